@@ -30,6 +30,7 @@
 #include <unistd.h>
 #include <zlib.h>
 
+#include <algorithm>
 #include <fstream>
 #include <memory>
 
@@ -50,6 +51,7 @@
 #include <android-base/macros.h>
 #include <android-base/properties.h>
 #include <android-base/stringprintf.h>
+#include <android-base/unique_fd.h>
 
 using namespace android;
 using pdx::default_transport::ServiceUtility;
@@ -892,6 +894,79 @@ static void stopTrace()
 }
 
 // Read data from the tracing pipe and forward to stdout
+// Writes whatever is left in the pipe to outFd with plain reads and writes.
+static bool drainPipe(int pipeFd, int outFd, size_t bytes)
+{
+    char buf[4096];
+    while (bytes > 0) {
+        ssize_t rc = TEMP_FAILURE_RETRY(read(pipeFd, buf, std::min(bytes, sizeof(buf))));
+        if (rc <= 0 || !android::base::WriteFully(outFd, buf, rc)) {
+            return false;
+        }
+        bytes -= rc;
+    }
+    return true;
+}
+
+// Moves the trace from inFd to outFd through a pipe with splice(), so that it never gets copied
+// through user space. Stops at the end of the input, on errors, or, when streaming, once tracing
+// is aborted. Returns false if inFd turns out not to support splicing before anything was moved,
+// in which case the caller should carry on with read() and write(). If only outFd doesn't
+// support it, the data is written out with write() instead.
+static bool spliceTrace(int inFd, int outFd)
+{
+    constexpr size_t kChunkSize = 64 * 1024;
+    int pipeFds[2];
+    if (pipe2(pipeFds, O_CLOEXEC) == -1) {
+        return false;
+    }
+    android::base::unique_fd pipeRead(pipeFds[0]);
+    android::base::unique_fd pipeWrite(pipeFds[1]);
+
+    bool spliced = false;
+    bool outSplice = true;
+    fflush(stdout);
+    while (true) {
+        // Not retried on EINTR: a signal is how streaming gets stopped.
+        ssize_t in = splice(inFd, nullptr, pipeWrite.get(), nullptr, kChunkSize, SPLICE_F_MOVE);
+        if (in == 0) {
+            break;
+        } else if (in < 0) {
+            if (!spliced && errno == EINVAL) {
+                return false;
+            }
+            if (errno == EINTR && !g_traceAborted) {
+                continue;
+            }
+            if (!g_traceAborted) {
+                fprintf(stderr, "error splicing trace: %s (%d)\n", strerror(errno), errno);
+            }
+            break;
+        }
+        spliced = true;
+
+        size_t left = in;
+        while (outSplice && left > 0) {
+            ssize_t out = TEMP_FAILURE_RETRY(
+                    splice(pipeRead.get(), nullptr, outFd, nullptr, left, SPLICE_F_MOVE));
+            if (out <= 0) {
+                if (out < 0 && errno == EINVAL) {
+                    outSplice = false;
+                    break;
+                }
+                fprintf(stderr, "error writing trace: %s\n", strerror(errno));
+                return true;
+            }
+            left -= out;
+        }
+        if (left > 0 && !drainPipe(pipeRead.get(), outFd, left)) {
+            fprintf(stderr, "error writing trace: %s\n", strerror(errno));
+            return true;
+        }
+    }
+    return true;
+}
+
 static void streamTrace()
 {
     char trace_data[4096];
@@ -901,6 +976,10 @@ static void streamTrace()
                 strerror(errno), errno);
         return;
     }
+    if (spliceTrace(traceFD, STDOUT_FILENO)) {
+        close(traceFD);
+        return;
+    }
     while (!g_traceAborted) {
         ssize_t bytes_read = read(traceFD, trace_data, 4096);
         if (bytes_read > 0) {
@@ -1003,8 +1082,9 @@ static void dumpTrace(int outFd)
         if (result != Z_OK) {
             fprintf(stderr, "error cleaning up zlib: %d\n", result);
         }
-    } else {
-        char buf[4096];
+    } else if (!spliceTrace(traceFD, outFd)) {
+        // The trace file doesn't support splicing on older kernels.
+        char buf[64 * 1024];
         ssize_t rc;
         while ((rc = TEMP_FAILURE_RETRY(read(traceFD, buf, sizeof(buf)))) > 0) {
             if (!android::base::WriteFully(outFd, buf, rc)) {
@@ -38,6 +38,7 @@
 #include <stdarg.h>
 #include <string.h>
 #include <sys/capability.h>
+#include <sys/eventfd.h>
 #include <sys/inotify.h>
 #include <sys/klog.h>
 #include <time.h>
@@ -45,6 +46,8 @@
 
 #include <chrono>
 #include <cmath>
+#include <condition_variable>
+#include <deque>
 #include <fstream>
 #include <functional>
 #include <future>
@@ -53,6 +56,7 @@
 #include <regex>
 #include <set>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -305,8 +309,8 @@ static bool CopyFileToFile(const std::string& input_file, const std::string& out
 
 static void RunDumpsys(const std::string& title, const std::vector<std::string>& dumpsysArgs,
                        const CommandOptions& options = Dumpstate::DEFAULT_DUMPSYS,
-                       long dumpsysTimeoutMs = 0) {
-    return ds.RunDumpsys(title, dumpsysArgs, options, dumpsysTimeoutMs);
+                       long dumpsysTimeoutMs = 0, int out_fd = STDOUT_FILENO) {
+    return ds.RunDumpsys(title, dumpsysArgs, options, dumpsysTimeoutMs, out_fd);
 }
 static int DumpFile(const std::string& title, const std::string& path) {
     return ds.DumpFile(title, path);
@@ -764,6 +768,137 @@ static const std::set<std::string> PROBLEMATIC_FILE_EXTENSIONS = {
       ".shb", ".sys", ".vb",  ".vbe", ".vbs", ".vxd", ".wsc", ".wsf", ".wsh"
 };
 
+// Reads the data for a zip entry in chunks. Unless the data is a small regular file, reading
+// happens on a background thread that stays up to kMaxQueuedChunks ahead of the caller, so
+// whoever writes into the other end of a pipe (e.g. a service dumping itself) and the disk are not
+// stalled while the previous chunk is being compressed.
+class ZipEntryReader {
+  public:
+    static constexpr size_t kChunkSize = 65536;
+    static constexpr size_t kMaxQueuedChunks = 16;
+
+    ZipEntryReader(const std::string& entry_name, int fd, std::chrono::milliseconds timeout)
+        : entry_name_(entry_name),
+          fd_(fd),
+          timeout_(timeout),
+          end_(std::chrono::steady_clock::now() + timeout) {
+        struct stat st;
+        if (fstat(fd_, &st) == 0 && S_ISREG(st.st_mode) &&
+            st.st_size <= static_cast<off_t>(kChunkSize)) {
+            return;
+        }
+        wake_fd_.reset(eventfd(0, EFD_CLOEXEC));
+        if (wake_fd_ == -1) {
+            MYLOGE("eventfd(%s): %s\n", entry_name_.c_str(), strerror(errno));
+            return;
+        }
+        thread_ = std::thread([this] { ReadAhead(); });
+    }
+
+    ~ZipEntryReader() {
+        if (!thread_.joinable()) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(lock_);
+            stopped_ = true;
+        }
+        cond_.notify_all();
+        uint64_t one = 1;
+        TEMP_FAILURE_RETRY(write(wake_fd_.get(), &one, sizeof(one)));
+        thread_.join();
+    }
+
+    // Moves the next chunk into |chunk| and returns its size, 0 at the end of the data or a
+    // negative status_t on errors and timeouts.
+    ssize_t Next(std::vector<uint8_t>* chunk) {
+        if (!thread_.joinable()) {
+            return Read(chunk);
+        }
+        std::unique_lock<std::mutex> lock(lock_);
+        cond_.wait(lock, [this] { return !chunks_.empty() || done_; });
+        if (chunks_.empty()) {
+            return result_;
+        }
+        *chunk = std::move(chunks_.front());
+        chunks_.pop_front();
+        cond_.notify_all();
+        return chunk->size();
+    }
+
+  private:
+    void ReadAhead() {
+        while (true) {
+            std::vector<uint8_t> chunk;
+            ssize_t result = Read(&chunk);
+            std::unique_lock<std::mutex> lock(lock_);
+            if (result <= 0) {
+                done_ = true;
+                result_ = result;
+                cond_.notify_all();
+                return;
+            }
+            chunks_.push_back(std::move(chunk));
+            cond_.notify_all();
+            cond_.wait(lock, [this] { return stopped_ || chunks_.size() < kMaxQueuedChunks; });
+            if (stopped_) {
+                return;
+            }
+        }
+    }
+
+    ssize_t Read(std::vector<uint8_t>* chunk) {
+        if (timeout_.count() > 0 || wake_fd_ != -1) {
+            int timeout_ms = -1;
+            if (timeout_.count() > 0) {
+                auto now = std::chrono::steady_clock::now();
+                auto diff = std::chrono::duration_cast<std::chrono::milliseconds>(end_ - now);
+                timeout_ms = std::max<int64_t>(diff.count(), 0);
+            }
+            // A negative fd is ignored by poll(), so this also works without a wake_fd_.
+            struct pollfd pfds[] = {{fd_, POLLIN, 0}, {wake_fd_.get(), POLLIN, 0}};
+            int rc = TEMP_FAILURE_RETRY(poll(pfds, arraysize(pfds), timeout_ms));
+            if (rc < 0) {
+                MYLOGE("Error in poll while adding from fd to zip entry %s:%s\n",
+                       entry_name_.c_str(), strerror(errno));
+                return -errno;
+            } else if (rc == 0) {
+                MYLOGE("Timed out adding from fd to zip entry %s:%s Timeout:%lldms\n",
+                       entry_name_.c_str(), strerror(errno), timeout_.count());
+                return TIMED_OUT;
+            } else if (pfds[1].revents != 0) {
+                // The caller gave up on this entry.
+                return -ECANCELED;
+            }
+        }
+
+        chunk->resize(kChunkSize);
+        ssize_t bytes_read = TEMP_FAILURE_RETRY(read(fd_, chunk->data(), chunk->size()));
+        if (bytes_read == -1) {
+            MYLOGE("read(%s): %s\n", entry_name_.c_str(), strerror(errno));
+            return -errno;
+        }
+        chunk->resize(bytes_read);
+        return bytes_read;
+    }
+
+    const std::string entry_name_;
+    const int fd_;
+    const std::chrono::milliseconds timeout_;
+    const std::chrono::steady_clock::time_point end_;
+    android::base::unique_fd wake_fd_;
+    std::thread thread_;
+
+    std::mutex lock_;
+    std::condition_variable cond_;
+    std::deque<std::vector<uint8_t>> chunks_;
+    bool done_ = false;
+    ssize_t result_ = 0;
+    bool stopped_ = false;
+
+    DISALLOW_COPY_AND_ASSIGN(ZipEntryReader);
+};
+
 status_t Dumpstate::AddZipEntryFromFd(const std::string& entry_name, int fd,
                                       std::chrono::milliseconds timeout = 0ms) {
     if (!IsZipping()) {
@@ -786,6 +921,7 @@ status_t Dumpstate::AddZipEntryFromFd(const std::string& entry_name, int fd,
 
     // Logging statement  below is useful to time how long each entry takes, but it's too verbose.
     // MYLOGD("Adding zip entry %s\n", entry_name.c_str());
+    std::lock_guard<std::mutex> lock(zip_lock_);
     int32_t err = zip_writer_->StartEntryWithTime(valid_name.c_str(), ZipWriter::kCompress,
                                                   get_mtime(fd, ds.now_));
     if (err != 0) {
@@ -804,40 +940,17 @@ status_t Dumpstate::AddZipEntryFromFd(const std::string& entry_name, int fd,
         }
     };
     auto scope_guard = android::base::make_scope_guard(finish_entry);
-    auto start = std::chrono::steady_clock::now();
-    auto end = start + timeout;
-    struct pollfd pfd = {fd, POLLIN};
 
-    std::vector<uint8_t> buffer(65536);
+    ZipEntryReader reader(entry_name, fd, timeout);
+    std::vector<uint8_t> chunk;
     while (1) {
-        if (timeout.count() > 0) {
-            // lambda to recalculate the timeout.
-            auto time_left_ms = [end]() {
-                auto now = std::chrono::steady_clock::now();
-                auto diff = std::chrono::duration_cast<std::chrono::milliseconds>(end - now);
-                return std::max(diff.count(), 0LL);
-            };
-
-            int rc = TEMP_FAILURE_RETRY(poll(&pfd, 1, time_left_ms()));
-            if (rc < 0) {
-                MYLOGE("Error in poll while adding from fd to zip entry %s:%s\n",
-                       entry_name.c_str(), strerror(errno));
-                return -errno;
-            } else if (rc == 0) {
-                MYLOGE("Timed out adding from fd to zip entry %s:%s Timeout:%lldms\n",
-                       entry_name.c_str(), strerror(errno), timeout.count());
-                return TIMED_OUT;
-            }
-        }
-
-        ssize_t bytes_read = TEMP_FAILURE_RETRY(read(fd, buffer.data(), buffer.size()));
+        ssize_t bytes_read = reader.Next(&chunk);
         if (bytes_read == 0) {
             break;
-        } else if (bytes_read == -1) {
-            MYLOGE("read(%s): %s\n", entry_name.c_str(), strerror(errno));
-            return -errno;
+        } else if (bytes_read < 0) {
+            return bytes_read;
         }
-        err = zip_writer_->WriteBytes(buffer.data(), bytes_read);
+        err = zip_writer_->WriteBytes(chunk.data(), bytes_read);
         if (err) {
             MYLOGE("zip_writer_->WriteBytes(): %s\n", ZipWriter::ErrorCodeString(err));
             return UNKNOWN_ERROR;
@@ -887,6 +1000,7 @@ bool Dumpstate::AddTextZipEntry(const std::string& entry_name, const std::string
         return false;
     }
     MYLOGD("Adding zip text entry %s\n", entry_name.c_str());
+    std::lock_guard<std::mutex> lock(zip_lock_);
     int32_t err = zip_writer_->StartEntryWithTime(entry_name.c_str(), ZipWriter::kCompress, ds.now_);
     if (err != 0) {
         MYLOGE("zip_writer_->StartEntryWithTime(%s): %s\n", entry_name.c_str(),
@@ -1153,6 +1267,9 @@ static void DumpIpAddrAndRules() {
     RunCommand("IP RULES v6", {"ip", "-6", "rule", "show"});
 }
 
+// How many services RunDumpsysTextByPriority() dumps at the same time.
+static const size_t kDumpsysTextJobs = 4;
+
 static Dumpstate::RunStatus RunDumpsysTextByPriority(const std::string& title, int priority,
                                                      std::chrono::milliseconds timeout,
                                                      std::chrono::milliseconds service_timeout) {
@@ -1162,30 +1279,20 @@ static Dumpstate::RunStatus RunDumpsysTextByPriority(const std::string& title, i
     Vector<String16> args;
     Dumpsys::setServiceArgs(args, /* asProto = */ false, priority);
     Vector<String16> services = dumpsys.listServices(priority, /* supports_proto = */ false);
-    for (const String16& service : services) {
-        RETURN_IF_USER_DENIED_CONSENT();
-        std::string path(title);
-        path.append(" - ").append(String8(service).c_str());
-        size_t bytes_written = 0;
-        status_t status = dumpsys.startDumpThread(Dumpsys::Type::DUMP, service, args);
-        if (status == OK) {
-            dumpsys.writeDumpHeader(STDOUT_FILENO, service, priority);
-            std::chrono::duration<double> elapsed_seconds;
-            status = dumpsys.writeDump(STDOUT_FILENO, service, service_timeout,
-                                       /* as_proto = */ false, elapsed_seconds, bytes_written);
-            dumpsys.writeDumpFooter(STDOUT_FILENO, service, elapsed_seconds);
-            bool dump_complete = (status == OK);
-            dumpsys.stopDumpThread(dump_complete);
-        }
-
+    auto should_start = [&]() {
+        if (ds.IsUserConsentDenied()) return false;
         auto elapsed_duration = std::chrono::duration_cast<std::chrono::milliseconds>(
             std::chrono::steady_clock::now() - start);
         if (elapsed_duration > timeout) {
             MYLOGE("*** command '%s' timed out after %llums\n", title.c_str(),
                    elapsed_duration.count());
-            break;
+            return false;
         }
-    }
+        return true;
+    };
+    dumpsys.dumpServices(STDOUT_FILENO, Dumpsys::Type::DUMP, services, args, priority,
+                         service_timeout, /* asProto = */ false, kDumpsysTextJobs, should_start);
+    RETURN_IF_USER_DENIED_CONSENT();
     return Dumpstate::RunStatus::OK;
 }
 
@@ -1245,8 +1352,6 @@ static Dumpstate::RunStatus RunDumpsysProto(const std::string& title, int priori
             bool dumpTerminated = (status == OK);
             dumpsys.stopDumpThread(dumpTerminated);
         }
-        ZipWriter::FileEntry file_entry;
-        ds.zip_writer_->GetLastEntry(&file_entry);
 
         auto elapsed_duration = std::chrono::duration_cast<std::chrono::milliseconds>(
             std::chrono::steady_clock::now() - start);
@@ -1294,15 +1399,18 @@ static Dumpstate::RunStatus RunDumpsysNormal() {
                            /* timeout= */ 90s, /* service_timeout= */ 10s);
 }
 
-static void DumpHals() {
+static void DumpHals(int out_fd = STDOUT_FILENO) {
     if (!ds.IsZipping()) {
-        RunCommand("HARDWARE HALS", {"lshal", "-lVSietrpc", "--types=b,c,l,z", "--debug"},
-                   CommandOptions::WithTimeout(10).AsRootIfAvailable().Build());
+        ds.RunCommand("HARDWARE HALS", {"lshal", "-lVSietrpc", "--types=b,c,l,z", "--debug"},
+                      CommandOptions::WithTimeout(10).AsRootIfAvailable().Build(),
+                      false /* verbose_duration */, out_fd);
         return;
     }
-    DurationReporter duration_reporter("DUMP HALS");
-    RunCommand("HARDWARE HALS", {"lshal", "-lVSietrpc", "--types=b,c,l,z"},
-               CommandOptions::WithTimeout(10).AsRootIfAvailable().Build());
+    DurationReporter duration_reporter("DUMP HALS", out_fd != STDOUT_FILENO /* logcat_only */,
+                                       false /* verbose */, out_fd);
+    ds.RunCommand("HARDWARE HALS", {"lshal", "-lVSietrpc", "--types=b,c,l,z"},
+                  CommandOptions::WithTimeout(10).AsRootIfAvailable().Build(),
+                  false /* verbose_duration */, out_fd);
 
     using android::hidl::manager::V1_0::IServiceManager;
     using android::hardware::defaultServiceManager;
@@ -1392,6 +1500,139 @@ static void DumpExternalFragmentationInfo() {
     printf("\n");
 }
 
+// Dumps the checkin variants of various services.
+static void DumpCheckins(int out_fd = STDOUT_FILENO) {
+    dprintf(out_fd, "========================================================\n");
+    dprintf(out_fd, "== Checkins\n");
+    dprintf(out_fd, "========================================================\n");
+
+    RunDumpsys("CHECKIN BATTERYSTATS", {"batterystats", "-c"}, Dumpstate::DEFAULT_DUMPSYS, 0,
+               out_fd);
+    if (ds.IsUserConsentDenied()) {
+        return;
+    }
+    RunDumpsys("CHECKIN MEMINFO", {"meminfo", "--checkin"}, Dumpstate::DEFAULT_DUMPSYS, 0,
+               out_fd);
+    if (ds.IsUserConsentDenied()) {
+        return;
+    }
+    RunDumpsys("CHECKIN NETSTATS", {"netstats", "--checkin"}, Dumpstate::DEFAULT_DUMPSYS, 0,
+               out_fd);
+    RunDumpsys("CHECKIN PROCSTATS", {"procstats", "-c"}, Dumpstate::DEFAULT_DUMPSYS, 0, out_fd);
+    RunDumpsys("CHECKIN USAGESTATS", {"usagestats", "-c"}, Dumpstate::DEFAULT_DUMPSYS, 0, out_fd);
+    RunDumpsys("CHECKIN PACKAGE", {"package", "--checkin"}, Dumpstate::DEFAULT_DUMPSYS, 0, out_fd);
+}
+
+// Dumps the activities, services and providers of running applications.
+static void DumpAppInfos(int out_fd = STDOUT_FILENO) {
+    dprintf(out_fd, "========================================================\n");
+    dprintf(out_fd, "== Running Application Activities\n");
+    dprintf(out_fd, "========================================================\n");
+
+    // The following dumpsys internally collects output from running apps, so it can take a long
+    // time. So let's extend the timeout.
+
+    const CommandOptions DUMPSYS_COMPONENTS_OPTIONS = CommandOptions::WithTimeout(60).Build();
+
+    RunDumpsys("APP ACTIVITIES", {"activity", "-v", "all"}, DUMPSYS_COMPONENTS_OPTIONS, 0, out_fd);
+
+    dprintf(out_fd, "========================================================\n");
+    dprintf(out_fd, "== Running Application Services (platform)\n");
+    dprintf(out_fd, "========================================================\n");
+
+    RunDumpsys("APP SERVICES PLATFORM", {"activity", "service", "all-platform-non-critical"},
+            DUMPSYS_COMPONENTS_OPTIONS, 0, out_fd);
+
+    dprintf(out_fd, "========================================================\n");
+    dprintf(out_fd, "== Running Application Services (non-platform)\n");
+    dprintf(out_fd, "========================================================\n");
+
+    RunDumpsys("APP SERVICES NON-PLATFORM", {"activity", "service", "all-non-platform"},
+            DUMPSYS_COMPONENTS_OPTIONS, 0, out_fd);
+
+    dprintf(out_fd, "========================================================\n");
+    dprintf(out_fd, "== Running Application Providers (platform)\n");
+    dprintf(out_fd, "========================================================\n");
+
+    RunDumpsys("APP PROVIDERS PLATFORM", {"activity", "provider", "all-platform"},
+            DUMPSYS_COMPONENTS_OPTIONS, 0, out_fd);
+
+    dprintf(out_fd, "========================================================\n");
+    dprintf(out_fd, "== Running Application Providers (non-platform)\n");
+    dprintf(out_fd, "========================================================\n");
+
+    RunDumpsys("APP PROVIDERS NON-PLATFORM", {"activity", "provider", "all-non-platform"},
+            DUMPSYS_COMPONENTS_OPTIONS, 0, out_fd);
+}
+
+// A section of the report that is generated on its own thread while the main thread carries on
+// with the sections before it. Its output goes to an unlinked file in the bugreport directory and
+// Wait() appends it to stdout, so the report keeps the layout it had when sections ran in turn.
+// Sections run this way must write to the fd they are given rather than stdout; zip entries they
+// add are serialized by Dumpstate::zip_lock_.
+class ParallelSection {
+  public:
+    ParallelSection(const std::string& title, std::function<void(int)> dump)
+        : title_(title), dump_(std::move(dump)) {
+        fd_.reset(TEMP_FAILURE_RETRY(open(ds.bugreport_internal_dir_.c_str(),
+                                          O_TMPFILE | O_RDWR | O_CLOEXEC, S_IRUSR | S_IWUSR)));
+        if (fd_ == -1) {
+            MYLOGE("Could not create output file for %s, it will run in turn: %s\n",
+                   title_.c_str(), strerror(errno));
+            return;
+        }
+        thread_ = std::thread([this] { dump_(fd_.get()); });
+    }
+
+    // Sections that were never waited on, e.g. because the user denied consent, still have to
+    // finish before the zip file is closed.
+    ~ParallelSection() {
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+
+    // Waits for the section and appends its output to stdout. If it could not be started in the
+    // background, runs it now instead.
+    void Wait() {
+        if (waited_) {
+            return;
+        }
+        waited_ = true;
+        if (!thread_.joinable()) {
+            dump_(STDOUT_FILENO);
+            return;
+        }
+        thread_.join();
+
+        if (lseek(fd_.get(), 0, SEEK_SET) == -1) {
+            MYLOGE("lseek(%s): %s\n", title_.c_str(), strerror(errno));
+            return;
+        }
+        std::vector<char> buffer(64 * 1024);
+        ssize_t bytes_read;
+        while ((bytes_read = TEMP_FAILURE_RETRY(read(fd_.get(), buffer.data(), buffer.size()))) >
+               0) {
+            if (!android::base::WriteFully(STDOUT_FILENO, buffer.data(), bytes_read)) {
+                MYLOGE("Failed to copy output of %s: %s\n", title_.c_str(), strerror(errno));
+                return;
+            }
+        }
+        if (bytes_read == -1) {
+            MYLOGE("read(%s): %s\n", title_.c_str(), strerror(errno));
+        }
+    }
+
+  private:
+    std::string title_;
+    std::function<void(int)> dump_;
+    android::base::unique_fd fd_;
+    std::thread thread_;
+    bool waited_ = false;
+
+    DISALLOW_COPY_AND_ASSIGN(ParallelSection);
+};
+
 static void DumpstateLimitedOnly() {
     // Trimmed-down version of dumpstate to only include a whitelisted
     // set of logs (system log, event log, and system server / system app
@@ -1439,6 +1680,12 @@ static void DumpstateLimitedOnly() {
 static Dumpstate::RunStatus dumpstate() {
     DurationReporter duration_reporter("DUMPSTATE");
 
+    // These sections don't depend on the rest of the report, so they run in the background from
+    // the start and their output is placed where they used to run.
+    ParallelSection dump_hals("DUMP HALS", DumpHals);
+    ParallelSection dump_checkins("CHECKINS", DumpCheckins);
+    ParallelSection dump_app_infos("APP INFOS", DumpAppInfos);
+
     // Dump various things. Note that anything that takes "long" (i.e. several seconds) should
     // check intermittently (if it's intrerruptable like a foreach on pids) and/or should be wrapped
     // in a consent check (via RUN_SLOW_FUNCTION_WITH_CONSENT_CHECK).
@@ -1470,7 +1717,7 @@ static Dumpstate::RunStatus dumpstate() {
     RUN_SLOW_FUNCTION_WITH_CONSENT_CHECK(RunCommand, "LIBRANK", {"librank"},
                                          CommandOptions::AS_ROOT);
 
-    DumpHals();
+    dump_hals.Wait();
 
     RunCommand("PRINTENV", {"printenv"});
     RunCommand("NETSTAT", {"netstat", "-nW"});
@@ -1574,57 +1821,9 @@ static Dumpstate::RunStatus dumpstate() {
 
     RUN_SLOW_FUNCTION_WITH_CONSENT_CHECK(RunDumpsysNormal);
 
-    printf("========================================================\n");
-    printf("== Checkins\n");
-    printf("========================================================\n");
-
-    RunDumpsys("CHECKIN BATTERYSTATS", {"batterystats", "-c"});
-
-    RUN_SLOW_FUNCTION_WITH_CONSENT_CHECK(RunDumpsys, "CHECKIN MEMINFO", {"meminfo", "--checkin"});
-
-    RunDumpsys("CHECKIN NETSTATS", {"netstats", "--checkin"});
-    RunDumpsys("CHECKIN PROCSTATS", {"procstats", "-c"});
-    RunDumpsys("CHECKIN USAGESTATS", {"usagestats", "-c"});
-    RunDumpsys("CHECKIN PACKAGE", {"package", "--checkin"});
+    RUN_SLOW_FUNCTION_WITH_CONSENT_CHECK(dump_checkins.Wait);
 
-    printf("========================================================\n");
-    printf("== Running Application Activities\n");
-    printf("========================================================\n");
-
-    // The following dumpsys internally collects output from running apps, so it can take a long
-    // time. So let's extend the timeout.
-
-    const CommandOptions DUMPSYS_COMPONENTS_OPTIONS = CommandOptions::WithTimeout(60).Build();
-
-    RunDumpsys("APP ACTIVITIES", {"activity", "-v", "all"}, DUMPSYS_COMPONENTS_OPTIONS);
-
-    printf("========================================================\n");
-    printf("== Running Application Services (platform)\n");
-    printf("========================================================\n");
-
-    RunDumpsys("APP SERVICES PLATFORM", {"activity", "service", "all-platform-non-critical"},
-            DUMPSYS_COMPONENTS_OPTIONS);
-
-    printf("========================================================\n");
-    printf("== Running Application Services (non-platform)\n");
-    printf("========================================================\n");
-
-    RunDumpsys("APP SERVICES NON-PLATFORM", {"activity", "service", "all-non-platform"},
-            DUMPSYS_COMPONENTS_OPTIONS);
-
-    printf("========================================================\n");
-    printf("== Running Application Providers (platform)\n");
-    printf("========================================================\n");
-
-    RunDumpsys("APP PROVIDERS PLATFORM", {"activity", "provider", "all-platform"},
-            DUMPSYS_COMPONENTS_OPTIONS);
-
-    printf("========================================================\n");
-    printf("== Running Application Providers (non-platform)\n");
-    printf("========================================================\n");
-
-    RunDumpsys("APP PROVIDERS NON-PLATFORM", {"activity", "provider", "all-non-platform"},
-            DUMPSYS_COMPONENTS_OPTIONS);
+    RUN_SLOW_FUNCTION_WITH_CONSENT_CHECK(dump_app_infos.Wait);
 
     printf("========================================================\n");
     printf("== Dropbox crashes\n");
@@ -2155,6 +2354,26 @@ bool Dumpstate::FinishZipFile() {
         MYLOGE("Failed to add text entry to .zip file\n");
         return false;
     }
+
+    // One line per section, with times relative to the first section that started. The title
+    // comes last so it needs no quoting.
+    std::string sections = "start_ms,duration_ms,bytes,timed_out,title\n";
+    {
+        std::lock_guard<std::mutex> lock(sections_lock_);
+        uint64_t first_start_ns = UINT64_MAX;
+        for (const auto& section : sections_) {
+            first_start_ns = std::min(first_start_ns, section.start_ns);
+        }
+        for (const auto& section : sections_) {
+            sections += StringPrintf("%" PRIu64 ",%" PRIu64 ",%" PRId64 ",%d,%s\n",
+                                     (section.start_ns - first_start_ns) / 1000000,
+                                     section.duration_ns / 1000000, section.bytes,
+                                     section.timed_out, section.title.c_str());
+        }
+    }
+    if (!AddTextZipEntry("dumpstate_sections.txt", sections)) {
+        MYLOGE("Failed to add dumpstate_sections.txt to .zip file\n");
+    }
     if (!AddTextZipEntry("main_entry.txt", entry_name)) {
         MYLOGE("Failed to add main_entry.txt to .zip file\n");
         return false;
@@ -2989,16 +3208,24 @@ Dumpstate& Dumpstate::GetInstance() {
     return singleton_;
 }
 
-DurationReporter::DurationReporter(const std::string& title, bool logcat_only, bool verbose)
-    : title_(title), logcat_only_(logcat_only), verbose_(verbose) {
+DurationReporter::DurationReporter(const std::string& title, bool logcat_only, bool verbose,
+                                   int out_fd)
+    : title_(title), logcat_only_(logcat_only), verbose_(verbose), out_fd_(out_fd) {
     if (!title_.empty()) {
         started_ = Nanotime();
+        start_offset_ = lseek(out_fd_, 0, SEEK_CUR);
     }
 }
 
 DurationReporter::~DurationReporter() {
     if (!title_.empty()) {
-        float elapsed = (float)(Nanotime() - started_) / NANOS_PER_SEC;
+        uint64_t duration = Nanotime() - started_;
+        off_t end_offset = start_offset_ == -1 ? -1 : lseek(out_fd_, 0, SEEK_CUR);
+        Dumpstate::GetInstance().RecordSection(title_, started_, duration,
+                                               end_offset == -1 ? -1 : end_offset - start_offset_,
+                                               timed_out_);
+
+        float elapsed = (float)duration / NANOS_PER_SEC;
         if (elapsed >= .5f || verbose_) {
             MYLOGD("Duration of '%s': %.2fs\n", title_.c_str(), elapsed);
         }
@@ -3590,10 +3817,17 @@ int dump_file_from_fd(const char *title, const char *path, int fd) {
 }
 
 int Dumpstate::RunCommand(const std::string& title, const std::vector<std::string>& full_command,
-                          const CommandOptions& options, bool verbose_duration) {
-    DurationReporter duration_reporter(title, false /* logcat_only */, verbose_duration);
+                          const CommandOptions& options, bool verbose_duration, int out_fd) {
+    DurationReporter duration_reporter(title, out_fd != STDOUT_FILENO /* logcat_only */,
+                                       verbose_duration, out_fd);
 
-    int status = RunCommandToFd(STDOUT_FILENO, title, full_command, options);
+    uint64_t start = Nanotime();
+    int status = RunCommandToFd(out_fd, title, full_command, options);
+    // RunCommandToFd() returns -1 both for timeouts and for errors; only a timeout runs this long.
+    if (status == -1 &&
+        static_cast<int64_t>((Nanotime() - start) / 1000000) >= options.TimeoutInMs()) {
+        duration_reporter.SetTimedOut();
+    }
 
     /* TODO: for now we're simplifying the progress calculation by using the
      * timeout as the weight. It's a good approximation for most cases, except when calling dumpsys,
@@ -3605,11 +3839,11 @@ int Dumpstate::RunCommand(const std::string& title, const std::vector<std::strin
 }
 
 void Dumpstate::RunDumpsys(const std::string& title, const std::vector<std::string>& dumpsys_args,
-                           const CommandOptions& options, long dumpsysTimeoutMs) {
+                           const CommandOptions& options, long dumpsysTimeoutMs, int out_fd) {
     long timeout_ms = dumpsysTimeoutMs > 0 ? dumpsysTimeoutMs : options.TimeoutInMs();
     std::vector<std::string> dumpsys = {"/system/bin/dumpsys", "-T", std::to_string(timeout_ms)};
     dumpsys.insert(dumpsys.end(), dumpsys_args.begin(), dumpsys_args.end());
-    RunCommand(title, dumpsys, options);
+    RunCommand(title, dumpsys, options, false /* verbose_duration */, out_fd);
 }
 
 int open_socket(const char *service) {
@@ -3732,8 +3966,14 @@ void dump_route_tables() {
     fclose(fp);
 }
 
-// TODO: make this function thread safe if sections are generated in parallel.
+void Dumpstate::RecordSection(const std::string& title, uint64_t start_ns, uint64_t duration_ns,
+                              int64_t bytes, bool timed_out) {
+    std::lock_guard<std::mutex> lock(sections_lock_);
+    sections_.push_back({title, start_ns, duration_ns, bytes, timed_out});
+}
+
 void Dumpstate::UpdateProgress(int32_t delta_sec) {
+    std::lock_guard<std::mutex> lock(progress_lock_);
     if (progress_ == nullptr) {
         MYLOGE("UpdateProgress: progress_ not set\n");
         return;
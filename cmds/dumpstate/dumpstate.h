@@ -22,6 +22,7 @@
 #include <stdbool.h>
 #include <stdio.h>
 
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -65,7 +66,8 @@ extern "C" {
 #endif
 
 /*
- * Helper class used to report how long it takes for a section to finish.
+ * Helper class used to report how long it takes for a section to finish, and how many bytes it
+ * wrote to |out_fd|. Every section is also listed in the dumpstate_sections.txt zip entry.
  *
  * Typical usage:
  *
@@ -75,15 +77,23 @@ extern "C" {
 class DurationReporter {
   public:
     explicit DurationReporter(const std::string& title, bool logcat_only = false,
-                              bool verbose = false);
+                              bool verbose = false, int out_fd = STDOUT_FILENO);
 
     ~DurationReporter();
 
+    // Flags the section as having been cut short by its timeout.
+    void SetTimedOut() {
+        timed_out_ = true;
+    }
+
   private:
     std::string title_;
     bool logcat_only_;
     bool verbose_;
+    int out_fd_;
     uint64_t started_;
+    off_t start_offset_;
+    bool timed_out_ = false;
 
     DISALLOW_COPY_AND_ASSIGN(DurationReporter);
 };
@@ -227,11 +237,12 @@ class Dumpstate {
      * |full_command| array containing the command (first entry) and its arguments.
      * Must contain at least one element.
      * |options| optional argument defining the command's behavior.
+     * |out_fd| where the output goes; when it is not `stdout`, the duration is only logged.
      */
     int RunCommand(const std::string& title, const std::vector<std::string>& fullCommand,
                    const android::os::dumpstate::CommandOptions& options =
                        android::os::dumpstate::CommandOptions::DEFAULT,
-                   bool verbose_duration = false);
+                   bool verbose_duration = false, int out_fd = STDOUT_FILENO);
 
     /*
      * Runs `dumpsys` with the given arguments, automatically setting its timeout
@@ -244,10 +255,11 @@ class Dumpstate {
      * |options| optional argument defining the command's behavior.
      * |dumpsys_timeout| when > 0, defines the value passed to `dumpsys -T` (otherwise it uses the
      * timeout from `options`)
+     * |out_fd| where the output goes (see RunCommand()).
      */
     void RunDumpsys(const std::string& title, const std::vector<std::string>& dumpsys_args,
                     const android::os::dumpstate::CommandOptions& options = DEFAULT_DUMPSYS,
-                    long dumpsys_timeout_ms = 0);
+                    long dumpsys_timeout_ms = 0, int out_fd = STDOUT_FILENO);
 
     /*
      * Prints the contents of a file.
@@ -306,8 +318,16 @@ class Dumpstate {
 
     void DumpstateBoard();
 
+    /*
+     * Records a finished section for the dumpstate_sections.txt zip entry. |bytes| is what the
+     * section wrote to the text report, or -1 if that is unknown.
+     */
+    void RecordSection(const std::string& title, uint64_t start_ns, uint64_t duration_ns,
+                       int64_t bytes, bool timed_out);
+
     /*
      * Updates the overall progress of the bugreport generation by the given weight increment.
+     * Safe to call from sections running in parallel.
      */
     void UpdateProgress(int32_t delta);
 
@@ -481,6 +501,25 @@ class Dumpstate {
     // Pointer to the zip structure.
     std::unique_ptr<ZipWriter> zip_writer_;
 
+    // Serializes entries added to zip_writer_, which can only write one entry at a time, by
+    // sections running in parallel.
+    std::mutex zip_lock_;
+
+    // Guards progress_ and last_reported_percent_progress_ in UpdateProgress().
+    std::mutex progress_lock_;
+
+    struct SectionStats {
+        std::string title;
+        uint64_t start_ns;
+        uint64_t duration_ns;
+        int64_t bytes;
+        bool timed_out;
+    };
+
+    // Sections recorded by RecordSection(), in the order they finished.
+    std::vector<SectionStats> sections_;
+    std::mutex sections_lock_;
+
     // Binder object listening to progress.
     android::sp<android::os::IDumpstateListener> listener_;
 
@@ -615,6 +615,21 @@ TEST_F(DumpstateTest, RunCommandWithTitle) {
                 StartsWith("------ I AM GROOT (" + kSimpleCommand + ") ------\nstdout\n"));
 }
 
+TEST_F(DumpstateTest, RunCommandToOutFd) {
+    TemporaryFile tmp;
+    CaptureStdout();
+    CaptureStderr();
+    EXPECT_EQ(0, ds.RunCommand("I AM GROOT", {kSimpleCommand}, CommandOptions::DEFAULT,
+                               true /* verbose_duration */, tmp.fd));
+    out = GetCapturedStdout();
+    err = GetCapturedStderr();
+    // Not even the duration goes to stdout.
+    EXPECT_THAT(out, IsEmpty());
+    std::string content;
+    ReadFileToString(tmp.path, &content);
+    EXPECT_THAT(content, StartsWith("------ I AM GROOT (" + kSimpleCommand + ") ------\nstdout\n"));
+}
+
 TEST_F(DumpstateTest, RunCommandWithLoggingMessage) {
     EXPECT_EQ(
         0, RunCommand("", {kSimpleCommand},
@@ -16,8 +16,10 @@
 
 #include <algorithm>
 #include <chrono>
+#include <deque>
 #include <iomanip>
 #include <thread>
+#include <vector>
 
 #include <android-base/file.h>
 #include <android-base/stringprintf.h>
@@ -60,13 +62,15 @@ static void usage() {
             "usage: dumpsys\n"
             "         To dump all services.\n"
             "or:\n"
-            "       dumpsys [-t TIMEOUT] [--priority LEVEL] [--pid] [--help | -l | --skip SERVICES "
-            "| SERVICE [ARGS]]\n"
+            "       dumpsys [-t TIMEOUT] [--priority LEVEL] [--pid] [--parallel JOBS] [--help | -l | "
+            "--skip SERVICES | SERVICE [ARGS]]\n"
             "         --help: shows this help\n"
             "         -l: only list services, do not dump them\n"
             "         -t TIMEOUT_SEC: TIMEOUT to use in seconds instead of default 10 seconds\n"
             "         -T TIMEOUT_MS: TIMEOUT to use in milliseconds instead of default 10 seconds\n"
             "         --pid: dump PID instead of usual dump\n"
+            "         --parallel JOBS: dump up to JOBS services at the same time; output is still\n"
+            "               written in order\n"
             "         --proto: filter services that support dumping data in proto format. Dumps\n"
             "               will be in proto format.\n"
             "         --priority LEVEL: filter services based on specified priority\n"
@@ -125,7 +129,9 @@ int Dumpsys::main(int argc, char* const argv[]) {
     Type type = Type::DUMP;
     int timeoutArgMs = 10000;
     int priorityFlags = IServiceManager::DUMP_FLAG_PRIORITY_ALL;
+    int maxConcurrent = 1;
     static struct option longOptions[] = {{"pid", no_argument, 0, 0},
+                                          {"parallel", required_argument, 0, 0},
                                           {"priority", required_argument, 0, 0},
                                           {"proto", no_argument, 0, 0},
                                           {"skip", no_argument, 0, 0},
@@ -163,6 +169,13 @@ int Dumpsys::main(int argc, char* const argv[]) {
                 }
             } else if (!strcmp(longOptions[optionIndex].name, "pid")) {
                 type = Type::PID;
+            } else if (!strcmp(longOptions[optionIndex].name, "parallel")) {
+                char* endptr;
+                maxConcurrent = strtol(optarg, &endptr, 10);
+                if (*endptr != '\0' || maxConcurrent <= 0) {
+                    fprintf(stderr, "Error: invalid number of parallel dumps: '%s'\n", optarg);
+                    return -1;
+                }
             }
             break;
 
@@ -248,6 +261,16 @@ int Dumpsys::main(int argc, char* const argv[]) {
         return 0;
     }
 
+    if (N > 1 && maxConcurrent > 1) {
+        Vector<String16> dumpedServices;
+        for (const String16& serviceName : services) {
+            if (!IsSkipped(skippedServices, serviceName)) dumpedServices.add(serviceName);
+        }
+        dumpServices(STDOUT_FILENO, type, dumpedServices, args, priorityFlags,
+                     std::chrono::milliseconds(timeoutArgMs), asProto, maxConcurrent);
+        return 0;
+    }
+
     for (size_t i = 0; i < N; i++) {
         const String16& serviceName = services[i];
         if (IsSkipped(skippedServices, serviceName)) continue;
@@ -398,6 +421,12 @@ void Dumpsys::writeDumpHeader(int fd, const String16& serviceName, int priorityF
     WriteStringToFd(msg, fd);
 }
 
+static std::string timeoutMessage(const String16& serviceName,
+                                  std::chrono::milliseconds timeout) {
+    return StringPrintf("\n*** SERVICE '%s' DUMP TIMEOUT (%llums) EXPIRED ***\n\n",
+                        String8(serviceName).string(), timeout.count());
+}
+
 status_t Dumpsys::writeDump(int fd, const String16& serviceName, std::chrono::milliseconds timeout,
                             bool asProto, std::chrono::duration<double>& elapsedDuration,
                             size_t& bytesWritten) const {
@@ -454,9 +483,7 @@ status_t Dumpsys::writeDump(int fd, const String16& serviceName, std::chrono::mi
     }
 
     if ((status == TIMED_OUT) && (!asProto)) {
-        std::string msg = StringPrintf("\n*** SERVICE '%s' DUMP TIMEOUT (%llums) EXPIRED ***\n\n",
-                                       String8(serviceName).string(), timeout.count());
-        WriteStringToFd(msg, fd);
+        WriteStringToFd(timeoutMessage(serviceName, timeout), fd);
     }
 
     elapsedDuration = std::chrono::steady_clock::now() - start;
@@ -464,6 +491,145 @@ status_t Dumpsys::writeDump(int fd, const String16& serviceName, std::chrono::mi
     return status;
 }
 
+namespace {
+
+// A dump started by Dumpsys::dumpServices() whose output has not been fully written yet.
+struct PendingDump {
+    String16 serviceName;
+    std::thread thread;
+    unique_fd fd;
+    std::chrono::steady_clock::time_point start;
+    std::string output;
+    bool headerWritten = false;
+    bool done = false;
+    status_t status = OK;
+    std::chrono::duration<double> elapsedDuration;
+
+    void finish(status_t finalStatus) {
+        status = finalStatus;
+        done = true;
+        elapsedDuration = std::chrono::steady_clock::now() - start;
+        fd.reset();
+    }
+};
+
+}  // namespace
+
+status_t Dumpsys::dumpServices(int fd, Type type, const Vector<String16>& services,
+                               const Vector<String16>& args, int priorityFlags,
+                               std::chrono::milliseconds timeout, bool asProto,
+                               size_t maxConcurrent, const std::function<bool()>& shouldStart) {
+    maxConcurrent = std::max<size_t>(maxConcurrent, 1);
+    std::deque<PendingDump> pending;
+    size_t next = 0;
+    status_t status = OK;
+
+    while (status == OK) {
+        while (pending.size() < maxConcurrent && next < services.size()) {
+            if (shouldStart && !shouldStart()) {
+                next = services.size();
+                break;
+            }
+            const String16& serviceName = services[next++];
+            if (startDumpThread(type, serviceName, args) != OK) continue;
+            PendingDump& dump = pending.emplace_back();
+            dump.serviceName = serviceName;
+            dump.thread = std::move(activeThread_);
+            dump.fd = std::move(redirectFd_);
+            dump.start = std::chrono::steady_clock::now();
+        }
+
+        // The oldest dump is written as its output arrives; the others are buffered until it is
+        // their turn.
+        while (!pending.empty()) {
+            PendingDump& dump = pending.front();
+            if (!dump.headerWritten) {
+                writeDumpHeader(fd, dump.serviceName, priorityFlags);
+                dump.headerWritten = true;
+            }
+            if (!dump.output.empty()) {
+                if (!WriteFully(fd, dump.output.data(), dump.output.size())) {
+                    status = -errno;
+                    std::cerr << "Failed to write while dumping service " << dump.serviceName
+                              << ": " << strerror(-status) << std::endl;
+                    break;
+                }
+                dump.output.clear();
+            }
+            if (!dump.done) break;
+            if (dump.status == TIMED_OUT && !asProto) {
+                WriteStringToFd(timeoutMessage(dump.serviceName, timeout), fd);
+            }
+            writeDumpFooter(fd, dump.serviceName, dump.elapsedDuration);
+            if (dump.status == OK) {
+                dump.thread.join();
+            } else {
+                dump.thread.detach();
+            }
+            pending.pop_front();
+        }
+        if (pending.empty()) {
+            if (next >= services.size()) break;
+            continue;
+        }
+        if (status != OK) break;
+
+        auto now = std::chrono::steady_clock::now();
+        auto wakeUp = now + timeout;
+        std::vector<struct pollfd> pfds;
+        std::vector<PendingDump*> polled;
+        for (PendingDump& dump : pending) {
+            if (dump.done) continue;
+            auto end = dump.start + timeout;
+            if (end <= now) {
+                dump.finish(TIMED_OUT);
+                continue;
+            }
+            wakeUp = std::min(wakeUp, end);
+            pfds.push_back({.fd = dump.fd.get(), .events = POLLIN});
+            polled.push_back(&dump);
+        }
+        if (pfds.empty()) continue;
+
+        // Round up so that poll() does not return just before the earliest timeout.
+        auto waitMs = std::chrono::ceil<std::chrono::milliseconds>(wakeUp - now).count();
+        int rc = TEMP_FAILURE_RETRY(poll(pfds.data(), pfds.size(), waitMs));
+        if (rc < 0) {
+            int err = errno;
+            std::cerr << "Error in poll while dumping services: " << strerror(err) << std::endl;
+            for (PendingDump* dump : polled) dump->finish(-err);
+            continue;
+        }
+        for (size_t i = 0; i < pfds.size(); i++) {
+            if (pfds[i].revents == 0) continue;
+            PendingDump* dump = polled[i];
+            char buf[65536];
+            ssize_t bytesRead = TEMP_FAILURE_RETRY(read(dump->fd.get(), buf, sizeof(buf)));
+            if (bytesRead < 0) {
+                int err = errno;
+                std::cerr << "Failed to read while dumping service " << dump->serviceName << ": "
+                          << strerror(err) << std::endl;
+                dump->finish(-err);
+            } else if (bytesRead == 0) {
+                dump->finish(OK);
+            } else {
+                dump->output.append(buf, bytesRead);
+            }
+        }
+    }
+
+    // Only reached with dumps pending if writing failed; leave them to finish on their own.
+    for (PendingDump& dump : pending) {
+        dump.fd.reset();
+        if (dump.done && dump.status == OK) {
+            dump.thread.join();
+        } else {
+            dump.thread.detach();
+        }
+    }
+    return status;
+}
+
 void Dumpsys::writeDumpFooter(int fd, const String16& serviceName,
                               const std::chrono::duration<double>& elapsedDuration) const {
     using std::chrono::system_clock;
@@ -17,6 +17,8 @@
 #ifndef FRAMEWORK_NATIVE_CMD_DUMPSYS_H_
 #define FRAMEWORK_NATIVE_CMD_DUMPSYS_H_
 
+#include <chrono>
+#include <functional>
 #include <thread>
 
 #include <android-base/unique_fd.h>
@@ -106,6 +108,30 @@ class Dumpsys {
     void writeDumpFooter(int fd, const String16& serviceName,
                          const std::chrono::duration<double>& elapsedDuration) const;
 
+    /**
+     * Dumps several services at once, running up to {@code maxConcurrent} dump threads at a time.
+     * The output of each service is written to a file descriptor between a header and a footer,
+     * in the order of {@code services}; a service's output is buffered in memory until all the
+     * services before it have been written.
+     * @param fd file descriptor to write data
+     * @param type type of dump
+     * @param services services to dump; services that can't be found are skipped
+     * @param args list of arguments to pass to service dump method.
+     * @param priorityFlags dump priority specified
+     * @param timeout timeout to terminate each dump if not completed
+     * @param asProto used to supresses additional output to the fd such as timeout
+     * error messages
+     * @param maxConcurrent maximum number of services dumping at the same time
+     * @param shouldStart if set, called before starting each dump; once it returns
+     * {@code false}, no more dumps are started, but the ones already running are still written
+     * @return {@code OK} if successful
+     *         {@code != OK} error writing to the fd
+     */
+    status_t dumpServices(int fd, Type type, const Vector<String16>& services,
+                          const Vector<String16>& args, int priorityFlags,
+                          std::chrono::milliseconds timeout, bool asProto, size_t maxConcurrent,
+                          const std::function<bool()>& shouldStart = nullptr);
+
     /**
      * Terminates dump thread.
      * @param dumpComplete If {@code true}, indicates the dump was successfully completed and
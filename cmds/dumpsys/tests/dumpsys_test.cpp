@@ -237,6 +237,15 @@ class DumpsysTest : public Test {
         EXPECT_THAT(stdout_, HasSubstr("was the duration of dumpsys " + service + ", ending at: "));
     }
 
+    void AssertOutputInOrder(const std::vector<std::string>& parts) {
+        size_t pos = 0;
+        for (const std::string& part : parts) {
+            pos = stdout_.find(part, pos);
+            ASSERT_NE(pos, std::string::npos) << "'" << part << "' missing or out of order";
+            pos += part.size();
+        }
+    }
+
     void AssertNotDumped(const std::string& dump) {
         EXPECT_THAT(stdout_, Not(HasSubstr(dump)));
     }
@@ -426,6 +435,40 @@ TEST_F(DumpsysTest, DumpMultipleServices) {
     AssertDumped("running3", "dump3");
 }
 
+// Tests 'dumpsys --parallel 2', where the first service is the slowest to dump
+TEST_F(DumpsysTest, DumpMultipleServicesInParallel) {
+    ExpectListServices({"running1", "stopped2", "running3", "running4"});
+    ExpectDumpAndHang("running1", 1, "dump1");
+    ExpectCheckService("stopped2", false);
+    ExpectDump("running3", "dump3");
+    ExpectDump("running4", "dump4");
+
+    CallMain({"--parallel", "2"});
+
+    AssertRunningServices({"running1", "running3", "running4"});
+    AssertDumped("running1", "dump1");
+    AssertStopped("stopped2");
+    AssertDumped("running3", "dump3");
+    AssertDumped("running4", "dump4");
+    AssertOutputInOrder({"dump1", "dump3", "dump4"});
+}
+
+// Tests 'dumpsys -T 500 --parallel 2' where one of the services times out after 2s
+TEST_F(DumpsysTest, DumpMultipleServicesInParallelWithTimeout) {
+    ExpectListServices({"Locksmith", "Valet"});
+    sp<BinderMock> binder_mock = ExpectDumpAndHang("Locksmith", 2, "Here's your key");
+    ExpectDump("Valet", "Here's your car");
+
+    CallMain({"-T", "500", "--parallel", "2"});
+
+    AssertOutputContains("SERVICE 'Locksmith' DUMP TIMEOUT (500ms) EXPIRED");
+    AssertNotDumped("Here's your key");
+    AssertDumped("Valet", "Here's your car");
+
+    // TODO(b/65056227): BinderMock is not destructed because thread is detached on dumpsys.cpp
+    Mock::AllowLeak(binder_mock.get());
+}
+
 // Tests 'dumpsys --skip skipped3 skipped5', which should skip these services
 TEST_F(DumpsysTest, DumpWithSkip) {
     ExpectListServices({"running1", "stopped2", "skipped3", "running4", "skipped5"});
@@ -126,16 +126,50 @@ public:
         return true;
     }
 
+    virtual bool setUpLayer(const sp<SurfaceControl>& sc,
+            SurfaceComposerClient::Transaction* t) {
+        t->setPosition(sc, mLayerDesc.x, mLayerDesc.y);
+        return true;
+    }
+
+    virtual void updateLayer(const sp<SurfaceControl>& /*sc*/,
+            SurfaceComposerClient::Transaction* /*t*/) {
+    }
+
 protected:
     virtual bool setUp(GLHelper* /*helper*/) {
         return true;
     }
 
+    // Alternately shrinks the layer and restores it, as the shrinking
+    // composers do.
+    void shrinkLayer(bool shrink, const sp<SurfaceControl>& sc,
+            SurfaceComposerClient::Transaction* t) {
+        int32_t x = mLayerDesc.x;
+        int32_t y = mLayerDesc.y;
+        int32_t w = mLayerDesc.width;
+        int32_t h = mLayerDesc.height;
+
+        if (shrink) {
+            t->setPosition(sc, x + w / 128, y + h / 128);
+            t->setMatrix(sc, float(w - w / 64) / float(w), 0.0f, 0.0f,
+                    float(h - h / 64) / float(h));
+        } else {
+            t->setPosition(sc, x, y);
+            t->setMatrix(sc, 1.0f, 0.0f, 0.0f, 1.0f);
+        }
+    }
+
     LayerDesc mLayerDesc;
 };
 
 Composer* nocomp() {
     class NoComp : public ComposerBase {
+        virtual bool setUpLayer(const sp<SurfaceControl>& sc,
+                SurfaceComposerClient::Transaction* t) {
+            t->hide(sc);
+            return true;
+        }
     };
     return new NoComp();
 }
@@ -158,6 +192,13 @@ Composer* opaque() {
             return mBlitter.blit(texName, texMatrix, x, y, w, h);
         }
 
+        virtual bool setUpLayer(const sp<SurfaceControl>& sc,
+                SurfaceComposerClient::Transaction* t) {
+            t->setFlags(sc, layer_state_t::eLayerOpaque,
+                    layer_state_t::eLayerOpaque);
+            return ComposerBase::setUpLayer(sc, t);
+        }
+
         Blitter mBlitter;
     };
     return new OpaqueComp();
@@ -190,6 +231,19 @@ Composer* opaqueShrink() {
             return mBlitter.blit(texName, texMatrix, x, y, w, h);
         }
 
+        virtual bool setUpLayer(const sp<SurfaceControl>& sc,
+                SurfaceComposerClient::Transaction* t) {
+            t->setFlags(sc, layer_state_t::eLayerOpaque,
+                    layer_state_t::eLayerOpaque);
+            return ComposerBase::setUpLayer(sc, t);
+        }
+
+        virtual void updateLayer(const sp<SurfaceControl>& sc,
+                SurfaceComposerClient::Transaction* t) {
+            mParity = !mParity;
+            shrinkLayer(mParity, sc, t);
+        }
+
         Blitter mBlitter;
         bool mParity;
     };
@@ -229,6 +283,12 @@ Composer* blend() {
             return true;
         }
 
+        virtual bool setUpLayer(const sp<SurfaceControl>& sc,
+                SurfaceComposerClient::Transaction* t) {
+            t->setAlpha(sc, .75f);
+            return ComposerBase::setUpLayer(sc, t);
+        }
+
         Blitter mBlitter;
     };
     return new BlendComp();
@@ -276,6 +336,18 @@ Composer* blendShrink() {
             return true;
         }
 
+        virtual bool setUpLayer(const sp<SurfaceControl>& sc,
+                SurfaceComposerClient::Transaction* t) {
+            t->setAlpha(sc, .75f);
+            return ComposerBase::setUpLayer(sc, t);
+        }
+
+        virtual void updateLayer(const sp<SurfaceControl>& sc,
+                SurfaceComposerClient::Transaction* t) {
+            mParity = !mParity;
+            shrinkLayer(mParity, sc, t);
+        }
+
         Blitter mBlitter;
         bool mParity;
     };
@@ -20,6 +20,10 @@
 #include <GLES2/gl2.h>
 
 #include <gui/GLConsumer.h>
+#include <gui/SurfaceComposerClient.h>
+
+#include <string>
+#include <vector>
 
 namespace android {
 
@@ -32,6 +36,18 @@ class Composer;
 class Renderer;
 class GLHelper;
 
+// How a layer is composed.
+enum Composition {
+    // By flatland's GL composition, or as chosen by SurfaceFlinger.
+    COMPOSITION_DEFAULT = 0,
+    // By the GPU. SurfaceFlinger is made to use client composition for the
+    // layer by rounding its corners.
+    COMPOSITION_CLIENT,
+    // By the display hardware. Flatland renders such layers without composing
+    // them, and leaves them to SurfaceFlinger otherwise.
+    COMPOSITION_DEVICE,
+};
+
 struct LayerDesc {
     uint32_t flags;
     Renderer* (*rendererFactory)();
@@ -40,8 +56,35 @@ struct LayerDesc {
     int32_t y;
     uint32_t width;
     uint32_t height;
+
+    // The pixel format of the layer, or 0 for PIXEL_FORMAT_RGBA_8888.
+    int32_t format;
+
+    // The layer is rendered every updateInterval frames, or every frame if 0.
+    uint32_t updateInterval;
+
+    Composition composition;
 };
 
+struct BenchmarkDesc {
+    // The name of the test.
+    std::string name;
+
+    // The dimensions of the space in which window layers are specified.
+    uint32_t width;
+    uint32_t height;
+
+    // The screen heights at which to run the test.
+    uint32_t runHeights[MAX_TEST_RUNS];
+
+    // The list of window layers.
+    LayerDesc layers[MAX_NUM_LAYERS];
+};
+
+// Loads the benchmarks described by a scenario file, whose format is described
+// in README.txt.
+bool loadBenchmarks(const char* path, std::vector<BenchmarkDesc>* outBenchmarks);
+
 void resetColorGenerator();
 
 class Composer {
@@ -50,6 +93,13 @@ public:
     virtual bool setUp(const LayerDesc& desc, GLHelper* helper) = 0;
     virtual void tearDown() = 0;
     virtual bool compose(GLuint texName, const sp<GLConsumer>& glc) = 0;
+
+    // Sets up the composition of the layer by SurfaceFlinger instead.
+    virtual bool setUpLayer(const sp<SurfaceControl>& sc,
+            SurfaceComposerClient::Transaction* t) = 0;
+    // Updates the composition of the layer by SurfaceFlinger for a frame.
+    virtual void updateLayer(const sp<SurfaceControl>& sc,
+            SurfaceComposerClient::Transaction* t) = 0;
 };
 
 Composer* nocomp();
@@ -67,5 +117,6 @@ public:
 };
 
 Renderer* staticGradient();
+Renderer* animatedGradient();
 
 } // namespace android
@@ -16,6 +16,7 @@
 
 #include "GLHelper.h"
 
+#include <EGL/eglext.h>
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
 #include <gui/SurfaceComposerClient.h>
@@ -28,6 +29,7 @@ GLHelper::GLHelper() :
     mContext(EGL_NO_CONTEXT),
     mDummySurface(EGL_NO_SURFACE),
     mConfig(0),
+    mAnyFormat(false),
     mShaderPrograms(nullptr),
     mDitherTexture(0) {
 }
@@ -35,7 +37,8 @@ GLHelper::GLHelper() :
 GLHelper::~GLHelper() {
 }
 
-bool GLHelper::setUp(const ShaderDesc* shaderDescs, size_t numShaders) {
+bool GLHelper::setUp(const ShaderDesc* shaderDescs, size_t numShaders,
+        bool anyFormat) {
     bool result;
 
     mDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
@@ -73,7 +76,19 @@ bool GLHelper::setUp(const ShaderDesc* shaderDescs, size_t numShaders) {
         EGL_CONTEXT_CLIENT_VERSION, 2,
         EGL_NONE
     };
-    mContext = eglCreateContext(mDisplay, mConfig, EGL_NO_CONTEXT,
+    if (anyFormat) {
+        const char* extensions = eglQueryString(mDisplay, EGL_EXTENSIONS);
+        if (extensions == nullptr ||
+                strstr(extensions, "EGL_KHR_no_config_context") == nullptr) {
+            fprintf(stderr, "EGL_KHR_no_config_context is required for "
+                    "formats other than RGBA_8888.\n");
+            return false;
+        }
+    }
+    mAnyFormat = anyFormat;
+
+    mContext = eglCreateContext(mDisplay,
+            mAnyFormat ? EGL_NO_CONFIG_KHR : mConfig, EGL_NO_CONTEXT,
             contextAttribs);
     if (mContext == EGL_NO_CONTEXT) {
         fprintf(stderr, "eglCreateContext error: %#x\n", eglGetError());
@@ -128,6 +143,7 @@ void GLHelper::tearDown() {
     mDummySurface = EGL_NO_SURFACE;
     mDummyGLConsumer.clear();
     mConfig = 0;
+    mAnyFormat = false;
 }
 
 bool GLHelper::makeCurrent(EGLSurface surface) {
@@ -149,7 +165,7 @@ bool GLHelper::makeCurrent(EGLSurface surface) {
 
 bool GLHelper::createSurfaceTexture(uint32_t w, uint32_t h,
         sp<GLConsumer>* glConsumer, EGLSurface* surface,
-        GLuint* name) {
+        GLuint* name, int32_t format) {
     if (!makeCurrent(mDummySurface)) {
         return false;
     }
@@ -161,7 +177,7 @@ bool GLHelper::createSurfaceTexture(uint32_t w, uint32_t h,
         return false;
     }
 
-    return createNamedSurfaceTexture(*name, w, h, glConsumer, surface);
+    return createNamedSurfaceTexture(*name, w, h, glConsumer, surface, format);
 }
 
 void GLHelper::destroySurface(EGLSurface* surface) {
@@ -198,18 +214,24 @@ bool GLHelper::getShaderProgram(const char* name, GLuint* outPgm) {
 }
 
 bool GLHelper::createNamedSurfaceTexture(GLuint name, uint32_t w, uint32_t h,
-        sp<GLConsumer>* glConsumer, EGLSurface* surface) {
+        sp<GLConsumer>* glConsumer, EGLSurface* surface, int32_t format) {
+    EGLConfig config;
+    if (!getConfig(format, &config)) {
+        return false;
+    }
+
     sp<IGraphicBufferProducer> producer;
     sp<IGraphicBufferConsumer> consumer;
     BufferQueue::createBufferQueue(&producer, &consumer);
     sp<GLConsumer> glc = new GLConsumer(consumer, name,
             GL_TEXTURE_EXTERNAL_OES, false, true);
     glc->setDefaultBufferSize(w, h);
+    glc->setDefaultBufferFormat(format);
     producer->setMaxDequeuedBufferCount(2);
     glc->setConsumerUsageBits(GRALLOC_USAGE_HW_COMPOSER);
 
     sp<ANativeWindow> anw = new Surface(producer);
-    EGLSurface s = eglCreateWindowSurface(mDisplay, mConfig, anw.get(), nullptr);
+    EGLSurface s = eglCreateWindowSurface(mDisplay, config, anw.get(), nullptr);
     if (s == EGL_NO_SURFACE) {
         fprintf(stderr, "eglCreateWindowSurface error: %#x\n", eglGetError());
         return false;
@@ -220,6 +242,90 @@ bool GLHelper::createNamedSurfaceTexture(GLuint name, uint32_t w, uint32_t h,
     return true;
 }
 
+bool GLHelper::getConfig(int32_t format, EGLConfig* outConfig) {
+    if (format == PIXEL_FORMAT_RGBA_8888) {
+        *outConfig = mConfig;
+        return true;
+    }
+
+    if (!mAnyFormat) {
+        fprintf(stderr, "GLHelper was not set up for format %d.\n", format);
+        return false;
+    }
+
+    EGLint red, green, blue, alpha;
+    bool isFloat = false;
+    switch (format) {
+        case PIXEL_FORMAT_RGBX_8888:
+            red = 8; green = 8; blue = 8; alpha = 0;
+            break;
+        case PIXEL_FORMAT_RGB_565:
+            red = 5; green = 6; blue = 5; alpha = 0;
+            break;
+        case PIXEL_FORMAT_RGBA_1010102:
+            red = 10; green = 10; blue = 10; alpha = 2;
+            break;
+        case PIXEL_FORMAT_RGBA_FP16:
+            red = 16; green = 16; blue = 16; alpha = 16;
+            isFloat = true;
+            break;
+        default:
+            fprintf(stderr, "unsupported format: %d\n", format);
+            return false;
+    }
+
+    EGLint configAttribs[] = {
+        EGL_SURFACE_TYPE, EGL_WINDOW_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+        EGL_RED_SIZE, red,
+        EGL_GREEN_SIZE, green,
+        EGL_BLUE_SIZE, blue,
+        EGL_ALPHA_SIZE, alpha,
+        // Only float configs are requested, so that the attribute isn't
+        // passed to drivers which don't support EGL_EXT_pixel_format_float.
+        isFloat ? EGL_COLOR_COMPONENT_TYPE_EXT : EGL_NONE,
+        EGL_COLOR_COMPONENT_TYPE_FLOAT_EXT,
+        EGL_NONE
+    };
+    const EGLint maxConfigs = 64;
+    EGLConfig configs[maxConfigs];
+    EGLint numConfigs = 0;
+    if (eglChooseConfig(mDisplay, configAttribs, configs, maxConfigs,
+            &numConfigs) != EGL_TRUE) {
+        fprintf(stderr, "eglChooseConfig error: %#x\n", eglGetError());
+        return false;
+    }
+
+    // eglChooseConfig sorts the deepest configs first, so look for the one
+    // which matches the format exactly.
+    for (EGLint i = 0; i < numConfigs; i++) {
+        EGLint r, g, b, a;
+        eglGetConfigAttrib(mDisplay, configs[i], EGL_RED_SIZE, &r);
+        eglGetConfigAttrib(mDisplay, configs[i], EGL_GREEN_SIZE, &g);
+        eglGetConfigAttrib(mDisplay, configs[i], EGL_BLUE_SIZE, &b);
+        eglGetConfigAttrib(mDisplay, configs[i], EGL_ALPHA_SIZE, &a);
+        if (r == red && g == green && b == blue && a == alpha) {
+            *outConfig = configs[i];
+            return true;
+        }
+    }
+
+    fprintf(stderr, "no EGL config for format %d\n", format);
+    return false;
+}
+
+bool GLHelper::setUpSurfaceComposerClient() {
+    if (mSurfaceComposerClient == nullptr) {
+        mSurfaceComposerClient = new SurfaceComposerClient;
+    }
+    status_t err = mSurfaceComposerClient->initCheck();
+    if (err != NO_ERROR) {
+        fprintf(stderr, "SurfaceComposerClient::initCheck error: %#x\n", err);
+        return false;
+    }
+    return true;
+}
+
 bool GLHelper::computeWindowScale(uint32_t w, uint32_t h, float* scale) {
     const sp<IBinder> dpy = mSurfaceComposerClient->getInternalDisplayToken();
     if (dpy == nullptr) {
@@ -244,14 +350,9 @@ bool GLHelper::computeWindowScale(uint32_t w, uint32_t h, float* scale) {
 bool GLHelper::createWindowSurface(uint32_t w, uint32_t h,
         sp<SurfaceControl>* surfaceControl, EGLSurface* surface) {
     bool result;
-    status_t err;
 
-    if (mSurfaceComposerClient == nullptr) {
-        mSurfaceComposerClient = new SurfaceComposerClient;
-    }
-    err = mSurfaceComposerClient->initCheck();
-    if (err != NO_ERROR) {
-        fprintf(stderr, "SurfaceComposerClient::initCheck error: %#x\n", err);
+    result = setUpSurfaceComposerClient();
+    if (!result) {
         return false;
     }
 
@@ -285,6 +386,35 @@ bool GLHelper::createWindowSurface(uint32_t w, uint32_t h,
     return true;
 }
 
+bool GLHelper::createLayerSurface(uint32_t w, uint32_t h, int32_t format,
+        sp<SurfaceControl>* surfaceControl, EGLSurface* surface) {
+    EGLConfig config;
+    if (!getConfig(format, &config) || !setUpSurfaceComposerClient()) {
+        return false;
+    }
+
+    sp<SurfaceControl> sc = mSurfaceComposerClient->createSurface(
+            String8("Flatland"), w, h, format, 0);
+    if (sc == nullptr || !sc->isValid()) {
+        fprintf(stderr, "Failed to create SurfaceControl.\n");
+        return false;
+    }
+
+    sp<Surface> s = sc->getSurface();
+    s->enableFrameTimestamps(true);
+
+    EGLSurface eglSurface = eglCreateWindowSurface(mDisplay, config, s.get(),
+            nullptr);
+    if (eglSurface == EGL_NO_SURFACE) {
+        fprintf(stderr, "eglCreateWindowSurface error: %#x\n", eglGetError());
+        return false;
+    }
+
+    *surfaceControl = sc;
+    *surface = eglSurface;
+    return true;
+}
+
 static bool compileShader(GLenum shaderType, const char* src,
         GLuint* outShader) {
     GLuint shader = glCreateShader(shaderType);
@@ -17,6 +17,7 @@
 #include <gui/GLConsumer.h>
 #include <gui/Surface.h>
 #include <gui/SurfaceControl.h>
+#include <ui/PixelFormat.h>
 
 #include <EGL/egl.h>
 #include <GLES2/gl2.h>
@@ -44,7 +45,11 @@ public:
 
     ~GLHelper();
 
-    bool setUp(const ShaderDesc* shaderDescs, size_t numShaders);
+    // If anyFormat is set, the context is created without a config so that
+    // surfaces of formats other than RGBA_8888 can be rendered to. That
+    // requires EGL_KHR_no_config_context.
+    bool setUp(const ShaderDesc* shaderDescs, size_t numShaders,
+            bool anyFormat = false);
 
     void tearDown();
 
@@ -52,11 +57,16 @@ public:
 
     bool createSurfaceTexture(uint32_t w, uint32_t h,
             sp<GLConsumer>* surfaceTexture, EGLSurface* surface,
-            GLuint* name);
+            GLuint* name, int32_t format = PIXEL_FORMAT_RGBA_8888);
 
     bool createWindowSurface(uint32_t w, uint32_t h,
             sp<SurfaceControl>* surfaceControl, EGLSurface* surface);
 
+    // Creates a hidden SurfaceFlinger layer of the given size and format, with
+    // frame timestamps enabled on its surface.
+    bool createLayerSurface(uint32_t w, uint32_t h, int32_t format,
+            sp<SurfaceControl>* surfaceControl, EGLSurface* surface);
+
     void destroySurface(EGLSurface* surface);
 
     bool swapBuffers(EGLSurface surface);
@@ -68,7 +78,12 @@ public:
 private:
 
     bool createNamedSurfaceTexture(GLuint name, uint32_t w, uint32_t h,
-            sp<GLConsumer>* surfaceTexture, EGLSurface* surface);
+            sp<GLConsumer>* surfaceTexture, EGLSurface* surface,
+            int32_t format = PIXEL_FORMAT_RGBA_8888);
+
+    bool getConfig(int32_t format, EGLConfig* outConfig);
+
+    bool setUpSurfaceComposerClient();
 
     bool computeWindowScale(uint32_t w, uint32_t h, float* scale);
 
@@ -79,6 +94,7 @@ private:
     EGLSurface mDummySurface;
     sp<GLConsumer> mDummyGLConsumer;
     EGLConfig mConfig;
+    bool mAnyFormat;
 
     sp<SurfaceComposerClient> mSurfaceComposerClient;
 
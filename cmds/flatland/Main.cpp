@@ -17,43 +17,45 @@
 #define ATRACE_TAG ATRACE_TAG_ALWAYS
 
 #include <gui/Surface.h>
+#include <gui/SurfaceComposerClient.h>
 #include <gui/SurfaceControl.h>
 #include <gui/GLConsumer.h>
 #include <gui/Surface.h>
 #include <ui/Fence.h>
+#include <utils/Timers.h>
 #include <utils/Trace.h>
 
 #include <EGL/egl.h>
 #include <GLES2/gl2.h>
 
+#include <inttypes.h>
 #include <math.h>
 #include <getopt.h>
 
+#include <algorithm>
+#include <deque>
+
 #include "Flatland.h"
 #include "GLHelper.h"
 
 using namespace ::android;
 
-static uint32_t g_SleepBetweenSamplesMs = 0;
-static bool     g_PresentToWindow       = false;
-static size_t   g_BenchmarkNameLen      = 0;
-
-struct BenchmarkDesc {
-    // The name of the test.
-    const char* name;
-
-    // The dimensions of the space in which window layers are specified.
-    uint32_t width;
-    uint32_t height;
+enum OutputFormat {
+    OUTPUT_TABLE,
+    OUTPUT_CSV,
+    OUTPUT_JSON,
+};
 
-    // The screen heights at which to run the test.
-    uint32_t runHeights[MAX_TEST_RUNS];
+static uint32_t     g_SleepBetweenSamplesMs = 0;
+static bool         g_PresentToWindow       = false;
+static size_t       g_BenchmarkNameLen      = 0;
+static bool         g_UseSurfaceFlinger     = false;
+static uint32_t     g_SurfaceFlingerFrames  = 300;
+static OutputFormat g_OutputFormat          = OUTPUT_TABLE;
 
-    // The list of window layers.
-    LayerDesc layers[MAX_NUM_LAYERS];
-};
+static std::vector<BenchmarkDesc> g_Benchmarks;
 
-static const BenchmarkDesc benchmarks[] = {
+static const BenchmarkDesc defaultBenchmarks[] = {
     { "16:10 Single Static Window",
         2560, 1600, { 800, 1200, 1600, 2400 },
         {
@@ -279,6 +281,45 @@ static const ShaderDesc shaders[] = {
     },
 };
 
+static size_t countLayers(const BenchmarkDesc& desc) {
+    size_t i;
+    for (i = 0; i < MAX_NUM_LAYERS; i++) {
+        if (desc.layers[i].rendererFactory == nullptr) {
+            break;
+        }
+    }
+    return i;
+}
+
+static int32_t layerFormat(const LayerDesc& desc) {
+    return desc.format != 0 ? desc.format : int32_t(PIXEL_FORMAT_RGBA_8888);
+}
+
+// Whether the layers of a benchmark have formats other than RGBA_8888.
+static bool hasOtherFormats(const BenchmarkDesc& desc) {
+    for (size_t i = 0; i < countLayers(desc); i++) {
+        if (layerFormat(desc.layers[i]) != PIXEL_FORMAT_RGBA_8888) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Whether a layer is rendered in the given frame.
+static bool isUpdateFrame(const LayerDesc& desc, uint32_t frame) {
+    return desc.updateInterval <= 1 || frame % desc.updateInterval == 0;
+}
+
+// Scales a layer specified for a benchmark to the screen size of a run.
+static LayerDesc scaleLayer(const LayerDesc& desc, float scaleFactor) {
+    LayerDesc ld = desc;
+    ld.x = int32_t(scaleFactor * float(ld.x));
+    ld.y = int32_t(scaleFactor * float(ld.y));
+    ld.width = uint32_t(scaleFactor * float(ld.width));
+    ld.height = uint32_t(scaleFactor * float(ld.height));
+    return ld;
+}
+
 class Layer {
 
 public:
@@ -295,7 +336,7 @@ public:
         mGLHelper = helper;
 
         result = mGLHelper->createSurfaceTexture(mDesc.width, mDesc.height,
-                &mGLConsumer, &mSurface, &mTexName);
+                &mGLConsumer, &mSurface, &mTexName, layerFormat(mDesc));
         if (!result) {
             return false;
         }
@@ -336,7 +377,10 @@ public:
         mGLConsumer.clear();
     }
 
-    bool render() {
+    bool render(uint32_t frame) {
+        if (!isUpdateFrame(mDesc, frame)) {
+            return true;
+        }
         return mRenderer->render(mSurface);
     }
 
@@ -353,6 +397,10 @@ public:
     }
 
     bool compose() {
+        if (mDesc.composition == COMPOSITION_DEVICE) {
+            // The layer would be composed by the display hardware.
+            return true;
+        }
         return mComposer->compose(mTexName, mGLConsumer);
     }
 
@@ -379,7 +427,8 @@ public:
         mNumLayers(countLayers(desc)),
         mGLHelper(nullptr),
         mSurface(EGL_NO_SURFACE),
-        mWindowSurface(EGL_NO_SURFACE) {
+        mWindowSurface(EGL_NO_SURFACE),
+        mFrame(0) {
     }
 
     bool setUp() {
@@ -393,7 +442,8 @@ public:
         uint32_t h = mDesc.runHeights[mInstance];
 
         mGLHelper = new GLHelper();
-        result = mGLHelper->setUp(shaders, NELEMS(shaders));
+        result = mGLHelper->setUp(shaders, NELEMS(shaders),
+                hasOtherFormats(mDesc));
         if (!result) {
             return false;
         }
@@ -407,11 +457,7 @@ public:
 
         for (size_t i = 0; i < mNumLayers; i++) {
             // Scale the layer to match the current screen size.
-            LayerDesc ld = mDesc.layers[i];
-            ld.x = int32_t(scaleFactor * float(ld.x));
-            ld.y = int32_t(scaleFactor * float(ld.y));
-            ld.width = uint32_t(scaleFactor * float(ld.width));
-            ld.height = uint32_t(scaleFactor * float(ld.height));
+            LayerDesc ld = scaleLayer(mDesc.layers[i], scaleFactor);
 
             // Set up the layer.
             result = mLayers[i].setUp(ld, mGLHelper);
@@ -508,11 +554,12 @@ private:
         status_t err;
 
         for (size_t i = 0; i < mNumLayers; i++) {
-            result = mLayers[i].render();
+            result = mLayers[i].render(mFrame);
             if (!result) {
                 return false;
             }
         }
+        mFrame++;
 
         for (size_t i = 0; i < mNumLayers; i++) {
             result = mLayers[i].prepareComposition();
@@ -550,16 +597,6 @@ private:
         return true;
     }
 
-    static size_t countLayers(const BenchmarkDesc& desc) {
-        size_t i;
-        for (i = 0; i < MAX_NUM_LAYERS; i++) {
-            if (desc.layers[i].rendererFactory == nullptr) {
-                break;
-            }
-        }
-        return i;
-    }
-
     const BenchmarkDesc& mDesc;
     const size_t mInstance;
     const size_t mNumLayers;
@@ -575,6 +612,289 @@ private:
     sp<SurfaceControl> mSurfaceControl;
 
     Layer mLayers[MAX_NUM_LAYERS];
+
+    // The number of frames done so far.
+    uint32_t mFrame;
+};
+
+// A layer which is composed by SurfaceFlinger rather than by flatland.
+class SurfaceLayer {
+
+public:
+
+    SurfaceLayer() :
+        mGLHelper(nullptr),
+        mSurface(EGL_NO_SURFACE),
+        mRenderer(nullptr),
+        mComposer(nullptr) {
+    }
+
+    bool setUp(const LayerDesc& desc, GLHelper* helper, int32_t z,
+            SurfaceComposerClient::Transaction* t) {
+        bool result;
+
+        mDesc = desc;
+        mGLHelper = helper;
+
+        result = mGLHelper->createLayerSurface(mDesc.width, mDesc.height,
+                layerFormat(mDesc), &mSurfaceControl, &mSurface);
+        if (!result) {
+            return false;
+        }
+
+        mRenderer = desc.rendererFactory();
+        result = mRenderer->setUp(helper);
+        if (!result) {
+            return false;
+        }
+
+        mComposer = desc.composerFactory();
+        result = mComposer->setUp(desc, helper);
+        if (!result) {
+            return false;
+        }
+
+        t->setLayer(mSurfaceControl, z).show(mSurfaceControl);
+        if (mDesc.composition == COMPOSITION_CLIENT) {
+            // SurfaceFlinger composes layers with rounded corners on the GPU.
+            t->setCornerRadius(mSurfaceControl, 1.0f);
+        }
+        return mComposer->setUpLayer(mSurfaceControl, t);
+    }
+
+    void tearDown() {
+        if (mComposer != nullptr) {
+            mComposer->tearDown();
+            delete mComposer;
+            mComposer = nullptr;
+        }
+
+        if (mRenderer != nullptr) {
+            mRenderer->tearDown();
+            delete mRenderer;
+            mRenderer = nullptr;
+        }
+
+        if (mSurface != EGL_NO_SURFACE) {
+            mGLHelper->destroySurface(&mSurface);
+        }
+        mGLHelper = nullptr;
+        mSurfaceControl.clear();
+    }
+
+    // Renders the layer if it is updated in the frame. outFrameNumber is set
+    // to the frame number of the buffer it queued, or 0 if it queued none.
+    bool render(uint32_t frame, uint64_t* outFrameNumber) {
+        *outFrameNumber = 0;
+        if (!isUpdateFrame(mDesc, frame)) {
+            return true;
+        }
+
+        sp<Surface> surface = mSurfaceControl->getSurface();
+        uint64_t frameNumber = surface->getNextFrameNumber();
+        if (!mRenderer->render(mSurface)) {
+            return false;
+        }
+        if (surface->getNextFrameNumber() != frameNumber) {
+            *outFrameNumber = frameNumber;
+        }
+        return true;
+    }
+
+    void update(SurfaceComposerClient::Transaction* t) {
+        mComposer->updateLayer(mSurfaceControl, t);
+    }
+
+    sp<Surface> getSurface() const {
+        return mSurfaceControl->getSurface();
+    }
+
+private:
+    LayerDesc mDesc;
+
+    GLHelper* mGLHelper;
+
+    sp<SurfaceControl> mSurfaceControl;
+    EGLSurface mSurface;
+
+    Renderer* mRenderer;
+    Composer* mComposer;
+};
+
+// The timestamps of a frame presented by SurfaceFlinger.
+struct PresentedFrame {
+    nsecs_t refreshStartTime;
+    nsecs_t gpuCompositionDoneTime;
+    nsecs_t presentTime;
+};
+
+// Runs a benchmark with layers composed by SurfaceFlinger, and times the
+// frames it presents with the frame timestamps of the layers.
+class SurfaceFlingerRunner {
+
+public:
+
+    SurfaceFlingerRunner(const BenchmarkDesc& desc, size_t instance) :
+        mDesc(desc),
+        mInstance(instance),
+        mNumLayers(countLayers(desc)),
+        mGLHelper(nullptr),
+        mFrame(0) {
+    }
+
+    bool setUp() {
+        ATRACE_CALL();
+
+        bool result;
+
+        float scaleFactor = float(mDesc.runHeights[mInstance]) /
+            float(mDesc.height);
+
+        mGLHelper = new GLHelper();
+        result = mGLHelper->setUp(shaders, NELEMS(shaders),
+                hasOtherFormats(mDesc));
+        if (!result) {
+            return false;
+        }
+
+        SurfaceComposerClient::Transaction t;
+        for (size_t i = 0; i < mNumLayers; i++) {
+            LayerDesc ld = scaleLayer(mDesc.layers[i], scaleFactor);
+
+            // Put the layers above everything else, in order.
+            int32_t z = INT32_MAX - MAX_NUM_LAYERS + int32_t(i);
+            result = mLayers[i].setUp(ld, mGLHelper, z, &t);
+            if (!result) {
+                return false;
+            }
+        }
+        t.apply(true);
+
+        return true;
+    }
+
+    void tearDown() {
+        ATRACE_CALL();
+
+        for (size_t i = 0; i < mNumLayers; i++) {
+            mLayers[i].tearDown();
+        }
+
+        if (mGLHelper != nullptr) {
+            mGLHelper->tearDown();
+            delete mGLHelper;
+            mGLHelper = nullptr;
+        }
+    }
+
+    // Runs the frames, and returns the timestamps of the timed frames which
+    // were presented. Frames in which no layer was updated aren't timed.
+    bool run(uint32_t warmUpFrames, uint32_t totalFrames,
+            std::vector<PresentedFrame>* outFrames) {
+        ATRACE_CALL();
+
+        resetColorGenerator();
+
+        std::deque<PendingFrame> pending;
+        for (uint32_t i = 0; i < totalFrames; i++) {
+            SurfaceComposerClient::Transaction t;
+            PendingFrame timed = {nullptr, 0};
+            for (size_t j = 0; j < mNumLayers; j++) {
+                uint64_t frameNumber;
+                if (!mLayers[j].render(mFrame, &frameNumber)) {
+                    return false;
+                }
+                if (timed.frameNumber == 0 && frameNumber != 0) {
+                    timed = {mLayers[j].getSurface(), frameNumber};
+                }
+                mLayers[j].update(&t);
+            }
+            t.apply();
+            mFrame++;
+
+            if (i >= warmUpFrames && timed.frameNumber != 0) {
+                pending.push_back(timed);
+            }
+
+            // The timestamps of only the last few frames are kept, so they are
+            // collected as the frames are presented.
+            if (!collectTimestamps(&pending, outFrames,
+                    pending.size() > MAX_PENDING_FRAMES)) {
+                return false;
+            }
+        }
+
+        while (!pending.empty()) {
+            if (!collectTimestamps(&pending, outFrames, true)) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+private:
+
+    // Fewer than the frames kept in a FrameEventHistory.
+    enum { MAX_PENDING_FRAMES = 4 };
+
+    struct PendingFrame {
+        sp<Surface> surface;
+        uint64_t frameNumber;
+    };
+
+    // Collects the timestamps of the oldest pending frames which were
+    // presented. If wait is set, waits for the oldest one to be presented.
+    static bool collectTimestamps(std::deque<PendingFrame>* pending,
+            std::vector<PresentedFrame>* outFrames, bool wait) {
+        const nsecs_t deadline = systemTime() + ms2ns(1000);
+        while (!pending->empty()) {
+            const PendingFrame& frame = pending->front();
+            PresentedFrame presented;
+            status_t err = frame.surface->getFrameTimestamps(frame.frameNumber,
+                    nullptr, nullptr, nullptr, nullptr,
+                    &presented.refreshStartTime,
+                    &presented.gpuCompositionDoneTime, &presented.presentTime,
+                    nullptr, nullptr);
+            if (err != NO_ERROR) {
+                // The frame is no longer in the history.
+                pending->pop_front();
+                continue;
+            }
+
+            if (presented.refreshStartTime == NATIVE_WINDOW_TIMESTAMP_PENDING ||
+                    presented.gpuCompositionDoneTime ==
+                            NATIVE_WINDOW_TIMESTAMP_PENDING ||
+                    presented.presentTime == NATIVE_WINDOW_TIMESTAMP_PENDING) {
+                if (!wait) {
+                    break;
+                }
+                if (systemTime() > deadline) {
+                    fprintf(stderr, "timed out waiting for frame %" PRIu64
+                            " to be presented\n", frame.frameNumber);
+                    return false;
+                }
+                usleep(1000);
+                continue;
+            }
+
+            outFrames->push_back(presented);
+            pending->pop_front();
+            wait = false;
+        }
+        return true;
+    }
+
+    const BenchmarkDesc& mDesc;
+    const size_t mInstance;
+    const size_t mNumLayers;
+
+    GLHelper* mGLHelper;
+
+    SurfaceLayer mLayers[MAX_NUM_LAYERS];
+
+    // The number of frames done so far.
+    uint32_t mFrame;
 };
 
 static int cmpDouble(const double* lhs, const double* rhs) {
@@ -586,18 +906,27 @@ static int cmpDouble(const double* lhs, const double* rhs) {
     return 0;
 }
 
-// Run a single benchmark and print the result.
-static bool runTest(const BenchmarkDesc b, size_t run) {
+struct BenchmarkResult {
+    // "ok" if the benchmark was measured, or the reason why it wasn't.
+    const char* status;
+
+    // The resulting time of a frame, in ms.
+    double frameTime;
+
+    // The frame times that were measured, in ms.
+    std::vector<double> frameTimes;
+
+    // The times SurfaceFlinger took to compose frames on the GPU, in ms.
+    std::vector<double> gpuTimes;
+};
+
+// Run a single benchmark by doing the composition with GL.
+static bool runGLTest(const BenchmarkDesc& b, size_t run,
+        BenchmarkResult* outResult) {
     bool success = true;
     double prevResult = 0.0, result = 0.0;
     Vector<double> samples;
 
-    uint32_t runHeight = b.runHeights[run];
-    uint32_t runWidth = b.width * runHeight / b.height;
-    printf(" %-*s | %4d x %4d | ", static_cast<int>(g_BenchmarkNameLen), b.name,
-            runWidth, runHeight);
-    fflush(stdout);
-
     BenchmarkRunner r(b, run);
     if (!r.setUp()) {
         fprintf(stderr, "error initializing runner.\n");
@@ -627,11 +956,11 @@ static bool runTest(const BenchmarkDesc b, size_t run) {
 
     if (totalFrames - warmUpFrames > 16) {
         // The test runs too fast to get a stable result.  Skip it.
-        printf("  fast");
+        outResult->status = "fast";
         goto done;
     } else if (totalFrames == 5 && runTime > 200e6) {
         // The test runs too slow to be very useful.  Skip it.
-        printf("  slow");
+        outResult->status = "slow";
         goto done;
     }
 
@@ -642,7 +971,7 @@ static bool runTest(const BenchmarkDesc b, size_t run) {
         }
 
         if (newSamples > 512) {
-            printf("varies");
+            outResult->status = "varies";
             goto done;
         }
 
@@ -668,17 +997,90 @@ static bool runTest(const BenchmarkDesc b, size_t run) {
         result = (samples[elem-1] + samples[elem]) * 0.5;
     } while (fabs(result - prevResult) > threshold * result);
 
-    printf("%6.3f", result / double(totalFrames - warmUpFrames) / 1e6);
+    outResult->status = "ok";
+    outResult->frameTime = result / double(totalFrames - warmUpFrames) / 1e6;
 
 done:
 
-    printf("\n");
-    fflush(stdout);
+    for (size_t i = 0; i < samples.size(); i++) {
+        outResult->frameTimes.push_back(
+                samples[i] / double(totalFrames - warmUpFrames) / 1e6);
+    }
     r.tearDown();
 
     return success;
 }
 
+// Run a single benchmark with the layers composed by SurfaceFlinger.
+static bool runSurfaceFlingerTest(const BenchmarkDesc& b, size_t run,
+        BenchmarkResult* outResult) {
+    const uint32_t warmUpFrames = 10;
+
+    SurfaceFlingerRunner r(b, run);
+    if (!r.setUp()) {
+        fprintf(stderr, "error initializing runner.\n");
+        r.tearDown();
+        return false;
+    }
+
+    std::vector<PresentedFrame> frames;
+    bool success = r.run(warmUpFrames, warmUpFrames + g_SurfaceFlingerFrames,
+            &frames);
+    r.tearDown();
+    if (!success) {
+        return false;
+    }
+
+    // The frame time is the time between the presentation of a frame and of
+    // the previous one.
+    nsecs_t prevPresentTime = -1;
+    for (const PresentedFrame& frame : frames) {
+        if (frame.presentTime < 0) {
+            continue;
+        }
+        if (prevPresentTime >= 0) {
+            outResult->frameTimes.push_back(
+                    double(frame.presentTime - prevPresentTime) / 1e6);
+        }
+        prevPresentTime = frame.presentTime;
+
+        if (frame.gpuCompositionDoneTime >= 0 && frame.refreshStartTime >= 0) {
+            outResult->gpuTimes.push_back(double(
+                    frame.gpuCompositionDoneTime - frame.refreshStartTime) / 1e6);
+        }
+    }
+
+    if (outResult->frameTimes.empty()) {
+        // No layer was updated, or no present times were reported.
+        outResult->status = "static";
+        return true;
+    }
+
+    std::vector<double> sorted = outResult->frameTimes;
+    std::sort(sorted.begin(), sorted.end());
+    outResult->status = "ok";
+    outResult->frameTime = sorted[sorted.size() / 2];
+    return true;
+}
+
+// Returns the p-th percentile of the values, with the nearest-rank method.
+static double percentile(std::vector<double> values, double p) {
+    std::sort(values.begin(), values.end());
+    size_t rank = size_t(ceil(p / 100.0 * double(values.size())));
+    return values[rank > 0 ? rank - 1 : 0];
+}
+
+static std::string escapeJson(const std::string& str) {
+    std::string escaped;
+    for (char c : str) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+        }
+        escaped += c;
+    }
+    return escaped;
+}
+
 static void printResultsTableHeader() {
     const char* scenario = "Scenario";
     size_t len = strlen(scenario);
@@ -689,27 +1091,147 @@ static void printResultsTableHeader() {
             "Scenario", static_cast<int>(rightPad), "");
 }
 
-// Run ALL the benchmarks!
-static bool runTests() {
-    printResultsTableHeader();
+static void printResultsHeader(int argc, char** argv) {
+    switch (g_OutputFormat) {
+        case OUTPUT_TABLE:
+            printf(" cmdline:");
+            for (int i = 0; i < argc; i++) {
+                printf(" %s", argv[i]);
+            }
+            printf("\n");
+            printResultsTableHeader();
+            break;
 
-    for (size_t i = 0; i < NELEMS(benchmarks); i++) {
-        const BenchmarkDesc& b = benchmarks[i];
-        for (size_t j = 0; j < MAX_TEST_RUNS && b.runHeights[j]; j++) {
-            if (!runTest(b, j)) {
-                return false;
+        case OUTPUT_CSV:
+            printf("scenario,width,height,status,time_ms,"
+                    "p50_ms,p90_ms,p99_ms,gpu_p50_ms,gpu_p90_ms,gpu_p99_ms,"
+                    "samples\n");
+            break;
+
+        case OUTPUT_JSON:
+            printf("{\n  \"cmdline\": \"");
+            for (int i = 0; i < argc; i++) {
+                printf("%s%s", i > 0 ? " " : "", escapeJson(argv[i]).c_str());
             }
+            printf("\",\n  \"compositor\": \"%s\",\n  \"results\": [",
+                    g_UseSurfaceFlinger ? "surfaceflinger" : "flatland");
+            break;
+    }
+    fflush(stdout);
+}
+
+static void printPercentiles(const char* name, const std::vector<double>& values) {
+    if (values.empty()) {
+        return;
+    }
+    switch (g_OutputFormat) {
+        case OUTPUT_TABLE:
+            break;
+
+        case OUTPUT_CSV:
+            printf(",%.3f,%.3f,%.3f", percentile(values, 50),
+                    percentile(values, 90), percentile(values, 99));
+            break;
+
+        case OUTPUT_JSON:
+            printf(",\n      \"%s\": { \"p50\": %.3f, \"p90\": %.3f, "
+                    "\"p99\": %.3f, \"samples\": %zu }", name,
+                    percentile(values, 50), percentile(values, 90),
+                    percentile(values, 99), values.size());
+            break;
+    }
+}
+
+static void printResult(const BenchmarkDesc& b, uint32_t width,
+        uint32_t height, const BenchmarkResult& result) {
+    static bool first = true;
+    bool ok = strcmp(result.status, "ok") == 0;
+
+    switch (g_OutputFormat) {
+        case OUTPUT_TABLE:
+            printf(" %-*s | %4d x %4d | ", static_cast<int>(g_BenchmarkNameLen),
+                    b.name.c_str(), width, height);
+            if (ok) {
+                printf("%6.3f\n", result.frameTime);
+            } else {
+                printf("%6s\n", result.status);
+            }
+            break;
+
+        case OUTPUT_CSV:
+            printf("\"%s\",%u,%u,%s,", b.name.c_str(), width, height,
+                    result.status);
+            if (ok) {
+                printf("%.3f", result.frameTime);
+            }
+            if (result.frameTimes.empty()) {
+                printf(",,,");
+            }
+            printPercentiles("frame_ms", result.frameTimes);
+            if (result.gpuTimes.empty()) {
+                printf(",,,");
+            }
+            printPercentiles("gpu_ms", result.gpuTimes);
+            printf(",%zu\n", result.frameTimes.size());
+            break;
+
+        case OUTPUT_JSON:
+            printf("%s\n    {\n      \"scenario\": \"%s\",\n"
+                    "      \"width\": %u,\n      \"height\": %u,\n"
+                    "      \"status\": \"%s\"", first ? "" : ",",
+                    escapeJson(b.name).c_str(), width, height, result.status);
+            if (ok) {
+                printf(",\n      \"time_ms\": %.3f", result.frameTime);
+            }
+            printPercentiles("frame_ms", result.frameTimes);
+            printPercentiles("gpu_ms", result.gpuTimes);
+            printf("\n    }");
+            break;
+    }
+    first = false;
+    fflush(stdout);
+}
+
+static void printResultsFooter() {
+    if (g_OutputFormat == OUTPUT_JSON) {
+        printf("\n  ]\n}\n");
+    }
+}
+
+// Run a single benchmark and print the result.
+static bool runTest(const BenchmarkDesc& b, size_t run) {
+    uint32_t runHeight = b.runHeights[run];
+    uint32_t runWidth = b.width * runHeight / b.height;
+
+    BenchmarkResult result = { "error", 0.0, {}, {} };
+    bool success = g_UseSurfaceFlinger ?
+            runSurfaceFlingerTest(b, run, &result) :
+            runGLTest(b, run, &result);
+    printResult(b, runWidth, runHeight, result);
+
+    return success;
+}
+
+// Run ALL the benchmarks!
+static bool runTests(int argc, char** argv) {
+    bool success = true;
+
+    printResultsHeader(argc, argv);
+    for (const BenchmarkDesc& b : g_Benchmarks) {
+        for (size_t j = 0; success && j < MAX_TEST_RUNS && b.runHeights[j]; j++) {
+            success = runTest(b, j);
         }
     }
-    return true;
+    printResultsFooter();
+
+    return success;
 }
 
 // Return the length longest benchmark name.
 static size_t maxBenchmarkNameLen() {
     size_t maxLen = 0;
-    for (size_t i = 0; i < NELEMS(benchmarks); i++) {
-        const BenchmarkDesc& b = benchmarks[i];
-        size_t len = strlen(b.name);
+    for (const BenchmarkDesc& b : g_Benchmarks) {
+        size_t len = b.name.size();
         if (len > maxLen) {
             maxLen = len;
         }
@@ -723,11 +1245,18 @@ static void showHelp(const char *cmd) {
     fprintf(stderr, "options include:\n"
                     "  -s N            sleep for N ms between samples\n"
                     "  -d              display the test frame to a window\n"
+                    "  -c FILE         run the scenarios of FILE instead of the\n"
+                    "                  built-in ones, see README.txt\n"
+                    "  -f              have SurfaceFlinger compose the layers\n"
+                    "  -n N            time N frames of each SurfaceFlinger run\n"
+                    "  -o FORMAT       print the results as a table, csv or json\n"
                     "  --help          print this helpful message and exit\n"
             );
 }
 
 int main(int argc, char** argv) {
+    const char* scenarioFile = nullptr;
+
     if (argc == 2 && 0 == strcmp(argv[1], "--help")) {
         showHelp(argv[0]);
         exit(0);
@@ -741,7 +1270,7 @@ int main(int argc, char** argv) {
             {     0,               0, 0,  0 }
         };
 
-        ret = getopt_long(argc, argv, "ds:",
+        ret = getopt_long(argc, argv, "ds:c:fn:o:",
                           long_options, &option_index);
 
         if (ret < 0) {
@@ -757,6 +1286,31 @@ int main(int argc, char** argv) {
                 g_SleepBetweenSamplesMs = atoi(optarg);
             break;
 
+            case 'c':
+                scenarioFile = optarg;
+            break;
+
+            case 'f':
+                g_UseSurfaceFlinger = true;
+            break;
+
+            case 'n':
+                g_SurfaceFlingerFrames = atoi(optarg);
+            break;
+
+            case 'o':
+                if (strcmp(optarg, "table") == 0) {
+                    g_OutputFormat = OUTPUT_TABLE;
+                } else if (strcmp(optarg, "csv") == 0) {
+                    g_OutputFormat = OUTPUT_CSV;
+                } else if (strcmp(optarg, "json") == 0) {
+                    g_OutputFormat = OUTPUT_JSON;
+                } else {
+                    showHelp(argv[0]);
+                    exit(2);
+                }
+            break;
+
             case 0:
                 if (strcmp(long_options[option_index].name, "help")) {
                     showHelp(argv[0]);
@@ -770,15 +1324,18 @@ int main(int argc, char** argv) {
         }
     }
 
-    g_BenchmarkNameLen = maxBenchmarkNameLen();
-
-    printf(" cmdline:");
-    for (int i = 0; i < argc; i++) {
-        printf(" %s", argv[i]);
+    if (scenarioFile != nullptr) {
+        if (!loadBenchmarks(scenarioFile, &g_Benchmarks)) {
+            return 1;
+        }
+    } else {
+        g_Benchmarks.assign(defaultBenchmarks,
+                defaultBenchmarks + NELEMS(defaultBenchmarks));
     }
-    printf("\n");
 
-    if (!runTests()) {
+    g_BenchmarkNameLen = maxBenchmarkNameLen();
+
+    if (!runTests(argc, argv)) {
         fprintf(stderr, "exiting due to error.\n");
         return 1;
     }
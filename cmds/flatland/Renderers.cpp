@@ -193,5 +193,38 @@ Renderer* staticGradient() {
     return new NoRenderer;
 }
 
+Renderer* animatedGradient() {
+    class GradientAnimator : public Renderer {
+        virtual bool setUp(GLHelper* helper) {
+            mGLHelper = helper;
+            return mGradientRenderer.setUp(helper);
+        }
+
+        virtual void tearDown() {
+            mGradientRenderer.tearDown();
+        }
+
+        virtual bool render(EGLSurface surface) {
+            bool result;
+
+            result = mGLHelper->makeCurrent(surface);
+            if (!result) {
+                return false;
+            }
+
+            result = mGradientRenderer.drawGradient();
+            if (!result) {
+                return false;
+            }
+
+            return mGLHelper->swapBuffers(surface);
+        }
+
+        GLHelper* mGLHelper;
+        GradientRenderer mGradientRenderer;
+    };
+    return new GradientAnimator;
+}
+
 
 } // namespace android
@@ -0,0 +1,212 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <ui/PixelFormat.h>
+
+#include <fstream>
+#include <sstream>
+
+#include "Flatland.h"
+
+namespace android {
+
+static const struct {
+    const char* name;
+    Renderer* (*factory)();
+} renderers[] = {
+    { "staticGradient", staticGradient },
+    { "animatedGradient", animatedGradient },
+};
+
+static const struct {
+    const char* name;
+    Composer* (*factory)();
+} composers[] = {
+    { "nocomp", nocomp },
+    { "opaque", opaque },
+    { "opaqueShrink", opaqueShrink },
+    { "blend", blend },
+    { "blendShrink", blendShrink },
+};
+
+static const struct {
+    const char* name;
+    int32_t format;
+} formats[] = {
+    { "rgba8888", PIXEL_FORMAT_RGBA_8888 },
+    { "rgbx8888", PIXEL_FORMAT_RGBX_8888 },
+    { "rgb565", PIXEL_FORMAT_RGB_565 },
+    { "rgba1010102", PIXEL_FORMAT_RGBA_1010102 },
+    { "rgbaFp16", PIXEL_FORMAT_RGBA_FP16 },
+};
+
+static const struct {
+    const char* name;
+    Composition composition;
+} compositions[] = {
+    { "default", COMPOSITION_DEFAULT },
+    { "client", COMPOSITION_CLIENT },
+    { "device", COMPOSITION_DEVICE },
+};
+
+// Returns the entry of one of the tables above with the given name, or nullptr.
+template <typename Entry, size_t N>
+static const Entry* findEntry(const Entry (&table)[N], const std::string& name) {
+    for (const Entry& entry : table) {
+        if (name == entry.name) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+static bool parseLayer(std::istringstream& in, LayerDesc* outLayer) {
+    std::string renderer, composer;
+    if (!(in >> renderer >> composer >> outLayer->x >> outLayer->y >>
+            outLayer->width >> outLayer->height)) {
+        fprintf(stderr, "expected: layer <renderer> <composer> <x> <y> <width> <height>\n");
+        return false;
+    }
+    auto rendererEntry = findEntry(renderers, renderer);
+    if (rendererEntry == nullptr) {
+        fprintf(stderr, "unknown renderer: %s\n", renderer.c_str());
+        return false;
+    }
+    outLayer->rendererFactory = rendererEntry->factory;
+    auto composerEntry = findEntry(composers, composer);
+    if (composerEntry == nullptr) {
+        fprintf(stderr, "unknown composer: %s\n", composer.c_str());
+        return false;
+    }
+    outLayer->composerFactory = composerEntry->factory;
+
+    // The remaining options are key=value pairs.
+    std::string option;
+    while (in >> option) {
+        size_t separator = option.find('=');
+        std::string key = option.substr(0, separator);
+        std::string value = separator == std::string::npos ? "" : option.substr(separator + 1);
+        if (key == "format") {
+            auto entry = findEntry(formats, value);
+            if (entry == nullptr) {
+                fprintf(stderr, "unknown format: %s\n", value.c_str());
+                return false;
+            }
+            outLayer->format = entry->format;
+        } else if (key == "interval") {
+            char* end;
+            outLayer->updateInterval = strtoul(value.c_str(), &end, 10);
+            if (value.empty() || *end != '\0') {
+                fprintf(stderr, "invalid interval: %s\n", value.c_str());
+                return false;
+            }
+        } else if (key == "composition") {
+            auto entry = findEntry(compositions, value);
+            if (entry == nullptr) {
+                fprintf(stderr, "unknown composition: %s\n", value.c_str());
+                return false;
+            }
+            outLayer->composition = entry->composition;
+        } else {
+            fprintf(stderr, "unknown layer option: %s\n", option.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+bool loadBenchmarks(const char* path, std::vector<BenchmarkDesc>* outBenchmarks) {
+    std::ifstream file(path);
+    if (!file) {
+        fprintf(stderr, "failed to open scenario file %s\n", path);
+        return false;
+    }
+
+    std::vector<BenchmarkDesc> benchmarks;
+    size_t numLayers = 0;
+    std::string line;
+    for (int lineNumber = 1; std::getline(file, line); lineNumber++) {
+        std::istringstream in(line);
+        std::string keyword;
+        if (!(in >> keyword) || keyword[0] == '#') {
+            continue;
+        }
+
+        bool result = true;
+        if (keyword == "scenario") {
+            BenchmarkDesc b = {};
+            result = static_cast<bool>(in >> b.width >> b.height);
+            std::getline(in >> std::ws, b.name);
+            if (!result || b.name.empty() || b.width == 0 || b.height == 0) {
+                fprintf(stderr, "expected: scenario <width> <height> <name>\n");
+                result = false;
+            }
+            b.runHeights[0] = b.height;
+            benchmarks.push_back(b);
+            numLayers = 0;
+        } else if (benchmarks.empty()) {
+            fprintf(stderr, "expected a scenario before %s\n", keyword.c_str());
+            result = false;
+        } else if (keyword == "heights") {
+            BenchmarkDesc& b = benchmarks.back();
+            size_t numHeights = 0;
+            uint32_t height;
+            while (result && in >> height) {
+                if (numHeights == MAX_TEST_RUNS || height == 0) {
+                    result = false;
+                } else {
+                    b.runHeights[numHeights++] = height;
+                }
+            }
+            if (!result || numHeights == 0 || !in.eof()) {
+                fprintf(stderr, "expected: heights <height> [<height> ...], with at most %d "
+                        "non-zero heights\n", MAX_TEST_RUNS);
+                result = false;
+            }
+        } else if (keyword == "layer") {
+            if (numLayers == MAX_NUM_LAYERS) {
+                fprintf(stderr, "more than %d layers\n", MAX_NUM_LAYERS);
+                result = false;
+            } else {
+                result = parseLayer(in, &benchmarks.back().layers[numLayers++]);
+            }
+        } else {
+            fprintf(stderr, "unknown keyword: %s\n", keyword.c_str());
+            result = false;
+        }
+
+        if (!result) {
+            fprintf(stderr, "%s:%d: invalid scenario\n", path, lineNumber);
+            return false;
+        }
+    }
+
+    for (const BenchmarkDesc& b : benchmarks) {
+        if (b.layers[0].rendererFactory == nullptr) {
+            fprintf(stderr, "%s: scenario \"%s\" has no layers\n", path, b.name.c_str());
+            return false;
+        }
+    }
+    if (benchmarks.empty()) {
+        fprintf(stderr, "%s: no scenarios\n", path);
+        return false;
+    }
+
+    *outBenchmarks = std::move(benchmarks);
+    return true;
+}
+
+} // namespace android
@@ -18,8 +18,10 @@
 
 #include "CacheTracker.h"
 
+#include <algorithm>
 #include <fts.h>
 #include <sys/xattr.h>
+#include <thread>
 #include <utils/Trace.h>
 
 #include <android-base/logging.h>
@@ -33,6 +35,20 @@ using android::base::StringPrintf;
 namespace android {
 namespace installd {
 
+// Orders items from the one to keep longest to the one to purge first
+static bool compareItems(const std::shared_ptr<CacheItem>& left,
+        const std::shared_ptr<CacheItem>& right) {
+    // TODO: sort dotfiles last
+    // TODO: sort code_cache last
+    if (left->modified != right->modified) {
+        return (left->modified > right->modified);
+    }
+    if (left->level != right->level) {
+        return (left->level < right->level);
+    }
+    return left->directory && !right->directory;
+}
+
 CacheTracker::CacheTracker(userid_t userId, appid_t appId, const std::string& uuid)
       : cacheUsed(0),
         cacheQuota(0),
@@ -57,10 +73,11 @@ void CacheTracker::addDataPath(const std::string& dataPath) {
 void CacheTracker::loadStats() {
     ATRACE_BEGIN("loadStats quota");
     cacheUsed = 0;
-    if (loadQuotaStats()) {
+    bool loaded = loadQuotaStats();
+    ATRACE_END();
+    if (loaded) {
         return;
     }
-    ATRACE_END();
 
     ATRACE_BEGIN("loadStats tree");
     cacheUsed = 0;
@@ -94,7 +111,8 @@ bool CacheTracker::loadQuotaStats() {
     }
 }
 
-void CacheTracker::loadItemsFrom(const std::string& path) {
+void CacheTracker::loadItemsFrom(const std::string& path,
+        std::vector<std::shared_ptr<CacheItem>>* items) {
     FTS *fts;
     FTSENT *p;
     char *argv[] = { (char*) path.c_str(), nullptr };
@@ -114,7 +132,7 @@ void CacheTracker::loadItemsFrom(const std::string& path) {
         case FTS_SLNONE: {
             auto item = std::shared_ptr<CacheItem>(new CacheItem(p));
             p->fts_pointer = static_cast<void*>(item.get());
-            items.push_back(item);
+            items->push_back(item);
         }
         }
 
@@ -165,28 +183,43 @@ void CacheTracker::loadItems() {
     items.clear();
 
     ATRACE_BEGIN("loadItems");
+    std::vector<std::string> paths;
     for (const auto& path : mDataPaths) {
-        loadItemsFrom(read_path_inode(path, "cache", kXattrInodeCache));
-        loadItemsFrom(read_path_inode(path, "code_cache", kXattrInodeCodeCache));
+        paths.push_back(read_path_inode(path, "cache", kXattrInodeCache));
+        paths.push_back(read_path_inode(path, "code_cache", kXattrInodeCodeCache));
+    }
+    // The trees are disjoint, so walk them at the same time
+    std::vector<std::vector<std::shared_ptr<CacheItem>>> loaded(paths.size());
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < paths.size(); i++) {
+        threads.emplace_back([&paths, &loaded, i]() { loadItemsFrom(paths[i], &loaded[i]); });
+    }
+    if (!paths.empty()) {
+        loadItemsFrom(paths[0], &loaded[0]);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (auto& pathItems : loaded) {
+        items.insert(items.end(), std::make_move_iterator(pathItems.begin()),
+                std::make_move_iterator(pathItems.end()));
     }
     ATRACE_END();
 
-    ATRACE_BEGIN("sortItems");
-    auto cmp = [](std::shared_ptr<CacheItem> left, std::shared_ptr<CacheItem> right) {
-        // TODO: sort dotfiles last
-        // TODO: sort code_cache last
-        if (left->modified != right->modified) {
-            return (left->modified > right->modified);
-        }
-        if (left->level != right->level) {
-            return (left->level < right->level);
-        }
-        return left->directory;
-    };
-    std::stable_sort(items.begin(), items.end(), cmp);
+    // Usually only a few items are purged before another tracker takes over,
+    // so a heap is cheaper than sorting everything up front
+    ATRACE_BEGIN("heapifyItems");
+    std::make_heap(items.begin(), items.end(), compareItems);
     ATRACE_END();
 }
 
+std::shared_ptr<CacheItem> CacheTracker::popItem() {
+    std::pop_heap(items.begin(), items.end(), compareItems);
+    auto item = std::move(items.back());
+    items.pop_back();
+    return item;
+}
+
 void CacheTracker::ensureItems() {
     if (mItemsLoaded) {
         return;
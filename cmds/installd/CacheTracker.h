@@ -50,12 +50,15 @@ public:
     void loadItems();
 
     void ensureItems();
+    /* Removes and returns the item to purge first; items must not be empty */
+    std::shared_ptr<CacheItem> popItem();
 
     int getCacheRatio();
 
     int64_t cacheUsed;
     int64_t cacheQuota;
 
+    /* Heap ordered so that the item to purge first is at the front; see popItem() */
     std::vector<std::shared_ptr<CacheItem>> items;
 
 private:
@@ -67,7 +70,8 @@ private:
     std::vector<std::string> mDataPaths;
 
     bool loadQuotaStats();
-    void loadItemsFrom(const std::string& path);
+    static void loadItemsFrom(const std::string& path,
+            std::vector<std::shared_ptr<CacheItem>>* items);
 
     DISALLOW_COPY_AND_ASSIGN(CacheTracker);
 };
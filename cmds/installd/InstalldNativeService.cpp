@@ -19,6 +19,7 @@
 #define ATRACE_TAG ATRACE_TAG_PACKAGE_MANAGER
 
 #include <algorithm>
+#include <atomic>
 #include <errno.h>
 #include <fstream>
 #include <fts.h>
@@ -38,6 +39,7 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <sys/xattr.h>
+#include <thread>
 #include <unistd.h>
 
 #include <android-base/file.h>
@@ -53,7 +55,7 @@
 #include <cutils/properties.h>
 #include <cutils/sched_policy.h>
 #include <log/log.h>               // TODO: Move everything to base/logging.
-#include <logwrap/logwrap.h>
+#include <openssl/sha.h>
 #include <private/android_filesystem_config.h>
 #include <private/android_projectid_config.h>
 #include <selinux/android.h>
@@ -88,7 +90,6 @@ static constexpr const char* kTestUuid = "TEST";
 
 static constexpr const mode_t kRollbackFolderMode = 0700;
 
-static constexpr const char* kCpPath = "/system/bin/cp";
 static constexpr const char* kXattrDefault = "user.default";
 
 static constexpr const char* kDataMirrorCePath = "/data_mirror/data_ce";
@@ -105,6 +106,10 @@ static constexpr const char* CODE_CACHE_DIR_POSTFIX = "/code_cache";
 static constexpr int kVerityPageSize = 4096;
 static constexpr size_t kSha256Size = 32;
 static constexpr const char* kPropApkVerityMode = "ro.apk_verity.mode";
+
+// How many dexopt() calls may compile at the same time. With the default of 1, dexopt() holds
+// mLock throughout, like every other call.
+static constexpr const char* kPropDexoptConcurrency = "dalvik.vm.dexopt-concurrency";
 static constexpr const char* kFuseProp = "persist.sys.fuse";
 
 /**
@@ -287,10 +292,31 @@ status_t InstalldNativeService::dump(int fd, const Vector<String16> & /* args */
         out << dump_permission.toString8() << endl;
         return PERMISSION_DENIED;
     }
+    // freeCache() holds mLock for as long as it runs, so report its progress before waiting
+    std::string freeCacheStats;
+    {
+        std::lock_guard<std::recursive_mutex> lock(mFreeCacheStatsLock);
+        const auto& stats = mFreeCacheStats;
+        if (stats.phase.empty()) {
+            freeCacheStats = "    none";
+        } else {
+            auto end = stats.running ? std::chrono::steady_clock::now() : stats.end;
+            int64_t elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    end - stats.start).count();
+            freeCacheStats = StringPrintf("    %s in phase %s after %" PRId64 " ms\n"
+                    "    target free %" PRId64 ", trackers %zu, purged %zu items, %" PRId64
+                    " bytes", stats.running ? "running" : "finished", stats.phase.c_str(),
+                    elapsedMs, stats.targetFreeBytes, stats.trackers, stats.itemsPurged,
+                    stats.bytesCleared);
+        }
+    }
+
     std::lock_guard<std::recursive_mutex> lock(mLock);
 
     out << "installd is happy!" << endl;
 
+    out << endl << "Last freeCache:" << endl << freeCacheStats << endl;
+
     {
         std::lock_guard<std::recursive_mutex> lock(mMountsLock);
         out << endl << "Storage mounts:" << endl;
@@ -427,22 +453,49 @@ binder::Status InstalldNativeService::createAppDataBatched(
         const std::vector<std::string>& seInfos, const std::vector<int32_t>& targetSdkVersions,
         int64_t* _aidl_return) {
     ENFORCE_UID(AID_SYSTEM);
+    for (size_t i = 0; i < uuids->size(); i++) {
+        if (!packageNames->at(i)) {
+            continue;
+        }
+        CHECK_ARGUMENT_UUID(uuids->at(i));
+        CHECK_ARGUMENT_PACKAGE_NAME(*packageNames->at(i));
+    }
     std::lock_guard<std::recursive_mutex> lock(mLock);
 
     ATRACE_BEGIN("createAppDataBatched");
-    binder::Status ret;
+    // Packages never share directories, so they are prepared in parallel while
+    // this thread holds mLock on behalf of all of them. A failing package no
+    // longer stops the rest of the batch.
+    std::vector<binder::Status> results(uuids->size());
+    std::vector<int64_t> inodes(uuids->size(), -1);
+    run_in_parallel(uuids->size(), [&](size_t i) {
+        if (!packageNames->at(i)) {
+            return;
+        }
+        results[i] = createAppDataLocked(uuids->at(i), *packageNames->at(i), userId, flags,
+                appIds[i], seInfos[i], targetSdkVersions[i], &inodes[i]);
+    });
+    ATRACE_END();
+
+    size_t failed = 0;
+    std::string errors;
     for (size_t i = 0; i < uuids->size(); i++) {
         if (!packageNames->at(i)) {
             continue;
         }
-        ret = createAppData(uuids->at(i), *packageNames->at(i), userId, flags, appIds[i],
-                seInfos[i], targetSdkVersions[i], _aidl_return);
-        if (!ret.isOk()) {
-            ATRACE_END();
-            return ret;
+        // Same as calling createAppData() in order: the last package wins.
+        if (_aidl_return != nullptr) *_aidl_return = inodes[i];
+        if (!results[i].isOk()) {
+            if (failed++ > 0) {
+                errors += "; ";
+            }
+            errors += results[i].exceptionMessage().string();
         }
     }
-    ATRACE_END();
+    if (failed > 0) {
+        return error(StringPrintf("Failed to create app data for %zu of %zu packages: %s",
+                failed, uuids->size(), errors.c_str()));
+    }
     return ok();
 }
 
@@ -454,6 +507,14 @@ binder::Status InstalldNativeService::createAppData(const std::unique_ptr<std::s
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
     std::lock_guard<std::recursive_mutex> lock(mLock);
 
+    return createAppDataLocked(uuid, packageName, userId, flags, appId, seInfo, targetSdkVersion,
+            _aidl_return);
+}
+
+binder::Status InstalldNativeService::createAppDataLocked(
+        const std::unique_ptr<std::string>& uuid, const std::string& packageName,
+        int32_t userId, int32_t flags, int32_t appId, const std::string& seInfo,
+        int32_t targetSdkVersion, int64_t* _aidl_return) {
     const char* uuid_ = uuid ? uuid->c_str() : nullptr;
     const char* pkgname = packageName.c_str();
 
@@ -883,22 +944,6 @@ binder::Status InstalldNativeService::fixupAppData(const std::unique_ptr<std::st
     return ok();
 }
 
-static int32_t copy_directory_recursive(const char* from, const char* to) {
-    char *argv[] = {
-        (char*) kCpPath,
-        (char*) "-F", /* delete any existing destination file first (--remove-destination) */
-        (char*) "-p", /* preserve timestamps, ownership, and permissions */
-        (char*) "-R", /* recurse into subdirectories (DEST must be a directory) */
-        (char*) "-P", /* Do not follow symlinks [default] */
-        (char*) "-d", /* don't dereference symlinks */
-        (char*) from,
-        (char*) to
-    };
-
-    LOG(DEBUG) << "Copying " << from << " to " << to;
-    return logwrap_fork_execvp(ARRAY_SIZE(argv), argv, nullptr, false, LOG_ALOG, false, nullptr);
-}
-
 binder::Status InstalldNativeService::snapshotAppData(
         const std::unique_ptr<std::string>& volumeUuid,
         const std::string& packageName, int32_t user, int32_t snapshotId,
@@ -1335,6 +1380,11 @@ binder::Status InstalldNativeService::destroyUserData(const std::unique_ptr<std:
     return res;
 }
 
+void InstalldNativeService::setFreeCachePhase(const char* phase) {
+    std::lock_guard<std::recursive_mutex> lock(mFreeCacheStatsLock);
+    mFreeCacheStats.phase = phase;
+}
+
 binder::Status InstalldNativeService::freeCache(const std::unique_ptr<std::string>& uuid,
         int64_t targetFreeBytes, int64_t cacheReservedBytes, int32_t flags) {
     ENFORCE_UID(AID_SYSTEM);
@@ -1360,11 +1410,25 @@ binder::Status InstalldNativeService::freeCache(const std::unique_ptr<std::strin
         return ok();
     }
 
+    {
+        std::lock_guard<std::recursive_mutex> lock(mFreeCacheStatsLock);
+        mFreeCacheStats = FreeCacheStats();
+        mFreeCacheStats.running = true;
+        mFreeCacheStats.start = std::chrono::steady_clock::now();
+        mFreeCacheStats.targetFreeBytes = targetFreeBytes;
+    }
+    auto done = android::base::make_scope_guard([this]() {
+        std::lock_guard<std::recursive_mutex> lock(mFreeCacheStatsLock);
+        mFreeCacheStats.running = false;
+        mFreeCacheStats.end = std::chrono::steady_clock::now();
+    });
+
     if (flags & FLAG_FREE_CACHE_V2) {
         // This new cache strategy fairly removes files from UIDs by deleting
         // files from the UIDs which are most over their allocated quota
 
         // 1. Create trackers for every known UID
+        setFreeCachePhase("create");
         ATRACE_BEGIN("create");
         std::unordered_map<uid_t, std::shared_ptr<CacheTracker>> trackers;
         for (auto user : get_known_users(uuid_)) {
@@ -1412,22 +1476,34 @@ binder::Status InstalldNativeService::freeCache(const std::unique_ptr<std::strin
         ATRACE_END();
 
         // 2. Populate tracker stats and insert into priority queue
+        setFreeCachePhase("populate");
+        {
+            std::lock_guard<std::recursive_mutex> lock(mFreeCacheStatsLock);
+            mFreeCacheStats.trackers = trackers.size();
+        }
         ATRACE_BEGIN("populate");
         int64_t cacheTotal = 0;
-        auto cmp = [](std::shared_ptr<CacheTracker> left, std::shared_ptr<CacheTracker> right) {
+        auto cmp = [](const std::shared_ptr<CacheTracker>& left,
+                const std::shared_ptr<CacheTracker>& right) {
             return (left->getCacheRatio() < right->getCacheRatio());
         };
+        std::vector<std::shared_ptr<CacheTracker>> loading;
+        for (const auto& it : trackers) {
+            loading.push_back(it.second);
+        }
+        // Without quota support every tracker walks its cache trees
+        run_in_parallel(loading.size(), [&loading](size_t i) { loading[i]->loadStats(); });
         std::priority_queue<std::shared_ptr<CacheTracker>,
                 std::vector<std::shared_ptr<CacheTracker>>, decltype(cmp)> queue(cmp);
-        for (const auto& it : trackers) {
-            it.second->loadStats();
-            queue.push(it.second);
-            cacheTotal += it.second->cacheUsed;
+        for (const auto& tracker : loading) {
+            queue.push(tracker);
+            cacheTotal += tracker->cacheUsed;
         }
         ATRACE_END();
 
         // 3. Bounce across the queue, freeing items from whichever tracker is
         // the most over their assigned quota
+        setFreeCachePhase("bounce");
         ATRACE_BEGIN("bounce");
         std::shared_ptr<CacheTracker> active;
         while (active || !queue.empty()) {
@@ -1465,8 +1541,7 @@ binder::Status InstalldNativeService::freeCache(const std::unique_ptr<std::strin
                 active = nullptr;
                 continue;
             } else {
-                auto item = active->items.back();
-                active->items.pop_back();
+                auto item = active->popItem();
 
                 LOG(DEBUG) << "Purging " << item->toString() << " from " << active->toString();
                 if (!noop) {
@@ -1475,6 +1550,10 @@ binder::Status InstalldNativeService::freeCache(const std::unique_ptr<std::strin
                 active->cacheUsed -= item->size;
                 needed -= item->size;
                 cleared += item->size;
+
+                std::lock_guard<std::recursive_mutex> lock(mFreeCacheStatsLock);
+                mFreeCacheStats.itemsPurged++;
+                mFreeCacheStats.bytesCleared = cleared;
             }
 
             // Verify that we're actually done before bailing, since sneaky
@@ -1705,6 +1784,28 @@ static void collectManualStatsForUser(const std::string& path, struct stats* sta
     closedir(d);
 }
 
+typedef std::function<void(struct stats* stats, struct stats* extStats)> measure_fn;
+
+// Runs measurements of unrelated trees in parallel. Each measurement fills in its own pair of
+// stats, which are summed into stats and extStats once all of them are done.
+static void runMeasurements(const std::vector<measure_fn>& measurements, struct stats* stats,
+        struct stats* extStats) {
+    std::vector<struct stats> results(measurements.size() * 2);
+    run_in_parallel(measurements.size(), [&](size_t i) {
+        measurements[i](&results[i * 2], &results[i * 2 + 1]);
+    });
+
+    auto add = [](struct stats* total, const struct stats& result) {
+        total->codeSize += result.codeSize;
+        total->dataSize += result.dataSize;
+        total->cacheSize += result.cacheSize;
+    };
+    for (size_t i = 0; i < measurements.size(); i++) {
+        add(stats, results[i * 2]);
+        add(extStats, results[i * 2 + 1]);
+    }
+}
+
 static void collectManualExternalStatsForUser(const std::string& path, struct stats* stats) {
     FTS *fts;
     FTSENT *p;
@@ -1786,70 +1887,82 @@ binder::Status InstalldNativeService::getAppSize(const std::unique_ptr<std::stri
         flags &= ~FLAG_USE_QUOTA;
     }
 
-    ATRACE_BEGIN("obb");
+    // The trees below don't overlap, so they are walked in parallel.
+    std::vector<measure_fn> measurements;
     for (const auto& packageName : packageNames) {
         auto obbCodePath = create_data_media_package_path(uuid_, userId,
                 "obb", packageName.c_str());
-        calculate_tree_size(obbCodePath, &extStats.codeSize);
+        measurements.push_back([obbCodePath](struct stats*, struct stats* extStats) {
+            ATRACE_NAME("obb");
+            calculate_tree_size(obbCodePath, &extStats->codeSize);
+        });
     }
-    ATRACE_END();
 
     if (flags & FLAG_USE_QUOTA && appId >= AID_APP_START) {
-        ATRACE_BEGIN("code");
+        int32_t sharedGid = multiuser_get_shared_gid(0, appId);
         for (const auto& codePath : codePaths) {
-            calculate_tree_size(codePath, &stats.codeSize, -1,
-                    multiuser_get_shared_gid(0, appId));
+            measurements.push_back([codePath, sharedGid](struct stats* stats, struct stats*) {
+                ATRACE_NAME("code");
+                calculate_tree_size(codePath, &stats->codeSize, -1, sharedGid);
+            });
         }
-        ATRACE_END();
+        runMeasurements(measurements, &stats, &extStats);
 
         ATRACE_BEGIN("quota");
         collectQuotaStats(uuidString, userId, appId, &stats, &extStats);
         ATRACE_END();
     } else {
-        ATRACE_BEGIN("code");
         for (const auto& codePath : codePaths) {
-            calculate_tree_size(codePath, &stats.codeSize);
+            measurements.push_back([codePath](struct stats* stats, struct stats*) {
+                ATRACE_NAME("code");
+                calculate_tree_size(codePath, &stats->codeSize);
+            });
         }
-        ATRACE_END();
 
         for (size_t i = 0; i < packageNames.size(); i++) {
             const char* pkgname = packageNames[i].c_str();
 
-            ATRACE_BEGIN("data");
             auto cePath = create_data_user_ce_package_path(uuid_, userId, pkgname, ceDataInodes[i]);
-            collectManualStats(cePath, &stats);
             auto dePath = create_data_user_de_package_path(uuid_, userId, pkgname);
-            collectManualStats(dePath, &stats);
-            ATRACE_END();
+            measurements.push_back([cePath, dePath](struct stats* stats, struct stats*) {
+                ATRACE_NAME("data");
+                collectManualStats(cePath, stats);
+                collectManualStats(dePath, stats);
+            });
 
             if (!uuid) {
-                ATRACE_BEGIN("profiles");
-                calculate_tree_size(
-                        create_primary_current_profile_package_dir_path(userId, pkgname),
-                        &stats.dataSize);
-                calculate_tree_size(
-                        create_primary_reference_profile_package_dir_path(pkgname),
-                        &stats.codeSize);
-                ATRACE_END();
+                auto curProfilePath = create_primary_current_profile_package_dir_path(userId,
+                        pkgname);
+                auto refProfilePath = create_primary_reference_profile_package_dir_path(pkgname);
+                measurements.push_back([curProfilePath, refProfilePath](struct stats* stats,
+                        struct stats*) {
+                    ATRACE_NAME("profiles");
+                    calculate_tree_size(curProfilePath, &stats->dataSize);
+                    calculate_tree_size(refProfilePath, &stats->codeSize);
+                });
             }
 
-            ATRACE_BEGIN("external");
             auto extPath = create_data_media_package_path(uuid_, userId, "data", pkgname);
-            collectManualStats(extPath, &extStats);
             auto mediaPath = create_data_media_package_path(uuid_, userId, "media", pkgname);
-            calculate_tree_size(mediaPath, &extStats.dataSize);
-            ATRACE_END();
+            measurements.push_back([extPath, mediaPath](struct stats*, struct stats* extStats) {
+                ATRACE_NAME("external");
+                collectManualStats(extPath, extStats);
+                calculate_tree_size(mediaPath, &extStats->dataSize);
+            });
         }
 
         if (!uuid) {
-            ATRACE_BEGIN("dalvik");
             int32_t sharedGid = multiuser_get_shared_gid(0, appId);
             if (sharedGid != -1) {
-                calculate_tree_size(create_data_dalvik_cache_path(), &stats.codeSize,
-                        sharedGid, -1);
+                measurements.push_back([sharedGid](struct stats* stats, struct stats*) {
+                    ATRACE_NAME("dalvik");
+                    calculate_tree_size(create_data_dalvik_cache_path(), &stats->codeSize,
+                            sharedGid, -1);
+                });
             }
-            ATRACE_END();
         }
+
+        runMeasurements(measurements, &stats, &extStats);
     }
 
     std::vector<int64_t> ret;
@@ -1872,6 +1985,7 @@ struct external_sizes {
     int64_t imageSize;
     int64_t totalSize; // excludes OBBs (Android/obb), but includes app data + cache
     int64_t obbSize;
+    int64_t appSize; // app data + cache (Android/data and Android/media)
 };
 
 #define PER_USER_RANGE 100000
@@ -1908,6 +2022,17 @@ static external_sizes getExternalSizesForUserWithQuota(const std::string& uuid,
         if ((space = GetOccupiedSpaceForGid(uuid, AID_MEDIA_OBB)) != -1) {
             sizes.obbSize = space;
         }
+
+        for (auto appId : appIds) {
+            if (appId >= AID_APP_START) {
+                if ((space = get_occupied_app_space_external(uuid, userId, appId)) != -1) {
+                    sizes.appSize += space;
+                }
+                if ((space = get_occupied_app_cache_space_external(uuid, userId, appId)) != -1) {
+                    sizes.appSize += space;
+                }
+            }
+        }
     } else {
         int64_t totalSize = 0;
         long defaultProjectId = getProjectIdForUser(userId, PROJECT_ID_EXT_DEFAULT);
@@ -1943,21 +2068,28 @@ static external_sizes getExternalSizesForUserWithQuota(const std::string& uuid,
                 // App data
                 uid_t uid = multiuser_get_uid(userId, appId);
                 long projectId = uid - AID_APP_START + PROJECT_ID_EXT_DATA_START;
-                totalAppDataSize += GetOccupiedSpaceForProjectId(uuid, projectId);
+                if ((space = GetOccupiedSpaceForProjectId(uuid, projectId)) != -1) {
+                    totalAppDataSize += space;
+                }
 
                 // App cache
                 long cacheProjectId = uid - AID_APP_START + PROJECT_ID_EXT_CACHE_START;
-                totalAppCacheSize += GetOccupiedSpaceForProjectId(uuid, cacheProjectId);
+                if ((space = GetOccupiedSpaceForProjectId(uuid, cacheProjectId)) != -1) {
+                    totalAppCacheSize += space;
+                }
 
                 // App OBBs
                 long obbProjectId = uid - AID_APP_START + PROJECT_ID_EXT_OBB_START;
-                totalAppObbSize += GetOccupiedSpaceForProjectId(uuid, obbProjectId);
+                if ((space = GetOccupiedSpaceForProjectId(uuid, obbProjectId)) != -1) {
+                    totalAppObbSize += space;
+                }
             }
         }
         // Total size should include app data + cache
         totalSize += totalAppDataSize;
         totalSize += totalAppCacheSize;
         sizes.totalSize = totalSize;
+        sizes.appSize = totalAppDataSize + totalAppCacheSize;
 
         // Only OBB is separate
         sizes.obbSize = totalAppObbSize;
@@ -2135,17 +2267,9 @@ binder::Status InstalldNativeService::getExternalSize(const std::unique_ptr<std:
         videoSize = sizes.videoSize;
         imageSize = sizes.imageSize;
         obbSize = sizes.obbSize;
-        ATRACE_END();
-
-        ATRACE_BEGIN("apps");
-        struct stats extStats;
-        memset(&extStats, 0, sizeof(extStats));
-        for (auto appId : appIds) {
-            if (appId >= AID_APP_START) {
-                collectQuotaStats(uuidString, userId, appId, nullptr, &extStats);
-            }
-        }
-        appSize = extStats.dataSize;
+        // Read from the same per-app quotas as totalSize, so there is no need to
+        // ask the kernel for them a second time.
+        appSize = sizes.appSize;
         ATRACE_END();
     } else {
         ATRACE_BEGIN("manual");
@@ -2383,6 +2507,25 @@ static const char* getCStr(const std::unique_ptr<std::string>& data,
         const char* default_value = nullptr) {
     return data == nullptr ? default_value : data->c_str();
 }
+InstalldNativeService::DexoptSlot::DexoptSlot(InstalldNativeService* service,
+        const std::string& packageName, size_t concurrency)
+        : mService(service), mPackageName(packageName) {
+    std::unique_lock<std::mutex> lock(mService->mDexoptLock);
+    auto& packages = mService->mDexoptPackages;
+    mService->mDexoptCondition.wait(lock, [&]() {
+        return packages.size() < concurrency && packages.count(mPackageName) == 0;
+    });
+    packages.insert(mPackageName);
+}
+
+InstalldNativeService::DexoptSlot::~DexoptSlot() {
+    {
+        std::lock_guard<std::mutex> lock(mService->mDexoptLock);
+        mService->mDexoptPackages.erase(mPackageName);
+    }
+    mService->mDexoptCondition.notify_all();
+}
+
 binder::Status InstalldNativeService::dexopt(const std::string& apkPath, int32_t uid,
         const std::unique_ptr<std::string>& packageName, const std::string& instructionSet,
         int32_t dexoptNeeded, const std::unique_ptr<std::string>& outputPath, int32_t dexFlags,
@@ -2400,7 +2543,15 @@ binder::Status InstalldNativeService::dexopt(const std::string& apkPath, int32_t
     }
     CHECK_ARGUMENT_PATH(outputPath);
     CHECK_ARGUMENT_PATH(dexMetadataPath);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    const char* pkgname = getCStr(packageName, "*");
+
+    // In concurrent mode mLock only covers the setup of the output directory. The compilation
+    // itself just excludes other dexopt() calls for the same package, and is bounded by the
+    // number of slots. Each dex2oat child still gets the usual thread count, cpu set and
+    // background priority from the dalvik.vm.*dex2oat* properties.
+    const size_t concurrency = android::base::GetUintProperty<size_t>(kPropDexoptConcurrency, 1);
+    std::unique_lock<std::recursive_mutex> lock(mLock);
+    std::unique_ptr<DexoptSlot> slot;
 
     const char* oat_dir = getCStr(outputPath);
     const char* instruction_set = instructionSet.c_str();
@@ -2409,8 +2560,12 @@ binder::Status InstalldNativeService::dexopt(const std::string& apkPath, int32_t
         oat_dir = nullptr;
     }
 
+    if (concurrency > 1) {
+        lock.unlock();
+        slot = std::make_unique<DexoptSlot>(this, pkgname, concurrency);
+    }
+
     const char* apk_path = apkPath.c_str();
-    const char* pkgname = getCStr(packageName, "*");
     const char* compiler_filter = compilerFilter.c_str();
     const char* volume_uuid = getCStr(uuid);
     const char* class_loader_context = getCStr(classLoaderContext);
@@ -2828,6 +2983,46 @@ binder::Status InstalldNativeService::hashSecondaryDexFile(
     return result ? ok() : error();
 }
 
+binder::Status InstalldNativeService::reconcileSecondaryDexFiles(
+        const std::vector<std::string>& dexPaths, const std::string& packageName, int32_t uid,
+        const std::vector<std::string>& isas, const std::unique_ptr<std::string>& volumeUuid,
+        int32_t storage_flag, std::vector<bool>* _aidl_return) {
+    ENFORCE_UID(AID_SYSTEM);
+    CHECK_ARGUMENT_UUID(volumeUuid);
+    CHECK_ARGUMENT_PACKAGE_NAME(packageName);
+    for (const auto& dexPath : dexPaths) {
+        CHECK_ARGUMENT_PATH(dexPath);
+    }
+    std::lock_guard<std::recursive_mutex> lock(mLock);
+
+    bool result = android::installd::reconcile_secondary_dex_files(
+            dexPaths, packageName, uid, isas, volumeUuid, storage_flag, _aidl_return);
+    return result ? ok() : error();
+}
+
+binder::Status InstalldNativeService::hashSecondaryDexFiles(
+        const std::vector<std::string>& dexPaths, const std::string& packageName, int32_t uid,
+        const std::unique_ptr<std::string>& volumeUuid, int32_t storageFlag,
+        std::vector<uint8_t>* _aidl_return) {
+    ENFORCE_UID(AID_SYSTEM);
+    CHECK_ARGUMENT_UUID(volumeUuid);
+    CHECK_ARGUMENT_PACKAGE_NAME(packageName);
+    for (const auto& dexPath : dexPaths) {
+        CHECK_ARGUMENT_PATH(dexPath);
+    }
+
+    // mLock is not taken here, see hashSecondaryDexFile.
+    std::vector<std::vector<uint8_t>> hashes;
+    bool result = android::installd::hash_secondary_dex_files(
+        dexPaths, packageName, uid, volumeUuid, storageFlag, &hashes);
+    _aidl_return->assign(dexPaths.size() * SHA256_DIGEST_LENGTH, 0);
+    for (size_t i = 0; i < hashes.size(); i++) {
+        std::copy(hashes[i].begin(), hashes[i].end(),
+                _aidl_return->begin() + i * SHA256_DIGEST_LENGTH);
+    }
+    return result ? ok() : error();
+}
+
 binder::Status InstalldNativeService::invalidateMounts() {
     ENFORCE_UID(AID_SYSTEM);
     std::lock_guard<std::recursive_mutex> lock(mMountsLock);
@@ -21,8 +21,13 @@
 #include <inttypes.h>
 #include <unistd.h>
 
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
 #include <vector>
 #include <unordered_map>
+#include <unordered_set>
 
 #include <android-base/macros.h>
 #include <binder/BinderService.h>
@@ -155,6 +160,14 @@ public:
     binder::Status reconcileSecondaryDexFile(const std::string& dexPath,
         const std::string& packageName, int32_t uid, const std::vector<std::string>& isa,
         const std::unique_ptr<std::string>& volumeUuid, int32_t storage_flag, bool* _aidl_return);
+    binder::Status reconcileSecondaryDexFiles(const std::vector<std::string>& dexPaths,
+            const std::string& packageName, int32_t uid, const std::vector<std::string>& isa,
+            const std::unique_ptr<std::string>& volumeUuid, int32_t storage_flag,
+            std::vector<bool>* _aidl_return);
+    binder::Status hashSecondaryDexFiles(const std::vector<std::string>& dexPaths,
+            const std::string& packageName, int32_t uid,
+            const std::unique_ptr<std::string>& volumeUuid, int32_t storageFlag,
+            std::vector<uint8_t>* _aidl_return);
     binder::Status hashSecondaryDexFile(const std::string& dexPath,
         const std::string& packageName, int32_t uid, const std::unique_ptr<std::string>& volumeUuid,
         int32_t storageFlag, std::vector<uint8_t>* _aidl_return);
@@ -184,7 +197,48 @@ private:
     /* Map from UID to cache quota size */
     std::unordered_map<uid_t, int64_t> mCacheQuotas;
 
+    /* Guards mFreeCacheStats, which dump() reads while freeCache() holds mLock */
+    std::recursive_mutex mFreeCacheStatsLock;
+
+    /* Progress of the running freeCache(), or the outcome of the last one */
+    struct FreeCacheStats {
+        bool running = false;
+        std::string phase;
+        std::chrono::steady_clock::time_point start;
+        std::chrono::steady_clock::time_point end;
+        int64_t targetFreeBytes = 0;
+        size_t trackers = 0;
+        size_t itemsPurged = 0;
+        int64_t bytesCleared = 0;
+    } mFreeCacheStats;
+
+    void setFreeCachePhase(const char* phase);
+
+    /* Packages being compiled by dexopt() calls that run without mLock */
+    std::mutex mDexoptLock;
+    std::condition_variable mDexoptCondition;
+    std::unordered_set<std::string> mDexoptPackages;
+
+    /* Waits for one of the concurrent dexopt slots, and for the package to be free */
+    class DexoptSlot {
+    public:
+        DexoptSlot(InstalldNativeService* service, const std::string& packageName,
+                size_t concurrency);
+        ~DexoptSlot();
+
+    private:
+        InstalldNativeService* mService;
+        std::string mPackageName;
+
+        DISALLOW_COPY_AND_ASSIGN(DexoptSlot);
+    };
+
     std::string findDataMediaPath(const std::unique_ptr<std::string>& uuid, userid_t userid);
+
+    /* Body of createAppData(); callers must have checked arguments and hold mLock */
+    binder::Status createAppDataLocked(const std::unique_ptr<std::string>& uuid,
+            const std::string& packageName, int32_t userId, int32_t flags, int32_t appId,
+            const std::string& seInfo, int32_t targetSdkVersion, int64_t* _aidl_return);
 };
 
 }  // namespace installd
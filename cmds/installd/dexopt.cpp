@@ -15,7 +15,9 @@
  */
 #define LOG_TAG "installd"
 
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
@@ -29,6 +31,10 @@
 #include <unistd.h>
 
 #include <iomanip>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <tuple>
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
@@ -894,6 +900,35 @@ class RunProfman : public ExecVHelper {
 
 
 
+// Identity and state of a set of profile files, as seen by fstat.
+typedef std::vector<std::tuple<dev_t, ino_t, off_t, int64_t>> ProfileSignature;
+
+static ProfileSignature get_profile_signature(const std::vector<unique_fd>& profiles_fd,
+        const unique_fd& reference_profile_fd) {
+    ProfileSignature signature;
+    auto add = [&signature](int fd) {
+        struct stat st;
+        if (fstat(fd, &st) == 0) {
+            signature.emplace_back(st.st_dev, st.st_ino, st.st_size,
+                    st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec);
+        } else {
+            // Never matches a recorded signature.
+            signature.emplace_back(0, 0, -1, -1);
+        }
+    };
+    for (const unique_fd& fd : profiles_fd) {
+        add(fd.get());
+    }
+    add(reference_profile_fd.get());
+    return signature;
+}
+
+// Profiles which profman last found not worth compiling for, keyed by location. They are left
+// in place in that case, so the next analysis would merge the very same data again unless some
+// profile has changed since.
+static std::mutex analyzed_profiles_lock;
+static std::map<std::string, ProfileSignature> analyzed_profiles;
+
 // Decides if profile guided compilation is needed or not based on existing profiles.
 // The location is the package name for primary apks or the dex path for secondary dex files.
 // Returns true if there is enough information in the current profiles that makes it
@@ -912,6 +947,17 @@ static bool analyze_profiles(uid_t uid, const std::string& package_name,
         return false;
     }
 
+    const std::string analyzed_key = package_name + (is_secondary_dex ? ":" : "/") + location;
+    ProfileSignature signature = get_profile_signature(profiles_fd, reference_profile_fd);
+    {
+        std::lock_guard<std::mutex> lock(analyzed_profiles_lock);
+        auto it = analyzed_profiles.find(analyzed_key);
+        if (it != analyzed_profiles.end() && it->second == signature) {
+            LOG(DEBUG) << "Profiles unchanged since the last analysis for location " << location;
+            return false;
+        }
+    }
+
     RunProfman profman_merge;
     const std::vector<unique_fd>& apk_fds = std::vector<unique_fd>();
     const std::vector<std::string>& dex_locations = std::vector<std::string>();
@@ -933,6 +979,7 @@ static bool analyze_profiles(uid_t uid, const std::string& package_name,
     bool need_to_compile = false;
     bool should_clear_current_profiles = false;
     bool should_clear_reference_profile = false;
+    bool should_remember_profiles = false;
     if (!WIFEXITED(return_code)) {
         LOG(WARNING) << "profman failed for location " << location << ": " << return_code;
     } else {
@@ -947,6 +994,7 @@ static bool analyze_profiles(uid_t uid, const std::string& package_name,
                 need_to_compile = false;
                 should_clear_current_profiles = false;
                 should_clear_reference_profile = false;
+                should_remember_profiles = true;
                 break;
             case PROFMAN_BIN_RETURN_CODE_BAD_PROFILES:
                 LOG(WARNING) << "Bad profiles for location " << location;
@@ -990,6 +1038,15 @@ static bool analyze_profiles(uid_t uid, const std::string& package_name,
     if (should_clear_reference_profile) {
         clear_reference_profile(package_name, location, is_secondary_dex);
     }
+
+    {
+        std::lock_guard<std::mutex> lock(analyzed_profiles_lock);
+        if (should_remember_profiles) {
+            analyzed_profiles[analyzed_key] = std::move(signature);
+        } else {
+            analyzed_profiles.erase(analyzed_key);
+        }
+    }
     return need_to_compile;
 }
 
@@ -2329,19 +2386,86 @@ enum ReconcileSecondaryDexResult {
     kReconcileSecondaryDexAccessIOError = 4,
 };
 
-// Reconcile the secondary dex 'dex_path' and its generated oat files.
-// Return true if all the parameters are valid and the secondary dex file was
+// Reconcile the secondary dex 'dex_path' and its generated oat files. Runs in the child forked
+// by reconcile_secondary_dex_files, with the capabilities of the app.
+static ReconcileSecondaryDexResult reconcile_secondary_dex_file_in_child(
+        const std::string& dex_path, const std::string& pkgname, int uid,
+        const std::vector<std::string>& isas, const char* volume_uuid_cstr, int storage_flag) {
+    if (!validate_secondary_dex_path(pkgname, dex_path, volume_uuid_cstr,
+            uid, storage_flag)) {
+        LOG(ERROR) << "Could not validate secondary dex path " << dex_path;
+        return kReconcileSecondaryDexValidationError;
+    }
+
+    SecondaryDexAccess access_check = check_secondary_dex_access(dex_path);
+    switch (access_check) {
+        case kSecondaryDexAccessDoesNotExist:
+             // File does not exist. Proceed with cleaning.
+            break;
+        case kSecondaryDexAccessReadOk: return kReconcileSecondaryDexExists;
+        case kSecondaryDexAccessIOError: return kReconcileSecondaryDexAccessIOError;
+        case kSecondaryDexAccessPermissionError: return kReconcileSecondaryDexValidationError;
+        default:
+            LOG(ERROR) << "Unexpected result from check_secondary_dex_access: " << access_check;
+            return kReconcileSecondaryDexValidationError;
+    }
+
+    // The secondary dex does not exist anymore or it's. Clear any generated files.
+    char oat_path[PKG_PATH_MAX];
+    char oat_dir[PKG_PATH_MAX];
+    char oat_isa_dir[PKG_PATH_MAX];
+    bool result = true;
+    for (size_t i = 0; i < isas.size(); i++) {
+        std::string error_msg;
+        if (!create_secondary_dex_oat_layout(
+                dex_path,isas[i], oat_dir, oat_isa_dir, oat_path, &error_msg)) {
+            LOG(ERROR) << error_msg;
+            return kReconcileSecondaryDexValidationError;
+        }
+
+        // Delete oat/vdex/art files.
+        result = unlink_if_exists(oat_path) && result;
+        result = unlink_if_exists(create_vdex_filename(oat_path)) && result;
+        result = unlink_if_exists(create_image_filename(oat_path)) && result;
+
+        // Delete profiles.
+        std::string current_profile = create_current_profile_path(
+            multiuser_get_user_id(uid), pkgname, dex_path, /*is_secondary*/true);
+        std::string reference_profile = create_reference_profile_path(
+            pkgname, dex_path, /*is_secondary*/true);
+        result = unlink_if_exists(current_profile) && result;
+        result = unlink_if_exists(reference_profile) && result;
+
+        // We upgraded once the location of current profile for secondary dex files.
+        // Check for any previous left-overs and remove them as well.
+        std::string old_current_profile = dex_path + ".prof";
+        result = unlink_if_exists(old_current_profile);
+
+        // Try removing the directories as well, they might be empty.
+        result = rmdir_if_empty(oat_isa_dir) && result;
+        result = rmdir_if_empty(oat_dir) && result;
+    }
+    if (!result) {
+        PLOG(ERROR) << "Failed to clean secondary dex artifacts for location " << dex_path;
+    }
+    return result ? kReconcileSecondaryDexCleanedUp : kReconcileSecondaryDexAccessIOError;
+}
+
+// Reconcile the secondary dex files 'dex_paths' and their generated oat files.
+// Return true if all the parameters are valid and every secondary dex file was
 //   processed successfully (i.e. the dex_path either exists, or if not, its corresponding
-//   oat/vdex/art files where deleted successfully). In this case, out_secondary_dex_exists
-//   will be true if the secondary dex file still exists. If the secondary dex file does not exist,
+//   oat/vdex/art files where deleted successfully). In this case, out_secondary_dex_exists[i]
+//   will be true if dex_paths[i] still exists. If a secondary dex file does not exist,
 //   the method cleans up any previously generated compiler artifacts (oat, vdex, art).
 // Return false if there were errors during processing. In this case
-//   out_secondary_dex_exists will be set to false.
-bool reconcile_secondary_dex_file(const std::string& dex_path,
+//   out_secondary_dex_exists is set to false for the files that failed.
+// All files are processed in a single child process.
+bool reconcile_secondary_dex_files(const std::vector<std::string>& dex_paths,
         const std::string& pkgname, int uid, const std::vector<std::string>& isas,
         const std::unique_ptr<std::string>& volume_uuid, int storage_flag,
-        /*out*/bool* out_secondary_dex_exists) {
-    *out_secondary_dex_exists = false;  // start by assuming the file does not exist.
+        /*out*/std::vector<bool>* out_secondary_dex_exists) {
+    // start by assuming the files do not exist.
+    out_secondary_dex_exists->assign(dex_paths.size(), false);
     if (isas.size() == 0) {
         LOG(ERROR) << "reconcile_secondary_dex_file called with empty isas vector";
         return false;
@@ -2353,117 +2477,149 @@ bool reconcile_secondary_dex_file(const std::string& dex_path,
         return false;
     }
 
+    if (dex_paths.empty()) {
+        return true;
+    }
+
+    // Pipe to get the result for each file back from our child process.
+    unique_fd pipe_read, pipe_write;
+    if (!Pipe(&pipe_read, &pipe_write)) {
+        PLOG(ERROR) << "Failed to create pipe";
+        return false;
+    }
+
     // As a security measure we want to unlink art artifacts with the reduced capabilities
     // of the package user id. So we fork and drop capabilities in the child.
     pid_t pid = fork();
     if (pid == 0) {
         /* child -- drop privileges before continuing */
         drop_capabilities(uid);
+        pipe_read.reset();
 
         const char* volume_uuid_cstr = volume_uuid == nullptr ? nullptr : volume_uuid->c_str();
-        if (!validate_secondary_dex_path(pkgname, dex_path, volume_uuid_cstr,
-                uid, storage_flag)) {
-            LOG(ERROR) << "Could not validate secondary dex path " << dex_path;
-            _exit(kReconcileSecondaryDexValidationError);
+        for (const std::string& dex_path : dex_paths) {
+            uint8_t code = reconcile_secondary_dex_file_in_child(
+                    dex_path, pkgname, uid, isas, volume_uuid_cstr, storage_flag);
+            if (!WriteFully(pipe_write, &code, sizeof(code))) {
+                _exit(kReconcileSecondaryDexAccessIOError);
+            }
         }
+        _exit(0);
+    }
+
+    // parent
+    pipe_write.reset();
+
+    std::vector<uint8_t> codes(dex_paths.size());
+    bool read = ReadFully(pipe_read, codes.data(), codes.size());
+    int return_code = wait_child(pid);
+    if (!read || return_code != 0) {
+        LOG(WARNING) << "reconcile dex failed for " << dex_paths.size() << " locations: "
+                << return_code;
+        return false;
+    }
 
-        SecondaryDexAccess access_check = check_secondary_dex_access(dex_path);
-        switch (access_check) {
-            case kSecondaryDexAccessDoesNotExist:
-                 // File does not exist. Proceed with cleaning.
+    bool result = true;
+    for (size_t i = 0; i < dex_paths.size(); i++) {
+        LOG(DEBUG) << "Reconcile secondary dex path " << dex_paths[i] << " result=" << +codes[i];
+
+        switch (codes[i]) {
+            case kReconcileSecondaryDexCleanedUp:
+            case kReconcileSecondaryDexValidationError:
+                // If we couldn't validate assume the dex file does not exist.
+                // This will purge the entry from the PM records.
+                (*out_secondary_dex_exists)[i] = false;
+                break;
+            case kReconcileSecondaryDexExists:
+                (*out_secondary_dex_exists)[i] = true;
+                break;
+            case kReconcileSecondaryDexAccessIOError:
+                // We had an access IO error.
+                // Return false so that we can try again.
+                // The value of out_secondary_dex_exists does not matter in this case and by
+                // convention is set to false.
+                (*out_secondary_dex_exists)[i] = false;
+                result = false;
                 break;
-            case kSecondaryDexAccessReadOk: _exit(kReconcileSecondaryDexExists);
-            case kSecondaryDexAccessIOError: _exit(kReconcileSecondaryDexAccessIOError);
-            case kSecondaryDexAccessPermissionError: _exit(kReconcileSecondaryDexValidationError);
             default:
-                LOG(ERROR) << "Unexpected result from check_secondary_dex_access: " << access_check;
-                _exit(kReconcileSecondaryDexValidationError);
-        }
-
-        // The secondary dex does not exist anymore or it's. Clear any generated files.
-        char oat_path[PKG_PATH_MAX];
-        char oat_dir[PKG_PATH_MAX];
-        char oat_isa_dir[PKG_PATH_MAX];
-        bool result = true;
-        for (size_t i = 0; i < isas.size(); i++) {
-            std::string error_msg;
-            if (!create_secondary_dex_oat_layout(
-                    dex_path,isas[i], oat_dir, oat_isa_dir, oat_path, &error_msg)) {
-                LOG(ERROR) << error_msg;
-                _exit(kReconcileSecondaryDexValidationError);
-            }
+                LOG(ERROR) << "Unexpected code from reconcile_secondary_dex_file: " << +codes[i];
+                (*out_secondary_dex_exists)[i] = false;
+                result = false;
+                break;
+        }
+    }
+    return result;
+}
 
-            // Delete oat/vdex/art files.
-            result = unlink_if_exists(oat_path) && result;
-            result = unlink_if_exists(create_vdex_filename(oat_path)) && result;
-            result = unlink_if_exists(create_image_filename(oat_path)) && result;
+// Reconcile the secondary dex 'dex_path' and its generated oat files.
+// Same as reconcile_secondary_dex_files for a single file.
+bool reconcile_secondary_dex_file(const std::string& dex_path,
+        const std::string& pkgname, int uid, const std::vector<std::string>& isas,
+        const std::unique_ptr<std::string>& volume_uuid, int storage_flag,
+        /*out*/bool* out_secondary_dex_exists) {
+    std::vector<bool> exists;
+    bool result = reconcile_secondary_dex_files({dex_path}, pkgname, uid, isas, volume_uuid,
+            storage_flag, &exists);
+    *out_secondary_dex_exists = result && exists[0];
+    return result;
+}
 
-            // Delete profiles.
-            std::string current_profile = create_current_profile_path(
-                multiuser_get_user_id(uid), pkgname, dex_path, /*is_secondary*/true);
-            std::string reference_profile = create_reference_profile_path(
-                pkgname, dex_path, /*is_secondary*/true);
-            result = unlink_if_exists(current_profile) && result;
-            result = unlink_if_exists(reference_profile) && result;
+// Number of threads the child forked by hash_secondary_dex_files hashes files on.
+static constexpr size_t kHashThreads = 4;
 
-            // We upgraded once the location of current profile for secondary dex files.
-            // Check for any previous left-overs and remove them as well.
-            std::string old_current_profile = dex_path + ".prof";
-            result = unlink_if_exists(old_current_profile);
+// Computes the hash of the secondary dex file at dex_path into out_hash. Runs in the child forked
+// by hash_secondary_dex_files, with the capabilities of the app. Returns 0 and sets out_exists
+// on success, or one of the DexoptReturnCodes otherwise.
+static int hash_secondary_dex_file_in_child(const std::string& dex_path,
+        const std::string& pkgname, int uid, const char* volume_uuid_cstr, int storage_flag,
+        bool* out_exists, uint8_t* out_hash) {
+    *out_exists = false;
+    if (!validate_secondary_dex_path(pkgname, dex_path, volume_uuid_cstr, uid, storage_flag)) {
+        LOG(ERROR) << "Could not validate secondary dex path " << dex_path;
+        return DexoptReturnCodes::kHashValidatePath;
+    }
 
-            // Try removing the directories as well, they might be empty.
-            result = rmdir_if_empty(oat_isa_dir) && result;
-            result = rmdir_if_empty(oat_dir) && result;
+    unique_fd fd(TEMP_FAILURE_RETRY(open(dex_path.c_str(), O_RDONLY | O_CLOEXEC | O_NOFOLLOW)));
+    if (fd == -1) {
+        if (errno == EACCES || errno == ENOENT) {
+            // Not treated as an error.
+            return 0;
         }
-        if (!result) {
-            PLOG(ERROR) << "Failed to clean secondary dex artifacts for location " << dex_path;
-        }
-        _exit(result ? kReconcileSecondaryDexCleanedUp : kReconcileSecondaryDexAccessIOError);
+        PLOG(ERROR) << "Failed to open secondary dex " << dex_path;
+        return DexoptReturnCodes::kHashOpenPath;
     }
 
-    int return_code = wait_child(pid);
-    if (!WIFEXITED(return_code)) {
-        LOG(WARNING) << "reconcile dex failed for location " << dex_path << ": " << return_code;
-    } else {
-        return_code = WEXITSTATUS(return_code);
-    }
+    SHA256_CTX ctx;
+    SHA256_Init(&ctx);
 
-    LOG(DEBUG) << "Reconcile secondary dex path " << dex_path << " result=" << return_code;
+    std::vector<uint8_t> buffer(65536);
+    while (true) {
+        ssize_t bytes_read = TEMP_FAILURE_RETRY(read(fd, buffer.data(), buffer.size()));
+        if (bytes_read == 0) {
+            break;
+        } else if (bytes_read == -1) {
+            PLOG(ERROR) << "Failed to read secondary dex " << dex_path;
+            return DexoptReturnCodes::kHashReadDex;
+        }
 
-    switch (return_code) {
-        case kReconcileSecondaryDexCleanedUp:
-        case kReconcileSecondaryDexValidationError:
-            // If we couldn't validate assume the dex file does not exist.
-            // This will purge the entry from the PM records.
-            *out_secondary_dex_exists = false;
-            return true;
-        case kReconcileSecondaryDexExists:
-            *out_secondary_dex_exists = true;
-            return true;
-        case kReconcileSecondaryDexAccessIOError:
-            // We had an access IO error.
-            // Return false so that we can try again.
-            // The value of out_secondary_dex_exists does not matter in this case and by convention
-            // is set to false.
-            *out_secondary_dex_exists = false;
-            return false;
-        default:
-            LOG(ERROR) << "Unexpected code from reconcile_secondary_dex_file: " << return_code;
-            *out_secondary_dex_exists = false;
-            return false;
+        SHA256_Update(&ctx, buffer.data(), bytes_read);
     }
+
+    SHA256_Final(out_hash, &ctx);
+    *out_exists = true;
+    return 0;
 }
 
-// Compute and return the hash (SHA-256) of the secondary dex file at dex_path.
-// Returns true if all parameters are valid and the hash successfully computed and stored in
-// out_secondary_dex_hash.
-// Also returns true with an empty hash if the file does not currently exist or is not accessible to
-// the app.
+// Compute and return the hashes (SHA-256) of the secondary dex files at dex_paths.
+// Returns true if all parameters are valid and the hashes successfully computed and stored in
+// out_secondary_dex_hashes, in the order of dex_paths.
+// The hash of a file that does not currently exist or is not accessible to the app is empty.
 // For any other errors (e.g. if any of the parameters are invalid) returns false.
-bool hash_secondary_dex_file(const std::string& dex_path, const std::string& pkgname, int uid,
-        const std::unique_ptr<std::string>& volume_uuid, int storage_flag,
-        std::vector<uint8_t>* out_secondary_dex_hash) {
-    out_secondary_dex_hash->clear();
+// All files are hashed in a single child process, on a few threads.
+bool hash_secondary_dex_files(const std::vector<std::string>& dex_paths,
+        const std::string& pkgname, int uid, const std::unique_ptr<std::string>& volume_uuid,
+        int storage_flag, std::vector<std::vector<uint8_t>>* out_secondary_dex_hashes) {
+    out_secondary_dex_hashes->assign(dex_paths.size(), std::vector<uint8_t>());
 
     const char* volume_uuid_cstr = volume_uuid == nullptr ? nullptr : volume_uuid->c_str();
 
@@ -2473,13 +2629,20 @@ bool hash_secondary_dex_file(const std::string& dex_path, const std::string& pkg
         return false;
     }
 
-    // Pipe to get the hash result back from our child process.
+    if (dex_paths.empty()) {
+        return true;
+    }
+
+    // Pipe to get the hash results back from our child process.
     unique_fd pipe_read, pipe_write;
     if (!Pipe(&pipe_read, &pipe_write)) {
         PLOG(ERROR) << "Failed to create pipe";
         return false;
     }
 
+    // Each file is reported as a byte telling whether it exists, followed by its hash.
+    constexpr size_t kRecordSize = 1 + SHA256_DIGEST_LENGTH;
+
     // Fork so that actual access to the files is done in the app's own UID, to ensure we only
     // access data the app itself can access.
     pid_t pid = fork();
@@ -2488,40 +2651,34 @@ bool hash_secondary_dex_file(const std::string& dex_path, const std::string& pkg
         drop_capabilities(uid);
         pipe_read.reset();
 
-        if (!validate_secondary_dex_path(pkgname, dex_path, volume_uuid_cstr, uid, storage_flag)) {
-            LOG(ERROR) << "Could not validate secondary dex path " << dex_path;
-            _exit(DexoptReturnCodes::kHashValidatePath);
-        }
-
-        unique_fd fd(TEMP_FAILURE_RETRY(open(dex_path.c_str(), O_RDONLY | O_CLOEXEC | O_NOFOLLOW)));
-        if (fd == -1) {
-            if (errno == EACCES || errno == ENOENT) {
-                // Not treated as an error.
-                _exit(0);
+        std::vector<uint8_t> records(dex_paths.size() * kRecordSize);
+        std::atomic<size_t> next(0);
+        std::atomic<int> error(0);
+        auto worker = [&]() {
+            for (size_t i = next++; i < dex_paths.size() && error == 0; i = next++) {
+                bool exists;
+                uint8_t* record = &records[i * kRecordSize];
+                int res = hash_secondary_dex_file_in_child(dex_paths[i], pkgname, uid,
+                        volume_uuid_cstr, storage_flag, &exists, record + 1);
+                if (res != 0) {
+                    error = res;
+                }
+                record[0] = exists;
             }
-            PLOG(ERROR) << "Failed to open secondary dex " << dex_path;
-            _exit(DexoptReturnCodes::kHashOpenPath);
+        };
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < std::min(dex_paths.size(), kHashThreads); i++) {
+            threads.emplace_back(worker);
         }
-
-        SHA256_CTX ctx;
-        SHA256_Init(&ctx);
-
-        std::vector<uint8_t> buffer(65536);
-        while (true) {
-            ssize_t bytes_read = TEMP_FAILURE_RETRY(read(fd, buffer.data(), buffer.size()));
-            if (bytes_read == 0) {
-                break;
-            } else if (bytes_read == -1) {
-                PLOG(ERROR) << "Failed to read secondary dex " << dex_path;
-                _exit(DexoptReturnCodes::kHashReadDex);
-            }
-
-            SHA256_Update(&ctx, buffer.data(), bytes_read);
+        worker();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        if (error != 0) {
+            _exit(error);
         }
 
-        std::array<uint8_t, SHA256_DIGEST_LENGTH> hash;
-        SHA256_Final(hash.data(), &ctx);
-        if (!WriteFully(pipe_write, hash.data(), hash.size())) {
+        if (!WriteFully(pipe_write, records.data(), records.size())) {
             _exit(DexoptReturnCodes::kHashWrite);
         }
 
@@ -2531,13 +2688,30 @@ bool hash_secondary_dex_file(const std::string& dex_path, const std::string& pkg
     // parent
     pipe_write.reset();
 
-    out_secondary_dex_hash->resize(SHA256_DIGEST_LENGTH);
-    if (!ReadFully(pipe_read, out_secondary_dex_hash->data(), out_secondary_dex_hash->size())) {
-        out_secondary_dex_hash->clear();
+    std::vector<uint8_t> records(dex_paths.size() * kRecordSize);
+    if (ReadFully(pipe_read, records.data(), records.size())) {
+        for (size_t i = 0; i < dex_paths.size(); i++) {
+            const uint8_t* record = &records[i * kRecordSize];
+            if (record[0]) {
+                (*out_secondary_dex_hashes)[i].assign(record + 1, record + kRecordSize);
+            }
+        }
     }
     return wait_child(pid) == 0;
 }
 
+// Compute and return the hash (SHA-256) of the secondary dex file at dex_path.
+// Same as hash_secondary_dex_files for a single file.
+bool hash_secondary_dex_file(const std::string& dex_path, const std::string& pkgname, int uid,
+        const std::unique_ptr<std::string>& volume_uuid, int storage_flag,
+        std::vector<uint8_t>* out_secondary_dex_hash) {
+    std::vector<std::vector<uint8_t>> hashes;
+    bool result = hash_secondary_dex_files({dex_path}, pkgname, uid, volume_uuid, storage_flag,
+            &hashes);
+    *out_secondary_dex_hash = std::move(hashes[0]);
+    return result;
+}
+
 // Helper for move_ab, so that we can have common failure-case cleanup.
 static bool unlink_and_rename(const char* from, const char* to) {
     // Check whether "from" exists, and if so whether it's regular. If it is, unlink. Otherwise,
@@ -339,8 +339,11 @@ private:
             }
         }
 
-        // Clear cached artifacts.
-        ClearDirectory(isa_path);
+        // Clear cached artifacts, unless other otapreopt processes of a batch may be writing
+        // theirs.
+        if (getenv(kOtapreoptKeepDalvikCacheEnv) == nullptr) {
+            ClearDirectory(isa_path);
+        }
 
         // Check whether we have a boot image.
         // TODO: check that the files are correct wrt/ jars.
@@ -15,16 +15,24 @@
  */
 
 #include <fcntl.h>
+#include <string.h>
 #include <linux/unistd.h>
 #include <sys/mount.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
 
+#include <chrono>
+#include <map>
+#include <set>
 #include <sstream>
 
+#include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/macros.h>
+#include <android-base/parseint.h>
 #include <android-base/stringprintf.h>
+#include <android-base/strings.h>
+#include <android-base/unique_fd.h>
 #include <libdm/dm.h>
 #include <selinux/android.h>
 
@@ -115,8 +123,103 @@ static void TryExtraMount(const char* name, const char* slot, const char* target
     UNUSED(mount_result);
 }
 
+// Runs otapreopt for each line of the batch file, which holds the parameters of one package per
+// line, with up to max_jobs packages at a time. The first package runs alone, as it clears the
+// dalvik-cache. The lines of the packages which were run are appended to a checkpoint file
+// beside the batch file, so that a batch which was interrupted resumes where it stopped.
+static bool RunBatch(const char* target_slot, const std::string& batch_file, size_t max_jobs) {
+    std::string batch;
+    if (!base::ReadFileToString(batch_file, &batch)) {
+        PLOG(ERROR) << "Failed to read batch file " << batch_file;
+        return false;
+    }
+    const std::string checkpoint_file = batch_file + ".done";
+    std::string checkpoint;
+    base::ReadFileToString(checkpoint_file, &checkpoint);
+    const std::vector<std::string> done_lines = base::Split(checkpoint, "\n");
+    const std::set<std::string> done(done_lines.begin(), done_lines.end());
+
+    base::unique_fd checkpoint_fd(open(checkpoint_file.c_str(),
+                                       O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0600));
+    if (checkpoint_fd < 0) {
+        PLOG(ERROR) << "Failed to open checkpoint file " << checkpoint_file;
+        return false;
+    }
+
+    std::vector<std::string> lines;
+    for (const std::string& line : base::Split(batch, "\n")) {
+        if (!line.empty() && done.count(line) == 0) {
+            lines.push_back(line);
+        }
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    std::map<pid_t, std::string> running;
+    size_t next = 0;
+    size_t failed = 0;
+    while (next < lines.size() || !running.empty()) {
+        const size_t jobs = next == 0 ? 1 : max_jobs;
+        while (running.size() < jobs && next < lines.size()) {
+            const std::string& line = lines[next];
+            std::vector<std::string> cmd = {"/system/bin/otapreopt", target_slot};
+            for (const std::string& param : base::Split(line, " ")) {
+                if (!param.empty()) {
+                    cmd.push_back(param);
+                }
+            }
+            std::vector<std::string> env;
+            if (next > 0) {
+                env.push_back(StringPrintf("%s=1", kOtapreoptKeepDalvikCacheEnv));
+            }
+            next++;
+
+            std::string error_msg;
+            pid_t pid = ExecAsync(cmd, env, &error_msg);
+            if (pid < 0) {
+                LOG(ERROR) << "Running otapreopt failed: " << error_msg;
+                failed++;
+                continue;
+            }
+            running.emplace(pid, line);
+        }
+        if (running.empty()) {
+            continue;
+        }
+
+        int status;
+        pid_t pid = TEMP_FAILURE_RETRY(waitpid(-1, &status, 0));
+        if (pid < 0) {
+            PLOG(ERROR) << "Failed to wait for otapreopt";
+            return false;
+        }
+        auto it = running.find(pid);
+        if (it == running.end()) {
+            continue;
+        }
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            LOG(ERROR) << "Running otapreopt failed for " << it->second;
+            failed++;
+        }
+        // Failures aren't retried, like when otapreopt is run one package at a time.
+        if (!base::WriteStringToFd(it->second + "\n", checkpoint_fd) ||
+            fsync(checkpoint_fd) != 0) {
+            PLOG(ERROR) << "Failed to write checkpoint file " << checkpoint_file;
+        }
+        running.erase(it);
+    }
+
+    const auto elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start).count();
+    LOG(INFO) << "Ran otapreopt for " << lines.size() << " packages ("
+              << done.size() - done.count("") << " done before, " << failed
+              << " failed) with up to " << max_jobs << " jobs in " << elapsed_ms << " ms";
+    return true;
+}
+
 // Entry for otapreopt_chroot. Expected parameters are:
 //   [cmd] [status-fd] [target-slot] "dexopt" [dexopt-params]
+// or, to run the packages of a batch file in parallel (see RunBatch):
+//   [cmd] [status-fd] [target-slot] "--batch" [batch-file] [max-jobs]
 // The file descriptor denoted by status-fd will be closed. The rest of the parameters will
 // be passed on to otapreopt in the chroot.
 static int otapreopt_chroot(const int argc, char **arg) {
@@ -254,6 +357,22 @@ static int otapreopt_chroot(const int argc, char **arg) {
 
     // Now go on and run otapreopt.
 
+    if (argc >= 4 && strcmp(arg[3], "--batch") == 0) {
+        size_t max_jobs;
+        bool batch_result = argc == 6 && base::ParseUint(arg[5], &max_jobs) && max_jobs > 0 &&
+                RunBatch(arg[2], arg[4], max_jobs);
+        if (!batch_result) {
+            LOG(ERROR) << "Running otapreopt batch failed";
+        }
+
+        DeactivateApexPackages(active_packages);
+
+        if (!batch_result) {
+            exit(213);
+        }
+        return 0;
+    }
+
     // Incoming:  cmd + status-fd + target-slot + cmd...      | Incoming | = argc
     // Outgoing:  cmd             + target-slot + cmd...      | Outgoing | = argc - 1
     std::vector<std::string> cmd;
@@ -50,6 +50,16 @@ else
 fi
 
 
+# Packages are compiled in batches, with several otapreopt processes at a time. dex2oat is
+# multi-threaded itself, so use half of the cores by default.
+BATCH_FILE="/data/ota/otapreopt_batch"
+CORES=$(nproc)
+MAX_JOBS=$(getprop ro.otapreopt.max_jobs $((CORES/2)))
+if ((MAX_JOBS<1)) ; then
+  MAX_JOBS=1
+fi
+BATCH_SIZE=$((MAX_JOBS*4))
+
 PREPARE=$(cmd otadexopt prepare)
 # Note: Ignore preparation failures. Step and done will fail and exit this.
 #       This is necessary to support suspends - the OTA service will keep
@@ -60,9 +70,29 @@ print -u${STATUS_FD} "global_progress $PROGRESS"
 
 i=0
 while ((i<MAXIMUM_PACKAGES)) ; do
-  DEXOPT_PARAMS=$(cmd otadexopt next)
+  # A batch left over by an interrupted run is resumed first. otapreopt_chroot skips the
+  # packages it lists in the checkpoint file.
+  if [ ! -s "$BATCH_FILE" ] ; then
+    rm -f "$BATCH_FILE.done"
+    j=0
+    while ((j<BATCH_SIZE)) ; do
+      DONE=$(cmd otadexopt done)
+      if [ "$DONE" != "OTA incomplete." ] ; then
+        break
+      fi
+      echo "$(cmd otadexopt next)" >> "$BATCH_FILE"
+      j=$((j+1))
+    done
+    i=$((i+j))
+  fi
 
-  /system/bin/otapreopt_chroot $STATUS_FD $TARGET_SLOT_SUFFIX $DEXOPT_PARAMS >&- 2>&-
+  if [ -s "$BATCH_FILE" ] ; then
+    START=$(date +%s)
+    /system/bin/otapreopt_chroot $STATUS_FD $TARGET_SLOT_SUFFIX --batch $BATCH_FILE $MAX_JOBS >&- 2>&-
+    COUNT=$(wc -l < "$BATCH_FILE")
+    echo "Compiled $COUNT packages in $(($(date +%s)-START)) s with up to $MAX_JOBS jobs."
+  fi
+  rm -f "$BATCH_FILE" "$BATCH_FILE.done"
 
   PROGRESS=$(cmd otadexopt progress)
   print -u${STATUS_FD} "global_progress $PROGRESS"
@@ -70,7 +100,6 @@ while ((i<MAXIMUM_PACKAGES)) ; do
   DONE=$(cmd otadexopt done)
   if [ "$DONE" = "OTA incomplete." ] ; then
     sleep 1
-    i=$((i+1))
     continue
   fi
   break
@@ -30,7 +30,8 @@ using android::base::StringPrintf;
 namespace android {
 namespace installd {
 
-bool Exec(const std::vector<std::string>& arg_vector, std::string* error_msg) {
+pid_t ExecAsync(const std::vector<std::string>& arg_vector,
+                const std::vector<std::string>& extra_env, std::string* error_msg) {
     const std::string command_line = Join(arg_vector, ' ');
 
     CHECK_GE(arg_vector.size(), 1U) << command_line;
@@ -46,6 +47,16 @@ bool Exec(const std::vector<std::string>& arg_vector, std::string* error_msg) {
     }
     args.push_back(nullptr);
 
+    // Same for the environment, the extra variables last.
+    std::vector<char*> env;
+    for (char** var = environ; *var != nullptr; ++var) {
+        env.push_back(*var);
+    }
+    for (const std::string& var : extra_env) {
+        env.push_back(const_cast<char*>(var.c_str()));
+    }
+    env.push_back(nullptr);
+
     // Fork and exec.
     pid_t pid = fork();
     if (pid == 0) {
@@ -54,32 +65,40 @@ bool Exec(const std::vector<std::string>& arg_vector, std::string* error_msg) {
         // Change process groups, so we don't get reaped by ProcessManager.
         setpgid(0, 0);
 
-        execv(program, &args[0]);
+        execve(program, &args[0], &env[0]);
 
         PLOG(ERROR) << "Failed to execv(" << command_line << ")";
         // _exit to avoid atexit handlers in child.
         _exit(1);
-    } else {
-        if (pid == -1) {
-            *error_msg = StringPrintf("Failed to execv(%s) because fork failed: %s",
-                    command_line.c_str(), strerror(errno));
-            return false;
-        }
-
-        // wait for subprocess to finish
-        int status;
-        pid_t got_pid = TEMP_FAILURE_RETRY(waitpid(pid, &status, 0));
-        if (got_pid != pid) {
-            *error_msg = StringPrintf("Failed after fork for execv(%s) because waitpid failed: "
-                    "wanted %d, got %d: %s",
-                    command_line.c_str(), pid, got_pid, strerror(errno));
-            return false;
-        }
-        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
-            *error_msg = StringPrintf("Failed execv(%s) because non-0 exit status",
-                    command_line.c_str());
-            return false;
-        }
+    }
+    if (pid == -1) {
+        *error_msg = StringPrintf("Failed to execv(%s) because fork failed: %s",
+                command_line.c_str(), strerror(errno));
+    }
+    return pid;
+}
+
+bool Exec(const std::vector<std::string>& arg_vector, std::string* error_msg) {
+    const std::string command_line = Join(arg_vector, ' ');
+
+    pid_t pid = ExecAsync(arg_vector, {}, error_msg);
+    if (pid == -1) {
+        return false;
+    }
+
+    // wait for subprocess to finish
+    int status;
+    pid_t got_pid = TEMP_FAILURE_RETRY(waitpid(pid, &status, 0));
+    if (got_pid != pid) {
+        *error_msg = StringPrintf("Failed after fork for execv(%s) because waitpid failed: "
+                "wanted %d, got %d: %s",
+                command_line.c_str(), pid, got_pid, strerror(errno));
+        return false;
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        *error_msg = StringPrintf("Failed execv(%s) because non-0 exit status",
+                command_line.c_str());
+        return false;
     }
     return true;
 }
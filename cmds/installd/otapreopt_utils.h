@@ -17,6 +17,8 @@
 #ifndef OTAPREOPT_UTILS_H_
 #define OTAPREOPT_UTILS_H_
 
+#include <sys/types.h>
+
 #include <regex>
 #include <string>
 #include <vector>
@@ -30,9 +32,19 @@ static inline bool ValidateTargetSlotSuffix(const std::string& input) {
     return std::regex_match(input, slot_suffix_match, slot_suffix_regex);
 }
 
+// Set in the environment of the otapreopt processes of a batch which run alongside others, so
+// that they don't clear the dalvik-cache the others are writing to. The first process of the
+// batch runs alone and clears it.
+static constexpr const char* kOtapreoptKeepDalvikCacheEnv = "OTAPREOPT_KEEP_DALVIK_CACHE";
+
 // Wrapper on fork/execv to run a command in a subprocess.
 bool Exec(const std::vector<std::string>& arg_vector, std::string* error_msg);
 
+// Starts a command in a subprocess, with the given variables added to its environment, and
+// returns its pid without waiting for it, or -1 on failure.
+pid_t ExecAsync(const std::vector<std::string>& arg_vector,
+                const std::vector<std::string>& extra_env, std::string* error_msg);
+
 }  // namespace installd
 }  // namespace android
 
@@ -212,6 +212,35 @@ TEST_F(ServiceTest, HashSecondaryDex_Unreadable) {
     EXPECT_EQ(result.size(), 0U);
 }
 
+TEST_F(ServiceTest, HashSecondaryDexFiles) {
+    LOG(INFO) << "HashSecondaryDexFiles";
+
+    mkdir("com.example", 10000, 10000, 0700);
+    mkdir("com.example/foo", 10000, 10000, 0700);
+    touch("com.example/foo/file", 10000, 20000, 0700);
+
+    std::vector<uint8_t> result;
+    std::vector<std::string> dexPaths = {
+        get_full_path("com.example/foo/file"),
+        get_full_path("com.example/foo/missing"),
+        get_full_path("com.example/foo/file"),
+    };
+    EXPECT_BINDER_SUCCESS(service->hashSecondaryDexFiles(
+        dexPaths, "com.example", 10000, testUuid, FLAG_STORAGE_CE, &result));
+
+    EXPECT_EQ(result.size(), 96U);
+
+    std::ostringstream output;
+    output << std::hex << std::setfill('0');
+    for (auto b : result) {
+        output << std::setw(2) << +b;
+    }
+
+    // The SHA256 of an empty string, zeros for the missing file, and the empty string again
+    const std::string empty = "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855";
+    EXPECT_EQ(output.str(), empty + std::string(64, '0') + empty);
+}
+
 TEST_F(ServiceTest, HashSecondaryDex_WrongApp) {
     LOG(INFO) << "HashSecondaryDex_WrongApp";
 
@@ -17,6 +17,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/scopeguard.h>
 #include <gtest/gtest.h>
@@ -638,5 +639,88 @@ TEST_F(UtilsTest, TestCreateDirIfNeeded) {
     ASSERT_NE(0, create_dir_if_needed("/data/local/tmp/user/0/bar/baz", 0700));
 }
 
+TEST_F(UtilsTest, TestCopyDirectoryRecursive) {
+    system("mkdir -p /data/local/tmp/user/0/from/pkg/dir /data/local/tmp/user/0/to");
+
+    auto deleter = [&]() {
+        delete_dir_contents_and_dir("/data/local/tmp/user/0", true /* ignore_if_missing */);
+    };
+    auto scope_guard = android::base::make_scope_guard(deleter);
+
+    const std::string from = "/data/local/tmp/user/0/from/pkg";
+    ASSERT_TRUE(android::base::WriteStringToFile("contents", from + "/dir/file"));
+    ASSERT_EQ(0, chmod((from + "/dir/file").c_str(), 0640));
+    ASSERT_EQ(0, chmod((from + "/dir").c_str(), 0751));
+    ASSERT_EQ(0, symlink("dir/file", (from + "/link").c_str()));
+    // Existing files are replaced.
+    system("mkdir -p /data/local/tmp/user/0/to/pkg/dir");
+    ASSERT_TRUE(android::base::WriteStringToFile("stale contents",
+                                                 "/data/local/tmp/user/0/to/pkg/dir/file"));
+
+    ASSERT_EQ(0, copy_directory_recursive(from, "/data/local/tmp/user/0/to"));
+
+    const std::string to = "/data/local/tmp/user/0/to/pkg";
+    std::string contents;
+    ASSERT_TRUE(android::base::ReadFileToString(to + "/dir/file", &contents));
+    EXPECT_EQ("contents", contents);
+
+    struct stat from_st, to_st;
+    ASSERT_EQ(0, stat((from + "/dir/file").c_str(), &from_st));
+    ASSERT_EQ(0, stat((to + "/dir/file").c_str(), &to_st));
+    EXPECT_EQ(0640, to_st.st_mode & ALLPERMS);
+    EXPECT_EQ(from_st.st_mtim.tv_sec, to_st.st_mtim.tv_sec);
+    EXPECT_EQ(from_st.st_mtim.tv_nsec, to_st.st_mtim.tv_nsec);
+    ASSERT_EQ(0, stat((to + "/dir").c_str(), &to_st));
+    EXPECT_EQ(0751, to_st.st_mode & ALLPERMS);
+
+    std::string target;
+    ASSERT_TRUE(android::base::Readlink(to + "/link", &target));
+    EXPECT_EQ("dir/file", target);
+}
+
+TEST_F(UtilsTest, TestCalculateTreeSize) {
+    auto deleter = [&]() {
+        delete_dir_contents_and_dir("/data/local/tmp/user/0", true /* ignore_if_missing */);
+    };
+    auto scope_guard = android::base::make_scope_guard(deleter);
+
+    const std::string root = "/data/local/tmp/user/0/tree";
+    int64_t expected = 0;
+    auto measure = [&](const std::string& path) {
+        struct stat st;
+        ASSERT_EQ(0, lstat(path.c_str(), &st));
+        expected += st.st_blocks * 512;
+    };
+    system(("mkdir -p " + root).c_str());
+    measure(root);
+    // Enough directories for several threads to take part in the traversal.
+    for (int i = 0; i < 16; i++) {
+        const std::string dir = root + "/dir" + std::to_string(i);
+        ASSERT_EQ(0, mkdir(dir.c_str(), 0700));
+        ASSERT_TRUE(android::base::WriteStringToFile(std::string(8192, 'x'), dir + "/file"));
+        ASSERT_EQ(0, symlink("file", (dir + "/link").c_str()));
+        measure(dir);
+        measure(dir + "/file");
+        measure(dir + "/link");
+    }
+
+    int64_t size = 0;
+    ASSERT_EQ(0, calculate_tree_size(root, &size));
+    EXPECT_EQ(expected, size);
+
+    // Only entries with the included gid are counted, but directories are still traversed.
+    const std::string file = root + "/dir3/file";
+    ASSERT_EQ(0, lchown(file.c_str(), -1, 1234));
+    struct stat st;
+    ASSERT_EQ(0, lstat(file.c_str(), &st));
+    size = 0;
+    ASSERT_EQ(0, calculate_tree_size(root, &size, 1234));
+    EXPECT_EQ(st.st_blocks * 512, size);
+
+    size = 0;
+    EXPECT_EQ(-1, calculate_tree_size(root + "/missing", &size));
+    EXPECT_EQ(0, size);
+}
+
 }  // namespace installd
 }  // namespace android
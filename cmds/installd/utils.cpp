@@ -19,12 +19,19 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <fts.h>
+#include <linux/fs.h>
 #include <stdlib.h>
 #include <sys/capability.h>
+#include <sys/ioctl.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
 #include <sys/xattr.h>
 #include <sys/statvfs.h>
+#include <sys/syscall.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
@@ -33,6 +40,7 @@
 #include <android-base/unique_fd.h>
 #include <cutils/fs.h>
 #include <cutils/properties.h>
+#include <diskusage/dirsize.h>
 #include <log/log.h>
 #include <private/android_filesystem_config.h>
 #include <private/android_projectid_config.h>
@@ -376,47 +384,64 @@ std::vector<userid_t> get_known_users(const char* volume_uuid) {
     return users;
 }
 
+struct TreeSizeFilter {
+    int32_t include_gid;
+    int32_t exclude_gid;
+    bool exclude_apps;
+};
+
+static int tree_size_category(const struct dir_size_entry* entry, void* cookie) {
+    const auto* filter = static_cast<const TreeSizeFilter*>(cookie);
+    int32_t uid = entry->uid;
+    int32_t gid = entry->gid;
+    int32_t user_uid = multiuser_get_app_id(uid);
+    int32_t user_gid = multiuser_get_app_id(gid);
+    if (filter->exclude_apps && ((user_uid >= AID_APP_START && user_uid <= AID_APP_END)
+            || (user_gid >= AID_CACHE_GID_START && user_gid <= AID_CACHE_GID_END)
+            || (user_gid >= AID_SHARED_GID_START && user_gid <= AID_SHARED_GID_END))) {
+        // Don't traverse inside or measure
+        return DIR_SIZE_PRUNE;
+    }
+    if (filter->include_gid != -1 && gid != filter->include_gid) {
+        return DIR_SIZE_IGNORE;
+    }
+    if (filter->exclude_gid != -1 && gid == filter->exclude_gid) {
+        return DIR_SIZE_IGNORE;
+    }
+    return 0;
+}
+
 int calculate_tree_size(const std::string& path, int64_t* size,
         int32_t include_gid, int32_t exclude_gid, bool exclude_apps) {
-    FTS *fts;
-    FTSENT *p;
-    int64_t matchedSize = 0;
-    char *argv[] = { (char*) path.c_str(), nullptr };
-    if (!(fts = fts_open(argv, FTS_PHYSICAL | FTS_NOCHDIR | FTS_XDEV, nullptr))) {
+    TreeSizeFilter filter{include_gid, exclude_gid, exclude_apps};
+    struct stat s;
+    if (lstat(path.c_str(), &s) != 0) {
         if (errno != ENOENT) {
-            PLOG(ERROR) << "Failed to fts_open " << path;
+            PLOG(ERROR) << "Failed to stat " << path;
         }
         return -1;
     }
-    while ((p = fts_read(fts)) != nullptr) {
-        switch (p->fts_info) {
-        case FTS_D:
-        case FTS_DEFAULT:
-        case FTS_F:
-        case FTS_SL:
-        case FTS_SLNONE:
-            int32_t uid = p->fts_statp->st_uid;
-            int32_t gid = p->fts_statp->st_gid;
-            int32_t user_uid = multiuser_get_app_id(uid);
-            int32_t user_gid = multiuser_get_app_id(gid);
-            if (exclude_apps && ((user_uid >= AID_APP_START && user_uid <= AID_APP_END)
-                    || (user_gid >= AID_CACHE_GID_START && user_gid <= AID_CACHE_GID_END)
-                    || (user_gid >= AID_SHARED_GID_START && user_gid <= AID_SHARED_GID_END))) {
-                // Don't traverse inside or measure
-                fts_set(fts, p, FTS_SKIP);
-                break;
-            }
-            if (include_gid != -1 && gid != include_gid) {
-                break;
-            }
-            if (exclude_gid != -1 && gid == exclude_gid) {
-                break;
-            }
-            matchedSize += (p->fts_statp->st_blocks * 512);
-            break;
+
+    // The root is measured like its descendants, which are traversed in parallel.
+    struct dir_size_entry root;
+    root.parent_fd = AT_FDCWD;
+    root.name = path.c_str();
+    root.mode = s.st_mode;
+    root.uid = s.st_uid;
+    root.gid = s.st_gid;
+    root.size = stat_size(&s);
+    const int category = tree_size_category(&root, &filter);
+    int64_t matchedSize = category == 0 ? root.size : 0;
+    if (S_ISDIR(s.st_mode) && category != DIR_SIZE_PRUNE) {
+        int fd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        if (fd < 0) {
+            PLOG(WARNING) << "Failed to open " << path;
+        } else if (calculate_dir_size_parallel(fd, 0, DIR_SIZE_XDEV, tree_size_category, &filter,
+                                               &matchedSize, 1) != 0) {
+            PLOG(ERROR) << "Failed to measure " << path;
+            return -1;
         }
     }
-    fts_close(fts);
 #if MEASURE_DEBUG
     if ((include_gid == -1) && (exclude_gid == -1)) {
         LOG(DEBUG) << "Measured " << path << " size " << matchedSize;
@@ -714,6 +739,265 @@ int copy_dir_files(const char *srcname,
     return res;
 }
 
+// Number of threads long filesystem walks and batched calls are spread over.
+static constexpr size_t kWorkerThreads = 4;
+
+void run_in_parallel(size_t count, const std::function<void(size_t)>& fn) {
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t i = next++; i < count; i = next++) {
+            fn(i);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < std::min(count, kWorkerThreads); i++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+// Set once cloning fails on a filesystem without reflink support, so that later
+// files go straight to copy_file_range.
+static std::atomic<bool> sCloneUnsupported(false);
+
+static bool should_copy_xattr(const char* name) {
+    // SELinux labels are assigned by the policy of the destination and fixed up
+    // by restorecon, and the inode xattrs refer to inodes of the source tree.
+    return !android::base::StartsWith(name, "security.") && strcmp(name, kXattrInodeCache) != 0
+            && strcmp(name, kXattrInodeCodeCache) != 0;
+}
+
+static void copy_xattrs(int src_fd, int dst_fd, const std::string& dst) {
+    ssize_t size = flistxattr(src_fd, nullptr, 0);
+    if (size <= 0) {
+        return;
+    }
+    std::vector<char> names(size);
+    size = flistxattr(src_fd, names.data(), names.size());
+    for (ssize_t i = 0; i < size; i += strlen(&names[i]) + 1) {
+        const char* name = &names[i];
+        if (!should_copy_xattr(name)) {
+            continue;
+        }
+        std::vector<char> value(std::max<ssize_t>(fgetxattr(src_fd, name, nullptr, 0), 0));
+        ssize_t value_size = fgetxattr(src_fd, name, value.data(), value.size());
+        if (value_size < 0 || fsetxattr(dst_fd, name, value.data(), value_size, 0) != 0) {
+            PLOG(WARNING) << "Failed to copy xattr " << name << " to " << dst;
+        }
+    }
+}
+
+// Copies the ownership, mode and timestamps of st. Ownership goes first, as
+// changing it clears the setuid and setgid bits.
+static int copy_metadata(int dst_fd, const struct stat& st, const std::string& dst) {
+    const struct timespec times[2] = {st.st_atim, st.st_mtim};
+    if (fchown(dst_fd, st.st_uid, st.st_gid) != 0 || fchmod(dst_fd, st.st_mode & ALLPERMS) != 0
+            || futimens(dst_fd, times) != 0) {
+        PLOG(ERROR) << "Failed to set attributes of " << dst;
+        return -1;
+    }
+    return 0;
+}
+
+static int copy_file_contents(int src_fd, int dst_fd, const std::string& dst) {
+    if (!sCloneUnsupported && ioctl(dst_fd, FICLONE, src_fd) == 0) {
+        return 0;
+    }
+    if (errno == EOPNOTSUPP || errno == ENOTTY) {
+        sCloneUnsupported = true;
+    }
+
+    // copy_file_range keeps the data in the kernel, and both it and the
+    // fallback advance the file offsets, so the fallback can pick up where it
+    // stopped.
+    while (true) {
+        ssize_t copied = syscall(__NR_copy_file_range, src_fd, nullptr, dst_fd, nullptr,
+                                 SSIZE_MAX, 0);
+        if (copied == 0) {
+            return 0;
+        }
+        if (copied < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == ENOSYS || errno == EXDEV || errno == EINVAL || errno == EOPNOTSUPP) {
+                break;
+            }
+            PLOG(ERROR) << "Failed to copy " << dst;
+            return -1;
+        }
+    }
+
+    char buf[64 * 1024];
+    ssize_t size;
+    while ((size = TEMP_FAILURE_RETRY(read(src_fd, buf, sizeof(buf)))) > 0) {
+        if (!android::base::WriteFully(dst_fd, buf, size)) {
+            PLOG(ERROR) << "Failed to write " << dst;
+            return -1;
+        }
+    }
+    if (size < 0) {
+        PLOG(ERROR) << "Failed to read the source of " << dst;
+        return -1;
+    }
+    return 0;
+}
+
+static int copy_regular_file(const std::string& src, const std::string& dst,
+                             const struct stat& st) {
+    unique_fd src_fd(open(src.c_str(), O_RDONLY | O_NOFOLLOW | O_CLOEXEC));
+    if (src_fd == -1) {
+        PLOG(ERROR) << "Failed to open " << src;
+        return -1;
+    }
+    if (unlink(dst.c_str()) != 0 && errno != ENOENT) {
+        PLOG(ERROR) << "Failed to remove " << dst;
+        return -1;
+    }
+    // The file stays private to its owner until its attributes are copied.
+    unique_fd dst_fd(open(dst.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC,
+                          S_IRUSR | S_IWUSR));
+    if (dst_fd == -1) {
+        PLOG(ERROR) << "Failed to create " << dst;
+        return -1;
+    }
+    if (copy_file_contents(src_fd.get(), dst_fd.get(), dst) != 0) {
+        return -1;
+    }
+    // Snapshots are rarely read back, so don't let them push other data out
+    // of the page cache.
+    posix_fadvise(src_fd.get(), 0, 0, POSIX_FADV_DONTNEED);
+    copy_xattrs(src_fd.get(), dst_fd.get(), dst);
+    return copy_metadata(dst_fd.get(), st, dst);
+}
+
+static int copy_symlink(const std::string& src, const std::string& dst, const struct stat& st) {
+    std::string target;
+    if (!android::base::Readlink(src, &target)) {
+        PLOG(ERROR) << "Failed to read link " << src;
+        return -1;
+    }
+    if (unlink(dst.c_str()) != 0 && errno != ENOENT) {
+        PLOG(ERROR) << "Failed to remove " << dst;
+        return -1;
+    }
+    const struct timespec times[2] = {st.st_atim, st.st_mtim};
+    if (symlink(target.c_str(), dst.c_str()) != 0
+            || lchown(dst.c_str(), st.st_uid, st.st_gid) != 0
+            || utimensat(AT_FDCWD, dst.c_str(), times, AT_SYMLINK_NOFOLLOW) != 0) {
+        PLOG(ERROR) << "Failed to copy link " << src << " to " << dst;
+        return -1;
+    }
+    return 0;
+}
+
+static int copy_special_file(const std::string& src, const std::string& dst,
+                             const struct stat& st) {
+    if (unlink(dst.c_str()) != 0 && errno != ENOENT) {
+        PLOG(ERROR) << "Failed to remove " << dst;
+        return -1;
+    }
+    const struct timespec times[2] = {st.st_atim, st.st_mtim};
+    if (mknod(dst.c_str(), st.st_mode & ~ALLPERMS, st.st_rdev) != 0
+            || lchown(dst.c_str(), st.st_uid, st.st_gid) != 0
+            || fchmodat(AT_FDCWD, dst.c_str(), st.st_mode & ALLPERMS, 0) != 0
+            || utimensat(AT_FDCWD, dst.c_str(), times, AT_SYMLINK_NOFOLLOW) != 0) {
+        PLOG(ERROR) << "Failed to copy " << src << " to " << dst;
+        return -1;
+    }
+    return 0;
+}
+
+int copy_directory_recursive(const std::string& from, const std::string& to) {
+    LOG(DEBUG) << "Copying " << from << " to " << to;
+
+    struct Entry {
+        std::string src;
+        std::string dst;
+        struct stat st;
+    };
+    std::vector<Entry> dirs;
+    std::vector<Entry> files;
+
+    // Create the directories, links and special files while walking the tree,
+    // so that the regular files can then be copied in any order.
+    const std::string dst_root = to + "/" + android::base::Basename(from);
+    char* argv[] = {const_cast<char*>(from.c_str()), nullptr};
+    FTS* fts = fts_open(argv, FTS_PHYSICAL | FTS_NOCHDIR | FTS_XDEV, nullptr);
+    if (fts == nullptr) {
+        PLOG(ERROR) << "Failed to fts_open " << from;
+        return -1;
+    }
+    int res = 0;
+    FTSENT* p;
+    while (res == 0 && (p = fts_read(fts)) != nullptr) {
+        std::string dst = dst_root + (p->fts_path + from.size());
+        switch (p->fts_info) {
+            case FTS_D:
+                if (mkdir(dst.c_str(), S_IRWXU) != 0 && errno != EEXIST) {
+                    PLOG(ERROR) << "Failed to create " << dst;
+                    res = -1;
+                } else {
+                    dirs.push_back({p->fts_path, std::move(dst), *p->fts_statp});
+                }
+                break;
+            case FTS_F:
+                files.push_back({p->fts_path, std::move(dst), *p->fts_statp});
+                break;
+            case FTS_SL:
+            case FTS_SLNONE:
+                res = copy_symlink(p->fts_path, dst, *p->fts_statp);
+                break;
+            case FTS_DEFAULT:
+                res = copy_special_file(p->fts_path, dst, *p->fts_statp);
+                break;
+            case FTS_DNR:
+            case FTS_ERR:
+            case FTS_NS:
+                errno = p->fts_errno;
+                PLOG(ERROR) << "Failed to read " << p->fts_path;
+                res = -1;
+                break;
+            default:
+                break;
+        }
+    }
+    fts_close(fts);
+    if (res != 0) {
+        return res;
+    }
+
+    std::atomic<bool> failed(false);
+    run_in_parallel(files.size(), [&](size_t i) {
+        if (!failed && copy_regular_file(files[i].src, files[i].dst, files[i].st) != 0) {
+            failed = true;
+        }
+    });
+    if (failed) {
+        return -1;
+    }
+
+    // Adding entries changes the timestamps of a directory, and its mode may
+    // not allow them, so the directories are finished last.
+    for (const Entry& dir : dirs) {
+        unique_fd src_fd(open(dir.src.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC));
+        unique_fd dst_fd(open(dir.dst.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC));
+        if (src_fd == -1 || dst_fd == -1) {
+            PLOG(ERROR) << "Failed to open " << dir.src << " or " << dir.dst;
+            return -1;
+        }
+        copy_xattrs(src_fd.get(), dst_fd.get(), dir.dst);
+        if (copy_metadata(dst_fd.get(), dir.st, dir.dst) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
 int64_t data_disk_free(const std::string& data_path) {
     struct statvfs sfs;
     if (statvfs(data_path.c_str(), &sfs) == 0) {
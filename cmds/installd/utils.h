@@ -18,6 +18,7 @@
 #ifndef UTILS_H_
 #define UTILS_H_
 
+#include <functional>
 #include <string>
 #include <vector>
 
@@ -131,6 +132,17 @@ int rm_package_dir(const std::string& package_dir);
 
 int copy_dir_files(const char *srcname, const char *dstname, uid_t owner, gid_t group);
 
+// Copies the directory |from| into the directory |to|, replacing existing
+// files, like `cp -F -p -R -P -d`. Ownership, modes, timestamps and xattrs
+// other than SELinux labels are preserved, and symlinks are copied as links.
+// Files are cloned when the filesystem supports it, and copied within the
+// kernel otherwise, on a pool of worker threads.
+int copy_directory_recursive(const std::string& from, const std::string& to);
+
+// Calls fn(i) for every i in [0, count) on a few threads, the calling one
+// included, and returns once all calls are done.
+void run_in_parallel(size_t count, const std::function<void(size_t)>& fn);
+
 int64_t data_disk_free(const std::string& data_path);
 
 int get_path_inode(const std::string& path, ino_t *inode);
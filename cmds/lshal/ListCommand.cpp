@@ -19,6 +19,7 @@
 #include <getopt.h>
 
 #include <algorithm>
+#include <atomic>
 #include <fstream>
 #include <functional>
 #include <iomanip>
@@ -26,6 +27,7 @@
 #include <map>
 #include <regex>
 #include <sstream>
+#include <thread>
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
@@ -234,65 +236,125 @@ static bool scanBinderContext(pid_t pid,
     return true;
 }
 
+// Like scanBinderContext, but for all processes at once, reading the state file of the binder
+// driver instead of one file per process.
+static bool scanBinderStateContext(const std::string &contextName,
+        std::function<void(pid_t, const std::string&)> eachLine) {
+    std::ifstream ifs("/dev/binderfs/binder_logs/state");
+    if (!ifs.is_open()) {
+        ifs.open("/d/binder/state");
+        if (!ifs.is_open()) {
+            return false;
+        }
+    }
+
+    // Unlike nodes and threads, these lines are not indented.
+    static const std::string kProcPrefix = "proc ";
+    static const std::string kContextPrefix = "context ";
+
+    pid_t pid = NO_PID;
+    bool isDesiredContext = false;
+    std::string line;
+    while (getline(ifs, line)) {
+        if (line.compare(0, kProcPrefix.size(), kProcPrefix) == 0) {
+            if (!::android::base::ParseInt(line.substr(kProcPrefix.size()), &pid)) {
+                pid = NO_PID;
+            }
+            isDesiredContext = false;
+            continue;
+        }
+
+        if (line.compare(0, kContextPrefix.size(), kContextPrefix) == 0) {
+            isDesiredContext =
+                    pid != NO_PID && line.compare(kContextPrefix.size(), line.npos, contextName) == 0;
+            continue;
+        }
+
+        if (!isDesiredContext) {
+            continue;
+        }
+
+        eachLine(pid, line);
+    }
+    return true;
+}
+
 bool ListCommand::getPidInfo(
         pid_t serverPid, PidInfo *pidInfo) const {
+    std::call_once(mAllPidInfosOnce, [this] {
+        scanBinderStateContext("hwbinder", [this](pid_t pid, const std::string& line) {
+            addPidInfoLine(line, &mAllPidInfos[pid]);
+        });
+    });
+    auto it = mAllPidInfos.find(serverPid);
+    if (it != mAllPidInfos.end()) {
+        *pidInfo = it->second;
+        return true;
+    }
+
+    // The process may have started after the state was read.
+    return scanBinderContext(serverPid, "hwbinder", [&](const std::string& line) {
+        addPidInfoLine(line, pidInfo);
+    });
+}
+
+void ListCommand::addPidInfoLine(const std::string &line, PidInfo *pidInfo) const {
     static const std::regex kReferencePrefix("^\\s*node \\d+:\\s+u([0-9a-f]+)\\s+c([0-9a-f]+)\\s+");
     static const std::regex kThreadPrefix("^\\s*thread \\d+:\\s+l\\s+(\\d)(\\d)");
 
     std::smatch match;
-    return scanBinderContext(serverPid, "hwbinder", [&](const std::string& line) {
-        if (std::regex_search(line, match, kReferencePrefix)) {
-            const std::string &ptrString = "0x" + match.str(2); // use number after c
-            uint64_t ptr;
-            if (!::android::base::ParseUint(ptrString.c_str(), &ptr)) {
-                // Should not reach here, but just be tolerant.
-                err() << "Could not parse number " << ptrString << std::endl;
-                return;
-            }
-            const std::string proc = " proc ";
-            auto pos = line.rfind(proc);
-            if (pos != std::string::npos) {
-                for (const std::string &pidStr : split(line.substr(pos + proc.size()), ' ')) {
-                    int32_t pid;
-                    if (!::android::base::ParseInt(pidStr, &pid)) {
-                        err() << "Could not parse number " << pidStr << std::endl;
-                        return;
-                    }
-                    pidInfo->refPids[ptr].push_back(pid);
-                }
-            }
-
+    if (std::regex_search(line, match, kReferencePrefix)) {
+        const std::string &ptrString = "0x" + match.str(2); // use number after c
+        uint64_t ptr;
+        if (!::android::base::ParseUint(ptrString.c_str(), &ptr)) {
+            // Should not reach here, but just be tolerant.
+            err() << "Could not parse number " << ptrString << std::endl;
             return;
         }
-
-        if (std::regex_search(line, match, kThreadPrefix)) {
-            // "1" is waiting in binder driver
-            // "2" is poll. It's impossible to tell if these are in use.
-            //     and HIDL default code doesn't use it.
-            bool isInUse = match.str(1) != "1";
-            // "0" is a thread that has called into binder
-            // "1" is looper thread
-            // "2" is main looper thread
-            bool isHwbinderThread = match.str(2) != "0";
-
-            if (!isHwbinderThread) {
-                return;
+        const std::string proc = " proc ";
+        auto pos = line.rfind(proc);
+        if (pos != std::string::npos) {
+            for (const std::string &pidStr : split(line.substr(pos + proc.size()), ' ')) {
+                int32_t pid;
+                if (!::android::base::ParseInt(pidStr, &pid)) {
+                    err() << "Could not parse number " << pidStr << std::endl;
+                    return;
+                }
+                pidInfo->refPids[ptr].push_back(pid);
             }
+        }
 
-            if (isInUse) {
-                pidInfo->threadUsage++;
-            }
+        return;
+    }
 
-            pidInfo->threadCount++;
+    if (std::regex_search(line, match, kThreadPrefix)) {
+        // "1" is waiting in binder driver
+        // "2" is poll. It's impossible to tell if these are in use.
+        //     and HIDL default code doesn't use it.
+        bool isInUse = match.str(1) != "1";
+        // "0" is a thread that has called into binder
+        // "1" is looper thread
+        // "2" is main looper thread
+        bool isHwbinderThread = match.str(2) != "0";
+
+        if (!isHwbinderThread) {
             return;
         }
 
-        // not reference or thread line
+        if (isInUse) {
+            pidInfo->threadUsage++;
+        }
+
+        pidInfo->threadCount++;
         return;
-    });
+    }
+
+    // not reference or thread line
+    return;
 }
 
 const PidInfo* ListCommand::getPidInfoCached(pid_t serverPid) {
+    std::lock_guard<std::mutex> lock(mCachedPidInfosLock);
     auto pair = mCachedPidInfos.insert({serverPid, PidInfo{}});
     if (pair.second /* did insertion take place? */) {
         if (!getPidInfo(serverPid, &pair.first->second)) {
@@ -652,6 +714,9 @@ Status ListCommand::fetchPassthrough(const sp<IServiceManager> &manager) {
     return OK;
 }
 
+// Maximum number of HALs that fetchBinderized() queries at the same time.
+static constexpr size_t kFetchBinderizedThreads = 8;
+
 Status ListCommand::fetchBinderized(const sp<IServiceManager> &manager) {
     using vintf::operator<<;
 
@@ -671,14 +736,39 @@ Status ListCommand::fetchBinderized(const sp<IServiceManager> &manager) {
 
     Status status = OK;
     std::map<std::string, TableEntry> allTableEntries;
+    std::vector<TableEntry*> entries;
     for (const auto &fqInstanceName : fqInstanceNames) {
         // create entry and default assign all fields.
         TableEntry& entry = allTableEntries[fqInstanceName];
         entry.interfaceName = fqInstanceName;
         entry.transport = mode;
         entry.serviceStatus = ServiceStatus::NON_RESPONSIVE;
+        entries.push_back(&entry);
+    }
 
-        status |= fetchBinderizedEntry(manager, &entry);
+    // Fetch entries concurrently so that slow HALs don't add up; each IPC still has its own
+    // timeout. Errors are printed afterwards, in order.
+    std::vector<Status> statuses(entries.size(), OK);
+    std::vector<std::string> errors(entries.size());
+    std::atomic<size_t> next{0};
+    auto fetchEntries = [&] {
+        for (size_t i = next++; i < entries.size(); i = next++) {
+            std::stringstream entryErrors;
+            statuses[i] = fetchBinderizedEntry(manager, entries[i], entryErrors);
+            errors[i] = entryErrors.str();
+        }
+    };
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < std::min(kFetchBinderizedThreads, entries.size()); ++i) {
+        threads.emplace_back(fetchEntries);
+    }
+    fetchEntries();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (size_t i = 0; i < entries.size(); ++i) {
+        err() << errors[i];
+        status |= statuses[i];
     }
 
     for (auto& pair : allTableEntries) {
@@ -688,10 +778,10 @@ Status ListCommand::fetchBinderized(const sp<IServiceManager> &manager) {
 }
 
 Status ListCommand::fetchBinderizedEntry(const sp<IServiceManager> &manager,
-                                         TableEntry *entry) {
+                                         TableEntry *entry, std::ostream &errors) {
     Status status = OK;
     const auto handleError = [&](Status additionalError, const std::string& msg) {
-        err() << "Warning: Skipping \"" << entry->interfaceName << "\": " << msg << std::endl;
+        errors << "Warning: Skipping \"" << entry->interfaceName << "\": " << msg << std::endl;
         status |= DUMP_BINDERIZED_ERROR | additionalError;
     };
 
@@ -20,6 +20,9 @@
 #include <stdint.h>
 
 #include <fstream>
+#include <map>
+#include <mutex>
+#include <ostream>
 #include <string>
 #include <vector>
 
@@ -101,15 +104,19 @@ protected:
     Status fetchManifestHals();
     Status fetchLazyHals();
 
+    // Errors are written to errors instead of err(), because entries are fetched concurrently.
     Status fetchBinderizedEntry(const sp<::android::hidl::manager::V1_0::IServiceManager> &manager,
-                                TableEntry *entry);
+                                TableEntry *entry, std::ostream &errors);
 
     // Get relevant information for a PID by parsing files under
-    // /dev/binderfs/binder_logs or /d/binder.
+    // /dev/binderfs/binder_logs or /d/binder. The state of all processes is parsed once on the
+    // first call, falling back to the file of the PID if it is not found there.
     // It is a virtual member function so that it can be mocked.
     virtual bool getPidInfo(pid_t serverPid, PidInfo *info) const;
-    // Retrieve from mCachedPidInfos and call getPidInfo if necessary.
+    // Retrieve from mCachedPidInfos and call getPidInfo if necessary. Thread-safe.
     const PidInfo* getPidInfoCached(pid_t serverPid);
+    // Add a line of the hwbinder context of a process to its PidInfo.
+    void addPidInfoLine(const std::string &line, PidInfo *pidInfo) const;
 
     void dumpTable(const NullableOStream<std::ostream>& out) const;
     void dumpVintf(const NullableOStream<std::ostream>& out) const;
@@ -187,9 +194,14 @@ protected:
     // If an entry exist and not empty, it contains the cached content of /proc/{pid}/cmdline.
     std::map<pid_t, std::string> mCmdlines;
 
-    // Cache for getPidInfo.
+    // Cache for getPidInfo, guarded by mCachedPidInfosLock.
+    std::mutex mCachedPidInfosLock;
     std::map<pid_t, PidInfo> mCachedPidInfos;
 
+    // Parsed binder state of all processes, filled in by the first getPidInfo call.
+    mutable std::once_flag mAllPidInfosOnce;
+    mutable std::map<pid_t, PidInfo> mAllPidInfos;
+
     // Cache for getPartition.
     std::map<pid_t, Partition> mPartitions;
 
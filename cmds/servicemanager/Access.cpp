@@ -30,6 +30,9 @@ constexpr bool kIsVendor = true;
 constexpr bool kIsVendor = false;
 #endif
 
+// Bounds the find cache in case callers cycle through many contexts or names.
+constexpr size_t kMaxFindCacheSize = 1024;
+
 static std::string getPidcon(pid_t pid) {
     android_errorWriteLog(0x534e4554, "121035042");
 
@@ -111,7 +114,27 @@ Access::CallingContext Access::getCallingContext() {
 }
 
 bool Access::canFind(const CallingContext& ctx,const std::string& name) {
-    return actionAllowedFromLookup(ctx, name, "find");
+    const int policyLoad = selinux_status_policyload();
+    const int enforce = selinux_status_getenforce();
+    if (policyLoad != mFindCachePolicyLoad || enforce != mFindCacheEnforce ||
+            mFindCache.size() >= kMaxFindCacheSize) {
+        mFindCache.clear();
+        mFindCachePolicyLoad = policyLoad;
+        mFindCacheEnforce = enforce;
+    }
+
+    auto key = std::make_pair(ctx.sid, name);
+    if (mFindCache.count(key) != 0) {
+        return true;
+    }
+
+    bool allowed = actionAllowedFromLookup(ctx, name, "find");
+    // In permissive mode a denial is logged but still returns success, so
+    // only cache while enforcing. An empty sid means getpidcon() failed.
+    if (allowed && enforce == 1 && !ctx.sid.empty()) {
+        mFindCache.insert(std::move(key));
+    }
+    return allowed;
 }
 
 bool Access::canAdd(const CallingContext& ctx, const std::string& name) {
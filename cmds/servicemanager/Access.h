@@ -16,8 +16,10 @@
 
 #pragma once
 
+#include <set>
 #include <string>
 #include <sys/types.h>
+#include <utility>
 
 namespace android {
 
@@ -51,6 +53,14 @@ private:
             const char *perm);
 
     char* mThisProcessContext = nullptr;
+
+    // Granted "find" checks keyed by (caller sid, service name). Denials and
+    // permissive-mode checks are never cached so they keep being audited.
+    // Dropped whenever the policy is reloaded or the enforcing mode changes.
+    // servicemanager handles one call at a time, so this needs no lock.
+    std::set<std::pair<std::string, std::string>> mFindCache;
+    int mFindCachePolicyLoad = -1;
+    int mFindCacheEnforce = -1;
 };
 
 };
@@ -24,6 +24,11 @@
 #include <binder/Stability.h>
 #include <cutils/android_filesystem_config.h>
 #include <cutils/multiuser.h>
+#include <utils/SystemClock.h>
+
+#include <algorithm>
+#include <inttypes.h>
+#include <stdio.h>
 #include <thread>
 
 #ifndef VENDORSERVICEMANAGER
@@ -36,6 +41,19 @@ using ::android::internal::Stability;
 
 namespace android {
 
+// Bounds on the service wait bookkeeping, which clients can otherwise grow.
+constexpr size_t kMaxPendingLookupNames = 256;
+constexpr size_t kMaxPendingLookupsPerName = 32;
+constexpr size_t kMaxServiceWaits = 1024;
+
+// Lazy services which were started kFrequentStartCount times within
+// kFrequentStartWindowMs are kept kFrequentIdleTimeoutMs without clients
+// before being told to shut down, so that bursty clients don't restart them
+// over and over.
+constexpr size_t kFrequentStartCount = 3;
+constexpr int64_t kFrequentStartWindowMs = 10 * 60 * 1000;
+constexpr int64_t kFrequentIdleTimeoutMs = 60 * 1000;
+
 #ifndef VENDORSERVICEMANAGER
 static bool isVintfDeclared(const std::string& name) {
     size_t firstSlash = name.find('/');
@@ -85,7 +103,10 @@ static bool meetsDeclarationRequirements(const sp<IBinder>& binder, const std::s
 }
 #endif  // !VENDORSERVICEMANAGER
 
-ServiceManager::ServiceManager(std::unique_ptr<Access>&& access) : mAccess(std::move(access)) {
+ServiceManager::ServiceManager(std::unique_ptr<Access>&& access)
+      : mIdleTimeoutMs(
+                base::GetIntProperty<int64_t>("ro.servicemanager.lazy_idle_timeout_ms", 0)),
+        mAccess(std::move(access)) {
 // TODO(b/151696835): reenable performance hack when we solve bug, since with
 //     this hack and other fixes, it is unlikely we will see even an ephemeral
 //     failure when the manifest parse fails. The goal is that the manifest will
@@ -151,8 +172,12 @@ sp<IBinder> ServiceManager::tryGetService(const std::string& name, bool startIfN
         return nullptr;
     }
 
-    if (!out && startIfNotFound) {
-        tryStartService(name);
+    if (!out) {
+        recordPendingLookup(ctx, name);
+        if (startIfNotFound) {
+            recordStartRequest(name);
+            tryStartService(name);
+        }
     }
 
     if (out) {
@@ -221,6 +246,9 @@ Status ServiceManager::addService(const std::string& name, const sp<IBinder>& bi
         .debugPid = ctx.debugPid,
     };
 
+    resolvePendingLookups(name);
+    recordStart(name);
+
     auto it = mNameToRegistrationCallback.find(name);
     if (it != mNameToRegistrationCallback.end()) {
         for (const sp<IServiceCallback>& cb : it->second) {
@@ -289,6 +317,8 @@ Status ServiceManager::registerForNotifications(
         // never null if an entry exists
         CHECK(binder != nullptr) << name;
         callback->onRegistration(name, binder);
+    } else {
+        recordPendingLookup(ctx, name);
     }
 
     return Status::ok();
@@ -472,6 +502,8 @@ ssize_t ServiceManager::handleServiceClientCallback(const std::string& serviceNa
 
         // guarantee is temporary
         service.guaranteeClient = false;
+        // the service was just used, so it isn't idle
+        service.idleSinceMs = 0;
     }
 
     // only send notifications if this was called via the interval checking workflow
@@ -481,15 +513,40 @@ ssize_t ServiceManager::handleServiceClientCallback(const std::string& serviceNa
             sendClientCallbackNotifications(serviceName, true);
         }
 
-        // there are no more clients, but the callback has not been called yet
+        // there are no more clients, but the callback has not been called yet. Wait for the
+        // service to be idle long enough first.
         if (!hasClients && service.hasClients) {
-            sendClientCallbackNotifications(serviceName, false);
+            const int64_t now = uptimeMillis();
+            if (service.idleSinceMs == 0) {
+                service.idleSinceMs = now;
+            }
+            if (now - service.idleSinceMs >= getIdleTimeoutMs(serviceName, now)) {
+                sendClientCallbackNotifications(serviceName, false);
+            }
+        }
+
+        if (hasClients || !service.hasClients) {
+            service.idleSinceMs = 0;
         }
     }
 
     return count;
 }
 
+int64_t ServiceManager::getIdleTimeoutMs(const std::string& name, int64_t nowMs) {
+    auto it = mNameToLazyStats.find(name);
+    if (it == mNameToLazyStats.end()) return mIdleTimeoutMs;
+
+    std::deque<int64_t>& starts = it->second.recentStartsMs;
+    while (!starts.empty() && nowMs - starts.front() > kFrequentStartWindowMs) {
+        starts.pop_front();
+    }
+    if (starts.size() >= kFrequentStartCount) {
+        return std::max(mIdleTimeoutMs, kFrequentIdleTimeoutMs);
+    }
+    return mIdleTimeoutMs;
+}
+
 void ServiceManager::sendClientCallbackNotifications(const std::string& serviceName, bool hasClients) {
     auto serviceIt = mNameToService.find(serviceName);
     if (serviceIt == mNameToService.end()) {
@@ -569,4 +626,113 @@ Status ServiceManager::tryUnregisterService(const std::string& name, const sp<IB
     return Status::ok();
 }
 
+void ServiceManager::recordPendingLookup(const Access::CallingContext& ctx,
+                                         const std::string& name) {
+    if (mServiceWaits.size() >= kMaxServiceWaits) return;
+
+    auto it = mNameToPendingLookups.find(name);
+    if (it == mNameToPendingLookups.end()) {
+        if (mNameToPendingLookups.size() >= kMaxPendingLookupNames) return;
+        it = mNameToPendingLookups.emplace(name, std::vector<PendingLookup>()).first;
+    }
+
+    std::vector<PendingLookup>& lookups = it->second;
+    for (const PendingLookup& lookup : lookups) {
+        // polling clients ask over and over; the first miss is when they started waiting
+        if (lookup.debugPid == ctx.debugPid) return;
+    }
+    if (lookups.size() >= kMaxPendingLookupsPerName) return;
+
+    lookups.push_back(PendingLookup {
+        .debugPid = ctx.debugPid,
+        .uid = ctx.uid,
+        .startMs = uptimeMillis(),
+    });
+}
+
+void ServiceManager::resolvePendingLookups(const std::string& name) {
+    auto it = mNameToPendingLookups.find(name);
+    if (it == mNameToPendingLookups.end()) return;
+
+    const int64_t now = uptimeMillis();
+    for (const PendingLookup& lookup : it->second) {
+        if (mServiceWaits.size() >= kMaxServiceWaits) break;
+        mServiceWaits.push_back(ServiceWait {
+            .name = name,
+            .debugPid = lookup.debugPid,
+            .uid = lookup.uid,
+            .startMs = lookup.startMs,
+            .waitMs = now - lookup.startMs,
+        });
+    }
+    mNameToPendingLookups.erase(it);
+}
+
+void ServiceManager::recordStartRequest(const std::string& name) {
+    auto it = mNameToLazyStats.find(name);
+    if (it == mNameToLazyStats.end()) {
+        if (mNameToLazyStats.size() >= kMaxPendingLookupNames) return;
+        it = mNameToLazyStats.emplace(name, LazyServiceStats()).first;
+    }
+
+    // clients may ask again while the service starts; the first request is when it started
+    if (it->second.startRequestMs == 0) {
+        it->second.startRequestMs = uptimeMillis();
+    }
+}
+
+void ServiceManager::recordStart(const std::string& name) {
+    auto it = mNameToLazyStats.find(name);
+    if (it == mNameToLazyStats.end() || it->second.startRequestMs == 0) return;
+
+    LazyServiceStats& stats = it->second;
+    const int64_t now = uptimeMillis();
+    const int64_t startMs = now - stats.startRequestMs;
+    stats.startRequestMs = 0;
+    stats.startCount++;
+    stats.totalStartMs += startMs;
+    stats.maxStartMs = std::max(stats.maxStartMs, startMs);
+    stats.recentStartsMs.push_back(now);
+    if (stats.recentStartsMs.size() > kFrequentStartCount) {
+        stats.recentStartsMs.pop_front();
+    }
+
+    LOG(INFO) << "Lazy service " << name << " started in " << startMs << " ms";
+}
+
+status_t ServiceManager::dump(int fd, const Vector<String16>& /*args*/) {
+    if (!mAccess->canList(mAccess->getCallingContext())) {
+        return PERMISSION_DENIED;
+    }
+
+    dprintf(fd, "Service waits (uptime ms when the client started waiting):\n");
+    for (const ServiceWait& wait : mServiceWaits) {
+        dprintf(fd, "  %" PRId64 " pid=%d uid=%d waited %" PRId64 " ms for %s\n",
+                wait.startMs, wait.debugPid, wait.uid, wait.waitMs, wait.name.c_str());
+    }
+    if (mServiceWaits.size() >= kMaxServiceWaits) {
+        dprintf(fd, "  (full, later waits not recorded)\n");
+    }
+
+    const int64_t now = uptimeMillis();
+    dprintf(fd, "Still waiting:\n");
+    for (const auto& [name, lookups] : mNameToPendingLookups) {
+        for (const PendingLookup& lookup : lookups) {
+            dprintf(fd, "  %" PRId64 " pid=%d uid=%d waiting %" PRId64 " ms for %s\n",
+                    lookup.startMs, lookup.debugPid, lookup.uid, now - lookup.startMs,
+                    name.c_str());
+        }
+    }
+
+    dprintf(fd, "Lazy service starts:\n");
+    for (const auto& [name, stats] : mNameToLazyStats) {
+        if (stats.startCount == 0) continue;
+        dprintf(fd, "  %s: %zu starts, avg %" PRId64 " ms, max %" PRId64 " ms, idle timeout %"
+                PRId64 " ms\n", name.c_str(), stats.startCount,
+                stats.totalStartMs / static_cast<int64_t>(stats.startCount), stats.maxStartMs,
+                getIdleTimeoutMs(name, now));
+    }
+    return OK;
+}
+
 }  // namespace android
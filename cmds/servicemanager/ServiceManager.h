@@ -20,6 +20,8 @@
 #include <android/os/IClientCallback.h>
 #include <android/os/IServiceCallback.h>
 
+#include <deque>
+
 #include "Access.h"
 
 namespace android {
@@ -50,6 +52,9 @@ public:
     void binderDied(const wp<IBinder>& who) override;
     void handleClientCallbacks();
 
+    // Prints which clients waited how long for which service.
+    status_t dump(int fd, const Vector<String16>& args) override;
+
 protected:
     virtual void tryStartService(const std::string& name);
 
@@ -60,6 +65,7 @@ private:
         int32_t dumpPriority;
         bool hasClients = false; // notifications sent on true -> false.
         bool guaranteeClient = false; // forces the client check to true
+        int64_t idleSinceMs = 0; // when the client check first found no clients, or 0
         pid_t debugPid = 0; // the process in which this service runs
 
         // the number of clients of the service, including servicemanager itself
@@ -76,6 +82,8 @@ private:
                         ServiceCallbackMap::iterator* it,
                         bool* found);
     ssize_t handleServiceClientCallback(const std::string& serviceName, bool isCalledOnInterval);
+    // How long a service must be without clients before it is told so.
+    int64_t getIdleTimeoutMs(const std::string& name, int64_t nowMs);
      // Also updates mHasClients (of what the last callback was)
     void sendClientCallbackNotifications(const std::string& serviceName, bool hasClients);
     // removes a callback from mNameToClientCallback, deleting the entry if the vector is empty
@@ -84,7 +92,42 @@ private:
 
     sp<IBinder> tryGetService(const std::string& name, bool startIfNotFound);
 
+    // A client asked for a service that is not registered yet.
+    struct PendingLookup {
+        pid_t debugPid;
+        uid_t uid;
+        int64_t startMs;
+    };
+    // A pending lookup that was satisfied by addService.
+    struct ServiceWait {
+        std::string name;
+        pid_t debugPid;
+        uid_t uid;
+        int64_t startMs;
+        int64_t waitMs;
+    };
+    void recordPendingLookup(const Access::CallingContext& ctx, const std::string& name);
+    void resolvePendingLookups(const std::string& name);
+
+    // Starts of a lazy service, kept across its restarts.
+    struct LazyServiceStats {
+        int64_t startRequestMs = 0; // when a pending start was requested, or 0
+        size_t startCount = 0;
+        int64_t totalStartMs = 0;
+        int64_t maxStartMs = 0;
+        std::deque<int64_t> recentStartsMs; // the starts within kFrequentStartWindowMs
+    };
+    void recordStartRequest(const std::string& name);
+    void recordStart(const std::string& name);
+
     ServiceMap mNameToService;
+    std::map<std::string, std::vector<PendingLookup>> mNameToPendingLookups;
+    // In the order services were added, so the early entries form the boot
+    // critical path. Stops growing once full.
+    std::vector<ServiceWait> mServiceWaits;
+    std::map<std::string, LazyServiceStats> mNameToLazyStats;
+    // Time a service must be without clients before it is told so, at least.
+    int64_t mIdleTimeoutMs;
     ServiceCallbackMap mNameToRegistrationCallback;
     ClientCallbackMap mNameToClientCallback;
 
@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include <android-base/file.h>
 #include <android/os/BnServiceCallback.h>
 #include <binder/Binder.h>
 #include <binder/ProcessState.h>
@@ -21,6 +22,7 @@
 #include <cutils/android_filesystem_config.h>
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
+#include <unistd.h>
 
 #include "Access.h"
 #include "ServiceManager.h"
@@ -35,6 +37,7 @@ using android::os::BnServiceCallback;
 using android::os::IServiceManager;
 using testing::_;
 using testing::ElementsAre;
+using testing::HasSubstr;
 using testing::NiceMock;
 using testing::Return;
 
@@ -447,3 +450,23 @@ TEST(ServiceNotifications, GetMultipleNotification) {
     EXPECT_THAT(cb->registrations, ElementsAre("asdfasdf", "asdfasdf"));
     EXPECT_THAT(cb->registrations, ElementsAre("asdfasdf", "asdfasdf"));
 }
+
+TEST(LazyServices, StartIsRecorded) {
+    auto sm = getPermissiveServiceManager();
+
+    sp<IBinder> out;
+    EXPECT_TRUE(sm->getService("foo", &out).isOk());
+    EXPECT_EQ(nullptr, out.get());
+    EXPECT_TRUE(sm->addService("foo", getBinder(), false /*allowIsolated*/,
+        IServiceManager::DUMP_FLAG_PRIORITY_DEFAULT).isOk());
+
+    int fds[2];
+    ASSERT_EQ(0, pipe(fds));
+    EXPECT_EQ(android::OK, sm->dump(fds[1], {}));
+    close(fds[1]);
+    std::string dump;
+    EXPECT_TRUE(android::base::ReadFdToString(fds[0], &dump));
+    close(fds[0]);
+
+    EXPECT_THAT(dump, HasSubstr("foo: 1 starts"));
+}
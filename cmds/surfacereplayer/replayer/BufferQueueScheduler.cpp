@@ -19,12 +19,20 @@
 
 #include <android/native_window.h>
 #include <gui/Surface.h>
+#include <system/window.h>
+#include <ui/PixelFormat.h>
+
+#include <cstring>
 
 using namespace android;
 
-BufferQueueScheduler::BufferQueueScheduler(
-        const sp<SurfaceControl>& surfaceControl, const HSV& color, int id)
-      : mSurfaceControl(surfaceControl), mColor(color), mSurfaceId(id), mContinueScheduling(true) {}
+BufferQueueScheduler::BufferQueueScheduler(const sp<SurfaceControl>& surfaceControl,
+        const HSV& color, int id, FrameStats* frameStats)
+      : mSurfaceControl(surfaceControl),
+        mColor(color),
+        mSurfaceId(id),
+        mContinueScheduling(true),
+        mFrameStats(frameStats) {}
 
 void BufferQueueScheduler::startScheduling() {
     ALOGV("Starting Scheduler for %d Layer", mSurfaceId);
@@ -42,7 +50,7 @@ void BufferQueueScheduler::startScheduling() {
             BufferEvent event = mBufferEvents.front();
             lock.unlock();
 
-            bufferUpdate(event.dimensions);
+            bufferUpdate(event.dimensions, event.format);
             fillSurface(event.event);
             mColor.modulate();
             lock.lock();
@@ -72,15 +80,53 @@ void BufferQueueScheduler::setSurfaceControl(
     mCondition.notify_one();
 }
 
-void BufferQueueScheduler::bufferUpdate(const Dimensions& dimensions) {
+void BufferQueueScheduler::collectFrameStats(bool final) {
+    if (mFrameStats == nullptr) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mPostedFramesMutex);
+    // Buffers are presented in the order they were posted, so stop at the first pending one.
+    while (!mPostedFrames.empty()) {
+        const PostedFrame& frame = mPostedFrames.front();
+        nsecs_t latchTime = FrameEvents::TIMESTAMP_PENDING;
+        nsecs_t presentTime = FrameEvents::TIMESTAMP_PENDING;
+        status_t status = frame.surface->getFrameTimestamps(frame.frameNumber, nullptr, nullptr,
+                &latchTime, nullptr, nullptr, nullptr, &presentTime, nullptr, nullptr);
+
+        if (status != NO_ERROR) {
+            // The frame has fallen out of the producer's history.
+            mFrameStats->addUnknownFrame();
+        } else if (presentTime == FrameEvents::TIMESTAMP_PENDING) {
+            if (!final) {
+                break;
+            }
+            mFrameStats->addUnknownFrame();
+        } else if (presentTime == NATIVE_WINDOW_TIMESTAMP_INVALID) {
+            mFrameStats->addDroppedFrame();
+        } else {
+            mFrameStats->addPresentedFrame(frame.postTime, latchTime, presentTime);
+        }
+        mPostedFrames.pop_front();
+    }
+}
+
+void BufferQueueScheduler::bufferUpdate(const Dimensions& dimensions, int format) {
     sp<Surface> s = mSurfaceControl->getSurface();
     s->setBuffersDimensions(dimensions.width, dimensions.height);
+    if (format != 0) {
+        s->setBuffersFormat(format);
+    }
 }
 
 void BufferQueueScheduler::fillSurface(const std::shared_ptr<Event>& event) {
     ANativeWindow_Buffer outBuffer;
     sp<Surface> s = mSurfaceControl->getSurface();
 
+    if (mFrameStats != nullptr) {
+        s->enableFrameTimestamps(true);
+    }
+
     status_t status = s->lock(&outBuffer, nullptr);
 
     if (status != NO_ERROR) {
@@ -91,19 +137,35 @@ void BufferQueueScheduler::fillSurface(const std::shared_ptr<Event>& event) {
     auto color = mColor.getRGB();
 
     auto img = reinterpret_cast<uint8_t*>(outBuffer.bits);
-    for (int y = 0; y < outBuffer.height; y++) {
-        for (int x = 0; x < outBuffer.width; x++) {
-            uint8_t* pixel = img + (4 * (y * outBuffer.stride + x));
-            pixel[0] = color.r;
-            pixel[1] = color.g;
-            pixel[2] = color.b;
-            pixel[3] = LAYER_ALPHA;
+    const size_t bpp = bytesPerPixel(outBuffer.format);
+    if (bpp == 4) {
+        for (int y = 0; y < outBuffer.height; y++) {
+            for (int x = 0; x < outBuffer.width; x++) {
+                uint8_t* pixel = img + (4 * (y * outBuffer.stride + x));
+                pixel[0] = color.r;
+                pixel[1] = color.g;
+                pixel[2] = color.b;
+                pixel[3] = LAYER_ALPHA;
+            }
         }
+    } else if (bpp > 0) {
+        // Other formats from the trace are filled with a flat grey.
+        memset(img, 0x80, bpp * outBuffer.stride * outBuffer.height);
     }
 
     event->readyToExecute();
 
+    const uint64_t frameNumber = s->getNextFrameNumber();
+    const nsecs_t postTime = systemTime();
     status = s->unlockAndPost();
 
     ALOGE_IF(status != NO_ERROR, "fillSurface: failed to unlock and post buffer, (%d)", status);
+
+    if (mFrameStats != nullptr && status == NO_ERROR) {
+        {
+            std::lock_guard<std::mutex> lock(mPostedFramesMutex);
+            mPostedFrames.push_back({s, frameNumber, postTime});
+        }
+        collectFrameStats(false);
+    }
 }
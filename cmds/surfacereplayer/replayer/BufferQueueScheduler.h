@@ -19,13 +19,16 @@
 
 #include "Color.h"
 #include "Event.h"
+#include "FrameStats.h"
 
+#include <gui/Surface.h>
 #include <gui/SurfaceControl.h>
 
 #include <utils/StrongPointer.h>
 
 #include <atomic>
 #include <condition_variable>
+#include <deque>
 #include <mutex>
 #include <queue>
 #include <utility>
@@ -44,15 +47,19 @@ struct Dimensions {
 
 struct BufferEvent {
     BufferEvent() = default;
-    BufferEvent(std::shared_ptr<Event> e, Dimensions d) : event(e), dimensions(d) {}
+    BufferEvent(std::shared_ptr<Event> e, Dimensions d, int f = 0)
+          : event(e), dimensions(d), format(f) {}
 
     std::shared_ptr<Event> event;
     Dimensions dimensions;
+    int format = 0;  // 0 if the trace does not record the format
 };
 
 class BufferQueueScheduler {
   public:
-    BufferQueueScheduler(const sp<SurfaceControl>& surfaceControl, const HSV& color, int id);
+    // If frameStats is set the timing of every posted buffer is reported to it.
+    BufferQueueScheduler(const sp<SurfaceControl>& surfaceControl, const HSV& color, int id,
+            FrameStats* frameStats = nullptr);
 
     void startScheduling();
     void addEvent(const BufferEvent&);
@@ -60,8 +67,12 @@ class BufferQueueScheduler {
 
     void setSurfaceControl(const sp<SurfaceControl>& surfaceControl, const HSV& color);
 
+    // Reports the posted buffers whose timestamps are available. If final is set, buffers which
+    // are still pending are reported as unknown.
+    void collectFrameStats(bool final);
+
   private:
-    void bufferUpdate(const Dimensions& dimensions);
+    void bufferUpdate(const Dimensions& dimensions, int format);
 
     // Lock and fill the surface, block until the event is signaled by the main loop,
     // then unlock and post the buffer.
@@ -73,6 +84,15 @@ class BufferQueueScheduler {
 
     bool mContinueScheduling;
 
+    FrameStats* const mFrameStats;
+    struct PostedFrame {
+        sp<Surface> surface;
+        uint64_t frameNumber;
+        nsecs_t postTime;
+    };
+    std::mutex mPostedFramesMutex;
+    std::deque<PostedFrame> mPostedFrames;
+
     std::queue<BufferEvent> mBufferEvents;
     std::mutex mMutex;
     std::condition_variable mCondition;
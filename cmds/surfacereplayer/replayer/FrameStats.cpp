@@ -0,0 +1,98 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "FrameStats.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <map>
+
+using namespace android;
+
+namespace {
+
+double toMs(nsecs_t time) {
+    return static_cast<double>(time) / 1e6;
+}
+
+void dumpPercentiles(std::ostream& out, const char* name, std::vector<nsecs_t>& latencies) {
+    if (latencies.empty()) {
+        return;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](size_t p) { return latencies[(latencies.size() - 1) * p / 100]; };
+    out << "  " << name << " (ms): p50 " << toMs(percentile(50)) << ", p90 "
+        << toMs(percentile(90)) << ", p99 " << toMs(percentile(99)) << ", max "
+        << toMs(latencies.back()) << "\n";
+}
+
+}  // namespace
+
+void FrameStats::addPresentedFrame(nsecs_t postTime, nsecs_t latchTime, nsecs_t presentTime) {
+    std::lock_guard<std::mutex> lock(mLock);
+    if (latchTime >= postTime) {
+        mLatchLatencies.push_back(latchTime - postTime);
+    }
+    mPresentLatencies.push_back(presentTime - postTime);
+}
+
+void FrameStats::addDroppedFrame() {
+    std::lock_guard<std::mutex> lock(mLock);
+    mDroppedFrames++;
+}
+
+void FrameStats::addUnknownFrame() {
+    std::lock_guard<std::mutex> lock(mLock);
+    mUnknownFrames++;
+}
+
+void FrameStats::dump(std::ostream& out, nsecs_t vsyncPeriod) {
+    std::lock_guard<std::mutex> lock(mLock);
+
+    out << std::fixed << std::setprecision(2);
+    out << "Frame statistics (vsync period " << toMs(vsyncPeriod) << "ms):\n";
+    out << "  presented " << mPresentLatencies.size() << ", dropped " << mDroppedFrames
+        << ", unknown " << mUnknownFrames << "\n";
+
+    // Count how many vsyncs each frame took from being posted to being presented. Frames which
+    // took longer than the most common count missed the vsync they would normally have made.
+    std::map<nsecs_t, size_t> histogram;
+    for (nsecs_t latency : mPresentLatencies) {
+        histogram[(latency + vsyncPeriod - 1) / vsyncPeriod]++;
+    }
+    const auto typical = std::max_element(histogram.begin(), histogram.end(),
+                                          [](const auto& a, const auto& b) {
+                                              return a.second < b.second;
+                                          });
+    size_t jankyFrames = 0;
+    for (auto it = typical; it != histogram.end(); it++) {
+        if (it != typical) {
+            jankyFrames += it->second;
+        }
+    }
+
+    dumpPercentiles(out, "post to latch", mLatchLatencies);
+    dumpPercentiles(out, "post to present", mPresentLatencies);
+    for (const auto& [vsyncs, count] : histogram) {
+        out << "  " << vsyncs << " vsync(s): " << count << "\n";
+    }
+    out << "  janky " << jankyFrames;
+    if (!mPresentLatencies.empty()) {
+        out << " (" << 100.0 * jankyFrames / mPresentLatencies.size() << "%)";
+    }
+    out << std::endl;
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef ANDROID_SURFACEREPLAYER_FRAMESTATS_H
+#define ANDROID_SURFACEREPLAYER_FRAMESTATS_H
+
+#include <utils/Timers.h>
+
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+namespace android {
+
+// Collects the SurfaceFlinger timing of every buffer posted during a benchmark replay.
+class FrameStats {
+  public:
+    // Adds a frame which was presented. Times are in the SYSTEM_TIME_MONOTONIC base.
+    void addPresentedFrame(nsecs_t postTime, nsecs_t latchTime, nsecs_t presentTime);
+    // Adds a frame which SurfaceFlinger dropped without presenting.
+    void addDroppedFrame();
+    // Adds a frame whose timestamps could not be retrieved.
+    void addUnknownFrame();
+
+    // Prints latency percentiles and how many frames missed the vsync most frames hit.
+    void dump(std::ostream& out, nsecs_t vsyncPeriod);
+
+  private:
+    std::mutex mLock;
+    std::vector<nsecs_t> mLatchLatencies;
+    std::vector<nsecs_t> mPresentLatencies;
+    size_t mDroppedFrames = 0;
+    size_t mUnknownFrames = 0;
+};
+
+}  // namespace android
+#endif
@@ -28,12 +28,19 @@
 #include <gui/Surface.h>
 #include <private/gui/ComposerService.h>
 
+#include <ui/DisplayConfig.h>
 #include <ui/DisplayInfo.h>
 #include <utils/Log.h>
 #include <utils/String8.h>
 #include <utils/Trace.h>
 
+#include <poll.h>
+#include <time.h>
+#include <zlib.h>
+
+#include <algorithm>
 #include <chrono>
+#include <cinttypes>
 #include <cmath>
 #include <condition_variable>
 #include <cstdlib>
@@ -50,19 +57,35 @@ using namespace android;
 
 std::atomic_bool Replayer::sReplayingManually(false);
 
+// Reads a trace written by SurfaceInterceptor, which may be gzip-compressed. zlib passes
+// uncompressed files through unchanged.
+static bool readTraceFile(const std::string& filename, std::string* output) {
+    gzFile file = gzopen(filename.c_str(), "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    char buffer[64 * 1024];
+    int read;
+    while ((read = gzread(file, buffer, sizeof(buffer))) > 0) {
+        output->append(buffer, static_cast<size_t>(read));
+    }
+    return gzclose(file) == Z_OK && read == 0;
+}
+
 Replayer::Replayer(const std::string& filename, bool replayManually, int numThreads, bool wait,
-        nsecs_t stopHere)
+        nsecs_t stopHere, bool benchmark)
       : mTrace(),
         mLoaded(false),
         mIncrementIndex(0),
         mCurrentTime(0),
         mNumThreads(numThreads),
         mWaitForTimeStamps(wait),
-        mStopTimeStamp(stopHere) {
+        mStopTimeStamp(stopHere),
+        mBenchmark(benchmark) {
     srand(RAND_COLOR_SEED);
 
     std::string input;
-    if (!android::base::ReadFileToString(filename, &input, true)) {
+    if (!readTraceFile(filename, &input)) {
         std::cerr << "Trace did not load. Does " << filename << " exist?" << std::endl;
         abort();
     }
@@ -82,14 +105,16 @@ Replayer::Replayer(const std::string& filename, bool replayManually, int numThre
     }
 }
 
-Replayer::Replayer(const Trace& t, bool replayManually, int numThreads, bool wait, nsecs_t stopHere)
+Replayer::Replayer(const Trace& t, bool replayManually, int numThreads, bool wait, nsecs_t stopHere,
+        bool benchmark)
       : mTrace(t),
         mLoaded(true),
         mIncrementIndex(0),
         mCurrentTime(0),
         mNumThreads(numThreads),
         mWaitForTimeStamps(wait),
-        mStopTimeStamp(stopHere) {
+        mStopTimeStamp(stopHere),
+        mBenchmark(benchmark) {
     srand(RAND_COLOR_SEED);
     mCurrentTime = mTrace.increment(0).time_stamp();
 
@@ -112,7 +137,15 @@ status_t Replayer::replay() {
         return status;
     }
 
-    SurfaceComposerClient::enableVSyncInjections(true);
+    if (mBenchmark) {
+        status = alignToVSync();
+        if (status != NO_ERROR) {
+            ALOGE("Couldn't align the replay to vsync (%d)", status);
+            return status;
+        }
+    } else {
+        SurfaceComposerClient::enableVSyncInjections(true);
+    }
 
     initReplay();
 
@@ -128,7 +161,11 @@ status_t Replayer::replay() {
         waitForConsoleCommmand();
 
         if (mWaitForTimeStamps) {
-            waitUntilTimestamp(mCurrentIncrement.time_stamp());
+            if (mBenchmark) {
+                waitUntilReplayTime(mCurrentIncrement.time_stamp());
+            } else {
+                waitUntilTimestamp(mCurrentIncrement.time_stamp());
+            }
         }
 
         auto event = mPendingIncrements.front();
@@ -153,7 +190,11 @@ status_t Replayer::replay() {
         mCurrentTime = mCurrentIncrement.time_stamp();
     }
 
-    SurfaceComposerClient::enableVSyncInjections(false);
+    if (mBenchmark) {
+        reportFrameStats();
+    } else {
+        SurfaceComposerClient::enableVSyncInjections(false);
+    }
 
     return status;
 }
@@ -291,12 +332,13 @@ status_t Replayer::dispatchEvent(int index) {
             std::lock_guard<std::mutex> lock2(mBufferQueueSchedulerLock);
 
             Dimensions dimensions(increment.buffer_update().w(), increment.buffer_update().h());
-            BufferEvent bufferEvent(event, dimensions);
+            BufferEvent bufferEvent(event, dimensions, increment.buffer_update().format());
 
             auto layerId = increment.buffer_update().id();
             if (mBufferQueueSchedulers.count(layerId) == 0) {
                 mBufferQueueSchedulers[layerId] = std::make_shared<BufferQueueScheduler>(
-                        mLayers[layerId], mColors[layerId], layerId);
+                        mLayers[layerId], mColors[layerId], layerId,
+                        mBenchmark ? &mFrameStats : nullptr);
                 mBufferQueueSchedulers[layerId]->addEvent(bufferEvent);
 
                 std::thread(&BufferQueueScheduler::startScheduling,
@@ -653,7 +695,10 @@ status_t Replayer::injectVSyncEvent(
 
     event->readyToExecute();
 
-    SurfaceComposerClient::injectVSync(vSyncEvent.when());
+    // Benchmarks run on the real vsync; the captured ones only anchor the schedule.
+    if (!mBenchmark) {
+        SurfaceComposerClient::injectVSync(vSyncEvent.when());
+    }
 
     return NO_ERROR;
 }
@@ -692,6 +737,83 @@ void Replayer::waitUntilTimestamp(int64_t timestamp) {
     std::this_thread::sleep_for(std::chrono::nanoseconds(timestamp - mCurrentTime));
 }
 
+status_t Replayer::alignToVSync() {
+    DisplayEventReceiver receiver;
+    status_t status = receiver.initCheck();
+    if (status != NO_ERROR) {
+        return status;
+    }
+
+    DisplayConfig config;
+    const auto display = SurfaceComposerClient::getInternalDisplayToken();
+    if (display != nullptr &&
+        SurfaceComposerClient::getActiveDisplayConfig(display, &config) == NO_ERROR &&
+        config.refreshRate > 0) {
+        mVSyncPeriod = static_cast<nsecs_t>(1e9f / config.refreshRate);
+    }
+
+    // Land the first captured vsync on a real vsync, so that every increment keeps its phase
+    // relative to the vsyncs it was captured against.
+    mTraceStartTime = mTrace.increment(0).time_stamp();
+    for (const auto& increment : mTrace.increment()) {
+        if (increment.increment_case() == Increment::kVsyncEvent) {
+            mTraceStartTime = increment.time_stamp();
+            break;
+        }
+    }
+
+    const nsecs_t vsyncTime = waitForVSync(receiver);
+    if (vsyncTime < 0) {
+        return TIMED_OUT;
+    }
+
+    // Give the first increment a vsync of headroom to be dispatched.
+    const nsecs_t leadIn = mTraceStartTime - mTrace.increment(0).time_stamp();
+    const nsecs_t earliestStart = systemTime() + mVSyncPeriod + leadIn;
+    const nsecs_t vsyncs = std::max<nsecs_t>(0,
+            (earliestStart - vsyncTime + mVSyncPeriod - 1) / mVSyncPeriod);
+    mReplayStartTime = vsyncTime + vsyncs * mVSyncPeriod;
+
+    ALOGV("Replaying on vsync at %" PRId64 " with a period of %" PRId64, mReplayStartTime,
+            mVSyncPeriod);
+    return NO_ERROR;
+}
+
+nsecs_t Replayer::waitForVSync(DisplayEventReceiver& receiver) {
+    receiver.requestNextVsync();
+
+    pollfd fd = {receiver.getFd(), POLLIN, 0};
+    DisplayEventReceiver::Event event;
+    while (poll(&fd, 1, 1000) > 0) {
+        while (receiver.getEvents(&event, 1) > 0) {
+            if (event.header.type == DisplayEventReceiver::DISPLAY_EVENT_VSYNC) {
+                return event.header.timestamp;
+            }
+        }
+    }
+    return -1;
+}
+
+void Replayer::waitUntilReplayTime(int64_t timestamp) {
+    // Sleep to an absolute time so that errors do not accumulate over long traces.
+    const nsecs_t target = mReplayStartTime + (timestamp - mTraceStartTime);
+    const timespec time = {static_cast<time_t>(target / 1000000000),
+                           static_cast<long>(target % 1000000000)};
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &time, nullptr) == EINTR) {
+    }
+}
+
+void Replayer::reportFrameStats() {
+    // Let the last buffers reach the display before reading back their timestamps.
+    std::this_thread::sleep_for(std::chrono::nanoseconds(mVSyncPeriod * 4));
+
+    std::lock_guard<std::mutex> lock(mBufferQueueSchedulerLock);
+    for (auto& [id, scheduler] : mBufferQueueSchedulers) {
+        scheduler->collectFrameStats(true);
+    }
+    mFrameStats.dump(std::cout, mVSyncPeriod);
+}
+
 void Replayer::waitUntilDeferredTransactionLayerExists(
         const DeferredTransactionChange& dtc, std::unique_lock<std::mutex>& lock) {
     if (mLayers.count(dtc.layer_id()) == 0 || mLayers[dtc.layer_id()] == nullptr) {
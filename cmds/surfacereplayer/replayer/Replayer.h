@@ -20,9 +20,11 @@
 #include "BufferQueueScheduler.h"
 #include "Color.h"
 #include "Event.h"
+#include "FrameStats.h"
 
 #include <frameworks/native/cmds/surfacereplayer/proto/src/trace.pb.h>
 
+#include <gui/DisplayEventReceiver.h>
 #include <gui/SurfaceComposerClient.h>
 #include <gui/SurfaceControl.h>
 
@@ -45,6 +47,7 @@ namespace android {
 const auto DEFAULT_PATH = "/data/local/tmp/SurfaceTrace.dat";
 const auto RAND_COLOR_SEED = 700;
 const auto DEFAULT_THREADS = 3;
+const nsecs_t DEFAULT_VSYNC_PERIOD = 16666667;
 
 typedef int32_t layer_id;
 typedef int32_t display_id;
@@ -54,10 +57,14 @@ typedef google::protobuf::RepeatedPtrField<DisplayChange> DisplayChanges;
 
 class Replayer {
   public:
+    // In benchmark mode the trace is replayed on the real vsync rather than on injected vsyncs,
+    // every increment is scheduled at its original offset from the first captured vsync, and
+    // per-frame SurfaceFlinger latency statistics are printed once the replay finishes.
     Replayer(const std::string& filename, bool replayManually = false,
-            int numThreads = DEFAULT_THREADS, bool wait = true, nsecs_t stopHere = -1);
+            int numThreads = DEFAULT_THREADS, bool wait = true, nsecs_t stopHere = -1,
+            bool benchmark = false);
     Replayer(const Trace& trace, bool replayManually = false, int numThreads = DEFAULT_THREADS,
-            bool wait = true, nsecs_t stopHere = -1);
+            bool wait = true, nsecs_t stopHere = -1, bool benchmark = false);
 
     status_t replay();
 
@@ -133,6 +140,12 @@ class Replayer {
             display_id id, const ProjectionChange& pc);
 
     void waitUntilTimestamp(int64_t timestamp);
+
+    // Benchmark mode
+    status_t alignToVSync();
+    nsecs_t waitForVSync(DisplayEventReceiver& receiver);
+    void waitUntilReplayTime(int64_t timestamp);
+    void reportFrameStats();
     void waitUntilDeferredTransactionLayerExists(
             const DeferredTransactionChange& dtc, std::unique_lock<std::mutex>& lock);
     status_t loadSurfaceComposerClient();
@@ -153,6 +166,14 @@ class Replayer {
     nsecs_t mStopTimeStamp;
     bool mHasStopped;
 
+    bool mBenchmark = false;
+    nsecs_t mVSyncPeriod = DEFAULT_VSYNC_PERIOD;
+    // The trace timestamp mTraceStartTime is replayed at mReplayStartTime, which is in the
+    // SYSTEM_TIME_MONOTONIC base
+    int64_t mTraceStartTime = 0;
+    nsecs_t mReplayStartTime = 0;
+    FrameStats mFrameStats;
+
     std::mutex mLayerLock;
     std::condition_variable mLayerCond;
     std::unordered_map<layer_id, sp<SurfaceControl>> mLayers;
@@ -19,12 +19,51 @@
 #define __LIBDISKUSAGE_DIRSIZE_H
 
 #include <stdint.h>
+#include <sys/cdefs.h>
+#include <sys/types.h>
 
 __BEGIN_DECLS
 
 int64_t stat_size(struct stat *s);
 int64_t calculate_dir_size(int dfd);
 
+/* An entry found by calculate_dir_size_parallel. */
+struct dir_size_entry {
+    /* Directory containing the entry, and its name in that directory. */
+    int parent_fd;
+    const char *name;
+    /* Only the type bits are set if no callback is given. */
+    mode_t mode;
+    uid_t uid;
+    gid_t gid;
+    /* Allocated size, in bytes. */
+    int64_t size;
+};
+
+/* Returned by a dir_size_callback to not count an entry, but still traverse it. */
+#define DIR_SIZE_IGNORE (-1)
+/* Returned by a dir_size_callback to neither count nor traverse an entry. */
+#define DIR_SIZE_PRUNE (-2)
+
+/* Don't traverse directories on another device than their parent, like FTS_XDEV. */
+#define DIR_SIZE_XDEV 0x1
+
+/*
+ * Returns the index of the category an entry is counted in, or DIR_SIZE_IGNORE or
+ * DIR_SIZE_PRUNE. Called concurrently from several threads.
+ */
+typedef int (*dir_size_callback)(const struct dir_size_entry *entry, void *cookie);
+
+/*
+ * Like calculate_dir_size, but traverses the tree from num_threads threads, or one per CPU if
+ * num_threads is 0. Threads which run out of directories take the oldest ones queued by the
+ * others, which are the largest subtrees left. The size of each entry is added to
+ * sizes[category], with the category returned by the callback, or 0 if it is NULL. Takes
+ * ownership of dfd. Returns 0, or -1 with errno set if the traversal couldn't be started.
+ */
+int calculate_dir_size_parallel(int dfd, int num_threads, int flags, dir_size_callback callback,
+                                void *cookie, int64_t *sizes, int num_categories);
+
 __END_DECLS
 
 #endif /* __LIBDISKUSAGE_DIRSIZE_H */
@@ -37,6 +37,15 @@ public:
 
     virtual void setInputWindows(const std::vector<InputWindowInfo>& inputHandles,
             const sp<ISetInputWindowsListener>& setInputWindowsListener) = 0;
+    /*
+     * Updates the windows set by the previous setInputWindows() or updateInputWindows() call.
+     * changedWindows holds the windows which were added or changed since, and windowIds the id
+     * of every window in the order setInputWindows() would have been given them. Windows whose
+     * id is not in windowIds are removed.
+     */
+    virtual void updateInputWindows(const std::vector<InputWindowInfo>& changedWindows,
+            const std::vector<int32_t>& windowIds,
+            const sp<ISetInputWindowsListener>& setInputWindowsListener) = 0;
     virtual void registerInputChannel(const sp<InputChannel>& channel) = 0;
     virtual void unregisterInputChannel(const sp<InputChannel>& channel) = 0;
 };
@@ -50,7 +59,8 @@ public:
     enum {
         SET_INPUT_WINDOWS_TRANSACTION = IBinder::FIRST_CALL_TRANSACTION,
         REGISTER_INPUT_CHANNEL_TRANSACTION,
-        UNREGISTER_INPUT_CHANNEL_TRANSACTION
+        UNREGISTER_INPUT_CHANNEL_TRANSACTION,
+        UPDATE_INPUT_WINDOWS_TRANSACTION
     };
 
     virtual status_t onTransact(uint32_t code, const Parcel& data,
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LIBINPUT_INPUT_MESSAGE_RING_H
+#define _LIBINPUT_INPUT_MESSAGE_RING_H
+
+#include <android-base/unique_fd.h>
+#include <utils/Errors.h>
+
+#include <memory>
+#include <string>
+
+namespace android {
+
+struct InputMessage;
+
+/*
+ * Shared memory transport for an InputChannel pair.
+ *
+ * The region holds two single-producer single-consumer rings of InputMessages, one per
+ * direction. The server side of the pair writes events into the first ring and reads finished
+ * signals from the second; the client side does the opposite. Writing and reading a message
+ * takes no system call. The channel's socket is kept as a doorbell: a writer only sends a
+ * wake-up byte over it when the reader has drained its ring and said that it is about to go
+ * back to polling the socket. It also still reports the peer going away.
+ *
+ * The peer can write to the whole region, so every index and message read from it is
+ * validated before use.
+ */
+class InputMessageRing {
+public:
+    // Number of messages each direction can hold before writes return WOULD_BLOCK.
+    static constexpr uint32_t SLOT_COUNT = 16;
+
+    enum class Side { SERVER, CLIENT };
+
+    /* Creates a new, empty region. Returns nullptr if shared memory is unavailable. */
+    static std::shared_ptr<InputMessageRing> create(const std::string& name);
+
+    /* Maps a region created by create() in this or another process, e.g. one received
+     * over binder. Returns nullptr if the fd does not refer to a valid region. */
+    static std::shared_ptr<InputMessageRing> map(android::base::unique_fd fd);
+
+    ~InputMessageRing();
+
+    inline int getFd() const { return mFd.get(); }
+
+    /* Appends the first 'size' bytes of 'msg' to the ring this side writes.
+     * Sets *outWakePeer if the reader is waiting on the socket and needs a wake-up byte.
+     *
+     * Return OK on success.
+     * Return WOULD_BLOCK if the ring is full.
+     * Return BAD_VALUE if the peer corrupted the ring.
+     */
+    status_t write(Side side, const InputMessage& msg, size_t size, bool* outWakePeer);
+
+    /* Takes the next message from the ring this side reads.
+     * If the ring is empty, records that this side is about to wait on the socket, so that
+     * the next write sends a wake-up byte.
+     *
+     * Return OK on success.
+     * Return WOULD_BLOCK if the ring is empty.
+     * Return BAD_VALUE if the peer corrupted the ring or sent an invalid message.
+     */
+    status_t read(Side side, InputMessage* msg);
+
+private:
+    struct Region;
+
+    InputMessageRing(android::base::unique_fd fd, Region* region);
+
+    android::base::unique_fd mFd;
+    Region* mRegion;
+};
+
+} // namespace android
+
+#endif // _LIBINPUT_INPUT_MESSAGE_RING_H
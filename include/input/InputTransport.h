@@ -29,12 +29,16 @@
  * The InputConsumer is used by the application to receive events from the input dispatcher.
  */
 
+#include <memory>
 #include <string>
+#include <vector>
 
 #include <android-base/chrono_utils.h>
 
 #include <binder/IBinder.h>
 #include <input/Input.h>
+#include <input/InputMessageRing.h>
+#include <input/VelocityTracker.h>
 #include <utils/BitSet.h>
 #include <utils/Errors.h>
 #include <utils/RefBase.h>
@@ -65,8 +69,12 @@ struct InputMessage {
         MOTION,
         FINISHED,
         FOCUS,
+        FINISHED_BATCH,
     };
 
+    /* Maximum number of sequence numbers acknowledged by one FINISHED_BATCH message. */
+    static constexpr size_t MAX_FINISHED_BATCH_SEQS = 32;
+
     struct Header {
         Type type; // 4 bytes
         // We don't need this field in order to align the body below but we
@@ -167,6 +175,21 @@ struct InputMessage {
 
             inline size_t size() const { return sizeof(Focus); }
         } focus;
+
+        struct FinishedBatch {
+            uint32_t handled; // actually a bool
+            uint32_t seqCount;
+            /**
+             * Like the motion "pointers" field, only the first seqCount entries are sent,
+             * so this must remain the last field of the struct.
+             */
+            uint32_t seqs[MAX_FINISHED_BATCH_SEQS];
+
+            inline size_t size() const {
+                return sizeof(FinishedBatch) -
+                        sizeof(uint32_t) * (MAX_FINISHED_BATCH_SEQS - seqCount);
+            }
+        } finishedBatch;
     } __attribute__((aligned(8))) body;
 
     bool isValid(size_t actualSize) const;
@@ -200,9 +223,25 @@ public:
     static status_t openInputChannelPair(const std::string& name,
             sp<InputChannel>& outServerChannel, sp<InputChannel>& outClientChannel);
 
+    /**
+     * Same as above, but lets the caller choose the transport instead of following the
+     * ro.input.shared_memory_channels property.
+     * With useSharedMemory, messages travel through an InputMessageRing and the socket is only
+     * used to wake up the peer. If shared memory is unavailable, the pair falls back to
+     * plain sockets; check usesSharedMemory() to tell.
+     */
+    static status_t openInputChannelPair(const std::string& name,
+            sp<InputChannel>& outServerChannel, sp<InputChannel>& outClientChannel,
+            bool useSharedMemory);
+
     inline std::string getName() const { return mName; }
     inline int getFd() const { return mFd.get(); }
 
+    /* Returns true if messages travel through shared memory rather than through the socket.
+     * In that case, readers must keep calling receiveMessage() until it returns WOULD_BLOCK
+     * before waiting for the fd to become readable again. */
+    inline bool usesSharedMemory() const { return mRing != nullptr; }
+
     /* Send a message to the other endpoint.
      *
      * If the channel is full then the message is guaranteed not to have been sent at all.
@@ -249,11 +288,23 @@ public:
     sp<IBinder> getConnectionToken() const;
 
 private:
-    InputChannel(const std::string& name, android::base::unique_fd fd, sp<IBinder> token);
+    static sp<InputChannel> create(const std::string& name, android::base::unique_fd fd,
+                                   sp<IBinder> token, std::shared_ptr<InputMessageRing> ring,
+                                   InputMessageRing::Side ringSide);
+    InputChannel(const std::string& name, android::base::unique_fd fd, sp<IBinder> token,
+                 std::shared_ptr<InputMessageRing> ring, InputMessageRing::Side ringSide);
+
+    status_t sendWakeSignal();
+    status_t drainWakeSignals();
+
     std::string mName;
     android::base::unique_fd mFd;
 
     sp<IBinder> mToken;
+
+    // Set when messages travel through shared memory; see openInputChannelPair().
+    std::shared_ptr<InputMessageRing> mRing;
+    InputMessageRing::Side mRingSide;
 };
 
 /*
@@ -324,9 +375,26 @@ public:
      */
     status_t receiveFinishedSignal(uint32_t* outSeq, bool* outHandled);
 
+    /* Receives the next finished message from the consumer, which may acknowledge several
+     * dispatched messages at once. Appends their sequence numbers to outSeqs, oldest first,
+     * and reports whether the consumer handled them; all of them share the same answer.
+     *
+     * Returns OK on success.
+     * Returns WOULD_BLOCK if there is no signal present.
+     * Returns DEAD_OBJECT if the channel's peer has been closed.
+     * Other errors probably indicate that the channel is broken.
+     */
+    status_t receiveFinishedSignals(std::vector<uint32_t>* outSeqs, bool* outHandled);
+
 private:
 
     sp<InputChannel> mChannel;
+
+    // Sequence numbers of a batched finished message not yet returned by
+    // receiveFinishedSignal(), oldest first.
+    std::vector<uint32_t> mPendingFinishedSeqs;
+    size_t mPendingFinishedIndex;
+    bool mPendingFinishedHandled;
 };
 
 /*
@@ -343,6 +411,24 @@ public:
     /* Gets the underlying input channel. */
     inline sp<InputChannel> getChannel() { return mChannel; }
 
+    /* Ways of resampling touch events to the frame time. */
+    enum class ResampleStrategy {
+        /* Interpolate between, or extrapolate from, the two most recent samples. */
+        LINEAR,
+        /* Extrapolate with a least-squares fit over the recent samples of each pointer,
+         * predicting where the touch will be when the frame is presented. */
+        PREDICTIVE,
+    };
+
+    /* Sets how touches are resampled for the window this consumer belongs to.
+     *
+     * presentLatency is how long after the frame time the frame is expected to reach
+     * the display; the PREDICTIVE strategy aims its prediction at that point.
+     * Takes effect from the next ACTION_DOWN. Has no effect if touch resampling is
+     * disabled on the device.
+     */
+    void setResampleStrategy(ResampleStrategy strategy, nsecs_t presentLatency = 0);
+
     /* Consumes an input event from the input channel and copies its contents into
      * an InputEvent object created using the specified factory.
      *
@@ -415,6 +501,10 @@ private:
     // True if touch resampling is enabled.
     const bool mResampleTouch;
 
+    // How touches are resampled, see setResampleStrategy().
+    ResampleStrategy mResampleStrategy;
+    nsecs_t mPresentLatency;
+
     // The input channel.
     sp<InputChannel> mChannel;
 
@@ -476,6 +566,8 @@ private:
         size_t historySize;
         History history[2];
         History lastResample;
+        // Fit over the recent raw samples, only with ResampleStrategy::PREDICTIVE.
+        std::shared_ptr<VelocityTracker> predictor;
 
         void initialize(int32_t deviceId, int32_t source) {
             this->deviceId = deviceId;
@@ -541,6 +633,7 @@ private:
     ssize_t findTouchState(int32_t deviceId, int32_t source) const;
 
     status_t sendUnchainedFinishedSignal(uint32_t seq, bool handled);
+    status_t sendFinishedSignalBatch(const uint32_t* seqs, size_t seqCount, bool handled);
 
     static void rewriteMessage(TouchState& state, InputMessage& msg);
     static void initializeKeyEvent(KeyEvent* event, const InputMessage* msg);
@@ -550,6 +643,7 @@ private:
     static bool canAddSample(const Batch& batch, const InputMessage* msg);
     static ssize_t findSampleNoLaterThan(const Batch& batch, nsecs_t time);
     static bool shouldResampleTool(int32_t toolType);
+    static void addPredictorMovement(TouchState& state, const InputMessage& msg);
 
     static bool isTouchResamplingEnabled();
 };
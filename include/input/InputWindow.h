@@ -188,6 +188,10 @@ struct InputWindowInfo {
 
     bool overlaps(const InputWindowInfo* other) const;
 
+    // Compares the fields which are parcelled.
+    bool operator==(const InputWindowInfo& info) const;
+    bool operator!=(const InputWindowInfo& info) const { return !(*this == info); }
+
     status_t write(Parcel& output) const;
     static InputWindowInfo read(const Parcel& from);
 };
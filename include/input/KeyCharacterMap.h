@@ -30,6 +30,8 @@
 #include <utils/Unicode.h>
 #include <utils/RefBase.h>
 
+#include <unordered_map>
+
 // Maximum number of keys supported by KeyCharacterMaps
 #define MAX_KEYS 8192
 
@@ -224,6 +226,12 @@ private:
         status_t parseCharacterLiteral(char16_t* outCharacter);
     };
 
+    /* The key and meta key modifiers that findKey() uses to generate a character. */
+    struct KeyForCharacter {
+        int32_t keyCode;
+        int32_t metaState;
+    };
+
     static sp<KeyCharacterMap> sEmpty;
 
     KeyedVector<int32_t, Key*> mKeys;
@@ -232,6 +240,9 @@ private:
     KeyedVector<int32_t, int32_t> mKeysByScanCode;
     KeyedVector<int32_t, int32_t> mKeysByUsageCode;
 
+    /* Reverse index of mKeys, rebuilt whenever mKeys changes. */
+    std::unordered_map<char16_t, KeyForCharacter> mKeysByCharacter;
+
     KeyCharacterMap();
     KeyCharacterMap(const KeyCharacterMap& other);
 
@@ -241,6 +252,7 @@ private:
     static bool matchesMetaState(int32_t eventMetaState, int32_t behaviorMetaState);
 
     bool findKey(char16_t ch, int32_t* outKeyCode, int32_t* outMetaState) const;
+    void buildKeysByCharacter();
 
     static status_t load(Tokenizer* tokenizer, Format format, sp<KeyCharacterMap>* outMap);
 
@@ -19,6 +19,7 @@
 
 #include <stdint.h>
 #include <sys/time.h>
+#include <memory>
 #include <vector>
 
 namespace android {
@@ -27,6 +28,10 @@ namespace android {
  * Represents data from a single scan of the touchscreen device.
  * Similar in concept to a video frame, but the touch strength is used as
  * the values instead.
+ *
+ * Copies of a frame share the same touch strength data, so frames can be passed along the
+ * input pipeline by value without copying every heatmap. The data is only duplicated when a
+ * shared frame is modified.
  */
 class TouchVideoFrame {
 public:
@@ -64,9 +69,14 @@ public:
 private:
     uint32_t mHeight;
     uint32_t mWidth;
-    std::vector<int16_t> mData;
+    std::shared_ptr<std::vector<int16_t>> mData;
     struct timeval mTimestamp;
 
+    /**
+     * Returns data that is safe to modify, copying it first if other frames share it.
+     */
+    std::vector<int16_t>& editData();
+
     /**
      * Common method for 90 degree and 270 degree rotation
      */
@@ -183,11 +183,18 @@ private:
     };
 
     float chooseWeight(uint32_t index) const;
+    bool computeEstimator(uint32_t id, VelocityTracker::Estimator* outEstimator) const;
 
     const uint32_t mDegree;
     const Weighting mWeighting;
     uint32_t mIndex;
     Movement mMovements[HISTORY_SIZE];
+
+    // Estimators computed since the last change to the movements, by pointer id.
+    // Apps ask for every pointer's velocity on each computeCurrentVelocity(), often
+    // several times per frame without new samples in between.
+    mutable BitSet32 mEstimatorCacheIdBits;
+    mutable VelocityTracker::Estimator mEstimatorCache[MAX_POINTER_ID + 1];
 };
 
 
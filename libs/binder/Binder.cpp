@@ -23,6 +23,7 @@
 #include <binder/IResultReceiver.h>
 #include <binder/IShellCallback.h>
 #include <binder/Parcel.h>
+#include <binder/TransactionStats.h>
 
 #include <linux/sched.h>
 #include <stdio.h>
@@ -174,6 +175,8 @@ status_t BBinder::transact(
 {
     data.setDataPosition(0);
 
+    const nsecs_t startTime =
+            TransactionStats::isEnabled() ? systemTime(SYSTEM_TIME_MONOTONIC) : 0;
     status_t err = NO_ERROR;
     switch (code) {
         case PING_TRANSACTION:
@@ -195,6 +198,11 @@ status_t BBinder::transact(
         reply->setDataPosition(0);
     }
 
+    if (startTime != 0) {
+        TransactionStats::recordServer(getInterfaceDescriptor(), code,
+                                       systemTime(SYSTEM_TIME_MONOTONIC) - startTime);
+    }
+
     return err;
 }
 
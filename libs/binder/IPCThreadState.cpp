@@ -21,6 +21,7 @@
 #include <binder/Binder.h>
 #include <binder/BpBinder.h>
 #include <binder/TextOutput.h>
+#include <binder/TransactionStats.h>
 
 #include <android-base/macros.h>
 #include <cutils/sched_policy.h>
@@ -466,6 +467,9 @@ void IPCThreadState::flushCommands()
 {
     if (mProcess->mDriverFD < 0)
         return;
+    if (mOnewayBatchPending > 0) {
+        submitOnewayBatch();
+    }
     talkWithDriver(false);
     // The flush could have caused post-write refcount decrements to have
     // been executed, which in turn could result in BC_RELEASE/BC_DECREFS
@@ -478,6 +482,55 @@ void IPCThreadState::flushCommands()
     }
 }
 
+void IPCThreadState::beginOnewayBatch()
+{
+    mOnewayBatchDepth++;
+}
+
+status_t IPCThreadState::flushOnewayBatch()
+{
+    if (mOnewayBatchDepth == 0) {
+        ALOGE("flushOnewayBatch() called without a matching beginOnewayBatch()");
+        return INVALID_OPERATION;
+    }
+    if (--mOnewayBatchDepth > 0) {
+        return NO_ERROR;
+    }
+    submitOnewayBatch();
+    const status_t result = mOnewayBatchError;
+    mOnewayBatchError = NO_ERROR;
+    return result;
+}
+
+uint64_t IPCThreadState::getDriverCallCount() const
+{
+    return mDriverCallCount;
+}
+
+status_t IPCThreadState::submitOnewayBatch()
+{
+    status_t result = NO_ERROR;
+    // The driver stops processing a write buffer at the first failed
+    // command and leaves the rest in mOut, so each wait below either
+    // completes one queued transaction or resubmits the remainder.
+    while (mOnewayBatchPending > 0) {
+        mOnewayBatchPending--;
+        const status_t err = waitForResponse(nullptr, nullptr);
+        if (err != NO_ERROR && result == NO_ERROR) {
+            result = err;
+        }
+    }
+    // The driver copies transaction data when it consumes the command, so
+    // the copies may only go once nothing in mOut can reference them.
+    if (mOut.dataSize() == 0) {
+        mOnewayBatch.clear();
+    }
+    if (mOnewayBatchError == NO_ERROR) {
+        mOnewayBatchError = result;
+    }
+    return result;
+}
+
 void IPCThreadState::blockUntilThreadAvailable()
 {
     pthread_mutex_lock(&mProcess->mThreadCountLock);
@@ -507,6 +560,9 @@ status_t IPCThreadState::getAndExecuteCommand()
 
         pthread_mutex_lock(&mProcess->mThreadCountLock);
         mProcess->mExecutingThreadsCount++;
+        if (mProcess->mExecutingThreadsCount > mProcess->mPeakExecutingThreadsCount) {
+            mProcess->mPeakExecutingThreadsCount = mProcess->mExecutingThreadsCount;
+        }
         if (mProcess->mExecutingThreadsCount >= mProcess->mMaxThreads &&
                 mProcess->mStarvationStartTimeMs == 0) {
             mProcess->mStarvationStartTimeMs = uptimeMillis();
@@ -525,6 +581,7 @@ status_t IPCThreadState::getAndExecuteCommand()
                       mProcess->mMaxThreads, starvationTimeMs);
             }
             mProcess->mStarvationStartTimeMs = 0;
+            mProcess->onStarvationEndLocked(starvationTimeMs);
         }
         pthread_cond_broadcast(&mProcess->mThreadCountDecrement);
         pthread_mutex_unlock(&mProcess->mThreadCountLock);
@@ -605,6 +662,13 @@ void IPCThreadState::joinThreadPool(bool isMain)
         if(result == TIMED_OUT && !isMain) {
             break;
         }
+
+        // An adaptive pool sheds threads once it has been idle for a while.
+        if (result == NO_ERROR && !isMain && mProcess->shouldRetirePooledThread()) {
+            LOG_THREADPOOL("**** THREAD %p (PID %d) RETIRING FROM IDLE THREAD POOL\n",
+                (void*)pthread_self(), getpid());
+            break;
+        }
     } while (result != -ECONNREFUSED && result != -EBADF);
 
     LOG_THREADPOOL("**** THREAD %p (PID %d) IS LEAVING THE THREAD POOL err=%d\n",
@@ -663,8 +727,33 @@ status_t IPCThreadState::transact(int32_t handle,
             << indent << data << dedent << endl;
     }
 
+    const bool batched = (flags & TF_ONE_WAY) != 0 && mOnewayBatchDepth > 0;
+    if (!batched && mOnewayBatchPending > 0) {
+        // Keep call order: everything batched so far goes out first.
+        submitOnewayBatch();
+    }
+
     LOG_ONEWAY(">>>> SEND from pid %d uid %d %s", getpid(), getuid(),
         (flags & TF_ONE_WAY) == 0 ? "READ REPLY" : "ONE WAY");
+    if (batched) {
+        // writeTransactionData() only records a pointer to the data, which
+        // the caller is free to destroy once we return, so queue a copy.
+        std::unique_ptr<Parcel> copy = std::make_unique<Parcel>();
+        err = copy->appendFrom(&data, 0, data.dataSize());
+        if (err == NO_ERROR) {
+            err = writeTransactionData(BC_TRANSACTION, flags, handle, code, *copy, nullptr);
+        }
+        if (err != NO_ERROR) {
+            return (mLastError = err);
+        }
+        mOnewayBatch.push_back(std::move(copy));
+        mOnewayBatchPending++;
+        if (mOnewayBatchPending >= kMaxOnewayBatchSize) {
+            submitOnewayBatch();
+        }
+        return NO_ERROR;
+    }
+
     err = writeTransactionData(BC_TRANSACTION, flags, handle, code, data, nullptr);
 
     if (err != NO_ERROR) {
@@ -690,12 +779,18 @@ status_t IPCThreadState::transact(int32_t handle,
             ALOGI(">>>>>> CALLING transaction %d", code);
         }
         #endif
+        const nsecs_t startTime =
+                TransactionStats::isEnabled() ? systemTime(SYSTEM_TIME_MONOTONIC) : 0;
         if (reply) {
             err = waitForResponse(reply);
         } else {
             Parcel fakeReply;
             err = waitForResponse(&fakeReply);
         }
+        if (startTime != 0) {
+            TransactionStats::recordClient(handle, code,
+                                           systemTime(SYSTEM_TIME_MONOTONIC) - startTime);
+        }
         #if 0
         if (code == 4) { // relayout
             ALOGI("<<<<<< RETURNING transaction 4");
@@ -807,7 +902,11 @@ IPCThreadState::IPCThreadState()
       mPropagateWorkSource(false),
       mStrictModePolicy(0),
       mLastTransactionBinderFlags(0),
-      mCallRestriction(mProcess->mCallRestriction)
+      mCallRestriction(mProcess->mCallRestriction),
+      mOnewayBatchDepth(0),
+      mOnewayBatchError(NO_ERROR),
+      mOnewayBatchPending(0),
+      mDriverCallCount(0)
 {
     pthread_setspecific(gTLS, this);
     clearCaller();
@@ -977,6 +1076,7 @@ status_t IPCThreadState::talkWithDriver(bool doReceive)
             alog << "About to read/write, write size = " << mOut.dataSize() << endl;
         }
 #if defined(__ANDROID__)
+        mDriverCallCount++;
         if (ioctl(mProcess->mDriverFD, BINDER_WRITE_READ, &bwr) >= 0)
             err = NO_ERROR;
         else
@@ -36,6 +36,9 @@
 
 #include "Static.h"
 
+#include <map>
+#include <mutex>
+
 #include <unistd.h>
 
 namespace android {
@@ -82,7 +85,48 @@ public:
         return IInterface::asBinder(mTheRealServiceManager).get();
     }
 private:
+    class CacheCallback;
+
+    // Returns true and sets *outBinder if name can be answered from the cache.
+    bool lookupCache(const std::string& name, sp<IBinder>* outBinder) const;
+    void updateCache(const std::string& name, const sp<IBinder>& binder) const;
+
     sp<AidlServiceManager> mTheRealServiceManager;
+
+    // checkService() results for names we are registered for notifications
+    // on, so a re-registered service replaces its entry. Binders are held
+    // weakly so the cache never keeps a (possibly lazy) service alive; a hit
+    // only needs some other part of the process to still hold it. Only used
+    // once the thread pool runs, since otherwise notifications never arrive.
+    struct CacheEntry {
+        wp<IBinder> binder;
+        // Not registered when looked up; stays a miss until a notification.
+        bool absent = false;
+    };
+    mutable std::mutex mCacheMutex;
+    mutable std::map<std::string, CacheEntry> mCache;
+    mutable sp<android::os::IServiceCallback> mCacheCallback;
+};
+
+class ServiceManagerShim::CacheCallback : public android::os::BnServiceCallback {
+public:
+    explicit CacheCallback(const wp<ServiceManagerShim>& shim) : mShim(shim) {}
+
+    Status onRegistration(const std::string& name, const sp<IBinder>& binder) override {
+        sp<ServiceManagerShim> shim = mShim.promote();
+        if (shim != nullptr) {
+            std::lock_guard<std::mutex> _l(shim->mCacheMutex);
+            auto it = shim->mCache.find(name);
+            if (it != shim->mCache.end()) {
+                it->second.binder = binder;
+                it->second.absent = false;
+            }
+        }
+        return Status::ok();
+    }
+
+private:
+    wp<ServiceManagerShim> mShim;
 };
 
 [[clang::no_destroy]] static std::once_flag gSmOnce;
@@ -202,6 +246,36 @@ bool checkPermission(const String16& permission, pid_t pid, uid_t uid)
 
 // ----------------------------------------------------------------------
 
+namespace {
+
+class Waiter : public android::os::BnServiceCallback {
+    Status onRegistration(const std::string& /*name*/,
+                          const sp<IBinder>& binder) override {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mBinder = binder;
+        lock.unlock();
+        // Flushing here helps ensure the service's ref count remains accurate
+        IPCThreadState::self()->flushCommands();
+        mCv.notify_one();
+        return Status::ok();
+    }
+public:
+    sp<IBinder> mBinder;
+    std::mutex mMutex;
+    std::condition_variable mCv;
+};
+
+// Simple RAII object to ensure a function call immediately before going out of scope
+class Defer {
+public:
+    Defer(std::function<void()>&& f) : mF(std::move(f)) {}
+    ~Defer() { mF(); }
+private:
+    std::function<void()> mF;
+};
+
+} // namespace
+
 ServiceManagerShim::ServiceManagerShim(const sp<AidlServiceManager>& impl)
  : mTheRealServiceManager(impl)
 {}
@@ -229,12 +303,36 @@ sp<IBinder> ServiceManagerShim::getService(const String16& name) const
     // retry interval in millisecond; note that vendor services stay at 100ms
     const long sleepTime = gSystemBootCompleted ? 1000 : 100;
 
+    // With a thread pool to deliver it, wake up as soon as the service is
+    // added instead of at the next poll.
+    sp<Waiter> waiter;
+    const std::string name8 = String8(name).c_str();
+    if (ProcessState::self()->isThreadPoolStarted()) {
+        waiter = new Waiter;
+        if (!mTheRealServiceManager->registerForNotifications(name8, waiter).isOk()) {
+            waiter = nullptr;
+        }
+    }
+    Defer unregister ([&] {
+        if (waiter != nullptr) {
+            mTheRealServiceManager->unregisterForNotifications(name8, waiter);
+        }
+    });
+
     int n = 0;
     while (uptimeMillis() < timeout) {
         n++;
         ALOGI("Waiting for service '%s' on '%s'...", String8(name).string(),
             ProcessState::self()->getDriverName().c_str());
-        usleep(1000*sleepTime);
+        if (waiter != nullptr) {
+            std::unique_lock<std::mutex> lock(waiter->mMutex);
+            waiter->mCv.wait_for(lock, std::chrono::milliseconds(sleepTime), [&] {
+                return waiter->mBinder != nullptr;
+            });
+            if (waiter->mBinder != nullptr) return waiter->mBinder;
+        } else {
+            usleep(1000*sleepTime);
+        }
 
         sp<IBinder> svc = checkService(name);
         if (svc != nullptr) return svc;
@@ -243,15 +341,74 @@ sp<IBinder> ServiceManagerShim::getService(const String16& name) const
     return nullptr;
 }
 
-sp<IBinder> ServiceManagerShim::checkService(const String16& name) const
+sp<IBinder> ServiceManagerShim::checkService(const String16& name16) const
 {
+    const std::string name = String8(name16).c_str();
+
     sp<IBinder> ret;
-    if (!mTheRealServiceManager->checkService(String8(name).c_str(), &ret).isOk()) {
+    if (lookupCache(name, &ret)) {
+        return ret;
+    }
+    if (!mTheRealServiceManager->checkService(name, &ret).isOk()) {
         return nullptr;
     }
+    updateCache(name, ret);
     return ret;
 }
 
+bool ServiceManagerShim::lookupCache(const std::string& name, sp<IBinder>* outBinder) const
+{
+    std::lock_guard<std::mutex> _l(mCacheMutex);
+    auto it = mCache.find(name);
+    if (it == mCache.end()) {
+        return false;
+    }
+    if (it->second.absent) {
+        *outBinder = nullptr;
+        return true;
+    }
+    sp<IBinder> binder = it->second.binder.promote();
+    if (binder == nullptr || !binder->isBinderAlive()) {
+        return false;
+    }
+    *outBinder = binder;
+    return true;
+}
+
+void ServiceManagerShim::updateCache(const std::string& name, const sp<IBinder>& binder) const
+{
+    {
+        std::lock_guard<std::mutex> _l(mCacheMutex);
+        auto it = mCache.find(name);
+        if (it != mCache.end()) {
+            // A notification may already have brought in something newer,
+            // so only fill in an entry whose binder has gone away.
+            if (binder != nullptr && it->second.binder.promote() == nullptr) {
+                it->second.binder = binder;
+                it->second.absent = false;
+            }
+            return;
+        }
+        if (!ProcessState::self()->isThreadPoolStarted()) {
+            return;
+        }
+        if (mCacheCallback == nullptr) {
+            mCacheCallback = new CacheCallback(
+                    const_cast<ServiceManagerShim*>(this));
+        }
+        // Add the entry before registering: servicemanager may deliver
+        // onRegistration() on another thread before the call returns.
+        CacheEntry& entry = mCache[name];
+        entry.binder = binder;
+        entry.absent = binder == nullptr;
+    }
+
+    if (!mTheRealServiceManager->registerForNotifications(name, mCacheCallback).isOk()) {
+        std::lock_guard<std::mutex> _l(mCacheMutex);
+        mCache.erase(name);
+    }
+}
+
 status_t ServiceManagerShim::addService(const String16& name, const sp<IBinder>& service,
                                         bool allowIsolated, int dumpsysPriority)
 {
@@ -277,32 +434,6 @@ Vector<String16> ServiceManagerShim::listServices(int dumpsysPriority)
 
 sp<IBinder> ServiceManagerShim::waitForService(const String16& name16)
 {
-    class Waiter : public android::os::BnServiceCallback {
-        Status onRegistration(const std::string& /*name*/,
-                              const sp<IBinder>& binder) override {
-            std::unique_lock<std::mutex> lock(mMutex);
-            mBinder = binder;
-            lock.unlock();
-            // Flushing here helps ensure the service's ref count remains accurate
-            IPCThreadState::self()->flushCommands();
-            mCv.notify_one();
-            return Status::ok();
-        }
-    public:
-        sp<IBinder> mBinder;
-        std::mutex mMutex;
-        std::condition_variable mCv;
-    };
-
-    // Simple RAII object to ensure a function call immediately before going out of scope
-    class Defer {
-    public:
-        Defer(std::function<void()>&& f) : mF(std::move(f)) {}
-        ~Defer() { mF(); }
-    private:
-        std::function<void()> mF;
-    };
-
     const std::string name = String8(name16).c_str();
 
     sp<IBinder> out;
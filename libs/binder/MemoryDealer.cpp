@@ -25,6 +25,10 @@
 #include <utils/String8.h>
 #include <utils/threads.h>
 
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -120,20 +124,35 @@ private:
 
 // ----------------------------------------------------------------------------
 
-class SimpleBestFitAllocator
+class MemoryDealerAllocator
+{
+public:
+    virtual ~MemoryDealerAllocator() {}
+
+    // Returns the offset of the new block, or NO_MEMORY.
+    virtual size_t      allocate(size_t size, uint32_t flags = 0) = 0;
+    virtual status_t    deallocate(size_t offset) = 0;
+    virtual void        dump(const char* what) const = 0;
+    virtual MemoryDealer::Stats getStats() const = 0;
+};
+
+// ----------------------------------------------------------------------------
+
+class SimpleBestFitAllocator : public MemoryDealerAllocator
 {
     enum {
         PAGE_ALIGNED = 0x00000001
     };
 public:
     explicit SimpleBestFitAllocator(size_t size);
-    ~SimpleBestFitAllocator();
+    ~SimpleBestFitAllocator() override;
 
-    size_t      allocate(size_t size, uint32_t flags = 0);
-    status_t    deallocate(size_t offset);
+    size_t      allocate(size_t size, uint32_t flags = 0) override;
+    status_t    deallocate(size_t offset) override;
     size_t      size() const;
-    void        dump(const char* what) const;
+    void        dump(const char* what) const override;
     void        dump(String8& res, const char* what) const;
+    MemoryDealer::Stats getStats() const override;
 
     static size_t getAllocationAlignment() { return kMemoryAlign; }
 
@@ -163,6 +182,63 @@ private:
 
 // ----------------------------------------------------------------------------
 
+/*
+ * Binary buddy allocator. Block metadata lives here rather than in the heap,
+ * which may be mapped read-only. Free blocks of each order are kept in
+ * intrusive lists threaded through mNext/mPrev, so allocate and deallocate
+ * only touch a bounded number of blocks.
+ */
+class BuddyAllocator : public MemoryDealerAllocator
+{
+public:
+    explicit BuddyAllocator(size_t size);
+
+    size_t      allocate(size_t size, uint32_t flags = 0) override;
+    status_t    deallocate(size_t offset) override;
+    void        dump(const char* what) const override;
+    MemoryDealer::Stats getStats() const override;
+
+private:
+    enum : uint8_t {
+        INTERIOR = 0,   // not the first unit of a block
+        ALLOCATED,
+        FREE,
+    };
+
+    // Smallest block; a multiple of the 32-byte MemoryDealer alignment.
+    static constexpr size_t     kUnitSize = 128;
+    static constexpr size_t     kMaxOrders = 32;
+    static constexpr uint32_t   kNone = UINT32_MAX;
+    // Freed blocks of the smallest orders are parked in these slots and
+    // handed out again without taking mLock or merging buddies.
+    static constexpr size_t     kCachedOrders = 6;
+    static constexpr size_t     kCacheSlots = 8;
+
+    ssize_t     alloc_l(uint32_t order);
+    void        free_l(uint32_t unit);
+    void        push_l(uint32_t unit, uint32_t order);
+    void        remove_l(uint32_t unit);
+    void        drainCache_l();
+
+    static uint32_t orderFor(size_t size);
+
+    mutable Mutex           mLock;
+    size_t                  mHeapSize;
+    uint32_t                mUnits;
+    std::vector<uint8_t>    mOrder;
+    std::vector<uint8_t>    mState;
+    std::vector<uint32_t>   mNext;
+    std::vector<uint32_t>   mPrev;
+    uint32_t                mFreeHead[kMaxOrders];
+    // Bit n is set when mFreeHead[n] is not empty.
+    uint32_t                mFreeOrders;
+    size_t                  mAllocatedUnits;
+    size_t                  mAllocationCount;
+    std::atomic<uint32_t>   mCache[kCachedOrders][kCacheSlots];
+};
+
+// ----------------------------------------------------------------------------
+
 Allocation::Allocation(
         const sp<MemoryDealer>& dealer,
         const sp<IMemoryHeap>& heap, ssize_t offset, size_t size)
@@ -233,6 +309,14 @@ MemoryDealer::MemoryDealer(size_t size, const char* name, uint32_t flags)
 {    
 }
 
+MemoryDealer::MemoryDealer(size_t size, const char* name, uint32_t flags, Policy policy)
+    : mHeap(new MemoryHeapBase(size, flags, name)),
+    mAllocator(policy == BUDDY
+            ? static_cast<MemoryDealerAllocator*>(new BuddyAllocator(size))
+            : new SimpleBestFitAllocator(size))
+{
+}
+
 MemoryDealer::~MemoryDealer()
 {
     delete mAllocator;
@@ -258,11 +342,16 @@ void MemoryDealer::dump(const char* what) const
     allocator()->dump(what);
 }
 
+MemoryDealer::Stats MemoryDealer::getStats() const
+{
+    return allocator()->getStats();
+}
+
 const sp<IMemoryHeap>& MemoryDealer::heap() const {
     return mHeap;
 }
 
-SimpleBestFitAllocator* MemoryDealer::allocator() const {
+MemoryDealerAllocator* MemoryDealer::allocator() const {
     return mAllocator;
 }
 
@@ -480,5 +569,236 @@ void SimpleBestFitAllocator::dump_l(String8& result,
     result.append(buffer);
 }
 
+MemoryDealer::Stats SimpleBestFitAllocator::getStats() const
+{
+    Mutex::Autolock _l(mLock);
+    MemoryDealer::Stats stats = {};
+    stats.heapSize = mHeapSize;
+    for (chunk_t const* cur = mList.head(); cur; cur = cur->next) {
+        const size_t bytes = cur->size * kMemoryAlign;
+        if (cur->free) {
+            stats.freeBytes += bytes;
+            stats.freeBlockCount++;
+            if (bytes > stats.largestFreeBlock) stats.largestFreeBlock = bytes;
+        } else {
+            stats.allocatedBytes += bytes;
+            stats.allocationCount++;
+        }
+    }
+    return stats;
+}
+
+// ----------------------------------------------------------------------------
+
+BuddyAllocator::BuddyAllocator(size_t size)
+    : mFreeOrders(0), mAllocatedUnits(0), mAllocationCount(0)
+{
+    size_t pagesize = getpagesize();
+    mHeapSize = ((size + pagesize-1) & ~(pagesize-1));
+    mUnits = mHeapSize / kUnitSize;
+
+    mOrder.resize(mUnits, 0);
+    mState.resize(mUnits, INTERIOR);
+    mNext.resize(mUnits, kNone);
+    mPrev.resize(mUnits, kNone);
+    for (size_t i = 0; i < kMaxOrders; i++) {
+        mFreeHead[i] = kNone;
+    }
+    for (size_t i = 0; i < kCachedOrders; i++) {
+        for (size_t j = 0; j < kCacheSlots; j++) {
+            mCache[i][j].store(kNone, std::memory_order_relaxed);
+        }
+    }
+
+    // Cover the heap with the largest naturally aligned blocks that fit.
+    // Their orders strictly decrease, so no two of them are buddies.
+    uint32_t unit = 0;
+    while (unit < mUnits) {
+        uint32_t order = 31 - __builtin_clz(mUnits - unit);
+        if (unit != 0) {
+            order = std::min<uint32_t>(order, __builtin_ctz(unit));
+        }
+        push_l(unit, order);
+        unit += 1u << order;
+    }
+}
+
+uint32_t BuddyAllocator::orderFor(size_t size)
+{
+    const size_t units = (size + kUnitSize-1) / kUnitSize;
+    return units <= 1 ? 0 : 64 - __builtin_clzll(units - 1);
+}
+
+void BuddyAllocator::push_l(uint32_t unit, uint32_t order)
+{
+    mOrder[unit] = order;
+    mState[unit] = FREE;
+    mPrev[unit] = kNone;
+    mNext[unit] = mFreeHead[order];
+    if (mFreeHead[order] != kNone) mPrev[mFreeHead[order]] = unit;
+    mFreeHead[order] = unit;
+    mFreeOrders |= 1u << order;
+}
+
+void BuddyAllocator::remove_l(uint32_t unit)
+{
+    const uint32_t order = mOrder[unit];
+    if (mPrev[unit] != kNone) mNext[mPrev[unit]] = mNext[unit];
+    else                      mFreeHead[order] = mNext[unit];
+    if (mNext[unit] != kNone) mPrev[mNext[unit]] = mPrev[unit];
+    if (mFreeHead[order] == kNone) mFreeOrders &= ~(1u << order);
+    mState[unit] = INTERIOR;
+}
+
+size_t BuddyAllocator::allocate(size_t size, uint32_t /*flags*/)
+{
+    // Blocks of kUnitSize << n are aligned to their size, so anything of a
+    // page or more is page aligned without special handling.
+    if (size == 0) {
+        return 0;
+    }
+    const uint32_t order = orderFor(size);
+    if (order >= kMaxOrders) {
+        return NO_MEMORY;
+    }
+    if (order < kCachedOrders) {
+        for (std::atomic<uint32_t>& slot : mCache[order]) {
+            if (slot.load(std::memory_order_relaxed) == kNone) continue;
+            const uint32_t unit = slot.exchange(kNone, std::memory_order_acquire);
+            if (unit != kNone) {
+                return unit * kUnitSize;
+            }
+        }
+    }
+
+    Mutex::Autolock _l(mLock);
+    ssize_t offset = alloc_l(order);
+    if (offset < 0) {
+        // Parked blocks may be what is keeping larger blocks from merging.
+        drainCache_l();
+        offset = alloc_l(order);
+    }
+    return offset;
+}
+
+ssize_t BuddyAllocator::alloc_l(uint32_t order)
+{
+    const uint32_t candidates = mFreeOrders & ~((1u << order) - 1);
+    if (candidates == 0) {
+        return NO_MEMORY;
+    }
+    uint32_t found = __builtin_ctz(candidates);
+    const uint32_t unit = mFreeHead[found];
+    remove_l(unit);
+    // Split down, returning the upper halves to their free lists.
+    while (found > order) {
+        found--;
+        push_l(unit + (1u << found), found);
+    }
+    mOrder[unit] = order;
+    mState[unit] = ALLOCATED;
+    mAllocatedUnits += 1u << order;
+    mAllocationCount++;
+    return ssize_t(unit) * kUnitSize;
+}
+
+status_t BuddyAllocator::deallocate(size_t offset)
+{
+    const uint32_t unit = offset / kUnitSize;
+    if (offset % kUnitSize || unit >= mUnits) {
+        return NAME_NOT_FOUND;
+    }
+    // The head of an allocated block is only written by whoever frees it,
+    // so its order can be read without the lock.
+    const uint32_t order = mOrder[unit];
+    if (order < kCachedOrders) {
+        for (std::atomic<uint32_t>& slot : mCache[order]) {
+            uint32_t expected = kNone;
+            if (slot.compare_exchange_strong(expected, unit, std::memory_order_release,
+                                             std::memory_order_relaxed)) {
+                return NO_ERROR;
+            }
+        }
+    }
+
+    Mutex::Autolock _l(mLock);
+    if (mState[unit] != ALLOCATED) {
+        LOG_FATAL_IF(mState[unit] == FREE,
+                "block at offset 0x%08zX already freed", offset);
+        return NAME_NOT_FOUND;
+    }
+    free_l(unit);
+    return NO_ERROR;
+}
+
+void BuddyAllocator::free_l(uint32_t unit)
+{
+    uint32_t order = mOrder[unit];
+    mAllocatedUnits -= 1u << order;
+    mAllocationCount--;
+    mState[unit] = INTERIOR;
+    while (order + 1 < kMaxOrders) {
+        const uint32_t buddy = unit ^ (1u << order);
+        if (buddy >= mUnits || mState[buddy] != FREE || mOrder[buddy] != order) {
+            break;
+        }
+        remove_l(buddy);
+        unit = std::min(unit, buddy);
+        order++;
+    }
+    push_l(unit, order);
+}
+
+void BuddyAllocator::drainCache_l()
+{
+    // Parked blocks are still marked allocated; give them back for real.
+    for (size_t i = 0; i < kCachedOrders; i++) {
+        for (std::atomic<uint32_t>& slot : mCache[i]) {
+            const uint32_t unit = slot.exchange(kNone, std::memory_order_acquire);
+            if (unit != kNone) {
+                free_l(unit);
+            }
+        }
+    }
+}
+
+MemoryDealer::Stats BuddyAllocator::getStats() const
+{
+    Mutex::Autolock _l(mLock);
+    MemoryDealer::Stats stats = {};
+    stats.heapSize = mHeapSize;
+    stats.allocatedBytes = mAllocatedUnits * kUnitSize;
+    stats.allocationCount = mAllocationCount;
+    // Parked blocks are free as far as clients are concerned.
+    for (size_t i = 0; i < kCachedOrders; i++) {
+        for (const std::atomic<uint32_t>& slot : mCache[i]) {
+            if (slot.load(std::memory_order_relaxed) != kNone) {
+                stats.allocatedBytes -= kUnitSize << i;
+                stats.allocationCount--;
+                stats.freeBlockCount++;
+                stats.largestFreeBlock = std::max(stats.largestFreeBlock, kUnitSize << i);
+            }
+        }
+    }
+    for (uint32_t order = 0; order < kMaxOrders; order++) {
+        for (uint32_t unit = mFreeHead[order]; unit != kNone; unit = mNext[unit]) {
+            stats.freeBlockCount++;
+            stats.largestFreeBlock = std::max(stats.largestFreeBlock, kUnitSize << order);
+        }
+    }
+    stats.freeBytes = size_t(mUnits) * kUnitSize - stats.allocatedBytes;
+    return stats;
+}
+
+void BuddyAllocator::dump(const char* what) const
+{
+    const MemoryDealer::Stats stats = getStats();
+    ALOGD("  %s (%p, size=%zu, buddy)\n"
+          "  allocated: %zu bytes in %zu blocks\n"
+          "  free: %zu bytes in %zu blocks, largest %zu",
+          what, this, stats.heapSize, stats.allocatedBytes, stats.allocationCount,
+          stats.freeBytes, stats.freeBlockCount, stats.largestFreeBlock);
+}
+
 
 } // namespace android
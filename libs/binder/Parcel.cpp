@@ -34,6 +34,7 @@
 #include <binder/Binder.h>
 #include <binder/BpBinder.h>
 #include <binder/IPCThreadState.h>
+#include <binder/MemoryDealer.h>
 #include <binder/Parcel.h>
 #include <binder/ProcessState.h>
 #include <binder/Stability.h>
@@ -44,6 +45,7 @@
 #include <utils/Debug.h>
 #include <utils/Flattenable.h>
 #include <utils/Log.h>
+#include <utils/Mutex.h>
 #include <utils/misc.h>
 #include <utils/String8.h>
 #include <utils/String16.h>
@@ -90,6 +92,7 @@ enum {
     BLOB_INPLACE = 0,
     BLOB_ASHMEM_IMMUTABLE = 1,
     BLOB_ASHMEM_MUTABLE = 2,
+    BLOB_ARENA = 3,
 };
 
 static void acquire_object(const sp<ProcessState>& proc,
@@ -434,13 +437,9 @@ status_t Parcel::appendFrom(const Parcel *parcel, size_t offset, size_t len)
             if (mObjectsSize + numObjects > SIZE_MAX / 3) return NO_MEMORY; // overflow
             size_t newSize = ((mObjectsSize + numObjects)*3)/2;
             if (newSize > SIZE_MAX / sizeof(binder_size_t)) return NO_MEMORY; // overflow
-            binder_size_t *objects =
-                (binder_size_t*)realloc(mObjects, newSize*sizeof(binder_size_t));
-            if (objects == (binder_size_t*)nullptr) {
+            if (reallocObjects(newSize) != NO_ERROR) {
                 return NO_MEMORY;
             }
-            mObjects = objects;
-            mObjectsCapacity = newSize;
         }
 
         // append and acquire objects
@@ -601,15 +600,14 @@ bool Parcel::enforceInterface(const char16_t* interface,
         return false;
     }
     // Interface descriptor.
-    size_t parcel_interface_len;
-    const char16_t* parcel_interface = readString16Inplace(&parcel_interface_len);
-    if (len == parcel_interface_len &&
-            (!len || !memcmp(parcel_interface, interface, len * sizeof (char16_t)))) {
+    std::u16string_view parcel_interface;
+    readString16View(&parcel_interface);
+    if (parcel_interface == std::u16string_view(interface, len)) {
         return true;
     } else {
         ALOGW("**** enforceInterface() expected '%s' but read '%s'",
               String8(interface, len).string(),
-              String8(parcel_interface, parcel_interface_len).string());
+              String8(parcel_interface.data(), parcel_interface.size()).string());
         return false;
     }
 }
@@ -801,52 +799,52 @@ status_t Parcel::writeByteVector(const std::unique_ptr<std::vector<uint8_t>>& va
 
 status_t Parcel::writeInt32Vector(const std::vector<int32_t>& val)
 {
-    return writeTypedVector(val, &Parcel::writeInt32);
+    return writeTrivialVector(val);
 }
 
 status_t Parcel::writeInt32Vector(const std::unique_ptr<std::vector<int32_t>>& val)
 {
-    return writeNullableTypedVector(val, &Parcel::writeInt32);
+    return writeTrivialVector(val);
 }
 
 status_t Parcel::writeInt64Vector(const std::vector<int64_t>& val)
 {
-    return writeTypedVector(val, &Parcel::writeInt64);
+    return writeTrivialVector(val);
 }
 
 status_t Parcel::writeInt64Vector(const std::unique_ptr<std::vector<int64_t>>& val)
 {
-    return writeNullableTypedVector(val, &Parcel::writeInt64);
+    return writeTrivialVector(val);
 }
 
 status_t Parcel::writeUint64Vector(const std::vector<uint64_t>& val)
 {
-    return writeTypedVector(val, &Parcel::writeUint64);
+    return writeTrivialVector(val);
 }
 
 status_t Parcel::writeUint64Vector(const std::unique_ptr<std::vector<uint64_t>>& val)
 {
-    return writeNullableTypedVector(val, &Parcel::writeUint64);
+    return writeTrivialVector(val);
 }
 
 status_t Parcel::writeFloatVector(const std::vector<float>& val)
 {
-    return writeTypedVector(val, &Parcel::writeFloat);
+    return writeTrivialVector(val);
 }
 
 status_t Parcel::writeFloatVector(const std::unique_ptr<std::vector<float>>& val)
 {
-    return writeNullableTypedVector(val, &Parcel::writeFloat);
+    return writeTrivialVector(val);
 }
 
 status_t Parcel::writeDoubleVector(const std::vector<double>& val)
 {
-    return writeTypedVector(val, &Parcel::writeDouble);
+    return writeTrivialVector(val);
 }
 
 status_t Parcel::writeDoubleVector(const std::unique_ptr<std::vector<double>>& val)
 {
-    return writeNullableTypedVector(val, &Parcel::writeDouble);
+    return writeTrivialVector(val);
 }
 
 status_t Parcel::writeBoolVector(const std::vector<bool>& val)
@@ -1219,6 +1217,39 @@ status_t Parcel::writeBlob(size_t len, bool mutableCopy, WritableBlob* outBlob)
     return status;
 }
 
+status_t Parcel::writeBlob(const sp<MemoryDealer>& arena, size_t len, WritableBlob* outBlob)
+{
+    if (arena == nullptr || len <= BLOB_INPLACE_LIMIT) {
+        return writeBlob(len, false /*mutableCopy*/, outBlob);
+    }
+
+    if (len > INT32_MAX) {
+        // don't accept size_t values which may have come from an
+        // inadvertent conversion from a negative int.
+        return BAD_VALUE;
+    }
+
+    sp<IMemory> memory = arena->allocate(len);
+    if (memory == nullptr) {
+        ALOGV("writeBlob: arena full, write to ashmem");
+        return writeBlob(len, false /*mutableCopy*/, outBlob);
+    }
+
+    ALOGV("writeBlob: write to arena");
+    ssize_t offset = 0;
+    sp<IMemoryHeap> heap = memory->getMemory(&offset);
+    status_t status = writeInt32(BLOB_ARENA);
+    if (status) return status;
+    status = writeStrongBinder(IInterface::asBinder(heap));
+    if (status) return status;
+    status = writeInt64(offset);
+    if (status) return status;
+
+    mBlobAllocations.push_back(memory);
+    outBlob->init(-1, memory->unsecurePointer(), len, false);
+    return NO_ERROR;
+}
+
 status_t Parcel::writeDupImmutableBlobFileDescriptor(int fd)
 {
     // Must match up with what's done in writeBlob.
@@ -1310,10 +1341,7 @@ restart_write:
         if ((mObjectsSize + 2) > SIZE_MAX / 3) return NO_MEMORY; // overflow
         size_t newSize = ((mObjectsSize+2)*3)/2;
         if (newSize > SIZE_MAX / sizeof(binder_size_t)) return NO_MEMORY; // overflow
-        binder_size_t* objects = (binder_size_t*)realloc(mObjects, newSize*sizeof(binder_size_t));
-        if (objects == nullptr) return NO_MEMORY;
-        mObjects = objects;
-        mObjectsCapacity = newSize;
+        if (reallocObjects(newSize) != NO_ERROR) return NO_MEMORY;
     }
 
     goto restart_write;
@@ -1516,43 +1544,43 @@ status_t Parcel::readByteVector(std::unique_ptr<std::vector<uint8_t>>* val) cons
 }
 
 status_t Parcel::readInt32Vector(std::unique_ptr<std::vector<int32_t>>* val) const {
-    return readNullableTypedVector(val, &Parcel::readInt32);
+    return readTrivialVector(val);
 }
 
 status_t Parcel::readInt32Vector(std::vector<int32_t>* val) const {
-    return readTypedVector(val, &Parcel::readInt32);
+    return readTrivialVector(val);
 }
 
 status_t Parcel::readInt64Vector(std::unique_ptr<std::vector<int64_t>>* val) const {
-    return readNullableTypedVector(val, &Parcel::readInt64);
+    return readTrivialVector(val);
 }
 
 status_t Parcel::readInt64Vector(std::vector<int64_t>* val) const {
-    return readTypedVector(val, &Parcel::readInt64);
+    return readTrivialVector(val);
 }
 
 status_t Parcel::readUint64Vector(std::unique_ptr<std::vector<uint64_t>>* val) const {
-    return readNullableTypedVector(val, &Parcel::readUint64);
+    return readTrivialVector(val);
 }
 
 status_t Parcel::readUint64Vector(std::vector<uint64_t>* val) const {
-    return readTypedVector(val, &Parcel::readUint64);
+    return readTrivialVector(val);
 }
 
 status_t Parcel::readFloatVector(std::unique_ptr<std::vector<float>>* val) const {
-    return readNullableTypedVector(val, &Parcel::readFloat);
+    return readTrivialVector(val);
 }
 
 status_t Parcel::readFloatVector(std::vector<float>* val) const {
-    return readTypedVector(val, &Parcel::readFloat);
+    return readTrivialVector(val);
 }
 
 status_t Parcel::readDoubleVector(std::unique_ptr<std::vector<double>>* val) const {
-    return readNullableTypedVector(val, &Parcel::readDouble);
+    return readTrivialVector(val);
 }
 
 status_t Parcel::readDoubleVector(std::vector<double>* val) const {
-    return readTypedVector(val, &Parcel::readDouble);
+    return readTrivialVector(val);
 }
 
 status_t Parcel::readBoolVector(std::unique_ptr<std::vector<bool>>* val) const {
@@ -1888,6 +1916,19 @@ const char* Parcel::readString8Inplace(size_t* outLen) const
     return nullptr;
 }
 
+status_t Parcel::readString8View(std::string_view* pArg) const
+{
+    size_t len;
+    const char* str = readString8Inplace(&len);
+    if (str) {
+        *pArg = std::string_view(str, len);
+        return OK;
+    } else {
+        *pArg = std::string_view();
+        return UNEXPECTED_NULL;
+    }
+}
+
 String16 Parcel::readString16() const
 {
     size_t len;
@@ -1933,6 +1974,19 @@ status_t Parcel::readString16(String16* pArg) const
     }
 }
 
+status_t Parcel::readString16View(std::u16string_view* pArg) const
+{
+    size_t len;
+    const char16_t* str = readString16Inplace(&len);
+    if (str) {
+        *pArg = std::u16string_view(str, len);
+        return OK;
+    } else {
+        *pArg = std::u16string_view();
+        return UNEXPECTED_NULL;
+    }
+}
+
 const char16_t* Parcel::readString16Inplace(size_t* outLen) const
 {
     int32_t size = readInt32();
@@ -2113,6 +2167,43 @@ status_t Parcel::readUniqueFileDescriptorVector(std::vector<base::unique_fd>* va
     return readTypedVector(val, &Parcel::readUniqueFileDescriptor);
 }
 
+// Receivers keep the heaps of the last few arenas they read from, so that
+// blobs from the same sender reuse one mapping instead of mapping the heap on
+// every transaction.
+static constexpr size_t kArenaHeapCacheSize = 4;
+static Mutex gArenaHeapCacheLock;
+
+static sp<IMemoryHeap> findArenaHeap(const sp<IBinder>& binder)
+{
+    if (binder == nullptr) return nullptr;
+
+    // Most recently used first. Leaked so no heap proxy is torn down at exit.
+    static sp<IMemoryHeap>* const cache = new sp<IMemoryHeap>[kArenaHeapCacheSize];
+
+    Mutex::Autolock _l(gArenaHeapCacheLock);
+    size_t i = 0;
+    while (i < kArenaHeapCacheSize &&
+            (cache[i] == nullptr || IInterface::asBinder(cache[i]) != binder)) {
+        i++;
+    }
+
+    sp<IMemoryHeap> heap;
+    if (i < kArenaHeapCacheSize) {
+        heap = cache[i];
+    } else {
+        // Not cached; this evicts the least recently used entry
+        heap = interface_cast<IMemoryHeap>(binder);
+        if (heap == nullptr) return nullptr;
+        i = kArenaHeapCacheSize - 1;
+    }
+
+    for (; i > 0; i--) {
+        cache[i] = cache[i - 1];
+    }
+    cache[0] = heap;
+    return heap;
+}
+
 status_t Parcel::readBlob(size_t len, ReadableBlob* outBlob) const
 {
     int32_t blobType;
@@ -2128,6 +2219,31 @@ status_t Parcel::readBlob(size_t len, ReadableBlob* outBlob) const
         return NO_ERROR;
     }
 
+    if (blobType == BLOB_ARENA) {
+        ALOGV("readBlob: read from arena");
+        sp<IBinder> binder;
+        status = readStrongBinder(&binder);
+        if (status) return status;
+        int64_t offset;
+        status = readInt64(&offset);
+        if (status) return status;
+
+        sp<IMemoryHeap> heap = findArenaHeap(binder);
+        if (heap == nullptr) return BAD_VALUE;
+        uint8_t* base = static_cast<uint8_t*>(heap->getBase());
+        if (base == MAP_FAILED || base == nullptr) return NO_MEMORY;
+        const size_t heapSize = heap->getSize();
+        if (offset < 0 || static_cast<uint64_t>(offset) > heapSize ||
+                len > heapSize - static_cast<size_t>(offset)) {
+            ALOGE("arena blob at %" PRId64 " size %zu outside heap size %zu", offset, len,
+                    heapSize);
+            return BAD_VALUE;
+        }
+
+        outBlob->init(heap, base + offset, len);
+        return NO_ERROR;
+    }
+
     ALOGV("readBlob: read from ashmem");
     bool isMutable = (blobType == BLOB_ASHMEM_MUTABLE);
     int fd = readFileDescriptor();
@@ -2419,14 +2535,10 @@ void Parcel::freeDataNoInit()
     } else {
         LOG_ALLOC("Parcel %p: freeing allocated data", this);
         releaseObjects();
-        if (mData) {
-            LOG_ALLOC("Parcel %p: freeing with %zu capacity", this, mDataCapacity);
-            gParcelGlobalAllocSize -= mDataCapacity;
-            gParcelGlobalAllocCount--;
-            free(mData);
-        }
-        if (mObjects) free(mObjects);
+        freeDataStorage();
+        freeObjectsStorage();
     }
+    mBlobAllocations.clear();
 }
 
 status_t Parcel::growData(size_t len)
@@ -2458,36 +2570,21 @@ status_t Parcel::restartWrite(size_t desired)
         return continueWrite(desired);
     }
 
-    uint8_t* data = (uint8_t*)realloc(mData, desired);
-    if (!data && desired > mDataCapacity) {
+    LOG_ALLOC("Parcel %p: restart from %zu to %zu capacity", this, mDataCapacity, desired);
+    if (reallocData(desired) != NO_ERROR) {
         mError = NO_MEMORY;
         return NO_MEMORY;
     }
 
     releaseObjects();
 
-    if (data || desired == 0) {
-        LOG_ALLOC("Parcel %p: restart from %zu to %zu capacity", this, mDataCapacity, desired);
-        if (mDataCapacity > desired) {
-            gParcelGlobalAllocSize -= (mDataCapacity - desired);
-        } else {
-            gParcelGlobalAllocSize += (desired - mDataCapacity);
-        }
-
-        if (!mData) {
-            gParcelGlobalAllocCount++;
-        }
-        mData = data;
-        mDataCapacity = desired;
-    }
-
     mDataSize = mDataPos = 0;
     ALOGV("restartWrite Setting data size of %p to %zu", this, mDataSize);
     ALOGV("restartWrite Setting data pos of %p to %zu", this, mDataPos);
 
-    free(mObjects);
-    mObjects = nullptr;
-    mObjectsSize = mObjectsCapacity = 0;
+    freeObjectsStorage();
+    mObjectsSize = 0;
+    mBlobAllocations.clear();
     mNextObjectHint = 0;
     mObjectsSorted = false;
     mHasFds = false;
@@ -2529,22 +2626,31 @@ status_t Parcel::continueWrite(size_t desired)
 
         // If there is a different owner, we need to take
         // posession.
-        uint8_t* data = (uint8_t*)malloc(desired);
+        const bool inlineData = desired <= kInlineDataCapacity;
+        uint8_t* data = inlineData ? mInlineData : (uint8_t*)malloc(desired);
         if (!data) {
             mError = NO_MEMORY;
             return NO_MEMORY;
         }
         binder_size_t* objects = nullptr;
+        size_t objectsCapacity = objectsSize;
 
-        if (objectsSize) {
+        if (objectsSize <= kInlineObjectsCapacity) {
+            if (objectsSize) {
+                objects = mInlineObjects;
+                objectsCapacity = kInlineObjectsCapacity;
+            }
+        } else {
             objects = (binder_size_t*)calloc(objectsSize, sizeof(binder_size_t));
             if (!objects) {
-                free(data);
+                if (!inlineData) free(data);
 
                 mError = NO_MEMORY;
                 return NO_MEMORY;
             }
+        }
 
+        if (objectsSize) {
             // Little hack to only acquire references on objects
             // we will be keeping.
             size_t oldObjectsSize = mObjectsSize;
@@ -2564,15 +2670,18 @@ status_t Parcel::continueWrite(size_t desired)
         mOwner = nullptr;
 
         LOG_ALLOC("Parcel %p: taking ownership of %zu capacity", this, desired);
-        gParcelGlobalAllocSize += desired;
-        gParcelGlobalAllocCount++;
+        if (!inlineData) {
+            gParcelGlobalAllocSize += desired;
+            gParcelGlobalAllocCount++;
+        }
 
         mData = data;
         mObjects = objects;
         mDataSize = (mDataSize < desired) ? mDataSize : desired;
         ALOGV("continueWrite Setting data size of %p to %zu", this, mDataSize);
-        mDataCapacity = desired;
-        mObjectsSize = mObjectsCapacity = objectsSize;
+        mDataCapacity = inlineData ? kInlineDataCapacity : desired;
+        mObjectsSize = objectsSize;
+        mObjectsCapacity = objectsCapacity;
         mNextObjectHint = 0;
         mObjectsSorted = false;
 
@@ -2591,10 +2700,8 @@ status_t Parcel::continueWrite(size_t desired)
             }
 
             if (objectsSize == 0) {
-                free(mObjects);
-                mObjects = nullptr;
-                mObjectsCapacity = 0;
-            } else {
+                freeObjectsStorage();
+            } else if (mObjects != mInlineObjects) {
                 binder_size_t* objects =
                     (binder_size_t*)realloc(mObjects, objectsSize*sizeof(binder_size_t));
                 if (objects) {
@@ -2609,15 +2716,9 @@ status_t Parcel::continueWrite(size_t desired)
 
         // We own the data, so we can just do a realloc().
         if (desired > mDataCapacity) {
-            uint8_t* data = (uint8_t*)realloc(mData, desired);
-            if (data) {
-                LOG_ALLOC("Parcel %p: continue from %zu to %zu capacity", this, mDataCapacity,
-                        desired);
-                gParcelGlobalAllocSize += desired;
-                gParcelGlobalAllocSize -= mDataCapacity;
-                mData = data;
-                mDataCapacity = desired;
-            } else {
+            LOG_ALLOC("Parcel %p: continue from %zu to %zu capacity", this, mDataCapacity,
+                    desired);
+            if (reallocData(desired) != NO_ERROR) {
                 mError = NO_MEMORY;
                 return NO_MEMORY;
             }
@@ -2634,31 +2735,121 @@ status_t Parcel::continueWrite(size_t desired)
 
     } else {
         // This is the first data.  Easy!
-        uint8_t* data = (uint8_t*)malloc(desired);
-        if (!data) {
-            mError = NO_MEMORY;
-            return NO_MEMORY;
-        }
-
         if(!(mDataCapacity == 0 && mObjects == nullptr
              && mObjectsCapacity == 0)) {
             ALOGE("continueWrite: %zu/%p/%zu/%zu", mDataCapacity, mObjects, mObjectsCapacity, desired);
         }
 
         LOG_ALLOC("Parcel %p: allocating with %zu capacity", this, desired);
-        gParcelGlobalAllocSize += desired;
-        gParcelGlobalAllocCount++;
+        if (reallocData(desired) != NO_ERROR) {
+            mError = NO_MEMORY;
+            return NO_MEMORY;
+        }
 
-        mData = data;
         mDataSize = mDataPos = 0;
         ALOGV("continueWrite Setting data size of %p to %zu", this, mDataSize);
         ALOGV("continueWrite Setting data pos of %p to %zu", this, mDataPos);
+    }
+
+    return NO_ERROR;
+}
+
+// Resizes the data buffer this Parcel owns to hold at least desired bytes,
+// keeping its contents. Sizes that fit in mInlineData are served from there
+// until the data has had to move to the heap once. The global allocation
+// stats only track heap buffers.
+status_t Parcel::reallocData(size_t desired)
+{
+    const bool isHeap = mData != nullptr && mData != mInlineData;
+
+    if (desired == 0) {
+        freeDataStorage();
+        return NO_ERROR;
+    }
+
+    if (!isHeap && desired <= kInlineDataCapacity) {
+        mData = mInlineData;
+        mDataCapacity = kInlineDataCapacity;
+        return NO_ERROR;
+    }
+
+    if (isHeap) {
+        uint8_t* data = (uint8_t*)realloc(mData, desired);
+        if (!data) {
+            // Shrinking in place is fine if realloc() can't move the data
+            return desired > mDataCapacity ? NO_MEMORY : NO_ERROR;
+        }
+        gParcelGlobalAllocSize += desired;
+        gParcelGlobalAllocSize -= mDataCapacity;
+        mData = data;
         mDataCapacity = desired;
+        return NO_ERROR;
+    }
+
+    uint8_t* data = (uint8_t*)malloc(desired);
+    if (!data) {
+        return NO_MEMORY;
+    }
+    if (mData) {
+        memcpy(data, mData, mDataCapacity < desired ? mDataCapacity : desired);
+    }
+    gParcelGlobalAllocSize += desired;
+    gParcelGlobalAllocCount++;
+    mData = data;
+    mDataCapacity = desired;
+    return NO_ERROR;
+}
+
+void Parcel::freeDataStorage()
+{
+    if (mData && mData != mInlineData) {
+        LOG_ALLOC("Parcel %p: freeing with %zu capacity", this, mDataCapacity);
+        gParcelGlobalAllocSize -= mDataCapacity;
+        gParcelGlobalAllocCount--;
+        free(mData);
+    }
+    mData = nullptr;
+    mDataCapacity = 0;
+}
+
+// Same as reallocData, for the object offsets. Only the first mObjectsSize
+// entries are kept.
+status_t Parcel::reallocObjects(size_t capacity)
+{
+    const bool isHeap = mObjects != nullptr && mObjects != mInlineObjects;
+
+    if (!isHeap && capacity <= kInlineObjectsCapacity) {
+        mObjects = mInlineObjects;
+        mObjectsCapacity = kInlineObjectsCapacity;
+        return NO_ERROR;
     }
 
+    binder_size_t* objects;
+    if (isHeap) {
+        objects = (binder_size_t*)realloc(mObjects, capacity*sizeof(binder_size_t));
+        if (!objects) return NO_MEMORY;
+    } else {
+        objects = (binder_size_t*)malloc(capacity*sizeof(binder_size_t));
+        if (!objects) return NO_MEMORY;
+        if (mObjects) {
+            memcpy(objects, mObjects,
+                    (mObjectsSize < capacity ? mObjectsSize : capacity)*sizeof(binder_size_t));
+        }
+    }
+    mObjects = objects;
+    mObjectsCapacity = capacity;
     return NO_ERROR;
 }
 
+void Parcel::freeObjectsStorage()
+{
+    if (mObjects != mInlineObjects) {
+        free(mObjects);
+    }
+    mObjects = nullptr;
+    mObjectsCapacity = 0;
+}
+
 void Parcel::initState()
 {
     LOG_ALLOC("Parcel %p: initState", this);
@@ -2745,6 +2936,15 @@ void Parcel::Blob::init(int fd, void* data, size_t size, bool isMutable) {
     mData = data;
     mSize = size;
     mMutable = isMutable;
+    mHeap.clear();
+}
+
+void Parcel::Blob::init(const sp<IMemoryHeap>& heap, void* data, size_t size) {
+    mFd = -1;
+    mData = data;
+    mSize = size;
+    mMutable = false;
+    mHeap = heap;
 }
 
 void Parcel::Blob::clear() {
@@ -2752,6 +2952,7 @@ void Parcel::Blob::clear() {
     mData = nullptr;
     mSize = 0;
     mMutable = false;
+    mHeap.clear();
 }
 
 } // namespace android
@@ -25,13 +25,19 @@
 #include <cutils/atomic.h>
 #include <utils/Log.h>
 #include <utils/String8.h>
+#include <utils/SystemClock.h>
 #include <utils/threads.h>
 
 #include <private/binder/binder_module.h>
 #include "Static.h"
 
+#include <algorithm>
+#include <new>
+
 #include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
+#include <sched.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -42,6 +48,8 @@
 
 #define BINDER_VM_SIZE ((1 * 1024 * 1024) - sysconf(_SC_PAGE_SIZE) * 2)
 #define DEFAULT_MAX_BINDER_THREADS 15
+// How long every thread must be busy before an adaptive pool grows.
+#define ADAPTIVE_GROW_THRESHOLD_MS 10
 
 #ifdef __ANDROID_VNDK__
 const char* kDefaultDriver = "/dev/vndbinder";
@@ -132,6 +140,12 @@ void ProcessState::startThreadPool()
     }
 }
 
+bool ProcessState::isThreadPoolStarted() const
+{
+    AutoMutex _l(mLock);
+    return mThreadPoolStarted;
+}
+
 bool ProcessState::becomeContextManager(context_check_func checkFunc, void* userData)
 {
     AutoMutex _l(mLock);
@@ -223,26 +237,85 @@ void ProcessState::setCallRestriction(CallRestriction restriction) {
     mCallRestriction = restriction;
 }
 
+ProcessState::handle_entry* ProcessState::lookupHandle(int32_t handle) const
+{
+    if (handle < 0) return nullptr;
+    // Chunk k holds 2^(k + kFirstHandleChunkShift) handles.
+    const uint64_t index = static_cast<uint64_t>(handle) + (1u << kFirstHandleChunkShift);
+    const size_t bit = 63 - __builtin_clzll(index);
+    handle_entry* chunk =
+            mHandleChunks[bit - kFirstHandleChunkShift].load(std::memory_order_acquire);
+    if (chunk == nullptr) return nullptr;
+    return &chunk[index - (uint64_t(1) << bit)];
+}
+
 ProcessState::handle_entry* ProcessState::lookupHandleLocked(int32_t handle)
 {
-    const size_t N=mHandleToObject.size();
-    if (N <= (size_t)handle) {
-        handle_entry e;
-        e.binder = nullptr;
-        e.refs = nullptr;
-        status_t err = mHandleToObject.insertAt(e, N, handle+1-N);
-        if (err < NO_ERROR) return nullptr;
+    handle_entry* e = lookupHandle(handle);
+    if (e != nullptr || handle < 0) return e;
+
+    const uint64_t index = static_cast<uint64_t>(handle) + (1u << kFirstHandleChunkShift);
+    const size_t bit = 63 - __builtin_clzll(index);
+    handle_entry* chunk = new (std::nothrow) handle_entry[uint64_t(1) << bit]();
+    if (chunk == nullptr) return nullptr;
+    mHandleChunks[bit - kFirstHandleChunkShift].store(chunk, std::memory_order_release);
+    return &chunk[index - (uint64_t(1) << bit)];
+}
+
+void ProcessState::setHandleEntryLocked(handle_entry* e, IBinder* binder)
+{
+    const uint32_t seq = e->seq.load(std::memory_order_relaxed);
+    e->seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    e->binder.store(binder, std::memory_order_relaxed);
+    if (binder != nullptr) {
+        e->refs.store(binder->getWeakRefs(), std::memory_order_relaxed);
+    }
+    e->seq.store(seq + 2, std::memory_order_release);
+}
+
+void ProcessState::waitForHandleReadersLocked()
+{
+    // A reader may have picked its slot just before the first flip, so flip
+    // twice and drain whichever slot was current each time.
+    for (int i = 0; i < 2; i++) {
+        const uint32_t slot = mHandleReaderEpoch.fetch_add(1) & 1;
+        while (mHandleReaders[slot].load(std::memory_order_acquire) != 0) {
+            sched_yield();
+        }
     }
-    return &mHandleToObject.editItemAt(handle);
 }
 
 sp<IBinder> ProcessState::getStrongProxyForHandle(int32_t handle)
 {
     sp<IBinder> result;
 
+    // Fast path: the handle already has a live proxy. attemptIncWeak() on
+    // refs is safe without mLock because expungeHandle(), which the BpBinder
+    // destructor always calls before its refs are freed, waits for lookups
+    // like this one to finish.
+    const uint32_t slot = mHandleReaderEpoch.load() & 1;
+    mHandleReaders[slot].fetch_add(1);
+    handle_entry* e = lookupHandle(handle);
+    if (e != nullptr) {
+        const uint32_t seq = e->seq.load(std::memory_order_acquire);
+        IBinder* b = e->binder.load(std::memory_order_relaxed);
+        RefBase::weakref_type* refs = e->refs.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if ((seq & 1) == 0 && e->seq.load(std::memory_order_relaxed) == seq &&
+                b != nullptr && refs->attemptIncWeak(this)) {
+            result.force_set(b);
+            refs->decWeak(this);
+        }
+    }
+    mHandleReaders[slot].fetch_sub(1, std::memory_order_release);
+    if (result != nullptr) {
+        return result;
+    }
+
     AutoMutex _l(mLock);
 
-    handle_entry* e = lookupHandleLocked(handle);
+    e = lookupHandleLocked(handle);
 
     if (e != nullptr) {
         // We need to create a new BpBinder if there isn't currently one, OR we
@@ -252,8 +325,9 @@ sp<IBinder> ProcessState::getStrongProxyForHandle(int32_t handle)
         // We need to do this because there is a race condition between someone
         // releasing a reference on this BpBinder, and a new reference on its handle
         // arriving from the driver.
-        IBinder* b = e->binder;
-        if (b == nullptr || !e->refs->attemptIncWeak(this)) {
+        IBinder* b = e->binder.load(std::memory_order_relaxed);
+        RefBase::weakref_type* refs = e->refs.load(std::memory_order_relaxed);
+        if (b == nullptr || !refs->attemptIncWeak(this)) {
             if (handle == 0) {
                 // Special case for context manager...
                 // The context manager is the only object for which we create
@@ -282,15 +356,14 @@ sp<IBinder> ProcessState::getStrongProxyForHandle(int32_t handle)
             }
 
             b = BpBinder::create(handle);
-            e->binder = b;
-            if (b) e->refs = b->getWeakRefs();
+            setHandleEntryLocked(e, b);
             result = b;
         } else {
             // This little bit of nastyness is to allow us to add a primary
             // reference to the remote proxy when this team doesn't have one
             // but another team is sending the handle to us.
             result.force_set(b);
-            e->refs->decWeak(this);
+            refs->decWeak(this);
         }
     }
 
@@ -301,12 +374,17 @@ void ProcessState::expungeHandle(int32_t handle, IBinder* binder)
 {
     AutoMutex _l(mLock);
 
-    handle_entry* e = lookupHandleLocked(handle);
+    handle_entry* e = lookupHandle(handle);
 
     // This handle may have already been replaced with a new BpBinder
     // (if someone failed the AttemptIncWeak() above); we don't want
     // to overwrite it.
-    if (e && e->binder == binder) e->binder = nullptr;
+    if (e && e->binder.load(std::memory_order_relaxed) == binder) {
+        setHandleEntryLocked(e, nullptr);
+    }
+
+    // Even if it was replaced, a lookup may still hold our refs pointer.
+    waitForHandleReadersLocked();
 }
 
 String8 ProcessState::makeBinderThreadName() {
@@ -322,22 +400,116 @@ void ProcessState::spawnPooledThread(bool isMain)
     if (mThreadPoolStarted) {
         String8 name = makeBinderThreadName();
         ALOGV("Spawning new pooled thread, name=%s\n", name.string());
+        pthread_mutex_lock(&mThreadCountLock);
+        mSpawnCount++;
+        if (!isMain) {
+            mLivePooledThreads++;
+        }
+        pthread_mutex_unlock(&mThreadCountLock);
         sp<Thread> t = new PoolThread(isMain);
         t->run(name.string());
     }
 }
 
 status_t ProcessState::setThreadPoolMaxThreadCount(size_t maxThreads) {
-    status_t result = NO_ERROR;
-    if (ioctl(mDriverFD, BINDER_SET_MAX_THREADS, &maxThreads) != -1) {
-        mMaxThreads = maxThreads;
-    } else {
-        result = -errno;
-        ALOGE("Binder ioctl to set max threads failed: %s", strerror(-result));
+    pthread_mutex_lock(&mThreadCountLock);
+    mAdaptive = false;
+    status_t result = setDriverMaxThreadsLocked(maxThreads);
+    pthread_mutex_unlock(&mThreadCountLock);
+    return result;
+}
+
+status_t ProcessState::setThreadPoolAdaptive(size_t minThreads, size_t maxThreads,
+                                             int64_t idleTimeoutMs) {
+    if (minThreads > maxThreads || idleTimeoutMs <= 0) {
+        return BAD_VALUE;
+    }
+    pthread_mutex_lock(&mThreadCountLock);
+    const size_t limit = std::min(std::max(mMaxThreads, minThreads), maxThreads);
+    status_t result = setDriverMaxThreadsLocked(limit);
+    if (result == NO_ERROR) {
+        mAdaptive = true;
+        mAdaptiveMinThreads = minThreads;
+        mAdaptiveMaxThreads = maxThreads;
+        mAdaptiveIdleTimeoutMs = idleTimeoutMs;
+        mLastStarvationEndMs = uptimeMillis();
+        mLastRetireMs = mLastStarvationEndMs;
     }
+    pthread_mutex_unlock(&mThreadCountLock);
     return result;
 }
 
+status_t ProcessState::setDriverMaxThreadsLocked(size_t maxThreads) {
+    size_t driverMaxThreads = maxThreads + mRetireCount;
+    if (ioctl(mDriverFD, BINDER_SET_MAX_THREADS, &driverMaxThreads) == -1) {
+        status_t result = -errno;
+        ALOGE("Binder ioctl to set max threads failed: %s", strerror(-result));
+        return result;
+    }
+    mMaxThreads = maxThreads;
+    return NO_ERROR;
+}
+
+void ProcessState::onStarvationEndLocked(int64_t starvationTimeMs) {
+    mLastStarvationEndMs = uptimeMillis();
+    if (starvationTimeMs > mMaxStarvationMs) {
+        mMaxStarvationMs = starvationTimeMs;
+    }
+    if (mAdaptive && starvationTimeMs >= ADAPTIVE_GROW_THRESHOLD_MS &&
+            mMaxThreads < mAdaptiveMaxThreads) {
+        // The driver sends BR_SPAWN_LOOPER for the new slot on its own.
+        setDriverMaxThreadsLocked(mMaxThreads + 1);
+    }
+}
+
+bool ProcessState::shouldRetirePooledThread() {
+    bool retire = false;
+    pthread_mutex_lock(&mThreadCountLock);
+    if (mAdaptive && mStarvationStartTimeMs == 0 && mLivePooledThreads > mAdaptiveMinThreads) {
+        const int64_t now = uptimeMillis();
+        if (now - mLastStarvationEndMs >= mAdaptiveIdleTimeoutMs &&
+                now - mLastRetireMs >= mAdaptiveIdleTimeoutMs) {
+            // Lowering the limit and raising the retire count together
+            // leaves the driver's limit where it is, which is what keeps
+            // it from asking for a replacement.
+            mLivePooledThreads--;
+            mRetireCount++;
+            setDriverMaxThreadsLocked(
+                    mMaxThreads > mAdaptiveMinThreads ? mMaxThreads - 1 : mAdaptiveMinThreads);
+            mLastRetireMs = now;
+            retire = true;
+        }
+    }
+    pthread_mutex_unlock(&mThreadCountLock);
+    return retire;
+}
+
+ProcessState::ThreadPoolStats ProcessState::getThreadPoolStats() {
+    ThreadPoolStats stats;
+    pthread_mutex_lock(&mThreadCountLock);
+    stats.busyThreads = mExecutingThreadsCount;
+    stats.peakBusyThreads = mPeakExecutingThreadsCount;
+    stats.threadLimit = mMaxThreads;
+    stats.spawnCount = mSpawnCount;
+    stats.retireCount = mRetireCount;
+    stats.maxWaitMs = mMaxStarvationMs;
+    if (mStarvationStartTimeMs != 0) {
+        stats.maxWaitMs = std::max(stats.maxWaitMs, uptimeMillis() - mStarvationStartTimeMs);
+    }
+    stats.adaptive = mAdaptive;
+    pthread_mutex_unlock(&mThreadCountLock);
+    return stats;
+}
+
+void ProcessState::dumpThreadPoolStats(int fd) {
+    const ThreadPoolStats stats = getThreadPoolStats();
+    dprintf(fd, "Binder thread pool (%s):\n", stats.adaptive ? "adaptive" : "fixed");
+    dprintf(fd, "  busy threads: %zu (peak %zu)\n", stats.busyThreads, stats.peakBusyThreads);
+    dprintf(fd, "  thread limit: %zu\n", stats.threadLimit);
+    dprintf(fd, "  spawned: %zu retired: %zu\n", stats.spawnCount, stats.retireCount);
+    dprintf(fd, "  max wait: %" PRId64 " ms\n", stats.maxWaitMs);
+}
+
 void ProcessState::giveThreadPoolName() {
     androidSetThreadName( makeBinderThreadName().string() );
 }
@@ -383,6 +555,20 @@ ProcessState::ProcessState(const char *driver)
     , mExecutingThreadsCount(0)
     , mMaxThreads(DEFAULT_MAX_BINDER_THREADS)
     , mStarvationStartTimeMs(0)
+    , mLastStarvationEndMs(0)
+    , mMaxStarvationMs(0)
+    , mPeakExecutingThreadsCount(0)
+    , mLivePooledThreads(0)
+    , mSpawnCount(0)
+    , mRetireCount(0)
+    , mAdaptive(false)
+    , mAdaptiveMinThreads(0)
+    , mAdaptiveMaxThreads(0)
+    , mAdaptiveIdleTimeoutMs(0)
+    , mLastRetireMs(0)
+    , mHandleChunks{}
+    , mHandleReaderEpoch(0)
+    , mHandleReaders{}
     , mBinderContextCheckFunc(nullptr)
     , mBinderContextUserData(nullptr)
     , mThreadPoolStarted(false)
@@ -414,6 +600,9 @@ ProcessState::ProcessState(const char *driver)
 
 ProcessState::~ProcessState()
 {
+    for (size_t i = 0; i < kHandleChunkCount; i++) {
+        delete[] mHandleChunks[i].load(std::memory_order_relaxed);
+    }
     if (mDriverFD >= 0) {
         if (mVMStart != MAP_FAILED) {
             munmap(mVMStart, BINDER_VM_SIZE);
@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "TransactionStats"
+
+#include <binder/TransactionStats.h>
+
+#include <binder/IBinder.h>
+#include <binder/ProcessState.h>
+#include <utils/String8.h>
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <utility>
+
+namespace android {
+
+std::atomic<bool> TransactionStats::sEnabled(false);
+
+namespace {
+
+struct Histogram {
+    uint64_t count = 0;
+    int64_t totalUs = 0;
+    int64_t maxUs = 0;
+    std::array<uint64_t, TransactionStats::kBucketCount> buckets{};
+
+    void add(int64_t us) {
+        size_t bucket = 0;
+        if (us > 1) {
+            bucket = std::min<size_t>(63 - __builtin_clzll(static_cast<uint64_t>(us)),
+                                      TransactionStats::kBucketCount - 1);
+        }
+        buckets[bucket]++;
+        count++;
+        totalUs += us;
+        maxUs = std::max(maxUs, us);
+    }
+
+    void mergeInto(TransactionStats::Entry* entry) const {
+        entry->count += count;
+        entry->totalUs += totalUs;
+        entry->maxUs = std::max(entry->maxUs, maxUs);
+        for (size_t i = 0; i < buckets.size(); i++) {
+            entry->buckets[i] += buckets[i];
+        }
+    }
+};
+
+struct ServerHistogram {
+    // Holding a copy keeps the descriptor's buffer, and so the key, alive.
+    String16 descriptor;
+    Histogram histogram;
+};
+
+std::mutex gLock;
+// Keyed by (handle, code). Descriptors are looked up in snapshot().
+std::map<std::pair<int32_t, uint32_t>, Histogram> gClient;
+// Keyed by (descriptor buffer, code). Generated code hands out one static
+// descriptor per interface, so comparing buffers is enough on the call path.
+std::map<std::pair<const char16_t*, uint32_t>, ServerHistogram> gServer;
+
+TransactionStats::Entry* findOrAdd(std::vector<TransactionStats::Entry>* entries,
+                                   const String16& descriptor, uint32_t code, bool server) {
+    for (auto& entry : *entries) {
+        if (entry.code == code && entry.server == server && entry.descriptor == descriptor) {
+            return &entry;
+        }
+    }
+    entries->push_back({descriptor, code, server, 0, 0, 0, {}});
+    return &entries->back();
+}
+
+} // namespace
+
+void TransactionStats::setEnabled(bool enabled) {
+    sEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+void TransactionStats::recordClient(int32_t handle, uint32_t code, nsecs_t latency) {
+    std::lock_guard<std::mutex> _l(gLock);
+    gClient[std::make_pair(handle, code)].add(ns2us(latency));
+}
+
+void TransactionStats::recordServer(const String16& descriptor, uint32_t code,
+                                    nsecs_t latency) {
+    std::lock_guard<std::mutex> _l(gLock);
+    ServerHistogram& server = gServer[std::make_pair(descriptor.string(), code)];
+    if (server.histogram.count == 0) {
+        server.descriptor = descriptor;
+    }
+    server.histogram.add(ns2us(latency));
+}
+
+std::vector<TransactionStats::Entry> TransactionStats::snapshot() {
+    std::map<std::pair<int32_t, uint32_t>, Histogram> client;
+    std::vector<Entry> entries;
+    {
+        std::lock_guard<std::mutex> _l(gLock);
+        client = gClient;
+        for (const auto& [key, server] : gServer) {
+            server.histogram.mergeInto(findOrAdd(&entries, server.descriptor, key.second, true));
+        }
+    }
+
+    // Handles are reused once their proxy goes away, so samples are credited
+    // to whatever interface the handle refers to now.
+    sp<ProcessState> proc = ProcessState::selfOrNull();
+    std::map<int32_t, String16> descriptors;
+    for (const auto& [key, histogram] : client) {
+        const int32_t handle = key.first;
+        auto it = descriptors.find(handle);
+        if (it == descriptors.end()) {
+            String16 descriptor;
+            sp<IBinder> binder = proc != nullptr ? proc->getStrongProxyForHandle(handle) : nullptr;
+            if (binder != nullptr) {
+                descriptor = binder->getInterfaceDescriptor();
+            }
+            if (descriptor.size() == 0) {
+                descriptor = String16(String8::format("<handle %d>", handle));
+            }
+            it = descriptors.emplace(handle, descriptor).first;
+        }
+        histogram.mergeInto(findOrAdd(&entries, it->second, key.second, false));
+    }
+    return entries;
+}
+
+void TransactionStats::dump(int fd) {
+    const std::vector<Entry> entries = snapshot();
+    dprintf(fd, "Binder transaction latency (%s):\n", isEnabled() ? "enabled" : "disabled");
+    for (const Entry& entry : entries) {
+        dprintf(fd, "  %s %s code %u: count %" PRIu64 " avg %" PRId64 " us max %" PRId64 " us\n",
+                entry.server ? "server" : "client", String8(entry.descriptor).c_str(),
+                entry.code, entry.count,
+                entry.count > 0 ? entry.totalUs / static_cast<int64_t>(entry.count) : 0,
+                entry.maxUs);
+        dprintf(fd, "    buckets (log2 us):");
+        for (uint64_t bucket : entry.buckets) {
+            dprintf(fd, " %" PRIu64, bucket);
+        }
+        dprintf(fd, "\n");
+    }
+}
+
+void TransactionStats::reset() {
+    std::lock_guard<std::mutex> _l(gLock);
+    gClient.clear();
+    gServer.clear();
+}
+
+} // namespace android
@@ -22,6 +22,9 @@
 #include <binder/ProcessState.h>
 #include <utils/Vector.h>
 
+#include <memory>
+#include <vector>
+
 #if defined(_WIN32)
 typedef  int  uid_t;
 #endif
@@ -93,6 +96,22 @@ public:
             status_t            handlePolledCommands();
             void                flushCommands();
 
+            // Queues the one-way transactions made by this thread until the
+            // matching flushOnewayBatch(), so that they reach the driver in a
+            // single BINDER_WRITE_READ instead of one each. While a batch is
+            // open, one-way transact() returns NO_ERROR as soon as the call is
+            // queued; delivery errors are reported by flushOnewayBatch().
+            // Batches nest, and only the outermost flush submits. A two-way
+            // transaction, flushCommands() or a full batch submits what has
+            // been queued so far, preserving call order.
+            void                beginOnewayBatch();
+            // Closes the innermost batch. Returns the first error seen by any
+            // transaction submitted since the outermost beginOnewayBatch().
+            status_t            flushOnewayBatch();
+
+            // Debugging: number of BINDER_WRITE_READ ioctls this thread has made.
+            uint64_t            getDriverCallCount() const;
+
             void                joinThreadPool(bool isMain = true);
             
             // Stop the local process.
@@ -164,6 +183,7 @@ private:
             void                processPostWriteDerefs();
 
             void                clearCaller();
+            status_t            submitOnewayBatch();
 
     static  void                threadDestructor(void *st);
     static  void                freeBuffer(Parcel* parcel,
@@ -192,6 +212,16 @@ private:
             int32_t             mLastTransactionBinderFlags;
 
             ProcessState::CallRestriction mCallRestriction;
+
+    static  const size_t        kMaxOnewayBatchSize = 32;
+            size_t              mOnewayBatchDepth;
+            status_t            mOnewayBatchError;
+            // Owned copies of the batched transaction data; the BC_TRANSACTION
+            // commands queued in mOut point into these until the driver has
+            // consumed them.
+            std::vector<std::unique_ptr<Parcel>> mOnewayBatch;
+            size_t              mOnewayBatchPending;
+            uint64_t            mDriverCallCount;
 };
 
 } // namespace android
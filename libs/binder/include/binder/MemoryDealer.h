@@ -27,19 +27,44 @@
 namespace android {
 // ----------------------------------------------------------------------------
 
-class SimpleBestFitAllocator;
+class MemoryDealerAllocator;
 
 // ----------------------------------------------------------------------------
 
 class MemoryDealer : public RefBase
 {
 public:
+    enum Policy {
+        // Best fit over a list of chunks. Packs tightly, but allocate and
+        // deallocate scan the whole list under one lock.
+        BEST_FIT = 0,
+        // Binary buddy blocks with per-size free lists: constant time
+        // allocate and deallocate, and recently freed small blocks are
+        // recycled without taking the lock. Sizes are rounded up to a
+        // power of two of at least 128 bytes.
+        BUDDY = 1,
+    };
+
+    struct Stats {
+        size_t heapSize;
+        // Bytes handed out, including rounding up to the policy's block sizes.
+        size_t allocatedBytes;
+        size_t allocationCount;
+        size_t freeBytes;
+        size_t freeBlockCount;
+        // freeBytes split over many small blocks, with a small largest free
+        // block, means the heap is fragmented.
+        size_t largestFreeBlock;
+    };
+
     explicit MemoryDealer(size_t size, const char* name = nullptr,
             uint32_t flags = 0 /* or bits such as MemoryHeapBase::READ_ONLY */ );
+    MemoryDealer(size_t size, const char* name, uint32_t flags, Policy policy);
 
     virtual sp<IMemory> allocate(size_t size);
     virtual void        deallocate(size_t offset);
     virtual void        dump(const char* what) const;
+    Stats               getStats() const;
 
     // allocations are aligned to some value. return that value so clients can account for it.
     static size_t      getAllocationAlignment();
@@ -51,10 +76,10 @@ protected:
 
 private:
     const sp<IMemoryHeap>&      heap() const;
-    SimpleBestFitAllocator*     allocator() const;
+    MemoryDealerAllocator*      allocator() const;
 
     sp<IMemoryHeap>             mHeap;
-    SimpleBestFitAllocator*     mAllocator;
+    MemoryDealerAllocator*      mAllocator;
 };
 
 
@@ -17,8 +17,10 @@
 #ifndef ANDROID_PARCEL_H
 #define ANDROID_PARCEL_H
 
+#include <cstring>
 #include <map> // for legacy reasons
 #include <string>
+#include <string_view>
 #include <type_traits>
 #include <vector>
 
@@ -31,6 +33,7 @@
 #include <utils/Flattenable.h>
 
 #include <binder/IInterface.h>
+#include <binder/IMemory.h>
 #include <binder/Parcelable.h>
 
 #ifdef BINDER_IPC_32BIT
@@ -48,6 +51,7 @@ template <typename T> class LightFlattenable;
 struct flat_binder_object;
 class IBinder;
 class IPCThreadState;
+class MemoryDealer;
 class ProcessState;
 class String8;
 class TextOutput;
@@ -242,6 +246,17 @@ public:
     // The caller should call release() on the blob after writing its contents.
     status_t            writeBlob(size_t len, bool mutableCopy, WritableBlob* outBlob);
 
+    // Writes a blob to the parcel, carving large blobs out of arena instead of
+    // creating a new ashmem region. Only the arena's heap binder and an offset
+    // are sent; the receiver maps the heap once and keeps that mapping across
+    // transactions from the same arena. The space is returned to the arena
+    // when this Parcel is freed, so use this only for the data of synchronous
+    // transactions, whose receivers must be done reading the blob by the time
+    // they return. Small blobs are stored in-place, and if arena is full the
+    // blob falls back to an immutable ashmem copy as with writeBlob.
+    status_t            writeBlob(const sp<MemoryDealer>& arena, size_t len,
+                                  WritableBlob* outBlob);
+
     // Write an existing immutable blob file descriptor to the parcel.
     // This allows the client to send the same blob to multiple processes
     // as long as it keeps a dup of the blob file descriptor handy for later.
@@ -289,6 +304,11 @@ public:
     status_t            readString16(String16* pArg) const;
     status_t            readString16(std::unique_ptr<String16>* pArg) const;
     const char16_t*     readString16Inplace(size_t* outLen) const;
+
+    // Read a string without copying it. The view points into the Parcel's
+    // data, so it is only valid until the Parcel is modified or destroyed.
+    status_t            readString8View(std::string_view* pArg) const;
+    status_t            readString16View(std::u16string_view* pArg) const;
     sp<IBinder>         readStrongBinder() const;
     status_t            readStrongBinder(sp<IBinder>* val) const;
     status_t            readNullableStrongBinder(sp<IBinder>* val) const;
@@ -448,6 +468,10 @@ private:
     status_t            growData(size_t len);
     status_t            restartWrite(size_t desired);
     status_t            continueWrite(size_t desired);
+    status_t            reallocData(size_t desired);
+    void                freeDataStorage();
+    status_t            reallocObjects(size_t capacity);
+    void                freeObjectsStorage();
     status_t            writePointer(uintptr_t val);
     status_t            readPointer(uintptr_t *pArg) const;
     uintptr_t           readPointer() const;
@@ -513,6 +537,20 @@ private:
     status_t            writeTypedVector(const std::vector<T>& val,
                                          status_t(Parcel::*write_func)(T));
 
+    // Vectors of trivially copyable, 4-byte-multiple elements are laid out
+    // exactly as writeTypedVector would write them, so these copy the
+    // elements in one go instead of one write/read call per element.
+    template<typename T>
+    status_t            writeTrivialVector(const std::vector<T>& val);
+    template<typename T>
+    status_t            writeTrivialVector(const std::unique_ptr<std::vector<T>>& val);
+    template<typename T>
+    status_t            readTrivialVector(std::vector<T>* val) const;
+    template<typename T>
+    status_t            readTrivialVector(std::unique_ptr<std::vector<T>>* val) const;
+    template<typename T>
+    status_t            readTrivialVectorInternal(std::vector<T>* val, int32_t size) const;
+
     status_t            mError;
     uint8_t*            mData;
     size_t              mDataSize;
@@ -547,11 +585,13 @@ private:
 
     protected:
         void init(int fd, void* data, size_t size, bool isMutable);
+        void init(const sp<IMemoryHeap>& heap, void* data, size_t size);
 
         int mFd; // owned by parcel so not closed when released
         void* mData;
         size_t mSize;
         bool mMutable;
+        sp<IMemoryHeap> mHeap; // keeps an arena blob mapped
     };
 
     #if defined(__clang__)
@@ -620,6 +660,17 @@ public:
 private:
     size_t mOpenAshmemSize;
 
+    // Small transactions are written into these instead of the heap. mData
+    // and mObjects point here while they do, and move to the heap once a
+    // write outgrows them.
+    static constexpr size_t kInlineDataCapacity = 256;
+    static constexpr size_t kInlineObjectsCapacity = 4;
+    alignas(binder_size_t) uint8_t mInlineData[kInlineDataCapacity];
+    binder_size_t mInlineObjects[kInlineObjectsCapacity];
+
+    // Arena space handed out by writeBlob, held until the data is freed
+    std::vector<sp<IMemory>> mBlobAllocations;
+
 public:
     // TODO: Remove once ABI can be changed.
     size_t getBlobAshmemSize() const;
@@ -920,6 +971,102 @@ status_t Parcel::writeNullableTypedVector(const std::unique_ptr<std::vector<T>>&
     return unsafeWriteTypedVector(*val, write_func);
 }
 
+template<typename T>
+status_t Parcel::writeTrivialVector(const std::vector<T>& val) {
+    static_assert(std::is_trivially_copyable_v<T> && sizeof(T) % sizeof(int32_t) == 0);
+
+    if (val.size() > std::numeric_limits<int32_t>::max() / sizeof(T)) {
+        return BAD_VALUE;
+    }
+
+    // Make room for the size and every element up front
+    const size_t len = sizeof(int32_t) + val.size() * sizeof(T);
+    if (mDataPos + len > mDataCapacity) {
+        status_t status = growData(len);
+        if (status != OK) {
+            return status;
+        }
+    }
+
+    status_t status = this->writeInt32(static_cast<int32_t>(val.size()));
+
+    if (status != OK) {
+        return status;
+    }
+
+    return write(val.data(), val.size() * sizeof(T));
+}
+
+template<typename T>
+status_t Parcel::writeTrivialVector(const std::unique_ptr<std::vector<T>>& val) {
+    if (val.get() == nullptr) {
+        return this->writeInt32(-1);
+    }
+
+    return writeTrivialVector(*val);
+}
+
+template<typename T>
+status_t Parcel::readTrivialVectorInternal(std::vector<T>* val, int32_t size) const {
+    static_assert(std::is_trivially_copyable_v<T> && sizeof(T) % sizeof(int32_t) == 0);
+
+    if (static_cast<size_t>(size) > std::numeric_limits<int32_t>::max() / sizeof(T)) {
+        return NOT_ENOUGH_DATA;
+    }
+
+    // Check that every element is there before sizing the vector, so a bogus
+    // size can't make us allocate more than the Parcel holds
+    const size_t len = static_cast<size_t>(size) * sizeof(T);
+    const void* data = readInplace(len);
+    if (data == nullptr) {
+        return NOT_ENOUGH_DATA;
+    }
+
+    val->resize(static_cast<size_t>(size));
+    if (len > 0) {
+        std::memcpy(val->data(), data, len);
+    }
+
+    return OK;
+}
+
+template<typename T>
+status_t Parcel::readTrivialVector(std::vector<T>* val) const {
+    int32_t size;
+    status_t status = this->readInt32(&size);
+
+    if (status != OK) {
+        return status;
+    }
+
+    if (size < 0) {
+        return UNEXPECTED_NULL;
+    }
+
+    return readTrivialVectorInternal(val, size);
+}
+
+template<typename T>
+status_t Parcel::readTrivialVector(std::unique_ptr<std::vector<T>>* val) const {
+    int32_t size;
+    status_t status = readInt32(&size);
+    val->reset();
+
+    if (status != OK || size < 0) {
+        return status;
+    }
+
+    val->reset(new std::vector<T>());
+
+    status = readTrivialVectorInternal(val->get(), size);
+
+    if (status != OK) {
+        val->reset();
+    }
+
+    return status;
+}
+
 template<typename T>
 status_t Parcel::readParcelableVector(std::vector<T>* val) const {
     return unsafeReadTypedVector<T, Parcelable>(val, &Parcel::readParcelable);
@@ -1019,11 +1166,11 @@ status_t Parcel::writeEnumVector(const std::unique_ptr<std::vector<T>>& val) {
 }
 template<typename T, std::enable_if_t<std::is_enum_v<T> && !std::is_same_v<typename std::underlying_type_t<T>,int8_t>, bool>>
 status_t Parcel::writeEnumVector(const std::vector<T>& val) {
-    return writeTypedVector(val, &Parcel::writeEnum);
+    return writeTrivialVector(val);
 }
 template<typename T, std::enable_if_t<std::is_enum_v<T> && !std::is_same_v<typename std::underlying_type_t<T>,int8_t>, bool>>
 status_t Parcel::writeEnumVector(const std::unique_ptr<std::vector<T>>& val) {
-    return writeNullableTypedVector(val, &Parcel::writeEnum);
+    return writeTrivialVector(val);
 }
 
 template<typename T, std::enable_if_t<std::is_same_v<typename std::underlying_type_t<T>,int32_t>, bool>>
@@ -1065,11 +1212,11 @@ status_t Parcel::readEnumVector(std::unique_ptr<std::vector<T>>* val) const {
 }
 template<typename T, std::enable_if_t<std::is_enum_v<T> && !std::is_same_v<typename std::underlying_type_t<T>,int8_t>, bool>>
 status_t Parcel::readEnumVector(std::vector<T>* val) const {
-    return readTypedVector(val, &Parcel::readEnum);
+    return readTrivialVector(val);
 }
 template<typename T, std::enable_if_t<std::is_enum_v<T> && !std::is_same_v<typename std::underlying_type_t<T>,int8_t>, bool>>
 status_t Parcel::readEnumVector(std::unique_ptr<std::vector<T>>* val) const {
-    return readNullableTypedVector(val, &Parcel::readEnum);
+    return readTrivialVector(val);
 }
 
 // ---------------------------------------------------------------------------
@@ -24,6 +24,8 @@
 
 #include <utils/threads.h>
 
+#include <atomic>
+
 #include <pthread.h>
 
 // ---------------------------------------------------------------------------
@@ -48,6 +50,9 @@ public:
             sp<IBinder>         getContextObject(const sp<IBinder>& caller);
 
             void                startThreadPool();
+                                // True once startThreadPool() has been called, meaning
+                                // incoming calls such as callbacks will be serviced.
+            bool                isThreadPoolStarted() const;
                         
     typedef bool (*context_check_func)(const String16& name,
                                        const sp<IBinder>& caller,
@@ -63,6 +68,35 @@ public:
             void                spawnPooledThread(bool isMain);
             
             status_t            setThreadPoolMaxThreadCount(size_t maxThreads);
+
+                                // Lets the pool size follow the load instead of a fixed cap.
+                                // The pool starts at minThreads and gets one more thread each
+                                // time every thread has been busy long enough for incoming
+                                // calls to queue, up to maxThreads. A pooled thread retires
+                                // once the pool has gone idleTimeoutMs without saturating,
+                                // one thread per timeout, never dropping below minThreads.
+                                // Calling setThreadPoolMaxThreadCount() leaves adaptive mode.
+            status_t            setThreadPoolAdaptive(size_t minThreads, size_t maxThreads,
+                                                      int64_t idleTimeoutMs);
+
+            struct ThreadPoolStats {
+                // Threads currently executing a command.
+                size_t          busyThreads;
+                // Highest busyThreads seen so far.
+                size_t          peakBusyThreads;
+                // Current thread limit; changes over time in adaptive mode.
+                size_t          threadLimit;
+                size_t          spawnCount;
+                size_t          retireCount;
+                // Longest time the pool has stayed saturated, which bounds
+                // how long an incoming call waited for a thread.
+                int64_t         maxWaitMs;
+                bool            adaptive;
+            };
+            ThreadPoolStats     getThreadPoolStats();
+                                // Writes getThreadPoolStats() in dumpsys format to fd.
+            void                dumpThreadPoolStats(int fd);
+
             void                giveThreadPoolName();
 
             String8             getDriverName();
@@ -99,12 +133,32 @@ private:
             ProcessState&       operator=(const ProcessState& o);
             String8             makeBinderThreadName();
 
+            // Written under mLock, read without it by getStrongProxyForHandle().
             struct handle_entry {
-                IBinder* binder;
-                RefBase::weakref_type* refs;
+                std::atomic<IBinder*> binder;
+                std::atomic<RefBase::weakref_type*> refs;
+                // Odd while binder and refs are being rewritten.
+                std::atomic<uint32_t> seq;
             };
 
+            // Handles live in chunks that double in size and are never moved
+            // or freed, so a lookup never races with the table growing.
+            static constexpr size_t kFirstHandleChunkShift = 6;
+            static constexpr size_t kHandleChunkCount = 32 - kFirstHandleChunkShift;
+
+            // Returns nullptr if the handle's chunk has not been allocated.
+            handle_entry*       lookupHandle(int32_t handle) const;
             handle_entry*       lookupHandleLocked(int32_t handle);
+            void                setHandleEntryLocked(handle_entry* e, IBinder* binder);
+            // Waits until no lock-free lookup can still be using a value that
+            // was in the table before this call.
+            void                waitForHandleReadersLocked();
+
+            status_t            setDriverMaxThreadsLocked(size_t maxThreads);
+            // Called with mThreadCountLock held when the pool stops being saturated.
+            void                onStarvationEndLocked(int64_t starvationTimeMs);
+            // Called by a non-main pooled thread between commands; true if it should exit.
+            bool                shouldRetirePooledThread();
 
             String8             mDriverName;
             int                 mDriverFD;
@@ -119,10 +173,28 @@ private:
             size_t              mMaxThreads;
             // Time when thread pool was emptied
             int64_t             mStarvationStartTimeMs;
+            int64_t             mLastStarvationEndMs;
+            int64_t             mMaxStarvationMs;
+            size_t              mPeakExecutingThreadsCount;
+            // Non-main pooled threads started by spawnPooledThread() and still running.
+            size_t              mLivePooledThreads;
+            size_t              mSpawnCount;
+            // The driver never forgets threads it asked for, so retired
+            // threads are added to the limit we hand it.
+            size_t              mRetireCount;
+            bool                mAdaptive;
+            size_t              mAdaptiveMinThreads;
+            size_t              mAdaptiveMaxThreads;
+            int64_t             mAdaptiveIdleTimeoutMs;
+            int64_t             mLastRetireMs;
 
     mutable Mutex               mLock;  // protects everything below.
 
-            Vector<handle_entry>mHandleToObject;
+            std::atomic<handle_entry*> mHandleChunks[kHandleChunkCount];
+            // Lookups in progress, split by the parity of mHandleReaderEpoch
+            // when they started.
+            std::atomic<uint32_t> mHandleReaderEpoch;
+            std::atomic<int32_t> mHandleReaders[2];
 
             context_check_func  mBinderContextCheckFunc;
             void*               mBinderContextUserData;
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <utils/String16.h>
+#include <utils/Timers.h>
+
+#include <array>
+#include <atomic>
+#include <vector>
+
+namespace android {
+
+class BBinder;
+class IPCThreadState;
+
+// Per-process binder call latency histograms, keyed by interface descriptor
+// and transaction code. Off by default; while disabled, the only cost on the
+// transaction path is one relaxed atomic load.
+//
+// Client-side samples cover two-way calls made through IPCThreadState, from
+// the moment the call is handed to the driver until the reply arrives.
+// Server-side samples cover BBinder::transact() for every incoming call.
+class TransactionStats final {
+public:
+    // Bucket i counts calls that took [2^i, 2^(i+1)) microseconds. Bucket 0
+    // also takes anything faster and the last bucket anything slower.
+    static constexpr size_t kBucketCount = 20;
+
+    struct Entry {
+        String16 descriptor;
+        uint32_t code;
+        // false for calls made by this process, true for calls it served.
+        bool server;
+        uint64_t count;
+        int64_t totalUs;
+        int64_t maxUs;
+        std::array<uint64_t, kBucketCount> buckets;
+    };
+
+    static void setEnabled(bool enabled);
+    static bool isEnabled() { return sEnabled.load(std::memory_order_relaxed); }
+
+    // Copies out all histograms, e.g. for a stats atom puller. Client-side
+    // descriptors are looked up here rather than on the call path, so this
+    // may itself make binder calls and must not be called with locks held
+    // that an incoming call could need.
+    static std::vector<Entry> snapshot();
+    // Writes snapshot() in dumpsys format to fd.
+    static void dump(int fd);
+    static void reset();
+
+private:
+    friend class BBinder;
+    friend class IPCThreadState;
+
+    static void recordClient(int32_t handle, uint32_t code, nsecs_t latency);
+    static void recordServer(const String16& descriptor, uint32_t code, nsecs_t latency);
+
+    static std::atomic<bool> sEnabled;
+
+    TransactionStats();
+};
+
+} // namespace android
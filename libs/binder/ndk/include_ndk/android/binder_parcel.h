@@ -1119,6 +1119,172 @@ binder_status_t AParcel_readByteArray(const AParcel* parcel, void* arrayData,
 // @END-PRIMITIVE-READ-WRITE
 
 #endif  //__ANDROID_API__ >= 29
+
+#if __ANDROID_API__ >= 31
+
+/**
+ * Reads an array of int32_t from the next location in a non-null parcel into a caller-provided
+ * buffer, without going through an allocator callback.
+ *
+ * If the array is longer than capacity, nothing is read, the parcel position is left where it
+ * was, *outLength is set to the array's length and STATUS_BAD_VALUE is returned, so the caller
+ * can retry with a bigger buffer or fall back to AParcel_readInt32Array.
+ *
+ * Available since API level 31.
+ *
+ * \param parcel the parcel to read from.
+ * \param buffer where to put the array (may be null if capacity is 0).
+ * \param capacity the number of elements buffer can hold.
+ * \param outLength set to the length of the array, or -1 if a null array was read.
+ *
+ * \return STATUS_OK on successful read.
+ */
+binder_status_t AParcel_readInt32ArrayInto(const AParcel* parcel, int32_t* buffer, int32_t capacity,
+                                           int32_t* outLength) __INTRODUCED_IN(31);
+
+/**
+ * Reads an array of uint32_t from the next location in a non-null parcel into a caller-provided
+ * buffer, without going through an allocator callback.
+ *
+ * If the array is longer than capacity, nothing is read, the parcel position is left where it
+ * was, *outLength is set to the array's length and STATUS_BAD_VALUE is returned, so the caller
+ * can retry with a bigger buffer or fall back to AParcel_readUint32Array.
+ *
+ * Available since API level 31.
+ *
+ * \param parcel the parcel to read from.
+ * \param buffer where to put the array (may be null if capacity is 0).
+ * \param capacity the number of elements buffer can hold.
+ * \param outLength set to the length of the array, or -1 if a null array was read.
+ *
+ * \return STATUS_OK on successful read.
+ */
+binder_status_t AParcel_readUint32ArrayInto(const AParcel* parcel, uint32_t* buffer,
+                                            int32_t capacity, int32_t* outLength)
+        __INTRODUCED_IN(31);
+
+/**
+ * Reads an array of int64_t from the next location in a non-null parcel into a caller-provided
+ * buffer, without going through an allocator callback.
+ *
+ * If the array is longer than capacity, nothing is read, the parcel position is left where it
+ * was, *outLength is set to the array's length and STATUS_BAD_VALUE is returned, so the caller
+ * can retry with a bigger buffer or fall back to AParcel_readInt64Array.
+ *
+ * Available since API level 31.
+ *
+ * \param parcel the parcel to read from.
+ * \param buffer where to put the array (may be null if capacity is 0).
+ * \param capacity the number of elements buffer can hold.
+ * \param outLength set to the length of the array, or -1 if a null array was read.
+ *
+ * \return STATUS_OK on successful read.
+ */
+binder_status_t AParcel_readInt64ArrayInto(const AParcel* parcel, int64_t* buffer, int32_t capacity,
+                                           int32_t* outLength) __INTRODUCED_IN(31);
+
+/**
+ * Reads an array of uint64_t from the next location in a non-null parcel into a caller-provided
+ * buffer, without going through an allocator callback.
+ *
+ * If the array is longer than capacity, nothing is read, the parcel position is left where it
+ * was, *outLength is set to the array's length and STATUS_BAD_VALUE is returned, so the caller
+ * can retry with a bigger buffer or fall back to AParcel_readUint64Array.
+ *
+ * Available since API level 31.
+ *
+ * \param parcel the parcel to read from.
+ * \param buffer where to put the array (may be null if capacity is 0).
+ * \param capacity the number of elements buffer can hold.
+ * \param outLength set to the length of the array, or -1 if a null array was read.
+ *
+ * \return STATUS_OK on successful read.
+ */
+binder_status_t AParcel_readUint64ArrayInto(const AParcel* parcel, uint64_t* buffer,
+                                            int32_t capacity, int32_t* outLength)
+        __INTRODUCED_IN(31);
+
+/**
+ * Reads an array of float from the next location in a non-null parcel into a caller-provided
+ * buffer, without going through an allocator callback.
+ *
+ * If the array is longer than capacity, nothing is read, the parcel position is left where it
+ * was, *outLength is set to the array's length and STATUS_BAD_VALUE is returned, so the caller
+ * can retry with a bigger buffer or fall back to AParcel_readFloatArray.
+ *
+ * Available since API level 31.
+ *
+ * \param parcel the parcel to read from.
+ * \param buffer where to put the array (may be null if capacity is 0).
+ * \param capacity the number of elements buffer can hold.
+ * \param outLength set to the length of the array, or -1 if a null array was read.
+ *
+ * \return STATUS_OK on successful read.
+ */
+binder_status_t AParcel_readFloatArrayInto(const AParcel* parcel, float* buffer, int32_t capacity,
+                                           int32_t* outLength) __INTRODUCED_IN(31);
+
+/**
+ * Reads an array of double from the next location in a non-null parcel into a caller-provided
+ * buffer, without going through an allocator callback.
+ *
+ * If the array is longer than capacity, nothing is read, the parcel position is left where it
+ * was, *outLength is set to the array's length and STATUS_BAD_VALUE is returned, so the caller
+ * can retry with a bigger buffer or fall back to AParcel_readDoubleArray.
+ *
+ * Available since API level 31.
+ *
+ * \param parcel the parcel to read from.
+ * \param buffer where to put the array (may be null if capacity is 0).
+ * \param capacity the number of elements buffer can hold.
+ * \param outLength set to the length of the array, or -1 if a null array was read.
+ *
+ * \return STATUS_OK on successful read.
+ */
+binder_status_t AParcel_readDoubleArrayInto(const AParcel* parcel, double* buffer, int32_t capacity,
+                                            int32_t* outLength) __INTRODUCED_IN(31);
+
+/**
+ * Reads an array of char16_t from the next location in a non-null parcel into a caller-provided
+ * buffer, without going through an allocator callback.
+ *
+ * If the array is longer than capacity, nothing is read, the parcel position is left where it
+ * was, *outLength is set to the array's length and STATUS_BAD_VALUE is returned, so the caller
+ * can retry with a bigger buffer or fall back to AParcel_readCharArray.
+ *
+ * Available since API level 31.
+ *
+ * \param parcel the parcel to read from.
+ * \param buffer where to put the array (may be null if capacity is 0).
+ * \param capacity the number of elements buffer can hold.
+ * \param outLength set to the length of the array, or -1 if a null array was read.
+ *
+ * \return STATUS_OK on successful read.
+ */
+binder_status_t AParcel_readCharArrayInto(const AParcel* parcel, char16_t* buffer, int32_t capacity,
+                                          int32_t* outLength) __INTRODUCED_IN(31);
+
+/**
+ * Reads an array of int8_t from the next location in a non-null parcel into a caller-provided
+ * buffer, without going through an allocator callback.
+ *
+ * If the array is longer than capacity, nothing is read, the parcel position is left where it
+ * was, *outLength is set to the array's length and STATUS_BAD_VALUE is returned, so the caller
+ * can retry with a bigger buffer or fall back to AParcel_readByteArray.
+ *
+ * Available since API level 31.
+ *
+ * \param parcel the parcel to read from.
+ * \param buffer where to put the array (may be null if capacity is 0).
+ * \param capacity the number of elements buffer can hold.
+ * \param outLength set to the length of the array, or -1 if a null array was read.
+ *
+ * \return STATUS_OK on successful read.
+ */
+binder_status_t AParcel_readByteArrayInto(const AParcel* parcel, int8_t* buffer, int32_t capacity,
+                                          int32_t* outLength) __INTRODUCED_IN(31);
+
+#endif  //__ANDROID_API__ >= 31
 __END_DECLS
 
 /** @} */
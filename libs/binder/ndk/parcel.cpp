@@ -22,6 +22,7 @@
 #include "status_internal.h"
 
 #include <limits>
+#include <type_traits>
 
 #include <android-base/logging.h>
 #include <android-base/unique_fd.h>
@@ -91,15 +92,15 @@ binder_status_t WriteArray<char16_t>(AParcel* parcel, const char16_t* array, int
     if (status != STATUS_OK) return status;
     if (length <= 0) return STATUS_OK;
 
-    int32_t size = 0;
-    if (__builtin_smul_overflow(sizeof(char16_t), length, &size)) return STATUS_NO_MEMORY;
+    // Reserve every widened slot at once rather than growing per element.
+    int32_t wireSize = 0;
+    if (__builtin_smul_overflow(sizeof(int32_t), length, &wireSize)) return STATUS_NO_MEMORY;
 
-    Parcel* rawParcel = parcel->get();
+    int32_t* const data = static_cast<int32_t*>(parcel->get()->writeInplace(wireSize));
+    if (data == nullptr) return STATUS_NO_MEMORY;
 
     for (int32_t i = 0; i < length; i++) {
-        status = rawParcel->writeChar(array[i]);
-
-        if (status != STATUS_OK) return PruneStatusT(status);
+        data[i] = static_cast<int32_t>(array[i]);
     }
 
     return STATUS_OK;
@@ -151,13 +152,59 @@ binder_status_t ReadArray<char16_t>(const AParcel* parcel, void* arrayData,
     if (length <= 0) return STATUS_OK;
     if (array == nullptr) return STATUS_NO_MEMORY;
 
-    int32_t size = 0;
-    if (__builtin_smul_overflow(sizeof(char16_t), length, &size)) return STATUS_NO_MEMORY;
+    int32_t wireSize = 0;
+    if (__builtin_smul_overflow(sizeof(int32_t), length, &wireSize)) return STATUS_NO_MEMORY;
+
+    const int32_t* data = static_cast<const int32_t*>(rawParcel->readInplace(wireSize));
+    if (data == nullptr) return STATUS_NO_MEMORY;
 
     for (int32_t i = 0; i < length; i++) {
-        status = rawParcel->readChar(array + i);
+        array[i] = static_cast<char16_t>(data[i]);
+    }
 
-        if (status != STATUS_OK) return PruneStatusT(status);
+    return STATUS_OK;
+}
+
+// Reads the length and the array payload, leaving the parcel untouched if the
+// array does not fit so the caller can retry with a bigger buffer.
+template <typename T>
+binder_status_t ReadArrayInto(const AParcel* parcel, T* buffer, int32_t capacity,
+                              int32_t* outLength) {
+    if (capacity < 0 || (buffer == nullptr && capacity > 0) || outLength == nullptr) {
+        return STATUS_BAD_VALUE;
+    }
+
+    const Parcel* rawParcel = parcel->get();
+    const size_t start = rawParcel->dataPosition();
+
+    int32_t length;
+    status_t status = rawParcel->readInt32(&length);
+
+    if (status != STATUS_OK) return PruneStatusT(status);
+    if (length < -1) return STATUS_BAD_VALUE;
+
+    *outLength = length;
+    if (length <= 0) return STATUS_OK;
+    if (length > capacity) {
+        rawParcel->setDataPosition(start);
+        return STATUS_BAD_VALUE;
+    }
+
+    // char16_t travels widened to int32_t, everything else packed.
+    constexpr size_t kWireSize = std::is_same<T, char16_t>::value ? sizeof(int32_t) : sizeof(T);
+    int32_t size = 0;
+    if (__builtin_smul_overflow(kWireSize, length, &size)) return STATUS_NO_MEMORY;
+
+    const void* data = rawParcel->readInplace(size);
+    if (data == nullptr) return STATUS_NO_MEMORY;
+
+    if constexpr (std::is_same<T, char16_t>::value) {
+        const int32_t* wide = static_cast<const int32_t*>(data);
+        for (int32_t i = 0; i < length; i++) {
+            buffer[i] = static_cast<char16_t>(wide[i]);
+        }
+    } else {
+        memcpy(buffer, data, size);
     }
 
     return STATUS_OK;
@@ -648,3 +695,43 @@ bool AParcel_getAllowFds(const AParcel* parcel) {
 }
 
 // @END
+
+binder_status_t AParcel_readInt32ArrayInto(const AParcel* parcel, int32_t* buffer, int32_t capacity,
+                                           int32_t* outLength) {
+    return ReadArrayInto<int32_t>(parcel, buffer, capacity, outLength);
+}
+
+binder_status_t AParcel_readUint32ArrayInto(const AParcel* parcel, uint32_t* buffer,
+                                            int32_t capacity, int32_t* outLength) {
+    return ReadArrayInto<uint32_t>(parcel, buffer, capacity, outLength);
+}
+
+binder_status_t AParcel_readInt64ArrayInto(const AParcel* parcel, int64_t* buffer, int32_t capacity,
+                                           int32_t* outLength) {
+    return ReadArrayInto<int64_t>(parcel, buffer, capacity, outLength);
+}
+
+binder_status_t AParcel_readUint64ArrayInto(const AParcel* parcel, uint64_t* buffer,
+                                            int32_t capacity, int32_t* outLength) {
+    return ReadArrayInto<uint64_t>(parcel, buffer, capacity, outLength);
+}
+
+binder_status_t AParcel_readFloatArrayInto(const AParcel* parcel, float* buffer, int32_t capacity,
+                                           int32_t* outLength) {
+    return ReadArrayInto<float>(parcel, buffer, capacity, outLength);
+}
+
+binder_status_t AParcel_readDoubleArrayInto(const AParcel* parcel, double* buffer, int32_t capacity,
+                                            int32_t* outLength) {
+    return ReadArrayInto<double>(parcel, buffer, capacity, outLength);
+}
+
+binder_status_t AParcel_readCharArrayInto(const AParcel* parcel, char16_t* buffer, int32_t capacity,
+                                          int32_t* outLength) {
+    return ReadArrayInto<char16_t>(parcel, buffer, capacity, outLength);
+}
+
+binder_status_t AParcel_readByteArrayInto(const AParcel* parcel, int8_t* buffer, int32_t capacity,
+                                          int32_t* outLength) {
+    return ReadArrayInto<int8_t>(parcel, buffer, capacity, outLength);
+}
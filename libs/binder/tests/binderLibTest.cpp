@@ -1117,6 +1117,23 @@ TEST_F(BinderLibTest, VectorSent) {
     EXPECT_EQ(readValue, testValue);
 }
 
+TEST_F(BinderLibTest, ReadStringViews) {
+    Parcel data;
+    data.writeString16(String16("binder"));
+    data.writeString8(String8("parcel"));
+    data.writeString16(nullptr, 0);
+    data.setDataPosition(0);
+
+    std::u16string_view string16;
+    EXPECT_EQ(NO_ERROR, data.readString16View(&string16));
+    EXPECT_EQ(u"binder", string16);
+    std::string_view string8;
+    EXPECT_EQ(NO_ERROR, data.readString8View(&string8));
+    EXPECT_EQ("parcel", string8);
+    EXPECT_EQ(UNEXPECTED_NULL, data.readString16View(&string16));
+    EXPECT_TRUE(string16.empty());
+}
+
 TEST_F(BinderLibTest, BufRejected) {
     Parcel data, reply;
     uint32_t buf;
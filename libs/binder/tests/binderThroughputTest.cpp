@@ -11,7 +11,10 @@
 #include <vector>
 #include <tuple>
 
+#include <fcntl.h>
+#include <sched.h>
 #include <unistd.h>
+#include <sys/resource.h>
 #include <sys/wait.h>
 
 using namespace std;
@@ -19,6 +22,24 @@ using namespace android;
 
 enum BinderWorkerServiceCode {
     BINDER_NOP = IBinder::FIRST_CALL_TRANSACTION,
+    // Replies with the nice value of the thread serving the call.
+    BINDER_GET_PRIORITY,
+};
+
+// Shape of the traffic each client sends.
+struct Workload {
+    // Payload size in bytes is drawn uniformly from [payload_min, payload_max].
+    int payload_min = 0;
+    int payload_max = 0;
+    int binders_per_call = 0;
+    int fds_per_call = 0;
+    // Percentage of calls sent one-way.
+    int oneway_percent = 0;
+    // Pin worker N to CPU N modulo the number of CPUs.
+    bool pin_cpus = false;
+    // Run clients at this nice value and check that servers inherit it.
+    bool check_priority = false;
+    int client_nice = 0;
 };
 
 #define ASSERT_TRUE(cond) \
@@ -39,10 +60,11 @@ public:
                                 uint32_t flags = 0) {
         (void)flags;
         (void)data;
-        (void)reply;
         switch (code) {
         case BINDER_NOP:
             return NO_ERROR;
+        case BINDER_GET_PRIORITY:
+            return reply->writeInt32(getpriority(PRIO_PROCESS, 0));
         default:
             return UNKNOWN_TRANSACTION;
         };
@@ -111,6 +133,13 @@ struct ProcResults {
     uint64_t m_long_transactions = 0;
     uint64_t m_total_time = 0;
     uint64_t m_best = max_time_bucket;
+    // Sum over transactions of the Parcel heap buffers alive right after each
+    // transaction returned
+    uint64_t m_parcel_allocs = 0;
+    // BINDER_WRITE_READ ioctls made by the calling thread
+    uint64_t m_driver_calls = 0;
+    // Two-way calls served at a different nice value than the caller's
+    uint64_t m_priority_mismatches = 0;
 
     void add_time(uint64_t time) {
         if (time > max_time_bucket) {
@@ -132,9 +161,16 @@ struct ProcResults {
         ret.m_transactions = a.m_transactions + b.m_transactions;
         ret.m_long_transactions = a.m_long_transactions + b.m_long_transactions;
         ret.m_total_time = a.m_total_time + b.m_total_time;
+        ret.m_parcel_allocs = a.m_parcel_allocs + b.m_parcel_allocs;
+        ret.m_driver_calls = a.m_driver_calls + b.m_driver_calls;
+        ret.m_priority_mismatches = a.m_priority_mismatches + b.m_priority_mismatches;
         return ret;
     }
     void dump() {
+        if (m_transactions == 0) {
+            cout << "no transactions" << endl;
+            return;
+        }
         if (m_long_transactions > 0) {
             cout << (double)m_long_transactions / m_transactions << "% of transactions took longer "
                 "than estimated max latency. Consider setting -m to be higher than "
@@ -145,24 +181,27 @@ struct ProcResults {
         double worst = (double)m_worst / 1.0E6;
         double average = (double)m_total_time / m_transactions / 1.0E6;
         cout << "average:" << average << "ms worst:" << worst << "ms best:" << best << "ms" << endl;
+        cout << "parcel heap allocations per transaction: "
+             << (double)m_parcel_allocs / m_transactions << endl;
+        cout << "driver calls per transaction: "
+             << (double)m_driver_calls / m_transactions << endl;
+        if (m_priority_mismatches > 0) {
+            cout << m_priority_mismatches << " transactions did not inherit the caller's priority"
+                 << endl;
+        }
 
+        static const double percentiles[] = {0.5, 0.9, 0.95, 0.99, 0.999};
         uint64_t cur_total = 0;
+        size_t next = 0;
         float time_per_bucket_ms = time_per_bucket / 1.0E6;
         for (int i = 0; i < num_buckets; i++) {
             float cur_time = time_per_bucket_ms * i + 0.5f * time_per_bucket_ms;
-            if ((cur_total < 0.5f * m_transactions) && (cur_total + m_buckets[i] >= 0.5f * m_transactions)) {
-                cout << "50%: " << cur_time << " ";
-            }
-            if ((cur_total < 0.9f * m_transactions) && (cur_total + m_buckets[i] >= 0.9f * m_transactions)) {
-                cout << "90%: " << cur_time << " ";
-            }
-            if ((cur_total < 0.95f * m_transactions) && (cur_total + m_buckets[i] >= 0.95f * m_transactions)) {
-                cout << "95%: " << cur_time << " ";
-            }
-            if ((cur_total < 0.99f * m_transactions) && (cur_total + m_buckets[i] >= 0.99f * m_transactions)) {
-                cout << "99%: " << cur_time << " ";
-            }
             cur_total += m_buckets[i];
+            while (next < sizeof(percentiles) / sizeof(percentiles[0]) &&
+                   cur_total >= percentiles[next] * m_transactions) {
+                cout << percentiles[next] * 100 << "%: " << cur_time << " ";
+                next++;
+            }
         }
         cout << endl;
     }
@@ -179,10 +218,18 @@ String16 generateServiceName(int num)
 void worker_fx(int num,
                int worker_count,
                int iterations,
-               int payload_size,
+               const Workload& workload,
                bool cs_pair,
                Pipe p)
 {
+    if (workload.pin_cpus) {
+        // Binder threads started below inherit the mask.
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(num % sysconf(_SC_NPROCESSORS_ONLN), &cpus);
+        ASSERT_TRUE(sched_setaffinity(0, sizeof(cpus), &cpus) == 0);
+    }
+
     // Create BinderWorkerService and for go.
     ProcessState::self()->startThreadPool();
     sp<IServiceManager> serviceMgr = defaultServiceManager();
@@ -207,24 +254,57 @@ void worker_fx(int num,
         workers.push_back(serviceMgr->getService(generateServiceName(i)));
     }
 
+    // Objects to send along with each call; the driver translates them on
+    // every transaction, which is the cost we want to see.
+    sp<IBinder> token = new BBinder;
+    int null_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    ASSERT_TRUE(null_fd >= 0);
+
+    const bool is_client = !cs_pair || num >= server_count;
+    if (is_client && workload.check_priority) {
+        ASSERT_TRUE(setpriority(PRIO_PROCESS, 0, workload.client_nice) == 0);
+    }
+
     // Run the benchmark if client
     ProcResults results;
+    ProcResults oneway_results;
+    IPCThreadState* ipc = IPCThreadState::self();
     chrono::time_point<chrono::high_resolution_clock> start, end;
-    for (int i = 0; (!cs_pair || num >= server_count) && i < iterations; i++) {
+    for (int i = 0; is_client && i < iterations; i++) {
         Parcel data, reply;
         int target = cs_pair ? num % server_count : rand() % workers.size();
-        int sz = payload_size;
+        int sz = workload.payload_min;
+        if (workload.payload_max > workload.payload_min) {
+            sz += rand() % (workload.payload_max - workload.payload_min + 1);
+        }
+        const bool oneway = rand() % 100 < workload.oneway_percent;
+        const uint32_t code =
+                workload.check_priority && !oneway ? BINDER_GET_PRIORITY : BINDER_NOP;
 
         while (sz >= sizeof(uint32_t)) {
             data.writeInt32(0);
             sz -= sizeof(uint32_t);
         }
+        for (int j = 0; j < workload.binders_per_call; j++) {
+            data.writeStrongBinder(token);
+        }
+        for (int j = 0; j < workload.fds_per_call; j++) {
+            data.writeFileDescriptor(null_fd);
+        }
+        const uint64_t driver_calls = ipc->getDriverCallCount();
         start = chrono::high_resolution_clock::now();
-        status_t ret = workers[target]->transact(BINDER_NOP, data, &reply);
+        status_t ret = workers[target]->transact(code, data, &reply,
+                                                 oneway ? IBinder::FLAG_ONEWAY : 0);
         end = chrono::high_resolution_clock::now();
 
+        ProcResults& cur_results = oneway ? oneway_results : results;
         uint64_t cur_time = uint64_t(chrono::duration_cast<chrono::nanoseconds>(end - start).count());
-        results.add_time(cur_time);
+        cur_results.add_time(cur_time);
+        cur_results.m_parcel_allocs += Parcel::getGlobalAllocCount();
+        cur_results.m_driver_calls += ipc->getDriverCallCount() - driver_calls;
+        if (code == BINDER_GET_PRIORITY && reply.readInt32() != workload.client_nice) {
+            cur_results.m_priority_mismatches++;
+        }
 
         if (ret != NO_ERROR) {
            cout << "thread " << num << " failed " << ret << "i : " << i << endl;
@@ -238,12 +318,14 @@ void worker_fx(int num,
 
     // Send results to master and wait for go to exit.
     p.send(results);
+    p.send(oneway_results);
     p.wait();
 
     exit(EXIT_SUCCESS);
 }
 
-Pipe make_worker(int num, int iterations, int worker_count, int payload_size, bool cs_pair)
+Pipe make_worker(int num, int iterations, int worker_count, const Workload& workload,
+                 bool cs_pair)
 {
     auto pipe_pair = Pipe::createPipePair();
     pid_t pid = fork();
@@ -252,7 +334,7 @@ Pipe make_worker(int num, int iterations, int worker_count, int payload_size, bo
         return move(get<0>(pipe_pair));
     } else {
         /* child */
-        worker_fx(num, worker_count, iterations, payload_size, cs_pair, move(get<1>(pipe_pair)));
+        worker_fx(num, worker_count, iterations, workload, cs_pair, move(get<1>(pipe_pair)));
         /* never get here */
         return move(get<0>(pipe_pair));
     }
@@ -275,14 +357,14 @@ void signal_all(vector<Pipe>& v)
 
 void run_main(int iterations,
               int workers,
-              int payload_size,
+              const Workload& workload,
               int cs_pair,
               bool training_round=false)
 {
     vector<Pipe> pipes;
     // Create all the workers and wait for them to spawn.
     for (int i = 0; i < workers; i++) {
-        pipes.push_back(make_worker(i, iterations, workers, payload_size, cs_pair));
+        pipes.push_back(make_worker(i, iterations, workers, workload, cs_pair));
     }
     wait_all(pipes);
 
@@ -302,10 +384,13 @@ void run_main(int iterations,
     cout << "collecting results" << endl;
     signal_all(pipes);
     ProcResults tot_results;
+    ProcResults tot_oneway_results;
     for (int i = 0; i < workers; i++) {
         ProcResults tmp_results;
         pipes[i].recv(tmp_results);
         tot_results = ProcResults::combine(tot_results, tmp_results);
+        pipes[i].recv(tmp_results);
+        tot_oneway_results = ProcResults::combine(tot_oneway_results, tmp_results);
     }
 
     // Kill all the workers.
@@ -326,6 +411,10 @@ void run_main(int iterations,
         cout << "Max latency during training: " << tot_results.m_worst / 1.0E6 << "ms" << endl;
     } else {
             tot_results.dump();
+            if (workload.oneway_percent > 0) {
+                cout << "one-way:" << endl;
+                tot_oneway_results.dump();
+            }
     }
 }
 
@@ -333,7 +422,7 @@ int main(int argc, char *argv[])
 {
     int workers = 2;
     int iterations = 10000;
-    int payload_size = 0;
+    Workload workload;
     bool cs_pair = false;
     bool training_round = false;
     (void)argc;
@@ -343,10 +432,16 @@ int main(int argc, char *argv[])
     for (int i = 1; i < argc; i++) {
         if (string(argv[i]) == "--help") {
             cout << "Usage: binderThroughputTest [OPTIONS]" << endl;
+            cout << "\t-a      : Pin each worker to one CPU." << endl;
+            cout << "\t-b N    : Send N binder objects with each call." << endl;
+            cout << "\t-f N    : Send N file descriptors with each call." << endl;
             cout << "\t-i N    : Specify number of iterations." << endl;
             cout << "\t-m N    : Specify expected max latency in microseconds." << endl;
+            cout << "\t-n N    : Run clients at nice N and check servers inherit it." << endl;
+            cout << "\t-o N    : Send N percent of calls one-way." << endl;
             cout << "\t-p      : Split workers into client/server pairs." << endl;
             cout << "\t-s N    : Specify payload size." << endl;
+            cout << "\t-S N:M  : Draw payload sizes uniformly from N to M bytes." << endl;
             cout << "\t-t N    : Run training round." << endl;
             cout << "\t-w N    : Specify total number of workers." << endl;
             return 0;
@@ -362,9 +457,43 @@ int main(int argc, char *argv[])
             continue;
         }
         if (string(argv[i]) == "-s") {
-            payload_size = atoi(argv[i+1]);
+            workload.payload_min = workload.payload_max = atoi(argv[i+1]);
             i++;
         }
+        if (string(argv[i]) == "-S") {
+            if (sscanf(argv[i+1], "%d:%d", &workload.payload_min, &workload.payload_max) != 2 ||
+                workload.payload_min < 0 || workload.payload_max < workload.payload_min) {
+                cout << "Payload range -S must be MIN:MAX." << endl;
+                exit(EXIT_FAILURE);
+            }
+            i++;
+            continue;
+        }
+        if (string(argv[i]) == "-b") {
+            workload.binders_per_call = atoi(argv[i+1]);
+            i++;
+            continue;
+        }
+        if (string(argv[i]) == "-f") {
+            workload.fds_per_call = atoi(argv[i+1]);
+            i++;
+            continue;
+        }
+        if (string(argv[i]) == "-o") {
+            workload.oneway_percent = atoi(argv[i+1]);
+            i++;
+            continue;
+        }
+        if (string(argv[i]) == "-n") {
+            workload.check_priority = true;
+            workload.client_nice = atoi(argv[i+1]);
+            i++;
+            continue;
+        }
+        if (string(argv[i]) == "-a") {
+            workload.pin_cpus = true;
+            continue;
+        }
         if (string(argv[i]) == "-p") {
             // client/server pairs instead of spreading
             // requests to all workers. If true, half
@@ -392,10 +521,10 @@ int main(int argc, char *argv[])
 
     if (training_round) {
         cout << "Start training round" << endl;
-        run_main(iterations, workers, payload_size, cs_pair, training_round=true);
+        run_main(iterations, workers, workload, cs_pair, training_round=true);
         cout << "Completed training round" << endl << endl;
     }
 
-    run_main(iterations, workers, payload_size, cs_pair);
+    run_main(iterations, workers, workload, cs_pair);
     return 0;
 }
@@ -22,8 +22,12 @@
 #include <dirent.h>
 #include <errno.h>
 #include <inttypes.h>
+#include <sys/syscall.h>
 #include <sys/sysinfo.h>
+#include <unistd.h>
 
+#include <atomic>
+#include <functional>
 #include <mutex>
 #include <numeric>
 #include <optional>
@@ -59,6 +63,22 @@ static std::set<uint32_t> gAllFreqs;
 static unique_fd gTisMapFd;
 static unique_fd gConcurrentMapFd;
 static unique_fd gUidLastUpdateMapFd;
+// Set once the kernel has rejected BPF_MAP_LOOKUP_BATCH, which needs 5.6 or later.
+static std::atomic<bool> gNoBatchLookup = false;
+
+// BPF_MAP_LOOKUP_BATCH and its part of union bpf_attr, which the uapi headers we build against
+// may predate.
+constexpr int kBpfMapLookupBatch = 24;
+struct bpf_batch_attr {
+    uint64_t in_batch;
+    uint64_t out_batch;
+    uint64_t keys;
+    uint64_t values;
+    uint32_t count;
+    uint32_t map_fd;
+    uint64_t elem_flags;
+    uint64_t flags;
+};
 
 static std::optional<std::vector<uint32_t>> readNumbersFromFile(const std::string &path) {
     std::string data;
@@ -271,6 +291,73 @@ std::optional<std::vector<std::vector<uint64_t>>> getUidCpuFreqTimes(uint32_t ui
     return out;
 }
 
+// Calls fn(key, vals) for every entry of the per-CPU map mapFd whose key passes filter, where vals
+// holds one value per CPU. filter returns no value on error. Entries are fetched many at a time
+// with BPF_MAP_LOOKUP_BATCH where the kernel supports it; otherwise the keys are walked one by one
+// and filtered out entries are never looked up. Returns false on error.
+template <class Key, class Val>
+static bool forEachPerCpuEntry(const unique_fd &mapFd,
+                               const std::function<std::optional<bool>(const Key &)> &filter,
+                               const std::function<void(const Key &, const Val *)> &fn) {
+    // The kernel pads per-CPU values to 8 bytes in batches, but not in single lookups.
+    static_assert(sizeof(Val) % 8 == 0);
+    if (!gNoBatchLookup) {
+        uint32_t batchSize = 256;
+        std::vector<Key> keys;
+        std::vector<Val> vals;
+        // Hash maps, which are all we read, use a 32-bit bucket index as the batch position.
+        uint64_t inBatch = 0, outBatch = 0;
+        bool first = true;
+        while (true) {
+            keys.resize(batchSize);
+            vals.resize(batchSize * gNCpus);
+            bpf_batch_attr attr = {
+                    .in_batch = first ? 0 : reinterpret_cast<uint64_t>(&inBatch),
+                    .out_batch = reinterpret_cast<uint64_t>(&outBatch),
+                    .keys = reinterpret_cast<uint64_t>(keys.data()),
+                    .values = reinterpret_cast<uint64_t>(vals.data()),
+                    .count = batchSize,
+                    .map_fd = static_cast<uint32_t>(mapFd.get()),
+                    .elem_flags = 0,
+                    .flags = 0,
+            };
+            int ret = syscall(__NR_bpf, kBpfMapLookupBatch, &attr, sizeof(attr));
+            int err = ret ? errno : 0;
+            if (err == ENOSPC && attr.count == 0) {
+                // A single hash bucket holds more entries than fit in a batch.
+                batchSize *= 2;
+                continue;
+            }
+            if (err && err != ENOENT) {
+                if (!first) return false;
+                gNoBatchLookup = true;
+                break;
+            }
+            for (uint32_t i = 0; i < attr.count; ++i) {
+                auto wanted = filter(keys[i]);
+                if (!wanted.has_value()) return false;
+                if (*wanted) fn(keys[i], &vals[i * gNCpus]);
+            }
+            // ENOENT means that this was the last batch.
+            if (err == ENOENT) return true;
+            inBatch = outBatch;
+            first = false;
+        }
+    }
+
+    Key key, prevKey;
+    if (getFirstMapKey(mapFd, &key)) return errno == ENOENT;
+    std::vector<Val> vals(gNCpus);
+    do {
+        auto wanted = filter(key);
+        if (!wanted.has_value()) return false;
+        if (!*wanted) continue;
+        if (findMapEntry(mapFd, &key, vals.data())) return false;
+        fn(key, vals.data());
+    } while (prevKey = key, !getNextMapKey(mapFd, &prevKey, &key));
+    return errno == ENOENT;
+}
+
 static std::optional<bool> uidUpdatedSince(uint32_t uid, uint64_t lastUpdate,
                                            uint64_t *newLastUpdate) {
     uint64_t uidLastUpdate;
@@ -300,41 +387,32 @@ getUidsCpuFreqTimes() {
 std::optional<std::unordered_map<uint32_t, std::vector<std::vector<uint64_t>>>>
 getUidsUpdatedCpuFreqTimes(uint64_t *lastUpdate) {
     if (!gInitialized && !initGlobals()) return {};
-    time_key_t key, prevKey;
     std::unordered_map<uint32_t, std::vector<std::vector<uint64_t>>> map;
-    if (getFirstMapKey(gTisMapFd, &key)) {
-        if (errno == ENOENT) return map;
-        return std::nullopt;
-    }
 
     std::vector<std::vector<uint64_t>> mapFormat;
     for (const auto &freqList : gPolicyFreqs) mapFormat.emplace_back(freqList.size(), 0);
 
     uint64_t newLastUpdate = lastUpdate ? *lastUpdate : 0;
-    std::vector<tis_val_t> vals(gNCpus);
-    do {
-        if (lastUpdate) {
-            auto uidUpdated = uidUpdatedSince(key.uid, *lastUpdate, &newLastUpdate);
-            if (!uidUpdated.has_value()) return {};
-            if (!*uidUpdated) continue;
-        }
-        if (findMapEntry(gTisMapFd, &key, vals.data())) return {};
-        if (map.find(key.uid) == map.end()) map.emplace(key.uid, mapFormat);
+    auto filter = [&](const time_key_t &key) -> std::optional<bool> {
+        if (!lastUpdate) return true;
+        return uidUpdatedSince(key.uid, *lastUpdate, &newLastUpdate);
+    };
+    auto add = [&](const time_key_t &key, const tis_val_t *vals) {
+        auto &times = map.try_emplace(key.uid, mapFormat).first->second;
 
         auto offset = key.bucket * FREQS_PER_ENTRY;
         auto nextOffset = (key.bucket + 1) * FREQS_PER_ENTRY;
         for (uint32_t i = 0; i < gNPolicies; ++i) {
             if (offset >= gPolicyFreqs[i].size()) continue;
-            auto begin = map[key.uid][i].begin() + offset;
+            auto begin = times[i].begin() + offset;
             auto end = nextOffset < gPolicyFreqs[i].size() ? begin + FREQS_PER_ENTRY :
-                map[key.uid][i].end();
+                times[i].end();
             for (const auto &cpu : gPolicyCpus[i]) {
                 std::transform(begin, end, std::begin(vals[cpu].ar), begin, std::plus<uint64_t>());
             }
         }
-        prevKey = key;
-    } while (prevKey = key, !getNextMapKey(gTisMapFd, &prevKey, &key));
-    if (errno != ENOENT) return {};
+    };
+    if (!forEachPerCpuEntry<time_key_t, tis_val_t>(gTisMapFd, filter, add)) return {};
     if (lastUpdate && newLastUpdate > *lastUpdate) *lastUpdate = newLastUpdate;
     return map;
 }
@@ -410,34 +488,24 @@ std::optional<std::unordered_map<uint32_t, concurrent_time_t>> getUidsConcurrent
 std::optional<std::unordered_map<uint32_t, concurrent_time_t>> getUidsUpdatedConcurrentTimes(
         uint64_t *lastUpdate) {
     if (!gInitialized && !initGlobals()) return {};
-    time_key_t key, prevKey;
     std::unordered_map<uint32_t, concurrent_time_t> ret;
-    if (getFirstMapKey(gConcurrentMapFd, &key)) {
-        if (errno == ENOENT) return ret;
-        return {};
-    }
 
     concurrent_time_t retFormat = {.active = std::vector<uint64_t>(gNCpus, 0)};
     for (const auto &cpuList : gPolicyCpus) retFormat.policy.emplace_back(cpuList.size(), 0);
 
-    std::vector<concurrent_val_t> vals(gNCpus);
-    std::vector<uint64_t>::iterator activeBegin, activeEnd, policyBegin, policyEnd;
-
     uint64_t newLastUpdate = lastUpdate ? *lastUpdate : 0;
-    do {
-        if (lastUpdate) {
-            auto uidUpdated = uidUpdatedSince(key.uid, *lastUpdate, &newLastUpdate);
-            if (!uidUpdated.has_value()) return {};
-            if (!*uidUpdated) continue;
-        }
-        if (findMapEntry(gConcurrentMapFd, &key, vals.data())) return {};
-        if (ret.find(key.uid) == ret.end()) ret.emplace(key.uid, retFormat);
+    auto filter = [&](const time_key_t &key) -> std::optional<bool> {
+        if (!lastUpdate) return true;
+        return uidUpdatedSince(key.uid, *lastUpdate, &newLastUpdate);
+    };
+    auto add = [&](const time_key_t &key, const concurrent_val_t *vals) {
+        auto &times = ret.try_emplace(key.uid, retFormat).first->second;
 
         auto offset = key.bucket * CPUS_PER_ENTRY;
         auto nextOffset = (key.bucket + 1) * CPUS_PER_ENTRY;
 
-        activeBegin = ret[key.uid].active.begin();
-        activeEnd = nextOffset < gNCpus ? activeBegin + CPUS_PER_ENTRY : ret[key.uid].active.end();
+        auto activeBegin = times.active.begin() + offset;
+        auto activeEnd = nextOffset < gNCpus ? activeBegin + CPUS_PER_ENTRY : times.active.end();
 
         for (uint32_t cpu = 0; cpu < gNCpus; ++cpu) {
             std::transform(activeBegin, activeEnd, std::begin(vals[cpu].active), activeBegin,
@@ -446,17 +514,19 @@ std::optional<std::unordered_map<uint32_t, concurrent_time_t>> getUidsUpdatedCon
 
         for (uint32_t policy = 0; policy < gNPolicies; ++policy) {
             if (offset >= gPolicyCpus[policy].size()) continue;
-            policyBegin = ret[key.uid].policy[policy].begin() + offset;
-            policyEnd = nextOffset < gPolicyCpus[policy].size() ? policyBegin + CPUS_PER_ENTRY
-                                                                : ret[key.uid].policy[policy].end();
+            auto policyBegin = times.policy[policy].begin() + offset;
+            auto policyEnd = nextOffset < gPolicyCpus[policy].size() ? policyBegin + CPUS_PER_ENTRY
+                                                                     : times.policy[policy].end();
 
             for (const auto &cpu : gPolicyCpus[policy]) {
                 std::transform(policyBegin, policyEnd, std::begin(vals[cpu].policy), policyBegin,
                                std::plus<uint64_t>());
             }
         }
-    } while (prevKey = key, !getNextMapKey(gConcurrentMapFd, &prevKey, &key));
-    if (errno != ENOENT) return {};
+    };
+    if (!forEachPerCpuEntry<time_key_t, concurrent_val_t>(gConcurrentMapFd, filter, add)) {
+        return {};
+    }
     for (const auto &[key, value] : ret) {
         if (!verifyConcurrentTimes(value)) {
             auto val = getUidConcurrentTimes(key, false);
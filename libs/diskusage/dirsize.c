@@ -15,9 +15,19 @@
  * limitations under the License.
  */
 
+#define _GNU_SOURCE /* for statx */
+
 #include <dirent.h>
+#include <errno.h>
 #include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
 #include <unistd.h>
 
 #include <diskusage/dirsize.h>
@@ -69,3 +79,365 @@ int64_t calculate_dir_size(int dfd)
     closedir(d);
     return size;
 }
+
+/* Large enough to read most directories with a single getdents64 call. */
+#define DIRENT_BUFFER_SIZE (32 * 1024)
+/* Beyond this, the traversal is limited by the storage rather than by the CPUs. */
+#define MAX_THREADS 8
+
+struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+/* A directory kept open until all of its subdirectories have been opened. */
+struct dir_ref {
+    int fd;
+    atomic_int refs;
+};
+
+/* A subdirectory waiting to be traversed. */
+struct dir_item {
+    struct dir_ref *parent;
+    dev_t dev;
+    char name[];
+};
+
+struct scan;
+
+struct worker {
+    struct scan *scan;
+    pthread_t thread;
+    bool started;
+    char *buffer;
+    int64_t *sizes;
+    /* Queued items. The worker pushes and pops at the tail, others steal at the head. */
+    pthread_mutex_t lock;
+    struct dir_item **items;
+    size_t head;
+    size_t tail;
+    size_t capacity;
+};
+
+struct scan {
+    int flags;
+    dir_size_callback callback;
+    void *cookie;
+    int num_categories;
+    unsigned int mask;
+    struct worker *workers;
+    int num_workers;
+    /* Directories queued or being traversed, and directories queued. */
+    atomic_size_t pending;
+    atomic_size_t queued;
+    /* Idle workers wait for directories to be queued, or for the traversal to end. */
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+};
+
+/* Kernels before 4.11 don't have statx. */
+static atomic_bool statx_unsupported;
+
+static int stat_entry(const struct scan *scan, int dfd, const char *name,
+                      struct dir_size_entry *entry, dev_t *dev)
+{
+    if (!atomic_load_explicit(&statx_unsupported, memory_order_relaxed)) {
+        struct statx stx;
+        if (statx(dfd, name, AT_SYMLINK_NOFOLLOW | AT_STATX_DONT_SYNC, scan->mask, &stx) == 0) {
+            entry->mode = stx.stx_mode;
+            entry->uid = stx.stx_uid;
+            entry->gid = stx.stx_gid;
+            entry->size = stx.stx_blocks * 512;
+            *dev = makedev(stx.stx_dev_major, stx.stx_dev_minor);
+            return 0;
+        }
+        if (errno != ENOSYS) {
+            return -1;
+        }
+        atomic_store_explicit(&statx_unsupported, true, memory_order_relaxed);
+    }
+
+    struct stat s;
+    if (fstatat(dfd, name, &s, AT_SYMLINK_NOFOLLOW) != 0) {
+        return -1;
+    }
+    entry->mode = s.st_mode;
+    entry->uid = s.st_uid;
+    entry->gid = s.st_gid;
+    entry->size = stat_size(&s);
+    *dev = s.st_dev;
+    return 0;
+}
+
+static void release_dir(struct dir_ref *ref)
+{
+    if (atomic_fetch_sub(&ref->refs, 1) == 1) {
+        close(ref->fd);
+        free(ref);
+    }
+}
+
+static bool push_item(struct worker *w, struct dir_item *item)
+{
+    struct scan *scan = w->scan;
+
+    pthread_mutex_lock(&w->lock);
+    if (w->tail == w->capacity) {
+        if (w->head > 0) {
+            memmove(w->items, w->items + w->head, (w->tail - w->head) * sizeof(*w->items));
+            w->tail -= w->head;
+            w->head = 0;
+        } else {
+            size_t capacity = w->capacity ? w->capacity * 2 : 64;
+            struct dir_item **items = realloc(w->items, capacity * sizeof(*items));
+            if (items == NULL) {
+                pthread_mutex_unlock(&w->lock);
+                return false;
+            }
+            w->items = items;
+            w->capacity = capacity;
+        }
+    }
+    /* Counted as pending before it can be taken, so that the traversal can't end meanwhile. */
+    atomic_fetch_add(&scan->pending, 1);
+    w->items[w->tail++] = item;
+    pthread_mutex_unlock(&w->lock);
+
+    atomic_fetch_add(&scan->queued, 1);
+    pthread_mutex_lock(&scan->lock);
+    pthread_cond_signal(&scan->cond);
+    pthread_mutex_unlock(&scan->lock);
+    return true;
+}
+
+static struct dir_item *take_item(struct worker *w)
+{
+    struct scan *scan = w->scan;
+    struct dir_item *item = NULL;
+
+    pthread_mutex_lock(&w->lock);
+    if (w->tail > w->head) {
+        item = w->items[--w->tail];
+    }
+    pthread_mutex_unlock(&w->lock);
+
+    /* Steal the oldest item of another worker, which has the most left to traverse. */
+    int index = w - scan->workers;
+    for (int i = 1; item == NULL && i < scan->num_workers; i++) {
+        struct worker *victim = &scan->workers[(index + i) % scan->num_workers];
+        pthread_mutex_lock(&victim->lock);
+        if (victim->tail > victim->head) {
+            item = victim->items[victim->head++];
+        }
+        pthread_mutex_unlock(&victim->lock);
+    }
+
+    if (item != NULL) {
+        atomic_fetch_sub(&scan->queued, 1);
+    }
+    return item;
+}
+
+static void finish_dir(struct scan *scan)
+{
+    if (atomic_fetch_sub(&scan->pending, 1) == 1) {
+        pthread_mutex_lock(&scan->lock);
+        pthread_cond_broadcast(&scan->cond);
+        pthread_mutex_unlock(&scan->lock);
+    }
+}
+
+/* Counts the entries of the directory, and queues its subdirectories. Takes ownership of dfd. */
+static void scan_dir(struct worker *w, int dfd, dev_t dev)
+{
+    struct scan *scan = w->scan;
+
+    struct dir_ref *ref = malloc(sizeof(*ref));
+    if (ref == NULL) {
+        close(dfd);
+        return;
+    }
+    ref->fd = dfd;
+    atomic_init(&ref->refs, 1);
+
+    for (;;) {
+        long n = syscall(SYS_getdents64, dfd, w->buffer, DIRENT_BUFFER_SIZE);
+        if (n <= 0) {
+            break;
+        }
+
+        for (long offset = 0; offset < n;) {
+            const struct linux_dirent64 *de = (const struct linux_dirent64 *)(w->buffer + offset);
+            offset += de->d_reclen;
+
+            const char *name = de->d_name;
+            /* always skip "." and ".." */
+            if (name[0] == '.') {
+                if (name[1] == 0)
+                    continue;
+                if ((name[1] == '.') && (name[2] == 0))
+                    continue;
+            }
+
+            struct dir_size_entry entry = { .parent_fd = dfd, .name = name };
+            dev_t entry_dev;
+            if (stat_entry(scan, dfd, name, &entry, &entry_dev) != 0) {
+                continue;
+            }
+
+            int category = scan->callback ? scan->callback(&entry, scan->cookie) : 0;
+            if (category >= 0 && category < scan->num_categories) {
+                w->sizes[category] += entry.size;
+            }
+
+            if (!S_ISDIR(entry.mode) || category == DIR_SIZE_PRUNE ||
+                    ((scan->flags & DIR_SIZE_XDEV) && entry_dev != dev)) {
+                continue;
+            }
+
+            size_t length = strlen(name);
+            struct dir_item *item = malloc(sizeof(*item) + length + 1);
+            if (item == NULL) {
+                continue;
+            }
+            item->parent = ref;
+            item->dev = entry_dev;
+            memcpy(item->name, name, length + 1);
+            atomic_fetch_add(&ref->refs, 1);
+            if (!push_item(w, item)) {
+                atomic_fetch_sub(&ref->refs, 1);
+                free(item);
+            }
+        }
+    }
+    release_dir(ref);
+}
+
+static void scan_item(struct worker *w, struct dir_item *item)
+{
+    int dfd = openat(item->parent->fd, item->name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    dev_t dev = item->dev;
+    release_dir(item->parent);
+    free(item);
+
+    if (dfd >= 0) {
+        scan_dir(w, dfd, dev);
+    }
+}
+
+static void *run_worker(void *arg)
+{
+    struct worker *w = arg;
+    struct scan *scan = w->scan;
+
+    for (;;) {
+        struct dir_item *item = take_item(w);
+        if (item != NULL) {
+            scan_item(w, item);
+            finish_dir(scan);
+            continue;
+        }
+
+        pthread_mutex_lock(&scan->lock);
+        while (atomic_load(&scan->queued) == 0 && atomic_load(&scan->pending) != 0) {
+            pthread_cond_wait(&scan->cond, &scan->lock);
+        }
+        bool done = atomic_load(&scan->pending) == 0;
+        pthread_mutex_unlock(&scan->lock);
+        if (done) {
+            return NULL;
+        }
+    }
+}
+
+int calculate_dir_size_parallel(int dfd, int num_threads, int flags, dir_size_callback callback,
+                                void *cookie, int64_t *sizes, int num_categories)
+{
+    struct stat s;
+    if (fstat(dfd, &s) != 0) {
+        int saved_errno = errno;
+        close(dfd);
+        errno = saved_errno;
+        return -1;
+    }
+
+    if (num_threads <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        num_threads = cpus > 0 ? cpus : 1;
+    }
+    if (num_threads > MAX_THREADS) {
+        num_threads = MAX_THREADS;
+    }
+
+    struct scan scan = {
+        .flags = flags,
+        .callback = callback,
+        .cookie = cookie,
+        .num_categories = callback ? num_categories : (num_categories > 0 ? 1 : 0),
+        /* The callback is the only reader of the mode and owners. */
+        .mask = STATX_TYPE | STATX_BLOCKS | (callback ? STATX_MODE | STATX_UID | STATX_GID : 0),
+        .num_workers = num_threads,
+    };
+    atomic_init(&scan.pending, 1);
+    atomic_init(&scan.queued, 0);
+    pthread_mutex_init(&scan.lock, NULL);
+    pthread_cond_init(&scan.cond, NULL);
+
+    int result = 0;
+    scan.workers = calloc(num_threads, sizeof(*scan.workers));
+    if (scan.workers == NULL) {
+        close(dfd);
+        result = -1;
+        goto out;
+    }
+    for (int i = 0; i < num_threads; i++) {
+        struct worker *w = &scan.workers[i];
+        w->scan = &scan;
+        pthread_mutex_init(&w->lock, NULL);
+        w->buffer = malloc(DIRENT_BUFFER_SIZE);
+        w->sizes = calloc(num_categories > 0 ? num_categories : 1, sizeof(*w->sizes));
+        if (w->buffer == NULL || w->sizes == NULL) {
+            close(dfd);
+            errno = ENOMEM;
+            result = -1;
+            goto out;
+        }
+    }
+
+    /* The calling thread is the first worker, and starts with the root. */
+    for (int i = 1; i < num_threads; i++) {
+        struct worker *w = &scan.workers[i];
+        w->started = pthread_create(&w->thread, NULL, run_worker, w) == 0;
+    }
+    scan_dir(&scan.workers[0], dfd, s.st_dev);
+    finish_dir(&scan);
+    run_worker(&scan.workers[0]);
+
+    for (int i = 0; i < num_threads; i++) {
+        struct worker *w = &scan.workers[i];
+        if (w->started) {
+            pthread_join(w->thread, NULL);
+        }
+        for (int category = 0; category < scan.num_categories; category++) {
+            sizes[category] += w->sizes[category];
+        }
+    }
+
+out:
+    if (scan.workers != NULL) {
+        for (int i = 0; i < num_threads; i++) {
+            struct worker *w = &scan.workers[i];
+            pthread_mutex_destroy(&w->lock);
+            free(w->items);
+            free(w->buffer);
+            free(w->sizes);
+        }
+        free(scan.workers);
+    }
+    pthread_cond_destroy(&scan.cond);
+    pthread_mutex_destroy(&scan.lock);
+    return result;
+}
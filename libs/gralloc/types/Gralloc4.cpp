@@ -75,6 +75,17 @@ public:
         return NO_ERROR;
     }
 
+    /**
+     * Resizes to a size the caller already knows, so the sizing pass over the encodeHelper can
+     * be skipped.
+     */
+    status_t resize(size_t size) {
+        mNeededResize = size;
+        return resize();
+    }
+
+    bool isFilled() const { return mVec && mResized && mOffset == mVec->size(); }
+
     status_t encode(const uint8_t* data, size_t size) {
         if (!mVec) {
             return BAD_VALUE;
@@ -153,6 +164,22 @@ public:
         return NO_ERROR;
     }
 
+    /**
+     * Consumes size bytes if they are equal to data. Lets callers check an expected value
+     * without decoding it into a temporary.
+     */
+    status_t match(const uint8_t* data, size_t size) {
+        if (!mVec || hasAdditionOverflow(mOffset, size) || mOffset + size > mVec->size()) {
+            return BAD_VALUE;
+        }
+        if (std::memcmp(mVec->data() + mOffset, data, size) != 0) {
+            return BAD_VALUE;
+        }
+
+        mOffset += size;
+        return NO_ERROR;
+    }
+
     bool hasRemainingData() {
         if (!mVec) {
             return false;
@@ -248,6 +275,44 @@ status_t encodeMetadata(const MetadataType& metadataType, const T& input, hidl_v
     return encodeHelper(input, &outputHidlVec);
 }
 
+/**
+ * encodeFixedSizeMetadata is encodeMetadata for types whose encoded size is known up front. It
+ * resizes the hidl_vec once and runs the encodeHelper a single time.
+ */
+size_t getEncodedMetadataTypeSize(const MetadataType& metadataType);
+
+template <class T>
+status_t encodeFixedSizeMetadata(const MetadataType& metadataType, const T& input,
+                                 hidl_vec<uint8_t>* output, EncodeHelper<T> encodeHelper,
+                                 size_t encodedSize) {
+    OutputHidlVec outputHidlVec{output};
+
+    const size_t metadataTypeSize = getEncodedMetadataTypeSize(metadataType);
+    if (hasAdditionOverflow(metadataTypeSize, encodedSize)) {
+        return BAD_VALUE;
+    }
+    status_t err = outputHidlVec.resize(metadataTypeSize + encodedSize);
+    if (err) {
+        return err;
+    }
+
+    err = encodeMetadataType(metadataType, &outputHidlVec);
+    if (err) {
+        return err;
+    }
+
+    err = encodeHelper(input, &outputHidlVec);
+    if (err) {
+        return err;
+    }
+
+    if (!outputHidlVec.isFilled()) {
+        outputHidlVec.clear();
+        return BAD_VALUE;
+    }
+    return NO_ERROR;
+}
+
 template <class T>
 status_t encodeOptionalMetadata(const MetadataType& metadataType, const std::optional<T>& input,
                         hidl_vec<uint8_t>* output, EncodeHelper<T> encodeHelper) {
@@ -257,6 +322,16 @@ status_t encodeOptionalMetadata(const MetadataType& metadataType, const std::opt
     return encodeMetadata(metadataType, *input, output, encodeHelper);
 }
 
+template <class T>
+status_t encodeOptionalFixedSizeMetadata(const MetadataType& metadataType,
+                                         const std::optional<T>& input, hidl_vec<uint8_t>* output,
+                                         EncodeHelper<T> encodeHelper, size_t encodedSize) {
+    if (!input) {
+        return NO_ERROR;
+    }
+    return encodeFixedSizeMetadata(metadataType, *input, output, encodeHelper, encodedSize);
+}
+
 /**
  * decode/decodeMetadata are the main decoding functions. They take in a hidl_vec and use the
  * decodeHelper function to turn the hidl_vec byte stream into T. If an error occurs, the
@@ -319,14 +394,25 @@ status_t decodeOptionalMetadata(const MetadataType& metadataType, const hidl_vec
         output->reset();
         return NO_ERROR;
     }
-    T tmp;
-    status_t err = decodeMetadata(metadataType, input, &tmp, decodeHelper);
-    if (!err) {
-        *output = tmp;
+    // Decode in place rather than through a temporary, which would be copied for vector types.
+    output->emplace();
+    status_t err = decodeMetadata(metadataType, input, &output->value(), decodeHelper);
+    if (err) {
+        output->reset();
     }
     return err;
 }
 
+/**
+ * Encoded sizes of the fixed size types.
+ */
+constexpr size_t kEncodedXyColorSize = 2 * sizeof(float);
+constexpr size_t kEncodedRectSize = 4 * sizeof(int32_t);
+constexpr size_t kEncodedSmpte2086Size = 4 * kEncodedXyColorSize + 2 * sizeof(float);
+constexpr size_t kEncodedCta861_3Size = 2 * sizeof(float);
+// An empty component list followed by the eight int64_t fields of PlaneLayout.
+constexpr size_t kMinEncodedPlaneLayoutSize = sizeof(int64_t) + 8 * sizeof(int64_t);
+
 /**
  * Private helper functions
  */
@@ -468,35 +554,37 @@ status_t encodeMetadataType(const MetadataType& input, OutputHidlVec* output) {
     return NO_ERROR;
 }
 
-status_t decodeMetadataType(InputHidlVec* input, MetadataType* output) {
-    std::string name;
-    status_t err = decodeString(input, &name);
+size_t getEncodedMetadataTypeSize(const MetadataType& metadataType) {
+    return sizeof(int64_t) + metadataType.name.size() + sizeof(int64_t);
+}
+
+/**
+ * Every decode starts by checking the encoded MetadataType. Compare it in place so that decoding
+ * doesn't allocate a std::string and hidl_string for the name each time.
+ */
+status_t validateMetadataType(InputHidlVec* input, const MetadataType& expectedMetadataType) {
+    int64_t nameSize = 0;
+    status_t err = decodeInteger<int64_t>(input, &nameSize);
     if (err) {
         return err;
     }
-    output->name = name;
+    if (nameSize < 0 || static_cast<uint64_t>(nameSize) != expectedMetadataType.name.size()) {
+        return BAD_VALUE;
+    }
 
-    err = decodeInteger<int64_t>(input, &output->value);
+    err = input->match(reinterpret_cast<const uint8_t*>(expectedMetadataType.name.c_str()),
+                       expectedMetadataType.name.size());
     if (err) {
         return err;
     }
 
-    return NO_ERROR;
-}
-
-status_t validateMetadataType(InputHidlVec* input, const MetadataType& expectedMetadataType) {
-    MetadataType receivedMetadataType;
-
-    status_t err = decodeMetadataType(input, &receivedMetadataType);
+    int64_t value = 0;
+    err = decodeInteger<int64_t>(input, &value);
     if (err) {
         return err;
     }
 
-    if (expectedMetadataType.name != receivedMetadataType.name) {
-        return BAD_VALUE;
-    }
-
-    if (receivedMetadataType.value != expectedMetadataType.value) {
+    if (value != expectedMetadataType.value) {
         return BAD_VALUE;
     }
 
@@ -804,6 +892,14 @@ status_t decodePlaneLayoutsHelper(InputHidlVec* inputHidlVec, std::vector<PlaneL
         return BAD_VALUE;
     }
 
+    // Each PlaneLayout takes at least kMinEncodedPlaneLayoutSize bytes, which bounds the number
+    // of entries the remaining data can hold.
+    if (static_cast<uint64_t>(size) >
+        inputHidlVec->getRemainingSize() / kMinEncodedPlaneLayoutSize) {
+        return BAD_VALUE;
+    }
+    outPlaneLayouts->reserve(outPlaneLayouts->size() + static_cast<size_t>(size));
+
     for (size_t i = 0; i < size; i++) {
         outPlaneLayouts->emplace_back();
         err = decodePlaneLayout(inputHidlVec, &outPlaneLayouts->back());
@@ -847,6 +943,11 @@ status_t decodeCropHelper(InputHidlVec* inputHidlVec, std::vector<Rect>* outCrop
         return BAD_VALUE;
     }
 
+    if (static_cast<uint64_t>(size) > inputHidlVec->getRemainingSize() / kEncodedRectSize) {
+        return BAD_VALUE;
+    }
+    outCrops->reserve(outCrops->size() + static_cast<size_t>(size));
+
     for (size_t i = 0; i < size; i++) {
         outCrops->emplace_back();
         err = decodeRect(inputHidlVec, &outCrops->back());
@@ -928,6 +1029,12 @@ status_t decodeCta861_3Helper(InputHidlVec* inputHidlVec, Cta861_3* outCta861_3)
     return decodeInteger<float>(inputHidlVec, &outCta861_3->maxFrameAverageLightLevel);
 }
 
+template <class T>
+status_t encodeIntegerMetadata(const MetadataType& metadataType, const T& input,
+                               hidl_vec<uint8_t>* output) {
+    return encodeFixedSizeMetadata(metadataType, input, output, encodeInteger<T>, sizeof(T));
+}
+
 /**
  * Public API functions
  */
@@ -942,7 +1049,7 @@ status_t decodeBufferDescriptorInfo(const hidl_vec<uint8_t>& bufferDescriptorInf
 }
 
 status_t encodeBufferId(uint64_t bufferId, hidl_vec<uint8_t>* outBufferId) {
-    return encodeMetadata(MetadataType_BufferId, bufferId, outBufferId, encodeInteger);
+    return encodeIntegerMetadata(MetadataType_BufferId, bufferId, outBufferId);
 }
 
 status_t decodeBufferId(const hidl_vec<uint8_t>& bufferId, uint64_t* outBufferId) {
@@ -958,7 +1065,7 @@ status_t decodeName(const hidl_vec<uint8_t>& name, std::string* outName) {
 }
 
 status_t encodeWidth(uint64_t width, hidl_vec<uint8_t>* outWidth) {
-    return encodeMetadata(MetadataType_Width, width, outWidth, encodeInteger);
+    return encodeIntegerMetadata(MetadataType_Width, width, outWidth);
 }
 
 status_t decodeWidth(const hidl_vec<uint8_t>& width, uint64_t* outWidth) {
@@ -966,7 +1073,7 @@ status_t decodeWidth(const hidl_vec<uint8_t>& width, uint64_t* outWidth) {
 }
 
 status_t encodeHeight(uint64_t height, hidl_vec<uint8_t>* outHeight) {
-    return encodeMetadata(MetadataType_Height, height, outHeight, encodeInteger);
+    return encodeIntegerMetadata(MetadataType_Height, height, outHeight);
 }
 
 status_t decodeHeight(const hidl_vec<uint8_t>& height, uint64_t* outHeight) {
@@ -974,7 +1081,7 @@ status_t decodeHeight(const hidl_vec<uint8_t>& height, uint64_t* outHeight) {
 }
 
 status_t encodeLayerCount(uint64_t layerCount, hidl_vec<uint8_t>* outLayerCount) {
-    return encodeMetadata(MetadataType_LayerCount, layerCount, outLayerCount, encodeInteger);
+    return encodeIntegerMetadata(MetadataType_LayerCount, layerCount, outLayerCount);
 }
 
 status_t decodeLayerCount(const hidl_vec<uint8_t>& layerCount, uint64_t* outLayerCount) {
@@ -983,8 +1090,9 @@ status_t decodeLayerCount(const hidl_vec<uint8_t>& layerCount, uint64_t* outLaye
 
 status_t encodePixelFormatRequested(const hardware::graphics::common::V1_2::PixelFormat& pixelFormatRequested,
         hidl_vec<uint8_t>* outPixelFormatRequested) {
-    return encodeMetadata(MetadataType_PixelFormatRequested, static_cast<int32_t>(pixelFormatRequested),
-                  outPixelFormatRequested, encodeInteger);
+    return encodeIntegerMetadata(MetadataType_PixelFormatRequested,
+                                 static_cast<int32_t>(pixelFormatRequested),
+                                 outPixelFormatRequested);
 }
 
 status_t decodePixelFormatRequested(const hidl_vec<uint8_t>& pixelFormatRequested,
@@ -994,8 +1102,8 @@ status_t decodePixelFormatRequested(const hidl_vec<uint8_t>& pixelFormatRequeste
 }
 
 status_t encodePixelFormatFourCC(uint32_t pixelFormatFourCC, hidl_vec<uint8_t>* outPixelFormatFourCC) {
-    return encodeMetadata(MetadataType_PixelFormatFourCC, pixelFormatFourCC, outPixelFormatFourCC,
-                  encodeInteger);
+    return encodeIntegerMetadata(MetadataType_PixelFormatFourCC, pixelFormatFourCC,
+                                 outPixelFormatFourCC);
 }
 
 status_t decodePixelFormatFourCC(const hidl_vec<uint8_t>& pixelFormatFourCC, uint32_t* outPixelFormatFourCC) {
@@ -1004,8 +1112,8 @@ status_t decodePixelFormatFourCC(const hidl_vec<uint8_t>& pixelFormatFourCC, uin
 }
 
 status_t encodePixelFormatModifier(uint64_t pixelFormatModifier, hidl_vec<uint8_t>* outPixelFormatModifier) {
-    return encodeMetadata(MetadataType_PixelFormatModifier, pixelFormatModifier, outPixelFormatModifier,
-                  encodeInteger);
+    return encodeIntegerMetadata(MetadataType_PixelFormatModifier, pixelFormatModifier,
+                                 outPixelFormatModifier);
 }
 
 status_t decodePixelFormatModifier(const hidl_vec<uint8_t>& pixelFormatModifier, uint64_t* outPixelFormatModifier) {
@@ -1014,7 +1122,7 @@ status_t decodePixelFormatModifier(const hidl_vec<uint8_t>& pixelFormatModifier,
 }
 
 status_t encodeUsage(uint64_t usage, hidl_vec<uint8_t>* outUsage) {
-    return encodeMetadata(MetadataType_Usage, usage, outUsage, encodeInteger);
+    return encodeIntegerMetadata(MetadataType_Usage, usage, outUsage);
 }
 
 status_t decodeUsage(const hidl_vec<uint8_t>& usage, uint64_t* outUsage) {
@@ -1022,7 +1130,7 @@ status_t decodeUsage(const hidl_vec<uint8_t>& usage, uint64_t* outUsage) {
 }
 
 status_t encodeAllocationSize(uint64_t allocationSize, hidl_vec<uint8_t>* outAllocationSize) {
-    return encodeMetadata(MetadataType_AllocationSize, allocationSize, outAllocationSize, encodeInteger);
+    return encodeIntegerMetadata(MetadataType_AllocationSize, allocationSize, outAllocationSize);
 }
 
 status_t decodeAllocationSize(const hidl_vec<uint8_t>& allocationSize, uint64_t* outAllocationSize) {
@@ -1030,8 +1138,8 @@ status_t decodeAllocationSize(const hidl_vec<uint8_t>& allocationSize, uint64_t*
 }
 
 status_t encodeProtectedContent(uint64_t protectedContent, hidl_vec<uint8_t>* outProtectedContent) {
-    return encodeMetadata(MetadataType_ProtectedContent, protectedContent, outProtectedContent,
-                  encodeInteger);
+    return encodeIntegerMetadata(MetadataType_ProtectedContent, protectedContent,
+                                 outProtectedContent);
 }
 
 status_t decodeProtectedContent(const hidl_vec<uint8_t>& protectedContent, uint64_t* outProtectedContent) {
@@ -1085,8 +1193,8 @@ status_t decodeCrop(const hidl_vec<uint8_t>& crop, std::vector<Rect>* outCrop) {
 }
 
 status_t encodeDataspace(const Dataspace& dataspace, hidl_vec<uint8_t>* outDataspace) {
-    return encodeMetadata(MetadataType_Dataspace, static_cast<int32_t>(dataspace), outDataspace,
-                  encodeInteger);
+    return encodeIntegerMetadata(MetadataType_Dataspace, static_cast<int32_t>(dataspace),
+                                 outDataspace);
 }
 
 status_t decodeDataspace(const hidl_vec<uint8_t>& dataspace, Dataspace* outDataspace) {
@@ -1095,8 +1203,8 @@ status_t decodeDataspace(const hidl_vec<uint8_t>& dataspace, Dataspace* outDatas
 }
 
 status_t encodeBlendMode(const BlendMode& blendMode, hidl_vec<uint8_t>* outBlendMode) {
-    return encodeMetadata(MetadataType_BlendMode, static_cast<int32_t>(blendMode), outBlendMode,
-                  encodeInteger);
+    return encodeIntegerMetadata(MetadataType_BlendMode, static_cast<int32_t>(blendMode),
+                                 outBlendMode);
 }
 
 status_t decodeBlendMode(const hidl_vec<uint8_t>& blendMode, BlendMode* outBlendMode) {
@@ -1106,7 +1214,8 @@ status_t decodeBlendMode(const hidl_vec<uint8_t>& blendMode, BlendMode* outBlend
 
 status_t encodeSmpte2086(const std::optional<Smpte2086>& smpte2086,
                          hidl_vec<uint8_t>* outSmpte2086) {
-    return encodeOptionalMetadata(MetadataType_Smpte2086, smpte2086, outSmpte2086, encodeSmpte2086Helper);
+    return encodeOptionalFixedSizeMetadata(MetadataType_Smpte2086, smpte2086, outSmpte2086,
+                                           encodeSmpte2086Helper, kEncodedSmpte2086Size);
 }
 
 status_t decodeSmpte2086(const hidl_vec<uint8_t>& smpte2086,
@@ -1115,7 +1224,8 @@ status_t decodeSmpte2086(const hidl_vec<uint8_t>& smpte2086,
 }
 
 status_t encodeCta861_3(const std::optional<Cta861_3>& cta861_3, hidl_vec<uint8_t>* outCta861_3) {
-    return encodeOptionalMetadata(MetadataType_Cta861_3, cta861_3, outCta861_3, encodeCta861_3Helper);
+    return encodeOptionalFixedSizeMetadata(MetadataType_Cta861_3, cta861_3, outCta861_3,
+                                           encodeCta861_3Helper, kEncodedCta861_3Size);
 }
 
 status_t decodeCta861_3(const hidl_vec<uint8_t>& cta861_3, std::optional<Cta861_3>* outCta861_3) {
@@ -1136,7 +1246,7 @@ status_t decodeSmpte2094_40(const hidl_vec<uint8_t>& smpte2094_40,
 
 status_t encodeUint32(const MetadataType& metadataType, uint32_t input,
                       hidl_vec<uint8_t>* output) {
-    return encodeMetadata(metadataType, input, output, encodeInteger);
+    return encodeIntegerMetadata(metadataType, input, output);
 }
 
 status_t decodeUint32(const MetadataType& metadataType, const hidl_vec<uint8_t>& input,
@@ -1146,7 +1256,7 @@ status_t decodeUint32(const MetadataType& metadataType, const hidl_vec<uint8_t>&
 
 status_t encodeInt32(const MetadataType& metadataType, int32_t input,
                      hidl_vec<uint8_t>* output) {
-    return encodeMetadata(metadataType, input, output, encodeInteger);
+    return encodeIntegerMetadata(metadataType, input, output);
 }
 
 status_t decodeInt32(const MetadataType& metadataType, const hidl_vec<uint8_t>& input,
@@ -1156,7 +1266,7 @@ status_t decodeInt32(const MetadataType& metadataType, const hidl_vec<uint8_t>&
 
 status_t encodeUint64(const MetadataType& metadataType, uint64_t input,
                       hidl_vec<uint8_t>* output) {
-    return encodeMetadata(metadataType, input, output, encodeInteger);
+    return encodeIntegerMetadata(metadataType, input, output);
 }
 
 status_t decodeUint64(const MetadataType& metadataType, const hidl_vec<uint8_t>& input,
@@ -1166,7 +1276,7 @@ status_t decodeUint64(const MetadataType& metadataType, const hidl_vec<uint8_t>&
 
 status_t encodeInt64(const MetadataType& metadataType, int64_t input,
                      hidl_vec<uint8_t>* output) {
-    return encodeMetadata(metadataType, input, output, encodeInteger);
+    return encodeIntegerMetadata(metadataType, input, output);
 }
 
 status_t decodeInt64(const MetadataType& metadataType, const hidl_vec<uint8_t>& input,
@@ -1176,7 +1286,7 @@ status_t decodeInt64(const MetadataType& metadataType, const hidl_vec<uint8_t>&
 
 status_t encodeFloat(const MetadataType& metadataType, float input,
                      hidl_vec<uint8_t>* output) {
-    return encodeMetadata(metadataType, input, output, encodeInteger);
+    return encodeIntegerMetadata(metadataType, input, output);
 }
 
 status_t decodeFloat(const MetadataType& metadataType, const hidl_vec<uint8_t>& input,
@@ -1186,7 +1296,7 @@ status_t decodeFloat(const MetadataType& metadataType, const hidl_vec<uint8_t>&
 
 status_t encodeDouble(const MetadataType& metadataType, double input,
                       hidl_vec<uint8_t>* output) {
-    return encodeMetadata(metadataType, input, output, encodeInteger);
+    return encodeIntegerMetadata(metadataType, input, output);
 }
 
 status_t decodeDouble(const MetadataType& metadataType, const hidl_vec<uint8_t>& input,
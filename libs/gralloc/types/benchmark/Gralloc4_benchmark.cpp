@@ -0,0 +1,159 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <gralloctypes/Gralloc4.h>
+
+using android::hardware::hidl_vec;
+
+using aidl::android::hardware::graphics::common::Cta861_3;
+using aidl::android::hardware::graphics::common::Dataspace;
+using aidl::android::hardware::graphics::common::PlaneLayout;
+using aidl::android::hardware::graphics::common::PlaneLayoutComponent;
+using aidl::android::hardware::graphics::common::Rect;
+using aidl::android::hardware::graphics::common::Smpte2086;
+using aidl::android::hardware::graphics::common::XyColor;
+
+namespace android {
+
+// The plane layouts of a 1080p YCbCr 4:2:0 buffer, which the mapper reports on every lock.
+static std::vector<PlaneLayout> makeYCbCr420PlaneLayouts() {
+    PlaneLayout y;
+    y.components = {{gralloc4::PlaneLayoutComponentType_Y, 0, 8}};
+    y.sampleIncrementInBits = 8;
+    y.strideInBytes = 1920;
+    y.widthInSamples = 1920;
+    y.heightInSamples = 1080;
+    y.totalSizeInBytes = 1920 * 1080;
+    y.horizontalSubsampling = 1;
+    y.verticalSubsampling = 1;
+
+    PlaneLayout cbcr;
+    cbcr.components = {{gralloc4::PlaneLayoutComponentType_CB, 0, 8},
+                       {gralloc4::PlaneLayoutComponentType_CR, 8, 8}};
+    cbcr.offsetInBytes = y.totalSizeInBytes;
+    cbcr.sampleIncrementInBits = 16;
+    cbcr.strideInBytes = 1920;
+    cbcr.widthInSamples = 960;
+    cbcr.heightInSamples = 540;
+    cbcr.totalSizeInBytes = 1920 * 540;
+    cbcr.horizontalSubsampling = 2;
+    cbcr.verticalSubsampling = 2;
+
+    return {y, cbcr};
+}
+
+static const Smpte2086 kSmpte2086{XyColor{0.680, 0.320}, XyColor{0.265, 0.690},
+                                  XyColor{0.150, 0.060}, XyColor{0.3127, 0.3290}, 1000.0, 0.05};
+
+static void BM_encodeDataspace(benchmark::State& state) {
+    for (auto _ : state) {
+        hidl_vec<uint8_t> vec;
+        gralloc4::encodeDataspace(Dataspace::DISPLAY_P3, &vec);
+        benchmark::DoNotOptimize(vec);
+    }
+}
+BENCHMARK(BM_encodeDataspace);
+
+static void BM_decodeDataspace(benchmark::State& state) {
+    hidl_vec<uint8_t> vec;
+    gralloc4::encodeDataspace(Dataspace::DISPLAY_P3, &vec);
+    for (auto _ : state) {
+        Dataspace dataspace;
+        gralloc4::decodeDataspace(vec, &dataspace);
+        benchmark::DoNotOptimize(dataspace);
+    }
+}
+BENCHMARK(BM_decodeDataspace);
+
+static void BM_encodeCrop(benchmark::State& state) {
+    const std::vector<Rect> crops = {Rect{0, 0, 1920, 1080}, Rect{0, 0, 960, 540}};
+    for (auto _ : state) {
+        hidl_vec<uint8_t> vec;
+        gralloc4::encodeCrop(crops, &vec);
+        benchmark::DoNotOptimize(vec);
+    }
+}
+BENCHMARK(BM_encodeCrop);
+
+static void BM_decodeCrop(benchmark::State& state) {
+    hidl_vec<uint8_t> vec;
+    gralloc4::encodeCrop({Rect{0, 0, 1920, 1080}, Rect{0, 0, 960, 540}}, &vec);
+    for (auto _ : state) {
+        std::vector<Rect> crops;
+        gralloc4::decodeCrop(vec, &crops);
+        benchmark::DoNotOptimize(crops);
+    }
+}
+BENCHMARK(BM_decodeCrop);
+
+static void BM_encodePlaneLayouts(benchmark::State& state) {
+    const auto planeLayouts = makeYCbCr420PlaneLayouts();
+    for (auto _ : state) {
+        hidl_vec<uint8_t> vec;
+        gralloc4::encodePlaneLayouts(planeLayouts, &vec);
+        benchmark::DoNotOptimize(vec);
+    }
+}
+BENCHMARK(BM_encodePlaneLayouts);
+
+static void BM_decodePlaneLayouts(benchmark::State& state) {
+    hidl_vec<uint8_t> vec;
+    gralloc4::encodePlaneLayouts(makeYCbCr420PlaneLayouts(), &vec);
+    for (auto _ : state) {
+        std::vector<PlaneLayout> planeLayouts;
+        gralloc4::decodePlaneLayouts(vec, &planeLayouts);
+        benchmark::DoNotOptimize(planeLayouts);
+    }
+}
+BENCHMARK(BM_decodePlaneLayouts);
+
+static void BM_encodeSmpte2086(benchmark::State& state) {
+    const std::optional<Smpte2086> smpte2086 = kSmpte2086;
+    for (auto _ : state) {
+        hidl_vec<uint8_t> vec;
+        gralloc4::encodeSmpte2086(smpte2086, &vec);
+        benchmark::DoNotOptimize(vec);
+    }
+}
+BENCHMARK(BM_encodeSmpte2086);
+
+static void BM_decodeSmpte2086(benchmark::State& state) {
+    hidl_vec<uint8_t> vec;
+    gralloc4::encodeSmpte2086(kSmpte2086, &vec);
+    for (auto _ : state) {
+        std::optional<Smpte2086> smpte2086;
+        gralloc4::decodeSmpte2086(vec, &smpte2086);
+        benchmark::DoNotOptimize(smpte2086);
+    }
+}
+BENCHMARK(BM_decodeSmpte2086);
+
+static void BM_decodeCta861_3(benchmark::State& state) {
+    hidl_vec<uint8_t> vec;
+    gralloc4::encodeCta861_3(Cta861_3{1000.0, 400.0}, &vec);
+    for (auto _ : state) {
+        std::optional<Cta861_3> cta861_3;
+        gralloc4::decodeCta861_3(vec, &cta861_3);
+        benchmark::DoNotOptimize(cta861_3);
+    }
+}
+BENCHMARK(BM_decodeCta861_3);
+
+} // namespace android
+
+BENCHMARK_MAIN();
@@ -556,6 +556,25 @@ TEST_F(Gralloc4TestErrors, Gralloc4TestDecodeBadVec) {
     ASSERT_NE(NO_ERROR, gralloc4::decodeSmpte2094_40(vec, &smpte2094_40));
 }
 
+TEST_F(Gralloc4TestErrors, Gralloc4TestDecodeMismatchedMetadataType) {
+    hidl_vec<uint8_t> vec;
+    uint32_t output;
+
+    // Same name length, different name.
+    MetadataType encodedType{"vendor.mycompanyname.graphics.common.MetadataType", 0};
+    MetadataType decodedType{"vendor.othercompanyname.graphics.common.MetadataT", 0};
+    ASSERT_EQ(NO_ERROR, gralloc4::encodeUint32(encodedType, 7, &vec));
+    ASSERT_NE(NO_ERROR, gralloc4::decodeUint32(decodedType, vec, &output));
+
+    // Same name, different value.
+    decodedType = {"vendor.mycompanyname.graphics.common.MetadataType", 1};
+    ASSERT_NE(NO_ERROR, gralloc4::decodeUint32(decodedType, vec, &output));
+
+    // Truncated name.
+    vec.resize(sizeof(int64_t) + 4);
+    ASSERT_NE(NO_ERROR, gralloc4::decodeUint32(encodedType, vec, &output));
+}
+
 class Gralloc4TestHelpers : public testing::Test { };
 
 TEST_F(Gralloc4TestHelpers, Gralloc4TestIsStandard) {
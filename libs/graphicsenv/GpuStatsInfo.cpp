@@ -88,6 +88,11 @@ status_t GpuStatsAppInfo::writeToParcel(Parcel* parcel) const {
     if ((status = parcel->writeBool(cpuVulkanInUse)) != OK) return status;
     if ((status = parcel->writeBool(falsePrerotation)) != OK) return status;
     if ((status = parcel->writeBool(gles1InUse)) != OK) return status;
+    if ((status = parcel->writeUint32(driverLoadingStageTime.size())) != OK) return status;
+    for (const auto& [stage, stageTime] : driverLoadingStageTime) {
+        if ((status = parcel->writeUtf8AsUtf16(stage)) != OK) return status;
+        if ((status = parcel->writeInt64Vector(stageTime)) != OK) return status;
+    }
     return OK;
 }
 
@@ -101,6 +106,16 @@ status_t GpuStatsAppInfo::readFromParcel(const Parcel* parcel) {
     if ((status = parcel->readBool(&cpuVulkanInUse)) != OK) return status;
     if ((status = parcel->readBool(&falsePrerotation)) != OK) return status;
     if ((status = parcel->readBool(&gles1InUse)) != OK) return status;
+    uint32_t stageCount;
+    if ((status = parcel->readUint32(&stageCount)) != OK) return status;
+    driverLoadingStageTime.clear();
+    for (uint32_t i = 0; i < stageCount; i++) {
+        std::string stage;
+        if ((status = parcel->readUtf8FromUtf16(&stage)) != OK) return status;
+        if ((status = parcel->readInt64Vector(&driverLoadingStageTime[stage])) != OK) {
+            return status;
+        }
+    }
     return OK;
 }
 
@@ -126,6 +141,13 @@ std::string GpuStatsAppInfo::toString() const {
         StringAppendF(&result, " %d", loadingTime);
     }
     result.append("\n");
+    for (const auto& [stage, stageTime] : driverLoadingStageTime) {
+        StringAppendF(&result, "%s:", stage.c_str());
+        for (int64_t time : stageTime) {
+            StringAppendF(&result, " %" PRId64, time);
+        }
+        result.append("\n");
+    }
     return result;
 }
 
@@ -142,6 +142,17 @@ void GraphicsEnv::setDriverPathAndSphalLibraries(const std::string path,
           sphalLibraries.c_str());
     mDriverPath = path;
     mSphalLibraries = sphalLibraries;
+
+    // Linking the driver namespace takes a few milliseconds, which the first GL or Vulkan call
+    // would otherwise spend on the app's critical path. The driver is only chosen after the app
+    // process is forked, so this is the earliest point it can be done.
+    if (!mDriverPath.empty() && android::base::GetBoolProperty("ro.gfx.driver.preload", false)) {
+        std::thread preloadThread([this]() {
+            ATRACE_NAME("preloadDriverNamespace");
+            getDriverNamespace();
+        });
+        preloadThread.detach();
+    }
 }
 
 void GraphicsEnv::hintActivityLaunch() {
@@ -247,6 +258,24 @@ void GraphicsEnv::setDriverLoaded(GpuStatsInfo::Api api, bool isDriverLoaded,
     sendGpuStatsLocked(api, isDriverLoaded, driverLoadingTime);
 }
 
+void GraphicsEnv::setDriverLoadingStageTime(GpuStatsInfo::Api api, const std::string& stage,
+                                            int64_t stageTime) {
+    ALOGV("setDriverLoadingStageTime: api[%d] stage[%s] time[%" PRId64 "]",
+          static_cast<int32_t>(api), stage.c_str(), stageTime);
+
+    std::lock_guard<std::mutex> lock(mStatsLock);
+    auto& stageTimes =
+            api == GpuStatsInfo::Api::API_GL ? mGlLoadingStageTimes : mVkLoadingStageTimes;
+    stageTimes.emplace_back(stage, stageTime);
+    sendDriverLoadingStageTimesLocked(api);
+}
+
+std::vector<std::pair<std::string, int64_t>> GraphicsEnv::getDriverLoadingStageTimes(
+        GpuStatsInfo::Api api) {
+    std::lock_guard<std::mutex> lock(mStatsLock);
+    return api == GpuStatsInfo::Api::API_GL ? mGlLoadingStageTimes : mVkLoadingStageTimes;
+}
+
 static sp<IGpuService> getGpuService() {
     static const sp<IBinder> binder = defaultServiceManager()->checkService(String16("gpu"));
     if (!binder) {
@@ -269,10 +298,18 @@ void GraphicsEnv::setTargetStats(const GpuStatsInfo::Stats stats, const uint64_t
     std::lock_guard<std::mutex> lock(mStatsLock);
     if (!readyToSendGpuStatsLocked()) return;
 
+    // GpuService drops target stats of apps it has no driver stats for, and one-way calls are
+    // delivered in order, so a flag only needs to be sent once after the driver stats.
+    const uint32_t statsBit = 1u << static_cast<uint32_t>(stats);
+    if (mTargetStatsSent & statsBit) return;
+
     const sp<IGpuService> gpuService = getGpuService();
     if (gpuService) {
         gpuService->setTargetStats(mGpuStats.appPackageName, mGpuStats.driverVersionCode, stats,
                                    value);
+        if (mDriverStatsSent) {
+            mTargetStatsSent |= statsBit;
+        }
     }
 }
 
@@ -314,7 +351,56 @@ void GraphicsEnv::sendGpuStatsLocked(GpuStatsInfo::Api api, bool isDriverLoaded,
                                 mGpuStats.driverVersionCode, mGpuStats.driverBuildTime,
                                 mGpuStats.appPackageName, mGpuStats.vulkanVersion, driver,
                                 isIntendedDriverLoaded, driverLoadingTime);
+        mDriverStatsSent = true;
     }
+
+    sendDriverLoadingStageTimesLocked(api);
+}
+
+void GraphicsEnv::sendDriverLoadingStageTimesLocked(GpuStatsInfo::Api api) {
+    // GpuService drops stage times of apps it has no driver stats for, so they are held back
+    // until the driver stats have been sent.
+    if (!mDriverStatsSent || !readyToSendGpuStatsLocked()) return;
+
+    const auto& stageTimes =
+            api == GpuStatsInfo::Api::API_GL ? mGlLoadingStageTimes : mVkLoadingStageTimes;
+    size_t& stageTimesSent =
+            api == GpuStatsInfo::Api::API_GL ? mGlLoadingStageTimesSent : mVkLoadingStageTimesSent;
+    if (stageTimesSent == stageTimes.size()) return;
+
+    const sp<IGpuService> gpuService = getGpuService();
+    if (!gpuService) return;
+
+    for (; stageTimesSent < stageTimes.size(); stageTimesSent++) {
+        const auto& [stage, stageTime] = stageTimes[stageTimesSent];
+        gpuService->setDriverLoadingStageTime(mGpuStats.appPackageName,
+                                              mGpuStats.driverVersionCode, api, stage, stageTime);
+    }
+}
+
+std::vector<uint8_t> GraphicsEnv::getShaderCacheBlob(const std::string& driverKey,
+                                                     const void* key, size_t keySize) {
+    ATRACE_CALL();
+
+    const sp<IGpuService> gpuService = getGpuService();
+    if (!gpuService) return {};
+
+    const uint8_t* keyBytes = static_cast<const uint8_t*>(key);
+    return gpuService->getShaderCacheBlob(driverKey,
+                                          std::vector<uint8_t>(keyBytes, keyBytes + keySize));
+}
+
+void GraphicsEnv::setShaderCacheBlob(const std::string& driverKey, const void* key,
+                                     size_t keySize, const void* value, size_t valueSize) {
+    ATRACE_CALL();
+
+    const sp<IGpuService> gpuService = getGpuService();
+    if (!gpuService) return;
+
+    const uint8_t* keyBytes = static_cast<const uint8_t*>(key);
+    const uint8_t* valueBytes = static_cast<const uint8_t*>(value);
+    gpuService->setShaderCacheBlob(driverKey, std::vector<uint8_t>(keyBytes, keyBytes + keySize),
+                                   std::vector<uint8_t>(valueBytes, valueBytes + valueSize));
 }
 
 bool GraphicsEnv::setInjectLayersPrSetDumpable() {
@@ -61,6 +61,22 @@ public:
         remote()->transact(BnGpuService::SET_TARGET_STATS, data, &reply, IBinder::FLAG_ONEWAY);
     }
 
+    void setDriverLoadingStageTime(const std::string& appPackageName,
+                                   const uint64_t driverVersionCode, const GpuStatsInfo::Api api,
+                                   const std::string& stage, const int64_t stageTime) override {
+        Parcel data, reply;
+        data.writeInterfaceToken(IGpuService::getInterfaceDescriptor());
+
+        data.writeUtf8AsUtf16(appPackageName);
+        data.writeUint64(driverVersionCode);
+        data.writeInt32(static_cast<int32_t>(api));
+        data.writeUtf8AsUtf16(stage);
+        data.writeInt64(stageTime);
+
+        remote()->transact(BnGpuService::SET_DRIVER_LOADING_STAGE_TIME, data, &reply,
+                           IBinder::FLAG_ONEWAY);
+    }
+
     void setUpdatableDriverPath(const std::string& driverPath) override {
         Parcel data, reply;
         data.writeInterfaceToken(IGpuService::getInterfaceDescriptor());
@@ -81,6 +97,33 @@ public:
         }
         return driverPath;
     }
+
+    void setShaderCacheBlob(const std::string& driverKey, const std::vector<uint8_t>& key,
+                            const std::vector<uint8_t>& value) override {
+        Parcel data, reply;
+        data.writeInterfaceToken(IGpuService::getInterfaceDescriptor());
+        data.writeUtf8AsUtf16(driverKey);
+        data.writeByteVector(key);
+        data.writeByteVector(value);
+
+        remote()->transact(BnGpuService::SET_SHADER_CACHE_BLOB, data, &reply,
+                           IBinder::FLAG_ONEWAY);
+    }
+
+    std::vector<uint8_t> getShaderCacheBlob(const std::string& driverKey,
+                                            const std::vector<uint8_t>& key) override {
+        Parcel data, reply;
+        data.writeInterfaceToken(IGpuService::getInterfaceDescriptor());
+        data.writeUtf8AsUtf16(driverKey);
+        data.writeByteVector(key);
+
+        status_t error = remote()->transact(BnGpuService::GET_SHADER_CACHE_BLOB, data, &reply);
+        std::vector<uint8_t> value;
+        if (error == OK) {
+            error = reply.readByteVector(&value);
+        }
+        return value;
+    }
 };
 
 IMPLEMENT_META_INTERFACE(GpuService, "android.graphicsenv.IGpuService");
@@ -147,6 +190,29 @@ status_t BnGpuService::onTransact(uint32_t code, const Parcel& data, Parcel* rep
 
             return OK;
         }
+        case SET_DRIVER_LOADING_STAGE_TIME: {
+            CHECK_INTERFACE(IGpuService, data, reply);
+
+            std::string appPackageName;
+            if ((status = data.readUtf8FromUtf16(&appPackageName)) != OK) return status;
+
+            uint64_t driverVersionCode;
+            if ((status = data.readUint64(&driverVersionCode)) != OK) return status;
+
+            int32_t api;
+            if ((status = data.readInt32(&api)) != OK) return status;
+
+            std::string stage;
+            if ((status = data.readUtf8FromUtf16(&stage)) != OK) return status;
+
+            int64_t stageTime;
+            if ((status = data.readInt64(&stageTime)) != OK) return status;
+
+            setDriverLoadingStageTime(appPackageName, driverVersionCode,
+                                      static_cast<GpuStatsInfo::Api>(api), stage, stageTime);
+
+            return OK;
+        }
         case SET_UPDATABLE_DRIVER_PATH: {
             CHECK_INTERFACE(IGpuService, data, reply);
 
@@ -162,6 +228,33 @@ status_t BnGpuService::onTransact(uint32_t code, const Parcel& data, Parcel* rep
             std::string driverPath = getUpdatableDriverPath();
             return reply->writeUtf8AsUtf16(driverPath);
         }
+        case SET_SHADER_CACHE_BLOB: {
+            CHECK_INTERFACE(IGpuService, data, reply);
+
+            std::string driverKey;
+            if ((status = data.readUtf8FromUtf16(&driverKey)) != OK) return status;
+
+            std::vector<uint8_t> key;
+            if ((status = data.readByteVector(&key)) != OK) return status;
+
+            std::vector<uint8_t> value;
+            if ((status = data.readByteVector(&value)) != OK) return status;
+
+            setShaderCacheBlob(driverKey, key, value);
+            return OK;
+        }
+        case GET_SHADER_CACHE_BLOB: {
+            CHECK_INTERFACE(IGpuService, data, reply);
+
+            std::string driverKey;
+            if ((status = data.readUtf8FromUtf16(&driverKey)) != OK) return status;
+
+            std::vector<uint8_t> key;
+            if ((status = data.readByteVector(&key)) != OK) return status;
+
+            std::vector<uint8_t> value = getShaderCacheBlob(driverKey, key);
+            return reply->writeByteVector(value);
+        }
         case SHELL_COMMAND_TRANSACTION: {
             int in = data.readFileDescriptor();
             int out = data.readFileDescriptor();
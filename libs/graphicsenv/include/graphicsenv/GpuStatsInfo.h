@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include <map>
 #include <string>
 #include <vector>
 
@@ -72,6 +73,8 @@ public:
     bool cpuVulkanInUse = false;
     bool falsePrerotation = false;
     bool gles1InUse = false;
+    // Times of each driver loading stage, keyed by the api and the stage, e.g. "gl.dlopen".
+    std::map<std::string, std::vector<int64_t>> driverLoadingStageTime = {};
 };
 
 /*
@@ -54,7 +54,8 @@ public:
     //     /data/app/com.example.driver/base.apk!/lib/arm64-v8a
     // Also set additional required sphal libraries to the linker for loading
     // graphics drivers. The string is a list of libraries separated by ':',
-    // which is required by android_link_namespaces.
+    // which is required by android_link_namespaces. If ro.gfx.driver.preload
+    // is set, the driver namespace is then linked in the background.
     void setDriverPathAndSphalLibraries(const std::string path, const std::string sphalLibraries);
     // Get the updatable driver namespace.
     android_namespace_t* getDriverNamespace();
@@ -75,6 +76,25 @@ public:
     void setDriverToLoad(GpuStatsInfo::Driver driver);
     // Set which driver is actually loaded.
     void setDriverLoaded(GpuStatsInfo::Api api, bool isDriverLoaded, int64_t driverLoadingTime);
+    // Record how long a stage of driver loading took, in nanoseconds. Stages
+    // deferred past setDriverLoaded, e.g. lazily loaded client APIs, are
+    // recorded here as well.
+    void setDriverLoadingStageTime(GpuStatsInfo::Api api, const std::string& stage,
+                                   int64_t stageTime);
+    // Get the recorded driver loading stages in the order they completed.
+    std::vector<std::pair<std::string, int64_t>> getDriverLoadingStageTimes(GpuStatsInfo::Api api);
+
+    /*
+     * Apis for the shared shader cache in GpuService
+     */
+    // Get a blob cached in GpuService for the driver identified by driverKey.
+    // Return an empty vector on a miss or if GpuService is unavailable.
+    std::vector<uint8_t> getShaderCacheBlob(const std::string& driverKey, const void* key,
+                                            size_t keySize);
+    // Contribute a blob produced by the driver identified by driverKey. This
+    // doesn't block on GpuService.
+    void setShaderCacheBlob(const std::string& driverKey, const void* key, size_t keySize,
+                            const void* value, size_t valueSize);
 
     /*
      * Api for Vk/GL layer injection.  Presently, drivers enable certain
@@ -136,6 +156,8 @@ private:
     bool readyToSendGpuStatsLocked();
     // Send the initial complete GpuStats to GpuService.
     void sendGpuStatsLocked(GpuStatsInfo::Api api, bool isDriverLoaded, int64_t driverLoadingTime);
+    // Send the driver loading stage times not yet sent to GpuService.
+    void sendDriverLoadingStageTimesLocked(GpuStatsInfo::Api api);
 
     GraphicsEnv() = default;
     // Path to updatable driver libs.
@@ -148,6 +170,17 @@ private:
     bool mActivityLaunched = false;
     // Information bookkept for GpuStats.
     GpuStatsInfo mGpuStats;
+    // Whether driver stats have been sent to GpuService, guarded by mStatsLock.
+    bool mDriverStatsSent = false;
+    // Bitmask of GpuStatsInfo::Stats already sent after the driver stats, guarded by
+    // mStatsLock. Target stats are flags, so they are only sent once per process.
+    uint32_t mTargetStatsSent = 0;
+    // Driver loading stage times, guarded by mStatsLock.
+    std::vector<std::pair<std::string, int64_t>> mGlLoadingStageTimes;
+    std::vector<std::pair<std::string, int64_t>> mVkLoadingStageTimes;
+    // Number of the driver loading stage times above sent to GpuService, guarded by mStatsLock.
+    size_t mGlLoadingStageTimesSent = 0;
+    size_t mVkLoadingStageTimesSent = 0;
     // Path to ANGLE libs.
     std::string mAnglePath;
     // This App's name.
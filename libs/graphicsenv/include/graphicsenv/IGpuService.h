@@ -43,9 +43,22 @@ public:
     virtual void setTargetStats(const std::string& appPackageName, const uint64_t driverVersionCode,
                                 const GpuStatsInfo::Stats stats, const uint64_t value = 0) = 0;
 
+    // set the time in nanoseconds a stage of driver loading took.
+    virtual void setDriverLoadingStageTime(const std::string& appPackageName,
+                                           const uint64_t driverVersionCode,
+                                           const GpuStatsInfo::Api api, const std::string& stage,
+                                           const int64_t stageTime) = 0;
+
     // setter and getter for updatable driver path.
     virtual void setUpdatableDriverPath(const std::string& driverPath) = 0;
     virtual std::string getUpdatableDriverPath() = 0;
+
+    // setter and getter for the shared shader cache. driverKey identifies the
+    // driver that produced the blob; an empty value is returned on a miss.
+    virtual void setShaderCacheBlob(const std::string& driverKey, const std::vector<uint8_t>& key,
+                                    const std::vector<uint8_t>& value) = 0;
+    virtual std::vector<uint8_t> getShaderCacheBlob(const std::string& driverKey,
+                                                    const std::vector<uint8_t>& key) = 0;
 };
 
 class BnGpuService : public BnInterface<IGpuService> {
@@ -55,6 +68,9 @@ public:
         SET_TARGET_STATS,
         SET_UPDATABLE_DRIVER_PATH,
         GET_UPDATABLE_DRIVER_PATH,
+        SET_SHADER_CACHE_BLOB,
+        GET_SHADER_CACHE_BLOB,
+        SET_DRIVER_LOADING_STAGE_TIME,
         // Always append new enum to the end.
     };
 
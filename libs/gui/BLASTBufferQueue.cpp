@@ -19,18 +19,117 @@
 
 #define ATRACE_TAG ATRACE_TAG_GRAPHICS
 
+#include <android-base/properties.h>
 #include <gui/BLASTBufferQueue.h>
 #include <gui/BufferItemConsumer.h>
+#include <gui/DisplayEventReceiver.h>
 #include <gui/GLConsumer.h>
 
 #include <utils/Trace.h>
 
+#include <poll.h>
+#include <pthread.h>
+
+#include <atomic>
 #include <chrono>
+#include <set>
 
 using namespace std::chrono_literals;
 
 namespace android {
 
+namespace {
+
+std::atomic<bool> sTransactionBatchingEnabled =
+        base::GetBoolProperty("debug.blast.batch_transactions", false);
+
+// Collects the buffer updates of every BLASTBufferQueue in the process into one transaction
+// that is applied on the next vsync, so that surfaces updating in the same frame cost a single
+// setTransactionState call. The same Transaction object is reused for every batch.
+class TransactionBatcher {
+public:
+    using Transaction = SurfaceComposerClient::Transaction;
+
+    static TransactionBatcher& getInstance() {
+        static TransactionBatcher* sInstance = new TransactionBatcher();
+        return *sInstance;
+    }
+
+    // Merges a buffer update for surface into the pending batch, leaving t empty for reuse. If
+    // the batch already carries a buffer for the same surface it is applied first, so that the
+    // buffers of one queue reach SurfaceFlinger in frame number order.
+    void add(const sp<SurfaceControl>& surface, nsecs_t desiredPresentTime, Transaction&& t) {
+        std::lock_guard lock(mMutex);
+        const sp<IBinder> handle = surface->getHandle();
+        if (mSurfaces.count(handle) != 0) {
+            applyLocked();
+        }
+        mTransaction.merge(std::move(t));
+        mSurfaces.insert(handle);
+        if (mSurfaces.size() == 1 || desiredPresentTime < mDesiredPresentTime) {
+            mDesiredPresentTime = desiredPresentTime;
+        }
+        mCondition.notify_one();
+    }
+
+private:
+    // Upper bound on how long a batch waits for vsync, in case the event is lost.
+    static constexpr int kVsyncTimeoutMs = 100;
+
+    TransactionBatcher() { std::thread(&TransactionBatcher::threadMain, this).detach(); }
+
+    void threadMain() {
+        pthread_setname_np(pthread_self(), "BLASTBatcher");
+        DisplayEventReceiver receiver;
+        const bool hasVsync = receiver.initCheck() == NO_ERROR;
+        ALOGW_IF(!hasVsync, "No vsync source, batched transactions are applied immediately");
+
+        std::unique_lock lock(mMutex);
+        while (true) {
+            mCondition.wait(lock, [this] { return !mSurfaces.empty(); });
+            if (hasVsync) {
+                lock.unlock();
+                waitForVsync(receiver);
+                lock.lock();
+            }
+            applyLocked();
+        }
+    }
+
+    void waitForVsync(DisplayEventReceiver& receiver) {
+        ATRACE_CALL();
+        if (receiver.requestNextVsync() != NO_ERROR) {
+            return;
+        }
+        struct pollfd fd = {.fd = receiver.getFd(), .events = POLLIN};
+        if (poll(&fd, 1, kVsyncTimeoutMs) <= 0) {
+            return;
+        }
+        DisplayEventReceiver::Event events[8];
+        while (receiver.getEvents(events, std::size(events)) > 0) {
+        }
+    }
+
+    void applyLocked() REQUIRES(mMutex) {
+        if (mSurfaces.empty()) {
+            return;
+        }
+        ATRACE_NAME("applyBatchedTransaction");
+        mTransaction.setDesiredPresentTime(mDesiredPresentTime);
+        // apply() clears the transaction, leaving it ready for the next batch.
+        mTransaction.apply();
+        mSurfaces.clear();
+    }
+
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    Transaction mTransaction GUARDED_BY(mMutex);
+    std::set<sp<IBinder>> mSurfaces GUARDED_BY(mMutex);
+    nsecs_t mDesiredPresentTime GUARDED_BY(mMutex) = 0;
+};
+
+} // namespace
+
 void BLASTBufferItemConsumer::onDisconnect() {
     Mutex::Autolock lock(mFrameEventHistoryMutex);
     mPreviouslyConnected = mCurrentlyConnected;
@@ -127,6 +226,10 @@ BLASTBufferQueue::BLASTBufferQueue(const sp<SurfaceControl>& surface, int width,
     mPendingReleaseItem.releaseFence = nullptr;
 }
 
+void BLASTBufferQueue::setTransactionBatchingEnabled(bool enabled) {
+    sTransactionBatchingEnabled = enabled;
+}
+
 void BLASTBufferQueue::update(const sp<SurfaceControl>& surface, int width, int height) {
     std::unique_lock _lock{mMutex};
     mSurfaceControl = surface;
@@ -153,21 +256,34 @@ void BLASTBufferQueue::transactionCallback(nsecs_t /*latchTime*/, const sp<Fence
     std::unique_lock _lock{mMutex};
     ATRACE_CALL();
 
-    if (!stats.empty()) {
-        mTransformHint = stats[0].transformHint;
+    // The transaction may have carried other surfaces as well, e.g. when it was batched or
+    // merged into the caller's transaction, so pick the stats of our own surface.
+    const SurfaceControlStats* stat = nullptr;
+    for (const auto& s : stats) {
+        if (SurfaceControl::isSameSurface(s.surfaceControl, mSurfaceControl)) {
+            stat = &s;
+            break;
+        }
+    }
+    if (stat == nullptr && !stats.empty()) {
+        stat = &stats[0];
+    }
+
+    if (stat != nullptr) {
+        mTransformHint = stat->transformHint;
         mBufferItemConsumer->setTransformHint(mTransformHint);
-        mBufferItemConsumer->updateFrameTimestamps(stats[0].frameEventStats.frameNumber,
-                                                   stats[0].frameEventStats.refreshStartTime,
-                                                   stats[0].frameEventStats.gpuCompositionDoneFence,
-                                                   stats[0].presentFence,
-                                                   stats[0].previousReleaseFence,
-                                                   stats[0].frameEventStats.compositorTiming,
-                                                   stats[0].latchTime,
-                                                   stats[0].frameEventStats.dequeueReadyTime);
+        mBufferItemConsumer->updateFrameTimestamps(stat->frameEventStats.frameNumber,
+                                                   stat->frameEventStats.refreshStartTime,
+                                                   stat->frameEventStats.gpuCompositionDoneFence,
+                                                   stat->presentFence,
+                                                   stat->previousReleaseFence,
+                                                   stat->frameEventStats.compositorTiming,
+                                                   stat->latchTime,
+                                                   stat->frameEventStats.dequeueReadyTime);
     }
     if (mPendingReleaseItem.item.mGraphicBuffer != nullptr) {
-        if (!stats.empty()) {
-            mPendingReleaseItem.releaseFence = stats[0].previousReleaseFence;
+        if (stat != nullptr) {
+            mPendingReleaseItem.releaseFence = stat->previousReleaseFence;
         } else {
             ALOGE("Warning: no SurfaceControlStats returned in BLASTBufferQueue callback");
             mPendingReleaseItem.releaseFence = nullptr;
@@ -204,15 +320,6 @@ void BLASTBufferQueue::processNextBufferLocked(bool useNextTransaction) {
         return;
     }
 
-    SurfaceComposerClient::Transaction localTransaction;
-    bool applyTransaction = true;
-    SurfaceComposerClient::Transaction* t = &localTransaction;
-    if (mNextTransaction != nullptr && useNextTransaction) {
-        t = mNextTransaction;
-        mNextTransaction = nullptr;
-        applyTransaction = false;
-    }
-
     BufferItem bufferItem;
 
     status_t status = mBufferItemConsumer->acquireBuffer(&bufferItem, -1, false);
@@ -230,31 +337,46 @@ void BLASTBufferQueue::processNextBufferLocked(bool useNextTransaction) {
     mNumAcquired++;
     mSubmitted.push(bufferItem);
 
+    // Ensure BLASTBufferQueue stays alive until we receive the transaction complete callback.
+    incStrong((void*)transactionCallbackThunk);
+
+    if (mNextTransaction != nullptr && useNextTransaction) {
+        SurfaceComposerClient::Transaction* t = mNextTransaction;
+        mNextTransaction = nullptr;
+        setBufferLocked(*t, bufferItem);
+        t->setDesiredPresentTime(bufferItem.mTimestamp);
+    } else if (sTransactionBatchingEnabled) {
+        setBufferLocked(mBatchedTransaction, bufferItem);
+        TransactionBatcher::getInstance().add(mSurfaceControl, bufferItem.mTimestamp,
+                                              std::move(mBatchedTransaction));
+    } else {
+        SurfaceComposerClient::Transaction t;
+        setBufferLocked(t, bufferItem);
+        t.setDesiredPresentTime(bufferItem.mTimestamp);
+        t.apply();
+    }
+}
+
+void BLASTBufferQueue::setBufferLocked(SurfaceComposerClient::Transaction& t,
+                                       const BufferItem& bufferItem) {
     bool needsDisconnect = false;
     mBufferItemConsumer->getConnectionEvents(bufferItem.mFrameNumber, &needsDisconnect);
 
     // if producer disconnected before, notify SurfaceFlinger
     if (needsDisconnect) {
-        t->notifyProducerDisconnect(mSurfaceControl);
+        t.notifyProducerDisconnect(mSurfaceControl);
     }
 
-    // Ensure BLASTBufferQueue stays alive until we receive the transaction complete callback.
-    incStrong((void*)transactionCallbackThunk);
-
-    t->setBuffer(mSurfaceControl, buffer);
-    t->setAcquireFence(mSurfaceControl,
-                       bufferItem.mFence ? new Fence(bufferItem.mFence->dup()) : Fence::NO_FENCE);
-    t->addTransactionCompletedCallback(transactionCallbackThunk, static_cast<void*>(this));
+    t.setBuffer(mSurfaceControl, bufferItem.mGraphicBuffer);
+    t.setAcquireFence(mSurfaceControl,
+                      bufferItem.mFence ? new Fence(bufferItem.mFence->dup()) : Fence::NO_FENCE);
+    t.addTransactionCompletedCallback(transactionCallbackThunk, static_cast<void*>(this));
 
-    t->setFrame(mSurfaceControl, {0, 0, mWidth, mHeight});
-    t->setCrop(mSurfaceControl, computeCrop(bufferItem));
-    t->setTransform(mSurfaceControl, bufferItem.mTransform);
-    t->setTransformToDisplayInverse(mSurfaceControl, bufferItem.mTransformToDisplayInverse);
-    t->setDesiredPresentTime(bufferItem.mTimestamp);
-
-    if (applyTransaction) {
-        t->apply();
-    }
+    t.setFrame(mSurfaceControl, {0, 0, mWidth, mHeight});
+    t.setCrop(mSurfaceControl, computeCrop(bufferItem));
+    t.setTransform(mSurfaceControl, bufferItem.mTransform);
+    t.setTransformToDisplayInverse(mSurfaceControl, bufferItem.mTransformToDisplayInverse);
+    t.setSurfaceDamageRegion(mSurfaceControl, bufferItem.mSurfaceDamage);
 }
 
 Rect BLASTBufferQueue::computeCrop(const BufferItem& item) {
@@ -23,6 +23,8 @@
 #include <fcntl.h>
 #include <unistd.h>
 
+#include <algorithm>
+
 #include <utils/Errors.h>
 
 #include <binder/Parcel.h>
@@ -34,6 +36,12 @@ namespace gui {
 // need. So we make it smaller.
 static const size_t DEFAULT_SOCKET_BUFFER_SIZE = 4 * 1024;
 
+// Maximum number of messages read by a single recvObjectMessages() call.
+static constexpr size_t MAX_RECV_MESSAGES = 64;
+
+// Maximum number of messages sent by a single system call of sendObjectMessages().
+static constexpr size_t MAX_SEND_MESSAGES = 64;
+
 BitTube::BitTube(size_t bufsize) {
     init(bufsize, bufsize);
 }
@@ -173,5 +181,80 @@ ssize_t BitTube::recvObjects(BitTube* tube, void* events, size_t count, size_t o
     return size < 0 ? size : size / static_cast<ssize_t>(objSize);
 }
 
+ssize_t BitTube::sendObjectMessages(BitTube* tube, void const* events, size_t count,
+                                   size_t objSize) {
+    const char* vaddr = reinterpret_cast<const char*>(events);
+    iovec iovecs[MAX_SEND_MESSAGES];
+    mmsghdr messages[MAX_SEND_MESSAGES];
+    size_t sent = 0;
+    while (sent < count) {
+        const size_t batch = std::min(count - sent, MAX_SEND_MESSAGES);
+        for (size_t i = 0; i < batch; i++) {
+            iovecs[i] = {const_cast<char*>(vaddr + (sent + i) * objSize), objSize};
+            messages[i] = {};
+            messages[i].msg_hdr.msg_iov = &iovecs[i];
+            messages[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        int n, err;
+        do {
+            n = ::sendmmsg(tube->mSendFd, messages, static_cast<unsigned int>(batch),
+                           MSG_DONTWAIT | MSG_NOSIGNAL);
+            err = n < 0 ? errno : 0;
+        } while (err == EINTR);
+        if (err != 0) {
+            return sent > 0 ? static_cast<ssize_t>(sent) : -err;
+        }
+
+        sent += static_cast<size_t>(n);
+        if (static_cast<size_t>(n) < batch) {
+            // the socket buffer is full
+            break;
+        }
+    }
+    return static_cast<ssize_t>(sent);
+}
+
+ssize_t BitTube::recvObjectMessages(BitTube* tube, void* events, size_t count, size_t objSize) {
+    if (count == 0) {
+        return 0;
+    }
+
+    count = std::min(count, MAX_RECV_MESSAGES);
+    char* vaddr = reinterpret_cast<char*>(events);
+    iovec iovecs[MAX_RECV_MESSAGES];
+    mmsghdr messages[MAX_RECV_MESSAGES];
+    for (size_t i = 0; i < count; i++) {
+        iovecs[i] = {vaddr + i * objSize, objSize};
+        messages[i] = {};
+        messages[i].msg_hdr.msg_iov = &iovecs[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    int n, err;
+    do {
+        n = ::recvmmsg(tube->mReceiveFd, messages, static_cast<unsigned int>(count),
+                       MSG_DONTWAIT, nullptr);
+        err = n < 0 ? errno : 0;
+    } while (err == EINTR);
+    if (err == EAGAIN || err == EWOULDBLOCK) {
+        return 0;
+    }
+    if (err != 0) {
+        return -err;
+    }
+
+    for (int i = 0; i < n; i++) {
+        // should never happen because of SOCK_SEQPACKET
+        LOG_ALWAYS_FATAL_IF(messages[i].msg_len < objSize,
+                            "BitTube::recvObjectMessages(count=%zu, size=%zu), message %d has "
+                            "%u bytes (partial events were received!)",
+                            count, objSize, i, messages[i].msg_len);
+        ALOGW_IF(messages[i].msg_hdr.msg_flags & MSG_TRUNC,
+                 "BitTube::recvObjectMessages(size=%zu), message %d was truncated", objSize, i);
+    }
+    return n;
+}
+
 } // namespace gui
 } // namespace android
@@ -85,6 +85,42 @@ status_t BufferItemConsumer::acquireBuffer(BufferItem *item,
     return OK;
 }
 
+status_t BufferItemConsumer::acquireBuffers(std::vector<BufferItem>* items,
+        size_t maxBuffers, bool waitForFence) {
+    status_t err;
+
+    if (!items) return BAD_VALUE;
+
+    Mutex::Autolock _l(mMutex);
+
+    size_t first = items->size();
+    err = acquireBuffersLocked(items, maxBuffers);
+    if (err != OK) {
+        if (err != NO_BUFFER_AVAILABLE) {
+            BI_LOGE("Error acquiring buffers: %s (%d)", strerror(err), err);
+        }
+        return err;
+    }
+
+    for (size_t i = first; i < items->size(); i++) {
+        BufferItem& item = (*items)[i];
+        item.mGraphicBuffer = mSlots[item.mSlot].mGraphicBuffer;
+    }
+
+    if (waitForFence) {
+        for (size_t i = first; i < items->size(); i++) {
+            err = (*items)[i].mFence->waitForever("BufferItemConsumer::acquireBuffers");
+            if (err != OK) {
+                BI_LOGE("Failed to wait for fence of acquired buffer: %s (%d)",
+                        strerror(-err), err);
+                return err;
+            }
+        }
+    }
+
+    return OK;
+}
+
 status_t BufferItemConsumer::releaseBuffer(const BufferItem &item,
         const sp<Fence>& releaseFence) {
     status_t err;
@@ -14,6 +14,8 @@
  * limitations under the License.
  */
 
+#include <algorithm>
+
 #include <inttypes.h>
 #include <pwd.h>
 #include <sys/types.h>
@@ -308,6 +310,84 @@ status_t BufferQueueConsumer::acquireBuffer(BufferItem* outBuffer,
     return NO_ERROR;
 }
 
+status_t BufferQueueConsumer::acquireBuffers(std::vector<BufferItem>* outBuffers,
+        size_t maxBuffers) {
+    ATRACE_CALL();
+
+    if (outBuffers == nullptr || maxBuffers == 0) {
+        BQ_LOGE("acquireBuffers: invalid arguments (outBuffers=%p maxBuffers=%zu)",
+                outBuffers, maxBuffers);
+        return BAD_VALUE;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(mCore->mMutex);
+
+        // The shared buffer is synthesized rather than taken from the queue,
+        // so leave that case to acquireBuffer.
+        if (!mCore->mSharedBufferMode) {
+            int numAcquiredBuffers = 0;
+            for (int s : mCore->mActiveBuffers) {
+                if (mSlots[s].mBufferState.isAcquired()) {
+                    ++numAcquiredBuffers;
+                }
+            }
+            if (numAcquiredBuffers >= mCore->mMaxAcquiredBufferCount + 1) {
+                BQ_LOGE("acquireBuffers: max acquired buffer count reached: %d "
+                        "(max %d)", numAcquiredBuffers,
+                        mCore->mMaxAcquiredBufferCount);
+                return INVALID_OPERATION;
+            }
+
+            if (mCore->mQueue.empty()) {
+                return NO_BUFFER_AVAILABLE;
+            }
+
+            // Same allowance as acquireBuffer: one over the max acquired count.
+            size_t available = static_cast<size_t>(
+                    mCore->mMaxAcquiredBufferCount + 1 - numAcquiredBuffers);
+            size_t count = std::min({maxBuffers, available,
+                    mCore->mQueue.size()});
+            outBuffers->reserve(outBuffers->size() + count);
+
+            for (size_t i = 0; i < count; ++i) {
+                const BufferItem& queued(mCore->mQueue[i]);
+                int slot = queued.mSlot;
+                outBuffers->push_back(queued);
+                BufferItem& item = outBuffers->back();
+
+                ATRACE_BUFFER_INDEX(slot);
+
+                if (!item.mIsStale) {
+                    mSlots[slot].mAcquireCalled = true;
+                    mSlots[slot].mBufferState.acquire();
+                    mSlots[slot].mFence = Fence::NO_FENCE;
+                }
+
+                // See acquireBuffer
+                if (item.mAcquireCalled) {
+                    item.mGraphicBuffer = nullptr;
+                }
+            }
+
+            mCore->mQueue.removeItemsAt(0, count);
+
+            mCore->mDequeueCondition.notify_all();
+
+            ATRACE_INT(mCore->mConsumerName.string(),
+                    static_cast<int32_t>(mCore->mQueue.size()));
+#ifndef NO_BINDER
+            mCore->mOccupancyTracker.registerOccupancyChange(mCore->mQueue.size());
+#endif
+            VALIDATE_CONSISTENCY();
+            return NO_ERROR;
+        }
+    }
+
+    return IGraphicBufferConsumer::acquireBuffers(outBuffers,
+            std::min<size_t>(maxBuffers, 1));
+}
+
 status_t BufferQueueConsumer::detachBuffer(int slot) {
     ATRACE_CALL();
     ATRACE_BUFFER_INDEX(slot);
@@ -388,9 +468,8 @@ status_t BufferQueueConsumer::attachBuffer(int* outSlot,
     // Find a free slot to put the buffer into
     int found = BufferQueueCore::INVALID_BUFFER_SLOT;
     if (!mCore->mFreeSlots.empty()) {
-        auto slot = mCore->mFreeSlots.begin();
-        found = *slot;
-        mCore->mFreeSlots.erase(slot);
+        found = mCore->mFreeSlots.first();
+        mCore->mFreeSlots.erase(found);
     } else if (!mCore->mFreeBuffers.empty()) {
         found = mCore->mFreeBuffers.front();
         mCore->mFreeBuffers.remove(found);
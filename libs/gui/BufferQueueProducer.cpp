@@ -32,6 +32,7 @@
 #include <gui/BufferItem.h>
 #include <gui/BufferQueueCore.h>
 #include <gui/BufferQueueProducer.h>
+#include <gui/FrameEventRing.h>
 #include <gui/GLConsumer.h>
 #include <gui/IConsumerListener.h>
 #include <gui/IProducerListener.h>
@@ -42,6 +43,10 @@
 
 #include <system/window.h>
 
+#include <algorithm>
+#include <future>
+#include <vector>
+
 namespace android {
 
 // Macros for include BufferQueueCore information in log messages
@@ -67,6 +72,8 @@ namespace android {
           ##__VA_ARGS__)
 
 static constexpr uint32_t BQ_LAYER_COUNT = 1;
+// Maximum number of buffers allocateBuffers allocates at the same time.
+static constexpr size_t MAX_CONCURRENT_ALLOCATIONS = 3;
 ProducerListener::~ProducerListener() = default;
 
 BufferQueueProducer::BufferQueueProducer(const sp<BufferQueueCore>& core,
@@ -265,11 +272,30 @@ int BufferQueueProducer::getFreeSlotLocked() const {
     if (mCore->mFreeSlots.empty()) {
         return BufferQueueCore::INVALID_BUFFER_SLOT;
     }
-    int slot = *(mCore->mFreeSlots.begin());
+    int slot = mCore->mFreeSlots.first();
     mCore->mFreeSlots.erase(slot);
     return slot;
 }
 
+bool BufferQueueProducer::canDequeueWithoutWaiting() const {
+    std::lock_guard<std::mutex> lock(mCore->mMutex);
+    if (mCore->mIsAbandoned || mCore->mSharedBufferMode || mCore->mFreeBuffers.empty()) {
+        return false;
+    }
+
+    if (mCore->mQueue.size() > static_cast<size_t>(mCore->getMaxBufferCountLocked())) {
+        return false;
+    }
+
+    int dequeuedCount = 0;
+    for (int s : mCore->mActiveBuffers) {
+        if (mSlots[s].mBufferState.isDequeued()) {
+            ++dequeuedCount;
+        }
+    }
+    return dequeuedCount < mCore->mMaxDequeuedBufferCount;
+}
+
 status_t BufferQueueProducer::waitForFreeSlotThenRelock(FreeSlotCaller caller,
         std::unique_lock<std::mutex>& lock, int* found) const {
     auto callerString = (caller == FreeSlotCaller::Dequeue) ?
@@ -1004,6 +1030,7 @@ status_t BufferQueueProducer::queueBuffer(int slot,
         output->transformHint = mCore->mTransformHintInUse = mCore->mTransformHint;
         output->numPendingBuffers = static_cast<uint32_t>(mCore->mQueue.size());
         output->nextFrameNumber = mCore->mFrameCounter + 1;
+        getConsumerPropertiesLocked(output);
 
         ATRACE_INT(mCore->mConsumerName.string(),
                 static_cast<int32_t>(mCore->mQueue.size()));
@@ -1196,6 +1223,13 @@ int BufferQueueProducer::query(int what, int *outValue) {
     return NO_ERROR;
 }
 
+void BufferQueueProducer::getConsumerPropertiesLocked(QueueBufferOutput* output) const {
+    output->hasConsumerProperties = true;
+    output->consumerUsageBits = mCore->mConsumerUsageBits;
+    output->defaultDataSpace = static_cast<int32_t>(mCore->mDefaultBufferDataSpace);
+    output->consumerIsProtected = mCore->mConsumerIsProtected;
+}
+
 status_t BufferQueueProducer::connect(const sp<IProducerListener>& listener,
         int api, bool producerControlledByApp, QueueBufferOutput *output) {
     ATRACE_CALL();
@@ -1252,6 +1286,7 @@ status_t BufferQueueProducer::connect(const sp<IProducerListener>& listener,
             output->nextFrameNumber = mCore->mFrameCounter + 1;
             output->bufferReplaced = false;
             output->maxBufferCount = mCore->mMaxBufferCount;
+            getConsumerPropertiesLocked(output);
 
             if (listener != nullptr) {
                 // Set up a death notification so that we can disconnect
@@ -1417,9 +1452,10 @@ void BufferQueueProducer::allocateBuffers(uint32_t width, uint32_t height,
                 return;
             }
 
-            // Only allocate one buffer at a time to reduce risks of overlapping an allocation from
-            // both allocateBuffers and dequeueBuffer.
-            newBufferCount = mCore->mFreeSlots.empty() ? 0 : 1;
+            // Allocate the buffers of all free slots, a few at a time. Each buffer is handed to
+            // the free buffers as soon as it's allocated, so that a dequeueBuffer waiting for
+            // one doesn't wait for the others.
+            newBufferCount = std::min(mCore->mFreeSlots.size(), MAX_CONCURRENT_ALLOCATIONS);
             if (newBufferCount == 0) {
                 return;
             }
@@ -1438,11 +1474,20 @@ void BufferQueueProducer::allocateBuffers(uint32_t width, uint32_t height,
             mCore->mIsAllocating = true;
         } // Autolock scope
 
-        Vector<sp<GraphicBuffer>> buffers;
+        // gralloc allocates concurrently, so all the buffers but the first are allocated on
+        // their own threads. The first one is allocated on this thread when it is waited for.
+        auto allocate = [=]() -> sp<GraphicBuffer> {
+            return new GraphicBuffer(allocWidth, allocHeight, allocFormat, BQ_LAYER_COUNT,
+                                     allocUsage, allocName);
+        };
+        std::vector<std::future<sp<GraphicBuffer>>> allocations;
+        allocations.push_back(std::async(std::launch::deferred, allocate));
+        for (size_t i = 1; i < newBufferCount; ++i) {
+            allocations.push_back(std::async(std::launch::async, allocate));
+        }
+
         for (size_t i = 0; i < newBufferCount; ++i) {
-            sp<GraphicBuffer> graphicBuffer = new GraphicBuffer(
-                    allocWidth, allocHeight, allocFormat, BQ_LAYER_COUNT,
-                    allocUsage, allocName);
+            sp<GraphicBuffer> graphicBuffer = allocations[i].get();
 
             status_t result = graphicBuffer->initCheck();
 
@@ -1454,10 +1499,7 @@ void BufferQueueProducer::allocateBuffers(uint32_t width, uint32_t height,
                 mCore->mIsAllocatingCondition.notify_all();
                 return;
             }
-            buffers.push_back(graphicBuffer);
-        }
 
-        { // Autolock scope
             std::unique_lock<std::mutex> lock(mCore->mMutex);
             uint32_t checkWidth = width > 0 ? width : mCore->mDefaultWidth;
             uint32_t checkHeight = height > 0 ? height : mCore->mDefaultHeight;
@@ -1475,30 +1517,25 @@ void BufferQueueProducer::allocateBuffers(uint32_t width, uint32_t height,
                 BQ_LOGV("allocateBuffers: size/format/usage changed while allocating. Retrying.");
                 mCore->mIsAllocating = false;
                 mCore->mIsAllocatingCondition.notify_all();
-                continue;
+                break;
             }
 
-            for (size_t i = 0; i < newBufferCount; ++i) {
-                if (mCore->mFreeSlots.empty()) {
-                    BQ_LOGV("allocateBuffers: a slot was occupied while "
-                            "allocating. Dropping allocated buffer.");
-                    continue;
-                }
-                auto slot = mCore->mFreeSlots.begin();
-                mCore->clearBufferSlotLocked(*slot); // Clean up the slot first
-                mSlots[*slot].mGraphicBuffer = buffers[i];
-                mSlots[*slot].mFence = Fence::NO_FENCE;
+            if (mCore->mFreeSlots.empty()) {
+                BQ_LOGV("allocateBuffers: a slot was occupied while "
+                        "allocating. Dropping allocated buffer.");
+            } else {
+                int slot = mCore->mFreeSlots.first();
+                mCore->clearBufferSlotLocked(slot); // Clean up the slot first
+                mSlots[slot].mGraphicBuffer = graphicBuffer;
+                mSlots[slot].mFence = Fence::NO_FENCE;
 
                 // freeBufferLocked puts this slot on the free slots list. Since
                 // we then attached a buffer, move the slot to free buffer list.
-                mCore->mFreeBuffers.push_front(*slot);
+                mCore->mFreeSlots.erase(slot);
+                mCore->mFreeBuffers.push_front(slot);
 
                 BQ_LOGV("allocateBuffers: allocated a new buffer in slot %d",
-                        *slot);
-
-                // Make sure the erase is done after all uses of the slot
-                // iterator since it will be invalid after this point.
-                mCore->mFreeSlots.erase(slot);
+                        slot);
             }
 
             mCore->mIsAllocating = false;
@@ -1510,7 +1547,13 @@ void BufferQueueProducer::allocateBuffers(uint32_t width, uint32_t height,
             while (mDequeueWaitingForAllocation) {
                 mDequeueWaitingForAllocationCondition.wait(lock);
             }
-        } // Autolock scope
+
+            // Resume allocating to hand over the next buffer.
+            if (i + 1 < newBufferCount) {
+                mCore->waitWhileAllocatingLocked(lock);
+                mCore->mIsAllocating = true;
+            }
+        }
     }
 }
 
@@ -1625,6 +1668,26 @@ void BufferQueueProducer::getFrameTimestamps(FrameEventHistoryDelta* outDelta) {
     addAndGetFrameTimestamps(nullptr, outDelta);
 }
 
+status_t BufferQueueProducer::getFrameEventRing(sp<FrameEventRing>* outRing) {
+    ATRACE_CALL();
+    BQ_LOGV("getFrameEventRing");
+    if (outRing == nullptr) {
+        BQ_LOGE("getFrameEventRing: outRing must not be NULL");
+        return BAD_VALUE;
+    }
+
+    sp<IConsumerListener> listener;
+    {
+        std::lock_guard<std::mutex> lock(mCore->mMutex);
+        listener = mCore->mConsumerListener;
+    }
+    outRing->clear();
+    if (listener != nullptr) {
+        listener->getFrameEventRing(outRing);
+    }
+    return *outRing != nullptr ? NO_ERROR : INVALID_OPERATION;
+}
+
 void BufferQueueProducer::addAndGetFrameTimestamps(
         const NewFrameEventsEntry* newTimestamps,
         FrameEventHistoryDelta* outDelta) {
@@ -1678,4 +1741,33 @@ status_t BufferQueueProducer::setAutoPrerotation(bool autoPrerotation) {
     return NO_ERROR;
 }
 
+status_t BufferQueueProducer::dequeueBuffers(const std::vector<DequeueBufferInput>& inputs,
+                                             std::vector<DequeueBufferOutput>* outputs) {
+    ATRACE_CALL();
+    if (inputs.empty() || outputs == nullptr) {
+        return BAD_VALUE;
+    }
+
+    outputs->clear();
+    outputs->reserve(inputs.size());
+    for (const DequeueBufferInput& input : inputs) {
+        // Requests past the first one give up rather than wait for a buffer.
+        const bool first = outputs->empty();
+        if (!first && !canDequeueWithoutWaiting()) {
+            break;
+        }
+
+        outputs->emplace_back();
+        dequeueBufferWithRequest(input, &outputs->back());
+        if (outputs->back().result < 0) {
+            if (!first) {
+                outputs->pop_back();
+            }
+            break;
+        }
+    }
+    BQ_LOGV("dequeueBuffers: dequeued %zu of %zu", outputs->size(), inputs.size());
+    return NO_ERROR;
+}
+
 } // namespace android
@@ -394,15 +394,7 @@ status_t ConsumerBase::acquireBufferLocked(BufferItem *item,
         return err;
     }
 
-    if (item->mGraphicBuffer != nullptr) {
-        if (mSlots[item->mSlot].mGraphicBuffer != nullptr) {
-            freeBufferLocked(item->mSlot);
-        }
-        mSlots[item->mSlot].mGraphicBuffer = item->mGraphicBuffer;
-    }
-
-    mSlots[item->mSlot].mFrameNumber = item->mFrameNumber;
-    mSlots[item->mSlot].mFence = item->mFence;
+    trackAcquiredBufferLocked(*item);
 
     CB_LOGV("acquireBufferLocked: -> slot=%d/%" PRIu64,
             item->mSlot, item->mFrameNumber);
@@ -410,6 +402,40 @@ status_t ConsumerBase::acquireBufferLocked(BufferItem *item,
     return OK;
 }
 
+status_t ConsumerBase::acquireBuffersLocked(std::vector<BufferItem>* items,
+        size_t maxBuffers) {
+    if (mAbandoned) {
+        CB_LOGE("acquireBuffersLocked: ConsumerBase is abandoned!");
+        return NO_INIT;
+    }
+
+    size_t first = items->size();
+    status_t err = mConsumer->acquireBuffers(items, maxBuffers);
+    if (err != NO_ERROR) {
+        return err;
+    }
+
+    for (size_t i = first; i < items->size(); i++) {
+        trackAcquiredBufferLocked((*items)[i]);
+    }
+
+    CB_LOGV("acquireBuffersLocked: -> %zu buffers", items->size() - first);
+
+    return OK;
+}
+
+void ConsumerBase::trackAcquiredBufferLocked(const BufferItem& item) {
+    if (item.mGraphicBuffer != nullptr) {
+        if (mSlots[item.mSlot].mGraphicBuffer != nullptr) {
+            freeBufferLocked(item.mSlot);
+        }
+        mSlots[item.mSlot].mGraphicBuffer = item.mGraphicBuffer;
+    }
+
+    mSlots[item.mSlot].mFrameNumber = item.mFrameNumber;
+    mSlots[item.mSlot].mFence = item.mFence;
+}
+
 status_t ConsumerBase::addReleaseFence(int slot,
         const sp<GraphicBuffer> graphicBuffer, const sp<Fence>& fence) {
     Mutex::Autolock lock(mMutex);
@@ -23,6 +23,9 @@
 #include <gui/BufferItem.h>
 #include <utils/Log.h>
 
+#include <algorithm>
+#include <vector>
+
 #define CC_LOGV(x, ...) ALOGV("[%s] " x, mName.string(), ##__VA_ARGS__)
 //#define CC_LOGD(x, ...) ALOGD("[%s] " x, mName.string(), ##__VA_ARGS__)
 //#define CC_LOGI(x, ...) ALOGI("[%s] " x, mName.string(), ##__VA_ARGS__)
@@ -87,15 +90,19 @@ static bool isPossiblyYUV(PixelFormat format) {
     }
 }
 
-status_t CpuConsumer::lockBufferItem(const BufferItem& item, LockedBuffer* outBuffer) const {
+status_t CpuConsumer::lockBufferItem(const BufferItem& item, LockedBuffer* outBuffer) {
     android_ycbcr ycbcr = android_ycbcr();
 
     PixelFormat format = item.mGraphicBuffer->getPixelFormat();
     PixelFormat flexFormat = format;
-    if (isPossiblyYUV(format)) {
+    SlotLockMode& lockMode = mSlotLockModes[item.mSlot];
+    bool skipYCbCr = lockMode.mBufferId == item.mGraphicBuffer->getId() && lockMode.mSkipYCbCr;
+    if (isPossiblyYUV(format) && !skipYCbCr) {
         int fenceFd = item.mFence.get() ? item.mFence->dup() : -1;
         status_t err = item.mGraphicBuffer->lockAsyncYCbCr(GraphicBuffer::USAGE_SW_READ_OFTEN,
                                                            item.mCrop, &ycbcr, fenceFd);
+        lockMode.mBufferId = item.mGraphicBuffer->getId();
+        lockMode.mSkipYCbCr = err != OK;
         if (err == OK) {
             flexFormat = HAL_PIXEL_FORMAT_YCbCr_420_888;
             if (format != HAL_PIXEL_FORMAT_YCbCr_420_888) {
@@ -172,11 +179,62 @@ status_t CpuConsumer::lockNextBuffer(LockedBuffer *nativeBuffer) {
         }
     }
 
-    if (b.mGraphicBuffer == nullptr) {
-        b.mGraphicBuffer = mSlots[b.mSlot].mGraphicBuffer;
+    return lockAcquiredBufferLocked(&b, nativeBuffer);
+}
+
+status_t CpuConsumer::lockNextBuffers(LockedBuffer* outBuffers, size_t maxBuffers,
+                                      size_t* outCount) {
+    status_t err;
+
+    if (!outBuffers || !outCount || maxBuffers == 0) return BAD_VALUE;
+    *outCount = 0;
+
+    Mutex::Autolock _l(mMutex);
+
+    if (mCurrentLockedBuffers == mMaxLockedBuffers) {
+        CC_LOGW("Max buffers have been locked (%zd), cannot lock anymore.",
+                mMaxLockedBuffers);
+        return NOT_ENOUGH_DATA;
+    }
+
+    std::vector<BufferItem> items;
+    err = acquireBuffersLocked(&items,
+                               std::min(maxBuffers, mMaxLockedBuffers - mCurrentLockedBuffers));
+    if (err != OK) {
+        if (err == BufferQueue::NO_BUFFER_AVAILABLE) {
+            return BAD_VALUE;
+        } else {
+            CC_LOGE("Error acquiring buffers: %s (%d)", strerror(err), err);
+            return err;
+        }
+    }
+
+    for (size_t i = 0; i < items.size(); i++) {
+        err = lockAcquiredBufferLocked(&items[i], &outBuffers[*outCount]);
+        if (err != OK) {
+            // Hand back everything that was acquired but not locked; the
+            // buffers locked so far are still returned to the caller.
+            for (size_t j = i; j < items.size(); j++) {
+                BufferItem& item = items[j];
+                if (item.mGraphicBuffer == nullptr) {
+                    item.mGraphicBuffer = mSlots[item.mSlot].mGraphicBuffer;
+                }
+                releaseBufferLocked(item.mSlot, item.mGraphicBuffer);
+            }
+            break;
+        }
+        (*outCount)++;
+    }
+
+    return *outCount > 0 ? OK : err;
+}
+
+status_t CpuConsumer::lockAcquiredBufferLocked(BufferItem* item, LockedBuffer* outBuffer) {
+    if (item->mGraphicBuffer == nullptr) {
+        item->mGraphicBuffer = mSlots[item->mSlot].mGraphicBuffer;
     }
 
-    err = lockBufferItem(b, nativeBuffer);
+    status_t err = lockBufferItem(*item, outBuffer);
     if (err != OK) {
         return err;
     }
@@ -186,9 +244,9 @@ status_t CpuConsumer::lockNextBuffer(LockedBuffer *nativeBuffer) {
     ALOG_ASSERT(lockedIdx < mMaxLockedBuffers);
     AcquiredBuffer& ab = mAcquiredBuffers.editItemAt(lockedIdx);
 
-    ab.mSlot = b.mSlot;
-    ab.mGraphicBuffer = b.mGraphicBuffer;
-    ab.mLockedBufferId = getLockedBufferId(*nativeBuffer);
+    ab.mSlot = item->mSlot;
+    ab.mGraphicBuffer = item->mGraphicBuffer;
+    ab.mLockedBufferId = getLockedBufferId(*outBuffer);
 
     mCurrentLockedBuffers++;
 
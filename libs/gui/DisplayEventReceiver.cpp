@@ -87,7 +87,7 @@ ssize_t DisplayEventReceiver::getEvents(DisplayEventReceiver::Event* events,
 ssize_t DisplayEventReceiver::getEvents(gui::BitTube* dataChannel,
         Event* events, size_t count)
 {
-    return gui::BitTube::recvObjects(dataChannel, events, count);
+    return gui::BitTube::recvObjectMessages(dataChannel, events, count);
 }
 
 ssize_t DisplayEventReceiver::sendEvents(Event const* events, size_t count) {
@@ -97,7 +97,9 @@ ssize_t DisplayEventReceiver::sendEvents(Event const* events, size_t count) {
 ssize_t DisplayEventReceiver::sendEvents(gui::BitTube* dataChannel,
         Event const* events, size_t count)
 {
-    return gui::BitTube::sendObjects(dataChannel, events, count);
+    // Each event goes in a message of its own, so that getEvents() can drain the queue with a
+    // single call.
+    return gui::BitTube::sendObjectMessages(dataChannel, events, count);
 }
 
 // ---------------------------------------------------------------------------
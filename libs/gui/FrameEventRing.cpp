@@ -0,0 +1,201 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "FrameEventRing"
+
+#include <gui/FrameEventRing.h>
+
+#include <cutils/ashmem.h>
+#include <gui/FrameTimestamps.h>
+#include <log/log.h>
+#include <sys/mman.h>
+#include <system/window.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+
+namespace android {
+
+namespace {
+
+// Bumped whenever Layout changes, so that a producer built against another layout stops reading.
+constexpr uint32_t kLayoutVersion = 1;
+
+// Number of attempts a reader makes before giving up on a slot that keeps being rewritten.
+constexpr int kMaxReadAttempts = 4;
+
+enum Time : size_t {
+    LATCH,
+    FIRST_REFRESH_START,
+    LAST_REFRESH_START,
+    GPU_COMPOSITION_DONE,
+    DISPLAY_PRESENT,
+    DEQUEUE_READY,
+    RELEASE,
+    TIME_COUNT,
+};
+
+nsecs_t toNativeTimestamp(nsecs_t time) {
+    return FrameEvents::isValidTimestamp(time) ? time : NATIVE_WINDOW_TIMESTAMP_PENDING;
+}
+
+nsecs_t toNativeSignalTime(const std::shared_ptr<FenceTime>& fence, bool fenceShouldBeKnown) {
+    if (!fenceShouldBeKnown) {
+        return NATIVE_WINDOW_TIMESTAMP_PENDING;
+    }
+    const nsecs_t signalTime = fence->getSignalTime();
+    return signalTime == Fence::SIGNAL_TIME_PENDING
+            ? NATIVE_WINDOW_TIMESTAMP_PENDING
+            : signalTime == Fence::SIGNAL_TIME_INVALID ? NATIVE_WINDOW_TIMESTAMP_INVALID
+                                                       : signalTime;
+}
+
+} // namespace
+
+struct FrameEventRing::Layout {
+    struct Slot {
+        // Odd while the slot is being written.
+        std::atomic<uint32_t> sequence;
+        std::atomic<uint64_t> frameNumber;
+        std::atomic<int64_t> times[TIME_COUNT];
+    };
+
+    std::atomic<uint32_t> version;
+    Slot slots[kCapacity];
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free &&
+                      std::atomic<uint64_t>::is_always_lock_free,
+              "FrameEventRing needs lock-free atomics to be shared across processes");
+
+sp<FrameEventRing> FrameEventRing::create() {
+    base::unique_fd fd(ashmem_create_region("FrameEventRing", sizeof(Layout)));
+    if (fd < 0) {
+        ALOGE("Failed to create the shared memory region: %s", strerror(errno));
+        return nullptr;
+    }
+    void* memory = mmap(nullptr, sizeof(Layout), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (memory == MAP_FAILED) {
+        ALOGE("Failed to map the shared memory region: %s", strerror(errno));
+        return nullptr;
+    }
+    // Only the creator keeps a writable mapping; whoever gets the fd can only read.
+    if (ashmem_set_prot_region(fd, PROT_READ) < 0) {
+        ALOGE("Failed to restrict the shared memory region: %s", strerror(errno));
+        munmap(memory, sizeof(Layout));
+        return nullptr;
+    }
+
+    // ashmem regions come zero-filled, which is a valid empty ring.
+    Layout* layout = static_cast<Layout*>(memory);
+    layout->version.store(kLayoutVersion, std::memory_order_release);
+    return new FrameEventRing(std::move(fd), layout, true);
+}
+
+sp<FrameEventRing> FrameEventRing::fromFd(base::unique_fd fd) {
+    if (fd < 0 || ashmem_get_size_region(fd) < static_cast<int>(sizeof(Layout))) {
+        ALOGE("Invalid shared memory region");
+        return nullptr;
+    }
+    void* memory = mmap(nullptr, sizeof(Layout), PROT_READ, MAP_SHARED, fd, 0);
+    if (memory == MAP_FAILED) {
+        ALOGE("Failed to map the shared memory region: %s", strerror(errno));
+        return nullptr;
+    }
+    Layout* layout = static_cast<Layout*>(memory);
+    if (layout->version.load(std::memory_order_acquire) != kLayoutVersion) {
+        ALOGE("Unsupported layout version %u", layout->version.load());
+        munmap(memory, sizeof(Layout));
+        return nullptr;
+    }
+    return new FrameEventRing(std::move(fd), layout, false);
+}
+
+FrameEventRing::FrameEventRing(base::unique_fd fd, Layout* layout, bool writable)
+      : mFd(std::move(fd)), mLayout(layout), mWritable(writable) {}
+
+FrameEventRing::~FrameEventRing() {
+    munmap(mLayout, sizeof(Layout));
+}
+
+void FrameEventRing::publish(const FrameEvents& events) {
+    LOG_ALWAYS_FATAL_IF(!mWritable, "publish on a read-only FrameEventRing");
+    if (!events.valid) {
+        return;
+    }
+
+    int64_t times[TIME_COUNT];
+    times[LATCH] = toNativeTimestamp(events.latchTime);
+    times[FIRST_REFRESH_START] = toNativeTimestamp(events.firstRefreshStartTime);
+    times[LAST_REFRESH_START] = toNativeTimestamp(events.lastRefreshStartTime);
+    times[GPU_COMPOSITION_DONE] = toNativeSignalTime(events.gpuCompositionDoneFence,
+                                                     events.hasGpuCompositionDoneInfo());
+    times[DISPLAY_PRESENT] =
+            toNativeSignalTime(events.displayPresentFence, events.hasDisplayPresentInfo());
+    times[DEQUEUE_READY] = toNativeTimestamp(events.dequeueReadyTime);
+    times[RELEASE] = toNativeSignalTime(events.releaseFence, events.hasReleaseInfo());
+
+    Layout::Slot& slot = mLayout->slots[events.frameNumber % kCapacity];
+    const uint32_t sequence = slot.sequence.load(std::memory_order_relaxed);
+    slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.frameNumber.store(events.frameNumber, std::memory_order_relaxed);
+    for (size_t i = 0; i < TIME_COUNT; i++) {
+        slot.times[i].store(times[i], std::memory_order_relaxed);
+    }
+
+    slot.sequence.store(sequence + 2, std::memory_order_release);
+}
+
+bool FrameEventRing::read(uint64_t frameNumber, Snapshot* outSnapshot) const {
+    const Layout::Slot& slot = mLayout->slots[frameNumber % kCapacity];
+    for (int attempt = 0; attempt < kMaxReadAttempts; attempt++) {
+        const uint32_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence & 1) {
+            continue;
+        }
+
+        const uint64_t slotFrameNumber = slot.frameNumber.load(std::memory_order_relaxed);
+        int64_t times[TIME_COUNT];
+        for (size_t i = 0; i < TIME_COUNT; i++) {
+            times[i] = slot.times[i].load(std::memory_order_relaxed);
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != sequence) {
+            continue;
+        }
+        // A zero sequence is a slot that was never written.
+        if (sequence == 0 || slotFrameNumber != frameNumber) {
+            return false;
+        }
+
+        outSnapshot->frameNumber = slotFrameNumber;
+        outSnapshot->latchTime = times[LATCH];
+        outSnapshot->firstRefreshStartTime = times[FIRST_REFRESH_START];
+        outSnapshot->lastRefreshStartTime = times[LAST_REFRESH_START];
+        outSnapshot->gpuCompositionDoneTime = times[GPU_COMPOSITION_DONE];
+        outSnapshot->displayPresentTime = times[DISPLAY_PRESENT];
+        outSnapshot->dequeueReadyTime = times[DEQUEUE_READY];
+        outSnapshot->releaseTime = times[RELEASE];
+        return true;
+    }
+    return false;
+}
+
+} // namespace android
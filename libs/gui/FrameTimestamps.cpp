@@ -21,6 +21,7 @@
 #include <LibGuiProperties.sysprop.h>
 #include <android-base/stringprintf.h>
 #include <cutils/compiler.h>  // For CC_[UN]LIKELY
+#include <gui/FrameEventRing.h>
 #include <inttypes.h>
 #include <utils/Log.h>
 
@@ -388,6 +389,7 @@ void ConsumerFrameEventHistory::addQueue(const NewFrameEventsEntry& newEntry) {
     // they have the original one already, so there is no need to set the
     // acquire dirty bit.
     mFramesDirty[mQueueOffset].setDirty<FrameEvent::POSTED>();
+    publishFrame(mFrames[mQueueOffset]);
 
     mQueueOffset = (mQueueOffset + 1) % mFrames.size();
 }
@@ -401,6 +403,7 @@ void ConsumerFrameEventHistory::addLatch(
     }
     frame->latchTime = latchTime;
     mFramesDirty[mCompositionOffset].setDirty<FrameEvent::LATCH>();
+    publishFrame(*frame);
 }
 
 void ConsumerFrameEventHistory::addPreComposition(
@@ -417,6 +420,7 @@ void ConsumerFrameEventHistory::addPreComposition(
         frame->firstRefreshStartTime = refreshStartTime;
         mFramesDirty[mCompositionOffset].setDirty<FrameEvent::FIRST_REFRESH_START>();
     }
+    publishFrame(*frame);
 }
 
 void ConsumerFrameEventHistory::addPostComposition(uint64_t frameNumber,
@@ -441,6 +445,8 @@ void ConsumerFrameEventHistory::addPostComposition(uint64_t frameNumber,
             mFramesDirty[mCompositionOffset].setDirty<FrameEvent::DISPLAY_PRESENT>();
         }
     }
+    // Fences of earlier frames may have signaled since they were published.
+    publishAllFrames();
 }
 
 void ConsumerFrameEventHistory::addRelease(uint64_t frameNumber,
@@ -454,6 +460,27 @@ void ConsumerFrameEventHistory::addRelease(uint64_t frameNumber,
     frame->dequeueReadyTime = dequeueReadyTime;
     frame->releaseFence = std::move(release);
     mFramesDirty[mReleaseOffset].setDirty<FrameEvent::RELEASE>();
+    publishFrame(*frame);
+}
+
+void ConsumerFrameEventHistory::setFrameEventRing(const sp<FrameEventRing>& ring) {
+    mFrameEventRing = ring;
+    publishAllFrames();
+}
+
+void ConsumerFrameEventHistory::publishFrame(const FrameEvents& frame) {
+    if (mFrameEventRing != nullptr && frame.connectId == mCurrentConnectId) {
+        mFrameEventRing->publish(frame);
+    }
+}
+
+void ConsumerFrameEventHistory::publishAllFrames() {
+    if (mFrameEventRing == nullptr) {
+        return;
+    }
+    for (const auto& frame : mFrames) {
+        publishFrame(frame);
+    }
 }
 
 void ConsumerFrameEventHistory::getFrameDelta(FrameEventHistoryDelta* delta,
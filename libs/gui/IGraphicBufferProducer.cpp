@@ -17,6 +17,8 @@
 #include <stdint.h>
 #include <sys/types.h>
 
+#include <algorithm>
+
 #include <utils/Errors.h>
 #include <utils/NativeHandle.h>
 #include <utils/RefBase.h>
@@ -34,6 +36,7 @@
 #include <gui/bufferqueue/1.0/H2BGraphicBufferProducer.h>
 #include <gui/bufferqueue/2.0/H2BGraphicBufferProducer.h>
 #include <gui/BufferQueueDefs.h>
+#include <gui/FrameEventRing.h>
 #include <gui/IGraphicBufferProducer.h>
 #include <gui/IProducerListener.h>
 
@@ -74,6 +77,8 @@ enum {
     GET_CONSUMER_USAGE,
     SET_LEGACY_BUFFER_DROP,
     SET_AUTO_PREROTATION,
+    DEQUEUE_BUFFERS,
+    GET_FRAME_EVENT_RING,
 };
 
 class BpGraphicBufferProducer : public BpInterface<IGraphicBufferProducer>
@@ -559,6 +564,92 @@ public:
         }
         return result;
     }
+
+    virtual status_t dequeueBuffers(const std::vector<DequeueBufferInput>& inputs,
+                                    std::vector<DequeueBufferOutput>* outputs) {
+        if (inputs.empty() || outputs == nullptr) {
+            return BAD_VALUE;
+        }
+
+        Parcel data, reply;
+        data.writeInterfaceToken(IGraphicBufferProducer::getInterfaceDescriptor());
+        data.writeUint32(static_cast<uint32_t>(inputs.size()));
+        for (const auto& input : inputs) {
+            data.writeUint32(input.width);
+            data.writeUint32(input.height);
+            data.writeInt32(static_cast<int32_t>(input.format));
+            data.writeUint64(input.usage);
+            data.writeBool(input.getTimestamps);
+        }
+
+        status_t result = remote()->transact(DEQUEUE_BUFFERS, data, &reply);
+        if (result != NO_ERROR) {
+            return result;
+        }
+        result = reply.readInt32();
+        if (result != NO_ERROR) {
+            return result;
+        }
+
+        const uint32_t count = reply.readUint32();
+        if (count == 0 || count > inputs.size()) {
+            ALOGE("IGBP::dequeueBuffers got %u outputs for %zu inputs", count, inputs.size());
+            return BAD_VALUE;
+        }
+
+        outputs->clear();
+        outputs->reserve(count);
+        for (uint32_t i = 0; i < count; i++) {
+            DequeueBufferOutput output;
+            output.result = reply.readInt32();
+            output.slot = reply.readInt32();
+            output.fence = new Fence();
+            result = reply.read(*output.fence);
+            if (result == NO_ERROR) {
+                result = reply.readUint64(&output.bufferAge);
+            }
+            if (result == NO_ERROR && reply.readBool()) {
+                output.buffer = new GraphicBuffer();
+                result = reply.read(*output.buffer);
+            }
+            if (result == NO_ERROR && inputs[i].getTimestamps) {
+                output.timestamps.emplace();
+                result = reply.read(*output.timestamps);
+            }
+            if (result != NO_ERROR) {
+                ALOGE("IGBP::dequeueBuffers failed to read output %u: %d", i, result);
+                return result;
+            }
+            outputs->push_back(std::move(output));
+        }
+        return NO_ERROR;
+    }
+
+    virtual status_t getFrameEventRing(sp<FrameEventRing>* outRing) {
+        if (outRing == nullptr) {
+            return BAD_VALUE;
+        }
+
+        Parcel data, reply;
+        data.writeInterfaceToken(IGraphicBufferProducer::getInterfaceDescriptor());
+        status_t result = remote()->transact(GET_FRAME_EVENT_RING, data, &reply);
+        if (result != NO_ERROR) {
+            return result;
+        }
+        result = reply.readInt32();
+        if (result != NO_ERROR) {
+            return result;
+        }
+
+        base::unique_fd fd;
+        result = reply.readUniqueFileDescriptor(&fd);
+        if (result != NO_ERROR) {
+            ALOGE("IGBP::getFrameEventRing failed to read fd: %d", result);
+            return result;
+        }
+        *outRing = FrameEventRing::fromFd(std::move(fd));
+        return *outRing != nullptr ? NO_ERROR : NO_MEMORY;
+    }
 };
 
 // Out-of-line virtual method definition to trigger vtable emission in this
@@ -691,6 +782,15 @@ public:
     status_t setAutoPrerotation(bool autoPrerotation) override {
         return mBase->setAutoPrerotation(autoPrerotation);
     }
+
+    status_t dequeueBuffers(const std::vector<DequeueBufferInput>& inputs,
+                            std::vector<DequeueBufferOutput>* outputs) override {
+        return mBase->dequeueBuffers(inputs, outputs);
+    }
+
+    status_t getFrameEventRing(sp<FrameEventRing>* outRing) override {
+        return mBase->getFrameEventRing(outRing);
+    }
 };
 
 IMPLEMENT_HYBRID_META_INTERFACE(GraphicBufferProducer,
@@ -710,6 +810,47 @@ status_t IGraphicBufferProducer::setAutoPrerotation(bool autoPrerotation) {
     return INVALID_OPERATION;
 }
 
+status_t IGraphicBufferProducer::getFrameEventRing(sp<FrameEventRing>* outRing) {
+    // Only supported by BufferQueue.
+    (void)outRing;
+    return INVALID_OPERATION;
+}
+
+status_t IGraphicBufferProducer::dequeueBuffers(const std::vector<DequeueBufferInput>& inputs,
+                                                std::vector<DequeueBufferOutput>* outputs) {
+    if (inputs.empty() || outputs == nullptr) {
+        return BAD_VALUE;
+    }
+
+    // Only BufferQueue knows whether a further dequeue would block, so other
+    // IGBPs serve the first request only.
+    outputs->clear();
+    outputs->emplace_back();
+    dequeueBufferWithRequest(inputs.front(), &outputs->back());
+    return NO_ERROR;
+}
+
+void IGraphicBufferProducer::dequeueBufferWithRequest(const DequeueBufferInput& input,
+                                                      DequeueBufferOutput* output) {
+    if (input.getTimestamps) {
+        output->timestamps.emplace();
+    }
+    output->result = dequeueBuffer(&output->slot, &output->fence, input.width, input.height,
+                                   input.format, input.usage, &output->bufferAge,
+                                   output->timestamps ? &*output->timestamps : nullptr);
+    if (output->result < 0 || !(output->result & BUFFER_NEEDS_REALLOCATION)) {
+        return;
+    }
+
+    status_t result = requestBuffer(output->slot, &output->buffer);
+    if (result != NO_ERROR) {
+        ALOGE("dequeueBuffers: requestBuffer failed for slot %d: %d", output->slot, result);
+        cancelBuffer(output->slot, output->fence);
+        output->result = result;
+        output->buffer.clear();
+    }
+}
+
 status_t IGraphicBufferProducer::exportToParcel(Parcel* parcel) {
     status_t res = OK;
     res = parcel->writeUint32(USE_BUFFER_QUEUE);
@@ -1079,6 +1220,67 @@ status_t BnGraphicBufferProducer::onTransact(
             reply->writeInt32(result);
             return NO_ERROR;
         }
+        case DEQUEUE_BUFFERS: {
+            CHECK_INTERFACE(IGraphicBufferProducer, data, reply);
+            const uint32_t count = data.readUint32();
+            if (count == 0 || count > BufferQueueDefs::NUM_BUFFER_SLOTS) {
+                reply->writeInt32(BAD_VALUE);
+                return NO_ERROR;
+            }
+            std::vector<DequeueBufferInput> inputs(count);
+            for (auto& input : inputs) {
+                input.width = data.readUint32();
+                input.height = data.readUint32();
+                input.format = static_cast<PixelFormat>(data.readInt32());
+                input.usage = data.readUint64();
+                input.getTimestamps = data.readBool();
+            }
+
+            std::vector<DequeueBufferOutput> outputs;
+            status_t result = dequeueBuffers(inputs, &outputs);
+            reply->writeInt32(result);
+            if (result != NO_ERROR) {
+                return NO_ERROR;
+            }
+
+            const size_t outputCount = std::min(outputs.size(), inputs.size());
+            reply->writeUint32(static_cast<uint32_t>(outputCount));
+            for (size_t i = 0; i < outputCount; i++) {
+                DequeueBufferOutput& output = outputs[i];
+                if (output.fence == nullptr) {
+                    ALOGE("dequeueBuffers returned a NULL fence, setting to Fence::NO_FENCE");
+                    output.fence = Fence::NO_FENCE;
+                }
+                reply->writeInt32(output.result);
+                reply->writeInt32(output.slot);
+                reply->write(*output.fence);
+                reply->writeUint64(output.bufferAge);
+                reply->writeBool(output.buffer != nullptr);
+                if (output.buffer != nullptr) {
+                    reply->write(*output.buffer);
+                }
+                if (inputs[i].getTimestamps) {
+                    if (!output.timestamps) {
+                        output.timestamps.emplace();
+                    }
+                    reply->write(*output.timestamps);
+                }
+            }
+            return NO_ERROR;
+        }
+        case GET_FRAME_EVENT_RING: {
+            CHECK_INTERFACE(IGraphicBufferProducer, data, reply);
+            sp<FrameEventRing> ring;
+            status_t result = getFrameEventRing(&ring);
+            if (result == NO_ERROR && ring == nullptr) {
+                result = NO_MEMORY;
+            }
+            reply->writeInt32(result);
+            if (result == NO_ERROR) {
+                reply->writeDupFileDescriptor(ring->getFd());
+            }
+            return NO_ERROR;
+        }
     }
     return BBinder::onTransact(code, data, reply, flags);
 }
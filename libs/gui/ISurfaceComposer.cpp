@@ -145,6 +145,42 @@ public:
         return result;
     }
 
+    virtual status_t captureScreenIntoBuffer(const sp<IBinder>& display,
+                                             const sp<GraphicBuffer>& buffer,
+                                             ui::Dataspace reqDataspace, const Rect& sourceCrop,
+                                             bool useIdentityTransform, ui::Rotation rotation,
+                                             bool captureSecureLayers,
+                                             bool& outCapturedSecureLayers,
+                                             sp<Fence>* outFence) {
+        if (buffer == nullptr || outFence == nullptr) {
+            return BAD_VALUE;
+        }
+        Parcel data, reply;
+        data.writeInterfaceToken(ISurfaceComposer::getInterfaceDescriptor());
+        data.writeStrongBinder(display);
+        data.write(*buffer);
+        data.writeInt32(static_cast<int32_t>(reqDataspace));
+        data.write(sourceCrop);
+        data.writeInt32(static_cast<int32_t>(useIdentityTransform));
+        data.writeInt32(static_cast<int32_t>(rotation));
+        data.writeInt32(static_cast<int32_t>(captureSecureLayers));
+        status_t result =
+                remote()->transact(BnSurfaceComposer::CAPTURE_SCREEN_INTO_BUFFER, data, &reply);
+        if (result != NO_ERROR) {
+            ALOGE("captureScreenIntoBuffer failed to transact: %d", result);
+            return result;
+        }
+        result = reply.readInt32();
+        if (result != NO_ERROR) {
+            ALOGE("captureScreenIntoBuffer failed to readInt32: %d", result);
+            return result;
+        }
+
+        outCapturedSecureLayers = reply.readBool();
+        *outFence = new Fence();
+        return reply.read(**outFence);
+    }
+
     virtual status_t captureScreen(uint64_t displayOrLayerStack, ui::Dataspace* outDataspace,
                                    sp<GraphicBuffer>* outBuffer) {
         Parcel data, reply;
@@ -1254,10 +1290,10 @@ status_t BnSurfaceComposer::onTransact(
             if (count > data.dataSize()) {
                 return BAD_VALUE;
             }
-            DisplayState d;
             Vector<DisplayState> displays;
             displays.setCapacity(count);
             for (size_t i = 0; i < count; i++) {
+                DisplayState d;
                 if (d.read(data) == BAD_VALUE) {
                     return BAD_VALUE;
                 }
@@ -1322,6 +1358,35 @@ status_t BnSurfaceComposer::onTransact(
             }
             return NO_ERROR;
         }
+        case CAPTURE_SCREEN_INTO_BUFFER: {
+            CHECK_INTERFACE(ISurfaceComposer, data, reply);
+            sp<IBinder> display = data.readStrongBinder();
+            sp<GraphicBuffer> buffer = new GraphicBuffer();
+            status_t res = data.read(*buffer);
+            if (res != NO_ERROR) {
+                ALOGE("captureScreenIntoBuffer: failed to read buffer: %d", res);
+                return res;
+            }
+            ui::Dataspace reqDataspace = static_cast<ui::Dataspace>(data.readInt32());
+            Rect sourceCrop(Rect::EMPTY_RECT);
+            data.read(sourceCrop);
+            bool useIdentityTransform = static_cast<bool>(data.readInt32());
+            int32_t rotation = data.readInt32();
+            bool captureSecureLayers = static_cast<bool>(data.readInt32());
+
+            bool capturedSecureLayers = false;
+            sp<Fence> fence;
+            res = captureScreenIntoBuffer(display, buffer, reqDataspace, sourceCrop,
+                                          useIdentityTransform, ui::toRotation(rotation),
+                                          captureSecureLayers, capturedSecureLayers, &fence);
+
+            reply->writeInt32(res);
+            if (res == NO_ERROR) {
+                reply->writeBool(capturedSecureLayers);
+                reply->write(fence != nullptr ? *fence : *Fence::NO_FENCE);
+            }
+            return NO_ERROR;
+        }
         case CAPTURE_SCREEN_BY_ID: {
             CHECK_INTERFACE(ISurfaceComposer, data, reply);
             uint64_t displayOrLayerStack = data.readUint64();
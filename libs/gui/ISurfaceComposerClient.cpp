@@ -35,7 +35,8 @@ enum class Tag : uint32_t {
     CLEAR_LAYER_FRAME_STATS,
     GET_LAYER_FRAME_STATS,
     MIRROR_SURFACE,
-    LAST = MIRROR_SURFACE,
+    GET_LAYER_FRAME_STATS_SINCE,
+    LAST = GET_LAYER_FRAME_STATS_SINCE,
 };
 
 } // Anonymous namespace
@@ -85,6 +86,14 @@ public:
                                                               outStats);
     }
 
+    status_t getLayerFrameStatsSince(const sp<IBinder>& handle, uint64_t frameNumber,
+                                     FrameStats* outStats,
+                                     uint64_t* outNextFrameNumber) const override {
+        return callRemote<decltype(&ISurfaceComposerClient::getLayerFrameStatsSince)>(
+                Tag::GET_LAYER_FRAME_STATS_SINCE, handle, frameNumber, outStats,
+                outNextFrameNumber);
+    }
+
     status_t mirrorSurface(const sp<IBinder>& mirrorFromHandle, sp<IBinder>* outHandle) override {
         return callRemote<decltype(&ISurfaceComposerClient::mirrorSurface)>(Tag::MIRROR_SURFACE,
                                                                             mirrorFromHandle,
@@ -117,6 +126,8 @@ status_t BnSurfaceComposerClient::onTransact(uint32_t code, const Parcel& data,
             return callLocal(data, reply, &ISurfaceComposerClient::getLayerFrameStats);
         case Tag::MIRROR_SURFACE:
             return callLocal(data, reply, &ISurfaceComposerClient::mirrorSurface);
+        case Tag::GET_LAYER_FRAME_STATS_SINCE:
+            return callLocal(data, reply, &ISurfaceComposerClient::getLayerFrameStatsSince);
     }
 }
 
@@ -25,7 +25,8 @@ namespace { // Anonymous
 
 enum class Tag : uint32_t {
     ON_TRANSACTION_COMPLETED = IBinder::FIRST_CALL_TRANSACTION,
-    LAST = ON_TRANSACTION_COMPLETED,
+    ON_CACHED_BUFFER_EVICTED,
+    LAST = ON_CACHED_BUFFER_EVICTED,
 };
 
 } // Anonymous namespace
@@ -195,30 +196,198 @@ status_t TransactionStats::readFromParcel(const Parcel* input) {
     return input->readParcelableVector(&surfaceStats);
 }
 
+namespace { // Anonymous
+
+// The fences of a ListenerStats are mostly shared: every transaction presented in a frame carries
+// the frame's present fence, and every surface composited by the GPU carries the same composition
+// fence. Each fence costs a file descriptor to parcel, so a ListenerStats writes each of its
+// fences once, followed by the stats which refer to them by index.
+constexpr int32_t NO_FENCE_INDEX = -1;
+
+class FenceTable {
+public:
+    int32_t add(const sp<Fence>& fence) {
+        if (fence == nullptr) {
+            return NO_FENCE_INDEX;
+        }
+        for (size_t i = 0; i < mFences.size(); i++) {
+            if (mFences[i] == fence) {
+                return static_cast<int32_t>(i);
+            }
+        }
+        mFences.push_back(fence);
+        return static_cast<int32_t>(mFences.size() - 1);
+    }
+
+    status_t writeToParcel(Parcel* output) const {
+        status_t err = output->writeInt32(static_cast<int32_t>(mFences.size()));
+        if (err != NO_ERROR) {
+            return err;
+        }
+        for (const auto& fence : mFences) {
+            err = output->write(*fence);
+            if (err != NO_ERROR) {
+                return err;
+            }
+        }
+        return NO_ERROR;
+    }
+
+    status_t readFromParcel(const Parcel* input) {
+        int32_t count = 0;
+        status_t err = input->readInt32(&count);
+        if (err != NO_ERROR) {
+            return err;
+        }
+        if (count < 0 || static_cast<size_t>(count) > input->dataAvail()) {
+            return BAD_VALUE;
+        }
+        mFences.reserve(count);
+        for (int32_t i = 0; i < count; i++) {
+            sp<Fence> fence = new Fence();
+            err = input->read(*fence);
+            if (err != NO_ERROR) {
+                return err;
+            }
+            mFences.push_back(fence);
+        }
+        return NO_ERROR;
+    }
+
+    status_t read(const Parcel* input, sp<Fence>* outFence) const {
+        int32_t index = NO_FENCE_INDEX;
+        status_t err = input->readInt32(&index);
+        if (err != NO_ERROR) {
+            return err;
+        }
+        if (index == NO_FENCE_INDEX) {
+            *outFence = nullptr;
+            return NO_ERROR;
+        }
+        if (index < 0 || static_cast<size_t>(index) >= mFences.size()) {
+            return BAD_VALUE;
+        }
+        *outFence = mFences[index];
+        return NO_ERROR;
+    }
+
+private:
+    std::vector<sp<Fence>> mFences;
+};
+
+} // Anonymous namespace
+
 status_t ListenerStats::writeToParcel(Parcel* output) const {
-    status_t err = output->writeInt32(static_cast<int32_t>(transactionStats.size()));
+    FenceTable fences;
+    for (const auto& stats : transactionStats) {
+        fences.add(stats.presentFence);
+        for (const auto& surfaceStats : stats.surfaceStats) {
+            fences.add(surfaceStats.previousReleaseFence);
+            fences.add(surfaceStats.eventStats.gpuCompositionDoneFence);
+        }
+    }
+    status_t err = fences.writeToParcel(output);
+    if (err != NO_ERROR) {
+        return err;
+    }
+
+    err = output->writeInt32(static_cast<int32_t>(transactionStats.size()));
     if (err != NO_ERROR) {
         return err;
     }
     for (const auto& stats : transactionStats) {
-        err = output->writeParcelable(stats);
-        if (err != NO_ERROR) {
-            return err;
+        err = output->writeInt64Vector(stats.callbackIds);
+        if (err != NO_ERROR) return err;
+        err = output->writeInt64(stats.latchTime);
+        if (err != NO_ERROR) return err;
+        err = output->writeInt32(fences.add(stats.presentFence));
+        if (err != NO_ERROR) return err;
+
+        err = output->writeInt32(static_cast<int32_t>(stats.surfaceStats.size()));
+        if (err != NO_ERROR) return err;
+        for (const auto& surfaceStats : stats.surfaceStats) {
+            const auto& eventStats = surfaceStats.eventStats;
+            err = output->writeStrongBinder(surfaceStats.surfaceControl);
+            if (err != NO_ERROR) return err;
+            err = output->writeInt64(surfaceStats.acquireTime);
+            if (err != NO_ERROR) return err;
+            err = output->writeInt32(fences.add(surfaceStats.previousReleaseFence));
+            if (err != NO_ERROR) return err;
+            err = output->writeUint32(surfaceStats.transformHint);
+            if (err != NO_ERROR) return err;
+            err = output->writeUint64(eventStats.frameNumber);
+            if (err != NO_ERROR) return err;
+            err = output->writeInt32(fences.add(eventStats.gpuCompositionDoneFence));
+            if (err != NO_ERROR) return err;
+            err = output->writeInt64(eventStats.compositorTiming.deadline);
+            if (err != NO_ERROR) return err;
+            err = output->writeInt64(eventStats.compositorTiming.interval);
+            if (err != NO_ERROR) return err;
+            err = output->writeInt64(eventStats.compositorTiming.presentLatency);
+            if (err != NO_ERROR) return err;
+            err = output->writeInt64(eventStats.refreshStartTime);
+            if (err != NO_ERROR) return err;
+            err = output->writeInt64(eventStats.dequeueReadyTime);
+            if (err != NO_ERROR) return err;
         }
     }
     return NO_ERROR;
 }
 
 status_t ListenerStats::readFromParcel(const Parcel* input) {
-    int32_t transactionStats_size = input->readInt32();
+    FenceTable fences;
+    status_t err = fences.readFromParcel(input);
+    if (err != NO_ERROR) {
+        return err;
+    }
 
+    int32_t transactionStats_size = 0;
+    err = input->readInt32(&transactionStats_size);
+    if (err != NO_ERROR) {
+        return err;
+    }
     for (int i = 0; i < transactionStats_size; i++) {
         TransactionStats stats;
-        status_t err = input->readParcelable(&stats);
-        if (err != NO_ERROR) {
-            return err;
+        err = input->readInt64Vector(&stats.callbackIds);
+        if (err != NO_ERROR) return err;
+        err = input->readInt64(&stats.latchTime);
+        if (err != NO_ERROR) return err;
+        err = fences.read(input, &stats.presentFence);
+        if (err != NO_ERROR) return err;
+
+        int32_t surfaceStats_size = 0;
+        err = input->readInt32(&surfaceStats_size);
+        if (err != NO_ERROR) return err;
+        if (surfaceStats_size < 0 || static_cast<size_t>(surfaceStats_size) > input->dataAvail()) {
+            return BAD_VALUE;
+        }
+        stats.surfaceStats.resize(surfaceStats_size);
+        for (auto& surfaceStats : stats.surfaceStats) {
+            auto& eventStats = surfaceStats.eventStats;
+            err = input->readStrongBinder(&surfaceStats.surfaceControl);
+            if (err != NO_ERROR) return err;
+            err = input->readInt64(&surfaceStats.acquireTime);
+            if (err != NO_ERROR) return err;
+            err = fences.read(input, &surfaceStats.previousReleaseFence);
+            if (err != NO_ERROR) return err;
+            err = input->readUint32(&surfaceStats.transformHint);
+            if (err != NO_ERROR) return err;
+            err = input->readUint64(&eventStats.frameNumber);
+            if (err != NO_ERROR) return err;
+            err = fences.read(input, &eventStats.gpuCompositionDoneFence);
+            if (err != NO_ERROR) return err;
+            err = input->readInt64(&eventStats.compositorTiming.deadline);
+            if (err != NO_ERROR) return err;
+            err = input->readInt64(&eventStats.compositorTiming.interval);
+            if (err != NO_ERROR) return err;
+            err = input->readInt64(&eventStats.compositorTiming.presentLatency);
+            if (err != NO_ERROR) return err;
+            err = input->readInt64(&eventStats.refreshStartTime);
+            if (err != NO_ERROR) return err;
+            err = input->readInt64(&eventStats.dequeueReadyTime);
+            if (err != NO_ERROR) return err;
         }
-        transactionStats.push_back(stats);
+        transactionStats.push_back(std::move(stats));
     }
     return NO_ERROR;
 }
@@ -245,6 +414,12 @@ public:
                                          onTransactionCompleted)>(Tag::ON_TRANSACTION_COMPLETED,
                                                                   stats);
     }
+
+    void onCachedBufferEvicted(uint64_t cacheId) override {
+        callRemoteAsync<decltype(&ITransactionCompletedListener::
+                                         onCachedBufferEvicted)>(Tag::ON_CACHED_BUFFER_EVICTED,
+                                                                 cacheId);
+    }
 };
 
 // Out-of-line virtual method definitions to trigger vtable emission in this translation unit (see
@@ -263,6 +438,9 @@ status_t BnTransactionCompletedListener::onTransact(uint32_t code, const Parcel&
         case Tag::ON_TRANSACTION_COMPLETED:
             return callLocalAsync(data, reply,
                                   &ITransactionCompletedListener::onTransactionCompleted);
+        case Tag::ON_CACHED_BUFFER_EVICTED:
+            return callLocalAsync(data, reply,
+                                  &ITransactionCompletedListener::onCachedBufferEvicted);
     }
 }
 
@@ -110,7 +110,9 @@ status_t IGraphicBufferProducer::QueueBufferInput::unflatten(
 ////////////////////////////////////////////////////////////////////////
 constexpr size_t IGraphicBufferProducer::QueueBufferOutput::minFlattenedSize() {
     return sizeof(width) + sizeof(height) + sizeof(transformHint) + sizeof(numPendingBuffers) +
-            sizeof(nextFrameNumber) + sizeof(bufferReplaced) + sizeof(maxBufferCount);
+            sizeof(nextFrameNumber) + sizeof(bufferReplaced) + sizeof(maxBufferCount) +
+            sizeof(hasConsumerProperties) + sizeof(consumerUsageBits) + sizeof(defaultDataSpace) +
+            sizeof(consumerIsProtected);
 }
 size_t IGraphicBufferProducer::QueueBufferOutput::getFlattenedSize() const {
     return minFlattenedSize() + frameTimestamps.getFlattenedSize();
@@ -134,6 +136,10 @@ status_t IGraphicBufferProducer::QueueBufferOutput::flatten(
     FlattenableUtils::write(buffer, size, nextFrameNumber);
     FlattenableUtils::write(buffer, size, bufferReplaced);
     FlattenableUtils::write(buffer, size, maxBufferCount);
+    FlattenableUtils::write(buffer, size, hasConsumerProperties);
+    FlattenableUtils::write(buffer, size, consumerUsageBits);
+    FlattenableUtils::write(buffer, size, defaultDataSpace);
+    FlattenableUtils::write(buffer, size, consumerIsProtected);
 
     return frameTimestamps.flatten(buffer, size, fds, count);
 }
@@ -152,6 +158,10 @@ status_t IGraphicBufferProducer::QueueBufferOutput::unflatten(
     FlattenableUtils::read(buffer, size, nextFrameNumber);
     FlattenableUtils::read(buffer, size, bufferReplaced);
     FlattenableUtils::read(buffer, size, maxBufferCount);
+    FlattenableUtils::read(buffer, size, hasConsumerProperties);
+    FlattenableUtils::read(buffer, size, consumerUsageBits);
+    FlattenableUtils::read(buffer, size, defaultDataSpace);
+    FlattenableUtils::read(buffer, size, consumerIsProtected);
 
     return frameTimestamps.unflatten(buffer, size, fds, count);
 }
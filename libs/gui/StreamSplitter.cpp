@@ -62,9 +62,9 @@ StreamSplitter::StreamSplitter(const sp<IGraphicBufferConsumer>& inputQueue)
 
 StreamSplitter::~StreamSplitter() {
     mInput->consumerDisconnect();
-    Vector<sp<IGraphicBufferProducer> >::iterator output = mOutputs.begin();
+    Vector<Output>::iterator output = mOutputs.begin();
     for (; output != mOutputs.end(); ++output) {
-        (*output)->disconnect(NATIVE_WINDOW_API_CPU);
+        output->mProducer->disconnect(NATIVE_WINDOW_API_CPU);
     }
 
     if (mBuffers.size() > 0) {
@@ -73,11 +73,16 @@ StreamSplitter::~StreamSplitter() {
 }
 
 status_t StreamSplitter::addOutput(
-        const sp<IGraphicBufferProducer>& outputQueue) {
+        const sp<IGraphicBufferProducer>& outputQueue, DropPolicy policy,
+        size_t maxBuffers) {
     if (outputQueue == nullptr) {
         ALOGE("addOutput: outputQueue must not be NULL");
         return BAD_VALUE;
     }
+    if (policy != DropPolicy::Block && maxBuffers == 0) {
+        ALOGE("addOutput: maxBuffers must be positive");
+        return BAD_VALUE;
+    }
 
     Mutex::Autolock lock(mMutex);
 
@@ -91,7 +96,23 @@ status_t StreamSplitter::addOutput(
         return status;
     }
 
-    mOutputs.push_back(outputQueue);
+    // In async mode a queued frame that has not been acquired yet is replaced
+    // by the next one, which is reported through bufferReplaced on queue.
+    if (policy == DropPolicy::LatestOnly) {
+        status = outputQueue->setAsyncMode(true);
+        if (status != NO_ERROR) {
+            ALOGE("addOutput: failed to set async mode (%d)", status);
+            outputQueue->disconnect(NATIVE_WINDOW_API_CPU);
+            return status;
+        }
+    }
+
+    Output output;
+    output.mProducer = outputQueue;
+    output.mPolicy = policy;
+    output.mMaxBuffers = maxBuffers;
+    output.mBufferCount = 0;
+    mOutputs.push_back(output);
 
     return NO_ERROR;
 }
@@ -105,13 +126,13 @@ void StreamSplitter::onFrameAvailable(const BufferItem& /* item */) {
     ATRACE_CALL();
     Mutex::Autolock lock(mMutex);
 
-    // The current policy is that if any one consumer is consuming buffers too
-    // slowly, the splitter will stall the rest of the outputs by not acquiring
-    // any more buffers from the input. This will cause back pressure on the
-    // input queue, slowing down its producer.
+    // If any Block output is consuming buffers too slowly, the splitter will
+    // stall the rest of the outputs by not acquiring any more buffers from the
+    // input. This will cause back pressure on the input queue, slowing down
+    // its producer. Other outputs drop frames instead, below.
 
     // If there are too many outstanding buffers, we block until a buffer is
-    // released back to the input in onBufferReleased
+    // released by the Block outputs in onBufferReleased
     while (mOutstandingBuffers >= MAX_OUTSTANDING_BUFFERS) {
         mReleaseCondition.wait(mMutex);
 
@@ -123,7 +144,6 @@ void StreamSplitter::onFrameAvailable(const BufferItem& /* item */) {
             return;
         }
     }
-    ++mOutstandingBuffers;
 
     // Acquire and detach the buffer from the input
     BufferItem bufferItem;
@@ -139,8 +159,9 @@ void StreamSplitter::onFrameAvailable(const BufferItem& /* item */) {
             "detaching buffer from input failed (%d)", status);
 
     // Initialize our reference count for this buffer
-    mBuffers.add(bufferItem.mGraphicBuffer->getId(),
-            new BufferTracker(bufferItem.mGraphicBuffer));
+    const uint64_t bufferId = bufferItem.mGraphicBuffer->getId();
+    sp<BufferTracker> tracker = new BufferTracker(bufferItem.mGraphicBuffer);
+    mBuffers.add(bufferId, tracker);
 
     IGraphicBufferProducer::QueueBufferInput queueInput(
             bufferItem.mTimestamp, bufferItem.mIsAutoTimestamp,
@@ -149,17 +170,23 @@ void StreamSplitter::onFrameAvailable(const BufferItem& /* item */) {
             bufferItem.mTransform, bufferItem.mFence);
 
     // Attach and queue the buffer to each of the outputs
-    Vector<sp<IGraphicBufferProducer> >::iterator output = mOutputs.begin();
-    for (; output != mOutputs.end(); ++output) {
+    for (size_t i = 0; i < mOutputs.size(); ++i) {
+        Output& output = mOutputs.editItemAt(i);
+        const bool blocking = output.mPolicy == DropPolicy::Block;
+
+        if (!blocking && output.mBufferCount >= output.mMaxBuffers) {
+            ALOGV("dropped buffer %#" PRIx64 " for output %p", bufferId,
+                    output.mProducer.get());
+            continue;
+        }
+
         int slot;
-        status = (*output)->attachBuffer(&slot, bufferItem.mGraphicBuffer);
+        status = output.mProducer->attachBuffer(&slot, bufferItem.mGraphicBuffer);
         if (status == NO_INIT) {
             // If we just discovered that this output has been abandoned, note
-            // that, increment the release count so that we still release this
-            // buffer eventually, and move on to the next output
+            // that, don't take a reference for it so that we still release
+            // this buffer eventually, and move on to the next output
             onAbandonedLocked();
-            mBuffers.editValueFor(bufferItem.mGraphicBuffer->getId())->
-                    incrementReleaseCountLocked();
             continue;
         } else {
             LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
@@ -167,22 +194,37 @@ void StreamSplitter::onFrameAvailable(const BufferItem& /* item */) {
         }
 
         IGraphicBufferProducer::QueueBufferOutput queueOutput;
-        status = (*output)->queueBuffer(slot, queueInput, &queueOutput);
+        status = output.mProducer->queueBuffer(slot, queueInput, &queueOutput);
         if (status == NO_INIT) {
             // If we just discovered that this output has been abandoned, note
-            // that, increment the release count so that we still release this
-            // buffer eventually, and move on to the next output
+            // that, don't take a reference for it so that we still release
+            // this buffer eventually, and move on to the next output
             onAbandonedLocked();
-            mBuffers.editValueFor(bufferItem.mGraphicBuffer->getId())->
-                    incrementReleaseCountLocked();
             continue;
         } else {
             LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
                     "queueing buffer to output failed (%d)", status);
         }
 
-        ALOGV("queued buffer %#" PRIx64 " to output %p",
-                bufferItem.mGraphicBuffer->getId(), output->get());
+        if (blocking && tracker->getBlockingRefCountLocked() == 0) {
+            ++mOutstandingBuffers;
+        }
+        tracker->addReferenceLocked(blocking);
+        ++output.mBufferCount;
+
+        ALOGV("queued buffer %#" PRIx64 " to output %p", bufferId,
+                output.mProducer.get());
+
+        // The frame this one replaced is free in the output now, but the
+        // output's consumer never saw it, so no release callback will come
+        if (queueOutput.bufferReplaced) {
+            releaseFromOutputLocked(i);
+        }
+    }
+
+    // Every output dropped this frame, so hand it straight back
+    if (tracker->getRefCountLocked() == 0) {
+        releaseToInputLocked(bufferId);
     }
 }
 
@@ -191,6 +233,18 @@ void StreamSplitter::onBufferReleasedByOutput(
     ATRACE_CALL();
     Mutex::Autolock lock(mMutex);
 
+    size_t outputIndex = findOutputLocked(from);
+    if (outputIndex == mOutputs.size()) {
+        ALOGE("onBufferReleasedByOutput: unknown output %p", from.get());
+        return;
+    }
+    releaseFromOutputLocked(outputIndex);
+}
+
+void StreamSplitter::releaseFromOutputLocked(size_t outputIndex) {
+    Output& output = mOutputs.editItemAt(outputIndex);
+    const sp<IGraphicBufferProducer>& from = output.mProducer;
+
     sp<GraphicBuffer> buffer;
     sp<Fence> fence;
     status_t status = from->detachNextBuffer(&buffer, &fence);
@@ -214,23 +268,38 @@ void StreamSplitter::onBufferReleasedByOutput(
     tracker->mergeFence(fence);
 
     // Check to see if this is the last outstanding reference to this buffer
-    size_t releaseCount = tracker->incrementReleaseCountLocked();
-    ALOGV("buffer %#" PRIx64 " reference count %zu (of %zu)", buffer->getId(),
-            releaseCount, mOutputs.size());
-    if (releaseCount < mOutputs.size()) {
+    const bool blocking = output.mPolicy == DropPolicy::Block;
+    --output.mBufferCount;
+    size_t refCount = tracker->removeReferenceLocked(blocking);
+    ALOGV("buffer %#" PRIx64 " reference count %zu", buffer->getId(), refCount);
+
+    // Once no Block output holds the buffer it no longer counts against the
+    // input, so notify any waiting onFrameAvailable calls
+    if (blocking && tracker->getBlockingRefCountLocked() == 0) {
+        --mOutstandingBuffers;
+        mReleaseCondition.signal();
+    }
+
+    if (refCount > 0) {
         return;
     }
 
+    releaseToInputLocked(buffer->getId());
+}
+
+void StreamSplitter::releaseToInputLocked(uint64_t bufferId) {
+    const sp<BufferTracker> tracker = mBuffers.valueFor(bufferId);
+
     // If we've been abandoned, we can't return the buffer to the input, so just
     // stop tracking it and move on
     if (mIsAbandoned) {
-        mBuffers.removeItem(buffer->getId());
+        mBuffers.removeItem(bufferId);
         return;
     }
 
     // Attach and release the buffer back to the input
     int consumerSlot;
-    status = mInput->attachBuffer(&consumerSlot, tracker->getBuffer());
+    status_t status = mInput->attachBuffer(&consumerSlot, tracker->getBuffer());
     LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
             "attaching buffer to input failed (%d)", status);
 
@@ -239,15 +308,22 @@ void StreamSplitter::onBufferReleasedByOutput(
     LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
             "releasing buffer to input failed (%d)", status);
 
-    ALOGV("released buffer %#" PRIx64 " to input", buffer->getId());
+    ALOGV("released buffer %#" PRIx64 " to input", bufferId);
 
     // We no longer need to track the buffer once it has been returned to the
     // input
-    mBuffers.removeItem(buffer->getId());
+    mBuffers.removeItem(bufferId);
+}
 
-    // Notify any waiting onFrameAvailable calls
-    --mOutstandingBuffers;
-    mReleaseCondition.signal();
+size_t StreamSplitter::findOutputLocked(
+        const sp<IGraphicBufferProducer>& from) const {
+    sp<IBinder> binder = IInterface::asBinder(from);
+    for (size_t i = 0; i < mOutputs.size(); ++i) {
+        if (IInterface::asBinder(mOutputs[i].mProducer) == binder) {
+            return i;
+        }
+    }
+    return mOutputs.size();
 }
 
 void StreamSplitter::onAbandonedLocked() {
@@ -276,7 +352,8 @@ void StreamSplitter::OutputListener::binderDied(const wp<IBinder>& /* who */) {
 }
 
 StreamSplitter::BufferTracker::BufferTracker(const sp<GraphicBuffer>& buffer)
-      : mBuffer(buffer), mMergedFence(Fence::NO_FENCE), mReleaseCount(0) {}
+      : mBuffer(buffer), mMergedFence(Fence::NO_FENCE), mRefCount(0),
+        mBlockingRefCount(0) {}
 
 StreamSplitter::BufferTracker::~BufferTracker() {}
 
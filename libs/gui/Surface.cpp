@@ -40,6 +40,7 @@
 #include <ui/Region.h>
 
 #include <gui/BufferItem.h>
+#include <gui/FrameEventRing.h>
 #include <gui/IProducerListener.h>
 
 #include <gui/ISurfaceComposer.h>
@@ -107,6 +108,10 @@ Surface::Surface(const sp<IGraphicBufferProducer>& bufferProducer, bool controll
     mUserHeight = 0;
     mTransformHint = 0;
     mConsumerRunningBehind = false;
+    mHasConsumerProperties = false;
+    mConsumerUsageBits = 0;
+    mDefaultDataSpace = 0;
+    mConsumerIsProtected = false;
     mConnectedToCpu = false;
     mProducerControlledByApp = controlledByApp;
     mSwapIntervalZero = false;
@@ -191,6 +196,9 @@ void Surface::enableFrameTimestamps(bool enable) {
         FrameEventHistoryDelta delta;
         mGraphicBufferProducer->getFrameTimestamps(&delta);
         mFrameEventHistory->applyDelta(delta);
+        if (mFrameEventRing == nullptr) {
+            mGraphicBufferProducer->getFrameEventRing(&mFrameEventRing);
+        }
     }
     mEnableFrameTimestamps = enable;
 }
@@ -250,6 +258,52 @@ static bool checkConsumerForUpdates(
             checkForDisplayPresent || checkForDequeueReady || checkForRelease;
 }
 
+// Reads the consumer-side timestamps of frameNumber from the consumer's shared ring. Returns
+// false, leaving the outputs untouched, unless every requested timestamp is known there; pending
+// fences may have signaled since the consumer last published them, so only the consumer can
+// tell for sure.
+static bool getConsumerTimestampsFromRing(
+        const sp<FrameEventRing>& ring, uint64_t frameNumber,
+        const uint64_t lastFrameNumber, nsecs_t* outLatchTime,
+        nsecs_t* outFirstRefreshStartTime, nsecs_t* outLastRefreshStartTime,
+        nsecs_t* outGpuCompositionDoneTime, nsecs_t* outDisplayPresentTime,
+        nsecs_t* outDequeueReadyTime, nsecs_t* outReleaseTime) {
+    FrameEventRing::Snapshot snapshot;
+    if (ring == nullptr || !ring->read(frameNumber, &snapshot)) {
+        return false;
+    }
+
+    // LastRefreshStart, DequeueReady, and Release are never available for the
+    // last frame, so the consumer has nothing more to say about them.
+    const bool isLastFrame = frameNumber == lastFrameNumber;
+    auto isKnown = [](const nsecs_t* dst, nsecs_t time, bool pendingIsFinal) {
+        return dst == nullptr || time != NATIVE_WINDOW_TIMESTAMP_PENDING || pendingIsFinal;
+    };
+    if (!isKnown(outLatchTime, snapshot.latchTime, false) ||
+            !isKnown(outFirstRefreshStartTime, snapshot.firstRefreshStartTime, false) ||
+            !isKnown(outLastRefreshStartTime, snapshot.lastRefreshStartTime, isLastFrame) ||
+            !isKnown(outGpuCompositionDoneTime, snapshot.gpuCompositionDoneTime, false) ||
+            !isKnown(outDisplayPresentTime, snapshot.displayPresentTime, false) ||
+            !isKnown(outDequeueReadyTime, snapshot.dequeueReadyTime, isLastFrame) ||
+            !isKnown(outReleaseTime, snapshot.releaseTime, isLastFrame)) {
+        return false;
+    }
+
+    auto set = [](nsecs_t* dst, nsecs_t time) {
+        if (dst != nullptr) {
+            *dst = time;
+        }
+    };
+    set(outLatchTime, snapshot.latchTime);
+    set(outFirstRefreshStartTime, snapshot.firstRefreshStartTime);
+    set(outLastRefreshStartTime, snapshot.lastRefreshStartTime);
+    set(outGpuCompositionDoneTime, snapshot.gpuCompositionDoneTime);
+    set(outDisplayPresentTime, snapshot.displayPresentTime);
+    set(outDequeueReadyTime, snapshot.dequeueReadyTime);
+    set(outReleaseTime, snapshot.releaseTime);
+    return true;
+}
+
 static void getFrameTimestamp(nsecs_t *dst, const nsecs_t& src) {
     if (dst != nullptr) {
         // We always get valid timestamps for these eventually.
@@ -307,6 +361,19 @@ status_t Surface::getFrameTimestamps(uint64_t frameNumber,
             outLatchTime, outFirstRefreshStartTime, outLastRefreshStartTime,
             outGpuCompositionDoneTime, outDisplayPresentTime,
             outDequeueReadyTime, outReleaseTime)) {
+        // The consumer's shared ring saves the round trip when it already
+        // has everything that was asked for.
+        if (getConsumerTimestampsFromRing(mFrameEventRing, frameNumber,
+                mLastFrameNumber, outLatchTime, outFirstRefreshStartTime,
+                outLastRefreshStartTime, outGpuCompositionDoneTime,
+                outDisplayPresentTime, outDequeueReadyTime, outReleaseTime)) {
+            getFrameTimestamp(outRequestedPresentTime,
+                    events->requestedPresentTime);
+            getFrameTimestampFence(outAcquireTime, events->acquireFence,
+                    events->hasAcquireInfo());
+            return NO_ERROR;
+        }
+
         FrameEventHistoryDelta delta;
         mGraphicBufferProducer->getFrameTimestamps(&delta);
         mFrameEventHistory->applyDelta(delta);
@@ -534,6 +601,10 @@ int Surface::setSwapInterval(int interval) {
     mSwapIntervalZero = (interval == 0);
 
     if (mSwapIntervalZero != wasSwapIntervalZero) {
+        {
+            Mutex::Autolock lock(mMutex);
+            cancelPrefetchedBuffersLocked();
+        }
         mGraphicBufferProducer->setAsyncMode(mSwapIntervalZero);
     }
 
@@ -625,6 +696,11 @@ int Surface::dequeueBuffer(android_native_buffer_t** buffer, int* fenceFd) {
     PixelFormat reqFormat;
     uint64_t reqUsage;
     bool enableFrameTimestamps;
+    size_t prefetchCount;
+
+    int buf = -1;
+    sp<Fence> fence;
+    bool prefetched = false;
 
     {
         Mutex::Autolock lock(mMutex);
@@ -649,17 +725,43 @@ int Surface::dequeueBuffer(android_native_buffer_t** buffer, int* fenceFd) {
                 return OK;
             }
         }
+
+        prefetchCount = mSharedBufferMode ? 0 : mDequeuePrefetchCount;
+        if (prefetchCount > 0) {
+            prefetched = takePrefetchedBufferLocked({reqWidth, reqHeight, reqFormat, reqUsage},
+                                                    &buf, &fence);
+        }
     } // Drop the lock so that we can still touch the Surface while blocking in IGBP::dequeueBuffer
 
-    int buf = -1;
-    sp<Fence> fence;
     nsecs_t startTime = systemTime();
 
     FrameEventHistoryDelta frameTimestamps;
-    status_t result = mGraphicBufferProducer->dequeueBuffer(&buf, &fence, reqWidth, reqHeight,
-                                                            reqFormat, reqUsage, &mBufferAge,
-                                                            enableFrameTimestamps ? &frameTimestamps
-                                                                                  : nullptr);
+    // The reallocated buffer of the slot, when dequeueBuffers returned it along with the slot.
+    sp<GraphicBuffer> reallocatedBuffer;
+    status_t result = NO_ERROR;
+    if (prefetched) {
+        ALOGV("dequeueBuffer: using prefetched slot %d", buf);
+    } else if (prefetchCount > 0) {
+        IGraphicBufferProducer::DequeueBufferOutput output;
+        result = dequeueBufferWithPrefetch({reqWidth, reqHeight, reqFormat, reqUsage,
+                                            enableFrameTimestamps},
+                                           prefetchCount, &output);
+        if (result == NO_ERROR) {
+            result = output.result;
+            buf = output.slot;
+            fence = output.fence;
+            mBufferAge = output.bufferAge;
+            reallocatedBuffer = std::move(output.buffer);
+            if (output.timestamps) {
+                frameTimestamps = std::move(*output.timestamps);
+            }
+        }
+    } else {
+        result = mGraphicBufferProducer->dequeueBuffer(&buf, &fence, reqWidth, reqHeight, reqFormat,
+                                                       reqUsage, &mBufferAge,
+                                                       enableFrameTimestamps ? &frameTimestamps
+                                                                             : nullptr);
+    }
     mLastDequeueDuration = systemTime() - startTime;
 
     if (result < 0) {
@@ -694,7 +796,7 @@ int Surface::dequeueBuffer(android_native_buffer_t** buffer, int* fenceFd) {
         freeAllBuffers();
     }
 
-    if (enableFrameTimestamps) {
+    if (enableFrameTimestamps && !prefetched) {
          mFrameEventHistory->applyDelta(frameTimestamps);
     }
 
@@ -702,11 +804,15 @@ int Surface::dequeueBuffer(android_native_buffer_t** buffer, int* fenceFd) {
         if (mReportRemovedBuffers && (gbuf != nullptr)) {
             mRemovedBuffers.push_back(gbuf);
         }
-        result = mGraphicBufferProducer->requestBuffer(buf, &gbuf);
-        if (result != NO_ERROR) {
-            ALOGE("dequeueBuffer: IGraphicBufferProducer::requestBuffer failed: %d", result);
-            mGraphicBufferProducer->cancelBuffer(buf, fence);
-            return result;
+        if (reallocatedBuffer != nullptr) {
+            gbuf = std::move(reallocatedBuffer);
+        } else {
+            result = mGraphicBufferProducer->requestBuffer(buf, &gbuf);
+            if (result != NO_ERROR) {
+                ALOGE("dequeueBuffer: IGraphicBufferProducer::requestBuffer failed: %d", result);
+                mGraphicBufferProducer->cancelBuffer(buf, fence);
+                return result;
+            }
         }
     }
 
@@ -737,6 +843,104 @@ int Surface::dequeueBuffer(android_native_buffer_t** buffer, int* fenceFd) {
     return OK;
 }
 
+status_t Surface::dequeueBufferWithPrefetch(const IGraphicBufferProducer::DequeueBufferInput& input,
+                                            size_t prefetchCount,
+                                            IGraphicBufferProducer::DequeueBufferOutput* output) {
+    std::vector<IGraphicBufferProducer::DequeueBufferInput> inputs(1 + prefetchCount, input);
+    for (size_t i = 1; i < inputs.size(); i++) {
+        inputs[i].getTimestamps = false;
+    }
+
+    std::vector<IGraphicBufferProducer::DequeueBufferOutput> outputs;
+    status_t result = mGraphicBufferProducer->dequeueBuffers(inputs, &outputs);
+    if (result == UNKNOWN_TRANSACTION) {
+        // The producer predates dequeueBuffers; stop trying.
+        ALOGW("dequeueBuffer: producer does not support prefetching, disabling it");
+        {
+            Mutex::Autolock lock(mMutex);
+            mDequeuePrefetchCount = 0;
+        }
+        output->result =
+                mGraphicBufferProducer->dequeueBuffer(&output->slot, &output->fence, input.width,
+                                                      input.height, input.format, input.usage,
+                                                      &output->bufferAge,
+                                                      input.getTimestamps
+                                                              ? &output->timestamps.emplace()
+                                                              : nullptr);
+        return NO_ERROR;
+    }
+    if (result != NO_ERROR || outputs.empty()) {
+        ALOGE("dequeueBuffer: IGraphicBufferProducer::dequeueBuffers failed: %d", result);
+        return result != NO_ERROR ? result : UNKNOWN_ERROR;
+    }
+
+    Mutex::Autolock lock(mMutex);
+
+    // Outputs are handled in the order they were dequeued in, so that buffers
+    // attached to later slots survive a RELEASE_ALL_BUFFERS on earlier ones.
+    IGraphicBufferProducer::DequeueBufferOutput& first = outputs.front();
+    if (first.result >= 0 && (first.result & IGraphicBufferProducer::RELEASE_ALL_BUFFERS)) {
+        freeAllBuffers();
+        first.result &= ~IGraphicBufferProducer::RELEASE_ALL_BUFFERS;
+    }
+
+    for (size_t i = 1; i < outputs.size(); i++) {
+        IGraphicBufferProducer::DequeueBufferOutput& extra = outputs[i];
+        if (extra.result < 0 || extra.slot < 0 || extra.slot >= NUM_BUFFER_SLOTS) {
+            ALOGE("dequeueBuffer: dequeueBuffers returned invalid prefetched slot %d (%d)",
+                  extra.slot, extra.result);
+            continue;
+        }
+
+        if (extra.result & IGraphicBufferProducer::RELEASE_ALL_BUFFERS) {
+            freeAllBuffers();
+        }
+        if (extra.buffer != nullptr) {
+            sp<GraphicBuffer>& gbuf(mSlots[extra.slot].buffer);
+            if (mReportRemovedBuffers && gbuf != nullptr) {
+                mRemovedBuffers.push_back(gbuf);
+            }
+            gbuf = std::move(extra.buffer);
+        }
+        mPrefetchedBuffers.push_back(
+                {input, extra.slot, extra.fence, extra.bufferAge, mNextFrameNumber});
+    }
+
+    *output = std::move(first);
+    return NO_ERROR;
+}
+
+bool Surface::takePrefetchedBufferLocked(const IGraphicBufferProducer::DequeueBufferInput& input,
+                                         int* outSlot, sp<Fence>* outFence) {
+    if (mPrefetchedBuffers.empty()) {
+        return false;
+    }
+
+    const PrefetchedBuffer& prefetched = mPrefetchedBuffers.front();
+    if (prefetched.input.width != input.width || prefetched.input.height != input.height ||
+        prefetched.input.format != input.format || prefetched.input.usage != input.usage) {
+        cancelPrefetchedBuffersLocked();
+        return false;
+    }
+
+    *outSlot = prefetched.slot;
+    *outFence = prefetched.fence;
+    // The producer computed the age when the buffer was dequeued; account for
+    // the frames queued since.
+    mBufferAge = prefetched.bufferAge == 0
+            ? 0
+            : prefetched.bufferAge + (mNextFrameNumber - prefetched.frameNumber);
+    mPrefetchedBuffers.pop_front();
+    return true;
+}
+
+void Surface::cancelPrefetchedBuffersLocked() {
+    for (const PrefetchedBuffer& prefetched : mPrefetchedBuffers) {
+        mGraphicBufferProducer->cancelBuffer(prefetched.slot, prefetched.fence);
+    }
+    mPrefetchedBuffers.clear();
+}
+
 int Surface::cancelBuffer(android_native_buffer_t* buffer,
         int fenceFd) {
     ATRACE_CALL();
@@ -927,6 +1131,7 @@ int Surface::queueBuffer(android_native_buffer_t* buffer, int fenceFd) {
     }
 
     mConsumerRunningBehind = (output.numPendingBuffers >= 2);
+    updateConsumerPropertiesLocked(output);
 
     if (!mConnectedToCpu) {
         // Clear surface damage back to full-buffer
@@ -970,6 +1175,14 @@ void Surface::querySupportedTimestampsLocked() const {
     }
 }
 
+void Surface::updateConsumerPropertiesLocked(
+        const IGraphicBufferProducer::QueueBufferOutput& output) {
+    mHasConsumerProperties = output.hasConsumerProperties;
+    mConsumerUsageBits = output.consumerUsageBits;
+    mDefaultDataSpace = output.defaultDataSpace;
+    mConsumerIsProtected = output.consumerIsProtected;
+}
+
 int Surface::query(int what, int* value) const {
     ATRACE_CALL();
     ALOGV("Surface::query");
@@ -1017,6 +1230,25 @@ int Surface::query(int what, int* value) const {
                 }
                 return err;
             }
+            case NATIVE_WINDOW_CONSUMER_USAGE_BITS:
+                if (mHasConsumerProperties) {
+                    // deprecated; higher 32 bits are truncated
+                    *value = static_cast<int32_t>(mConsumerUsageBits);
+                    return NO_ERROR;
+                }
+                break;
+            case NATIVE_WINDOW_DEFAULT_DATASPACE:
+                if (mHasConsumerProperties) {
+                    *value = mDefaultDataSpace;
+                    return NO_ERROR;
+                }
+                break;
+            case NATIVE_WINDOW_CONSUMER_IS_PROTECTED:
+                if (mHasConsumerProperties) {
+                    *value = mConsumerIsProtected ? 1 : 0;
+                    return NO_ERROR;
+                }
+                break;
             case NATIVE_WINDOW_BUFFER_AGE: {
                 if (mBufferAge > INT32_MAX) {
                     *value = 0;
@@ -1557,6 +1789,7 @@ int Surface::connect(
         }
 
         mConsumerRunningBehind = (output.numPendingBuffers >= 2);
+        updateConsumerPropertiesLocked(output);
     }
     if (!err && api == NATIVE_WINDOW_API_CPU) {
         mConnectedToCpu = true;
@@ -1578,6 +1811,7 @@ int Surface::disconnect(int api, IGraphicBufferProducer::DisconnectMode mode) {
     mRemovedBuffers.clear();
     mSharedBufferSlot = BufferItem::INVALID_BUFFER_SLOT;
     mSharedBufferHasBeenQueued = false;
+    cancelPrefetchedBuffersLocked();
     freeAllBuffers();
     int err = mGraphicBufferProducer->disconnect(api, mode);
     if (!err) {
@@ -1592,6 +1826,7 @@ int Surface::disconnect(int api, IGraphicBufferProducer::DisconnectMode mode) {
         mAutoPrerotation = false;
         mEnableFrameTimestamps = false;
         mMaxBufferCount = NUM_BUFFER_SLOTS;
+        mHasConsumerProperties = false;
 
         if (api == NATIVE_WINDOW_API_CPU) {
             mConnectedToCpu = false;
@@ -1706,6 +1941,7 @@ int Surface::setBufferCount(int bufferCount)
     ATRACE_CALL();
     ALOGV("Surface::setBufferCount");
     Mutex::Autolock lock(mMutex);
+    cancelPrefetchedBuffersLocked();
 
     status_t err = NO_ERROR;
     if (bufferCount == 0) {
@@ -1730,6 +1966,7 @@ int Surface::setMaxDequeuedBufferCount(int maxDequeuedBuffers) {
     ATRACE_CALL();
     ALOGV("Surface::setMaxDequeuedBufferCount");
     Mutex::Autolock lock(mMutex);
+    cancelPrefetchedBuffersLocked();
 
     status_t err = mGraphicBufferProducer->setMaxDequeuedBufferCount(
             maxDequeuedBuffers);
@@ -1743,6 +1980,7 @@ int Surface::setAsyncMode(bool async) {
     ATRACE_CALL();
     ALOGV("Surface::setAsyncMode");
     Mutex::Autolock lock(mMutex);
+    cancelPrefetchedBuffersLocked();
 
     status_t err = mGraphicBufferProducer->setAsyncMode(async);
     ALOGE_IF(err, "IGraphicBufferProducer::setAsyncMode(%d) returned %s",
@@ -1755,6 +1993,7 @@ int Surface::setSharedBufferMode(bool sharedBufferMode) {
     ATRACE_CALL();
     ALOGV("Surface::setSharedBufferMode (%d)", sharedBufferMode);
     Mutex::Autolock lock(mMutex);
+    cancelPrefetchedBuffersLocked();
 
     status_t err = mGraphicBufferProducer->setSharedBufferMode(
             sharedBufferMode);
@@ -2184,6 +2423,10 @@ status_t Surface::getUniqueId(uint64_t* outId) const {
 
 int Surface::getConsumerUsage(uint64_t* outUsage) const {
     Mutex::Autolock lock(mMutex);
+    if (mHasConsumerProperties && outUsage != nullptr) {
+        *outUsage = mConsumerUsageBits;
+        return NO_ERROR;
+    }
     return mGraphicBufferProducer->getConsumerUsage(outUsage);
 }
 
@@ -2248,6 +2491,22 @@ int Surface::setAutoPrerotation(bool autoPrerotation) {
     return err;
 }
 
+int Surface::setDequeuePrefetchCount(size_t count) {
+    ATRACE_CALL();
+    ALOGV("Surface::setDequeuePrefetchCount (%zu)", count);
+    Mutex::Autolock lock(mMutex);
+
+    if (count >= NUM_BUFFER_SLOTS) {
+        return BAD_VALUE;
+    }
+
+    if (count < mDequeuePrefetchCount) {
+        cancelPrefetchedBuffersLocked();
+    }
+    mDequeuePrefetchCount = count;
+    return NO_ERROR;
+}
+
 void Surface::ProducerListenerProxy::onBuffersDiscarded(const std::vector<int32_t>& slots) {
     ATRACE_CALL();
     sp<Surface> parent = mParent.promote();
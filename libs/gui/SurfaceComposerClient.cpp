@@ -50,6 +50,9 @@
 // This server size should always be smaller than the server cache size
 #define BUFFER_CACHE_MAX_SIZE 64
 
+// Transactions with more layers than this look their states up by hash rather than linearly
+#define MAX_LINEAR_SEARCH_COMPOSER_STATES 16
+
 namespace android {
 
 using ui::ColorMode;
@@ -304,6 +307,15 @@ public:
         uncacheLocked(cacheId);
     }
 
+    // Uncaches the buffer unless it was uncached already, as SurfaceFlinger may ask for buffers
+    // to be evicted while they are being uncached.
+    void evict(uint64_t cacheId) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (mBuffers.count(cacheId) != 0) {
+            uncacheLocked(cacheId);
+        }
+    }
+
     void uncacheLocked(uint64_t cacheId) REQUIRES(mMutex) {
         mBuffers.erase(cacheId);
         SurfaceComposerClient::doUncacheBufferTransaction(cacheId);
@@ -346,6 +358,10 @@ void removeDeadBufferCallback(void* /*context*/, uint64_t graphicBufferId) {
     BufferCache::getInstance().uncache(graphicBufferId);
 }
 
+void TransactionCompletedListener::onCachedBufferEvicted(uint64_t cacheId) {
+    BufferCache::getInstance().evict(cacheId);
+}
+
 // ---------------------------------------------------------------------------
 
 SurfaceComposerClient::Transaction::Transaction(const Transaction& other)
@@ -359,6 +375,7 @@ SurfaceComposerClient::Transaction::Transaction(const Transaction& other)
         mDesiredPresentTime(other.mDesiredPresentTime) {
     mDisplayStates = other.mDisplayStates;
     mComposerStates = other.mComposerStates;
+    mComposerStateIndices = other.mComposerStateIndices;
     mInputWindowCommands = other.mInputWindowCommands;
     mListenerCallbacks = other.mListenerCallbacks;
 }
@@ -427,8 +444,8 @@ status_t SurfaceComposerClient::Transaction::readFromParcel(const Parcel* parcel
     if (count > parcel->dataSize()) {
         return BAD_VALUE;
     }
-    std::unordered_map<sp<IBinder>, ComposerState, IBinderHash> composerStates;
-    composerStates.reserve(count);
+    Vector<ComposerState> composerStates;
+    composerStates.setCapacity(count);
     for (size_t i = 0; i < count; i++) {
         sp<IBinder> surfaceControlHandle = parcel->readStrongBinder();
 
@@ -436,7 +453,8 @@ status_t SurfaceComposerClient::Transaction::readFromParcel(const Parcel* parcel
         if (composerState.read(*parcel) == BAD_VALUE) {
             return BAD_VALUE;
         }
-        composerStates[surfaceControlHandle] = composerState;
+        composerState.state.surface = surfaceControlHandle;
+        composerStates.add(composerState);
     }
 
     InputWindowCommands inputWindowCommands;
@@ -453,7 +471,10 @@ status_t SurfaceComposerClient::Transaction::readFromParcel(const Parcel* parcel
     mDesiredPresentTime = desiredPresentTime;
     mDisplayStates = displayStates;
     mListenerCallbacks = listenerCallbacks;
-    mComposerStates = composerStates;
+    clearComposerStates();
+    for (const auto& composerState : composerStates) {
+        addComposerState(composerState);
+    }
     mInputWindowCommands = inputWindowCommands;
     return NO_ERROR;
 }
@@ -499,8 +520,8 @@ status_t SurfaceComposerClient::Transaction::writeToParcel(Parcel* parcel) const
     }
 
     parcel->writeUint32(static_cast<uint32_t>(mComposerStates.size()));
-    for (auto const& [surfaceHandle, composerState] : mComposerStates) {
-        parcel->writeStrongBinder(surfaceHandle);
+    for (auto const& composerState : mComposerStates) {
+        parcel->writeStrongBinder(composerState.state.surface);
         composerState.write(*parcel);
     }
 
@@ -509,11 +530,19 @@ status_t SurfaceComposerClient::Transaction::writeToParcel(Parcel* parcel) const
 }
 
 SurfaceComposerClient::Transaction& SurfaceComposerClient::Transaction::merge(Transaction&& other) {
-    for (auto const& [surfaceHandle, composerState] : other.mComposerStates) {
-        if (mComposerStates.count(surfaceHandle) == 0) {
-            mComposerStates[surfaceHandle] = composerState;
-        } else {
-            mComposerStates[surfaceHandle].state.merge(composerState.state);
+    if (mComposerStates.isEmpty()) {
+        // Take over the states of other, which is cleared below anyway.
+        mComposerStates = other.mComposerStates;
+        mComposerStateIndices = std::move(other.mComposerStateIndices);
+    } else {
+        for (auto const& composerState : other.mComposerStates) {
+            const ssize_t index = indexOfComposerState(composerState.state.surface);
+            if (index < 0) {
+                addComposerState(composerState);
+            } else {
+                mComposerStates.editItemAt(static_cast<size_t>(index))
+                        .state.merge(composerState.state);
+            }
         }
     }
 
@@ -526,26 +555,28 @@ SurfaceComposerClient::Transaction& SurfaceComposerClient::Transaction::merge(Tr
         }
     }
 
-    for (const auto& [listener, callbackInfo] : other.mListenerCallbacks) {
-        auto& [callbackIds, surfaceControls] = callbackInfo;
-        mListenerCallbacks[listener].callbackIds.insert(std::make_move_iterator(
-                                                                callbackIds.begin()),
-                                                        std::make_move_iterator(callbackIds.end()));
-
-        mListenerCallbacks[listener].surfaceControls.insert(surfaceControls.begin(),
-                                                            surfaceControls.end());
-
-        auto& currentProcessCallbackInfo =
-                mListenerCallbacks[TransactionCompletedListener::getIInstance()];
-        currentProcessCallbackInfo.surfaceControls
-                .insert(std::make_move_iterator(surfaceControls.begin()),
-                        std::make_move_iterator(surfaceControls.end()));
-
-        // register all surface controls for all callbackIds for this listener that is merging
-        for (const auto& surfaceControl : currentProcessCallbackInfo.surfaceControls) {
-            TransactionCompletedListener::getInstance()
-                    ->addSurfaceControlToCallbacks(surfaceControl,
-                                                   currentProcessCallbackInfo.callbackIds);
+    if (!other.mListenerCallbacks.empty()) {
+        // Look the listener of this process up once, rather than for each merged listener.
+        const sp<TransactionCompletedListener> completedListener =
+                TransactionCompletedListener::getInstance();
+        const sp<ITransactionCompletedListener> currentProcessListener = completedListener;
+        for (const auto& [listener, callbackInfo] : other.mListenerCallbacks) {
+            auto& [callbackIds, surfaceControls] = callbackInfo;
+            auto& listenerCallbackInfo = mListenerCallbacks[listener];
+            listenerCallbackInfo.callbackIds.insert(callbackIds.begin(), callbackIds.end());
+            listenerCallbackInfo.surfaceControls.insert(surfaceControls.begin(),
+                                                        surfaceControls.end());
+
+            auto& currentProcessCallbackInfo = mListenerCallbacks[currentProcessListener];
+            currentProcessCallbackInfo.surfaceControls.insert(surfaceControls.begin(),
+                                                              surfaceControls.end());
+
+            // register all surface controls for all callbackIds for this listener that is merging
+            for (const auto& surfaceControl : currentProcessCallbackInfo.surfaceControls) {
+                completedListener->addSurfaceControlToCallbacks(surfaceControl,
+                                                                currentProcessCallbackInfo
+                                                                        .callbackIds);
+            }
         }
     }
 
@@ -560,7 +591,7 @@ SurfaceComposerClient::Transaction& SurfaceComposerClient::Transaction::merge(Tr
 }
 
 void SurfaceComposerClient::Transaction::clear() {
-    mComposerStates.clear();
+    clearComposerStates();
     mDisplayStates.clear();
     mListenerCallbacks.clear();
     mInputWindowCommands.clear();
@@ -591,8 +622,8 @@ void SurfaceComposerClient::Transaction::cacheBuffers() {
     }
 
     size_t count = 0;
-    for (auto& [handle, cs] : mComposerStates) {
-        layer_state_t* s = getLayerState(handle);
+    for (size_t i = 0; i < mComposerStates.size(); i++) {
+        layer_state_t* s = &mComposerStates.editItemAt(i).state;
         if (!(s->what & layer_state_t::eBufferChanged)) {
             continue;
         } else if (s->what & layer_state_t::eCachedBufferChanged) {
@@ -669,21 +700,10 @@ status_t SurfaceComposerClient::Transaction::apply(bool synchronous) {
 
     cacheBuffers();
 
-    Vector<ComposerState> composerStates;
-    Vector<DisplayState> displayStates;
     uint32_t flags = 0;
 
     mForceSynchronous |= synchronous;
 
-    for (auto const& kv : mComposerStates){
-        composerStates.add(kv.second);
-    }
-
-    mComposerStates.clear();
-
-    displayStates = mDisplayStates;
-    mDisplayStates.clear();
-
     if (mForceSynchronous) {
         flags |= ISurfaceComposer::eSynchronous;
     }
@@ -710,10 +730,14 @@ status_t SurfaceComposerClient::Transaction::apply(bool synchronous) {
     mExplicitEarlyWakeupEnd = false;
 
     sp<IBinder> applyToken = IInterface::asBinder(TransactionCompletedListener::getIInstance());
-    sf->setTransactionState(composerStates, displayStates, flags, applyToken, mInputWindowCommands,
-                            mDesiredPresentTime,
+    // Both Vectors share their storage with the transaction, rather than copying the states.
+    const Vector<DisplayState> displayStates(mDisplayStates);
+    sf->setTransactionState(mComposerStates, displayStates, flags, applyToken,
+                            mInputWindowCommands, mDesiredPresentTime,
                             {} /*uncacheBuffer - only set in doUncacheBufferTransaction*/,
                             hasListenerCallbacks, listenerCallbacks);
+    clearComposerStates();
+    mDisplayStates.clear();
     mInputWindowCommands.clear();
     mStatus = NO_ERROR;
     return NO_ERROR;
@@ -762,24 +786,61 @@ void SurfaceComposerClient::Transaction::setExplicitEarlyWakeupEnd() {
     mExplicitEarlyWakeupEnd = true;
 }
 
+ssize_t SurfaceComposerClient::Transaction::indexOfComposerState(
+        const sp<IBinder>& handle) const {
+    if (mComposerStates.size() > MAX_LINEAR_SEARCH_COMPOSER_STATES) {
+        const auto it = mComposerStateIndices.find(handle.get());
+        return it != mComposerStateIndices.end() ? static_cast<ssize_t>(it->second) : -1;
+    }
+    for (size_t i = 0; i < mComposerStates.size(); i++) {
+        if (mComposerStates[i].state.surface == handle) {
+            return static_cast<ssize_t>(i);
+        }
+    }
+    return -1;
+}
+
+void SurfaceComposerClient::Transaction::addComposerState(const ComposerState& state) {
+    const size_t index = static_cast<size_t>(mComposerStates.add(state));
+    if (mComposerStates.size() <= MAX_LINEAR_SEARCH_COMPOSER_STATES) {
+        return;
+    }
+    if (mComposerStateIndices.empty()) {
+        for (size_t i = 0; i < mComposerStates.size(); i++) {
+            mComposerStateIndices.emplace(mComposerStates[i].state.surface.get(), i);
+        }
+    } else {
+        mComposerStateIndices.emplace(state.state.surface.get(), index);
+    }
+}
+
+void SurfaceComposerClient::Transaction::clearComposerStates() {
+    mComposerStates.clear();
+    mComposerStateIndices.clear();
+}
+
 layer_state_t* SurfaceComposerClient::Transaction::getLayerState(const sp<IBinder>& handle) {
-    if (mComposerStates.count(handle) == 0) {
+    ssize_t index = indexOfComposerState(handle);
+    if (index < 0) {
         // we don't have it, add an initialized layer_state to our list
         ComposerState s;
         s.state.surface = handle;
-        mComposerStates[handle] = s;
+        addComposerState(s);
+        index = static_cast<ssize_t>(mComposerStates.size() - 1);
     }
 
-    return &(mComposerStates[handle].state);
+    return &mComposerStates.editItemAt(static_cast<size_t>(index)).state;
 }
 
 void SurfaceComposerClient::Transaction::registerSurfaceControlForCallback(
         const sp<SurfaceControl>& sc) {
     auto& callbackInfo = mListenerCallbacks[TransactionCompletedListener::getIInstance()];
-    callbackInfo.surfaceControls.insert(sc);
-
-    TransactionCompletedListener::getInstance()
-            ->addSurfaceControlToCallbacks(sc, callbackInfo.callbackIds);
+    // Callbacks added later are registered for the surface controls already in the set, so the
+    // surface control only needs to be registered the first time it is set on.
+    if (callbackInfo.surfaceControls.insert(sc).second && !callbackInfo.callbackIds.empty()) {
+        TransactionCompletedListener::getInstance()
+                ->addSurfaceControlToCallbacks(sc, callbackInfo.callbackIds);
+    }
 }
 
 SurfaceComposerClient::Transaction& SurfaceComposerClient::Transaction::setPosition(
@@ -1543,6 +1604,13 @@ void SurfaceComposerClient::Transaction::setDisplaySize(const sp<IBinder>& token
     s.what |= DisplayState::eDisplaySizeChanged;
 }
 
+void SurfaceComposerClient::Transaction::setDisplayMaxFrameRate(const sp<IBinder>& token,
+                                                                float frameRate) {
+    DisplayState& s(getDisplayState(token));
+    s.maxFrameRate = frameRate;
+    s.what |= DisplayState::eFrameRateChanged;
+}
+
 // ---------------------------------------------------------------------------
 
 SurfaceComposerClient::SurfaceComposerClient()
@@ -1695,6 +1763,15 @@ status_t SurfaceComposerClient::getLayerFrameStats(const sp<IBinder>& token,
     return mClient->getLayerFrameStats(token, outStats);
 }
 
+status_t SurfaceComposerClient::getLayerFrameStatsSince(const sp<IBinder>& token,
+                                                        uint64_t frameNumber, FrameStats* outStats,
+                                                        uint64_t* outNextFrameNumber) const {
+    if (mStatus != NO_ERROR) {
+        return mStatus;
+    }
+    return mClient->getLayerFrameStatsSince(token, frameNumber, outStats, outNextFrameNumber);
+}
+
 // ----------------------------------------------------------------------------
 
 status_t SurfaceComposerClient::enableVSyncInjections(bool enable) {
@@ -1939,6 +2016,19 @@ status_t ScreenshotClient::capture(uint64_t displayOrLayerStack, ui::Dataspace*
     return s->captureScreen(displayOrLayerStack, outDataspace, outBuffer);
 }
 
+status_t ScreenshotClient::captureIntoBuffer(const sp<IBinder>& display,
+                                             const sp<GraphicBuffer>& buffer,
+                                             ui::Dataspace reqDataSpace, const Rect& sourceCrop,
+                                             bool useIdentityTransform, ui::Rotation rotation,
+                                             bool captureSecureLayers,
+                                             bool& outCapturedSecureLayers, sp<Fence>* outFence) {
+    sp<ISurfaceComposer> s(ComposerService::getComposerService());
+    if (s == nullptr) return NO_INIT;
+    return s->captureScreenIntoBuffer(display, buffer, reqDataSpace, sourceCrop,
+                                      useIdentityTransform, rotation, captureSecureLayers,
+                                      outCapturedSecureLayers, outFence);
+}
+
 status_t ScreenshotClient::captureLayers(const sp<IBinder>& layerHandle, ui::Dataspace reqDataSpace,
                                          ui::PixelFormat reqPixelFormat, const Rect& sourceCrop,
                                          float frameScale, sp<GraphicBuffer>* outBuffer) {
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <binder/Binder.h>
+#include <binder/Parcel.h>
+#include <gui/SurfaceComposerClient.h>
+#include <gui/SurfaceControl.h>
+
+#include <vector>
+
+namespace android {
+
+using Transaction = SurfaceComposerClient::Transaction;
+
+// Surface controls backed by local handles, so that transactions can be built
+// without a connection to SurfaceFlinger. Transactions are never applied.
+static std::vector<sp<SurfaceControl>> makeSurfaceControls(size_t count) {
+    std::vector<sp<SurfaceControl>> surfaceControls;
+    for (size_t i = 0; i < count; i++) {
+        surfaceControls.push_back(new SurfaceControl(nullptr, new BBinder(), nullptr));
+    }
+    return surfaceControls;
+}
+
+// Mimics the transaction of an animation frame: a few properties of each
+// animated layer, set on a transaction which is reused for every frame.
+static void setAnimationFrame(Transaction& t, const std::vector<sp<SurfaceControl>>& layers) {
+    float offset = 0.0f;
+    for (const auto& layer : layers) {
+        t.setPosition(layer, offset, offset);
+        t.setAlpha(layer, 0.5f);
+        t.setMatrix(layer, 1.0f, 0.0f, 0.0f, 1.0f);
+        offset += 1.0f;
+    }
+}
+
+static void BM_buildTransaction(benchmark::State& state) {
+    const auto layers = makeSurfaceControls(static_cast<size_t>(state.range(0)));
+    Transaction t;
+    for (auto _ : state) {
+        setAnimationFrame(t, layers);
+        benchmark::DoNotOptimize(t);
+        t.clear();
+    }
+}
+BENCHMARK(BM_buildTransaction)->Arg(1)->Arg(4)->Arg(16)->Arg(64);
+
+static void BM_mergeTransactions(benchmark::State& state) {
+    const auto layers = makeSurfaceControls(static_cast<size_t>(state.range(0)));
+    Transaction t;
+    Transaction other;
+    for (auto _ : state) {
+        setAnimationFrame(t, layers);
+        setAnimationFrame(other, layers);
+        t.merge(std::move(other));
+        benchmark::DoNotOptimize(t);
+        t.clear();
+    }
+}
+BENCHMARK(BM_mergeTransactions)->Arg(1)->Arg(4)->Arg(16)->Arg(64);
+
+static void BM_parcelTransaction(benchmark::State& state) {
+    const auto layers = makeSurfaceControls(static_cast<size_t>(state.range(0)));
+    Transaction t;
+    setAnimationFrame(t, layers);
+    for (auto _ : state) {
+        Parcel parcel;
+        t.writeToParcel(&parcel);
+        parcel.setDataPosition(0);
+        Transaction result;
+        result.readFromParcel(&parcel);
+        benchmark::DoNotOptimize(result);
+    }
+}
+BENCHMARK(BM_parcelTransaction)->Arg(1)->Arg(4)->Arg(16)->Arg(64);
+
+} // namespace android
+
+BENCHMARK_MAIN();
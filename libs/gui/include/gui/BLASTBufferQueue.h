@@ -83,6 +83,11 @@ public:
 
     void update(const sp<SurfaceControl>& surface, int width, int height);
 
+    // When enabled, buffers acquired by any BLASTBufferQueue in this process are merged into a
+    // single transaction that is applied once per vsync, instead of applying one transaction per
+    // buffer. Defaults to the debug.blast.batch_transactions property.
+    static void setTransactionBatchingEnabled(bool enabled);
+
     virtual ~BLASTBufferQueue() = default;
 
 private:
@@ -93,6 +98,8 @@ private:
     BLASTBufferQueue(const BLASTBufferQueue& rhs);
 
     void processNextBufferLocked(bool useNextTransaction) REQUIRES(mMutex);
+    void setBufferLocked(SurfaceComposerClient::Transaction& t, const BufferItem& bufferItem)
+            REQUIRES(mMutex);
     Rect computeCrop(const BufferItem& item);
 
     sp<SurfaceControl> mSurfaceControl;
@@ -125,6 +132,10 @@ private:
     sp<BLASTBufferItemConsumer> mBufferItemConsumer;
 
     SurfaceComposerClient::Transaction* mNextTransaction GUARDED_BY(mMutex);
+
+    // Scratch transaction handed to the process-wide batcher; merging leaves it empty so it is
+    // reused for every buffer.
+    SurfaceComposerClient::Transaction mBatchedTransaction GUARDED_BY(mMutex);
 };
 
 } // namespace android
@@ -76,6 +76,17 @@ class BufferItemConsumer: public ConsumerBase
     status_t acquireBuffer(BufferItem* item, nsecs_t presentWhen,
             bool waitForFence = true);
 
+    // Gets up to maxBuffers pending graphics buffers from the producer in
+    // queue order, appending them to items. All of them are taken from the
+    // BufferQueue in one pass, which is cheaper than calling acquireBuffer
+    // repeatedly when the consumer drains several frames per wakeup. Returns
+    // the same errors as acquireBuffer when no buffer could be acquired.
+    //
+    // If waitForFence is true, the fence of every acquired buffer is waited on
+    // with no timeout before returning.
+    status_t acquireBuffers(std::vector<BufferItem>* items, size_t maxBuffers,
+            bool waitForFence = false);
+
     // Returns an acquired buffer to the queue, allowing it to be reused. Since
     // only a fixed number of buffers may be acquired at a time, old buffers
     // must be released by calling releaseBuffer to ensure new buffers can be
@@ -50,6 +50,12 @@ public:
     virtual status_t acquireBuffer(BufferItem* outBuffer,
             nsecs_t expectedPresent, uint64_t maxFrameNumber = 0) override;
 
+    // See IGraphicBufferConsumer::acquireBuffers. All of the buffers are
+    // taken from the queue while holding the core mutex once, so the producer
+    // sees a single state change however many buffers were drained.
+    virtual status_t acquireBuffers(std::vector<BufferItem>* outBuffers,
+            size_t maxBuffers) override;
+
     // See IGraphicBufferConsumer::detachBuffer
     virtual status_t detachBuffer(int slot);
 
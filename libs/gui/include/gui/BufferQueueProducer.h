@@ -198,6 +198,13 @@ public:
     // See IGraphicBufferProducer::setAutoPrerotation
     virtual status_t setAutoPrerotation(bool autoPrerotation);
 
+    // See IGraphicBufferProducer::dequeueBuffers
+    virtual status_t dequeueBuffers(const std::vector<DequeueBufferInput>& inputs,
+                                    std::vector<DequeueBufferOutput>* outputs) override;
+
+    // See IGraphicBufferProducer::getFrameEventRing
+    virtual status_t getFrameEventRing(sp<FrameEventRing>* outRing) override;
+
 private:
     // This is required by the IBinder::DeathRecipient interface
     virtual void binderDied(const wp<IBinder>& who);
@@ -210,9 +217,17 @@ private:
     // BufferQueueCore::INVALID_BUFFER_SLOT otherwise
     int getFreeSlotLocked() const;
 
+    // Returns whether dequeueBuffer would return an already allocated free
+    // buffer right away, without waiting or exceeding the max dequeued buffer
+    // count.
+    bool canDequeueWithoutWaiting() const;
+
     void addAndGetFrameTimestamps(const NewFrameEventsEntry* newTimestamps,
             FrameEventHistoryDelta* outDelta);
 
+    // Fills in the consumer properties of a QueueBufferOutput.
+    void getConsumerPropertiesLocked(QueueBufferOutput* output) const;
+
     // waitForFreeSlotThenRelock finds the oldest slot in the FREE state. It may
     // block if there are no available slots and we are not in non-blocking
     // mode (producer and consumer controlled by the application). If it blocks,
@@ -0,0 +1,206 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_GUI_BUFFERSLOTSET_H
+#define ANDROID_GUI_BUFFERSLOTSET_H
+
+#include <ui/BufferQueueDefs.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+
+namespace android {
+
+// BufferSlotSet is an ordered set of buffer slot indices stored as a single
+// bitmask. It never allocates, and iterates in increasing slot order like the
+// std::set<int> it replaces. Iterators hold a copy of the mask, so modifying
+// the set while iterating over it does not invalidate them.
+class BufferSlotSet {
+public:
+    static_assert(BufferQueueDefs::NUM_BUFFER_SLOTS <= 64,
+                  "BufferSlotSet stores slots in a 64-bit mask");
+
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = int;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const int*;
+        using reference = int;
+
+        explicit const_iterator(uint64_t mask) : mMask(mask) {}
+
+        int operator*() const { return __builtin_ctzll(mMask); }
+        const_iterator& operator++() {
+            mMask &= mMask - 1;
+            return *this;
+        }
+        const_iterator operator++(int) {
+            const_iterator copy = *this;
+            ++*this;
+            return copy;
+        }
+        bool operator==(const const_iterator& other) const { return mMask == other.mMask; }
+        bool operator!=(const const_iterator& other) const { return mMask != other.mMask; }
+
+    private:
+        uint64_t mMask;
+    };
+    using iterator = const_iterator;
+
+    const_iterator begin() const { return const_iterator(mMask); }
+    const_iterator end() const { return const_iterator(0); }
+
+    bool empty() const { return mMask == 0; }
+    size_t size() const { return static_cast<size_t>(__builtin_popcountll(mMask)); }
+    size_t count(int slot) const { return (mMask & bit(slot)) != 0 ? 1 : 0; }
+
+    // Returns the lowest slot in the set, which must not be empty.
+    int first() const { return __builtin_ctzll(mMask); }
+
+    void insert(int slot) { mMask |= bit(slot); }
+    void erase(int slot) { mMask &= ~bit(slot); }
+    void clear() { mMask = 0; }
+
+private:
+    static uint64_t bit(int slot) { return uint64_t(1) << slot; }
+
+    uint64_t mMask = 0;
+};
+
+// BufferSlotList is an ordered list of distinct buffer slot indices, linked
+// through fixed per-slot arrays. It never allocates, and unlike std::list
+// both remove() and count() are constant time. Inserting a slot that is
+// already in the list moves it to the new position.
+class BufferSlotList {
+public:
+    static_assert(BufferQueueDefs::NUM_BUFFER_SLOTS <= 64,
+                  "BufferSlotList tracks membership in a 64-bit mask");
+
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = int;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const int*;
+        using reference = int;
+
+        const_iterator(const BufferSlotList* list, int slot) : mList(list), mSlot(slot) {}
+
+        int operator*() const { return mSlot; }
+        const_iterator& operator++() {
+            mSlot = mList->mNext[mSlot];
+            return *this;
+        }
+        const_iterator operator++(int) {
+            const_iterator copy = *this;
+            ++*this;
+            return copy;
+        }
+        bool operator==(const const_iterator& other) const { return mSlot == other.mSlot; }
+        bool operator!=(const const_iterator& other) const { return mSlot != other.mSlot; }
+
+    private:
+        const BufferSlotList* mList;
+        int mSlot;
+    };
+    using iterator = const_iterator;
+
+    const_iterator begin() const { return const_iterator(this, mHead); }
+    const_iterator end() const { return const_iterator(this, NONE); }
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend() const { return end(); }
+
+    bool empty() const { return mMembers == 0; }
+    size_t size() const { return static_cast<size_t>(__builtin_popcountll(mMembers)); }
+    size_t count(int slot) const { return (mMembers & bit(slot)) != 0 ? 1 : 0; }
+
+    // front() and back() must not be called on an empty list.
+    int front() const { return mHead; }
+    int back() const { return mTail; }
+
+    void push_front(int slot) {
+        remove(slot);
+        mPrev[slot] = NONE;
+        mNext[slot] = mHead;
+        if (mHead != NONE) {
+            mPrev[mHead] = static_cast<int8_t>(slot);
+        } else {
+            mTail = static_cast<int8_t>(slot);
+        }
+        mHead = static_cast<int8_t>(slot);
+        mMembers |= bit(slot);
+    }
+
+    void push_back(int slot) {
+        remove(slot);
+        mPrev[slot] = mTail;
+        mNext[slot] = NONE;
+        if (mTail != NONE) {
+            mNext[mTail] = static_cast<int8_t>(slot);
+        } else {
+            mHead = static_cast<int8_t>(slot);
+        }
+        mTail = static_cast<int8_t>(slot);
+        mMembers |= bit(slot);
+    }
+
+    void pop_front() { remove(mHead); }
+    void pop_back() { remove(mTail); }
+
+    // Removes slot from the list. Does nothing if it is not in the list.
+    void remove(int slot) {
+        if (slot < 0 || count(slot) == 0) {
+            return;
+        }
+        const int8_t prev = mPrev[slot];
+        const int8_t next = mNext[slot];
+        if (prev != NONE) {
+            mNext[prev] = next;
+        } else {
+            mHead = next;
+        }
+        if (next != NONE) {
+            mPrev[next] = prev;
+        } else {
+            mTail = prev;
+        }
+        mMembers &= ~bit(slot);
+    }
+
+    void clear() {
+        mHead = NONE;
+        mTail = NONE;
+        mMembers = 0;
+    }
+
+private:
+    static constexpr int8_t NONE = -1;
+
+    static uint64_t bit(int slot) { return uint64_t(1) << slot; }
+
+    // mPrev and mNext are only meaningful for slots in mMembers.
+    int8_t mPrev[BufferQueueDefs::NUM_BUFFER_SLOTS] = {};
+    int8_t mNext[BufferQueueDefs::NUM_BUFFER_SLOTS] = {};
+    int8_t mHead = NONE;
+    int8_t mTail = NONE;
+    uint64_t mMembers = 0;
+};
+
+} // namespace android
+
+#endif // ANDROID_GUI_BUFFERSLOTSET_H
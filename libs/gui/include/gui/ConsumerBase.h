@@ -196,6 +196,16 @@ protected:
     virtual status_t acquireBufferLocked(BufferItem *item, nsecs_t presentWhen,
             uint64_t maxFrameNumber = 0);
 
+    // acquireBuffersLocked fetches up to maxBuffers pending buffers from the
+    // BufferQueue in a single call and updates the buffer slots for each of
+    // the buffers returned, which are appended to items. Unlike
+    // acquireBufferLocked this is not a hook for derived classes; consumers
+    // that override acquireBufferLocked must not use it.
+    status_t acquireBuffersLocked(std::vector<BufferItem>* items, size_t maxBuffers);
+
+    // trackAcquiredBufferLocked records a freshly acquired buffer in mSlots.
+    void trackAcquiredBufferLocked(const BufferItem& item);
+
     // releaseBufferLocked relinquishes control over a buffer, returning that
     // control to the BufferQueue.
     //
@@ -105,6 +105,14 @@ class CpuConsumer : public ConsumerBase
     // by calling unlockBuffer before more buffers can be acquired.
     status_t lockNextBuffer(LockedBuffer *nativeBuffer);
 
+    // Gets up to maxBuffers pending graphics buffers from the producer in one
+    // pass and locks them for CPU use, filling out outBuffers[0..*outCount).
+    // The number of buffers is further limited by how many more may be locked
+    // given maxLockedBuffers. Returns the same errors as lockNextBuffer when
+    // no buffer could be locked; each buffer that was locked must be returned
+    // with unlockBuffer.
+    status_t lockNextBuffers(LockedBuffer* outBuffers, size_t maxBuffers, size_t* outCount);
+
     // Returns a locked buffer to the queue, allowing it to be reused. Since
     // only a fixed number of buffers may be locked at a time, old buffers must
     // be released by calling unlockBuffer to ensure new buffers can be acquired by
@@ -140,10 +148,22 @@ class CpuConsumer : public ConsumerBase
 
     size_t findAcquiredBufferLocked(uintptr_t id) const;
 
-    status_t lockBufferItem(const BufferItem& item, LockedBuffer* outBuffer) const;
+    status_t lockBufferItem(const BufferItem& item, LockedBuffer* outBuffer);
+
+    // Locks an acquired buffer and records it in mAcquiredBuffers.
+    status_t lockAcquiredBufferLocked(BufferItem* item, LockedBuffer* outBuffer);
 
     Vector<AcquiredBuffer> mAcquiredBuffers;
 
+    // Remembers, per slot, a buffer whose possibly-YUV format could not be
+    // locked as flexible YUV, so later locks of the same buffer go straight to
+    // lockAsync instead of failing in gralloc first.
+    struct SlotLockMode {
+        uint64_t mBufferId = 0;
+        bool mSkipYCbCr = false;
+    };
+    SlotLockMode mSlotLockModes[BufferQueueDefs::NUM_BUFFER_SLOTS];
+
     // Count of currently locked buffers
     size_t mCurrentLockedBuffers;
 };
@@ -20,6 +20,14 @@
 
 namespace android {
 
+struct VsyncEventData {
+    // The id of the vsync, or DisplayEventReceiver::INVALID_VSYNC_ID if it is unknown.
+    int64_t id = DisplayEventReceiver::INVALID_VSYNC_ID;
+
+    // Time by which the frame started on the vsync should be done, or -1 if it is unknown.
+    nsecs_t deadlineTimestamp = -1;
+};
+
 class DisplayEventDispatcher : public LooperCallback {
 public:
     explicit DisplayEventDispatcher(
@@ -38,10 +46,15 @@ public:
 protected:
     virtual ~DisplayEventDispatcher() = default;
 
+    // Returns the data of the vsync being dispatched by dispatchVsync(), or of the last one
+    // dispatched otherwise.
+    const VsyncEventData& getVsyncEventData() const { return mVsyncEventData; }
+
 private:
     sp<Looper> mLooper;
     DisplayEventReceiver mReceiver;
     bool mWaitingForVsync;
+    VsyncEventData mVsyncEventData;
 
     virtual void dispatchVsync(nsecs_t timestamp, PhysicalDisplayId displayId, uint32_t count) = 0;
     virtual void dispatchHotplug(nsecs_t timestamp, PhysicalDisplayId displayId,
@@ -53,6 +66,6 @@ private:
     virtual void dispatchNullEvent(nsecs_t timestamp, PhysicalDisplayId displayId) = 0;
 
     bool processPendingEvents(nsecs_t* outTimestamp, PhysicalDisplayId* outDisplayId,
-                              uint32_t* outCount);
+                              uint32_t* outCount, VsyncEventData* outVsyncEventData);
 };
 } // namespace android
@@ -56,6 +56,8 @@ public:
         DISPLAY_EVENT_NULL = fourcc('n', 'u', 'l', 'l'),
     };
 
+    static constexpr int64_t INVALID_VSYNC_ID = -1;
+
     struct Event {
 
         struct Header {
@@ -67,6 +69,12 @@ public:
         struct VSync {
             uint32_t count;
             nsecs_t expectedVSyncTimestamp;
+            // Identifies the vsync across the connections of SurfaceFlinger,
+            // or INVALID_VSYNC_ID.
+            int64_t vsyncId;
+            // Time by which the frame started on this vsync should be done
+            // for the app to keep up with the display.
+            nsecs_t deadlineTimestamp;
         };
 
         struct Hotplug {
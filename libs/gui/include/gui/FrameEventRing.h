@@ -0,0 +1,89 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_GUI_FRAME_EVENT_RING_H
+#define ANDROID_GUI_FRAME_EVENT_RING_H
+
+#include <android-base/unique_fd.h>
+#include <utils/RefBase.h>
+#include <utils/StrongPointer.h>
+#include <utils/Timers.h>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace android {
+
+struct FrameEvents;
+
+// A fixed-size ring of the consumer-side timestamps of recent frames, kept in shared memory.
+// The consumer publishes into it whenever its FrameEventHistory changes and the producer reads
+// from it without any IPC. Slots are indexed by frame number and guarded by a sequence counter,
+// so readers never block the writer and simply retry or give up on a torn read.
+//
+// Fence signal times are published as they are known to the consumer at the time of the last
+// update, so a value that is still pending in the ring may already have signaled.
+class FrameEventRing : public LightRefBase<FrameEventRing> {
+public:
+    static constexpr size_t kCapacity = 32;
+
+    // Consumer-side events of a single frame. Values follow the
+    // NATIVE_WINDOW_TIMESTAMP_* conventions: PENDING for events that have not
+    // happened yet, INVALID for fences that will never signal.
+    struct Snapshot {
+        uint64_t frameNumber = 0;
+        nsecs_t latchTime;
+        nsecs_t firstRefreshStartTime;
+        nsecs_t lastRefreshStartTime;
+        nsecs_t gpuCompositionDoneTime;
+        nsecs_t displayPresentTime;
+        nsecs_t dequeueReadyTime;
+        nsecs_t releaseTime;
+    };
+
+    // Allocates a new ring mapped read-write, for the consumer. Returns nullptr on failure.
+    static sp<FrameEventRing> create();
+
+    // Maps a ring received from the consumer read-only. Returns nullptr on failure.
+    static sp<FrameEventRing> fromFd(base::unique_fd fd);
+
+    ~FrameEventRing();
+
+    // The shared memory region, to be sent to the producer. Once mapped by the creator,
+    // the region can no longer be mapped writable.
+    int getFd() const { return mFd.get(); }
+
+    // Publishes the state of events into the slot of its frame number. Only valid on a ring
+    // returned by create(), and must not be called concurrently.
+    void publish(const FrameEvents& events);
+
+    // Reads the events of frameNumber. Returns false if the slot holds another frame or
+    // could not be read consistently.
+    bool read(uint64_t frameNumber, Snapshot* outSnapshot) const;
+
+private:
+    struct Layout;
+
+    FrameEventRing(base::unique_fd fd, Layout* layout, bool writable);
+
+    const base::unique_fd mFd;
+    Layout* const mLayout;
+    const bool mWritable;
+};
+
+} // namespace android
+
+#endif // ANDROID_GUI_FRAME_EVENT_RING_H
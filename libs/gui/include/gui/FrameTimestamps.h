@@ -30,6 +30,7 @@ namespace android {
 
 struct FrameEvents;
 class FrameEventHistoryDelta;
+class FrameEventRing;
 
 
 // Identifiers for all the events that may be recorded or reported.
@@ -224,9 +225,15 @@ public:
 
     void getAndResetDelta(FrameEventHistoryDelta* delta);
 
+    // Publishes every later change of the history into ring, from which the
+    // producer can read its frame events without asking for a delta.
+    void setFrameEventRing(const sp<FrameEventRing>& ring);
+
 private:
     void getFrameDelta(FrameEventHistoryDelta* delta,
                        const std::vector<FrameEvents>::iterator& frame);
+    void publishFrame(const FrameEvents& frame);
+    void publishAllFrames();
 
     std::vector<FrameEventDirtyFields> mFramesDirty;
 
@@ -236,6 +243,8 @@ private:
 
     int mCurrentConnectId{0};
     bool mProducerWantsEvents{false};
+
+    sp<FrameEventRing> mFrameEventRing;
 };
 
 
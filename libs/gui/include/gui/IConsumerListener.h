@@ -28,6 +28,7 @@ namespace android {
 
 class BufferItem;
 class FrameEventHistoryDelta;
+class FrameEventRing;
 struct NewFrameEventsEntry;
 
 // ConsumerListener is the interface through which the BufferQueue notifies the consumer of events
@@ -90,6 +91,12 @@ public:
     // WARNING: This method can only be called when the BufferQueue is in the consumer's process.
     virtual void addAndGetFrameTimestamps(const NewFrameEventsEntry* /*newTimestamps*/,
                                           FrameEventHistoryDelta* /*outDelta*/) {}
+
+    // Returns in outRing the shared memory ring the consumer publishes its frame history into,
+    // creating it if needed. Leaves outRing untouched if the consumer does not support it.
+    //
+    // WARNING: This method can only be called when the BufferQueue is in the consumer's process.
+    virtual void getFrameEventRing(sp<FrameEventRing>* /*outRing*/) {}
 };
 
 #ifndef NO_BINDER
@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include <gui/BufferItem.h>
 #include <gui/OccupancyTracker.h>
 
 #include <binder/IInterface.h>
@@ -28,9 +29,10 @@
 
 #include <utils/Errors.h>
 
+#include <vector>
+
 namespace android {
 
-class BufferItem;
 class Fence;
 class GraphicBuffer;
 class IConsumerListener;
@@ -84,6 +86,30 @@ public:
     virtual status_t acquireBuffer(BufferItem* buffer, nsecs_t presentWhen,
                                    uint64_t maxFrameNumber = 0) = 0;
 
+    // acquireBuffers acquires up to maxBuffers pending buffers in queue order, appending them to
+    // outBuffers. Unlike repeated calls to acquireBuffer, an implementation may take all of the
+    // buffers in a single pass over the queue. No buffers are dropped and presentation times are
+    // ignored, as with acquireBuffer(buffer, 0).
+    //
+    // Return of NO_ERROR means at least one buffer was acquired. Otherwise nothing was acquired:
+    // * NO_BUFFER_AVAILABLE - no buffer is pending (nothing queued by producer)
+    // * INVALID_OPERATION - too many buffers have been acquired
+    // * BAD_VALUE - outBuffers is NULL or maxBuffers is zero
+    virtual status_t acquireBuffers(std::vector<BufferItem>* outBuffers, size_t maxBuffers) {
+        if (outBuffers == nullptr || maxBuffers == 0) {
+            return BAD_VALUE;
+        }
+        for (size_t i = 0; i < maxBuffers; ++i) {
+            BufferItem item;
+            status_t err = acquireBuffer(&item, 0);
+            if (err != NO_ERROR) {
+                return i == 0 ? err : NO_ERROR;
+            }
+            outBuffers->push_back(std::move(item));
+        }
+        return NO_ERROR;
+    }
+
     // detachBuffer attempts to remove all ownership of the buffer in the given slot from the buffer
     // queue. If this call succeeds, the slot will be freed, and there will be no way to obtain the
     // buffer from this interface. The freed slot will remain unallocated until either it is
@@ -20,6 +20,9 @@
 #include <stdint.h>
 #include <sys/types.h>
 
+#include <optional>
+#include <vector>
+
 #include <utils/Errors.h>
 #include <utils/RefBase.h>
 
@@ -41,6 +44,7 @@
 namespace android {
 // ----------------------------------------------------------------------------
 
+class FrameEventRing;
 class IProducerListener;
 class NativeHandle;
 class Surface;
@@ -385,6 +389,13 @@ public:
         FrameEventHistoryDelta frameTimestamps;
         bool bufferReplaced{false};
         int maxBufferCount{0};
+        // Consumer properties which rarely change, so that they can be cached
+        // by the producer instead of queried. Only valid if
+        // hasConsumerProperties is set, which not all producers do.
+        bool hasConsumerProperties{false};
+        uint64_t consumerUsageBits{0};
+        int32_t defaultDataSpace{0};
+        bool consumerIsProtected{false};
     };
 
     // queueBuffer indicates that the client has finished filling in the
@@ -639,6 +650,54 @@ public:
     // the width and height used for dequeueBuffer will be additionally swapped.
     virtual status_t setAutoPrerotation(bool autoPrerotation);
 
+    struct DequeueBufferInput {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        PixelFormat format = 0;
+        uint64_t usage = 0;
+        bool getTimestamps = false;
+    };
+
+    struct DequeueBufferOutput {
+        // Same as the return value of dequeueBuffer.
+        status_t result = NO_ERROR;
+        int slot = BufferQueueDefs::NUM_BUFFER_SLOTS;
+        sp<Fence> fence = Fence::NO_FENCE;
+        uint64_t bufferAge = 0;
+        // Set when result has BUFFER_NEEDS_REALLOCATION set, to the buffer that
+        // requestBuffer would return for slot.
+        sp<GraphicBuffer> buffer;
+        std::optional<FrameEventHistoryDelta> timestamps;
+    };
+
+    // dequeueBuffers dequeues up to inputs.size() buffers in a single call,
+    // and returns in outputs the buffers that were dequeued, in order.
+    //
+    // The first request behaves like dequeueBuffer and always produces an
+    // output, whose result may be an error. The remaining requests are only
+    // served while a free buffer is available without blocking, and stop at
+    // the first one that is not; IGBPs other than BufferQueue serve the first
+    // request only.
+    //
+    // Unlike dequeueBuffer, a slot that needs reallocation comes back with its
+    // new buffer attached, so that no requestBuffer call is needed.
+    //
+    // Return of a value other than NO_ERROR means that no buffer was dequeued:
+    // * BAD_VALUE - inputs is empty or outputs is null.
+    // * Any error of the underlying transport.
+    virtual status_t dequeueBuffers(const std::vector<DequeueBufferInput>& inputs,
+                                    std::vector<DequeueBufferOutput>* outputs);
+
+    // getFrameEventRing returns in outRing a read-only view of the shared
+    // memory ring the consumer publishes its frame events into. Once obtained,
+    // the consumer-side timestamps of recent frames can be read from it
+    // without calling getFrameTimestamps.
+    //
+    // Return of a value other than NO_ERROR means that no ring is available:
+    // * INVALID_OPERATION - the consumer does not support it.
+    // * NO_MEMORY - the ring could not be created or mapped.
+    virtual status_t getFrameEventRing(sp<FrameEventRing>* outRing);
+
 #ifndef NO_BINDER
     // Static method exports any IGraphicBufferProducer object to a parcel. It
     // handles null producer as well.
@@ -658,6 +717,11 @@ protected:
     // ProducerQueueParcelable object.
     virtual status_t exportToParcel(Parcel* parcel);
 #endif
+
+protected:
+    // Serves a single dequeueBuffers request through dequeueBuffer and, if the
+    // slot needs reallocation, requestBuffer.
+    void dequeueBufferWithRequest(const DequeueBufferInput& input, DequeueBufferOutput* output);
 };
 
 // ----------------------------------------------------------------------------
@@ -306,6 +306,25 @@ public:
     virtual status_t captureScreen(uint64_t displayOrLayerStack, ui::Dataspace* outDataspace,
                                    sp<GraphicBuffer>* outBuffer) = 0;
 
+    /**
+     * Capture the specified screen into a buffer owned by the caller, without waiting for the
+     * render to complete. This requires the same permissions as captureScreen.
+     *
+     * The buffer must be allocated with GRALLOC_USAGE_HW_RENDER, and the source crop is scaled to
+     * fill it. Callers that capture repeatedly should reuse a small set of buffers, which saves a
+     * buffer allocation per capture and the import of the returned buffer.
+     *
+     * On success, outFence signals once the buffer holds the capture. The caller must not read
+     * the buffer, or pass it to another capture, before then.
+     */
+    virtual status_t captureScreenIntoBuffer(const sp<IBinder>& display,
+                                             const sp<GraphicBuffer>& buffer,
+                                             ui::Dataspace reqDataspace, const Rect& sourceCrop,
+                                             bool useIdentityTransform, ui::Rotation rotation,
+                                             bool captureSecureLayers,
+                                             bool& outCapturedSecureLayers,
+                                             sp<Fence>* outFence) = 0;
+
     template <class AA>
     struct SpHash {
         size_t operator()(const sp<AA>& k) const { return std::hash<AA*>()(k.get()); }
@@ -599,6 +618,7 @@ public:
         SET_GAME_CONTENT_TYPE,
         SET_FRAME_RATE,
         ACQUIRE_FRAME_RATE_FLEXIBILITY_TOKEN,
+        CAPTURE_SCREEN_INTO_BUFFER,
         // Always append new enum to the end.
     };
 
@@ -79,6 +79,17 @@ public:
      */
     virtual status_t getLayerFrameStats(const sp<IBinder>& handle, FrameStats* outStats) const = 0;
 
+    /*
+     * Gets the stats of the frames of the layer which completed since frameNumber, in order, and
+     * the number of the next frame to ask for. Calling it again with that number streams the
+     * frame stats without missing or repeating frames, as long as the layer keeps the frames.
+     *
+     * Requires ACCESS_SURFACE_FLINGER permission
+     */
+    virtual status_t getLayerFrameStatsSince(const sp<IBinder>& handle, uint64_t frameNumber,
+                                             FrameStats* outStats,
+                                             uint64_t* outNextFrameNumber) const = 0;
+
     virtual status_t mirrorSurface(const sp<IBinder>& mirrorFromHandle, sp<IBinder>* outHandle) = 0;
 };
 
@@ -97,6 +97,9 @@ public:
     std::vector<SurfaceStats> surfaceStats;
 };
 
+// The stats of all the transactions of a listener which completed in a frame. They are parceled
+// together, sharing the fences common to several transactions or surfaces, so that each fence
+// is only sent once.
 class ListenerStats : public Parcelable {
 public:
     status_t writeToParcel(Parcel* output) const override;
@@ -114,6 +117,10 @@ public:
     DECLARE_META_INTERFACE(TransactionCompletedListener)
 
     virtual void onTransactionCompleted(ListenerStats stats) = 0;
+
+    // Asks the process to uncache the buffer cached with cacheId, as SurfaceFlinger is over its
+    // budget for cached buffers.
+    virtual void onCachedBufferEvicted(uint64_t cacheId) = 0;
 };
 
 class BnTransactionCompletedListener : public SafeBnInterface<ITransactionCompletedListener> {
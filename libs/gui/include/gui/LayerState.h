@@ -250,7 +250,8 @@ struct DisplayState {
         eSurfaceChanged = 0x01,
         eLayerStackChanged = 0x02,
         eDisplayProjectionChanged = 0x04,
-        eDisplaySizeChanged = 0x08
+        eDisplaySizeChanged = 0x08,
+        eFrameRateChanged = 0x10
     };
 
     DisplayState();
@@ -278,6 +279,9 @@ struct DisplayState {
 
     uint32_t width, height;
 
+    // The maximum rate at which a virtual display is composed, or 0 for no limit.
+    float maxFrameRate = 0.0f;
+
     status_t write(Parcel& output) const;
     status_t read(const Parcel& input);
 };
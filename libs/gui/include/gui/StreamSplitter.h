@@ -37,8 +37,23 @@ class IGraphicBufferProducer;
 // BufferQueue, where each buffer queued to the input is available to be
 // acquired by each of the outputs, and is able to be dequeued by the input
 // again only once all of the outputs have released it.
+//
+// Each output has a drop policy that decides what happens when its consumer
+// falls behind. Only Block outputs throttle the input; the others drop frames
+// for themselves so that one slow consumer does not stall the rest.
 class StreamSplitter : public BnConsumerListener {
 public:
+    enum class DropPolicy {
+        // Stop acquiring from the input while this output holds too many
+        // buffers. This slows down the input's producer and every output.
+        Block,
+        // Keep only the newest frame queued to this output. A frame not yet
+        // acquired by the output's consumer is replaced by the next one.
+        LatestOnly,
+        // Skip new frames for this output while it holds maxBuffers buffers.
+        Bounded,
+    };
+
     // createSplitter creates a new splitter, outSplitter, using inputQueue as
     // the input BufferQueue. Output BufferQueues must be added using addOutput
     // before queueing any buffers to the input.
@@ -61,7 +76,14 @@ public:
     // outputQueue has not been added to the splitter. BAD_VALUE is returned if
     // outputQueue is NULL. See IGraphicBufferProducer::connect for explanations
     // of other error codes.
-    status_t addOutput(const sp<IGraphicBufferProducer>& outputQueue);
+    //
+    // policy selects how the output is treated when its consumer holds on to
+    // buffers; see DropPolicy. For LatestOnly and Bounded outputs, maxBuffers
+    // caps how many buffers the output may hold at once, and frames beyond
+    // that are dropped for this output only.
+    status_t addOutput(const sp<IGraphicBufferProducer>& outputQueue,
+            DropPolicy policy = DropPolicy::Block,
+            size_t maxBuffers = MAX_OUTSTANDING_BUFFERS);
 
     // setName sets the consumer name of the input queue
     void setName(const String8& name);
@@ -93,10 +115,18 @@ private:
     // During this callback, we detach the buffer from the output queue that
     // generated the callback, update our state tracking to see if this is the
     // last output releasing the buffer, and if so, release it to the input.
-    // If we release the buffer to the input, we allow a blocked
+    // If the last Block output releases the buffer, we allow a blocked
     // onFrameAvailable call to proceed.
     void onBufferReleasedByOutput(const sp<IGraphicBufferProducer>& from);
 
+    // Detaches the next released buffer from the indexed output and drops
+    // that output's reference to it. This must be called with mMutex locked.
+    void releaseFromOutputLocked(size_t outputIndex);
+
+    // Returns a buffer that no output references any more to the input. This
+    // must be called with mMutex locked.
+    void releaseToInputLocked(uint64_t bufferId);
+
     // When this is called, the splitter disconnects from (i.e., abandons) its
     // input queue and signals any waiting onFrameAvailable calls to wake up.
     // It still processes callbacks from other outputs, but only detaches their
@@ -135,9 +165,23 @@ private:
 
         void mergeFence(const sp<Fence>& with);
 
-        // Returns the new value
+        // Counts the outputs, and separately the Block outputs, to which the
+        // buffer has been queued and which have not yet released it.
         // Only called while mMutex is held
-        size_t incrementReleaseCountLocked() { return ++mReleaseCount; }
+        void addReferenceLocked(bool blocking) {
+            ++mRefCount;
+            if (blocking) ++mBlockingRefCount;
+        }
+
+        // Returns the number of remaining references
+        // Only called while mMutex is held
+        size_t removeReferenceLocked(bool blocking) {
+            if (blocking) --mBlockingRefCount;
+            return --mRefCount;
+        }
+
+        size_t getRefCountLocked() const { return mRefCount; }
+        size_t getBlockingRefCountLocked() const { return mBlockingRefCount; }
 
     private:
         // Only destroy through LightRefBase
@@ -150,9 +194,22 @@ private:
 
         sp<GraphicBuffer> mBuffer; // One instance that holds this native handle
         sp<Fence> mMergedFence;
-        size_t mReleaseCount;
+        size_t mRefCount;
+        size_t mBlockingRefCount;
     };
 
+    struct Output {
+        sp<IGraphicBufferProducer> mProducer;
+        DropPolicy mPolicy;
+        size_t mMaxBuffers;
+        // Buffers queued to this output that it has not released yet
+        size_t mBufferCount;
+    };
+
+    // Returns the index of from in mOutputs, or mOutputs.size() if it is not
+    // one of our outputs
+    size_t findOutputLocked(const sp<IGraphicBufferProducer>& from) const;
+
     // Only called from createSplitter
     explicit StreamSplitter(const sp<IGraphicBufferConsumer>& inputQueue);
 
@@ -169,9 +226,10 @@ private:
 
     Mutex mMutex;
     Condition mReleaseCondition;
+    // Number of buffers still held by at least one Block output
     int mOutstandingBuffers;
     sp<IGraphicBufferConsumer> mInput;
-    Vector<sp<IGraphicBufferProducer> > mOutputs;
+    Vector<Output> mOutputs;
 
     // Map of GraphicBuffer IDs (GraphicBuffer::getId()) to buffer tracking
     // objects (which are mostly for counting how many outputs have released the
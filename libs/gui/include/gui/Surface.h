@@ -29,6 +29,7 @@
 #include <utils/Mutex.h>
 #include <utils/RefBase.h>
 
+#include <deque>
 #include <shared_mutex>
 #include <unordered_set>
 
@@ -301,6 +302,15 @@ public:
     virtual int setSharedBufferMode(bool sharedBufferMode);
     virtual int setAutoRefresh(bool autoRefresh);
     virtual int setAutoPrerotation(bool autoPrerotation);
+
+    // When count is non-zero, dequeueBuffer asks the producer for up to count
+    // more buffers than it needs, taking only those that are available
+    // without blocking, and hands them out on the following calls without
+    // going over Binder. Buffers that need reallocation come back along with
+    // the dequeue, instead of through a separate requestBuffer call.
+    // Prefetched buffers remain dequeued from the producer's point of view.
+    virtual int setDequeuePrefetchCount(size_t count);
+
     virtual int setBuffersDimensions(uint32_t width, uint32_t height);
     virtual int lock(ANativeWindow_Buffer* outBuffer, ARect* inOutDirtyBounds);
     virtual int unlockAndPost();
@@ -361,9 +371,26 @@ protected:
 
     void querySupportedTimestampsLocked() const;
 
+    // Caches the consumer properties of the output of connect or queueBuffer.
+    void updateConsumerPropertiesLocked(const IGraphicBufferProducer::QueueBufferOutput& output);
+
     void freeAllBuffers();
     int getSlotFromBufferLocked(android_native_buffer_t* buffer) const;
 
+    // Dequeues a buffer through IGraphicBufferProducer::dequeueBuffers, along
+    // with up to prefetchCount more that are kept in mPrefetchedBuffers.
+    status_t dequeueBufferWithPrefetch(const IGraphicBufferProducer::DequeueBufferInput& input,
+                                       size_t prefetchCount,
+                                       IGraphicBufferProducer::DequeueBufferOutput* output);
+
+    // Takes the oldest prefetched buffer if it was dequeued for input. Returns
+    // false, after cancelling any stale prefetched buffers, otherwise.
+    bool takePrefetchedBufferLocked(const IGraphicBufferProducer::DequeueBufferInput& input,
+                                    int* outSlot, sp<Fence>* outFence);
+
+    // Returns all prefetched buffers to the producer.
+    void cancelPrefetchedBuffersLocked();
+
     struct BufferSlot {
         sp<GraphicBuffer> buffer;
         Region dirtyRegion;
@@ -465,6 +492,15 @@ protected:
     // one buffer behind the producer.
     mutable bool mConsumerRunningBehind;
 
+    // Consumer properties returned by the last connect or queueBuffer, which
+    // answer the queries of these properties without a call to the producer.
+    // They are only valid if mHasConsumerProperties is set, and may be one
+    // queueBuffer late if the consumer changes them.
+    bool mHasConsumerProperties;
+    uint64_t mConsumerUsageBits;
+    int32_t mDefaultDataSpace;
+    bool mConsumerIsProtected;
+
     // mMutex is the mutex used to prevent concurrent access to the member
     // variables of Surface objects. It must be locked whenever the
     // member variables are accessed.
@@ -538,6 +574,9 @@ protected:
     // A cached copy of the FrameEventHistory maintained by the consumer.
     bool mEnableFrameTimestamps = false;
     std::unique_ptr<ProducerFrameEventHistory> mFrameEventHistory;
+    // The consumer's shared copy of its frame events, if it has one. Read
+    // before falling back to asking the consumer for a delta.
+    sp<FrameEventRing> mFrameEventRing;
 
     bool mReportRemovedBuffers = false;
     std::vector<sp<GraphicBuffer>> mRemovedBuffers;
@@ -553,6 +592,20 @@ protected:
 
     // Buffers that are successfully dequeued/attached and handed to clients
     std::unordered_set<int> mDequeuedSlots;
+
+    // Buffers that were dequeued ahead of time and not yet handed to clients.
+    // See setDequeuePrefetchCount.
+    struct PrefetchedBuffer {
+        IGraphicBufferProducer::DequeueBufferInput input;
+        int slot;
+        sp<Fence> fence;
+        uint64_t bufferAge;
+        // mNextFrameNumber when the buffer was dequeued, to keep its age
+        // current.
+        uint64_t frameNumber;
+    };
+    size_t mDequeuePrefetchCount = 0;
+    std::deque<PrefetchedBuffer> mPrefetchedBuffers;
 };
 
 } // namespace android
@@ -340,7 +340,13 @@ public:
 
     class Transaction : public Parcelable {
     protected:
-        std::unordered_map<sp<IBinder>, ComposerState, IBinderHash> mComposerStates;
+        // Layer states, keyed by the handle in their surface. They are kept in a Vector, which
+        // apply() shares with the binder call rather than copying each of them, and which
+        // transactions of a few layers search linearly.
+        Vector<ComposerState> mComposerStates;
+        // Indices of mComposerStates by handle, only kept once there are more than
+        // MAX_LINEAR_SEARCH_COMPOSER_STATES of them.
+        std::unordered_map<IBinder*, size_t> mComposerStateIndices;
         SortedVector<DisplayState > mDisplayStates;
         std::unordered_map<sp<ITransactionCompletedListener>, CallbackInfo, TCLHash>
                 mListenerCallbacks;
@@ -370,6 +376,10 @@ public:
         InputWindowCommands mInputWindowCommands;
         int mStatus = NO_ERROR;
 
+        ssize_t indexOfComposerState(const sp<IBinder>& surfaceHandle) const;
+        void addComposerState(const ComposerState& state);
+        void clearComposerStates();
+
         layer_state_t* getLayerState(const sp<IBinder>& surfaceHandle);
         layer_state_t* getLayerState(const sp<SurfaceControl>& sc) {
             return getLayerState(sc->getHandle());
@@ -547,6 +557,13 @@ public:
         void setDisplayProjection(const sp<IBinder>& token, ui::Rotation orientation,
                                   const Rect& layerStackRect, const Rect& displayRect);
         void setDisplaySize(const sp<IBinder>& token, uint32_t width, uint32_t height);
+
+        /* setDisplayMaxFrameRate() limits the rate at which a virtual display
+         * is composed, e.g. to the rate its consumer encodes at. Refreshes
+         * which come sooner are skipped for the display. 0 removes the limit.
+         * Physical displays ignore it.
+         */
+        void setDisplayMaxFrameRate(const sp<IBinder>& token, float frameRate);
         void setAnimationTransaction();
         void setEarlyWakeup();
         void setExplicitEarlyWakeupStart();
@@ -555,6 +572,8 @@ public:
 
     status_t clearLayerFrameStats(const sp<IBinder>& token) const;
     status_t getLayerFrameStats(const sp<IBinder>& token, FrameStats* outStats) const;
+    status_t getLayerFrameStatsSince(const sp<IBinder>& token, uint64_t frameNumber,
+                                     FrameStats* outStats, uint64_t* outNextFrameNumber) const;
     static status_t clearAnimationFrameStats();
     static status_t getAnimationFrameStats(FrameStats* outStats);
 
@@ -605,6 +624,13 @@ public:
                             ui::Rotation rotation, sp<GraphicBuffer>* outBuffer);
     static status_t capture(uint64_t displayOrLayerStack, ui::Dataspace* outDataspace,
                             sp<GraphicBuffer>* outBuffer);
+    // Renders into a caller-owned buffer and returns without waiting for the render. The
+    // capture is complete once outFence signals. See ISurfaceComposer::captureScreenIntoBuffer.
+    static status_t captureIntoBuffer(const sp<IBinder>& display, const sp<GraphicBuffer>& buffer,
+                                      ui::Dataspace reqDataSpace, const Rect& sourceCrop,
+                                      bool useIdentityTransform, ui::Rotation rotation,
+                                      bool captureSecureLayers, bool& outCapturedSecureLayers,
+                                      sp<Fence>* outFence);
     static status_t captureLayers(const sp<IBinder>& layerHandle, ui::Dataspace reqDataSpace,
                                   ui::PixelFormat reqPixelFormat, const Rect& sourceCrop,
                                   float frameScale, sp<GraphicBuffer>* outBuffer);
@@ -653,6 +679,9 @@ public:
 
     // Overrides BnTransactionCompletedListener's onTransactionCompleted
     void onTransactionCompleted(ListenerStats stats) override;
+
+    // Overrides BnTransactionCompletedListener's onCachedBufferEvicted
+    void onCachedBufferEvicted(uint64_t cacheId) override;
 };
 
 } // namespace android
@@ -74,6 +74,21 @@ public:
         return recvObjects(tube, events, count, sizeof(T));
     }
 
+    // send objects in a message of their own each, with a system call per 64 messages. Returns
+    // the number of objects sent, which is less than count if the socket buffer fills up.
+    template <typename T>
+    static ssize_t sendObjectMessages(BitTube* tube, T const* events, size_t count) {
+        return sendObjectMessages(tube, events, count, sizeof(T));
+    }
+
+    // receive objects which were each sent in a message of their own, reading up to count (at
+    // most 64) messages with a single system call. Messages holding more than one object are truncated to
+    // their first object.
+    template <typename T>
+    static ssize_t recvObjectMessages(BitTube* tube, T* events, size_t count) {
+        return recvObjectMessages(tube, events, count, sizeof(T));
+    }
+
     // implement the Parcelable protocol. Only parcels the receive file descriptor
     status_t writeToParcel(Parcel* reply) const;
     status_t readFromParcel(const Parcel* parcel);
@@ -94,6 +109,11 @@ private:
     static ssize_t sendObjects(BitTube* tube, void const* events, size_t count, size_t objSize);
 
     static ssize_t recvObjects(BitTube* tube, void* events, size_t count, size_t objSize);
+
+    static ssize_t sendObjectMessages(BitTube* tube, void const* events, size_t count,
+                                      size_t objSize);
+
+    static ssize_t recvObjectMessages(BitTube* tube, void* events, size_t count, size_t objSize);
 };
 
 } // namespace gui
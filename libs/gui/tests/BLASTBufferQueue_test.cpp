@@ -350,6 +350,73 @@ TEST_F(BLASTBufferQueueTest, TripleBuffering) {
     adapter.waitForCallbacks();
 }
 
+TEST_F(BLASTBufferQueueTest, BatchedTransactions) {
+    sp<SurfaceControl> bottomSurface =
+            mClient->createSurface(String8("BottomSurface"), mDisplayWidth, mDisplayHeight / 2,
+                                   PIXEL_FORMAT_RGBA_8888,
+                                   ISurfaceComposerClient::eFXSurfaceBufferState,
+                                   /*parent*/ nullptr);
+    Transaction()
+            .setLayerStack(bottomSurface, 0)
+            .setLayer(bottomSurface, std::numeric_limits<int32_t>::max())
+            .setPosition(bottomSurface, 0, mDisplayHeight / 2)
+            .show(bottomSurface)
+            .setDataspace(bottomSurface, ui::Dataspace::V0_SRGB)
+            .apply();
+
+    BLASTBufferQueue::setTransactionBatchingEnabled(true);
+    BLASTBufferQueueHelper topAdapter(mSurfaceControl, mDisplayWidth, mDisplayHeight);
+    BLASTBufferQueueHelper bottomAdapter(bottomSurface, mDisplayWidth, mDisplayHeight / 2);
+
+    auto queueColor = [&](BLASTBufferQueueHelper& adapter, uint32_t width, uint32_t height,
+                          uint8_t r, uint8_t g, uint8_t b) {
+        sp<IGraphicBufferProducer> igbProducer;
+        ASSERT_NO_FATAL_FAILURE(setUpProducer(adapter, igbProducer));
+        int slot;
+        sp<Fence> fence;
+        sp<GraphicBuffer> buf;
+        auto ret = igbProducer->dequeueBuffer(&slot, &fence, width, height, PIXEL_FORMAT_RGBA_8888,
+                                              GRALLOC_USAGE_SW_WRITE_OFTEN, nullptr, nullptr);
+        ASSERT_EQ(IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION, ret);
+        ASSERT_EQ(OK, igbProducer->requestBuffer(slot, &buf));
+
+        uint32_t* bufData;
+        buf->lock(static_cast<uint32_t>(GraphicBuffer::USAGE_SW_WRITE_OFTEN),
+                  reinterpret_cast<void**>(&bufData));
+        fillBuffer(bufData, Rect(buf->getWidth(), buf->getHeight()), buf->getStride(), r, g, b);
+        buf->unlock();
+
+        IGraphicBufferProducer::QueueBufferOutput qbOutput;
+        IGraphicBufferProducer::QueueBufferInput input(systemTime(), false, HAL_DATASPACE_UNKNOWN,
+                                                       Rect(width, height),
+                                                       NATIVE_WINDOW_SCALING_MODE_FREEZE, 0,
+                                                       Fence::NO_FENCE);
+        ASSERT_EQ(NO_ERROR, igbProducer->queueBuffer(slot, input, &qbOutput));
+    };
+    ASSERT_NO_FATAL_FAILURE(queueColor(topAdapter, mDisplayWidth, mDisplayHeight, 255, 0, 0));
+    ASSERT_NO_FATAL_FAILURE(
+            queueColor(bottomAdapter, mDisplayWidth, mDisplayHeight / 2, 0, 0, 255));
+
+    topAdapter.waitForCallbacks();
+    bottomAdapter.waitForCallbacks();
+    BLASTBufferQueue::setTransactionBatchingEnabled(false);
+
+    // capture screen and verify that the top half is red and the bottom half blue
+    bool capturedSecureLayers;
+    ASSERT_EQ(NO_ERROR,
+              mComposer->captureScreen(mDisplayToken, &mScreenCaptureBuf, capturedSecureLayers,
+                                       ui::Dataspace::V0_SRGB, ui::PixelFormat::RGBA_8888, Rect(),
+                                       mDisplayWidth, mDisplayHeight,
+                                       /*useIdentityTransform*/ false));
+    ASSERT_NO_FATAL_FAILURE(
+            checkScreenCapture(255, 0, 0,
+                               {0, 0, (int32_t)mDisplayWidth, (int32_t)mDisplayHeight / 2}));
+    ASSERT_NO_FATAL_FAILURE(
+            checkScreenCapture(0, 0, 255,
+                               {0, (int32_t)mDisplayHeight / 2, (int32_t)mDisplayWidth,
+                                (int32_t)mDisplayHeight}));
+}
+
 TEST_F(BLASTBufferQueueTest, SetCrop_Item) {
     uint8_t r = 255;
     uint8_t g = 0;
@@ -203,4 +203,34 @@ TEST_F(BufferItemConsumerTest, TriggerBufferFreed_DeleteBufferItemConsumer) {
     ASSERT_EQ(1, GetFreedBufferCount());
 }
 
+// Test that acquireBuffers drains every queued buffer in queue order.
+TEST_F(BufferItemConsumerTest, AcquireBuffers_DrainsQueueInOrder) {
+    int slots[kMaxLockedBuffers];
+    for (int i = 0; i < kMaxLockedBuffers; i++) {
+        DequeueBuffer(&slots[i]);
+    }
+    for (int i = 0; i < kMaxLockedBuffers; i++) {
+        QueueBuffer(slots[i]);
+    }
+
+    std::vector<BufferItem> items;
+    ASSERT_EQ(NO_ERROR, mBIC->acquireBuffers(&items, BufferQueueDefs::NUM_BUFFER_SLOTS));
+    ASSERT_EQ(static_cast<size_t>(kMaxLockedBuffers), items.size());
+    for (int i = 0; i < kMaxLockedBuffers; i++) {
+        EXPECT_EQ(slots[i], items[i].mSlot);
+        EXPECT_EQ(mBuffers[slots[i]], items[i].mGraphicBuffer);
+        if (i > 0) {
+            EXPECT_LT(items[i - 1].mFrameNumber, items[i].mFrameNumber);
+        }
+    }
+
+    std::vector<BufferItem> empty;
+    EXPECT_EQ(BufferQueue::NO_BUFFER_AVAILABLE, mBIC->acquireBuffers(&empty, 1));
+    EXPECT_TRUE(empty.empty());
+
+    for (int i = 0; i < kMaxLockedBuffers; i++) {
+        ReleaseBuffer(slots[i]);
+    }
+}
+
 }  // namespace android
@@ -524,6 +524,31 @@ TEST_F(BufferQueueTest, TestDisallowingAllocation) {
                                        GRALLOC_USAGE_SW_WRITE_OFTEN, nullptr, nullptr));
 }
 
+TEST_F(BufferQueueTest, AllocateBuffersFillsAllFreeSlots) {
+    createBufferQueue();
+    sp<DummyConsumer> dc(new DummyConsumer);
+    ASSERT_EQ(OK, mConsumer->consumerConnect(dc, true));
+    IGraphicBufferProducer::QueueBufferOutput output;
+    ASSERT_EQ(OK, mProducer->connect(new DummyProducerListener,
+            NATIVE_WINDOW_API_CPU, true, &output));
+
+    // More buffers than are allocated at the same time.
+    static const int DEQUEUED_COUNT = 5;
+    ASSERT_EQ(OK, mProducer->setMaxDequeuedBufferCount(DEQUEUED_COUNT));
+    ASSERT_EQ(OK, mConsumer->setDefaultBufferSize(320, 240));
+    mProducer->allocateBuffers(0, 0, 0, GRALLOC_USAGE_SW_WRITE_OFTEN);
+
+    // All the buffers can be dequeued without allocating.
+    ASSERT_EQ(OK, mProducer->allowAllocation(false));
+    int slot;
+    sp<Fence> fence;
+    for (int i = 0; i < DEQUEUED_COUNT; i++) {
+        ASSERT_EQ(OK,
+                  mProducer->dequeueBuffer(&slot, &fence, 0, 0, 0, GRALLOC_USAGE_SW_WRITE_OFTEN,
+                                           nullptr, nullptr));
+    }
+}
+
 TEST_F(BufferQueueTest, TestGenerationNumbers) {
     createBufferQueue();
     sp<DummyConsumer> dc(new DummyConsumer);
@@ -1213,6 +1238,54 @@ TEST_F(BufferQueueTest, TestStaleBufferHandleSentAfterDisconnect) {
     ASSERT_NE(nullptr, item.mGraphicBuffer.get());
 }
 
+TEST_F(BufferQueueTest, TestDequeueBuffers) {
+    createBufferQueue();
+    sp<DummyConsumer> dc(new DummyConsumer);
+    ASSERT_EQ(OK, mConsumer->consumerConnect(dc, false));
+    IGraphicBufferProducer::QueueBufferOutput output;
+    ASSERT_EQ(OK, mProducer->connect(new DummyProducerListener, NATIVE_WINDOW_API_CPU, false,
+                                     &output));
+    ASSERT_EQ(OK, mProducer->setMaxDequeuedBufferCount(3));
+
+    std::vector<IGraphicBufferProducer::DequeueBufferOutput> outputs;
+    ASSERT_EQ(BAD_VALUE, mProducer->dequeueBuffers({}, &outputs));
+
+    // Nothing is allocated yet, so only the first request is served, and it
+    // carries the newly allocated buffer.
+    std::vector<IGraphicBufferProducer::DequeueBufferInput> inputs(4);
+    ASSERT_EQ(OK, mProducer->dequeueBuffers(inputs, &outputs));
+    ASSERT_EQ(1u, outputs.size());
+    ASSERT_EQ(IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION,
+              outputs[0].result & IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION);
+    ASSERT_NE(nullptr, outputs[0].buffer);
+    ASSERT_EQ(OK, mProducer->cancelBuffer(outputs[0].slot, Fence::NO_FENCE));
+
+    // Preallocate the remaining buffers that may be dequeued at once.
+    int slots[2] = {};
+    sp<Fence> fence;
+    sp<GraphicBuffer> buffer;
+    for (int& slot : slots) {
+        ASSERT_EQ(IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION,
+                  mProducer->dequeueBuffer(&slot, &fence, 0, 0, 0, 0, nullptr, nullptr));
+        ASSERT_EQ(OK, mProducer->requestBuffer(slot, &buffer));
+    }
+    for (int slot : slots) {
+        ASSERT_EQ(OK, mProducer->cancelBuffer(slot, Fence::NO_FENCE));
+    }
+
+    // All three free buffers come back in one call, without exceeding the max
+    // dequeued buffer count.
+    ASSERT_EQ(OK, mProducer->dequeueBuffers(inputs, &outputs));
+    ASSERT_EQ(3u, outputs.size());
+    for (const auto& dequeued : outputs) {
+        EXPECT_EQ(OK, dequeued.result);
+        EXPECT_EQ(nullptr, dequeued.buffer);
+    }
+    for (const auto& dequeued : outputs) {
+        ASSERT_EQ(OK, mProducer->cancelBuffer(dequeued.slot, Fence::NO_FENCE));
+    }
+}
+
 TEST_F(BufferQueueTest, TestProducerConnectDisconnect) {
     createBufferQueue();
     sp<DummyConsumer> dc(new DummyConsumer);
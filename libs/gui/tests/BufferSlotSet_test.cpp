@@ -0,0 +1,122 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gui/BufferSlotSet.h>
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+namespace android {
+
+namespace {
+
+template <typename T>
+std::vector<int> toVector(const T& slots) {
+    return std::vector<int>(slots.begin(), slots.end());
+}
+
+} // namespace
+
+TEST(BufferSlotSetTest, IteratesInSlotOrder) {
+    BufferSlotSet set;
+    EXPECT_TRUE(set.empty());
+
+    set.insert(63);
+    set.insert(5);
+    set.insert(0);
+    set.insert(5);
+    EXPECT_EQ(3u, set.size());
+    EXPECT_EQ(0, set.first());
+    EXPECT_EQ((std::vector<int>{0, 5, 63}), toVector(set));
+
+    set.erase(0);
+    set.erase(17);
+    EXPECT_EQ(5, set.first());
+    EXPECT_EQ(1u, set.count(63));
+    EXPECT_EQ(0u, set.count(0));
+
+    set.clear();
+    EXPECT_TRUE(set.empty());
+    EXPECT_EQ(set.begin(), set.end());
+}
+
+TEST(BufferSlotSetTest, IterationSurvivesModification) {
+    BufferSlotSet set;
+    for (int s = 0; s < 4; s++) {
+        set.insert(s);
+    }
+
+    std::vector<int> visited;
+    for (int s : set) {
+        visited.push_back(s);
+        set.erase(s + 1);
+    }
+    EXPECT_EQ((std::vector<int>{0, 1, 2, 3}), visited);
+    EXPECT_EQ((std::vector<int>{0}), toVector(set));
+}
+
+TEST(BufferSlotListTest, KeepsInsertionOrder) {
+    BufferSlotList list;
+    EXPECT_TRUE(list.empty());
+
+    list.push_back(3);
+    list.push_back(1);
+    list.push_front(7);
+    list.push_back(63);
+    EXPECT_EQ(4u, list.size());
+    EXPECT_EQ(7, list.front());
+    EXPECT_EQ(63, list.back());
+    EXPECT_EQ((std::vector<int>{7, 3, 1, 63}), toVector(list));
+
+    list.remove(1);
+    list.remove(42);
+    EXPECT_EQ((std::vector<int>{7, 3, 63}), toVector(list));
+    EXPECT_EQ(0u, list.count(1));
+
+    list.pop_front();
+    list.pop_back();
+    EXPECT_EQ((std::vector<int>{3}), toVector(list));
+    EXPECT_EQ(3, list.front());
+    EXPECT_EQ(3, list.back());
+
+    list.pop_back();
+    EXPECT_TRUE(list.empty());
+    EXPECT_EQ(list.begin(), list.end());
+
+    list.pop_front();
+    EXPECT_TRUE(list.empty());
+}
+
+TEST(BufferSlotListTest, ReinsertingMovesSlot) {
+    BufferSlotList list;
+    list.push_back(1);
+    list.push_back(2);
+    list.push_back(3);
+
+    list.push_back(1);
+    EXPECT_EQ((std::vector<int>{2, 3, 1}), toVector(list));
+
+    list.push_front(3);
+    EXPECT_EQ((std::vector<int>{3, 2, 1}), toVector(list));
+    EXPECT_EQ(3u, list.size());
+
+    list.clear();
+    list.push_front(2);
+    EXPECT_EQ((std::vector<int>{2}), toVector(list));
+}
+
+} // namespace android
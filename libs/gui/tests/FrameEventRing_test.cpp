@@ -0,0 +1,126 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gui/FrameEventRing.h>
+
+#include <gtest/gtest.h>
+#include <gui/FrameTimestamps.h>
+#include <system/window.h>
+#include <unistd.h>
+
+namespace android {
+
+namespace {
+
+FrameEvents makeFrame(uint64_t frameNumber) {
+    FrameEvents frame;
+    frame.valid = true;
+    frame.frameNumber = frameNumber;
+    frame.latchTime = 100;
+    frame.firstRefreshStartTime = 110;
+    frame.lastRefreshStartTime = 120;
+    return frame;
+}
+
+sp<FrameEventRing> mapReadOnly(const sp<FrameEventRing>& ring) {
+    return FrameEventRing::fromFd(base::unique_fd(dup(ring->getFd())));
+}
+
+} // namespace
+
+TEST(FrameEventRingTest, ReadsPublishedFrame) {
+    sp<FrameEventRing> writer = FrameEventRing::create();
+    ASSERT_NE(nullptr, writer.get());
+    sp<FrameEventRing> reader = mapReadOnly(writer);
+    ASSERT_NE(nullptr, reader.get());
+
+    FrameEventRing::Snapshot snapshot;
+    EXPECT_FALSE(reader->read(1, &snapshot));
+
+    FrameEvents frame = makeFrame(1);
+    writer->publish(frame);
+    ASSERT_TRUE(reader->read(1, &snapshot));
+    EXPECT_EQ(1u, snapshot.frameNumber);
+    EXPECT_EQ(100, snapshot.latchTime);
+    EXPECT_EQ(110, snapshot.firstRefreshStartTime);
+    EXPECT_EQ(120, snapshot.lastRefreshStartTime);
+    EXPECT_EQ(NATIVE_WINDOW_TIMESTAMP_PENDING, snapshot.dequeueReadyTime);
+    // No composition or release has been reported for the frame yet.
+    EXPECT_EQ(NATIVE_WINDOW_TIMESTAMP_PENDING, snapshot.gpuCompositionDoneTime);
+    EXPECT_EQ(NATIVE_WINDOW_TIMESTAMP_PENDING, snapshot.displayPresentTime);
+    EXPECT_EQ(NATIVE_WINDOW_TIMESTAMP_PENDING, snapshot.releaseTime);
+}
+
+TEST(FrameEventRingTest, ReportsFencesThatNeverSignalAsInvalid) {
+    sp<FrameEventRing> writer = FrameEventRing::create();
+    ASSERT_NE(nullptr, writer.get());
+    sp<FrameEventRing> reader = mapReadOnly(writer);
+    ASSERT_NE(nullptr, reader.get());
+
+    FrameEvents frame = makeFrame(3);
+    frame.addPostCompositeCalled = true;
+    frame.addReleaseCalled = true;
+    frame.dequeueReadyTime = 130;
+    writer->publish(frame);
+
+    FrameEventRing::Snapshot snapshot;
+    ASSERT_TRUE(reader->read(3, &snapshot));
+    EXPECT_EQ(130, snapshot.dequeueReadyTime);
+    EXPECT_EQ(NATIVE_WINDOW_TIMESTAMP_INVALID, snapshot.gpuCompositionDoneTime);
+    EXPECT_EQ(NATIVE_WINDOW_TIMESTAMP_INVALID, snapshot.displayPresentTime);
+    EXPECT_EQ(NATIVE_WINDOW_TIMESTAMP_INVALID, snapshot.releaseTime);
+}
+
+TEST(FrameEventRingTest, NewerFrameReplacesSlot) {
+    sp<FrameEventRing> writer = FrameEventRing::create();
+    ASSERT_NE(nullptr, writer.get());
+    sp<FrameEventRing> reader = mapReadOnly(writer);
+    ASSERT_NE(nullptr, reader.get());
+
+    writer->publish(makeFrame(5));
+    writer->publish(makeFrame(5 + FrameEventRing::kCapacity));
+
+    FrameEventRing::Snapshot snapshot;
+    EXPECT_FALSE(reader->read(5, &snapshot));
+    EXPECT_TRUE(reader->read(5 + FrameEventRing::kCapacity, &snapshot));
+}
+
+TEST(FrameEventRingTest, ConsumerHistoryPublishesChanges) {
+    sp<FrameEventRing> writer = FrameEventRing::create();
+    ASSERT_NE(nullptr, writer.get());
+    sp<FrameEventRing> reader = mapReadOnly(writer);
+    ASSERT_NE(nullptr, reader.get());
+
+    ConsumerFrameEventHistory history;
+    history.setFrameEventRing(writer);
+
+    NewFrameEventsEntry entry;
+    entry.frameNumber = 7;
+    history.addQueue(entry);
+    history.addLatch(7, 200);
+
+    FrameEventRing::Snapshot snapshot;
+    ASSERT_TRUE(reader->read(7, &snapshot));
+    EXPECT_EQ(200, snapshot.latchTime);
+    EXPECT_EQ(NATIVE_WINDOW_TIMESTAMP_PENDING, snapshot.firstRefreshStartTime);
+
+    history.addPreComposition(7, 210);
+    ASSERT_TRUE(reader->read(7, &snapshot));
+    EXPECT_EQ(210, snapshot.firstRefreshStartTime);
+    EXPECT_EQ(210, snapshot.lastRefreshStartTime);
+}
+
+} // namespace android
@@ -0,0 +1,80 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gui/ITransactionCompletedListener.h>
+
+#include <binder/Binder.h>
+#include <binder/Parcel.h>
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+namespace android {
+
+TEST(ListenerStatsTest, ParcelsSharedFencesOnce) {
+    int fds[2];
+    ASSERT_EQ(0, pipe(fds));
+    close(fds[1]);
+    sp<Fence> presentFence = new Fence(fds[0]);
+    sp<Fence> releaseFence = new Fence(dup(fds[0]));
+    sp<Fence> gpuFence = new Fence(dup(fds[0]));
+
+    const FrameEventHistoryStats eventStats(7, gpuFence, CompositorTiming(), 100, 200);
+    std::vector<SurfaceStats> surfaceStats;
+    surfaceStats.emplace_back(new BBinder(), 10, releaseFence, 1, eventStats);
+    surfaceStats.emplace_back(new BBinder(), 20, nullptr, 2, eventStats);
+
+    ListenerStats stats;
+    stats.transactionStats.emplace_back(std::vector<CallbackId>{1, 2}, 50, presentFence,
+                                        surfaceStats);
+    stats.transactionStats.emplace_back(std::vector<CallbackId>{3}, 60, presentFence,
+                                        std::vector<SurfaceStats>());
+    stats.transactionStats.emplace_back(std::vector<CallbackId>{4});
+
+    Parcel parcel;
+    ASSERT_EQ(NO_ERROR, stats.writeToParcel(&parcel));
+    // The present, release and GPU composition fences are each written once, along with the
+    // binders of the two surfaces.
+    EXPECT_EQ(5u, parcel.objectsCount());
+
+    parcel.setDataPosition(0);
+    ListenerStats result;
+    ASSERT_EQ(NO_ERROR, result.readFromParcel(&parcel));
+    EXPECT_EQ(parcel.dataSize(), parcel.dataPosition());
+    ASSERT_EQ(3u, result.transactionStats.size());
+
+    const auto& first = result.transactionStats[0];
+    EXPECT_EQ((std::vector<CallbackId>{1, 2}), first.callbackIds);
+    EXPECT_EQ(50, first.latchTime);
+    ASSERT_NE(nullptr, first.presentFence);
+    EXPECT_EQ(first.presentFence, result.transactionStats[1].presentFence);
+    ASSERT_EQ(2u, first.surfaceStats.size());
+    EXPECT_EQ(10, first.surfaceStats[0].acquireTime);
+    EXPECT_NE(nullptr, first.surfaceStats[0].previousReleaseFence);
+    EXPECT_EQ(nullptr, first.surfaceStats[1].previousReleaseFence);
+    EXPECT_EQ(2u, first.surfaceStats[1].transformHint);
+    EXPECT_EQ(7u, first.surfaceStats[1].eventStats.frameNumber);
+    EXPECT_EQ(200, first.surfaceStats[1].eventStats.dequeueReadyTime);
+    EXPECT_EQ(first.surfaceStats[0].eventStats.gpuCompositionDoneFence,
+              first.surfaceStats[1].eventStats.gpuCompositionDoneFence);
+
+    const auto& last = result.transactionStats[2];
+    EXPECT_EQ((std::vector<CallbackId>{4}), last.callbackIds);
+    EXPECT_EQ(-1, last.latchTime);
+    EXPECT_EQ(nullptr, last.presentFence);
+    EXPECT_TRUE(last.surfaceStats.empty());
+}
+
+} // namespace android
@@ -0,0 +1,93 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gui/LayerState.h>
+
+#include <binder/Parcel.h>
+#include <gtest/gtest.h>
+
+namespace android {
+
+TEST(LayerStateTest, ParcelsOnlyChangedFields) {
+    layer_state_t state;
+    state.what = layer_state_t::ePositionChanged | layer_state_t::eAlphaChanged;
+    state.x = 10.0f;
+    state.y = 20.0f;
+    state.alpha = 0.5f;
+    // Not parceled, as eCornerRadiusChanged is not set.
+    state.cornerRadius = 8.0f;
+
+    Parcel parcel;
+    ASSERT_EQ(NO_ERROR, state.write(parcel));
+    const size_t positionAndAlphaSize = parcel.dataSize();
+
+    parcel.setDataPosition(0);
+    layer_state_t result;
+    ASSERT_EQ(NO_ERROR, result.read(parcel));
+    EXPECT_EQ(parcel.dataSize(), parcel.dataPosition());
+    EXPECT_EQ(state.what, result.what);
+    EXPECT_EQ(10.0f, result.x);
+    EXPECT_EQ(20.0f, result.y);
+    EXPECT_EQ(0.5f, result.alpha);
+    EXPECT_EQ(0.0f, result.cornerRadius);
+
+    state.what |= layer_state_t::eCornerRadiusChanged | layer_state_t::eColorTransformChanged |
+            layer_state_t::eMatrixChanged;
+    Parcel largerParcel;
+    ASSERT_EQ(NO_ERROR, state.write(largerParcel));
+    EXPECT_LT(positionAndAlphaSize, largerParcel.dataSize());
+
+    largerParcel.setDataPosition(0);
+    ASSERT_EQ(NO_ERROR, result.read(largerParcel));
+    EXPECT_EQ(largerParcel.dataSize(), largerParcel.dataPosition());
+    EXPECT_EQ(8.0f, result.cornerRadius);
+}
+
+TEST(LayerStateTest, ParcelsListenersRegardlessOfChanges) {
+    layer_state_t state;
+    state.what = layer_state_t::eLayerChanged;
+    state.z = 3;
+    state.listeners.emplace_back(nullptr, std::vector<CallbackId>{1, 2});
+
+    Parcel parcel;
+    ASSERT_EQ(NO_ERROR, state.write(parcel));
+    parcel.setDataPosition(0);
+    layer_state_t result;
+    ASSERT_EQ(NO_ERROR, result.read(parcel));
+    EXPECT_EQ(3, result.z);
+    ASSERT_EQ(1u, result.listeners.size());
+    EXPECT_EQ((std::vector<CallbackId>{1, 2}), result.listeners[0].callbackIds);
+}
+
+TEST(LayerStateTest, ParcelsOnlyChangedDisplayFields) {
+    DisplayState state;
+    state.what = DisplayState::eDisplaySizeChanged;
+    state.width = 1080;
+    state.height = 1920;
+    state.layerStack = 7;
+
+    Parcel parcel;
+    ASSERT_EQ(NO_ERROR, state.write(parcel));
+    parcel.setDataPosition(0);
+    DisplayState result;
+    ASSERT_EQ(NO_ERROR, result.read(parcel));
+    EXPECT_EQ(parcel.dataSize(), parcel.dataPosition());
+    EXPECT_EQ(1080u, result.width);
+    EXPECT_EQ(1920u, result.height);
+    EXPECT_EQ(0u, result.layerStack);
+}
+
+} // namespace android
@@ -236,4 +236,67 @@ TEST_F(StreamSplitterTest, OutputAbandonment) {
                                            nullptr, nullptr));
 }
 
+TEST_F(StreamSplitterTest, BoundedOutputDoesNotStallOthers) {
+    const int NUM_FRAMES = 4;
+
+    sp<IGraphicBufferProducer> inputProducer;
+    sp<IGraphicBufferConsumer> inputConsumer;
+    BufferQueue::createBufferQueue(&inputProducer, &inputConsumer);
+
+    sp<IGraphicBufferProducer> fastProducer;
+    sp<IGraphicBufferConsumer> fastConsumer;
+    BufferQueue::createBufferQueue(&fastProducer, &fastConsumer);
+    ASSERT_EQ(OK, fastConsumer->consumerConnect(new DummyListener, false));
+
+    sp<IGraphicBufferProducer> slowProducer;
+    sp<IGraphicBufferConsumer> slowConsumer;
+    BufferQueue::createBufferQueue(&slowProducer, &slowConsumer);
+    ASSERT_EQ(OK, slowConsumer->consumerConnect(new DummyListener, false));
+
+    sp<StreamSplitter> splitter;
+    status_t status = StreamSplitter::createSplitter(inputConsumer, &splitter);
+    ASSERT_EQ(OK, status);
+    ASSERT_EQ(OK, splitter->addOutput(fastProducer));
+    ASSERT_EQ(OK, splitter->addOutput(slowProducer,
+            StreamSplitter::DropPolicy::Bounded, 1));
+
+    IGraphicBufferProducer::QueueBufferOutput qbOutput;
+    ASSERT_EQ(OK, inputProducer->connect(new DummyProducerListener,
+            NATIVE_WINDOW_API_CPU, false, &qbOutput));
+
+    IGraphicBufferProducer::QueueBufferInput qbInput(0, false,
+            HAL_DATASPACE_UNKNOWN, Rect(0, 0, 1, 1),
+            NATIVE_WINDOW_SCALING_MODE_FREEZE, 0, Fence::NO_FENCE);
+
+    // The slow output holds on to its first frame for the whole test. Were it
+    // a Block output, queueing the third frame would stall.
+    BufferItem slowItem;
+    for (int frame = 0; frame < NUM_FRAMES; ++frame) {
+        int slot;
+        sp<Fence> fence;
+        sp<GraphicBuffer> buffer;
+        ASSERT_LE(OK, inputProducer->dequeueBuffer(&slot, &fence, 0, 0, 0,
+                GRALLOC_USAGE_SW_WRITE_OFTEN, nullptr, nullptr));
+        ASSERT_EQ(OK, inputProducer->requestBuffer(slot, &buffer));
+        ASSERT_EQ(OK, inputProducer->queueBuffer(slot, qbInput, &qbOutput));
+
+        BufferItem item;
+        ASSERT_EQ(OK, fastConsumer->acquireBuffer(&item, 0));
+        ASSERT_EQ(OK, fastConsumer->releaseBuffer(item.mSlot, item.mFrameNumber,
+                EGL_NO_DISPLAY, EGL_NO_SYNC_KHR, Fence::NO_FENCE));
+
+        if (frame == 0) {
+            ASSERT_EQ(OK, slowConsumer->acquireBuffer(&slowItem, 0));
+        } else {
+            BufferItem dropped;
+            ASSERT_EQ(IGraphicBufferConsumer::NO_BUFFER_AVAILABLE,
+                      slowConsumer->acquireBuffer(&dropped, 0));
+        }
+    }
+
+    ASSERT_EQ(OK, slowConsumer->releaseBuffer(slowItem.mSlot,
+            slowItem.mFrameNumber, EGL_NO_DISPLAY, EGL_NO_SYNC_KHR,
+            Fence::NO_FENCE));
+}
+
 } // namespace android
@@ -341,6 +341,50 @@ TEST_F(SurfaceTest, QueryDefaultBuffersDataSpace) {
     ASSERT_EQ(TEST_DATASPACE, dataSpace);
 }
 
+TEST_F(SurfaceTest, QueryCachedConsumerProperties) {
+    sp<IGraphicBufferProducer> producer;
+    sp<IGraphicBufferConsumer> consumer;
+    BufferQueue::createBufferQueue(&producer, &consumer);
+
+    sp<DummyConsumer> dummyConsumer(new DummyConsumer);
+    consumer->consumerConnect(dummyConsumer, false);
+    consumer->setConsumerUsageBits(GRALLOC_USAGE_HW_TEXTURE);
+    consumer->setDefaultBufferDataSpace(HAL_DATASPACE_V0_SRGB);
+
+    sp<Surface> surface = new Surface(producer);
+    sp<ANativeWindow> window(surface);
+    ASSERT_EQ(NO_ERROR, native_window_api_connect(window.get(), NATIVE_WINDOW_API_CPU));
+
+    int value = -1;
+    ASSERT_EQ(NO_ERROR, window->query(window.get(), NATIVE_WINDOW_CONSUMER_USAGE_BITS, &value));
+    EXPECT_EQ(GRALLOC_USAGE_HW_TEXTURE, value);
+    ASSERT_EQ(NO_ERROR, window->query(window.get(), NATIVE_WINDOW_DEFAULT_DATASPACE, &value));
+    EXPECT_EQ(HAL_DATASPACE_V0_SRGB, value);
+    ASSERT_EQ(NO_ERROR, window->query(window.get(), NATIVE_WINDOW_CONSUMER_IS_PROTECTED, &value));
+    EXPECT_EQ(0, value);
+
+    // Changes of the consumer are seen after the next queueBuffer.
+    consumer->setConsumerUsageBits(GRALLOC_USAGE_SW_READ_OFTEN);
+    consumer->setDefaultBufferDataSpace(HAL_DATASPACE_V0_BT709);
+    consumer->setConsumerIsProtected(true);
+
+    int fence;
+    ANativeWindowBuffer* buffer;
+    ASSERT_EQ(NO_ERROR, window->dequeueBuffer(window.get(), &buffer, &fence));
+    ASSERT_EQ(NO_ERROR, window->queueBuffer(window.get(), buffer, fence));
+
+    ASSERT_EQ(NO_ERROR, window->query(window.get(), NATIVE_WINDOW_CONSUMER_USAGE_BITS, &value));
+    EXPECT_EQ(GRALLOC_USAGE_SW_READ_OFTEN, value);
+    ASSERT_EQ(NO_ERROR, window->query(window.get(), NATIVE_WINDOW_DEFAULT_DATASPACE, &value));
+    EXPECT_EQ(HAL_DATASPACE_V0_BT709, value);
+    ASSERT_EQ(NO_ERROR, window->query(window.get(), NATIVE_WINDOW_CONSUMER_IS_PROTECTED, &value));
+    EXPECT_EQ(1, value);
+
+    uint64_t usage = 0;
+    ASSERT_EQ(NO_ERROR, surface->getConsumerUsage(&usage));
+    EXPECT_EQ(static_cast<uint64_t>(GRALLOC_USAGE_SW_READ_OFTEN), usage);
+}
+
 TEST_F(SurfaceTest, SettingGenerationNumber) {
     sp<IGraphicBufferProducer> producer;
     sp<IGraphicBufferConsumer> consumer;
@@ -765,6 +809,15 @@ public:
                            sp<GraphicBuffer>* /*outBuffer*/) override {
         return NO_ERROR;
     }
+    status_t captureScreenIntoBuffer(const sp<IBinder>& /*display*/,
+                                     const sp<GraphicBuffer>& /*buffer*/,
+                                     ui::Dataspace /*reqDataspace*/, const Rect& /*sourceCrop*/,
+                                     bool /*useIdentityTransform*/, ui::Rotation,
+                                     bool /*captureSecureLayers*/,
+                                     bool& /*outCapturedSecureLayers*/,
+                                     sp<Fence>* /*outFence*/) override {
+        return NO_ERROR;
+    }
     virtual status_t captureLayers(
             const sp<IBinder>& /*parentHandle*/, sp<GraphicBuffer>* /*outBuffer*/,
             ui::Dataspace /*reqDataspace*/, ui::PixelFormat /*reqPixelFormat*/,
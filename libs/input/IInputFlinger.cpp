@@ -45,6 +45,23 @@ public:
                 IBinder::FLAG_ONEWAY);
     }
 
+    virtual void updateInputWindows(const std::vector<InputWindowInfo>& changedWindows,
+            const std::vector<int32_t>& windowIds,
+            const sp<ISetInputWindowsListener>& setInputWindowsListener) {
+        Parcel data, reply;
+        data.writeInterfaceToken(IInputFlinger::getInterfaceDescriptor());
+
+        data.writeUint32(static_cast<uint32_t>(changedWindows.size()));
+        for (const auto& info : changedWindows) {
+            info.write(data);
+        }
+        data.writeInt32Vector(windowIds);
+        data.writeStrongBinder(IInterface::asBinder(setInputWindowsListener));
+
+        remote()->transact(BnInputFlinger::UPDATE_INPUT_WINDOWS_TRANSACTION, data, &reply,
+                IBinder::FLAG_ONEWAY);
+    }
+
     virtual void registerInputChannel(const sp<InputChannel>& channel) {
         Parcel data, reply;
         data.writeInterfaceToken(IInputFlinger::getInterfaceDescriptor());
@@ -80,6 +97,26 @@ status_t BnInputFlinger::onTransact(
         setInputWindows(handles, setInputWindowsListener);
         break;
     }
+    case UPDATE_INPUT_WINDOWS_TRANSACTION: {
+        CHECK_INTERFACE(IInputFlinger, data, reply);
+        size_t count = data.readUint32();
+        if (count > data.dataSize()) {
+            return BAD_VALUE;
+        }
+        std::vector<InputWindowInfo> changedWindows;
+        for (size_t i = 0; i < count; i++) {
+            changedWindows.push_back(InputWindowInfo::read(data));
+        }
+        std::vector<int32_t> windowIds;
+        status_t result = data.readInt32Vector(&windowIds);
+        if (result != NO_ERROR) {
+            return result;
+        }
+        const sp<ISetInputWindowsListener> setInputWindowsListener =
+                ISetInputWindowsListener::asInterface(data.readStrongBinder());
+        updateInputWindows(changedWindows, windowIds, setInputWindowsListener);
+        break;
+    }
     case REGISTER_INPUT_CHANNEL_TRANSACTION: {
         CHECK_INTERFACE(IInputFlinger, data, reply);
         sp<InputChannel> channel = InputChannel::read(data);
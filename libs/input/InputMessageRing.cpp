@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "InputMessageRing"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <atomic>
+
+#include <cutils/ashmem.h>
+#include <input/InputMessageRing.h>
+#include <input/InputTransport.h>
+#include <log/log.h>
+
+namespace android {
+
+static constexpr uint32_t REGION_MAGIC = 0x49524e47; // 'IRNG'
+static constexpr uint32_t REGION_VERSION = 1;
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free,
+              "ring indices must be usable across processes");
+
+struct InputMessageRing::Region {
+    struct Slot {
+        uint32_t size;
+        uint32_t padding;
+        InputMessage message;
+    };
+
+    struct Ring {
+        // Written by the producer only.
+        alignas(64) std::atomic<uint32_t> head;
+        // Written by the consumer only.
+        alignas(64) std::atomic<uint32_t> tail;
+        // Set by the consumer when it finds the ring empty, cleared by the producer when it
+        // sends the wake-up byte.
+        std::atomic<uint32_t> readerWaiting;
+        Slot slots[SLOT_COUNT];
+    };
+
+    uint32_t magic;
+    uint32_t version;
+    // rings[0] carries server -> client messages, rings[1] client -> server.
+    Ring rings[2];
+};
+
+std::shared_ptr<InputMessageRing> InputMessageRing::create(const std::string& name) {
+    android::base::unique_fd fd(ashmem_create_region(name.c_str(), sizeof(Region)));
+    if (!fd.ok()) {
+        ALOGE("Could not create input message ring '%s': %s", name.c_str(), strerror(errno));
+        return nullptr;
+    }
+    void* addr = mmap(nullptr, sizeof(Region), PROT_READ | PROT_WRITE, MAP_SHARED, fd.get(), 0);
+    if (addr == MAP_FAILED) {
+        ALOGE("Could not map input message ring '%s': %s", name.c_str(), strerror(errno));
+        return nullptr;
+    }
+
+    // The region starts out zeroed. Both readers start out waiting, so that the first message
+    // in each direction rings the doorbell.
+    Region* region = static_cast<Region*>(addr);
+    region->magic = REGION_MAGIC;
+    region->version = REGION_VERSION;
+    for (Region::Ring& ring : region->rings) {
+        ring.readerWaiting.store(1, std::memory_order_relaxed);
+    }
+    return std::shared_ptr<InputMessageRing>(new InputMessageRing(std::move(fd), region));
+}
+
+std::shared_ptr<InputMessageRing> InputMessageRing::map(android::base::unique_fd fd) {
+    const int size = ashmem_get_size_region(fd.get());
+    if (size < 0 || static_cast<size_t>(size) < sizeof(Region)) {
+        ALOGE("Input message ring fd %d has size %d, expected %zu", fd.get(), size,
+              sizeof(Region));
+        return nullptr;
+    }
+    void* addr = mmap(nullptr, sizeof(Region), PROT_READ | PROT_WRITE, MAP_SHARED, fd.get(), 0);
+    if (addr == MAP_FAILED) {
+        ALOGE("Could not map input message ring fd %d: %s", fd.get(), strerror(errno));
+        return nullptr;
+    }
+    Region* region = static_cast<Region*>(addr);
+    if (region->magic != REGION_MAGIC || region->version != REGION_VERSION) {
+        ALOGE("Input message ring fd %d has an unexpected header", fd.get());
+        munmap(addr, sizeof(Region));
+        return nullptr;
+    }
+    return std::shared_ptr<InputMessageRing>(new InputMessageRing(std::move(fd), region));
+}
+
+InputMessageRing::InputMessageRing(android::base::unique_fd fd, Region* region)
+      : mFd(std::move(fd)), mRegion(region) {}
+
+InputMessageRing::~InputMessageRing() {
+    munmap(mRegion, sizeof(Region));
+}
+
+status_t InputMessageRing::write(Side side, const InputMessage& msg, size_t size,
+                                 bool* outWakePeer) {
+    *outWakePeer = false;
+    Region::Ring& ring = mRegion->rings[side == Side::SERVER ? 0 : 1];
+    const uint32_t head = ring.head.load(std::memory_order_relaxed);
+    const uint32_t tail = ring.tail.load(std::memory_order_acquire);
+    const uint32_t used = head - tail;
+    if (used > SLOT_COUNT) {
+        return BAD_VALUE;
+    }
+    if (used == SLOT_COUNT) {
+        return WOULD_BLOCK;
+    }
+
+    Region::Slot& slot = ring.slots[head % SLOT_COUNT];
+    slot.size = static_cast<uint32_t>(size);
+    memcpy(&slot.message, &msg, size);
+
+    // Publishing the message and checking for a waiting reader pairs with the reader setting
+    // the flag and then checking for messages, so at least one of the two sides sees the other.
+    ring.head.store(head + 1, std::memory_order_seq_cst);
+    *outWakePeer = ring.readerWaiting.exchange(0, std::memory_order_seq_cst) != 0;
+    return OK;
+}
+
+status_t InputMessageRing::read(Side side, InputMessage* msg) {
+    Region::Ring& ring = mRegion->rings[side == Side::SERVER ? 1 : 0];
+    const uint32_t tail = ring.tail.load(std::memory_order_relaxed);
+    uint32_t head = ring.head.load(std::memory_order_acquire);
+    if (head == tail) {
+        ring.readerWaiting.store(1, std::memory_order_seq_cst);
+        head = ring.head.load(std::memory_order_seq_cst);
+        if (head == tail) {
+            return WOULD_BLOCK;
+        }
+    }
+    if (head - tail > SLOT_COUNT) {
+        return BAD_VALUE;
+    }
+
+    // Copy out before validating; the writer could change the slot underneath us.
+    const Region::Slot& slot = ring.slots[tail % SLOT_COUNT];
+    const size_t size =
+            std::min<size_t>(__atomic_load_n(&slot.size, __ATOMIC_RELAXED), sizeof(InputMessage));
+    memcpy(msg, &slot.message, size);
+    ring.tail.store(tail + 1, std::memory_order_release);
+
+    if (!msg->isValid(size)) {
+        return BAD_VALUE;
+    }
+    return OK;
+}
+
+} // namespace android
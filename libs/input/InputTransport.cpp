@@ -27,6 +27,8 @@ static constexpr bool DEBUG_TRANSPORT_ACTIONS = false;
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
+
 #include <android-base/stringprintf.h>
 #include <binder/Parcel.h>
 #include <cutils/properties.h>
@@ -63,6 +65,14 @@ static const nsecs_t RESAMPLE_MAX_DELTA = 20 * NANOS_PER_MS;
 // far into the future.  This time is further bounded by 50% of the last time delta.
 static const nsecs_t RESAMPLE_MAX_PREDICTION = 8 * NANOS_PER_MS;
 
+// Maximum time to predict forward with ResampleStrategy::PREDICTIVE.  The fit uses several
+// samples, so it stays usable further out than a line through the last two, but not much
+// beyond a frame.
+static const nsecs_t RESAMPLE_MAX_PREDICTIVE_PREDICTION = 20 * NANOS_PER_MS;
+
+// VelocityTracker strategy used by ResampleStrategy::PREDICTIVE.
+static const char* RESAMPLE_PREDICTOR_STRATEGY = "lsq2";
+
 /**
  * System property for enabling / disabling touch resampling.
  * Resampling extrapolates / interpolates the reported touch event coordinates to better
@@ -75,6 +85,14 @@ static const nsecs_t RESAMPLE_MAX_PREDICTION = 8 * NANOS_PER_MS;
  */
 static const char* PROPERTY_RESAMPLING_ENABLED = "ro.input.resampling";
 
+/**
+ * System property for moving input messages into shared memory.
+ * Set to "1" to have InputChannel::openInputChannelPair() pass messages through an
+ * InputMessageRing, with the socket only used for wake-ups.
+ * Sockets are used by default.
+ */
+static const char* PROPERTY_SHARED_MEMORY_CHANNELS = "ro.input.shared_memory_channels";
+
 template<typename T>
 inline static T min(const T& a, const T& b) {
     return a < b ? a : b;
@@ -84,6 +102,14 @@ inline static float lerp(float a, float b, float alpha) {
     return a + alpha * (b - a);
 }
 
+inline static float evaluatePolynomial(const float* coeff, uint32_t degree, float t) {
+    float value = 0;
+    for (uint32_t i = degree + 1; i > 0; i--) {
+        value = value * t + coeff[i - 1];
+    }
+    return value;
+}
+
 inline static bool isPointerEvent(int32_t source) {
     return (source & AINPUT_SOURCE_CLASS_POINTER) == AINPUT_SOURCE_CLASS_POINTER;
 }
@@ -105,6 +131,9 @@ bool InputMessage::isValid(size_t actualSize) const {
                 return true;
             case Type::FOCUS:
                 return true;
+            case Type::FINISHED_BATCH:
+                return body.finishedBatch.seqCount > 0 &&
+                        body.finishedBatch.seqCount <= MAX_FINISHED_BATCH_SEQS;
         }
     }
     return false;
@@ -120,6 +149,12 @@ size_t InputMessage::size() const {
             return sizeof(Header) + body.finished.size();
         case Type::FOCUS:
             return sizeof(Header) + body.focus.size();
+        case Type::FINISHED_BATCH:
+            // Clamp so a corrupt count can't make us read past the message.
+            if (body.finishedBatch.seqCount > MAX_FINISHED_BATCH_SEQS) {
+                return sizeof(Header) + sizeof(Body::FinishedBatch);
+            }
+            return sizeof(Header) + body.finishedBatch.size();
     }
     return sizeof(Header);
 }
@@ -243,6 +278,13 @@ void InputMessage::getSanitizedCopy(InputMessage* msg) const {
             msg->body.focus.inTouchMode = body.focus.inTouchMode;
             break;
         }
+        case InputMessage::Type::FINISHED_BATCH: {
+            msg->body.finishedBatch.handled = body.finishedBatch.handled;
+            msg->body.finishedBatch.seqCount = body.finishedBatch.seqCount;
+            memcpy(msg->body.finishedBatch.seqs, body.finishedBatch.seqs,
+                   body.finishedBatch.seqCount * sizeof(body.finishedBatch.seqs[0]));
+            break;
+        }
     }
 }
 
@@ -250,17 +292,29 @@ void InputMessage::getSanitizedCopy(InputMessage* msg) const {
 
 sp<InputChannel> InputChannel::create(const std::string& name, android::base::unique_fd fd,
                                       sp<IBinder> token) {
+    return create(name, std::move(fd), token, nullptr, InputMessageRing::Side::SERVER);
+}
+
+sp<InputChannel> InputChannel::create(const std::string& name, android::base::unique_fd fd,
+                                      sp<IBinder> token, std::shared_ptr<InputMessageRing> ring,
+                                      InputMessageRing::Side ringSide) {
     const int result = fcntl(fd, F_SETFL, O_NONBLOCK);
     if (result != 0) {
         LOG_ALWAYS_FATAL("channel '%s' ~ Could not make socket non-blocking: %s", name.c_str(),
                          strerror(errno));
         return nullptr;
     }
-    return new InputChannel(name, std::move(fd), token);
+    return new InputChannel(name, std::move(fd), token, std::move(ring), ringSide);
 }
 
-InputChannel::InputChannel(const std::string& name, android::base::unique_fd fd, sp<IBinder> token)
-      : mName(name), mFd(std::move(fd)), mToken(token) {
+InputChannel::InputChannel(const std::string& name, android::base::unique_fd fd, sp<IBinder> token,
+                           std::shared_ptr<InputMessageRing> ring,
+                           InputMessageRing::Side ringSide)
+      : mName(name),
+        mFd(std::move(fd)),
+        mToken(token),
+        mRing(std::move(ring)),
+        mRingSide(ringSide) {
     if (DEBUG_CHANNEL_LIFECYCLE) {
         ALOGD("Input channel constructed: name='%s', fd=%d", mName.c_str(), mFd.get());
     }
@@ -274,6 +328,13 @@ InputChannel::~InputChannel() {
 
 status_t InputChannel::openInputChannelPair(const std::string& name,
         sp<InputChannel>& outServerChannel, sp<InputChannel>& outClientChannel) {
+    return openInputChannelPair(name, outServerChannel, outClientChannel,
+                                property_get_bool(PROPERTY_SHARED_MEMORY_CHANNELS, false));
+}
+
+status_t InputChannel::openInputChannelPair(const std::string& name,
+        sp<InputChannel>& outServerChannel, sp<InputChannel>& outClientChannel,
+        bool useSharedMemory) {
     int sockets[2];
     if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sockets)) {
         status_t result = -errno;
@@ -292,13 +353,21 @@ status_t InputChannel::openInputChannelPair(const std::string& name,
 
     sp<IBinder> token = new BBinder();
 
+    // Fall back to sockets if shared memory can't be set up; both ends follow the server.
+    std::shared_ptr<InputMessageRing> ring;
+    if (useSharedMemory) {
+        ring = InputMessageRing::create(name);
+    }
+
     std::string serverChannelName = name + " (server)";
     android::base::unique_fd serverFd(sockets[0]);
-    outServerChannel = InputChannel::create(serverChannelName, std::move(serverFd), token);
+    outServerChannel = InputChannel::create(serverChannelName, std::move(serverFd), token, ring,
+                                            InputMessageRing::Side::SERVER);
 
     std::string clientChannelName = name + " (client)";
     android::base::unique_fd clientFd(sockets[1]);
-    outClientChannel = InputChannel::create(clientChannelName, std::move(clientFd), token);
+    outClientChannel = InputChannel::create(clientChannelName, std::move(clientFd), token, ring,
+                                            InputMessageRing::Side::CLIENT);
     return OK;
 }
 
@@ -306,6 +375,19 @@ status_t InputChannel::sendMessage(const InputMessage* msg) {
     const size_t msgLength = msg->size();
     InputMessage cleanMsg;
     msg->getSanitizedCopy(&cleanMsg);
+    if (mRing != nullptr) {
+        bool wakePeer;
+        status_t status = mRing->write(mRingSide, cleanMsg, msgLength, &wakePeer);
+        if (status == OK && wakePeer) {
+            status = sendWakeSignal();
+        }
+#if DEBUG_CHANNEL_MESSAGES
+        ALOGD("channel '%s' ~ wrote message of type %d to shared memory, status=%d",
+              mName.c_str(), msg->header.type, status);
+#endif
+        return status;
+    }
+
     ssize_t nWrite;
     do {
         nWrite = ::send(mFd.get(), &cleanMsg, msgLength, MSG_DONTWAIT | MSG_NOSIGNAL);
@@ -341,6 +423,21 @@ status_t InputChannel::sendMessage(const InputMessage* msg) {
 }
 
 status_t InputChannel::receiveMessage(InputMessage* msg) {
+    if (mRing != nullptr) {
+        status_t status = mRing->read(mRingSide, msg);
+        if (status != WOULD_BLOCK) {
+            return status;
+        }
+        // The ring is empty. Consume the wake-ups so the fd stops polling as readable, and
+        // notice if the peer went away. A message may have landed while draining, and its
+        // wake-up byte may be among the ones just consumed, so look once more.
+        status = drainWakeSignals();
+        if (status != OK) {
+            return status;
+        }
+        return mRing->read(mRingSide, msg);
+    }
+
     ssize_t nRead;
     do {
         nRead = ::recv(mFd.get(), msg, sizeof(InputMessage), MSG_DONTWAIT);
@@ -380,6 +477,51 @@ status_t InputChannel::receiveMessage(InputMessage* msg) {
     return OK;
 }
 
+status_t InputChannel::sendWakeSignal() {
+    const uint8_t signal = 0;
+    ssize_t nWrite;
+    do {
+        nWrite = ::send(mFd.get(), &signal, sizeof(signal), MSG_DONTWAIT | MSG_NOSIGNAL);
+    } while (nWrite == -1 && errno == EINTR);
+
+    if (nWrite < 0) {
+        int error = errno;
+        if (error == EAGAIN || error == EWOULDBLOCK) {
+            // The socket is full of wake-ups the peer hasn't read yet; it will wake up anyway.
+            return OK;
+        }
+        if (error == EPIPE || error == ENOTCONN || error == ECONNREFUSED || error == ECONNRESET) {
+            return DEAD_OBJECT;
+        }
+        return -error;
+    }
+    return OK;
+}
+
+status_t InputChannel::drainWakeSignals() {
+    uint8_t signals[16];
+    for (;;) {
+        ssize_t nRead;
+        do {
+            nRead = ::recv(mFd.get(), signals, sizeof(signals), MSG_DONTWAIT);
+        } while (nRead == -1 && errno == EINTR);
+
+        if (nRead < 0) {
+            int error = errno;
+            if (error == EAGAIN || error == EWOULDBLOCK) {
+                return OK;
+            }
+            if (error == EPIPE || error == ENOTCONN || error == ECONNREFUSED) {
+                return DEAD_OBJECT;
+            }
+            return -error;
+        }
+        if (nRead == 0) { // check for EOF
+            return DEAD_OBJECT;
+        }
+    }
+}
+
 sp<InputChannel> InputChannel::dup() const {
     android::base::unique_fd newFd(::dup(getFd()));
     if (!newFd.ok()) {
@@ -394,7 +536,7 @@ sp<InputChannel> InputChannel::dup() const {
                             getName().c_str());
         return nullptr;
     }
-    return InputChannel::create(mName, std::move(newFd), mToken);
+    return InputChannel::create(mName, std::move(newFd), mToken, mRing, mRingSide);
 }
 
 status_t InputChannel::write(Parcel& out) const {
@@ -409,6 +551,19 @@ status_t InputChannel::write(Parcel& out) const {
     }
 
     s = out.writeUniqueFileDescriptor(mFd);
+    if (s != OK) {
+        return s;
+    }
+
+    s = out.writeBool(mRing != nullptr);
+    if (s != OK || mRing == nullptr) {
+        return s;
+    }
+    s = out.writeBool(mRingSide == InputMessageRing::Side::SERVER);
+    if (s != OK) {
+        return s;
+    }
+    s = out.writeDupFileDescriptor(mRing->getFd());
     return s;
 }
 
@@ -421,7 +576,21 @@ sp<InputChannel> InputChannel::read(const Parcel& from) {
         return nullptr;
     }
 
-    return InputChannel::create(name, std::move(rawFd), token);
+    if (!from.readBool()) {
+        return InputChannel::create(name, std::move(rawFd), token);
+    }
+    const InputMessageRing::Side ringSide =
+            from.readBool() ? InputMessageRing::Side::SERVER : InputMessageRing::Side::CLIENT;
+    android::base::unique_fd ringFd;
+    if (from.readUniqueFileDescriptor(&ringFd) != OK) {
+        return nullptr;
+    }
+    // The peer is already writing to shared memory, so there is no falling back to the socket.
+    std::shared_ptr<InputMessageRing> ring = InputMessageRing::map(std::move(ringFd));
+    if (ring == nullptr) {
+        return nullptr;
+    }
+    return InputChannel::create(name, std::move(rawFd), token, std::move(ring), ringSide);
 }
 
 sp<IBinder> InputChannel::getConnectionToken() const {
@@ -431,7 +600,7 @@ sp<IBinder> InputChannel::getConnectionToken() const {
 // --- InputPublisher ---
 
 InputPublisher::InputPublisher(const sp<InputChannel>& channel) :
-        mChannel(channel) {
+        mChannel(channel), mPendingFinishedIndex(0), mPendingFinishedHandled(false) {
 }
 
 InputPublisher::~InputPublisher() {
@@ -577,27 +746,65 @@ status_t InputPublisher::receiveFinishedSignal(uint32_t* outSeq, bool* outHandle
         ALOGD("channel '%s' publisher ~ receiveFinishedSignal", mChannel->getName().c_str());
     }
 
+    if (mPendingFinishedIndex == mPendingFinishedSeqs.size()) {
+        mPendingFinishedSeqs.clear();
+        mPendingFinishedIndex = 0;
+        status_t result = receiveFinishedSignals(&mPendingFinishedSeqs, &mPendingFinishedHandled);
+        if (result) {
+            *outSeq = 0;
+            *outHandled = false;
+            return result;
+        }
+    }
+    *outSeq = mPendingFinishedSeqs[mPendingFinishedIndex++];
+    *outHandled = mPendingFinishedHandled;
+    return OK;
+}
+
+status_t InputPublisher::receiveFinishedSignals(std::vector<uint32_t>* outSeqs,
+                                                bool* outHandled) {
+    if (DEBUG_TRANSPORT_ACTIONS) {
+        ALOGD("channel '%s' publisher ~ receiveFinishedSignals", mChannel->getName().c_str());
+    }
+
+    // Hand back whatever receiveFinishedSignal() has not returned yet first, to keep the order.
+    if (mPendingFinishedIndex < mPendingFinishedSeqs.size()) {
+        outSeqs->insert(outSeqs->end(), mPendingFinishedSeqs.begin() + mPendingFinishedIndex,
+                        mPendingFinishedSeqs.end());
+        *outHandled = mPendingFinishedHandled;
+        mPendingFinishedSeqs.clear();
+        mPendingFinishedIndex = 0;
+        return OK;
+    }
+
     InputMessage msg;
     status_t result = mChannel->receiveMessage(&msg);
     if (result) {
-        *outSeq = 0;
         *outHandled = false;
         return result;
     }
-    if (msg.header.type != InputMessage::Type::FINISHED) {
-        ALOGE("channel '%s' publisher ~ Received unexpected message of type %d from consumer",
-                mChannel->getName().c_str(), msg.header.type);
-        return UNKNOWN_ERROR;
+    switch (msg.header.type) {
+        case InputMessage::Type::FINISHED:
+            outSeqs->push_back(msg.body.finished.seq);
+            *outHandled = msg.body.finished.handled == 1;
+            return OK;
+        case InputMessage::Type::FINISHED_BATCH:
+            outSeqs->insert(outSeqs->end(), msg.body.finishedBatch.seqs,
+                            msg.body.finishedBatch.seqs + msg.body.finishedBatch.seqCount);
+            *outHandled = msg.body.finishedBatch.handled == 1;
+            return OK;
+        default:
+            ALOGE("channel '%s' publisher ~ Received unexpected message of type %d from consumer",
+                  mChannel->getName().c_str(), msg.header.type);
+            return UNKNOWN_ERROR;
     }
-    *outSeq = msg.body.finished.seq;
-    *outHandled = msg.body.finished.handled == 1;
-    return OK;
 }
 
 // --- InputConsumer ---
 
 InputConsumer::InputConsumer(const sp<InputChannel>& channel) :
         mResampleTouch(isTouchResamplingEnabled()),
+        mResampleStrategy(ResampleStrategy::LINEAR), mPresentLatency(0),
         mChannel(channel), mMsgDeferred(false) {
 }
 
@@ -608,6 +815,11 @@ bool InputConsumer::isTouchResamplingEnabled() {
     return property_get_bool(PROPERTY_RESAMPLING_ENABLED, true);
 }
 
+void InputConsumer::setResampleStrategy(ResampleStrategy strategy, nsecs_t presentLatency) {
+    mResampleStrategy = strategy;
+    mPresentLatency = presentLatency > 0 ? presentLatency : 0;
+}
+
 status_t InputConsumer::consume(InputEventFactoryInterface* factory, bool consumeBatches,
                                 nsecs_t frameTime, uint32_t* outSeq, InputEvent** outEvent) {
     if (DEBUG_TRANSPORT_ACTIONS) {
@@ -727,7 +939,8 @@ status_t InputConsumer::consume(InputEventFactoryInterface* factory, bool consum
                 break;
             }
 
-            case InputMessage::Type::FINISHED: {
+            case InputMessage::Type::FINISHED:
+            case InputMessage::Type::FINISHED_BATCH: {
                 LOG_ALWAYS_FATAL("Consumed a FINISHED message, which should never be seen by "
                                  "InputConsumer!");
                 break;
@@ -833,6 +1046,17 @@ void InputConsumer::updateTouchState(InputMessage& msg) {
         TouchState& touchState = mTouchStates.editItemAt(index);
         touchState.initialize(deviceId, source);
         touchState.addHistory(msg);
+        if (mResampleStrategy == ResampleStrategy::PREDICTIVE) {
+            if (touchState.predictor == nullptr) {
+                touchState.predictor =
+                        std::make_shared<VelocityTracker>(RESAMPLE_PREDICTOR_STRATEGY);
+            } else {
+                touchState.predictor->clear();
+            }
+            addPredictorMovement(touchState, msg);
+        } else {
+            touchState.predictor = nullptr;
+        }
         break;
     }
 
@@ -841,6 +1065,7 @@ void InputConsumer::updateTouchState(InputMessage& msg) {
         if (index >= 0) {
             TouchState& touchState = mTouchStates.editItemAt(index);
             touchState.addHistory(msg);
+            addPredictorMovement(touchState, msg);
             rewriteMessage(touchState, msg);
         }
         break;
@@ -851,6 +1076,12 @@ void InputConsumer::updateTouchState(InputMessage& msg) {
         if (index >= 0) {
             TouchState& touchState = mTouchStates.editItemAt(index);
             touchState.lastResample.idBits.clearBit(msg.body.motion.getActionId());
+            if (touchState.predictor != nullptr) {
+                // The id may have belonged to an earlier pointer.
+                BitSet32 idBits;
+                idBits.markBit(msg.body.motion.getActionId());
+                touchState.predictor->clearPointers(idBits);
+            }
             rewriteMessage(touchState, msg);
         }
         break;
@@ -888,6 +1119,29 @@ void InputConsumer::updateTouchState(InputMessage& msg) {
     }
 }
 
+void InputConsumer::addPredictorMovement(TouchState& state, const InputMessage& msg) {
+    if (state.predictor == nullptr) {
+        return;
+    }
+    // VelocityTracker wants the positions ordered by increasing pointer id.
+    BitSet32 idBits;
+    int32_t idToIndex[MAX_POINTER_ID + 1];
+    for (uint32_t i = 0; i < msg.body.motion.pointerCount; i++) {
+        uint32_t id = msg.body.motion.pointers[i].properties.id;
+        idBits.markBit(id);
+        idToIndex[id] = i;
+    }
+    VelocityTracker::Position positions[MAX_POINTERS];
+    size_t count = 0;
+    for (BitSet32 remaining(idBits); !remaining.isEmpty(); count++) {
+        const PointerCoords& coords =
+                msg.body.motion.pointers[idToIndex[remaining.clearFirstMarkedBit()]].coords;
+        positions[count].x = coords.getX();
+        positions[count].y = coords.getY();
+    }
+    state.predictor->addMovement(msg.body.motion.eventTime, idBits, positions);
+}
+
 /**
  * Replace the coordinates in msg with the coordinates in lastResample, if necessary.
  *
@@ -963,6 +1217,8 @@ void InputConsumer::resampleTouchState(nsecs_t sampleTime, MotionEvent* event,
     const History* other;
     History future;
     float alpha;
+    // Set when extrapolating with a fit over the recent samples rather than along a line.
+    const VelocityTracker* predictor = nullptr;
     if (next) {
         // Interpolate between current sample and future sample.
         // So current->eventTime <= sampleTime <= future.eventTime.
@@ -992,7 +1248,15 @@ void InputConsumer::resampleTouchState(nsecs_t sampleTime, MotionEvent* event,
 #endif
             return;
         }
-        nsecs_t maxPredict = current->eventTime + min(delta / 2, RESAMPLE_MAX_PREDICTION);
+        predictor = touchState.predictor.get();
+        nsecs_t maxPredict;
+        if (predictor) {
+            // Aim for when the frame reaches the display instead of trailing the frame time.
+            sampleTime += RESAMPLE_LATENCY + mPresentLatency;
+            maxPredict = current->eventTime + RESAMPLE_MAX_PREDICTIVE_PREDICTION;
+        } else {
+            maxPredict = current->eventTime + min(delta / 2, RESAMPLE_MAX_PREDICTION);
+        }
         if (sampleTime > maxPredict) {
 #if DEBUG_RESAMPLING
             ALOGD("Sample time is too far in the future, adjusting prediction "
@@ -1033,7 +1297,20 @@ void InputConsumer::resampleTouchState(nsecs_t sampleTime, MotionEvent* event,
         PointerCoords& resampledCoords = touchState.lastResample.pointers[i];
         const PointerCoords& currentCoords = current->getPointerById(id);
         resampledCoords.copyFrom(currentCoords);
-        if (other->idBits.hasBit(id)
+        VelocityTracker::Estimator estimator;
+        if (predictor && shouldResampleTool(event->getToolType(i))
+                && predictor->getEstimator(id, &estimator) && estimator.degree >= 1) {
+            const float t = (sampleTime - estimator.time) * 0.000000001f;
+            resampledCoords.setAxisValue(AMOTION_EVENT_AXIS_X,
+                    evaluatePolynomial(estimator.xCoeff, estimator.degree, t));
+            resampledCoords.setAxisValue(AMOTION_EVENT_AXIS_Y,
+                    evaluatePolynomial(estimator.yCoeff, estimator.degree, t));
+#if DEBUG_RESAMPLING
+            ALOGD("[%d] - out (%0.3f, %0.3f), cur (%0.3f, %0.3f), predicted %0.3f s ahead, "
+                    "degree %u", id, resampledCoords.getX(), resampledCoords.getY(),
+                    currentCoords.getX(), currentCoords.getY(), t, estimator.degree);
+#endif
+        } else if (other->idBits.hasBit(id)
                 && shouldResampleTool(event->getToolType(i))) {
             const PointerCoords& otherCoords = other->getPointerById(id);
             resampledCoords.setAxisValue(AMOTION_EVENT_AXIS_X,
@@ -1076,42 +1353,47 @@ status_t InputConsumer::sendFinishedSignal(uint32_t seq, bool handled) {
         return BAD_VALUE;
     }
 
-    // Send finished signals for the batch sequence chain first.
+    // Collect the batch sequence chain, oldest first, followed by the last message in the batch.
     size_t seqChainCount = mSeqChains.size();
-    if (seqChainCount) {
-        uint32_t currentSeq = seq;
-        uint32_t chainSeqs[seqChainCount];
-        size_t chainIndex = 0;
-        for (size_t i = seqChainCount; i > 0; ) {
-             i--;
-             const SeqChain& seqChain = mSeqChains.itemAt(i);
-             if (seqChain.seq == currentSeq) {
-                 currentSeq = seqChain.chain;
-                 chainSeqs[chainIndex++] = currentSeq;
-                 mSeqChains.removeAt(i);
-             }
-        }
-        status_t status = OK;
-        while (!status && chainIndex > 0) {
-            chainIndex--;
-            status = sendUnchainedFinishedSignal(chainSeqs[chainIndex], handled);
+    if (!seqChainCount) {
+        return sendUnchainedFinishedSignal(seq, handled);
+    }
+    uint32_t seqs[seqChainCount + 1];
+    size_t seqCount = seqChainCount + 1;
+    size_t chainIndex = seqCount - 1;
+    seqs[chainIndex] = seq;
+    uint32_t currentSeq = seq;
+    for (size_t i = seqChainCount; i > 0; ) {
+         i--;
+         const SeqChain& seqChain = mSeqChains.itemAt(i);
+         if (seqChain.seq == currentSeq) {
+             currentSeq = seqChain.chain;
+             seqs[--chainIndex] = currentSeq;
+             mSeqChains.removeAt(i);
+         }
+    }
+
+    // Acknowledge the whole batch with as few messages as possible.
+    status_t status = OK;
+    size_t sent = chainIndex;
+    while (!status && sent < seqCount) {
+        const size_t count = std::min(seqCount - sent, InputMessage::MAX_FINISHED_BATCH_SEQS);
+        status = count == 1 ? sendUnchainedFinishedSignal(seqs[sent], handled)
+                            : sendFinishedSignalBatch(&seqs[sent], count, handled);
+        if (!status) {
+            sent += count;
         }
-        if (status) {
-            // An error occurred so at least one signal was not sent, reconstruct the chain.
-            for (;;) {
-                SeqChain seqChain;
-                seqChain.seq = chainIndex != 0 ? chainSeqs[chainIndex - 1] : seq;
-                seqChain.chain = chainSeqs[chainIndex];
-                mSeqChains.push(seqChain);
-                if (!chainIndex) break;
-                chainIndex--;
-            }
-            return status;
+    }
+    if (status) {
+        // An error occurred so at least one signal was not sent, reconstruct the chain.
+        for (size_t i = sent; i + 1 < seqCount; i++) {
+            SeqChain seqChain;
+            seqChain.seq = seqs[i + 1];
+            seqChain.chain = seqs[i];
+            mSeqChains.push(seqChain);
         }
     }
-
-    // Send finished signal for the last message in the batch.
-    return sendUnchainedFinishedSignal(seq, handled);
+    return status;
 }
 
 status_t InputConsumer::sendUnchainedFinishedSignal(uint32_t seq, bool handled) {
@@ -1122,6 +1404,16 @@ status_t InputConsumer::sendUnchainedFinishedSignal(uint32_t seq, bool handled)
     return mChannel->sendMessage(&msg);
 }
 
+status_t InputConsumer::sendFinishedSignalBatch(const uint32_t* seqs, size_t seqCount,
+                                                bool handled) {
+    InputMessage msg;
+    msg.header.type = InputMessage::Type::FINISHED_BATCH;
+    msg.body.finishedBatch.handled = handled ? 1 : 0;
+    msg.body.finishedBatch.seqCount = seqCount;
+    memcpy(msg.body.finishedBatch.seqs, seqs, seqCount * sizeof(seqs[0]));
+    return mChannel->sendMessage(&msg);
+}
+
 bool InputConsumer::hasDeferredEvent() const {
     return mMsgDeferred;
 }
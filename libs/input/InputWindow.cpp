@@ -65,6 +65,28 @@ bool InputWindowInfo::overlaps(const InputWindowInfo* other) const {
             && frameTop < other->frameBottom && frameBottom > other->frameTop;
 }
 
+bool InputWindowInfo::operator==(const InputWindowInfo& info) const {
+    return info.token == token && info.id == id && info.name == name &&
+            info.layoutParamsFlags == layoutParamsFlags &&
+            info.layoutParamsType == layoutParamsType &&
+            info.dispatchingTimeout == dispatchingTimeout && info.frameLeft == frameLeft &&
+            info.frameTop == frameTop && info.frameRight == frameRight &&
+            info.frameBottom == frameBottom && info.surfaceInset == surfaceInset &&
+            info.globalScaleFactor == globalScaleFactor && info.windowXScale == windowXScale &&
+            info.windowYScale == windowYScale && info.visible == visible &&
+            info.canReceiveKeys == canReceiveKeys && info.hasFocus == hasFocus &&
+            info.hasWallpaper == hasWallpaper && info.paused == paused &&
+            info.ownerPid == ownerPid && info.ownerUid == ownerUid &&
+            info.inputFeatures == inputFeatures && info.displayId == displayId &&
+            info.portalToDisplayId == portalToDisplayId &&
+            info.applicationInfo.token == applicationInfo.token &&
+            info.applicationInfo.name == applicationInfo.name &&
+            info.applicationInfo.dispatchingTimeout == applicationInfo.dispatchingTimeout &&
+            info.touchableRegion.hasSameRects(touchableRegion) &&
+            info.replaceTouchableRegionWithCrop == replaceTouchableRegionWithCrop &&
+            info.touchableRegionCropHandle == touchableRegionCropHandle;
+}
+
 status_t InputWindowInfo::write(Parcel& output) const {
     if (name.empty()) {
         output.writeInt32(0);
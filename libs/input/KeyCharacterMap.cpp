@@ -18,6 +18,7 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 
 #ifdef __ANDROID__
 #include <binder/Parcel.h>
@@ -33,6 +34,9 @@
 #include <utils/Tokenizer.h>
 #include <utils/Timers.h>
 
+#include <map>
+#include <mutex>
+
 // Enables debug output for the parser.
 #define DEBUG_PARSER 0
 
@@ -83,6 +87,48 @@ static String8 toString(const char16_t* chars, size_t numChars) {
 #endif
 
 
+// --- Load cache ---
+
+// Loaded maps are immutable, so devices that use the same file in the same format share one
+// instance for as long as any of them holds on to it, rather than parsing the file again.
+struct CachedKeyCharacterMap {
+    struct stat fileStat;
+    wp<KeyCharacterMap> map;
+};
+
+static std::mutex gLoadCacheLock;
+static std::map<std::pair<std::string, KeyCharacterMap::Format>, CachedKeyCharacterMap>
+        gLoadCache;
+
+static bool isSameFile(const struct stat& a, const struct stat& b) {
+    return a.st_dev == b.st_dev && a.st_ino == b.st_ino && a.st_size == b.st_size &&
+            a.st_mtim.tv_sec == b.st_mtim.tv_sec && a.st_mtim.tv_nsec == b.st_mtim.tv_nsec;
+}
+
+static sp<KeyCharacterMap> findCachedMap(const std::string& filename,
+                                         KeyCharacterMap::Format format,
+                                         const struct stat& fileStat) {
+    std::scoped_lock _l(gLoadCacheLock);
+    auto it = gLoadCache.find(std::make_pair(filename, format));
+    if (it == gLoadCache.end() || !isSameFile(it->second.fileStat, fileStat)) {
+        return nullptr;
+    }
+    return it->second.map.promote();
+}
+
+static void cacheMap(const std::string& filename, KeyCharacterMap::Format format,
+                     const struct stat& fileStat, const sp<KeyCharacterMap>& map) {
+    std::scoped_lock _l(gLoadCacheLock);
+    for (auto it = gLoadCache.begin(); it != gLoadCache.end();) {
+        if (it->second.map.promote() == nullptr) {
+            it = gLoadCache.erase(it);
+        } else {
+            it++;
+        }
+    }
+    gLoadCache[std::make_pair(filename, format)] = {fileStat, map};
+}
+
 // --- KeyCharacterMap ---
 
 sp<KeyCharacterMap> KeyCharacterMap::sEmpty = new KeyCharacterMap();
@@ -93,7 +139,7 @@ KeyCharacterMap::KeyCharacterMap() :
 
 KeyCharacterMap::KeyCharacterMap(const KeyCharacterMap& other) :
     RefBase(), mType(other.mType), mKeysByScanCode(other.mKeysByScanCode),
-    mKeysByUsageCode(other.mKeysByUsageCode) {
+    mKeysByUsageCode(other.mKeysByUsageCode), mKeysByCharacter(other.mKeysByCharacter) {
     for (size_t i = 0; i < other.mKeys.size(); i++) {
         mKeys.add(other.mKeys.keyAt(i), new Key(*other.mKeys.valueAt(i)));
     }
@@ -110,6 +156,16 @@ status_t KeyCharacterMap::load(const std::string& filename,
         Format format, sp<KeyCharacterMap>* outMap) {
     outMap->clear();
 
+    struct stat fileStat;
+    const bool haveFileStat = stat(filename.c_str(), &fileStat) == 0;
+    if (haveFileStat) {
+        sp<KeyCharacterMap> map = findCachedMap(filename, format, fileStat);
+        if (map != nullptr) {
+            *outMap = map;
+            return OK;
+        }
+    }
+
     Tokenizer* tokenizer;
     status_t status = Tokenizer::open(String8(filename.c_str()), &tokenizer);
     if (status) {
@@ -117,6 +173,9 @@ status_t KeyCharacterMap::load(const std::string& filename,
     } else {
         status = load(tokenizer, format, outMap);
         delete tokenizer;
+        if (!status && haveFileStat) {
+            cacheMap(filename, format, fileStat, *outMap);
+        }
     }
     return status;
 }
@@ -156,6 +215,7 @@ status_t KeyCharacterMap::load(Tokenizer* tokenizer,
                 elapsedTime / 1000000.0);
 #endif
         if (!status) {
+            map->buildKeysByCharacter();
             *outMap = map;
         }
     }
@@ -193,6 +253,7 @@ sp<KeyCharacterMap> KeyCharacterMap::combine(const sp<KeyCharacterMap>& base,
         map->mKeysByUsageCode.replaceValueFor(overlay->mKeysByUsageCode.keyAt(i),
                 overlay->mKeysByUsageCode.valueAt(i));
     }
+    map->buildKeysByCharacter();
     return map;
 }
 
@@ -299,6 +360,8 @@ bool KeyCharacterMap::getEvents(int32_t deviceId, const char16_t* chars, size_t
         Vector<KeyEvent>& outEvents) const {
     nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
 
+    // Every character takes at least a down and an up event.
+    outEvents.setCapacity(outEvents.size() + numChars * 2);
     for (size_t i = 0; i < numChars; i++) {
         int32_t keyCode, metaState;
         char16_t ch = chars[i];
@@ -463,24 +526,34 @@ bool KeyCharacterMap::findKey(char16_t ch, int32_t* outKeyCode, int32_t* outMeta
         return false;
     }
 
-    for (size_t i = 0; i < mKeys.size(); i++) {
-        const Key* key = mKeys.valueAt(i);
+    auto it = mKeysByCharacter.find(ch);
+    if (it == mKeysByCharacter.end()) {
+        return false;
+    }
+    *outKeyCode = it->second.keyCode;
+    *outMetaState = it->second.metaState;
+    return true;
+}
 
-        // Try to find the most general behavior that maps to this character.
-        // For example, the base key behavior will usually be last in the list.
-        const Behavior* found = nullptr;
-        for (const Behavior* behavior = key->firstBehavior; behavior; behavior = behavior->next) {
-            if (behavior->character == ch) {
-                found = behavior;
+void KeyCharacterMap::buildKeysByCharacter() {
+    mKeysByCharacter.clear();
+    // Keys are visited in key code order and the first key that generates a character wins.
+    // Within that key, use the most general behavior that maps to the character. For example,
+    // the base key behavior will usually be last in the list.
+    for (size_t i = 0; i < mKeys.size(); i++) {
+        const int32_t keyCode = mKeys.keyAt(i);
+        for (const Behavior* behavior = mKeys.valueAt(i)->firstBehavior; behavior;
+             behavior = behavior->next) {
+            if (!behavior->character) {
+                continue;
+            }
+            auto [it, inserted] = mKeysByCharacter.try_emplace(
+                    behavior->character, KeyForCharacter{keyCode, behavior->metaState});
+            if (!inserted && it->second.keyCode == keyCode) {
+                it->second.metaState = behavior->metaState;
             }
-        }
-        if (found) {
-            *outKeyCode = mKeys.keyAt(i);
-            *outMetaState = found->metaState;
-            return true;
         }
     }
-    return false;
 }
 
 void KeyCharacterMap::addKey(Vector<KeyEvent>& outEvents,
@@ -652,6 +725,7 @@ sp<KeyCharacterMap> KeyCharacterMap::readFromParcel(Parcel* parcel) {
             return nullptr;
         }
     }
+    map->buildKeysByCharacter();
     return map;
 }
 
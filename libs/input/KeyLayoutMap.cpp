@@ -17,6 +17,7 @@
 #define LOG_TAG "KeyLayoutMap"
 
 #include <stdlib.h>
+#include <sys/stat.h>
 
 #include <android/keycodes.h>
 #include <input/InputEventLabels.h>
@@ -27,6 +28,9 @@
 #include <utils/Tokenizer.h>
 #include <utils/Timers.h>
 
+#include <map>
+#include <mutex>
+
 // Enables debug output for the parser.
 #define DEBUG_PARSER 0
 
@@ -41,6 +45,46 @@ namespace android {
 
 static const char* WHITESPACE = " \t\r";
 
+// --- Load cache ---
+
+// Every device that uses a layout file would otherwise parse it again, which adds up when
+// many devices are added at once. Loaded maps are immutable, so devices that share a file
+// share one instance for as long as any of them holds on to it.
+struct CachedKeyLayoutMap {
+    struct stat fileStat;
+    wp<KeyLayoutMap> map;
+};
+
+static std::mutex gLoadCacheLock;
+static std::map<std::string, CachedKeyLayoutMap> gLoadCache;
+
+static bool isSameFile(const struct stat& a, const struct stat& b) {
+    return a.st_dev == b.st_dev && a.st_ino == b.st_ino && a.st_size == b.st_size &&
+            a.st_mtim.tv_sec == b.st_mtim.tv_sec && a.st_mtim.tv_nsec == b.st_mtim.tv_nsec;
+}
+
+static sp<KeyLayoutMap> findCachedMap(const std::string& filename, const struct stat& fileStat) {
+    std::scoped_lock _l(gLoadCacheLock);
+    auto it = gLoadCache.find(filename);
+    if (it == gLoadCache.end() || !isSameFile(it->second.fileStat, fileStat)) {
+        return nullptr;
+    }
+    return it->second.map.promote();
+}
+
+static void cacheMap(const std::string& filename, const struct stat& fileStat,
+                     const sp<KeyLayoutMap>& map) {
+    std::scoped_lock _l(gLoadCacheLock);
+    for (auto it = gLoadCache.begin(); it != gLoadCache.end();) {
+        if (it->second.map.promote() == nullptr) {
+            it = gLoadCache.erase(it);
+        } else {
+            it++;
+        }
+    }
+    gLoadCache[filename] = {fileStat, map};
+}
+
 // --- KeyLayoutMap ---
 
 KeyLayoutMap::KeyLayoutMap() {
@@ -52,6 +96,16 @@ KeyLayoutMap::~KeyLayoutMap() {
 status_t KeyLayoutMap::load(const std::string& filename, sp<KeyLayoutMap>* outMap) {
     outMap->clear();
 
+    struct stat fileStat;
+    const bool haveFileStat = stat(filename.c_str(), &fileStat) == 0;
+    if (haveFileStat) {
+        sp<KeyLayoutMap> map = findCachedMap(filename, fileStat);
+        if (map != nullptr) {
+            *outMap = map;
+            return NO_ERROR;
+        }
+    }
+
     Tokenizer* tokenizer;
     status_t status = Tokenizer::open(String8(filename.c_str()), &tokenizer);
     if (status) {
@@ -75,6 +129,9 @@ status_t KeyLayoutMap::load(const std::string& filename, sp<KeyLayoutMap>* outMa
 #endif
             if (!status) {
                 *outMap = map;
+                if (haveFileStat) {
+                    cacheMap(filename, fileStat, map);
+                }
             }
         }
         delete tokenizer;
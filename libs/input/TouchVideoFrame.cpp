@@ -21,13 +21,14 @@ namespace android {
 
 TouchVideoFrame::TouchVideoFrame(uint32_t height, uint32_t width, std::vector<int16_t> data,
         const struct timeval& timestamp) :
-         mHeight(height), mWidth(width),mData(std::move(data)), mTimestamp(timestamp) {
+         mHeight(height), mWidth(width),
+         mData(std::make_shared<std::vector<int16_t>>(std::move(data))), mTimestamp(timestamp) {
 }
 
 bool TouchVideoFrame::operator==(const TouchVideoFrame& rhs) const {
     return mHeight == rhs.mHeight
             && mWidth == rhs.mWidth
-            && mData == rhs.mData
+            && (mData == rhs.mData || *mData == *rhs.mData)
             && mTimestamp.tv_sec == rhs.mTimestamp.tv_sec
             && mTimestamp.tv_usec == rhs.mTimestamp.tv_usec;
 }
@@ -36,10 +37,17 @@ uint32_t TouchVideoFrame::getHeight() const { return mHeight; }
 
 uint32_t TouchVideoFrame::getWidth() const { return mWidth; }
 
-const std::vector<int16_t>& TouchVideoFrame::getData() const { return mData; }
+const std::vector<int16_t>& TouchVideoFrame::getData() const { return *mData; }
 
 const struct timeval& TouchVideoFrame::getTimestamp() const { return mTimestamp; }
 
+std::vector<int16_t>& TouchVideoFrame::editData() {
+    if (mData.use_count() > 1) {
+        mData = std::make_shared<std::vector<int16_t>>(*mData);
+    }
+    return *mData;
+}
+
 void TouchVideoFrame::rotate(int32_t orientation) {
     switch (orientation) {
         case DISPLAY_ORIENTATION_90:
@@ -63,7 +71,8 @@ void TouchVideoFrame::rotate(int32_t orientation) {
  *     An element at position (i, j) is rotated to (width - j - 1, i)
  */
 void TouchVideoFrame::rotateQuarterTurn(bool clockwise) {
-    std::vector<int16_t> rotated(mData.size());
+    const std::vector<int16_t>& data = *mData;
+    std::vector<int16_t> rotated(data.size());
     for (size_t i = 0; i < mHeight; i++) {
         for (size_t j = 0; j < mWidth; j++) {
             size_t iRotated, jRotated;
@@ -75,10 +84,11 @@ void TouchVideoFrame::rotateQuarterTurn(bool clockwise) {
                 jRotated = i;
             }
             size_t indexRotated = iRotated * mHeight + jRotated;
-            rotated[indexRotated] = mData[i * mWidth + j];
+            rotated[indexRotated] = data[i * mWidth + j];
         }
     }
-    mData = std::move(rotated);
+    // Other frames sharing the old data keep it; this one takes the rotated copy.
+    mData = std::make_shared<std::vector<int16_t>>(std::move(rotated));
     std::swap(mHeight, mWidth);
 }
 
@@ -89,12 +99,13 @@ void TouchVideoFrame::rotateQuarterTurn(bool clockwise) {
  * we can just swap elements [i] and [height * width - i - 1].
  */
 void TouchVideoFrame::rotate180() {
-    if (mData.size() == 0) {
+    if (mData->size() == 0) {
         return;
     }
+    std::vector<int16_t>& data = editData();
     // Just need to swap elements i and (height * width - 1 - i)
-    for (size_t i = 0; i < mData.size() / 2; i++) {
-        std::swap(mData[i], mData[mHeight * mWidth - 1 - i]);
+    for (size_t i = 0; i < data.size() / 2; i++) {
+        std::swap(data[i], data[mHeight * mWidth - 1 - i]);
     }
 }
 
@@ -198,4 +198,82 @@ TEST_F(InputChannelTest, SendAndReceive_MotionClassification) {
 }
 
 
+TEST_F(InputChannelTest, SharedMemory_SendAndReceiveInBothDirections) {
+    sp<InputChannel> serverChannel, clientChannel;
+    status_t result = InputChannel::openInputChannelPair("channel name",
+            serverChannel, clientChannel, true /*useSharedMemory*/);
+    ASSERT_EQ(OK, result)
+            << "should have successfully opened a channel pair";
+    ASSERT_TRUE(serverChannel->usesSharedMemory());
+    ASSERT_TRUE(clientChannel->usesSharedMemory());
+
+    InputMessage serverMsg = {}, clientMsg;
+    serverMsg.header.type = InputMessage::Type::KEY;
+    serverMsg.body.key.seq = 7;
+    serverMsg.body.key.action = AKEY_EVENT_ACTION_DOWN;
+    EXPECT_EQ(OK, serverChannel->sendMessage(&serverMsg))
+            << "server channel should be able to send message to client channel";
+    EXPECT_EQ(OK, clientChannel->receiveMessage(&clientMsg))
+            << "client channel should be able to receive message from server channel";
+    EXPECT_EQ(serverMsg.header.type, clientMsg.header.type);
+    EXPECT_EQ(serverMsg.body.key.seq, clientMsg.body.key.seq);
+    EXPECT_EQ(serverMsg.body.key.action, clientMsg.body.key.action);
+
+    InputMessage clientReply = {}, serverReply;
+    clientReply.header.type = InputMessage::Type::FINISHED;
+    clientReply.body.finished.seq = 7;
+    clientReply.body.finished.handled = true;
+    EXPECT_EQ(OK, clientChannel->sendMessage(&clientReply))
+            << "client channel should be able to send message to server channel";
+    EXPECT_EQ(OK, serverChannel->receiveMessage(&serverReply))
+            << "server channel should be able to receive message from client channel";
+    EXPECT_EQ(clientReply.header.type, serverReply.header.type);
+    EXPECT_EQ(clientReply.body.finished.seq, serverReply.body.finished.seq);
+    EXPECT_EQ(clientReply.body.finished.handled, serverReply.body.finished.handled);
+
+    EXPECT_EQ(WOULD_BLOCK, clientChannel->receiveMessage(&clientMsg))
+            << "receiveMessage should have returned WOULD_BLOCK once the ring is drained";
+    EXPECT_EQ(WOULD_BLOCK, serverChannel->receiveMessage(&serverReply))
+            << "receiveMessage should have returned WOULD_BLOCK once the ring is drained";
+}
+
+TEST_F(InputChannelTest, SharedMemory_WhenRingIsFull_ReturnsWouldBlock) {
+    sp<InputChannel> serverChannel, clientChannel;
+    status_t result = InputChannel::openInputChannelPair("channel name",
+            serverChannel, clientChannel, true /*useSharedMemory*/);
+    ASSERT_EQ(OK, result)
+            << "should have successfully opened a channel pair";
+    ASSERT_TRUE(serverChannel->usesSharedMemory());
+
+    InputMessage msg = {};
+    msg.header.type = InputMessage::Type::KEY;
+    for (size_t i = 0; i < InputMessageRing::SLOT_COUNT; i++) {
+        msg.body.key.seq = i + 1;
+        ASSERT_EQ(OK, serverChannel->sendMessage(&msg)) << "message " << i;
+    }
+    EXPECT_EQ(WOULD_BLOCK, serverChannel->sendMessage(&msg))
+            << "sendMessage should have returned WOULD_BLOCK on a full ring";
+
+    // Messages come out in order, and reading one frees a slot.
+    InputMessage received;
+    ASSERT_EQ(OK, clientChannel->receiveMessage(&received));
+    EXPECT_EQ(1u, received.body.key.seq);
+    EXPECT_EQ(OK, serverChannel->sendMessage(&msg));
+}
+
+TEST_F(InputChannelTest, SharedMemory_ReceiveWhenPeerClosed_ReturnsAnError) {
+    sp<InputChannel> serverChannel, clientChannel;
+    status_t result = InputChannel::openInputChannelPair("channel name",
+            serverChannel, clientChannel, true /*useSharedMemory*/);
+    ASSERT_EQ(OK, result)
+            << "should have successfully opened a channel pair";
+    ASSERT_TRUE(clientChannel->usesSharedMemory());
+
+    serverChannel.clear(); // close server channel
+
+    InputMessage msg;
+    EXPECT_EQ(DEAD_OBJECT, clientChannel->receiveMessage(&msg))
+            << "receiveMessage should have returned DEAD_OBJECT";
+}
+
 } // namespace android
@@ -21,6 +21,7 @@
 #include <time.h>
 
 #include <cutils/ashmem.h>
+#include <cutils/properties.h>
 #include <gtest/gtest.h>
 #include <input/InputTransport.h>
 #include <utils/Timers.h>
@@ -62,6 +63,8 @@ protected:
     void PublishAndConsumeKeyEvent();
     void PublishAndConsumeMotionEvent();
     void PublishAndConsumeFocusEvent();
+    void PublishAndConsumeBatchedMoves(const std::vector<uint32_t>& seqs,
+                                       uint32_t* outConsumeSeq);
 };
 
 TEST_F(InputPublisherAndConsumerTest, GetChannel_ReturnsTheChannel) {
@@ -394,4 +397,121 @@ TEST_F(InputPublisherAndConsumerTest, PublishMultipleEvents_EndToEnd) {
     ASSERT_NO_FATAL_FAILURE(PublishAndConsumeKeyEvent());
 }
 
+
+void InputPublisherAndConsumerTest::PublishAndConsumeBatchedMoves(
+        const std::vector<uint32_t>& seqs, uint32_t* outConsumeSeq) {
+    PointerProperties pointerProperties;
+    pointerProperties.clear();
+    pointerProperties.toolType = AMOTION_EVENT_TOOL_TYPE_FINGER;
+    PointerCoords pointerCoords;
+    pointerCoords.clear();
+
+    nsecs_t eventTime = 0;
+    for (uint32_t seq : seqs) {
+        eventTime += 1000;
+        pointerCoords.setAxisValue(AMOTION_EVENT_AXIS_X, eventTime);
+        status_t status =
+                mPublisher->publishMotionEvent(seq, InputEvent::nextId(), 1,
+                                               AINPUT_SOURCE_TOUCHSCREEN, ADISPLAY_ID_DEFAULT,
+                                               INVALID_HMAC, AMOTION_EVENT_ACTION_MOVE, 0, 0, 0,
+                                               0, 0, MotionClassification::NONE, 1 /* xScale */,
+                                               1 /* yScale */, 0, 0, 0, 0,
+                                               AMOTION_EVENT_INVALID_CURSOR_POSITION,
+                                               AMOTION_EVENT_INVALID_CURSOR_POSITION, 0,
+                                               eventTime, 1, &pointerProperties, &pointerCoords);
+        ASSERT_EQ(OK, status) << "publisher publishMotionEvent should return OK";
+    }
+
+    InputEvent* event;
+    status_t status =
+            mConsumer->consume(&mEventFactory, true /*consumeBatches*/, -1, outConsumeSeq, &event);
+    ASSERT_EQ(OK, status) << "consumer consume should return OK";
+    ASSERT_EQ(AINPUT_EVENT_TYPE_MOTION, event->getType());
+    EXPECT_EQ(seqs.back(), *outConsumeSeq);
+    EXPECT_EQ(seqs.size() - 1, static_cast<MotionEvent*>(event)->getHistorySize());
+}
+
+TEST_F(InputPublisherAndConsumerTest, SendFinishedSignal_ForBatch_AcknowledgesAllSeqsAtOnce) {
+    const std::vector<uint32_t> seqs = {4, 5, 6};
+    uint32_t consumeSeq;
+    ASSERT_NO_FATAL_FAILURE(PublishAndConsumeBatchedMoves(seqs, &consumeSeq));
+
+    ASSERT_EQ(OK, mConsumer->sendFinishedSignal(consumeSeq, true));
+
+    std::vector<uint32_t> finishedSeqs;
+    bool handled = false;
+    ASSERT_EQ(OK, mPublisher->receiveFinishedSignals(&finishedSeqs, &handled));
+    EXPECT_EQ(seqs, finishedSeqs)
+            << "a single finished message should acknowledge the whole batch, oldest first";
+    EXPECT_TRUE(handled);
+
+    finishedSeqs.clear();
+    EXPECT_EQ(WOULD_BLOCK, mPublisher->receiveFinishedSignals(&finishedSeqs, &handled));
+    EXPECT_TRUE(finishedSeqs.empty());
+}
+
+TEST_F(InputPublisherAndConsumerTest, ReceiveFinishedSignal_ForBatch_ReturnsSeqsOneAtATime) {
+    const std::vector<uint32_t> seqs = {7, 8, 9};
+    uint32_t consumeSeq;
+    ASSERT_NO_FATAL_FAILURE(PublishAndConsumeBatchedMoves(seqs, &consumeSeq));
+
+    ASSERT_EQ(OK, mConsumer->sendFinishedSignal(consumeSeq, false));
+
+    for (uint32_t seq : seqs) {
+        uint32_t finishedSeq = 0;
+        bool handled = true;
+        ASSERT_EQ(OK, mPublisher->receiveFinishedSignal(&finishedSeq, &handled));
+        EXPECT_EQ(seq, finishedSeq);
+        EXPECT_FALSE(handled);
+    }
+
+    uint32_t finishedSeq;
+    bool handled;
+    EXPECT_EQ(WOULD_BLOCK, mPublisher->receiveFinishedSignal(&finishedSeq, &handled));
+}
+
+
+TEST_F(InputPublisherAndConsumerTest, ResampleStrategyPredictive_PredictsTouchAtPresentTime) {
+    if (!property_get_bool("ro.input.resampling", true)) {
+        GTEST_SKIP() << "Touch resampling is disabled on this device";
+    }
+    mConsumer->setResampleStrategy(InputConsumer::ResampleStrategy::PREDICTIVE, ms2ns(8));
+
+    PointerProperties pointerProperties;
+    pointerProperties.clear();
+    pointerProperties.toolType = AMOTION_EVENT_TOOL_TYPE_FINGER;
+    PointerCoords pointerCoords;
+    pointerCoords.clear();
+
+    // The finger moves right at 1 pixel per millisecond, reported every 10 ms.
+    MotionEvent* motionEvent = nullptr;
+    for (uint32_t i = 0; i <= 4; i++) {
+        const nsecs_t eventTime = ms2ns(10 * i);
+        pointerCoords.setAxisValue(AMOTION_EVENT_AXIS_X, 10 * i);
+        const int32_t action = i == 0 ? AMOTION_EVENT_ACTION_DOWN : AMOTION_EVENT_ACTION_MOVE;
+        status_t status =
+                mPublisher->publishMotionEvent(i + 1, InputEvent::nextId(), 1,
+                                               AINPUT_SOURCE_TOUCHSCREEN, ADISPLAY_ID_DEFAULT,
+                                               INVALID_HMAC, action, 0, 0, 0, 0, 0,
+                                               MotionClassification::NONE, 1 /* xScale */,
+                                               1 /* yScale */, 0, 0, 0, 0,
+                                               AMOTION_EVENT_INVALID_CURSOR_POSITION,
+                                               AMOTION_EVENT_INVALID_CURSOR_POSITION, 0,
+                                               eventTime, 1, &pointerProperties, &pointerCoords);
+        ASSERT_EQ(OK, status) << "publisher publishMotionEvent should return OK";
+
+        uint32_t consumeSeq;
+        InputEvent* event;
+        status = mConsumer->consume(&mEventFactory, true /*consumeBatches*/,
+                                    eventTime + ms2ns(5), &consumeSeq, &event);
+        ASSERT_EQ(OK, status) << "consumer consume should return OK";
+        ASSERT_EQ(AINPUT_EVENT_TYPE_MOTION, event->getType());
+        motionEvent = static_cast<MotionEvent*>(event);
+    }
+
+    // The frame starts 5 ms after the last sample and is presented 8 ms later.
+    EXPECT_EQ(ms2ns(53), motionEvent->getEventTime());
+    EXPECT_NEAR(53, motionEvent->getRawX(0), 0.5);
+}
+
 } // namespace android
@@ -99,5 +99,36 @@ TEST(InputWindowInfo, Parcelling) {
     ASSERT_EQ(i.touchableRegionCropHandle, i2.touchableRegionCropHandle);
 }
 
+TEST(InputWindowInfo, Equality) {
+    InputWindowInfo i;
+    i.token = new BBinder();
+    i.id = 1;
+    i.name = "Foobar";
+    i.frameRight = 100;
+    i.frameBottom = 200;
+    i.addTouchableRegion(Rect(0, 0, 100, 200));
+    i.applicationInfo.name = "Application";
+
+    InputWindowInfo i2 = i;
+    ASSERT_TRUE(i == i2);
+
+    i2.frameRight = 50;
+    ASSERT_FALSE(i == i2);
+
+    i2 = i;
+    i2.touchableRegion.clear();
+    ASSERT_FALSE(i == i2);
+
+    i2 = i;
+    i2.applicationInfo.name = "OtherApplication";
+    ASSERT_TRUE(i != i2);
+
+    // Equal windows stay equal across parcelling
+    Parcel p;
+    i.write(p);
+    p.setDataPosition(0);
+    ASSERT_TRUE(i == InputWindowInfo::read(p));
+}
+
 } // namespace test
 } // namespace android
@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <android-base/file.h>
+#include <android/keycodes.h>
+#include <gtest/gtest.h>
+#include <input/KeyCharacterMap.h>
+#include <input/KeyLayoutMap.h>
+
+namespace android {
+
+// --- KeyLayoutMapTest ---
+
+TEST(KeyLayoutMapTest, Load_SameFile_SharesMap) {
+    TemporaryFile file;
+    ASSERT_TRUE(base::WriteStringToFile("key 30 A\n", file.path));
+
+    sp<KeyLayoutMap> first;
+    ASSERT_EQ(OK, KeyLayoutMap::load(file.path, &first));
+    sp<KeyLayoutMap> second;
+    ASSERT_EQ(OK, KeyLayoutMap::load(file.path, &second));
+    ASSERT_EQ(first, second);
+}
+
+TEST(KeyLayoutMapTest, Load_ModifiedFile_ParsesAgain) {
+    TemporaryFile file;
+    ASSERT_TRUE(base::WriteStringToFile("key 30 A\n", file.path));
+    sp<KeyLayoutMap> first;
+    ASSERT_EQ(OK, KeyLayoutMap::load(file.path, &first));
+
+    ASSERT_TRUE(base::WriteStringToFile("key 30 BUTTON_A\n", file.path));
+    sp<KeyLayoutMap> second;
+    ASSERT_EQ(OK, KeyLayoutMap::load(file.path, &second));
+
+    ASSERT_NE(first, second);
+    int32_t keyCode;
+    uint32_t flags;
+    ASSERT_EQ(OK, second->mapKey(30, 0, &keyCode, &flags));
+    ASSERT_EQ(AKEYCODE_BUTTON_A, keyCode);
+}
+
+// --- KeyCharacterMapTest ---
+
+TEST(KeyCharacterMapTest, Load_SameFileAndFormat_SharesMap) {
+    TemporaryFile file;
+    ASSERT_TRUE(base::WriteStringToFile("type FULL\nkey A {\n    label: 'A'\n}\n", file.path));
+
+    sp<KeyCharacterMap> first;
+    ASSERT_EQ(OK, KeyCharacterMap::load(file.path, KeyCharacterMap::FORMAT_BASE, &first));
+    sp<KeyCharacterMap> second;
+    ASSERT_EQ(OK, KeyCharacterMap::load(file.path, KeyCharacterMap::FORMAT_BASE, &second));
+    ASSERT_EQ(first, second);
+
+    sp<KeyCharacterMap> any;
+    ASSERT_EQ(OK, KeyCharacterMap::load(file.path, KeyCharacterMap::FORMAT_ANY, &any));
+    ASSERT_NE(first, any);
+}
+
+TEST(KeyCharacterMapTest, GetEvents_UsesFirstKeyAndMostGeneralBehavior) {
+    sp<KeyCharacterMap> map;
+    ASSERT_EQ(OK,
+              KeyCharacterMap::loadContents("test.kcm",
+                                            "type FULL\n"
+                                            "key A {\n"
+                                            "    base: 'a'\n"
+                                            "    shift: 'A'\n"
+                                            "}\n"
+                                            "key B {\n"
+                                            "    base: 'b'\n"
+                                            "    shift: 'A'\n"
+                                            "}\n",
+                                            KeyCharacterMap::FORMAT_BASE, &map));
+
+    const char16_t chars[] = {u'b', u'A'};
+    Vector<KeyEvent> events;
+    ASSERT_TRUE(map->getEvents(/*deviceId*/ 1, chars, 2, events));
+
+    ASSERT_EQ(6u, events.size());
+    ASSERT_EQ(AKEYCODE_B, events[0].getKeyCode());
+    ASSERT_EQ(AKEYCODE_B, events[1].getKeyCode());
+    ASSERT_EQ(AKEYCODE_SHIFT_LEFT, events[2].getKeyCode());
+    ASSERT_EQ(AKEYCODE_A, events[3].getKeyCode());
+    ASSERT_EQ(AMETA_SHIFT_ON | AMETA_SHIFT_LEFT_ON, events[3].getMetaState());
+    ASSERT_EQ(AKEYCODE_SHIFT_LEFT, events[5].getKeyCode());
+
+    const char16_t unmapped[] = {u'z'};
+    ASSERT_FALSE(map->getEvents(/*deviceId*/ 1, unmapped, 1, events));
+}
+
+} // namespace android
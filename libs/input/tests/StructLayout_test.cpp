@@ -82,6 +82,10 @@ void TestInputMessageAlignment() {
 
   CHECK_OFFSET(InputMessage::Body::Finished, seq, 0);
   CHECK_OFFSET(InputMessage::Body::Finished, handled, 4);
+
+  CHECK_OFFSET(InputMessage::Body::FinishedBatch, handled, 0);
+  CHECK_OFFSET(InputMessage::Body::FinishedBatch, seqCount, 4);
+  CHECK_OFFSET(InputMessage::Body::FinishedBatch, seqs, 8);
 }
 
 void TestHeaderSize() {
@@ -99,6 +103,9 @@ void TestBodySize() {
                           sizeof(InputMessage::Body::Motion::Pointer) * MAX_POINTERS);
     static_assert(sizeof(InputMessage::Body::Finished) == 8);
     static_assert(sizeof(InputMessage::Body::Focus) == 16);
+    static_assert(sizeof(InputMessage::Body::FinishedBatch) ==
+                  offsetof(InputMessage::Body::FinishedBatch, seqs) +
+                          sizeof(uint32_t) * InputMessage::MAX_FINISHED_BATCH_SEQS);
 }
 
 // --- VerifiedInputEvent ---
@@ -38,6 +38,19 @@ TEST(TouchVideoFrame, Constructor) {
     ASSERT_EQ(TIMESTAMP.tv_usec, frame.getTimestamp().tv_usec);
 }
 
+TEST(TouchVideoFrame, Copy_SharesDataUntilModified) {
+    const std::vector<int16_t> data = {1, 2, 3, 4, 5, 6};
+    TouchVideoFrame frame(3, 2, data, TIMESTAMP);
+
+    TouchVideoFrame copy = frame;
+    ASSERT_EQ(frame.getData().data(), copy.getData().data());
+
+    copy.rotate(DISPLAY_ORIENTATION_180);
+    ASSERT_NE(frame.getData().data(), copy.getData().data());
+    ASSERT_EQ(data, frame.getData());
+    ASSERT_EQ(std::vector<int16_t>({6, 5, 4, 3, 2, 1}), copy.getData());
+}
+
 TEST(TouchVideoFrame, Equality) {
     const std::vector<int16_t> data = {1, 2, 3, 4, 5, 6};
     constexpr uint32_t height = 3;
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <input/VelocityTracker.h>
+
+namespace android {
+
+// Touch samples arrive every 8 ms, roughly the rate of a 120 Hz digitizer.
+static constexpr nsecs_t SAMPLE_INTERVAL = 8 * 1000000;
+
+static void addSample(VelocityTracker& tracker, nsecs_t eventTime, size_t pointerCount) {
+    BitSet32 idBits;
+    VelocityTracker::Position positions[MAX_POINTERS];
+    for (size_t i = 0; i < pointerCount; i++) {
+        idBits.markBit(i);
+        // A fling that decelerates.
+        const float t = eventTime * 0.000000001f;
+        positions[i].x = 100 * i + 2000 * t - 1500 * t * t;
+        positions[i].y = 50 * i + 1000 * t - 700 * t * t;
+    }
+    tracker.addMovement(eventTime, idBits, positions);
+}
+
+// A new sample followed by a velocity query for each pointer, as during a drag.
+static void benchmarkAddMovementAndGetVelocity(benchmark::State& state, const char* strategy) {
+    const size_t pointerCount = state.range(0);
+    VelocityTracker tracker(strategy);
+    nsecs_t eventTime = 0;
+    for (auto _ : state) {
+        addSample(tracker, eventTime, pointerCount);
+        eventTime += SAMPLE_INTERVAL;
+        for (size_t i = 0; i < pointerCount; i++) {
+            float vx, vy;
+            tracker.getVelocity(i, &vx, &vy);
+            benchmark::DoNotOptimize(vx);
+            benchmark::DoNotOptimize(vy);
+        }
+    }
+}
+
+static void benchmarkLsq2(benchmark::State& state) {
+    benchmarkAddMovementAndGetVelocity(state, "lsq2");
+}
+
+static void benchmarkWlsq2Recent(benchmark::State& state) {
+    benchmarkAddMovementAndGetVelocity(state, "wlsq2-recent");
+}
+
+// Repeated queries without new samples, as when an app calls computeCurrentVelocity() and
+// reads each pointer's velocity several times while handling a single ACTION_UP.
+static void benchmarkLsq2RepeatedQueries(benchmark::State& state) {
+    VelocityTracker tracker("lsq2");
+    for (nsecs_t eventTime = 0; eventTime < 20 * SAMPLE_INTERVAL; eventTime += SAMPLE_INTERVAL) {
+        addSample(tracker, eventTime, 1);
+    }
+    for (auto _ : state) {
+        float vx, vy;
+        tracker.getVelocity(0, &vx, &vy);
+        benchmark::DoNotOptimize(vx);
+        benchmark::DoNotOptimize(vy);
+    }
+}
+
+BENCHMARK(benchmarkLsq2)->Arg(1)->Arg(2)->Arg(5);
+BENCHMARK(benchmarkWlsq2Recent)->Arg(1)->Arg(2)->Arg(5);
+BENCHMARK(benchmarkLsq2RepeatedQueries);
+
+} // namespace android
+
+BENCHMARK_MAIN();
@@ -224,6 +224,66 @@ CONSTEXPR MATRIX PURE fastInverse3(const MATRIX& x) {
     return inverted;
 }
 
+//------------------------------------------------------------------------------
+// 4x4 matrix inverse using the Laplace expansion theorem: the determinant and
+// the adjugate are computed from the 2x2 sub-determinants of the upper two
+// and the lower two rows. This avoids the branches and the O(n^3) divisions of
+// the Gauss-Jordan elimination, and only divides once.
+// See "The Laplace Expansion Theorem: Computing the Determinants and Inverses
+// of Matrices" by David Eberly.
+template <typename MATRIX>
+CONSTEXPR MATRIX PURE fastInverse4(const MATRIX& x) {
+    typedef typename MATRIX::value_type T;
+
+    // Since inverse(transpose(m)) == transpose(inverse(m)), the expansion
+    // below can work directly on the column-major storage: element (i, j)
+    // of the inverse is written to inverted[i][j] when reading x[i][j] as
+    // element (i, j) of the input.
+
+    MATRIX inverted(MATRIX::NO_INIT);
+
+    // 2x2 sub-determinants of the first two "rows"
+    const T s0 = x[0][0] * x[1][1] - x[1][0] * x[0][1];
+    const T s1 = x[0][0] * x[1][2] - x[1][0] * x[0][2];
+    const T s2 = x[0][0] * x[1][3] - x[1][0] * x[0][3];
+    const T s3 = x[0][1] * x[1][2] - x[1][1] * x[0][2];
+    const T s4 = x[0][1] * x[1][3] - x[1][1] * x[0][3];
+    const T s5 = x[0][2] * x[1][3] - x[1][2] * x[0][3];
+
+    // 2x2 sub-determinants of the last two "rows"
+    const T c0 = x[2][0] * x[3][1] - x[3][0] * x[2][1];
+    const T c1 = x[2][0] * x[3][2] - x[3][0] * x[2][2];
+    const T c2 = x[2][0] * x[3][3] - x[3][0] * x[2][3];
+    const T c3 = x[2][1] * x[3][2] - x[3][1] * x[2][2];
+    const T c4 = x[2][1] * x[3][3] - x[3][1] * x[2][3];
+    const T c5 = x[2][2] * x[3][3] - x[3][2] * x[2][3];
+
+    const T det(s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0);
+    const T invDet(T(1) / det);
+
+    inverted[0][0] = ( x[1][1] * c5 - x[1][2] * c4 + x[1][3] * c3) * invDet;
+    inverted[0][1] = (-x[0][1] * c5 + x[0][2] * c4 - x[0][3] * c3) * invDet;
+    inverted[0][2] = ( x[3][1] * s5 - x[3][2] * s4 + x[3][3] * s3) * invDet;
+    inverted[0][3] = (-x[2][1] * s5 + x[2][2] * s4 - x[2][3] * s3) * invDet;
+
+    inverted[1][0] = (-x[1][0] * c5 + x[1][2] * c2 - x[1][3] * c1) * invDet;
+    inverted[1][1] = ( x[0][0] * c5 - x[0][2] * c2 + x[0][3] * c1) * invDet;
+    inverted[1][2] = (-x[3][0] * s5 + x[3][2] * s2 - x[3][3] * s1) * invDet;
+    inverted[1][3] = ( x[2][0] * s5 - x[2][2] * s2 + x[2][3] * s1) * invDet;
+
+    inverted[2][0] = ( x[1][0] * c4 - x[1][1] * c2 + x[1][3] * c0) * invDet;
+    inverted[2][1] = (-x[0][0] * c4 + x[0][1] * c2 - x[0][3] * c0) * invDet;
+    inverted[2][2] = ( x[3][0] * s4 - x[3][1] * s2 + x[3][3] * s0) * invDet;
+    inverted[2][3] = (-x[2][0] * s4 + x[2][1] * s2 - x[2][3] * s0) * invDet;
+
+    inverted[3][0] = (-x[1][0] * c3 + x[1][1] * c1 - x[1][2] * c0) * invDet;
+    inverted[3][1] = ( x[0][0] * c3 - x[0][1] * c1 + x[0][2] * c0) * invDet;
+    inverted[3][2] = (-x[3][0] * s3 + x[3][1] * s1 - x[3][2] * s0) * invDet;
+    inverted[3][3] = ( x[2][0] * s3 - x[2][1] * s1 + x[2][2] * s0) * invDet;
+
+    return inverted;
+}
+
 /**
  * Inversion function which switches on the matrix size.
  * @warning This function assumes the matrix is invertible. The result is
@@ -235,7 +295,8 @@ inline constexpr MATRIX PURE inverse(const MATRIX& matrix) {
     static_assert(MATRIX::NUM_ROWS == MATRIX::NUM_COLS, "only square matrices can be inverted");
     return (MATRIX::NUM_ROWS == 2) ? fastInverse2<MATRIX>(matrix) :
           ((MATRIX::NUM_ROWS == 3) ? fastInverse3<MATRIX>(matrix) :
-                    gaussJordanInverse<MATRIX>(matrix));
+          ((MATRIX::NUM_ROWS == 4) ? fastInverse4<MATRIX>(matrix) :
+                    gaussJordanInverse<MATRIX>(matrix)));
 }
 
 template<typename MATRIX_R, typename MATRIX_A, typename MATRIX_B>
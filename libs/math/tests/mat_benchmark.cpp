@@ -0,0 +1,114 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <math/mat4.h>
+#include <math/vec4.h>
+
+using namespace android;
+
+namespace {
+
+// A typical model-view transform: a rotation, a scale and a translation.
+mat4 makeTransform() {
+    return mat4::translate(vec4(1.5f, -2.0f, 3.25f, 1.0f)) *
+           mat4::rotate(0.7f, vec3(0.2f, 0.9f, -0.4f)) *
+           mat4::scale(vec4(2.0f, 0.5f, 1.25f, 1.0f));
+}
+
+void BM_Mat4Multiply(benchmark::State& state) {
+    mat4 a = makeTransform();
+    mat4 b = transpose(a);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(a);
+        benchmark::DoNotOptimize(b);
+        mat4 c = a * b;
+        benchmark::DoNotOptimize(c);
+    }
+}
+BENCHMARK(BM_Mat4Multiply);
+
+void BM_Mat4Inverse(benchmark::State& state) {
+    mat4 a = makeTransform();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(a);
+        mat4 c = inverse(a);
+        benchmark::DoNotOptimize(c);
+    }
+}
+BENCHMARK(BM_Mat4Inverse);
+
+void BM_Mat4GaussJordanInverse(benchmark::State& state) {
+    mat4 a = makeTransform();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(a);
+        mat4 c = details::matrix::gaussJordanInverse(a);
+        benchmark::DoNotOptimize(c);
+    }
+}
+BENCHMARK(BM_Mat4GaussJordanInverse);
+
+void BM_Mat4Transpose(benchmark::State& state) {
+    mat4 a = makeTransform();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(a);
+        mat4 c = transpose(a);
+        benchmark::DoNotOptimize(c);
+    }
+}
+BENCHMARK(BM_Mat4Transpose);
+
+void BM_Mat4TransformVec4(benchmark::State& state) {
+    mat4 a = makeTransform();
+    vec4 v(1.0f, 2.0f, 3.0f, 1.0f);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(a);
+        benchmark::DoNotOptimize(v);
+        vec4 r = a * v;
+        benchmark::DoNotOptimize(r);
+    }
+}
+BENCHMARK(BM_Mat4TransformVec4);
+
+void BM_Vec4Dot(benchmark::State& state) {
+    vec4 a(1.0f, 2.0f, 3.0f, 4.0f);
+    vec4 b(-4.0f, 3.0f, -2.0f, 1.0f);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(a);
+        benchmark::DoNotOptimize(b);
+        float r = dot(a, b);
+        benchmark::DoNotOptimize(r);
+    }
+}
+BENCHMARK(BM_Vec4Dot);
+
+void BM_Vec4MultiplyAdd(benchmark::State& state) {
+    vec4 a(1.0f, 2.0f, 3.0f, 4.0f);
+    vec4 b(-4.0f, 3.0f, -2.0f, 1.0f);
+    vec4 c(0.5f, 0.25f, 0.125f, 0.0625f);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(a);
+        benchmark::DoNotOptimize(b);
+        vec4 r = a * b + c;
+        benchmark::DoNotOptimize(r);
+    }
+}
+BENCHMARK(BM_Vec4MultiplyAdd);
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -18,6 +18,7 @@
 
 #include <stdlib.h>
 
+#include <algorithm>
 #include <limits>
 #include <random>
 #include <functional>
@@ -421,6 +422,32 @@ TYPED_TEST(MatTestT, Inverse4) {
     TEST_MATRIX_INVERSE(m5, 20.0 * std::numeric_limits<TypeParam>::epsilon());
 }
 
+TYPED_TEST(MatTestT, Inverse4MatchesGaussJordan) {
+    typedef ::android::details::TMat44<TypeParam> M44T;
+
+    std::default_random_engine generator(82828);
+    std::uniform_real_distribution<TypeParam> distribution(-10.0, 10.0);
+    auto next = std::bind(distribution, generator);
+
+    for (size_t i = 0; i < 100; ++i) {
+        M44T m;
+        for (size_t col = 0; col < M44T::COL_SIZE; ++col) {
+            for (size_t row = 0; row < M44T::ROW_SIZE; ++row) {
+                m[col][row] = next();
+            }
+        }
+
+        M44T fast = ::android::details::matrix::fastInverse4(m);
+        M44T reference = ::android::details::matrix::gaussJordanInverse(m);
+        for (size_t col = 0; col < M44T::COL_SIZE; ++col) {
+            for (size_t row = 0; row < M44T::ROW_SIZE; ++row) {
+                EXPECT_NEAR(reference[col][row], fast[col][row],
+                        1e-3 * std::max(TypeParam(1), std::abs(reference[col][row])));
+            }
+        }
+    }
+}
+
 //------------------------------------------------------------------------------
 TYPED_TEST(MatTestT, Inverse3) {
     typedef ::android::details::TMat33<TypeParam> M33T;
@@ -118,6 +118,9 @@ public:
     // processing thread, either by looper or by AChoreographer_handleEvents
     void handleRefreshRateUpdates();
     void scheduleLatestConfigRequest();
+    // Data of the vsync which frame callbacks are being run for, or of the last one.
+    int64_t getVsyncId() const { return getVsyncEventData().id; }
+    nsecs_t getFrameDeadline() const { return getVsyncEventData().deadlineTimestamp; }
 
     enum {
         MSG_SCHEDULE_CALLBACKS = 0,
@@ -483,6 +486,16 @@ static inline AChoreographer* Choreographer_to_AChoreographer(Choreographer* cho
     return reinterpret_cast<AChoreographer*>(choreographer);
 }
 
+// Glue for the private vsync data accessors
+namespace android {
+int64_t AChoreographer_getVsyncId(const AChoreographer* choreographer) {
+    return AChoreographer_to_Choreographer(choreographer)->getVsyncId();
+}
+int64_t AChoreographer_getFrameDeadline(const AChoreographer* choreographer) {
+    return AChoreographer_to_Choreographer(choreographer)->getFrameDeadline();
+}
+} // namespace android
+
 AChoreographer* AChoreographer_getInstance() {
     return Choreographer_to_AChoreographer(Choreographer::getForThread());
 }
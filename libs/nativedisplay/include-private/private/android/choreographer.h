@@ -29,6 +29,14 @@ void AChoreographer_initJVM(JNIEnv* env);
 // for consumption by callbacks.
 void AChoreographer_signalRefreshRateCallbacks(int64_t vsyncPeriod);
 
+// Returns the id of the vsync which frame callbacks are being run for, or
+// of the last vsync if called outside of them.
+int64_t AChoreographer_getVsyncId(const AChoreographer* choreographer);
+
+// Returns the time by which the frame started on the vsync returned by
+// AChoreographer_getVsyncId should be done, in the CLOCK_MONOTONIC time base.
+int64_t AChoreographer_getFrameDeadline(const AChoreographer* choreographer);
+
 // Trampoline functions allowing libandroid.so to define the NDK symbols without including
 // the entirety of libnativedisplay as a whole static lib. As libnativedisplay
 // maintains global state, libnativedisplay can never be directly statically
@@ -86,6 +86,13 @@ public:
      */
     status_t attachToContext(uint32_t tex, SurfaceTexture& st);
 
+    /**
+     * onFrameAvailableLocked starts creating the EGLImage of a newly queued
+     * buffer on a background thread, so that updateTexImage doesn't block on
+     * its creation when the buffer is acquired.
+     */
+    void onFrameAvailableLocked(const BufferItem& item);
+
     /**
      * onAcquireBufferLocked amends the ConsumerBase method to update the
      * mEglSlots array in addition to the ConsumerBase behavior.
@@ -173,6 +180,13 @@ protected:
          */
         status_t createIfNeeded(EGLDisplay display, bool forceCreate = false);
 
+        /**
+         * prepare creates an EGLImage if there isn't one yet. Unlike
+         * createIfNeeded, it never destroys an existing image, so it may be
+         * called from any thread while the image is in use.
+         */
+        void prepare(EGLDisplay display);
+
         /**
          * This calls glEGLImageTargetTexture2DOES to bind the image to the
          * texture in the specified texture target.
@@ -208,6 +222,9 @@ protected:
         // mCropRect is the crop rectangle passed to EGL when mEglImage
         // was created.
         Rect mCropRect;
+
+        // mMutex protects the creation of mEglImage by prepare.
+        Mutex mMutex;
     };
 
     /**
@@ -293,6 +310,13 @@ protected:
      */
     EglSlot mEglSlots[BufferQueueDefs::NUM_BUFFER_SLOTS];
 
+    /**
+     * mPreparedImages stores the EglImages created by onFrameAvailableLocked
+     * for buffers which haven't been acquired yet. They replace the images of
+     * mEglSlots when the buffers are acquired.
+     */
+    sp<EglImage> mPreparedImages[BufferQueueDefs::NUM_BUFFER_SLOTS];
+
     /**
      * protects static initialization
      */
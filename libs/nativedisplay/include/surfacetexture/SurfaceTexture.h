@@ -290,6 +290,13 @@ public:
     void releaseConsumerOwnership();
 
 protected:
+    /**
+     * onFrameAvailable and onFrameReplaced override the ConsumerBase methods
+     * to prepare the EGLImage of the queued buffer ahead of updateTexImage.
+     */
+    virtual void onFrameAvailable(const BufferItem& item) override;
+    virtual void onFrameReplaced(const BufferItem& item) override;
+
     /**
      * abandonLocked overrides the ConsumerBase method to clear
      * mCurrentTextureImage in addition to the ConsumerBase behavior.
@@ -325,6 +332,12 @@ protected:
      */
     virtual void freeBufferLocked(int slotIndex);
 
+    /**
+     * prepareFrame prepares the EGLImage of a queued buffer when attached to
+     * GL.
+     */
+    void prepareFrame(const BufferItem& item);
+
     /**
      * computeCurrentTransformMatrixLocked computes the transform matrix for the
      * current texture.  It uses mCurrentTransform and the current GraphicBuffer
@@ -27,11 +27,18 @@
 #include <surfacetexture/EGLConsumer.h>
 #include <surfacetexture/SurfaceTexture.h>
 #include <inttypes.h>
+#include <pthread.h>
 #include <private/gui/SyncFeatures.h>
 #include <utils/Log.h>
 #include <utils/String8.h>
 #include <utils/Trace.h>
 
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+
 #define PROT_CONTENT_EXT_STR "EGL_EXT_protected_content"
 #define EGL_PROTECTED_CONTENT_EXT 0x32C0
 
@@ -83,6 +90,43 @@ static bool hasEglProtectedContent() {
     return hasIt;
 }
 
+// Runs tasks in the background, on a thread shared by all the EGLConsumers of
+// the process.
+class BackgroundWorker {
+public:
+    static BackgroundWorker& getInstance() {
+        // Never destroyed, as its thread runs until the process exits.
+        static BackgroundWorker* worker = new BackgroundWorker();
+        return *worker;
+    }
+
+    void post(std::function<void()> task) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mTasks.push(std::move(task));
+        mCondition.notify_one();
+    }
+
+private:
+    BackgroundWorker() { std::thread([this]() { run(); }).detach(); }
+
+    void run() {
+        pthread_setname_np(pthread_self(), "EGLConsumerBg");
+        std::unique_lock<std::mutex> lock(mMutex);
+        while (true) {
+            mCondition.wait(lock, [this]() { return !mTasks.empty(); });
+            std::function<void()> task = std::move(mTasks.front());
+            mTasks.pop();
+            lock.unlock();
+            task();
+            lock.lock();
+        }
+    }
+
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::queue<std::function<void()>> mTasks;
+};
+
 EGLConsumer::EGLConsumer() : mEglDisplay(EGL_NO_DISPLAY), mEglContext(EGL_NO_CONTEXT) {}
 
 status_t EGLConsumer::updateTexImage(SurfaceTexture& st) {
@@ -211,13 +255,49 @@ sp<GraphicBuffer> EGLConsumer::getDebugTexImageBuffer() {
     return sReleasedTexImageBuffer;
 }
 
+void EGLConsumer::onFrameAvailableLocked(const BufferItem& item) {
+    int slot = item.mSlot;
+    const sp<GraphicBuffer>& buffer = item.mGraphicBuffer;
+    if (slot < 0 || slot >= BufferQueueDefs::NUM_BUFFER_SLOTS || buffer == nullptr) {
+        return;
+    }
+
+    // Nothing to do if the buffer already has an image, or is getting one.
+    for (const sp<EglImage>& image : {mEglSlots[slot].mEglImage, mPreparedImages[slot]}) {
+        if (image != nullptr && image->graphicBuffer() != nullptr &&
+            image->graphicBuffer()->getId() == buffer->getId()) {
+            return;
+        }
+    }
+
+    // EGLImages are created without a context, so only the display they will
+    // be used with is needed. It isn't known until updateTexImage is first
+    // called, and is the default display then in practice. Should it be
+    // another one, the image is created again by createIfNeeded.
+    EGLDisplay display =
+            mEglDisplay != EGL_NO_DISPLAY ? mEglDisplay : eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    EGC_LOGV("onFrameAvailable: preparing image for slot=%d", slot);
+    sp<EglImage> image = new EglImage(buffer);
+    mPreparedImages[slot] = image;
+    BackgroundWorker::getInstance().post([image, display]() { image->prepare(display); });
+}
+
 void EGLConsumer::onAcquireBufferLocked(BufferItem* item, SurfaceTexture& st) {
     // If item->mGraphicBuffer is not null, this buffer has not been acquired
     // before, so any prior EglImage created is using a stale buffer. This
-    // replaces any old EglImage with a new one (using the new buffer).
+    // replaces any old EglImage with a new one (using the new buffer), which
+    // is the one prepared when the buffer was queued if there is one.
     int slot = item->mSlot;
     if (item->mGraphicBuffer != nullptr || mEglSlots[slot].mEglImage.get() == nullptr) {
-        mEglSlots[slot].mEglImage = new EglImage(st.mSlots[slot].mGraphicBuffer);
+        const sp<GraphicBuffer>& buffer = st.mSlots[slot].mGraphicBuffer;
+        sp<EglImage>& prepared = mPreparedImages[slot];
+        if (prepared != nullptr && buffer != nullptr &&
+            prepared->graphicBuffer()->getId() == buffer->getId()) {
+            mEglSlots[slot].mEglImage = prepared;
+            prepared.clear();
+        } else {
+            mEglSlots[slot].mEglImage = new EglImage(buffer);
+        }
     }
 }
 
@@ -594,10 +674,14 @@ status_t EGLConsumer::doGLFenceWaitLocked(SurfaceTexture& st) const {
 
 void EGLConsumer::onFreeBufferLocked(int slotIndex) {
     mEglSlots[slotIndex].mEglImage.clear();
+    mPreparedImages[slotIndex].clear();
 }
 
 void EGLConsumer::onAbandonLocked() {
     mCurrentTextureImage.clear();
+    for (sp<EglImage>& image : mPreparedImages) {
+        image.clear();
+    }
 }
 
 EGLConsumer::EglImage::EglImage(sp<GraphicBuffer> graphicBuffer)
@@ -613,6 +697,8 @@ EGLConsumer::EglImage::~EglImage() {
 }
 
 status_t EGLConsumer::EglImage::createIfNeeded(EGLDisplay eglDisplay, bool forceCreation) {
+    Mutex::Autolock lock(mMutex);
+
     // If there's an image and it's no longer valid, destroy it.
     bool haveImage = mEglImage != EGL_NO_IMAGE_KHR;
     bool displayInvalid = mEglDisplay != eglDisplay;
@@ -644,6 +730,16 @@ status_t EGLConsumer::EglImage::createIfNeeded(EGLDisplay eglDisplay, bool force
     return OK;
 }
 
+void EGLConsumer::EglImage::prepare(EGLDisplay eglDisplay) {
+    Mutex::Autolock lock(mMutex);
+
+    if (mEglImage == EGL_NO_IMAGE_KHR) {
+        mEglImage = createImage(eglDisplay, mGraphicBuffer);
+        // If it failed, createIfNeeded tries again when the image is used.
+        mEglDisplay = mEglImage != EGL_NO_IMAGE_KHR ? eglDisplay : EGL_NO_DISPLAY;
+    }
+}
+
 void EGLConsumer::EglImage::bindToTextureTarget(uint32_t texTarget) {
     glEGLImageTargetTexture2DOES(texTarget, static_cast<GLeglImageOES>(mEglImage));
 }
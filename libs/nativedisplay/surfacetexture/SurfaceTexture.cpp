@@ -443,6 +443,23 @@ void SurfaceTexture::freeBufferLocked(int slotIndex) {
     ConsumerBase::freeBufferLocked(slotIndex);
 }
 
+void SurfaceTexture::onFrameAvailable(const BufferItem& item) {
+    prepareFrame(item);
+    ConsumerBase::onFrameAvailable(item);
+}
+
+void SurfaceTexture::onFrameReplaced(const BufferItem& item) {
+    prepareFrame(item);
+    ConsumerBase::onFrameReplaced(item);
+}
+
+void SurfaceTexture::prepareFrame(const BufferItem& item) {
+    Mutex::Autolock lock(mMutex);
+    if (!mAbandoned && mOpMode == OpMode::attachedToGL) {
+        mEGLConsumer.onFrameAvailableLocked(item);
+    }
+}
+
 void SurfaceTexture::abandonLocked() {
     SFT_LOGV("abandonLocked");
     mEGLConsumer.onAbandonLocked();
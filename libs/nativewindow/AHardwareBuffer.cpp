@@ -24,6 +24,7 @@
 
 #include <cutils/native_handle.h>
 #include <log/log.h>
+#include <sync/sync.h>
 #include <utils/StrongPointer.h>
 #include <ui/GraphicBuffer.h>
 #include <system/graphics.h>
@@ -238,6 +239,44 @@ int AHardwareBuffer_unlock(AHardwareBuffer* buffer, int32_t* fence) {
         return gBuffer->unlockAsync(fence);
 }
 
+int AHardwareBuffer_lockPersistent(AHardwareBuffer* buffer, uint64_t usage, int32_t fence,
+                                   void** outVirtualAddress) {
+    if (!buffer || !outVirtualAddress) return BAD_VALUE;
+
+    if (usage & ~(AHARDWAREBUFFER_USAGE_CPU_READ_MASK |
+                  AHARDWAREBUFFER_USAGE_CPU_WRITE_MASK)) {
+        ALOGE("Invalid usage flags passed to AHardwareBuffer_lockPersistent; only "
+                "AHARDWAREBUFFER_USAGE_CPU_* flags are allowed");
+        return BAD_VALUE;
+    }
+
+    usage = AHardwareBuffer_convertToGrallocUsageBits(usage);
+    GraphicBuffer* gbuffer = AHardwareBuffer_to_GraphicBuffer(buffer);
+
+    if (gbuffer->getLayerCount() > 1) {
+        ALOGE("Buffer with multiple layers passed to AHardwareBuffer_lockPersistent; "
+                "only buffers with one layer are allowed");
+        return INVALID_OPERATION;
+    }
+
+    return gbuffer->lockPersistentAsync(usage, outVirtualAddress, fence);
+}
+
+int AHardwareBuffer_unlockPersistent(AHardwareBuffer* buffer, int32_t* fence) {
+    if (!buffer) return BAD_VALUE;
+
+    GraphicBuffer* gBuffer = AHardwareBuffer_to_GraphicBuffer(buffer);
+    int fenceFd = -1;
+    status_t result = gBuffer->unlockPersistentAsync(&fenceFd);
+    if (fence != nullptr) {
+        *fence = fenceFd;
+    } else if (fenceFd >= 0) {
+        sync_wait(fenceFd, -1);
+        close(fenceFd);
+    }
+    return result;
+}
+
 int AHardwareBuffer_sendHandleToUnixSocket(const AHardwareBuffer* buffer, int socketFd) {
     if (!buffer) return BAD_VALUE;
     const GraphicBuffer* gBuffer = AHardwareBuffer_to_GraphicBuffer(buffer);
@@ -49,6 +49,28 @@ int AHardwareBuffer_createFromHandle(const AHardwareBuffer_Desc* desc,
                                      const native_handle_t* handle, int32_t method,
                                      AHardwareBuffer** outBuffer);
 
+/**
+ * Lock the AHardwareBuffer for direct CPU access, keeping it mapped for the lifetime of the buffer.
+ *
+ * This function behaves like AHardwareBuffer_lock() for the whole buffer, but the first call maps
+ * the buffer and later calls reuse that mapping instead of mapping the buffer again, which suits
+ * buffers that are locked repeatedly. Each call waits for fence and makes the writes of other
+ * users of the buffer visible to the CPU, and each call to AHardwareBuffer_unlockPersistent()
+ * makes the CPU writes visible to other users. The returned address remains valid until the next
+ * call to AHardwareBuffer_unlockPersistent().
+ *
+ * The buffer must not be locked with AHardwareBuffer_lock() or its variants while it is mapped.
+ */
+int AHardwareBuffer_lockPersistent(AHardwareBuffer* buffer, uint64_t usage, int32_t fence,
+                                   void** outVirtualAddress);
+
+/**
+ * Unlock an AHardwareBuffer locked by AHardwareBuffer_lockPersistent(), flushing its CPU writes.
+ *
+ * If fence is not NULL, it is set to a fence to wait on before the writes are visible, or -1.
+ */
+int AHardwareBuffer_unlockPersistent(AHardwareBuffer* buffer, int32_t* fence);
+
 /**
  * Buffer pixel formats.
  */
@@ -131,3 +131,33 @@ TEST(AHardwareBufferTest, GetCreateHandleTest) {
     AHardwareBuffer_release(buffer);
     AHardwareBuffer_release(otherBuffer);
 }
+
+TEST(AHardwareBufferTest, LockPersistentReusesMapping) {
+    AHardwareBuffer_Desc desc{
+            .width = 64,
+            .height = 1,
+            .layers = 1,
+            .format = AHARDWAREBUFFER_FORMAT_BLOB,
+            .usage = AHARDWAREBUFFER_USAGE_CPU_READ_OFTEN | AHARDWAREBUFFER_USAGE_CPU_WRITE_OFTEN,
+            .stride = 64,
+    };
+
+    AHardwareBuffer* buffer = nullptr;
+    ASSERT_EQ(0, AHardwareBuffer_allocate(&desc, &buffer));
+
+    void* data = nullptr;
+    ASSERT_EQ(0, AHardwareBuffer_lockPersistent(buffer, AHARDWAREBUFFER_USAGE_CPU_WRITE_OFTEN, -1,
+                                                &data));
+    ASSERT_NE(nullptr, data);
+    static_cast<uint8_t*>(data)[0] = 42;
+    EXPECT_EQ(0, AHardwareBuffer_unlockPersistent(buffer, nullptr));
+
+    void* otherData = nullptr;
+    ASSERT_EQ(0, AHardwareBuffer_lockPersistent(buffer, AHARDWAREBUFFER_USAGE_CPU_READ_OFTEN, -1,
+                                                &otherData));
+    EXPECT_EQ(42, static_cast<uint8_t*>(otherData)[0]);
+    EXPECT_EQ(0, AHardwareBuffer_unlockPersistent(buffer, nullptr));
+
+    // The buffer is unmapped when released.
+    AHardwareBuffer_release(buffer);
+}
@@ -20,6 +20,7 @@
 #include <log/log.h>
 #include <private/gui/SyncFeatures.h>
 #include "gl/GLESRenderEngine.h"
+#include "threaded/RenderEngineThreaded.h"
 
 namespace android {
 namespace renderengine {
@@ -31,6 +32,11 @@ std::unique_ptr<impl::RenderEngine> RenderEngine::create(const RenderEngineCreat
         ALOGD("RenderEngine GLES Backend");
         return renderengine::gl::GLESRenderEngine::create(args);
     }
+    if (strcmp(prop, "threaded") == 0) {
+        ALOGD("Threaded RenderEngine with GLES Backend");
+        return renderengine::threaded::RenderEngineThreaded::create(
+                [args]() { return renderengine::gl::GLESRenderEngine::create(args); }, args);
+    }
     ALOGE("UNKNOWN BackendType: %s, create GLES RenderEngine.", prop);
     return renderengine::gl::GLESRenderEngine::create(args);
 }
@@ -0,0 +1,397 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+#include <benchmark/benchmark.h>
+#include <renderengine/RenderEngine.h>
+#include <sync/sync.h>
+#include <ui/PixelFormat.h>
+
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "../gl/GLESRenderEngine.h"
+
+namespace android {
+namespace {
+
+constexpr uint32_t kDisplayWidth = 1080;
+constexpr uint32_t kDisplayHeight = 2340;
+
+const Rect kDisplayRect(kDisplayWidth, kDisplayHeight);
+
+std::unique_ptr<renderengine::gl::GLESRenderEngine> createRenderEngine(bool useColorManagement,
+                                                                       bool protectedContext) {
+    // The engine is not threaded, so that its context is current on the benchmark thread for the
+    // timer queries below.
+    return renderengine::gl::GLESRenderEngine::create(
+            renderengine::RenderEngineCreationArgs::Builder()
+                    .setPixelFormat(static_cast<int>(ui::PixelFormat::RGBA_8888))
+                    .setImageCacheSize(1)
+                    .setUseColorManagerment(useColorManagement)
+                    .setEnableProtectedContext(protectedContext)
+                    .setPrecacheToneMapperShaderOnly(false)
+                    .setSupportsBackgroundBlur(true)
+                    .setContextPriority(renderengine::RenderEngine::ContextPriority::MEDIUM)
+                    .build());
+}
+
+renderengine::gl::GLESRenderEngine& getRenderEngine() {
+    static std::unique_ptr<renderengine::gl::GLESRenderEngine> engine =
+            createRenderEngine(false, false);
+    return *engine;
+}
+
+renderengine::gl::GLESRenderEngine& getColorManagedRenderEngine() {
+    static std::unique_ptr<renderengine::gl::GLESRenderEngine> engine =
+            createRenderEngine(true, false);
+    return *engine;
+}
+
+renderengine::gl::GLESRenderEngine& getProtectedRenderEngine() {
+    static std::unique_ptr<renderengine::gl::GLESRenderEngine> engine =
+            createRenderEngine(false, true);
+    return *engine;
+}
+
+// Measures the GPU time of the commands issued between begin() and end() with
+// GL_EXT_disjoint_timer_query, when the driver supports it.
+class GpuTimer {
+public:
+    GpuTimer() {
+        const char* extensions = reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS));
+        mSupported = extensions && strstr(extensions, "GL_EXT_disjoint_timer_query");
+        if (mSupported) {
+            glGenQueriesEXT(1, &mQuery);
+        }
+    }
+
+    ~GpuTimer() {
+        if (mSupported) {
+            glDeleteQueriesEXT(1, &mQuery);
+        }
+    }
+
+    bool isSupported() const { return mSupported; }
+
+    void begin() {
+        if (mSupported) {
+            glBeginQueryEXT(GL_TIME_ELAPSED_EXT, mQuery);
+        }
+    }
+
+    void end() {
+        if (mSupported) {
+            glEndQueryEXT(GL_TIME_ELAPSED_EXT);
+        }
+    }
+
+    // Waits for the result of the last query. Returns false if it is not
+    // available, or if the GPU was disjoint (e.g. its clock changed) during it.
+    bool read(uint64_t* elapsedNs) {
+        if (!mSupported) {
+            return false;
+        }
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64vEXT(mQuery, GL_QUERY_RESULT_EXT, &elapsed);
+        GLint disjoint = 0;
+        glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+        if (disjoint) {
+            return false;
+        }
+        *elapsedNs = elapsed;
+        return true;
+    }
+
+private:
+    bool mSupported = false;
+    GLuint mQuery = 0;
+};
+
+// The layers of a composition and the buffers they are drawn from and to.
+class Scene {
+public:
+    explicit Scene(renderengine::gl::GLESRenderEngine& engine, bool isProtected = false)
+          : mEngine(engine), mProtected(isProtected) {
+        uint64_t usage = GRALLOC_USAGE_HW_RENDER | GRALLOC_USAGE_HW_TEXTURE;
+        if (mProtected) {
+            usage |= GRALLOC_USAGE_PROTECTED;
+        }
+        mOutput = new GraphicBuffer(kDisplayWidth, kDisplayHeight, HAL_PIXEL_FORMAT_RGBA_8888, 1,
+                                    usage, "output");
+
+        mDisplay.physicalDisplay = kDisplayRect;
+        mDisplay.clip = kDisplayRect;
+        mDisplay.maxLuminance = 500.0f;
+        mDisplay.outputDataspace = ui::Dataspace::V0_SRGB;
+    }
+
+    ~Scene() {
+        for (uint32_t texName : mTexNames) {
+            mEngine.deleteTextures(1, &texName);
+        }
+    }
+
+    bool isValid() const {
+        if (mOutput->initCheck() != NO_ERROR) {
+            return false;
+        }
+        for (const auto& layer : mLayers) {
+            const auto& buffer = layer->source.buffer.buffer;
+            if (buffer && buffer->initCheck() != NO_ERROR) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    renderengine::DisplaySettings& display() { return mDisplay; }
+
+    // Adds a solid color layer covering the bounds.
+    renderengine::LayerSettings& addColorLayer(const FloatRect& bounds, half3 color) {
+        auto& layer = addLayer(bounds);
+        layer.source.solidColor = color;
+        return layer;
+    }
+
+    // Adds a layer covering the bounds, drawn from a buffer of the same size
+    // filled with a gradient.
+    renderengine::LayerSettings& addBufferLayer(const FloatRect& bounds) {
+        auto& layer = addLayer(bounds);
+        layer.source.buffer.buffer = allocateSourceBuffer(static_cast<uint32_t>(bounds.getWidth()),
+                                                          static_cast<uint32_t>(
+                                                                  bounds.getHeight()));
+        mEngine.genTextures(1, &layer.source.buffer.textureName);
+        mTexNames.push_back(layer.source.buffer.textureName);
+        layer.sourceDataspace = ui::Dataspace::V0_SRGB;
+        return layer;
+    }
+
+    // Composes the scene once per iteration. The CPU time reported by the
+    // benchmark is the time taken to issue the draw, and the GPU time
+    // measured with a GpuTimer is reported as the gpu_ns counter.
+    // beforeDraw is called with the iteration index before each draw.
+    void run(benchmark::State& state,
+             const std::function<void(size_t iteration)>& beforeDraw = nullptr) {
+        if (!isValid()) {
+            state.SkipWithError("Failed to allocate buffers");
+            return;
+        }
+
+        std::vector<const renderengine::LayerSettings*> layers;
+        for (const auto& layer : mLayers) {
+            layers.push_back(layer.get());
+        }
+
+        GpuTimer timer;
+        uint64_t totalGpuNs = 0;
+        size_t gpuSamples = 0;
+        size_t iteration = 0;
+        for (auto _ : state) {
+            if (beforeDraw) {
+                beforeDraw(iteration);
+            }
+            iteration++;
+
+            timer.begin();
+            base::unique_fd drawFence;
+            mEngine.drawLayers(mDisplay, layers, mOutput->getNativeBuffer(), true,
+                               base::unique_fd(), &drawFence);
+            timer.end();
+
+            state.PauseTiming();
+            if (drawFence.ok()) {
+                sync_wait(drawFence.get(), -1);
+            }
+            uint64_t gpuNs;
+            if (timer.read(&gpuNs)) {
+                totalGpuNs += gpuNs;
+                gpuSamples++;
+            }
+            state.ResumeTiming();
+        }
+
+        if (gpuSamples > 0) {
+            state.counters["gpu_ns"] = static_cast<double>(totalGpuNs) / gpuSamples;
+        } else if (!timer.isSupported()) {
+            state.SetLabel("no GPU timer");
+        }
+    }
+
+private:
+    renderengine::LayerSettings& addLayer(const FloatRect& bounds) {
+        mLayers.push_back(std::make_unique<renderengine::LayerSettings>());
+        auto& layer = *mLayers.back();
+        layer.geometry.boundaries = bounds;
+        layer.alpha = 1.0f;
+        return layer;
+    }
+
+    sp<GraphicBuffer> allocateSourceBuffer(uint32_t width, uint32_t height) {
+        if (mProtected) {
+            // Protected buffers can't be written by the CPU, their contents are left undefined.
+            return new GraphicBuffer(width, height, HAL_PIXEL_FORMAT_RGBA_8888, 1,
+                                     GRALLOC_USAGE_HW_TEXTURE | GRALLOC_USAGE_PROTECTED, "input");
+        }
+
+        sp<GraphicBuffer> buffer =
+                new GraphicBuffer(width, height, HAL_PIXEL_FORMAT_RGBA_8888, 1,
+                                  GRALLOC_USAGE_SW_WRITE_OFTEN | GRALLOC_USAGE_HW_TEXTURE, "input");
+        uint8_t* pixels;
+        if (buffer->initCheck() != NO_ERROR ||
+            buffer->lock(GRALLOC_USAGE_SW_WRITE_OFTEN, reinterpret_cast<void**>(&pixels)) !=
+                    NO_ERROR) {
+            return buffer;
+        }
+        for (uint32_t j = 0; j < height; j++) {
+            uint8_t* iter = pixels + (buffer->getStride() * j) * 4;
+            for (uint32_t i = 0; i < width; i++) {
+                iter[0] = uint8_t(i * 255 / width);
+                iter[1] = uint8_t(j * 255 / height);
+                iter[2] = 128;
+                iter[3] = 255;
+                iter += 4;
+            }
+        }
+        buffer->unlock();
+        return buffer;
+    }
+
+    renderengine::gl::GLESRenderEngine& mEngine;
+    const bool mProtected;
+    sp<GraphicBuffer> mOutput;
+    renderengine::DisplaySettings mDisplay;
+    // The settings are held by pointer, so that their addresses are stable.
+    std::vector<std::unique_ptr<renderengine::LayerSettings>> mLayers;
+    std::vector<uint32_t> mTexNames;
+};
+
+const FloatRect kFullscreen = kDisplayRect.toFloatRect();
+
+// Returns the bounds of a window inset from the edges of the display.
+FloatRect insetBounds(float inset) {
+    return FloatRect(inset, inset, kDisplayWidth - inset, kDisplayHeight - inset);
+}
+
+// Fullscreen buffer layers blended on top of each other.
+void BM_BufferLayers(benchmark::State& state) {
+    Scene scene(getRenderEngine());
+    for (int64_t i = 0; i < state.range(0); i++) {
+        scene.addBufferLayer(kFullscreen).alpha = 0.9f;
+    }
+    scene.run(state);
+}
+BENCHMARK(BM_BufferLayers)->Arg(1)->Arg(4)->Arg(8)->Arg(16);
+
+// A wallpaper below a window with rounded corners of the given radius.
+void BM_RoundedCorners(benchmark::State& state) {
+    Scene scene(getRenderEngine());
+    scene.addBufferLayer(kFullscreen);
+    auto& window = scene.addBufferLayer(insetBounds(64.0f));
+    window.geometry.roundedCornersRadius = state.range(0);
+    window.geometry.roundedCornersCrop = window.geometry.boundaries;
+    scene.run(state);
+}
+BENCHMARK(BM_RoundedCorners)->Arg(16)->Arg(64)->Arg(256);
+
+// A wallpaper below a window casting a shadow of the given length.
+void BM_Shadows(benchmark::State& state) {
+    Scene scene(getRenderEngine());
+    scene.addBufferLayer(kFullscreen);
+
+    // The shadow is drawn by its own layer, below the caster.
+    const FloatRect windowBounds = insetBounds(128.0f);
+    auto& shadow = scene.addColorLayer(windowBounds, half3(0.0f, 0.0f, 0.0f));
+    shadow.alpha = 0.0f;
+    shadow.geometry.roundedCornersRadius = 32.0f;
+    shadow.geometry.roundedCornersCrop = windowBounds;
+    shadow.shadow.ambientColor = vec4(0.0f, 0.0f, 0.0f, 0.039f);
+    shadow.shadow.spotColor = vec4(0.0f, 0.0f, 0.0f, 0.19f);
+    shadow.shadow.lightPos = vec3(kDisplayWidth / 2.0f, 0.0f, 1500.0f);
+    shadow.shadow.lightRadius = 2500.0f;
+    shadow.shadow.length = state.range(0);
+
+    auto& window = scene.addBufferLayer(windowBounds);
+    window.geometry.roundedCornersRadius = 32.0f;
+    window.geometry.roundedCornersCrop = windowBounds;
+    scene.run(state);
+}
+BENCHMARK(BM_Shadows)->Arg(8)->Arg(32)->Arg(128);
+
+// A window blurring the layer below it with the given radius. If the second
+// argument is 0, the layer below changes every frame, so that the blur can't
+// be reused from the previous frame.
+void BM_BackgroundBlur(benchmark::State& state) {
+    Scene scene(getRenderEngine());
+    auto& background = scene.addColorLayer(kFullscreen, half3(1.0f, 0.0f, 0.0f));
+    auto& blur = scene.addColorLayer(insetBounds(64.0f), half3(0.0f, 0.0f, 0.0f));
+    blur.alpha = 0.0f;
+    blur.backgroundBlurRadius = state.range(0);
+
+    const bool cacheable = state.range(1) != 0;
+    scene.run(state, [&](size_t iteration) {
+        if (!cacheable) {
+            background.source.solidColor =
+                    iteration % 2 ? half3(1.0f, 0.0f, 0.0f) : half3(0.0f, 0.0f, 1.0f);
+        }
+    });
+}
+BENCHMARK(BM_BackgroundBlur)
+        ->Args({25, 0})
+        ->Args({75, 0})
+        ->Args({150, 0})
+        ->Args({75, 1});
+
+// A fullscreen HDR10 buffer tone mapped to the given output dataspace.
+void BM_HdrToneMapping(benchmark::State& state) {
+    Scene scene(getColorManagedRenderEngine());
+    scene.display().outputDataspace = static_cast<ui::Dataspace>(state.range(0));
+
+    auto& video = scene.addBufferLayer(kFullscreen);
+    video.sourceDataspace = ui::Dataspace::BT2020_ITU_PQ;
+    video.source.buffer.isOpaque = true;
+    video.source.buffer.maxMasteringLuminance = 1000.0f;
+    video.source.buffer.maxContentLuminance = 1000.0f;
+    scene.run(state);
+}
+BENCHMARK(BM_HdrToneMapping)
+        ->Arg(static_cast<int64_t>(ui::Dataspace::V0_SRGB))
+        ->Arg(static_cast<int64_t>(ui::Dataspace::DISPLAY_P3));
+
+// A fullscreen protected buffer composed in a protected context.
+void BM_ProtectedContent(benchmark::State& state) {
+    auto& engine = getProtectedRenderEngine();
+    if (!engine.supportsProtectedContent() || !engine.useProtectedContext(true)) {
+        state.SkipWithError("Protected context not supported");
+        return;
+    }
+
+    {
+        Scene scene(engine, true);
+        scene.addBufferLayer(kFullscreen).source.buffer.isOpaque = true;
+        scene.run(state);
+    }
+    engine.useProtectedContext(false);
+}
+BENCHMARK(BM_ProtectedContent);
+
+} // namespace
+} // namespace android
+
+BENCHMARK_MAIN();
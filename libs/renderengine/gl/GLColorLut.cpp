@@ -0,0 +1,386 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define ATRACE_TAG ATRACE_TAG_GRAPHICS
+
+#include "GLColorLut.h"
+
+#include <GLES3/gl3.h>
+#include <log/log.h>
+#include <utils/Trace.h>
+#include <algorithm>
+#include <cmath>
+
+namespace android {
+namespace renderengine {
+namespace gl {
+
+namespace {
+
+using TransferFunction = Description::TransferFunction;
+
+// Bound of the values stored in the table, see encode().
+constexpr float kMaxEncodedValue = 2.0f;
+
+// Same as ProgramCache::Key::needsToneMapping.
+bool needsToneMapping(TransferFunction input, TransferFunction output) {
+    if ((input == TransferFunction::SRGB && output == TransferFunction::LINEAR) ||
+        (input == TransferFunction::LINEAR && output == TransferFunction::SRGB)) {
+        return false;
+    }
+    return input != output;
+}
+
+// Clamps to [0, 1], mapping NaN to 0.
+float clampToUnit(float value) {
+    return !(value > 0.0f) ? 0.0f : value > 1.0f ? 1.0f : value;
+}
+
+vec3 clampToUnit(const vec3& color) {
+    return vec3(clampToUnit(color.r), clampToUnit(color.g), clampToUnit(color.b));
+}
+
+vec3 transform(const mat4& matrix, const vec3& color) {
+    return clampToUnit((matrix * vec4(color, 1.0f)).xyz);
+}
+
+// The functions below mirror the shader code generated by ProgramCache.
+
+float EOTF(TransferFunction tf, float channel) {
+    switch (tf) {
+        case TransferFunction::SRGB:
+            return channel <= 0.04045f ? channel / 12.92f
+                                       : std::pow((channel + 0.055f) / 1.055f, 2.4f);
+        case TransferFunction::ST2084: {
+            constexpr float m1 = (2610.0f / 4096.0f) / 4.0f;
+            constexpr float m2 = (2523.0f / 4096.0f) * 128.0f;
+            constexpr float c1 = (3424.0f / 4096.0f);
+            constexpr float c2 = (2413.0f / 4096.0f) * 32.0f;
+            constexpr float c3 = (2392.0f / 4096.0f) * 32.0f;
+            float tmp = std::pow(channel, 1.0f / m2);
+            tmp = std::max(tmp - c1, 0.0f) / (c2 - c3 * tmp);
+            return std::pow(tmp, 1.0f / m1);
+        }
+        case TransferFunction::HLG: {
+            constexpr float a = 0.17883277f;
+            constexpr float b = 0.28466892f;
+            constexpr float c = 0.55991073f;
+            return channel <= 0.5f ? channel * channel / 3.0f
+                                   : (std::exp((channel - c) / a) + b) / 12.0f;
+        }
+        default:
+            return channel;
+    }
+}
+
+float OETF(TransferFunction tf, float channel) {
+    switch (tf) {
+        case TransferFunction::SRGB:
+            return channel <= 0.0031308f ? channel * 12.92f
+                                         : (std::pow(channel, 1.0f / 2.4f) * 1.055f) - 0.055f;
+        case TransferFunction::ST2084: {
+            constexpr float m1 = (2610.0f / 4096.0f) / 4.0f;
+            constexpr float m2 = (2523.0f / 4096.0f) * 128.0f;
+            constexpr float c1 = (3424.0f / 4096.0f);
+            constexpr float c2 = (2413.0f / 4096.0f) * 32.0f;
+            constexpr float c3 = (2392.0f / 4096.0f) * 32.0f;
+            float tmp = std::pow(channel, m1);
+            tmp = (c1 + c2 * tmp) / (1.0f + c3 * tmp);
+            return std::pow(tmp, m2);
+        }
+        case TransferFunction::HLG: {
+            constexpr float a = 0.17883277f;
+            constexpr float b = 0.28466892f;
+            constexpr float c = 0.55991073f;
+            return channel <= 1.0f / 12.0f ? std::sqrt(3.0f * channel)
+                                           : a * std::log(12.0f * channel - b) + c;
+        }
+        default:
+            return channel;
+    }
+}
+
+// The OETF, extended to values outside of [0, 1] so that the output can be
+// clamped after interpolating the table. Clamping before would make the table
+// non-linear within the cells at the gamut boundaries, where the conversion
+// from a wider colorspace to a narrower one results in >1.0 or <0.0 values.
+float encode(TransferFunction tf, float channel) {
+    // NaN, from the tone mapping of black, is mapped to 0.
+    if (!(std::abs(channel) <= kMaxEncodedValue)) {
+        return std::isnan(channel) ? 0.0f : std::copysign(kMaxEncodedValue, channel);
+    }
+    const float encoded = std::copysign(OETF(tf, std::abs(channel)), channel);
+    return std::clamp(encoded, -kMaxEncodedValue, kMaxEncodedValue);
+}
+
+vec3 scaleLuminance(const GLColorLut::Conversion& conversion, const vec3& color) {
+    switch (conversion.inputTransferFunction) {
+        case TransferFunction::ST2084:
+            return color * 10000.0f;
+        case TransferFunction::HLG:
+            return color * 1000.0f * std::pow(color.y, 0.2f);
+        default:
+            return color * conversion.displayMaxLuminance;
+    }
+}
+
+vec3 toneMapHdr(const GLColorLut::Conversion& conversion, const vec3& color) {
+    const float maxInLumi =
+            std::min(conversion.maxMasteringLuminance, conversion.maxContentLuminance);
+    const float maxOutLumi = conversion.displayMaxLuminance;
+
+    float nits = std::clamp(color.y, 0.0f, maxInLumi);
+
+    if (maxInLumi <= maxOutLumi) {
+        return color * (maxOutLumi / maxInLumi);
+    }
+
+    constexpr float x0 = 10.0f;
+    constexpr float y0 = 17.0f;
+    const float x1 = maxOutLumi * 0.75f;
+    const float y1 = x1;
+    const float x2 = x1 + (maxInLumi - x1) / 2.0f;
+    const float y2 = y1 + (maxOutLumi - y1) * 0.75f;
+
+    const float h12 = x2 - x1;
+    const float h23 = maxInLumi - x2;
+    const float m1 = (y2 - y1) / h12;
+    const float m3 = (maxOutLumi - y2) / h23;
+    const float m2 = (m1 + m3) / 2.0f;
+
+    if (nits < x0) {
+        return color * (y0 / x0);
+    } else if (nits < x1) {
+        nits = y0 + (nits - x0) * ((y1 - y0) / (x1 - x0));
+    } else if (nits < x2) {
+        const float t = (nits - x1) / h12;
+        nits = (y1 * (1.0f + 2.0f * t) + h12 * m1 * t) * (1.0f - t) * (1.0f - t) +
+                (y2 * (3.0f - 2.0f * t) + h12 * m2 * (t - 1.0f)) * t * t;
+    } else {
+        const float t = (nits - x2) / h23;
+        nits = (y2 * (1.0f + 2.0f * t) + h23 * m2 * t) * (1.0f - t) * (1.0f - t) +
+                (maxOutLumi * (3.0f - 2.0f * t) + h23 * m3 * (t - 1.0f)) * t * t;
+    }
+    return color * (nits / color.y);
+}
+
+vec3 inverseToneMap(const GLColorLut::Conversion& conversion, const vec3& color) {
+    constexpr float maxOutLumi = 3000.0f;
+
+    constexpr float x0 = 5.0f;
+    constexpr float y0 = 2.5f;
+    const float x1 = conversion.displayMaxLuminance * 0.7f;
+    constexpr float y1 = maxOutLumi * 0.15f;
+    const float x2 = conversion.displayMaxLuminance * 0.9f;
+    constexpr float y2 = maxOutLumi * 0.45f;
+    const float x3 = conversion.displayMaxLuminance;
+    constexpr float y3 = maxOutLumi;
+
+    constexpr float c1 = y1 / 3.0f;
+    constexpr float c2 = y2 / 2.0f;
+    constexpr float c3 = y3 / 1.5f;
+
+    float nits = color.y;
+    if (nits <= x0) {
+        return color * (y0 / x0);
+    } else if (nits <= x1) {
+        const float t = (nits - x0) / (x1 - x0);
+        nits = (1.0f - t) * (1.0f - t) * y0 + 2.0f * (1.0f - t) * t * c1 + t * t * y1;
+    } else if (nits <= x2) {
+        const float t = (nits - x1) / (x2 - x1);
+        nits = (1.0f - t) * (1.0f - t) * y1 + 2.0f * (1.0f - t) * t * c2 + t * t * y2;
+    } else {
+        const float t = (nits - x2) / (x3 - x2);
+        nits = (1.0f - t) * (1.0f - t) * y2 + 2.0f * (1.0f - t) * t * c3 + t * t * y3;
+    }
+    return color * (nits / color.y);
+}
+
+vec3 toneMap(const GLColorLut::Conversion& conversion, const vec3& color) {
+    switch (conversion.inputTransferFunction) {
+        case TransferFunction::ST2084:
+        case TransferFunction::HLG:
+            switch (conversion.outputTransferFunction) {
+                case TransferFunction::HLG:
+                    return vec3(std::clamp(color.r, 0.0f, 1000.0f),
+                                std::clamp(color.g, 0.0f, 1000.0f),
+                                std::clamp(color.b, 0.0f, 1000.0f));
+                case TransferFunction::ST2084:
+                    return color;
+                default:
+                    return toneMapHdr(conversion, color);
+            }
+        default:
+            return inverseToneMap(conversion, color);
+    }
+}
+
+vec3 normalizeLuminance(const GLColorLut::Conversion& conversion, const vec3& color) {
+    switch (conversion.outputTransferFunction) {
+        case TransferFunction::ST2084:
+            return color / 10000.0f;
+        case TransferFunction::HLG:
+            return color / 1000.0f * std::pow(color.y / 1000.0f, -0.2f / 1.2f);
+        default:
+            return color / conversion.displayMaxLuminance;
+    }
+}
+
+} // namespace
+
+GLColorLut::Conversion::Conversion(const Description& description)
+      : inputTransferFunction(description.inputTransferFunction),
+        outputTransferFunction(description.outputTransferFunction),
+        inputTransformMatrix(description.inputTransformMatrix),
+        // Same as the outputTransformMatrix uniform set by Program.
+        outputTransformMatrix(description.colorMatrix * description.outputTransformMatrix) {
+    if (needsToneMapping(inputTransferFunction, outputTransferFunction)) {
+        displayMaxLuminance = description.displayMaxLuminance;
+        maxMasteringLuminance = description.maxMasteringLuminance;
+        maxContentLuminance = description.maxContentLuminance;
+    }
+}
+
+bool GLColorLut::Conversion::operator==(const Conversion& other) const {
+    return inputTransferFunction == other.inputTransferFunction &&
+            outputTransferFunction == other.outputTransferFunction &&
+            inputTransformMatrix == other.inputTransformMatrix &&
+            outputTransformMatrix == other.outputTransformMatrix &&
+            displayMaxLuminance == other.displayMaxLuminance &&
+            maxMasteringLuminance == other.maxMasteringLuminance &&
+            maxContentLuminance == other.maxContentLuminance;
+}
+
+GLColorLut::~GLColorLut() {
+    for (const Lut& lut : mCache) {
+        glDeleteTextures(1, &lut.texture);
+    }
+}
+
+bool GLColorLut::canConvert(const Description& description) const {
+    return description.inputTransferFunction != TransferFunction::LINEAR;
+}
+
+vec3 GLColorLut::convert(const Conversion& conversion, const vec3& signal) {
+    const TransferFunction inputTF = conversion.inputTransferFunction;
+    const TransferFunction outputTF = conversion.outputTransferFunction;
+
+    vec3 color = clampToUnit(signal);
+    color = vec3(EOTF(inputTF, color.r), EOTF(inputTF, color.g), EOTF(inputTF, color.b));
+    color = transform(conversion.inputTransformMatrix, color);
+    if (needsToneMapping(inputTF, outputTF)) {
+        color = normalizeLuminance(conversion,
+                                   toneMap(conversion, scaleLuminance(conversion, color)));
+    }
+    color = (conversion.outputTransformMatrix * vec4(color, 1.0f)).xyz;
+    return vec3(encode(outputTF, color.r), encode(outputTF, color.g), encode(outputTF, color.b));
+}
+
+GLuint GLColorLut::getTexture(const Description& description) {
+    const Conversion conversion(description);
+    auto it = std::find_if(mCache.begin(), mCache.end(),
+                           [&](const Lut& lut) { return lut.conversion == conversion; });
+    if (it != mCache.end()) {
+        std::rotate(it, it + 1, mCache.end());
+        return mCache.back().texture;
+    }
+
+    if (mCache.size() == kCacheSize) {
+        glDeleteTextures(1, &mCache.front().texture);
+        mCache.pop_front();
+    }
+
+    const std::vector<half> table = generateTable(conversion);
+    GLuint texture = 0;
+    if (!mValidate) {
+        texture = createTexture(table);
+    } else if (const float error = computeError(conversion, table); error <= kMaxError) {
+        texture = createTexture(table);
+    } else {
+        ALOGD("Color LUT rejected for conversion from transfer function %d to %d, error %f",
+              static_cast<int>(conversion.inputTransferFunction),
+              static_cast<int>(conversion.outputTransferFunction), error);
+    }
+    mCache.push_back(Lut{conversion, texture});
+    return texture;
+}
+
+std::vector<half> GLColorLut::generateTable(const Conversion& conversion) {
+    ATRACE_CALL();
+
+    // Green selects the row, and blue the slice within the row.
+    std::vector<half> table;
+    table.reserve(kSize * kSize * kSize * 4);
+    for (int g = 0; g < kSize; g++) {
+        for (int b = 0; b < kSize; b++) {
+            for (int r = 0; r < kSize; r++) {
+                const vec3 color = convert(conversion, vec3(r, g, b) / float(kSize - 1));
+                table.push_back(half(color.r));
+                table.push_back(half(color.g));
+                table.push_back(half(color.b));
+                table.push_back(half(1.0f));
+            }
+        }
+    }
+    return table;
+}
+
+float GLColorLut::computeError(const Conversion& conversion, const std::vector<half>& table) {
+    ATRACE_CALL();
+
+    const auto sample = [&](int r, int g, int b) {
+        const half* texel = &table[((g * kSize + b) * kSize + r) * 4];
+        return vec3(texel[0], texel[1], texel[2]);
+    };
+
+    float maxError = 0.0f;
+    for (int g = 0; g < kSize - 1; g++) {
+        for (int b = 0; b < kSize - 1; b++) {
+            for (int r = 0; r < kSize - 1; r++) {
+                // The interpolation at the center of a cell is the average of its corners.
+                vec3 interpolated;
+                for (int corner = 0; corner < 8; corner++) {
+                    interpolated += sample(r + (corner & 1), g + ((corner >> 1) & 1),
+                                           b + ((corner >> 2) & 1));
+                }
+                interpolated = clampToUnit(interpolated / 8.0f);
+                const vec3 exact = clampToUnit(
+                        convert(conversion, (vec3(r, g, b) + 0.5f) / float(kSize - 1)));
+                const vec3 error = abs(interpolated - exact);
+                maxError = std::max({maxError, error.r, error.g, error.b});
+            }
+        }
+    }
+    return maxError;
+}
+
+GLuint GLColorLut::createTexture(const std::vector<half>& table) {
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexImage2D(GL_TEXTURE_2D, 0 /* base image level */, GL_RGBA16F, kSize * kSize, kSize,
+                 0 /* border */, GL_RGBA, GL_HALF_FLOAT, table.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return texture;
+}
+
+} // namespace gl
+} // namespace renderengine
+} // namespace android
@@ -0,0 +1,117 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <GLES2/gl2.h>
+#include <math/half.h>
+#include <math/mat4.h>
+#include <renderengine/private/Description.h>
+#include <deque>
+#include <vector>
+
+namespace android {
+namespace renderengine {
+namespace gl {
+
+/*
+ * Bakes the color conversion of a Description, from the input transfer
+ * function through the output transfer function, into a 3D lookup table
+ * indexed by the input signal values. Sampling the table replaces the transfer
+ * functions, tone mapping and matrices in the fragment shader, which are
+ * costly per pixel and each need their own program. The output is clamped to
+ * [0, 1] after sampling, and the display color matrix is still applied by the
+ * shader after that.
+ *
+ * The table is stored as a 2D texture of kSize slices of kSize x kSize texels
+ * side by side, one slice per blue value, so that it can be sampled from GLSL
+ * ES 1.00 shaders. Tables are cached by conversion, so that they are only
+ * computed once for content which keeps its dataspace and luminance.
+ *
+ * Requires OpenGL ES 3.0 for its half float texture.
+ */
+class GLColorLut {
+public:
+    // Number of samples along each axis of the table.
+    static constexpr int kSize = 33;
+
+    // If validate is set, tables are only used if they reproduce the
+    // conversion within kMaxError at the center of each of their cells. This
+    // holds for conversions to wider colorspaces, but not for conversions
+    // which clip colors, or for tone mapping, whose clamping between the
+    // matrices and transfer functions isn't interpolated precisely.
+    explicit GLColorLut(bool validate) : mValidate(validate) {}
+    ~GLColorLut();
+
+    bool isValidating() const { return mValidate; }
+
+    // Whether the conversion of the description can be looked up in a table.
+    // Linear input has most of its precision in the first few samples, so it
+    // is always converted by the shader.
+    bool canConvert(const Description& description) const;
+
+    // Returns the name of the texture holding the conversion of the description,
+    // computing it if it isn't cached, or 0 if the table is not precise enough.
+    GLuint getTexture(const Description& description);
+
+    size_t getCacheSize() const { return mCache.size(); }
+
+    // The conversion baked into a table. Parameters which don't affect the
+    // conversion are left to their defaults, so that they don't cause misses.
+    struct Conversion {
+        Description::TransferFunction inputTransferFunction = Description::TransferFunction::LINEAR;
+        Description::TransferFunction outputTransferFunction =
+                Description::TransferFunction::LINEAR;
+        mat4 inputTransformMatrix;
+        mat4 outputTransformMatrix;
+        float displayMaxLuminance = 0.0f;
+        float maxMasteringLuminance = 0.0f;
+        float maxContentLuminance = 0.0f;
+
+        explicit Conversion(const Description& description);
+        bool operator==(const Conversion& other) const;
+    };
+
+    // Converts input signal values the way the fragment shader does without the
+    // table, up to the clamping of the output signal values to [0, 1].
+    static vec3 convert(const Conversion& conversion, const vec3& signal);
+
+private:
+    struct Lut {
+        Conversion conversion;
+        // 0 if the table was rejected by the validation.
+        GLuint texture;
+    };
+
+    // Maximum error of a validated table, half of an 8 bit step.
+    static constexpr float kMaxError = 0.5f / 255.0f;
+    // Maximum size of mCache, the least recently used table is deleted beyond that.
+    static constexpr size_t kCacheSize = 4;
+
+    static std::vector<half> generateTable(const Conversion& conversion);
+    // Returns the largest difference between the conversion and the table, at
+    // the centers of its cells.
+    static float computeError(const Conversion& conversion, const std::vector<half>& table);
+    static GLuint createTexture(const std::vector<half>& table);
+
+    const bool mValidate;
+    // Cache of tables, the most recently used last.
+    std::deque<Lut> mCache;
+};
+
+} // namespace gl
+} // namespace renderengine
+} // namespace android
@@ -20,6 +20,7 @@
 #define ATRACE_TAG ATRACE_TAG_GRAPHICS
 
 #include <sched.h>
+#include <algorithm>
 #include <cmath>
 #include <fstream>
 #include <sstream>
@@ -119,6 +120,10 @@ namespace gl {
 using base::StringAppendF;
 using ui::Dataspace;
 
+// Linked programs are stored here, so that they are not compiled again on every boot.
+static constexpr const char* kProgramBinaryCachePath =
+        "/data/misc/surfaceflinger/renderengine_program_binaries";
+
 static status_t selectConfigForAttribute(EGLDisplay dpy, EGLint const* attrs, EGLint attribute,
                                          EGLint wanted, EGLConfig* outConfig) {
     EGLint numConfigs = -1, n = 0;
@@ -352,6 +357,9 @@ GLESRenderEngine::GLESRenderEngine(const RenderEngineCreationArgs& args, EGLDisp
 
     glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
     glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    // Programs may be linked on another context, so this can't rely on them
+    // enabling the position attribute.
+    glEnableVertexAttribArray(Program::position);
 
     // Initialize protected EGL Context.
     if (mProtectedEGLContext != EGL_NO_CONTEXT) {
@@ -360,6 +368,7 @@ GLESRenderEngine::GLESRenderEngine(const RenderEngineCreationArgs& args, EGLDisp
         ALOGE_IF(!success, "can't make protected context current");
         glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
         glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glEnableVertexAttribArray(Program::position);
         success = eglMakeCurrent(display, mDummySurface, mDummySurface, mEGLContext);
         LOG_ALWAYS_FATAL_IF(!success, "can't make default context current");
     }
@@ -401,6 +410,35 @@ GLESRenderEngine::GLESRenderEngine(const RenderEngineCreationArgs& args, EGLDisp
         mFlushTracer = std::make_unique<FlushTracer>(this);
     }
 
+    property_get("debug.renderengine.program_binary_cache", value, "1");
+    if (atoi(value)) {
+        ProgramCache::getInstance().enableBinaryCache(kProgramBinaryCachePath);
+    }
+
+    // 1 uses color LUTs for the conversions they reproduce precisely, and 2 for all of them.
+    property_get("debug.renderengine.color_lut", value, "1");
+    if (mUseColorManagement && atoi(value) &&
+        parseGlesVersion(GLExtensions::getInstance().getVersion()) >= GLES_VERSION_3_0) {
+        mColorLut = std::make_unique<GLColorLut>(/*validate*/ atoi(value) == 1);
+    }
+
+    property_get("debug.renderengine.background_prime_cache", value, "1");
+    if (atoi(value)) {
+        mPrimingEGLContext = createEglContext(display, config, mEGLContext,
+                                              /*useContextPriority*/ false, Protection::UNPROTECTED);
+        if (mPrimingEGLContext != EGL_NO_CONTEXT &&
+            !GLExtensions::getInstance().hasSurfacelessContext()) {
+            mPrimingDummySurface = createDummyEglPbufferSurface(display, config, args.pixelFormat,
+                                                                Protection::UNPROTECTED);
+            if (mPrimingDummySurface == EGL_NO_SURFACE) {
+                eglDestroyContext(display, mPrimingEGLContext);
+                mPrimingEGLContext = EGL_NO_CONTEXT;
+            }
+        }
+        ALOGE_IF(mPrimingEGLContext == EGL_NO_CONTEXT,
+                 "Can't create priming context, priming the program cache synchronously");
+    }
+
     if (args.supportsBackgroundBlur) {
         mBlurFilter = new BlurFilter(*this);
         checkErrors("BlurFilter creation");
@@ -431,9 +469,17 @@ GLESRenderEngine::GLESRenderEngine(const RenderEngineCreationArgs& args, EGLDisp
 GLESRenderEngine::~GLESRenderEngine() {
     // Destroy the image manager first.
     mImageManager = nullptr;
+    ProgramCache::getInstance().waitForPriming();
+    if (mPrimingEGLContext != EGL_NO_CONTEXT) {
+        eglDestroyContext(mEGLDisplay, mPrimingEGLContext);
+    }
+    if (mPrimingDummySurface != EGL_NO_SURFACE) {
+        eglDestroySurface(mEGLDisplay, mPrimingDummySurface);
+    }
     std::lock_guard<std::mutex> lock(mRenderingMutex);
     unbindFrameBuffer(mDrawingBuffer.get());
     mDrawingBuffer = nullptr;
+    mColorLut = nullptr;
     while (!mFramebufferImageCache.empty()) {
         EGLImageKHR expired = mFramebufferImageCache.front().second;
         mFramebufferImageCache.pop_front();
@@ -459,9 +505,20 @@ Framebuffer* GLESRenderEngine::getFramebufferForDrawing() {
 }
 
 void GLESRenderEngine::primeCache() const {
-    ProgramCache::getInstance().primeCache(mInProtectedContext ? mProtectedEGLContext : mEGLContext,
-                                           mArgs.useColorManagement,
-                                           mArgs.precacheToneMapperShaderOnly);
+    const EGLContext context = mInProtectedContext ? mProtectedEGLContext : mEGLContext;
+    const bool useColorLut = mColorLut != nullptr;
+    // Tone mapping tables are rejected by the validation.
+    const bool useToneMappingLut = useColorLut && !mColorLut->isValidating();
+    if (mPrimingEGLContext != EGL_NO_CONTEXT) {
+        ProgramCache::getInstance().primeCacheInBackground(mEGLDisplay, mPrimingEGLContext,
+                                                           mPrimingDummySurface, context,
+                                                           mArgs.useColorManagement,
+                                                           useColorLut, useToneMappingLut,
+                                                           mArgs.precacheToneMapperShaderOnly);
+        return;
+    }
+    ProgramCache::getInstance().primeCache(context, mArgs.useColorManagement, useColorLut,
+                                           useToneMappingLut, mArgs.precacheToneMapperShaderOnly);
 }
 
 base::unique_fd GLESRenderEngine::flush() {
@@ -638,13 +695,20 @@ status_t GLESRenderEngine::bindExternalTextureBuffer(uint32_t texName,
         std::lock_guard<std::mutex> lock(mRenderingMutex);
         auto cachedImage = mImageCache.find(buffer->getId());
         found = (cachedImage != mImageCache.end());
+        if (!found) {
+            mImageCacheMisses++;
+        }
     }
 
     // If we couldn't find the image in the cache at this time, then either
     // SurfaceFlinger messed up registering the buffer ahead of time or we got
-    // backed up creating other EGLImages.
+    // backed up creating other EGLImages. Either way, create the image right
+    // here rather than waiting for the ImageManager to go through its whole
+    // queue first. If the ImageManager is creating the same image meanwhile,
+    // only one of the two is kept.
     if (!found) {
-        status_t cacheResult = mImageManager->cache(buffer);
+        ATRACE_NAME("ImageCacheMiss");
+        status_t cacheResult = cacheExternalTextureBufferInternal(buffer);
         if (cacheResult != NO_ERROR) {
             return cacheResult;
         }
@@ -1064,7 +1128,13 @@ status_t GLESRenderEngine::drawLayers(const DisplaySettings& display,
     }
     const auto blurLayersSize = blurLayers.size();
 
-    if (blurLayersSize == 0) {
+    // When the only blurred layer has the same layers underneath it as during the last frame,
+    // the blur prepared back then is still valid. These layers don't need to be drawn, and the
+    // blur only needs to be rendered onto the native buffer.
+    bool reuseBlur = blurLayersSize == 1 &&
+            mBlurFilter->isCached(display, layers, blurLayers.front());
+
+    if (blurLayersSize == 0 || reuseBlur) {
         fbo = std::make_unique<BindNativeBufferAsFramebuffer>(*this, buffer, useFramebufferCache);
         if (fbo->getStatus() != NO_ERROR) {
             ALOGE("Failed to bind framebuffer! Aborting GPU composition for buffer (%p).",
@@ -1074,6 +1144,7 @@ status_t GLESRenderEngine::drawLayers(const DisplaySettings& display,
         }
         setViewportAndProjection(display.physicalDisplay, display.clip);
     } else {
+        mBlurFilter->invalidateCache();
         setViewportAndProjection(display.physicalDisplay, display.clip);
         auto status =
                 mBlurFilter->setAsDrawTarget(display, blurLayers.front()->backgroundBlurRadius);
@@ -1085,6 +1156,14 @@ status_t GLESRenderEngine::drawLayers(const DisplaySettings& display,
         }
     }
 
+    // Only the damaged part of the buffer needs to be redrawn, unless there is
+    // blurring, which samples content from outside of the damage.
+    const Rect damage = display.damageRegion.getBounds();
+    const bool partialRedraw = blurLayersSize == 0 && damage.isValid();
+    if (partialRedraw) {
+        setScissor(damage);
+    }
+
     // clear the entire buffer, sometimes when we reuse buffers we'd persist
     // ghost images otherwise.
     // we also require a full transparent framebuffer for overlays. This is
@@ -1113,31 +1192,43 @@ status_t GLESRenderEngine::drawLayers(const DisplaySettings& display,
         if (blurLayers.size() > 0 && blurLayers.front() == layer) {
             blurLayers.pop_front();
 
-            auto status = mBlurFilter->prepare();
-            if (status != NO_ERROR) {
-                ALOGE("Failed to render blur effect! Aborting GPU composition for buffer (%p).",
-                      buffer->handle);
-                checkErrors("Can't render first blur pass");
-                return status;
-            }
-
-            if (blurLayers.size() == 0) {
-                // Done blurring, time to bind the native FBO and render our blur onto it.
-                fbo = std::make_unique<BindNativeBufferAsFramebuffer>(*this, buffer,
-                                                                      useFramebufferCache);
-                status = fbo->getStatus();
-                setViewportAndProjection(display.physicalDisplay, display.clip);
+            status_t status = NO_ERROR;
+            if (reuseBlur) {
+                ATRACE_NAME("BlurFilter::reuse");
+                reuseBlur = false;
             } else {
-                // There's still something else to blur, so let's keep rendering to our FBO
-                // instead of to the display.
-                status = mBlurFilter->setAsDrawTarget(display,
-                                                      blurLayers.front()->backgroundBlurRadius);
-            }
-            if (status != NO_ERROR) {
-                ALOGE("Failed to bind framebuffer! Aborting GPU composition for buffer (%p).",
-                      buffer->handle);
-                checkErrors("Can't bind native framebuffer");
-                return status;
+                status = mBlurFilter->prepare();
+                if (status != NO_ERROR) {
+                    ALOGE("Failed to render blur effect! Aborting GPU composition for buffer "
+                          "(%p).",
+                          buffer->handle);
+                    checkErrors("Can't render first blur pass");
+                    return status;
+                }
+
+                if (blurLayers.size() == 0) {
+                    // Done blurring, time to bind the native FBO and render our blur onto it.
+                    fbo = std::make_unique<BindNativeBufferAsFramebuffer>(*this, buffer,
+                                                                          useFramebufferCache);
+                    status = fbo->getStatus();
+                    setViewportAndProjection(display.physicalDisplay, display.clip);
+                    // With a single blur, nothing else is going to be drawn into the blur
+                    // buffers, so the blur can be reused by the next frames.
+                    if (blurLayersSize == 1) {
+                        mBlurFilter->updateCache(display, layers, layer);
+                    }
+                } else {
+                    // There's still something else to blur, so let's keep rendering to our FBO
+                    // instead of to the display.
+                    status = mBlurFilter->setAsDrawTarget(display,
+                                                          blurLayers.front()->backgroundBlurRadius);
+                }
+                if (status != NO_ERROR) {
+                    ALOGE("Failed to bind framebuffer! Aborting GPU composition for buffer (%p).",
+                          buffer->handle);
+                    checkErrors("Can't bind native framebuffer");
+                    return status;
+                }
             }
 
             status = mBlurFilter->render(blurLayersSize > 1);
@@ -1147,6 +1238,9 @@ status_t GLESRenderEngine::drawLayers(const DisplaySettings& display,
                 checkErrors("Can't render blur filter");
                 return status;
             }
+        } else if (reuseBlur) {
+            // Already part of the reused blur.
+            continue;
         }
 
         mState.maxMasteringLuminance = layer->source.buffer.maxMasteringLuminance;
@@ -1209,8 +1303,10 @@ status_t GLESRenderEngine::drawLayers(const DisplaySettings& display,
         }
         // We only want to do a special handling for rounded corners when having rounded corners
         // is the only reason it needs to turn on blending, otherwise, we handle it like the
-        // usual way since it needs to turn on blending anyway.
-        else if (layer->geometry.roundedCornersRadius > 0.0 && color.a >= 1.0f && isOpaque) {
+        // usual way since it needs to turn on blending anyway. The special handling relies on
+        // the scissor test, so it is not used when only redrawing the damaged region.
+        else if (layer->geometry.roundedCornersRadius > 0.0 && color.a >= 1.0f && isOpaque &&
+                 !partialRedraw) {
             handleRoundedCorners(display, *layer, mesh);
         } else {
             drawMesh(mesh);
@@ -1224,6 +1320,10 @@ status_t GLESRenderEngine::drawLayers(const DisplaySettings& display,
         }
     }
 
+    if (partialRedraw) {
+        disableScissor();
+    }
+
     if (drawFence != nullptr) {
         *drawFence = flush();
     }
@@ -1465,6 +1565,22 @@ void GLESRenderEngine::drawMesh(const Mesh& mesh) {
             managedState.outputTransferFunction =
                     Description::dataSpaceToTransferFunction(outputTransfer);
         }
+
+        // The LUT is indexed by signal values in [0, 1], so it can't be used for extended range
+        // input, which has part of its range outside of that.
+        const bool needsConversion = managedState.hasInputTransformMatrix() ||
+                managedState.hasOutputTransformMatrix() || managedState.hasColorMatrix() ||
+                managedState.inputTransferFunction != managedState.outputTransferFunction;
+        const Dataspace inputRange = static_cast<Dataspace>(mDataSpace & Dataspace::RANGE_MASK);
+        if (mColorLut && needsConversion && inputRange != Dataspace::RANGE_EXTENDED &&
+            mColorLut->canConvert(managedState)) {
+            if (const GLuint colorLut = mColorLut->getTexture(managedState); colorLut != 0) {
+                glActiveTexture(GL_TEXTURE1);
+                glBindTexture(GL_TEXTURE_2D, colorLut);
+                glActiveTexture(GL_TEXTURE0);
+                managedState.colorLutEnabled = true;
+            }
+        }
     }
 
     ProgramCache::getInstance().useProgram(mInProtectedContext ? mProtectedEGLContext : mEGLContext,
@@ -1522,12 +1638,19 @@ void GLESRenderEngine::dump(std::string& result) {
                   cache.getSize(mEGLContext));
     StringAppendF(&result, "RenderEngine program cache size for protected context: %zu\n",
                   cache.getSize(mProtectedEGLContext));
+    StringAppendF(&result, "RenderEngine program binary cache size: %zu (%zu programs loaded)\n",
+                  cache.getBinaryCacheSize(), cache.getBinaryCacheHits());
+    cache.dump(result);
     StringAppendF(&result, "RenderEngine last dataspace conversion: (%s) to (%s)\n",
                   dataspaceDetails(static_cast<android_dataspace>(mDataSpace)).c_str(),
                   dataspaceDetails(static_cast<android_dataspace>(mOutputDataSpace)).c_str());
+    StringAppendF(&result, "RenderEngine color LUT cache size: %zu\n",
+                  mColorLut ? mColorLut->getCacheSize() : 0);
     {
         std::lock_guard<std::mutex> lock(mRenderingMutex);
         StringAppendF(&result, "RenderEngine image cache size: %zu\n", mImageCache.size());
+        StringAppendF(&result, "RenderEngine image cache misses while drawing: %zu\n",
+                      mImageCacheMisses);
         StringAppendF(&result, "Dumping buffer ids...\n");
         for (const auto& [id, unused] : mImageCache) {
             StringAppendF(&result, "0x%" PRIx64 "\n", id);
@@ -1743,6 +1866,26 @@ void GLESRenderEngine::FlushTracer::loop() {
 void GLESRenderEngine::handleShadow(const FloatRect& casterRect, float casterCornerRadius,
                                     const ShadowSettings& settings) {
     ATRACE_CALL();
+    const Mesh& mesh = getShadowMesh(casterRect, casterCornerRadius, settings);
+
+    mState.cornerRadius = 0.0f;
+    mState.drawShadows = true;
+    setupLayerTexturing(mShadowTexture.getTexture());
+    drawMesh(mesh);
+    mState.drawShadows = false;
+}
+
+const Mesh& GLESRenderEngine::getShadowMesh(const FloatRect& casterRect, float casterCornerRadius,
+                                            const ShadowSettings& settings) {
+    for (auto it = mShadowMeshCache.begin(); it != mShadowMeshCache.end(); it++) {
+        if (it->casterRect == casterRect && it->casterCornerRadius == casterCornerRadius &&
+            it->settings == settings) {
+            std::rotate(it, it + 1, mShadowMeshCache.end());
+            return *mShadowMeshCache.back().mesh;
+        }
+    }
+
+    ATRACE_NAME("GLESRenderEngine::tessellateShadow");
     const float casterZ = settings.length / 2.0f;
     const GLShadowVertexGenerator shadows(casterRect, casterCornerRadius, casterZ,
                                           settings.casterIsTranslucent, settings.ambientColor,
@@ -1750,24 +1893,25 @@ void GLESRenderEngine::handleShadow(const FloatRect& casterRect, float casterCor
                                           settings.lightRadius);
 
     // setup mesh for both shadows
-    Mesh mesh = Mesh::Builder()
-                        .setPrimitive(Mesh::TRIANGLES)
-                        .setVertices(shadows.getVertexCount(), 2 /* size */)
-                        .setShadowAttrs()
-                        .setIndices(shadows.getIndexCount())
-                        .build();
-
-    Mesh::VertexArray<vec2> position = mesh.getPositionArray<vec2>();
-    Mesh::VertexArray<vec4> shadowColor = mesh.getShadowColorArray<vec4>();
-    Mesh::VertexArray<vec3> shadowParams = mesh.getShadowParamsArray<vec3>();
+    std::unique_ptr<Mesh> mesh(new Mesh(Mesh::Builder()
+                                                .setPrimitive(Mesh::TRIANGLES)
+                                                .setVertices(shadows.getVertexCount(),
+                                                             2 /* size */)
+                                                .setShadowAttrs()
+                                                .setIndices(shadows.getIndexCount())
+                                                .build()));
+
+    Mesh::VertexArray<vec2> position = mesh->getPositionArray<vec2>();
+    Mesh::VertexArray<vec4> shadowColor = mesh->getShadowColorArray<vec4>();
+    Mesh::VertexArray<vec3> shadowParams = mesh->getShadowParamsArray<vec3>();
     shadows.fillVertices(position, shadowColor, shadowParams);
-    shadows.fillIndices(mesh.getIndicesArray());
+    shadows.fillIndices(mesh->getIndicesArray());
 
-    mState.cornerRadius = 0.0f;
-    mState.drawShadows = true;
-    setupLayerTexturing(mShadowTexture.getTexture());
-    drawMesh(mesh);
-    mState.drawShadows = false;
+    if (mShadowMeshCache.size() >= kShadowMeshCacheSize) {
+        mShadowMeshCache.pop_front();
+    }
+    mShadowMeshCache.push_back({casterRect, casterCornerRadius, settings, std::move(mesh)});
+    return *mShadowMeshCache.back().mesh;
 }
 
 } // namespace gl
@@ -31,6 +31,7 @@
 #include <renderengine/RenderEngine.h>
 #include <renderengine/private/Description.h>
 #include <sys/types.h>
+#include "GLColorLut.h"
 #include "GLShadowTexture.h"
 #include "ImageManager.h"
 
@@ -160,6 +161,10 @@ private:
     void fillRegionWithColor(const Region& region, float red, float green, float blue, float alpha);
     void handleShadow(const FloatRect& casterRect, float casterCornerRadius,
                       const ShadowSettings& shadowSettings);
+    // Returns the mesh of the shadows cast by casterRect, tessellating them only if they are not
+    // in mShadowMeshCache yet.
+    const Mesh& getShadowMesh(const FloatRect& casterRect, float casterCornerRadius,
+                              const ShadowSettings& shadowSettings);
     void setupLayerBlending(bool premultipliedAlpha, bool opaque, bool disableTexture,
                             const half4& color, float cornerRadius);
     void setupLayerTexturing(const Texture& texture);
@@ -185,6 +190,10 @@ private:
     EGLSurface mDummySurface;
     EGLContext mProtectedEGLContext;
     EGLSurface mProtectedDummySurface;
+    // Shares its programs with mEGLContext, and is used to prime the program
+    // cache in the background.
+    EGLContext mPrimingEGLContext = EGL_NO_CONTEXT;
+    EGLSurface mPrimingDummySurface = EGL_NO_SURFACE;
     GLint mMaxViewportDims[2];
     GLint mMaxTextureSize;
     GLuint mVpWidth;
@@ -192,6 +201,20 @@ private:
     Description mState;
     GLShadowTexture mShadowTexture;
 
+    // Shadow meshes are cached for as long as their caster and settings don't change, which is
+    // the case for the whole of most window animations, so that they're not tessellated again
+    // for every frame.
+    struct ShadowMesh {
+        FloatRect casterRect;
+        float casterCornerRadius;
+        ShadowSettings settings;
+        std::unique_ptr<Mesh> mesh;
+    };
+    // Maximum size of mShadowMeshCache, the least recently used mesh is kicked out beyond that.
+    static constexpr size_t kShadowMeshCacheSize = 8;
+    // Cache of shadow meshes, the most recently used last.
+    std::deque<ShadowMesh> mShadowMeshCache;
+
     mat4 mSrgbToXyz;
     mat4 mDisplayP3ToXyz;
     mat4 mBt2020ToXyz;
@@ -229,8 +252,15 @@ private:
     // supports sRGB, DisplayP3 color spaces.
     const bool mUseColorManagement = false;
 
+    // Color conversions are looked up in LUTs rather than computed in the fragment shaders, when
+    // enabled. Only available with OpenGL ES 3.0.
+    std::unique_ptr<GLColorLut> mColorLut;
+
     // Cache of GL images that we'll store per GraphicBuffer ID
     std::unordered_map<uint64_t, std::unique_ptr<Image>> mImageCache GUARDED_BY(mRenderingMutex);
+    // Number of buffers that had no image in mImageCache yet when they were bound for drawing,
+    // which then had to wait for the image to be created.
+    size_t mImageCacheMisses GUARDED_BY(mRenderingMutex) = 0;
     std::unordered_map<uint32_t, std::optional<uint64_t>> mTextureView;
 
     // Mutex guarding rendering operations, so that:
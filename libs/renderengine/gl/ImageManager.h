@@ -45,7 +45,6 @@ public:
     void initThread();
     void cacheAsync(const sp<GraphicBuffer>& buffer, const std::shared_ptr<Barrier>& barrier)
             EXCLUDES(mMutex);
-    status_t cache(const sp<GraphicBuffer>& buffer);
     void releaseAsync(uint64_t bufferId, const std::shared_ptr<Barrier>& barrier) EXCLUDES(mMutex);
 
 private:
@@ -18,6 +18,7 @@
 
 #include <stdint.h>
 
+#include <GLES2/gl2ext.h>
 #include <log/log.h>
 #include <math/mat4.h>
 #include <utils/String8.h>
@@ -61,27 +62,51 @@ Program::Program(const ProgramCache::Key& /*needs*/, const char* vertex, const c
         mProgram = programId;
         mVertexShader = vertexId;
         mFragmentShader = fragmentId;
-        mInitialized = true;
-        mProjectionMatrixLoc = glGetUniformLocation(programId, "projection");
-        mTextureMatrixLoc = glGetUniformLocation(programId, "texture");
-        mSamplerLoc = glGetUniformLocation(programId, "sampler");
-        mColorLoc = glGetUniformLocation(programId, "color");
-        mDisplayColorMatrixLoc = glGetUniformLocation(programId, "displayColorMatrix");
-        mDisplayMaxLuminanceLoc = glGetUniformLocation(programId, "displayMaxLuminance");
-        mMaxMasteringLuminanceLoc = glGetUniformLocation(programId, "maxMasteringLuminance");
-        mMaxContentLuminanceLoc = glGetUniformLocation(programId, "maxContentLuminance");
-        mInputTransformMatrixLoc = glGetUniformLocation(programId, "inputTransformMatrix");
-        mOutputTransformMatrixLoc = glGetUniformLocation(programId, "outputTransformMatrix");
-        mCornerRadiusLoc = glGetUniformLocation(programId, "cornerRadius");
-        mCropCenterLoc = glGetUniformLocation(programId, "cropCenter");
-
-        // set-up the default values for our uniforms
-        glUseProgram(programId);
-        glUniformMatrix4fv(mProjectionMatrixLoc, 1, GL_FALSE, mat4().asArray());
-        glEnableVertexAttribArray(0);
+        initialize(programId);
     }
 }
 
+Program::Program(const ProgramCache::Key& /*needs*/, GLenum binaryFormat,
+                 const std::vector<uint8_t>& binary)
+      : mInitialized(false), mProgram(0), mVertexShader(0), mFragmentShader(0) {
+    GLuint programId = glCreateProgram();
+    glProgramBinaryOES(programId, binaryFormat, binary.data(), static_cast<GLint>(binary.size()));
+
+    GLint status;
+    glGetProgramiv(programId, GL_LINK_STATUS, &status);
+    if (status != GL_TRUE) {
+        // This is expected after a driver update, so the caller just compiles the program.
+        ALOGW("Program binary was rejected by the driver");
+        glDeleteProgram(programId);
+    } else {
+        // Attribute locations are part of the binary, so they don't need to be bound again.
+        mProgram = programId;
+        initialize(programId);
+    }
+}
+
+void Program::initialize(GLuint programId) {
+    mInitialized = true;
+    mProjectionMatrixLoc = glGetUniformLocation(programId, "projection");
+    mTextureMatrixLoc = glGetUniformLocation(programId, "texture");
+    mSamplerLoc = glGetUniformLocation(programId, "sampler");
+    mColorLoc = glGetUniformLocation(programId, "color");
+    mDisplayColorMatrixLoc = glGetUniformLocation(programId, "displayColorMatrix");
+    mDisplayMaxLuminanceLoc = glGetUniformLocation(programId, "displayMaxLuminance");
+    mMaxMasteringLuminanceLoc = glGetUniformLocation(programId, "maxMasteringLuminance");
+    mMaxContentLuminanceLoc = glGetUniformLocation(programId, "maxContentLuminance");
+    mInputTransformMatrixLoc = glGetUniformLocation(programId, "inputTransformMatrix");
+    mOutputTransformMatrixLoc = glGetUniformLocation(programId, "outputTransformMatrix");
+    mCornerRadiusLoc = glGetUniformLocation(programId, "cornerRadius");
+    mCropCenterLoc = glGetUniformLocation(programId, "cropCenter");
+    mColorLutLoc = glGetUniformLocation(programId, "colorLut");
+
+    // set-up the default values for our uniforms
+    glUseProgram(programId);
+    glUniformMatrix4fv(mProjectionMatrixLoc, 1, GL_FALSE, mat4().asArray());
+    glEnableVertexAttribArray(0);
+}
+
 bool Program::isValid() const {
     return mInitialized;
 }
@@ -100,6 +125,26 @@ GLint Program::getUniform(const char* name) const {
     return glGetUniformLocation(mProgram, name);
 }
 
+bool Program::getBinary(GLenum* binaryFormat, std::vector<uint8_t>* binary) const {
+    if (!mInitialized) {
+        return false;
+    }
+    GLint length = 0;
+    glGetProgramiv(mProgram, GL_PROGRAM_BINARY_LENGTH_OES, &length);
+    if (length <= 0) {
+        return false;
+    }
+    binary->resize(static_cast<size_t>(length));
+    GLsizei written = 0;
+    glGetProgramBinaryOES(mProgram, length, &written, binaryFormat, binary->data());
+    if (written <= 0) {
+        binary->clear();
+        return false;
+    }
+    binary->resize(static_cast<size_t>(written));
+    return true;
+}
+
 GLuint Program::buildShader(const char* source, GLenum type) {
     GLuint shader = glCreateShader(type);
     glShaderSource(shader, 1, &source, 0);
@@ -158,6 +203,9 @@ void Program::setUniforms(const Description& desc) {
     if (mCropCenterLoc >= 0) {
         glUniform2f(mCropCenterLoc, desc.cropSize.x / 2.0f, desc.cropSize.y / 2.0f);
     }
+    if (mColorLutLoc >= 0) {
+        glUniform1i(mColorLutLoc, 1);
+    }
     // these uniforms are always present
     glUniformMatrix4fv(mProjectionMatrixLoc, 1, GL_FALSE, desc.projectionMatrix.asArray());
 }
@@ -18,6 +18,7 @@
 #define SF_RENDER_ENGINE_PROGRAM_H
 
 #include <stdint.h>
+#include <vector>
 
 #include <GLES2/gl2.h>
 #include <renderengine/private/Description.h>
@@ -54,6 +55,9 @@ public:
     };
 
     Program(const ProgramCache::Key& needs, const char* vertex, const char* fragment);
+    // Creates the program from a binary previously returned by getBinary. The
+    // program is invalid if the driver rejects the binary.
+    Program(const ProgramCache::Key& needs, GLenum binaryFormat, const std::vector<uint8_t>& binary);
     ~Program() = default;
 
     /* whether this object is usable */
@@ -71,8 +75,12 @@ public:
     /* set-up uniforms from the description */
     void setUniforms(const Description& desc);
 
+    /* Returns the linked program binary, so that it can be reused without compiling */
+    bool getBinary(GLenum* binaryFormat, std::vector<uint8_t>* binary) const;
+
 private:
     GLuint buildShader(const char* source, GLenum type);
+    void initialize(GLuint programId);
 
     // whether the initialization succeeded
     bool mInitialized;
@@ -111,6 +119,9 @@ private:
 
     /* location of surface crop origin uniform, for rounded corner clipping */
     GLint mCropCenterLoc;
+
+    /* location of the color LUT sampler uniform */
+    GLint mColorLutLoc;
 };
 
 } // namespace gl
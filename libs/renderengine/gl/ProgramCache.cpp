@@ -18,12 +18,24 @@
 
 #include "ProgramCache.h"
 
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
+#include <android-base/file.h>
+#include <android-base/stringprintf.h>
+#include <cutils/properties.h>
 #include <log/log.h>
 #include <renderengine/private/Description.h>
 #include <utils/String8.h>
 #include <utils/Trace.h>
+#include "GLColorLut.h"
+#include "GLExtensions.h"
 #include "Program.h"
 
 ANDROID_SINGLETON_STATIC_INSTANCE(android::renderengine::gl::ProgramCache)
@@ -32,6 +44,12 @@ namespace android {
 namespace renderengine {
 namespace gl {
 
+// "SFPB", for SurfaceFlinger program binaries.
+static constexpr uint32_t kBinaryCacheMagic = 0x42504653;
+// Bumped when the file layout changes. Shader changes come with a new build
+// fingerprint, which already invalidates the stored binaries.
+static constexpr uint32_t kBinaryCacheVersion = 1;
+
 /*
  * A simple formatter class to automatically add the endl and
  * manage the indentation.
@@ -77,12 +95,31 @@ Formatter& dedent(Formatter& f) {
     return f;
 }
 
-void ProgramCache::primeCache(
-        EGLContext context, bool useColorManagement, bool toneMapperShaderOnly) {
-    auto& cache = mCaches[context];
-    uint32_t shaderCount = 0;
+std::vector<ProgramCache::PrimingTier> ProgramCache::getPrimingTiers(bool useColorManagement,
+                                                                     bool useColorLut,
+                                                                     bool useToneMappingLut,
+                                                                     bool toneMapperShaderOnly) {
+    std::vector<PrimingTier> tiers;
+    // Tiers are filled in through references, which must not be invalidated.
+    tiers.reserve(3);
+
+    if (toneMapperShaderOnly && useToneMappingLut) {
+        PrimingTier& tier = tiers.emplace_back(PrimingTier{"HDR tone mapping", {}});
+        Key shaderKey;
+        // The tone mapping is in the LUT, so only Y410 makes a difference.
+        shaderKey.set(Key::BLEND_MASK | Key::COLOR_LUT_MASK | Key::OPACITY_MASK | Key::ALPHA_MASK |
+                              Key::ROUNDED_CORNERS_MASK | Key::TEXTURE_MASK,
+                      Key::BLEND_NORMAL | Key::COLOR_LUT_ON | Key::OPACITY_OPAQUE |
+                              Key::ALPHA_EQ_ONE | Key::ROUNDED_CORNERS_OFF | Key::TEXTURE_EXT);
+        for (int i = 0; i < 2; i++) {
+            shaderKey.set(Key::Y410_BT2020_MASK, i ? Key::Y410_BT2020_ON : Key::Y410_BT2020_OFF);
+            tier.keys.push_back(shaderKey);
+        }
+        return tiers;
+    }
 
     if (toneMapperShaderOnly) {
+        PrimingTier& tier = tiers.emplace_back(PrimingTier{"HDR tone mapping", {}});
         Key shaderKey;
         // base settings used by HDR->SDR tonemap only
         shaderKey.set(Key::BLEND_MASK | Key::INPUT_TRANSFORM_MATRIX_MASK |
@@ -101,20 +138,18 @@ void ProgramCache::primeCache(
             // Cache Y410 input on or off
             shaderKey.set(Key::Y410_BT2020_MASK, (i & 2) ?
                     Key::Y410_BT2020_ON : Key::Y410_BT2020_OFF);
-            if (cache.count(shaderKey) == 0) {
-                cache.emplace(shaderKey, generateProgram(shaderKey));
-                shaderCount++;
-            }
+            tier.keys.push_back(shaderKey);
         }
-        return;
+        return tiers;
     }
 
+    // Prime the cache for all combinations of the masks below, leaving off the
+    // experimental color matrix mask options. Keys without rounded corners are
+    // the ones nearly every frame needs, so they are primed first.
+    PrimingTier& sdrTier = tiers.emplace_back(PrimingTier{"SDR", {}});
+    PrimingTier& roundedCornersTier = tiers.emplace_back(PrimingTier{"SDR rounded corners", {}});
     uint32_t keyMask = Key::BLEND_MASK | Key::OPACITY_MASK | Key::ALPHA_MASK | Key::TEXTURE_MASK
         | Key::ROUNDED_CORNERS_MASK;
-    // Prime the cache for all combinations of the above masks,
-    // leaving off the experimental color matrix mask options.
-
-    nsecs_t timeBefore = systemTime();
     for (uint32_t keyVal = 0; keyVal <= keyMask; keyVal++) {
         Key shaderKey;
         shaderKey.set(keyMask, keyVal);
@@ -122,19 +157,22 @@ void ProgramCache::primeCache(
         if (tex != Key::TEXTURE_OFF && tex != Key::TEXTURE_EXT && tex != Key::TEXTURE_2D) {
             continue;
         }
-        if (cache.count(shaderKey) == 0) {
-            cache.emplace(shaderKey, generateProgram(shaderKey));
-            shaderCount++;
-        }
+        (shaderKey.hasRoundedCorners() ? roundedCornersTier : sdrTier).keys.push_back(shaderKey);
     }
 
     // Prime for sRGB->P3 conversion
     if (useColorManagement) {
+        PrimingTier& tier = tiers.emplace_back(PrimingTier{"wide color", {}});
         Key shaderKey;
-        shaderKey.set(Key::BLEND_MASK | Key::OUTPUT_TRANSFORM_MATRIX_MASK | Key::INPUT_TF_MASK |
-                              Key::OUTPUT_TF_MASK,
-                      Key::BLEND_PREMULT | Key::OUTPUT_TRANSFORM_MATRIX_ON | Key::INPUT_TF_SRGB |
-                              Key::OUTPUT_TF_SRGB);
+        if (useColorLut) {
+            shaderKey.set(Key::BLEND_MASK | Key::COLOR_LUT_MASK,
+                          Key::BLEND_PREMULT | Key::COLOR_LUT_ON);
+        } else {
+            shaderKey.set(Key::BLEND_MASK | Key::OUTPUT_TRANSFORM_MATRIX_MASK |
+                                  Key::INPUT_TF_MASK | Key::OUTPUT_TF_MASK,
+                          Key::BLEND_PREMULT | Key::OUTPUT_TRANSFORM_MATRIX_ON |
+                                  Key::INPUT_TF_SRGB | Key::OUTPUT_TF_SRGB);
+        }
         for (int i = 0; i < 16; i++) {
             shaderKey.set(Key::OPACITY_MASK,
                           (i & 1) ? Key::OPACITY_OPAQUE : Key::OPACITY_TRANSLUCENT);
@@ -146,16 +184,319 @@ void ProgramCache::primeCache(
 
             // Cache texture off option for window transition
             shaderKey.set(Key::TEXTURE_MASK, (i & 8) ? Key::TEXTURE_EXT : Key::TEXTURE_OFF);
-            if (cache.count(shaderKey) == 0) {
-                cache.emplace(shaderKey, generateProgram(shaderKey));
-                shaderCount++;
+            tier.keys.push_back(shaderKey);
+        }
+    }
+
+    return tiers;
+}
+
+void ProgramCache::primeTier(EGLContext context, const PrimingTier& tier, bool sharedContext) {
+    ATRACE_NAME(tier.name);
+
+    size_t shaderCount = 0;
+    nsecs_t timeBefore = systemTime();
+    for (const Key& shaderKey : tier.keys) {
+        {
+            std::lock_guard lock(mMutex);
+            if (mCaches[context].count(shaderKey) != 0) {
+                mPrimingKeys.erase(shaderKey);
+                continue;
             }
         }
+        auto program = createProgram(shaderKey);
+        if (sharedContext) {
+            // Programs are shared with the composition context, which may only
+            // use them once they are fully built.
+            glFinish();
+        }
+        {
+            std::lock_guard lock(mMutex);
+            mCaches[context].emplace(shaderKey, std::move(program));
+            mPrimingKeys.erase(shaderKey);
+        }
+        mPrimedCondition.notify_all();
+        shaderCount++;
+    }
+    nsecs_t time = systemTime() - timeBefore;
+
+    std::lock_guard lock(mMutex);
+    mPrimingTimes.push_back(PrimingTime{tier.name, shaderCount, time});
+    ALOGD("shader cache tier %s generated - %zu shaders in %f ms\n", tier.name, shaderCount,
+          static_cast<float>(time) / 1.0E6);
+}
+
+void ProgramCache::primeCache(EGLContext context, bool useColorManagement, bool useColorLut,
+                              bool useToneMappingLut, bool toneMapperShaderOnly) {
+    waitForPriming();
+    for (const PrimingTier& tier : getPrimingTiers(useColorManagement, useColorLut,
+                                                   useToneMappingLut, toneMapperShaderOnly)) {
+        primeTier(context, tier, /*sharedContext*/ false);
+    }
+    storeBinaries();
+}
+
+void ProgramCache::primeCacheInBackground(EGLDisplay display, EGLContext primingContext,
+                                          EGLSurface primingSurface, EGLContext context,
+                                          bool useColorManagement, bool useColorLut,
+                                          bool useToneMappingLut, bool toneMapperShaderOnly) {
+    waitForPriming();
+    std::vector<PrimingTier> tiers = getPrimingTiers(useColorManagement, useColorLut,
+                                                     useToneMappingLut, toneMapperShaderOnly);
+    {
+        std::lock_guard lock(mMutex);
+        for (const PrimingTier& tier : tiers) {
+            mPrimingKeys.insert(tier.keys.begin(), tier.keys.end());
+        }
+    }
+
+    mPrimingThread = std::thread([this, display, primingContext, primingSurface, context,
+                                  tiers = std::move(tiers)]() {
+        pthread_setname_np(pthread_self(), "ProgramCache");
+        // Composition has priority over priming, so this does not inherit the
+        // realtime priority of the thread which started it.
+        struct sched_param param = {0};
+        if (pthread_setschedparam(pthread_self(), SCHED_OTHER, &param) != 0) {
+            ALOGW("Couldn't set SCHED_OTHER for priming");
+        }
+
+        if (!eglMakeCurrent(display, primingSurface, primingSurface, primingContext)) {
+            ALOGE("Can't make the priming context current, programs are compiled on use");
+            std::lock_guard lock(mMutex);
+            mPrimingKeys.clear();
+            mPrimedCondition.notify_all();
+            return;
+        }
+        for (const PrimingTier& tier : tiers) {
+            primeTier(context, tier, /*sharedContext*/ true);
+        }
+        storeBinaries();
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    });
+}
+
+void ProgramCache::waitForPriming() {
+    if (mPrimingThread.joinable()) {
+        mPrimingThread.join();
+    }
+}
+
+size_t ProgramCache::getSize(const EGLContext context) {
+    std::lock_guard lock(mMutex);
+    return mCaches[context].size();
+}
+
+void ProgramCache::dump(std::string& result) {
+    std::lock_guard lock(mMutex);
+    for (const auto& [name, count, time] : mPrimingTimes) {
+        base::StringAppendF(&result, "RenderEngine program cache primed %s: %zu programs in %.2f ms\n",
+                            name, count, static_cast<float>(time) / 1.0E6);
+    }
+    if (!mPrimingKeys.empty()) {
+        base::StringAppendF(&result, "RenderEngine program cache still priming %zu programs\n",
+                            mPrimingKeys.size());
+    }
+}
+
+void ProgramCache::enableBinaryCache(const std::string& path) {
+    const GLExtensions& extensions = GLExtensions::getInstance();
+    if (!extensions.hasProgramBinary()) {
+        return;
+    }
+    GLint formatCount = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS_OES, &formatCount);
+    if (formatCount <= 0) {
+        return;
+    }
+
+    // Binaries are only compatible with the driver which produced them.
+    char buildFingerprint[PROPERTY_VALUE_MAX];
+    property_get("ro.build.fingerprint", buildFingerprint, "");
+    mBinaryCacheFingerprint = base::StringPrintf("%u|%s|%s|%s|%s", kBinaryCacheVersion,
+                                                 extensions.getVendor(), extensions.getRenderer(),
+                                                 extensions.getVersion(), buildFingerprint);
+    mBinaryCachePath = path;
+    mBinaryCacheEnabled = true;
+    std::lock_guard lock(mBinaryMutex);
+    mPendingBinaries = std::async(std::launch::async, &ProgramCache::readBinaries, path,
+                                  mBinaryCacheFingerprint);
+}
+
+size_t ProgramCache::getBinaryCacheSize() const {
+    std::lock_guard lock(mBinaryMutex);
+    return mBinaries.size();
+}
+
+size_t ProgramCache::getBinaryCacheHits() const {
+    std::lock_guard lock(mBinaryMutex);
+    return mBinaryCacheHits;
+}
+
+std::unique_ptr<Program> ProgramCache::createProgram(const Key& needs) {
+    if (!mBinaryCacheEnabled) {
+        return generateProgram(needs);
+    }
+
+    std::shared_ptr<const ProgramBinary> storedBinary;
+    {
+        std::lock_guard lock(mBinaryMutex);
+        if (mPendingBinaries.valid()) {
+            ATRACE_NAME("waitForProgramBinaries");
+            mBinaries = mPendingBinaries.get();
+        }
+        if (const auto it = mBinaries.find(needs); it != mBinaries.end()) {
+            storedBinary = it->second;
+        }
+    }
+
+    if (storedBinary) {
+        ATRACE_NAME("loadProgramBinary");
+        auto program = std::make_unique<Program>(needs, storedBinary->format, storedBinary->data);
+        if (program->isValid()) {
+            std::lock_guard lock(mBinaryMutex);
+            mBinaryCacheHits++;
+            return program;
+        }
+        // The program is generated again below, which replaces the binary.
+    }
+
+    auto program = generateProgram(needs);
+    auto binary = std::make_shared<ProgramBinary>();
+    if (program->getBinary(&binary->format, &binary->data)) {
+        std::lock_guard lock(mBinaryMutex);
+        mBinaries[needs] = std::move(binary);
+        mBinariesChanged = true;
+    }
+    return program;
+}
+
+void ProgramCache::storeBinaries() {
+    std::lock_guard lock(mBinaryMutex);
+    if (!mBinariesChanged) {
+        return;
+    }
+    // Don't wait for a previous write; the binaries are stored by the next one.
+    if (mPendingWrite.valid() &&
+        mPendingWrite.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        return;
+    }
+    mBinariesChanged = false;
+    mPendingWrite = std::async(std::launch::async, &ProgramCache::writeBinaries, mBinaryCachePath,
+                               mBinaryCacheFingerprint, mBinaries);
+}
+
+/*
+ * The binary cache file is made of a header, followed by one entry per program:
+ *
+ * uint32_t magic, uint32_t fingerprint size, char fingerprint[], uint32_t count
+ * count x { uint32_t key, uint32_t format, uint32_t size, uint8_t binary[] }
+ */
+
+namespace {
+
+class BlobReader {
+public:
+    explicit BlobReader(const std::string& blob) : mBlob(blob) {}
+
+    bool read(void* data, size_t size) {
+        if (size > mBlob.size() - mOffset) {
+            return false;
+        }
+        memcpy(data, mBlob.data() + mOffset, size);
+        mOffset += size;
+        return true;
+    }
+
+    bool read(uint32_t* value) { return read(value, sizeof(*value)); }
+
+private:
+    const std::string& mBlob;
+    size_t mOffset = 0;
+};
+
+void append(std::string* blob, const void* data, size_t size) {
+    blob->append(static_cast<const char*>(data), size);
+}
+
+void append(std::string* blob, uint32_t value) {
+    append(blob, &value, sizeof(value));
+}
+
+} // namespace
+
+ProgramCache::ProgramBinaries ProgramCache::readBinaries(const std::string& path,
+                                                         const std::string& fingerprint) {
+    ATRACE_CALL();
+    ProgramBinaries binaries;
+    std::string blob;
+    if (!base::ReadFileToString(path, &blob)) {
+        ALOGV("No program binaries at %s", path.c_str());
+        return binaries;
+    }
+
+    BlobReader reader(blob);
+    uint32_t magic = 0;
+    uint32_t fingerprintSize = 0;
+    if (!reader.read(&magic) || magic != kBinaryCacheMagic || !reader.read(&fingerprintSize) ||
+        fingerprintSize != fingerprint.size()) {
+        ALOGI("Ignoring program binaries from another driver");
+        return binaries;
+    }
+    std::string storedFingerprint(fingerprintSize, '\0');
+    if (!reader.read(storedFingerprint.data(), fingerprintSize) ||
+        storedFingerprint != fingerprint) {
+        ALOGI("Ignoring program binaries from another driver");
+        return binaries;
+    }
+
+    uint32_t count = 0;
+    if (!reader.read(&count)) {
+        return binaries;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        Key key;
+        uint32_t format = 0;
+        uint32_t size = 0;
+        auto binary = std::make_shared<ProgramBinary>();
+        if (!reader.read(&key.mKey) || !reader.read(&format) || !reader.read(&size) ||
+            size > blob.size()) {
+            ALOGE("Program binaries at %s are truncated", path.c_str());
+            return {};
+        }
+        binary->format = format;
+        binary->data.resize(size);
+        if (!reader.read(binary->data.data(), size)) {
+            ALOGE("Program binaries at %s are truncated", path.c_str());
+            return {};
+        }
+        binaries[key] = std::move(binary);
     }
+    ALOGD("Read %zu program binaries from %s", binaries.size(), path.c_str());
+    return binaries;
+}
 
-    nsecs_t timeAfter = systemTime();
-    float compileTimeMs = static_cast<float>(timeAfter - timeBefore) / 1.0E6;
-    ALOGD("shader cache generated - %u shaders in %f ms\n", shaderCount, compileTimeMs);
+void ProgramCache::writeBinaries(const std::string& path, const std::string& fingerprint,
+                                 const ProgramBinaries& binaries) {
+    ATRACE_CALL();
+    std::string blob;
+    append(&blob, kBinaryCacheMagic);
+    append(&blob, static_cast<uint32_t>(fingerprint.size()));
+    append(&blob, fingerprint.data(), fingerprint.size());
+    append(&blob, static_cast<uint32_t>(binaries.size()));
+    for (const auto& [key, binary] : binaries) {
+        append(&blob, key.mKey);
+        append(&blob, static_cast<uint32_t>(binary->format));
+        append(&blob, static_cast<uint32_t>(binary->data.size()));
+        append(&blob, binary->data.data(), binary->data.size());
+    }
+
+    // Write to a temporary file first, so that a crash never leaves a partial cache.
+    const std::string tempPath = path + ".tmp";
+    if (!base::WriteStringToFile(blob, tempPath, 0600, getuid(), getgid()) ||
+        rename(tempPath.c_str(), path.c_str()) != 0) {
+        ALOGW("Failed to write program binaries to %s: %s", path.c_str(), strerror(errno));
+        unlink(tempPath.c_str());
+    }
 }
 
 ProgramCache::Key ProgramCache::computeKey(const Description& description) {
@@ -190,6 +531,14 @@ ProgramCache::Key ProgramCache::computeKey(const Description& description) {
     needs.set(Key::Y410_BT2020_MASK,
               description.isY410BT2020 ? Key::Y410_BT2020_ON : Key::Y410_BT2020_OFF);
 
+    if (description.colorLutEnabled) {
+        // The transfer functions and transform matrices are all baked into the LUT.
+        needs.set(Key::INPUT_TRANSFORM_MATRIX_MASK | Key::OUTPUT_TRANSFORM_MATRIX_MASK |
+                          Key::COLOR_LUT_MASK,
+                  Key::COLOR_LUT_ON);
+        return needs;
+    }
+
     if (needs.hasTransformMatrix() ||
         (description.inputTransferFunction != description.outputTransferFunction)) {
         switch (description.inputTransferFunction) {
@@ -665,7 +1014,43 @@ String8 ProgramCache::generateFragmentShader(const Key& needs) {
             )__SHADER__";
     }
 
-    if (needs.hasTransformMatrix() ||
+    if (needs.hasColorLut() || needs.hasTransformMatrix() ||
+        (needs.getInputTF() != needs.getOutputTF()) ||
+        needs.hasDisplayColorMatrix()) {
+        if (needs.hasDisplayColorMatrix()) {
+            fs << "uniform mat4 displayColorMatrix;";
+            fs << R"__SHADER__(
+                highp vec3 DisplayColorMatrix(const highp vec3 color) {
+                    return clamp(vec3(displayColorMatrix * vec4(color, 1.0)), 0.0, 1.0);
+                }
+            )__SHADER__";
+        } else {
+            fs << R"__SHADER__(
+                highp vec3 DisplayColorMatrix(const highp vec3 color) {
+                    return color;
+                }
+            )__SHADER__";
+        }
+    }
+
+    if (needs.hasColorLut()) {
+        // The LUT is laid out as kSize slices of kSize x kSize texels side by
+        // side, one per blue value. Red and green are interpolated by the
+        // texture filtering within a slice, and blue between two slices.
+        fs << "uniform sampler2D colorLut;";
+        fs << String8::format("const highp float colorLutSize = %d.0;", GLColorLut::kSize);
+        fs << R"__SHADER__(
+            vec3 ColorLut(const highp vec3 color) {
+                highp vec3 scaled = clamp(color, 0.0, 1.0) * (colorLutSize - 1.0);
+                highp float slice = min(floor(scaled.b), colorLutSize - 2.0);
+                highp vec2 uv = (vec2(scaled.r + slice * colorLutSize, scaled.g) + 0.5) /
+                        vec2(colorLutSize * colorLutSize, colorLutSize);
+                vec3 low = texture2D(colorLut, uv).rgb;
+                vec3 high = texture2D(colorLut, uv + vec2(1.0 / colorLutSize, 0.0)).rgb;
+                return mix(low, high, scaled.b - slice);
+            }
+        )__SHADER__";
+    } else if (needs.hasTransformMatrix() ||
         (needs.getInputTF() != needs.getOutputTF()) ||
         needs.hasDisplayColorMatrix()) {
         if (needs.needsToneMapping()) {
@@ -706,21 +1091,6 @@ String8 ProgramCache::generateFragmentShader(const Key& needs) {
             )__SHADER__";
         }
 
-        if (needs.hasDisplayColorMatrix()) {
-            fs << "uniform mat4 displayColorMatrix;";
-            fs << R"__SHADER__(
-                highp vec3 DisplayColorMatrix(const highp vec3 color) {
-                    return clamp(vec3(displayColorMatrix * vec4(color, 1.0)), 0.0, 1.0);
-                }
-            )__SHADER__";
-        } else {
-            fs << R"__SHADER__(
-                highp vec3 DisplayColorMatrix(const highp vec3 color) {
-                    return color;
-                }
-            )__SHADER__";
-        }
-
         generateEOTF(fs, needs);
         generateOOTF(fs, needs);
         generateOETF(fs, needs);
@@ -753,7 +1123,7 @@ String8 ProgramCache::generateFragmentShader(const Key& needs) {
         }
     }
 
-    if (needs.hasTransformMatrix() ||
+    if (needs.hasColorLut() || needs.hasTransformMatrix() ||
         (needs.getInputTF() != needs.getOutputTF()) ||
         needs.hasDisplayColorMatrix()) {
         if (!needs.isOpaque() && needs.isPremultiplied()) {
@@ -761,8 +1131,13 @@ String8 ProgramCache::generateFragmentShader(const Key& needs) {
             // avoid divide by 0 by adding 0.5/256 to the alpha channel
             fs << "gl_FragColor.rgb = gl_FragColor.rgb / (gl_FragColor.a + 0.0019);";
         }
-        fs << "gl_FragColor.rgb = "
-              "DisplayColorMatrix(OETF(OutputTransform(OOTF(InputTransform(EOTF(gl_FragColor.rgb))))));";
+        if (needs.hasColorLut()) {
+            fs << "gl_FragColor.rgb = "
+                  "DisplayColorMatrix(clamp(ColorLut(gl_FragColor.rgb), 0.0, 1.0));";
+        } else {
+            fs << "gl_FragColor.rgb = "
+                  "DisplayColorMatrix(OETF(OutputTransform(OOTF(InputTransform(EOTF(gl_FragColor.rgb))))));";
+        }
 
         if (!needs.isOpaque() && needs.isPremultiplied()) {
             // and re-premultiply if needed after gamma correction
@@ -799,13 +1174,24 @@ void ProgramCache::useProgram(EGLContext context, const Description& description
     Key needs(computeKey(description));
 
     // look-up the program in the cache
+    std::unique_lock lock(mMutex);
+    base::ScopedLockAssertion assumeLocked(mMutex);
     auto& cache = mCaches[context];
     auto it = cache.find(needs);
+    if (it == cache.end() && mPrimingKeys.count(needs) != 0) {
+        // The program is being primed, so wait for it rather than compiling it twice.
+        ATRACE_NAME("waitForPrimedProgram");
+        mPrimedCondition.wait(lock, [&]() REQUIRES(mMutex) {
+            return mPrimingKeys.count(needs) == 0;
+        });
+        it = cache.find(needs);
+    }
     if (it == cache.end()) {
         // we didn't find our program, so generate one...
         nsecs_t time = systemTime();
-        it = cache.emplace(needs, generateProgram(needs)).first;
+        it = cache.emplace(needs, createProgram(needs)).first;
         time = systemTime() - time;
+        storeBinaries();
 
         ALOGV(">>> generated new program for context %p: needs=%08X, time=%u ms (%zu programs)",
               context, needs.mKey, uint32_t(ns2ms(time)), cache.size());
@@ -17,13 +17,22 @@
 #ifndef SF_RENDER_ENGINE_PROGRAMCACHE_H
 #define SF_RENDER_ENGINE_PROGRAMCACHE_H
 
+#include <condition_variable>
+#include <future>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include <EGL/egl.h>
 #include <GLES2/gl2.h>
+#include <android-base/thread_annotations.h>
 #include <renderengine/private/Description.h>
 #include <utils/Singleton.h>
+#include <utils/Timers.h>
 #include <utils/TypeHelpers.h>
 
 namespace android {
@@ -122,6 +131,13 @@ public:
             DISPLAY_COLOR_TRANSFORM_MATRIX_MASK = 1 << DISPLAY_COLOR_TRANSFORM_MATRIX_SHIFT,
             DISPLAY_COLOR_TRANSFORM_MATRIX_OFF = 0 << DISPLAY_COLOR_TRANSFORM_MATRIX_SHIFT,
             DISPLAY_COLOR_TRANSFORM_MATRIX_ON = 1 << DISPLAY_COLOR_TRANSFORM_MATRIX_SHIFT,
+
+            // The color conversion is looked up in a GLColorLut, in place of
+            // the transfer functions and transform matrices.
+            COLOR_LUT_SHIFT = 15,
+            COLOR_LUT_MASK = 1 << COLOR_LUT_SHIFT,
+            COLOR_LUT_OFF = 0 << COLOR_LUT_SHIFT,
+            COLOR_LUT_ON = 1 << COLOR_LUT_SHIFT,
         };
 
         inline Key() : mKey(0) {}
@@ -154,6 +170,7 @@ public:
         inline bool hasTransformMatrix() const {
             return hasInputTransformMatrix() || hasOutputTransformMatrix();
         }
+        inline bool hasColorLut() const { return (mKey & COLOR_LUT_MASK) == COLOR_LUT_ON; }
         inline int getInputTF() const { return (mKey & INPUT_TF_MASK); }
         inline int getOutputTF() const { return (mKey & OUTPUT_TF_MASK); }
 
@@ -191,18 +208,81 @@ public:
     };
 
     ProgramCache() = default;
-    ~ProgramCache() = default;
+    ~ProgramCache() { waitForPriming(); }
 
     // Generate shaders to populate the cache
-    void primeCache(const EGLContext context, bool useColorManagement, bool toneMapperShaderOnly);
-
-    size_t getSize(const EGLContext context) { return mCaches[context].size(); }
+    // useColorLut and useToneMappingLut tell whether color conversions and tone
+    // mapping are looked up in a GLColorLut.
+    void primeCache(const EGLContext context, bool useColorManagement, bool useColorLut,
+                    bool useToneMappingLut, bool toneMapperShaderOnly);
+
+    // Generate the same shaders as primeCache, on a thread which makes
+    // primingContext current. primingContext must share its programs with
+    // context. Shaders are generated in order of priority, and useProgram
+    // waits for a shader which is still to be generated rather than
+    // generating it again.
+    void primeCacheInBackground(EGLDisplay display, EGLContext primingContext,
+                                EGLSurface primingSurface, const EGLContext context,
+                                bool useColorManagement, bool useColorLut,
+                                bool useToneMappingLut, bool toneMapperShaderOnly);
+
+    // Waits for background priming to finish. This must be called before the
+    // priming context is destroyed.
+    void waitForPriming();
+
+    size_t getSize(const EGLContext context) EXCLUDES(mMutex);
 
     // useProgram lookup a suitable program in the cache or generates one
     // if none can be found.
-    void useProgram(const EGLContext context, const Description& description);
+    void useProgram(const EGLContext context, const Description& description) EXCLUDES(mMutex);
+
+    // Starts reading the program binaries stored at path in the background, so
+    // that programs are loaded instead of compiled once they are ready. Newly
+    // compiled programs are stored back to path. The binaries are only used if
+    // they were stored by the same driver build. Must be called with a context
+    // current, before the cache is primed.
+    void enableBinaryCache(const std::string& path);
+
+    size_t getBinaryCacheSize() const EXCLUDES(mBinaryMutex);
+    size_t getBinaryCacheHits() const EXCLUDES(mBinaryMutex);
+
+    // Dumps the time spent priming each tier of shaders.
+    void dump(std::string& result) EXCLUDES(mMutex);
 
 private:
+    // A group of keys primed together, from the most to the least commonly used.
+    struct PrimingTier {
+        const char* name;
+        std::vector<Key> keys;
+    };
+    struct PrimingTime {
+        const char* name;
+        size_t count;
+        nsecs_t time;
+    };
+
+    struct ProgramBinary {
+        GLenum format;
+        std::vector<uint8_t> data;
+    };
+    // Binaries are shared with the thread storing them, and are never modified.
+    using ProgramBinaries =
+            std::unordered_map<Key, std::shared_ptr<const ProgramBinary>, Key::Hash>;
+
+    // Loads the program from its binary if there is a valid one, or generates it
+    // and keeps its binary otherwise.
+    std::unique_ptr<Program> createProgram(const Key& needs) EXCLUDES(mBinaryMutex);
+    // Stores the binaries in the background, if any were added.
+    void storeBinaries() EXCLUDES(mBinaryMutex);
+    static std::vector<PrimingTier> getPrimingTiers(bool useColorManagement, bool useColorLut,
+                                                    bool useToneMappingLut,
+                                                    bool toneMapperShaderOnly);
+    void primeTier(const EGLContext context, const PrimingTier& tier, bool sharedContext)
+            EXCLUDES(mMutex);
+    static ProgramBinaries readBinaries(const std::string& path, const std::string& fingerprint);
+    static void writeBinaries(const std::string& path, const std::string& fingerprint,
+                              const ProgramBinaries& binaries);
+
     // compute a cache Key from a Description
     static Key computeKey(const Description& description);
     // Generate EOTF based from Key.
@@ -220,10 +300,30 @@ private:
     // generates the fragment shader from the Key
     static String8 generateFragmentShader(const Key& needs);
 
+    std::mutex mMutex;
     // Key/Value map used for caching Programs. Currently the cache
     // is never shrunk (and the GL program objects are never deleted).
     std::unordered_map<EGLContext, std::unordered_map<Key, std::unique_ptr<Program>, Key::Hash>>
-            mCaches;
+            mCaches GUARDED_BY(mMutex);
+
+    // Background priming. The keys still to be primed are signaled by
+    // mPrimedCondition as they are added to mCaches.
+    std::thread mPrimingThread;
+    std::unordered_set<Key, Key::Hash> mPrimingKeys GUARDED_BY(mMutex);
+    std::condition_variable mPrimedCondition;
+    std::vector<PrimingTime> mPrimingTimes GUARDED_BY(mMutex);
+
+    // The binary cache. Binaries are the same for every context, so they are
+    // kept once for all of them.
+    bool mBinaryCacheEnabled = false;
+    std::string mBinaryCachePath;
+    std::string mBinaryCacheFingerprint;
+    mutable std::mutex mBinaryMutex;
+    std::future<ProgramBinaries> mPendingBinaries GUARDED_BY(mBinaryMutex);
+    ProgramBinaries mBinaries GUARDED_BY(mBinaryMutex);
+    bool mBinariesChanged GUARDED_BY(mBinaryMutex) = false;
+    std::future<void> mPendingWrite GUARDED_BY(mBinaryMutex);
+    size_t mBinaryCacheHits GUARDED_BY(mBinaryMutex) = 0;
 };
 
 } // namespace gl
@@ -205,6 +205,56 @@ status_t BlurFilter::render(bool multiPass) {
     return NO_ERROR;
 }
 
+bool BlurFilter::isCached(const DisplaySettings& display,
+                          const std::vector<const LayerSettings*>& layers,
+                          const LayerSettings* blurLayer) const {
+    if (!mCacheValid || blurLayer->backgroundBlurRadius != (int)mRadius) {
+        return false;
+    }
+
+    // The damage region doesn't matter, the blur is always computed over the whole display.
+    if (display.physicalDisplay != mCachedDisplay.physicalDisplay ||
+        display.clip != mCachedDisplay.clip ||
+        display.maxLuminance != mCachedDisplay.maxLuminance ||
+        display.outputDataspace != mCachedDisplay.outputDataspace ||
+        display.colorTransform != mCachedDisplay.colorTransform ||
+        !display.clearRegion.hasSameRects(mCachedDisplay.clearRegion) ||
+        display.orientation != mCachedDisplay.orientation) {
+        return false;
+    }
+
+    auto cached = mCachedLayers.begin();
+    for (auto layer : layers) {
+        if (layer == blurLayer) {
+            return cached == mCachedLayers.end();
+        }
+        if (cached == mCachedLayers.end() || !(*layer == *cached)) {
+            return false;
+        }
+        cached++;
+    }
+    return false;
+}
+
+void BlurFilter::updateCache(const DisplaySettings& display,
+                             const std::vector<const LayerSettings*>& layers,
+                             const LayerSettings* blurLayer) {
+    mCachedDisplay = display;
+    mCachedLayers.clear();
+    for (auto layer : layers) {
+        if (layer == blurLayer) {
+            break;
+        }
+        mCachedLayers.push_back(*layer);
+    }
+    mCacheValid = true;
+}
+
+void BlurFilter::invalidateCache() {
+    mCacheValid = false;
+    mCachedLayers.clear();
+}
+
 string BlurFilter::getVertexShader() const {
     return R"SHADER(#version 310 es
         precision mediump float;
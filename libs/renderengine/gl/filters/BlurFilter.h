@@ -16,7 +16,10 @@
 
 #pragma once
 
+#include <renderengine/DisplaySettings.h>
+#include <renderengine/LayerSettings.h>
 #include <ui/GraphicTypes.h>
+#include <vector>
 #include "../GLESRenderEngine.h"
 #include "../GLFramebuffer.h"
 #include "../GLVertexBuffer.h"
@@ -51,6 +54,17 @@ public:
     // Render blur to the bound framebuffer (screen).
     status_t render(bool multiPass);
 
+    // Whether the blur prepared for a previous frame can be rendered again as is for blurLayer,
+    // because the display and the layers drawn underneath blurLayer are all unchanged.
+    bool isCached(const DisplaySettings& display, const std::vector<const LayerSettings*>& layers,
+                  const LayerSettings* blurLayer) const;
+    // Remember what the blur that was just prepared is made of, for isCached().
+    void updateCache(const DisplaySettings& display,
+                     const std::vector<const LayerSettings*>& layers,
+                     const LayerSettings* blurLayer);
+    // Forget about the prepared blur, before its frame buffers are written to.
+    void invalidateCache();
+
 private:
     uint32_t mRadius;
     void drawMesh(GLuint uv, GLuint position);
@@ -71,6 +85,12 @@ private:
     // Buffer holding the final blur pass.
     GLFramebuffer* mLastDrawTarget;
 
+    // What the prepared blur was made of. The layer settings hold references to their buffers
+    // and fences, so that a new buffer can't be mistaken for a cached one.
+    bool mCacheValid = false;
+    DisplaySettings mCachedDisplay;
+    std::vector<LayerSettings> mCachedLayers;
+
     // VBO containing vertex and uv data of a fullscreen triangle.
     GLVertexBuffer mMeshBuffer;
 
@@ -60,13 +60,19 @@ struct DisplaySettings {
     // capture of a device in landscape while the buffer is in portrait
     // orientation.
     uint32_t orientation = ui::Transform::ROT_0;
+
+    // Region of the output buffer which needs to be redrawn, in physical display
+    // space. The content of the buffer outside of it is already up to date and is
+    // left untouched. An invalid region means that the whole buffer is redrawn.
+    Region damageRegion = Region::INVALID_REGION;
 };
 
 static inline bool operator==(const DisplaySettings& lhs, const DisplaySettings& rhs) {
     return lhs.physicalDisplay == rhs.physicalDisplay && lhs.clip == rhs.clip &&
             lhs.maxLuminance == rhs.maxLuminance && lhs.outputDataspace == rhs.outputDataspace &&
             lhs.colorTransform == rhs.colorTransform &&
-            lhs.clearRegion.hasSameRects(rhs.clearRegion) && lhs.orientation == rhs.orientation;
+            lhs.clearRegion.hasSameRects(rhs.clearRegion) && lhs.orientation == rhs.orientation &&
+            lhs.damageRegion.hasSameRects(rhs.damageRegion);
 }
 
 // Defining PrintTo helps with Google Tests.
@@ -83,6 +89,8 @@ static inline void PrintTo(const DisplaySettings& settings, ::std::ostream* os)
     *os << "\n    .clearRegion = ";
     PrintTo(settings.clearRegion, os);
     *os << "\n    .orientation = " << settings.orientation;
+    *os << "\n    .damageRegion = ";
+    PrintTo(settings.damageRegion, os);
     *os << "\n}";
 }
 
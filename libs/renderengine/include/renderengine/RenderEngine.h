@@ -31,7 +31,8 @@
 #include <ui/Transform.h>
 
 /**
- * Allows to set RenderEngine backend to GLES (default) or Vulkan (NOT yet supported).
+ * Allows to set RenderEngine backend to GLES (default), threaded GLES, or Vulkan (NOT yet
+ * supported).
  */
 #define PROPERTY_DEBUG_RENDERENGINE_BACKEND "debug.renderengine.backend"
 
@@ -54,6 +55,10 @@ namespace impl {
 class RenderEngine;
 }
 
+namespace threaded {
+class RenderEngineThreaded;
+}
+
 enum class Protection {
     UNPROTECTED = 1,
     PROTECTED = 2,
@@ -185,6 +190,7 @@ protected:
     // live longer than RenderEngine.
     virtual Framebuffer* getFramebufferForDrawing() = 0;
     friend class BindNativeBufferAsFramebuffer;
+    friend class threaded::RenderEngineThreaded;
 };
 
 struct RenderEngineCreationArgs {
@@ -85,6 +85,10 @@ struct Description {
     mat4 inputTransformMatrix;
     mat4 outputTransformMatrix;
 
+    // True if the conversion from the input transfer function through the display color matrix
+    // is looked up in the color LUT bound to texture unit 1, rather than computed.
+    bool colorLutEnabled = false;
+
     // True if this layer will draw a shadow.
     bool drawShadows = false;
 };
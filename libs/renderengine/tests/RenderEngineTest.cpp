@@ -1244,6 +1244,55 @@ TEST_F(RenderEngineTest, drawLayers_fillBufferAndBlurBackground_bufferSource) {
     fillBufferAndBlurBackground<BufferSourceVariant<RelaxOpaqueBufferVariant>>();
 }
 
+TEST_F(RenderEngineTest, drawLayers_blurBackgroundRedrawnWhenBackgroundChanges) {
+    char value[PROPERTY_VALUE_MAX];
+    property_get("ro.surface_flinger.supports_background_blur", value, "0");
+    if (!atoi(value)) {
+        // This device doesn't support blurs, no-op.
+        return;
+    }
+
+    const auto center = DEFAULT_DISPLAY_WIDTH / 2;
+
+    renderengine::DisplaySettings settings;
+    settings.physicalDisplay = fullscreenRect();
+    settings.clip = fullscreenRect();
+
+    std::vector<const renderengine::LayerSettings*> layers;
+
+    renderengine::LayerSettings backgroundLayer;
+    backgroundLayer.geometry.boundaries = fullscreenRect().toFloatRect();
+    ColorSourceVariant::fillColor(backgroundLayer, 0.0f, 1.0f, 0.0f, this);
+    backgroundLayer.alpha = 1.0f;
+    layers.push_back(&backgroundLayer);
+
+    renderengine::LayerSettings leftLayer;
+    leftLayer.geometry.boundaries =
+            Rect(DEFAULT_DISPLAY_WIDTH / 2, DEFAULT_DISPLAY_HEIGHT).toFloatRect();
+    ColorSourceVariant::fillColor(leftLayer, 1.0f, 0.0f, 0.0f, this);
+    leftLayer.alpha = 1.0f;
+    layers.push_back(&leftLayer);
+
+    renderengine::LayerSettings blurLayer;
+    blurLayer.geometry.boundaries = fullscreenRect().toFloatRect();
+    blurLayer.backgroundBlurRadius = 50;
+    blurLayer.alpha = 0;
+    layers.push_back(&blurLayer);
+
+    // The second draw can reuse the blur of the first one.
+    for (int i = 0; i < 2; i++) {
+        invokeDraw(settings, layers, mBuffer);
+        expectBufferColor(Rect(center - 1, center - 5, center + 1, center + 5), 150, 150, 0,
+                          255, 50 /* tolerance */);
+    }
+
+    // But not once a layer underneath the blur changed.
+    ColorSourceVariant::fillColor(leftLayer, 0.0f, 1.0f, 0.0f, this);
+    invokeDraw(settings, layers, mBuffer);
+    expectBufferColor(Rect(center - 1, center - 5, center + 1, center + 5), 0, 255, 0, 255,
+                      50 /* tolerance */);
+}
+
 TEST_F(RenderEngineTest, drawLayers_overlayCorners_bufferSource) {
     overlayCorners<BufferSourceVariant<RelaxOpaqueBufferVariant>>();
 }
@@ -1264,6 +1313,29 @@ TEST_F(RenderEngineTest, drawLayers_clearRegion) {
     clearRegion();
 }
 
+TEST_F(RenderEngineTest, drawLayers_onlyRedrawsDamageRegion) {
+    fillBuffer<ColorSourceVariant>(1.0f, 0.0f, 0.0f, 1.0f);
+
+    renderengine::DisplaySettings settings;
+    settings.physicalDisplay = fullscreenRect();
+    settings.clip = fullscreenRect();
+    settings.damageRegion = Region(offsetRect());
+
+    std::vector<const renderengine::LayerSettings*> layers;
+
+    renderengine::LayerSettings layer;
+    layer.geometry.boundaries = fullscreenRect().toFloatRect();
+    ColorSourceVariant::fillColor(layer, 0.0f, 0.0f, 1.0f, this);
+    layer.alpha = 1.0f;
+
+    layers.push_back(&layer);
+
+    invokeDraw(settings, layers, mBuffer);
+
+    expectBufferColor(offsetRect(), 0, 0, 255, 255);
+    expectBufferColor(Region(fullscreenRect()).subtractSelf(offsetRect()), 255, 0, 0, 255);
+}
+
 TEST_F(RenderEngineTest, drawLayers_fillsBufferAndCachesImages) {
     renderengine::DisplaySettings settings;
     settings.physicalDisplay = fullscreenRect();
@@ -1387,6 +1459,32 @@ TEST_F(RenderEngineTest, drawLayers_fillShadow_casterColorLayer) {
     expectShadowColor(castingLayer, settings, casterColor, backgroundColor);
 }
 
+TEST_F(RenderEngineTest, drawLayers_fillShadow_casterMovedBetweenFrames) {
+    const ubyte4 casterColor(255, 0, 0, 255);
+    const ubyte4 backgroundColor(255, 255, 255, 255);
+    const float shadowLength = 5.0f;
+    Rect casterBounds(DEFAULT_DISPLAY_WIDTH / 3.0f, DEFAULT_DISPLAY_HEIGHT / 3.0f);
+    casterBounds.offsetBy(shadowLength + 1, shadowLength + 1);
+    renderengine::LayerSettings castingLayer;
+    castingLayer.geometry.boundaries = casterBounds.toFloatRect();
+    castingLayer.alpha = 1.0f;
+    renderengine::ShadowSettings settings =
+            getShadowSettings(vec2(casterBounds.left, casterBounds.top), shadowLength,
+                              false /* casterIsTranslucent */);
+
+    drawShadow<ColorSourceVariant>(castingLayer, settings, casterColor, backgroundColor);
+    expectShadowColor(castingLayer, settings, casterColor, backgroundColor);
+
+    // The shadow of the first frame must not be reused for the moved caster.
+    casterBounds.offsetBy(DEFAULT_DISPLAY_WIDTH / 3, DEFAULT_DISPLAY_HEIGHT / 3);
+    castingLayer.geometry.boundaries = casterBounds.toFloatRect();
+    settings = getShadowSettings(vec2(casterBounds.left, casterBounds.top), shadowLength,
+                                 false /* casterIsTranslucent */);
+
+    drawShadow<ColorSourceVariant>(castingLayer, settings, casterColor, backgroundColor);
+    expectShadowColor(castingLayer, settings, casterColor, backgroundColor);
+}
+
 TEST_F(RenderEngineTest, drawLayers_fillShadow_casterOpaqueBufferLayer) {
     const ubyte4 casterColor(255, 0, 0, 255);
     const ubyte4 backgroundColor(255, 255, 255, 255);
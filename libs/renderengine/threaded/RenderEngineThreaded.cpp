@@ -0,0 +1,244 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#undef LOG_TAG
+#define LOG_TAG "RenderEngine"
+#define ATRACE_TAG ATRACE_TAG_GRAPHICS
+
+#include "RenderEngineThreaded.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <processgroup/sched_policy.h>
+#include <utils/Log.h>
+#include <utils/Trace.h>
+
+namespace android {
+namespace renderengine {
+namespace threaded {
+
+std::unique_ptr<RenderEngineThreaded> RenderEngineThreaded::create(
+        CreateInstanceFactory factory, const RenderEngineCreationArgs& args) {
+    return std::make_unique<RenderEngineThreaded>(std::move(factory), args);
+}
+
+RenderEngineThreaded::RenderEngineThreaded(CreateInstanceFactory factory,
+                                           const RenderEngineCreationArgs& args)
+      : renderengine::impl::RenderEngine(args) {
+    ATRACE_CALL();
+
+    std::promise<void> initialized;
+    std::future<void> initializedFuture = initialized.get_future();
+    mThread = std::thread([this, factory = std::move(factory), &initialized]() mutable {
+        mRenderEngine = factory();
+        initialized.set_value();
+        threadMain();
+    });
+    pthread_setname_np(mThread.native_handle(), "RenderEngine");
+    // Use SCHED_FIFO to minimize jitter, like the main thread the work comes from.
+    struct sched_param param = {0};
+    param.sched_priority = 2;
+    if (pthread_setschedparam(mThread.native_handle(), SCHED_FIFO, &param) != 0) {
+        ALOGE("Couldn't set SCHED_FIFO for RenderEngine");
+    }
+    // The EGL context is created by the thread, and must exist before any call.
+    initializedFuture.wait();
+}
+
+RenderEngineThreaded::~RenderEngineThreaded() {
+    {
+        std::lock_guard lock(mThreadMutex);
+        mRunning = false;
+    }
+    mCondition.notify_one();
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+}
+
+void RenderEngineThreaded::threadMain() {
+    set_sched_policy(0, SP_FOREGROUND);
+
+    while (true) {
+        Work work;
+        {
+            std::unique_lock lock(mThreadMutex);
+            base::ScopedLockAssertion assumeLocked(mThreadMutex);
+            mCondition.wait(lock, [this]() REQUIRES(mThreadMutex) {
+                return !mRunning || !mWorkQueue.empty();
+            });
+            // Queued work is still run when being destroyed, as the caller
+            // does not wait for it.
+            if (mWorkQueue.empty()) {
+                break;
+            }
+            work = std::move(mWorkQueue.front());
+            mWorkQueue.pop();
+            ATRACE_INT("RenderEngineQueueDepth", static_cast<int32_t>(mWorkQueue.size()));
+        }
+        work(*mRenderEngine);
+    }
+
+    // The RenderEngine must be destroyed on the thread which created its context.
+    mRenderEngine.reset();
+    ALOGD("Reached end of threadMain, terminating RenderEngine thread!");
+}
+
+void RenderEngineThreaded::queueWork(Work&& work) const {
+    {
+        std::lock_guard lock(mThreadMutex);
+        mWorkQueue.push(std::move(work));
+        ATRACE_INT("RenderEngineQueueDepth", static_cast<int32_t>(mWorkQueue.size()));
+    }
+    mCondition.notify_one();
+}
+
+void RenderEngineThreaded::primeCache() const {
+    // Composition only waits for priming once it needs the RenderEngine.
+    queueWork([](renderengine::RenderEngine& instance) {
+        ATRACE_NAME("REThreaded::primeCache");
+        instance.primeCache();
+    });
+}
+
+void RenderEngineThreaded::dump(std::string& result) {
+    result.append("RenderEngine is running on a dedicated thread\n");
+    runSync([&result](renderengine::RenderEngine& instance) { instance.dump(result); });
+}
+
+void RenderEngineThreaded::genTextures(size_t count, uint32_t* names) {
+    runSync([count, names](renderengine::RenderEngine& instance) {
+        ATRACE_NAME("REThreaded::genTextures");
+        instance.genTextures(count, names);
+    });
+}
+
+void RenderEngineThreaded::deleteTextures(size_t count, uint32_t const* names) {
+    // The names are copied, as the caller may reuse its array once this returns.
+    queueWork([textureNames = std::vector<uint32_t>(names, names + count)](
+                      renderengine::RenderEngine& instance) {
+        ATRACE_NAME("REThreaded::deleteTextures");
+        instance.deleteTextures(textureNames.size(), textureNames.data());
+    });
+}
+
+void RenderEngineThreaded::bindExternalTextureImage(uint32_t texName, const Image& image) {
+    runSync([texName, &image](renderengine::RenderEngine& instance) {
+        ATRACE_NAME("REThreaded::bindExternalTextureImage");
+        instance.bindExternalTextureImage(texName, image);
+    });
+}
+
+status_t RenderEngineThreaded::bindExternalTextureBuffer(uint32_t texName,
+                                                         const sp<GraphicBuffer>& buffer,
+                                                         const sp<Fence>& fence) {
+    return runSync([texName, &buffer, &fence](renderengine::RenderEngine& instance) {
+        ATRACE_NAME("REThreaded::bindExternalTextureBuffer");
+        return instance.bindExternalTextureBuffer(texName, buffer, fence);
+    });
+}
+
+void RenderEngineThreaded::cacheExternalTextureBuffer(const sp<GraphicBuffer>& buffer) {
+    queueWork([buffer](renderengine::RenderEngine& instance) {
+        ATRACE_NAME("REThreaded::cacheExternalTextureBuffer");
+        instance.cacheExternalTextureBuffer(buffer);
+    });
+}
+
+void RenderEngineThreaded::unbindExternalTextureBuffer(uint64_t bufferId) {
+    queueWork([bufferId](renderengine::RenderEngine& instance) {
+        ATRACE_NAME("REThreaded::unbindExternalTextureBuffer");
+        instance.unbindExternalTextureBuffer(bufferId);
+    });
+}
+
+status_t RenderEngineThreaded::bindFrameBuffer(Framebuffer* framebuffer) {
+    return runSync([framebuffer](renderengine::RenderEngine& instance) {
+        ATRACE_NAME("REThreaded::bindFrameBuffer");
+        return instance.bindFrameBuffer(framebuffer);
+    });
+}
+
+void RenderEngineThreaded::unbindFrameBuffer(Framebuffer* framebuffer) {
+    runSync([framebuffer](renderengine::RenderEngine& instance) {
+        ATRACE_NAME("REThreaded::unbindFrameBuffer");
+        instance.unbindFrameBuffer(framebuffer);
+    });
+}
+
+bool RenderEngineThreaded::cleanupPostRender(CleanupMode mode) {
+    return runSync([mode](renderengine::RenderEngine& instance) {
+        ATRACE_NAME("REThreaded::cleanupPostRender");
+        return instance.cleanupPostRender(mode);
+    });
+}
+
+size_t RenderEngineThreaded::getMaxTextureSize() const {
+    return runSync([](renderengine::RenderEngine& instance) {
+        return instance.getMaxTextureSize();
+    });
+}
+
+size_t RenderEngineThreaded::getMaxViewportDims() const {
+    return runSync([](renderengine::RenderEngine& instance) {
+        return instance.getMaxViewportDims();
+    });
+}
+
+bool RenderEngineThreaded::isProtected() const {
+    return runSync([](renderengine::RenderEngine& instance) { return instance.isProtected(); });
+}
+
+bool RenderEngineThreaded::supportsProtectedContent() const {
+    return runSync([](renderengine::RenderEngine& instance) {
+        return instance.supportsProtectedContent();
+    });
+}
+
+bool RenderEngineThreaded::useProtectedContext(bool useProtectedContext) {
+    return runSync([useProtectedContext](renderengine::RenderEngine& instance) {
+        ATRACE_NAME("REThreaded::useProtectedContext");
+        return instance.useProtectedContext(useProtectedContext);
+    });
+}
+
+Framebuffer* RenderEngineThreaded::getFramebufferForDrawing() {
+    return runSync([](renderengine::RenderEngine& instance) {
+        return instance.getFramebufferForDrawing();
+    });
+}
+
+status_t RenderEngineThreaded::drawLayers(const DisplaySettings& display,
+                                          const std::vector<const LayerSettings*>& layers,
+                                          ANativeWindowBuffer* buffer,
+                                          const bool useFramebufferCache,
+                                          base::unique_fd&& bufferFence,
+                                          base::unique_fd* drawFence) {
+    ATRACE_CALL();
+    // The draw fence only exists once the GPU commands are flushed, and the
+    // caller needs it to present the buffer, so this waits for the thread.
+    return runSync([&](renderengine::RenderEngine& instance) {
+        ATRACE_NAME("REThreaded::drawLayers");
+        return instance.drawLayers(display, layers, buffer, useFramebufferCache,
+                                   std::move(bufferFence), drawFence);
+    });
+}
+
+} // namespace threaded
+} // namespace renderengine
+} // namespace android
@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android-base/thread_annotations.h>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+
+#include "renderengine/RenderEngine.h"
+
+namespace android {
+namespace renderengine {
+namespace threaded {
+
+using CreateInstanceFactory = std::function<std::unique_ptr<renderengine::RenderEngine>()>;
+
+/**
+ * This class extends a basic RenderEngine class. It wraps another RenderEngine, and
+ * runs all of its calls on a dedicated thread, which owns the EGL context.
+ *
+ * Calls which return a result wait for the thread to run them. Calls which do
+ * not are queued, and return as soon as they are, so the caller does not wait
+ * for work such as texture deletion or shader compilation. Since all calls are
+ * run in the order they are made, queued work is always done before the work
+ * of any later call.
+ */
+class RenderEngineThreaded : public impl::RenderEngine {
+public:
+    static std::unique_ptr<RenderEngineThreaded> create(CreateInstanceFactory factory,
+                                                        const RenderEngineCreationArgs& args);
+
+    RenderEngineThreaded(CreateInstanceFactory factory, const RenderEngineCreationArgs& args);
+    ~RenderEngineThreaded() override;
+
+    void primeCache() const override;
+    void dump(std::string& result) override;
+
+    void genTextures(size_t count, uint32_t* names) override;
+    void deleteTextures(size_t count, uint32_t const* names) override;
+    void bindExternalTextureImage(uint32_t texName, const Image& image) override;
+    status_t bindExternalTextureBuffer(uint32_t texName, const sp<GraphicBuffer>& buffer,
+                                       const sp<Fence>& fence) override;
+    void cacheExternalTextureBuffer(const sp<GraphicBuffer>& buffer) override;
+    void unbindExternalTextureBuffer(uint64_t bufferId) override;
+    status_t bindFrameBuffer(Framebuffer* framebuffer) override;
+    void unbindFrameBuffer(Framebuffer* framebuffer) override;
+    bool cleanupPostRender(CleanupMode mode) override;
+
+    size_t getMaxTextureSize() const override;
+    size_t getMaxViewportDims() const override;
+
+    bool isProtected() const override;
+    bool supportsProtectedContent() const override;
+    bool useProtectedContext(bool useProtectedContext) override;
+
+    status_t drawLayers(const DisplaySettings& display,
+                        const std::vector<const LayerSettings*>& layers,
+                        ANativeWindowBuffer* buffer, const bool useFramebufferCache,
+                        base::unique_fd&& bufferFence, base::unique_fd* drawFence) override;
+
+protected:
+    Framebuffer* getFramebufferForDrawing() override;
+
+private:
+    using Work = std::function<void(renderengine::RenderEngine&)>;
+
+    void threadMain();
+
+    // Queues the work to run on the RenderEngine thread, and returns immediately.
+    void queueWork(Work&& work) const EXCLUDES(mThreadMutex);
+
+    // Runs the function on the RenderEngine thread, and returns its result.
+    template <typename F>
+    std::invoke_result_t<F&, renderengine::RenderEngine&> runSync(F&& function) const {
+        using Result = std::invoke_result_t<F&, renderengine::RenderEngine&>;
+        std::promise<Result> resultPromise;
+        std::future<Result> resultFuture = resultPromise.get_future();
+        queueWork([&resultPromise, &function](renderengine::RenderEngine& instance) {
+            if constexpr (std::is_void_v<Result>) {
+                function(instance);
+                resultPromise.set_value();
+            } else {
+                resultPromise.set_value(function(instance));
+            }
+        });
+        return resultFuture.get();
+    }
+
+    std::thread mThread;
+
+    // The work queue, which is shared with the thread.
+    mutable std::mutex mThreadMutex;
+    mutable std::condition_variable mCondition;
+    mutable std::queue<Work> mWorkQueue GUARDED_BY(mThreadMutex);
+    bool mRunning GUARDED_BY(mThreadMutex) = true;
+
+    // The wrapped RenderEngine, which is only used by the thread.
+    std::unique_ptr<renderengine::RenderEngine> mRenderEngine;
+};
+
+} // namespace threaded
+} // namespace renderengine
+} // namespace android
@@ -16,6 +16,12 @@
 
 #include <ui/ColorSpace.h>
 
+#include <algorithm>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 using namespace std::placeholders;
 
 namespace android {
@@ -351,25 +357,161 @@ const ColorSpace ColorSpace::ACEScg() {
     };
 }
 
+// LUTs are cached by their color spaces and size, since the same LUTs are requested
+// repeatedly, e.g. when the display color mode changes. Color spaces can only be
+// compared if their transfer functions are defined by parameters and their clamping
+// function is a plain function, LUTs of other color spaces are not cached.
+struct LutColorSpaceKey {
+    mat3 rgbToXYZ;
+    float2 whitePoint;
+    ColorSpace::TransferParameters parameters;
+    float (*clamper)(float);
+
+    bool operator==(const LutColorSpaceKey& other) const {
+        const ColorSpace::TransferParameters& p = other.parameters;
+        return rgbToXYZ[0] == other.rgbToXYZ[0] && rgbToXYZ[1] == other.rgbToXYZ[1] &&
+                rgbToXYZ[2] == other.rgbToXYZ[2] && whitePoint == other.whitePoint &&
+                parameters.g == p.g && parameters.a == p.a && parameters.b == p.b &&
+                parameters.c == p.c && parameters.d == p.d && parameters.e == p.e &&
+                parameters.f == p.f && clamper == other.clamper;
+    }
+};
+
+static bool getLutColorSpaceKey(const ColorSpace& colorSpace, LutColorSpaceKey* key) {
+    // The transfer functions of color spaces created without parameters are opaque,
+    // and their parameters are left to 0.
+    if (colorSpace.getTransferParameters().g == 0.0f) {
+        return false;
+    }
+    // The default clamping function, saturate(), is noexcept.
+    float (*clamper)(float) = nullptr;
+    if (auto target = colorSpace.getClamper().target<float (*)(float) noexcept>()) {
+        clamper = *target;
+    } else if (auto target = colorSpace.getClamper().target<float (*)(float)>()) {
+        clamper = *target;
+    } else {
+        return false;
+    }
+    *key = {colorSpace.getRGBtoXYZ(), colorSpace.getWhitePoint(),
+            colorSpace.getTransferParameters(), clamper};
+    return true;
+}
+
+struct LutCacheEntry {
+    LutColorSpaceKey src;
+    LutColorSpaceKey dst;
+    uint32_t size;
+    std::unique_ptr<float3[]> lut;
+};
+
+// Maximum number of LUTs in the cache, the least recently used one is evicted beyond
+// that, and maximum size of cached LUTs, to bound the memory held by the cache.
+static constexpr size_t LUT_CACHE_SIZE = 4;
+static constexpr uint32_t LUT_CACHE_MAX_LUT_SIZE = 64;
+
+static std::mutex& lutCacheMutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+// Most recently used first, guarded by lutCacheMutex().
+static std::list<LutCacheEntry>& lutCache() {
+    static std::list<LutCacheEntry> cache;
+    return cache;
+}
+
+static std::unique_ptr<float3[]> copyLUT(const float3* lut, uint32_t size) {
+    std::unique_ptr<float3[]> copy(new float3[size * size * size]);
+    std::copy(lut, lut + size * size * size, copy.get());
+    return copy;
+}
+
+static void fillLUT(float3* lut, uint32_t size, const ColorSpaceConnector& connector) {
+    const ColorSpace& src = connector.getSource();
+    const ColorSpace& dst = connector.getDestination();
+    const mat3& transform = connector.getTransform();
+    const float m = 1.0f / float(size - 1);
+
+    // The source transfer and clamping functions apply to each component separately,
+    // and the grid is the same along all axes, so they are only evaluated once per
+    // grid coordinate. The transform is then split into the contribution of each
+    // axis, so that only the destination transfer function is evaluated per entry.
+    std::vector<float> linear(size);
+    for (uint32_t i = 0; i < size; i++) {
+        linear[i] = src.getEOTF()(src.getClamper()(static_cast<float>(i) * m));
+    }
+    std::vector<float3> red(size);
+    std::vector<float3> green(size);
+    for (uint32_t i = 0; i < size; i++) {
+        red[i] = transform[0] * linear[i];
+        green[i] = transform[1] * linear[i];
+    }
+
+    const auto& oetf = dst.getOETF();
+    const auto& clamper = dst.getClamper();
+
+    // Slices of constant blue are computed in parallel for large LUTs.
+    auto fillSlices = [&](uint32_t begin, uint32_t end) {
+        for (uint32_t z = begin; z < end; z++) {
+            const float3 blue = transform[2] * linear[z];
+            float3* data = lut + z * size * size;
+            for (int32_t y = int32_t(size - 1); y >= 0; y--) {
+                const float3 greenBlue = green[y] + blue;
+                for (uint32_t x = 0; x < size; x++) {
+                    const float3 rgb = red[x] + greenBlue;
+                    *data++ = {clamper(oetf(rgb.r)), clamper(oetf(rgb.g)), clamper(oetf(rgb.b))};
+                }
+            }
+        }
+    };
+
+    // Below this size, starting threads costs more than they save.
+    constexpr uint32_t kMinParallelSize = 32;
+    const uint32_t threadCount = size < kMinParallelSize
+            ? 1u
+            : std::clamp(std::thread::hardware_concurrency(), 1u, 4u);
+    std::vector<std::thread> threads;
+    const uint32_t slicesPerThread = (size + threadCount - 1) / threadCount;
+    for (uint32_t begin = slicesPerThread; begin < size; begin += slicesPerThread) {
+        threads.emplace_back(fillSlices, begin, std::min(begin + slicesPerThread, size));
+    }
+    fillSlices(0, std::min(slicesPerThread, size));
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
 std::unique_ptr<float3[]> ColorSpace::createLUT(uint32_t size, const ColorSpace& src,
                                                 const ColorSpace& dst) {
     size = clamp(size, 2u, 256u);
-    float m = 1.0f / float(size - 1);
+
+    LutColorSpaceKey srcKey;
+    LutColorSpaceKey dstKey;
+    const bool cacheable = size <= LUT_CACHE_MAX_LUT_SIZE && getLutColorSpaceKey(src, &srcKey) &&
+            getLutColorSpaceKey(dst, &dstKey);
+
+    if (cacheable) {
+        std::lock_guard<std::mutex> lock(lutCacheMutex());
+        auto& cache = lutCache();
+        auto it = std::find_if(cache.begin(), cache.end(), [&](const LutCacheEntry& entry) {
+            return entry.size == size && entry.src == srcKey && entry.dst == dstKey;
+        });
+        if (it != cache.end()) {
+            cache.splice(cache.begin(), cache, it);
+            return copyLUT(it->lut.get(), size);
+        }
+    }
 
     std::unique_ptr<float3[]> lut(new float3[size * size * size]);
-    float3* data = lut.get();
-
-    ColorSpaceConnector connector(src, dst);
-
-    for (uint32_t z = 0; z < size; z++) {
-        for (int32_t y = int32_t(size - 1); y >= 0; y--) {
-            for (uint32_t x = 0; x < size; x++) {
-                *data++ = connector.transform({
-                    static_cast<float>(x) * m,
-                    static_cast<float>(y) * m,
-                    static_cast<float>(z) * m,
-                });
-            }
+    fillLUT(lut.get(), size, ColorSpaceConnector(src, dst));
+
+    if (cacheable) {
+        std::unique_ptr<float3[]> cached = copyLUT(lut.get(), size);
+        std::lock_guard<std::mutex> lock(lutCacheMutex());
+        auto& cache = lutCache();
+        cache.push_front({srcKey, dstKey, size, std::move(cached)});
+        if (cache.size() > LUT_CACHE_SIZE) {
+            cache.pop_back();
         }
     }
 
@@ -104,6 +104,15 @@ nsecs_t FenceTime::getSignalTime() {
         return signalTime;
     }
 
+    // A FenceWatcher will store the signal time once the fence signals.
+    if (mWatched.load(std::memory_order_acquire)) {
+        return Fence::SIGNAL_TIME_PENDING;
+    }
+
+    return pollSignalTime();
+}
+
+nsecs_t FenceTime::pollSignalTime() {
     // Hold a reference to the fence on the stack in case the class'
     // reference is removed by another thread. This prevents the
     // fence from being destroyed until the end of this method, where
@@ -122,7 +131,7 @@ nsecs_t FenceTime::getSignalTime() {
     }
 
     // Make the system call without the lock held.
-    signalTime = fence->getSignalTime();
+    nsecs_t signalTime = fence->getSignalTime();
 
     // Allow tests to override SIGNAL_TIME_INVALID behavior, since tests
     // use invalid underlying Fences without real file descriptors.
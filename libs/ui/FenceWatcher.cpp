@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <ui/FenceWatcher.h>
+
+#define LOG_TAG "FenceWatcher"
+
+#include <pthread.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <ui/FenceTime.h>
+#include <utils/Log.h>
+
+namespace android {
+
+FenceWatcher::FenceWatcher()
+      : mEpollFd(epoll_create1(EPOLL_CLOEXEC)), mStopFd(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) {
+    if (mEpollFd < 0 || mStopFd < 0) {
+        ALOGE("Failed to create fds: %s", strerror(errno));
+        mEpollFd.reset();
+        return;
+    }
+
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = mStopFd.get();
+    if (epoll_ctl(mEpollFd.get(), EPOLL_CTL_ADD, mStopFd.get(), &event) != 0) {
+        ALOGE("Failed to watch stop fd: %s", strerror(errno));
+        mEpollFd.reset();
+        return;
+    }
+
+    mThread = std::thread(&FenceWatcher::threadMain, this);
+    pthread_setname_np(mThread.native_handle(), "FenceWatcher");
+}
+
+FenceWatcher::~FenceWatcher() {
+    if (mThread.joinable()) {
+        const uint64_t value = 1;
+        if (TEMP_FAILURE_RETRY(write(mStopFd.get(), &value, sizeof(value))) < 0) {
+            ALOGE("Failed to stop thread: %s", strerror(errno));
+        }
+        mThread.join();
+    }
+    unwatchAll();
+}
+
+bool FenceWatcher::watch(const std::shared_ptr<FenceTime>& fenceTime, SignalCallback callback) {
+    if (!mThread.joinable() || !fenceTime || fenceTime->mState != FenceTime::State::VALID ||
+        fenceTime->mSignalTime.load(std::memory_order_relaxed) != Fence::SIGNAL_TIME_PENDING ||
+        fenceTime->mWatched.load(std::memory_order_relaxed)) {
+        return false;
+    }
+
+    sp<Fence> fence;
+    {
+        std::lock_guard<std::mutex> lock(fenceTime->mMutex);
+        fence = fenceTime->mFence;
+    }
+    if (!fence.get() || !fence->isValid()) {
+        return false;
+    }
+
+    std::lock_guard lock(mMutex);
+    if (mStopped || mEntries.size() >= MAX_WATCHED_FENCES) {
+        return false;
+    }
+
+    // The dup keeps the fd number stable for the lifetime of the entry, even
+    // if the FenceTime drops its Fence.
+    base::unique_fd fd(fence->dup());
+    if (fd < 0) {
+        return false;
+    }
+
+    epoll_event event = {};
+    event.events = EPOLLIN | EPOLLONESHOT;
+    event.data.fd = fd.get();
+    if (epoll_ctl(mEpollFd.get(), EPOLL_CTL_ADD, fd.get(), &event) != 0) {
+        ALOGE("Failed to watch fence: %s", strerror(errno));
+        return false;
+    }
+
+    fenceTime->mWatched.store(true, std::memory_order_release);
+    const int key = fd.get();
+    mEntries.emplace(key, Entry{std::move(fd), fenceTime, std::move(callback)});
+    return true;
+}
+
+void FenceWatcher::threadMain() {
+    constexpr int kMaxEvents = 16;
+    epoll_event events[kMaxEvents];
+
+    while (true) {
+        const int count = TEMP_FAILURE_RETRY(epoll_wait(mEpollFd.get(), events, kMaxEvents, -1));
+        if (count < 0) {
+            ALOGE("epoll_wait failed: %s", strerror(errno));
+            break;
+        }
+
+        for (int i = 0; i < count; i++) {
+            const int fd = events[i].data.fd;
+            if (fd == mStopFd.get()) {
+                return;
+            }
+            onFenceSignaled(fd);
+        }
+    }
+
+    // Hand every pending FenceTime back to its own polling.
+    unwatchAll();
+}
+
+void FenceWatcher::onFenceSignaled(int fd) {
+    std::shared_ptr<FenceTime> fenceTime;
+    base::unique_fd watchedFd;
+    SignalCallback callback;
+    {
+        std::lock_guard lock(mMutex);
+        const auto it = mEntries.find(fd);
+        if (it == mEntries.end()) {
+            return;
+        }
+
+        // The FenceTime still holds the same file description, so closing the
+        // dup alone would not remove it from the epoll set.
+        epoll_ctl(mEpollFd.get(), EPOLL_CTL_DEL, fd, nullptr);
+        fenceTime = it->second.fenceTime.lock();
+        watchedFd = std::move(it->second.fd);
+        callback = std::move(it->second.callback);
+        mEntries.erase(it);
+    }
+
+    if (fenceTime) {
+        fenceTime->pollSignalTime();
+        fenceTime->mWatched.store(false, std::memory_order_release);
+        if (callback) {
+            callback();
+        }
+    }
+}
+
+void FenceWatcher::unwatchAll() {
+    std::lock_guard lock(mMutex);
+    for (auto& [fd, entry] : mEntries) {
+        epoll_ctl(mEpollFd.get(), EPOLL_CTL_DEL, fd, nullptr);
+        if (const auto fenceTime = entry.fenceTime.lock()) {
+            fenceTime->mWatched.store(false, std::memory_order_release);
+        }
+    }
+    mEntries.clear();
+    mStopped = true;
+}
+
+} // namespace android
@@ -22,6 +22,36 @@ namespace android {
 
 GrallocMapper::~GrallocMapper() {}
 
+status_t GrallocMapper::getBufferMetadata(buffer_handle_t bufferHandle, uint32_t fields,
+                                          BufferMetadata* outMetadata) const {
+    if (!outMetadata) {
+        return BAD_VALUE;
+    }
+
+    outMetadata->validFields = 0;
+    if ((fields & BufferMetadata::DATASPACE) &&
+        getDataspace(bufferHandle, &outMetadata->dataspace) == NO_ERROR) {
+        outMetadata->validFields |= BufferMetadata::DATASPACE;
+    }
+    if ((fields & BufferMetadata::BLEND_MODE) &&
+        getBlendMode(bufferHandle, &outMetadata->blendMode) == NO_ERROR) {
+        outMetadata->validFields |= BufferMetadata::BLEND_MODE;
+    }
+    if ((fields & BufferMetadata::SMPTE2086) &&
+        getSmpte2086(bufferHandle, &outMetadata->smpte2086) == NO_ERROR) {
+        outMetadata->validFields |= BufferMetadata::SMPTE2086;
+    }
+    if ((fields & BufferMetadata::CTA861_3) &&
+        getCta861_3(bufferHandle, &outMetadata->cta861_3) == NO_ERROR) {
+        outMetadata->validFields |= BufferMetadata::CTA861_3;
+    }
+    if ((fields & BufferMetadata::SMPTE2094_40) &&
+        getSmpte2094_40(bufferHandle, &outMetadata->smpte2094_40) == NO_ERROR) {
+        outMetadata->validFields |= BufferMetadata::SMPTE2094_40;
+    }
+    return NO_ERROR;
+}
+
 GrallocAllocator::~GrallocAllocator() {}
 
 } // namespace android
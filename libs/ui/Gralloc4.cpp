@@ -409,6 +409,49 @@ int Gralloc4Mapper::unlock(buffer_handle_t bufferHandle) const {
     return releaseFence;
 }
 
+status_t Gralloc4Mapper::flushLockedBuffer(buffer_handle_t bufferHandle,
+                                           int* outReleaseFence) const {
+    auto buffer = const_cast<native_handle_t*>(bufferHandle);
+
+    *outReleaseFence = -1;
+    Error error;
+    auto ret = mMapper->flushLockedBuffer(buffer, [&](const auto& tmpError,
+                                                      const auto& tmpReleaseFence) {
+        error = tmpError;
+        if (error != Error::NONE) {
+            return;
+        }
+
+        auto fenceHandle = tmpReleaseFence.getNativeHandle();
+        if (fenceHandle && fenceHandle->numFds == 1) {
+            int fd = dup(fenceHandle->data[0]);
+            if (fd >= 0) {
+                *outReleaseFence = fd;
+            } else {
+                ALOGD("failed to dup flush release fence");
+                sync_wait(fenceHandle->data[0], -1);
+            }
+        }
+    });
+
+    error = (ret.isOk()) ? error : kTransactionError;
+
+    ALOGW_IF(error != Error::NONE, "flushLockedBuffer(%p) failed: %d", buffer, error);
+
+    return static_cast<status_t>(error);
+}
+
+status_t Gralloc4Mapper::rereadLockedBuffer(buffer_handle_t bufferHandle) const {
+    auto buffer = const_cast<native_handle_t*>(bufferHandle);
+
+    auto ret = mMapper->rereadLockedBuffer(buffer);
+    const Error error = (ret.isOk()) ? static_cast<Error>(ret) : kTransactionError;
+
+    ALOGW_IF(error != Error::NONE, "rereadLockedBuffer(%p) failed: %d", buffer, error);
+
+    return static_cast<status_t>(error);
+}
+
 status_t Gralloc4Mapper::isSupported(uint32_t width, uint32_t height, PixelFormat format,
                                      uint32_t layerCount, uint64_t usage,
                                      bool* outSupported) const {
@@ -441,17 +484,22 @@ status_t Gralloc4Mapper::isSupported(uint32_t width, uint32_t height, PixelForma
 
 template <class T>
 status_t Gralloc4Mapper::get(buffer_handle_t bufferHandle, const MetadataType& metadataType,
-                             DecodeFunction<T> decodeFunction, T* outMetadata) const {
+                             DecodeFunction<T> decodeFunction, T* outMetadata,
+                             bool logUnsupported) const {
     if (!outMetadata) {
         return BAD_VALUE;
     }
 
-    hidl_vec<uint8_t> vec;
+    // Decode straight out of the HAL's buffer instead of copying it into a local hidl_vec
+    // first.
+    status_t decodeError = NO_ERROR;
     Error error;
     auto ret = mMapper->get(const_cast<native_handle_t*>(bufferHandle), metadataType,
                             [&](const auto& tmpError, const hidl_vec<uint8_t>& tmpVec) {
                                 error = tmpError;
-                                vec = tmpVec;
+                                if (error == Error::NONE) {
+                                    decodeError = decodeFunction(tmpVec, outMetadata);
+                                }
                             });
 
     if (!ret.isOk()) {
@@ -459,12 +507,14 @@ status_t Gralloc4Mapper::get(buffer_handle_t bufferHandle, const MetadataType& m
     }
 
     if (error != Error::NONE) {
-        ALOGE("get(%s, %" PRIu64 ", ...) failed with %d", metadataType.name.c_str(),
-              metadataType.value, error);
+        if (logUnsupported || error != Error::UNSUPPORTED) {
+            ALOGE("get(%s, %" PRIu64 ", ...) failed with %d", metadataType.name.c_str(),
+                  metadataType.value, error);
+        }
         return static_cast<status_t>(error);
     }
 
-    return decodeFunction(vec, outMetadata);
+    return decodeError;
 }
 
 status_t Gralloc4Mapper::getBufferId(buffer_handle_t bufferHandle, uint64_t* outBufferId) const {
@@ -640,6 +690,56 @@ status_t Gralloc4Mapper::getSmpte2094_40(
                outSmpte2094_40);
 }
 
+status_t Gralloc4Mapper::getBufferMetadata(buffer_handle_t bufferHandle, uint32_t fields,
+                                           BufferMetadata* outMetadata) const {
+    if (!outMetadata) {
+        return BAD_VALUE;
+    }
+
+    // IMapper 4.0 has no multi-get, so this still makes one get() per field, but it skips the
+    // per-field vector copies and does not log for metadata the allocator doesn't support.
+    outMetadata->validFields = 0;
+    if (fields & BufferMetadata::DATASPACE) {
+        aidl::android::hardware::graphics::common::Dataspace dataspace;
+        if (get(bufferHandle, gralloc4::MetadataType_Dataspace, gralloc4::decodeDataspace,
+                &dataspace, false) == NO_ERROR) {
+            outMetadata->dataspace = static_cast<ui::Dataspace>(dataspace);
+            outMetadata->validFields |= BufferMetadata::DATASPACE;
+        }
+    }
+    if ((fields & BufferMetadata::BLEND_MODE) &&
+        get(bufferHandle, gralloc4::MetadataType_BlendMode, gralloc4::decodeBlendMode,
+            &outMetadata->blendMode, false) == NO_ERROR) {
+        outMetadata->validFields |= BufferMetadata::BLEND_MODE;
+    }
+    if (fields & BufferMetadata::CROP) {
+        std::vector<aidl::android::hardware::graphics::common::Rect> crops;
+        if (get(bufferHandle, gralloc4::MetadataType_Crop, gralloc4::decodeCrop, &crops, false) ==
+                    NO_ERROR &&
+            !crops.empty()) {
+            const auto& crop = crops.front();
+            outMetadata->crop = Rect(crop.left, crop.top, crop.right, crop.bottom);
+            outMetadata->validFields |= BufferMetadata::CROP;
+        }
+    }
+    if ((fields & BufferMetadata::SMPTE2086) &&
+        get(bufferHandle, gralloc4::MetadataType_Smpte2086, gralloc4::decodeSmpte2086,
+            &outMetadata->smpte2086, false) == NO_ERROR) {
+        outMetadata->validFields |= BufferMetadata::SMPTE2086;
+    }
+    if ((fields & BufferMetadata::CTA861_3) &&
+        get(bufferHandle, gralloc4::MetadataType_Cta861_3, gralloc4::decodeCta861_3,
+            &outMetadata->cta861_3, false) == NO_ERROR) {
+        outMetadata->validFields |= BufferMetadata::CTA861_3;
+    }
+    if ((fields & BufferMetadata::SMPTE2094_40) &&
+        get(bufferHandle, gralloc4::MetadataType_Smpte2094_40, gralloc4::decodeSmpte2094_40,
+            &outMetadata->smpte2094_40, false) == NO_ERROR) {
+        outMetadata->validFields |= BufferMetadata::SMPTE2094_40;
+    }
+    return NO_ERROR;
+}
+
 template <class T>
 status_t Gralloc4Mapper::getDefault(uint32_t width, uint32_t height, PixelFormat format,
                                     uint32_t layerCount, uint64_t usage,
@@ -20,8 +20,10 @@
 #include <ui/GraphicBuffer.h>
 
 #include <cutils/atomic.h>
+#include <unistd.h>
 
 #include <grallocusage/GrallocUsageConversion.h>
+#include <sync/sync.h>
 
 #include <ui/GraphicBufferAllocator.h>
 #include <ui/GraphicBufferMapper.h>
@@ -119,15 +121,27 @@ GraphicBuffer::~GraphicBuffer()
 
 void GraphicBuffer::free_handle()
 {
+    {
+        std::lock_guard<std::mutex> lock(mPersistentMappingMutex);
+        unmapPersistentLocked();
+    }
     if (mOwner == ownHandle) {
         mBufferMapper.freeBuffer(handle);
     } else if (mOwner == ownData) {
-        GraphicBufferAllocator& allocator(GraphicBufferAllocator::get());
-        allocator.free(handle);
+        releaseAllocatedHandle();
     }
     handle = nullptr;
 }
 
+void GraphicBuffer::releaseAllocatedHandle() {
+    GraphicBufferAllocator& allocator(GraphicBufferAllocator::get());
+    if (mShared) {
+        allocator.free(handle);
+    } else {
+        allocator.recycle(handle);
+    }
+}
+
 status_t GraphicBuffer::initCheck() const {
     return static_cast<status_t>(mInitCheck);
 }
@@ -158,8 +172,7 @@ status_t GraphicBuffer::reallocate(uint32_t inWidth, uint32_t inHeight,
         return NO_ERROR;
 
     if (handle) {
-        GraphicBufferAllocator& allocator(GraphicBufferAllocator::get());
-        allocator.free(handle);
+        releaseAllocatedHandle();
         handle = nullptr;
     }
     return initWithSize(inWidth, inHeight, inFormat, inLayerCount, inUsage, "[Reallocation]");
@@ -346,6 +359,68 @@ status_t GraphicBuffer::unlockAsync(int *fenceFd)
     return res;
 }
 
+status_t GraphicBuffer::lockPersistentAsync(uint64_t inUsage, void** vaddr, int fenceFd) {
+    std::lock_guard<std::mutex> lock(mPersistentMappingMutex);
+
+    if (mPersistentVaddr != nullptr && (mPersistentUsage & inUsage) == inUsage) {
+        if (fenceFd >= 0) {
+            sync_wait(fenceFd, -1);
+            close(fenceFd);
+            fenceFd = -1;
+        }
+        if (!(inUsage & GRALLOC_USAGE_SW_READ_MASK) ||
+            getBufferMapper().rereadLockedBuffer(handle) == NO_ERROR) {
+            *vaddr = mPersistentVaddr;
+            return NO_ERROR;
+        }
+    }
+
+    // Map the buffer for the usage of the previous mapping too, so that alternating usages
+    // keep reusing the same mapping.
+    const uint64_t usage = inUsage | mPersistentUsage;
+    unmapPersistentLocked();
+
+    void* data = nullptr;
+    status_t res = lockAsync(usage, usage, Rect(width, height), &data, fenceFd);
+    if (res != NO_ERROR) {
+        return res;
+    }
+
+    mPersistentUsage = usage;
+    mPersistentVaddr = data;
+    *vaddr = data;
+    return NO_ERROR;
+}
+
+status_t GraphicBuffer::unlockPersistentAsync(int* fenceFd) {
+    std::lock_guard<std::mutex> lock(mPersistentMappingMutex);
+
+    *fenceFd = -1;
+    if (mPersistentVaddr == nullptr) {
+        return INVALID_OPERATION;
+    }
+
+    if (!(mPersistentUsage & GRALLOC_USAGE_SW_WRITE_MASK) ||
+        getBufferMapper().flushLockedBuffer(handle, fenceFd) == NO_ERROR) {
+        return NO_ERROR;
+    }
+
+    // The writes can only be flushed by unlocking the buffer.
+    mPersistentUsage = 0;
+    mPersistentVaddr = nullptr;
+    return unlockAsync(fenceFd);
+}
+
+void GraphicBuffer::unmapPersistentLocked() {
+    if (mPersistentVaddr == nullptr) {
+        return;
+    }
+
+    getBufferMapper().unlock(handle);
+    mPersistentUsage = 0;
+    mPersistentVaddr = nullptr;
+}
+
 status_t GraphicBuffer::isSupported(uint32_t inWidth, uint32_t inHeight, PixelFormat inFormat,
                                     uint32_t inLayerCount, uint64_t inUsage,
                                     bool* outSupported) const {
@@ -368,6 +443,8 @@ status_t GraphicBuffer::flatten(void*& buffer, size_t& size, int*& fds, size_t&
     size_t fdCountNeeded = GraphicBuffer::getFdCount();
     if (count < fdCountNeeded) return NO_MEMORY;
 
+    mShared = true;
+
     int32_t* buf = static_cast<int32_t*>(buffer);
     buf[0] = 'GB01';
     buf[1] = width;
@@ -25,6 +25,7 @@
 
 #include <grallocusage/GrallocUsageConversion.h>
 
+#include <android-base/properties.h>
 #include <android-base/stringprintf.h>
 #include <log/log.h>
 #include <utils/Singleton.h>
@@ -41,6 +42,20 @@ namespace android {
 
 using base::StringAppendF;
 
+namespace {
+
+// Pooled buffers that were not reused for this long are freed.
+constexpr nsecs_t kPoolMaxIdleTime = s2ns(2);
+
+constexpr size_t kDefaultPoolMaxBuffers = 16;
+
+// Buffers that other processes or devices may keep accessing by handle after they are freed, or
+// whose contents must not outlive them.
+constexpr uint64_t kUnpoolableUsage = GRALLOC_USAGE_PROTECTED | GRALLOC_USAGE_HW_VIDEO_ENCODER |
+        GRALLOC_USAGE_HW_CAMERA_WRITE | GRALLOC_USAGE_HW_CAMERA_READ;
+
+} // namespace
+
 ANDROID_SINGLETON_STATIC_INSTANCE( GraphicBufferAllocator )
 
 Mutex GraphicBufferAllocator::sLock;
@@ -48,6 +63,9 @@ KeyedVector<buffer_handle_t,
     GraphicBufferAllocator::alloc_rec_t> GraphicBufferAllocator::sAllocList;
 
 GraphicBufferAllocator::GraphicBufferAllocator() : mMapper(GraphicBufferMapper::getInstance()) {
+    mPoolMaxBytes = base::GetUintProperty<size_t>("debug.ui.buffer_pool_kb", 0) * 1024;
+    mPoolMaxBuffers = kDefaultPoolMaxBuffers;
+
     mAllocator = std::make_unique<const Gralloc4Allocator>(
             reinterpret_cast<const Gralloc4Mapper&>(mMapper.getGrallocMapper()));
     if (mAllocator->isLoaded()) {
@@ -88,20 +106,33 @@ void GraphicBufferAllocator::dump(std::string& result, bool less) const {
         const alloc_rec_t& rec(list.valueAt(i));
         if (rec.size) {
             StringAppendF(&result,
-                          "%10p: %7.2f KiB | %4u (%4u) x %4u | %4u | %8X | 0x%" PRIx64 " | %s\n",
+                          "%10p: %7.2f KiB | %4u (%4u) x %4u | %4u | %8X | 0x%" PRIx64 " | %s%s\n",
                           list.keyAt(i), static_cast<double>(rec.size) / 1024.0, rec.width, rec.stride, rec.height,
-                          rec.layerCount, rec.format, rec.usage, rec.requestorName.c_str());
+                          rec.layerCount, rec.format, rec.usage, rec.requestorName.c_str(),
+                          rec.pooled ? " (pooled)" : "");
         } else {
             StringAppendF(&result,
-                          "%10p: unknown     | %4u (%4u) x %4u | %4u | %8X | 0x%" PRIx64 " | %s\n",
+                          "%10p: unknown     | %4u (%4u) x %4u | %4u | %8X | 0x%" PRIx64 " | %s%s\n",
                           list.keyAt(i), rec.width, rec.stride, rec.height, rec.layerCount,
-                          rec.format, rec.usage, rec.requestorName.c_str());
+                          rec.format, rec.usage, rec.requestorName.c_str(),
+                          rec.pooled ? " (pooled)" : "");
         }
         total += rec.size;
     }
     StringAppendF(&result, "Total allocated by GraphicBufferAllocator (estimate): %.2f KB\n",
                   static_cast<double>(total) / 1024.0);
 
+    if (mPoolMaxBytes > 0) {
+        StringAppendF(&result,
+                      "Buffer pool: %zu buffers, %.2f KB (limits %zu buffers, %.2f KB) | "
+                      "hits %" PRIu64 " misses %" PRIu64 " evictions %" PRIu64 "\n",
+                      mPool.size(), static_cast<double>(mPoolBytes) / 1024.0, mPoolMaxBuffers,
+                      static_cast<double>(mPoolMaxBytes) / 1024.0, mPoolStats.hits,
+                      mPoolStats.misses, mPoolStats.evictions);
+    } else {
+        result.append("Buffer pool: disabled\n");
+    }
+
     result.append(mAllocator->dumpDebugInfo(less));
 }
 
@@ -137,6 +168,21 @@ status_t GraphicBufferAllocator::allocateHelper(uint32_t width, uint32_t height,
     // TODO(b/72323293, b/72703005): Remove these invalid bits from callers
     usage &= ~static_cast<uint64_t>((1 << 10) | (1 << 13));
 
+    if (importBuffer) {
+        bool pooled;
+        std::vector<buffer_handle_t> evicted;
+        {
+            Mutex::Autolock _l(sLock);
+            pooled = takePooledBufferLocked(width, height, format, layerCount, usage, handle,
+                                            stride, requestorName);
+            evicted = evictPooledBuffersLocked(systemTime(), mPoolMaxBytes);
+        }
+        freeEvictedBuffers(evicted);
+        if (pooled) {
+            return NO_ERROR;
+        }
+    }
+
     status_t error = mAllocator->allocate(requestorName, width, height, format, layerCount, usage,
                                           1, stride, handle, importBuffer);
     if (error != NO_ERROR) {
@@ -200,6 +246,104 @@ status_t GraphicBufferAllocator::allocate(uint32_t width, uint32_t height, Pixel
                           true);
 }
 
+bool GraphicBufferAllocator::takePooledBufferLocked(uint32_t width, uint32_t height,
+                                                    PixelFormat format, uint32_t layerCount,
+                                                    uint64_t usage, buffer_handle_t* handle,
+                                                    uint32_t* stride,
+                                                    std::string& requestorName) {
+    if (mPoolMaxBytes == 0) {
+        return false;
+    }
+    for (auto it = mPool.rbegin(); it != mPool.rend(); ++it) {
+        alloc_rec_t& rec = sAllocList.editValueFor(it->handle);
+        if (rec.width == width && rec.height == height && rec.format == format &&
+            rec.layerCount == layerCount && rec.usage == usage) {
+            ATRACE_NAME("takePooledBuffer");
+            *handle = it->handle;
+            *stride = rec.stride;
+            rec.pooled = false;
+            rec.requestorName = std::move(requestorName);
+            mPoolBytes -= rec.size;
+            mPool.erase(std::next(it).base());
+            mPoolStats.hits++;
+            return true;
+        }
+    }
+    mPoolStats.misses++;
+    return false;
+}
+
+std::vector<buffer_handle_t> GraphicBufferAllocator::evictPooledBuffersLocked(nsecs_t now,
+                                                                              size_t maxBytes) {
+    std::vector<buffer_handle_t> evicted;
+    while (!mPool.empty() &&
+           (mPoolBytes > maxBytes || mPool.size() > mPoolMaxBuffers ||
+            now - mPool.front().recycleTime > kPoolMaxIdleTime)) {
+        const buffer_handle_t handle = mPool.front().handle;
+        mPool.pop_front();
+        mPoolBytes -= sAllocList.valueFor(handle).size;
+        // Drop the record before the handle is freed, since a new import may reuse its address.
+        sAllocList.removeItem(handle);
+        evicted.push_back(handle);
+        mPoolStats.evictions++;
+    }
+    return evicted;
+}
+
+void GraphicBufferAllocator::freeEvictedBuffers(const std::vector<buffer_handle_t>& handles) {
+    for (buffer_handle_t handle : handles) {
+        mMapper.freeBuffer(handle);
+    }
+}
+
+status_t GraphicBufferAllocator::recycle(buffer_handle_t handle) {
+    ATRACE_CALL();
+
+    std::vector<buffer_handle_t> evicted;
+    {
+        Mutex::Autolock _l(sLock);
+        const ssize_t index = sAllocList.indexOfKey(handle);
+        alloc_rec_t* rec = index >= 0 ? &sAllocList.editValueAt(static_cast<size_t>(index))
+                                      : nullptr;
+        if (rec == nullptr || rec->size == 0 || rec->size > mPoolMaxBytes ||
+            mPoolMaxBuffers == 0 || (rec->usage & kUnpoolableUsage)) {
+            if (index >= 0) {
+                sAllocList.removeItemsAt(static_cast<size_t>(index));
+            }
+            evicted.push_back(handle);
+        } else {
+            rec->pooled = true;
+            mPoolBytes += rec->size;
+            const nsecs_t now = systemTime();
+            mPool.push_back({handle, now});
+            evicted = evictPooledBuffersLocked(now, mPoolMaxBytes);
+        }
+    }
+    freeEvictedBuffers(evicted);
+    return NO_ERROR;
+}
+
+void GraphicBufferAllocator::setPoolLimits(size_t maxBytes, size_t maxBuffers) {
+    std::vector<buffer_handle_t> evicted;
+    {
+        Mutex::Autolock _l(sLock);
+        mPoolMaxBytes = maxBytes;
+        mPoolMaxBuffers = maxBuffers;
+        evicted = evictPooledBuffersLocked(systemTime(), mPoolMaxBytes);
+    }
+    freeEvictedBuffers(evicted);
+}
+
+void GraphicBufferAllocator::trimPool(size_t maxBytes) {
+    ATRACE_CALL();
+    std::vector<buffer_handle_t> evicted;
+    {
+        Mutex::Autolock _l(sLock);
+        evicted = evictPooledBuffersLocked(systemTime(), maxBytes);
+    }
+    freeEvictedBuffers(evicted);
+}
+
 status_t GraphicBufferAllocator::free(buffer_handle_t handle)
 {
     ATRACE_CALL();
@@ -183,6 +183,18 @@ status_t GraphicBufferMapper::unlockAsync(buffer_handle_t handle, int *fenceFd)
     return NO_ERROR;
 }
 
+status_t GraphicBufferMapper::flushLockedBuffer(buffer_handle_t handle, int* fenceFd) {
+    ATRACE_CALL();
+
+    return mMapper->flushLockedBuffer(handle, fenceFd);
+}
+
+status_t GraphicBufferMapper::rereadLockedBuffer(buffer_handle_t handle) {
+    ATRACE_CALL();
+
+    return mMapper->rereadLockedBuffer(handle);
+}
+
 status_t GraphicBufferMapper::isSupported(uint32_t width, uint32_t height,
                                           android::PixelFormat format, uint32_t layerCount,
                                           uint64_t usage, bool* outSupported) {
@@ -301,6 +313,11 @@ status_t GraphicBufferMapper::getSmpte2094_40(
     return mMapper->getSmpte2094_40(bufferHandle, outSmpte2094_40);
 }
 
+status_t GraphicBufferMapper::getBufferMetadata(buffer_handle_t bufferHandle, uint32_t fields,
+                                                BufferMetadata* outMetadata) {
+    return mMapper->getBufferMetadata(bufferHandle, fields, outMetadata);
+}
+
 status_t GraphicBufferMapper::getDefaultPixelFormatFourCC(uint32_t width, uint32_t height,
                                                           PixelFormat format, uint32_t layerCount,
                                                           uint64_t usage,
@@ -19,6 +19,14 @@
 #include <inttypes.h>
 #include <limits.h>
 
+#include <memory>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include <android-base/stringprintf.h>
 
 #include <utils/Log.h>
@@ -66,6 +74,104 @@ const Region Region::INVALID_REGION(Rect::INVALID_RECT);
 
 // ----------------------------------------------------------------------------
 
+static_assert(sizeof(Rect) == 4 * sizeof(int32_t), "Rect must be four packed int32_t");
+
+// Returns true if every rect in p has the same left and right edges as the
+// matching rect in q. Used to decide if two adjacent spans can be merged.
+static bool spansHaveSameColumns(const Rect* p, const Rect* q, size_t count) {
+#if defined(__ARM_NEON)
+    int32x4_t diff = vdupq_n_s32(0);
+    for (size_t i = 0; i < count; i++) {
+        const int32x4_t a = vld1q_s32(reinterpret_cast<const int32_t*>(p + i));
+        const int32x4_t b = vld1q_s32(reinterpret_cast<const int32_t*>(q + i));
+        diff = vorrq_s32(diff, veorq_s32(a, b));
+    }
+    // Only the left (lane 0) and right (lane 2) edges are compared
+    return (vgetq_lane_s32(diff, 0) | vgetq_lane_s32(diff, 2)) == 0;
+#elif defined(__SSE2__)
+    __m128i diff = _mm_setzero_si128();
+    for (size_t i = 0; i < count; i++) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(q + i));
+        diff = _mm_or_si128(diff, _mm_xor_si128(a, b));
+    }
+    // Only the left (lane 0) and right (lane 2) edges are compared
+    const __m128i mask = _mm_set_epi32(0, -1, 0, -1);
+    return _mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(diff, mask), _mm_setzero_si128())) ==
+            0xFFFF;
+#else
+    for (size_t i = 0; i < count; i++) {
+        if ((p[i].left != q[i].left) || (p[i].right != q[i].right)) {
+            return false;
+        }
+    }
+    return true;
+#endif
+}
+
+// Offsets every rect by (dx, dy)
+static void offsetRects(Rect* rects, size_t count, int dx, int dy) {
+#if defined(__ARM_NEON)
+    const int32_t offset[4] = {dx, dy, dx, dy};
+    const int32x4_t delta = vld1q_s32(offset);
+    for (size_t i = 0; i < count; i++) {
+        int32_t* r = reinterpret_cast<int32_t*>(rects + i);
+        vst1q_s32(r, vaddq_s32(vld1q_s32(r), delta));
+    }
+#elif defined(__SSE2__)
+    const __m128i delta = _mm_set_epi32(dy, dx, dy, dx);
+    for (size_t i = 0; i < count; i++) {
+        __m128i* r = reinterpret_cast<__m128i*>(rects + i);
+        _mm_storeu_si128(r, _mm_add_epi32(_mm_loadu_si128(r), delta));
+    }
+#else
+    for (size_t i = 0; i < count; i++) {
+        rects[i].offsetBy(dx, dy);
+    }
+#endif
+}
+
+// Scratch storage for the copy of the left hand side made by the self
+// operations, and for the spans built up by the rasterizer. It is kept per
+// thread and reused across operations, so that steady state region math on a
+// thread (such as the SurfaceFlinger composition loop) does not allocate.
+struct RegionScratch {
+    Region lhs;
+    FatVector<Rect> span;
+};
+
+// Scratch storage that grew beyond this many rects is released once the
+// operation is done, so that one unusually complex region does not pin memory
+// for the lifetime of the thread.
+static constexpr size_t kMaxScratchRects = 256;
+
+static thread_local std::unique_ptr<RegionScratch> tlsRegionScratch;
+
+static RegionScratch& getRegionScratch() {
+    if (!tlsRegionScratch) {
+        tlsRegionScratch = std::make_unique<RegionScratch>();
+    }
+    return *tlsRegionScratch;
+}
+
+static void trimRegionScratch() {
+    if (!tlsRegionScratch) {
+        return;
+    }
+    size_t lhsCount = 0;
+    tlsRegionScratch->lhs.getArray(&lhsCount);
+    if (lhsCount > kMaxScratchRects || tlsRegionScratch->span.capacity() > kMaxScratchRects) {
+        tlsRegionScratch.reset();
+    }
+}
+
+static inline bool rectContains(const Rect& outer, const Rect& inner) {
+    return outer.left <= inner.left && outer.top <= inner.top && outer.right >= inner.right &&
+            outer.bottom >= inner.bottom;
+}
+
+// ----------------------------------------------------------------------------
+
 Region::Region() {
     mStorage.push_back(Rect(0, 0));
 }
@@ -329,8 +435,13 @@ Region& Region::subtractSelf(const Rect& r) {
     return operationSelf(r, op_nand);
 }
 Region& Region::operationSelf(const Rect& r, uint32_t op) {
-    Region lhs(*this);
-    boolean_operation(op, *this, lhs, r);
+    if (r.isValid() && trivial_boolean_operation(op, *this, *this, nullptr, r)) {
+        return *this;
+    }
+    RegionScratch& scratch = getRegionScratch();
+    scratch.lhs = *this;
+    boolean_operation(op, *this, scratch.lhs, r);
+    trimRegionScratch();
     return *this;
 }
 
@@ -353,8 +464,13 @@ Region& Region::subtractSelf(const Region& rhs) {
     return operationSelf(rhs, op_nand);
 }
 Region& Region::operationSelf(const Region& rhs, uint32_t op) {
-    Region lhs(*this);
-    boolean_operation(op, *this, lhs, rhs);
+    if (trivial_boolean_operation(op, *this, *this, &rhs, rhs.getBounds())) {
+        return *this;
+    }
+    RegionScratch& scratch = getRegionScratch();
+    scratch.lhs = *this;
+    boolean_operation(op, *this, scratch.lhs, rhs);
+    trimRegionScratch();
     return *this;
 }
 
@@ -394,6 +510,7 @@ const Region Region::subtract(const Rect& rhs) const {
 const Region Region::operation(const Rect& rhs, uint32_t op) const {
     Region result;
     boolean_operation(op, result, *this, rhs);
+    trimRegionScratch();
     return result;
 }
 
@@ -414,6 +531,7 @@ const Region Region::subtract(const Region& rhs) const {
 const Region Region::operation(const Region& rhs, uint32_t op) const {
     Region result;
     boolean_operation(op, result, *this, rhs);
+    trimRegionScratch();
     return result;
 }
 
@@ -438,8 +556,10 @@ Region& Region::subtractSelf(const Region& rhs, int dx, int dy) {
     return operationSelf(rhs, dx, dy, op_nand);
 }
 Region& Region::operationSelf(const Region& rhs, int dx, int dy, uint32_t op) {
-    Region lhs(*this);
-    boolean_operation(op, *this, lhs, rhs, dx, dy);
+    RegionScratch& scratch = getRegionScratch();
+    scratch.lhs = *this;
+    boolean_operation(op, *this, scratch.lhs, rhs, dx, dy);
+    trimRegionScratch();
     return *this;
 }
 
@@ -460,6 +580,7 @@ const Region Region::subtract(const Region& rhs, int dx, int dy) const {
 const Region Region::operation(const Region& rhs, int dx, int dy, uint32_t op) const {
     Region result;
     boolean_operation(op, result, *this, rhs, dx, dy);
+    trimRegionScratch();
     return result;
 }
 
@@ -473,12 +594,14 @@ class Region::rasterizer : public region_operator<Rect>::region_rasterizer
     FatVector<Rect>& storage;
     Rect* head;
     Rect* tail;
-    FatVector<Rect> span;
+    FatVector<Rect>& span;
     Rect* cur;
 public:
     explicit rasterizer(Region& reg)
-        : bounds(INT_MAX, 0, INT_MIN, 0), storage(reg.mStorage), head(), tail(), cur() {
+        : bounds(INT_MAX, 0, INT_MIN, 0), storage(reg.mStorage), head(), tail(),
+          span(getRegionScratch().span), cur() {
         storage.clear();
+        span.clear();
     }
 
     virtual ~rasterizer();
@@ -535,15 +658,7 @@ void Region::rasterizer::flushSpan()
         Rect const* p = span.data();
         Rect const* q = head;
         if (p->top == q->bottom) {
-            merge = true;
-            while (q != tail) {
-                if ((p->left != q->left) || (p->right != q->right)) {
-                    merge = false;
-                    break;
-                }
-                p++;
-                q++;
-            }
+            merge = spansHaveSameColumns(p, q, span.size());
         }
     }
     if (merge) {
@@ -653,6 +768,12 @@ void Region::boolean_operation(uint32_t op, Region& dst,
     validate(dst, "boolean_operation (before): dst");
 #endif
 
+#if !VALIDATE_WITH_CORECG
+    if ((dx | dy) == 0 && trivial_boolean_operation(op, dst, lhs, &rhs, rhs.getBounds())) {
+        return;
+    }
+#endif
+
     size_t lhs_count;
     Rect const * const lhs_rects = lhs.getArray(&lhs_count);
 
@@ -767,6 +888,12 @@ void Region::boolean_operation(uint32_t op, Region& dst,
 #if VALIDATE_WITH_CORECG || defined(VALIDATE_REGIONS)
     boolean_operation(op, dst, lhs, Region(rhs), dx, dy);
 #else
+    Rect rhsBounds(rhs);
+    rhsBounds.offsetBy(dx, dy);
+    if (trivial_boolean_operation(op, dst, lhs, nullptr, rhsBounds)) {
+        return;
+    }
+
     size_t lhs_count;
     Rect const * const lhs_rects = lhs.getArray(&lhs_count);
 
@@ -781,6 +908,71 @@ void Region::boolean_operation(uint32_t op, Region& dst,
 #endif
 }
 
+bool Region::trivial_boolean_operation(uint32_t op, Region& dst, const Region& lhs,
+                                       const Region* rhsRegion, const Rect& rhsBounds) {
+    const Rect lhsBounds = lhs.getBounds();
+    const bool lhsEmpty = lhsBounds.isEmpty();
+    const bool rhsEmpty = rhsBounds.isEmpty();
+    const bool rhsIsRect = !rhsRegion || rhsRegion->isRect();
+    Rect intersection;
+    const bool overlaps = !lhsEmpty && !rhsEmpty && lhsBounds.intersect(rhsBounds, &intersection);
+
+    // Note that dst may alias lhs or rhs, so it is only written once the
+    // result is known.
+    const auto setRhs = [&]() {
+        if (rhsRegion) {
+            dst = *rhsRegion;
+        } else {
+            dst.set(rhsBounds);
+        }
+    };
+
+    switch (op) {
+        case op_and:
+            if (!overlaps) {
+                dst.clear();
+            } else if (lhs.isRect() && rhsIsRect) {
+                dst.set(intersection);
+            } else if (rhsIsRect && rectContains(rhsBounds, lhsBounds)) {
+                dst = lhs;
+            } else if (lhs.isRect() && rectContains(lhsBounds, rhsBounds)) {
+                setRhs();
+            } else {
+                return false;
+            }
+            return true;
+
+        case op_nand:
+            if (lhsEmpty) {
+                dst.clear();
+            } else if (!overlaps) {
+                dst = lhs;
+            } else if (rhsIsRect && rectContains(rhsBounds, lhsBounds)) {
+                dst.clear();
+            } else {
+                return false;
+            }
+            return true;
+
+        case op_or:
+            if (lhsEmpty && rhsEmpty) {
+                dst.clear();
+            } else if (rhsEmpty) {
+                dst = lhs;
+            } else if (lhsEmpty) {
+                setRhs();
+            } else if (lhs.isRect() && rectContains(lhsBounds, rhsBounds)) {
+                dst = lhs;
+            } else if (rhsIsRect && rectContains(rhsBounds, lhsBounds)) {
+                setRhs();
+            } else {
+                return false;
+            }
+            return true;
+    }
+    return false;
+}
+
 void Region::boolean_operation(uint32_t op, Region& dst,
         const Region& lhs, const Region& rhs)
 {
@@ -799,13 +991,7 @@ void Region::translate(Region& reg, int dx, int dy)
 #if defined(VALIDATE_REGIONS)
         validate(reg, "translate (before)");
 #endif
-        size_t count = reg.mStorage.size();
-        Rect* rects = reg.mStorage.data();
-        while (count) {
-            rects->offsetBy(dx, dy);
-            rects++;
-            count--;
-        }
+        offsetRects(reg.mStorage.data(), reg.mStorage.size(), dx, dy);
 #if defined(VALIDATE_REGIONS)
         validate(reg, "translate (after)");
 #endif
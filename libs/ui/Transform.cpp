@@ -18,6 +18,7 @@
 
 #include <android-base/stringprintf.h>
 #include <cutils/compiler.h>
+#include <ui/FatVector.h>
 #include <ui/Region.h>
 #include <ui/Transform.h>
 #include <utils/String8.h>
@@ -67,6 +68,13 @@ Transform Transform::operator * (const Transform& rhs) const
     if (rhs.mType == IDENTITY)
         return r;
 
+    if (mType <= TRANSLATE && rhs.mType <= TRANSLATE) {
+        // both are pure translations (and their type is known), so is the
+        // product, no need for the full multiply and reclassification
+        r.set(tx() + rhs.tx(), ty() + rhs.ty());
+        return r;
+    }
+
     // TODO: we could use mType to optimize the matrix multiply
     const mat33& A(mMatrix);
     const mat33& B(rhs.mMatrix);
@@ -216,7 +224,36 @@ Rect Transform::makeBounds(int w, int h) const
 
 Rect Transform::transform(const Rect& bounds, bool roundOutwards) const
 {
+    const uint32_t type = this->type();
+    if (CC_LIKELY(type <= TRANSLATE) && bounds.isValid() && hasIntegerTranslation()) {
+        // exact, whatever the rounding
+        return Rect(bounds).offsetBy(static_cast<int32_t>(tx()), static_cast<int32_t>(ty()));
+    }
+
     Rect r;
+    if (CC_LIKELY(!(type & UNKNOWN))) {
+        // there is no skew nor arbitrary rotation, so the transformed rect is
+        // still axis aligned, and two opposite corners are enough to find it
+        vec2 lt( bounds.left,  bounds.top    );
+        vec2 rb( bounds.right, bounds.bottom );
+
+        lt = transform(lt);
+        rb = transform(rb);
+
+        if (roundOutwards) {
+            r.left   = static_cast<int32_t>(floorf(std::min(lt[0], rb[0])));
+            r.top    = static_cast<int32_t>(floorf(std::min(lt[1], rb[1])));
+            r.right  = static_cast<int32_t>(ceilf(std::max(lt[0], rb[0])));
+            r.bottom = static_cast<int32_t>(ceilf(std::max(lt[1], rb[1])));
+        } else {
+            r.left   = static_cast<int32_t>(floorf(std::min(lt[0], rb[0]) + 0.5f));
+            r.top    = static_cast<int32_t>(floorf(std::min(lt[1], rb[1]) + 0.5f));
+            r.right  = static_cast<int32_t>(floorf(std::max(lt[0], rb[0]) + 0.5f));
+            r.bottom = static_cast<int32_t>(floorf(std::max(lt[1], rb[1]) + 0.5f));
+        }
+        return r;
+    }
+
     vec2 lt( bounds.left,  bounds.top    );
     vec2 rt( bounds.right, bounds.top    );
     vec2 lb( bounds.left,  bounds.bottom );
@@ -242,6 +279,25 @@ Rect Transform::transform(const Rect& bounds, bool roundOutwards) const
     return r;
 }
 
+void Transform::transform(const Rect* in, Rect* out, size_t count, bool roundOutwards) const
+{
+    const uint32_t type = this->type();
+    if (type == IDENTITY) {
+        std::copy(in, in + count, out);
+    } else if (type <= TRANSLATE && hasIntegerTranslation()) {
+        const int32_t dx = static_cast<int32_t>(tx());
+        const int32_t dy = static_cast<int32_t>(ty());
+        for (size_t i = 0; i < count; i++) {
+            out[i] = in[i].isValid() ? Rect(in[i]).offsetBy(dx, dy)
+                                     : transform(in[i], roundOutwards);
+        }
+    } else {
+        for (size_t i = 0; i < count; i++) {
+            out[i] = transform(in[i], roundOutwards);
+        }
+    }
+}
+
 FloatRect Transform::transform(const FloatRect& bounds) const
 {
     vec2 lt(bounds.left, bounds.top);
@@ -267,7 +323,37 @@ Region Transform::transform(const Region& reg) const
 {
     Region out;
     if (CC_UNLIKELY(type() > TRANSLATE)) {
-        if (CC_LIKELY(preserveRects())) {
+        size_t count;
+        const Rect* rects = reg.getArray(&count);
+        if (count > 1 && isIntegerFlip()) {
+            // Flips map the region onto itself, only reversing the order of
+            // its bands (FLIP_V) and of the rects within each band (FLIP_H),
+            // so the result can be built directly without any region math.
+            FatVector<Rect, 16> transformed(count);
+            transform(rects, transformed.data(), count);
+
+            const bool flipH = mMatrix[0][0] < 0;
+            const bool flipV = mMatrix[1][1] < 0;
+            out.set(transform(reg.getBounds()));
+            for (size_t done = 0; done < count;) {
+                // [first, last) is the next band in the order of the result
+                size_t first, last;
+                if (flipV) {
+                    last = count - done;
+                    first = last - 1;
+                    while (first > 0 && rects[first - 1].top == rects[first].top) first--;
+                } else {
+                    first = done;
+                    last = first + 1;
+                    while (last < count && rects[last].top == rects[first].top) last++;
+                }
+                for (size_t i = 0; i < last - first; i++) {
+                    const Rect& r = transformed[flipH ? last - 1 - i : first + i];
+                    out.addRectUnchecked(r.left, r.top, r.right, r.bottom);
+                }
+                done += last - first;
+            }
+        } else if (CC_LIKELY(preserveRects())) {
             Region::const_iterator it = reg.begin();
             Region::const_iterator const end = reg.end();
             while (it != end) {
@@ -342,7 +428,7 @@ Transform Transform::inverse() const {
     // followed by a translation: T*M, therefore:
     // (T*M)^-1 = M^-1 * T^-1
     Transform result;
-    if (mType <= TRANSLATE) {
+    if (type() <= TRANSLATE) {
         // 1 0 0
         // 0 1 0
         // x y 1
@@ -376,6 +462,16 @@ Transform Transform::inverse() const {
     return result;
 }
 
+bool Transform::isIntegerFlip() const {
+    const mat33& M(mMatrix);
+    return isZero(M[1][0]) && isZero(M[0][1]) && absIsOne(M[0][0]) && absIsOne(M[1][1]) &&
+            hasIntegerTranslation();
+}
+
+bool Transform::hasIntegerTranslation() const {
+    return floorf(tx()) == tx() && floorf(ty()) == ty();
+}
+
 uint32_t Transform::getType() const {
     return type() & 0xFF;
 }
@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <ui/Rect.h>
+#include <ui/Region.h>
+
+#include <vector>
+
+namespace android {
+
+// The layer bounds of a typical phone home screen, front to back: status and
+// navigation bars, a few overlapping app widgets and icons, and the wallpaper.
+static const std::vector<Rect> kLayerBounds = {
+        Rect(0, 0, 1080, 84),       Rect(0, 2208, 1080, 2340),  Rect(40, 200, 1040, 620),
+        Rect(40, 660, 520, 1100),   Rect(560, 660, 1040, 1100), Rect(80, 1900, 240, 2060),
+        Rect(320, 1900, 480, 2060), Rect(560, 1900, 720, 2060), Rect(800, 1900, 960, 2060),
+        Rect(0, 0, 1080, 2340),
+};
+
+// Mimics the coverage computation SurfaceFlinger does for every layer on each
+// geometry update, which exercises union, intersect and subtract together.
+static void BM_regionCoverage(benchmark::State& state) {
+    for (auto _ : state) {
+        Region aboveOpaque;
+        Region aboveCovered;
+        for (const auto& bounds : kLayerBounds) {
+            Region visible(bounds);
+            Region covered = aboveCovered.intersect(visible);
+            aboveCovered.orSelf(visible);
+            visible.subtractSelf(aboveOpaque);
+            aboveOpaque.orSelf(bounds);
+            benchmark::DoNotOptimize(covered);
+            benchmark::DoNotOptimize(visible);
+        }
+    }
+}
+BENCHMARK(BM_regionCoverage);
+
+static void BM_regionUnion(benchmark::State& state) {
+    for (auto _ : state) {
+        Region region;
+        for (const auto& bounds : kLayerBounds) {
+            region.orSelf(bounds);
+        }
+        benchmark::DoNotOptimize(region);
+    }
+}
+BENCHMARK(BM_regionUnion);
+
+static void BM_regionSubtract(benchmark::State& state) {
+    const Region screen(Rect(0, 0, 1080, 2340));
+    for (auto _ : state) {
+        Region region(screen);
+        for (const auto& bounds : kLayerBounds) {
+            region.subtractSelf(bounds);
+        }
+        benchmark::DoNotOptimize(region);
+    }
+}
+BENCHMARK(BM_regionSubtract);
+
+static void BM_regionIntersect(benchmark::State& state) {
+    Region complex;
+    for (size_t i = 0; i + 1 < kLayerBounds.size(); i++) {
+        complex.orSelf(kLayerBounds[i]);
+    }
+    for (auto _ : state) {
+        for (const auto& bounds : kLayerBounds) {
+            benchmark::DoNotOptimize(complex.intersect(bounds));
+        }
+    }
+}
+BENCHMARK(BM_regionIntersect);
+
+// The common case of operations on two simple rects, which do not need the
+// rasterizer at all.
+static void BM_regionRectIntersect(benchmark::State& state) {
+    const Region lhs(Rect(0, 0, 1080, 2340));
+    const Region rhs(Rect(40, 200, 1040, 620));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(lhs.intersect(rhs));
+    }
+}
+BENCHMARK(BM_regionRectIntersect);
+
+static void BM_regionTranslate(benchmark::State& state) {
+    Region complex;
+    for (const auto& bounds : kLayerBounds) {
+        complex.xorSelf(bounds);
+    }
+    for (auto _ : state) {
+        complex.translateSelf(1, -1);
+        benchmark::DoNotOptimize(complex);
+    }
+}
+BENCHMARK(BM_regionTranslate);
+
+} // namespace android
+
+BENCHMARK_MAIN();
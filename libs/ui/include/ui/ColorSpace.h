@@ -250,6 +250,8 @@ public:
     // axis is thus already flipped
     // The source color space must define its values in the domain [0..1]
     // The generated LUT transforms from gamma space to gamma space
+    // Small LUTs between color spaces with parametric transfer functions are
+    // cached, and large LUTs are generated on several threads
     static std::unique_ptr<float3[]> createLUT(uint32_t size, const ColorSpace& src,
                                                const ColorSpace& dst);
 
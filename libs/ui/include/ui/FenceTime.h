@@ -30,6 +30,7 @@
 namespace android {
 
 class FenceToFenceTimeMap;
+class FenceWatcher;
 
 // A wrapper around fence that only implements isValid and getSignalTime.
 // It automatically closes the fence in a thread-safe manner once the signal
@@ -115,10 +116,16 @@ public:
     void signalForTest(nsecs_t signalTime);
 
 private:
+    friend class FenceWatcher;
+
     // For tests only. If forceValidForTest is true, then getSignalTime will
     // never return SIGNAL_TIME_INVALID and isValid will always return true.
     FenceTime(const sp<Fence>& fence, bool forceValidForTest);
 
+    // Queries the Fence for its signal time and caches it if it is no longer
+    // pending. This is the system call getSignalTime() falls back to.
+    nsecs_t pollSignalTime();
+
     enum class State {
         VALID,
         INVALID,
@@ -133,6 +140,11 @@ private:
     mutable std::mutex mMutex;
     sp<Fence> mFence{Fence::NO_FENCE};
     std::atomic<nsecs_t> mSignalTime{Fence::SIGNAL_TIME_INVALID};
+
+    // Set while a FenceWatcher is waiting on the Fence. The watcher publishes
+    // mSignalTime as soon as the Fence signals, so getSignalTime() does not
+    // need to query the Fence itself in the meantime.
+    std::atomic<bool> mWatched{false};
 };
 
 // A queue of FenceTimes that are expected to signal in FIFO order.
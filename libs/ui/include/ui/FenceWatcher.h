@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <android-base/thread_annotations.h>
+#include <android-base/unique_fd.h>
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace android {
+
+class FenceTime;
+
+// Waits on FenceTimes from a dedicated thread and publishes their signal time
+// as soon as the underlying Fence signals. While a FenceTime is watched,
+// FenceTime::getSignalTime() returns the published value without querying the
+// Fence, so consumers that poll a pending fence every frame no longer make a
+// system call each time.
+//
+// Only weak references are held; a FenceTime destroyed before its Fence
+// signals is simply dropped.
+class FenceWatcher {
+public:
+    FenceWatcher();
+    ~FenceWatcher();
+
+    FenceWatcher(const FenceWatcher&) = delete;
+    FenceWatcher& operator=(const FenceWatcher&) = delete;
+
+    // Called from the watcher thread once the signal time of the FenceTime has
+    // been published, unless the FenceTime was destroyed first.
+    using SignalCallback = std::function<void()>;
+
+    // Returns false, leaving the FenceTime to be polled as before, if it has
+    // no pending Fence or cannot be watched. The callback is not called then.
+    bool watch(const std::shared_ptr<FenceTime>& fenceTime, SignalCallback callback = nullptr);
+
+private:
+    // Bounds the number of fds held open for fences that never signal.
+    static constexpr size_t MAX_WATCHED_FENCES = 256;
+
+    struct Entry {
+        base::unique_fd fd;
+        std::weak_ptr<FenceTime> fenceTime;
+        SignalCallback callback;
+    };
+
+    void threadMain();
+    void onFenceSignaled(int fd);
+    // Releases every watched FenceTime and refuses further watch() calls.
+    void unwatchAll();
+
+    base::unique_fd mEpollFd;
+    base::unique_fd mStopFd;
+
+    std::mutex mMutex;
+    std::unordered_map<int, Entry> mEntries GUARDED_BY(mMutex);
+    bool mStopped GUARDED_BY(mMutex) = false;
+
+    std::thread mThread;
+};
+
+} // namespace android
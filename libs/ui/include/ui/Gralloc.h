@@ -24,10 +24,36 @@
 #include <ui/Rect.h>
 #include <utils/StrongPointer.h>
 
+#include <optional>
 #include <string>
+#include <vector>
 
 namespace android {
 
+// Buffer metadata fetched in a single query by GrallocMapper::getBufferMetadata.
+struct BufferMetadata {
+    enum Field : uint32_t {
+        DATASPACE = 1 << 0,
+        BLEND_MODE = 1 << 1,
+        CROP = 1 << 2,
+        SMPTE2086 = 1 << 3,
+        CTA861_3 = 1 << 4,
+        SMPTE2094_40 = 1 << 5,
+    };
+
+    // The requested fields the mapper was able to fetch. Fields that are not set here hold
+    // their default values.
+    uint32_t validFields = 0;
+
+    ui::Dataspace dataspace = ui::Dataspace::UNKNOWN;
+    ui::BlendMode blendMode = ui::BlendMode::INVALID;
+    // Crop of the first plane.
+    Rect crop = Rect::INVALID_RECT;
+    std::optional<ui::Smpte2086> smpte2086;
+    std::optional<ui::Cta861_3> cta861_3;
+    std::optional<std::vector<uint8_t>> smpte2094_40;
+};
+
 // A wrapper to IMapper
 class GrallocMapper {
 public:
@@ -74,6 +100,20 @@ public:
     // owned by the caller
     virtual int unlock(buffer_handle_t bufferHandle) const = 0;
 
+    // flushLockedBuffer makes the CPU writes to a locked buffer visible to other users of the
+    // buffer without unlocking it. It returns a fence sync object (or -1) in outReleaseFence,
+    // owned by the caller. This is supported by gralloc 4.0+.
+    virtual status_t flushLockedBuffer(buffer_handle_t /*bufferHandle*/,
+                                       int* /*outReleaseFence*/) const {
+        return INVALID_OPERATION;
+    }
+
+    // rereadLockedBuffer makes the writes of other users of a locked buffer visible to the CPU
+    // without unlocking it. This is supported by gralloc 4.0+.
+    virtual status_t rereadLockedBuffer(buffer_handle_t /*bufferHandle*/) const {
+        return INVALID_OPERATION;
+    }
+
     // isSupported queries whether or not a buffer with the given width, height,
     // format, layer count, and usage can be allocated on the device.  If
     // *outSupported is set to true, a buffer with the given specifications may be successfully
@@ -179,6 +219,12 @@ public:
         return INVALID_OPERATION;
     }
 
+    // Fetches every field set in the BufferMetadata::Field mask into outMetadata. Fields
+    // the mapper does not support are left out of outMetadata->validFields rather than
+    // failing the whole query. The default implementation calls the individual getters.
+    virtual status_t getBufferMetadata(buffer_handle_t bufferHandle, uint32_t fields,
+                                       BufferMetadata* outMetadata) const;
+
     virtual status_t getDefaultPixelFormatFourCC(uint32_t /*width*/, uint32_t /*height*/,
                                                  PixelFormat /*format*/, uint32_t /*layerCount*/,
                                                  uint64_t /*usage*/,
@@ -64,6 +64,10 @@ public:
 
     int unlock(buffer_handle_t bufferHandle) const override;
 
+    status_t flushLockedBuffer(buffer_handle_t bufferHandle, int* outReleaseFence) const override;
+
+    status_t rereadLockedBuffer(buffer_handle_t bufferHandle) const override;
+
     status_t isSupported(uint32_t width, uint32_t height, PixelFormat format, uint32_t layerCount,
                          uint64_t usage, bool* outSupported) const override;
 
@@ -108,6 +112,8 @@ public:
                          std::optional<ui::Cta861_3>* outCta861_3) const override;
     status_t getSmpte2094_40(buffer_handle_t bufferHandle,
                              std::optional<std::vector<uint8_t>>* outSmpte2094_40) const override;
+    status_t getBufferMetadata(buffer_handle_t bufferHandle, uint32_t fields,
+                               BufferMetadata* outMetadata) const override;
 
     status_t getDefaultPixelFormatFourCC(uint32_t width, uint32_t height, PixelFormat format,
                                          uint32_t layerCount, uint64_t usage,
@@ -163,7 +169,7 @@ private:
     status_t get(
             buffer_handle_t bufferHandle,
             const android::hardware::graphics::mapper::V4_0::IMapper::MetadataType& metadataType,
-            DecodeFunction<T> decodeFunction, T* outMetadata) const;
+            DecodeFunction<T> decodeFunction, T* outMetadata, bool logUnsupported = true) const;
 
     template <class T>
     status_t getDefault(
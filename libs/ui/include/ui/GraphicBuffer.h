@@ -20,6 +20,8 @@
 #include <stdint.h>
 #include <sys/types.h>
 
+#include <atomic>
+#include <mutex>
 #include <string>
 #include <utility>
 #include <vector>
@@ -195,6 +197,15 @@ public:
             android_ycbcr *ycbcr, int fenceFd);
     status_t unlockAsync(int *fenceFd);
 
+    // Locks the whole buffer for CPU access and keeps it mapped until the buffer is freed, so
+    // that locking it repeatedly doesn't map and unmap it each time. Each lock waits for fenceFd
+    // and makes the writes of other users visible to the CPU, and each unlock makes the CPU
+    // writes visible to other users. The buffer must not be locked by the other lock functions
+    // while it is mapped. Mappers before gralloc 4.0 can't flush or reread a locked buffer, so
+    // with them the buffer is unlocked and locked again instead.
+    status_t lockPersistentAsync(uint64_t inUsage, void** vaddr, int fenceFd);
+    status_t unlockPersistentAsync(int* fenceFd);
+
     status_t isSupported(uint32_t inWidth, uint32_t inHeight, PixelFormat inFormat,
                          uint32_t inLayerCount, uint64_t inUsage, bool* outSupported) const;
 
@@ -251,6 +262,12 @@ private:
 
     void free_handle();
 
+    // Returns handle to the allocator, letting it recycle buffers that never left this process.
+    void releaseAllocatedHandle();
+
+    // Unlocks the buffer if it is mapped by lockPersistentAsync.
+    void unmapPersistentLocked();
+
     GraphicBufferMapper& mBufferMapper;
     ssize_t mInitCheck;
 
@@ -260,6 +277,15 @@ private:
 
     uint64_t mId;
 
+    // Set once the buffer has been flattened, after which other processes may hold on to its
+    // memory, so that it is not recycled by GraphicBufferAllocator when freed.
+    mutable std::atomic<bool> mShared{false};
+
+    // Usage and address of the mapping of lockPersistentAsync, if the buffer is mapped.
+    std::mutex mPersistentMappingMutex;
+    uint64_t mPersistentUsage = 0;
+    void* mPersistentVaddr = nullptr;
+
     // Stores the generation number of this buffer. If this number does not
     // match the BufferQueue's internal generation number (set through
     // IGBP::setGenerationNumber), attempts to attach the buffer will fail.
@@ -20,8 +20,10 @@
 
 #include <stdint.h>
 
+#include <deque>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include <cutils/native_handle.h>
 
@@ -31,6 +33,7 @@
 #include <utils/KeyedVector.h>
 #include <utils/Mutex.h>
 #include <utils/Singleton.h>
+#include <utils/Timers.h>
 
 namespace android {
 
@@ -72,6 +75,27 @@ public:
 
     status_t free(buffer_handle_t handle);
 
+    /**
+     * Like free(), but lets a later allocate() with the same size, format, layer count and usage
+     * reuse the buffer while the buffer pool is enabled, instead of going through the allocator
+     * HAL. The buffer must never have been shared with another process, since its memory is
+     * handed out again as is.
+     */
+    status_t recycle(buffer_handle_t handle);
+
+    /**
+     * Sets how much memory and how many buffers the pool may hold on to. A maxBytes of 0
+     * disables pooling and frees the pooled buffers. Pooling is disabled by default unless the
+     * debug.ui.buffer_pool_kb property is set.
+     */
+    void setPoolLimits(size_t maxBytes, size_t maxBuffers);
+
+    /**
+     * Frees pooled buffers, least recently recycled first, until the pool holds at most maxBytes.
+     * Meant to be called when the process is under memory pressure.
+     */
+    void trimPool(size_t maxBytes = 0);
+
     uint64_t getTotalSize() const;
 
     void dump(std::string& res, bool less = true) const;
@@ -87,15 +111,43 @@ protected:
         uint64_t usage;
         size_t size;
         std::string requestorName;
+        bool pooled = false;
+    };
+
+    struct pool_rec_t {
+        buffer_handle_t handle;
+        nsecs_t recycleTime;
+    };
+
+    struct pool_stats_t {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
     };
 
     status_t allocateHelper(uint32_t w, uint32_t h, PixelFormat format, uint32_t layerCount,
                             uint64_t usage, buffer_handle_t* handle, uint32_t* stride,
                             std::string requestorName, bool importBuffer);
 
+    // Takes a pooled buffer matching the given parameters out of the pool, if any.
+    bool takePooledBufferLocked(uint32_t width, uint32_t height, PixelFormat format,
+                                uint32_t layerCount, uint64_t usage, buffer_handle_t* handle,
+                                uint32_t* stride, std::string& requestorName);
+    // Removes pooled buffers that went idle or exceed maxBytes from the pool, and returns them
+    // so that they can be freed once sLock is released.
+    std::vector<buffer_handle_t> evictPooledBuffersLocked(nsecs_t now, size_t maxBytes);
+    void freeEvictedBuffers(const std::vector<buffer_handle_t>& handles);
+
     static Mutex sLock;
     static KeyedVector<buffer_handle_t, alloc_rec_t> sAllocList;
 
+    // Recycled buffers, least recently recycled first. The pool is guarded by sLock.
+    std::deque<pool_rec_t> mPool;
+    size_t mPoolBytes = 0;
+    size_t mPoolMaxBytes = 0;
+    size_t mPoolMaxBuffers = 0;
+    pool_stats_t mPoolStats;
+
     friend class Singleton<GraphicBufferAllocator>;
     GraphicBufferAllocator();
     ~GraphicBufferAllocator();
@@ -37,6 +37,7 @@ namespace android {
 // ---------------------------------------------------------------------------
 
 class GrallocMapper;
+struct BufferMetadata;
 
 class GraphicBufferMapper : public Singleton<GraphicBufferMapper>
 {
@@ -86,6 +87,14 @@ public:
 
     status_t unlockAsync(buffer_handle_t handle, int *fenceFd);
 
+    /**
+     * Flushes CPU writes to, or rereads, a locked buffer without unlocking it.
+     *
+     * These functions are supported by gralloc 4.0+.
+     */
+    status_t flushLockedBuffer(buffer_handle_t handle, int* fenceFd);
+    status_t rereadLockedBuffer(buffer_handle_t handle);
+
     status_t isSupported(uint32_t width, uint32_t height, android::PixelFormat format,
                          uint32_t layerCount, uint64_t usage, bool* outSupported);
 
@@ -127,6 +136,13 @@ public:
     status_t getSmpte2094_40(buffer_handle_t bufferHandle,
                              std::optional<std::vector<uint8_t>>* outSmpte2094_40);
 
+    /**
+     * Fetches the metadata selected by the BufferMetadata::Field mask in one call. Fields the
+     * allocator does not report are left out of outMetadata->validFields.
+     */
+    status_t getBufferMetadata(buffer_handle_t bufferHandle, uint32_t fields,
+                               BufferMetadata* outMetadata);
+
     /**
      * Gets the default metadata for a gralloc buffer allocated with the given parameters.
      *
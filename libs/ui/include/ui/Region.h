@@ -170,6 +170,12 @@ private:
     static void boolean_operation(uint32_t op, Region& dst,
             const Region& lhs, const Rect& rhs);
 
+    // Handles the boolean operations whose result follows from the bounds of
+    // the operands alone, without running the rasterizer. rhsRegion is null
+    // if the right hand side is the simple rect rhsBounds.
+    static bool trivial_boolean_operation(uint32_t op, Region& dst,
+            const Region& lhs, const Region* rhsRegion, const Rect& rhsBounds);
+
     static void translate(Region& reg, int dx, int dy);
     static void translate(Region& dst, const Region& reg, int dx, int dy);
 
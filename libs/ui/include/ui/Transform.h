@@ -84,6 +84,9 @@ public:
     Region  transform(const Region& reg) const;
     Rect    transform(const Rect& bounds,
                       bool roundOutwards = false) const;
+    // transforms |count| rects from |in| into |out|, which may alias |in|
+    void    transform(const Rect* in, Rect* out, size_t count,
+                      bool roundOutwards = false) const;
     FloatRect transform(const FloatRect& bounds) const;
     Transform& operator = (const Transform& other);
     Transform operator * (const Transform& rhs) const;
@@ -112,6 +115,10 @@ private:
     enum { UNKNOWN_TYPE = 0x80000000 };
 
     uint32_t type() const;
+    // true if the transform only flips and translates by whole pixels, in
+    // which case it maps the pixel grid onto itself
+    bool isIntegerFlip() const;
+    bool hasIntegerTranslation() const;
     static bool absIsOne(float f);
     static bool isZero(float f);
 
@@ -53,6 +53,11 @@ public:
                     allocate)
                 .WillOnce(DoAll(SetArgPointee<7>(stride), Return(err)));
     }
+    void setUpAllocateExpectations(status_t err, uint32_t stride, buffer_handle_t handle) {
+        EXPECT_CALL(*(reinterpret_cast<const mock::MockGrallocAllocator*>(mAllocator.get())),
+                    allocate)
+                .WillOnce(DoAll(SetArgPointee<7>(stride), SetArgPointee<8>(handle), Return(err)));
+    }
     std::unique_ptr<const GrallocAllocator>& getAllocator() { return mAllocator; }
 };
 
@@ -113,4 +118,33 @@ TEST_F(GraphicBufferAllocatorTest, AllocateLargeStride) {
     ASSERT_EQ(NO_ERROR, err);
     ASSERT_EQ(expectedStride, stride);
 }
+
+TEST_F(GraphicBufferAllocatorTest, AllocateReusesRecycledBuffer) {
+    android::PixelFormat format = PIXEL_FORMAT_RGBA_8888;
+    mAllocator.setPoolLimits(2 * kTestWidth * kTestHeight * bytesPerPixel(format), 2);
+
+    // The allocator HAL is only expected to be called once.
+    native_handle_t* fakeHandle = native_handle_create(0, 0);
+    mAllocator.setUpAllocateExpectations(NO_ERROR, kTestWidth, fakeHandle);
+    uint32_t stride = 0;
+    buffer_handle_t handle;
+    ASSERT_EQ(NO_ERROR,
+              mAllocator.allocate(kTestWidth, kTestHeight, format, kTestLayerCount, kTestUsage,
+                                  &handle, &stride, 0, "GraphicBufferAllocatorTest"));
+    ASSERT_EQ(fakeHandle, handle);
+    ASSERT_EQ(NO_ERROR, mAllocator.recycle(handle));
+
+    uint32_t recycledStride = 0;
+    buffer_handle_t recycledHandle;
+    ASSERT_EQ(NO_ERROR,
+              mAllocator.allocate(kTestWidth, kTestHeight, format, kTestLayerCount, kTestUsage,
+                                  &recycledHandle, &recycledStride, 0,
+                                  "GraphicBufferAllocatorTest"));
+    EXPECT_EQ(fakeHandle, recycledHandle);
+    EXPECT_EQ(stride, recycledStride);
+
+    std::string dump;
+    mAllocator.dump(dump);
+    EXPECT_NE(std::string::npos, dump.find("hits 1 misses 1 evictions 0")) << dump;
+}
 } // namespace android
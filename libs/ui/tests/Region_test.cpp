@@ -167,5 +167,97 @@ TEST_F(RegionTest, EqualsToSelf) {
     ASSERT_TRUE(touchableRegion.contains(50, 50));
 }
 
+TEST_F(RegionTest, SimpleRectOperations) {
+    const Region a(Rect(0, 0, 100, 100));
+    const Region b(Rect(50, 50, 150, 150));
+    const Region disjoint(Rect(200, 200, 300, 300));
+    const Region inner(Rect(10, 10, 20, 20));
+
+    EXPECT_TRUE(a.intersect(b).hasSameRects(Region(Rect(50, 50, 100, 100))));
+    EXPECT_TRUE(a.intersect(disjoint).isEmpty());
+    EXPECT_TRUE(a.intersect(inner).hasSameRects(inner));
+
+    EXPECT_TRUE(a.subtract(disjoint).hasSameRects(a));
+    EXPECT_TRUE(inner.subtract(a).isEmpty());
+    EXPECT_TRUE(a.subtract(Region()).hasSameRects(a));
+    EXPECT_TRUE(Region().subtract(a).isEmpty());
+
+    EXPECT_TRUE(a.merge(inner).hasSameRects(a));
+    EXPECT_TRUE(inner.merge(a).hasSameRects(a));
+    EXPECT_TRUE(Region().merge(a).hasSameRects(a));
+    EXPECT_TRUE(a.merge(Region()).hasSameRects(a));
+    EXPECT_TRUE(Region().merge(Region()).isEmpty());
+
+    // Operations which need the full rasterizer
+    const Region merged = a.merge(b);
+    EXPECT_EQ(3, merged.end() - merged.begin());
+    const Region subtracted = a.subtract(b);
+    EXPECT_EQ(2, subtracted.end() - subtracted.begin());
+}
+
+TEST_F(RegionTest, SelfOperationsMatchOperations) {
+    const Region a = Region(Rect(0, 0, 100, 100)).merge(Rect(100, 50, 200, 150));
+    const Rect rects[] = {Rect(0, 0, 0, 0),     Rect(0, 0, 200, 200),   Rect(10, 10, 20, 20),
+                          Rect(50, 25, 150, 75), Rect(300, 300, 400, 400), Rect(-10, -10, 5, 5)};
+
+    for (const auto& rect : rects) {
+        Region result(a);
+        result.andSelf(rect);
+        EXPECT_TRUE(result.hasSameRects(a.intersect(rect)));
+
+        result = a;
+        result.subtractSelf(rect);
+        EXPECT_TRUE(result.hasSameRects(a.subtract(rect)));
+
+        result = a;
+        result.orSelf(Region(rect));
+        EXPECT_TRUE(result.hasSameRects(a.merge(rect)));
+
+        // Check the results against the underlying geometry
+        for (int y = -20; y < 420; y += 5) {
+            for (int x = -20; x < 420; x += 5) {
+                const bool inA = a.contains(x, y);
+                const bool inRect = Region(rect).contains(x, y);
+                EXPECT_EQ(inA && inRect, a.intersect(rect).contains(x, y));
+                EXPECT_EQ(inA && !inRect, a.subtract(rect).contains(x, y));
+                EXPECT_EQ(inA || inRect, a.merge(rect).contains(x, y));
+            }
+        }
+    }
+}
+
+TEST_F(RegionTest, LargeRegionSelfOperations) {
+    // Enough rects to go past the scratch storage that is kept between calls
+    Region checkerboard;
+    for (int y = 0; y < 40; y++) {
+        for (int x = (y % 2); x < 40; x += 2) {
+            checkerboard.orSelf(Rect(x, y, x + 1, y + 1));
+        }
+    }
+    EXPECT_EQ(800, checkerboard.end() - checkerboard.begin());
+
+    Region inverse(Rect(0, 0, 40, 40));
+    inverse.subtractSelf(checkerboard);
+    EXPECT_EQ(800, inverse.end() - inverse.begin());
+    EXPECT_TRUE(inverse.intersect(checkerboard).isEmpty());
+
+    inverse.orSelf(checkerboard);
+    EXPECT_TRUE(inverse.hasSameRects(Region(Rect(0, 0, 40, 40))));
+
+    // Operations keep working once the scratch storage has been released
+    Region small(Rect(0, 0, 10, 10));
+    small.subtractSelf(Rect(0, 0, 5, 10));
+    EXPECT_TRUE(small.hasSameRects(Region(Rect(5, 0, 10, 10))));
+}
+
+TEST_F(RegionTest, TranslateOffsetsAllRects) {
+    Region r = Region(Rect(0, 0, 10, 10)).merge(Rect(20, 20, 30, 30));
+    r.translateSelf(5, -5);
+
+    Region expected = Region(Rect(5, -5, 15, 5)).merge(Rect(25, 15, 35, 25));
+    EXPECT_TRUE(r.hasSameRects(expected));
+    EXPECT_EQ(expected.getBounds(), r.getBounds());
+}
+
 }; // namespace android
 
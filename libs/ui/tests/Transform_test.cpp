@@ -0,0 +1,139 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <ui/Region.h>
+#include <ui/Transform.h>
+
+#include <gtest/gtest.h>
+
+namespace android::ui {
+
+namespace {
+
+const uint32_t kAllOrientations[] = {
+        Transform::ROT_0,  Transform::FLIP_H,  Transform::FLIP_V, Transform::ROT_180,
+        Transform::ROT_90, Transform::ROT_270, Transform::ROT_90 | Transform::FLIP_H,
+        Transform::ROT_90 | Transform::FLIP_V,
+};
+
+// Transforms all four corners of the rect, as done for arbitrary transforms.
+Rect transformCorners(const Transform& t, const Rect& r) {
+    const vec2 lt = t.transform(vec2(r.left, r.top));
+    const vec2 rt = t.transform(vec2(r.right, r.top));
+    const vec2 lb = t.transform(vec2(r.left, r.bottom));
+    const vec2 rb = t.transform(vec2(r.right, r.bottom));
+    return Rect(static_cast<int32_t>(floorf(std::min({lt[0], rt[0], lb[0], rb[0]}) + 0.5f)),
+                static_cast<int32_t>(floorf(std::min({lt[1], rt[1], lb[1], rb[1]}) + 0.5f)),
+                static_cast<int32_t>(floorf(std::max({lt[0], rt[0], lb[0], rb[0]}) + 0.5f)),
+                static_cast<int32_t>(floorf(std::max({lt[1], rt[1], lb[1], rb[1]}) + 0.5f)));
+}
+
+// Transforms the region one rect at a time.
+Region transformRects(const Transform& t, const Region& reg) {
+    Region out;
+    for (const Rect& r : reg) {
+        out.orSelf(t.transform(r));
+    }
+    return out;
+}
+
+Region makeRegion() {
+    Region reg(Rect(10, 10, 50, 20));
+    reg.orSelf(Rect(70, 10, 90, 40));
+    reg.orSelf(Rect(0, 30, 30, 60));
+    reg.orSelf(Rect(40, 50, 100, 55));
+    return reg;
+}
+
+} // namespace
+
+TEST(TransformTest, transformRectMatchesCorners) {
+    const Rect rects[] = {Rect(0, 0, 100, 200), Rect(-5, 7, 33, 41), Rect(3, 3, 3, 3)};
+    for (uint32_t orientation : kAllOrientations) {
+        Transform t(orientation, 1080, 1920);
+        Transform translate;
+        translate.set(12.5f, -7.0f);
+        Transform scale;
+        scale.set(0.5f, 0, 0, 1.5f);
+
+        for (const Transform& transform : {t, t * translate, t * scale}) {
+            for (const Rect& r : rects) {
+                EXPECT_EQ(transformCorners(transform, r), transform.transform(r));
+            }
+        }
+    }
+}
+
+TEST(TransformTest, transformRectIntegerTranslation) {
+    Transform t;
+    t.set(100.0f, -20.0f);
+    EXPECT_EQ(Rect(100, -10, 150, 40), t.transform(Rect(0, 10, 50, 60)));
+    EXPECT_EQ(Rect(100, -10, 150, 40), t.transform(Rect(0, 10, 50, 60), true));
+
+    // The corners of invalid rects are reordered.
+    EXPECT_EQ(Rect(99, -21, 100, -20), t.transform(Rect::INVALID_RECT));
+}
+
+TEST(TransformTest, transformRectArray) {
+    const Rect rects[] = {Rect(0, 0, 100, 200), Rect(-5, 7, 33, 41), Rect(3, 3, 3, 3)};
+    Transform translate;
+    translate.set(-3.0f, 4.0f);
+    for (const Transform& t : {Transform(), translate, Transform(Transform::ROT_90, 100, 200)}) {
+        Rect out[std::size(rects)];
+        t.transform(rects, out, std::size(rects));
+        for (size_t i = 0; i < std::size(rects); i++) {
+            EXPECT_EQ(t.transform(rects[i]), out[i]);
+        }
+    }
+}
+
+TEST(TransformTest, transformRegionMatchesRects) {
+    const Region reg = makeRegion();
+    for (uint32_t orientation : kAllOrientations) {
+        Transform t(orientation, 1080, 1920);
+        Transform translate;
+        translate.set(12.0f, -7.0f);
+        Transform scale;
+        scale.set(0.5f, 0, 0, 2.0f);
+
+        for (const Transform& transform : {t, translate * t, t * scale}) {
+            const Region expected = transformRects(transform, reg);
+            const Region actual = transform.transform(reg);
+            EXPECT_TRUE(expected.hasSameRects(actual))
+                    << "orientation " << orientation << " expected "
+                    << ::testing::PrintToString(expected) << " actual "
+                    << ::testing::PrintToString(actual);
+            EXPECT_EQ(expected.getBounds(), actual.getBounds());
+        }
+    }
+}
+
+TEST(TransformTest, multiplyTranslations) {
+    Transform a;
+    a.set(10.0f, 20.0f);
+    Transform b;
+    b.set(-10.0f, 5.0f);
+
+    const Transform ab = a * b;
+    EXPECT_EQ(static_cast<uint32_t>(Transform::TRANSLATE), ab.getType());
+    EXPECT_EQ(0.0f, ab.tx());
+    EXPECT_EQ(25.0f, ab.ty());
+
+    b.set(-10.0f, -20.0f);
+    EXPECT_EQ(static_cast<uint32_t>(Transform::IDENTITY), (a * b).getType());
+}
+
+} // namespace android::ui
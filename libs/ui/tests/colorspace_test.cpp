@@ -180,4 +180,39 @@ TEST_F(ColorSpaceTest, LUT) {
 
 }
 
+TEST_F(ColorSpaceTest, LUTMatchesConnector) {
+    // Cached and uncached color spaces, and a size generated on several threads
+    const std::pair<ColorSpace, ColorSpace> conversions[] = {
+            {ColorSpace::sRGB(), ColorSpace::ProPhotoRGB()},
+            {ColorSpace::extendedSRGB(), ColorSpace::DisplayP3()},
+            {ColorSpace::BT2020(), ColorSpace::DCIP3()},
+    };
+    const uint32_t size = 65;
+    const float m = 1.0f / float(size - 1);
+    for (const auto& [src, dst] : conversions) {
+        ColorSpaceConnector connector(src, dst);
+        auto lut = ColorSpace::createLUT(size, src, dst);
+        const float3* data = lut.get();
+        for (uint32_t z = 0; z < size; z++) {
+            for (int32_t y = int32_t(size - 1); y >= 0; y--) {
+                for (uint32_t x = 0; x < size; x++) {
+                    const float3 expected = connector.transform({x * m, y * m, z * m});
+                    ASSERT_TRUE(all(lessThan(abs(*data++ - expected), float3{1e-4f})));
+                }
+            }
+        }
+    }
+}
+
+TEST_F(ColorSpaceTest, LUTCached) {
+    auto lut = ColorSpace::createLUT(17, ColorSpace::DisplayP3(), ColorSpace::sRGB());
+    const float3 r = lut.get()[17 * 17 * 17 - 1];
+    lut.get()[17 * 17 * 17 - 1] = float3{0.0f};
+
+    // The cached LUT is returned as a copy
+    auto cached = ColorSpace::createLUT(17, ColorSpace::DisplayP3(), ColorSpace::sRGB());
+    EXPECT_NE(lut.get(), cached.get());
+    EXPECT_EQ(r, cached.get()[17 * 17 * 17 - 1]);
+}
+
 }; // namespace android
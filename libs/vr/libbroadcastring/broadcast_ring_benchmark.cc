@@ -0,0 +1,105 @@
+#include "libbroadcastring/broadcast_ring.h"
+
+#include <stdlib.h>
+#include <memory>
+
+#include <benchmark/benchmark.h>
+
+namespace android {
+namespace dvr {
+namespace {
+
+// Roughly the size of an IMU sample.
+struct alignas(8) Sample {
+  int64_t timestamp_ns;
+  float gyro[3];
+  float accel[3];
+  float mag[3];
+  uint32_t flags;
+  uint64_t padding[2];
+};
+
+struct BatchTraits : public DefaultRingTraits {
+  static constexpr uint32_t kMaxReservedRecords = 16;
+};
+
+using Ring = BroadcastRing<Sample, BatchTraits>;
+
+constexpr uint32_t kRecordCount = 256;
+
+struct RingMmap {
+  RingMmap() : data(new char[Ring::MemorySize(kRecordCount)]) {
+    ring = Ring::Create(data.get(), Ring::MemorySize(kRecordCount),
+                        kRecordCount);
+  }
+  std::unique_ptr<char[]> data;
+  Ring ring;
+};
+
+void BM_Put(benchmark::State& state) {
+  RingMmap mmap;
+  Sample sample = {};
+  for (auto _ : state) {
+    sample.timestamp_ns++;
+    mmap.ring.Put(sample);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Put);
+
+void BM_PutBatch(benchmark::State& state) {
+  const uint32_t batch_size = state.range(0);
+  RingMmap mmap;
+  Sample samples[BatchTraits::kMaxReservedRecords] = {};
+  for (auto _ : state) {
+    samples[0].timestamp_ns++;
+    mmap.ring.PutBatch(samples, batch_size);
+  }
+  state.SetItemsProcessed(state.iterations() * batch_size);
+}
+BENCHMARK(BM_PutBatch)->Arg(1)->Arg(4)->Arg(16);
+
+void BM_Get(benchmark::State& state) {
+  RingMmap mmap;
+  Sample samples[kRecordCount] = {};
+  for (auto _ : state) {
+    state.PauseTiming();
+    for (uint32_t i = 0; i < kRecordCount; i += BatchTraits::kMaxReservedRecords)
+      mmap.ring.PutBatch(&samples[i], BatchTraits::kMaxReservedRecords);
+    uint32_t sequence = mmap.ring.GetOldestSequence();
+    state.ResumeTiming();
+
+    Sample sample;
+    while (mmap.ring.Get(&sequence, &sample))
+      sequence++;
+    benchmark::DoNotOptimize(sample);
+  }
+  state.SetItemsProcessed(state.iterations() * kRecordCount);
+}
+BENCHMARK(BM_Get);
+
+void BM_GetBatch(benchmark::State& state) {
+  const uint32_t batch_size = state.range(0);
+  RingMmap mmap;
+  Sample samples[kRecordCount] = {};
+  for (auto _ : state) {
+    state.PauseTiming();
+    for (uint32_t i = 0; i < kRecordCount; i += BatchTraits::kMaxReservedRecords)
+      mmap.ring.PutBatch(&samples[i], BatchTraits::kMaxReservedRecords);
+    uint32_t sequence = mmap.ring.GetOldestSequence();
+    state.ResumeTiming();
+
+    while (uint32_t count =
+               mmap.ring.GetBatch(&sequence, samples, batch_size))
+      sequence += count;
+    benchmark::DoNotOptimize(samples);
+  }
+  state.SetItemsProcessed(state.iterations() * kRecordCount);
+}
+BENCHMARK(BM_GetBatch)->Arg(4)->Arg(16)->Arg(64);
+
+}  // namespace
+}  // namespace dvr
+}  // namespace android
+
+BENCHMARK_MAIN();
@@ -673,6 +673,71 @@ TEST(BroadcastRingTest, ShouldDieIfCreationMmapMisaligned) {
   }
 }
 
+TEST(BroadcastRingTest, PutBatchGetBatch) {
+  using Ring = Dynamic_16_NxM_5plus11::Ring;
+  using Record = Ring::Record;
+  constexpr uint32_t kBatchSize = Ring::Traits::kMaxReservedRecords;
+  Ring ring;
+  auto mmap = CreateRing(&ring, Ring::Traits::MinCount());
+
+  uint32_t sequence = ring.GetNextSequence();
+  Record records[kBatchSize];
+  EXPECT_EQ(0U, ring.GetBatch(&sequence, records, kBatchSize));
+
+  // Write enough batches to wrap the ring several times.
+  for (uint32_t batch = 0; batch < 10; ++batch) {
+    const uint32_t first = batch * kBatchSize;
+    for (uint32_t i = 0; i < kBatchSize; ++i)
+      records[i] = Record(FillChar(first + i));
+    ring.PutBatch(records, kBatchSize);
+    EXPECT_EQ(sequence + kBatchSize, ring.GetNextSequence());
+
+    // Read the batch back in two parts.
+    Record in_records[kBatchSize];
+    EXPECT_EQ(2U, ring.GetBatch(&sequence, in_records, 2));
+    EXPECT_EQ(Record(FillChar(first)), in_records[0]);
+    EXPECT_EQ(Record(FillChar(first + 1)), in_records[1]);
+    sequence += 2;
+
+    EXPECT_EQ(kBatchSize - 2, ring.GetBatch(&sequence, in_records, kBatchSize));
+    for (uint32_t i = 0; i < kBatchSize - 2; ++i)
+      EXPECT_EQ(Record(FillChar(first + 2 + i)), in_records[i]);
+    sequence += kBatchSize - 2;
+
+    EXPECT_EQ(0U, ring.GetBatch(&sequence, in_records, kBatchSize));
+  }
+}
+
+TEST(BroadcastRingTest, GetBatchSkipsToOldestRecord) {
+  using Ring = Dynamic_16_NxM_5plus11::Ring;
+  using Record = Ring::Record;
+  constexpr uint32_t kBatchSize = Ring::Traits::kMaxReservedRecords;
+  Ring ring;
+  auto mmap = CreateRing(&ring, Ring::Traits::MinCount());
+
+  uint32_t sequence = ring.GetNextSequence();
+  const uint32_t kRecordCount = 4 * ring.record_count();
+  uint32_t written = 0;
+  while (written < kRecordCount) {
+    Record records[kBatchSize];
+    for (uint32_t j = 0; j < kBatchSize; ++j)
+      records[j] = Record(FillChar(written + j));
+    ring.PutBatch(records, kBatchSize);
+    written += kBatchSize;
+  }
+
+  // Only the newest records are still available.
+  std::unique_ptr<Record[]> in_records(new Record[kRecordCount]);
+  const uint32_t count =
+      ring.GetBatch(&sequence, in_records.get(), kRecordCount);
+  EXPECT_LE(count, ring.record_count());
+  EXPECT_EQ(ring.GetOldestSequence(), sequence);
+  EXPECT_EQ(ring.GetNextSequence(), sequence + count);
+  const uint32_t first = written - count;
+  for (uint32_t i = 0; i < count; ++i)
+    EXPECT_EQ(Record(FillChar(first + i)), in_records[i]);
+}
+
 template <typename Ring>
 std::unique_ptr<std::thread> CopyTask(std::atomic<bool>* quit, void* in_base,
                                       size_t in_size, void* out_base,
@@ -854,6 +919,58 @@ void ThreadedOverwriteTorture() {
   }
 }
 
+template <typename Ring>
+std::unique_ptr<std::thread> CheckBatchFillTask(std::atomic<bool>* quit,
+                                                void* in_base, size_t in_size) {
+  return std::unique_ptr<std::thread>(
+      new std::thread([quit, in_base, in_size]() {
+        using Record = typename Ring::Record;
+        constexpr uint32_t kBatchSize = Ring::Traits::kMaxReservedRecords;
+
+        bool import_ok;
+        Ring in_ring;
+        std::tie(in_ring, import_ok) = Ring::Import(in_base, in_size);
+        ASSERT_TRUE(import_ok);
+
+        uint32_t sequence = in_ring.GetOldestSequence();
+        while (!std::atomic_load_explicit(quit, std::memory_order_relaxed)) {
+          Record records[kBatchSize];
+          const uint32_t count =
+              in_ring.GetBatch(&sequence, records, kBatchSize);
+          for (uint32_t i = 0; i < count; ++i)
+            ASSERT_EQ(Record(records[i].v[0]), records[i]);
+          sequence += count;
+        }
+      }));
+}
+
+TEST(BroadcastRingTest, ThreadedBatchOverwriteTorture) {
+  using Ring = TraitsDynamic<Sized<64>, false, 4, 0>::Ring;
+  using Record = Ring::Record;
+  constexpr uint32_t kBatchSize = Ring::Traits::kMaxReservedRecords;
+
+  // Maximize overwrites by having few records.
+  for (uint32_t count = kBatchSize; count <= 4 * kBatchSize; count *= 2) {
+    Ring out_ring;
+    auto out_mmap = CreateRing(&out_ring, count);
+
+    std::atomic<bool> quit(false);
+    std::unique_ptr<std::thread> check_task =
+        CheckBatchFillTask<Ring>(&quit, out_mmap.mmap(), out_mmap.size);
+
+    constexpr int kIterations = 10000;
+    for (int i = 0; i < kIterations; ++i) {
+      Record records[kBatchSize];
+      for (uint32_t j = 0; j < kBatchSize; ++j)
+        records[j] = Record(FillChar(i * kBatchSize + j));
+      out_ring.PutBatch(records, kBatchSize);
+    }
+
+    std::atomic_store_explicit(&quit, true, std::memory_order_relaxed);
+    check_task->join();
+  }
+}
+
 TEST(BroadcastRingTest, ThreadedOverwriteTortureSmall) {
   ThreadedOverwriteTorture<Dynamic_16_NxM_1plus0::Ring>();
 }
@@ -4,6 +4,7 @@
 #include <inttypes.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <algorithm>
 #include <atomic>
 #include <limits>
 #include <tuple>
@@ -58,7 +59,9 @@ struct DefaultRingTraits {
 // between successive puts than it takes to read one record from memory to
 // ensure Get() completes quickly. This requirement should not be difficult to
 // achieve for most practical uses; 4kB puts at 10,000Hz is well below the
-// scaling limit on current mobile chips.
+// scaling limit on current mobile chips. High-rate streams can instead batch
+// several records per PutBatch() call, up to Traits::kMaxReservedRecords, and
+// read them back with GetBatch().
 //
 // Example Writer Usage:
 //
@@ -265,6 +268,21 @@ class BroadcastRing {
     Publish(kRecordCount);
   }
 
+  // Writes |count| consecutive records to the ring.
+  //
+  // |count| must not exceed Traits::kMaxReservedRecords. The oldest records are
+  // overwritten as needed. The whole batch is reserved and published with a
+  // single update of each sequence number, rather than one per record.
+  void PutBatch(const Record* records, uint32_t count) {
+    Reserve(count);
+    Geometry geometry = GetGeometry();
+    for (uint32_t i = 0; i < count; ++i) {
+      uint32_t index = SequenceToIndex(geometry.tail + i, geometry.record_count);
+      PutRecordInternal(&records[i], record_mmap_writer(index));
+    }
+    Publish(count);
+  }
+
   // Gets sequence number of the oldest currently available record.
   uint32_t GetOldestSequence() const {
     return std::atomic_load_explicit(&header_mmap()->head,
@@ -355,6 +373,64 @@ class BroadcastRing {
     }
   }
 
+  // Copies up to |max_count| consecutive records, starting with the oldest
+  // available record with sequence at least |*sequence|, to |records|.
+  //
+  // Returns the number of records copied, which is zero if there is no recent
+  // enough record available.
+  //
+  // Updates |*sequence| with the sequence number of the first record returned.
+  // To get the records following the batch, increment this number by the
+  // returned count.
+  //
+  // Synchronizes with Put() and PutBatch() in the same way as Get(), checking
+  // |tail| and |head| once for the whole batch. Records that were overwritten
+  // while being copied are dropped from the front of the batch.
+  uint32_t GetBatch(uint32_t* sequence /*inout*/, Record* records /*out*/,
+                    uint32_t max_count) const {
+    for (;;) {
+      uint32_t tail = std::atomic_load_explicit(&header_mmap()->tail,
+                                                std::memory_order_acquire);
+      uint32_t head = std::atomic_load_explicit(&header_mmap()->head,
+                                                std::memory_order_relaxed);
+
+      if (tail - head > record_count())
+        continue;  // Concurrent modification; re-try.
+
+      if (*sequence - head > tail - head)
+        *sequence = head;  // Out of window, skip forward to first available.
+
+      if (*sequence == tail || max_count == 0)
+        return 0;  // No new records available.
+
+      uint32_t count = std::min(max_count, tail - *sequence);
+      for (uint32_t i = 0; i < count; ++i) {
+        uint32_t index = SequenceToIndex(*sequence + i, record_count());
+        GetRecordInternal(record_mmap_reader(index), &records[i]);
+      }
+
+      // NB: It is not sufficient to change this to a load-acquire of |head|.
+      std::atomic_thread_fence(std::memory_order_acquire);
+
+      uint32_t final_head = std::atomic_load_explicit(
+          &header_mmap()->head, std::memory_order_relaxed);
+
+      if (final_head - head > *sequence - head) {
+        // Records before |final_head| may have been concurrently modified, but
+        // the ones from |final_head| on are intact (see Get()).
+        uint32_t skipped = final_head - *sequence;
+        if (skipped >= count)
+          continue;  // Concurrent modification of the whole batch; re-try.
+
+        count -= skipped;
+        std::move(records + skipped, records + skipped + count, records);
+        *sequence = final_head;
+      }
+
+      return count;
+    }
+  }
+
   // Copies the newest available record with sequence at least |*sequence| to
   // |record|.
   //
@@ -229,6 +229,17 @@ Status<void> BufferHubQueue::HandleBufferEvent(size_t slot, int event_fd,
       id(), buffers_[slot]->id(), slot, event_fd, poll_events, events);
 
   if (events & EPOLLIN) {
+    // The buffer may already have been picked up from its shared state by
+    // ScanBufferStates(), in which case this event is stale.
+    if (ready_from_buffer_state_ &&
+        (available_slots_.test(slot) ||
+         !IsBufferReady(buffers_[slot].get()))) {
+      ALOGD_IF(TRACE,
+               "BufferHubQueue::HandleBufferEvent: Ignoring stale event: "
+               "slot=%zu buffer_id=%d",
+               slot, buffers_[slot]->id());
+      return {};
+    }
     return Enqueue({buffers_[slot], slot, buffers_[slot]->GetQueueIndex()});
   } else if (events & EPOLLHUP) {
     ALOGW(
@@ -329,6 +340,7 @@ Status<void> BufferHubQueue::RemoveBuffer(size_t slot) {
       on_buffer_removed_(buffers_[slot]);
 
     buffers_[slot] = nullptr;
+    available_slots_.reset(slot);
     capacity_--;
   }
 
@@ -346,6 +358,7 @@ Status<void> BufferHubQueue::Enqueue(Entry entry) {
       unavailable_buffers_slot_.erase(enqueued_buffer_iter);
     }
 
+    available_slots_.set(entry.slot);
     available_buffers_.push(std::move(entry));
 
     // Trigger OnBufferAvailable callback if registered.
@@ -365,6 +378,9 @@ Status<std::shared_ptr<BufferHubBase>> BufferHubQueue::Dequeue(int timeout,
 
   PDX_TRACE_FORMAT("%s|count=%zu|", __FUNCTION__, count());
 
+  if (count() == 0 && ready_from_buffer_state_)
+    ScanBufferStates();
+
   if (count() == 0) {
     if (!WaitForBuffers(timeout))
       return ErrorStatus(ETIMEDOUT);
@@ -378,11 +394,25 @@ Status<std::shared_ptr<BufferHubBase>> BufferHubQueue::Dequeue(int timeout,
   *slot = entry.slot;
 
   available_buffers_.pop();
+  available_slots_.reset(*slot);
   unavailable_buffers_slot_.push_back(*slot);
 
   return {std::move(buffer)};
 }
 
+void BufferHubQueue::ScanBufferStates() {
+  ATRACE_NAME("BufferHubQueue::ScanBufferStates");
+  for (size_t slot = 0; slot < kMaxQueueCapacity; slot++) {
+    if (!buffers_[slot] || available_slots_.test(slot) ||
+        !IsBufferReady(buffers_[slot].get()))
+      continue;
+
+    PDX_TRACE_FORMAT("buffer|queue_id=%d;buffer_id=%d;slot=%zu|", id(),
+                     buffers_[slot]->id(), slot);
+    Enqueue({buffers_[slot], slot, buffers_[slot]->GetQueueIndex()});
+  }
+}
+
 void BufferHubQueue::SetBufferAvailableCallback(
     BufferAvailableCallback callback) {
   on_buffer_available_ = callback;
@@ -396,6 +426,7 @@ pdx::Status<void> BufferHubQueue::FreeAllBuffers() {
   // Clear all available buffers.
   while (!available_buffers_.empty())
     available_buffers_.pop();
+  available_slots_.reset();
 
   pdx::Status<void> last_error;  // No error.
   // Clear all buffers this producer queue is tracking.
@@ -680,6 +711,8 @@ std::unique_ptr<ConsumerQueue> ConsumerQueue::Import(
 
 ConsumerQueue::ConsumerQueue(LocalChannelHandle handle)
     : BufferHubQueue(std::move(handle)) {
+  ready_from_buffer_state_ = true;
+
   auto status = ImportQueue();
   if (!status) {
     ALOGE("%s: Failed to import queue: %s", __FUNCTION__,
@@ -751,6 +784,11 @@ Status<void> ConsumerQueue::AddBuffer(
   return BufferHubQueue::AddBuffer(buffer, slot);
 }
 
+bool ConsumerQueue::IsBufferReady(BufferHubBase* buffer) {
+  return BufferHubDefs::isClientPosted(buffer->buffer_state(),
+                                       buffer->client_state_mask());
+}
+
 Status<std::shared_ptr<ConsumerBuffer>> ConsumerQueue::Dequeue(
     int timeout, size_t* slot, void* meta, size_t user_metadata_size,
     LocalHandle* acquire_fence) {
@@ -23,6 +23,7 @@
 #pragma clang diagnostic pop
 #endif
 
+#include <bitset>
 #include <memory>
 #include <queue>
 #include <vector>
@@ -165,6 +166,10 @@ class BufferHubQueue : public pdx::Client {
   // Waits for buffers to become available and adds them to the available queue.
   bool WaitForBuffers(int timeout);
 
+  // Adds buffers whose shared buffer state shows them ready for dequeue to the
+  // available queue, without waiting for their buffer events.
+  void ScanBufferStates();
+
   pdx::Status<void> HandleBufferEvent(size_t slot, int event_fd,
                                       int poll_events);
   pdx::Status<void> HandleQueueEvent(int poll_events);
@@ -206,6 +211,16 @@ class BufferHubQueue : public pdx::Client {
   // Called when a buffer is allocated remotely.
   virtual pdx::Status<void> OnBufferAllocated() { return {}; }
 
+  // Returns whether |buffer| is ready to be dequeued according to the buffer
+  // state it shares with bufferhubd. Only consulted when
+  // |ready_from_buffer_state_| is set.
+  virtual bool IsBufferReady(BufferHubBase* /*buffer*/) { return false; }
+
+  // Whether buffer readiness can be read from the shared buffer state. When
+  // set, Dequeue() looks for ready buffers there before waiting on the buffer
+  // event fds, which remain as the blocking fallback.
+  bool ready_from_buffer_state_{false};
+
   // Size of the metadata that buffers in this queue cary.
   size_t user_metadata_size_{0};
 
@@ -264,6 +279,9 @@ class BufferHubQueue : public pdx::Client {
   // Keeps track with how many buffers have been added into the queue.
   size_t capacity_{0};
 
+  // Slots of the buffers that are currently in |available_buffers_|.
+  std::bitset<kMaxQueueCapacity> available_slots_;
+
   // Epoll fd used to manage buffer events.
   EpollFileDescriptor epoll_fd_;
 
@@ -468,6 +486,9 @@ class ConsumerQueue : public BufferHubQueue {
                               size_t slot);
 
   pdx::Status<void> OnBufferAllocated() override;
+
+  // A consumer buffer is ready once it is posted to this consumer.
+  bool IsBufferReady(BufferHubBase* buffer) override;
 };
 
 }  // namespace dvr
@@ -124,6 +124,36 @@ TEST_F(BufferHubQueueTest, TestDequeue) {
   }
 }
 
+TEST_F(BufferHubQueueTest, TestConsumerDequeueFromBufferState) {
+  ASSERT_TRUE(CreateQueues(config_builder_.Build(), UsagePolicy{}));
+  AllocateBuffer();
+
+  size_t slot;
+  LocalHandle fence;
+  DvrNativeBufferMetadata mi, mo;
+
+  auto p1_status = producer_queue_->Dequeue(kTimeoutMs, &slot, &mo, &fence);
+  ASSERT_TRUE(p1_status.ok());
+  auto p1 = p1_status.take();
+  ASSERT_NE(p1, nullptr);
+  EXPECT_EQ(p1->PostAsync(&mi, LocalHandle()), 0);
+
+  // The posted buffer is visible through its shared state right away, so the
+  // consumer does not need to wait for the buffer event.
+  auto c1_status = consumer_queue_->Dequeue(0, &slot, &mo, &fence);
+  ASSERT_TRUE(c1_status.ok()) << c1_status.GetErrorMessage();
+  auto c1 = c1_status.take();
+  ASSERT_NE(c1, nullptr);
+
+  // The buffer event that follows is stale and must not make the acquired
+  // buffer available again.
+  EXPECT_FALSE(consumer_queue_->HandleQueueEvents());
+  EXPECT_EQ(consumer_queue_->count(), 0U);
+  EXPECT_FALSE(consumer_queue_->Dequeue(0, &slot, &mo, &fence).ok());
+
+  EXPECT_EQ(c1->ReleaseAsync(&mi, LocalHandle()), 0);
+}
+
 TEST_F(BufferHubQueueTest,
        TestDequeuePostedBufferIfNoAvailableReleasedBuffer_withConsumerBuffer) {
   ASSERT_TRUE(CreateQueues(config_builder_.Build(), UsagePolicy{}));
@@ -3,6 +3,7 @@
 #include <time.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <chrono>
 #include <iomanip>
 #include <iostream>
@@ -150,6 +151,29 @@ std::chrono::nanoseconds DeserializeTestRunner(
   return stop - start;
 }
 
+// Version of DeserializeTestRunner for wrappers over const data, which point
+// into the input buffer instead of copying the data out of it. Wrapper is the
+// type to deserialize into and |value| is what is serialized.
+template <typename Wrapper, typename T>
+std::chrono::nanoseconds DeserializeInPlaceTestRunner(
+    MessageReader* reader, MessageWriter* writer, size_t iterations,
+    ResetFunc* read_reset, ResetFunc* write_reset, void* reset_data,
+    const T& value) {
+  write_reset(reset_data);
+  Serialize(value, writer);
+  Wrapper output_data;
+  auto start = std::chrono::high_resolution_clock::now();
+  for (size_t i = 0; i < iterations; i++) {
+    read_reset(reset_data);
+    Deserialize(&output_data, reader);
+  }
+  auto stop = std::chrono::high_resolution_clock::now();
+  if (!std::equal(output_data.begin(), output_data.end(), value.begin(),
+                  value.end()))
+    return start - stop;  // Return negative value to indicate error.
+  return stop - start;
+}
+
 // Special version of SerializeTestRunner that doesn't perform any serialization
 // but does all the same setup steps and moves data of size |data_size| into
 // the output buffer. Useful to determine the baseline to calculate time used
@@ -487,6 +511,30 @@ int main(int /*argc*/, char** /*argv*/) {
                                 data_buffers.back().size()));
   }
 
+  // Deserializing into wrappers over const data avoids copying the payload;
+  // compare with string(10240) above.
+  for (size_t len : {256, 10240}) {
+    std::string string_value(len, '*');
+    const size_t data_size = GetSerializedSize(string_value);
+    test_runner.AddTestFunc(
+        GenerateContainerName("StringWrapper<const char>", len), {},
+        std::bind(&DeserializeInPlaceTestRunner<StringWrapper<const char>,
+                                                std::string>,
+                  _1, _2, _3, _4, _5, _6, std::move(string_value)),
+        data_size);
+  }
+  for (size_t len : {256, 10240}) {
+    BufferWrapper<std::vector<uint8_t>> buffer_value{std::vector<uint8_t>(len)};
+    const size_t data_size = GetSerializedSize(buffer_value);
+    test_runner.AddTestFunc(
+        GenerateContainerName("BufferWrapper<const uint8_t*>", len), {},
+        std::bind(&DeserializeInPlaceTestRunner<
+                      BufferWrapper<const uint8_t*>,
+                      BufferWrapper<std::vector<uint8_t>>>,
+                  _1, _2, _3, _4, _5, _6, std::move(buffer_value)),
+        data_size);
+  }
+
   // Various backing buffers to run the tests on.
   std::vector<TestRunner::BufferInfo> buffers;
 
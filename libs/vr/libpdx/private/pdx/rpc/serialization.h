@@ -1397,11 +1397,17 @@ inline ErrorType DeserializeObject(BufferWrapper<std::vector<T, Allocator>>*,
 template <typename T>
 inline ErrorType DeserializeObject(BufferWrapper<T*>*, MessageReader*,
                                    const void*&, const void*&);
+template <typename T>
+inline ErrorType DeserializeObject(BufferWrapper<const T*>*, MessageReader*,
+                                   const void*&, const void*&);
 inline ErrorType DeserializeObject(std::string*, MessageReader*, const void*&,
                                    const void*&);
 template <typename T>
 inline ErrorType DeserializeObject(StringWrapper<T>*, MessageReader*,
                                    const void*&, const void*&);
+template <typename T>
+inline ErrorType DeserializeObject(StringWrapper<const T>*, MessageReader*,
+                                   const void*&, const void*&);
 template <typename T, typename U>
 inline ErrorType DeserializeObject(std::pair<T, U>*, MessageReader*,
                                    const void*&, const void*&);
@@ -1609,6 +1615,35 @@ inline ErrorType DeserializeObject(BufferWrapper<T*>* value,
   }
 }
 
+// Overload of DeserializeObject() for BufferWrapper types over const data.
+// Instead of copying the payload, the wrapper is pointed at it in the input
+// buffer, so the result is only valid as long as the message being read is.
+template <typename T>
+inline ErrorType DeserializeObject(BufferWrapper<const T*>* value,
+                                   MessageReader* reader, const void*& start,
+                                   const void*& end) {
+  // Payloads follow their headers unaligned.
+  static_assert(alignof(T) == 1,
+                "Only byte-aligned types can be deserialized in place.");
+  EncodingType encoding;
+  std::size_t size;
+
+  if (const auto error =
+          DeserializeBinType(&encoding, &size, reader, start, end))
+    return error;
+
+  if (size % sizeof(T) != 0) {
+    return ErrorCode::UNEXPECTED_TYPE_SIZE;
+  } else if (PDX_UNLIKELY(AdvancePointer(start, size) > end)) {
+    return ErrorCode::INSUFFICIENT_BUFFER;
+  } else {
+    *value = BufferWrapper<const T*>(static_cast<const T*>(start),
+                                     size / sizeof(T));
+    start = AdvancePointer(start, size);
+    return ErrorCode::NO_ERROR;
+  }
+}
+
 // Deserializes the type code and size for string types.
 inline ErrorType DeserializeStringType(EncodingType* encoding,
                                        std::size_t* size, MessageReader* reader,
@@ -1674,6 +1709,34 @@ inline ErrorType DeserializeObject(StringWrapper<T>* value,
   }
 }
 
+// Overload of DeserializeObject() for StringWrapper types over const data.
+// Like BufferWrapper<const T*>, the wrapper is pointed at the string in the
+// input buffer instead of copying it.
+template <typename T>
+inline ErrorType DeserializeObject(StringWrapper<const T>* value,
+                                   MessageReader* reader, const void*& start,
+                                   const void*& end) {
+  static_assert(alignof(T) == 1,
+                "Only byte-aligned types can be deserialized in place.");
+  EncodingType encoding;
+  std::size_t size;
+
+  if (const auto error =
+          DeserializeStringType(&encoding, &size, reader, start, end))
+    return error;
+
+  if (size % sizeof(T) != 0) {
+    return ErrorCode::UNEXPECTED_TYPE_SIZE;
+  } else if (PDX_UNLIKELY(AdvancePointer(start, size) > end)) {
+    return ErrorCode::INSUFFICIENT_BUFFER;
+  } else {
+    *value = StringWrapper<const T>(static_cast<const T*>(start),
+                                    size / sizeof(T));
+    start = AdvancePointer(start, size);
+    return ErrorCode::NO_ERROR;
+  }
+}
+
 // Deserializes the type code and size of array types.
 inline ErrorType DeserializeArrayType(EncodingType* encoding, std::size_t* size,
                                       MessageReader* reader, const void*& start,
@@ -1991,6 +1991,58 @@ TEST(DeserializationTest, string) {
   EXPECT_EQ(std::string(0x10000, 'x'), result);
 }
 
+TEST(DeserializationTest, StringWrapperInPlace) {
+  Payload buffer;
+  StringWrapper<const char> result;
+  ErrorType error;
+
+  // Min FIXSTR.
+  buffer = {ENCODING_TYPE_FIXSTR_MIN};
+  error = Deserialize(&result, &buffer);
+  EXPECT_EQ(ErrorCode::NO_ERROR, error);
+  EXPECT_EQ(0U, result.size());
+
+  // Max STR8. The result points at the string in the buffer.
+  buffer = {ENCODING_TYPE_STR8, 0xff};
+  buffer.Append(0xff, 'x');
+  error = Deserialize(&result, &buffer);
+  EXPECT_EQ(ErrorCode::NO_ERROR, error);
+  EXPECT_EQ(std::string(0xff, 'x'), std::string(result.begin(), result.end()));
+  EXPECT_EQ(buffer.Data() + 2, reinterpret_cast<const std::uint8_t*>(result.data()));
+
+  // STR8 with fewer bytes than its size.
+  buffer = {ENCODING_TYPE_STR8, 0x02, 'x'};
+  error = Deserialize(&result, &buffer);
+  EXPECT_EQ(ErrorCode::INSUFFICIENT_BUFFER, error);
+}
+
+TEST(DeserializationTest, BufferWrapperInPlace) {
+  Payload buffer;
+  BufferWrapper<const std::uint8_t*> result;
+  ErrorType error;
+
+  // Min BIN8.
+  buffer = {ENCODING_TYPE_BIN8, 0x00};
+  error = Deserialize(&result, &buffer);
+  EXPECT_EQ(ErrorCode::NO_ERROR, error);
+  EXPECT_EQ(0U, result.size());
+
+  // Min BIN16 with max BIN8 + 1 bytes. The result points at the data in the
+  // buffer.
+  buffer = {ENCODING_TYPE_BIN16, 0x00, 0x01};
+  buffer.Append(0x100, 1);
+  error = Deserialize(&result, &buffer);
+  EXPECT_EQ(ErrorCode::NO_ERROR, error);
+  EXPECT_EQ(std::vector<std::uint8_t>(0x100, 1),
+            std::vector<std::uint8_t>(result.begin(), result.end()));
+  EXPECT_EQ(buffer.Data() + 3, result.data());
+
+  // BIN8 with fewer bytes than its size.
+  buffer = {ENCODING_TYPE_BIN8, 0x02, 1};
+  error = Deserialize(&result, &buffer);
+  EXPECT_EQ(ErrorCode::INSUFFICIENT_BUFFER, error);
+}
+
 TEST(DeserializationTest, vector) {
   Payload buffer;
   std::vector<std::uint8_t, DefaultInitializationAllocator<std::uint8_t>>
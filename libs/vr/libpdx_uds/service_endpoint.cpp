@@ -645,11 +645,12 @@ Status<void> Endpoint::MessageReply(Message* message, int return_code) {
 
   state->response.ret_code = return_code;
   state->response.recv_len = state->response_data.size();
-  auto status = SendData(channel_socket, state->response);
-  if (status && !state->response_data.empty()) {
-    status = SendData(channel_socket, state->response_data.data(),
-                      state->response_data.size());
-  }
+  // Send the reply data along with the header in a single sendmsg() call.
+  iovec response_vec = {state->response_data.data(),
+                        state->response_data.size()};
+  auto status = SendData(channel_socket, state->response,
+                         state->response_data.empty() ? nullptr : &response_vec,
+                         state->response_data.empty() ? 0 : 1);
 
   if (status)
     status = ReenableEpollEvent(channel_socket);
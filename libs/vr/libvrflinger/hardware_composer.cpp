@@ -61,6 +61,10 @@ constexpr int kBootFinishedDisplayOffTimeoutSec = 10;
 constexpr int kDefaultDisplayWidth = 1920;
 constexpr int kDefaultDisplayHeight = 1080;
 constexpr int64_t kDefaultVsyncPeriodNs = 16666667;
+
+// Max number of vsync periods a hardware vsync timestamp may be behind the
+// predicted display time and still be used to align the prediction.
+constexpr int64_t kMaxDisplayTimeAlignmentPeriods = 4;
 // Hardware composer reports dpi as dots per thousand inches (dpi * 1000).
 constexpr int kDefaultDpi = 400000;
 
@@ -715,6 +719,31 @@ Status<int64_t> HardwareComposer::WaitForPredictedVSync() {
   return {predicted_vsync_time};
 }
 
+int64_t HardwareComposer::PredictDisplayTime(int64_t vsync_timestamp) {
+  const int64_t vsync_period_ns = target_display_->vsync_period_ns;
+  const int64_t predicted_ns = vsync_timestamp + vsync_period_ns;
+
+  // The timer-based prediction only catches up with hardware vsync once per
+  // frame, after the frame is posted. Snap the estimate to the hardware vsync
+  // grid so the frame post offset is measured from the real vsync phase. Old
+  // hardware timestamps are not trusted, since period errors accumulate.
+  auto status = composer_callback_->GetVsyncTime(target_display_->id);
+  if (!status)
+    return predicted_ns;
+
+  const int64_t hardware_vsync_ns = status.get();
+  const int64_t periods =
+      (predicted_ns - hardware_vsync_ns + vsync_period_ns / 2) /
+      vsync_period_ns;
+  if (hardware_vsync_ns <= 0 || periods <= 0 ||
+      periods > kMaxDisplayTimeAlignmentPeriods)
+    return predicted_ns;
+
+  const int64_t aligned_ns = hardware_vsync_ns + periods * vsync_period_ns;
+  ATRACE_INT64("display_time_correction_ns", aligned_ns - predicted_ns);
+  return aligned_ns;
+}
+
 int HardwareComposer::SleepUntil(int64_t wakeup_timestamp) {
   const int timer_fd = vsync_sleep_timer_fd_.Get();
   const itimerspec wakeup_itimerspec = {
@@ -909,8 +938,7 @@ void HardwareComposer::PostThread() {
       // Sleep until shortly before vsync.
       ATRACE_NAME("sleep");
 
-      const int64_t display_time_est_ns =
-          vsync_timestamp + target_display_->vsync_period_ns;
+      const int64_t display_time_est_ns = PredictDisplayTime(vsync_timestamp);
       const int64_t now_ns = GetSystemClockNs();
       const int64_t sleep_time_ns = display_time_est_ns - now_ns -
                                     post_thread_config_.frame_post_offset_ns;
@@ -451,6 +451,11 @@ class HardwareComposer {
   pdx::Status<int64_t> WaitForPredictedVSync();
   int SleepUntil(int64_t wakeup_timestamp);
 
+  // Returns the estimated time of the vsync after |vsync_timestamp|, at which
+  // the frame posted next will be displayed, aligned to the phase of the most
+  // recent hardware vsync when one is available.
+  int64_t PredictDisplayTime(int64_t vsync_timestamp);
+
   // Initialize any newly connected displays, and set target_display_ to the
   // display we should render to. Returns true if target_display_
   // changed. Called only from the post thread.
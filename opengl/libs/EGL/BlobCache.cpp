@@ -21,9 +21,13 @@
 #include <errno.h>
 #include <inttypes.h>
 
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
 #include <android-base/properties.h>
 #include <log/log.h>
-#include <chrono>
 
 namespace android {
 
@@ -40,20 +44,22 @@ BlobCache::BlobCache(size_t maxKeySize, size_t maxValueSize, size_t maxTotalSize
         mMaxTotalSize(maxTotalSize),
         mMaxKeySize(maxKeySize),
         mMaxValueSize(maxValueSize),
-        mTotalSize(0) {
-    int64_t now = std::chrono::steady_clock::now().time_since_epoch().count();
-#ifdef _WIN32
-    srand(now);
-#else
-    mRandState[0] = (now >> 0) & 0xFFFF;
-    mRandState[1] = (now >> 16) & 0xFFFF;
-    mRandState[2] = (now >> 32) & 0xFFFF;
-#endif
-    ALOGV("initializing random seed using %lld", (unsigned long long)now);
+        mTotalSize(0),
+        mUseCounter(0) {
 }
 
 void BlobCache::set(const void* key, size_t keySize, const void* value,
         size_t valueSize) {
+    setEntry(key, keySize, value, valueSize, /*persisted*/ false);
+}
+
+void BlobCache::setPersisted(const void* key, size_t keySize, const void* value,
+        size_t valueSize) {
+    setEntry(key, keySize, value, valueSize, /*persisted*/ true);
+}
+
+void BlobCache::setEntry(const void* key, size_t keySize, const void* value,
+        size_t valueSize, bool persisted) {
     if (mMaxKeySize < keySize) {
         ALOGV("set: not caching because the key is too large: %zu (limit: %zu)",
                 keySize, mMaxKeySize);
@@ -78,17 +84,16 @@ void BlobCache::set(const void* key, size_t keySize, const void* value,
         return;
     }
 
-    std::shared_ptr<Blob> dummyKey(new Blob(key, keySize, false));
-    CacheEntry dummyEntry(dummyKey, nullptr);
+    const std::string_view keyView(static_cast<const char*>(key), keySize);
+    Shard& shard = getShard(keyView);
 
     while (true) {
-        auto index = std::lower_bound(mCacheEntries.begin(), mCacheEntries.end(), dummyEntry);
-        if (index == mCacheEntries.end() || dummyEntry < *index) {
+        std::unique_lock<std::shared_mutex> lock(shard.mMutex);
+        auto index = shard.mEntries.find(keyView);
+        if (index == shard.mEntries.end()) {
             // Create a new cache entry.
-            std::shared_ptr<Blob> keyBlob(new Blob(key, keySize, true));
-            std::shared_ptr<Blob> valueBlob(new Blob(value, valueSize, true));
-            size_t newTotalSize = mTotalSize + keySize + valueSize;
-            if (mMaxTotalSize < newTotalSize) {
+            if (!reserveSize(keySize + valueSize)) {
+                lock.unlock();
                 if (isCleanable()) {
                     // Clean the cache and try again.
                     clean();
@@ -101,29 +106,35 @@ void BlobCache::set(const void* key, size_t keySize, const void* value,
                     break;
                 }
             }
-            mCacheEntries.insert(index, CacheEntry(keyBlob, valueBlob));
-            mTotalSize = newTotalSize;
+            auto entry = std::make_unique<CacheEntry>(key, keySize, value, valueSize, persisted);
+            entry->mLastUse.store(nextUse(), std::memory_order_relaxed);
+            const std::string_view entryKey(entry->mKey);
+            shard.mEntries.emplace(entryKey, std::move(entry));
             ALOGV("set: created new cache entry with %zu byte key and %zu byte value",
                     keySize, valueSize);
         } else {
             // Update the existing cache entry.
-            std::shared_ptr<Blob> valueBlob(new Blob(value, valueSize, true));
-            std::shared_ptr<Blob> oldValueBlob(index->getValue());
-            size_t newTotalSize = mTotalSize + valueSize - oldValueBlob->getSize();
-            if (mMaxTotalSize < newTotalSize) {
-                if (isCleanable()) {
-                    // Clean the cache and try again.
-                    clean();
-                    continue;
-                } else {
-                    ALOGV("set: not caching new value because the total cache "
-                            "size limit would be exceeded: %zu (limit: %zu)",
-                            keySize + valueSize, mMaxTotalSize);
-                    break;
+            CacheEntry& entry = *index->second;
+            const size_t oldValueSize = entry.mValue.size();
+            if (valueSize > oldValueSize) {
+                if (!reserveSize(valueSize - oldValueSize)) {
+                    lock.unlock();
+                    if (isCleanable()) {
+                        // Clean the cache and try again.
+                        clean();
+                        continue;
+                    } else {
+                        ALOGV("set: not caching new value because the total cache "
+                                "size limit would be exceeded: %zu (limit: %zu)",
+                                keySize + valueSize, mMaxTotalSize);
+                        break;
+                    }
                 }
+            } else {
+                mTotalSize -= oldValueSize - valueSize;
             }
-            index->setValue(valueBlob);
-            mTotalSize = newTotalSize;
+            entry.setValue(value, valueSize, persisted);
+            entry.mLastUse.store(nextUse(), std::memory_order_relaxed);
             ALOGV("set: updated existing cache entry with %zu byte key and %zu byte "
                     "value", keySize, valueSize);
         }
@@ -138,21 +149,26 @@ size_t BlobCache::get(const void* key, size_t keySize, void* value,
                 keySize, mMaxKeySize);
         return 0;
     }
-    std::shared_ptr<Blob> dummyKey(new Blob(key, keySize, false));
-    CacheEntry dummyEntry(dummyKey, nullptr);
-    auto index = std::lower_bound(mCacheEntries.begin(), mCacheEntries.end(), dummyEntry);
-    if (index == mCacheEntries.end() || dummyEntry < *index) {
+    const std::string_view keyView(static_cast<const char*>(key), keySize);
+    Shard& shard = getShard(keyView);
+
+    // Lookups only need the shard lock in shared mode, so they don't wait for
+    // each other.
+    std::shared_lock<std::shared_mutex> lock(shard.mMutex);
+    auto index = shard.mEntries.find(keyView);
+    if (index == shard.mEntries.end()) {
         ALOGV("get: no cache entry found for key of size %zu", keySize);
         return 0;
     }
 
     // The key was found. Return the value if the caller's buffer is large
     // enough.
-    std::shared_ptr<Blob> valueBlob(index->getValue());
-    size_t valueBlobSize = valueBlob->getSize();
+    CacheEntry& entry = *index->second;
+    entry.mLastUse.store(nextUse(), std::memory_order_relaxed);
+    size_t valueBlobSize = entry.mValue.size();
     if (valueBlobSize <= valueSize) {
         ALOGV("get: copying %zu bytes to caller's buffer", valueBlobSize);
-        memcpy(value, valueBlob->getData(), valueBlobSize);
+        memcpy(value, entry.mValue.data(), valueBlobSize);
     } else {
         ALOGV("get: caller's buffer is too small for value: %zu (needs %zu)",
                 valueSize, valueBlobSize);
@@ -160,6 +176,16 @@ size_t BlobCache::get(const void* key, size_t keySize, void* value,
     return valueBlobSize;
 }
 
+void BlobCache::clear() {
+    for (Shard& shard : mShards) {
+        std::unique_lock<std::shared_mutex> lock(shard.mMutex);
+        for (const auto& [key, entry] : shard.mEntries) {
+            mTotalSize -= entry->getSize();
+        }
+        shard.mEntries.clear();
+    }
+}
+
 static inline size_t align4(size_t size) {
     return (size + 3) & ~3;
 }
@@ -167,10 +193,11 @@ static inline size_t align4(size_t size) {
 size_t BlobCache::getFlattenedSize() const {
     auto buildId = base::GetProperty("ro.build.id", "");
     size_t size = align4(sizeof(Header) + buildId.size());
-    for (const CacheEntry& e :  mCacheEntries) {
-        std::shared_ptr<Blob> const& keyBlob = e.getKey();
-        std::shared_ptr<Blob> const& valueBlob = e.getValue();
-        size += align4(sizeof(EntryHeader) + keyBlob->getSize() + valueBlob->getSize());
+    for (const Shard& shard : mShards) {
+        std::shared_lock<std::shared_mutex> lock(shard.mMutex);
+        for (const auto& [key, entry] : shard.mEntries) {
+            size += align4(sizeof(EntryHeader) + entry->getSize());
+        }
     }
     return size;
 }
@@ -185,7 +212,7 @@ int BlobCache::flatten(void* buffer, size_t size) const {
     header->mMagicNumber = blobCacheMagic;
     header->mBlobCacheVersion = blobCacheVersion;
     header->mDeviceVersion = blobCacheDeviceVersion;
-    header->mNumEntries = mCacheEntries.size();
+    header->mNumEntries = 0;
     auto buildId = base::GetProperty("ro.build.id", "");
     header->mBuildIdLength = buildId.size();
     memcpy(header->mBuildId, buildId.c_str(), header->mBuildIdLength);
@@ -193,41 +220,45 @@ int BlobCache::flatten(void* buffer, size_t size) const {
     // Write cache entries
     uint8_t* byteBuffer = reinterpret_cast<uint8_t*>(buffer);
     off_t byteOffset = align4(sizeof(Header) + header->mBuildIdLength);
-    for (const CacheEntry& e :  mCacheEntries) {
-        std::shared_ptr<Blob> const& keyBlob = e.getKey();
-        std::shared_ptr<Blob> const& valueBlob = e.getValue();
-        size_t keySize = keyBlob->getSize();
-        size_t valueSize = valueBlob->getSize();
+    size_t numEntries = 0;
+    for (const Shard& shard : mShards) {
+        std::shared_lock<std::shared_mutex> lock(shard.mMutex);
+        for (const auto& [key, entry] : shard.mEntries) {
+            size_t keySize = entry->mKey.size();
+            size_t valueSize = entry->mValue.size();
+
+            size_t entrySize = sizeof(EntryHeader) + keySize + valueSize;
+            size_t totalSize = align4(entrySize);
+            if (byteOffset + totalSize > size) {
+                ALOGE("flatten: not enough room for cache entries");
+                return -EINVAL;
+            }
 
-        size_t entrySize = sizeof(EntryHeader) + keySize + valueSize;
-        size_t totalSize = align4(entrySize);
-        if (byteOffset + totalSize > size) {
-            ALOGE("flatten: not enough room for cache entries");
-            return -EINVAL;
-        }
+            EntryHeader* eheader = reinterpret_cast<EntryHeader*>(&byteBuffer[byteOffset]);
+            eheader->mKeySize = keySize;
+            eheader->mValueSize = valueSize;
 
-        EntryHeader* eheader = reinterpret_cast<EntryHeader*>(&byteBuffer[byteOffset]);
-        eheader->mKeySize = keySize;
-        eheader->mValueSize = valueSize;
+            memcpy(eheader->mData, entry->mKey.data(), keySize);
+            memcpy(eheader->mData + keySize, entry->mValue.data(), valueSize);
 
-        memcpy(eheader->mData, keyBlob->getData(), keySize);
-        memcpy(eheader->mData + keySize, valueBlob->getData(), valueSize);
+            if (totalSize > entrySize) {
+                // We have padding bytes. Those will get written to storage, and contribute to the
+                // CRC, so make sure we zero-them to have reproducible results.
+                memset(eheader->mData + keySize + valueSize, 0, totalSize - entrySize);
+            }
 
-        if (totalSize > entrySize) {
-            // We have padding bytes. Those will get written to storage, and contribute to the CRC,
-            // so make sure we zero-them to have reproducible results.
-            memset(eheader->mData + keySize + valueSize, 0, totalSize - entrySize);
+            byteOffset += totalSize;
+            numEntries++;
         }
-
-        byteOffset += totalSize;
     }
+    header->mNumEntries = numEntries;
 
     return 0;
 }
 
 int BlobCache::unflatten(void const* buffer, size_t size) {
     // All errors should result in the BlobCache being in an empty state.
-    mCacheEntries.clear();
+    clear();
 
     // Read the cache header
     if (size < sizeof(Header)) {
@@ -254,7 +285,7 @@ int BlobCache::unflatten(void const* buffer, size_t size) {
     size_t numEntries = header->mNumEntries;
     for (size_t i = 0; i < numEntries; i++) {
         if (byteOffset + sizeof(EntryHeader) > size) {
-            mCacheEntries.clear();
+            clear();
             ALOGE("unflatten: not enough room for cache entry headers");
             return -EINVAL;
         }
@@ -267,7 +298,7 @@ int BlobCache::unflatten(void const* buffer, size_t size) {
 
         size_t totalSize = align4(entrySize);
         if (byteOffset + totalSize > size) {
-            mCacheEntries.clear();
+            clear();
             ALOGE("unflatten: not enough room for cache entry headers");
             return -EINVAL;
         }
@@ -281,22 +312,55 @@ int BlobCache::unflatten(void const* buffer, size_t size) {
     return 0;
 }
 
-long int BlobCache::blob_random() {
-#ifdef _WIN32
-    return rand();
-#else
-    return nrand48(mRandState);
-#endif
+bool BlobCache::reserveSize(size_t size) {
+    size_t totalSize = mTotalSize.load();
+    do {
+        if (mMaxTotalSize < totalSize + size) {
+            return false;
+        }
+    } while (!mTotalSize.compare_exchange_weak(totalSize, totalSize + size));
+    return true;
+}
+
+BlobCache::Shard& BlobCache::getShard(std::string_view key) {
+    return mShards[std::hash<std::string_view>()(key) % kNumShards];
 }
 
 void BlobCache::clean() {
-    // Remove a random cache entry until the total cache size gets below half
-    // the maximum total cache size.
-    while (mTotalSize > mMaxTotalSize / 2) {
-        size_t i = size_t(blob_random() % (mCacheEntries.size()));
-        const CacheEntry& entry(mCacheEntries[i]);
-        mTotalSize -= entry.getKey()->getSize() + entry.getValue()->getSize();
-        mCacheEntries.erase(mCacheEntries.begin() + i);
+    std::lock_guard<std::mutex> cleanLock(mCleanMutex);
+    std::array<std::unique_lock<std::shared_mutex>, kNumShards> locks;
+    for (size_t i = 0; i < kNumShards; i++) {
+        locks[i] = std::unique_lock<std::shared_mutex>(mShards[i].mMutex);
+    }
+    // Another thread may have cleaned the cache while this one was waiting.
+    if (!isCleanable()) {
+        return;
+    }
+
+    struct Candidate {
+        uint64_t lastUse;
+        size_t shard;
+        std::string_view key;
+    };
+    std::vector<Candidate> candidates;
+    for (size_t i = 0; i < kNumShards; i++) {
+        for (const auto& [key, entry] : mShards[i].mEntries) {
+            candidates.push_back({entry->mLastUse.load(std::memory_order_relaxed), i, key});
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(),
+              [](const Candidate& lhs, const Candidate& rhs) { return lhs.lastUse < rhs.lastUse; });
+
+    // Remove the least recently used entries until the total cache size gets
+    // below half the maximum total cache size.
+    for (const Candidate& candidate : candidates) {
+        if (mTotalSize <= mMaxTotalSize / 2) {
+            break;
+        }
+        auto& entries = mShards[candidate.shard].mEntries;
+        auto index = entries.find(candidate.key);
+        mTotalSize -= index->second->getSize();
+        entries.erase(index);
     }
 }
 
@@ -304,71 +368,40 @@ bool BlobCache::isCleanable() const {
     return mTotalSize > mMaxTotalSize / 2;
 }
 
-BlobCache::Blob::Blob(const void* data, size_t size, bool copyData) :
-        mData(copyData ? malloc(size) : data),
-        mSize(size),
-        mOwnsData(copyData) {
-    if (data != nullptr && copyData) {
-        memcpy(const_cast<void*>(mData), data, size);
+std::vector<BlobCache::Entry> BlobCache::takeEntriesToPersist(bool all) {
+    std::vector<Entry> entries;
+    for (Shard& shard : mShards) {
+        std::unique_lock<std::shared_mutex> lock(shard.mMutex);
+        for (const auto& [key, entry] : shard.mEntries) {
+            if (all || !entry->mPersisted) {
+                entries.push_back({std::string(entry->mKey), std::string(entry->mValue)});
+                entry->mPersisted = true;
+            }
+        }
     }
+    return entries;
 }
 
-BlobCache::Blob::~Blob() {
-    if (mOwnsData) {
-        free(const_cast<void*>(mData));
+BlobCache::CacheEntry::CacheEntry(const void* key, size_t keySize, const void* value,
+        size_t valueSize, bool persisted) {
+    if (persisted) {
+        mKey = std::string_view(static_cast<const char*>(key), keySize);
+    } else {
+        mOwnedKey.assign(static_cast<const char*>(key), keySize);
+        mKey = mOwnedKey;
     }
+    setValue(value, valueSize, persisted);
 }
 
-bool BlobCache::Blob::operator<(const Blob& rhs) const {
-    if (mSize == rhs.mSize) {
-        return memcmp(mData, rhs.mData, mSize) < 0;
+void BlobCache::CacheEntry::setValue(const void* value, size_t valueSize, bool persisted) {
+    if (persisted) {
+        std::string().swap(mOwnedValue);
+        mValue = std::string_view(static_cast<const char*>(value), valueSize);
     } else {
-        return mSize < rhs.mSize;
+        mOwnedValue.assign(static_cast<const char*>(value), valueSize);
+        mValue = mOwnedValue;
     }
-}
-
-const void* BlobCache::Blob::getData() const {
-    return mData;
-}
-
-size_t BlobCache::Blob::getSize() const {
-    return mSize;
-}
-
-BlobCache::CacheEntry::CacheEntry() {
-}
-
-BlobCache::CacheEntry::CacheEntry(
-        const std::shared_ptr<Blob>& key, const std::shared_ptr<Blob>& value):
-        mKey(key),
-        mValue(value) {
-}
-
-BlobCache::CacheEntry::CacheEntry(const CacheEntry& ce):
-        mKey(ce.mKey),
-        mValue(ce.mValue) {
-}
-
-bool BlobCache::CacheEntry::operator<(const CacheEntry& rhs) const {
-    return *mKey < *rhs.mKey;
-}
-
-const BlobCache::CacheEntry& BlobCache::CacheEntry::operator=(const CacheEntry& rhs) {
-    mKey = rhs.mKey;
-    mValue = rhs.mValue;
-    return *this;
-}
-
-std::shared_ptr<BlobCache::Blob> BlobCache::CacheEntry::getKey() const {
-    return mKey;
-}
-
-std::shared_ptr<BlobCache::Blob> BlobCache::CacheEntry::getValue() const {
-    return mValue;
-}
-
-void BlobCache::CacheEntry::setValue(const std::shared_ptr<Blob>& value) {
-    mValue = value;
+    mPersisted = persisted;
 }
 
 } // namespace android
@@ -19,13 +19,22 @@
 
 #include <stddef.h>
 
+#include <array>
+#include <atomic>
 #include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 namespace android {
 
 // A BlobCache is an in-memory cache for binary key/value pairs.  A BlobCache
-// does NOT provide any thread-safety guarantees.
+// may be used from several threads at once.  Entries are spread over shards
+// with their own lock, so that lookups of different keys never wait for each
+// other, and lookups in the same shard only wait for a set.
 //
 // The cache contents can be serialized to an in-memory buffer or mmap'd file
 // and then reloaded in a subsequent execution of the program.  This
@@ -83,7 +92,9 @@ public:
     // flatten serializes the current contents of the cache into the memory
     // pointed to by 'buffer'.  The serialized cache contents can later be
     // loaded into a BlobCache object using the unflatten method.  The contents
-    // of the BlobCache object will not be modified.
+    // of the BlobCache object will not be modified.  If entries were added
+    // since getFlattenedSize was called, -EINVAL may be returned and the size
+    // should be queried again.
     //
     // Preconditions:
     //   size >= this.getFlattenedSize()
@@ -99,9 +110,26 @@ public:
 
     // clear flushes out all contents of the cache then the BlobCache, leaving
     // it in an empty state.
-    void clear() { mCacheEntries.clear(); }
+    void clear();
 
 protected:
+    // An Entry is a copy of a key/value pair, as returned by takeEntriesToPersist.
+    struct Entry {
+        std::string key;
+        std::string value;
+    };
+
+    // setPersisted is like set, except that the key and value are not copied
+    // and must stay valid for the lifetime of the BlobCache.  This lets a
+    // subclass serve entries from a mapped file.  The entry is considered
+    // already persisted.
+    void setPersisted(const void* key, size_t keySize, const void* value, size_t valueSize);
+
+    // takeEntriesToPersist returns a copy of every entry which was set since
+    // it was last returned, or of every entry if all is true, and marks them
+    // as persisted.
+    std::vector<Entry> takeEntriesToPersist(bool all);
+
     // mMaxTotalSize is the maximum size that all cache entries can occupy. This
     // includes space for both keys and values. When a call to BlobCache::set
     // would otherwise cause this limit to be exceeded, either the key/value
@@ -114,10 +142,7 @@ private:
     BlobCache(const BlobCache&);
     void operator=(const BlobCache&);
 
-    // A random function helper to get around MinGW not having nrand48()
-    long int blob_random();
-
-    // clean evicts a randomly chosen set of entries from the cache such that
+    // clean evicts the least recently used entries from the cache such that
     // the total size of all remaining entries is less than mMaxTotalSize/2.
     void clean();
 
@@ -125,56 +150,45 @@ private:
     // to have some effect, and false otherwise.
     bool isCleanable() const;
 
-    // A Blob is an immutable sized unstructured data blob.
-    class Blob {
-    public:
-        Blob(const void* data, size_t size, bool copyData);
-        ~Blob();
-
-        bool operator<(const Blob& rhs) const;
-
-        const void* getData() const;
-        size_t getSize() const;
-
-    private:
-        // Copying is not allowed.
-        Blob(const Blob&);
-        void operator=(const Blob&);
-
-        // mData points to the buffer containing the blob data.
-        const void* mData;
-
-        // mSize is the size of the blob data in bytes.
-        size_t mSize;
-
-        // mOwnsData indicates whether or not this Blob object should free the
-        // memory pointed to by mData when the Blob gets destructed.
-        bool mOwnsData;
+    // setEntry implements set and setPersisted.
+    void setEntry(const void* key, size_t keySize, const void* value, size_t valueSize,
+            bool persisted);
+
+    // reserveSize adds size to mTotalSize and returns true, unless that would
+    // exceed mMaxTotalSize.
+    bool reserveSize(size_t size);
+
+    // A CacheEntry is a single key/value pair in the cache.  mLastUse is the
+    // value of mUseCounter when the entry was last set or read, and is updated
+    // by readers holding the shard lock in shared mode.
+    struct CacheEntry {
+        CacheEntry(const void* key, size_t keySize, const void* value, size_t valueSize,
+                bool persisted);
+
+        size_t getSize() const { return mKey.size() + mValue.size(); }
+        void setValue(const void* value, size_t valueSize, bool persisted);
+
+        // mKey and mValue point either into mOwnedKey and mOwnedValue, or into
+        // memory passed to setPersisted.
+        std::string mOwnedKey;
+        std::string mOwnedValue;
+        std::string_view mKey;
+        std::string_view mValue;
+        std::atomic<uint64_t> mLastUse{0};
+        bool mPersisted;
     };
 
-    // A CacheEntry is a single key/value pair in the cache.
-    class CacheEntry {
-    public:
-        CacheEntry();
-        CacheEntry(const std::shared_ptr<Blob>& key, const std::shared_ptr<Blob>& value);
-        CacheEntry(const CacheEntry& ce);
-
-        bool operator<(const CacheEntry& rhs) const;
-        const CacheEntry& operator=(const CacheEntry&);
-
-        std::shared_ptr<Blob> getKey() const;
-        std::shared_ptr<Blob> getValue() const;
-
-        void setValue(const std::shared_ptr<Blob>& value);
-
-    private:
+    // A Shard holds the entries whose key hashes to it.  The map keys point
+    // into the CacheEntry they map to.
+    struct Shard {
+        mutable std::shared_mutex mMutex;
+        std::unordered_map<std::string_view, std::unique_ptr<CacheEntry>> mEntries;
+    };
 
-        // mKey is the key that identifies the cache entry.
-        std::shared_ptr<Blob> mKey;
+    static constexpr size_t kNumShards = 16;
 
-        // mValue is the cached data associated with the key.
-        std::shared_ptr<Blob> mValue;
-    };
+    Shard& getShard(std::string_view key);
+    uint64_t nextUse() { return mUseCounter.fetch_add(1, std::memory_order_relaxed) + 1; }
 
     // A Header is the header for the entire BlobCache serialization format. No
     // need to make this portable, so we simply write the struct out.
@@ -233,16 +247,20 @@ private:
     const size_t mMaxValueSize;
 
     // mTotalSize is the total combined size of all keys and values currently in
-    // the cache.
-    size_t mTotalSize;
+    // the cache.  It is reserved by set before an entry is added, so that
+    // concurrent sets never exceed mMaxTotalSize.
+    std::atomic<size_t> mTotalSize;
+
+    // mUseCounter orders the uses of entries, for LRU eviction.
+    std::atomic<uint64_t> mUseCounter;
 
-    // mRandState is the pseudo-random number generator state. It is passed to
-    // nrand48 to generate random numbers when needed.
-    unsigned short mRandState[3];
+    // mCleanMutex prevents concurrent calls to clean, which takes the lock of
+    // every shard.
+    std::mutex mCleanMutex;
 
-    // mCacheEntries stores all the cache entries that are resident in memory.
-    // Cache entries are added to it by the 'set' method.
-    std::vector<CacheEntry> mCacheEntries;
+    // mShards stores all the cache entries that are resident in memory.
+    // Cache entries are added to them by the 'set' method.
+    std::array<Shard, kNumShards> mShards;
 };
 
 }
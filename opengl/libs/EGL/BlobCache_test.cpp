@@ -18,6 +18,8 @@
 #include <stdio.h>
 
 #include <memory>
+#include <thread>
+#include <vector>
 
 #include <gtest/gtest.h>
 
@@ -267,6 +269,64 @@ TEST_F(BlobCacheTest, ExceedingTotalLimitHalvesCacheSize) {
     ASSERT_EQ(maxEntries/2 + 1, numCached);
 }
 
+TEST_F(BlobCacheTest, ExceedingTotalLimitEvictsLeastRecentlyUsed) {
+    // Fill up the entire cache with 1 char key/value pairs.
+    const int maxEntries = MAX_TOTAL_SIZE / 2;
+    for (int i = 0; i < maxEntries; i++) {
+        uint8_t k = i;
+        mBC->set(&k, 1, "x", 1);
+    }
+    // Use the first entry, so that it becomes the most recently used.
+    {
+        uint8_t k = 0;
+        ASSERT_EQ(size_t(1), mBC->get(&k, 1, nullptr, 0));
+    }
+    // Insert one more entry, causing a cache overflow.
+    {
+        uint8_t k = maxEntries;
+        mBC->set(&k, 1, "x", 1);
+    }
+    // The entries used last are the ones left.
+    for (int i = 0; i < maxEntries+1; i++) {
+        uint8_t k = i;
+        bool expectCached = i == 0 || i >= maxEntries - maxEntries/2 + 1;
+        ASSERT_EQ(expectCached ? size_t(1) : size_t(0), mBC->get(&k, 1, nullptr, 0)) << i;
+    }
+}
+
+TEST_F(BlobCacheTest, ConcurrentSetsAndGetsDontExceedTotalLimit) {
+    constexpr int kNumThreads = 8;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kNumThreads; t++) {
+        threads.emplace_back([this, t]() {
+            for (int i = 0; i < 1000; i++) {
+                uint8_t k[2] = {static_cast<uint8_t>(t), static_cast<uint8_t>(i)};
+                uint8_t v = static_cast<uint8_t>(i);
+                mBC->set(k, sizeof(k), &v, 1);
+                uint8_t value = 0xee;
+                if (mBC->get(k, sizeof(k), &value, 1) == 1) {
+                    ASSERT_EQ(v, value);
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    size_t cachedSize = 0;
+    for (int t = 0; t < kNumThreads; t++) {
+        for (int i = 0; i < 256; i++) {
+            uint8_t k[2] = {static_cast<uint8_t>(t), static_cast<uint8_t>(i)};
+            size_t valueSize = mBC->get(k, sizeof(k), nullptr, 0);
+            if (valueSize > 0) {
+                cachedSize += sizeof(k) + valueSize;
+            }
+        }
+    }
+    ASSERT_GE(size_t(MAX_TOTAL_SIZE), cachedSize);
+}
+
 class BlobCacheFlattenTest : public BlobCacheTest {
 protected:
     virtual void SetUp() {
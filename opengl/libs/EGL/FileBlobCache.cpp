@@ -17,21 +17,51 @@
 #include "FileBlobCache.h"
 
 #include <errno.h>
+#include <fcntl.h>
 #include <inttypes.h>
 #include <log/log.h>
+#include <string.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
+#include <android-base/properties.h>
 
-// Cache file header
-static const char* cacheFileMagic = "EGL$";
-static const size_t cacheFileHeaderSize = 8;
+// Cache file magic. The previous format, which stored a flattened BlobCache
+// under "EGL$", is discarded on load.
+static const char* cacheFileMagic = "EGL2";
+
+// Cache file format version.
+static const uint32_t cacheFileVersion = 1;
 
 namespace android {
 
-static uint32_t crc32c(const uint8_t* buf, size_t len) {
+namespace {
+
+// The cache file is a FileHeader followed by records, each made of a
+// RecordHeader then the key and value data, padded to 4 bytes. Records are only
+// ever appended; when a key is in several records, the last one wins. Records
+// which don't fit or fail their CRC end the file, which handles a write being
+// interrupted.
+struct FileHeader {
+    char mMagic[4];
+    uint32_t mVersion;
+    uint32_t mBuildIdLength;
+    char mBuildId[];
+};
+
+struct RecordHeader {
+    uint32_t mKeySize;
+    uint32_t mValueSize;
+    // mCrc is the crc32c of the key and value data.
+    uint32_t mCrc;
+    uint8_t mData[];
+};
+
+} // namespace
+
+static uint32_t crc32c(const uint8_t* buf, size_t len, uint32_t r = 0) {
     const uint32_t polyBits = 0x82F63B78;
-    uint32_t r = 0;
     for (size_t i = 0; i < len; i++) {
         r ^= buf[i];
         for (int j = 0; j < 8; j++) {
@@ -45,13 +75,53 @@ static uint32_t crc32c(const uint8_t* buf, size_t len) {
     return r;
 }
 
+static inline size_t align4(size_t size) {
+    return (size + 3) & ~3;
+}
+
+static std::string makeFileHeader() {
+    auto buildId = base::GetProperty("ro.build.id", "");
+    std::string header(align4(sizeof(FileHeader) + buildId.size()), '\0');
+    auto* fileHeader = reinterpret_cast<FileHeader*>(header.data());
+    memcpy(fileHeader->mMagic, cacheFileMagic, 4);
+    fileHeader->mVersion = cacheFileVersion;
+    fileHeader->mBuildIdLength = buildId.size();
+    memcpy(fileHeader->mBuildId, buildId.data(), buildId.size());
+    return header;
+}
+
+static void appendRecord(std::string* buffer, const std::string& key, const std::string& value) {
+    size_t recordSize = sizeof(RecordHeader) + key.size() + value.size();
+    size_t offset = buffer->size();
+    buffer->resize(offset + align4(recordSize), '\0');
+    auto* record = reinterpret_cast<RecordHeader*>(buffer->data() + offset);
+    record->mKeySize = key.size();
+    record->mValueSize = value.size();
+    memcpy(record->mData, key.data(), key.size());
+    memcpy(record->mData + key.size(), value.data(), value.size());
+    record->mCrc = crc32c(record->mData, key.size() + value.size());
+}
+
+static bool writeFully(int fd, const std::string& buffer) {
+    size_t written = 0;
+    while (written < buffer.size()) {
+        ssize_t result = write(fd, buffer.data() + written, buffer.size() - written);
+        if (result == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        written += result;
+    }
+    return true;
+}
+
 FileBlobCache::FileBlobCache(size_t maxKeySize, size_t maxValueSize, size_t maxTotalSize,
         const std::string& filename)
         : BlobCache(maxKeySize, maxValueSize, maxTotalSize)
         , mFilename(filename) {
     if (mFilename.length() > 0) {
-        size_t headerSize = cacheFileHeaderSize;
-
         int fd = open(mFilename.c_str(), O_RDONLY, 0);
         if (fd == -1) {
             if (errno != ENOENT) {
@@ -68,119 +138,184 @@ FileBlobCache::FileBlobCache(size_t maxKeySize, size_t maxValueSize, size_t maxT
             return;
         }
 
-        // Sanity check the size before trying to mmap it.
+        // Sanity check the size before trying to mmap it. A larger file is
+        // compacted by the next write.
         size_t fileSize = statBuf.st_size;
-        if (fileSize > mMaxTotalSize * 2) {
+        if (fileSize > getMaxFileSize()) {
             ALOGE("cache file is too large: %#" PRIx64,
                   static_cast<off64_t>(statBuf.st_size));
             close(fd);
             return;
         }
+        if (fileSize == 0) {
+            close(fd);
+            return;
+        }
 
-        uint8_t* buf = reinterpret_cast<uint8_t*>(mmap(nullptr, fileSize,
-                PROT_READ, MAP_PRIVATE, fd, 0));
+        // The mapping is kept for the lifetime of the cache, and entries are
+        // served from it without being copied. It stays valid when the file
+        // is appended to or replaced.
+        void* buf = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
         if (buf == MAP_FAILED) {
             ALOGE("error mmaping cache file: %s (%d)", strerror(errno),
                     errno);
-            close(fd);
             return;
         }
+        mMappedData = reinterpret_cast<const uint8_t*>(buf);
+        mMappedSize = fileSize;
 
-        // Check the file magic and CRC
-        size_t cacheSize = fileSize - headerSize;
-        if (memcmp(buf, cacheFileMagic, 4) != 0) {
-            ALOGE("cache file has bad mojo");
-            close(fd);
-            return;
-        }
-        uint32_t* crc = reinterpret_cast<uint32_t*>(buf + 4);
-        if (crc32c(buf + headerSize, cacheSize) != *crc) {
-            ALOGE("cache file failed CRC check");
-            close(fd);
-            return;
-        }
+        loadRecords();
+    }
+}
 
-        int err = unflatten(buf + headerSize, cacheSize);
-        if (err < 0) {
-            ALOGE("error reading cache contents: %s (%d)", strerror(-err),
-                    -err);
-            munmap(buf, fileSize);
-            close(fd);
-            return;
-        }
+FileBlobCache::~FileBlobCache() {
+    // Entries may point into the mapping, so they must be dropped first.
+    clear();
+    if (mMappedData != nullptr) {
+        munmap(const_cast<uint8_t*>(mMappedData), mMappedSize);
+    }
+}
 
-        munmap(buf, fileSize);
-        close(fd);
+size_t FileBlobCache::getMaxFileSize() const {
+    return mMaxTotalSize * 2;
+}
+
+void FileBlobCache::loadRecords() {
+    const std::string expectedHeader = makeFileHeader();
+    if (mMappedSize < expectedHeader.size() ||
+        memcmp(mMappedData, expectedHeader.data(), expectedHeader.size()) != 0) {
+        // Either a file in another format, or from another build. It is
+        // replaced by the next write.
+        ALOGV("cache file has bad mojo or a different build");
+        return;
     }
+
+    size_t offset = expectedHeader.size();
+    size_t numRecords = 0;
+    while (offset + sizeof(RecordHeader) <= mMappedSize) {
+        const RecordHeader* record = reinterpret_cast<const RecordHeader*>(mMappedData + offset);
+        size_t dataSize = size_t(record->mKeySize) + record->mValueSize;
+        size_t recordSize = align4(sizeof(RecordHeader) + dataSize);
+        if (recordSize > mMappedSize - offset) {
+            ALOGW("cache file has a truncated record at %zu", offset);
+            break;
+        }
+        if (crc32c(record->mData, dataSize) != record->mCrc) {
+            ALOGW("cache file failed CRC check at %zu", offset);
+            break;
+        }
+        setPersisted(record->mData, record->mKeySize, record->mData + record->mKeySize,
+                record->mValueSize);
+        offset += recordSize;
+        numRecords++;
+    }
+    ALOGV("loaded %zu records from cache file", numRecords);
+
+    // Appends go after the last valid record.
+    mFileSize = offset;
 }
 
 void FileBlobCache::writeToFile() {
     if (mFilename.length() > 0) {
-        size_t cacheSize = getFlattenedSize();
-        size_t headerSize = cacheFileHeaderSize;
-        const char* fname = mFilename.c_str();
-
-        // Try to create the file with no permissions so we can write it
-        // without anyone trying to read it.
-        int fd = open(fname, O_CREAT | O_EXCL | O_RDWR, 0);
-        if (fd == -1) {
-            if (errno == EEXIST) {
-                // The file exists, delete it and try again.
-                if (unlink(fname) == -1) {
-                    // No point in retrying if the unlink failed.
-                    ALOGE("error unlinking cache file %s: %s (%d)", fname,
-                            strerror(errno), errno);
-                    return;
-                }
-                // Retry now that we've unlinked the file.
-                fd = open(fname, O_CREAT | O_EXCL | O_RDWR, 0);
-            }
-            if (fd == -1) {
-                ALOGE("error creating cache file %s: %s (%d)", fname,
-                        strerror(errno), errno);
+        std::lock_guard<std::mutex> lock(mWriteMutex);
+        // Records are appended to a valid file, unless evicted and replaced
+        // entries have made it too large, in which case it is compacted.
+        bool compact = mFileSize == 0;
+        std::vector<Entry> entries = takeEntriesToPersist(/*all*/ false);
+        if (!compact) {
+            if (entries.empty()) {
                 return;
             }
+            size_t appendSize = 0;
+            for (const Entry& entry : entries) {
+                appendSize += align4(sizeof(RecordHeader) + entry.key.size() + entry.value.size());
+            }
+            if (mFileSize + appendSize > getMaxFileSize() || !appendRecords(entries)) {
+                compact = true;
+            }
+        }
+        if (compact) {
+            compactFile();
         }
+    }
+}
 
-        size_t fileSize = headerSize + cacheSize;
+bool FileBlobCache::appendRecords(const std::vector<Entry>& entries) {
+    std::string buffer;
+    for (const Entry& entry : entries) {
+        appendRecord(&buffer, entry.key, entry.value);
+    }
 
-        uint8_t* buf = new uint8_t [fileSize];
-        if (!buf) {
-            ALOGE("error allocating buffer for cache contents: %s (%d)",
-                    strerror(errno), errno);
-            close(fd);
-            unlink(fname);
-            return;
-        }
+    const char* fname = mFilename.c_str();
+    int fd = open(fname, O_WRONLY, 0);
+    if (fd == -1) {
+        ALOGE("error opening cache file %s: %s (%d)", fname, strerror(errno), errno);
+        return false;
+    }
+    // Drop anything after the last valid record, such as an interrupted write.
+    if (ftruncate(fd, mFileSize) == -1 || lseek(fd, mFileSize, SEEK_SET) == -1 ||
+        !writeFully(fd, buffer)) {
+        ALOGE("error appending to cache file %s: %s (%d)", fname, strerror(errno), errno);
+        close(fd);
+        return false;
+    }
+    close(fd);
+    mFileSize += buffer.size();
+    return true;
+}
 
-        int err = flatten(buf + headerSize, cacheSize);
-        if (err < 0) {
-            ALOGE("error writing cache contents: %s (%d)", strerror(-err),
-                    -err);
-            delete [] buf;
-            close(fd);
-            unlink(fname);
-            return;
-        }
+void FileBlobCache::compactFile() {
+    std::string buffer = makeFileHeader();
+    for (const Entry& entry : takeEntriesToPersist(/*all*/ true)) {
+        appendRecord(&buffer, entry.key, entry.value);
+    }
+    mFileSize = 0;
 
-        // Write the file magic and CRC
-        memcpy(buf, cacheFileMagic, 4);
-        uint32_t* crc = reinterpret_cast<uint32_t*>(buf + 4);
-        *crc = crc32c(buf + headerSize, cacheSize);
+    // Write the new file next to the old one and rename it, so that the old
+    // file, which may be mapped, is never modified.
+    const std::string tempFilename = mFilename + ".tmp";
+    const char* fname = tempFilename.c_str();
 
-        if (write(fd, buf, fileSize) == -1) {
-            ALOGE("error writing cache file: %s (%d)", strerror(errno),
-                    errno);
-            delete [] buf;
-            close(fd);
-            unlink(fname);
+    // Try to create the file with no permissions so we can write it
+    // without anyone trying to read it.
+    int fd = open(fname, O_CREAT | O_EXCL | O_RDWR, 0);
+    if (fd == -1) {
+        if (errno == EEXIST) {
+            // The file exists, delete it and try again.
+            if (unlink(fname) == -1) {
+                // No point in retrying if the unlink failed.
+                ALOGE("error unlinking cache file %s: %s (%d)", fname,
+                        strerror(errno), errno);
+                return;
+            }
+            // Retry now that we've unlinked the file.
+            fd = open(fname, O_CREAT | O_EXCL | O_RDWR, 0);
+        }
+        if (fd == -1) {
+            ALOGE("error creating cache file %s: %s (%d)", fname,
+                    strerror(errno), errno);
             return;
         }
+    }
 
-        delete [] buf;
-        fchmod(fd, S_IRUSR);
+    if (!writeFully(fd, buffer)) {
+        ALOGE("error writing cache file: %s (%d)", strerror(errno),
+                errno);
         close(fd);
+        unlink(fname);
+        return;
+    }
+
+    // The file is appended to by later writes.
+    fchmod(fd, S_IRUSR | S_IWUSR);
+    close(fd);
+    if (rename(fname, mFilename.c_str()) == -1) {
+        ALOGE("error renaming cache file %s: %s (%d)", fname, strerror(errno), errno);
+        unlink(fname);
+        return;
     }
+    mFileSize = buffer.size();
 }
 
 }
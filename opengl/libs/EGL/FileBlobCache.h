@@ -18,24 +18,54 @@
 #define ANDROID_FILE_BLOB_CACHE_H
 
 #include "BlobCache.h"
+#include <mutex>
 #include <string>
+#include <vector>
 
 namespace android {
 
 class FileBlobCache : public BlobCache {
 public:
     // FileBlobCache attempts to load the saved cache contents from disk into
-    // BlobCache.
+    // BlobCache.  The file is mapped, and the loaded entries are served from
+    // the mapping rather than copied.
     FileBlobCache(size_t maxKeySize, size_t maxValueSize, size_t maxTotalSize,
             const std::string& filename);
+    ~FileBlobCache();
 
     // writeToFile attempts to save the current contents of BlobCache to
-    // disk.
+    // disk.  Only the entries set since the last call are appended to the
+    // file, unless the file needs to be compacted, in which case it is
+    // rewritten with the current contents.  It may be called while other
+    // threads use the cache.
     void writeToFile();
 
 private:
+    // getMaxFileSize returns the size past which the file is compacted.
+    size_t getMaxFileSize() const;
+
+    // loadRecords adds the records of the mapped file to the cache.
+    void loadRecords();
+
+    // appendRecords appends the entries to the file, returning false on error.
+    bool appendRecords(const std::vector<Entry>& entries);
+
+    // compactFile replaces the file with one holding the current contents.
+    void compactFile();
+
     // mFilename is the name of the file for storing cache contents.
     std::string mFilename;
+
+    // mMappedData is the mapping of the file loaded at construction.
+    const uint8_t* mMappedData = nullptr;
+    size_t mMappedSize = 0;
+
+    // mWriteMutex prevents concurrent writes of the file.
+    std::mutex mWriteMutex;
+
+    // mFileSize is the size of the valid part of the file, which records are
+    // appended after.  It is 0 if there is no valid file.
+    size_t mFileSize = 0;
 };
 
 } // namespace android
@@ -0,0 +1,181 @@
+/*
+ ** Copyright 2020, The Android Open Source Project
+ **
+ ** Licensed under the Apache License, Version 2.0 (the "License");
+ ** you may not use this file except in compliance with the License.
+ ** You may obtain a copy of the License at
+ **
+ **     http://www.apache.org/licenses/LICENSE-2.0
+ **
+ ** Unless required by applicable law or agreed to in writing, software
+ ** distributed under the License is distributed on an "AS IS" BASIS,
+ ** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ ** See the License for the specific language governing permissions and
+ ** limitations under the License.
+ */
+
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+
+#include <android-base/file.h>
+#include <gtest/gtest.h>
+
+#include "FileBlobCache.h"
+
+namespace android {
+
+class FileBlobCacheTest : public ::testing::Test {
+protected:
+    enum {
+        MAX_KEY_SIZE = 6,
+        MAX_VALUE_SIZE = 8,
+        MAX_TOTAL_SIZE = 64,
+    };
+
+    std::unique_ptr<FileBlobCache> open() {
+        return std::make_unique<FileBlobCache>(MAX_KEY_SIZE, MAX_VALUE_SIZE, MAX_TOTAL_SIZE,
+                                               mFilename);
+    }
+
+    off_t fileSize() {
+        struct stat statBuf;
+        if (stat(mFilename.c_str(), &statBuf) == -1) {
+            return -1;
+        }
+        return statBuf.st_size;
+    }
+
+    TemporaryDir mDir;
+    const std::string mFilename = std::string(mDir.path) + "/cache";
+};
+
+TEST_F(FileBlobCacheTest, EntriesAreReloaded) {
+    {
+        auto cache = open();
+        cache->set("abcd", 4, "efgh", 4);
+        cache->writeToFile();
+    }
+
+    auto cache = open();
+    char buf[4] = {};
+    ASSERT_EQ(size_t(4), cache->get("abcd", 4, buf, 4));
+    ASSERT_EQ(0, memcmp("efgh", buf, 4));
+}
+
+TEST_F(FileBlobCacheTest, WritesOnlyAppendNewEntries) {
+    auto cache = open();
+    cache->set("abcd", 4, "efgh", 4);
+    cache->writeToFile();
+    off_t firstSize = fileSize();
+    ASSERT_GT(firstSize, 0);
+
+    // Nothing new to write.
+    cache->writeToFile();
+    ASSERT_EQ(firstSize, fileSize());
+
+    cache->set("ijkl", 4, "mnop", 4);
+    cache->writeToFile();
+    ASSERT_GT(fileSize(), firstSize);
+
+    auto reloaded = open();
+    char buf[4] = {};
+    ASSERT_EQ(size_t(4), reloaded->get("abcd", 4, buf, 4));
+    ASSERT_EQ(0, memcmp("efgh", buf, 4));
+    ASSERT_EQ(size_t(4), reloaded->get("ijkl", 4, buf, 4));
+    ASSERT_EQ(0, memcmp("mnop", buf, 4));
+}
+
+TEST_F(FileBlobCacheTest, LastRecordOfAKeyWins) {
+    {
+        auto cache = open();
+        cache->set("abcd", 4, "efgh", 4);
+        cache->writeToFile();
+        cache->set("abcd", 4, "wxyz", 4);
+        cache->writeToFile();
+    }
+
+    auto cache = open();
+    char buf[4] = {};
+    ASSERT_EQ(size_t(4), cache->get("abcd", 4, buf, 4));
+    ASSERT_EQ(0, memcmp("wxyz", buf, 4));
+}
+
+TEST_F(FileBlobCacheTest, ReloadedEntriesCanBeUpdated) {
+    {
+        auto cache = open();
+        cache->set("abcd", 4, "efgh", 4);
+        cache->writeToFile();
+    }
+
+    {
+        auto cache = open();
+        cache->set("abcd", 4, "wxyz", 4);
+        cache->set("ijkl", 4, "mnop", 4);
+        cache->writeToFile();
+    }
+
+    auto cache = open();
+    char buf[4] = {};
+    ASSERT_EQ(size_t(4), cache->get("abcd", 4, buf, 4));
+    ASSERT_EQ(0, memcmp("wxyz", buf, 4));
+    ASSERT_EQ(size_t(4), cache->get("ijkl", 4, buf, 4));
+}
+
+TEST_F(FileBlobCacheTest, FileIsCompactedWhenTooLarge) {
+    auto cache = open();
+    for (int i = 0; i < 64; i++) {
+        uint8_t v = i;
+        cache->set("abcd", 4, &v, 1);
+        cache->writeToFile();
+        // Replaced records are dropped once the file reaches twice the
+        // cache size.
+        ASSERT_GE(2 * MAX_TOTAL_SIZE, fileSize());
+    }
+
+    auto reloaded = open();
+    uint8_t v = 0;
+    ASSERT_EQ(size_t(1), reloaded->get("abcd", 4, &v, 1));
+    ASSERT_EQ(63, v);
+}
+
+TEST_F(FileBlobCacheTest, TruncatedRecordIsDropped) {
+    {
+        auto cache = open();
+        cache->set("abcd", 4, "efgh", 4);
+        cache->writeToFile();
+        cache->set("ijkl", 4, "mnop", 4);
+        cache->writeToFile();
+    }
+    ASSERT_EQ(0, truncate(mFilename.c_str(), fileSize() - 2));
+
+    auto cache = open();
+    char buf[4] = {};
+    ASSERT_EQ(size_t(4), cache->get("abcd", 4, buf, 4));
+    ASSERT_EQ(size_t(0), cache->get("ijkl", 4, buf, 4));
+
+    // The next record replaces the truncated one.
+    cache->set("qrst", 4, "uvwx", 4);
+    cache->writeToFile();
+    auto reloaded = open();
+    ASSERT_EQ(size_t(4), reloaded->get("abcd", 4, buf, 4));
+    ASSERT_EQ(size_t(4), reloaded->get("qrst", 4, buf, 4));
+}
+
+TEST_F(FileBlobCacheTest, CorruptFileIsIgnored) {
+    ASSERT_TRUE(base::WriteStringToFile("not a cache file", mFilename));
+
+    auto cache = open();
+    char buf[4] = {};
+    ASSERT_EQ(size_t(0), cache->get("abcd", 4, buf, 4));
+
+    cache->set("abcd", 4, "efgh", 4);
+    cache->writeToFile();
+    auto reloaded = open();
+    ASSERT_EQ(size_t(4), reloaded->get("abcd", 4, buf, 4));
+}
+
+} // namespace android
@@ -23,6 +23,7 @@
 
 #include <dirent.h>
 #include <dlfcn.h>
+#include <inttypes.h>
 
 #include <android-base/properties.h>
 #include <android/dlext.h>
@@ -63,18 +64,47 @@ Loader& Loader::getInstance() {
     return loader;
 }
 
+// Time spent in each stage of the driver load in progress, reported to GpuStats. It is only set
+// while Loader::open runs, under the lock that serializes driver initialization.
+struct LoadingStageTimes {
+    nsecs_t namespaceSetup = 0;
+    nsecs_t dlopen = 0;
+    nsecs_t init = 0;
+};
+static LoadingStageTimes* sLoadingStageTimes = nullptr;
+
+// Adds the time until it goes out of scope to a stage of the driver load in progress, if any.
+class ScopedStageTimer {
+public:
+    explicit ScopedStageTimer(nsecs_t LoadingStageTimes::*stage)
+          : mStageTime(sLoadingStageTimes ? &(sLoadingStageTimes->*stage) : nullptr),
+            mStart(mStageTime ? systemTime() : 0) {}
+    ~ScopedStageTimer() {
+        if (mStageTime) {
+            *mStageTime += systemTime() - mStart;
+        }
+    }
+
+private:
+    nsecs_t* const mStageTime;
+    const nsecs_t mStart;
+};
+
 static void* do_dlopen(const char* path, int mode) {
     ATRACE_CALL();
+    ScopedStageTimer timer(&LoadingStageTimes::dlopen);
     return dlopen(path, mode);
 }
 
 static void* do_android_dlopen_ext(const char* path, int mode, const android_dlextinfo* info) {
     ATRACE_CALL();
+    ScopedStageTimer timer(&LoadingStageTimes::dlopen);
     return android_dlopen_ext(path, mode, info);
 }
 
 static void* do_android_load_sphal_library(const char* path, int mode) {
     ATRACE_CALL();
+    ScopedStageTimer timer(&LoadingStageTimes::dlopen);
     return android_load_sphal_library(path, mode);
 }
 
@@ -119,7 +149,8 @@ int Loader::driver_t::set(void* hnd, int32_t api)
 }
 
 Loader::Loader()
-    : getProcAddress(nullptr)
+    : getProcAddress(nullptr),
+      mLazyGles1(base::GetBoolProperty("debug.egl.lazy_gles1", true))
 {
 }
 
@@ -212,13 +243,22 @@ void* Loader::open(egl_connection_t* cnx)
 {
     ATRACE_CALL();
     const nsecs_t openTime = systemTime();
+    LoadingStageTimes stageTimes;
+    sLoadingStageTimes = &stageTimes;
 
-    if (should_unload_system_driver(cnx)) {
+    // Checking for ANGLE and the updated driver creates their namespaces.
+    bool shouldUnloadSystemDriver;
+    {
+        ScopedStageTimer timer(&LoadingStageTimes::namespaceSetup);
+        shouldUnloadSystemDriver = should_unload_system_driver(cnx);
+    }
+    if (shouldUnloadSystemDriver) {
         unload_system_driver(cnx);
     }
 
     // If a driver has been loaded, return the driver directly.
     if (cnx->dso) {
+        sLoadingStageTimes = nullptr;
         return cnx->dso;
     }
 
@@ -304,12 +344,47 @@ void* Loader::open(egl_connection_t* cnx)
     LOG_ALWAYS_FATAL_IF(!cnx->libGles2 || !cnx->libGles1,
                         "couldn't load system OpenGL ES wrapper libraries");
 
-    android::GraphicsEnv::getInstance().setDriverLoaded(android::GpuStatsInfo::Api::API_GL, true,
-                                                        systemTime() - openTime);
+    sLoadingStageTimes = nullptr;
+    const nsecs_t loadingTime = systemTime() - openTime;
+    android::GraphicsEnv& graphicsEnv = android::GraphicsEnv::getInstance();
+    graphicsEnv.setDriverLoadingStageTime(android::GpuStatsInfo::Api::API_GL, "namespace",
+                                          stageTimes.namespaceSetup);
+    graphicsEnv.setDriverLoadingStageTime(android::GpuStatsInfo::Api::API_GL, "dlopen",
+                                          stageTimes.dlopen);
+    graphicsEnv.setDriverLoadingStageTime(android::GpuStatsInfo::Api::API_GL, "init",
+                                          stageTimes.init);
+    graphicsEnv.setDriverLoaded(android::GpuStatsInfo::Api::API_GL, true, loadingTime);
+    graphicsEnv.setDriverLoadingStageTime(android::GpuStatsInfo::Api::API_GL, "open",
+                                          loadingTime);
 
     return (void*)hnd;
 }
 
+void Loader::load_gles1(egl_connection_t* cnx)
+{
+    std::lock_guard<std::mutex> lock(mGles1Mutex);
+    driver_t* hnd = (driver_t*) cnx->dso;
+    if (!hnd || !hnd->gles1Loader) {
+        return;
+    }
+
+    ATRACE_CALL();
+    const nsecs_t loadTime = systemTime();
+
+    void* dso = hnd->gles1Loader();
+    hnd->gles1Loader = nullptr;
+    initialize_api(dso, cnx, GLESv1_CM);
+    if (dso != hnd->dso[0]) {
+        hnd->set(dso, GLESv1_CM);
+    }
+
+    const nsecs_t loadingTime = systemTime() - loadTime;
+    ALOGD("deferred GLESv1_CM load took %" PRId64 "us", ns2us(loadingTime));
+    android::GraphicsEnv::getInstance()
+            .setDriverLoadingStageTime(android::GpuStatsInfo::Api::API_GL, "GLESv1_CM",
+                                       loadingTime);
+}
+
 void Loader::close(egl_connection_t* cnx)
 {
     driver_t* hnd = (driver_t*) cnx->dso;
@@ -545,9 +620,7 @@ Loader::driver_t* Loader::attempt_to_load_angle(egl_connection_t* cnx) {
         initialize_api(dso, cnx, EGL);
         hnd = new driver_t(dso);
 
-        dso = load_angle("GLESv1_CM", ns);
-        initialize_api(dso, cnx, GLESv1_CM);
-        hnd->set(dso, GLESv1_CM);
+        initialize_gles1(hnd, cnx, [ns]() { return load_angle("GLESv1_CM", ns); });
 
         dso = load_angle("GLESv2", ns);
         initialize_api(dso, cnx, GLESv2);
@@ -584,8 +657,9 @@ Loader::driver_t* Loader::attempt_to_load_updated_driver(egl_connection_t* cnx)
     driver_t* hnd = nullptr;
     void* dso = load_updated_driver("GLES", ns);
     if (dso) {
-        initialize_api(dso, cnx, EGL | GLESv1_CM | GLESv2);
+        initialize_api(dso, cnx, EGL | GLESv2);
         hnd = new driver_t(dso);
+        initialize_gles1(hnd, cnx, [dso]() { return dso; });
         return hnd;
     }
 
@@ -594,9 +668,7 @@ Loader::driver_t* Loader::attempt_to_load_updated_driver(egl_connection_t* cnx)
         initialize_api(dso, cnx, EGL);
         hnd = new driver_t(dso);
 
-        dso = load_updated_driver("GLESv1_CM", ns);
-        initialize_api(dso, cnx, GLESv1_CM);
-        hnd->set(dso, GLESv1_CM);
+        initialize_gles1(hnd, cnx, [ns]() { return load_updated_driver("GLESv1_CM", ns); });
 
         dso = load_updated_driver("GLESv2", ns);
         initialize_api(dso, cnx, GLESv2);
@@ -615,8 +687,9 @@ Loader::driver_t* Loader::attempt_to_load_system_driver(egl_connection_t* cnx, c
     driver_t* hnd = nullptr;
     void* dso = load_system_driver("GLES", suffix, exact);
     if (dso) {
-        initialize_api(dso, cnx, EGL | GLESv1_CM | GLESv2);
+        initialize_api(dso, cnx, EGL | GLESv2);
         hnd = new driver_t(dso);
+        initialize_gles1(hnd, cnx, [dso]() { return dso; });
         return hnd;
     }
     dso = load_system_driver("EGL", suffix, exact);
@@ -624,9 +697,13 @@ Loader::driver_t* Loader::attempt_to_load_system_driver(egl_connection_t* cnx, c
         initialize_api(dso, cnx, EGL);
         hnd = new driver_t(dso);
 
-        dso = load_system_driver("GLESv1_CM", suffix, exact);
-        initialize_api(dso, cnx, GLESv1_CM);
-        hnd->set(dso, GLESv1_CM);
+        // The suffix may point into a temporary owned by the caller.
+        const std::string suffixString = suffix ? suffix : "";
+        const bool hasSuffix = suffix != nullptr;
+        initialize_gles1(hnd, cnx, [suffixString, hasSuffix, exact]() {
+            return load_system_driver("GLESv1_CM", hasSuffix ? suffixString.c_str() : nullptr,
+                                      exact);
+        });
 
         dso = load_system_driver("GLESv2", suffix, exact);
         initialize_api(dso, cnx, GLESv2);
@@ -635,7 +712,23 @@ Loader::driver_t* Loader::attempt_to_load_system_driver(egl_connection_t* cnx, c
     return hnd;
 }
 
+void Loader::initialize_gles1(driver_t* hnd, egl_connection_t* cnx,
+                              std::function<void*()> loader) {
+    if (mLazyGles1) {
+        hnd->gles1Loader = std::move(loader);
+        return;
+    }
+
+    void* dso = loader();
+    initialize_api(dso, cnx, GLESv1_CM);
+    if (dso != hnd->dso[0]) {
+        hnd->set(dso, GLESv1_CM);
+    }
+}
+
 void Loader::initialize_api(void* dso, egl_connection_t* cnx, uint32_t mask) {
+    ScopedStageTimer timer(&LoadingStageTimes::init);
+
     if (mask & EGL) {
         getProcAddress = (getProcAddressType)dlsym(dso, "eglGetProcAddress");
 
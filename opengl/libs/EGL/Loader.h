@@ -21,6 +21,9 @@
 
 #include <EGL/egl.h>
 
+#include <functional>
+#include <mutex>
+
 // ----------------------------------------------------------------------------
 namespace android {
 // ----------------------------------------------------------------------------
@@ -42,6 +45,9 @@ class Loader {
         // returns -errno
         int set(void* hnd, int32_t api);
         void* dso[3];
+        // Loads the GLESv1_CM library when it was deferred by open(). It may
+        // return dso[0] for drivers shipped as a single library.
+        std::function<void*()> gles1Loader;
     };
 
     getProcAddressType getProcAddress;
@@ -52,6 +58,9 @@ public:
 
     void* open(egl_connection_t* cnx);
     void close(egl_connection_t* cnx);
+    // Load and resolve the GLES 1.x API if open() deferred it. This is called
+    // before the first GLES 1.x context is handed out.
+    void load_gles1(egl_connection_t* cnx);
 
 private:
     Loader();
@@ -60,6 +69,7 @@ private:
     driver_t* attempt_to_load_system_driver(egl_connection_t* cnx, const char* suffix, const bool exact);
     void unload_system_driver(egl_connection_t* cnx);
     void initialize_api(void* dso, egl_connection_t* cnx, uint32_t mask);
+    void initialize_gles1(driver_t* hnd, egl_connection_t* cnx, std::function<void*()> loader);
     void init_angle_backend(void* dso, egl_connection_t* cnx);
 
     static __attribute__((noinline))
@@ -68,6 +78,12 @@ private:
             char const * const * ref_api,
             __eglMustCastToProperFunctionPointerType* curr,
             getProcAddressType getProcAddress);
+
+    // Most processes never create a GLES 1.x context, so its library and
+    // entry points are only loaded on demand unless debug.egl.lazy_gles1 is 0.
+    bool mLazyGles1;
+    // Serializes load_gles1 against concurrent context creation.
+    std::mutex mGles1Mutex;
 };
 
 // ----------------------------------------------------------------------------
@@ -32,6 +32,8 @@
 #include "CallStack.h"
 #include "Loader.h"
 
+#include <private/EGL/loader.h>
+
 // ----------------------------------------------------------------------------
 namespace android {
 // ----------------------------------------------------------------------------
@@ -207,6 +209,12 @@ EGLBoolean egl_init_drivers() {
     return res;
 }
 
+void egl_preload_drivers() {
+    if (egl_init_drivers() == EGL_TRUE) {
+        Loader::getInstance().load_gles1(&gEGLImpl);
+    }
+}
+
 static pthread_mutex_t sLogPrintMutex = PTHREAD_MUTEX_INITIALIZER;
 static std::chrono::steady_clock::time_point sLogPrintTime;
 static constexpr std::chrono::seconds DURATION(1);
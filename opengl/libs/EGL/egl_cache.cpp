@@ -20,6 +20,7 @@
 
 #include "egl_display.h"
 
+#include <android-base/properties.h>
 #include <private/EGL/cache.h>
 
 #include <unistd.h>
@@ -27,6 +28,11 @@
 #include <thread>
 
 #include <log/log.h>
+#include <utils/Timers.h>
+
+#ifndef __ANDROID_VNDK__
+#include <graphicsenv/GraphicsEnv.h>
+#endif
 
 // Cache size limits.
 static const size_t maxKeySize = 12 * 1024;
@@ -64,7 +70,8 @@ static EGLsizeiANDROID getBlob(const void* key, EGLsizeiANDROID keySize,
 // egl_cache_t definition
 //
 egl_cache_t::egl_cache_t() :
-        mInitialized(false) {
+        mInitialized(false),
+        mCacheLoadReported(false) {
 }
 
 egl_cache_t::~egl_cache_t() {
@@ -111,6 +118,18 @@ void egl_cache_t::initialize(egl_display_t *display) {
         }
     }
 
+#ifndef __ANDROID_VNDK__
+    // Blobs are only shared between processes running the same driver build.
+    mSharedCacheDriverKey.clear();
+    if (base::GetBoolProperty("debug.egl.shared_shader_cache", false) &&
+            display->disp.queryString.vendor && display->disp.queryString.version) {
+        mSharedCacheDriverKey = std::string(display->disp.queryString.vendor) + " " +
+                display->disp.queryString.version + " " +
+                base::GetProperty("ro.build.fingerprint", "") + " " +
+                GraphicsEnv::getInstance().getDriverPath();
+    }
+#endif
+
     mInitialized = true;
 }
 
@@ -124,58 +143,118 @@ void egl_cache_t::terminate() {
 
 void egl_cache_t::setBlob(const void* key, EGLsizeiANDROID keySize,
         const void* value, EGLsizeiANDROID valueSize) {
-    std::lock_guard<std::mutex> lock(mMutex);
-
     if (keySize < 0 || valueSize < 0) {
         ALOGW("EGL_ANDROID_blob_cache set: negative sizes are not allowed");
         return;
     }
 
-    if (mInitialized) {
-        BlobCache* bc = getBlobCacheLocked();
-        bc->set(key, keySize, value, valueSize);
+    // The BlobCache has its own locking, so mMutex is only held to get it.
+    std::shared_ptr<FileBlobCache> bc;
+    std::string sharedCacheDriverKey;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (!mInitialized) {
+            return;
+        }
+        bc = getBlobCacheLocked();
+        sharedCacheDriverKey = mSharedCacheDriverKey;
 
         if (!mSavePending) {
             mSavePending = true;
             std::thread deferredSaveThread([this]() {
                 sleep(deferredSaveDelay);
-                std::lock_guard<std::mutex> lock(mMutex);
-                if (mInitialized && mBlobCache) {
-                    mBlobCache->writeToFile();
+                std::shared_ptr<FileBlobCache> cache;
+                {
+                    std::lock_guard<std::mutex> lock(mMutex);
+                    if (mInitialized) {
+                        cache = mBlobCache;
+                    }
+                    mSavePending = false;
+                }
+                if (cache) {
+                    cache->writeToFile();
                 }
-                mSavePending = false;
             });
             deferredSaveThread.detach();
         }
     }
+    bc->set(key, keySize, value, valueSize);
+
+#ifndef __ANDROID_VNDK__
+    if (!sharedCacheDriverKey.empty() && size_t(valueSize) <= maxValueSize) {
+        GraphicsEnv::getInstance().setShaderCacheBlob(sharedCacheDriverKey, key, keySize, value,
+                                                      valueSize);
+    }
+#endif
 }
 
 EGLsizeiANDROID egl_cache_t::getBlob(const void* key, EGLsizeiANDROID keySize,
         void* value, EGLsizeiANDROID valueSize) {
-    std::lock_guard<std::mutex> lock(mMutex);
-
     if (keySize < 0 || valueSize < 0) {
         ALOGW("EGL_ANDROID_blob_cache set: negative sizes are not allowed");
         return 0;
     }
 
-    if (mInitialized) {
-        BlobCache* bc = getBlobCacheLocked();
-        return bc->get(key, keySize, value, valueSize);
+    std::shared_ptr<FileBlobCache> bc;
+    std::string sharedCacheDriverKey;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (!mInitialized) {
+            return 0;
+        }
+        bc = getBlobCacheLocked();
+        sharedCacheDriverKey = mSharedCacheDriverKey;
+    }
+    EGLsizeiANDROID size = bc->get(key, keySize, value, valueSize);
+
+#ifndef __ANDROID_VNDK__
+    // On a local miss, ask GpuService before the driver compiles. A hit is
+    // copied into the local cache so it is only fetched once per process.
+    if (size == 0 && !sharedCacheDriverKey.empty()) {
+        std::vector<uint8_t> shared =
+                GraphicsEnv::getInstance().getShaderCacheBlob(sharedCacheDriverKey, key, keySize);
+        if (!shared.empty()) {
+            bc->set(key, keySize, shared.data(), shared.size());
+            size = shared.size();
+            if (size <= valueSize) {
+                memcpy(value, shared.data(), shared.size());
+            }
+        }
     }
-    return 0;
+#endif
+
+    return size;
 }
 
 void egl_cache_t::setCacheFilename(const char* filename) {
     std::lock_guard<std::mutex> lock(mMutex);
     mFilename = filename;
+
+    // The cache file is otherwise read when the driver first looks up a blob, which is usually
+    // while the first frame's shaders are compiled.
+    if (!mBlobCache && base::GetBoolProperty("ro.gfx.driver.preload", false)) {
+        std::thread preloadThread([this]() {
+            std::lock_guard<std::mutex> lock(mMutex);
+            getBlobCacheLocked();
+        });
+        preloadThread.detach();
+    }
 }
 
-BlobCache* egl_cache_t::getBlobCacheLocked() {
+std::shared_ptr<FileBlobCache> egl_cache_t::getBlobCacheLocked() {
     if (mBlobCache == nullptr) {
-        mBlobCache.reset(new FileBlobCache(maxKeySize, maxValueSize, maxTotalSize, mFilename));
+        const nsecs_t loadTime = systemTime();
+        mBlobCache = std::make_shared<FileBlobCache>(maxKeySize, maxValueSize, maxTotalSize,
+                                                     mFilename);
+#ifndef __ANDROID_VNDK__
+        if (!mCacheLoadReported) {
+            mCacheLoadReported = true;
+            GraphicsEnv::getInstance().setDriverLoadingStageTime(GpuStatsInfo::Api::API_GL, "cache",
+                                                                 systemTime() - loadTime);
+        }
+#endif
     }
-    return mBlobCache.get();
+    return mBlobCache;
 }
 
 // ----------------------------------------------------------------------------
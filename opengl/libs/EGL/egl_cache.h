@@ -64,7 +64,8 @@ public:
         void* value, EGLsizeiANDROID valueSize);
 
     // setCacheFilename sets the name of the file that should be used to store
-    // cache contents from one program invocation to another.
+    // cache contents from one program invocation to another.  If
+    // ro.gfx.driver.preload is set, the file is then loaded in the background.
     void setCacheFilename(const char* filename);
 
 private:
@@ -79,8 +80,9 @@ private:
     // getBlobCacheLocked returns the BlobCache object being used to store the
     // key/value blob pairs.  If the BlobCache object has not yet been created,
     // this will do so, loading the serialized cache contents from disk if
-    // possible.
-    BlobCache* getBlobCacheLocked();
+    // possible.  The BlobCache is thread-safe, so it may be used once mMutex
+    // is released; the returned reference keeps it alive across terminate.
+    std::shared_ptr<FileBlobCache> getBlobCacheLocked();
 
     // mInitialized indicates whether the egl_cache_t is in the initialized
     // state.  It is initialized to false at construction time, and gets set to
@@ -93,7 +95,7 @@ private:
     // mBlobCache is the cache in which the key/value blob pairs are stored.  It
     // is initially NULL, and will be initialized by getBlobCacheLocked the
     // first time it's needed.
-    std::unique_ptr<FileBlobCache> mBlobCache;
+    std::shared_ptr<FileBlobCache> mBlobCache;
 
     // mFilename is the name of the file for storing cache contents in between
     // program invocations.  It is initialized to an empty string at
@@ -109,8 +111,20 @@ private:
     // contents to disk.
     bool mSavePending;
 
+    // mSharedCacheDriverKey identifies the loaded driver build to the shared
+    // shader cache in GpuService.  It is set by initialize when
+    // debug.egl.shared_shader_cache is enabled; when empty, getBlob and
+    // setBlob only use the per-process cache.
+    std::string mSharedCacheDriverKey;
+
+    // mCacheLoadReported indicates whether the time to load the cache file
+    // has been reported to GpuStats.  Only the first load of the process is
+    // reported, as it is the one on the app's startup path.
+    bool mCacheLoadReported;
+
     // mMutex is the mutex used to prevent concurrent access to the member
-    // variables. It must be locked whenever the member variables are accessed.
+    // variables. It must be locked whenever the member variables are accessed,
+    // but not while using mBlobCache, which has its own locking.
     mutable std::mutex mMutex;
 
     // sCache is the singleton egl_cache_t object.
@@ -23,6 +23,7 @@
 
 #include <condition_variable>
 #include <mutex>
+#include <shared_mutex>
 #include <string>
 #include <unordered_set>
 
@@ -125,6 +126,9 @@ private:
     mutable std::mutex                  lock;
     mutable std::mutex                  refLock;
     mutable std::condition_variable     refCond;
+    // Guards objects. It is separate from lock, which is held across driver calls such as
+    // eglMakeCurrent, and shared so that validating objects in concurrent calls doesn't contend.
+    mutable std::shared_mutex           objectsLock;
             std::unordered_set<egl_object_t*> objects;
             std::string mVendorString;
             std::string mVersionString;
@@ -78,13 +78,14 @@ const void* getNextLayerProcAddress(void* layer_id, const char* name) {
 
     ALOGV("getNextLayerProcAddress servicing %s", name);
 
-    if (func_indices.find(name) == func_indices.end()) {
+    auto func_index = func_indices.find(name);
+    if (func_index == func_indices.end()) {
         // No entry for this function - it is an extension
         // call down the GPA chain directly to the impl
         ALOGV("getNextLayerProcAddress - name(%s) no func_indices entry found", name);
 
-        // Look up which GPA we should use
-        int gpaIndex = func_indices["eglGetProcAddress"];
+        // Look up which GPA we should use, it has the same index in every table
+        static const int gpaIndex = func_indices["eglGetProcAddress"];
         ALOGV("getNextLayerProcAddress - name(%s) gpaIndex(%i) <- using GPA from this index", name, gpaIndex);
         EGLFuncPointer gpaNext = (*next_layer_funcs)[gpaIndex];
         ALOGV("getNextLayerProcAddress - name(%s) gpaIndex(%i) gpaNext(%llu) <- using GPA at this address", name, gpaIndex, (unsigned long long)gpaNext);
@@ -103,20 +104,22 @@ const void* getNextLayerProcAddress(void* layer_id, const char* name) {
         return reinterpret_cast<void*>(val);
     }
 
-    int index = func_indices[name];
+    int index = func_index->second;
     val = (*next_layer_funcs)[index];
     ALOGV("getNextLayerProcAddress - name(%s) index(%i) entry(%llu) - Got a hit, returning known entry", name, index, (unsigned long long)val);
     return reinterpret_cast<void*>(val);
 }
 
+// The entries are walked in the same order for every table, so the name maps only need to be
+// filled in for the first one.
 void SetupFuncMaps(FunctionTable& functions, char const* const* entries, EGLFuncPointer* curr,
-                   int& func_idx) {
+                   int& func_idx, bool map_names) {
     while (*entries) {
         const char* name = *entries;
 
         // Some names overlap, only fill with initial entry
         // This does mean that some indices will not be used
-        if (func_indices.find(name) == func_indices.end()) {
+        if (map_names && func_indices.find(name) == func_indices.end()) {
             ALOGV("SetupFuncMaps - name(%s), func_idx(%i), No entry for func_indices, assigning now", name, func_idx);
             func_names[func_idx] = name;
             func_indices[name] = func_idx;
@@ -224,14 +227,24 @@ void LayerLoader::LayerPlatformEntries(layer_setup_func layer_setup, EGLFuncPoin
     }
 }
 
-void LayerLoader::LayerDriverEntries(layer_setup_func layer_setup, EGLFuncPointer* curr,
-                                     char const* const* entries) {
+std::vector<bool> LayerLoader::FindPlatformEntries(char const* const* entries) {
+    std::vector<bool> platform_entries;
     while (*entries) {
+        platform_entries.push_back(FindPlatformImplAddr(*entries) != nullptr);
+        entries++;
+    }
+    return platform_entries;
+}
+
+void LayerLoader::LayerDriverEntries(layer_setup_func layer_setup, EGLFuncPointer* curr,
+                                     char const* const* entries,
+                                     const std::vector<bool>& platform_entries) {
+    for (size_t i = 0; *entries; i++) {
         char const* name = *entries;
         EGLFuncPointer prev = *curr;
 
         // Only apply layers to driver entries if not handled by the platform
-        if (FindPlatformImplAddr(name) == nullptr) {
+        if (!platform_entries[i]) {
             // Pass the existing entry point into the layer, replace the call with return value
             *curr = ApplyLayer(layer_setup, name, *prev);
 
@@ -273,19 +286,24 @@ void LayerLoader::InitLayers(egl_connection_t* cnx) {
 
     entries = platform_names;
     curr = reinterpret_cast<EGLFuncPointer*>(&cnx->platform);
-    SetupFuncMaps(layer_functions[0], entries, curr, func_idx);
+    SetupFuncMaps(layer_functions[0], entries, curr, func_idx, true);
     ALOGV("InitLayers: func_idx after platform_names: %i", func_idx);
 
     entries = egl_names;
     curr = reinterpret_cast<EGLFuncPointer*>(&cnx->egl);
-    SetupFuncMaps(layer_functions[0], entries, curr, func_idx);
+    SetupFuncMaps(layer_functions[0], entries, curr, func_idx, true);
     ALOGV("InitLayers: func_idx after egl_names: %i", func_idx);
 
     entries = gl_names;
     curr = reinterpret_cast<EGLFuncPointer*>(&cnx->hooks[egl_connection_t::GLESv2_INDEX]->gl);
-    SetupFuncMaps(layer_functions[0], entries, curr, func_idx);
+    SetupFuncMaps(layer_functions[0], entries, curr, func_idx, true);
     ALOGV("InitLayers: func_idx after gl_names: %i", func_idx);
 
+    // Which driver entries the platform handles doesn't depend on the layer, and looking each of
+    // them up is a linear search of the platform entries.
+    const std::vector<bool> egl_platform_entries = FindPlatformEntries(egl_names);
+    const std::vector<bool> gl_platform_entries = FindPlatformEntries(gl_names);
+
     // Walk through each layer's entry points per API, starting just above the driver
     for (current_layer_ = 0; current_layer_ < layer_setup_.size(); current_layer_++) {
         // Init the layer with a key that points to layer just below it
@@ -300,15 +318,15 @@ void LayerLoader::InitLayers(egl_connection_t* cnx) {
         LayerPlatformEntries(layer_setup_[current_layer_], curr, entries);
 
         // Populate next function table after layers have been applied
-        SetupFuncMaps(layer_functions[current_layer_ + 1], entries, curr, func_idx);
+        SetupFuncMaps(layer_functions[current_layer_ + 1], entries, curr, func_idx, false);
 
         // EGL
         entries = egl_names;
         curr = reinterpret_cast<EGLFuncPointer*>(&cnx->egl);
-        LayerDriverEntries(layer_setup_[current_layer_], curr, entries);
+        LayerDriverEntries(layer_setup_[current_layer_], curr, entries, egl_platform_entries);
 
         // Populate next function table after layers have been applied
-        SetupFuncMaps(layer_functions[current_layer_ + 1], entries, curr, func_idx);
+        SetupFuncMaps(layer_functions[current_layer_ + 1], entries, curr, func_idx, false);
 
         // GLES 2+
         // NOTE: We route calls to GLESv2 hooks, not GLESv1, so layering does not support GLES 1.x
@@ -317,10 +335,10 @@ void LayerLoader::InitLayers(egl_connection_t* cnx) {
         // initialization.
         entries = gl_names;
         curr = reinterpret_cast<EGLFuncPointer*>(&cnx->hooks[egl_connection_t::GLESv2_INDEX]->gl);
-        LayerDriverEntries(layer_setup_[current_layer_], curr, entries);
+        LayerDriverEntries(layer_setup_[current_layer_], curr, entries, gl_platform_entries);
 
         // Populate next function table after layers have been applied
-        SetupFuncMaps(layer_functions[current_layer_ + 1], entries, curr, func_idx);
+        SetupFuncMaps(layer_functions[current_layer_ + 1], entries, curr, func_idx, false);
     }
 
     // We only want to apply layers once
@@ -342,19 +360,19 @@ void LayerLoader::LoadLayers() {
     ALOGI("Debug layer list: %s", debug_layers.c_str());
     std::vector<std::string> layers = android::base::Split(debug_layers, ":");
 
+    // The layer paths are the same for every layer
+    std::vector<std::string> paths =
+            android::base::Split(android::GraphicsEnv::getInstance().getLayerPaths().c_str(), ":");
+
+    if (!system_path.empty()) {
+        // Prepend the system paths so they override other layers
+        auto it = paths.begin();
+        paths.insert(it, system_path);
+    }
+
     // Load the layers in reverse order so we start with the driver's entrypoint and work our way up
     for (int32_t i = layers.size() - 1; i >= 0; i--) {
         // Check each layer path for the layer
-        std::vector<std::string> paths =
-                android::base::Split(android::GraphicsEnv::getInstance().getLayerPaths().c_str(),
-                                     ":");
-
-        if (!system_path.empty()) {
-            // Prepend the system paths so they override other layers
-            auto it = paths.begin();
-            paths.insert(it, system_path);
-        }
-
         bool layer_found = false;
         for (uint32_t j = 0; j < paths.size() && !layer_found; j++) {
             std::string layer;
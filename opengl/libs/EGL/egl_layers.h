@@ -47,7 +47,10 @@ public:
     void LoadLayers();
     void InitLayers(egl_connection_t*);
     void LayerPlatformEntries(layer_setup_func layer_setup, EGLFuncPointer*, char const* const*);
-    void LayerDriverEntries(layer_setup_func layer_setup, EGLFuncPointer*, char const* const*);
+    void LayerDriverEntries(layer_setup_func layer_setup, EGLFuncPointer*, char const* const*,
+                            const std::vector<bool>& platform_entries);
+    // Returns whether each of the entries is handled by the platform rather than the driver.
+    static std::vector<bool> FindPlatformEntries(char const* const*);
     bool Initialized();
     std::string GetDebugLayers();
 
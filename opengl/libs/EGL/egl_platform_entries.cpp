@@ -45,6 +45,7 @@
 
 #include "../egl_impl.h"
 
+#include "Loader.h"
 #include "egl_display.h"
 #include "egl_object.h"
 #include "egl_layers.h"
@@ -982,6 +983,7 @@ EGLContext eglCreateContextImpl(EGLDisplay dpy, EGLConfig config,
                 };
             }
             if (version == egl_connection_t::GLESv1_INDEX) {
+                Loader::getInstance().load_gles1(cnx);
                 android::GraphicsEnv::getInstance().setTargetStats(
                         android::GpuStatsInfo::Stats::GLES_1_IN_USE);
             }
@@ -1078,6 +1080,11 @@ EGLBoolean eglMakeCurrentImpl(  EGLDisplay dpy, EGLSurface draw,
         impl_read = r->surface;
     }
 
+    if (c && c == cur_c && c->draw == draw && c->read == read) {
+        // The context and surfaces are already current on this thread, so there is
+        // nothing for the driver to do.
+        return EGL_TRUE;
+    }
 
     EGLBoolean result = dp->makeCurrent(c, cur_c,
             draw, read, ctx,
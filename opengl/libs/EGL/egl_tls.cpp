@@ -19,6 +19,7 @@
 #include <stdlib.h>
 
 #include <android-base/properties.h>
+#include <bionic/tls.h>  /* special private C library header */
 #include <log/log.h>
 #include "CallStack.h"
 #include "egl_platform_entries.h"
@@ -28,6 +29,17 @@ namespace android {
 pthread_key_t egl_tls_t::sKey = TLS_KEY_NOT_INITIALIZED;
 pthread_once_t egl_tls_t::sOnceKey = PTHREAD_ONCE_INIT;
 
+// The thread's egl_tls_t is read by nearly every EGL call, so it is also kept in the bionic TLS
+// slot reserved for OpenGL, which is a plain load rather than a pthread_getspecific() lookup.
+// The pthread key still owns the data, so that it is released when the thread exits.
+static inline egl_tls_t* getTLSSlot() {
+    return static_cast<egl_tls_t*>(__get_tls()[TLS_SLOT_OPENGL]);
+}
+
+static inline void setTLSSlot(egl_tls_t* tls) {
+    __get_tls()[TLS_SLOT_OPENGL] = tls;
+}
+
 egl_tls_t::egl_tls_t()
     : error(EGL_SUCCESS), ctx(nullptr), logCallWithNoContext(true) {
 }
@@ -115,17 +127,23 @@ bool egl_tls_t::logNoContextCall() {
 }
 
 egl_tls_t* egl_tls_t::getTLS() {
-    egl_tls_t* tls = (egl_tls_t*)pthread_getspecific(sKey);
+    egl_tls_t* tls = getTLSSlot();
+    if (tls != nullptr) {
+        return tls;
+    }
+    tls = (egl_tls_t*)pthread_getspecific(sKey);
     if (tls == nullptr) {
         tls = new egl_tls_t;
         pthread_setspecific(sKey, tls);
     }
+    setTLSSlot(tls);
     return tls;
 }
 
 void egl_tls_t::clearTLS() {
     if (sKey != TLS_KEY_NOT_INITIALIZED) {
         egl_tls_t* tls = (egl_tls_t*)pthread_getspecific(sKey);
+        setTLSSlot(nullptr);
         if (tls) {
             pthread_setspecific(sKey, nullptr);
             delete tls;
@@ -143,7 +161,7 @@ EGLint egl_tls_t::getError() {
     if (sKey == TLS_KEY_NOT_INITIALIZED) {
         return EGL_SUCCESS;
     }
-    egl_tls_t* tls = (egl_tls_t*)pthread_getspecific(sKey);
+    egl_tls_t* tls = getTLSSlot();
     if (!tls) {
         return EGL_SUCCESS;
     }
@@ -161,7 +179,7 @@ EGLContext egl_tls_t::getContext() {
     if (sKey == TLS_KEY_NOT_INITIALIZED) {
         return EGL_NO_CONTEXT;
     }
-    egl_tls_t* tls = (egl_tls_t *)pthread_getspecific(sKey);
+    egl_tls_t* tls = getTLSSlot();
     if (!tls) return EGL_NO_CONTEXT;
     return tls->ctx;
 }
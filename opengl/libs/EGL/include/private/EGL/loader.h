@@ -0,0 +1,29 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <cutils/compiler.h>
+
+namespace android {
+
+// Load the GL driver and resolve every client API up front. Regular processes
+// load the GLES 1.x API on demand; zygote calls this while preloading so that
+// children share the resolved driver pages instead of loading them after fork.
+ANDROID_API void egl_preload_drivers();
+
+} // namespace android
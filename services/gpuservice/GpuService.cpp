@@ -26,6 +26,7 @@
 #include <cutils/properties.h>
 #include <gpustats/GpuStats.h>
 #include <private/android_filesystem_config.h>
+#include <shadercache/ShaderCache.h>
 #include <utils/String8.h>
 #include <utils/Trace.h>
 
@@ -45,7 +46,8 @@ const String16 sDump("android.permission.DUMP");
 
 const char* const GpuService::SERVICE_NAME = "gpu";
 
-GpuService::GpuService() : mGpuStats(std::make_unique<GpuStats>()){};
+GpuService::GpuService()
+      : mGpuStats(std::make_unique<GpuStats>()), mShaderCache(std::make_unique<ShaderCache>()){};
 
 void GpuService::setGpuStats(const std::string& driverPackageName,
                              const std::string& driverVersionName, uint64_t driverVersionCode,
@@ -62,6 +64,14 @@ void GpuService::setTargetStats(const std::string& appPackageName, const uint64_
     mGpuStats->insertTargetStats(appPackageName, driverVersionCode, stats, value);
 }
 
+void GpuService::setDriverLoadingStageTime(const std::string& appPackageName,
+                                           const uint64_t driverVersionCode,
+                                           const GpuStatsInfo::Api api, const std::string& stage,
+                                           const int64_t stageTime) {
+    mGpuStats->insertDriverLoadingStageTime(appPackageName, driverVersionCode, api, stage,
+                                            stageTime);
+}
+
 void GpuService::setUpdatableDriverPath(const std::string& driverPath) {
     IPCThreadState* ipc = IPCThreadState::self();
     const int pid = ipc->getCallingPid();
@@ -82,6 +92,16 @@ std::string GpuService::getUpdatableDriverPath() {
     return mDeveloperDriverPath;
 }
 
+void GpuService::setShaderCacheBlob(const std::string& driverKey, const std::vector<uint8_t>& key,
+                                    const std::vector<uint8_t>& value) {
+    mShaderCache->insert(IPCThreadState::self()->getCallingUid(), driverKey, key, value);
+}
+
+std::vector<uint8_t> GpuService::getShaderCacheBlob(const std::string& driverKey,
+                                                    const std::vector<uint8_t>& key) {
+    return mShaderCache->lookup(driverKey, key);
+}
+
 status_t GpuService::shellCommand(int /*in*/, int out, int err, std::vector<String16>& args) {
     ATRACE_CALL();
 
@@ -111,6 +131,7 @@ status_t GpuService::doDump(int fd, const Vector<String16>& args, bool /*asProto
         bool dumpAll = true;
         bool dumpDriverInfo = false;
         bool dumpStats = false;
+        bool dumpShaderCache = false;
         size_t numArgs = args.size();
 
         if (numArgs) {
@@ -119,9 +140,11 @@ status_t GpuService::doDump(int fd, const Vector<String16>& args, bool /*asProto
                     dumpStats = true;
                 } else if (args[index] == String16("--gpudriverinfo")) {
                     dumpDriverInfo = true;
+                } else if (args[index] == String16("--shadercache")) {
+                    dumpShaderCache = true;
                 }
             }
-            dumpAll = !(dumpDriverInfo || dumpStats);
+            dumpAll = !(dumpDriverInfo || dumpStats || dumpShaderCache);
         }
 
         if (dumpAll || dumpDriverInfo) {
@@ -132,6 +155,10 @@ status_t GpuService::doDump(int fd, const Vector<String16>& args, bool /*asProto
             mGpuStats->dump(args, &result);
             result.append("\n");
         }
+        if (dumpAll || dumpShaderCache) {
+            mShaderCache->dump(&result);
+            result.append("\n");
+        }
     }
 
     write(fd, result.c_str(), result.size());
@@ -29,6 +29,7 @@
 namespace android {
 
 class GpuStats;
+class ShaderCache;
 
 class GpuService : public BnGpuService, public PriorityDumper {
 public:
@@ -50,8 +51,15 @@ private:
                      int64_t driverLoadingTime) override;
     void setTargetStats(const std::string& appPackageName, const uint64_t driverVersionCode,
                         const GpuStatsInfo::Stats stats, const uint64_t value) override;
+    void setDriverLoadingStageTime(const std::string& appPackageName,
+                                   const uint64_t driverVersionCode, const GpuStatsInfo::Api api,
+                                   const std::string& stage, const int64_t stageTime) override;
     void setUpdatableDriverPath(const std::string& driverPath) override;
     std::string getUpdatableDriverPath() override;
+    void setShaderCacheBlob(const std::string& driverKey, const std::vector<uint8_t>& key,
+                            const std::vector<uint8_t>& value) override;
+    std::vector<uint8_t> getShaderCacheBlob(const std::string& driverKey,
+                                            const std::vector<uint8_t>& key) override;
 
     /*
      * IBinder interface
@@ -75,6 +83,7 @@ private:
      * Attributes
      */
     std::unique_ptr<GpuStats> mGpuStats;
+    std::unique_ptr<ShaderCache> mShaderCache;
     std::mutex mLock;
     std::string mDeveloperDriverPath;
 };
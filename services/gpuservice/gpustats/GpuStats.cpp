@@ -91,8 +91,6 @@ void GpuStats::insertDriverStats(const std::string& driverPackageName,
                                  bool isDriverLoaded, int64_t driverLoadingTime) {
     ATRACE_CALL();
 
-    std::lock_guard<std::mutex> lock(mLock);
-    registerStatsdCallbacksIfNeeded();
     ALOGV("Received:\n"
           "\tdriverPackageName[%s]\n"
           "\tdriverVersionName[%s]\n"
@@ -107,35 +105,40 @@ void GpuStats::insertDriverStats(const std::string& driverPackageName,
           appPackageName.c_str(), vulkanVersion, static_cast<int32_t>(driver), isDriverLoaded,
           driverLoadingTime);
 
-    if (!mGlobalStats.count(driverVersionCode)) {
-        GpuStatsGlobalInfo globalInfo;
+    {
+        std::lock_guard<std::mutex> lock(mGlobalLock);
+        auto [it, inserted] = mGlobalStats.try_emplace(driverVersionCode);
+        GpuStatsGlobalInfo& globalInfo = it->second;
+        if (inserted) {
+            globalInfo.driverPackageName = driverPackageName;
+            globalInfo.driverVersionName = driverVersionName;
+            globalInfo.driverVersionCode = driverVersionCode;
+            globalInfo.driverBuildTime = driverBuildTime;
+            globalInfo.vulkanVersion = vulkanVersion;
+        }
         addLoadingCount(driver, isDriverLoaded, &globalInfo);
-        globalInfo.driverPackageName = driverPackageName;
-        globalInfo.driverVersionName = driverVersionName;
-        globalInfo.driverVersionCode = driverVersionCode;
-        globalInfo.driverBuildTime = driverBuildTime;
-        globalInfo.vulkanVersion = vulkanVersion;
-        mGlobalStats.insert({driverVersionCode, globalInfo});
-    } else {
-        addLoadingCount(driver, isDriverLoaded, &mGlobalStats[driverVersionCode]);
     }
 
-    const std::string appStatsKey = appPackageName + std::to_string(driverVersionCode);
-    if (!mAppStats.count(appStatsKey)) {
-        if (mAppStats.size() >= MAX_NUM_APP_RECORDS) {
-            ALOGV("GpuStatsAppInfo has reached maximum size. Ignore new stats.");
-            return;
-        }
+    std::lock_guard<std::mutex> lock(mAppLock);
+    registerStatsdCallbacksIfNeeded();
+
+    if (GpuStatsAppInfo* appInfo = findAppStatsLocked(appPackageName, driverVersionCode)) {
+        addLoadingTime(driver, driverLoadingTime, appInfo);
+        return;
+    }
 
-        GpuStatsAppInfo appInfo;
-        addLoadingTime(driver, driverLoadingTime, &appInfo);
-        appInfo.appPackageName = appPackageName;
-        appInfo.driverVersionCode = driverVersionCode;
-        mAppStats.insert({appStatsKey, appInfo});
+    if (mAppStats.size() >= MAX_NUM_APP_RECORDS) {
+        ALOGV("GpuStatsAppInfo has reached maximum size. Ignore new stats.");
         return;
     }
 
-    addLoadingTime(driver, driverLoadingTime, &mAppStats[appStatsKey]);
+    const uint32_t appId =
+            mAppIds.try_emplace(appPackageName, static_cast<uint32_t>(mAppIds.size()))
+                    .first->second;
+    GpuStatsAppInfo& appInfo = mAppStats[{appId, driverVersionCode}];
+    addLoadingTime(driver, driverLoadingTime, &appInfo);
+    appInfo.appPackageName = appPackageName;
+    appInfo.driverVersionCode = driverVersionCode;
 }
 
 void GpuStats::insertTargetStats(const std::string& appPackageName,
@@ -143,29 +146,71 @@ void GpuStats::insertTargetStats(const std::string& appPackageName,
                                  const uint64_t /*value*/) {
     ATRACE_CALL();
 
-    const std::string appStatsKey = appPackageName + std::to_string(driverVersionCode);
-
-    std::lock_guard<std::mutex> lock(mLock);
+    std::lock_guard<std::mutex> lock(mAppLock);
     registerStatsdCallbacksIfNeeded();
-    if (!mAppStats.count(appStatsKey)) {
+    GpuStatsAppInfo* appInfo = findAppStatsLocked(appPackageName, driverVersionCode);
+    if (!appInfo) {
         return;
     }
 
     switch (stats) {
         case GpuStatsInfo::Stats::CPU_VULKAN_IN_USE:
-            mAppStats[appStatsKey].cpuVulkanInUse = true;
+            appInfo->cpuVulkanInUse = true;
             break;
         case GpuStatsInfo::Stats::FALSE_PREROTATION:
-            mAppStats[appStatsKey].falsePrerotation = true;
+            appInfo->falsePrerotation = true;
             break;
         case GpuStatsInfo::Stats::GLES_1_IN_USE:
-            mAppStats[appStatsKey].gles1InUse = true;
+            appInfo->gles1InUse = true;
             break;
         default:
             break;
     }
 }
 
+void GpuStats::insertDriverLoadingStageTime(const std::string& appPackageName,
+                                            const uint64_t driverVersionCode,
+                                            const GpuStatsInfo::Api api, const std::string& stage,
+                                            const int64_t stageTime) {
+    ATRACE_CALL();
+
+    std::lock_guard<std::mutex> lock(mAppLock);
+    GpuStatsAppInfo* appInfo = findAppStatsLocked(appPackageName, driverVersionCode);
+    if (!appInfo) {
+        return;
+    }
+
+    const std::string key = (api == GpuStatsInfo::Api::API_GL ? "gl." : "vk.") + stage;
+    auto stageTimes = appInfo->driverLoadingStageTime.find(key);
+    if (stageTimes == appInfo->driverLoadingStageTime.end()) {
+        if (appInfo->driverLoadingStageTime.size() >= MAX_NUM_LOADING_STAGES) {
+            ALOGV("Driver loading stages have reached maximum size. Ignore stage %s.",
+                  key.c_str());
+            return;
+        }
+        stageTimes = appInfo->driverLoadingStageTime.emplace(key, std::vector<int64_t>()).first;
+    }
+    if (stageTimes->second.size() < MAX_NUM_LOADING_TIMES) {
+        stageTimes->second.emplace_back(stageTime);
+    }
+}
+
+GpuStatsAppInfo* GpuStats::findAppStatsLocked(const std::string& appPackageName,
+                                              uint64_t driverVersionCode) {
+    const auto appId = mAppIds.find(appPackageName);
+    if (appId == mAppIds.end()) {
+        return nullptr;
+    }
+
+    const auto appStats = mAppStats.find({appId->second, driverVersionCode});
+    return appStats != mAppStats.end() ? &appStats->second : nullptr;
+}
+
+void GpuStats::clearAppStatsLocked() {
+    mAppStats.clear();
+    mAppIds.clear();
+}
+
 void GpuStats::interceptSystemDriverStatsLocked() {
     // Append cpuVulkanVersion and glesVersion to system driver stats
     if (!mGlobalStats.count(0) || mGlobalStats[0].glesVersion) {
@@ -194,7 +239,7 @@ void GpuStats::dump(const Vector<String16>& args, std::string* result) {
         return;
     }
 
-    std::lock_guard<std::mutex> lock(mLock);
+    std::scoped_lock lock(mGlobalLock, mAppLock);
     bool dumpAll = true;
 
     std::unordered_set<std::string> argsSet;
@@ -228,13 +273,13 @@ void GpuStats::dump(const Vector<String16>& args, std::string* result) {
         }
 
         if (dumpApp) {
-            mAppStats.clear();
+            clearAppStatsLocked();
             clearAll = false;
         }
 
         if (clearAll) {
             mGlobalStats.clear();
-            mAppStats.clear();
+            clearAppStatsLocked();
         }
     }
 }
@@ -287,7 +332,7 @@ static std::string int64VectorToProtoByteString(const std::vector<int64_t>& valu
 AStatsManager_PullAtomCallbackReturn GpuStats::pullAppInfoAtom(AStatsEventList* data) {
     ATRACE_CALL();
 
-    std::lock_guard<std::mutex> lock(mLock);
+    std::lock_guard<std::mutex> lock(mAppLock);
 
     if (data) {
         for (const auto& ele : mAppStats) {
@@ -312,7 +357,7 @@ AStatsManager_PullAtomCallbackReturn GpuStats::pullAppInfoAtom(AStatsEventList*
         }
     }
 
-    mAppStats.clear();
+    clearAppStatsLocked();
 
     return AStatsManager_PULL_SUCCESS;
 }
@@ -320,7 +365,7 @@ AStatsManager_PullAtomCallbackReturn GpuStats::pullAppInfoAtom(AStatsEventList*
 AStatsManager_PullAtomCallbackReturn GpuStats::pullGlobalInfoAtom(AStatsEventList* data) {
     ATRACE_CALL();
 
-    std::lock_guard<std::mutex> lock(mLock);
+    std::lock_guard<std::mutex> lock(mGlobalLock);
     // flush cpuVulkanVersion and glesVersion to builtin driver stats
     interceptSystemDriverStatsLocked();
 
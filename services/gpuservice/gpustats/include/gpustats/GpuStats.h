@@ -41,11 +41,17 @@ public:
     // Insert target stats into app stats or potentially global stats as well.
     void insertTargetStats(const std::string& appPackageName, const uint64_t driverVersionCode,
                            const GpuStatsInfo::Stats stats, const uint64_t value);
+    // Insert the time of a driver loading stage into app stats.
+    void insertDriverLoadingStageTime(const std::string& appPackageName,
+                                      const uint64_t driverVersionCode, const GpuStatsInfo::Api api,
+                                      const std::string& stage, const int64_t stageTime);
     // dumpsys interface
     void dump(const Vector<String16>& args, std::string* result);
 
     // This limits the worst case number of loading times tracked.
     static const size_t MAX_NUM_LOADING_TIMES = 50;
+    // This limits the number of driver loading stages tracked per app.
+    static const size_t MAX_NUM_LOADING_STAGES = 8;
 
 private:
     // Friend class for testing.
@@ -68,17 +74,42 @@ private:
     // Registers statsd callbacks if they have not already been registered
     void registerStatsdCallbacksIfNeeded();
 
+    // App stats are keyed by the interned app package name and the driver version code, so
+    // that inserting stats doesn't build a string key for every binder call.
+    struct AppStatsKey {
+        uint32_t appId;
+        uint64_t driverVersionCode;
+
+        bool operator==(const AppStatsKey& other) const {
+            return appId == other.appId && driverVersionCode == other.driverVersionCode;
+        }
+    };
+    struct AppStatsKeyHash {
+        size_t operator()(const AppStatsKey& key) const {
+            return std::hash<uint64_t>()(key.driverVersionCode) * 31 + key.appId;
+        }
+    };
+    // Returns the app stats of the app and driver, or nullptr if there are none.
+    GpuStatsAppInfo* findAppStatsLocked(const std::string& appPackageName,
+                                        uint64_t driverVersionCode);
+    // Clear app stats and the interned app package names
+    void clearAppStatsLocked();
+
     // Below limits the memory usage of GpuStats to be less than 10KB. This is
     // the preferred number for statsd while maintaining nice data quality.
     static const size_t MAX_NUM_APP_RECORDS = 100;
-    // GpuStats access should be guarded by mLock.
-    std::mutex mLock;
-    // True if statsd callbacks have been registered.
+    // Global stats and app stats are updated by separate binder calls, so they are guarded
+    // by separate locks. When both are needed, mGlobalLock is taken first.
+    std::mutex mGlobalLock;
+    std::mutex mAppLock;
+    // True if statsd callbacks have been registered, guarded by mAppLock.
     bool mStatsdRegistered = false;
-    // Key is driver version code.
+    // Key is driver version code, guarded by mGlobalLock.
     std::unordered_map<uint64_t, GpuStatsGlobalInfo> mGlobalStats;
-    // Key is <app package name>+<driver version code>.
-    std::unordered_map<std::string, GpuStatsAppInfo> mAppStats;
+    // Interned app package names, guarded by mAppLock.
+    std::unordered_map<std::string, uint32_t> mAppIds;
+    // Guarded by mAppLock.
+    std::unordered_map<AppStatsKey, GpuStatsAppInfo, AppStatsKeyHash> mAppStats;
 };
 
 } // namespace android
@@ -0,0 +1,178 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#undef LOG_TAG
+#define LOG_TAG "ShaderCache"
+#define ATRACE_TAG ATRACE_TAG_GRAPHICS
+
+#include "shadercache/ShaderCache.h"
+
+#include <android-base/stringprintf.h>
+#include <cutils/multiuser.h>
+#include <log/log.h>
+#include <private/android_filesystem_config.h>
+#include <utils/Trace.h>
+
+#include <algorithm>
+#include <cinttypes>
+
+namespace android {
+
+using base::StringAppendF;
+
+static std::string makeKey(const std::string& driverKey, const std::vector<uint8_t>& key) {
+    std::string result;
+    result.reserve(driverKey.size() + 1 + key.size());
+    result.append(driverKey);
+    result.push_back('\0');
+    result.append(key.begin(), key.end());
+    return result;
+}
+
+void ShaderCache::insert(uid_t uid, const std::string& driverKey,
+                         const std::vector<uint8_t>& key, const std::vector<uint8_t>& value) {
+    ATRACE_CALL();
+
+    if (driverKey.empty() || key.empty() || value.empty() || key.size() > MAX_KEY_SIZE ||
+        value.size() > MAX_VALUE_SIZE) {
+        mRejected++;
+        return;
+    }
+
+    // Count the same app running for several users as one contributor.
+    const uid_t appId = multiuser_get_app_id(uid);
+    const bool trusted = appId < AID_APP_START;
+    const std::string cacheKey = makeKey(driverKey, key);
+
+    std::lock_guard<std::shared_mutex> lock(mLock);
+    auto it = mEntries.find(cacheKey);
+    if (it != mEntries.end()) {
+        Entry& entry = it->second;
+        if (entry.value == value) {
+            if (entry.served) return;
+            if (std::find(entry.contributors.begin(), entry.contributors.end(), appId) ==
+                entry.contributors.end()) {
+                entry.contributors.push_back(appId);
+            }
+            if (!trusted && entry.contributors.size() < MIN_APP_CONTRIBUTORS) return;
+
+            // Promote the pending entry, making room for it among served ones.
+            std::string ownKey = *entry.order;
+            mPendingOrder.erase(entry.order);
+            entry.order = mServedOrder.end();
+            const size_t size = cacheKey.size() + value.size();
+            mTotalSize -= size;
+            if (!makeRoomLocked(size, true)) {
+                mEntries.erase(cacheKey);
+                mRejected++;
+                return;
+            }
+            Entry& promoted = mEntries[cacheKey];
+            promoted.served = true;
+            promoted.order = mServedOrder.insert(mServedOrder.end(), std::move(ownKey));
+            mTotalSize += size;
+            mServedSize += size;
+            return;
+        }
+
+        // A served value is never replaced by an untrusted contributor. A
+        // disagreeing pending value restarts the vote.
+        if (entry.served && !trusted) {
+            mRejected++;
+            return;
+        }
+        eraseLocked(cacheKey);
+    }
+
+    const size_t size = cacheKey.size() + value.size();
+    if (!makeRoomLocked(size, trusted)) {
+        mRejected++;
+        return;
+    }
+
+    Entry entry;
+    entry.value = value;
+    entry.contributors.push_back(appId);
+    entry.served = trusted;
+    std::list<std::string>& order = trusted ? mServedOrder : mPendingOrder;
+    entry.order = order.insert(order.end(), cacheKey);
+    mEntries.emplace(cacheKey, std::move(entry));
+    mTotalSize += size;
+    if (trusted) mServedSize += size;
+}
+
+std::vector<uint8_t> ShaderCache::lookup(const std::string& driverKey,
+                                         const std::vector<uint8_t>& key) {
+    ATRACE_CALL();
+
+    const std::string cacheKey = makeKey(driverKey, key);
+
+    std::shared_lock<std::shared_mutex> lock(mLock);
+    const auto it = mEntries.find(cacheKey);
+    if (it == mEntries.end() || !it->second.served) {
+        mMisses++;
+        return {};
+    }
+    mHits++;
+    return it->second.value;
+}
+
+void ShaderCache::eraseLocked(const std::string& key) {
+    auto it = mEntries.find(key);
+    if (it == mEntries.end()) return;
+
+    const size_t size = key.size() + it->second.value.size();
+    mTotalSize -= size;
+    if (it->second.served) {
+        mServedSize -= size;
+        mServedOrder.erase(it->second.order);
+    } else {
+        mPendingOrder.erase(it->second.order);
+    }
+    mEntries.erase(it);
+}
+
+bool ShaderCache::makeRoomLocked(size_t size, bool served) {
+    if (size > MAX_TOTAL_SIZE) return false;
+
+    while (mTotalSize + size > MAX_TOTAL_SIZE) {
+        if (!mPendingOrder.empty()) {
+            eraseLocked(std::string(mPendingOrder.front()));
+        } else if (served && !mServedOrder.empty()) {
+            eraseLocked(std::string(mServedOrder.front()));
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+void ShaderCache::dump(std::string* result) {
+    if (!result) return;
+
+    std::shared_lock<std::shared_mutex> lock(mLock);
+    StringAppendF(result, "Shader cache:\n");
+    StringAppendF(result, "  served entries = %zu\n", mServedOrder.size());
+    StringAppendF(result, "  pending entries = %zu\n", mPendingOrder.size());
+    StringAppendF(result, "  size = %zu / %zu bytes (served %zu)\n", mTotalSize, MAX_TOTAL_SIZE,
+                  mServedSize);
+    StringAppendF(result, "  hits = %" PRIu64 "\n", mHits.load());
+    StringAppendF(result, "  misses = %" PRIu64 "\n", mMisses.load());
+    StringAppendF(result, "  rejected = %" PRIu64 "\n", mRejected.load());
+}
+
+} // namespace android
@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <sys/types.h>
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace android {
+
+// ShaderCache is a system-wide, read-mostly cache of driver-produced program
+// binaries. Entries are keyed by a driver identifier and the key blob handed
+// out by the driver through EGL_ANDROID_blob_cache, so a binary is only ever
+// returned to processes running the driver that produced it.
+//
+// Because binaries are executed by the driver, an entry contributed by an app
+// is only served once enough distinct apps have contributed the same value.
+// Entries contributed by system uids are served immediately. Pending entries
+// never evict served ones, so a single app can't flush the cache.
+class ShaderCache {
+public:
+    ShaderCache() = default;
+
+    // Record a binary produced by the driver identified by driverKey in the
+    // process running as uid.
+    void insert(uid_t uid, const std::string& driverKey, const std::vector<uint8_t>& key,
+                const std::vector<uint8_t>& value);
+    // Return the served binary for key, or an empty vector on a miss.
+    std::vector<uint8_t> lookup(const std::string& driverKey, const std::vector<uint8_t>& key);
+    // dumpsys interface
+    void dump(std::string* result);
+
+    // Size limits, matching the per-process limits of egl_cache.
+    static const size_t MAX_KEY_SIZE = 12 * 1024;
+    static const size_t MAX_VALUE_SIZE = 64 * 1024;
+    // Total bytes of keys and values of served and pending entries.
+    static const size_t MAX_TOTAL_SIZE = 8 * 1024 * 1024;
+    // Number of distinct apps that must agree on a value before serving it.
+    static const size_t MIN_APP_CONTRIBUTORS = 2;
+
+private:
+    struct Entry {
+        std::vector<uint8_t> value;
+        // App ids that contributed value.
+        std::vector<uid_t> contributors;
+        bool served = false;
+        // Position of this entry in mServedOrder or mPendingOrder.
+        std::list<std::string>::iterator order;
+    };
+
+    // Evict the oldest entries until size more bytes fit. Served entries are
+    // only evicted to make room for another served entry. Return false if
+    // there is not enough evictable space.
+    bool makeRoomLocked(size_t size, bool served);
+    void eraseLocked(const std::string& key);
+
+    // ShaderCache access should be guarded by mLock. Lookups only take it shared.
+    std::shared_mutex mLock;
+    // Key is <driver key>+'\0'+<key blob>.
+    std::unordered_map<std::string, Entry> mEntries;
+    // Keys of served and pending mEntries in insertion order, oldest first.
+    std::list<std::string> mServedOrder;
+    std::list<std::string> mPendingOrder;
+    size_t mServedSize = 0;
+    size_t mTotalSize = 0;
+
+    // Counters for dumpsys, atomic so lookups don't need mLock exclusively.
+    std::atomic<uint64_t> mHits = 0;
+    std::atomic<uint64_t> mMisses = 0;
+    std::atomic<uint64_t> mRejected = 0;
+};
+
+} // namespace android
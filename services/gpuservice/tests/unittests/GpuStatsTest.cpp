@@ -32,6 +32,7 @@ namespace android {
 namespace {
 
 using testing::HasSubstr;
+using testing::Not;
 
 // clang-format off
 #define BUILTIN_DRIVER_PKG_NAME   "system"
@@ -221,6 +222,57 @@ TEST_F(GpuStatsTest, canInsertTargetStatsAfterProperSetup) {
     EXPECT_THAT(inputCommand(InputCommand::DUMP_APP), HasSubstr("gles1InUse = 1"));
 }
 
+TEST_F(GpuStatsTest, canInsertTargetStatsForEachAppAndDriver) {
+    mGpuStats->insertDriverStats(BUILTIN_DRIVER_PKG_NAME, BUILTIN_DRIVER_VER_NAME,
+                                 BUILTIN_DRIVER_VER_CODE, BUILTIN_DRIVER_BUILD_TIME, APP_PKG_NAME_1,
+                                 VULKAN_VERSION, GpuStatsInfo::Driver::GL, true,
+                                 DRIVER_LOADING_TIME_1);
+    mGpuStats->insertDriverStats(UPDATED_DRIVER_PKG_NAME, UPDATED_DRIVER_VER_NAME,
+                                 UPDATED_DRIVER_VER_CODE, UPDATED_DRIVER_BUILD_TIME, APP_PKG_NAME_2,
+                                 VULKAN_VERSION, GpuStatsInfo::Driver::GL_UPDATED, true,
+                                 DRIVER_LOADING_TIME_2);
+    // Neither app has stats for the other driver.
+    mGpuStats->insertTargetStats(APP_PKG_NAME_1, UPDATED_DRIVER_VER_CODE,
+                                 GpuStatsInfo::Stats::CPU_VULKAN_IN_USE, 0);
+    mGpuStats->insertTargetStats(APP_PKG_NAME_2, BUILTIN_DRIVER_VER_CODE,
+                                 GpuStatsInfo::Stats::CPU_VULKAN_IN_USE, 0);
+    mGpuStats->insertTargetStats(APP_PKG_NAME_2, UPDATED_DRIVER_VER_CODE,
+                                 GpuStatsInfo::Stats::GLES_1_IN_USE, 0);
+
+    const std::string result = inputCommand(InputCommand::DUMP_APP);
+    EXPECT_THAT(result, HasSubstr("appPackageName = " + std::string(APP_PKG_NAME_1)));
+    EXPECT_THAT(result, HasSubstr("appPackageName = " + std::string(APP_PKG_NAME_2)));
+    EXPECT_THAT(result, Not(HasSubstr("cpuVulkanInUse = 1")));
+    EXPECT_THAT(result, HasSubstr("gles1InUse = 1"));
+}
+
+TEST_F(GpuStatsTest, canInsertDriverLoadingStageTimeAfterProperSetup) {
+    mGpuStats->insertDriverLoadingStageTime(APP_PKG_NAME_1, BUILTIN_DRIVER_VER_CODE,
+                                            GpuStatsInfo::Api::API_GL, "dlopen",
+                                            DRIVER_LOADING_TIME_1);
+    EXPECT_TRUE(inputCommand(InputCommand::DUMP_APP).empty());
+
+    mGpuStats->insertDriverStats(BUILTIN_DRIVER_PKG_NAME, BUILTIN_DRIVER_VER_NAME,
+                                 BUILTIN_DRIVER_VER_CODE, BUILTIN_DRIVER_BUILD_TIME, APP_PKG_NAME_1,
+                                 VULKAN_VERSION, GpuStatsInfo::Driver::GL, true,
+                                 DRIVER_LOADING_TIME_1);
+    mGpuStats->insertDriverLoadingStageTime(APP_PKG_NAME_1, BUILTIN_DRIVER_VER_CODE,
+                                            GpuStatsInfo::Api::API_GL, "dlopen",
+                                            DRIVER_LOADING_TIME_2);
+    mGpuStats->insertDriverLoadingStageTime(APP_PKG_NAME_1, BUILTIN_DRIVER_VER_CODE,
+                                            GpuStatsInfo::Api::API_GL, "dlopen",
+                                            DRIVER_LOADING_TIME_3);
+    mGpuStats->insertDriverLoadingStageTime(APP_PKG_NAME_1, BUILTIN_DRIVER_VER_CODE,
+                                            GpuStatsInfo::Api::API_VK, "init",
+                                            DRIVER_LOADING_TIME_1);
+
+    const std::string result = inputCommand(InputCommand::DUMP_APP);
+    EXPECT_THAT(result,
+                HasSubstr("gl.dlopen: " + std::to_string(DRIVER_LOADING_TIME_2) + " " +
+                          std::to_string(DRIVER_LOADING_TIME_3) + "\n"));
+    EXPECT_THAT(result, HasSubstr("vk.init: " + std::to_string(DRIVER_LOADING_TIME_1) + "\n"));
+}
+
 TEST_F(GpuStatsTest, canDumpAllBeforeClearAll) {
     mGpuStats->insertDriverStats(BUILTIN_DRIVER_PKG_NAME, BUILTIN_DRIVER_VER_NAME,
                                  BUILTIN_DRIVER_VER_CODE, BUILTIN_DRIVER_BUILD_TIME, APP_PKG_NAME_1,
@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#undef LOG_TAG
+#define LOG_TAG "gpuservice_unittest"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <private/android_filesystem_config.h>
+#include <shadercache/ShaderCache.h>
+
+namespace android {
+namespace {
+
+using testing::HasSubstr;
+
+// clang-format off
+#define DRIVER_KEY_1 "driver1"
+#define DRIVER_KEY_2 "driver2"
+#define APP_UID_1    (AID_APP_START + 1)
+#define APP_UID_2    (AID_APP_START + 2)
+// clang-format on
+
+const std::vector<uint8_t> kKey = {'k', 'e', 'y'};
+const std::vector<uint8_t> kValue = {'v', 'a', 'l', 'u', 'e'};
+const std::vector<uint8_t> kOtherValue = {'o', 't', 'h', 'e', 'r'};
+
+class ShaderCacheTest : public testing::Test {
+protected:
+    ShaderCache mCache;
+};
+
+TEST_F(ShaderCacheTest, missOnEmptyCache) {
+    EXPECT_TRUE(mCache.lookup(DRIVER_KEY_1, kKey).empty());
+}
+
+TEST_F(ShaderCacheTest, systemEntryIsServedImmediately) {
+    mCache.insert(AID_SYSTEM, DRIVER_KEY_1, kKey, kValue);
+    EXPECT_EQ(kValue, mCache.lookup(DRIVER_KEY_1, kKey));
+}
+
+TEST_F(ShaderCacheTest, entryIsKeyedByDriver) {
+    mCache.insert(AID_SYSTEM, DRIVER_KEY_1, kKey, kValue);
+    EXPECT_TRUE(mCache.lookup(DRIVER_KEY_2, kKey).empty());
+}
+
+TEST_F(ShaderCacheTest, appEntryNeedsAnotherApp) {
+    mCache.insert(APP_UID_1, DRIVER_KEY_1, kKey, kValue);
+    EXPECT_TRUE(mCache.lookup(DRIVER_KEY_1, kKey).empty());
+
+    mCache.insert(APP_UID_1, DRIVER_KEY_1, kKey, kValue);
+    EXPECT_TRUE(mCache.lookup(DRIVER_KEY_1, kKey).empty());
+
+    mCache.insert(APP_UID_2, DRIVER_KEY_1, kKey, kValue);
+    EXPECT_EQ(kValue, mCache.lookup(DRIVER_KEY_1, kKey));
+}
+
+TEST_F(ShaderCacheTest, sameAppForAnotherUserDoesNotCount) {
+    mCache.insert(APP_UID_1, DRIVER_KEY_1, kKey, kValue);
+    mCache.insert(AID_USER_OFFSET + APP_UID_1, DRIVER_KEY_1, kKey, kValue);
+    EXPECT_TRUE(mCache.lookup(DRIVER_KEY_1, kKey).empty());
+}
+
+TEST_F(ShaderCacheTest, disagreeingAppsDoNotServe) {
+    mCache.insert(APP_UID_1, DRIVER_KEY_1, kKey, kValue);
+    mCache.insert(APP_UID_2, DRIVER_KEY_1, kKey, kOtherValue);
+    EXPECT_TRUE(mCache.lookup(DRIVER_KEY_1, kKey).empty());
+}
+
+TEST_F(ShaderCacheTest, appCannotReplaceServedEntry) {
+    mCache.insert(AID_SYSTEM, DRIVER_KEY_1, kKey, kValue);
+    mCache.insert(APP_UID_1, DRIVER_KEY_1, kKey, kOtherValue);
+    mCache.insert(APP_UID_2, DRIVER_KEY_1, kKey, kOtherValue);
+    EXPECT_EQ(kValue, mCache.lookup(DRIVER_KEY_1, kKey));
+}
+
+TEST_F(ShaderCacheTest, rejectsOversizedValue) {
+    const std::vector<uint8_t> value(ShaderCache::MAX_VALUE_SIZE + 1, 'v');
+    mCache.insert(AID_SYSTEM, DRIVER_KEY_1, kKey, value);
+    EXPECT_TRUE(mCache.lookup(DRIVER_KEY_1, kKey).empty());
+}
+
+TEST_F(ShaderCacheTest, pendingEntriesDoNotEvictServedEntries) {
+    const std::vector<uint8_t> value(ShaderCache::MAX_VALUE_SIZE, 'v');
+    const size_t count = ShaderCache::MAX_TOTAL_SIZE / ShaderCache::MAX_VALUE_SIZE;
+    for (size_t i = 0; i < count * 2; i++) {
+        const std::vector<uint8_t> key = {static_cast<uint8_t>(i), static_cast<uint8_t>(i >> 8)};
+        mCache.insert(i < count / 2 ? AID_SYSTEM : APP_UID_1, DRIVER_KEY_1, key, value);
+    }
+    const std::vector<uint8_t> firstKey = {0, 0};
+    EXPECT_EQ(value, mCache.lookup(DRIVER_KEY_1, firstKey));
+}
+
+TEST_F(ShaderCacheTest, servedEntriesEvictOldestFirst) {
+    const std::vector<uint8_t> value(ShaderCache::MAX_VALUE_SIZE, 'v');
+    const size_t count = ShaderCache::MAX_TOTAL_SIZE / ShaderCache::MAX_VALUE_SIZE;
+    for (size_t i = 0; i < count * 2; i++) {
+        const std::vector<uint8_t> key = {static_cast<uint8_t>(i), static_cast<uint8_t>(i >> 8)};
+        mCache.insert(AID_SYSTEM, DRIVER_KEY_1, key, value);
+    }
+    const std::vector<uint8_t> firstKey = {0, 0};
+    const std::vector<uint8_t> lastKey = {static_cast<uint8_t>(count * 2 - 1),
+                                          static_cast<uint8_t>((count * 2 - 1) >> 8)};
+    EXPECT_TRUE(mCache.lookup(DRIVER_KEY_1, firstKey).empty());
+    EXPECT_EQ(value, mCache.lookup(DRIVER_KEY_1, lastKey));
+}
+
+TEST_F(ShaderCacheTest, dumpCountsHitsAndMisses) {
+    mCache.insert(AID_SYSTEM, DRIVER_KEY_1, kKey, kValue);
+    mCache.lookup(DRIVER_KEY_1, kKey);
+    mCache.lookup(DRIVER_KEY_2, kKey);
+
+    std::string result;
+    mCache.dump(&result);
+    EXPECT_THAT(result, HasSubstr("served entries = 1"));
+    EXPECT_THAT(result, HasSubstr("hits = 1"));
+    EXPECT_THAT(result, HasSubstr("misses = 1"));
+}
+
+} // namespace
+} // namespace android
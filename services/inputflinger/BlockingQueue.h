@@ -69,10 +69,18 @@ public:
         return true;
     };
 
-    void erase(const std::function<bool(const T&)>& lambda) {
+    /**
+     * Remove all elements that match the lambda.
+     * Does not block.
+     * Return the number of elements removed.
+     */
+    size_t erase(const std::function<bool(const T&)>& lambda) {
         std::scoped_lock lock(mLock);
-        mQueue.erase(std::remove_if(mQueue.begin(), mQueue.end(),
-                [&lambda](const T& t) { return lambda(t); }), mQueue.end());
+        auto it = std::remove_if(mQueue.begin(), mQueue.end(),
+                [&lambda](const T& t) { return lambda(t); });
+        const size_t removed = std::distance(it, mQueue.end());
+        mQueue.erase(it, mQueue.end());
+        return removed;
     }
 
     /**
@@ -45,8 +45,9 @@ using namespace android::hardware::input;
 
 namespace android {
 
-//Max number of elements to store in mEvents.
-static constexpr size_t MAX_EVENTS = 5;
+// An ACTION_MOVE that has waited this long for the HAL is not sent to it. The HAL's answer
+// would only be applied to the event after the next one, well over a frame later.
+static constexpr nsecs_t CLASSIFICATION_DEADLINE = 50 * 1000000LL; // 50 ms
 
 template<class K, class V>
 static V getValueForKey(const std::unordered_map<K, V>& map, K key, V defaultValue) {
@@ -71,6 +72,14 @@ static bool isTouchEvent(const NotifyMotionArgs& args) {
     return args.source == AINPUT_SOURCE_TOUCHPAD || args.source == AINPUT_SOURCE_TOUCHSCREEN;
 }
 
+static bool isMoveEvent(const ClassifierEvent& event) {
+    if (event.type != ClassifierEventType::MOTION) {
+        return false;
+    }
+    const NotifyMotionArgs* motionArgs = static_cast<const NotifyMotionArgs*>(event.args.get());
+    return (motionArgs->action & AMOTION_EVENT_ACTION_MASK) == AMOTION_EVENT_ACTION_MOVE;
+}
+
 // --- ClassifierEvent ---
 
 ClassifierEvent::ClassifierEvent(std::unique_ptr<NotifyMotionArgs> args) :
@@ -177,9 +186,15 @@ void MotionClassifier::processEvents() {
         switch (event.type) {
             case ClassifierEventType::MOTION: {
                 NotifyMotionArgs* motionArgs = static_cast<NotifyMotionArgs*>(event.args.get());
+                const nsecs_t startTime = systemTime(SYSTEM_TIME_MONOTONIC);
+                if (shouldSkipMotion(*motionArgs, startTime)) {
+                    // Don't even bother converting the event.
+                    break;
+                }
                 common::V1_0::MotionEvent motionEvent =
                         notifyMotionArgsToHalMotionEvent(*motionArgs);
                 Return<common::V1_0::Classification> response = mService->classify(motionEvent);
+                recordHalLatency(systemTime(SYSTEM_TIME_MONOTONIC) - startTime);
                 halResponseOk = response.isOk();
                 if (halResponseOk) {
                     common::V1_0::Classification halClassification = response;
@@ -214,7 +229,27 @@ void MotionClassifier::processEvents() {
 }
 
 void MotionClassifier::enqueueEvent(ClassifierEvent&& event) {
+    const size_t depth = mEvents.size();
+    {
+        std::scoped_lock lock(mLock);
+        mStats.queueDepths[std::min(depth, MAX_EVENTS)]++;
+    }
+    const bool isMove = isMoveEvent(event);
+    const std::optional<int32_t> deviceId = event.getDeviceId();
     bool eventAdded = mEvents.push(std::move(event));
+    if (!eventAdded && isMove) {
+        // The newest ACTION_MOVE carries the current pointer positions, so the HAL loses
+        // little by skipping the ones that are still waiting.
+        const size_t collapsed = mEvents.erase([deviceId](const ClassifierEvent& pending) {
+            return isMoveEvent(pending) && pending.getDeviceId() == deviceId;
+        });
+        {
+            std::scoped_lock lock(mLock);
+            mStats.collapsed += collapsed;
+        }
+        // A failed push leaves the event untouched, so it can be pushed again.
+        eventAdded = collapsed > 0 && mEvents.push(std::move(event));
+    }
     if (!eventAdded) {
         // If the queue is full, suspect the HAL is slow in processing the events.
         ALOGE("Could not add the event to the queue. Resetting");
@@ -227,6 +262,32 @@ void MotionClassifier::requestExit() {
     mEvents.push(ClassifierEvent::createExitEvent());
 }
 
+bool MotionClassifier::shouldSkipMotion(const NotifyMotionArgs& args, nsecs_t now) {
+    if ((args.action & AMOTION_EVENT_ACTION_MASK) != AMOTION_EVENT_ACTION_MOVE) {
+        return false;
+    }
+    std::scoped_lock lock(mLock);
+    const nsecs_t lastDownTime =
+            getValueForKey(mLastDownTimes, args.deviceId, static_cast<nsecs_t>(0));
+    if (now - args.eventTime > CLASSIFICATION_DEADLINE || args.eventTime < lastDownTime) {
+        mStats.skipped++;
+        return true;
+    }
+    return false;
+}
+
+void MotionClassifier::recordHalLatency(nsecs_t latency) {
+    const int64_t us = ns2us(latency);
+    size_t bucket = 0;
+    if (us > 1) {
+        bucket = std::min<size_t>(63 - __builtin_clzll(static_cast<uint64_t>(us)),
+                                  LATENCY_BUCKET_COUNT - 1);
+    }
+    std::scoped_lock lock(mLock);
+    mStats.classified++;
+    mStats.halLatencies[bucket]++;
+}
+
 void MotionClassifier::updateClassification(int32_t deviceId, nsecs_t eventTime,
         MotionClassification classification) {
     std::scoped_lock lock(mLock);
@@ -312,6 +373,18 @@ void MotionClassifier::dump(std::string& dump) {
     dump += StringPrintf(INDENT2 "mService status: %s\n", getServiceStatus());
     dump += StringPrintf(INDENT2 "mEvents: %zu element(s) (max=%zu)\n",
             mEvents.size(), MAX_EVENTS);
+    dump += StringPrintf(INDENT2 "Classified: %" PRIu64 ", collapsed: %" PRIu64
+                         ", skipped: %" PRIu64 "\n",
+            mStats.classified, mStats.collapsed, mStats.skipped);
+    dump += INDENT2 "Queue depth on enqueue:";
+    for (uint64_t count : mStats.queueDepths) {
+        dump += StringPrintf(" %" PRIu64, count);
+    }
+    dump += "\n" INDENT2 "HAL latency (log2 us):";
+    for (uint64_t count : mStats.halLatencies) {
+        dump += StringPrintf(" %" PRIu64, count);
+    }
+    dump += "\n";
     dump += INDENT2 "mClassifications, mLastDownTimes:\n";
     dump += INDENT3 "Device Id\tClassification\tLast down time";
     // Combine mClassifications and mLastDownTimes into a single table.
@@ -19,6 +19,7 @@
 
 #include <android-base/thread_annotations.h>
 #include <utils/RefBase.h>
+#include <array>
 #include <thread>
 #include <unordered_map>
 
@@ -146,12 +147,25 @@ private:
     explicit MotionClassifier(
             sp<android::hardware::input::classifier::V1_0::IInputClassifier> service);
 
+    // Max number of elements to store in mEvents.
+    static constexpr size_t MAX_EVENTS = 5;
+    // Bucket i of the HAL latency histogram counts calls that took [2^i, 2^(i+1)) microseconds.
+    static constexpr size_t LATENCY_BUCKET_COUNT = 20;
+
     // The events that need to be sent to the HAL.
     BlockingQueue<ClassifierEvent> mEvents;
     /**
      * Add an event to the queue mEvents.
+     * If the queue is full, pending ACTION_MOVE events from the same device are collapsed
+     * into this one before giving up and resetting the HAL.
      */
     void enqueueEvent(ClassifierEvent&& event);
+    /**
+     * Whether the HAL call for this ACTION_MOVE can be skipped, because its classification
+     * would arrive too late to be of use or would be dropped by updateClassification.
+     * Gesture boundaries are always sent, so that the HAL state stays consistent.
+     */
+    bool shouldSkipMotion(const NotifyMotionArgs& args, nsecs_t now);
     /**
      * Thread that will communicate with InputClassifier HAL.
      * This should be the only thread that communicates with InputClassifier HAL,
@@ -204,6 +218,21 @@ private:
 
     void clearDeviceState(int32_t deviceId);
 
+    /**
+     * Queue and HAL statistics, reported in dump().
+     */
+    struct Stats {
+        uint64_t classified = 0;
+        // ACTION_MOVE events dropped from a full queue in favour of a newer one.
+        uint64_t collapsed = 0;
+        // ACTION_MOVE events that were dequeued but not sent to the HAL.
+        uint64_t skipped = 0;
+        // The queue depth found by each new event, indexed by depth.
+        std::array<uint64_t, MAX_EVENTS + 1> queueDepths{};
+        std::array<uint64_t, LATENCY_BUCKET_COUNT> halLatencies{};
+    } mStats GUARDED_BY(mLock);
+    void recordHalLatency(nsecs_t latency);
+
     /**
      * Exit the InputClassifier HAL thread.
      * Useful for tests to ensure proper cleanup.
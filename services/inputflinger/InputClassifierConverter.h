@@ -25,6 +25,8 @@ namespace android {
 
 /**
  * Convert from framework's NotifyMotionArgs to hidl's common::V1_0::MotionEvent
+ * The video frames of the returned event refer to the data held by args, so the event must not
+ * be used once args is gone.
  */
 ::android::hardware::input::common::V1_0::MotionEvent notifyMotionArgsToHalMotionEvent(
         const NotifyMotionArgs& args);
@@ -288,5 +288,29 @@ void QueuedInputListener::flush() {
     mArgsQueue.clear();
 }
 
+void QueuedInputListener::mergeByEventTime(const std::vector<sp<QueuedInputListener>>& listeners) {
+    std::vector<size_t> positions(listeners.size(), 0);
+    for (;;) {
+        // There are only ever a handful of listeners, so a linear scan beats a heap here.
+        ssize_t next = -1;
+        for (size_t i = 0; i < listeners.size(); i++) {
+            const std::vector<NotifyArgs*>& queue = listeners[i]->mArgsQueue;
+            if (positions[i] < queue.size() &&
+                (next < 0 ||
+                 queue[positions[i]]->eventTime <
+                         listeners[next]->mArgsQueue[positions[next]]->eventTime)) {
+                next = i;
+            }
+        }
+        if (next < 0) {
+            break;
+        }
+        mArgsQueue.push_back(listeners[next]->mArgsQueue[positions[next]++]);
+    }
+    for (const sp<QueuedInputListener>& listener : listeners) {
+        listener->mArgsQueue.clear();
+    }
+}
+
 
 } // namespace android
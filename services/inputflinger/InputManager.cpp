@@ -24,8 +24,10 @@
 
 #include <binder/IPCThreadState.h>
 
+#include <inttypes.h>
 #include <log/log.h>
 #include <unordered_map>
+#include <unordered_set>
 
 #include <private/android_filesystem_config.h>
 
@@ -106,10 +108,15 @@ void InputManager::setInputWindows(const std::vector<InputWindowInfo>& infos,
         const sp<ISetInputWindowsListener>& setInputWindowsListener) {
     std::unordered_map<int32_t, std::vector<sp<InputWindowHandle>>> handlesPerDisplay;
 
-    std::vector<sp<InputWindowHandle>> handles;
-    for (const auto& info : infos) {
-        handlesPerDisplay.emplace(info.displayId, std::vector<sp<InputWindowHandle>>());
-        handlesPerDisplay[info.displayId].push_back(new BinderWindowHandle(info));
+    {
+        std::scoped_lock _l(mWindowsLock);
+        mWindowInfosById.clear();
+        mWindowIdsByDisplay.clear();
+        for (const auto& info : infos) {
+            handlesPerDisplay[info.displayId].push_back(new BinderWindowHandle(info));
+            mWindowIdsByDisplay[info.displayId].push_back(info.id);
+            mWindowInfosById.insert_or_assign(info.id, info);
+        }
     }
     mDispatcher->setInputWindows(handlesPerDisplay);
 
@@ -118,6 +125,68 @@ void InputManager::setInputWindows(const std::vector<InputWindowInfo>& infos,
     }
 }
 
+void InputManager::updateInputWindows(const std::vector<InputWindowInfo>& changedWindows,
+        const std::vector<int32_t>& windowIds,
+        const sp<ISetInputWindowsListener>& setInputWindowsListener) {
+    std::unordered_map<int32_t, std::vector<sp<InputWindowHandle>>> handlesPerDisplay;
+
+    {
+        std::scoped_lock _l(mWindowsLock);
+
+        // A display has to be sent to the dispatcher again if any of its windows changed,
+        // or moved to or from another display.
+        std::unordered_set<int32_t> changedDisplays;
+        for (const auto& info : changedWindows) {
+            auto it = mWindowInfosById.find(info.id);
+            if (it != mWindowInfosById.end()) {
+                changedDisplays.insert(it->second.displayId);
+                it->second = info;
+            } else {
+                mWindowInfosById.emplace(info.id, info);
+            }
+            changedDisplays.insert(info.displayId);
+        }
+
+        // Rebuild the window lists from the ids, which drops the removed windows.
+        std::unordered_map<int32_t, InputWindowInfo> windowInfosById;
+        std::unordered_map<int32_t, std::vector<int32_t>> windowIdsByDisplay;
+        for (int32_t id : windowIds) {
+            auto node = mWindowInfosById.extract(id);
+            if (node.empty()) {
+                ALOGE("updateInputWindows: unknown or duplicate window id %" PRId32, id);
+                continue;
+            }
+            windowIdsByDisplay[node.mapped().displayId].push_back(id);
+            windowInfosById.insert(std::move(node));
+        }
+
+        // Displays whose windows are unchanged, in the same order, are skipped. As with
+        // setInputWindows(), displays with no windows left are not sent at all.
+        for (const auto& [displayId, ids] : windowIdsByDisplay) {
+            auto oldIds = mWindowIdsByDisplay.find(displayId);
+            if (changedDisplays.count(displayId) == 0 && oldIds != mWindowIdsByDisplay.end() &&
+                oldIds->second == ids) {
+                continue;
+            }
+            auto& handles = handlesPerDisplay[displayId];
+            handles.reserve(ids.size());
+            for (int32_t id : ids) {
+                handles.push_back(new BinderWindowHandle(windowInfosById.at(id)));
+            }
+        }
+
+        mWindowInfosById = std::move(windowInfosById);
+        mWindowIdsByDisplay = std::move(windowIdsByDisplay);
+    }
+    if (!handlesPerDisplay.empty()) {
+        mDispatcher->setInputWindows(handlesPerDisplay);
+    }
+
+    if (setInputWindowsListener) {
+        setInputWindowsListener->onSetInputWindowsFinished();
+    }
+}
+
 // Used by tests only.
 void InputManager::registerInputChannel(const sp<InputChannel>& channel) {
     IPCThreadState* ipc = IPCThreadState::self();
@@ -277,6 +277,46 @@ static void benchmarkNotifyMotion(benchmark::State& state) {
     dispatcher->stop();
 }
 
+static void benchmarkNotifyMotionStream(benchmark::State& state) {
+    // Create dispatcher
+    sp<FakeInputDispatcherPolicy> fakePolicy = new FakeInputDispatcherPolicy();
+    sp<InputDispatcher> dispatcher = new InputDispatcher(fakePolicy);
+    dispatcher->setInputDispatchMode(/*enabled*/ true, /*frozen*/ false);
+    dispatcher->start();
+
+    // Create a window that will receive motion events
+    sp<FakeApplicationHandle> application = new FakeApplicationHandle();
+    sp<FakeWindowHandle> window = new FakeWindowHandle(application, dispatcher, "Fake Window");
+
+    dispatcher->setInputWindows({{ADISPLAY_ID_DEFAULT, {window}}});
+
+    NotifyMotionArgs motionArgs = generateMotionArgs();
+    motionArgs.action = AMOTION_EVENT_ACTION_DOWN;
+    motionArgs.downTime = now();
+    motionArgs.eventTime = motionArgs.downTime;
+    dispatcher->notifyMotion(&motionArgs);
+    window->consumeEvent();
+
+    // Steady-state ACTION_MOVE stream, as produced by a finger or stylus held on the screen.
+    // Each event is consumed before the next is sent so that the consumer doesn't batch them.
+    int32_t id = 1;
+    for (auto _ : state) {
+        motionArgs.action = AMOTION_EVENT_ACTION_MOVE;
+        motionArgs.id = id++;
+        motionArgs.eventTime = now();
+        dispatcher->notifyMotion(&motionArgs);
+        window->consumeEvent();
+    }
+
+    motionArgs.action = AMOTION_EVENT_ACTION_UP;
+    motionArgs.id = id;
+    motionArgs.eventTime = now();
+    dispatcher->notifyMotion(&motionArgs);
+    window->consumeEvent();
+
+    dispatcher->stop();
+}
+
 static void benchmarkInjectMotion(benchmark::State& state) {
     // Create dispatcher
     sp<FakeInputDispatcherPolicy> fakePolicy = new FakeInputDispatcherPolicy();
@@ -311,6 +351,7 @@ static void benchmarkInjectMotion(benchmark::State& state) {
 }
 
 BENCHMARK(benchmarkNotifyMotion);
+BENCHMARK(benchmarkNotifyMotionStream);
 BENCHMARK(benchmarkInjectMotion);
 
 } // namespace android::inputdispatcher
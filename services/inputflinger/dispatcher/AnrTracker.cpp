@@ -16,15 +16,28 @@
 
 #include "AnrTracker.h"
 
-namespace android::inputdispatcher {
+#include <algorithm>
+#include <limits>
 
-template <typename T>
-static T max(const T& a, const T& b) {
-    return a < b ? b : a;
-}
+namespace android::inputdispatcher {
 
 void AnrTracker::insert(nsecs_t timeoutTime, sp<IBinder> token) {
-    mAnrTimeouts.insert(std::make_pair(timeoutTime, std::move(token)));
+    std::deque<nsecs_t>& timeouts = mTimeoutsByToken[token];
+    if (timeouts.empty() || timeouts.back() <= timeoutTime) {
+        timeouts.push_back(timeoutTime);
+        if (timeouts.size() == 1) {
+            mFirstTimeouts.emplace(timeoutTime, std::move(token));
+        }
+        return;
+    }
+
+    // Out of order, e.g. after the timeout for the connection changed.
+    const nsecs_t firstTimeout = timeouts.front();
+    timeouts.insert(std::upper_bound(timeouts.begin(), timeouts.end(), timeoutTime), timeoutTime);
+    if (timeoutTime < firstTimeout) {
+        mFirstTimeouts.erase(std::make_pair(firstTimeout, token));
+        mFirstTimeouts.emplace(timeoutTime, std::move(token));
+    }
 }
 
 /**
@@ -32,42 +45,57 @@ void AnrTracker::insert(nsecs_t timeoutTime, sp<IBinder> token) {
  * (same time, same connection), then only remove one of them.
  */
 void AnrTracker::erase(nsecs_t timeoutTime, const sp<IBinder>& token) {
-    auto pair = std::make_pair(timeoutTime, token);
-    auto it = mAnrTimeouts.find(pair);
-    if (it != mAnrTimeouts.end()) {
-        mAnrTimeouts.erase(it);
+    auto it = mTimeoutsByToken.find(token);
+    if (it == mTimeoutsByToken.end()) {
+        return;
+    }
+    std::deque<nsecs_t>& timeouts = it->second;
+    if (timeouts.front() == timeoutTime) {
+        timeouts.pop_front();
+        mFirstTimeouts.erase(std::make_pair(timeoutTime, token));
+        if (timeouts.empty()) {
+            mTimeoutsByToken.erase(it);
+        } else {
+            mFirstTimeouts.emplace(timeouts.front(), token);
+        }
+        return;
+    }
+
+    auto timeoutIt = std::lower_bound(timeouts.begin(), timeouts.end(), timeoutTime);
+    if (timeoutIt != timeouts.end() && *timeoutIt == timeoutTime) {
+        timeouts.erase(timeoutIt);
     }
 }
 
 void AnrTracker::eraseToken(const sp<IBinder>& token) {
-    for (auto it = mAnrTimeouts.begin(); it != mAnrTimeouts.end();) {
-        if (it->second == token) {
-            it = mAnrTimeouts.erase(it);
-        } else {
-            ++it;
-        }
+    auto it = mTimeoutsByToken.find(token);
+    if (it == mTimeoutsByToken.end()) {
+        return;
     }
+    mFirstTimeouts.erase(std::make_pair(it->second.front(), token));
+    mTimeoutsByToken.erase(it);
 }
 
 bool AnrTracker::empty() const {
-    return mAnrTimeouts.empty();
+    return mFirstTimeouts.empty();
 }
 
 // If empty() is false, return the time at which the next connection should cause an ANR
 // If empty() is true, return LONG_LONG_MAX
 nsecs_t AnrTracker::firstTimeout() const {
-    if (mAnrTimeouts.empty()) {
+    if (mFirstTimeouts.empty()) {
         return std::numeric_limits<nsecs_t>::max();
     }
-    return mAnrTimeouts.begin()->first;
+    return mFirstTimeouts.begin()->first;
 }
 
 const sp<IBinder>& AnrTracker::firstToken() const {
-    return mAnrTimeouts.begin()->second;
+    return mFirstTimeouts.begin()->second;
 }
 
 void AnrTracker::clear() {
-    mAnrTimeouts.clear();
+    mTimeoutsByToken.clear();
+    mFirstTimeouts.clear();
 }
 
 } // namespace android::inputdispatcher
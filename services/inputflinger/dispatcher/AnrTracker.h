@@ -19,7 +19,9 @@
 
 #include <binder/IBinder.h>
 #include <utils/Timers.h>
+#include <deque>
 #include <set>
+#include <unordered_map>
 
 namespace android::inputdispatcher {
 
@@ -43,16 +45,24 @@ public:
     const sp<IBinder>& firstToken() const;
 
 private:
-    // Optimization: use a multiset to keep track of the event timeouts. When an event is sent
-    // to the InputConsumer, we add an entry to this structure. We look at the smallest value to
-    // determine if any of the connections is unresponsive, and to determine when we should wake
-    // next for the future ANR check.
-    // Using a multiset helps quickly look up the next timeout due.
+    struct IBinderHash {
+        std::size_t operator()(const sp<IBinder>& b) const {
+            return std::hash<IBinder*>{}(b.get());
+        }
+    };
+
+    // Optimization: one entry is added for every event sent to the InputConsumer, and removed
+    // when the consumer finishes it. A connection's events all use the same timeout and are
+    // usually finished in order, so each connection keeps its own sorted queue of timeouts, where
+    // new entries are appended at the back and finished ones are removed from the front.
     //
-    // We must use a multi-set, because it is plausible (although highly unlikely) to have entries
+    // Duplicates are allowed, because it is plausible (although highly unlikely) to have entries
     // from the same connection and same timestamp, but different sequence numbers.
-    // We are not tracking sequence numbers, and just allow duplicates to exist.
-    std::multiset<std::pair<nsecs_t /*timeoutTime*/, sp<IBinder> /*connectionToken*/>> mAnrTimeouts;
+    std::unordered_map<sp<IBinder>, std::deque<nsecs_t>, IBinderHash> mTimeoutsByToken;
+    // The earliest timeout of every connection in mTimeoutsByToken. The smallest value determines
+    // whether any connection is unresponsive, and when we should wake next for the ANR check.
+    // This only changes when the front of a connection's queue changes.
+    std::set<std::pair<nsecs_t /*timeoutTime*/, sp<IBinder> /*connectionToken*/>> mFirstTimeouts;
 };
 
 } // namespace android::inputdispatcher
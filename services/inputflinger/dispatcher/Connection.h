@@ -52,6 +52,9 @@ public:
     // application consumes some of the input.
     bool responsive = true;
 
+    // True if the connection is waiting for its outbound queue to be published.
+    bool publishPending = false;
+
     // Queue of events that need to be published to the connection.
     std::deque<DispatchEntry*> outboundQueue;
 
@@ -22,12 +22,78 @@
 #include <android-base/stringprintf.h>
 #include <cutils/atomic.h>
 #include <inttypes.h>
+#include <mutex>
 
 using android::base::GetBoolProperty;
 using android::base::StringPrintf;
 
 namespace android::inputdispatcher {
 
+namespace {
+
+// A bounded free list of fixed-size blocks. Key, motion and dispatch entries are
+// created and destroyed for every input event; recycling a handful of blocks keeps a
+// steady stream of events (e.g. 240Hz+ touch or stylus) from going through the heap.
+// Entries are created on the reader thread and destroyed on the dispatcher thread, so
+// the list has its own lock rather than relying on the dispatcher lock.
+template <size_t kBlockSize, size_t kMaxFreeBlocks>
+class EntryPool {
+public:
+    void* allocate(size_t size) {
+        if (size == kBlockSize) {
+            std::scoped_lock _l(mLock);
+            if (mFreeList != nullptr) {
+                FreeBlock* block = mFreeList;
+                mFreeList = block->next;
+                mFreeCount--;
+                return block;
+            }
+        }
+        return ::operator new(size);
+    }
+
+    void release(void* ptr) {
+        {
+            std::scoped_lock _l(mLock);
+            if (mFreeCount < kMaxFreeBlocks) {
+                FreeBlock* block = static_cast<FreeBlock*>(ptr);
+                block->next = mFreeList;
+                mFreeList = block;
+                mFreeCount++;
+                return;
+            }
+        }
+        ::operator delete(ptr);
+    }
+
+private:
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+    static_assert(kBlockSize >= sizeof(FreeBlock));
+
+    std::mutex mLock;
+    FreeBlock* mFreeList = nullptr;
+    size_t mFreeCount = 0;
+};
+
+// Only blocks of exactly kBlockSize are handed out from the free list, and only entries
+// allocated through the matching operator new are released into it, so every block on
+// the list is large enough to hold the entry type it is reused for.
+using KeyEntryPool = EntryPool<sizeof(KeyEntry), 16>;
+using MotionEntryPool = EntryPool<sizeof(MotionEntry), 16>;
+using DispatchEntryPool = EntryPool<sizeof(DispatchEntry), 64>;
+
+// Intentionally leaked so that entries released during static destruction still have
+// somewhere to go.
+template <typename Pool>
+Pool& getPool() {
+    static Pool* sPool = new Pool();
+    return *sPool;
+}
+
+} // namespace
+
 VerifiedKeyEvent verifiedKeyEventFromKeyEntry(const KeyEntry& entry) {
     return {{VerifiedInputEvent::Type::KEY, entry.deviceId, entry.eventTime, entry.source,
              entry.displayId},
@@ -64,7 +130,8 @@ EventEntry::EventEntry(int32_t id, Type type, nsecs_t eventTime, uint32_t policy
         eventTime(eventTime),
         policyFlags(policyFlags),
         injectionState(nullptr),
-        dispatchInProgress(false) {}
+        dispatchInProgress(false),
+        dispatchTime(0) {}
 
 EventEntry::~EventEntry() {
     releaseInjectionState();
@@ -151,6 +218,14 @@ KeyEntry::KeyEntry(int32_t id, nsecs_t eventTime, int32_t deviceId, uint32_t sou
 
 KeyEntry::~KeyEntry() {}
 
+void* KeyEntry::operator new(size_t size) {
+    return getPool<KeyEntryPool>().allocate(size);
+}
+
+void KeyEntry::operator delete(void* ptr) {
+    getPool<KeyEntryPool>().release(ptr);
+}
+
 void KeyEntry::appendDescription(std::string& msg) const {
     msg += StringPrintf("KeyEvent");
     if (!GetBoolProperty("ro.debuggable", false)) {
@@ -211,6 +286,14 @@ MotionEntry::MotionEntry(int32_t id, nsecs_t eventTime, int32_t deviceId, uint32
 
 MotionEntry::~MotionEntry() {}
 
+void* MotionEntry::operator new(size_t size) {
+    return getPool<MotionEntryPool>().allocate(size);
+}
+
+void MotionEntry::operator delete(void* ptr) {
+    getPool<MotionEntryPool>().release(ptr);
+}
+
 void MotionEntry::appendDescription(std::string& msg) const {
     msg += StringPrintf("MotionEvent");
     if (!GetBoolProperty("ro.debuggable", false)) {
@@ -261,6 +344,14 @@ DispatchEntry::~DispatchEntry() {
     eventEntry->release();
 }
 
+void* DispatchEntry::operator new(size_t size) {
+    return getPool<DispatchEntryPool>().allocate(size);
+}
+
+void DispatchEntry::operator delete(void* ptr) {
+    getPool<DispatchEntryPool>().release(ptr);
+}
+
 uint32_t DispatchEntry::nextSeq() {
     // Sequence number 0 is reserved and will never be returned.
     uint32_t seq;
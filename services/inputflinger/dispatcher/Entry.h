@@ -26,6 +26,7 @@
 #include <utils/Timers.h>
 #include <functional>
 #include <string>
+#include <vector>
 
 namespace android::inputdispatcher {
 
@@ -61,6 +62,8 @@ struct EventEntry {
     InjectionState* injectionState;
 
     bool dispatchInProgress; // initially false, set to true while dispatching
+    // Time when the dispatcher took the event off its inbound queue, or 0 until then.
+    nsecs_t dispatchTime;
 
     /**
      * Injected keys are events from an external (probably untrusted) application
@@ -149,6 +152,10 @@ struct KeyEntry : EventEntry {
     virtual void appendDescription(std::string& msg) const;
     void recycle();
 
+    // Recycled through a small free list; see Entry.cpp.
+    static void* operator new(size_t size);
+    static void operator delete(void* ptr);
+
 protected:
     virtual ~KeyEntry();
 };
@@ -183,6 +190,10 @@ struct MotionEntry : EventEntry {
                 float xOffset, float yOffset);
     virtual void appendDescription(std::string& msg) const;
 
+    // Recycled through a small free list; see Entry.cpp.
+    static void* operator new(size_t size);
+    static void operator delete(void* ptr);
+
 protected:
     virtual ~MotionEntry();
 };
@@ -213,6 +224,10 @@ struct DispatchEntry {
                   float globalScaleFactor, float windowXScale, float windowYScale);
     ~DispatchEntry();
 
+    // Recycled through a small free list; see Entry.cpp.
+    static void* operator new(size_t size);
+    static void operator delete(void* ptr);
+
     inline bool hasForegroundTarget() const { return targetFlags & InputTarget::FLAG_FOREGROUND; }
 
     inline bool isSplit() const { return targetFlags & InputTarget::FLAG_SPLIT; }
@@ -260,7 +275,8 @@ struct CommandEntry {
     sp<InputApplicationHandle> inputApplicationHandle;
     std::string reason;
     int32_t userActivityEventType;
-    uint32_t seq;
+    // Dispatch entries acknowledged together, oldest first.
+    std::vector<uint32_t> seqs;
     bool handled;
     sp<InputChannel> inputChannel;
     sp<IBinder> oldToken;
@@ -58,6 +58,7 @@ static constexpr bool DEBUG_FOCUS = false;
 #include <sstream>
 
 #include <android-base/chrono_utils.h>
+#include <android-base/scopeguard.h>
 #include <android-base/stringprintf.h>
 #include <binder/Binder.h>
 #include <input/InputDevice.h>
@@ -258,6 +259,50 @@ static bool isStaleEvent(nsecs_t currentTime, const EventEntry& entry) {
     return currentTime - entry.eventTime >= STALE_EVENT_TIMEOUT;
 }
 
+/**
+ * Whether 'newer' only moves the pointers of 'older' along, so that once 'newer' is queued
+ * behind it, 'older' can be dropped without anyone downstream losing track of the gesture.
+ * Injected events are never coalesced since their injectors wait on each one.
+ */
+static bool canCoalesceMotion(const MotionEntry& older, const MotionEntry& newer) {
+    if (newer.action != AMOTION_EVENT_ACTION_MOVE &&
+        newer.action != AMOTION_EVENT_ACTION_HOVER_MOVE) {
+        return false;
+    }
+    if (older.action != newer.action || older.isInjected() || newer.isInjected()) {
+        return false;
+    }
+    if (older.deviceId != newer.deviceId || older.source != newer.source ||
+        older.displayId != newer.displayId || older.policyFlags != newer.policyFlags ||
+        older.flags != newer.flags || older.metaState != newer.metaState ||
+        older.buttonState != newer.buttonState || older.actionButton != newer.actionButton ||
+        older.classification != newer.classification || older.edgeFlags != newer.edgeFlags ||
+        older.pointerCount != newer.pointerCount) {
+        return false;
+    }
+    for (uint32_t i = 0; i < newer.pointerCount; i++) {
+        if (older.pointerProperties[i] != newer.pointerProperties[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool canCoalesceDispatchEntries(const DispatchEntry& older, const DispatchEntry& newer) {
+    if (older.eventEntry->type != EventEntry::Type::MOTION ||
+        newer.eventEntry->type != EventEntry::Type::MOTION) {
+        return false;
+    }
+    if (older.targetFlags != newer.targetFlags || older.resolvedAction != newer.resolvedAction ||
+        older.resolvedFlags != newer.resolvedFlags || older.xOffset != newer.xOffset ||
+        older.yOffset != newer.yOffset || older.globalScaleFactor != newer.globalScaleFactor ||
+        older.windowXScale != newer.windowXScale || older.windowYScale != newer.windowYScale) {
+        return false;
+    }
+    return canCoalesceMotion(static_cast<const MotionEntry&>(*older.eventEntry),
+                             static_cast<const MotionEntry&>(*newer.eventEntry));
+}
+
 static std::unique_ptr<DispatchEntry> createDispatchEntry(const InputTarget& inputTarget,
                                                           EventEntry* eventEntry,
                                                           int32_t inputTargetFlags) {
@@ -349,7 +394,14 @@ static std::array<uint8_t, 128> getRandomKey() {
 
 // --- HmacKeyManager ---
 
-HmacKeyManager::HmacKeyManager() : mHmacKey(getRandomKey()) {}
+HmacKeyManager::HmacKeyManager() : mHmacKey(getRandomKey()) {
+    // The key is longer than a SHA256 block, so setting it up costs more hashing than signing
+    // a verified event does. Do it once rather than on every sign() call.
+    if (!HMAC_Init_ex(mKeyedContext.get(), mHmacKey.data(), mHmacKey.size(), EVP_sha256(),
+                      nullptr)) {
+        LOG_ALWAYS_FATAL("Can't initialize HMAC context");
+    }
+}
 
 std::array<uint8_t, 32> HmacKeyManager::sign(const VerifiedInputEvent& event) const {
     size_t size;
@@ -371,9 +423,10 @@ std::array<uint8_t, 32> HmacKeyManager::sign(const uint8_t* data, size_t size) c
     // SHA256 always generates 32-bytes result
     std::array<uint8_t, 32> hash;
     unsigned int hashLen = 0;
-    uint8_t* result =
-            HMAC(EVP_sha256(), mHmacKey.data(), mHmacKey.size(), data, size, hash.data(), &hashLen);
-    if (result == nullptr) {
+    bssl::ScopedHMAC_CTX context;
+    if (!HMAC_CTX_copy_ex(context.get(), mKeyedContext.get()) ||
+        !HMAC_Update(context.get(), data, size) ||
+        !HMAC_Final(context.get(), hash.data(), &hashLen)) {
         ALOGE("Could not sign the data using HMAC");
         return INVALID_HMAC;
     }
@@ -403,7 +456,8 @@ InputDispatcher::InputDispatcher(const sp<InputDispatcherPolicyInterface>& polic
         // To avoid leaking stack in case that call never comes, and for tests,
         // initialize it here anyways.
         mInTouchMode(true),
-        mFocusedDisplayId(ADISPLAY_ID_DEFAULT) {
+        mFocusedDisplayId(ADISPLAY_ID_DEFAULT),
+        mDispatcherTid(-1) {
     mLooper = new Looper(false);
     mReporter = createInputReporter();
 
@@ -447,8 +501,10 @@ status_t InputDispatcher::stop() {
 
 void InputDispatcher::dispatchOnce() {
     nsecs_t nextWakeupTime = LONG_LONG_MAX;
+    bool havePendingPublishes;
     { // acquire lock
         std::scoped_lock _l(mLock);
+        mDispatcherTid = gettid();
         mDispatcherIsAlive.notify_all();
 
         // Run a dispatch loop if there are no pending commands.
@@ -470,11 +526,18 @@ void InputDispatcher::dispatchOnce() {
 
         // We are about to enter an infinitely long sleep, because we have no commands or
         // pending or queued events
-        if (nextWakeupTime == LONG_LONG_MAX) {
+        havePendingPublishes = !mConnectionsToPublish.empty();
+        if (nextWakeupTime == LONG_LONG_MAX && !havePendingPublishes) {
             mDispatcherEnteredIdle.notify_all();
         }
     } // release lock
 
+    // Write out the events queued above. This takes the lock again only to prepare the
+    // messages and to handle the results, not for the writes themselves.
+    if (havePendingPublishes) {
+        publishPendingConnections(&nextWakeupTime);
+    }
+
     // Wait for callback or timeout or wake.  (make sure we round up, not down)
     nsecs_t currentTime = now();
     int timeoutMillis = toMillisecondTimeoutDelay(currentTime, nextWakeupTime);
@@ -586,6 +649,7 @@ void InputDispatcher::dispatchOnceInnerLocked(nsecs_t* nextWakeupTime) {
             // Inbound queue has at least one entry.
             mPendingEvent = mInboundQueue.front();
             mInboundQueue.pop_front();
+            mPendingEvent->dispatchTime = currentTime;
             traceInboundQueueLengthLocked();
         }
 
@@ -742,6 +806,12 @@ bool InputDispatcher::shouldPruneInboundQueueLocked(const MotionEntry& motionEnt
 }
 
 bool InputDispatcher::enqueueInboundEventLocked(EventEntry* entry) {
+    if (entry->type == EventEntry::Type::MOTION &&
+        coalesceInboundMotionLocked(static_cast<MotionEntry*>(entry))) {
+        // The queue already had the entry's predecessor in it, so the dispatcher is awake.
+        return false;
+    }
+
     bool needWake = mInboundQueue.empty();
     mInboundQueue.push_back(entry);
     traceInboundQueueLengthLocked();
@@ -790,6 +860,27 @@ bool InputDispatcher::enqueueInboundEventLocked(EventEntry* entry) {
     return needWake;
 }
 
+bool InputDispatcher::coalesceInboundMotionLocked(MotionEntry* entry) {
+    if (mInboundQueue.empty()) {
+        return false;
+    }
+    // A move that is still queued when the next one for the same pointers arrives means the
+    // dispatcher is behind. Deliver only the latest position rather than let the backlog grow.
+    EventEntry* last = mInboundQueue.back();
+    if (last->type != EventEntry::Type::MOTION || last->refCount != 1 ||
+        last->dispatchInProgress || last == mNextUnblockedEvent ||
+        !canCoalesceMotion(static_cast<const MotionEntry&>(*last), *entry)) {
+        return false;
+    }
+#if DEBUG_INBOUND_EVENT_DETAILS
+    ALOGD("Coalescing inbound motion event id=0x%" PRIx32 " into id=0x%" PRIx32, last->id,
+          entry->id);
+#endif
+    mInboundQueue.back() = entry;
+    last->release();
+    return true;
+}
+
 void InputDispatcher::addRecentEventLocked(EventEntry* entry) {
     entry->refCount += 1;
     mRecentQueue.push_back(entry);
@@ -807,9 +898,15 @@ sp<InputWindowHandle> InputDispatcher::findTouchedWindowAtLocked(int32_t display
         LOG_ALWAYS_FATAL(
                 "Must provide a valid touch state if adding portal windows or outside targets");
     }
-    // Traverse windows from front to back to find touched window.
-    const std::vector<sp<InputWindowHandle>> windowHandles = getWindowHandlesLocked(displayId);
-    for (const sp<InputWindowHandle>& windowHandle : windowHandles) {
+    auto indexIt = mWindowIndexByDisplay.find(displayId);
+    if (indexIt == mWindowIndexByDisplay.end()) {
+        return nullptr;
+    }
+    const WindowIndex& windowIndex = indexIt->second;
+    // Traverse windows from front to back to find touched window. The index leaves out
+    // windows that can neither take this touch nor be told about it as an outside touch.
+    for (uint32_t zOrder : windowIndex.touchCandidatesAt(x, y)) {
+        const sp<InputWindowHandle>& windowHandle = windowIndex.windowAt(zOrder);
         const InputWindowInfo* windowInfo = windowHandle->getInfo();
         if (windowInfo->displayId == displayId) {
             int32_t flags = windowInfo->layoutParamsFlags;
@@ -1191,7 +1288,10 @@ bool InputDispatcher::dispatchKeyLocked(nsecs_t currentTime, KeyEntry* entry,
     }
 
     // Identify targets.
-    std::vector<InputTarget> inputTargets;
+    std::vector<InputTarget>& inputTargets = mTempInputTargets;
+    inputTargets.clear();
+    auto clearTargets =
+            android::base::make_scope_guard([&inputTargets] { inputTargets.clear(); });
     int32_t injectionResult =
             findFocusedWindowTargetsLocked(currentTime, *entry, inputTargets, nextWakeupTime);
     if (injectionResult == INPUT_EVENT_INJECTION_PENDING) {
@@ -1243,7 +1343,10 @@ bool InputDispatcher::dispatchMotionLocked(nsecs_t currentTime, MotionEntry* ent
     bool isPointerEvent = entry->source & AINPUT_SOURCE_CLASS_POINTER;
 
     // Identify targets.
-    std::vector<InputTarget> inputTargets;
+    std::vector<InputTarget>& inputTargets = mTempInputTargets;
+    inputTargets.clear();
+    auto clearTargets =
+            android::base::make_scope_guard([&inputTargets] { inputTargets.clear(); });
 
     bool conflictingPointerActions = false;
     int32_t injectionResult;
@@ -1586,12 +1689,16 @@ int32_t InputDispatcher::findTouchedWindowTargetsLocked(nsecs_t currentTime,
     // This state will be used to update mTouchStatesByDisplay at the end of this function.
     // If no state for the specified display exists, then our initial state will be empty.
     const TouchState* oldState = nullptr;
-    TouchState tempTouchState;
+    TouchState& tempTouchState = mTempTouchState;
+    auto resetTouchState =
+            android::base::make_scope_guard([&tempTouchState] { tempTouchState.reset(); });
     std::unordered_map<int32_t, TouchState>::iterator oldStateIt =
             mTouchStatesByDisplay.find(displayId);
     if (oldStateIt != mTouchStatesByDisplay.end()) {
         oldState = &(oldStateIt->second);
         tempTouchState.copyFrom(*oldState);
+    } else {
+        tempTouchState.reset();
     }
 
     bool isSplit = tempTouchState.split;
@@ -2103,13 +2210,19 @@ static bool canBeObscuredBy(const sp<InputWindowHandle>& windowHandle,
 bool InputDispatcher::isWindowObscuredAtPointLocked(const sp<InputWindowHandle>& windowHandle,
                                                     int32_t x, int32_t y) const {
     int32_t displayId = windowHandle->getInfo()->displayId;
-    const std::vector<sp<InputWindowHandle>> windowHandles = getWindowHandlesLocked(displayId);
-    for (const sp<InputWindowHandle>& otherHandle : windowHandles) {
-        if (windowHandle == otherHandle) {
+    auto indexIt = mWindowIndexByDisplay.find(displayId);
+    if (indexIt == mWindowIndexByDisplay.end()) {
+        return false;
+    }
+    const WindowIndex& windowIndex = indexIt->second;
+    const uint32_t windowZOrder = windowIndex.zOrderOf(windowHandle);
+    for (uint32_t zOrder : windowIndex.frameCandidatesAt(x, y)) {
+        if (zOrder >= windowZOrder) {
             break; // All future windows are below us. Exit early.
         }
+        const sp<InputWindowHandle>& otherHandle = windowIndex.windowAt(zOrder);
         const InputWindowInfo* otherInfo = otherHandle->getInfo();
-          if (canBeObscuredBy(windowHandle, otherHandle) &&
+        if (canBeObscuredBy(windowHandle, otherHandle) &&
             otherInfo->frameContainsPoint(x, y)) {
             return true;
         }
@@ -2425,6 +2538,15 @@ void InputDispatcher::enqueueDispatchEntryLocked(const sp<Connection>& connectio
         incrementPendingForegroundDispatches(newEntry);
     }
 
+    // A move still waiting in the outbound queue is superseded by this one. This happens when
+    // the connection's socket is full because the app is slow to consume.
+    if (!connection->outboundQueue.empty() &&
+        canCoalesceDispatchEntries(*connection->outboundQueue.back(), *dispatchEntry)) {
+        DispatchEntry* staleEntry = connection->outboundQueue.back();
+        connection->outboundQueue.pop_back();
+        releaseDispatchEntry(staleEntry);
+    }
+
     // Enqueue the dispatch entry.
     connection->outboundQueue.push_back(dispatchEntry.release());
     traceOutboundQueueLength(connection);
@@ -2460,15 +2582,75 @@ void InputDispatcher::dispatchPointerDownOutsideFocus(uint32_t source, int32_t a
 
 void InputDispatcher::startDispatchCycleLocked(nsecs_t currentTime,
                                                const sp<Connection>& connection) {
-    if (ATRACE_ENABLED()) {
-        std::string message = StringPrintf("startDispatchCycleLocked(inputChannel=%s)",
-                                           connection->getInputChannelName().c_str());
-        ATRACE_NAME(message.c_str());
-    }
 #if DEBUG_DISPATCH_CYCLE
     ALOGD("channel '%s' ~ startDispatchCycle", connection->getInputChannelName().c_str());
 #endif
 
+    if (connection->publishPending) {
+        return;
+    }
+    connection->publishPending = true;
+    mConnectionsToPublish.push_back(connection);
+    if (gettid() != mDispatcherTid) {
+        mLooper->wake();
+    }
+}
+
+void InputDispatcher::publishPendingConnections(nsecs_t* nextWakeupTime) {
+    ATRACE_CALL();
+    mOutboundMessages.clear();
+    mOutboundBatches.clear();
+
+    { // acquire lock
+        std::scoped_lock _l(mLock);
+        for (const sp<Connection>& connection : mConnectionsToPublish) {
+            connection->publishPending = false;
+            prepareOutboundMessagesLocked(connection);
+        }
+        mConnectionsToPublish.clear();
+    } // release lock
+
+    // Only this thread uses the publishers, so no lock is needed for the writes. The sockets
+    // are non-blocking: a full socket fails that connection's batch with WOULD_BLOCK without
+    // holding up the others.
+    for (OutboundBatch& batch : mOutboundBatches) {
+        for (size_t i = batch.begin; i < batch.end; i++) {
+            batch.status =
+                    publishOutboundMessage(batch.connection->inputPublisher, mOutboundMessages[i]);
+            if (batch.status) {
+                batch.failedAt = i;
+                break;
+            }
+        }
+    }
+
+    { // acquire lock
+        std::scoped_lock _l(mLock);
+        for (const OutboundBatch& batch : mOutboundBatches) {
+            finishOutboundBatchLocked(batch);
+        }
+
+        // A broken connection posts commands; run them before going to sleep.
+        if (haveCommandsLocked()) {
+            *nextWakeupTime = LONG_LONG_MIN;
+        }
+        if (*nextWakeupTime == LONG_LONG_MAX && mConnectionsToPublish.empty()) {
+            mDispatcherEnteredIdle.notify_all();
+        }
+    } // release lock
+
+    // Drop the connection references now rather than on the next round.
+    mOutboundBatches.clear();
+}
+
+void InputDispatcher::prepareOutboundMessagesLocked(const sp<Connection>& connection) {
+    const nsecs_t currentTime = now();
+    OutboundBatch batch;
+    batch.connection = connection;
+    batch.begin = mOutboundMessages.size();
+    batch.anrTracked = connection->responsive;
+    batch.status = OK;
+
     while (connection->status == Connection::STATUS_NORMAL && !connection->outboundQueue.empty()) {
         DispatchEntry* dispatchEntry = connection->outboundQueue.front();
         dispatchEntry->deliveryTime = currentTime;
@@ -2476,95 +2658,92 @@ void InputDispatcher::startDispatchCycleLocked(nsecs_t currentTime,
                 getDispatchingTimeoutLocked(connection->inputChannel->getConnectionToken());
         dispatchEntry->timeoutTime = currentTime + timeout;
 
-        // Publish the event.
-        status_t status;
+        OutboundMessage& message = mOutboundMessages.emplace_back();
+        message.seq = dispatchEntry->seq;
+        message.eventId = dispatchEntry->resolvedEventId;
+        message.action = dispatchEntry->resolvedAction;
+        message.flags = dispatchEntry->resolvedFlags;
+
         EventEntry* eventEntry = dispatchEntry->eventEntry;
+        message.type = eventEntry->type;
         switch (eventEntry->type) {
             case EventEntry::Type::KEY: {
                 const KeyEntry* keyEntry = static_cast<KeyEntry*>(eventEntry);
-                std::array<uint8_t, 32> hmac = getSignature(*keyEntry, *dispatchEntry);
-
-                // Publish the key event.
-                status =
-                        connection->inputPublisher
-                                .publishKeyEvent(dispatchEntry->seq, dispatchEntry->resolvedEventId,
-                                                 keyEntry->deviceId, keyEntry->source,
-                                                 keyEntry->displayId, std::move(hmac),
-                                                 dispatchEntry->resolvedAction,
-                                                 dispatchEntry->resolvedFlags, keyEntry->keyCode,
-                                                 keyEntry->scanCode, keyEntry->metaState,
-                                                 keyEntry->repeatCount, keyEntry->downTime,
-                                                 keyEntry->eventTime);
+                message.hmac = getSignature(*keyEntry, *dispatchEntry);
+                message.deviceId = keyEntry->deviceId;
+                message.source = keyEntry->source;
+                message.displayId = keyEntry->displayId;
+                message.keyCode = keyEntry->keyCode;
+                message.scanCode = keyEntry->scanCode;
+                message.metaState = keyEntry->metaState;
+                message.repeatCount = keyEntry->repeatCount;
+                message.downTime = keyEntry->downTime;
+                message.eventTime = keyEntry->eventTime;
                 break;
             }
 
             case EventEntry::Type::MOTION: {
                 MotionEntry* motionEntry = static_cast<MotionEntry*>(eventEntry);
 
-                PointerCoords scaledCoords[MAX_POINTERS];
-                const PointerCoords* usingCoords = motionEntry->pointerCoords;
-
                 // Set the X and Y offset and X and Y scale depending on the input source.
-                float xOffset = 0.0f, yOffset = 0.0f;
-                float xScale = 1.0f, yScale = 1.0f;
+                message.xOffset = 0.0f;
+                message.yOffset = 0.0f;
+                message.xScale = 1.0f;
+                message.yScale = 1.0f;
+                message.pointerCount = motionEntry->pointerCount;
+                for (uint32_t i = 0; i < motionEntry->pointerCount; i++) {
+                    message.pointerProperties[i] = motionEntry->pointerProperties[i];
+                    message.pointerCoords[i] = motionEntry->pointerCoords[i];
+                }
                 if ((motionEntry->source & AINPUT_SOURCE_CLASS_POINTER) &&
                     !(dispatchEntry->targetFlags & InputTarget::FLAG_ZERO_COORDS)) {
                     float globalScaleFactor = dispatchEntry->globalScaleFactor;
-                    xScale = dispatchEntry->windowXScale;
-                    yScale = dispatchEntry->windowYScale;
-                    xOffset = dispatchEntry->xOffset * xScale;
-                    yOffset = dispatchEntry->yOffset * yScale;
+                    message.xScale = dispatchEntry->windowXScale;
+                    message.yScale = dispatchEntry->windowYScale;
+                    message.xOffset = dispatchEntry->xOffset * message.xScale;
+                    message.yOffset = dispatchEntry->yOffset * message.yScale;
                     if (globalScaleFactor != 1.0f) {
                         for (uint32_t i = 0; i < motionEntry->pointerCount; i++) {
-                            scaledCoords[i] = motionEntry->pointerCoords[i];
                             // Don't apply window scale here since we don't want scale to affect raw
                             // coordinates. The scale will be sent back to the client and applied
                             // later when requesting relative coordinates.
-                            scaledCoords[i].scale(globalScaleFactor, 1 /* windowXScale */,
-                                                  1 /* windowYScale */);
+                            message.pointerCoords[i].scale(globalScaleFactor,
+                                                           1 /* windowXScale */,
+                                                           1 /* windowYScale */);
                         }
-                        usingCoords = scaledCoords;
                     }
                 } else {
                     // We don't want the dispatch target to know.
                     if (dispatchEntry->targetFlags & InputTarget::FLAG_ZERO_COORDS) {
                         for (uint32_t i = 0; i < motionEntry->pointerCount; i++) {
-                            scaledCoords[i].clear();
+                            message.pointerCoords[i].clear();
                         }
-                        usingCoords = scaledCoords;
                     }
                 }
 
-                std::array<uint8_t, 32> hmac = getSignature(*motionEntry, *dispatchEntry);
-
-                // Publish the motion event.
-                status = connection->inputPublisher
-                                 .publishMotionEvent(dispatchEntry->seq,
-                                                     dispatchEntry->resolvedEventId,
-                                                     motionEntry->deviceId, motionEntry->source,
-                                                     motionEntry->displayId, std::move(hmac),
-                                                     dispatchEntry->resolvedAction,
-                                                     motionEntry->actionButton,
-                                                     dispatchEntry->resolvedFlags,
-                                                     motionEntry->edgeFlags, motionEntry->metaState,
-                                                     motionEntry->buttonState,
-                                                     motionEntry->classification, xScale, yScale,
-                                                     xOffset, yOffset, motionEntry->xPrecision,
-                                                     motionEntry->yPrecision,
-                                                     motionEntry->xCursorPosition,
-                                                     motionEntry->yCursorPosition,
-                                                     motionEntry->downTime, motionEntry->eventTime,
-                                                     motionEntry->pointerCount,
-                                                     motionEntry->pointerProperties, usingCoords);
+                message.hmac = getSignature(*motionEntry, *dispatchEntry);
+                message.deviceId = motionEntry->deviceId;
+                message.source = motionEntry->source;
+                message.displayId = motionEntry->displayId;
+                message.actionButton = motionEntry->actionButton;
+                message.edgeFlags = motionEntry->edgeFlags;
+                message.metaState = motionEntry->metaState;
+                message.buttonState = motionEntry->buttonState;
+                message.classification = motionEntry->classification;
+                message.xPrecision = motionEntry->xPrecision;
+                message.yPrecision = motionEntry->yPrecision;
+                message.xCursorPosition = motionEntry->xCursorPosition;
+                message.yCursorPosition = motionEntry->yCursorPosition;
+                message.downTime = motionEntry->downTime;
+                message.eventTime = motionEntry->eventTime;
                 reportTouchEventForStatistics(*motionEntry);
                 break;
             }
             case EventEntry::Type::FOCUS: {
                 FocusEntry* focusEntry = static_cast<FocusEntry*>(eventEntry);
-                status = connection->inputPublisher.publishFocusEvent(dispatchEntry->seq,
-                                                                      focusEntry->id,
-                                                                      focusEntry->hasFocus,
-                                                                      mInTouchMode);
+                message.eventId = focusEntry->id;
+                message.hasFocus = focusEntry->hasFocus;
+                message.inTouchMode = mInTouchMode;
                 break;
             }
 
@@ -2576,46 +2755,118 @@ void InputDispatcher::startDispatchCycleLocked(nsecs_t currentTime,
             }
         }
 
-        // Check the result.
-        if (status) {
-            if (status == WOULD_BLOCK) {
-                if (connection->waitQueue.empty()) {
-                    ALOGE("channel '%s' ~ Could not publish event because the pipe is full. "
-                          "This is unexpected because the wait queue is empty, so the pipe "
-                          "should be empty and we shouldn't have any problems writing an "
-                          "event to it, status=%d",
-                          connection->getInputChannelName().c_str(), status);
-                    abortBrokenDispatchCycleLocked(currentTime, connection, true /*notify*/);
-                } else {
-                    // Pipe is full and we are waiting for the app to finish process some events
-                    // before sending more events to it.
-#if DEBUG_DISPATCH_CYCLE
-                    ALOGD("channel '%s' ~ Could not publish event because the pipe is full, "
-                          "waiting for the application to catch up",
-                          connection->getInputChannelName().c_str());
-#endif
-                }
-            } else {
-                ALOGE("channel '%s' ~ Could not publish event due to an unexpected error, "
-                      "status=%d",
-                      connection->getInputChannelName().c_str(), status);
-                abortBrokenDispatchCycleLocked(currentTime, connection, true /*notify*/);
-            }
-            return;
-        }
-
-        // Re-enqueue the event on the wait queue.
-        connection->outboundQueue.erase(std::remove(connection->outboundQueue.begin(),
-                                                    connection->outboundQueue.end(),
-                                                    dispatchEntry));
+        // Move the entry to the wait queue now, while the lock is held, so that a finished
+        // signal that races with the write still finds it. If the write fails, it is moved
+        // back in finishOutboundBatchLocked().
+        connection->outboundQueue.pop_front();
         traceOutboundQueueLength(connection);
         connection->waitQueue.push_back(dispatchEntry);
-        if (connection->responsive) {
+        if (batch.anrTracked) {
             mAnrTracker.insert(dispatchEntry->timeoutTime,
                                connection->inputChannel->getConnectionToken());
         }
         traceWaitQueueLength(connection);
     }
+
+    batch.end = mOutboundMessages.size();
+    batch.failedAt = batch.end;
+    if (batch.end > batch.begin) {
+        mOutboundBatches.push_back(std::move(batch));
+    }
+}
+
+status_t InputDispatcher::publishOutboundMessage(InputPublisher& publisher,
+                                                 const OutboundMessage& message) {
+    switch (message.type) {
+        case EventEntry::Type::KEY: {
+            return publisher.publishKeyEvent(message.seq, message.eventId, message.deviceId,
+                                             message.source, message.displayId, message.hmac,
+                                             message.action, message.flags, message.keyCode,
+                                             message.scanCode, message.metaState,
+                                             message.repeatCount, message.downTime,
+                                             message.eventTime);
+        }
+        case EventEntry::Type::MOTION: {
+            return publisher.publishMotionEvent(message.seq, message.eventId, message.deviceId,
+                                                message.source, message.displayId, message.hmac,
+                                                message.action, message.actionButton,
+                                                message.flags, message.edgeFlags,
+                                                message.metaState, message.buttonState,
+                                                message.classification, message.xScale,
+                                                message.yScale, message.xOffset, message.yOffset,
+                                                message.xPrecision, message.yPrecision,
+                                                message.xCursorPosition, message.yCursorPosition,
+                                                message.downTime, message.eventTime,
+                                                message.pointerCount, message.pointerProperties,
+                                                message.pointerCoords);
+        }
+        case EventEntry::Type::FOCUS: {
+            return publisher.publishFocusEvent(message.seq, message.eventId, message.hasFocus,
+                                               message.inTouchMode);
+        }
+        case EventEntry::Type::CONFIGURATION_CHANGED:
+        case EventEntry::Type::DEVICE_RESET: {
+            LOG_ALWAYS_FATAL("Should never publish %s events",
+                             EventEntry::typeToString(message.type));
+            return BAD_VALUE;
+        }
+    }
+}
+
+void InputDispatcher::finishOutboundBatchLocked(const OutboundBatch& batch) {
+    if (batch.failedAt == batch.end) {
+        return;
+    }
+    const sp<Connection>& connection = batch.connection;
+
+    // Put back what wasn't written, in order and ahead of anything queued since. Entries that
+    // are gone were dropped while the lock was released, e.g. because the channel was
+    // unregistered, and need nothing more.
+    for (size_t i = batch.end; i-- > batch.failedAt;) {
+        auto it = connection->findWaitQueueEntry(mOutboundMessages[i].seq);
+        if (it == connection->waitQueue.end()) {
+            continue;
+        }
+        DispatchEntry* dispatchEntry = *it;
+        connection->waitQueue.erase(it);
+        if (batch.anrTracked) {
+            mAnrTracker.erase(dispatchEntry->timeoutTime,
+                              connection->inputChannel->getConnectionToken());
+        }
+        connection->outboundQueue.push_front(dispatchEntry);
+    }
+    traceWaitQueueLength(connection);
+    traceOutboundQueueLength(connection);
+
+    if (connection->status != Connection::STATUS_NORMAL) {
+        return;
+    }
+
+    // Check the result.
+    const nsecs_t currentTime = now();
+    if (batch.status == WOULD_BLOCK) {
+        if (connection->waitQueue.empty()) {
+            ALOGE("channel '%s' ~ Could not publish event because the pipe is full. "
+                  "This is unexpected because the wait queue is empty, so the pipe "
+                  "should be empty and we shouldn't have any problems writing an "
+                  "event to it, status=%d",
+                  connection->getInputChannelName().c_str(), batch.status);
+            abortBrokenDispatchCycleLocked(currentTime, connection, true /*notify*/);
+        } else {
+            // Pipe is full and we are waiting for the app to finish process some events
+            // before sending more events to it.
+#if DEBUG_DISPATCH_CYCLE
+            ALOGD("channel '%s' ~ Could not publish event because the pipe is full, "
+                  "waiting for the application to catch up",
+                  connection->getInputChannelName().c_str());
+#endif
+        }
+    } else {
+        ALOGE("channel '%s' ~ Could not publish event due to an unexpected error, "
+              "status=%d",
+              connection->getInputChannelName().c_str(), batch.status);
+        abortBrokenDispatchCycleLocked(currentTime, connection, true /*notify*/);
+    }
 }
 
 const std::array<uint8_t, 32> InputDispatcher::getSignature(
@@ -2641,11 +2892,12 @@ const std::array<uint8_t, 32> InputDispatcher::getSignature(
 }
 
 void InputDispatcher::finishDispatchCycleLocked(nsecs_t currentTime,
-                                                const sp<Connection>& connection, uint32_t seq,
-                                                bool handled) {
+                                                const sp<Connection>& connection,
+                                                std::vector<uint32_t> seqs, bool handled) {
 #if DEBUG_DISPATCH_CYCLE
-    ALOGD("channel '%s' ~ finishDispatchCycle - seq=%u, handled=%s",
-          connection->getInputChannelName().c_str(), seq, toString(handled));
+    ALOGD("channel '%s' ~ finishDispatchCycle - seqs=%zu, last seq=%u, handled=%s",
+          connection->getInputChannelName().c_str(), seqs.size(), seqs.back(),
+          toString(handled));
 #endif
 
     if (connection->status == Connection::STATUS_BROKEN ||
@@ -2654,7 +2906,7 @@ void InputDispatcher::finishDispatchCycleLocked(nsecs_t currentTime,
     }
 
     // Notify other system components and prepare to start the next dispatch cycle.
-    onDispatchCycleFinishedLocked(currentTime, connection, seq, handled);
+    onDispatchCycleFinishedLocked(currentTime, connection, std::move(seqs), handled);
 }
 
 void InputDispatcher::abortBrokenDispatchCycleLocked(nsecs_t currentTime,
@@ -2725,13 +2977,15 @@ int InputDispatcher::handleReceiveCallback(int fd, int events, void* data) {
             bool gotOne = false;
             status_t status;
             for (;;) {
-                uint32_t seq;
+                // A single message may acknowledge a whole batch of motion samples; handle
+                // them with one command so the next cycle is only started once.
+                std::vector<uint32_t> seqs;
                 bool handled;
-                status = connection->inputPublisher.receiveFinishedSignal(&seq, &handled);
+                status = connection->inputPublisher.receiveFinishedSignals(&seqs, &handled);
                 if (status) {
                     break;
                 }
-                d->finishDispatchCycleLocked(currentTime, connection, seq, handled);
+                d->finishDispatchCycleLocked(currentTime, connection, std::move(seqs), handled);
                 gotOne = true;
             }
             if (gotOne) {
@@ -3621,6 +3875,7 @@ void InputDispatcher::updateWindowHandlesForDisplayLocked(
     if (inputWindowHandles.empty()) {
         // Remove all handles on a display if there are no windows left.
         mWindowHandlesByDisplay.erase(displayId);
+        mWindowIndexByDisplay.erase(displayId);
         return;
     }
 
@@ -3672,6 +3927,7 @@ void InputDispatcher::updateWindowHandlesForDisplayLocked(
 
     // Insert or replace
     mWindowHandlesByDisplay[displayId] = newHandles;
+    mWindowIndexByDisplay.insert_or_assign(displayId, WindowIndex(newHandles));
 }
 
 void InputDispatcher::setInputWindows(
@@ -4285,6 +4541,9 @@ void InputDispatcher::dumpDispatchStateLocked(std::string& dump) {
         dump += INDENT "AppSwitch: not pending\n";
     }
 
+    dump += INDENT "TouchLatency (since event time):\n";
+    mLatencyTracker.dump(dump, INDENT2);
+
     dump += INDENT "Configuration:\n";
     dump += StringPrintf(INDENT2 "KeyRepeatDelay: %" PRId64 "ms\n", ns2ms(mConfig.keyRepeatDelay));
     dump += StringPrintf(INDENT2 "KeyRepeatTimeout: %" PRId64 "ms\n",
@@ -4514,13 +4773,13 @@ void InputDispatcher::removeConnectionLocked(const sp<Connection>& connection) {
 }
 
 void InputDispatcher::onDispatchCycleFinishedLocked(nsecs_t currentTime,
-                                                    const sp<Connection>& connection, uint32_t seq,
-                                                    bool handled) {
+                                                    const sp<Connection>& connection,
+                                                    std::vector<uint32_t> seqs, bool handled) {
     std::unique_ptr<CommandEntry> commandEntry = std::make_unique<CommandEntry>(
             &InputDispatcher::doDispatchCycleFinishedLockedInterruptible);
     commandEntry->connection = connection;
     commandEntry->eventTime = currentTime;
-    commandEntry->seq = seq;
+    commandEntry->seqs = std::move(seqs);
     commandEntry->handled = handled;
     postCommandLocked(std::move(commandEntry));
 }
@@ -4756,54 +5015,55 @@ static bool isConnectionResponsive(const Connection& connection) {
 void InputDispatcher::doDispatchCycleFinishedLockedInterruptible(CommandEntry* commandEntry) {
     sp<Connection> connection = commandEntry->connection;
     const nsecs_t finishTime = commandEntry->eventTime;
-    uint32_t seq = commandEntry->seq;
     const bool handled = commandEntry->handled;
 
-    // Handle post-event policy actions.
-    std::deque<DispatchEntry*>::iterator dispatchEntryIt = connection->findWaitQueueEntry(seq);
-    if (dispatchEntryIt == connection->waitQueue.end()) {
-        return;
-    }
-    DispatchEntry* dispatchEntry = *dispatchEntryIt;
-    const nsecs_t eventDuration = finishTime - dispatchEntry->deliveryTime;
-    if (eventDuration > SLOW_EVENT_PROCESSING_WARNING_TIMEOUT) {
-        ALOGI("%s spent %" PRId64 "ms processing %s", connection->getWindowName().c_str(),
-              ns2ms(eventDuration), dispatchEntry->eventEntry->getDescription().c_str());
-    }
-    reportDispatchStatistics(std::chrono::nanoseconds(eventDuration), *connection, handled);
-
-    bool restartEvent;
-    if (dispatchEntry->eventEntry->type == EventEntry::Type::KEY) {
-        KeyEntry* keyEntry = static_cast<KeyEntry*>(dispatchEntry->eventEntry);
-        restartEvent =
-                afterKeyEventLockedInterruptible(connection, dispatchEntry, keyEntry, handled);
-    } else if (dispatchEntry->eventEntry->type == EventEntry::Type::MOTION) {
-        MotionEntry* motionEntry = static_cast<MotionEntry*>(dispatchEntry->eventEntry);
-        restartEvent = afterMotionEventLockedInterruptible(connection, dispatchEntry, motionEntry,
-                                                           handled);
-    } else {
-        restartEvent = false;
-    }
-
-    // Dequeue the event and start the next cycle.
-    // Because the lock might have been released, it is possible that the
-    // contents of the wait queue to have been drained, so we need to double-check
-    // a few things.
-    dispatchEntryIt = connection->findWaitQueueEntry(seq);
-    if (dispatchEntryIt != connection->waitQueue.end()) {
-        dispatchEntry = *dispatchEntryIt;
-        connection->waitQueue.erase(dispatchEntryIt);
-        mAnrTracker.erase(dispatchEntry->timeoutTime,
-                          connection->inputChannel->getConnectionToken());
-        if (!connection->responsive) {
-            connection->responsive = isConnectionResponsive(*connection);
+    for (uint32_t seq : commandEntry->seqs) {
+        // Handle post-event policy actions.
+        std::deque<DispatchEntry*>::iterator dispatchEntryIt = connection->findWaitQueueEntry(seq);
+        if (dispatchEntryIt == connection->waitQueue.end()) {
+            continue;
         }
-        traceWaitQueueLength(connection);
-        if (restartEvent && connection->status == Connection::STATUS_NORMAL) {
-            connection->outboundQueue.push_front(dispatchEntry);
-            traceOutboundQueueLength(connection);
+        DispatchEntry* dispatchEntry = *dispatchEntryIt;
+        const nsecs_t eventDuration = finishTime - dispatchEntry->deliveryTime;
+        if (eventDuration > SLOW_EVENT_PROCESSING_WARNING_TIMEOUT) {
+            ALOGI("%s spent %" PRId64 "ms processing %s", connection->getWindowName().c_str(),
+                  ns2ms(eventDuration), dispatchEntry->eventEntry->getDescription().c_str());
+        }
+        reportDispatchStatistics(*dispatchEntry, finishTime, *connection, handled);
+
+        bool restartEvent;
+        if (dispatchEntry->eventEntry->type == EventEntry::Type::KEY) {
+            KeyEntry* keyEntry = static_cast<KeyEntry*>(dispatchEntry->eventEntry);
+            restartEvent =
+                    afterKeyEventLockedInterruptible(connection, dispatchEntry, keyEntry, handled);
+        } else if (dispatchEntry->eventEntry->type == EventEntry::Type::MOTION) {
+            MotionEntry* motionEntry = static_cast<MotionEntry*>(dispatchEntry->eventEntry);
+            restartEvent = afterMotionEventLockedInterruptible(connection, dispatchEntry,
+                                                               motionEntry, handled);
         } else {
-            releaseDispatchEntry(dispatchEntry);
+            restartEvent = false;
+        }
+
+        // Dequeue the event.
+        // Because the lock might have been released, it is possible that the
+        // contents of the wait queue to have been drained, so we need to double-check
+        // a few things.
+        dispatchEntryIt = connection->findWaitQueueEntry(seq);
+        if (dispatchEntryIt != connection->waitQueue.end()) {
+            dispatchEntry = *dispatchEntryIt;
+            connection->waitQueue.erase(dispatchEntryIt);
+            mAnrTracker.erase(dispatchEntry->timeoutTime,
+                              connection->inputChannel->getConnectionToken());
+            if (!connection->responsive) {
+                connection->responsive = isConnectionResponsive(*connection);
+            }
+            traceWaitQueueLength(connection);
+            if (restartEvent && connection->status == Connection::STATUS_NORMAL) {
+                connection->outboundQueue.push_front(dispatchEntry);
+                traceOutboundQueueLength(connection);
+            } else {
+                releaseDispatchEntry(dispatchEntry);
+            }
         }
     }
 
@@ -5023,9 +5283,24 @@ KeyEvent InputDispatcher::createKeyEvent(const KeyEntry& entry) {
     return event;
 }
 
-void InputDispatcher::reportDispatchStatistics(std::chrono::nanoseconds eventDuration,
-                                               const Connection& connection, bool handled) {
-    // TODO Write some statistics about how long we spend waiting.
+void InputDispatcher::reportDispatchStatistics(const DispatchEntry& dispatchEntry,
+                                               nsecs_t finishTime, const Connection& connection,
+                                               bool handled) {
+    if (dispatchEntry.eventEntry->type != EventEntry::Type::MOTION) {
+        return;
+    }
+    const MotionEntry& motionEntry = static_cast<const MotionEntry&>(*dispatchEntry.eventEntry);
+    if (!shouldReportTouchStatistics(motionEntry) || motionEntry.dispatchTime == 0) {
+        return;
+    }
+    mLatencyTracker.trackFinishedEvent(motionEntry.displayId, connection.getWindowName(),
+                                       motionEntry.eventTime, motionEntry.dispatchTime,
+                                       dispatchEntry.deliveryTime, finishTime);
+}
+
+bool InputDispatcher::shouldReportTouchStatistics(const MotionEntry& motionEntry) {
+    return (motionEntry.source == AINPUT_SOURCE_TOUCHSCREEN) && !(motionEntry.isSynthesized()) &&
+            !mInputFilterEnabled;
 }
 
 /**
@@ -5040,9 +5315,7 @@ void InputDispatcher::reportDispatchStatistics(std::chrono::nanoseconds eventDur
  */
 void InputDispatcher::reportTouchEventForStatistics(const MotionEntry& motionEntry)
         REQUIRES(mLock) {
-    const bool reportForStatistics = (motionEntry.source == AINPUT_SOURCE_TOUCHSCREEN) &&
-            !(motionEntry.isSynthesized()) && !mInputFilterEnabled;
-    if (!reportForStatistics) {
+    if (!shouldReportTouchStatistics(motionEntry)) {
         return;
     }
 
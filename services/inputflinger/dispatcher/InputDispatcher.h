@@ -27,9 +27,11 @@
 #include "InputState.h"
 #include "InputTarget.h"
 #include "InputThread.h"
+#include "LatencyTracker.h"
 #include "Monitor.h"
 #include "TouchState.h"
 #include "TouchedWindow.h"
+#include "WindowIndex.h"
 
 #include <input/Input.h>
 #include <input/InputApplication.h>
@@ -37,6 +39,7 @@
 #include <input/InputWindow.h>
 #include <input/LatencyStatistics.h>
 #include <limits.h>
+#include <openssl/hmac.h>
 #include <stddef.h>
 #include <ui/Region.h>
 #include <unistd.h>
@@ -65,6 +68,8 @@ public:
 private:
     std::array<uint8_t, 32> sign(const uint8_t* data, size_t size) const;
     const std::array<uint8_t, 128> mHmacKey;
+    // HMAC state with mHmacKey already absorbed. Every signature starts from a copy of it.
+    bssl::ScopedHMAC_CTX mKeyedContext;
 };
 
 /* Dispatches events to input targets.  Some functions of the input dispatcher, such as
@@ -293,6 +298,8 @@ private:
 
     std::unordered_map<int32_t, std::vector<sp<InputWindowHandle>>> mWindowHandlesByDisplay
             GUARDED_BY(mLock);
+    // Spatial index over mWindowHandlesByDisplay, rebuilt whenever a display's windows change.
+    std::unordered_map<int32_t, WindowIndex> mWindowIndexByDisplay GUARDED_BY(mLock);
     void setInputWindowsLocked(const std::vector<sp<InputWindowHandle>>& inputWindowHandles,
                                int32_t displayId) REQUIRES(mLock);
     // Get window handles by display, return an empty vector if not found.
@@ -316,6 +323,12 @@ private:
 
     std::unordered_map<int32_t, TouchState> mTouchStatesByDisplay GUARDED_BY(mLock);
 
+    // Scratch state reused by every dispatch so that the target list and the working copy
+    // of the touch state keep their capacity from one event to the next. Both are emptied
+    // once the event has been dispatched so they don't hold on to channels or windows.
+    std::vector<InputTarget> mTempInputTargets GUARDED_BY(mLock);
+    TouchState mTempTouchState GUARDED_BY(mLock);
+
     // Focused applications.
     std::unordered_map<int32_t, sp<InputApplicationHandle>> mFocusedApplicationHandlesByDisplay
             GUARDED_BY(mLock);
@@ -351,6 +364,9 @@ private:
     std::optional<nsecs_t> mNoFocusedWindowTimeoutTime GUARDED_BY(mLock);
 
     bool shouldPruneInboundQueueLocked(const MotionEntry& motionEntry) REQUIRES(mLock);
+    // Replaces a still-queued move at the tail of the inbound queue with 'entry' if 'entry'
+    // supersedes it. Returns true if 'entry' was queued this way.
+    bool coalesceInboundMotionLocked(MotionEntry* entry) REQUIRES(mLock);
 
     /**
      * Time to stop waiting for the events to be processed while trying to dispatch a key.
@@ -433,15 +449,86 @@ private:
     void enqueueDispatchEntryLocked(const sp<Connection>& connection, EventEntry* eventEntry,
                                     const InputTarget& inputTarget, int32_t dispatchMode)
             REQUIRES(mLock);
+    // Schedules the connection's outbound queue to be published. The writes themselves happen
+    // on the dispatcher thread in publishPendingConnections(), with the mutex released.
     void startDispatchCycleLocked(nsecs_t currentTime, const sp<Connection>& connection)
             REQUIRES(mLock);
     void finishDispatchCycleLocked(nsecs_t currentTime, const sp<Connection>& connection,
-                                   uint32_t seq, bool handled) REQUIRES(mLock);
+                                   std::vector<uint32_t> seqs, bool handled) REQUIRES(mLock);
     void abortBrokenDispatchCycleLocked(nsecs_t currentTime, const sp<Connection>& connection,
                                         bool notify) REQUIRES(mLock);
     void drainDispatchQueue(std::deque<DispatchEntry*>& queue);
     void releaseDispatchEntry(DispatchEntry* dispatchEntry);
     static int handleReceiveCallback(int fd, int events, void* data);
+
+    // An event that is ready to be written to a connection. Everything the publisher needs is
+    // copied out of the dispatch entry under the mutex, so that the write can happen without it.
+    struct OutboundMessage {
+        uint32_t seq;
+        EventEntry::Type type;
+        int32_t eventId;
+        int32_t deviceId;
+        uint32_t source;
+        int32_t displayId;
+        std::array<uint8_t, 32> hmac;
+        int32_t action;
+        int32_t actionButton;
+        int32_t flags;
+        int32_t edgeFlags;
+        int32_t metaState;
+        int32_t buttonState;
+        MotionClassification classification;
+        int32_t keyCode;
+        int32_t scanCode;
+        int32_t repeatCount;
+        float xScale;
+        float yScale;
+        float xOffset;
+        float yOffset;
+        float xPrecision;
+        float yPrecision;
+        float xCursorPosition;
+        float yCursorPosition;
+        nsecs_t downTime;
+        nsecs_t eventTime;
+        bool hasFocus;
+        bool inTouchMode;
+        uint32_t pointerCount;
+        PointerProperties pointerProperties[MAX_POINTERS];
+        PointerCoords pointerCoords[MAX_POINTERS];
+    };
+
+    // The run of mOutboundMessages headed for one connection.
+    struct OutboundBatch {
+        sp<Connection> connection;
+        size_t begin;
+        size_t end;
+        // Whether the batch's entries were added to mAnrTracker when they were moved to the
+        // wait queue.
+        bool anrTracked;
+        // Index of the first message that could not be written, or 'end' if all of them were.
+        size_t failedAt;
+        status_t status;
+    };
+
+    // Connections that startDispatchCycleLocked() has scheduled for publishing.
+    std::vector<sp<Connection>> mConnectionsToPublish GUARDED_BY(mLock);
+    // The thread that runs dispatchOnce(). Only this thread writes to connections, so the
+    // others wake it up when they schedule a connection.
+    pid_t mDispatcherTid GUARDED_BY(mLock);
+    // Only touched by the dispatcher thread, inside publishPendingConnections().
+    std::vector<OutboundMessage> mOutboundMessages;
+    std::vector<OutboundBatch> mOutboundBatches;
+
+    // Publishes every scheduled connection's outbound queue. Messages are prepared and the
+    // dispatch entries moved to the wait queues under the mutex, written with the mutex
+    // released, and anything that could not be written is put back at the front of its
+    // outbound queue, so per-connection ordering is preserved.
+    void publishPendingConnections(nsecs_t* nextWakeupTime) EXCLUDES(mLock);
+    void prepareOutboundMessagesLocked(const sp<Connection>& connection) REQUIRES(mLock);
+    static status_t publishOutboundMessage(InputPublisher& publisher,
+                                           const OutboundMessage& message);
+    void finishOutboundBatchLocked(const OutboundBatch& batch) REQUIRES(mLock);
     // The action sent should only be of type AMOTION_EVENT_*
     void dispatchPointerDownOutsideFocus(uint32_t source, int32_t action,
                                          const sp<IBinder>& newToken) REQUIRES(mLock);
@@ -484,7 +571,7 @@ private:
 
     // Interesting events that we might like to log or tell the framework about.
     void onDispatchCycleFinishedLocked(nsecs_t currentTime, const sp<Connection>& connection,
-                                       uint32_t seq, bool handled) REQUIRES(mLock);
+                                       std::vector<uint32_t> seqs, bool handled) REQUIRES(mLock);
     void onDispatchCycleBrokenLocked(nsecs_t currentTime, const sp<Connection>& connection)
             REQUIRES(mLock);
     void onFocusChangedLocked(const sp<InputWindowHandle>& oldFocus,
@@ -521,9 +608,13 @@ private:
     static constexpr std::chrono::duration TOUCH_STATS_REPORT_PERIOD = 5min;
     LatencyStatistics mTouchStatistics{TOUCH_STATS_REPORT_PERIOD};
 
+    // Per-stage touch latency, for dumpsys.
+    LatencyTracker mLatencyTracker GUARDED_BY(mLock);
+
+    bool shouldReportTouchStatistics(const MotionEntry& entry) REQUIRES(mLock);
     void reportTouchEventForStatistics(const MotionEntry& entry);
-    void reportDispatchStatistics(std::chrono::nanoseconds eventDuration,
-                                  const Connection& connection, bool handled);
+    void reportDispatchStatistics(const DispatchEntry& dispatchEntry, nsecs_t finishTime,
+                                  const Connection& connection, bool handled) REQUIRES(mLock);
     void traceInboundQueueLengthLocked() REQUIRES(mLock);
     void traceOutboundQueueLength(const sp<Connection>& connection);
     void traceWaitQueueLength(const sp<Connection>& connection);
@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "LatencyTracker.h"
+
+#include <android-base/stringprintf.h>
+#include <inttypes.h>
+
+#include <algorithm>
+
+using android::base::StringPrintf;
+
+namespace android::inputdispatcher {
+
+static const char* OTHER_WINDOWS = "<other windows>";
+
+static const char* stageToString(size_t stage) {
+    switch (static_cast<LatencyTracker::Stage>(stage)) {
+        case LatencyTracker::Stage::DISPATCH:
+            return "dispatch";
+        case LatencyTracker::Stage::PUBLISH:
+            return "publish";
+        case LatencyTracker::Stage::FINISH:
+            return "finish";
+    }
+    return "?";
+}
+
+void LatencyTracker::Histogram::add(nsecs_t latency) {
+    const int64_t us = std::max<int64_t>(ns2us(latency), 0);
+    size_t bucket = 0;
+    if (us > 1) {
+        bucket = std::min<size_t>(63 - __builtin_clzll(static_cast<uint64_t>(us)),
+                                  BUCKET_COUNT - 1);
+    }
+    buckets[bucket]++;
+    count++;
+    totalUs += us;
+    maxUs = std::max(maxUs, us);
+}
+
+static void addToTimeline(LatencyTracker::Timeline& timeline, nsecs_t eventTime,
+                          nsecs_t dispatchTime, nsecs_t publishTime, nsecs_t finishTime) {
+    timeline[static_cast<size_t>(LatencyTracker::Stage::DISPATCH)].add(dispatchTime - eventTime);
+    timeline[static_cast<size_t>(LatencyTracker::Stage::PUBLISH)].add(publishTime - eventTime);
+    timeline[static_cast<size_t>(LatencyTracker::Stage::FINISH)].add(finishTime - eventTime);
+}
+
+void LatencyTracker::trackFinishedEvent(int32_t displayId, const std::string& windowName,
+                                        nsecs_t eventTime, nsecs_t dispatchTime,
+                                        nsecs_t publishTime, nsecs_t finishTime) {
+    addToTimeline(mDisplayTimelines[displayId], eventTime, dispatchTime, publishTime, finishTime);
+
+    auto it = mWindowTimelines.find(windowName);
+    if (it == mWindowTimelines.end()) {
+        // Leave room for the entry that collects the windows over the limit.
+        const std::string& key =
+                mWindowTimelines.size() + 1 < MAX_TRACKED_WINDOWS ? windowName : OTHER_WINDOWS;
+        it = mWindowTimelines.try_emplace(key).first;
+    }
+    addToTimeline(it->second, eventTime, dispatchTime, publishTime, finishTime);
+}
+
+const LatencyTracker::Timeline* LatencyTracker::getDisplayTimeline(int32_t displayId) const {
+    auto it = mDisplayTimelines.find(displayId);
+    return it != mDisplayTimelines.end() ? &it->second : nullptr;
+}
+
+const LatencyTracker::Timeline* LatencyTracker::getWindowTimeline(
+        const std::string& windowName) const {
+    auto it = mWindowTimelines.find(windowName);
+    return it != mWindowTimelines.end() ? &it->second : nullptr;
+}
+
+static void dumpTimeline(std::string& dump, const char* prefix,
+                         const LatencyTracker::Timeline& timeline) {
+    for (size_t stage = 0; stage < LatencyTracker::STAGE_COUNT; stage++) {
+        const LatencyTracker::Histogram& histogram = timeline[stage];
+        dump += StringPrintf("%s  %s: count=%" PRIu64 " avg=%" PRId64 "us max=%" PRId64
+                             "us buckets(log2 us):",
+                             prefix, stageToString(stage), histogram.count,
+                             histogram.count > 0
+                                     ? histogram.totalUs / static_cast<int64_t>(histogram.count)
+                                     : 0,
+                             histogram.maxUs);
+        for (uint64_t bucket : histogram.buckets) {
+            dump += StringPrintf(" %" PRIu64, bucket);
+        }
+        dump += "\n";
+    }
+}
+
+void LatencyTracker::dump(std::string& dump, const char* prefix) const {
+    for (const auto& [displayId, timeline] : mDisplayTimelines) {
+        dump += StringPrintf("%sDisplay %" PRId32 ":\n", prefix, displayId);
+        dumpTimeline(dump, prefix, timeline);
+    }
+    for (const auto& [windowName, timeline] : mWindowTimelines) {
+        dump += StringPrintf("%sWindow '%s':\n", prefix, windowName.c_str());
+        dumpTimeline(dump, prefix, timeline);
+    }
+}
+
+void LatencyTracker::clear() {
+    mDisplayTimelines.clear();
+    mWindowTimelines.clear();
+}
+
+} // namespace android::inputdispatcher
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _UI_INPUT_INPUTDISPATCHER_LATENCYTRACKER_H
+#define _UI_INPUT_INPUTDISPATCHER_LATENCYTRACKER_H
+
+#include <utils/Timers.h>
+#include <array>
+#include <map>
+#include <string>
+
+namespace android::inputdispatcher {
+
+/**
+ * Aggregates how long touch events take to get through each stage of the input pipeline,
+ * per display and per window.
+ *
+ * Every stage is measured from the event time, which is when the kernel queued the event on
+ * its evdev device:
+ *  - DISPATCH: the dispatcher took the event off its inbound queue.
+ *  - PUBLISH:  the event was written to the window's input channel.
+ *  - FINISH:   the window reported that it finished handling the event.
+ */
+class LatencyTracker {
+public:
+    enum class Stage : size_t {
+        DISPATCH,
+        PUBLISH,
+        FINISH,
+    };
+    static constexpr size_t STAGE_COUNT = 3;
+
+    // Bucket i counts events that took [2^i, 2^(i+1)) microseconds. Bucket 0 also takes
+    // anything faster and the last bucket anything slower.
+    static constexpr size_t BUCKET_COUNT = 20;
+
+    // Windows beyond this many are aggregated under a single entry, so that a stream of
+    // short-lived windows cannot grow the tracker without bound.
+    static constexpr size_t MAX_TRACKED_WINDOWS = 32;
+
+    struct Histogram {
+        uint64_t count = 0;
+        int64_t totalUs = 0;
+        int64_t maxUs = 0;
+        std::array<uint64_t, BUCKET_COUNT> buckets{};
+
+        void add(nsecs_t latency);
+    };
+    using Timeline = std::array<Histogram, STAGE_COUNT>;
+
+    void trackFinishedEvent(int32_t displayId, const std::string& windowName, nsecs_t eventTime,
+                            nsecs_t dispatchTime, nsecs_t publishTime, nsecs_t finishTime);
+
+    const Timeline* getDisplayTimeline(int32_t displayId) const;
+    const Timeline* getWindowTimeline(const std::string& windowName) const;
+
+    void dump(std::string& dump, const char* prefix) const;
+    void clear();
+
+private:
+    std::map<int32_t /*displayId*/, Timeline> mDisplayTimelines;
+    std::map<std::string /*windowName*/, Timeline> mWindowTimelines;
+};
+
+} // namespace android::inputdispatcher
+
+#endif // _UI_INPUT_INPUTDISPATCHER_LATENCYTRACKER_H
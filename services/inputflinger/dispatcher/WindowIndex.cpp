@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "WindowIndex.h"
+
+#include <algorithm>
+
+namespace android::inputdispatcher {
+
+// --- WindowGrid ---
+
+void WindowGrid::build(const std::vector<Rect>& bounds, const std::vector<bool>& everywhere) {
+    mCells.clear();
+    mEverywhere.clear();
+    mColumns = 0;
+    mRows = 0;
+
+    bool haveBounds = false;
+    int64_t left = 0, top = 0, right = 0, bottom = 0;
+    for (size_t i = 0; i < bounds.size(); i++) {
+        const Rect& rect = bounds[i];
+        if (everywhere[i] || rect.isEmpty()) {
+            continue;
+        }
+        if (!haveBounds) {
+            left = rect.left;
+            top = rect.top;
+            right = rect.right;
+            bottom = rect.bottom;
+            haveBounds = true;
+        } else {
+            left = std::min<int64_t>(left, rect.left);
+            top = std::min<int64_t>(top, rect.top);
+            right = std::max<int64_t>(right, rect.right);
+            bottom = std::max<int64_t>(bottom, rect.bottom);
+        }
+    }
+
+    if (haveBounds) {
+        mLeft = left;
+        mTop = top;
+        mCellWidth = std::max<int64_t>(1, (right - left + MAX_CELLS_PER_SIDE - 1) /
+                                               MAX_CELLS_PER_SIDE);
+        mCellHeight = std::max<int64_t>(1, (bottom - top + MAX_CELLS_PER_SIDE - 1) /
+                                                MAX_CELLS_PER_SIDE);
+        mColumns = (right - left + mCellWidth - 1) / mCellWidth;
+        mRows = (bottom - top + mCellHeight - 1) / mCellHeight;
+        mCells.resize(mColumns * mRows);
+    }
+
+    for (size_t i = 0; i < bounds.size(); i++) {
+        const uint32_t entry = static_cast<uint32_t>(i);
+        if (everywhere[i]) {
+            mEverywhere.push_back(entry);
+            for (std::vector<uint32_t>& cell : mCells) {
+                cell.push_back(entry);
+            }
+            continue;
+        }
+        const Rect& rect = bounds[i];
+        if (rect.isEmpty()) {
+            continue;
+        }
+        // Rects are half-open, so the last covered column holds right - 1.
+        const int64_t firstColumn = (rect.left - mLeft) / mCellWidth;
+        const int64_t lastColumn = (int64_t(rect.right) - 1 - mLeft) / mCellWidth;
+        const int64_t firstRow = (rect.top - mTop) / mCellHeight;
+        const int64_t lastRow = (int64_t(rect.bottom) - 1 - mTop) / mCellHeight;
+        for (int64_t row = firstRow; row <= lastRow; row++) {
+            for (int64_t column = firstColumn; column <= lastColumn; column++) {
+                mCells[row * mColumns + column].push_back(entry);
+            }
+        }
+    }
+}
+
+const std::vector<uint32_t>& WindowGrid::candidatesAt(int32_t x, int32_t y) const {
+    if (x < mLeft || y < mTop) {
+        return mEverywhere;
+    }
+    const int64_t column = (x - mLeft) / mCellWidth;
+    const int64_t row = (y - mTop) / mCellHeight;
+    if (column >= mColumns || row >= mRows) {
+        return mEverywhere;
+    }
+    return mCells[row * mColumns + column];
+}
+
+// --- WindowIndex ---
+
+WindowIndex::WindowIndex(const std::vector<sp<InputWindowHandle>>& windowHandles)
+      : mWindows(windowHandles) {
+    const size_t count = mWindows.size();
+    std::vector<Rect> touchBounds(count);
+    std::vector<bool> touchEverywhere(count, false);
+    std::vector<Rect> frames(count);
+    const std::vector<bool> frameEverywhere(count, false);
+
+    for (size_t i = 0; i < count; i++) {
+        const InputWindowInfo* info = mWindows[i]->getInfo();
+        mZOrderByWindow.emplace(mWindows[i].get(), static_cast<uint32_t>(i));
+        frames[i] = Rect(info->frameLeft, info->frameTop, info->frameRight, info->frameBottom);
+
+        if (!info->visible) {
+            continue;
+        }
+        const int32_t flags = info->layoutParamsFlags;
+        const bool touchable = !(flags & InputWindowInfo::FLAG_NOT_TOUCHABLE);
+        const bool isTouchModal = (flags &
+                                   (InputWindowInfo::FLAG_NOT_FOCUSABLE |
+                                    InputWindowInfo::FLAG_NOT_TOUCH_MODAL)) == 0;
+        // Touch modal windows take every touch, and outside watchers hear about every touch
+        // that lands below them, so both have to be looked at wherever the point is.
+        if ((touchable && isTouchModal) || (flags & InputWindowInfo::FLAG_WATCH_OUTSIDE_TOUCH)) {
+            touchEverywhere[i] = true;
+        } else if (touchable) {
+            touchBounds[i] = info->touchableRegion.getBounds();
+        }
+    }
+
+    mTouchGrid.build(touchBounds, touchEverywhere);
+    mFrameGrid.build(frames, frameEverywhere);
+}
+
+uint32_t WindowIndex::zOrderOf(const sp<InputWindowHandle>& windowHandle) const {
+    auto it = mZOrderByWindow.find(windowHandle.get());
+    return it != mZOrderByWindow.end() ? it->second : UINT32_MAX;
+}
+
+} // namespace android::inputdispatcher
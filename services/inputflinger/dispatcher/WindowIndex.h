@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _UI_INPUT_INPUTDISPATCHER_WINDOWINDEX_H
+#define _UI_INPUT_INPUTDISPATCHER_WINDOWINDEX_H
+
+#include <input/InputWindow.h>
+#include <ui/Rect.h>
+#include <unordered_map>
+#include <vector>
+
+namespace android::inputdispatcher {
+
+/**
+ * Buckets rectangles into a coarse uniform grid over their combined bounds, so that a point
+ * query only visits the entries whose rectangle covers the point's cell.
+ * Entries are identified by the order in which they were added, and every cell lists its
+ * entries in that order.
+ */
+class WindowGrid {
+public:
+    // Entries added with 'everywhere' set are returned for every point, inside the grid or not.
+    void build(const std::vector<Rect>& bounds, const std::vector<bool>& everywhere);
+    // Candidates for the point, in insertion order. The point may still fall outside any of
+    // the returned rectangles; callers do the exact test.
+    const std::vector<uint32_t>& candidatesAt(int32_t x, int32_t y) const;
+
+private:
+    static constexpr int64_t MAX_CELLS_PER_SIDE = 16;
+
+    int64_t mLeft = 0;
+    int64_t mTop = 0;
+    int64_t mCellWidth = 1;
+    int64_t mCellHeight = 1;
+    int64_t mColumns = 0;
+    int64_t mRows = 0;
+    std::vector<std::vector<uint32_t>> mCells;
+    std::vector<uint32_t> mEverywhere;
+};
+
+/**
+ * Spatial index over the input windows of a single display, in z order (topmost first).
+ * Hit testing and obscured checks use it to skip windows that cannot be under a point.
+ * Must be rebuilt whenever the display's window handles or their infos change.
+ */
+class WindowIndex {
+public:
+    explicit WindowIndex(const std::vector<sp<InputWindowHandle>>& windowHandles);
+
+    const sp<InputWindowHandle>& windowAt(uint32_t zOrder) const { return mWindows[zOrder]; }
+    // Position of the window in z order, or UINT32_MAX if it isn't part of this display.
+    uint32_t zOrderOf(const sp<InputWindowHandle>& windowHandle) const;
+
+    // Windows that may take a touch at the point, either because their touchable region
+    // could contain it or because they are touch modal or watch outside touches.
+    // Invisible windows are never returned.
+    const std::vector<uint32_t>& touchCandidatesAt(int32_t x, int32_t y) const {
+        return mTouchGrid.candidatesAt(x, y);
+    }
+    // Windows whose frame could contain the point.
+    const std::vector<uint32_t>& frameCandidatesAt(int32_t x, int32_t y) const {
+        return mFrameGrid.candidatesAt(x, y);
+    }
+
+private:
+    std::vector<sp<InputWindowHandle>> mWindows;
+    std::unordered_map<const InputWindowHandle*, uint32_t> mZOrderByWindow;
+    WindowGrid mTouchGrid;
+    WindowGrid mFrameGrid;
+};
+
+} // namespace android::inputdispatcher
+
+#endif // _UI_INPUT_INPUTDISPATCHER_WINDOWINDEX_H
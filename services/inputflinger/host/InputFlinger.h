@@ -42,6 +42,8 @@ public:
     virtual status_t dump(int fd, const Vector<String16>& args);
     void setInputWindows(const std::vector<InputWindowInfo>&,
             const sp<ISetInputWindowsListener>&) {}
+    void updateInputWindows(const std::vector<InputWindowInfo>&, const std::vector<int32_t>&,
+            const sp<ISetInputWindowsListener>&) {}
     void registerInputChannel(const sp<InputChannel>&) {}
     void unregisterInputChannel(const sp<InputChannel>&) {}
 
@@ -218,6 +218,11 @@ public:
 
     void flush();
 
+    /* Moves the args queued on each of the given listeners into this one, interleaved by
+     * event time. Args from the same listener keep their relative order, and ties between
+     * listeners go to the one that comes first in the list. */
+    void mergeByEventTime(const std::vector<sp<QueuedInputListener>>& listeners);
+
 private:
     sp<InputListenerInterface> mInnerListener;
     std::vector<NotifyArgs*> mArgsQueue;
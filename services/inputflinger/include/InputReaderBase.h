@@ -249,6 +249,11 @@ struct InputReaderConfiguration {
     // True if pointer capture is enabled.
     bool pointerCapture;
 
+    // True to let the reader cook events from different input devices on separate threads
+    // when several devices report in the same batch. Events are still delivered to the
+    // listener in event time order.
+    bool parallelEventCooking;
+
     // The set of currently disabled input devices.
     std::set<int32_t> disabledDevices;
 
@@ -268,7 +273,7 @@ struct InputReaderConfiguration {
             pointerGestureSwipeMaxWidthRatio(0.25f),
             pointerGestureMovementSpeedRatio(0.8f),
             pointerGestureZoomSpeedRatio(0.3f),
-            showTouches(false), pointerCapture(false) { }
+            showTouches(false), pointerCapture(false), parallelEventCooking(false) { }
 
     static std::string changesToString(uint32_t changes);
 
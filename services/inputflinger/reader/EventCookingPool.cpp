@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "EventCookingPool.h"
+
+namespace android {
+
+// --- EventCookingPool ---
+
+EventCookingPool::EventCookingPool(size_t threadCount)
+      : mTasks(nullptr), mNextTask(0), mUnfinishedTasks(0), mExiting(false) {
+    for (size_t i = 0; i < threadCount; i++) {
+        mThreads.push_back(std::make_unique<InputThread>(
+                "InputCooker", [this]() { loopOnce(); }, [this]() { wake(); }));
+    }
+}
+
+EventCookingPool::~EventCookingPool() {
+    mThreads.clear();
+}
+
+void EventCookingPool::run(const std::vector<std::function<void()>>& tasks) {
+    std::unique_lock<std::mutex> lock(mLock);
+    mTasks = &tasks;
+    mNextTask = 0;
+    mUnfinishedTasks = tasks.size();
+    mTasksAvailable.notify_all();
+
+    runTasksLocked(lock);
+    mTasksFinished.wait(lock, [this]() { return mUnfinishedTasks == 0; });
+    mTasks = nullptr;
+}
+
+void EventCookingPool::loopOnce() {
+    std::unique_lock<std::mutex> lock(mLock);
+    mTasksAvailable.wait(lock, [this]() {
+        return mExiting || (mTasks != nullptr && mNextTask < mTasks->size());
+    });
+    if (mExiting) {
+        return;
+    }
+    runTasksLocked(lock);
+}
+
+void EventCookingPool::wake() {
+    std::scoped_lock<std::mutex> lock(mLock);
+    mExiting = true;
+    mTasksAvailable.notify_all();
+}
+
+void EventCookingPool::runTasksLocked(std::unique_lock<std::mutex>& lock) {
+    while (mTasks != nullptr && mNextTask < mTasks->size()) {
+        const std::function<void()>& task = (*mTasks)[mNextTask++];
+        lock.unlock();
+        task();
+        lock.lock();
+        if (--mUnfinishedTasks == 0) {
+            mTasksFinished.notify_all();
+        }
+    }
+}
+
+} // namespace android
@@ -49,6 +49,9 @@
 #include <input/KeyLayoutMap.h>
 #include <input/VirtualKeyMap.h>
 
+#include <atomic>
+#include <thread>
+
 /* this macro is used to tell if "bit" is set in "array"
  * it selects a byte from the array, and does a boolean AND
  * operation with a byte that only has the relevant bit set.
@@ -136,6 +139,10 @@ static nsecs_t processEventTimestamp(const struct input_event& event) {
     return inputEventTime;
 }
 
+// getEvents() reads evdev events straight into the tail of the caller's RawEvent buffer and
+// expands them in place, which only works while an input_event is no larger than a RawEvent.
+static_assert(sizeof(struct input_event) <= sizeof(RawEvent));
+
 // --- Global Functions ---
 
 uint32_t getAbsAxisUsage(int32_t axis, uint32_t deviceClasses) {
@@ -849,8 +856,6 @@ size_t EventHub::getEvents(int timeoutMillis, RawEvent* buffer, size_t bufferSiz
 
     AutoMutex _l(mLock);
 
-    struct input_event readBuffer[bufferSize];
-
     RawEvent* event = buffer;
     size_t capacity = bufferSize;
     bool awoken = false;
@@ -864,6 +869,10 @@ size_t EventHub::getEvents(int timeoutMillis, RawEvent* buffer, size_t bufferSiz
             ALOGI("Reopening all input devices due to a configuration change.");
 
             closeAllDevicesLocked();
+            {
+                std::scoped_lock lock(mDeviceFilesLock);
+                mDeviceFiles.clear();
+            }
             mNeedToScanDevices = true;
             break; // return to the caller before we actually rescan
         }
@@ -974,6 +983,9 @@ size_t EventHub::getEvents(int timeoutMillis, RawEvent* buffer, size_t bufferSiz
             }
             // This must be an input event
             if (eventItem.events & EPOLLIN) {
+                // Read directly into the unused part of the result buffer rather than into a
+                // separate staging buffer, saving a full copy of every event.
+                uint8_t* readBuffer = reinterpret_cast<uint8_t*>(event);
                 int32_t readSize =
                         read(device->fd, readBuffer, sizeof(struct input_event) * capacity);
                 if (readSize == 0 || (readSize < 0 && errno == ENODEV)) {
@@ -993,16 +1005,20 @@ size_t EventHub::getEvents(int timeoutMillis, RawEvent* buffer, size_t bufferSiz
                     int32_t deviceId = device->id == mBuiltInKeyboardId ? 0 : device->id;
 
                     size_t count = size_t(readSize) / sizeof(struct input_event);
-                    for (size_t i = 0; i < count; i++) {
-                        struct input_event& iev = readBuffer[i];
-                        event->when = processEventTimestamp(iev);
-                        event->deviceId = deviceId;
-                        event->type = iev.type;
-                        event->code = iev.code;
-                        event->value = iev.value;
-                        event += 1;
-                        capacity -= 1;
+                    // Expand back to front: RawEvent i only overlaps input_events i and later,
+                    // which have already been consumed by then.
+                    for (size_t i = count; i-- > 0;) {
+                        struct input_event iev;
+                        memcpy(&iev, readBuffer + i * sizeof(struct input_event), sizeof(iev));
+                        RawEvent& rawEvent = event[i];
+                        rawEvent.when = processEventTimestamp(iev);
+                        rawEvent.deviceId = deviceId;
+                        rawEvent.type = iev.type;
+                        rawEvent.code = iev.code;
+                        rawEvent.value = iev.value;
                     }
+                    event += count;
+                    capacity -= count;
                     if (capacity == 0) {
                         // The result buffer is full.  Reset the pending event index
                         // so we will try to read the device again on the next iteration.
@@ -1215,22 +1231,46 @@ void EventHub::unregisterVideoDeviceFromEpollLocked(const TouchVideoDevice& vide
     }
 }
 
-status_t EventHub::openDeviceLocked(const char* devicePath) {
+EventHub::DeviceProbe::~DeviceProbe() {
+    if (fd >= 0) {
+        ::close(fd);
+    }
+}
+
+std::shared_ptr<EventHub::DeviceFiles> EventHub::getDeviceFiles(
+        const InputDeviceIdentifier& identifier) const {
+    // The configuration and key maps are looked up by these fields of the identifier.
+    const std::string key = StringPrintf("%04x:%04x:%04x:%04x:%s", identifier.bus,
+                                         identifier.vendor, identifier.product, identifier.version,
+                                         identifier.name.c_str());
+    std::scoped_lock lock(mDeviceFilesLock);
+    std::shared_ptr<DeviceFiles>& files = mDeviceFiles[key];
+    if (files == nullptr) {
+        files = std::make_shared<DeviceFiles>();
+    }
+    return files;
+}
+
+std::unique_ptr<EventHub::DeviceProbe> EventHub::probeDevice(const std::string& devicePath) const {
     char buffer[80];
 
-    ALOGV("Opening device: %s", devicePath);
+    ALOGV("Opening device: %s", devicePath.c_str());
 
-    int fd = open(devicePath, O_RDWR | O_CLOEXEC | O_NONBLOCK);
+    int fd = open(devicePath.c_str(), O_RDWR | O_CLOEXEC | O_NONBLOCK);
     if (fd < 0) {
-        ALOGE("could not open %s, %s\n", devicePath, strerror(errno));
-        return -1;
+        ALOGE("could not open %s, %s\n", devicePath.c_str(), strerror(errno));
+        return nullptr;
     }
 
-    InputDeviceIdentifier identifier;
+    // The probe closes the fd if it is dropped.
+    auto probe = std::make_unique<DeviceProbe>();
+    probe->path = devicePath;
+    probe->fd = fd;
+    InputDeviceIdentifier& identifier = probe->identifier;
 
     // Get device name.
     if (ioctl(fd, EVIOCGNAME(sizeof(buffer) - 1), &buffer) < 1) {
-        ALOGE("Could not get device name for %s: %s", devicePath, strerror(errno));
+        ALOGE("Could not get device name for %s: %s", devicePath.c_str(), strerror(errno));
     } else {
         buffer[sizeof(buffer) - 1] = '\0';
         identifier.name = buffer;
@@ -1240,26 +1280,22 @@ status_t EventHub::openDeviceLocked(const char* devicePath) {
     for (size_t i = 0; i < mExcludedDevices.size(); i++) {
         const std::string& item = mExcludedDevices[i];
         if (identifier.name == item) {
-            ALOGI("ignoring event id %s driver %s\n", devicePath, item.c_str());
-            close(fd);
-            return -1;
+            ALOGI("ignoring event id %s driver %s\n", devicePath.c_str(), item.c_str());
+            return nullptr;
         }
     }
 
     // Get device driver version.
-    int driverVersion;
-    if (ioctl(fd, EVIOCGVERSION, &driverVersion)) {
-        ALOGE("could not get driver version for %s, %s\n", devicePath, strerror(errno));
-        close(fd);
-        return -1;
+    if (ioctl(fd, EVIOCGVERSION, &probe->driverVersion)) {
+        ALOGE("could not get driver version for %s, %s\n", devicePath.c_str(), strerror(errno));
+        return nullptr;
     }
 
     // Get device identifier.
     struct input_id inputId;
     if (ioctl(fd, EVIOCGID, &inputId)) {
-        ALOGE("could not get device input id for %s, %s\n", devicePath, strerror(errno));
-        close(fd);
-        return -1;
+        ALOGE("could not get device input id for %s, %s\n", devicePath.c_str(), strerror(errno));
+        return nullptr;
     }
     identifier.bus = inputId.bustype;
     identifier.product = inputId.product;
@@ -1282,101 +1318,103 @@ status_t EventHub::openDeviceLocked(const char* devicePath) {
         identifier.uniqueId = buffer;
     }
 
-    // Fill in the descriptor.
-    assignDescriptorLocked(identifier);
-
-    // Allocate device.  (The device object takes ownership of the fd at this point.)
-    int32_t deviceId = mNextDeviceId++;
-    Device* device = new Device(fd, deviceId, devicePath, identifier);
-
-    ALOGV("add device %d: %s\n", deviceId, devicePath);
-    ALOGV("  bus:        %04x\n"
-          "  vendor      %04x\n"
-          "  product     %04x\n"
-          "  version     %04x\n",
-          identifier.bus, identifier.vendor, identifier.product, identifier.version);
-    ALOGV("  name:       \"%s\"\n", identifier.name.c_str());
-    ALOGV("  location:   \"%s\"\n", identifier.location.c_str());
-    ALOGV("  unique id:  \"%s\"\n", identifier.uniqueId.c_str());
-    ALOGV("  descriptor: \"%s\"\n", identifier.descriptor.c_str());
-    ALOGV("  driver:     v%d.%d.%d\n", driverVersion >> 16, (driverVersion >> 8) & 0xff,
-          driverVersion & 0xff);
-
     // Load the configuration file for the device.
-    loadConfigurationLocked(device);
+    std::shared_ptr<DeviceFiles> files = getDeviceFiles(identifier);
+    std::call_once(files->configurationLoaded, [&]() {
+        files->configurationFile = getInputDeviceConfigurationFilePathByDeviceIdentifier(
+                identifier, INPUT_DEVICE_CONFIGURATION_FILE_TYPE_CONFIGURATION);
+        if (files->configurationFile.empty()) {
+            ALOGD("No input device configuration file found for device '%s'.",
+                  identifier.name.c_str());
+        } else {
+            PropertyMap* configuration = nullptr;
+            status_t status =
+                    PropertyMap::load(String8(files->configurationFile.c_str()), &configuration);
+            files->configuration.reset(configuration);
+            if (status) {
+                ALOGE("Error loading input device configuration file for device '%s'.  "
+                      "Using default configuration.",
+                      identifier.name.c_str());
+            }
+        }
+    });
+    probe->configurationFile = files->configurationFile;
+    if (files->configuration) {
+        probe->configuration = std::make_unique<PropertyMap>(*files->configuration);
+    }
 
     // Figure out the kinds of events the device reports.
-    ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(device->keyBitmask)), device->keyBitmask);
-    ioctl(fd, EVIOCGBIT(EV_ABS, sizeof(device->absBitmask)), device->absBitmask);
-    ioctl(fd, EVIOCGBIT(EV_REL, sizeof(device->relBitmask)), device->relBitmask);
-    ioctl(fd, EVIOCGBIT(EV_SW, sizeof(device->swBitmask)), device->swBitmask);
-    ioctl(fd, EVIOCGBIT(EV_LED, sizeof(device->ledBitmask)), device->ledBitmask);
-    ioctl(fd, EVIOCGBIT(EV_FF, sizeof(device->ffBitmask)), device->ffBitmask);
-    ioctl(fd, EVIOCGPROP(sizeof(device->propBitmask)), device->propBitmask);
+    ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(probe->keyBitmask)), probe->keyBitmask);
+    ioctl(fd, EVIOCGBIT(EV_ABS, sizeof(probe->absBitmask)), probe->absBitmask);
+    ioctl(fd, EVIOCGBIT(EV_REL, sizeof(probe->relBitmask)), probe->relBitmask);
+    ioctl(fd, EVIOCGBIT(EV_SW, sizeof(probe->swBitmask)), probe->swBitmask);
+    ioctl(fd, EVIOCGBIT(EV_LED, sizeof(probe->ledBitmask)), probe->ledBitmask);
+    ioctl(fd, EVIOCGBIT(EV_FF, sizeof(probe->ffBitmask)), probe->ffBitmask);
+    ioctl(fd, EVIOCGPROP(sizeof(probe->propBitmask)), probe->propBitmask);
 
     // See if this is a keyboard.  Ignore everything in the button range except for
     // joystick and gamepad buttons which are handled like keyboards for the most part.
     bool haveKeyboardKeys =
-            containsNonZeroByte(device->keyBitmask, 0, sizeof_bit_array(BTN_MISC)) ||
-            containsNonZeroByte(device->keyBitmask, sizeof_bit_array(BTN_WHEEL),
+            containsNonZeroByte(probe->keyBitmask, 0, sizeof_bit_array(BTN_MISC)) ||
+            containsNonZeroByte(probe->keyBitmask, sizeof_bit_array(BTN_WHEEL),
                                 sizeof_bit_array(KEY_MAX + 1));
-    bool haveGamepadButtons = containsNonZeroByte(device->keyBitmask, sizeof_bit_array(BTN_MISC),
+    bool haveGamepadButtons = containsNonZeroByte(probe->keyBitmask, sizeof_bit_array(BTN_MISC),
                                                   sizeof_bit_array(BTN_MOUSE)) ||
-            containsNonZeroByte(device->keyBitmask, sizeof_bit_array(BTN_JOYSTICK),
+            containsNonZeroByte(probe->keyBitmask, sizeof_bit_array(BTN_JOYSTICK),
                                 sizeof_bit_array(BTN_DIGI));
     if (haveKeyboardKeys || haveGamepadButtons) {
-        device->classes |= INPUT_DEVICE_CLASS_KEYBOARD;
+        probe->classes |= INPUT_DEVICE_CLASS_KEYBOARD;
     }
 
     // See if this is a cursor device such as a trackball or mouse.
-    if (test_bit(BTN_MOUSE, device->keyBitmask) && test_bit(REL_X, device->relBitmask) &&
-        test_bit(REL_Y, device->relBitmask)) {
-        device->classes |= INPUT_DEVICE_CLASS_CURSOR;
+    if (test_bit(BTN_MOUSE, probe->keyBitmask) && test_bit(REL_X, probe->relBitmask) &&
+        test_bit(REL_Y, probe->relBitmask)) {
+        probe->classes |= INPUT_DEVICE_CLASS_CURSOR;
     }
 
     // See if this is a rotary encoder type device.
     String8 deviceType = String8();
-    if (device->configuration &&
-        device->configuration->tryGetProperty(String8("device.type"), deviceType)) {
+    if (probe->configuration &&
+        probe->configuration->tryGetProperty(String8("device.type"), deviceType)) {
         if (!deviceType.compare(String8("rotaryEncoder"))) {
-            device->classes |= INPUT_DEVICE_CLASS_ROTARY_ENCODER;
+            probe->classes |= INPUT_DEVICE_CLASS_ROTARY_ENCODER;
         }
     }
 
     // See if this is a touch pad.
     // Is this a new modern multi-touch driver?
-    if (test_bit(ABS_MT_POSITION_X, device->absBitmask) &&
-        test_bit(ABS_MT_POSITION_Y, device->absBitmask)) {
+    if (test_bit(ABS_MT_POSITION_X, probe->absBitmask) &&
+        test_bit(ABS_MT_POSITION_Y, probe->absBitmask)) {
         // Some joysticks such as the PS3 controller report axes that conflict
         // with the ABS_MT range.  Try to confirm that the device really is
         // a touch screen.
-        if (test_bit(BTN_TOUCH, device->keyBitmask) || !haveGamepadButtons) {
-            device->classes |= INPUT_DEVICE_CLASS_TOUCH | INPUT_DEVICE_CLASS_TOUCH_MT;
+        if (test_bit(BTN_TOUCH, probe->keyBitmask) || !haveGamepadButtons) {
+            probe->classes |= INPUT_DEVICE_CLASS_TOUCH | INPUT_DEVICE_CLASS_TOUCH_MT;
         }
         // Is this an old style single-touch driver?
-    } else if (test_bit(BTN_TOUCH, device->keyBitmask) && test_bit(ABS_X, device->absBitmask) &&
-               test_bit(ABS_Y, device->absBitmask)) {
-        device->classes |= INPUT_DEVICE_CLASS_TOUCH;
+    } else if (test_bit(BTN_TOUCH, probe->keyBitmask) && test_bit(ABS_X, probe->absBitmask) &&
+               test_bit(ABS_Y, probe->absBitmask)) {
+        probe->classes |= INPUT_DEVICE_CLASS_TOUCH;
         // Is this a BT stylus?
-    } else if ((test_bit(ABS_PRESSURE, device->absBitmask) ||
-                test_bit(BTN_TOUCH, device->keyBitmask)) &&
-               !test_bit(ABS_X, device->absBitmask) && !test_bit(ABS_Y, device->absBitmask)) {
-        device->classes |= INPUT_DEVICE_CLASS_EXTERNAL_STYLUS;
+    } else if ((test_bit(ABS_PRESSURE, probe->absBitmask) ||
+                test_bit(BTN_TOUCH, probe->keyBitmask)) &&
+               !test_bit(ABS_X, probe->absBitmask) && !test_bit(ABS_Y, probe->absBitmask)) {
+        probe->classes |= INPUT_DEVICE_CLASS_EXTERNAL_STYLUS;
         // Keyboard will try to claim some of the buttons but we really want to reserve those so we
         // can fuse it with the touch screen data, so just take them back. Note this means an
         // external stylus cannot also be a keyboard device.
-        device->classes &= ~INPUT_DEVICE_CLASS_KEYBOARD;
+        probe->classes &= ~INPUT_DEVICE_CLASS_KEYBOARD;
     }
 
     // See if this device is a joystick.
     // Assumes that joysticks always have gamepad buttons in order to distinguish them
     // from other devices such as accelerometers that also have absolute axes.
     if (haveGamepadButtons) {
-        uint32_t assumedClasses = device->classes | INPUT_DEVICE_CLASS_JOYSTICK;
+        uint32_t assumedClasses = probe->classes | INPUT_DEVICE_CLASS_JOYSTICK;
         for (int i = 0; i <= ABS_MAX; i++) {
-            if (test_bit(i, device->absBitmask) &&
+            if (test_bit(i, probe->absBitmask) &&
                 (getAbsAxisUsage(i, assumedClasses) & INPUT_DEVICE_CLASS_JOYSTICK)) {
-                device->classes = assumedClasses;
+                probe->classes = assumedClasses;
                 break;
             }
         }
@@ -1384,35 +1422,82 @@ status_t EventHub::openDeviceLocked(const char* devicePath) {
 
     // Check whether this device has switches.
     for (int i = 0; i <= SW_MAX; i++) {
-        if (test_bit(i, device->swBitmask)) {
-            device->classes |= INPUT_DEVICE_CLASS_SWITCH;
+        if (test_bit(i, probe->swBitmask)) {
+            probe->classes |= INPUT_DEVICE_CLASS_SWITCH;
             break;
         }
     }
 
     // Check whether this device supports the vibrator.
-    if (test_bit(FF_RUMBLE, device->ffBitmask)) {
-        device->classes |= INPUT_DEVICE_CLASS_VIBRATOR;
+    if (test_bit(FF_RUMBLE, probe->ffBitmask)) {
+        probe->classes |= INPUT_DEVICE_CLASS_VIBRATOR;
     }
 
     // Configure virtual keys.
-    if ((device->classes & INPUT_DEVICE_CLASS_TOUCH)) {
+    if ((probe->classes & INPUT_DEVICE_CLASS_TOUCH)) {
         // Load the virtual keys for the touch screen, if any.
         // We do this now so that we can make sure to load the keymap if necessary.
-        bool success = loadVirtualKeyMapLocked(device);
+        bool success = loadVirtualKeyMap(probe.get());
         if (success) {
-            device->classes |= INPUT_DEVICE_CLASS_KEYBOARD;
+            probe->classes |= INPUT_DEVICE_CLASS_KEYBOARD;
         }
     }
 
     // Load the key map.
     // We need to do this for joysticks too because the key layout may specify axes.
-    status_t keyMapStatus = NAME_NOT_FOUND;
-    if (device->classes & (INPUT_DEVICE_CLASS_KEYBOARD | INPUT_DEVICE_CLASS_JOYSTICK)) {
-        // Load the keymap for the device.
-        keyMapStatus = loadKeyMapLocked(device);
+    if (probe->classes & (INPUT_DEVICE_CLASS_KEYBOARD | INPUT_DEVICE_CLASS_JOYSTICK)) {
+        // Load the keymap for the device. The key maps are not modified once loaded, so they are
+        // shared by the devices with the same identifier.
+        std::call_once(files->keyMapLoaded, [&]() {
+            files->keyMapStatus = files->keyMap.load(identifier, files->configuration.get());
+        });
+        probe->keyMap = files->keyMap;
+        probe->keyMapStatus = files->keyMapStatus;
     }
 
+    return probe;
+}
+
+status_t EventHub::addProbedDeviceLocked(std::unique_ptr<DeviceProbe> probe) {
+    // Fill in the descriptor.
+    InputDeviceIdentifier identifier = probe->identifier;
+    assignDescriptorLocked(identifier);
+
+    // Allocate device.  (The device object takes ownership of the fd at this point.)
+    const int fd = probe->fd;
+    probe->fd = -1;
+    int32_t deviceId = mNextDeviceId++;
+    Device* device = new Device(fd, deviceId, probe->path, identifier);
+    const char* devicePath = device->path.c_str();
+    const int driverVersion = probe->driverVersion;
+
+    ALOGV("add device %d: %s\n", deviceId, devicePath);
+    ALOGV("  bus:        %04x\n"
+          "  vendor      %04x\n"
+          "  product     %04x\n"
+          "  version     %04x\n",
+          identifier.bus, identifier.vendor, identifier.product, identifier.version);
+    ALOGV("  name:       \"%s\"\n", identifier.name.c_str());
+    ALOGV("  location:   \"%s\"\n", identifier.location.c_str());
+    ALOGV("  unique id:  \"%s\"\n", identifier.uniqueId.c_str());
+    ALOGV("  descriptor: \"%s\"\n", identifier.descriptor.c_str());
+    ALOGV("  driver:     v%d.%d.%d\n", driverVersion >> 16, (driverVersion >> 8) & 0xff,
+          driverVersion & 0xff);
+
+    device->classes = probe->classes;
+    memcpy(device->keyBitmask, probe->keyBitmask, sizeof(device->keyBitmask));
+    memcpy(device->absBitmask, probe->absBitmask, sizeof(device->absBitmask));
+    memcpy(device->relBitmask, probe->relBitmask, sizeof(device->relBitmask));
+    memcpy(device->swBitmask, probe->swBitmask, sizeof(device->swBitmask));
+    memcpy(device->ledBitmask, probe->ledBitmask, sizeof(device->ledBitmask));
+    memcpy(device->ffBitmask, probe->ffBitmask, sizeof(device->ffBitmask));
+    memcpy(device->propBitmask, probe->propBitmask, sizeof(device->propBitmask));
+    device->configurationFile = std::move(probe->configurationFile);
+    device->configuration = probe->configuration.release();
+    device->virtualKeyMap = std::move(probe->virtualKeyMap);
+    device->keyMap = std::move(probe->keyMap);
+    status_t keyMapStatus = probe->keyMapStatus;
+
     // Configure the keyboard, gamepad or virtual keyboard.
     if (device->classes & INPUT_DEVICE_CLASS_KEYBOARD) {
         // Register the keyboard as a built-in keyboard if it is eligible.
@@ -1500,6 +1585,14 @@ status_t EventHub::openDeviceLocked(const char* devicePath) {
     return OK;
 }
 
+status_t EventHub::openDeviceLocked(const char* devicePath) {
+    std::unique_ptr<DeviceProbe> probe = probeDevice(devicePath);
+    if (probe == nullptr) {
+        return -1;
+    }
+    return addProbedDeviceLocked(std::move(probe));
+}
+
 void EventHub::configureFd(Device* device) {
     // Set fd parameters with ioctl, such as key repeat, suspend block, and clock type
     if (device->classes & INPUT_DEVICE_CLASS_KEYBOARD) {
@@ -1612,33 +1705,16 @@ void EventHub::addDeviceLocked(Device* device) {
     mOpeningDevices = device;
 }
 
-void EventHub::loadConfigurationLocked(Device* device) {
-    device->configurationFile = getInputDeviceConfigurationFilePathByDeviceIdentifier(
-            device->identifier, INPUT_DEVICE_CONFIGURATION_FILE_TYPE_CONFIGURATION);
-    if (device->configurationFile.empty()) {
-        ALOGD("No input device configuration file found for device '%s'.",
-              device->identifier.name.c_str());
-    } else {
-        status_t status = PropertyMap::load(String8(device->configurationFile.c_str()),
-                                            &device->configuration);
-        if (status) {
-            ALOGE("Error loading input device configuration file for device '%s'.  "
-                  "Using default configuration.",
-                  device->identifier.name.c_str());
-        }
-    }
-}
-
-bool EventHub::loadVirtualKeyMapLocked(Device* device) {
+bool EventHub::loadVirtualKeyMap(DeviceProbe* probe) {
     // The virtual key map is supplied by the kernel as a system board property file.
     std::string path;
     path += "/sys/board_properties/virtualkeys.";
-    path += device->identifier.getCanonicalName();
+    path += probe->identifier.getCanonicalName();
     if (access(path.c_str(), R_OK)) {
         return false;
     }
-    device->virtualKeyMap = VirtualKeyMap::load(path);
-    return device->virtualKeyMap != nullptr;
+    probe->virtualKeyMap = VirtualKeyMap::load(path);
+    return probe->virtualKeyMap != nullptr;
 }
 
 status_t EventHub::loadKeyMapLocked(Device* device) {
@@ -1873,14 +1949,39 @@ status_t EventHub::scanDirLocked(const char* dirname) {
     strcpy(devname, dirname);
     filename = devname + strlen(devname);
     *filename++ = '/';
+    std::vector<std::string> devicePaths;
     while ((de = readdir(dir))) {
         if (de->d_name[0] == '.' &&
             (de->d_name[1] == '\0' || (de->d_name[1] == '.' && de->d_name[2] == '\0')))
             continue;
         strcpy(filename, de->d_name);
-        openDeviceLocked(devname);
+        devicePaths.push_back(devname);
     }
     closedir(dir);
+
+    // Probing a node takes many ioctls and file loads, so the nodes are probed in parallel. They
+    // are then added in directory order, which assigns the device ids and descriptors.
+    std::vector<std::unique_ptr<DeviceProbe>> probes(devicePaths.size());
+    std::atomic<size_t> nextPath = 0;
+    auto probeDevices = [&]() {
+        for (size_t i = nextPath++; i < devicePaths.size(); i = nextPath++) {
+            probes[i] = probeDevice(devicePaths[i]);
+        }
+    };
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < std::min(devicePaths.size(), MAX_PROBE_THREADS); i++) {
+        threads.emplace_back(probeDevices);
+    }
+    probeDevices();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    for (std::unique_ptr<DeviceProbe>& probe : probes) {
+        if (probe != nullptr) {
+            addProbedDeviceLocked(std::move(probe));
+        }
+    }
     return 0;
 }
 
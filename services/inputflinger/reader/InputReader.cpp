@@ -32,12 +32,22 @@
 #include <utils/Errors.h>
 #include <utils/Thread.h>
 
+#include <thread>
+
 #include "InputDevice.h"
 
 using android::base::StringPrintf;
 
 namespace android {
 
+// Upper bound on the number of extra threads used for parallel event cooking. Devices that
+// report at high rates rarely come in more than a handful at a time.
+static constexpr size_t MAX_COOKING_THREADS = 3;
+
+// The listener that mappers cooking on the current thread should queue their args on, or
+// null to use the reader's own queue.
+static thread_local QueuedInputListener* sCookingListener = nullptr;
+
 // --- InputReader ---
 
 InputReader::InputReader(std::shared_ptr<EventHubInterface> eventHub,
@@ -51,7 +61,8 @@ InputReader::InputReader(std::shared_ptr<EventHubInterface> eventHub,
         mNextInputDeviceId(END_RESERVED_ID),
         mDisableVirtualKeysTimeout(LLONG_MIN),
         mNextTimeout(LLONG_MAX),
-        mConfigurationChangesToRefresh(0) {
+        mConfigurationChangesToRefresh(0),
+        mCookingInParallel(false) {
     mQueuedListener = new QueuedInputListener(listener);
 
     { // acquire lock
@@ -150,7 +161,13 @@ void InputReader::processEventsLocked(const RawEvent* rawEvents, size_t count) {
     for (const RawEvent* rawEvent = rawEvents; count;) {
         int32_t type = rawEvent->type;
         size_t batchSize = 1;
-        if (type < EventHubInterface::FIRST_SYNTHETIC_EVENT) {
+        if (type < EventHubInterface::FIRST_SYNTHETIC_EVENT && mCookingPool) {
+            while (batchSize < count &&
+                   rawEvent[batchSize].type < EventHubInterface::FIRST_SYNTHETIC_EVENT) {
+                batchSize += 1;
+            }
+            cookEventsLocked(rawEvent, batchSize);
+        } else if (type < EventHubInterface::FIRST_SYNTHETIC_EVENT) {
             int32_t deviceId = rawEvent->deviceId;
             while (batchSize < count) {
                 if (rawEvent[batchSize].type >= EventHubInterface::FIRST_SYNTHETIC_EVENT ||
@@ -302,6 +319,115 @@ void InputReader::processEventsForDeviceLocked(int32_t eventHubId, const RawEven
     device->process(rawEvents, count);
 }
 
+void InputReader::cookEventsLocked(const RawEvent* rawEvents, size_t count) {
+    struct Batch {
+        InputDevice* device;
+        const RawEvent* rawEvents;
+        size_t count;
+    };
+    struct Group {
+        InputDevice* device;
+        std::vector<Batch> batches;
+    };
+
+    // Split the events into one group per input device. A device that spans several
+    // EventHub devices still gets a single group, since its mappers share state.
+    std::vector<Batch> batches;
+    std::vector<Group> groups;
+    bool canCookInParallel = true;
+    for (const RawEvent* rawEvent = rawEvents; count;) {
+        int32_t eventHubId = rawEvent->deviceId;
+        size_t batchSize = 1;
+        while (batchSize < count && rawEvent[batchSize].deviceId == eventHubId) {
+            batchSize += 1;
+        }
+        const RawEvent* batchEvents = rawEvent;
+        count -= batchSize;
+        rawEvent += batchSize;
+
+        auto deviceIt = mDevices.find(eventHubId);
+        if (deviceIt == mDevices.end()) {
+            ALOGW("Discarding event for unknown eventHubId %d.", eventHubId);
+            continue;
+        }
+        InputDevice* device = deviceIt->second.get();
+        if (device->isIgnored()) {
+            continue;
+        }
+        // An external stylus pushes its state into every other device as it is cooked.
+        if (device->getClasses() & INPUT_DEVICE_CLASS_EXTERNAL_STYLUS) {
+            canCookInParallel = false;
+        }
+
+        Batch batch{device, batchEvents, batchSize};
+        batches.push_back(batch);
+        auto groupIt = std::find_if(groups.begin(), groups.end(),
+                                    [device](const Group& group) { return group.device == device; });
+        if (groupIt == groups.end()) {
+            groups.push_back({device, {batch}});
+        } else {
+            groupIt->batches.push_back(batch);
+        }
+    }
+
+    // Keyboards all feed the global meta state, so at most one of them may be cooked off the
+    // reader thread. The rest are cooked on it, in their original order.
+    std::vector<Group*> parallelGroups;
+    bool hasParallelKeyboard = false;
+    for (Group& group : groups) {
+        if (group.device->getClasses() & INPUT_DEVICE_CLASS_KEYBOARD) {
+            if (hasParallelKeyboard) {
+                continue;
+            }
+            hasParallelKeyboard = true;
+        }
+        parallelGroups.push_back(&group);
+    }
+    if (!canCookInParallel || parallelGroups.size() < 2) {
+        for (const Batch& batch : batches) {
+            batch.device->process(batch.rawEvents, batch.count);
+        }
+        return;
+    }
+
+#if DEBUG_RAW_EVENTS
+    ALOGD("Cooking %zu devices in parallel, %zu on the reader thread", parallelGroups.size(),
+          groups.size() - parallelGroups.size());
+#endif
+    std::vector<sp<QueuedInputListener>> listeners;
+    std::vector<std::function<void()>> tasks;
+    for (Group* group : parallelGroups) {
+        sp<QueuedInputListener> listener = new QueuedInputListener(nullptr);
+        listeners.push_back(listener);
+        tasks.push_back([group, listener]() {
+            sCookingListener = listener.get();
+            for (const Batch& batch : group->batches) {
+                batch.device->process(batch.rawEvents, batch.count);
+            }
+            sCookingListener = nullptr;
+        });
+    }
+    mCookingInParallel = true;
+    mCookingPool->run(tasks);
+    mCookingInParallel = false;
+
+    if (parallelGroups.size() < groups.size()) {
+        sp<QueuedInputListener> listener = new QueuedInputListener(nullptr);
+        listeners.push_back(listener);
+        sCookingListener = listener.get();
+        for (const Batch& batch : batches) {
+            if (std::find_if(parallelGroups.begin(), parallelGroups.end(), [&batch](Group* group) {
+                    return group->device == batch.device;
+                }) == parallelGroups.end()) {
+                batch.device->process(batch.rawEvents, batch.count);
+            }
+        }
+        sCookingListener = nullptr;
+    }
+
+    mQueuedListener->mergeByEventTime(listeners);
+}
+
 InputDevice* InputReader::findInputDevice(int32_t deviceId) {
     auto deviceIt =
             std::find_if(mDevices.begin(), mDevices.end(), [deviceId](const auto& devicePair) {
@@ -338,6 +464,7 @@ void InputReader::handleConfigurationChangedLocked(nsecs_t when) {
 void InputReader::refreshConfigurationLocked(uint32_t changes) {
     mPolicy->getReaderConfiguration(&mConfig);
     mEventHub->setExcludedDevices(mConfig.excludedDeviceNames);
+    updateCookingPoolLocked();
 
     if (changes) {
         ALOGI("Reconfiguring input devices, changes=%s",
@@ -359,6 +486,30 @@ void InputReader::refreshConfigurationLocked(uint32_t changes) {
     }
 }
 
+void InputReader::updateCookingPoolLocked() {
+    if (!mConfig.parallelEventCooking) {
+        mCookingPool.reset();
+        return;
+    }
+    if (mCookingPool) {
+        return;
+    }
+    // Leave a core for the reader thread itself, which takes a share of the work.
+    size_t cores = std::thread::hardware_concurrency();
+    if (cores < 2) {
+        ALOGI("Not enabling parallel event cooking on a single core.");
+        return;
+    }
+    mCookingPool = std::make_unique<EventCookingPool>(std::min(cores - 1, MAX_COOKING_THREADS));
+}
+
+std::unique_lock<std::mutex> InputReader::lockCookingStateLocked() {
+    if (!mCookingInParallel) {
+        return std::unique_lock<std::mutex>();
+    }
+    return std::unique_lock<std::mutex>(mCookingLock);
+}
+
 void InputReader::updateGlobalMetaStateLocked() {
     mGlobalMetaState = 0;
 
@@ -663,6 +814,9 @@ void InputReader::dump(std::string& dump) {
     dump += "]\n";
     dump += StringPrintf(INDENT2 "VirtualKeyQuietTime: %0.1fms\n",
                          mConfig.virtualKeyQuietTime * 0.000001f);
+    dump += StringPrintf(INDENT2 "ParallelEventCooking: %s (concurrency=%zu)\n",
+                         toString(mConfig.parallelEventCooking),
+                         mCookingPool ? mCookingPool->getConcurrency() : 1);
 
     dump += StringPrintf(INDENT2 "PointerVelocityControlParameters: "
                                  "scale=%0.3f, lowThreshold=%0.3f, highThreshold=%0.3f, "
@@ -725,42 +879,50 @@ InputReader::ContextImpl::ContextImpl(InputReader* reader)
 
 void InputReader::ContextImpl::updateGlobalMetaState() {
     // lock is already held by the input loop
+    auto cookingLock = mReader->lockCookingStateLocked();
     mReader->updateGlobalMetaStateLocked();
 }
 
 int32_t InputReader::ContextImpl::getGlobalMetaState() {
     // lock is already held by the input loop
+    auto cookingLock = mReader->lockCookingStateLocked();
     return mReader->getGlobalMetaStateLocked();
 }
 
 void InputReader::ContextImpl::disableVirtualKeysUntil(nsecs_t time) {
     // lock is already held by the input loop
+    auto cookingLock = mReader->lockCookingStateLocked();
     mReader->disableVirtualKeysUntilLocked(time);
 }
 
 bool InputReader::ContextImpl::shouldDropVirtualKey(nsecs_t now, int32_t keyCode,
                                                     int32_t scanCode) {
     // lock is already held by the input loop
+    auto cookingLock = mReader->lockCookingStateLocked();
     return mReader->shouldDropVirtualKeyLocked(now, keyCode, scanCode);
 }
 
 void InputReader::ContextImpl::fadePointer() {
     // lock is already held by the input loop
+    auto cookingLock = mReader->lockCookingStateLocked();
     mReader->fadePointerLocked();
 }
 
 sp<PointerControllerInterface> InputReader::ContextImpl::getPointerController(int32_t deviceId) {
     // lock is already held by the input loop
+    auto cookingLock = mReader->lockCookingStateLocked();
     return mReader->getPointerControllerLocked(deviceId);
 }
 
 void InputReader::ContextImpl::requestTimeoutAtTime(nsecs_t when) {
     // lock is already held by the input loop
+    auto cookingLock = mReader->lockCookingStateLocked();
     mReader->requestTimeoutAtTimeLocked(when);
 }
 
 int32_t InputReader::ContextImpl::bumpGeneration() {
     // lock is already held by the input loop
+    auto cookingLock = mReader->lockCookingStateLocked();
     return mReader->bumpGenerationLocked();
 }
 
@@ -778,6 +940,9 @@ InputReaderPolicyInterface* InputReader::ContextImpl::getPolicy() {
 }
 
 InputListenerInterface* InputReader::ContextImpl::getListener() {
+    if (sCookingListener != nullptr) {
+        return sCookingListener;
+    }
     return mReader->mQueuedListener.get();
 }
 
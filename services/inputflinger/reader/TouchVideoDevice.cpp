@@ -200,9 +200,10 @@ std::optional<TouchVideoFrame> TouchVideoDevice::readFrame() {
         ALOGW("The timestamp %ld.%ld was not acquired using CLOCK_MONOTONIC", buf.timestamp.tv_sec,
               buf.timestamp.tv_usec);
     }
-    std::vector<int16_t> data(mHeight * mWidth);
+    // The buffer goes straight back to the driver, so this is the only copy the frame needs.
+    // From here on it is shared by every TouchVideoFrame that refers to it.
     const int16_t* readFrom = mReadLocations[buf.index];
-    std::copy(readFrom, readFrom + mHeight * mWidth, data.begin());
+    std::vector<int16_t> data(readFrom, readFrom + mHeight * mWidth);
     TouchVideoFrame frame(mHeight, mWidth, std::move(data), buf.timestamp);
 
     result = ioctl(mFd.get(), VIDIOC_QBUF, &buf);
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _UI_INPUTREADER_EVENT_COOKING_POOL_H
+#define _UI_INPUTREADER_EVENT_COOKING_POOL_H
+
+#include "InputThread.h"
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace android {
+
+/* A small set of worker threads that the InputReader uses to cook the raw events of several
+ * input devices at the same time.
+ *
+ * The pool has no queue of its own: run() hands a batch of tasks to the workers, takes a share
+ * of them on the calling thread, and returns only once every task in the batch has finished.
+ * The reader therefore never has cooking work in flight outside of a single loop iteration.
+ */
+class EventCookingPool {
+public:
+    explicit EventCookingPool(size_t threadCount);
+    ~EventCookingPool();
+
+    // Runs all of the tasks and waits for them to finish. Must not be called concurrently.
+    void run(const std::vector<std::function<void()>>& tasks);
+
+    // The number of threads that can be cooking at once, including the caller of run().
+    size_t getConcurrency() const { return mThreads.size() + 1; }
+
+private:
+    std::mutex mLock;
+    std::condition_variable mTasksAvailable;
+    std::condition_variable mTasksFinished;
+
+    // The batch being run, or nullptr when idle. Guarded by mLock.
+    const std::vector<std::function<void()>>* mTasks;
+    size_t mNextTask;
+    size_t mUnfinishedTasks;
+    bool mExiting;
+
+    std::vector<std::unique_ptr<InputThread>> mThreads;
+
+    void loopOnce();
+    void wake();
+
+    // Runs tasks from the current batch until none are left to claim. Called with mLock held.
+    void runTasksLocked(std::unique_lock<std::mutex>& lock);
+};
+
+} // namespace android
+
+#endif // _UI_INPUTREADER_EVENT_COOKING_POOL_H
@@ -17,6 +17,9 @@
 #ifndef _RUNTIME_EVENT_HUB_H
 #define _RUNTIME_EVENT_HUB_H
 
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 
 #include <input/Input.h>
@@ -373,6 +376,51 @@ private:
         }
     };
 
+    // The part of opening an input device node which doesn't depend on the other devices: reading
+    // the identity and capabilities of the node, classifying it and loading its configuration and
+    // key maps. Probing doesn't modify the EventHub, so the nodes found by a scan are probed in
+    // parallel, and then added in order.
+    struct DeviceProbe {
+        std::string path;
+        int fd = -1;
+        int driverVersion = 0;
+        // The descriptor is assigned when the device is added.
+        InputDeviceIdentifier identifier;
+        uint32_t classes = 0;
+
+        uint8_t keyBitmask[(KEY_MAX + 1) / 8] = {};
+        uint8_t absBitmask[(ABS_MAX + 1) / 8] = {};
+        uint8_t relBitmask[(REL_MAX + 1) / 8] = {};
+        uint8_t swBitmask[(SW_MAX + 1) / 8] = {};
+        uint8_t ledBitmask[(LED_MAX + 1) / 8] = {};
+        uint8_t ffBitmask[(FF_MAX + 1) / 8] = {};
+        uint8_t propBitmask[(INPUT_PROP_MAX + 1) / 8] = {};
+
+        std::string configurationFile;
+        std::unique_ptr<PropertyMap> configuration;
+        std::unique_ptr<VirtualKeyMap> virtualKeyMap;
+        KeyMap keyMap;
+        status_t keyMapStatus = NAME_NOT_FOUND;
+
+        ~DeviceProbe();
+    };
+
+    // The configuration and key maps found for a device identifier. Input devices often expose
+    // several nodes with the same identifier, and reconnect with it, so the files are only looked
+    // up and parsed once. Each part is loaded when first needed.
+    struct DeviceFiles {
+        std::once_flag configurationLoaded;
+        std::string configurationFile;
+        std::unique_ptr<PropertyMap> configuration;
+
+        std::once_flag keyMapLoaded;
+        KeyMap keyMap;
+        status_t keyMapStatus = NAME_NOT_FOUND;
+    };
+
+    std::unique_ptr<DeviceProbe> probeDevice(const std::string& devicePath) const;
+    std::shared_ptr<DeviceFiles> getDeviceFiles(const InputDeviceIdentifier& identifier) const;
+    status_t addProbedDeviceLocked(std::unique_ptr<DeviceProbe> probe);
     status_t openDeviceLocked(const char* devicePath);
     void openVideoDeviceLocked(const std::string& devicePath);
     void createVirtualKeyboardLocked();
@@ -412,8 +460,7 @@ private:
 
     bool hasKeycodeLocked(Device* device, int keycode) const;
 
-    void loadConfigurationLocked(Device* device);
-    bool loadVirtualKeyMapLocked(Device* device);
+    static bool loadVirtualKeyMap(DeviceProbe* probe);
     status_t loadKeyMapLocked(Device* device);
 
     bool isExternalDeviceLocked(Device* device);
@@ -429,6 +476,14 @@ private:
     // Protect all internal state.
     mutable Mutex mLock;
 
+    // Maximum number of threads probing device nodes during a scan.
+    static constexpr size_t MAX_PROBE_THREADS = 4;
+
+    // The files loaded for each device identifier, see DeviceFiles. Dropped when the devices are
+    // reopened, so that configuration changes are picked up.
+    mutable std::mutex mDeviceFilesLock;
+    mutable std::unordered_map<std::string, std::shared_ptr<DeviceFiles>> mDeviceFiles;
+
     // The actual id of the built-in keyboard, or NO_BUILT_IN_KEYBOARD if none.
     // EventHub remaps the built-in keyboard to id 0 externally as required by the API.
     enum {
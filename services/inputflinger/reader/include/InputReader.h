@@ -17,6 +17,7 @@
 #ifndef _UI_INPUTREADER_INPUT_READER_H
 #define _UI_INPUTREADER_INPUT_READER_H
 
+#include "EventCookingPool.h"
 #include "EventHub.h"
 #include "InputListener.h"
 #include "InputReaderBase.h"
@@ -27,6 +28,7 @@
 #include <utils/Condition.h>
 #include <utils/Mutex.h>
 
+#include <mutex>
 #include <unordered_map>
 #include <vector>
 
@@ -146,12 +148,25 @@ private:
     std::unordered_map<std::shared_ptr<InputDevice>, std::vector<int32_t> /*eventHubId*/>
             mDeviceToEventHubIdsMap;
 
+    // Threads used to cook events of several devices at once when
+    // InputReaderConfiguration::parallelEventCooking is set, or null otherwise.
+    std::unique_ptr<EventCookingPool> mCookingPool;
+
+    // While devices are being cooked in parallel, the reader state that mappers reach through
+    // the context is additionally guarded by mCookingLock. mLock stays held by the reader
+    // thread for the whole loop iteration.
+    bool mCookingInParallel;
+    std::mutex mCookingLock;
+    std::unique_lock<std::mutex> lockCookingStateLocked();
+    void updateCookingPoolLocked();
+
     // low-level input event decoding and device management
     void processEventsLocked(const RawEvent* rawEvents, size_t count);
 
     void addDeviceLocked(nsecs_t when, int32_t eventHubId);
     void removeDeviceLocked(nsecs_t when, int32_t eventHubId);
     void processEventsForDeviceLocked(int32_t eventHubId, const RawEvent* rawEvents, size_t count);
+    void cookEventsLocked(const RawEvent* rawEvents, size_t count);
     void timeoutExpiredLocked(nsecs_t when);
 
     void handleConfigurationChangedLocked(nsecs_t when);
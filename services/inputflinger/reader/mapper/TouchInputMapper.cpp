@@ -1354,6 +1354,7 @@ void TouchInputMapper::dumpAffineTransformation(std::string& dump) {
 void TouchInputMapper::updateAffineTransformation() {
     mAffineTransform = getPolicy()->getTouchAffineTransformation(getDeviceContext().getDescriptor(),
                                                                  mSurfaceOrientation);
+    updateSurfaceTransform();
 }
 
 void TouchInputMapper::reset(nsecs_t when) {
@@ -2171,35 +2172,17 @@ void TouchInputMapper::cookPointerData() {
                 distance = 0;
         }
 
-        // Coverage
-        int32_t rawLeft, rawTop, rawRight, rawBottom;
-        switch (mCalibration.coverageCalibration) {
-            case Calibration::COVERAGE_CALIBRATION_BOX:
-                rawLeft = (in.toolMinor & 0xffff0000) >> 16;
-                rawRight = in.toolMinor & 0x0000ffff;
-                rawBottom = in.toolMajor & 0x0000ffff;
-                rawTop = (in.toolMajor & 0xffff0000) >> 16;
-                break;
-            default:
-                rawLeft = rawTop = rawRight = rawBottom = 0;
-                break;
-        }
-
-        // Adjust X,Y coords for device calibration
+        // Adjust X,Y coords for device calibration and surface orientation in one step.
         // TODO: Adjust coverage coords?
-        float xTransformed = in.x, yTransformed = in.y;
-        mAffineTransform.applyTo(xTransformed, yTransformed);
-        rotateAndScale(xTransformed, yTransformed);
-
-        // Adjust X, Y, and coverage coords for surface orientation.
-        float left, top, right, bottom;
+        const TouchAffineTransformation& transform = mSurfaceTransform;
+        const float xTransformed =
+                in.x * transform.x_scale + in.y * transform.x_ymix + transform.x_offset;
+        const float yTransformed =
+                in.x * transform.y_xmix + in.y * transform.y_scale + transform.y_offset;
 
+        // Adjust orientation for surface orientation.
         switch (mSurfaceOrientation) {
             case DISPLAY_ORIENTATION_90:
-                left = float(rawTop - mRawPointerAxes.y.minValue) * mYScale + mYTranslate;
-                right = float(rawBottom - mRawPointerAxes.y.minValue) * mYScale + mYTranslate;
-                bottom = float(mRawPointerAxes.x.maxValue - rawLeft) * mXScale + mXTranslate;
-                top = float(mRawPointerAxes.x.maxValue - rawRight) * mXScale + mXTranslate;
                 orientation -= M_PI_2;
                 if (mOrientedRanges.haveOrientation &&
                     orientation < mOrientedRanges.orientation.min) {
@@ -2208,10 +2191,6 @@ void TouchInputMapper::cookPointerData() {
                 }
                 break;
             case DISPLAY_ORIENTATION_180:
-                left = float(mRawPointerAxes.x.maxValue - rawRight) * mXScale;
-                right = float(mRawPointerAxes.x.maxValue - rawLeft) * mXScale;
-                bottom = float(mRawPointerAxes.y.maxValue - rawTop) * mYScale + mYTranslate;
-                top = float(mRawPointerAxes.y.maxValue - rawBottom) * mYScale + mYTranslate;
                 orientation -= M_PI;
                 if (mOrientedRanges.haveOrientation &&
                     orientation < mOrientedRanges.orientation.min) {
@@ -2220,10 +2199,6 @@ void TouchInputMapper::cookPointerData() {
                 }
                 break;
             case DISPLAY_ORIENTATION_270:
-                left = float(mRawPointerAxes.y.maxValue - rawBottom) * mYScale;
-                right = float(mRawPointerAxes.y.maxValue - rawTop) * mYScale;
-                bottom = float(rawRight - mRawPointerAxes.x.minValue) * mXScale + mXTranslate;
-                top = float(rawLeft - mRawPointerAxes.x.minValue) * mXScale + mXTranslate;
                 orientation += M_PI_2;
                 if (mOrientedRanges.haveOrientation &&
                     orientation > mOrientedRanges.orientation.max) {
@@ -2232,10 +2207,6 @@ void TouchInputMapper::cookPointerData() {
                 }
                 break;
             default:
-                left = float(rawLeft - mRawPointerAxes.x.minValue) * mXScale + mXTranslate;
-                right = float(rawRight - mRawPointerAxes.x.minValue) * mXScale + mXTranslate;
-                bottom = float(rawBottom - mRawPointerAxes.y.minValue) * mYScale + mYTranslate;
-                top = float(rawTop - mRawPointerAxes.y.minValue) * mYScale + mYTranslate;
                 break;
         }
 
@@ -2252,6 +2223,8 @@ void TouchInputMapper::cookPointerData() {
         out.setAxisValue(AMOTION_EVENT_AXIS_TILT, tilt);
         out.setAxisValue(AMOTION_EVENT_AXIS_DISTANCE, distance);
         if (mCalibration.coverageCalibration == Calibration::COVERAGE_CALIBRATION_BOX) {
+            float left, top, right, bottom;
+            cookCoverage(in, &left, &top, &right, &bottom);
             out.setAxisValue(AMOTION_EVENT_AXIS_GENERIC_1, left);
             out.setAxisValue(AMOTION_EVENT_AXIS_GENERIC_2, top);
             out.setAxisValue(AMOTION_EVENT_AXIS_GENERIC_3, right);
@@ -2273,6 +2246,42 @@ void TouchInputMapper::cookPointerData() {
     }
 }
 
+void TouchInputMapper::cookCoverage(const RawPointerData::Pointer& in, float* outLeft,
+                                    float* outTop, float* outRight, float* outBottom) const {
+    const int32_t rawLeft = (in.toolMinor & 0xffff0000) >> 16;
+    const int32_t rawRight = in.toolMinor & 0x0000ffff;
+    const int32_t rawBottom = in.toolMajor & 0x0000ffff;
+    const int32_t rawTop = (in.toolMajor & 0xffff0000) >> 16;
+
+    // Adjust coverage coords for surface orientation.
+    switch (mSurfaceOrientation) {
+        case DISPLAY_ORIENTATION_90:
+            *outLeft = float(rawTop - mRawPointerAxes.y.minValue) * mYScale + mYTranslate;
+            *outRight = float(rawBottom - mRawPointerAxes.y.minValue) * mYScale + mYTranslate;
+            *outBottom = float(mRawPointerAxes.x.maxValue - rawLeft) * mXScale + mXTranslate;
+            *outTop = float(mRawPointerAxes.x.maxValue - rawRight) * mXScale + mXTranslate;
+            break;
+        case DISPLAY_ORIENTATION_180:
+            *outLeft = float(mRawPointerAxes.x.maxValue - rawRight) * mXScale;
+            *outRight = float(mRawPointerAxes.x.maxValue - rawLeft) * mXScale;
+            *outBottom = float(mRawPointerAxes.y.maxValue - rawTop) * mYScale + mYTranslate;
+            *outTop = float(mRawPointerAxes.y.maxValue - rawBottom) * mYScale + mYTranslate;
+            break;
+        case DISPLAY_ORIENTATION_270:
+            *outLeft = float(mRawPointerAxes.y.maxValue - rawBottom) * mYScale;
+            *outRight = float(mRawPointerAxes.y.maxValue - rawTop) * mYScale;
+            *outBottom = float(rawRight - mRawPointerAxes.x.minValue) * mXScale + mXTranslate;
+            *outTop = float(rawLeft - mRawPointerAxes.x.minValue) * mXScale + mXTranslate;
+            break;
+        default:
+            *outLeft = float(rawLeft - mRawPointerAxes.x.minValue) * mXScale + mXTranslate;
+            *outRight = float(rawRight - mRawPointerAxes.x.minValue) * mXScale + mXTranslate;
+            *outBottom = float(rawBottom - mRawPointerAxes.y.minValue) * mYScale + mYTranslate;
+            *outTop = float(rawTop - mRawPointerAxes.y.minValue) * mYScale + mYTranslate;
+            break;
+    }
+}
+
 void TouchInputMapper::dispatchPointerUsage(nsecs_t when, uint32_t policyFlags,
                                             PointerUsage pointerUsage) {
     if (pointerUsage != mPointerUsage) {
@@ -3619,37 +3628,53 @@ void TouchInputMapper::cancelTouch(nsecs_t when) {
     abortTouches(when, 0 /* policyFlags*/);
 }
 
-// Transform raw coordinate to surface coordinate
-void TouchInputMapper::rotateAndScale(float& x, float& y) {
+// Combines the calibration transform with the scaling and rotation from raw to surface
+// coordinates, so that cookPointerData() maps each sample with a single affine transform.
+void TouchInputMapper::updateSurfaceTransform() {
     // Scale to surface coordinate.
-    const float xScaled = float(x - mRawPointerAxes.x.minValue) * mXScale;
-    const float yScaled = float(y - mRawPointerAxes.y.minValue) * mYScale;
+    // xScaled = (x - minX) * xScale, yScaled = (y - minY) * yScale.
+    const double xScale = mXScale;
+    const double yScale = mYScale;
 
-    // Rotate to surface coordinate.
+    // Rotate to surface coordinate, as surface = rotation * (xScaled, yScaled) + offset.
     // 0 - no swap and reverse.
     // 90 - swap x/y and reverse y.
     // 180 - reverse x, y.
     // 270 - swap x/y and reverse x.
+    double r11, r12, r21, r22, offsetX, offsetY;
     switch (mSurfaceOrientation) {
-        case DISPLAY_ORIENTATION_0:
-            x = xScaled + mXTranslate;
-            y = yScaled + mYTranslate;
-            break;
         case DISPLAY_ORIENTATION_90:
-            y = mSurfaceRight - xScaled;
-            x = yScaled + mYTranslate;
+            r11 = 0, r12 = 1, offsetX = mYTranslate;
+            r21 = -1, r22 = 0, offsetY = mSurfaceRight;
             break;
         case DISPLAY_ORIENTATION_180:
-            x = mSurfaceRight - xScaled;
-            y = mSurfaceBottom - yScaled;
+            r11 = -1, r12 = 0, offsetX = mSurfaceRight;
+            r21 = 0, r22 = -1, offsetY = mSurfaceBottom;
             break;
         case DISPLAY_ORIENTATION_270:
-            y = xScaled + mXTranslate;
-            x = mSurfaceBottom - yScaled;
+            r11 = 0, r12 = -1, offsetX = mSurfaceBottom;
+            r21 = 1, r22 = 0, offsetY = mXTranslate;
             break;
         default:
-            assert(false);
+            r11 = 1, r12 = 0, offsetX = mXTranslate;
+            r21 = 0, r22 = 1, offsetY = mYTranslate;
+            break;
     }
+
+    // Fold the scaling into the rotation, and the raw axis minimums into the offset.
+    const double m11 = r11 * xScale, m12 = r12 * yScale;
+    const double m21 = r21 * xScale, m22 = r22 * yScale;
+    offsetX -= m11 * mRawPointerAxes.x.minValue + m12 * mRawPointerAxes.y.minValue;
+    offsetY -= m21 * mRawPointerAxes.x.minValue + m22 * mRawPointerAxes.y.minValue;
+
+    // Apply the result after the calibration transform.
+    const TouchAffineTransformation& a = mAffineTransform;
+    mSurfaceTransform.x_scale = m11 * a.x_scale + m12 * a.y_xmix;
+    mSurfaceTransform.x_ymix = m11 * a.x_ymix + m12 * a.y_scale;
+    mSurfaceTransform.x_offset = m11 * a.x_offset + m12 * a.y_offset + offsetX;
+    mSurfaceTransform.y_xmix = m21 * a.x_scale + m22 * a.y_xmix;
+    mSurfaceTransform.y_scale = m21 * a.x_ymix + m22 * a.y_scale;
+    mSurfaceTransform.y_offset = m21 * a.x_offset + m22 * a.y_offset + offsetY;
 }
 
 bool TouchInputMapper::isPointInsideSurface(int32_t x, int32_t y) {
@@ -292,6 +292,9 @@ protected:
     // Affine location transformation/calibration
     struct TouchAffineTransformation mAffineTransform;
 
+    // mAffineTransform followed by the mapping from raw to surface coordinates.
+    struct TouchAffineTransformation mSurfaceTransform;
+
     RawPointerAxes mRawPointerAxes;
 
     struct RawState {
@@ -761,7 +764,9 @@ private:
     static void assignPointerIds(const RawState* last, RawState* current);
 
     const char* modeToString(DeviceMode deviceMode);
-    void rotateAndScale(float& x, float& y);
+    void updateSurfaceTransform();
+    void cookCoverage(const RawPointerData::Pointer& in, float* outLeft, float* outTop,
+                      float* outRight, float* outBottom) const;
 };
 
 } // namespace android
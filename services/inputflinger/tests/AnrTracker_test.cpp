@@ -162,6 +162,48 @@ TEST(AnrTrackerTest, RemoveInvalidItem_DoesntCrash) {
     ASSERT_EQ(nullptr, tracker.firstToken());
 }
 
+TEST(AnrTrackerTest, SingleToken_OutOfOrderInsert_MaintainsOrder) {
+    AnrTracker tracker;
+
+    sp<IBinder> token1 = new BBinder();
+    sp<IBinder> token2 = new BBinder();
+
+    tracker.insert(3, token1);
+    tracker.insert(5, token1);
+    tracker.insert(4, token2);
+    tracker.insert(1, token1);
+
+    ASSERT_EQ(1, tracker.firstTimeout());
+    ASSERT_EQ(token1, tracker.firstToken());
+
+    tracker.erase(1, token1);
+    ASSERT_EQ(3, tracker.firstTimeout());
+    ASSERT_EQ(token1, tracker.firstToken());
+
+    tracker.erase(3, token1);
+    ASSERT_EQ(4, tracker.firstTimeout());
+    ASSERT_EQ(token2, tracker.firstToken());
+}
+
+TEST(AnrTrackerTest, SingleToken_RemoveMiddle_KeepsFirst) {
+    AnrTracker tracker;
+
+    sp<IBinder> token = new BBinder();
+
+    tracker.insert(1, token);
+    tracker.insert(2, token);
+    tracker.insert(3, token);
+
+    tracker.erase(2, token);
+    ASSERT_EQ(1, tracker.firstTimeout());
+
+    tracker.erase(1, token);
+    ASSERT_EQ(3, tracker.firstTimeout());
+
+    tracker.erase(3, token);
+    ASSERT_TRUE(tracker.empty());
+}
+
 } // namespace inputdispatcher
 
 } // namespace android
@@ -87,7 +87,7 @@ TEST(BlockingQueueTest, Queue_Erases) {
     queue.push(3);
     queue.push(4);
     // Erase elements 2 and 4
-    queue.erase([](int element) { return element == 2 || element == 4; });
+    ASSERT_EQ(2U, queue.erase([](int element) { return element == 2 || element == 4; }));
     // Should no longer receive elements 2 and 4
     ASSERT_EQ(1, queue.pop());
     ASSERT_EQ(3, queue.pop());
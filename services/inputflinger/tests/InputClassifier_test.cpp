@@ -260,6 +260,29 @@ TEST_F(MotionClassifierTest, Classify_TwoVideoFrames) {
 /**
  * Make sure MotionClassifier does not crash when it is reset.
  */
+/**
+ * A burst of ACTION_MOVE events should be collapsed or skipped rather than overflowing the
+ * queue. Make sure this does not crash.
+ */
+TEST_F(MotionClassifierTest, Classify_ManyMoves_DoesNotCrash) {
+    NotifyMotionArgs motionArgs = generateBasicMotionArgs();
+    motionArgs.action = AMOTION_EVENT_ACTION_DOWN;
+    ASSERT_NO_FATAL_FAILURE(mMotionClassifier->classify(motionArgs));
+
+    motionArgs.action = AMOTION_EVENT_ACTION_MOVE;
+    for (int i = 0; i < 20; i++) {
+        motionArgs.eventTime += 1000000; // 1 ms
+        ASSERT_NO_FATAL_FAILURE(mMotionClassifier->classify(motionArgs));
+    }
+
+    motionArgs.action = AMOTION_EVENT_ACTION_UP;
+    ASSERT_NO_FATAL_FAILURE(mMotionClassifier->classify(motionArgs));
+
+    std::string dump;
+    mMotionClassifier->dump(dump);
+    ASSERT_NE(std::string::npos, dump.find("HAL latency"));
+}
+
 TEST_F(MotionClassifierTest, Reset_DoesNotCrash) {
     ASSERT_NO_FATAL_FAILURE(mMotionClassifier->reset());
 }
@@ -1211,6 +1211,41 @@ TEST_F(InputDispatcherTest, DispatchMouseEventsUnderCursor) {
     windowRight->assertNoEvents();
 }
 
+TEST_F(InputDispatcherTest, TouchInGridOfWindows_DispatchesOnlyToWindowUnderPointer) {
+    sp<FakeApplicationHandle> application = new FakeApplicationHandle();
+
+    // Enough non-overlapping windows that they land in different cells of the hit-test index.
+    constexpr int32_t kColumns = 6;
+    constexpr int32_t kRows = 6;
+    constexpr int32_t kSize = 100;
+    std::vector<sp<InputWindowHandle>> windows;
+    for (int32_t row = 0; row < kRows; row++) {
+        for (int32_t column = 0; column < kColumns; column++) {
+            sp<FakeWindowHandle> window =
+                    new FakeWindowHandle(application, mDispatcher, "Cell", ADISPLAY_ID_DEFAULT);
+            window->setFrame(Rect(column * kSize, row * kSize, (column + 1) * kSize,
+                                  (row + 1) * kSize));
+            window->setLayoutParamFlags(InputWindowInfo::FLAG_NOT_TOUCH_MODAL);
+            windows.push_back(window);
+        }
+    }
+    mDispatcher->setInputWindows({{ADISPLAY_ID_DEFAULT, windows}});
+
+    // Touch the bottom edge of the window in row 3, column 4.
+    ASSERT_EQ(INPUT_EVENT_INJECTION_SUCCEEDED,
+              injectMotionDown(mDispatcher, AINPUT_SOURCE_TOUCHSCREEN, ADISPLAY_ID_DEFAULT,
+                               {4 * kSize + 50, 4 * kSize - 1}));
+    const size_t touched = 3 * kColumns + 4;
+    for (size_t i = 0; i < windows.size(); i++) {
+        FakeWindowHandle* window = static_cast<FakeWindowHandle*>(windows[i].get());
+        if (i == touched) {
+            window->consumeMotionDown(ADISPLAY_ID_DEFAULT);
+        } else {
+            window->assertNoEvents();
+        }
+    }
+}
+
 TEST_F(InputDispatcherTest, NotifyDeviceReset_CancelsKeyStream) {
     sp<FakeApplicationHandle> application = new FakeApplicationHandle();
     sp<FakeWindowHandle> window =
@@ -285,6 +285,10 @@ public:
         mConfig.showTouches = enabled;
     }
 
+    void setParallelEventCooking(bool enabled) {
+        mConfig.parallelEventCooking = enabled;
+    }
+
     void setDefaultPointerDisplayId(int32_t pointerDisplayId) {
         mConfig.defaultPointerDisplayId = pointerDisplayId;
     }
@@ -1349,6 +1353,35 @@ TEST_F(InputReaderPolicyTest, Viewports_GetByPort) {
     ASSERT_FALSE(hdmi2Viewport);
 }
 
+// --- QueuedInputListenerTest ---
+
+TEST(QueuedInputListenerTest, MergeByEventTime_InterleavesQueuesInEventTimeOrder) {
+    sp<TestInputListener> testListener = new TestInputListener();
+    sp<QueuedInputListener> mergedListener = new QueuedInputListener(testListener);
+    sp<QueuedInputListener> firstListener = new QueuedInputListener(nullptr);
+    sp<QueuedInputListener> secondListener = new QueuedInputListener(nullptr);
+
+    NotifyConfigurationChangedArgs args1(/* id */ 1, /* eventTime */ 10);
+    NotifyConfigurationChangedArgs args2(/* id */ 2, /* eventTime */ 30);
+    NotifyConfigurationChangedArgs args3(/* id */ 3, /* eventTime */ 20);
+    NotifyConfigurationChangedArgs args4(/* id */ 4, /* eventTime */ 30);
+    firstListener->notifyConfigurationChanged(&args1);
+    firstListener->notifyConfigurationChanged(&args2);
+    secondListener->notifyConfigurationChanged(&args3);
+    secondListener->notifyConfigurationChanged(&args4);
+
+    mergedListener->mergeByEventTime({firstListener, secondListener});
+    mergedListener->flush();
+
+    // Equal event times keep the order in which the queues were passed in.
+    NotifyConfigurationChangedArgs args;
+    for (int32_t expectedId : {1, 3, 2, 4}) {
+        ASSERT_NO_FATAL_FAILURE(testListener->assertNotifyConfigurationChangedWasCalled(&args));
+        ASSERT_EQ(expectedId, args.id);
+    }
+    ASSERT_NO_FATAL_FAILURE(testListener->assertNotifyConfigurationChangedWasNotCalled());
+}
+
 // --- InputReaderTest ---
 
 class InputReaderTest : public testing::Test {
@@ -1642,6 +1675,37 @@ TEST_F(InputReaderTest, LoopOnce_ForwardsRawEventsToMappers) {
     ASSERT_EQ(1, event.value);
 }
 
+TEST_F(InputReaderTest, LoopOnce_WithParallelEventCooking_ForwardsRawEventsToMappers) {
+    mFakePolicy->setParallelEventCooking(true);
+    mReader->requestRefreshConfiguration(InputReaderConfiguration::CHANGE_ENABLED_STATE);
+    mReader->loopOnce();
+
+    constexpr int32_t touchEventHubId = 1;
+    constexpr int32_t joystickEventHubId = 2;
+    FakeInputMapper& touchMapper =
+            addDeviceWithFakeInputMapper(END_RESERVED_ID + 1000, touchEventHubId, "touch",
+                                         INPUT_DEVICE_CLASS_TOUCH, AINPUT_SOURCE_TOUCHSCREEN,
+                                         nullptr);
+    FakeInputMapper& joystickMapper =
+            addDeviceWithFakeInputMapper(END_RESERVED_ID + 1001, joystickEventHubId, "joystick",
+                                         INPUT_DEVICE_CLASS_JOYSTICK, AINPUT_SOURCE_JOYSTICK,
+                                         nullptr);
+
+    mFakeEventHub->enqueueEvent(0, touchEventHubId, EV_KEY, BTN_TOUCH, 1);
+    mFakeEventHub->enqueueEvent(1, joystickEventHubId, EV_KEY, BTN_A, 1);
+    mReader->loopOnce();
+    mReader->loopOnce();
+    ASSERT_NO_FATAL_FAILURE(mFakeEventHub->assertQueueIsEmpty());
+
+    RawEvent event;
+    ASSERT_NO_FATAL_FAILURE(touchMapper.assertProcessWasCalled(&event));
+    ASSERT_EQ(touchEventHubId, event.deviceId);
+    ASSERT_EQ(BTN_TOUCH, event.code);
+    ASSERT_NO_FATAL_FAILURE(joystickMapper.assertProcessWasCalled(&event));
+    ASSERT_EQ(joystickEventHubId, event.deviceId);
+    ASSERT_EQ(BTN_A, event.code);
+}
+
 TEST_F(InputReaderTest, DeviceReset_RandomId) {
     constexpr int32_t deviceId = END_RESERVED_ID + 1000;
     constexpr uint32_t deviceClass = INPUT_DEVICE_CLASS_KEYBOARD;
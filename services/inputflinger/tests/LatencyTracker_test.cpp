@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../LatencyTracker.h"
+
+#include <gtest/gtest.h>
+
+namespace android {
+
+namespace inputdispatcher {
+
+using Stage = LatencyTracker::Stage;
+
+static const LatencyTracker::Histogram& stage(const LatencyTracker::Timeline& timeline,
+                                              Stage s) {
+    return timeline[static_cast<size_t>(s)];
+}
+
+// --- LatencyTrackerTest ---
+
+TEST(LatencyTrackerTest, TrackFinishedEvent_RecordsEachStageFromEventTime) {
+    LatencyTracker tracker;
+
+    tracker.trackFinishedEvent(/*displayId*/ 0, "window", /*eventTime*/ 0, us2ns(100), us2ns(300),
+                               us2ns(5000));
+
+    const LatencyTracker::Timeline* timeline = tracker.getDisplayTimeline(0);
+    ASSERT_NE(nullptr, timeline);
+    ASSERT_EQ(1u, stage(*timeline, Stage::DISPATCH).count);
+    ASSERT_EQ(100, stage(*timeline, Stage::DISPATCH).maxUs);
+    ASSERT_EQ(300, stage(*timeline, Stage::PUBLISH).maxUs);
+    ASSERT_EQ(5000, stage(*timeline, Stage::FINISH).maxUs);
+    // 100us falls in [64, 128).
+    ASSERT_EQ(1u, stage(*timeline, Stage::DISPATCH).buckets[6]);
+
+    timeline = tracker.getWindowTimeline("window");
+    ASSERT_NE(nullptr, timeline);
+    ASSERT_EQ(5000, stage(*timeline, Stage::FINISH).totalUs);
+
+    ASSERT_EQ(nullptr, tracker.getDisplayTimeline(1));
+}
+
+TEST(LatencyTrackerTest, TrackFinishedEvent_AggregatesWindowsOverLimit) {
+    LatencyTracker tracker;
+
+    const size_t windowCount = LatencyTracker::MAX_TRACKED_WINDOWS + 5;
+    for (size_t i = 0; i < windowCount; i++) {
+        tracker.trackFinishedEvent(0, "window" + std::to_string(i), 0, 1, 2, 3);
+    }
+
+    ASSERT_NE(nullptr, tracker.getWindowTimeline("window0"));
+    ASSERT_EQ(nullptr, tracker.getWindowTimeline("window" + std::to_string(windowCount - 1)));
+    const LatencyTracker::Timeline* other = tracker.getWindowTimeline("<other windows>");
+    ASSERT_NE(nullptr, other);
+    ASSERT_EQ(windowCount - LatencyTracker::MAX_TRACKED_WINDOWS + 1,
+              stage(*other, Stage::FINISH).count);
+    ASSERT_EQ(windowCount, stage(*tracker.getDisplayTimeline(0), Stage::FINISH).count);
+}
+
+TEST(LatencyTrackerTest, Clear_RemovesAllTimelines) {
+    LatencyTracker tracker;
+    tracker.trackFinishedEvent(0, "window", 0, 1, 2, 3);
+
+    tracker.clear();
+
+    ASSERT_EQ(nullptr, tracker.getDisplayTimeline(0));
+    ASSERT_EQ(nullptr, tracker.getWindowTimeline("window"));
+}
+
+} // namespace inputdispatcher
+
+} // namespace android
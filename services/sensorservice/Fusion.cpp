@@ -487,7 +487,23 @@ void Fusion::predict(const vec3_t& w, float dT) {
     if (x0.w < 0)
         x0 = -x0;
 
-    P = Phi*P*transpose(Phi) + GQGt;
+    // Phi is | A B | so most of the generic block product multiplies by 0 or I.
+    //        | 0 I |
+    //
+    // Phi*P*Phi' = | (A*P00 + B*P01)*A' + (A*P10 + B*P11)*B'   A*P10 + B*P11 |
+    //              | P01*A' + P11*B'                           P11           |
+    //
+    // where P10 is P[1][0], the top-right block. This needs 8 3x3 products instead of 16.
+    const mat33_t& A = Phi[0][0];
+    const mat33_t& B = Phi[1][0];
+    const mat33_t At(transpose(A));
+    const mat33_t Bt(transpose(B));
+    const mat33_t APB0(A*P[0][0] + B*P[0][1]);
+    const mat33_t APB1(A*P[1][0] + B*P[1][1]);
+    P[0][0] = APB0*At + APB1*Bt + GQGt[0][0];
+    P[0][1] = P[0][1]*At + P[1][1]*Bt + GQGt[0][1];
+    P[1][0] = APB1 + GQGt[1][0];
+    P[1][1] += GQGt[1][1];
 
     checkState();
 }
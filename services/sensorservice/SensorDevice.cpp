@@ -29,10 +29,12 @@
 #include <utils/Errors.h>
 #include <utils/Singleton.h>
 
+#include <algorithm>
 #include <cstddef>
 #include <chrono>
 #include <cinttypes>
 #include <thread>
+#include <vector>
 
 using namespace android::hardware::sensors;
 using namespace android::hardware::sensors::V1_0;
@@ -139,7 +141,6 @@ void SensorDevice::initializeSensorList() {
                 const size_t count = list.size();
 
                 mActivationCount.setCapacity(count);
-                Info model;
                 for (size_t i=0 ; i < count; i++) {
                     sensor_t sensor;
                     convertToSensor(convertToOldSensorInfo(list[i]), &sensor);
@@ -176,7 +177,10 @@ void SensorDevice::initializeSensorList() {
                     }
                     mSensorList.push_back(sensor);
 
-                    mActivationCount.add(list[i].sensorHandle, model);
+                    Info info;
+                    info.hasFifo = sensor.fifoMaxEventCount > 0;
+                    info.isWakeUp = (sensor.flags & SENSOR_FLAG_WAKE_UP) != 0;
+                    mActivationCount.add(list[i].sensorHandle, info);
 
                     // Only disable all sensors on HAL 1.0 since HAL 2.0
                     // handles this in its initialize method
@@ -455,8 +459,47 @@ std::string SensorDevice::dump() const {
                     isClientDisabledLocked(info.batchParams.keyAt(j)) ? "(disabled)" : "",
                     (j < info.batchParams.size() - 1) ? ", " : "");
         }
-        result.appendFormat("}, selected = %.2f ms\n", info.bestBatchParams.mTBatch / 1e6f);
+        result.appendFormat("}, selected = %.2f ms", info.bestBatchParams.mTBatch / 1e6f);
+        if (info.halBatchParams.mTBatch != info.bestBatchParams.mTBatch) {
+            result.appendFormat(", aligned = %.2f ms", info.halBatchParams.mTBatch / 1e6f);
+        }
+        result.append("\n");
+    }
+
+    // Estimate how often the wake-up sensors bring the AP out of suspend. A streaming sensor
+    // wakes it for every sample and a batching one on every FIFO flush; sensors whose report
+    // periods are multiples of a shorter one are assumed to flush along with it.
+    auto wakeupsPerSecond = [](std::vector<nsecs_t> periods) {
+        std::sort(periods.begin(), periods.end());
+        double rate = 0;
+        for (size_t i = 0; i < periods.size(); i++) {
+            bool coincides = false;
+            for (size_t j = 0; j < i && !coincides; j++) {
+                coincides = periods[i] % periods[j] == 0;
+            }
+            if (!coincides) {
+                rate += 1e9 / periods[i];
+            }
+        }
+        return rate;
+    };
+    auto reportPeriod = [](const Info& info, const BatchParams& params) {
+        return info.hasFifo && params.mTBatch > 0 ? params.mTBatch : params.mTSample;
+    };
+    std::vector<nsecs_t> alignedPeriods;
+    std::vector<nsecs_t> requestedPeriods;
+    for (size_t i = 0; i < mActivationCount.size(); i++) {
+        const Info& info = mActivationCount.valueAt(i);
+        if (!info.isWakeUp || info.numActiveClients() == 0) continue;
+        nsecs_t aligned = reportPeriod(info, info.halBatchParams);
+        nsecs_t requested = reportPeriod(info, info.bestBatchParams);
+        if (aligned > 0 && aligned < INT64_MAX) alignedPeriods.push_back(aligned);
+        if (requested > 0 && requested < INT64_MAX) requestedPeriods.push_back(requested);
     }
+    result.appendFormat("Expected AP wake-ups: %.2f/s (%.2f/s without batch alignment), "
+                        "batch quantum = %.2f ms\n",
+                        wakeupsPerSecond(alignedPeriods), wakeupsPerSecond(requestedPeriods),
+                        batchLatencyQuantumLocked() / 1e6f);
 
     return result.string();
 }
@@ -717,16 +760,14 @@ status_t SensorDevice::activateLocked(void* ident, int handle, int enabled) {
             if (info.numActiveClients() == 0) {
                 // This is the last connection, we need to de-activate the underlying h/w sensor.
                 activateHardware = true;
+                info.halBatchParams = BatchParams();
             } else {
                 // Call batch for this sensor with the previously calculated best effort
                 // batch_rate and timeout. One of the apps has unregistered for sensor
                 // events, and the best effort batch parameters might have changed.
-                ALOGD_IF(DEBUG_CONNECTIONS,
-                         "\t>>> actuating h/w batch 0x%08x %" PRId64 " %" PRId64, handle,
-                         info.bestBatchParams.mTSample, info.bestBatchParams.mTBatch);
-                checkReturn(mSensors->batch(
-                        handle, info.bestBatchParams.mTSample, info.bestBatchParams.mTBatch));
+                batchHardwareLocked(handle, info, batchLatencyQuantumLocked());
             }
+            realignBatchLatenciesLocked(handle);
         } else {
             // sensor wasn't enabled for this ident
         }
@@ -825,17 +866,76 @@ status_t SensorDevice::updateBatchParamsLocked(int handle, Info &info) {
              prevBestBatchParams.mTBatch, info.bestBatchParams.mTBatch);
 
     status_t err(NO_ERROR);
-    // If the min period or min timeout has changed since the last batch call, call batch.
-    if (prevBestBatchParams != info.bestBatchParams && info.numActiveClients() > 0) {
-        ALOGD_IF(DEBUG_CONNECTIONS, "\t>>> actuating h/w BATCH 0x%08x %" PRId64 " %" PRId64, handle,
-                 info.bestBatchParams.mTSample, info.bestBatchParams.mTBatch);
-        err = checkReturnAndGetStatus(mSensors->batch(
-                handle, info.bestBatchParams.mTSample, info.bestBatchParams.mTBatch));
+    // If the parameters the HAL should use have changed since the last batch call, call batch.
+    if (info.numActiveClients() > 0) {
+        err = batchHardwareLocked(handle, info, batchLatencyQuantumLocked());
+    } else {
+        info.halBatchParams = BatchParams();
+    }
+
+    // A new batch latency for this sensor may move the quantum the others are aligned to.
+    if (err == NO_ERROR && prevBestBatchParams != info.bestBatchParams) {
+        realignBatchLatenciesLocked(handle);
     }
 
     return err;
 }
 
+nsecs_t SensorDevice::batchLatencyQuantumLocked() const {
+    // Only wake-up sensors bring the AP out of suspend, so they set the pace. Non wake-up
+    // sensors are flushed whenever the AP is awake anyway.
+    nsecs_t quantum = 0;
+    for (size_t i = 0; i < mActivationCount.size(); ++i) {
+        const Info& info = mActivationCount.valueAt(i);
+        if (!info.hasFifo || !info.isWakeUp || info.numActiveClients() == 0 ||
+            info.bestBatchParams.mTBatch == 0) {
+            continue;
+        }
+        if (quantum == 0 || info.bestBatchParams.mTBatch < quantum) {
+            quantum = info.bestBatchParams.mTBatch;
+        }
+    }
+    return quantum;
+}
+
+SensorDevice::BatchParams SensorDevice::alignedBatchParams(const Info& info, nsecs_t quantum) {
+    BatchParams params = info.bestBatchParams;
+    // Rounding down only ever shortens the latency, so every client still gets its events in
+    // time. The FIFO then flushes on a multiple of the quantum, along with the fastest sensor.
+    if (info.hasFifo && quantum > 0 && params.mTBatch > quantum) {
+        params.mTBatch -= params.mTBatch % quantum;
+    }
+    return params;
+}
+
+status_t SensorDevice::batchHardwareLocked(int handle, Info& info, nsecs_t quantum) {
+    BatchParams params = alignedBatchParams(info, quantum);
+    if (!(params != info.halBatchParams)) {
+        return NO_ERROR;
+    }
+
+    ALOGD_IF(DEBUG_CONNECTIONS, "\t>>> actuating h/w BATCH 0x%08x %" PRId64 " %" PRId64, handle,
+             params.mTSample, params.mTBatch);
+    status_t err = checkReturnAndGetStatus(mSensors->batch(handle, params.mTSample, params.mTBatch));
+    if (err == NO_ERROR) {
+        info.halBatchParams = params;
+    }
+    return err;
+}
+
+void SensorDevice::realignBatchLatenciesLocked(int changedHandle) {
+    const nsecs_t quantum = batchLatencyQuantumLocked();
+    for (size_t i = 0; i < mActivationCount.size(); ++i) {
+        const int handle = mActivationCount.keyAt(i);
+        Info& info = mActivationCount.editValueAt(i);
+        if (handle == changedHandle || !info.hasFifo || info.numActiveClients() == 0) {
+            continue;
+        }
+        status_t err = batchHardwareLocked(handle, info, quantum);
+        ALOGE_IF(err, "Error aligning batch latency of sensor %d (%s)", handle, strerror(-err));
+    }
+}
+
 status_t SensorDevice::setDelay(void* ident, int handle, int64_t samplingPeriodNs) {
     return batch(ident, handle, 0, samplingPeriodNs, 0);
 }
@@ -930,13 +1030,17 @@ void SensorDevice::enableAllSensors() {
         Info& info = mActivationCount.editValueAt(i);
         if (info.batchParams.isEmpty()) continue;
         info.selectBatchParams();
+    }
+
+    const nsecs_t quantum = batchLatencyQuantumLocked();
+    for (size_t i = 0; i< mActivationCount.size(); ++i) {
+        Info& info = mActivationCount.editValueAt(i);
+        if (info.batchParams.isEmpty()) continue;
         const int sensor_handle = mActivationCount.keyAt(i);
         ALOGD_IF(DEBUG_CONNECTIONS, "\t>> reenable actuating h/w sensor enable handle=%d ",
                    sensor_handle);
-        status_t err = checkReturnAndGetStatus(mSensors->batch(
-                sensor_handle,
-                info.bestBatchParams.mTSample,
-                info.bestBatchParams.mTBatch));
+        info.halBatchParams = BatchParams();
+        status_t err = batchHardwareLocked(sensor_handle, info, quantum);
         ALOGE_IF(err, "Error calling batch on sensor %d (%s)", sensor_handle, strerror(-err));
 
         if (err == NO_ERROR) {
@@ -971,6 +1075,7 @@ void SensorDevice::disableAllSensors() {
            }
 
            info.isActive = false;
+           info.halBatchParams = BatchParams();
         }
     }
 }
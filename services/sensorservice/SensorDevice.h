@@ -145,7 +145,7 @@ private:
       nsecs_t mTSample, mTBatch;
       BatchParams() : mTSample(INT64_MAX), mTBatch(INT64_MAX) {}
       BatchParams(nsecs_t tSample, nsecs_t tBatch): mTSample(tSample), mTBatch(tBatch) {}
-      bool operator != (const BatchParams& other) {
+      bool operator != (const BatchParams& other) const {
           return !(mTSample == other.mTSample && mTBatch == other.mTBatch);
       }
       // Merge another parameter with this one. The updated mTSample will be the min of the two.
@@ -169,9 +169,17 @@ private:
         // requested by the client.
         KeyedVector<void*, BatchParams> batchParams;
 
+        // The parameters last passed to the HAL. The batch latency may be shorter than the one
+        // in bestBatchParams, see alignedBatchParams().
+        BatchParams halBatchParams;
+
         // Flag to track if the sensor is active
         bool isActive = false;
 
+        // Whether the sensor has a hardware FIFO, i.e. whether a batch latency means anything.
+        bool hasFifo = false;
+        bool isWakeUp = false;
+
         // Sets batch parameters for this ident. Returns error if this ident is not already present
         // in the KeyedVector above.
         status_t setBatchParamsForIdent(void* ident, int flags, int64_t samplingPeriodNs,
@@ -243,6 +251,15 @@ private:
                          int64_t maxBatchReportLatencyNs);
 
     status_t updateBatchParamsLocked(int handle, Info& info);
+    // Batch latencies of sensors with a FIFO are rounded down to a multiple of the shortest batch
+    // latency among the active wake-up sensors (the quantum), so that FIFO flushes coincide and
+    // wake the AP together instead of at unrelated times.
+    nsecs_t batchLatencyQuantumLocked() const;
+    static BatchParams alignedBatchParams(const Info& info, nsecs_t quantum);
+    // Passes the aligned parameters of a sensor to the HAL if they changed.
+    status_t batchHardwareLocked(int handle, Info& info, nsecs_t quantum);
+    // Re-aligns every other active sensor after the quantum may have changed.
+    void realignBatchLatenciesLocked(int changedHandle);
     status_t doActivateHardwareLocked(int handle, bool enable);
 
     void handleHidlDeath(const std::string &detail);
@@ -64,7 +64,9 @@ void SensorService::SensorDirectConnection::dump(String8& result) const {
     result.appendFormat("\tPackage %s, HAL channel handle %d, total sensor activated %zu\n",
             String8(mOpPackageName).string(), getHalChannelHandle(), mActivated.size());
     for (auto &i : mActivated) {
-        result.appendFormat("\t\tSensor %#08x, rate %d\n", i.first, i.second);
+        auto token = mReportTokens.find(i.first);
+        result.appendFormat("\t\tSensor %#08x, rate %d, token %d\n", i.first, i.second,
+                token != mReportTokens.end() ? token->second : 0);
     }
 }
 
@@ -162,18 +164,34 @@ int32_t SensorService::SensorDirectConnection::configureChannel(int handle, int
     };
 
     Mutex::Autolock _l(mConnectionLock);
+    if (rateLevel != SENSOR_DIRECT_RATE_STOP) {
+        // The sensor already writes into this channel at the requested rate, the HAL would hand
+        // back the same token.
+        auto activated = mActivated.find(handle);
+        auto token = mReportTokens.find(handle);
+        if (activated != mActivated.end() && activated->second == rateLevel
+                && token != mReportTokens.end()) {
+            return token->second;
+        }
+    }
+
     SensorDevice& dev(SensorDevice::getInstance());
     int ret = dev.configureDirectChannel(handle, getHalChannelHandle(), &config);
 
     if (rateLevel == SENSOR_DIRECT_RATE_STOP) {
         if (ret == NO_ERROR) {
             mActivated.erase(handle);
+            mReportTokens.erase(handle);
         } else if (ret > 0) {
             ret = UNKNOWN_ERROR;
         }
     } else {
         if (ret > 0) {
             mActivated[handle] = rateLevel;
+            mReportTokens[handle] = ret;
+        } else {
+            // The previous configuration may or may not have survived, ask the HAL next time.
+            mReportTokens.erase(handle);
         }
     }
 
@@ -199,6 +217,7 @@ void SensorService::SensorDirectConnection::stopAllLocked(bool backupRecord) {
         mActivatedBackup = mActivated;
     }
     mActivated.clear();
+    mReportTokens.clear();
 }
 
 void SensorService::SensorDirectConnection::recoverAll() {
@@ -219,7 +238,10 @@ void SensorService::SensorDirectConnection::recoverAll() {
             struct sensors_direct_cfg_t config = {
                 .rate_level = i.second
             };
-            dev.configureDirectChannel(i.first, getHalChannelHandle(), &config);
+            int ret = dev.configureDirectChannel(i.first, getHalChannelHandle(), &config);
+            if (ret > 0) {
+                mReportTokens[i.first] = ret;
+            }
         }
     }
 }
@@ -91,6 +91,9 @@ private:
     mutable Mutex mConnectionLock;
     std::unordered_map<int, int> mActivated;
     std::unordered_map<int, int> mActivatedBackup;
+    // Report token the HAL returned for each sensor in mActivated. Used to answer a request for
+    // the rate a sensor already runs at without another round trip to the HAL.
+    std::unordered_map<int, int> mReportTokens;
 
     mutable Mutex mDestroyLock;
     bool mDestroyed;
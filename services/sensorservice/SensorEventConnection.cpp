@@ -14,6 +14,8 @@
  * limitations under the License.
  */
 
+#include <algorithm>
+
 #include <log/log.h>
 #include <sys/socket.h>
 #include <utils/threads.h>
@@ -41,7 +43,8 @@ SensorService::SensorEventConnection::SensorEventConnection(
         const String16& opPackageName)
     : mService(service), mUid(uid), mWakeLockRefCount(0), mHasLooperCallbacks(false),
       mDead(false), mDataInjectionMode(isDataInjectionMode), mEventCache(nullptr),
-      mCacheSize(0), mMaxCacheSize(0), mTimeOfLastEventDrop(0), mEventsDropped(0),
+      mCacheStart(0), mCacheSize(0), mMaxCacheSize(0), mTimeOfLastEventDrop(0),
+      mEventsDropped(0),
       mPackageName(packageName), mOpPackageName(opPackageName), mTargetSdk(kTargetSdkUnknown),
       mDestroyed(false) {
     mChannel = new BitTube(mService->mSocketBufferSize);
@@ -296,6 +299,23 @@ status_t SensorService::SensorEventConnection::sendEvents(
     int count = 0;
     Mutex::Autolock _l(mConnectionLock);
     if (scratch) {
+        // Most of the time a connection takes every event in the batch. Events are therefore only
+        // copied to scratch once one of them is filtered out; until then, the accepted events are
+        // exactly the start of buffer.
+        bool copiedToScratch = false;
+        auto acceptEvent = [&](size_t index) {
+            if (copiedToScratch) {
+                scratch[count] = buffer[index];
+            }
+            count++;
+        };
+        auto rejectEvent = [&]() {
+            if (!copiedToScratch) {
+                std::copy(buffer, buffer + count, scratch);
+                copiedToScratch = true;
+            }
+        };
+
         size_t i=0;
         while (i<numEvents) {
             int32_t sensor_handle = buffer[i].sensor;
@@ -311,6 +331,7 @@ status_t SensorService::SensorEventConnection::sendEvents(
             // Check if this connection has registered for this sensor. If not continue to the
             // next sensor_event.
             if (mSensorInfo.count(sensor_handle) == 0) {
+                rejectEvent();
                 ++i;
                 continue;
             }
@@ -322,6 +343,7 @@ status_t SensorService::SensorEventConnection::sendEvents(
                 flushInfo.mFirstFlushPending = false;
                 ALOGD_IF(DEBUG_CONNECTIONS, "First flush event for sensor==%d ",
                         buffer[i].meta_data.sensor);
+                rejectEvent();
                 ++i;
                 continue;
             }
@@ -329,6 +351,7 @@ status_t SensorService::SensorEventConnection::sendEvents(
             // If there is a pending flush complete event for this sensor on this connection,
             // ignore the event and proceed to the next.
             if (flushInfo.mFirstFlushPending) {
+                rejectEvent();
                 ++i;
                 continue;
             }
@@ -340,13 +363,17 @@ status_t SensorService::SensorEventConnection::sendEvents(
                 // corresponding flush_complete_event.
                 if (buffer[i].type == SENSOR_TYPE_META_DATA) {
                     if (mapFlushEventsToConnections[i] == this) {
-                        scratch[count++] = buffer[i];
+                        acceptEvent(i);
+                    } else {
+                        rejectEvent();
                     }
                 } else {
                     // Regular sensor event, just copy it to the scratch buffer after checking
                     // the AppOp.
                     if (hasSensorAccess() && noteOpIfRequired(buffer[i])) {
-                        scratch[count++] = buffer[i];
+                        acceptEvent(i);
+                    } else {
+                        rejectEvent();
                     }
                 }
                 i++;
@@ -355,6 +382,15 @@ status_t SensorService::SensorEventConnection::sendEvents(
                                        (buffer[i].type == SENSOR_TYPE_META_DATA  &&
                                         buffer[i].meta_data.sensor == sensor_handle)));
         }
+
+        // The wake up flag is set on the events that are sent, so those must come from scratch.
+        if (!copiedToScratch) {
+            if (findWakeUpSensorEventLocked(buffer, count) >= 0) {
+                std::copy(buffer, buffer + count, scratch);
+            } else {
+                scratch = const_cast<sensors_event_t *>(buffer);
+            }
+        }
     } else {
         if (hasSensorAccess()) {
             scratch = const_cast<sensors_event_t *>(buffer);
@@ -416,6 +452,7 @@ status_t SensorService::SensorEventConnection::sendEvents(
         if (mEventCache == nullptr) {
             mMaxCacheSize = computeMaxCacheSizeLocked();
             mEventCache = new sensors_event_t[mMaxCacheSize];
+            mCacheStart = 0;
             mCacheSize = 0;
         }
         // Save the events so that they can be written later
@@ -474,7 +511,10 @@ void SensorService::SensorEventConnection::reAllocateCacheLocked(sensors_event_t
     const int new_cache_size = computeMaxCacheSizeLocked();
     // Allocate new cache, copy over events from the old cache & scratch, free up memory.
     eventCache_new = new sensors_event_t[new_cache_size];
-    memcpy(eventCache_new, mEventCache, mCacheSize * sizeof(sensors_event_t));
+    const int firstPart = std::min(mCacheSize, mMaxCacheSize - mCacheStart);
+    memcpy(eventCache_new, &mEventCache[mCacheStart], firstPart * sizeof(sensors_event_t));
+    memcpy(&eventCache_new[firstPart], mEventCache,
+            (mCacheSize - firstPart) * sizeof(sensors_event_t));
     memcpy(&eventCache_new[mCacheSize], scratch, count * sizeof(sensors_event_t));
 
     ALOGD_IF(DEBUG_CONNECTIONS, "reAllocateCacheLocked maxCacheSize=%d %d", mMaxCacheSize,
@@ -482,18 +522,36 @@ void SensorService::SensorEventConnection::reAllocateCacheLocked(sensors_event_t
 
     delete[] mEventCache;
     mEventCache = eventCache_new;
+    mCacheStart = 0;
     mCacheSize += count;
     mMaxCacheSize = new_cache_size;
 }
 
+void SensorService::SensorEventConnection::copyEventsToCacheLocked(sensors_event_t const* events,
+                                                                   int count) {
+    const int end = (mCacheStart + mCacheSize) % mMaxCacheSize;
+    const int firstPart = std::min(count, mMaxCacheSize - end);
+    memcpy(&mEventCache[end], events, firstPart * sizeof(sensors_event_t));
+    memcpy(mEventCache, &events[firstPart], (count - firstPart) * sizeof(sensors_event_t));
+    mCacheSize += count;
+}
+
+void SensorService::SensorEventConnection::dropCachedEventsLocked(int count) {
+    // Check for any flush complete events in the events that will be dropped
+    const int firstPart = std::min(count, mMaxCacheSize - mCacheStart);
+    countFlushCompleteEventsLocked(&mEventCache[mCacheStart], firstPart);
+    countFlushCompleteEventsLocked(mEventCache, count - firstPart);
+    mCacheStart = (mCacheStart + count) % mMaxCacheSize;
+    mCacheSize -= count;
+}
+
 void SensorService::SensorEventConnection::appendEventsToCacheLocked(sensors_event_t const* events,
                                                                      int count) {
     if (count <= 0) {
         return;
     } else if (mCacheSize + count <= mMaxCacheSize) {
         // The events fit within the current cache: add them
-        memcpy(&mEventCache[mCacheSize], events, count * sizeof(sensors_event_t));
-        mCacheSize += count;
+        copyEventsToCacheLocked(events, count);
     } else if (mCacheSize + count <= computeMaxCacheSizeLocked()) {
         // The events fit within a resized cache: resize the cache and add the events
         reAllocateCacheLocked(events, count);
@@ -522,21 +580,12 @@ void SensorService::SensorEventConnection::appendEventsToCacheLocked(sensors_eve
             mEventsDropped += cachedEventsToDrop + newEventsToDrop;
         }
 
-        // Check for any flush complete events in the events that will be dropped
-        countFlushCompleteEventsLocked(mEventCache, cachedEventsToDrop);
+        // The cache is a ring, so dropping the oldest events does not move the others.
+        dropCachedEventsLocked(cachedEventsToDrop);
         countFlushCompleteEventsLocked(events, newEventsToDrop);
 
-        // Only shift the events if they will not all be overwritten
-        if (eventsToCopy != mMaxCacheSize) {
-            memmove(mEventCache, &mEventCache[cachedEventsToDrop],
-                    (mCacheSize - cachedEventsToDrop) * sizeof(sensors_event_t));
-        }
-        mCacheSize -= cachedEventsToDrop;
-
         // Copy the events into the cache
-        memcpy(&mEventCache[mCacheSize], &events[newEventsToDrop],
-                eventsToCopy * sizeof(sensors_event_t));
-        mCacheSize += eventsToCopy;
+        copyEventsToCacheLocked(&events[newEventsToDrop], eventsToCopy);
     }
 }
 
@@ -581,15 +630,17 @@ void SensorService::SensorEventConnection::writeToSocketFromCache() {
     Mutex::Autolock _l(mConnectionLock);
     // Send pending flush complete events (if any)
     sendPendingFlushEventsLocked();
-    for (int numEventsSent = 0; numEventsSent < mCacheSize;) {
-        const int numEventsToWrite = helpers::min(mCacheSize - numEventsSent, maxWriteSize);
+    while (mCacheSize > 0) {
+        // Write from the oldest event up to the end of the ring at most, so that events never
+        // need to be moved when the socket fills up again.
+        sensors_event_t* events = &mEventCache[mCacheStart];
+        const int numEventsToWrite = helpers::min(
+                helpers::min(mCacheSize, mMaxCacheSize - mCacheStart), maxWriteSize);
         int index_wake_up_event = -1;
         if (hasSensorAccess()) {
-            index_wake_up_event =
-                      findWakeUpSensorEventLocked(mEventCache + numEventsSent, numEventsToWrite);
+            index_wake_up_event = findWakeUpSensorEventLocked(events, numEventsToWrite);
             if (index_wake_up_event >= 0) {
-                mEventCache[index_wake_up_event + numEventsSent].flags |=
-                        WAKE_UP_SENSOR_EVENT_NEEDS_ACK;
+                events[index_wake_up_event].flags |= WAKE_UP_SENSOR_EVENT_NEEDS_ACK;
                 ++mWakeLockRefCount;
 #if DEBUG_CONNECTIONS
                 ++mTotalAcksNeeded;
@@ -598,13 +649,11 @@ void SensorService::SensorEventConnection::writeToSocketFromCache() {
         }
 
         ssize_t size = SensorEventQueue::write(mChannel,
-                          reinterpret_cast<ASensorEvent const*>(mEventCache + numEventsSent),
-                          numEventsToWrite);
+                          reinterpret_cast<ASensorEvent const*>(events), numEventsToWrite);
         if (size < 0) {
             if (index_wake_up_event >= 0) {
                 // If there was a wake_up sensor_event, reset the flag.
-                mEventCache[index_wake_up_event + numEventsSent].flags  &=
-                        ~WAKE_UP_SENSOR_EVENT_NEEDS_ACK;
+                events[index_wake_up_event].flags &= ~WAKE_UP_SENSOR_EVENT_NEEDS_ACK;
                 if (mWakeLockRefCount > 0) {
                     --mWakeLockRefCount;
                 }
@@ -612,21 +661,18 @@ void SensorService::SensorEventConnection::writeToSocketFromCache() {
                 --mTotalAcksNeeded;
 #endif
             }
-            memmove(mEventCache, &mEventCache[numEventsSent],
-                                 (mCacheSize - numEventsSent) * sizeof(sensors_event_t));
-            ALOGD_IF(DEBUG_CONNECTIONS, "wrote %d events from cache size==%d ",
-                    numEventsSent, mCacheSize);
-            mCacheSize -= numEventsSent;
+            ALOGD_IF(DEBUG_CONNECTIONS, "%d events left in cache", mCacheSize);
             return;
         }
-        numEventsSent += numEventsToWrite;
+        mCacheStart = (mCacheStart + numEventsToWrite) % mMaxCacheSize;
+        mCacheSize -= numEventsToWrite;
 #if DEBUG_CONNECTIONS
         mEventsSentFromCache += numEventsToWrite;
 #endif
     }
-    ALOGD_IF(DEBUG_CONNECTIONS, "wrote all events from cache size=%d ", mCacheSize);
-    // All events from the cache have been sent. Reset cache size to zero.
-    mCacheSize = 0;
+    ALOGD_IF(DEBUG_CONNECTIONS, "wrote all events from cache");
+    // All events from the cache have been sent.
+    mCacheStart = 0;
     // There are no more events in the cache. We don't need to poll for write on the fd.
     // Update Looper registration.
     updateLooperRegistrationLocked(mService->getLooper());
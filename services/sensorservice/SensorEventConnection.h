@@ -112,6 +112,13 @@ private:
     // the cache.
     void appendEventsToCacheLocked(sensors_event_t const* events, int count);
 
+    // Copy events to the end of the cache, which must have room for them.
+    void copyEventsToCacheLocked(sensors_event_t const* events, int count);
+
+    // Drop the oldest count events from the cache, remembering any flush complete events among
+    // them.
+    void dropCachedEventsLocked(int count);
+
     // LooperCallback method. If there is data to read on this fd, it is an ack from the app that it
     // has read events from a wake up sensor, decrement mWakeLockRefCount.  If this fd is available
     // for writing send the data from the cache.
@@ -171,8 +178,10 @@ private:
     // protected by SensorService::mLock. Key for this map is the sensor handle.
     std::unordered_map<int32_t, FlushInfo> mSensorInfo;
 
+    // Ring buffer of mMaxCacheSize events holding the mCacheSize events that could not be written
+    // yet, oldest first starting at mCacheStart.
     sensors_event_t *mEventCache;
-    int mCacheSize, mMaxCacheSize;
+    int mCacheStart, mCacheSize, mMaxCacheSize;
     int64_t mTimeOfLastEventDrop;
     int mEventsDropped;
     String8 mPackageName;
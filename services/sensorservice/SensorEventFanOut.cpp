@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <log/log.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sensor/SensorEventQueue.h>
+
+#include "SensorEventConnection.h"
+#include "SensorEventFanOut.h"
+
+namespace android {
+
+SensorService::SensorEventFanOut::SensorEventFanOut(size_t threadCount, int schedFifoPriority)
+      : mConnections(nullptr),
+        mBuffer(nullptr),
+        mCount(0),
+        mMapFlushEventsToConnections(nullptr),
+        mNextConnection(0),
+        mGeneration(0),
+        mBusyWorkers(0),
+        mExiting(false) {
+    for (size_t i = 0; i < threadCount; i++) {
+        mThreads.emplace_back(&SensorEventFanOut::threadLoop, this, schedFifoPriority);
+    }
+}
+
+SensorService::SensorEventFanOut::~SensorEventFanOut() {
+    {
+        std::scoped_lock lock(mLock);
+        mExiting = true;
+    }
+    mWorkAvailable.notify_all();
+    for (std::thread& thread : mThreads) {
+        thread.join();
+    }
+}
+
+void SensorService::SensorEventFanOut::threadLoop(int schedFifoPriority) {
+    pthread_setname_np(pthread_self(), "SensorFanOut");
+    if (schedFifoPriority != 0) {
+        struct sched_param param = {0};
+        param.sched_priority = schedFifoPriority;
+        if (sched_setscheduler(0 /*self*/, SCHED_FIFO | SCHED_RESET_ON_FORK, &param) != 0) {
+            ALOGE("Couldn't set SCHED_FIFO for SensorService fan-out thread");
+        }
+    }
+
+    // One scratch buffer per thread, since SensorEventConnection::sendEvents writes into it.
+    std::unique_ptr<sensors_event_t[]> scratch(
+            new sensors_event_t[SensorEventQueue::MAX_RECEIVE_BUFFER_EVENT_COUNT]);
+
+    std::unique_lock lock(mLock);
+    uint64_t seenGeneration = mGeneration;
+    while (true) {
+        mWorkAvailable.wait(lock, [&] { return mExiting || mGeneration != seenGeneration; });
+        if (mExiting) {
+            return;
+        }
+        seenGeneration = mGeneration;
+
+        mBusyWorkers++;
+        sendToConnectionsLocked(lock, scratch.get());
+        if (--mBusyWorkers == 0) {
+            mWorkFinished.notify_all();
+        }
+    }
+}
+
+void SensorService::SensorEventFanOut::sendEvents(
+        const std::vector<sp<SensorEventConnection>>& connections, sensors_event_t const* buffer,
+        size_t count, sensors_event_t* scratch,
+        wp<const SensorEventConnection> const* mapFlushEventsToConnections) {
+    if (mThreads.empty() || connections.size() < 2) {
+        for (const sp<SensorEventConnection>& connection : connections) {
+            connection->sendEvents(buffer, count, scratch, mapFlushEventsToConnections);
+        }
+        return;
+    }
+
+    std::unique_lock lock(mLock);
+    mConnections = &connections;
+    mBuffer = buffer;
+    mCount = count;
+    mMapFlushEventsToConnections = mapFlushEventsToConnections;
+    mNextConnection = 0;
+    mGeneration++;
+    mWorkAvailable.notify_all();
+
+    sendToConnectionsLocked(lock, scratch);
+    mWorkFinished.wait(lock, [this] { return mBusyWorkers == 0; });
+    mConnections = nullptr;
+}
+
+void SensorService::SensorEventFanOut::sendToConnectionsLocked(std::unique_lock<std::mutex>& lock,
+                                                               sensors_event_t* scratch) {
+    // A worker can wake up after the batch it was woken for has already been completed.
+    while (mConnections != nullptr && mNextConnection < mConnections->size()) {
+        const sp<SensorEventConnection>& connection = (*mConnections)[mNextConnection++];
+        sensors_event_t const* buffer = mBuffer;
+        const size_t count = mCount;
+        wp<const SensorEventConnection> const* mapFlushEventsToConnections =
+                mMapFlushEventsToConnections;
+
+        lock.unlock();
+        connection->sendEvents(buffer, count, scratch, mapFlushEventsToConnections);
+        lock.lock();
+    }
+}
+
+} // namespace android
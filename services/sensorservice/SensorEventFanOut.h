@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_SENSOR_EVENT_FAN_OUT_H
+#define ANDROID_SENSOR_EVENT_FAN_OUT_H
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "SensorService.h"
+
+namespace android {
+
+class SensorService;
+
+// Sends a batch of polled events to every active connection, spreading the connections over a
+// few worker threads. Each connection still filters and writes its own events, but the poll
+// thread no longer does all of that work serially when many clients listen to the same sensors.
+//
+// sendEvents() returns only once every connection has been sent the batch, so the caller can keep
+// SensorService::mLock held across the whole fan-out exactly as before, and the wake lock
+// bookkeeping after it sees the final state of every connection.
+class SensorService::SensorEventFanOut {
+public:
+    // threadCount may be 0, in which case everything runs on the caller of sendEvents().
+    // Workers run at the given SCHED_FIFO priority, if non-zero.
+    SensorEventFanOut(size_t threadCount, int schedFifoPriority);
+    ~SensorEventFanOut();
+
+    // Calls SensorEventConnection::sendEvents for every connection. The calling thread takes part
+    // and uses scratch; every worker uses its own scratch buffer. The buffer and the flush map are
+    // only read. Must not be called concurrently.
+    void sendEvents(const std::vector<sp<SensorEventConnection>>& connections,
+                    sensors_event_t const* buffer, size_t count, sensors_event_t* scratch,
+                    wp<const SensorEventConnection> const* mapFlushEventsToConnections);
+
+private:
+    std::mutex mLock;
+    std::condition_variable mWorkAvailable;
+    std::condition_variable mWorkFinished;
+
+    // The batch being sent. mConnections is nullptr when idle. Guarded by mLock.
+    const std::vector<sp<SensorEventConnection>>* mConnections;
+    sensors_event_t const* mBuffer;
+    size_t mCount;
+    wp<const SensorEventConnection> const* mMapFlushEventsToConnections;
+    size_t mNextConnection;
+    // Incremented for every batch, so that workers can tell a new batch from a spurious wakeup.
+    uint64_t mGeneration;
+    size_t mBusyWorkers;
+    bool mExiting;
+
+    std::vector<std::thread> mThreads;
+
+    void threadLoop(int schedFifoPriority);
+
+    // Sends the current batch to connections until none are left to claim. Called with mLock held.
+    void sendToConnectionsLocked(std::unique_lock<std::mutex>& lock, sensors_event_t* scratch);
+};
+
+} // namespace android
+
+#endif // ANDROID_SENSOR_EVENT_FAN_OUT_H
@@ -43,6 +43,9 @@ bool SensorService::SensorRecord::removeConnection(
     if (index >= 0) {
         mConnections.removeItemsAt(index, 1);
     }
+    if (mSamplingPeriods.erase(connection)) {
+        updateMinSamplingPeriod();
+    }
     // Remove this connections from the queue of flush() calls made on this sensor.
     for (Vector< wp<const SensorEventConnection> >::iterator it = mPendingFlushConnections.begin();
             it != mPendingFlushConnections.end(); ) {
@@ -78,4 +81,19 @@ void SensorService::SensorRecord::clearAllPendingFlushConnections() {
     mPendingFlushConnections.clear();
 }
 
+void SensorService::SensorRecord::setSamplingPeriod(
+        const wp<const SensorEventConnection>& connection, nsecs_t periodNs) {
+    mSamplingPeriods[connection] = periodNs;
+    updateMinSamplingPeriod();
+}
+
+void SensorService::SensorRecord::updateMinSamplingPeriod() {
+    mMinSamplingPeriodNs = 0;
+    for (auto it = mSamplingPeriods.begin(); it != mSamplingPeriods.end(); ++it) {
+        if (it == mSamplingPeriods.begin() || it->second < mMinSamplingPeriodNs) {
+            mMinSamplingPeriodNs = it->second;
+        }
+    }
+}
+
 } // namespace android
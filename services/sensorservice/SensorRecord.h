@@ -19,6 +19,8 @@
 
 #include "SensorService.h"
 
+#include <map>
+
 namespace android {
 
 class SensorService;
@@ -34,8 +36,24 @@ public:
     void removeFirstPendingFlushConnection();
     wp<const SensorEventConnection> getFirstPendingFlushConnection();
     void clearAllPendingFlushConnections();
+
+    // Virtual sensors are computed from physical events at the rate of the fusion, so their
+    // events are dropped by SensorService down to the fastest rate requested by a connection.
+    void setSamplingPeriod(const wp<const SensorEventConnection>& connection, nsecs_t periodNs);
+    // Whether an event of the virtual sensor at the given time needs to be computed. Events are
+    // let through after half of the sampling period, so that the rate doesn't fall below the
+    // requested one when the physical sensor isn't an exact multiple of it.
+    bool isEventDue(nsecs_t timestamp) const {
+        return timestamp - mLastEventTimestamp >= mMinSamplingPeriodNs / 2;
+    }
+    void setLastEventTimestamp(nsecs_t timestamp) { mLastEventTimestamp = timestamp; }
 private:
+    void updateMinSamplingPeriod();
+
     SortedVector< wp<const SensorEventConnection> > mConnections;
+    std::map<wp<const SensorEventConnection>, nsecs_t> mSamplingPeriods;
+    nsecs_t mMinSamplingPeriodNs = 0;
+    nsecs_t mLastEventTimestamp = 0;
     // A queue of all flush() calls made on this sensor. Flush complete events
     // will be sent in this order.
     Vector< wp<const SensorEventConnection> > mPendingFlushConnections;
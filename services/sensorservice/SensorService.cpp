@@ -47,9 +47,11 @@
 #include "SensorDirectConnection.h"
 #include "SensorEventAckReceiver.h"
 #include "SensorEventConnection.h"
+#include "SensorEventFanOut.h"
 #include "SensorRecord.h"
 #include "SensorRegistrationInfo.h"
 
+#include <algorithm>
 #include <ctime>
 #include <inttypes.h>
 #include <math.h>
@@ -87,6 +89,9 @@ AppOpsManager SensorService::sAppOpsManager;
 #define SENSOR_SERVICE_HMAC_KEY_FILE  SENSOR_SERVICE_DIR "/hmac_key"
 #define SENSOR_SERVICE_SCHED_FIFO_PRIORITY 10
 
+// Upper bound on the threads that send events to connections alongside the poll thread.
+#define MAX_FAN_OUT_THREADS 3
+
 // Permissions.
 static const String16 sDumpPermission("android.permission.DUMP");
 static const String16 sLocationHardwarePermission("android.permission.LOCATION_HARDWARE");
@@ -278,6 +283,11 @@ void SensorService::onFirstRef() {
             mSensorEventBuffer = new sensors_event_t[minBufferSize];
             mSensorEventScratch = new sensors_event_t[minBufferSize];
             mMapFlushEventsToConnections = new wp<const SensorEventConnection> [minBufferSize];
+            // The poll thread sends to connections as well, so leave it a core of its own.
+            const size_t cpuCount = std::thread::hardware_concurrency();
+            mEventFanOut = std::make_unique<SensorEventFanOut>(
+                    cpuCount > 1 ? std::min<size_t>(cpuCount - 1, MAX_FAN_OUT_THREADS) : 0,
+                    SENSOR_SERVICE_SCHED_FIFO_PRIORITY);
             mCurrentOperatingMode = NORMAL;
 
             mNextSensorRegIndex = 0;
@@ -871,6 +881,23 @@ bool SensorService::threadLoop() {
         for (int i = 0; i < count; i++) {
              mSensorEventBuffer[i].flags = 0;
         }
+
+        // Promote the active connections before taking mLock, so that binder threads registering
+        // or reconfiguring connections don't wait on this. A connection that goes away in the
+        // meantime has no sensors left and drops the events; one that has just been added has no
+        // sensors enabled yet. This must be declared before connLock, so that the references are
+        // released after the lock.
+        std::vector<sp<SensorEventConnection>> activeConnections;
+        if (SensorConnectionHolder::EventConnectionSnapshot snapshot =
+                    mConnectionHolder.getActiveConnectionsSnapshot()) {
+            activeConnections.reserve(snapshot->size());
+            for (const wp<SensorEventConnection>& weakConnection : *snapshot) {
+                sp<SensorEventConnection> connection = weakConnection.promote();
+                if (connection != nullptr) {
+                    activeConnections.push_back(std::move(connection));
+                }
+            }
+        }
         ConnectionSafeAutolock connLock = mConnectionHolder.lock(mLock);
 
         // Poll has returned. Hold a wakelock if one of the events is from a wake up sensor. The
@@ -912,6 +939,12 @@ bool SensorService::threadLoop() {
                                     count, k, minBufferSize);
                             break;
                         }
+                        // Skip computing events faster than any connection requested.
+                        SensorRecord* rec = mActiveSensors.valueFor(handle);
+                        if (rec != nullptr && !rec->isEventDue(event[i].timestamp)) {
+                            continue;
+                        }
+
                         sensors_event_t out;
                         sp<SensorInterface> si = mSensors.getInterface(handle);
                         if (si == nullptr) {
@@ -922,6 +955,9 @@ bool SensorService::threadLoop() {
                         if (si->process(&out, event[i])) {
                             mSensorEventBuffer[count + k] = out;
                             k++;
+                            if (rec != nullptr) {
+                                rec->setLastEventTimestamp(out.timestamp);
+                            }
                         }
                     }
                 }
@@ -930,7 +966,7 @@ bool SensorService::threadLoop() {
                     recordLastValueLocked(&mSensorEventBuffer[count], k);
                     count += k;
                     // sort the buffer by time-stamps
-                    sortEventBuffer(mSensorEventBuffer, count);
+                    sortEventBuffer(mSensorEventBuffer, count, mSensorEventScratch);
                 }
             }
         }
@@ -946,10 +982,6 @@ bool SensorService::threadLoop() {
             }
         }
 
-        // Cache the list of active connections, since we use it in multiple places below but won't
-        // modify it here
-        const std::vector<sp<SensorEventConnection>> activeConnections = connLock.getActiveConnections();
-
         for (int i = 0; i < count; ++i) {
             // Map flush_complete_events in the buffer to SensorEventConnections which called flush
             // on the hardware sensor. mapFlushEventsToConnections[i] will be the
@@ -1001,7 +1033,9 @@ bool SensorService::threadLoop() {
                         ALOGE("Dynamic sensor release error.");
                     }
 
-                    for (const sp<SensorEventConnection>& connection : activeConnections) {
+                    // A connection added since the snapshot may have enabled this sensor too.
+                    for (const sp<SensorEventConnection>& connection :
+                            connLock.getActiveConnections()) {
                         connection->removeSensor(handle);
                     }
                 }
@@ -1010,10 +1044,10 @@ bool SensorService::threadLoop() {
 
         // Send our events to clients. Check the state of wake lock for each client and release the
         // lock if none of the clients need it.
+        mEventFanOut->sendEvents(activeConnections, mSensorEventBuffer, count, mSensorEventScratch,
+                                 mMapFlushEventsToConnections);
         bool needsWakeLock = false;
         for (const sp<SensorEventConnection>& connection : activeConnections) {
-            connection->sendEvents(mSensorEventBuffer, count, mSensorEventScratch,
-                    mMapFlushEventsToConnections);
             needsWakeLock |= connection->needsWakeLock();
             // If the connection has one-shot sensors, it may be cleaned up after first trigger.
             // Early check for one-shot sensors.
@@ -1095,15 +1129,40 @@ void SensorService::recordLastValueLocked(
     }
 }
 
-void SensorService::sortEventBuffer(sensors_event_t* buffer, size_t count) {
-    struct compar {
-        static int cmp(void const* lhs, void const* rhs) {
-            sensors_event_t const* l = static_cast<sensors_event_t const*>(lhs);
-            sensors_event_t const* r = static_cast<sensors_event_t const*>(rhs);
-            return l->timestamp - r->timestamp;
-        }
+void SensorService::sortEventBuffer(sensors_event_t* buffer, size_t count,
+                                    sensors_event_t* scratch) {
+    // The buffer is made of a few runs that are already in timestamp order: the HAL reports each
+    // sensor's events in order, often flushing one sensor's batch after another's, and virtual
+    // sensor events are appended in the order of the events they were computed from. Merge
+    // neighbouring runs pairwise, bouncing between buffer and scratch, until one is left.
+    auto isEarlier = [](const sensors_event_t& lhs, const sensors_event_t& rhs) {
+        return lhs.timestamp < rhs.timestamp;
+    };
+    auto runEnd = [&](const sensors_event_t* events, size_t start) -> size_t {
+        return std::is_sorted_until(events + start, events + count, isEarlier) - events;
     };
-    qsort(buffer, count, sizeof(sensors_event_t), compar::cmp);
+
+    if (runEnd(buffer, 0) == count) {
+        return;
+    }
+
+    sensors_event_t* src = buffer;
+    sensors_event_t* dst = scratch;
+    size_t runCount;
+    do {
+        runCount = 0;
+        for (size_t start = 0; start < count; runCount++) {
+            const size_t middle = runEnd(src, start);
+            const size_t end = middle < count ? runEnd(src, middle) : count;
+            std::merge(src + start, src + middle, src + middle, src + end, dst + start, isEarlier);
+            start = end;
+        }
+        std::swap(src, dst);
+    } while (runCount > 1);
+
+    if (src != buffer) {
+        std::copy(src, src + count, buffer);
+    }
 }
 
 String8 SensorService::getSensorName(int handle) const {
@@ -1634,6 +1693,10 @@ status_t SensorService::enable(const sp<SensorEventConnection>& connection,
         samplingPeriodNs = minDelayNs;
     }
 
+    if (sensor->isVirtual()) {
+        rec->setSamplingPeriod(connection, samplingPeriodNs);
+    }
+
     ALOGD_IF(DEBUG_CONNECTIONS, "Calling batch handle==%d flags=%d"
                                 "rate=%" PRId64 " timeout== %" PRId64"",
              handle, reservedFlags, samplingPeriodNs, maxBatchReportLatencyNs);
@@ -1753,6 +1816,14 @@ status_t SensorService::setEventRate(const sp<SensorEventConnection>& connection
         ns = minDelayNs;
     }
 
+    if (sensor->isVirtual()) {
+        Mutex::Autolock _l(mLock);
+        SensorRecord* rec = mActiveSensors.valueFor(handle);
+        if (rec != nullptr) {
+            rec->setSamplingPeriod(connection, ns);
+        }
+    }
+
     return sensor->setDelay(connection.get(), handle, ns);
 }
 
@@ -2082,12 +2153,26 @@ void SensorService::SensorConnectionHolder::addEventConnectionIfNotPresent(
         const sp<SensorService::SensorEventConnection>& connection) {
     if (mActiveConnections.indexOf(connection) < 0) {
         mActiveConnections.add(connection);
+        publishActiveConnectionsSnapshot();
     }
 }
 
 void SensorService::SensorConnectionHolder::removeEventConnection(
         const wp<SensorService::SensorEventConnection>& connection) {
-    mActiveConnections.remove(connection);
+    if (mActiveConnections.remove(connection) >= 0) {
+        publishActiveConnectionsSnapshot();
+    }
+}
+
+SensorService::SensorConnectionHolder::EventConnectionSnapshot
+        SensorService::SensorConnectionHolder::getActiveConnectionsSnapshot() const {
+    return std::atomic_load(&mActiveConnectionsSnapshot);
+}
+
+void SensorService::SensorConnectionHolder::publishActiveConnectionsSnapshot() {
+    auto snapshot = std::make_shared<std::vector<wp<SensorEventConnection>>>(
+            mActiveConnections.begin(), mActiveConnections.end());
+    std::atomic_store(&mActiveConnectionsSnapshot, EventConnectionSnapshot(std::move(snapshot)));
 }
 
 void SensorService::SensorConnectionHolder::addDirectConnection(
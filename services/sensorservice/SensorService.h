@@ -41,6 +41,7 @@
 
 #include <stdint.h>
 #include <sys/types.h>
+#include <memory>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -105,6 +106,7 @@ private:
     class ConnectionSafeAutolock;
     class SensorConnectionHolder;
     class SensorEventAckReceiver;
+    class SensorEventFanOut;
     class SensorRecord;
     class SensorRegistrationInfo;
 
@@ -144,9 +146,11 @@ private:
 
     // Encapsulates the collection of active SensorEventConection and SensorDirectConnection
     // references. Write access is done through this class with mLock held, but all read access
-    // must be routed through ConnectionSafeAutolock.
+    // must be routed through ConnectionSafeAutolock, except for the snapshot below.
     class SensorConnectionHolder {
     public:
+        using EventConnectionSnapshot = std::shared_ptr<const std::vector<wp<SensorEventConnection>>>;
+
         void addEventConnectionIfNotPresent(const sp<SensorEventConnection>& connection);
         void removeEventConnection(const wp<SensorEventConnection>& connection);
 
@@ -157,10 +161,20 @@ private:
         // object that can be used to safely read the lists of connections
         ConnectionSafeAutolock lock(Mutex& mutex);
 
+        // Returns the active event connections without taking any lock. The list is copied on
+        // write, so a snapshot never changes once taken, but it may already be stale. Connections
+        // still have to be promoted, and the resulting sp<> must be destroyed without mLock held.
+        EventConnectionSnapshot getActiveConnectionsSnapshot() const;
+
     private:
         friend class ConnectionSafeAutolock;
+        void publishActiveConnectionsSnapshot();
+
         SortedVector< wp<SensorEventConnection> > mActiveConnections;
         SortedVector< wp<SensorDirectConnection> > mDirectConnections;
+        // Immutable copy of mActiveConnections, replaced whenever it changes. Accessed with the
+        // std::atomic_load/atomic_store overloads for shared_ptr.
+        EventConnectionSnapshot mActiveConnectionsSnapshot;
     };
 
     // If accessing a sensor we need to make sure the UID has access to it. If
@@ -299,7 +313,9 @@ private:
     sp<SensorInterface> getSensorInterfaceFromHandle(int handle) const;
     bool isWakeUpSensor(int type) const;
     void recordLastValueLocked(sensors_event_t const* buffer, size_t count);
-    static void sortEventBuffer(sensors_event_t* buffer, size_t count);
+    // Sorts buffer by timestamp, keeping events with equal timestamps in order. scratch must
+    // have room for count events.
+    static void sortEventBuffer(sensors_event_t* buffer, size_t count, sensors_event_t* scratch);
     const Sensor& registerSensor(SensorInterface* sensor,
                                  bool isDebug = false, bool isVirtual = false);
     const Sensor& registerVirtualSensor(SensorInterface* sensor, bool isDebug = false);
@@ -403,6 +419,8 @@ private:
     SensorConnectionHolder mConnectionHolder;
     bool mWakeLockAcquired;
     sensors_event_t *mSensorEventBuffer, *mSensorEventScratch;
+    // Sends each polled batch to the active connections, used only by threadLoop().
+    std::unique_ptr<SensorEventFanOut> mEventFanOut;
     // WARNING: these SensorEventConnection instances must not be promoted to sp, except via
     // modification to add support for them in ConnectionSafeAutolock
     wp<const SensorEventConnection> * mMapFlushEventsToConnections;
@@ -52,6 +52,7 @@
 
 #include "Colorizer.h"
 #include "DisplayDevice.h"
+#include "FrameTimeline/FrameTimeline.h"
 #include "FrameTracer/FrameTracer.h"
 #include "LayerRejecter.h"
 #include "TimeStats/TimeStats.h"
@@ -98,6 +99,40 @@ void BufferLayer::useEmptyDamage() {
     surfaceDamageRegion.clear();
 }
 
+Region BufferLayer::getScreenSpaceSurfaceDamage() const {
+    const Rect screenBounds = getScreenBounds();
+    if (surfaceDamageRegion.isEmpty() || surfaceDamageRegion.bounds() == Rect::INVALID_RECT ||
+        mBufferInfo.mBuffer == nullptr || mSidebandStream != nullptr) {
+        return Region(screenBounds);
+    }
+
+    // Surface damage is in buffer space. Only map it onto the layer when the buffer is drawn
+    // unrotated and unscaled at the layer's origin, and fall back to the whole layer otherwise.
+    const Rect bufferBounds = mBufferInfo.mBuffer->getBounds();
+    const bool isFullBufferCrop = mBufferInfo.mCrop.isEmpty() || mBufferInfo.mCrop == bufferBounds;
+    if (mBufferInfo.mTransform != 0 || mBufferInfo.mTransformToDisplayInverse ||
+        !isFullBufferCrop || !(mSourceBounds == bufferBounds.toFloatRect())) {
+        return Region(screenBounds);
+    }
+
+    const ui::Transform transform = getTransform();
+    if (!transform.preserveRects()) {
+        return Region(screenBounds);
+    }
+
+    const Region layerDamage = surfaceDamageRegion.intersect(Rect(getBounds()));
+    Region screenDamage;
+    for (const Rect& rect : layerDamage) {
+        Rect screenRect = transform.transform(rect, /*roundOutwards=*/true);
+        // Filtering samples the neighbouring texels when the layer is scaled.
+        if (transform.getType() >= ui::Transform::SCALE) {
+            screenRect.inset(-1, -1, -1, -1);
+        }
+        screenDamage.orSelf(screenRect);
+    }
+    return screenDamage.intersect(screenBounds);
+}
+
 bool BufferLayer::isOpaque(const Layer::State& s) const {
     // if we don't have a buffer or sidebandStream yet, we're translucent regardless of the
     // layer's opaque flag.
@@ -304,9 +339,8 @@ void BufferLayer::preparePerFrameCompositionState() {
     }
 
     compositionState->buffer = mBufferInfo.mBuffer;
-    compositionState->bufferSlot = (mBufferInfo.mBufferSlot == BufferQueue::INVALID_BUFFER_SLOT)
-            ? 0
-            : mBufferInfo.mBufferSlot;
+    // An invalid slot lets the HWC buffer cache pick one by buffer id.
+    compositionState->bufferSlot = mBufferInfo.mBufferSlot;
     compositionState->acquireFence = mBufferInfo.mFence;
 }
 
@@ -341,6 +375,7 @@ bool BufferLayer::onPostComposition(const DisplayDevice* display,
 
     const int32_t layerId = getSequence();
     mFlinger->mTimeStats->setDesiredTime(layerId, mCurrentFrameNumber, desiredPresentTime);
+    mFlinger->mFrameTimeline->onBufferLatched(layerId, mCurrentFrameNumber);
 
     const auto outputLayer = findOutputLayerForDisplay(display);
     if (outputLayer && outputLayer->requiresClientComposition()) {
@@ -724,6 +759,16 @@ void BufferLayer::latchAndReleaseBuffer() {
     releasePendingBuffer(systemTime());
 }
 
+void BufferLayer::releaseOffscreenBuffers() {
+    mBufferInfo.mBuffer = nullptr;
+    mBufferInfo.mBufferSlot = BufferQueue::INVALID_BUFFER_SLOT;
+    mBufferInfo.mFence = Fence::NO_FENCE;
+    if (mCompositionState) {
+        mCompositionState->buffer = nullptr;
+        mCompositionState->acquireFence = Fence::NO_FENCE;
+    }
+}
+
 PixelFormat BufferLayer::getPixelFormat() const {
     return mBufferInfo.mPixelFormat;
 }
@@ -832,6 +877,7 @@ void BufferLayer::updateCloneBufferInfo() {
     mDrawingState.zOrderRelativeOf = tmpZOrderRelativeOf;
     mDrawingState.zOrderRelatives = tmpZOrderRelatives;
     mDrawingState.inputInfo = tmpInputInfo;
+    invalidateInheritedState();
 }
 
 void BufferLayer::setTransformHint(ui::Transform::RotationFlags displayTransformHint) {
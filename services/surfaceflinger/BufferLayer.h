@@ -62,6 +62,7 @@ public:
     // one empty rect.
     void useSurfaceDamage() override;
     void useEmptyDamage() override;
+    Region getScreenSpaceSurfaceDamage() const override;
 
     bool isOpaque(const Layer::State& s) const override;
 
@@ -106,6 +107,10 @@ public:
     // Should only be called on the main thread.
     void latchAndReleaseBuffer() override;
 
+    // Clears the latched buffer from the buffer info and composition state. Derived classes
+    // release the buffer back to its producer before calling this.
+    void releaseOffscreenBuffers() override;
+
     bool getTransformToDisplayInverse() const override;
 
     Rect getBufferCrop() const override;
@@ -206,6 +206,36 @@ bool BufferLayerConsumer::releasePendingBuffer() {
     return true;
 }
 
+void BufferLayerConsumer::releaseCurrentBuffer() {
+    BLC_LOGV("releaseCurrentBuffer");
+    releasePendingBuffer();
+    {
+        Mutex::Autolock lock(mMutex);
+        if (mAbandoned) {
+            return;
+        }
+
+        if (mCurrentTexture != BufferQueue::INVALID_BUFFER_SLOT) {
+            status_t result =
+                    releaseBufferLocked(mCurrentTexture, mCurrentTextureBuffer->graphicBuffer());
+            if (result < NO_ERROR) {
+                BLC_LOGE("releaseCurrentBuffer failed: %s (%d)", strerror(-result), result);
+            }
+            mCurrentTexture = BufferQueue::INVALID_BUFFER_SLOT;
+        }
+        mCurrentTextureBuffer = nullptr;
+        mCurrentFence = Fence::NO_FENCE;
+        mCurrentFenceTime = FenceTime::NO_FENCE;
+    }
+
+    // Dropping the slots also drops their cached images, which unbinds them from RenderEngine.
+    status_t result = discardFreeBuffers();
+    if (result < NO_ERROR) {
+        BLC_LOGE("releaseCurrentBuffer: failed to discard free buffers: %s (%d)",
+                 strerror(-result), result);
+    }
+}
+
 sp<Fence> BufferLayerConsumer::getPrevFinalReleaseFence() const {
     Mutex::Autolock lock(mMutex);
     return ConsumerBase::mPrevFinalReleaseFence;
@@ -503,6 +533,16 @@ void BufferLayerConsumer::addAndGetFrameTimestamps(const NewFrameEventsEntry* ne
     mLayer->addAndGetFrameTimestamps(newTimestamps, outDelta);
 }
 
+void BufferLayerConsumer::getFrameEventRing(sp<FrameEventRing>* outRing) {
+    Mutex::Autolock lock(mMutex);
+
+    if (mAbandoned) {
+        return;
+    }
+
+    mLayer->getFrameEventRing(outRing);
+}
+
 void BufferLayerConsumer::abandonLocked() {
     BLC_LOGV("abandonLocked");
     mCurrentTextureBuffer = nullptr;
@@ -107,6 +107,11 @@ public:
 
     bool releasePendingBuffer();
 
+    // releaseCurrentBuffer releases the current buffer, and any pending one, back to the
+    // BufferQueue and frees every slot that is not in use by the producer. The consumer is left
+    // without a current texture until the next updateTexImage.
+    void releaseCurrentBuffer() EXCLUDES(mImagesMutex);
+
     sp<Fence> getPrevFinalReleaseFence() const;
 
     // See GLConsumer::getTransformMatrix.
@@ -247,6 +252,7 @@ private:
     void onSidebandStreamChanged() override;
     void addAndGetFrameTimestamps(const NewFrameEventsEntry* newTimestamps,
                                   FrameEventHistoryDelta* outDelta) override;
+    void getFrameEventRing(sp<FrameEventRing>* outRing) override;
 
     // computeCurrentTransformMatrixLocked computes the transform matrix for the
     // current texture.  It uses mCurrentTransform and the current GraphicBuffer
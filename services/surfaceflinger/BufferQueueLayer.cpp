@@ -91,6 +91,19 @@ void BufferQueueLayer::releasePendingBuffer(nsecs_t dequeueReadyTime) {
     }
 }
 
+void BufferQueueLayer::releaseOffscreenBuffers() {
+    if (mBufferInfo.mBuffer == nullptr) {
+        return;
+    }
+
+    releasePendingBuffer(systemTime());
+    // Clones share the buffer latched by the original layer, which owns the consumer slots.
+    if (!isClone()) {
+        mConsumer->releaseCurrentBuffer();
+    }
+    BufferLayer::releaseOffscreenBuffers();
+}
+
 void BufferQueueLayer::setDefaultBufferSize(uint32_t w, uint32_t h) {
     mConsumer->setDefaultBufferSize(w, h);
 }
@@ -158,6 +171,17 @@ bool BufferQueueLayer::fenceHasSignaled() const {
     return fenceSignaled;
 }
 
+void BufferQueueLayer::prepareLatch() {
+    // FenceTime caches the signal time once it has been polled, so the checks of latchBuffer and
+    // updateTexImage don't need to query the fences again.
+    Mutex::Autolock lock(mQueueItemLock);
+    for (const auto& item : mQueueItems) {
+        if (item.mFenceTime->getSignalTime() == Fence::SIGNAL_TIME_PENDING) {
+            break;
+        }
+    }
+}
+
 bool BufferQueueLayer::framePresentTimeIsCurrent(nsecs_t expectedPresentTime) const {
     if (!hasFrameUpdate() || isRemovedFromCurrentState()) {
         return true;
@@ -284,6 +308,8 @@ status_t BufferQueueLayer::updateTexImage(bool& recomputeVisibleRegions, nsecs_t
 
     status_t updateResult = mConsumer->updateTexImage(&r, expectedPresentTime, &mAutoRefresh,
                                                       &queuedBuffer, maxFrameNumberToAcquire);
+    // The rejecter may have updated the active size and crop of the drawing state.
+    invalidateInheritedState();
     if (updateResult == BufferQueue::PRESENT_LATER) {
         // Producer doesn't want buffer to be displayed yet.  Signal a
         // layer update so we check again at the next opportunity.
@@ -298,6 +324,7 @@ status_t BufferQueueLayer::updateTexImage(bool& recomputeVisibleRegions, nsecs_t
             mFlinger->mTimeStats->removeTimeRecord(layerId, mQueueItems[0].mFrameNumber);
             mQueueItems.removeAt(0);
             mQueuedFrames--;
+            ATRACE_INT(mQueueDepthName.c_str(), mQueueItems.size());
         }
         return BAD_VALUE;
     } else if (updateResult != NO_ERROR || mUpdateTexImageFailed) {
@@ -337,12 +364,17 @@ status_t BufferQueueLayer::updateTexImage(bool& recomputeVisibleRegions, nsecs_t
             mQueuedFrames--;
         }
 
+        // The buffers still queued behind the latched one are stuffed, and will each be
+        // presented at least a refresh later than if the app had queued them just in time.
+        mFlinger->mTimeStats->recordQueueDepth(layerId, mQueueItems.size());
+
         uint64_t bufferID = mQueueItems[0].mGraphicBuffer->getId();
         mFlinger->mTimeStats->setLatchTime(layerId, currentFrameNumber, latchTime);
         mFlinger->mFrameTracer->traceTimestamp(layerId, bufferID, currentFrameNumber, latchTime,
                                                FrameTracer::FrameEvent::LATCH);
 
         mQueueItems.removeAt(0);
+        ATRACE_INT(mQueueDepthName.c_str(), mQueueItems.size());
     }
 
     // Decrement the queued-frames count.  Signal another event if we
@@ -436,6 +468,7 @@ void BufferQueueLayer::onFrameAvailable(const BufferItem& item) {
 
         mQueueItems.push_back(item);
         mQueuedFrames++;
+        ATRACE_INT(mQueueDepthName.c_str(), mQueueItems.size());
 
         // Wake up any pending callbacks
         mLastFrameNumberReceived = item.mFrameNumber;
@@ -443,7 +476,9 @@ void BufferQueueLayer::onFrameAvailable(const BufferItem& item) {
     }
 
     mFlinger->mInterceptor->saveBufferUpdate(layerId, item.mGraphicBuffer->getWidth(),
-                                             item.mGraphicBuffer->getHeight(), item.mFrameNumber);
+                                             item.mGraphicBuffer->getHeight(),
+                                             item.mGraphicBuffer->getPixelFormat(),
+                                             item.mFrameNumber);
 
     mFlinger->signalLayerUpdate();
     mConsumer->onBufferAvailable(item);
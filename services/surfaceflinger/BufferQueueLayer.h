@@ -48,6 +48,8 @@ public:
     // If a buffer was replaced this frame, release the former buffer
     void releasePendingBuffer(nsecs_t dequeueReadyTime) override;
 
+    void releaseOffscreenBuffers() override;
+
     void setDefaultBufferSize(uint32_t w, uint32_t h) override;
 
     int32_t getQueuedFrameCount() const override;
@@ -61,6 +63,7 @@ public:
     // -----------------------------------------------------------------------
 public:
     bool fenceHasSignaled() const override;
+    void prepareLatch() override;
     bool framePresentTimeIsCurrent(nsecs_t expectedPresentTime) const override;
 
 private:
@@ -139,6 +142,8 @@ private:
     mutable Mutex mQueueItemLock;
     Condition mQueueItemCondition;
     Vector<BufferItem> mQueueItems;
+    // Name of the trace counter following the size of mQueueItems.
+    const std::string mQueueDepthName{"QD - " + mName};
     std::atomic<uint64_t> mLastFrameNumberReceived{0};
 
     bool mAutoRefresh{false};
@@ -31,12 +31,58 @@
 #include <gui/BufferQueue.h>
 #include <private/gui/SyncFeatures.h>
 #include <renderengine/Image.h>
+#include <ui/Gralloc.h>
+#include <ui/GraphicBufferMapper.h>
 
 #include "EffectLayer.h"
+#include "FrameTimeline/FrameTimeline.h"
 #include "TimeStats/TimeStats.h"
 
 namespace android {
 
+namespace {
+
+bool isHdrDataspace(ui::Dataspace dataspace) {
+    const auto transfer = static_cast<ui::Dataspace>(static_cast<int32_t>(dataspace) &
+                                                     static_cast<int32_t>(
+                                                             ui::Dataspace::TRANSFER_MASK));
+    return transfer == ui::Dataspace::TRANSFER_ST2084 || transfer == ui::Dataspace::TRANSFER_HLG;
+}
+
+// Producers such as video decoders may attach HDR metadata to the buffer through gralloc
+// rather than through the transaction. Fetch it in a single mapper query when latching.
+HdrMetadata getBufferHdrMetadata(const sp<GraphicBuffer>& buffer) {
+    HdrMetadata hdrMetadata;
+    BufferMetadata metadata;
+    GraphicBufferMapper::get().getBufferMetadata(buffer->getNativeBuffer()->handle,
+                                                 BufferMetadata::SMPTE2086 |
+                                                         BufferMetadata::CTA861_3 |
+                                                         BufferMetadata::SMPTE2094_40,
+                                                 &metadata);
+    if (metadata.smpte2086) {
+        const auto& smpte2086 = *metadata.smpte2086;
+        hdrMetadata.smpte2086 = {{smpte2086.primaryRed.x, smpte2086.primaryRed.y},
+                                 {smpte2086.primaryGreen.x, smpte2086.primaryGreen.y},
+                                 {smpte2086.primaryBlue.x, smpte2086.primaryBlue.y},
+                                 {smpte2086.whitePoint.x, smpte2086.whitePoint.y},
+                                 smpte2086.maxLuminance,
+                                 smpte2086.minLuminance};
+        hdrMetadata.validTypes |= HdrMetadata::SMPTE2086;
+    }
+    if (metadata.cta861_3) {
+        hdrMetadata.cta8613 = {metadata.cta861_3->maxContentLightLevel,
+                               metadata.cta861_3->maxFrameAverageLightLevel};
+        hdrMetadata.validTypes |= HdrMetadata::CTA861_3;
+    }
+    if (metadata.smpte2094_40 && !metadata.smpte2094_40->empty()) {
+        hdrMetadata.hdr10plus = std::move(*metadata.smpte2094_40);
+        hdrMetadata.validTypes |= HdrMetadata::HDR10PLUS;
+    }
+    return hdrMetadata;
+}
+
+} // namespace
+
 // clang-format off
 const std::array<float, 16> BufferStateLayer::IDENTITY_MATRIX{
         1, 0, 0, 0,
@@ -139,6 +185,25 @@ bool BufferStateLayer::shouldPresentNow(nsecs_t /*expectedPresentTime*/) const {
     return hasFrameUpdate();
 }
 
+void BufferStateLayer::releaseOffscreenBuffers() {
+    if (mBufferInfo.mBuffer == nullptr) {
+        return;
+    }
+
+    // As in the destructor, only the original layer unbinds the texture it shares with its clones.
+    // A buffer that is still in the client cache is rebound if the client sets it again.
+    if (!isClone()) {
+        mFlinger->getRenderEngine().unbindExternalTextureBuffer(mBufferInfo.mBuffer->getId());
+    }
+
+    // Keep a buffer that was set after the last latch; it is latched and released as usual.
+    if (mCurrentState.buffer == mDrawingState.buffer) {
+        mCurrentState.buffer = nullptr;
+    }
+    mDrawingState.buffer = nullptr;
+    BufferLayer::releaseOffscreenBuffers();
+}
+
 bool BufferStateLayer::willPresentCurrentTransaction() const {
     // Returns true if the most recent Transaction applied to CurrentState will be presented.
     return (getSidebandStreamChanged() || getAutoRefresh() ||
@@ -261,6 +326,12 @@ bool BufferStateLayer::setBuffer(const sp<GraphicBuffer>& buffer, const sp<Fence
                                  const client_cache_t& clientCacheId) {
     if (mCurrentState.buffer) {
         mReleasePreviousBuffer = true;
+        // The pending buffer will never be shown, so its damage has to be redrawn along with
+        // this one's. Its region has already been replaced, so treat the whole buffer as
+        // damaged.
+        if (mCurrentState.buffer != mDrawingState.buffer) {
+            mCurrentState.surfaceDamageRegion = Region::INVALID_REGION;
+        }
     }
 
     mCurrentState.frameNumber++;
@@ -275,6 +346,12 @@ bool BufferStateLayer::setBuffer(const sp<GraphicBuffer>& buffer, const sp<Fence
                                       postTime);
     desiredPresentTime = desiredPresentTime <= 0 ? 0 : desiredPresentTime;
     mCurrentState.desiredPresentTime = desiredPresentTime;
+    mFlinger->mFrameTimeline->onBufferQueued(layerId, getOwnerUid(), getName(),
+                                             mCurrentState.frameNumber, postTime,
+                                             desiredPresentTime,
+                                             std::make_shared<FenceTime>(
+                                                     acquireFence ? acquireFence
+                                                                  : Fence::NO_FENCE));
 
     mFlinger->mScheduler->recordLayerHistory(this, desiredPresentTime,
                                              LayerHistory::LayerUpdateType::Buffer);
@@ -426,7 +503,7 @@ bool BufferStateLayer::fenceHasSignaled() const {
         return true;
     }
 
-    const bool fenceSignaled =
+    const bool fenceSignaled = (isLatchPrepared() && mPreparedLatch.fenceSignaled) ||
             getDrawingState().acquireFence->getStatus() == Fence::Status::Signaled;
     if (!fenceSignaled) {
         mFlinger->mTimeStats->incrementLatchSkipped(getSequence(),
@@ -436,6 +513,25 @@ bool BufferStateLayer::fenceHasSignaled() const {
     return fenceSignaled;
 }
 
+void BufferStateLayer::prepareLatch() {
+    const State& s(getDrawingState());
+    mPreparedLatch.frameNumber = s.frameNumber;
+    mPreparedLatch.acquireFence = s.acquireFence;
+    mPreparedLatch.fenceSignaled = s.acquireFence->getStatus() == Fence::Status::Signaled;
+    mPreparedLatch.hdrMetadata.reset();
+    if (s.buffer && s.hdrMetadata.validTypes == 0 &&
+        isHdrDataspace(translateDataspace(s.dataspace))) {
+        mPreparedLatch.hdrMetadata = getBufferHdrMetadata(s.buffer);
+    }
+}
+
+bool BufferStateLayer::isLatchPrepared() const {
+    const State& s(getDrawingState());
+    return mPreparedLatch.acquireFence != nullptr &&
+            mPreparedLatch.frameNumber == s.frameNumber &&
+            mPreparedLatch.acquireFence == s.acquireFence;
+}
+
 bool BufferStateLayer::framePresentTimeIsCurrent(nsecs_t expectedPresentTime) const {
     if (!hasFrameUpdate() || isRemovedFromCurrentState()) {
         return true;
@@ -697,6 +793,11 @@ void BufferStateLayer::gatherBufferInfo() {
     mBufferInfo.mScaleMode = NATIVE_WINDOW_SCALING_MODE_SCALE_TO_WINDOW;
     mBufferInfo.mSurfaceDamage = s.surfaceDamageRegion;
     mBufferInfo.mHdrMetadata = s.hdrMetadata;
+    if (s.buffer && s.hdrMetadata.validTypes == 0 && isHdrDataspace(mBufferInfo.mDataspace)) {
+        mBufferInfo.mHdrMetadata = isLatchPrepared() && mPreparedLatch.hdrMetadata
+                ? *mPreparedLatch.hdrMetadata
+                : getBufferHdrMetadata(s.buffer);
+    }
     mBufferInfo.mApi = s.api;
     mBufferInfo.mTransformToDisplayInverse = s.transformToDisplayInverse;
     mBufferInfo.mBufferSlot = mHwcSlotGenerator->getHwcCacheSlot(s.clientCacheId);
@@ -734,7 +835,7 @@ sp<Layer> BufferStateLayer::createClone() {
     return layer;
 }
 
-Layer::RoundedCornerState BufferStateLayer::getRoundedCornerState() const {
+Layer::RoundedCornerState BufferStateLayer::computeRoundedCornerState() const {
     const auto& p = mDrawingParent.promote();
     if (p != nullptr) {
         RoundedCornerState parentState = p->getRoundedCornerState();
@@ -24,6 +24,7 @@
 #include <system/window.h>
 #include <utils/String8.h>
 
+#include <optional>
 #include <stack>
 
 namespace android {
@@ -44,6 +45,8 @@ public:
     void onLayerDisplayed(const sp<Fence>& releaseFence) override;
     void releasePendingBuffer(nsecs_t dequeueReadyTime) override;
 
+    void releaseOffscreenBuffers() override;
+
     void finalizeFrameEventHistory(const std::shared_ptr<FenceTime>& glDoneFence,
                                    const CompositorTiming& compositorTiming) override;
 
@@ -101,7 +104,6 @@ public:
 
     Rect getBufferSize(const State& s) const override;
     FloatRect computeSourceBounds(const FloatRect& parentBounds) const override;
-    Layer::RoundedCornerState getRoundedCornerState() const override;
 
     // -----------------------------------------------------------------------
 
@@ -111,10 +113,12 @@ public:
     bool fenceHasSignaled() const override;
     bool framePresentTimeIsCurrent(nsecs_t expectedPresentTime) const override;
     bool onPreComposition(nsecs_t refreshStartTime) override;
+    void prepareLatch() override;
 
 protected:
     void gatherBufferInfo() override;
     uint64_t getHeadFrameNumber(nsecs_t expectedPresentTime) const;
+    Layer::RoundedCornerState computeRoundedCornerState() const override;
 
 private:
     bool updateFrameEventHistory(const sp<Fence>& acquireFence, nsecs_t postedTime,
@@ -141,6 +145,9 @@ private:
     // Crop that applies to the buffer
     Rect computeCrop(const State& s);
 
+    // Whether mPreparedLatch was prepared for the buffer and acquire fence of the drawing state.
+    bool isLatchPrepared() const;
+
 private:
     friend class SlotGenerationTest;
     bool willPresentCurrentTransaction() const;
@@ -160,6 +167,15 @@ private:
 
     mutable bool mCurrentStateModified = false;
     bool mReleasePreviousBuffer = false;
+
+    // Results of prepareLatch, reused by latchBuffer while isLatchPrepared.
+    struct PreparedLatch {
+        uint64_t frameNumber = 0;
+        sp<Fence> acquireFence;
+        bool fenceSignaled = false;
+        std::optional<HdrMetadata> hdrMetadata;
+    };
+    PreparedLatch mPreparedLatch;
     nsecs_t mCallbackHandleAcquireTime = -1;
 
     // TODO(marissaw): support sticky transform for LEGACY camera mode
@@ -128,6 +128,17 @@ status_t Client::getLayerFrameStats(const sp<IBinder>& handle, FrameStats* outSt
     return NO_ERROR;
 }
 
+status_t Client::getLayerFrameStatsSince(const sp<IBinder>& handle, uint64_t frameNumber,
+                                         FrameStats* outStats,
+                                         uint64_t* outNextFrameNumber) const {
+    sp<Layer> layer = getLayerUser(handle);
+    if (layer == nullptr) {
+        return NAME_NOT_FOUND;
+    }
+    layer->getFrameStatsSince(frameNumber, outStats, outNextFrameNumber);
+    return NO_ERROR;
+}
+
 // ---------------------------------------------------------------------------
 }; // namespace android
 
@@ -70,6 +70,10 @@ private:
 
     virtual status_t getLayerFrameStats(const sp<IBinder>& handle, FrameStats* outStats) const;
 
+    virtual status_t getLayerFrameStatsSince(const sp<IBinder>& handle, uint64_t frameNumber,
+                                             FrameStats* outStats,
+                                             uint64_t* outNextFrameNumber) const;
+
     // constant
     sp<SurfaceFlinger> mFlinger;
 
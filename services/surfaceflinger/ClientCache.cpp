@@ -19,15 +19,38 @@
 #define LOG_TAG "ClientCache"
 #define ATRACE_TAG ATRACE_TAG_GRAPHICS
 
+#include <algorithm>
 #include <cinttypes>
 
+#include <android-base/stringprintf.h>
+#include <cutils/properties.h>
+#include <gui/ITransactionCompletedListener.h>
+#include <ui/PixelFormat.h>
+
 #include "ClientCache.h"
 
 namespace android {
 
 ANDROID_SINGLETON_STATIC_INSTANCE(ClientCache);
 
-ClientCache::ClientCache() : mDeathRecipient(new CacheDeathRecipient) {}
+namespace {
+
+size_t getBufferSize(const sp<GraphicBuffer>& buffer) {
+    // Formats without a fixed pixel size, such as YUV ones, are counted as 2 bytes per pixel.
+    uint32_t bpp = bytesPerPixel(buffer->getPixelFormat());
+    if (bpp == 0) {
+        bpp = 2;
+    }
+    return static_cast<size_t>(buffer->getStride()) * buffer->getHeight() *
+            buffer->getLayerCount() * bpp;
+}
+
+} // namespace
+
+ClientCache::ClientCache()
+      : mDeathRecipient(new CacheDeathRecipient),
+        mMaxBytes(static_cast<size_t>(
+                property_get_int64("debug.sf.client_cache_max_bytes", CLIENT_CACHE_MAX_BYTES))) {}
 
 bool ClientCache::getBuffer(const client_cache_t& cacheId,
                             ClientCacheBuffer** outClientCacheBuffer) {
@@ -51,6 +74,7 @@ bool ClientCache::getBuffer(const client_cache_t& cacheId,
     }
 
     ClientCacheBuffer& buf = bufItr->second;
+    buf.lastUsed = mUseCounter++;
     *outClientCacheBuffer = &buf;
     return true;
 }
@@ -67,7 +91,8 @@ bool ClientCache::add(const client_cache_t& cacheId, const sp<GraphicBuffer>& bu
         return false;
     }
 
-    std::lock_guard lock(mMutex);
+    std::vector<std::pair<sp<IBinder>, uint64_t>> evicted;
+    std::unique_lock lock(mMutex);
     sp<IBinder> token;
 
     // If this is a new process token, set a death recipient. If the client process dies, we will
@@ -100,7 +125,19 @@ bool ClientCache::add(const client_cache_t& cacheId, const sp<GraphicBuffer>& bu
         return false;
     }
 
-    processBuffers[id].buffer = buffer;
+    ClientCacheBuffer& buf = processBuffers[id];
+    mTotalBytes -= buf.size;
+    buf.buffer = buffer;
+    buf.size = getBufferSize(buffer);
+    buf.lastUsed = mUseCounter++;
+    buf.evicting = false;
+    mTotalBytes += buf.size;
+
+    if (mTotalBytes > mMaxBytes) {
+        evicted = evictLocked(mMaxBytes);
+        lock.unlock();
+        notifyEvicted(evicted);
+    }
     return true;
 }
 
@@ -122,6 +159,7 @@ void ClientCache::erase(const client_cache_t& cacheId) {
             }
         }
 
+        mTotalBytes -= buf->size;
         mBuffers[processToken].second.erase(id);
     }
 
@@ -183,6 +221,7 @@ void ClientCache::removeProcess(const wp<IBinder>& processToken) {
         }
 
         for (auto& [id, clientCacheBuffer] : itr->second.second) {
+            mTotalBytes -= clientCacheBuffer.size;
             client_cache_t cacheId = {processToken, id};
             for (auto& recipient : clientCacheBuffer.recipients) {
                 sp<ErasedRecipient> erasedRecipient = recipient.promote();
@@ -199,6 +238,74 @@ void ClientCache::removeProcess(const wp<IBinder>& processToken) {
     }
 }
 
+void ClientCache::trim(size_t targetBytes) {
+    std::vector<std::pair<sp<IBinder>, uint64_t>> evicted;
+    {
+        std::lock_guard lock(mMutex);
+        evicted = evictLocked(targetBytes);
+    }
+    notifyEvicted(evicted);
+}
+
+std::vector<std::pair<sp<IBinder>, uint64_t>> ClientCache::evictLocked(size_t targetBytes) {
+    struct Candidate {
+        uint64_t lastUsed;
+        ClientCacheBuffer* buf;
+        const sp<IBinder>* token;
+        uint64_t id;
+    };
+    std::vector<Candidate> candidates;
+    size_t keptBytes = 0;
+    for (auto& [processToken, process] : mBuffers) {
+        auto& [token, processBuffers] = process;
+        // Buffers cached by SurfaceFlinger itself are kept, as uncaching them would reenter it.
+        const bool local = token->localBinder() != nullptr;
+        for (auto& [id, buf] : processBuffers) {
+            if (!buf.evicting && !local) {
+                candidates.push_back({buf.lastUsed, &buf, &token, id});
+                keptBytes += buf.size;
+            }
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(),
+              [](const Candidate& a, const Candidate& b) { return a.lastUsed < b.lastUsed; });
+
+    std::vector<std::pair<sp<IBinder>, uint64_t>> evicted;
+    for (const auto& candidate : candidates) {
+        if (keptBytes <= targetBytes) {
+            break;
+        }
+        candidate.buf->evicting = true;
+        keptBytes -= candidate.buf->size;
+        evicted.emplace_back(*candidate.token, candidate.id);
+    }
+    return evicted;
+}
+
+void ClientCache::notifyEvicted(const std::vector<std::pair<sp<IBinder>, uint64_t>>& evicted) {
+    // The process tokens are the transaction completed listeners of the caching processes.
+    for (const auto& [token, id] : evicted) {
+        interface_cast<ITransactionCompletedListener>(token)->onCachedBufferEvicted(id);
+    }
+}
+
+void ClientCache::dump(std::string& result) {
+    std::lock_guard lock(mMutex);
+    base::StringAppendF(&result, "Client buffer cache: %zu KiB of %zu KiB in %zu processes\n",
+                        mTotalBytes / 1024, mMaxBytes / 1024, mBuffers.size());
+    for (const auto& [processToken, process] : mBuffers) {
+        const auto& [token, processBuffers] = process;
+        size_t bytes = 0;
+        size_t evictingCount = 0;
+        for (const auto& [id, buf] : processBuffers) {
+            bytes += buf.size;
+            evictingCount += buf.evicting;
+        }
+        base::StringAppendF(&result, "  process %p: %zu buffers (%zu evicting), %zu KiB\n",
+                            token.get(), processBuffers.size(), evictingCount, bytes / 1024);
+    }
+}
+
 void ClientCache::CacheDeathRecipient::binderDied(const wp<IBinder>& who) {
     ClientCache::getInstance().removeProcess(who);
 }
@@ -26,10 +26,16 @@
 #include <map>
 #include <mutex>
 #include <set>
+#include <string>
 #include <unordered_map>
+#include <vector>
 
 #define BUFFER_CACHE_MAX_SIZE 64
 
+// Default budget of the buffers cached by all processes together, in bytes. It can be overridden
+// with the debug.sf.client_cache_max_bytes property.
+#define CLIENT_CACHE_MAX_BYTES (256 * 1024 * 1024)
+
 namespace android {
 
 class ClientCache : public Singleton<ClientCache> {
@@ -43,6 +49,13 @@ public:
 
     void removeProcess(const wp<IBinder>& processToken);
 
+    // Asks the caching processes to uncache their least recently used buffers until the cached
+    // buffers fit in targetBytes, e.g. when the system is low on memory. Buffers are only dropped
+    // once their process uncaches them, as it may still refer to them in transactions in flight.
+    void trim(size_t targetBytes);
+
+    void dump(std::string& result);
+
     class ErasedRecipient : public virtual RefBase {
     public:
         virtual void bufferErased(const client_cache_t& clientCacheId) = 0;
@@ -59,6 +72,12 @@ private:
     struct ClientCacheBuffer {
         sp<GraphicBuffer> buffer;
         std::set<wp<ErasedRecipient>> recipients;
+        // Estimated size of the buffer in bytes.
+        size_t size = 0;
+        // Value of mUseCounter when the buffer was last added or used.
+        uint64_t lastUsed = 0;
+        // Whether the caching process was asked to uncache the buffer.
+        bool evicting = false;
     };
     std::map<wp<IBinder> /*caching process*/,
              std::pair<sp<IBinder> /*strong ref to caching process*/,
@@ -72,8 +91,19 @@ private:
 
     sp<CacheDeathRecipient> mDeathRecipient;
 
+    const size_t mMaxBytes;
+    // Size of all the cached buffers, including the ones being evicted.
+    size_t mTotalBytes GUARDED_BY(mMutex) = 0;
+    uint64_t mUseCounter GUARDED_BY(mMutex) = 0;
+
     bool getBuffer(const client_cache_t& cacheId, ClientCacheBuffer** outClientCacheBuffer)
             REQUIRES(mMutex);
+
+    // Marks the least recently used buffers which aren't being evicted yet as evicting, until
+    // the size of the other buffers fits in targetBytes. Returns the processes to notify.
+    std::vector<std::pair<sp<IBinder>, uint64_t>> evictLocked(size_t targetBytes)
+            REQUIRES(mMutex);
+    static void notifyEvicted(const std::vector<std::pair<sp<IBinder>, uint64_t>>& evicted);
 };
 
 }; // namespace android
@@ -28,6 +28,8 @@
 
 namespace android::compositionengine {
 
+class LayerFESnapshot;
+
 using Layers = std::vector<sp<compositionengine::LayerFE>>;
 using Outputs = std::vector<std::shared_ptr<compositionengine::Output>>;
 
@@ -79,6 +81,53 @@ struct CompositionRefreshArgs {
 
     // If set, causes the dirty regions to flash with the delay
     std::optional<std::chrono::microseconds> devOptFlashDirtyRegionsDelay;
+
+    // If true, the visibility computation for each output is done concurrently
+    // on a small pool of worker threads. The remaining per-output steps are
+    // still done serially, as they share the HWC command stream and the
+    // RenderEngine context.
+    bool parallelizeOutputPrepare{false};
+
+    // If true, every output is composed before any of them is presented, so that
+    // the HWC displays are presented with a single command batch rather than one
+    // round trip into the composer HAL each.
+    bool batchOutputPresents{false};
+
+    // If true, the visibility computed for a layer on the previous frame is
+    // reused when neither its geometry nor the coverage from the layers above
+    // it have changed.
+    bool incrementalVisibleRegions{false};
+
+    // If true, client composition only redraws the part of the output buffer
+    // which changed since the buffer was last drawn.
+    bool partialClientComposition{false};
+
+    // If true, the result of drawing layers which stay unchanged at the bottom
+    // of the client composition stack is cached and reused across frames.
+    bool cacheClientCompositionResults{false};
+
+    // If non-zero, runs of layers which are presented unchanged for this many
+    // frames are flattened into a single buffer presented by the HWC.
+    uint32_t layerFlatteningThreshold{0};
+
+    // If true, a compact snapshot of the state deciding whether each layer can
+    // be on an output is taken once per frame, so outputs can skip layers they
+    // cannot show without looking at the layer itself.
+    bool snapshotLayerFEState{false};
+
+    // If true, an output is not composed on refreshes where nothing it shows
+    // changed: no queued frames on its layers, no geometry or color transform
+    // update and an empty dirty region. The output keeps showing its last
+    // frame, without going through HWC validate and present.
+    bool skipIdleOutputs{false};
+
+    // The output whose present fence drives the frame timing, which is always
+    // composed so that a present fence is produced for each refresh.
+    const Output* timingOutput{nullptr};
+
+    // Set by CompositionEngine while the outputs are being prepared, if
+    // snapshotLayerFEState is set and the output geometry is being updated.
+    const LayerFESnapshot* layerFESnapshot{nullptr};
 };
 
 } // namespace android::compositionengine
@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <compositionengine/LayerFE.h>
+#include <utils/StrongPointer.h>
+
+namespace android::compositionengine {
+
+class Output;
+
+/**
+ * A structure-of-arrays copy of the front-end layer state which decides
+ * whether a layer can be visible on an output at all. It is built once per
+ * frame after the basic geometry of every layer has been latched, and is only
+ * read afterwards, so outputs which are prepared concurrently can share it.
+ *
+ * The entries are indexed the same as CompositionRefreshArgs::layers.
+ */
+class LayerFESnapshot {
+public:
+    // Rebuilds the snapshot from the latched state of the given layers
+    void build(const std::vector<sp<LayerFE>>& layers);
+    void clear();
+
+    size_t size() const { return mFlags.size(); }
+
+    // Returns false if Output::ensureOutputLayerIfVisible() would reject the
+    // layer at index on the given output before touching any of its coverage
+    // state, true otherwise.
+    bool mayBeVisibleOn(size_t index, const Output& output) const;
+
+private:
+    enum Flag : uint8_t {
+        kHasLayerStack = 1 << 0,
+        kInternalOnly = 1 << 1,
+        kVisible = 1 << 2,
+        kHasFootprint = 1 << 3,
+    };
+
+    std::vector<uint32_t> mLayerStackIds;
+    std::vector<uint8_t> mFlags;
+};
+
+} // namespace android::compositionengine
@@ -147,6 +147,9 @@ public:
         Region aboveOpaqueLayers;
         // The region of the output which should be considered dirty
         Region dirtyRegion;
+        // If true, the visibility from the last frame may be reused for layers
+        // whose inputs to the computation have not changed
+        bool reuseCachedVisibility{false};
     };
 
     virtual ~Output();
@@ -173,6 +176,11 @@ public:
     // belongsInOutput for full details.
     virtual void setLayerStackFilter(uint32_t layerStackId, bool isInternal) = 0;
 
+    // Sets the maximum rate at which the output is composed, or 0 for no limit.
+    // Refreshes which come sooner than that after the last composition of the
+    // output are skipped for it, and their changes are composed on a later one.
+    virtual void setMaxFrameRate(float frameRate) = 0;
+
     // Sets the output color mode
     virtual void setColorProfile(const ColorProfile&) = 0;
 
@@ -248,6 +256,11 @@ public:
     // Presents the output, finalizing all composition details
     virtual void present(const CompositionRefreshArgs&) = 0;
 
+    // The two halves of present(), so that several outputs can be composed before any of them
+    // is presented. composeFrame returns whether there is a frame for postFramebuffer to present.
+    virtual bool composeFrame(const CompositionRefreshArgs&) = 0;
+    virtual void postFramebuffer() = 0;
+
     // Latches the front-end layer state for each output layer
     virtual void updateLayerStateFromFE(const CompositionRefreshArgs&) const = 0;
 
@@ -269,7 +282,6 @@ protected:
     virtual void finishFrame(const CompositionRefreshArgs&) = 0;
     virtual std::optional<base::unique_fd> composeSurfaces(
             const Region&, const compositionengine::CompositionRefreshArgs& refreshArgs) = 0;
-    virtual void postFramebuffer() = 0;
     virtual void chooseCompositionStrategy() = 0;
     virtual bool getSkipColorTransform() const = 0;
     virtual FrameFences presentAndGetFrameFences() = 0;
@@ -21,6 +21,7 @@
 
 #include <ui/Fence.h>
 #include <ui/GraphicTypes.h>
+#include <ui/Region.h>
 #include <ui/Size.h>
 #include <utils/Errors.h>
 #include <utils/StrongPointer.h>
@@ -86,6 +87,15 @@ public:
     // which will fire when the buffer is ready for consumption.
     virtual void queueBuffer(base::unique_fd readyFence) = 0;
 
+    // Adds to the region of the surface, in display space, whose content
+    // changed since the last buffer was queued.
+    virtual void addFrameDamage(const Region&) = 0;
+
+    // Returns the region of the last dequeued buffer, in display space, which
+    // has to be redrawn for the buffer to hold the current frame. The rest of
+    // the buffer is already up to date.
+    virtual Region getBufferDamage() const = 0;
+
     // Called after the HWC calls are made to present the display
     virtual void onPresentDisplayCompleted() = 0;
 
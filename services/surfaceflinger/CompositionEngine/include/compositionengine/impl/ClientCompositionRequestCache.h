@@ -27,6 +27,13 @@ namespace android {
 
 namespace compositionengine::impl {
 
+// Returns a copy of the settings which does not hold strong references to the client buffer.
+LayerFE::LayerSettings getLayerSettingsSnapshot(const LayerFE::LayerSettings& settings);
+
+// Returns whether both settings draw the same content. Client buffers are compared by their
+// buffer id and frame number, so a snapshot compares equal to the settings it was taken from.
+bool layerSettingsAreEqual(const LayerFE::LayerSettings& lhs, const LayerFE::LayerSettings& rhs);
+
 // The cache is used to skip duplicate client composition requests. We do so by keeping track
 // of every composition request and the buffer that the request is rendered into. During the
 // next composition request, if the request matches what was rendered into the buffer, then
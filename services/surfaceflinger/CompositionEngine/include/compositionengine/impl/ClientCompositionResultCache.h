@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include <compositionengine/LayerFE.h>
+#include <renderengine/DisplaySettings.h>
+#include <renderengine/LayerSettings.h>
+#include <ui/Fence.h>
+#include <ui/GraphicBuffer.h>
+
+namespace android {
+
+namespace renderengine {
+class RenderEngine;
+} // namespace renderengine
+
+namespace compositionengine::impl {
+
+// The cache is used to avoid redrawing the static bottom of a layer stack on every frame which
+// uses client composition. Once the bottom-most layers of a request have been drawing the same
+// content for a few frames, they are drawn once into an offscreen buffer, and replaced in the
+// request by a single layer drawing that buffer.
+//
+// Entries are keyed by a hash of the content of the layers they were drawn from, rather than by
+// frame or by output buffer, so a layer stack going back to an earlier state (e.g. when
+// switching back and forth between two apps over the same wallpaper) reuses the earlier result.
+class ClientCompositionResultCache {
+public:
+    // The number of consecutive frames a layer must be drawn unchanged before being cached.
+    static constexpr uint32_t kMinStableFrames = 2;
+    // The smallest number of layers worth drawing from a cached result.
+    static constexpr size_t kMinCachedLayers = 2;
+
+    ClientCompositionResultCache(renderengine::RenderEngine&, size_t maxEntries);
+    ~ClientCompositionResultCache();
+
+    ClientCompositionResultCache(const ClientCompositionResultCache&) = delete;
+    ClientCompositionResultCache& operator=(const ClientCompositionResultCache&) = delete;
+
+    // Replaces the bottom-most stable layers of the request with a single layer drawing their
+    // cached result, drawing it first if it is not cached yet. Must be called once per frame
+    // which uses client composition, as it also tracks how long each layer has been stable.
+    void apply(const renderengine::DisplaySettings&, std::vector<LayerFE::LayerSettings>& layers);
+
+    size_t getEntryCountForTest() const { return mEntries.size(); }
+
+private:
+    struct Entry {
+        size_t key;
+        renderengine::DisplaySettings display;
+        std::vector<LayerFE::LayerSettings> layers;
+        sp<GraphicBuffer> buffer;
+        sp<Fence> drawFence;
+        uint64_t generation;
+    };
+
+    static bool isCacheable(const renderengine::DisplaySettings&);
+    static bool isCacheable(const LayerFE::LayerSettings&);
+    static bool displayMatches(const renderengine::DisplaySettings& lhs,
+                               const renderengine::DisplaySettings& rhs);
+
+    const Entry* findEntry(size_t key, const renderengine::DisplaySettings&,
+                           const std::vector<LayerFE::LayerSettings>& layers, size_t count);
+    const Entry* drawEntry(size_t key, const renderengine::DisplaySettings&,
+                           const std::vector<LayerFE::LayerSettings>& layers, size_t count);
+    LayerFE::LayerSettings getCachedLayerSettings(const Entry&) const;
+    void releaseEntry(const Entry&);
+
+    renderengine::RenderEngine& mRenderEngine;
+    const size_t mMaxEntries;
+    uint32_t mTextureName = 0;
+    uint64_t mGeneration = 0;
+
+    // The content hash of each layer of the last request, and the number of
+    // frames in a row it has been drawn with that content.
+    std::vector<size_t> mLayerHashes;
+    std::vector<uint32_t> mStableFrames;
+
+    // The cached results, most recently used first.
+    std::deque<Entry> mEntries;
+};
+
+} // namespace compositionengine::impl
+} // namespace android
@@ -17,6 +17,11 @@
 #pragma once
 
 #include <compositionengine/CompositionEngine.h>
+#include <compositionengine/LayerFESnapshot.h>
+#include <compositionengine/impl/OutputWorkerPool.h>
+
+#include <string>
+#include <vector>
 
 namespace android::compositionengine::impl {
 
@@ -56,12 +61,38 @@ public:
     // Testing
     void setNeedsAnotherUpdateForTest(bool);
 
+    // The per-output timing information captured for the last frame
+    struct OutputTiming {
+        std::string name;
+        nsecs_t prepareStart = 0;
+        nsecs_t prepareEnd = 0;
+        nsecs_t presentStart = 0;
+        nsecs_t presentEnd = 0;
+    };
+
+    const std::vector<OutputTiming>& getLastFrameOutputTimingsForTest() const;
+
 private:
+    void prepareOutputs(CompositionRefreshArgs& args);
+    void prepareOutputsInParallel(CompositionRefreshArgs& args);
+    void presentOutputs(CompositionRefreshArgs& args);
+    // Composes every output before presenting them all with a single HWC command batch.
+    void presentOutputsBatched(CompositionRefreshArgs& args);
+    // Latches the basic geometry of every candidate layer ahead of the outputs,
+    // and takes the per-frame snapshot if one was requested.
+    void latchBasicGeometry(CompositionRefreshArgs& args, LayerFESet& latchedLayers);
+
+    // The maximum number of worker threads used to prepare outputs concurrently
+    static constexpr size_t kMaxOutputWorkerThreads = 3;
+
     std::unique_ptr<HWComposer> mHwComposer;
     std::unique_ptr<renderengine::RenderEngine> mRenderEngine;
     std::shared_ptr<TimeStats> mTimeStats;
     bool mNeedsAnotherUpdate = false;
     nsecs_t mRefreshStartTime = 0;
+    std::vector<OutputTiming> mOutputTimings;
+    LayerFESnapshot mLayerFESnapshot;
+    OutputWorkerPool mOutputWorkerPool{kMaxOutputWorkerThreads};
 };
 
 std::unique_ptr<compositionengine::CompositionEngine> createCompositionEngine();
@@ -47,20 +47,45 @@ namespace compositionengine::impl {
 // use HWComposerBufferCache to mirror the cache in SF.
 class HwcBufferCache {
 public:
+    struct Stats {
+        // Buffers found in the cache, so only the slot was sent to the HWC.
+        uint32_t hits = 0;
+        // Buffers that had to be sent, and imported by the HAL.
+        uint32_t misses = 0;
+        // Misses that replaced another live buffer in the cache.
+        uint32_t evictions = 0;
+    };
+
     HwcBufferCache();
     // Given a buffer, return the HWC cache slot and
     // buffer to be sent to HWC.
     //
     // outBuffer is set to buffer when buffer is not in the HWC cache;
     // otherwise, outBuffer is set to nullptr.
+    //
+    // If slot is not a valid BufferQueue slot, the buffer is looked up by its
+    // id, and is otherwise given the least-recently used slot. This keeps
+    // layers without slot information from re-sending the same few buffers
+    // through a single slot.
     void getHwcBuffer(int slot, const sp<GraphicBuffer>& buffer, uint32_t* outSlot,
                       sp<GraphicBuffer>* outBuffer);
 
+    const Stats& getStats() const { return mStats; }
+
 private:
-    // an array where the index corresponds to a slot and the value corresponds to a (counter,
-    // buffer) pair. "counter" is a unique value that indicates the last time this slot was updated
-    // or used and allows us to keep track of the least-recently used buffer.
+    static bool isValidSlot(int slot);
+    uint32_t findSlotForBuffer(const sp<GraphicBuffer>& buffer) const;
+
+    // an array where the index corresponds to a slot and the value corresponds to the buffer last
+    // sent to the HWC in that slot.
     wp<GraphicBuffer> mBuffers[BufferQueue::NUM_BUFFER_SLOTS];
+    // The id of the buffer in each slot, and a counter value that indicates the last time the slot
+    // was updated or used, which allows us to keep track of the least-recently used slot.
+    uint64_t mBufferIds[BufferQueue::NUM_BUFFER_SLOTS] = {};
+    uint64_t mLastUsed[BufferQueue::NUM_BUFFER_SLOTS] = {};
+    uint64_t mCounter = 0;
+
+    Stats mStats;
 };
 
 } // namespace compositionengine::impl
@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include <compositionengine/LayerFE.h>
+#include <ui/Fence.h>
+#include <ui/FloatRect.h>
+#include <ui/GraphicBuffer.h>
+#include <ui/Rect.h>
+#include <ui/Region.h>
+
+// TODO(b/129481165): remove the #pragma below and fix conversion issues
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wconversion"
+
+#include "DisplayHardware/ComposerHal.h"
+
+// TODO(b/129481165): remove the #pragma below and fix conversion issues
+#pragma clang diagnostic pop // ignored "-Wconversion"
+
+namespace android {
+
+class TimeStats;
+
+namespace renderengine {
+class RenderEngine;
+} // namespace renderengine
+
+namespace compositionengine {
+
+class Output;
+class OutputLayer;
+
+namespace impl {
+
+// Flattens runs of layers which have not changed for a while into a single
+// buffer, which is presented to the HWC in place of the layers, so that static
+// content does not take up HWC planes or get client composited every frame.
+//
+// The first layer of a flattened run presents the buffer, and the other layers
+// of the run are presented as fully transparent until one of them changes.
+class LayerFlattener {
+public:
+    // A run of layers is flattened once all of its layers have been presented
+    // unchanged for minStableFrames frames.
+    LayerFlattener(renderengine::RenderEngine&, TimeStats&, uint32_t minStableFrames);
+    ~LayerFlattener();
+
+    LayerFlattener(const LayerFlattener&) = delete;
+    LayerFlattener& operator=(const LayerFlattener&) = delete;
+
+    // Updates how long each layer of the output has been unchanged, and sets
+    // the override state of the layers of the flattened run, if there is one.
+    // Must be called once per frame, after the composition state of the layers
+    // is updated and before it is written to the HWC.
+    void flatten(const compositionengine::Output&);
+
+    // Checks whether the HWC accepted the flattened run for device composition.
+    // If not, the run is dropped so the layers are presented normally again.
+    void onCompositionStrategyChosen(const compositionengine::Output&);
+
+    // Returns the settings for drawing the buffer presented by a layer with
+    // client composition, used if the HWC could not present it.
+    LayerFE::LayerSettings getOverrideLayerSettings(const compositionengine::Output&,
+                                                     const compositionengine::OutputLayer&) const;
+
+    // Clears the override state of all the layers of the output.
+    static void clearOverrides(const compositionengine::Output&);
+
+private:
+    // The state of a layer which is presented to the HWC, used to detect changes.
+    struct LayerSnapshot {
+        const LayerFE* layerFE{nullptr};
+        sp<GraphicBuffer> buffer;
+        sp<Fence> acquireFence;
+        half4 color;
+        float alpha{1.f};
+        hal::BlendMode blendMode{hal::BlendMode::INVALID};
+        hal::Composition compositionType{hal::Composition::INVALID};
+        Rect displayFrame;
+        FloatRect sourceCrop;
+        Hwc2::Transform bufferTransform{static_cast<Hwc2::Transform>(0)};
+        ui::Dataspace dataspace{ui::Dataspace::UNKNOWN};
+        Region visibleRegion;
+        bool cacheable{false};
+
+        bool operator==(const LayerSnapshot&) const;
+    };
+
+    struct FlattenedRun {
+        size_t start{0};
+        size_t count{0};
+        sp<GraphicBuffer> buffer;
+        sp<Fence> drawFence;
+        Rect displayFrame;
+        Region visibleRegion;
+        // True until the buffer is presented by the HWC for the first time.
+        bool isNew{true};
+    };
+
+    static LayerSnapshot getSnapshot(const compositionengine::OutputLayer&);
+    bool runIsUnchanged() const;
+    void findRun();
+    bool drawRun(const compositionengine::Output&);
+    void applyOverrides(const compositionengine::Output&) const;
+    void dropRun();
+
+    renderengine::RenderEngine& mRenderEngine;
+    TimeStats& mTimeStats;
+    const uint32_t mMinStableFrames;
+    uint32_t mTextureName = 0;
+
+    // The snapshot of each layer on the last frame, in Z order, and the number
+    // of frames in a row it has been presented unchanged.
+    std::vector<LayerSnapshot> mSnapshots;
+    std::vector<uint32_t> mStableFrames;
+
+    std::optional<FlattenedRun> mRun;
+    // Set by flatten, and cleared once the composition strategy is checked, as
+    // the strategy may be chosen more than once per frame.
+    bool mStrategyCheckPending = false;
+
+    // The ids of dropped buffers, released once they are no longer presented.
+    std::vector<uint64_t> mReleasedBufferIds;
+};
+
+} // namespace impl
+} // namespace compositionengine
+} // namespace android
@@ -19,6 +19,8 @@
 #include <compositionengine/CompositionEngine.h>
 #include <compositionengine/Output.h>
 #include <compositionengine/impl/ClientCompositionRequestCache.h>
+#include <compositionengine/impl/ClientCompositionResultCache.h>
+#include <compositionengine/impl/LayerFlattener.h>
 #include <compositionengine/impl/OutputCompositionState.h>
 #include <renderengine/DisplaySettings.h>
 #include <renderengine/LayerSettings.h>
@@ -43,6 +45,7 @@ public:
                        bool needsFiltering) override;
     void setBounds(const ui::Size&) override;
     void setLayerStackFilter(uint32_t layerStackId, bool isInternal) override;
+    void setMaxFrameRate(float frameRate) override;
 
     void setColorTransform(const compositionengine::CompositionRefreshArgs&) override;
     void setColorProfile(const ColorProfile&) override;
@@ -68,6 +71,7 @@ public:
 
     void prepare(const CompositionRefreshArgs&, LayerFESet&) override;
     void present(const CompositionRefreshArgs&) override;
+    bool composeFrame(const CompositionRefreshArgs&) override;
 
     void rebuildLayerStacks(const CompositionRefreshArgs&, LayerFESet&) override;
     void collectVisibleLayers(const CompositionRefreshArgs&,
@@ -116,7 +120,14 @@ protected:
     virtual void dumpState(std::string& out) const = 0;
 
 private:
+    bool ensureOutputLayerFromVisibilityCache(sp<compositionengine::LayerFE>&,
+                                              const LayerFECompositionState&,
+                                              const Rect& footprint,
+                                              compositionengine::Output::CoverageState&);
     void dirtyEntireOutput();
+    bool skipFrameForMaxFrameRate(const compositionengine::CompositionRefreshArgs&);
+    bool isIdle(const compositionengine::CompositionRefreshArgs&) const;
+    bool updateClientCompositionStructure(const renderengine::DisplaySettings&);
     compositionengine::OutputLayer* findLayerRequestingBackgroundComposition() const;
     ui::Dataspace getBestDataspace(ui::Dataspace*, bool*) const;
     compositionengine::Output::ColorProfile pickColorProfile(
@@ -130,6 +141,15 @@ private:
     ReleasedLayers mReleasedLayers;
     OutputLayer* mLayerRequestingBackgroundBlur = nullptr;
     std::unique_ptr<ClientCompositionRequestCache> mClientCompositionRequestCache;
+    std::unique_ptr<ClientCompositionResultCache> mClientCompositionResultCache;
+    std::unique_ptr<LayerFlattener> mLayerFlattener;
+
+    // What was composed by the GPU on the last frame which used client
+    // composition, other than the content of the layers. Used to detect the
+    // changes which the dirty region does not account for.
+    std::vector<std::pair<const compositionengine::OutputLayer*, bool>>
+            mLastClientCompositionLayers;
+    renderengine::DisplaySettings mLastClientCompositionDisplay;
 };
 
 // This template factory function standardizes the implementation details of the
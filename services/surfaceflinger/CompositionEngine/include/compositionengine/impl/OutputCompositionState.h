@@ -32,6 +32,7 @@
 #include <ui/Rect.h>
 #include <ui/Region.h>
 #include <ui/Transform.h>
+#include <utils/Timers.h>
 
 namespace android {
 
@@ -101,6 +102,22 @@ struct OutputCompositionState {
     // True if the last composition frame had visible layers
     bool lastCompositionHadVisibleLayers{false};
 
+    // The minimum time between two compositions of the output, or 0 if the
+    // output is composed on every refresh.
+    nsecs_t minFramePeriod{0};
+
+    // The refresh time from which the output is next composed, if
+    // minFramePeriod is set.
+    nsecs_t nextFrameTime{0};
+
+    // If true, the last refresh was skipped for the output while it had
+    // changes to compose.
+    bool frameDeferred{false};
+
+    // If true, the geometry changed on a skipped refresh, so it is written
+    // again on the next composition.
+    bool geometryUpdatePending{false};
+
     // The color transform matrix to apply
     mat4 colorTransformMatrix;
 
@@ -22,10 +22,13 @@
 
 #include <compositionengine/impl/HwcBufferCache.h>
 #include <renderengine/Mesh.h>
+#include <ui/Fence.h>
 #include <ui/FloatRect.h>
+#include <ui/GraphicBuffer.h>
 #include <ui/GraphicTypes.h>
 #include <ui/Rect.h>
 #include <ui/Region.h>
+#include <ui/Transform.h>
 
 // TODO(b/129481165): remove the #pragma below and fix conversion issues
 #pragma clang diagnostic push
@@ -83,6 +86,50 @@ struct OutputLayerCompositionState {
     // The Z order index of this layer on this output
     uint32_t z{0};
 
+    // The inputs to the visibility computation for this layer on the last
+    // frame, which is only set if incremental visible regions are enabled.
+    // If the inputs are unchanged on the next frame, the visibility results
+    // above can be reused as is.
+    struct VisibilityCache {
+        // The layer geometry
+        ui::Transform geomLayerTransform;
+        FloatRect geomLayerBounds;
+        Region transparentRegionHint;
+        float shadowRadius{0.f};
+        bool isOpaque{false};
+
+        // The output geometry
+        ui::Transform outputTransform;
+        Rect outputBounds;
+        Rect outputViewport;
+
+        // The opaque coverage of the layers above, clipped to this layer
+        Region aboveOpaqueLayers;
+
+        // The opaque region this layer contributed to the coverage
+        Region opaqueRegion;
+    };
+    std::optional<VisibilityCache> visibilityCache;
+
+    // The state written to the HWC in place of the layer's own when it is part
+    // of a run of layers flattened into a single buffer by the LayerFlattener.
+    struct OverrideInfo {
+        // The flattened buffer, which this layer presents, if set
+        sp<GraphicBuffer> buffer;
+        sp<Fence> acquireFence;
+
+        // The output space frame covered by the flattened buffer
+        Rect displayFrame;
+        ui::Dataspace dataspace{ui::Dataspace::UNKNOWN};
+        Region visibleRegion;
+        Region surfaceDamage;
+
+        // If true, this layer is drawn in the buffer presented by another
+        // layer, and is presented as fully transparent.
+        bool skip{false};
+    };
+    OverrideInfo overrideInfo;
+
     /*
      * HWC state
      */
@@ -97,6 +144,9 @@ struct OutputLayerCompositionState {
         Hwc2::IComposerClient::Composition hwcCompositionType{
                 Hwc2::IComposerClient::Composition::INVALID};
 
+        // True if the geometry last written to the HWC was overridden
+        bool overridden{false};
+
         // The buffer cache for this layer. This is used to lower the
         // cost of sending reused buffers to the HWC.
         HwcBufferCache hwcBufferCache;
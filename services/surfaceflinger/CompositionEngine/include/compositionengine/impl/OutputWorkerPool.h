@@ -0,0 +1,67 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <android-base/thread_annotations.h>
+
+namespace android::compositionengine::impl {
+
+// A small, fixed-size pool of worker threads used to run independent per-output
+// work concurrently. The threads are created lazily on first use and live for
+// the lifetime of the pool, so that steady-state frames do not pay for thread
+// creation.
+class OutputWorkerPool {
+public:
+    using Task = std::function<void()>;
+
+    explicit OutputWorkerPool(size_t maxThreads);
+    ~OutputWorkerPool();
+
+    OutputWorkerPool(const OutputWorkerPool&) = delete;
+    OutputWorkerPool& operator=(const OutputWorkerPool&) = delete;
+
+    // Runs all the tasks, and returns once every one of them has completed. The
+    // first task is always run on the calling thread, the rest are distributed
+    // to the worker threads.
+    void runAll(std::vector<Task>& tasks);
+
+    size_t getThreadCountForTest() const;
+
+private:
+    void ensureThreads(size_t count) REQUIRES(mMutex);
+    void threadMain();
+
+    const size_t mMaxThreads;
+
+    mutable std::mutex mMutex;
+    std::condition_variable mWorkAvailable;
+    std::condition_variable mWorkDone;
+    std::deque<Task*> mPending GUARDED_BY(mMutex);
+    size_t mOutstanding GUARDED_BY(mMutex) = 0;
+    bool mExiting GUARDED_BY(mMutex) = false;
+    std::vector<std::thread> mThreads GUARDED_BY(mMutex);
+};
+
+} // namespace android::compositionengine::impl
@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include <deque>
 #include <memory>
 
 #include <android-base/unique_fd.h>
@@ -56,6 +57,8 @@ public:
     void prepareFrame(bool usesClientComposition, bool usesDeviceComposition) override;
     sp<GraphicBuffer> dequeueBuffer(base::unique_fd* bufferFence) override;
     void queueBuffer(base::unique_fd readyFence) override;
+    void addFrameDamage(const Region&) override;
+    Region getBufferDamage() const override;
     void onPresentDisplayCompleted() override;
     void flip() override;
 
@@ -81,6 +84,21 @@ private:
     ui::Size mSize;
     bool mProtected{false};
     std::uint32_t mPageFlipCount{0};
+
+    // The number of queued frames whose damage is remembered, which bounds the
+    // age of the buffers that can be partially redrawn.
+    static constexpr size_t kMaxTrackedBufferAge = 4;
+
+    struct QueuedFrame {
+        // The region which changed since the previously queued frame
+        Region damage;
+        // Whether the buffer was drawn before it was queued
+        bool drawn;
+    };
+    // The most recently queued frames, newest first
+    std::deque<QueuedFrame> mQueuedFrames;
+    // The region which changed since the last queued frame
+    Region mFrameDamage;
 };
 
 std::unique_ptr<compositionengine::RenderSurface> createRenderSurface(
@@ -41,6 +41,8 @@ public:
     MOCK_METHOD2(prepareFrame, void(bool, bool));
     MOCK_METHOD1(dequeueBuffer, sp<GraphicBuffer>(base::unique_fd*));
     MOCK_METHOD1(queueBuffer, void(base::unique_fd));
+    MOCK_METHOD1(addFrameDamage, void(const Region&));
+    MOCK_CONST_METHOD0(getBufferDamage, Region());
     MOCK_METHOD0(onPresentDisplayCompleted, void());
     MOCK_METHOD0(flip, void());
     MOCK_CONST_METHOD1(dump, void(std::string& result));
@@ -0,0 +1,269 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <functional>
+
+#include <compositionengine/impl/ClientCompositionRequestCache.h>
+#include <compositionengine/impl/ClientCompositionResultCache.h>
+#include <renderengine/RenderEngine.h>
+#include <utils/Trace.h>
+
+namespace android::compositionengine::impl {
+
+namespace {
+
+size_t hashCombine(size_t seed, size_t value) {
+    return seed ^ (value + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+}
+
+template <typename T>
+size_t hashCombine(size_t seed, const T& value) {
+    return hashCombine(seed, std::hash<T>{}(value));
+}
+
+size_t hashCombine(size_t seed, const FloatRect& rect) {
+    seed = hashCombine(seed, rect.left);
+    seed = hashCombine(seed, rect.top);
+    seed = hashCombine(seed, rect.right);
+    return hashCombine(seed, rect.bottom);
+}
+
+size_t hashCombine(size_t seed, const mat4& matrix) {
+    const float* values = matrix.asArray();
+    for (size_t i = 0; i < mat4::ROW_SIZE * mat4::COL_SIZE; i++) {
+        seed = hashCombine(seed, values[i]);
+    }
+    return seed;
+}
+
+// Hashes the content drawn by a layer. Equal settings, as compared by
+// layerSettingsAreEqual, have equal hashes.
+size_t hashLayerSettings(const LayerFE::LayerSettings& settings) {
+    size_t hash = std::hash<uint64_t>{}(settings.bufferId);
+    hash = hashCombine(hash, settings.frameNumber);
+    hash = hashCombine(hash, settings.geometry.boundaries);
+    hash = hashCombine(hash, settings.geometry.positionTransform);
+    hash = hashCombine(hash, settings.geometry.roundedCornersRadius);
+    hash = hashCombine(hash, settings.source.solidColor.r);
+    hash = hashCombine(hash, settings.source.solidColor.g);
+    hash = hashCombine(hash, settings.source.solidColor.b);
+    hash = hashCombine(hash, settings.source.buffer.textureTransform);
+    hash = hashCombine(hash, settings.alpha);
+    hash = hashCombine(hash, static_cast<int32_t>(settings.sourceDataspace));
+    hash = hashCombine(hash, settings.disableBlending);
+    return hashCombine(hash, settings.shadow.length);
+}
+
+size_t hashDisplaySettings(const renderengine::DisplaySettings& display) {
+    size_t hash = std::hash<int32_t>{}(display.clip.left);
+    hash = hashCombine(hash, display.clip.top);
+    hash = hashCombine(hash, display.clip.right);
+    hash = hashCombine(hash, display.clip.bottom);
+    return hashCombine(hash, static_cast<int32_t>(display.outputDataspace));
+}
+
+bool isHdrDataspace(ui::Dataspace dataspace) {
+    const auto transfer = static_cast<ui::Dataspace>(static_cast<int32_t>(dataspace) &
+                                                     static_cast<int32_t>(
+                                                             ui::Dataspace::TRANSFER_MASK));
+    return transfer == ui::Dataspace::TRANSFER_ST2084 || transfer == ui::Dataspace::TRANSFER_HLG;
+}
+
+} // namespace
+
+ClientCompositionResultCache::ClientCompositionResultCache(renderengine::RenderEngine& renderEngine,
+                                                           size_t maxEntries)
+      : mRenderEngine(renderEngine), mMaxEntries(maxEntries) {
+    mRenderEngine.genTextures(1, &mTextureName);
+}
+
+ClientCompositionResultCache::~ClientCompositionResultCache() {
+    for (const Entry& entry : mEntries) {
+        releaseEntry(entry);
+    }
+    mRenderEngine.deleteTextures(1, &mTextureName);
+}
+
+void ClientCompositionResultCache::apply(const renderengine::DisplaySettings& display,
+                                         std::vector<LayerFE::LayerSettings>& layers) {
+    ATRACE_CALL();
+
+    std::vector<size_t> layerHashes;
+    std::vector<uint32_t> stableFrames;
+    layerHashes.reserve(layers.size());
+    stableFrames.reserve(layers.size());
+    for (size_t i = 0; i < layers.size(); i++) {
+        const size_t hash = hashLayerSettings(layers[i]);
+        const bool unchanged = i < mLayerHashes.size() && mLayerHashes[i] == hash;
+        layerHashes.push_back(hash);
+        stableFrames.push_back(unchanged ? mStableFrames[i] + 1 : 0);
+    }
+    mLayerHashes = std::move(layerHashes);
+    mStableFrames = std::move(stableFrames);
+
+    if (!isCacheable(display) || mRenderEngine.isProtected()) {
+        return;
+    }
+
+    size_t count = 0;
+    size_t key = hashDisplaySettings(display);
+    while (count < layers.size() && mStableFrames[count] >= kMinStableFrames &&
+           isCacheable(layers[count])) {
+        key = hashCombine(key, mLayerHashes[count]);
+        count++;
+    }
+    if (count < kMinCachedLayers) {
+        return;
+    }
+
+    const Entry* entry = findEntry(key, display, layers, count);
+    if (entry == nullptr) {
+        entry = drawEntry(key, display, layers, count);
+    }
+    if (entry == nullptr) {
+        return;
+    }
+
+    layers[count - 1] = getCachedLayerSettings(*entry);
+    layers.erase(layers.begin(), layers.begin() + count - 1);
+}
+
+bool ClientCompositionResultCache::isCacheable(const renderengine::DisplaySettings& display) {
+    // The display color transform is applied to the cached result when it is
+    // drawn, so it cannot be applied when drawing the result as well.
+    return display.colorTransform == mat4() && display.clip.isValid() &&
+            !isHdrDataspace(display.outputDataspace);
+}
+
+bool ClientCompositionResultCache::isCacheable(const LayerFE::LayerSettings& layer) {
+    // Blurs are drawn in a separate pass using the full output buffer.
+    if (layer.backgroundBlurRadius > 0) {
+        return false;
+    }
+    const sp<GraphicBuffer>& buffer = layer.source.buffer.buffer;
+    return buffer == nullptr || !(buffer->getUsage() & GRALLOC_USAGE_PROTECTED);
+}
+
+bool ClientCompositionResultCache::displayMatches(const renderengine::DisplaySettings& lhs,
+                                                  const renderengine::DisplaySettings& rhs) {
+    return lhs.clip == rhs.clip && lhs.maxLuminance == rhs.maxLuminance &&
+            lhs.outputDataspace == rhs.outputDataspace &&
+            lhs.clearRegion.hasSameRects(rhs.clearRegion);
+}
+
+const ClientCompositionResultCache::Entry* ClientCompositionResultCache::findEntry(
+        size_t key, const renderengine::DisplaySettings& display,
+        const std::vector<LayerFE::LayerSettings>& layers, size_t count) {
+    auto it = std::find_if(mEntries.begin(), mEntries.end(), [&](const Entry& entry) {
+        return entry.key == key && displayMatches(entry.display, display) &&
+                std::equal(entry.layers.begin(), entry.layers.end(), layers.begin(),
+                           layers.begin() + count, layerSettingsAreEqual);
+    });
+    if (it == mEntries.end()) {
+        return nullptr;
+    }
+    if (it != mEntries.begin()) {
+        Entry entry = std::move(*it);
+        mEntries.erase(it);
+        mEntries.push_front(std::move(entry));
+    }
+    return &mEntries.front();
+}
+
+const ClientCompositionResultCache::Entry* ClientCompositionResultCache::drawEntry(
+        size_t key, const renderengine::DisplaySettings& display,
+        const std::vector<LayerFE::LayerSettings>& layers, size_t count) {
+    ATRACE_CALL();
+
+    // The result is drawn in layer stack space, and is projected onto the
+    // output along with the rest of the layers when it is drawn.
+    const uint32_t width = static_cast<uint32_t>(display.clip.getWidth());
+    const uint32_t height = static_cast<uint32_t>(display.clip.getHeight());
+    sp<GraphicBuffer> buffer =
+            new GraphicBuffer(width, height, HAL_PIXEL_FORMAT_RGBA_8888, 1,
+                              GRALLOC_USAGE_HW_RENDER | GRALLOC_USAGE_HW_TEXTURE,
+                              "ClientCompositionResultCache");
+    if (buffer->initCheck() != NO_ERROR) {
+        ALOGE("Failed to allocate a buffer for caching client composition results");
+        return nullptr;
+    }
+
+    renderengine::DisplaySettings cacheDisplay;
+    cacheDisplay.physicalDisplay = Rect(width, height);
+    cacheDisplay.clip = display.clip;
+    cacheDisplay.maxLuminance = display.maxLuminance;
+    cacheDisplay.outputDataspace = display.outputDataspace;
+    cacheDisplay.clearRegion = display.clearRegion;
+
+    std::vector<const renderengine::LayerSettings*> layerPointers;
+    layerPointers.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        layerPointers.push_back(&layers[i]);
+    }
+
+    base::unique_fd drawFence;
+    const status_t status =
+            mRenderEngine.drawLayers(cacheDisplay, layerPointers, buffer->getNativeBuffer(),
+                                     /*useFramebufferCache=*/false, base::unique_fd(),
+                                     &drawFence);
+    if (status != NO_ERROR) {
+        ALOGE("Failed to draw client composition results for caching: %d", status);
+        return nullptr;
+    }
+
+    if (mEntries.size() >= mMaxEntries) {
+        releaseEntry(mEntries.back());
+        mEntries.pop_back();
+    }
+
+    Entry entry{key,
+                display,
+                {},
+                std::move(buffer),
+                drawFence.get() >= 0 ? sp<Fence>(new Fence(drawFence.release())) : Fence::NO_FENCE,
+                ++mGeneration};
+    entry.layers.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        entry.layers.push_back(getLayerSettingsSnapshot(layers[i]));
+    }
+    mEntries.push_front(std::move(entry));
+    return &mEntries.front();
+}
+
+LayerFE::LayerSettings ClientCompositionResultCache::getCachedLayerSettings(
+        const Entry& entry) const {
+    LayerFE::LayerSettings settings;
+    settings.geometry.boundaries = entry.display.clip.toFloatRect();
+    settings.source.buffer.buffer = entry.buffer;
+    settings.source.buffer.fence = entry.drawFence;
+    settings.source.buffer.textureName = mTextureName;
+    settings.source.buffer.usePremultipliedAlpha = true;
+    settings.sourceDataspace = entry.display.outputDataspace;
+    settings.alpha = 1.0f;
+    // The cached layers were at the bottom of the stack, so their result
+    // replaces whatever is below it rather than blending with it.
+    settings.disableBlending = true;
+    settings.bufferId = entry.buffer->getId();
+    settings.frameNumber = entry.generation;
+    return settings;
+}
+
+void ClientCompositionResultCache::releaseEntry(const Entry& entry) {
+    mRenderEngine.unbindExternalTextureBuffer(entry.buffer->getId());
+}
+
+} // namespace android::compositionengine::impl
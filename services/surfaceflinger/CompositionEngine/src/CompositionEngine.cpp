@@ -14,6 +14,8 @@
  * limitations under the License.
  */
 
+#include <cinttypes>
+
 #include <compositionengine/CompositionRefreshArgs.h>
 #include <compositionengine/LayerFE.h>
 #include <compositionengine/LayerFECompositionState.h>
@@ -21,6 +23,7 @@
 #include <compositionengine/impl/CompositionEngine.h>
 #include <compositionengine/impl/Display.h>
 
+#include <android-base/stringprintf.h>
 #include <renderengine/RenderEngine.h>
 #include <utils/Trace.h>
 
@@ -93,22 +96,124 @@ void CompositionEngine::present(CompositionRefreshArgs& args) {
     ALOGV(__FUNCTION__);
 
     preComposition(args);
+    args.layerFESnapshot = nullptr;
 
-    {
-        // latchedLayers is used to track the set of front-end layer state that
-        // has been latched across all outputs for the prepare step, and is not
-        // needed for anything else.
-        LayerFESet latchedLayers;
+    mOutputTimings.resize(args.outputs.size());
+    for (size_t i = 0; i < args.outputs.size(); i++) {
+        mOutputTimings[i] = OutputTiming{.name = args.outputs[i]->getName()};
+    }
 
-        for (const auto& output : args.outputs) {
-            output->prepare(args, latchedLayers);
-        }
+    if (args.parallelizeOutputPrepare && args.outputs.size() > 1) {
+        prepareOutputsInParallel(args);
+    } else {
+        prepareOutputs(args);
     }
+    args.layerFESnapshot = nullptr;
 
     updateLayerStateFromFE(args);
 
+    if (args.batchOutputPresents && args.outputs.size() > 1) {
+        presentOutputsBatched(args);
+    } else {
+        presentOutputs(args);
+    }
+
     for (const auto& output : args.outputs) {
-        output->present(args);
+        // Changes skipped by an output limiting its frame rate are composed on
+        // a later refresh, which has to be scheduled as nothing else may.
+        if (output->getState().frameDeferred) {
+            mNeedsAnotherUpdate = true;
+        }
+    }
+}
+
+void CompositionEngine::presentOutputs(CompositionRefreshArgs& args) {
+    for (size_t i = 0; i < args.outputs.size(); i++) {
+        mOutputTimings[i].presentStart = systemTime(SYSTEM_TIME_MONOTONIC);
+        args.outputs[i]->present(args);
+        mOutputTimings[i].presentEnd = systemTime(SYSTEM_TIME_MONOTONIC);
+    }
+}
+
+void CompositionEngine::presentOutputsBatched(CompositionRefreshArgs& args) {
+    ATRACE_CALL();
+
+    std::vector<bool> composed(args.outputs.size());
+    std::vector<DisplayId> displayIds;
+    for (size_t i = 0; i < args.outputs.size(); i++) {
+        mOutputTimings[i].presentStart = systemTime(SYSTEM_TIME_MONOTONIC);
+        composed[i] = args.outputs[i]->composeFrame(args);
+        if (composed[i] && args.outputs[i]->getState().isEnabled) {
+            if (const auto id = args.outputs[i]->getDisplayId()) {
+                displayIds.push_back(*id);
+            }
+        }
+    }
+
+    // The outputs which are not presented by the HWC, or could not be batched, present
+    // themselves when posting their frame.
+    getHwComposer().presentDisplays(displayIds);
+
+    for (size_t i = 0; i < args.outputs.size(); i++) {
+        if (composed[i]) {
+            args.outputs[i]->postFramebuffer();
+        }
+        mOutputTimings[i].presentEnd = systemTime(SYSTEM_TIME_MONOTONIC);
+    }
+}
+
+void CompositionEngine::prepareOutputs(CompositionRefreshArgs& args) {
+    // latchedLayers is used to track the set of front-end layer state that
+    // has been latched across all outputs for the prepare step, and is not
+    // needed for anything else.
+    LayerFESet latchedLayers;
+    if (args.snapshotLayerFEState) {
+        latchBasicGeometry(args, latchedLayers);
+    }
+
+    for (size_t i = 0; i < args.outputs.size(); i++) {
+        mOutputTimings[i].prepareStart = systemTime(SYSTEM_TIME_MONOTONIC);
+        args.outputs[i]->prepare(args, latchedLayers);
+        mOutputTimings[i].prepareEnd = systemTime(SYSTEM_TIME_MONOTONIC);
+    }
+}
+
+void CompositionEngine::prepareOutputsInParallel(CompositionRefreshArgs& args) {
+    ATRACE_CALL();
+
+    // Latch the basic geometry of every candidate layer up front, so that the
+    // set is only read while the outputs are being prepared concurrently.
+    LayerFESet latchedLayers;
+    latchBasicGeometry(args, latchedLayers);
+
+    std::vector<OutputWorkerPool::Task> tasks;
+    tasks.reserve(args.outputs.size());
+    for (size_t i = 0; i < args.outputs.size(); i++) {
+        tasks.emplace_back([this, i, &args, &latchedLayers]() {
+            mOutputTimings[i].prepareStart = systemTime(SYSTEM_TIME_MONOTONIC);
+            args.outputs[i]->prepare(args, latchedLayers);
+            mOutputTimings[i].prepareEnd = systemTime(SYSTEM_TIME_MONOTONIC);
+        });
+    }
+    mOutputWorkerPool.runAll(tasks);
+}
+
+void CompositionEngine::latchBasicGeometry(CompositionRefreshArgs& args,
+                                           LayerFESet& latchedLayers) {
+    if (!args.updatingOutputGeometryThisFrame) {
+        return;
+    }
+
+    for (const auto& layerFE : args.layers) {
+        if (latchedLayers.insert(layerFE).second) {
+            layerFE->prepareCompositionState(LayerFE::StateSubset::BasicGeometry);
+        }
+    }
+
+    if (args.snapshotLayerFEState) {
+        ATRACE_NAME("buildLayerFESnapshot");
+        mLayerFESnapshot.build(args.layers);
+        args.layerFESnapshot = &mLayerFESnapshot;
     }
 }
 
@@ -144,14 +249,33 @@ void CompositionEngine::preComposition(CompositionRefreshArgs& args) {
     mNeedsAnotherUpdate = needsAnotherUpdate;
 }
 
-void CompositionEngine::dump(std::string&) const {
-    // The base class has no state to dump, but derived classes might.
+void CompositionEngine::dump(std::string& out) const {
+    using android::base::StringAppendF;
+
+    out.append("CompositionEngine last frame output timings (us, relative to refresh start):\n");
+    for (const auto& timing : mOutputTimings) {
+        const auto toUs = [this](nsecs_t time) {
+            return time ? ns2us(time - mRefreshStartTime) : int64_t(0);
+        };
+        StringAppendF(&out,
+                      "  %-32s prepare=[%" PRId64 ", %" PRId64 "] (%" PRId64
+                      ") present=[%" PRId64 ", %" PRId64 "] (%" PRId64 ")\n",
+                      timing.name.c_str(), toUs(timing.prepareStart), toUs(timing.prepareEnd),
+                      ns2us(timing.prepareEnd - timing.prepareStart), toUs(timing.presentStart),
+                      toUs(timing.presentEnd), ns2us(timing.presentEnd - timing.presentStart));
+    }
+    out.append("\n");
 }
 
 void CompositionEngine::setNeedsAnotherUpdateForTest(bool value) {
     mNeedsAnotherUpdate = value;
 }
 
+const std::vector<CompositionEngine::OutputTiming>&
+CompositionEngine::getLastFrameOutputTimingsForTest() const {
+    return mOutputTimings;
+}
+
 void CompositionEngine::updateLayerStateFromFE(CompositionRefreshArgs& args) {
     // Update the composition state from each front-end layer
     for (const auto& output : args.outputs) {
@@ -32,26 +32,56 @@ HwcBufferCache::HwcBufferCache() {
     std::fill(std::begin(mBuffers), std::end(mBuffers), wp<GraphicBuffer>(nullptr));
 }
 
+bool HwcBufferCache::isValidSlot(int slot) {
+    return slot != BufferQueue::INVALID_BUFFER_SLOT && slot >= 0 &&
+            slot < BufferQueue::NUM_BUFFER_SLOTS;
+}
+
+uint32_t HwcBufferCache::findSlotForBuffer(const sp<GraphicBuffer>& buffer) const {
+    uint32_t leastRecentlyUsed = 0;
+    for (uint32_t slot = 0; slot < BufferQueue::NUM_BUFFER_SLOTS; slot++) {
+        if (mBufferIds[slot] == buffer->getId() && mBuffers[slot] == wp<GraphicBuffer>(buffer)) {
+            return slot;
+        }
+        if (mLastUsed[slot] < mLastUsed[leastRecentlyUsed]) {
+            leastRecentlyUsed = slot;
+        }
+    }
+    return leastRecentlyUsed;
+}
+
 void HwcBufferCache::getHwcBuffer(int slot, const sp<GraphicBuffer>& buffer, uint32_t* outSlot,
                                   sp<GraphicBuffer>* outBuffer) {
-    // default is 0
-    if (slot == BufferQueue::INVALID_BUFFER_SLOT || slot < 0 ||
-        slot >= BufferQueue::NUM_BUFFER_SLOTS) {
-        *outSlot = 0;
-    } else {
+    if (isValidSlot(slot)) {
         *outSlot = static_cast<uint32_t>(slot);
+    } else if (buffer != nullptr) {
+        *outSlot = findSlotForBuffer(buffer);
+    } else {
+        // default is 0
+        *outSlot = 0;
     }
 
     auto& currentBuffer = mBuffers[*outSlot];
+    mLastUsed[*outSlot] = ++mCounter;
     wp<GraphicBuffer> weakCopy(buffer);
     if (currentBuffer == weakCopy) {
         // already cached in HWC, skip sending the buffer
         *outBuffer = nullptr;
+        if (buffer != nullptr) {
+            mStats.hits++;
+        }
     } else {
         *outBuffer = buffer;
+        if (buffer != nullptr) {
+            mStats.misses++;
+            if (currentBuffer.promote() != nullptr) {
+                mStats.evictions++;
+            }
+        }
 
         // update cache
         currentBuffer = buffer;
+        mBufferIds[*outSlot] = buffer != nullptr ? buffer->getId() : 0;
     }
 }
 
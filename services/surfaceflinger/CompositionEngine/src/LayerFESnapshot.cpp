@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <cmath>
+
+#include <compositionengine/LayerFECompositionState.h>
+#include <compositionengine/LayerFESnapshot.h>
+#include <compositionengine/Output.h>
+
+namespace android::compositionengine {
+
+void LayerFESnapshot::build(const std::vector<sp<LayerFE>>& layers) {
+    clear();
+    mLayerStackIds.reserve(layers.size());
+    mFlags.reserve(layers.size());
+
+    for (const auto& layerFE : layers) {
+        const auto* state = layerFE->getCompositionState();
+        uint32_t layerStackId = 0;
+        uint8_t flags = 0;
+
+        if (state) {
+            if (state->layerStackId) {
+                layerStackId = *state->layerStackId;
+                flags |= kHasLayerStack;
+            }
+            if (state->internalOnly) {
+                flags |= kInternalOnly;
+            }
+            if (state->isVisible) {
+                flags |= kVisible;
+            }
+
+            // This must match the footprint computed by ensureOutputLayerIfVisible()
+            Rect footprint(state->geomLayerTransform.transform(state->geomLayerBounds));
+            if (state->shadowRadius > 0.0f) {
+                const auto inset = static_cast<int32_t>(ceilf(state->shadowRadius) * -1.0f);
+                footprint.inset(inset, inset, inset, inset);
+            }
+            if (!footprint.isEmpty()) {
+                flags |= kHasFootprint;
+            }
+        }
+
+        mLayerStackIds.push_back(layerStackId);
+        mFlags.push_back(flags);
+    }
+}
+
+void LayerFESnapshot::clear() {
+    mLayerStackIds.clear();
+    mFlags.clear();
+}
+
+bool LayerFESnapshot::mayBeVisibleOn(size_t index, const Output& output) const {
+    const uint8_t flags = mFlags[index];
+    if ((flags & (kVisible | kHasFootprint)) != (kVisible | kHasFootprint)) {
+        return false;
+    }
+    // Layers without a layer stack never belong to an output
+    if ((flags & kHasLayerStack) == 0) {
+        return false;
+    }
+    return output.belongsInOutput(mLayerStackIds[index], (flags & kInternalOnly) != 0);
+}
+
+} // namespace android::compositionengine
@@ -0,0 +1,349 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <compositionengine/DisplayColorProfile.h>
+#include <compositionengine/LayerFECompositionState.h>
+#include <compositionengine/Output.h>
+#include <compositionengine/OutputLayer.h>
+#include <compositionengine/RenderSurface.h>
+#include <compositionengine/impl/LayerFlattener.h>
+#include <compositionengine/impl/OutputCompositionState.h>
+#include <compositionengine/impl/OutputLayerCompositionState.h>
+#include <renderengine/RenderEngine.h>
+#include <utils/Trace.h>
+
+#include "TimeStats/TimeStats.h"
+
+namespace android::compositionengine::impl {
+
+namespace {
+
+// The smallest number of layers worth flattening.
+constexpr size_t kMinFlattenedLayers = 2;
+
+bool isHdrDataspace(ui::Dataspace dataspace) {
+    const auto transfer = static_cast<ui::Dataspace>(static_cast<int32_t>(dataspace) &
+                                                     static_cast<int32_t>(
+                                                             ui::Dataspace::TRANSFER_MASK));
+    return transfer == ui::Dataspace::TRANSFER_ST2084 || transfer == ui::Dataspace::TRANSFER_HLG;
+}
+
+} // namespace
+
+bool LayerFlattener::LayerSnapshot::operator==(const LayerSnapshot& other) const {
+    return layerFE == other.layerFE && buffer == other.buffer &&
+            acquireFence == other.acquireFence && color == other.color && alpha == other.alpha &&
+            blendMode == other.blendMode && compositionType == other.compositionType &&
+            displayFrame == other.displayFrame && sourceCrop == other.sourceCrop &&
+            bufferTransform == other.bufferTransform && dataspace == other.dataspace &&
+            visibleRegion.hasSameRects(other.visibleRegion) && cacheable == other.cacheable;
+}
+
+LayerFlattener::LayerFlattener(renderengine::RenderEngine& renderEngine, TimeStats& timeStats,
+                               uint32_t minStableFrames)
+      : mRenderEngine(renderEngine), mTimeStats(timeStats), mMinStableFrames(minStableFrames) {
+    mRenderEngine.genTextures(1, &mTextureName);
+}
+
+LayerFlattener::~LayerFlattener() {
+    if (mRun) {
+        dropRun();
+    }
+    for (const uint64_t bufferId : mReleasedBufferIds) {
+        mRenderEngine.unbindExternalTextureBuffer(bufferId);
+    }
+    mRenderEngine.deleteTextures(1, &mTextureName);
+}
+
+void LayerFlattener::flatten(const compositionengine::Output& output) {
+    ATRACE_CALL();
+
+    // Buffers dropped on the last frame may still have been drawn by it.
+    for (const uint64_t bufferId : mReleasedBufferIds) {
+        mRenderEngine.unbindExternalTextureBuffer(bufferId);
+    }
+    mReleasedBufferIds.clear();
+
+    clearOverrides(output);
+
+    std::vector<LayerSnapshot> snapshots;
+    std::vector<uint32_t> stableFrames;
+    snapshots.reserve(output.getOutputLayerCount());
+    stableFrames.reserve(output.getOutputLayerCount());
+    for (const auto* layer : output.getOutputLayersOrderedByZ()) {
+        const size_t index = snapshots.size();
+        LayerSnapshot snapshot = getSnapshot(*layer);
+        const bool unchanged = index < mSnapshots.size() && mSnapshots[index] == snapshot;
+        snapshots.push_back(std::move(snapshot));
+        stableFrames.push_back(unchanged ? mStableFrames[index] + 1 : 0);
+    }
+    mSnapshots = std::move(snapshots);
+    mStableFrames = std::move(stableFrames);
+
+    const bool canFlatten =
+            output.getRenderSurface() != nullptr && !isHdrDataspace(output.getState().dataspace);
+
+    if (mRun && (!canFlatten || !runIsUnchanged())) {
+        mTimeStats.incrementLayerFlatteningMisses();
+        dropRun();
+    }
+
+    if (!mRun && canFlatten) {
+        findRun();
+        if (mRun && !drawRun(output)) {
+            mRun.reset();
+        }
+    }
+
+    if (mRun) {
+        applyOverrides(output);
+        mStrategyCheckPending = true;
+    }
+}
+
+void LayerFlattener::onCompositionStrategyChosen(const compositionengine::Output& output) {
+    if (!mRun || !mStrategyCheckPending) {
+        return;
+    }
+    mStrategyCheckPending = false;
+
+    bool rejected = false;
+    for (size_t i = mRun->start; i < mRun->start + mRun->count; i++) {
+        rejected |= output.getOutputLayerOrderedByZByIndex(i)->requiresClientComposition();
+    }
+
+    if (rejected) {
+        // Wait for the layers to be stable again before retrying, since the
+        // HWC is likely to reject the same run right away.
+        for (size_t i = mRun->start; i < mRun->start + mRun->count; i++) {
+            mStableFrames[i] = 0;
+        }
+        mTimeStats.incrementLayerFlatteningMisses();
+        dropRun();
+        return;
+    }
+
+    if (!mRun->isNew) {
+        mTimeStats.incrementLayerFlatteningHits();
+    }
+    mRun->isNew = false;
+}
+
+LayerFE::LayerSettings LayerFlattener::getOverrideLayerSettings(
+        const compositionengine::Output& output, const compositionengine::OutputLayer& layer) const {
+    const auto& outputState = output.getState();
+    const auto& overrideInfo = layer.getState().overrideInfo;
+    const ui::Size size = output.getRenderSurface()->getSize();
+
+    // The buffer covers the whole output in physical display space, and is
+    // transparent outside of the flattened layers.
+    LayerFE::LayerSettings settings;
+    settings.geometry.boundaries =
+            FloatRect(0.f, 0.f, static_cast<float>(size.width), static_cast<float>(size.height));
+    settings.geometry.positionTransform = outputState.transform.inverse().asMatrix4();
+    settings.source.buffer.buffer = overrideInfo.buffer;
+    settings.source.buffer.fence = overrideInfo.acquireFence;
+    settings.source.buffer.textureName = mTextureName;
+    settings.source.buffer.usePremultipliedAlpha = true;
+    settings.sourceDataspace = overrideInfo.dataspace;
+    settings.alpha = 1.0f;
+    settings.bufferId = overrideInfo.buffer->getId();
+    return settings;
+}
+
+void LayerFlattener::clearOverrides(const compositionengine::Output& output) {
+    for (auto* layer : output.getOutputLayersOrderedByZ()) {
+        layer->editState().overrideInfo = {};
+    }
+}
+
+LayerFlattener::LayerSnapshot LayerFlattener::getSnapshot(
+        const compositionengine::OutputLayer& layer) {
+    LayerSnapshot snapshot;
+    snapshot.layerFE = &layer.getLayerFE();
+
+    const auto* layerFEState = layer.getLayerFE().getCompositionState();
+    if (!layerFEState) {
+        return snapshot;
+    }
+
+    const auto& state = layer.getState();
+    snapshot.buffer = layerFEState->buffer;
+    snapshot.acquireFence = layerFEState->acquireFence;
+    snapshot.color = layerFEState->color;
+    snapshot.alpha = layerFEState->alpha;
+    snapshot.blendMode = layerFEState->blendMode;
+    snapshot.compositionType = layerFEState->compositionType;
+    snapshot.displayFrame = state.displayFrame;
+    snapshot.sourceCrop = state.sourceCrop;
+    snapshot.bufferTransform = state.bufferTransform;
+    snapshot.dataspace = state.dataspace;
+    snapshot.visibleRegion = state.outputSpaceVisibleRegion;
+
+    // Only layers which could otherwise be presented by the HWC are flattened,
+    // and HDR and protected content is never copied into the flattened buffer.
+    const bool isDeviceComposited = layerFEState->compositionType == hal::Composition::DEVICE ||
+            layerFEState->compositionType == hal::Composition::SOLID_COLOR;
+    snapshot.cacheable = state.hwc && !state.forceClientComposition && isDeviceComposited &&
+            !layerFEState->hasProtectedContent && layerFEState->backgroundBlurRadius == 0 &&
+            !isHdrDataspace(state.dataspace);
+    return snapshot;
+}
+
+bool LayerFlattener::runIsUnchanged() const {
+    if (mRun->start + mRun->count > mStableFrames.size()) {
+        return false;
+    }
+    for (size_t i = mRun->start; i < mRun->start + mRun->count; i++) {
+        if (mStableFrames[i] == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void LayerFlattener::findRun() {
+    size_t bestStart = 0;
+    size_t bestCount = 0;
+    size_t start = 0;
+    for (size_t i = 0; i <= mSnapshots.size(); i++) {
+        const bool eligible = i < mSnapshots.size() && mSnapshots[i].cacheable &&
+                mStableFrames[i] >= mMinStableFrames;
+        if (eligible) {
+            continue;
+        }
+        if (i - start > bestCount) {
+            bestStart = start;
+            bestCount = i - start;
+        }
+        start = i + 1;
+    }
+
+    if (bestCount >= kMinFlattenedLayers) {
+        mRun = FlattenedRun{};
+        mRun->start = bestStart;
+        mRun->count = bestCount;
+    }
+}
+
+bool LayerFlattener::drawRun(const compositionengine::Output& output) {
+    ATRACE_CALL();
+
+    const auto& outputState = output.getState();
+    const ui::Size size = output.getRenderSurface()->getSize();
+    sp<GraphicBuffer> buffer =
+            new GraphicBuffer(static_cast<uint32_t>(size.width),
+                              static_cast<uint32_t>(size.height), HAL_PIXEL_FORMAT_RGBA_8888, 1,
+                              GRALLOC_USAGE_HW_RENDER | GRALLOC_USAGE_HW_COMPOSER |
+                                      GRALLOC_USAGE_HW_TEXTURE,
+                              "LayerFlattener");
+    if (buffer->initCheck() != NO_ERROR) {
+        ALOGE("Failed to allocate a buffer for flattening layers");
+        return false;
+    }
+
+    // The layers are drawn as they would be by client composition, except for
+    // the color transform, as the HWC applies it to the flattened buffer.
+    renderengine::DisplaySettings display;
+    display.physicalDisplay = outputState.destinationClip;
+    display.clip = outputState.sourceClip;
+    display.orientation = outputState.orientation;
+    display.outputDataspace = output.getDisplayColorProfile()->hasWideColorGamut()
+            ? outputState.dataspace
+            : ui::Dataspace::UNKNOWN;
+    display.maxLuminance =
+            output.getDisplayColorProfile()->getHdrCapabilities().getDesiredMaxLuminance();
+
+    const Region viewportRegion(outputState.viewport);
+    Region dummyRegion;
+    std::vector<LayerFE::LayerSettings> layerSettings;
+    Region displayFrames;
+    Region visibleRegion;
+    for (size_t i = mRun->start; i < mRun->start + mRun->count; i++) {
+        auto* layer = output.getOutputLayerOrderedByZByIndex(i);
+        const auto& layerState = layer->getState();
+
+        const Region clip(viewportRegion.intersect(layerState.visibleRegion));
+        const bool realContentIsVisible =
+                !layerState.visibleRegion.subtract(layerState.shadowRegion).isEmpty();
+        compositionengine::LayerFE::ClientCompositionTargetSettings targetSettings{
+                clip,
+                false, /* useIdentityTransform */
+                layer->needsFiltering() || outputState.needsFiltering,
+                outputState.isSecure,
+                false, /* supportsProtectedContent */
+                dummyRegion,
+                outputState.viewport,
+                display.outputDataspace,
+                realContentIsVisible,
+                false, /* clearContent */
+        };
+        std::vector<LayerFE::LayerSettings> results =
+                layer->getLayerFE().prepareClientCompositionList(targetSettings);
+        layerSettings.insert(layerSettings.end(), std::make_move_iterator(results.begin()),
+                             std::make_move_iterator(results.end()));
+
+        displayFrames.orSelf(layerState.displayFrame);
+        visibleRegion.orSelf(layerState.outputSpaceVisibleRegion);
+    }
+
+    std::vector<const renderengine::LayerSettings*> layerPointers;
+    layerPointers.reserve(layerSettings.size());
+    for (const auto& settings : layerSettings) {
+        layerPointers.push_back(&settings);
+    }
+
+    base::unique_fd drawFence;
+    const status_t status =
+            mRenderEngine.drawLayers(display, layerPointers, buffer->getNativeBuffer(),
+                                     /*useFramebufferCache=*/false, base::unique_fd(),
+                                     &drawFence);
+    if (status != NO_ERROR) {
+        ALOGE("Failed to draw flattened layers: %d", status);
+        return false;
+    }
+
+    mRun->buffer = std::move(buffer);
+    mRun->drawFence =
+            drawFence.get() >= 0 ? sp<Fence>(new Fence(drawFence.release())) : Fence::NO_FENCE;
+    mRun->displayFrame = displayFrames.getBounds();
+    mRun->visibleRegion = std::move(visibleRegion);
+    return true;
+}
+
+void LayerFlattener::applyOverrides(const compositionengine::Output& output) const {
+    const auto& outputState = output.getState();
+    for (size_t i = mRun->start; i < mRun->start + mRun->count; i++) {
+        auto& overrideInfo = output.getOutputLayerOrderedByZByIndex(i)->editState().overrideInfo;
+        if (i != mRun->start) {
+            overrideInfo.skip = true;
+            continue;
+        }
+        overrideInfo.buffer = mRun->buffer;
+        overrideInfo.acquireFence = mRun->drawFence;
+        overrideInfo.displayFrame = mRun->displayFrame;
+        overrideInfo.dataspace = outputState.dataspace;
+        overrideInfo.visibleRegion = mRun->visibleRegion;
+        overrideInfo.surfaceDamage = mRun->isNew ? Region(mRun->displayFrame) : Region();
+    }
+}
+
+void LayerFlattener::dropRun() {
+    mReleasedBufferIds.push_back(mRun->buffer->getId());
+    mRun.reset();
+}
+
+} // namespace android::compositionengine::impl
@@ -22,6 +22,7 @@
 #include <compositionengine/DisplayColorProfile.h>
 #include <compositionengine/LayerFE.h>
 #include <compositionengine/LayerFECompositionState.h>
+#include <compositionengine/LayerFESnapshot.h>
 #include <compositionengine/RenderSurface.h>
 #include <compositionengine/impl/Output.h>
 #include <compositionengine/impl/OutputCompositionState.h>
@@ -52,21 +53,21 @@ namespace impl {
 
 namespace {
 
-template <typename T>
-class Reversed {
-public:
-    explicit Reversed(const T& container) : mContainer(container) {}
-    auto begin() { return mContainer.rbegin(); }
-    auto end() { return mContainer.rend(); }
-
-private:
-    const T& mContainer;
-};
-
-// Helper for enumerating over a container in reverse order
-template <typename T>
-Reversed<T> reversed(const T& c) {
-    return Reversed<T>(c);
+// The number of distinct layer stacks whose client composition results are
+// kept. Each entry holds a buffer the size of the output.
+constexpr size_t kMaxCachedClientCompositionResults = 2;
+
+bool visibilityInputsMatch(const OutputLayerCompositionState::VisibilityCache& cache,
+                           const LayerFECompositionState& layerFEState,
+                           const OutputCompositionState& outputState) {
+    return cache.geomLayerTransform == layerFEState.geomLayerTransform &&
+            cache.geomLayerBounds == layerFEState.geomLayerBounds &&
+            cache.shadowRadius == layerFEState.shadowRadius &&
+            cache.isOpaque == layerFEState.isOpaque &&
+            cache.transparentRegionHint.hasSameRects(layerFEState.transparentRegionHint) &&
+            cache.outputTransform == outputState.transform &&
+            cache.outputBounds == outputState.bounds &&
+            cache.outputViewport == outputState.viewport;
 }
 
 } // namespace
@@ -137,6 +138,12 @@ void Output::setLayerStackFilter(uint32_t layerStackId, bool isInternal) {
     dirtyEntireOutput();
 }
 
+void Output::setMaxFrameRate(float frameRate) {
+    auto& outputState = editState();
+    outputState.minFramePeriod = frameRate > 0.0f ? static_cast<nsecs_t>(1e9f / frameRate) : 0;
+    outputState.nextFrameTime = 0;
+}
+
 void Output::setColorTransform(const compositionengine::CompositionRefreshArgs& args) {
     auto& colorTransformMatrix = editState().colorTransformMatrix;
     if (!args.colorTransformMatrix || colorTransformMatrix == args.colorTransformMatrix) {
@@ -308,14 +315,95 @@ void Output::present(const compositionengine::CompositionRefreshArgs& refreshArg
     ATRACE_CALL();
     ALOGV(__FUNCTION__);
 
+    if (composeFrame(refreshArgs)) {
+        postFramebuffer();
+    }
+}
+
+bool Output::composeFrame(const compositionengine::CompositionRefreshArgs& refreshArgs) {
+    ATRACE_CALL();
+    ALOGV(__FUNCTION__);
+
     updateColorProfile(refreshArgs);
+    if (isIdle(refreshArgs)) {
+        ATRACE_NAME("isIdle");
+        return false;
+    }
+    if (skipFrameForMaxFrameRate(refreshArgs)) {
+        setColorTransform(refreshArgs);
+        return false;
+    }
     updateAndWriteCompositionState(refreshArgs);
     setColorTransform(refreshArgs);
     beginFrame();
     prepareFrame();
     devOptRepaintFlash(refreshArgs);
     finishFrame(refreshArgs);
-    postFramebuffer();
+    return true;
+}
+
+bool Output::skipFrameForMaxFrameRate(const compositionengine::CompositionRefreshArgs& refreshArgs) {
+    auto& outputState = editState();
+    if (outputState.minFramePeriod == 0 || !outputState.isEnabled) {
+        return false;
+    }
+
+    // Refreshes start on vsync, give or take some scheduling jitter, so a
+    // refresh slightly before the next frame time still composes the output.
+    constexpr nsecs_t kFrameTimeTolerance = 2'000'000;
+    const nsecs_t now = getCompositionEngine().getLastFrameRefreshTimestamp();
+    if (now + kFrameTimeTolerance < outputState.nextFrameTime) {
+        ATRACE_NAME("skipFrameForMaxFrameRate");
+        if (refreshArgs.repaintEverything) {
+            dirtyEntireOutput();
+        }
+        outputState.geometryUpdatePending |= refreshArgs.updatingGeometryThisFrame;
+        outputState.frameDeferred =
+                outputState.geometryUpdatePending || !outputState.dirtyRegion.isEmpty();
+
+        // The layers removed from the output were last shown by a frame which
+        // was already presented.
+        for (auto& weakLayer : mReleasedLayers) {
+            if (auto layer = weakLayer.promote(); layer != nullptr) {
+                layer->onLayerDisplayed(Fence::NO_FENCE);
+            }
+        }
+        mReleasedLayers.clear();
+        return true;
+    }
+
+    // Keep the frame times on the period so the average rate matches it,
+    // unless the output was idle for longer than that.
+    const nsecs_t period = outputState.minFramePeriod;
+    outputState.nextFrameTime = now - outputState.nextFrameTime < period
+            ? outputState.nextFrameTime + period
+            : now + period;
+    outputState.frameDeferred = false;
+    return false;
+}
+
+bool Output::isIdle(const compositionengine::CompositionRefreshArgs& refreshArgs) const {
+    const auto& outputState = getState();
+    if (!refreshArgs.skipIdleOutputs || refreshArgs.timingOutput == this ||
+        !outputState.isEnabled) {
+        return false;
+    }
+
+    // Color profile changes dirty the entire output, and the layers removed
+    // from the output still need to be released by a composition.
+    if (refreshArgs.repaintEverything || refreshArgs.updatingGeometryThisFrame ||
+        refreshArgs.colorTransformMatrix || outputState.geometryUpdatePending ||
+        outputState.frameDeferred || !outputState.dirtyRegion.isEmpty() ||
+        !mReleasedLayers.empty()) {
+        return false;
+    }
+
+    for (const auto& layerFE : refreshArgs.layersWithQueuedFrames) {
+        if (getOutputLayerForLayer(layerFE) != nullptr) {
+            return false;
+        }
+    }
+    return true;
 }
 
 void Output::rebuildLayerStacks(const compositionengine::CompositionRefreshArgs& refreshArgs,
@@ -332,6 +420,7 @@ void Output::rebuildLayerStacks(const compositionengine::CompositionRefreshArgs&
 
     // Process the layers to determine visibility and coverage
     compositionengine::Output::CoverageState coverage{layerFESet};
+    coverage.reuseCachedVisibility = refreshArgs.incrementalVisibleRegions;
     collectVisibleLayers(refreshArgs, coverage);
 
     // Compute the resulting coverage for this output, and store it for later
@@ -345,11 +434,22 @@ void Output::rebuildLayerStacks(const compositionengine::CompositionRefreshArgs&
 
 void Output::collectVisibleLayers(const compositionengine::CompositionRefreshArgs& refreshArgs,
                                   compositionengine::Output::CoverageState& coverage) {
+    const auto* snapshot = refreshArgs.layerFESnapshot;
+    if (snapshot && snapshot->size() != refreshArgs.layers.size()) {
+        snapshot = nullptr;
+    }
+
     // Evaluate the layers from front to back to determine what is visible. This
     // also incrementally calculates the coverage information for each layer as
     // well as the entire output.
-    for (auto layer : reversed(refreshArgs.layers)) {
+    for (size_t i = refreshArgs.layers.size(); i-- > 0;) {
+        // Skip the layers which cannot be on this output without looking at them
+        if (snapshot && !snapshot->mayBeVisibleOn(i, *this)) {
+            continue;
+        }
+
         // Incrementally process the coverage for each layer
+        auto layer = refreshArgs.layers[i];
         ensureOutputLayerIfVisible(layer, coverage);
 
         // TODO(b/121291683): Stop early if the output is completely covered and
@@ -433,15 +533,23 @@ void Output::ensureOutputLayerIfVisible(sp<compositionengine::LayerFE>& layerFE,
     // TODO(b/121291683): Is it worth creating helper methods on LayerFEState
     // for computations like this?
     const Rect visibleRect(tr.transform(layerFEState->geomLayerBounds));
-    visibleRegion.set(visibleRect);
 
+    // footprint: the visible rect of the layer, including any shadow it casts
+    Rect footprint(visibleRect);
     if (layerFEState->shadowRadius > 0.0f) {
-        // if the layer casts a shadow, offset the layers visible region and
-        // calculate the shadow region.
         const auto inset = static_cast<int32_t>(ceilf(layerFEState->shadowRadius) * -1.0f);
-        Rect visibleRectWithShadows(visibleRect);
-        visibleRectWithShadows.inset(inset, inset, inset, inset);
-        visibleRegion.set(visibleRectWithShadows);
+        footprint.inset(inset, inset, inset, inset);
+    }
+
+    if (coverage.reuseCachedVisibility &&
+        ensureOutputLayerFromVisibilityCache(layerFE, *layerFEState, footprint, coverage)) {
+        return;
+    }
+
+    visibleRegion.set(footprint);
+
+    if (layerFEState->shadowRadius > 0.0f) {
+        // if the layer casts a shadow, calculate the shadow region.
         shadowRegion = visibleRegion.subtract(visibleRect);
     }
 
@@ -529,6 +637,13 @@ void Output::ensureOutputLayerIfVisible(sp<compositionengine::LayerFE>& layerFE,
     // accumulate to the screen dirty region
     coverage.dirtyRegion.orSelf(dirty);
 
+    // Capture the opaque coverage above this layer before adding its own, in
+    // case the results need to be cached.
+    Region aboveOpaqueLayers;
+    if (coverage.reuseCachedVisibility) {
+        aboveOpaqueLayers = coverage.aboveOpaqueLayers.intersect(footprint);
+    }
+
     // Update accumAboveOpaqueLayers for next (lower) layer
     coverage.aboveOpaqueLayers.orSelf(opaqueRegion);
 
@@ -559,6 +674,64 @@ void Output::ensureOutputLayerIfVisible(sp<compositionengine::LayerFE>& layerFE,
     outputLayerState.outputSpaceVisibleRegion =
             outputState.transform.transform(visibleNonShadowRegion.intersect(outputState.viewport));
     outputLayerState.shadowRegion = shadowRegion;
+
+    if (coverage.reuseCachedVisibility) {
+        outputLayerState.visibilityCache = OutputLayerCompositionState::VisibilityCache{
+                .geomLayerTransform = layerFEState->geomLayerTransform,
+                .geomLayerBounds = layerFEState->geomLayerBounds,
+                .transparentRegionHint = layerFEState->transparentRegionHint,
+                .shadowRadius = layerFEState->shadowRadius,
+                .isOpaque = layerFEState->isOpaque,
+                .outputTransform = outputState.transform,
+                .outputBounds = outputState.bounds,
+                .outputViewport = outputState.viewport,
+                .aboveOpaqueLayers = std::move(aboveOpaqueLayers),
+                .opaqueRegion = opaqueRegion,
+        };
+    } else {
+        outputLayerState.visibilityCache.reset();
+    }
+}
+
+bool Output::ensureOutputLayerFromVisibilityCache(
+        sp<compositionengine::LayerFE>& layerFE, const LayerFECompositionState& layerFEState,
+        const Rect& footprint, compositionengine::Output::CoverageState& coverage) {
+    // Only a layer which was visible on the last frame has anything to reuse
+    const auto prevOutputLayerIndex = findCurrentOutputLayerForLayer(layerFE);
+    if (!prevOutputLayerIndex) {
+        return false;
+    }
+    const auto& prevState = getOutputLayerOrderedByZByIndex(*prevOutputLayerIndex)->getState();
+    const auto& cache = prevState.visibilityCache;
+    if (!cache || !visibilityInputsMatch(*cache, layerFEState, getState())) {
+        return false;
+    }
+
+    // The visibility of the layer only depends on the coverage above it within
+    // its own footprint, so changes elsewhere on the output do not matter.
+    const Region coveredRegion = coverage.aboveCoveredLayers.intersect(footprint);
+    if (!coveredRegion.hasSameRects(prevState.coveredRegion)) {
+        return false;
+    }
+    const Region aboveOpaqueLayers = coverage.aboveOpaqueLayers.intersect(footprint);
+    if (!aboveOpaqueLayers.hasSameRects(cache->aboveOpaqueLayers)) {
+        return false;
+    }
+
+    // All the inputs are the same as on the last frame, so the visible and
+    // covered regions are too. The dirty region computation in
+    // ensureOutputLayerIfVisible() then reduces to the following.
+    Region dirty = layerFEState.contentDirty
+            ? prevState.visibleRegion
+            : prevState.visibleRegion.intersect(prevState.coveredRegion);
+    dirty.subtractSelf(coverage.aboveOpaqueLayers);
+    coverage.dirtyRegion.orSelf(dirty);
+
+    coverage.aboveCoveredLayers.orSelf(footprint);
+    coverage.aboveOpaqueLayers.orSelf(cache->opaqueRegion);
+
+    ensureOutputLayer(prevOutputLayerIndex, layerFE);
+    return true;
 }
 
 void Output::setReleasedLayers(const compositionengine::CompositionRefreshArgs&) {
@@ -582,11 +755,16 @@ void Output::updateAndWriteCompositionState(
         return;
     }
 
+    // Geometry changes from refreshes skipped for the output are written now.
+    const bool updatingGeometry =
+            refreshArgs.updatingGeometryThisFrame || getState().geometryUpdatePending;
+    editState().geometryUpdatePending = false;
+
     mLayerRequestingBackgroundBlur = findLayerRequestingBackgroundComposition();
     bool forceClientComposition = mLayerRequestingBackgroundBlur != nullptr;
 
     for (auto* layer : getOutputLayersOrderedByZ()) {
-        layer->updateCompositionState(refreshArgs.updatingGeometryThisFrame,
+        layer->updateCompositionState(updatingGeometry,
                                       refreshArgs.devOptForceClientComposition ||
                                               forceClientComposition,
                                       refreshArgs.internalDisplayRotationFlags);
@@ -594,9 +772,24 @@ void Output::updateAndWriteCompositionState(
         if (mLayerRequestingBackgroundBlur == layer) {
             forceClientComposition = false;
         }
+    }
+
+    if (refreshArgs.layerFlatteningThreshold > 0) {
+        if (!mLayerFlattener) {
+            mLayerFlattener =
+                    std::make_unique<LayerFlattener>(getCompositionEngine().getRenderEngine(),
+                                                     getCompositionEngine().getTimeStats(),
+                                                     refreshArgs.layerFlatteningThreshold);
+        }
+        mLayerFlattener->flatten(*this);
+    } else if (mLayerFlattener) {
+        LayerFlattener::clearOverrides(*this);
+        mLayerFlattener.reset();
+    }
 
+    for (auto* layer : getOutputLayersOrderedByZ()) {
         // Send the updated state to the HWC, if appropriate.
-        layer->writeStateToHWC(refreshArgs.updatingGeometryThisFrame);
+        layer->writeStateToHWC(updatingGeometry);
     }
 }
 
@@ -760,6 +953,10 @@ void Output::prepareFrame() {
 
     chooseCompositionStrategy();
 
+    if (mLayerFlattener) {
+        mLayerFlattener->onCompositionStrategyChosen(*this);
+    }
+
     mRenderSurface->prepareFrame(outputState.usesClientComposition,
                                  outputState.usesDeviceComposition);
 }
@@ -837,6 +1034,12 @@ std::optional<base::unique_fd> Output::composeSurfaces(
         }
     }
 
+    if (refreshArgs.partialClientComposition) {
+        Region frameDamage = getDirtyRegion(refreshArgs.repaintEverything);
+        frameDamage.orSelf(debugRegion);
+        mRenderSurface->addFrameDamage(outputState.transform.transform(frameDamage));
+    }
+
     base::unique_fd fd;
     sp<GraphicBuffer> buf;
 
@@ -886,6 +1089,14 @@ std::optional<base::unique_fd> Output::composeSurfaces(
                                               clientCompositionDisplay.outputDataspace);
     appendRegionFlashRequests(debugRegion, clientCompositionLayers);
 
+    // The dirty region does not cover layers switching between client and
+    // device composition, nor changes to the display settings, so in that case
+    // the whole buffer needs to be redrawn.
+    if (refreshArgs.partialClientComposition &&
+        updateClientCompositionStructure(clientCompositionDisplay)) {
+        mRenderSurface->addFrameDamage(Region(Rect(mRenderSurface->getSize())));
+    }
+
     // Check if the client composition requests were rendered into the provided graphic buffer. If
     // so, we can reuse the buffer and avoid client composition.
     if (mClientCompositionRequestCache) {
@@ -899,6 +1110,22 @@ std::optional<base::unique_fd> Output::composeSurfaces(
                                             clientCompositionLayers);
     }
 
+    // Set after the cache lookup, as the cached requests are valid for the
+    // buffer no matter which part of it they were redrawn for.
+    if (refreshArgs.partialClientComposition) {
+        clientCompositionDisplay.damageRegion = mRenderSurface->getBufferDamage();
+    }
+
+    if (refreshArgs.cacheClientCompositionResults) {
+        if (!mClientCompositionResultCache) {
+            mClientCompositionResultCache = std::make_unique<
+                    ClientCompositionResultCache>(renderEngine, kMaxCachedClientCompositionResults);
+        }
+        mClientCompositionResultCache->apply(clientCompositionDisplay, clientCompositionLayers);
+    } else {
+        mClientCompositionResultCache.reset();
+    }
+
     // We boost GPU frequency here because there will be color spaces conversion
     // or complex GPU shaders and it's expensive. We boost the GPU frequency so that
     // GPU composition can finish in time. We must reset GPU frequency afterwards,
@@ -967,6 +1194,14 @@ std::vector<LayerFE::LayerSettings> Output::generateClientCompositionRequests(
             continue;
         }
 
+        // The content of a skipped layer is in the buffer presented by the
+        // first layer of its flattened run.
+        if (layerState.overrideInfo.skip) {
+            ALOGV("  Skipping for being flattened");
+            firstLayer = false;
+            continue;
+        }
+
         const bool clientComposition = layer->requiresClientComposition();
 
         // We clear the client target for non-client composed layers if
@@ -997,8 +1232,12 @@ std::vector<LayerFE::LayerSettings> Output::generateClientCompositionRequests(
                     realContentIsVisible,
                     !clientComposition, /* clearContent  */
             };
-            std::vector<LayerFE::LayerSettings> results =
-                    layerFE.prepareClientCompositionList(targetSettings);
+            std::vector<LayerFE::LayerSettings> results;
+            if (clientComposition && layerState.overrideInfo.buffer && mLayerFlattener) {
+                results.push_back(mLayerFlattener->getOverrideLayerSettings(*this, *layer));
+            } else {
+                results = layerFE.prepareClientCompositionList(targetSettings);
+            }
             if (realContentIsVisible && !results.empty()) {
                 layer->editState().clientCompositionTimestamp = systemTime();
             }
@@ -1091,6 +1330,22 @@ void Output::postFramebuffer() {
     mReleasedLayers.clear();
 }
 
+bool Output::updateClientCompositionStructure(const renderengine::DisplaySettings& display) {
+    std::vector<std::pair<const compositionengine::OutputLayer*, bool>> layers;
+    for (auto* layer : getOutputLayersOrderedByZ()) {
+        const bool clientComposition = layer->requiresClientComposition();
+        if (clientComposition || layer->getState().clearClientTarget) {
+            layers.emplace_back(layer, clientComposition);
+        }
+    }
+
+    const bool changed =
+            layers != mLastClientCompositionLayers || !(display == mLastClientCompositionDisplay);
+    mLastClientCompositionLayers = std::move(layers);
+    mLastClientCompositionDisplay = display;
+    return changed;
+}
+
 void Output::dirtyEntireOutput() {
     auto& outputState = editState();
     outputState.dirtyRegion.set(outputState.bounds);
@@ -31,6 +31,9 @@ void OutputCompositionState::dump(std::string& out) const {
 
     dumpVal(out, "layerStack", layerStackId);
     dumpVal(out, "layerStackInternal", layerStackInternal);
+    dumpVal(out, "maxFrameRate",
+            minFramePeriod > 0 ? 1e9f / static_cast<float>(minFramePeriod) : 0.0f);
+    dumpVal(out, "frameDeferred", frameDeferred);
 
     out.append("\n   ");
 
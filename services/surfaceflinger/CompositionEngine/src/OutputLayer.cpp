@@ -334,9 +334,24 @@ void OutputLayer::writeStateToHWC(bool includeGeometry) {
 
     auto requestedCompositionType = outputIndependentState->compositionType;
 
+    // Starting or stopping being part of a flattened run of layers replaces all
+    // the geometry the HWC has for the layer.
+    const auto& overrideInfo = state.overrideInfo;
+    const bool isOverridden = overrideInfo.buffer != nullptr || overrideInfo.skip;
+    if (state.hwc->overridden != isOverridden) {
+        editState().hwc->overridden = isOverridden;
+        includeGeometry = true;
+    }
+
+    if (overrideInfo.buffer) {
+        writeOverrideStateToHWC(hwcLayer.get());
+        return;
+    }
+
     if (includeGeometry) {
         writeOutputDependentGeometryStateToHWC(hwcLayer.get(), requestedCompositionType);
-        writeOutputIndependentGeometryStateToHWC(hwcLayer.get(), *outputIndependentState);
+        writeOutputIndependentGeometryStateToHWC(hwcLayer.get(), *outputIndependentState,
+                                                 overrideInfo.skip);
     }
 
     writeOutputDependentPerFrameStateToHWC(hwcLayer.get());
@@ -396,7 +411,8 @@ void OutputLayer::writeOutputDependentGeometryStateToHWC(
 }
 
 void OutputLayer::writeOutputIndependentGeometryStateToHWC(
-        HWC2::Layer* hwcLayer, const LayerFECompositionState& outputIndependentState) {
+        HWC2::Layer* hwcLayer, const LayerFECompositionState& outputIndependentState,
+        bool skipLayer) {
     if (auto error = hwcLayer->setBlendMode(outputIndependentState.blendMode);
         error != hal::Error::NONE) {
         ALOGE("[%s] Failed to set blend mode %s: %s (%d)", getLayerFE().getDebugName(),
@@ -404,10 +420,12 @@ void OutputLayer::writeOutputIndependentGeometryStateToHWC(
               static_cast<int32_t>(error));
     }
 
-    if (auto error = hwcLayer->setPlaneAlpha(outputIndependentState.alpha);
-        error != hal::Error::NONE) {
-        ALOGE("[%s] Failed to set plane alpha %.3f: %s (%d)", getLayerFE().getDebugName(),
-              outputIndependentState.alpha, to_string(error).c_str(), static_cast<int32_t>(error));
+    // A skipped layer is drawn in the buffer of a flattened run, so it is made
+    // fully transparent, which the HWC can drop.
+    const float alpha = skipLayer ? 0.0f : outputIndependentState.alpha;
+    if (auto error = hwcLayer->setPlaneAlpha(alpha); error != hal::Error::NONE) {
+        ALOGE("[%s] Failed to set plane alpha %.3f: %s (%d)", getLayerFE().getDebugName(), alpha,
+              to_string(error).c_str(), static_cast<int32_t>(error));
     }
 
     if (auto error = hwcLayer->setInfo(static_cast<uint32_t>(outputIndependentState.type),
@@ -539,6 +557,90 @@ void OutputLayer::writeBufferStateToHWC(HWC2::Layer* hwcLayer,
     }
 }
 
+void OutputLayer::writeOverrideStateToHWC(HWC2::Layer* hwcLayer) {
+    const auto& state = getState();
+    const auto& overrideInfo = state.overrideInfo;
+
+    if (auto error = hwcLayer->setDisplayFrame(overrideInfo.displayFrame);
+        error != hal::Error::NONE) {
+        ALOGE("[%s] Failed to set override display frame [%d, %d, %d, %d]: %s (%d)",
+              getLayerFE().getDebugName(), overrideInfo.displayFrame.left,
+              overrideInfo.displayFrame.top, overrideInfo.displayFrame.right,
+              overrideInfo.displayFrame.bottom, to_string(error).c_str(),
+              static_cast<int32_t>(error));
+    }
+
+    if (auto error = hwcLayer->setSourceCrop(overrideInfo.displayFrame.toFloatRect());
+        error != hal::Error::NONE) {
+        ALOGE("[%s] Failed to set override source crop: %s (%d)", getLayerFE().getDebugName(),
+              to_string(error).c_str(), static_cast<int32_t>(error));
+    }
+
+    if (auto error = hwcLayer->setZOrder(state.z); error != hal::Error::NONE) {
+        ALOGE("[%s] Failed to set Z %u: %s (%d)", getLayerFE().getDebugName(), state.z,
+              to_string(error).c_str(), static_cast<int32_t>(error));
+    }
+
+    // The flattened buffer is already in output space, with the layer color
+    // transforms applied.
+    if (auto error = hwcLayer->setTransform(static_cast<hal::Transform>(0));
+        error != hal::Error::NONE) {
+        ALOGE("[%s] Failed to set override transform: %s (%d)", getLayerFE().getDebugName(),
+              to_string(error).c_str(), static_cast<int32_t>(error));
+    }
+
+    if (auto error = hwcLayer->setBlendMode(hal::BlendMode::PREMULTIPLIED);
+        error != hal::Error::NONE) {
+        ALOGE("[%s] Failed to set override blend mode: %s (%d)", getLayerFE().getDebugName(),
+              to_string(error).c_str(), static_cast<int32_t>(error));
+    }
+
+    if (auto error = hwcLayer->setPlaneAlpha(1.0f); error != hal::Error::NONE) {
+        ALOGE("[%s] Failed to set override plane alpha: %s (%d)", getLayerFE().getDebugName(),
+              to_string(error).c_str(), static_cast<int32_t>(error));
+    }
+
+    if (auto error = hwcLayer->setVisibleRegion(overrideInfo.visibleRegion);
+        error != hal::Error::NONE) {
+        ALOGE("[%s] Failed to set override visible region: %s (%d)", getLayerFE().getDebugName(),
+              to_string(error).c_str(), static_cast<int32_t>(error));
+    }
+
+    if (auto error = hwcLayer->setDataspace(overrideInfo.dataspace); error != hal::Error::NONE) {
+        ALOGE("[%s] Failed to set override dataspace %d: %s (%d)", getLayerFE().getDebugName(),
+              overrideInfo.dataspace, to_string(error).c_str(), static_cast<int32_t>(error));
+    }
+
+    switch (auto error = hwcLayer->setColorTransform(mat4())) {
+        case hal::Error::NONE:
+        case hal::Error::UNSUPPORTED:
+            break;
+        default:
+            ALOGE("[%s] Failed to set override color transform: %s (%d)",
+                  getLayerFE().getDebugName(), to_string(error).c_str(),
+                  static_cast<int32_t>(error));
+    }
+
+    if (auto error = hwcLayer->setSurfaceDamage(overrideInfo.surfaceDamage);
+        error != hal::Error::NONE) {
+        ALOGE("[%s] Failed to set override surface damage: %s (%d)", getLayerFE().getDebugName(),
+              to_string(error).c_str(), static_cast<int32_t>(error));
+    }
+
+    uint32_t hwcSlot = 0;
+    sp<GraphicBuffer> hwcBuffer;
+    editState().hwc->hwcBufferCache.getHwcBuffer(BufferQueue::INVALID_BUFFER_SLOT,
+                                                 overrideInfo.buffer, &hwcSlot, &hwcBuffer);
+
+    if (auto error = hwcLayer->setBuffer(hwcSlot, hwcBuffer, overrideInfo.acquireFence);
+        error != hal::Error::NONE) {
+        ALOGE("[%s] Failed to set override buffer %p: %s (%d)", getLayerFE().getDebugName(),
+              overrideInfo.buffer->handle, to_string(error).c_str(), static_cast<int32_t>(error));
+    }
+
+    writeCompositionTypeToHWC(hwcLayer, hal::Composition::DEVICE);
+}
+
 void OutputLayer::writeCompositionTypeToHWC(HWC2::Layer* hwcLayer,
                                             hal::Composition requestedCompositionType) {
     auto& outputDependentState = editState();
@@ -40,6 +40,11 @@ void dumpHwc(const OutputLayerCompositionState::Hwc& hwc, std::string& out) {
     }
 
     dumpVal(out, "composition", toString(hwc.hwcCompositionType), hwc.hwcCompositionType);
+
+    const auto& cacheStats = hwc.hwcBufferCache.getStats();
+    dumpVal(out, "bufferCacheHits", cacheStats.hits);
+    dumpVal(out, "bufferCacheMisses", cacheStats.misses);
+    dumpVal(out, "bufferCacheEvictions", cacheStats.evictions);
 }
 
 } // namespace
@@ -69,6 +74,15 @@ void OutputLayerCompositionState::dump(std::string& out) const {
     dumpVal(out, "dataspace", toString(dataspace), dataspace);
     dumpVal(out, "z-index", z);
 
+    if (overrideInfo.buffer) {
+        out.append("\n      override: ");
+        dumpHex(out, "buffer", overrideInfo.buffer->getId());
+        dumpVal(out, "displayFrame", overrideInfo.displayFrame);
+        dumpVal(out, "dataspace", toString(overrideInfo.dataspace), overrideInfo.dataspace);
+    } else if (overrideInfo.skip) {
+        out.append("\n      override: skipped");
+    }
+
     if (hwc) {
         dumpHwc(*hwc, out);
     }
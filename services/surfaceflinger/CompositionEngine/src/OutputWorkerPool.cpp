@@ -0,0 +1,115 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <compositionengine/impl/OutputWorkerPool.h>
+
+#include <pthread.h>
+
+#include <algorithm>
+
+namespace android::compositionengine::impl {
+
+OutputWorkerPool::OutputWorkerPool(size_t maxThreads) : mMaxThreads(maxThreads) {}
+
+OutputWorkerPool::~OutputWorkerPool() {
+    std::vector<std::thread> threads;
+    {
+        std::lock_guard lock(mMutex);
+        mExiting = true;
+        threads = std::move(mThreads);
+    }
+    mWorkAvailable.notify_all();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+void OutputWorkerPool::runAll(std::vector<Task>& tasks) {
+    if (tasks.empty()) {
+        return;
+    }
+
+    {
+        std::lock_guard lock(mMutex);
+        ensureThreads(std::min(tasks.size() - 1, mMaxThreads));
+        // If there are no workers available, everything runs inline below.
+        if (!mThreads.empty()) {
+            for (size_t i = 1; i < tasks.size(); i++) {
+                mPending.push_back(&tasks[i]);
+            }
+            mOutstanding += tasks.size() - 1;
+        }
+    }
+    mWorkAvailable.notify_all();
+
+    tasks[0]();
+
+    std::unique_lock lock(mMutex);
+    if (mThreads.empty()) {
+        lock.unlock();
+        for (size_t i = 1; i < tasks.size(); i++) {
+            tasks[i]();
+        }
+        return;
+    }
+
+    // Help drain the queue rather than sitting idle while the workers run.
+    while (!mPending.empty()) {
+        Task* task = mPending.front();
+        mPending.pop_front();
+        lock.unlock();
+        (*task)();
+        lock.lock();
+        mOutstanding--;
+    }
+    mWorkDone.wait(lock, [this]() REQUIRES(mMutex) { return mOutstanding == 0; });
+}
+
+size_t OutputWorkerPool::getThreadCountForTest() const {
+    std::lock_guard lock(mMutex);
+    return mThreads.size();
+}
+
+void OutputWorkerPool::ensureThreads(size_t count) {
+    while (mThreads.size() < count) {
+        mThreads.emplace_back(&OutputWorkerPool::threadMain, this);
+    }
+}
+
+void OutputWorkerPool::threadMain() {
+    pthread_setname_np(pthread_self(), "OutputWorker");
+
+    std::unique_lock lock(mMutex);
+    while (true) {
+        mWorkAvailable.wait(lock, [this]() REQUIRES(mMutex) {
+            return mExiting || !mPending.empty();
+        });
+        if (mExiting) {
+            return;
+        }
+
+        Task* task = mPending.front();
+        mPending.pop_front();
+        lock.unlock();
+        (*task)();
+        lock.lock();
+        if (--mOutstanding == 0) {
+            mWorkDone.notify_all();
+        }
+    }
+}
+
+} // namespace android::compositionengine::impl
@@ -97,6 +97,7 @@ void RenderSurface::setDisplaySize(const ui::Size& size) {
     mDisplaySurface->resizeBuffers(static_cast<uint32_t>(size.width),
                                    static_cast<uint32_t>(size.height));
     mSize = size;
+    mQueuedFrames.clear();
 }
 
 void RenderSurface::setBufferDataspace(ui::Dataspace dataspace) {
@@ -106,6 +107,7 @@ void RenderSurface::setBufferDataspace(ui::Dataspace dataspace) {
 
 void RenderSurface::setBufferPixelFormat(ui::PixelFormat pixelFormat) {
     native_window_set_buffers_format(mNativeWindow.get(), static_cast<int32_t>(pixelFormat));
+    mQueuedFrames.clear();
 }
 
 void RenderSurface::setProtected(bool useProtected) {
@@ -117,6 +119,7 @@ void RenderSurface::setProtected(bool useProtected) {
     ALOGE_IF(status != NO_ERROR, "Unable to set BQ usage bits for protected content: %d", status);
     if (status == NO_ERROR) {
         mProtected = useProtected;
+        mQueuedFrames.clear();
     }
 }
 
@@ -205,6 +208,12 @@ void RenderSurface::queueBuffer(base::unique_fd readyFence) {
                     mNativeWindow->cancelBuffer(mNativeWindow.get(),
                                                 mGraphicBuffer->getNativeBuffer(), dup(readyFence));
                 }
+            } else {
+                mQueuedFrames.push_front({mFrameDamage, state.usesClientComposition});
+                if (mQueuedFrames.size() > kMaxTrackedBufferAge) {
+                    mQueuedFrames.pop_back();
+                }
+                mFrameDamage.clear();
             }
 
             mGraphicBuffer = nullptr;
@@ -217,6 +226,30 @@ void RenderSurface::queueBuffer(base::unique_fd readyFence) {
     }
 }
 
+void RenderSurface::addFrameDamage(const Region& damage) {
+    mFrameDamage.orSelf(damage);
+}
+
+Region RenderSurface::getBufferDamage() const {
+    const Region fullDamage(Rect(mSize));
+
+    // The buffer age is the number of frames queued since the buffer was last
+    // queued, or 0 if its content is undefined.
+    int age = 0;
+    if (mGraphicBuffer == nullptr ||
+        mNativeWindow->query(mNativeWindow.get(), NATIVE_WINDOW_BUFFER_AGE, &age) != NO_ERROR ||
+        age <= 0 || static_cast<size_t>(age) > mQueuedFrames.size() ||
+        !mQueuedFrames[age - 1].drawn) {
+        return fullDamage;
+    }
+
+    Region damage(mFrameDamage);
+    for (int i = 0; i < age - 1; i++) {
+        damage.orSelf(mQueuedFrames[i].damage);
+    }
+    return damage.intersect(fullDamage);
+}
+
 void RenderSurface::onPresentDisplayCompleted() {
     mDisplaySurface->onFrameCommitted();
 }
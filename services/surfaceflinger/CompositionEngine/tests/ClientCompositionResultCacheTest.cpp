@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <compositionengine/impl/ClientCompositionResultCache.h>
+#include <gtest/gtest.h>
+#include <renderengine/mock/RenderEngine.h>
+
+namespace android::compositionengine {
+namespace {
+
+using testing::_;
+using testing::AnyNumber;
+using testing::Return;
+using testing::SetArgPointee;
+using testing::StrictMock;
+
+using impl::ClientCompositionResultCache;
+
+constexpr uint32_t kTextureName = 7u;
+constexpr size_t kMaxEntries = 2;
+
+class ClientCompositionResultCacheTest : public testing::Test {
+public:
+    ClientCompositionResultCacheTest() {
+        EXPECT_CALL(mRenderEngine, genTextures(1, _)).WillOnce(SetArgPointee<1>(kTextureName));
+        EXPECT_CALL(mRenderEngine, isProtected()).WillRepeatedly(Return(false));
+        mCache = std::make_unique<ClientCompositionResultCache>(mRenderEngine, kMaxEntries);
+
+        mDisplay.physicalDisplay = Rect(100, 200);
+        mDisplay.clip = Rect(100, 200);
+    }
+
+    ~ClientCompositionResultCacheTest() override {
+        EXPECT_CALL(mRenderEngine, unbindExternalTextureBuffer(_)).Times(AnyNumber());
+        EXPECT_CALL(mRenderEngine, deleteTextures(1, _)).Times(1);
+        mCache.reset();
+    }
+
+    static LayerFE::LayerSettings makeColorLayer(float red) {
+        LayerFE::LayerSettings settings;
+        settings.geometry.boundaries = FloatRect(0.f, 0.f, 100.f, 200.f);
+        settings.source.solidColor = half3(red, 0.f, 0.f);
+        settings.alpha = 1.f;
+        return settings;
+    }
+
+    // Returns a request whose bottom two layers are always the same, and
+    // whose top layer changes every frame.
+    std::vector<LayerFE::LayerSettings> makeRequest() {
+        return {makeColorLayer(0.25f), makeColorLayer(0.5f),
+                makeColorLayer(static_cast<float>(mFrame++) / 100.f)};
+    }
+
+    void expectDrawLayers(size_t layerCount) {
+        EXPECT_CALL(mRenderEngine, drawLayers(_, _, _, false, _, _))
+                .WillOnce([layerCount](const renderengine::DisplaySettings&,
+                                       const std::vector<const renderengine::LayerSettings*>& layers,
+                                       ANativeWindowBuffer*, bool, base::unique_fd&&,
+                                       base::unique_fd*) -> status_t {
+                    EXPECT_EQ(layerCount, layers.size());
+                    return NO_ERROR;
+                });
+    }
+
+    StrictMock<renderengine::mock::RenderEngine> mRenderEngine;
+    std::unique_ptr<ClientCompositionResultCache> mCache;
+    renderengine::DisplaySettings mDisplay;
+    uint32_t mFrame = 0;
+};
+
+TEST_F(ClientCompositionResultCacheTest, doesNotReplaceLayersUntilStable) {
+    for (uint32_t i = 0; i < ClientCompositionResultCache::kMinStableFrames; i++) {
+        auto layers = makeRequest();
+        mCache->apply(mDisplay, layers);
+        EXPECT_EQ(3u, layers.size());
+    }
+    EXPECT_EQ(0u, mCache->getEntryCountForTest());
+}
+
+TEST_F(ClientCompositionResultCacheTest, replacesStableBottomLayers) {
+    for (uint32_t i = 0; i < ClientCompositionResultCache::kMinStableFrames; i++) {
+        auto layers = makeRequest();
+        mCache->apply(mDisplay, layers);
+    }
+
+    expectDrawLayers(2u);
+    auto layers = makeRequest();
+    const auto topLayer = layers.back();
+    mCache->apply(mDisplay, layers);
+
+    ASSERT_EQ(2u, layers.size());
+    EXPECT_NE(nullptr, layers[0].source.buffer.buffer);
+    EXPECT_EQ(kTextureName, layers[0].source.buffer.textureName);
+    EXPECT_TRUE(layers[0].disableBlending);
+    EXPECT_EQ(topLayer.source.solidColor, layers[1].source.solidColor);
+    EXPECT_EQ(1u, mCache->getEntryCountForTest());
+}
+
+TEST_F(ClientCompositionResultCacheTest, reusesCachedResult) {
+    for (uint32_t i = 0; i < ClientCompositionResultCache::kMinStableFrames; i++) {
+        auto layers = makeRequest();
+        mCache->apply(mDisplay, layers);
+    }
+
+    expectDrawLayers(2u);
+    auto first = makeRequest();
+    mCache->apply(mDisplay, first);
+    ASSERT_EQ(2u, first.size());
+
+    // Only the previous drawLayers call is expected.
+    auto second = makeRequest();
+    mCache->apply(mDisplay, second);
+    ASSERT_EQ(2u, second.size());
+    EXPECT_EQ(first[0].bufferId, second[0].bufferId);
+    EXPECT_EQ(first[0].frameNumber, second[0].frameNumber);
+    EXPECT_EQ(1u, mCache->getEntryCountForTest());
+}
+
+TEST_F(ClientCompositionResultCacheTest, changedBottomLayerIsNotReplaced) {
+    for (uint32_t i = 0; i < ClientCompositionResultCache::kMinStableFrames; i++) {
+        auto layers = makeRequest();
+        mCache->apply(mDisplay, layers);
+    }
+
+    expectDrawLayers(2u);
+    auto layers = makeRequest();
+    mCache->apply(mDisplay, layers);
+    ASSERT_EQ(2u, layers.size());
+
+    layers = makeRequest();
+    layers[0] = makeColorLayer(0.75f);
+    mCache->apply(mDisplay, layers);
+    EXPECT_EQ(3u, layers.size());
+}
+
+TEST_F(ClientCompositionResultCacheTest, doesNotCacheWithColorTransform) {
+    mDisplay.colorTransform = mat4::scale(vec4(0.5f, 0.5f, 0.5f, 1.f));
+    for (uint32_t i = 0; i <= ClientCompositionResultCache::kMinStableFrames; i++) {
+        auto layers = makeRequest();
+        mCache->apply(mDisplay, layers);
+        EXPECT_EQ(3u, layers.size());
+    }
+    EXPECT_EQ(0u, mCache->getEntryCountForTest());
+}
+
+} // namespace
+} // namespace android::compositionengine
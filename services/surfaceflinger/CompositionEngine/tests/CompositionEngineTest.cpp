@@ -49,6 +49,10 @@ struct CompositionEngineTest : public testing::Test {
     std::shared_ptr<mock::Output> mOutput1{std::make_shared<StrictMock<mock::Output>>()};
     std::shared_ptr<mock::Output> mOutput2{std::make_shared<StrictMock<mock::Output>>()};
     std::shared_ptr<mock::Output> mOutput3{std::make_shared<StrictMock<mock::Output>>()};
+
+    const std::string mOutput1Name{"Output1"};
+    const std::string mOutput2Name{"Output2"};
+    const std::string mOutput3Name{"Output3"};
 };
 
 TEST_F(CompositionEngineTest, canInstantiateCompositionEngine) {
@@ -85,7 +89,17 @@ struct CompositionEnginePresentTest : public CompositionEngineTest {
         MOCK_METHOD1(preComposition, void(CompositionRefreshArgs&));
     };
 
+    CompositionEnginePresentTest() {
+        EXPECT_CALL(*mOutput1, getName()).WillRepeatedly(ReturnRef(mOutput1Name));
+        EXPECT_CALL(*mOutput2, getName()).WillRepeatedly(ReturnRef(mOutput2Name));
+        EXPECT_CALL(*mOutput3, getName()).WillRepeatedly(ReturnRef(mOutput3Name));
+        EXPECT_CALL(*mOutput1, getState()).WillRepeatedly(ReturnRef(mOutputState));
+        EXPECT_CALL(*mOutput2, getState()).WillRepeatedly(ReturnRef(mOutputState));
+        EXPECT_CALL(*mOutput3, getState()).WillRepeatedly(ReturnRef(mOutputState));
+    }
+
     StrictMock<CompositionEnginePartialMock> mEngine;
+    impl::OutputCompositionState mOutputState;
 };
 
 TEST_F(CompositionEnginePresentTest, worksWithEmptyRequest) {
@@ -122,6 +136,132 @@ TEST_F(CompositionEnginePresentTest, worksAsExpected) {
     mEngine.present(mRefreshArgs);
 }
 
+TEST_F(CompositionEnginePresentTest, preparesOutputsInParallelIfRequested) {
+    sp<StrictMock<mock::LayerFE>> layer1FE{new StrictMock<mock::LayerFE>()};
+    sp<StrictMock<mock::LayerFE>> layer2FE{new StrictMock<mock::LayerFE>()};
+
+    EXPECT_CALL(mEngine, preComposition(Ref(mRefreshArgs)));
+
+    // The basic geometry is latched once per layer before the outputs are
+    // prepared, and every output sees the same set of latched layers.
+    EXPECT_CALL(*layer1FE, prepareCompositionState(LayerFE::StateSubset::BasicGeometry));
+    EXPECT_CALL(*layer2FE, prepareCompositionState(LayerFE::StateSubset::BasicGeometry));
+
+    LayerFESet* output1LatchedLayers = nullptr;
+    LayerFESet* output2LatchedLayers = nullptr;
+    EXPECT_CALL(*mOutput1, prepare(Ref(mRefreshArgs), _))
+            .WillOnce(testing::WithArg<1>([&](LayerFESet& latched) {
+                EXPECT_EQ(2u, latched.size());
+                output1LatchedLayers = &latched;
+            }));
+    EXPECT_CALL(*mOutput2, prepare(Ref(mRefreshArgs), _))
+            .WillOnce(testing::WithArg<1>([&](LayerFESet& latched) {
+                EXPECT_EQ(2u, latched.size());
+                output2LatchedLayers = &latched;
+            }));
+
+    EXPECT_CALL(*mOutput1, updateLayerStateFromFE(Ref(mRefreshArgs)));
+    EXPECT_CALL(*mOutput2, updateLayerStateFromFE(Ref(mRefreshArgs)));
+
+    {
+        InSequence seq;
+        EXPECT_CALL(*mOutput1, present(Ref(mRefreshArgs)));
+        EXPECT_CALL(*mOutput2, present(Ref(mRefreshArgs)));
+    }
+
+    mRefreshArgs.outputs = {mOutput1, mOutput2};
+    mRefreshArgs.layers = {layer1FE, layer2FE};
+    mRefreshArgs.updatingOutputGeometryThisFrame = true;
+    mRefreshArgs.parallelizeOutputPrepare = true;
+    mEngine.present(mRefreshArgs);
+
+    EXPECT_NE(nullptr, output1LatchedLayers);
+    EXPECT_EQ(output1LatchedLayers, output2LatchedLayers);
+}
+
+TEST_F(CompositionEnginePresentTest, snapshotsLayerStateForOutputsIfRequested) {
+    sp<StrictMock<mock::LayerFE>> layerFE{new StrictMock<mock::LayerFE>()};
+    LayerFECompositionState layerFEState;
+
+    EXPECT_CALL(mEngine, preComposition(Ref(mRefreshArgs)));
+    EXPECT_CALL(*layerFE, prepareCompositionState(LayerFE::StateSubset::BasicGeometry));
+    EXPECT_CALL(*layerFE, getCompositionState()).WillOnce(Return(&layerFEState));
+
+    // The snapshot is only available while the outputs are being prepared.
+    EXPECT_CALL(*mOutput1, prepare(Ref(mRefreshArgs), _))
+            .WillOnce(testing::WithArg<0>([](const CompositionRefreshArgs& args) {
+                ASSERT_NE(nullptr, args.layerFESnapshot);
+                EXPECT_EQ(1u, args.layerFESnapshot->size());
+            }));
+    EXPECT_CALL(*mOutput1, updateLayerStateFromFE(Ref(mRefreshArgs)))
+            .WillOnce(testing::Invoke([](const CompositionRefreshArgs& args) {
+                EXPECT_EQ(nullptr, args.layerFESnapshot);
+            }));
+    EXPECT_CALL(*mOutput1, present(Ref(mRefreshArgs)));
+
+    mRefreshArgs.outputs = {mOutput1};
+    mRefreshArgs.layers = {layerFE};
+    mRefreshArgs.updatingOutputGeometryThisFrame = true;
+    mRefreshArgs.snapshotLayerFEState = true;
+    mEngine.present(mRefreshArgs);
+}
+
+TEST_F(CompositionEnginePresentTest, batchesOutputPresentsIfRequested) {
+    constexpr DisplayId kDisplayId1 = DisplayId{42};
+    constexpr DisplayId kDisplayId2 = DisplayId{43};
+    mEngine.setHwComposer(std::unique_ptr<android::HWComposer>(mHwc));
+    mOutputState.isEnabled = true;
+
+    EXPECT_CALL(mEngine, preComposition(Ref(mRefreshArgs)));
+    EXPECT_CALL(*mOutput1, prepare(Ref(mRefreshArgs), _));
+    EXPECT_CALL(*mOutput2, prepare(Ref(mRefreshArgs), _));
+    EXPECT_CALL(*mOutput3, prepare(Ref(mRefreshArgs), _));
+    EXPECT_CALL(*mOutput1, updateLayerStateFromFE(Ref(mRefreshArgs)));
+    EXPECT_CALL(*mOutput2, updateLayerStateFromFE(Ref(mRefreshArgs)));
+    EXPECT_CALL(*mOutput3, updateLayerStateFromFE(Ref(mRefreshArgs)));
+    EXPECT_CALL(*mOutput1, getDisplayId()).WillRepeatedly(Return(kDisplayId1));
+    EXPECT_CALL(*mOutput2, getDisplayId()).WillRepeatedly(Return(kDisplayId2));
+
+    {
+        // Every output is composed before any of them is presented. The third
+        // output is idle, so it has nothing to present.
+        InSequence seq;
+        EXPECT_CALL(*mOutput1, composeFrame(Ref(mRefreshArgs))).WillOnce(Return(true));
+        EXPECT_CALL(*mOutput2, composeFrame(Ref(mRefreshArgs))).WillOnce(Return(true));
+        EXPECT_CALL(*mOutput3, composeFrame(Ref(mRefreshArgs))).WillOnce(Return(false));
+        EXPECT_CALL(*mHwc, presentDisplays(std::vector<DisplayId>{kDisplayId1, kDisplayId2}));
+        EXPECT_CALL(*mOutput1, postFramebuffer());
+        EXPECT_CALL(*mOutput2, postFramebuffer());
+    }
+
+    mRefreshArgs.outputs = {mOutput1, mOutput2, mOutput3};
+    mRefreshArgs.batchOutputPresents = true;
+    mEngine.present(mRefreshArgs);
+}
+
+TEST_F(CompositionEnginePresentTest, recordsPerOutputTimings) {
+    EXPECT_CALL(mEngine, preComposition(Ref(mRefreshArgs)));
+    EXPECT_CALL(*mOutput1, prepare(Ref(mRefreshArgs), _));
+    EXPECT_CALL(*mOutput2, prepare(Ref(mRefreshArgs), _));
+    EXPECT_CALL(*mOutput1, updateLayerStateFromFE(Ref(mRefreshArgs)));
+    EXPECT_CALL(*mOutput2, updateLayerStateFromFE(Ref(mRefreshArgs)));
+    EXPECT_CALL(*mOutput1, present(Ref(mRefreshArgs)));
+    EXPECT_CALL(*mOutput2, present(Ref(mRefreshArgs)));
+
+    mRefreshArgs.outputs = {mOutput1, mOutput2};
+    mEngine.present(mRefreshArgs);
+
+    const auto& timings = mEngine.getLastFrameOutputTimingsForTest();
+    ASSERT_EQ(2u, timings.size());
+    EXPECT_EQ(mOutput1Name, timings[0].name);
+    EXPECT_EQ(mOutput2Name, timings[1].name);
+    for (const auto& timing : timings) {
+        EXPECT_LE(timing.prepareStart, timing.prepareEnd);
+        EXPECT_LE(timing.prepareEnd, timing.presentStart);
+        EXPECT_LE(timing.presentStart, timing.presentEnd);
+    }
+}
+
 /*
  * CompositionEngine::updateCursorAsync
  */
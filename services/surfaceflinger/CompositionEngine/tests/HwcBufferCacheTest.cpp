@@ -19,6 +19,8 @@
 #include <gui/BufferQueue.h>
 #include <ui/GraphicBuffer.h>
 
+#include <vector>
+
 namespace android::compositionengine {
 namespace {
 
@@ -78,8 +80,52 @@ TEST_F(HwcBufferCacheTest, cacheWorksForMaxSlot) {
     testSlot(BufferQueue::NUM_BUFFER_SLOTS - 1, BufferQueue::NUM_BUFFER_SLOTS - 1);
 }
 
-TEST_F(HwcBufferCacheTest, cacheMapsNegativeSlotToZero) {
-    testSlot(-123, 0);
+TEST_F(HwcBufferCacheTest, cacheFindsBuffersWithoutSlotById) {
+    uint32_t outSlot1;
+    uint32_t outSlot2;
+    sp<GraphicBuffer> outBuffer;
+
+    mCache.getHwcBuffer(BufferQueue::INVALID_BUFFER_SLOT, mBuffer1, &outSlot1, &outBuffer);
+    EXPECT_EQ(mBuffer1, outBuffer);
+
+    mCache.getHwcBuffer(BufferQueue::INVALID_BUFFER_SLOT, mBuffer2, &outSlot2, &outBuffer);
+    EXPECT_EQ(mBuffer2, outBuffer);
+    EXPECT_NE(outSlot1, outSlot2);
+
+    // Alternating between the two buffers no longer re-sends them.
+    uint32_t outSlot;
+    mCache.getHwcBuffer(-123, mBuffer1, &outSlot, &outBuffer);
+    EXPECT_EQ(outSlot1, outSlot);
+    EXPECT_EQ(nullptr, outBuffer.get());
+
+    mCache.getHwcBuffer(BufferQueue::INVALID_BUFFER_SLOT, mBuffer2, &outSlot, &outBuffer);
+    EXPECT_EQ(outSlot2, outSlot);
+    EXPECT_EQ(nullptr, outBuffer.get());
+
+    EXPECT_EQ(2u, mCache.getStats().hits);
+    EXPECT_EQ(2u, mCache.getStats().misses);
+    EXPECT_EQ(0u, mCache.getStats().evictions);
+}
+
+TEST_F(HwcBufferCacheTest, cacheEvictsLeastRecentlyUsedSlot) {
+    std::vector<sp<GraphicBuffer>> buffers;
+    uint32_t outSlot;
+    sp<GraphicBuffer> outBuffer;
+    for (int i = 0; i < BufferQueue::NUM_BUFFER_SLOTS; i++) {
+        buffers.push_back(new GraphicBuffer(1, 1, HAL_PIXEL_FORMAT_RGBA_8888, 1, 0));
+        mCache.getHwcBuffer(BufferQueue::INVALID_BUFFER_SLOT, buffers.back(), &outSlot,
+                            &outBuffer);
+        EXPECT_EQ(static_cast<uint32_t>(i), outSlot);
+    }
+
+    // Touch the oldest buffer, so the second one becomes least recently used.
+    mCache.getHwcBuffer(BufferQueue::INVALID_BUFFER_SLOT, buffers[0], &outSlot, &outBuffer);
+    EXPECT_EQ(0u, outSlot);
+
+    mCache.getHwcBuffer(BufferQueue::INVALID_BUFFER_SLOT, mBuffer1, &outSlot, &outBuffer);
+    EXPECT_EQ(1u, outSlot);
+    EXPECT_EQ(mBuffer1, outBuffer);
+    EXPECT_EQ(1u, mCache.getStats().evictions);
 }
 
 } // namespace
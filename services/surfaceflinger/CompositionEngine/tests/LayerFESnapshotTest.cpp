@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <compositionengine/LayerFECompositionState.h>
+#include <compositionengine/LayerFESnapshot.h>
+#include <compositionengine/mock/LayerFE.h>
+#include <compositionengine/mock/Output.h>
+#include <gtest/gtest.h>
+
+namespace android::compositionengine {
+namespace {
+
+using testing::_;
+using testing::Return;
+using testing::StrictMock;
+
+constexpr uint32_t kLayerStack = 123u;
+
+class LayerFESnapshotTest : public testing::Test {
+public:
+    LayerFESnapshotTest() {
+        mLayerFEState.layerStackId = kLayerStack;
+        mLayerFEState.isVisible = true;
+        mLayerFEState.geomLayerBounds = FloatRect{0, 0, 100, 200};
+        mLayerFEState.shadowRadius = 0.0f;
+        EXPECT_CALL(*mLayerFE, getCompositionState()).WillRepeatedly(Return(&mLayerFEState));
+    }
+
+    void build() { mSnapshot.build({mLayerFE}); }
+
+    LayerFECompositionState mLayerFEState;
+    sp<StrictMock<mock::LayerFE>> mLayerFE = new StrictMock<mock::LayerFE>();
+    StrictMock<mock::Output> mOutput;
+    LayerFESnapshot mSnapshot;
+};
+
+TEST_F(LayerFESnapshotTest, hasOneEntryPerLayer) {
+    sp<StrictMock<mock::LayerFE>> layerWithoutState = new StrictMock<mock::LayerFE>();
+    EXPECT_CALL(*layerWithoutState, getCompositionState()).WillOnce(Return(nullptr));
+
+    mSnapshot.build({mLayerFE, layerWithoutState});
+    EXPECT_EQ(2u, mSnapshot.size());
+
+    mSnapshot.clear();
+    EXPECT_EQ(0u, mSnapshot.size());
+}
+
+TEST_F(LayerFESnapshotTest, defersToOutputForVisibleLayer) {
+    mLayerFEState.internalOnly = true;
+    build();
+
+    EXPECT_CALL(mOutput, belongsInOutput(std::make_optional(kLayerStack), true))
+            .WillOnce(Return(true))
+            .WillOnce(Return(false));
+    EXPECT_TRUE(mSnapshot.mayBeVisibleOn(0, mOutput));
+    EXPECT_FALSE(mSnapshot.mayBeVisibleOn(0, mOutput));
+}
+
+TEST_F(LayerFESnapshotTest, rejectsLayerWithoutState) {
+    EXPECT_CALL(*mLayerFE, getCompositionState()).WillRepeatedly(Return(nullptr));
+    build();
+
+    EXPECT_FALSE(mSnapshot.mayBeVisibleOn(0, mOutput));
+}
+
+TEST_F(LayerFESnapshotTest, rejectsLayerWithoutLayerStack) {
+    mLayerFEState.layerStackId.reset();
+    build();
+
+    EXPECT_FALSE(mSnapshot.mayBeVisibleOn(0, mOutput));
+}
+
+TEST_F(LayerFESnapshotTest, rejectsHiddenLayer) {
+    mLayerFEState.isVisible = false;
+    build();
+
+    EXPECT_FALSE(mSnapshot.mayBeVisibleOn(0, mOutput));
+}
+
+TEST_F(LayerFESnapshotTest, rejectsLayerWithEmptyBounds) {
+    mLayerFEState.geomLayerBounds = FloatRect{0, 0, 0, 0};
+    build();
+
+    EXPECT_FALSE(mSnapshot.mayBeVisibleOn(0, mOutput));
+}
+
+TEST_F(LayerFESnapshotTest, keepsLayerWithEmptyBoundsCastingShadow) {
+    mLayerFEState.geomLayerBounds = FloatRect{10, 10, 10, 10};
+    mLayerFEState.shadowRadius = 5.0f;
+    build();
+
+    EXPECT_CALL(mOutput, belongsInOutput(std::make_optional(kLayerStack), false))
+            .WillOnce(Return(true));
+    EXPECT_TRUE(mSnapshot.mayBeVisibleOn(0, mOutput));
+}
+
+} // namespace
+} // namespace android::compositionengine
@@ -0,0 +1,217 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <compositionengine/LayerFECompositionState.h>
+#include <compositionengine/impl/LayerFlattener.h>
+#include <compositionengine/impl/OutputCompositionState.h>
+#include <compositionengine/impl/OutputLayerCompositionState.h>
+#include <compositionengine/mock/DisplayColorProfile.h>
+#include <compositionengine/mock/LayerFE.h>
+#include <compositionengine/mock/Output.h>
+#include <compositionengine/mock/OutputLayer.h>
+#include <compositionengine/mock/RenderSurface.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <renderengine/mock/RenderEngine.h>
+
+#include "TimeStats/TimeStats.h"
+
+namespace android::compositionengine {
+namespace {
+
+using testing::_;
+using testing::AnyNumber;
+using testing::HasSubstr;
+using testing::Return;
+using testing::ReturnRef;
+using testing::SetArgPointee;
+using testing::StrictMock;
+
+using impl::LayerFlattener;
+
+constexpr uint32_t kTextureName = 3u;
+constexpr uint32_t kMinStableFrames = 2;
+const ui::Size kOutputSize(100, 200);
+const Rect kOutputBounds(100, 200);
+
+struct TestLayer {
+    TestLayer() {
+        EXPECT_CALL(outputLayer, getLayerFE()).WillRepeatedly(ReturnRef(*layerFE.get()));
+        EXPECT_CALL(outputLayer, getState()).WillRepeatedly(ReturnRef(outputLayerState));
+        EXPECT_CALL(outputLayer, editState()).WillRepeatedly(ReturnRef(outputLayerState));
+        EXPECT_CALL(outputLayer, needsFiltering()).WillRepeatedly(Return(false));
+        EXPECT_CALL(outputLayer, requiresClientComposition()).WillRepeatedly(Return(false));
+        EXPECT_CALL(*layerFE, getCompositionState()).WillRepeatedly(Return(&layerFEState));
+        EXPECT_CALL(*layerFE, prepareClientCompositionList(_))
+                .WillRepeatedly(Return(std::vector<LayerFE::LayerSettings>{{}}));
+
+        layerFEState.compositionType = hal::Composition::DEVICE;
+        layerFEState.acquireFence = new Fence();
+        outputLayerState.displayFrame = kOutputBounds;
+        outputLayerState.visibleRegion = Region(kOutputBounds);
+        outputLayerState.outputSpaceVisibleRegion = Region(kOutputBounds);
+        outputLayerState.hwc = impl::OutputLayerCompositionState::Hwc(nullptr);
+    }
+
+    StrictMock<mock::OutputLayer> outputLayer;
+    sp<StrictMock<mock::LayerFE>> layerFE = new StrictMock<mock::LayerFE>();
+    LayerFECompositionState layerFEState;
+    impl::OutputLayerCompositionState outputLayerState;
+};
+
+class LayerFlattenerTest : public testing::Test {
+public:
+    LayerFlattenerTest() {
+        EXPECT_CALL(mRenderEngine, genTextures(1, _)).WillOnce(SetArgPointee<1>(kTextureName));
+        mFlattener = std::make_unique<LayerFlattener>(mRenderEngine, *mTimeStats,
+                                                      kMinStableFrames);
+
+        Vector<String16> args;
+        args.push_back(String16("-enable"));
+        std::string result;
+        mTimeStats->parseArgs(false, args, result);
+
+        mOutputState.destinationClip = kOutputBounds;
+        mOutputState.sourceClip = kOutputBounds;
+        mOutputState.viewport = kOutputBounds;
+
+        EXPECT_CALL(mOutput, getState()).WillRepeatedly(ReturnRef(mOutputState));
+        EXPECT_CALL(mOutput, getRenderSurface()).WillRepeatedly(Return(&mRenderSurface));
+        EXPECT_CALL(mOutput, getDisplayColorProfile())
+                .WillRepeatedly(Return(&mDisplayColorProfile));
+        EXPECT_CALL(mOutput, getOutputLayerCount()).WillRepeatedly(Return(mLayers.size()));
+        for (size_t i = 0; i < mLayers.size(); i++) {
+            EXPECT_CALL(mOutput, getOutputLayerOrderedByZByIndex(i))
+                    .WillRepeatedly(Return(&mLayers[i].outputLayer));
+        }
+        EXPECT_CALL(mRenderSurface, getSize()).WillRepeatedly(ReturnRef(kOutputSize));
+        EXPECT_CALL(mDisplayColorProfile, hasWideColorGamut()).WillRepeatedly(Return(false));
+        EXPECT_CALL(mDisplayColorProfile, getHdrCapabilities())
+                .WillRepeatedly(ReturnRef(mHdrCapabilities));
+    }
+
+    ~LayerFlattenerTest() override {
+        EXPECT_CALL(mRenderEngine, unbindExternalTextureBuffer(_)).Times(AnyNumber());
+        EXPECT_CALL(mRenderEngine, deleteTextures(1, _)).Times(1);
+        mFlattener.reset();
+    }
+
+    // Presents one frame with the unchanged layers.
+    void presentFrame() {
+        mFlattener->flatten(mOutput);
+        mFlattener->onCompositionStrategyChosen(mOutput);
+    }
+
+    void presentFramesUntilFlattened() {
+        for (uint32_t i = 0; i < kMinStableFrames; i++) {
+            presentFrame();
+        }
+        EXPECT_CALL(mRenderEngine, drawLayers(_, _, _, false, _, _)).WillOnce(Return(NO_ERROR));
+        presentFrame();
+    }
+
+    std::string dumpTimeStats() {
+        Vector<String16> args;
+        args.push_back(String16("-dump"));
+        std::string result;
+        mTimeStats->parseArgs(false, args, result);
+        return result;
+    }
+
+    StrictMock<renderengine::mock::RenderEngine> mRenderEngine;
+    std::shared_ptr<TimeStats> mTimeStats = std::make_shared<android::impl::TimeStats>();
+    std::unique_ptr<LayerFlattener> mFlattener;
+
+    StrictMock<mock::Output> mOutput;
+    StrictMock<mock::RenderSurface> mRenderSurface;
+    StrictMock<mock::DisplayColorProfile> mDisplayColorProfile;
+    impl::OutputCompositionState mOutputState;
+    HdrCapabilities mHdrCapabilities;
+    std::array<TestLayer, 3> mLayers;
+};
+
+TEST_F(LayerFlattenerTest, doesNotFlattenUntilStable) {
+    for (uint32_t i = 0; i < kMinStableFrames; i++) {
+        presentFrame();
+        for (const auto& layer : mLayers) {
+            EXPECT_EQ(nullptr, layer.outputLayerState.overrideInfo.buffer);
+            EXPECT_FALSE(layer.outputLayerState.overrideInfo.skip);
+        }
+    }
+}
+
+TEST_F(LayerFlattenerTest, flattensStableLayers) {
+    presentFramesUntilFlattened();
+
+    const auto& overrideInfo = mLayers[0].outputLayerState.overrideInfo;
+    ASSERT_NE(nullptr, overrideInfo.buffer);
+    EXPECT_EQ(kOutputBounds, overrideInfo.displayFrame);
+    EXPECT_TRUE(overrideInfo.surfaceDamage.hasSameRects(Region(kOutputBounds)));
+    EXPECT_TRUE(mLayers[1].outputLayerState.overrideInfo.skip);
+    EXPECT_TRUE(mLayers[2].outputLayerState.overrideInfo.skip);
+}
+
+TEST_F(LayerFlattenerTest, reusesFlattenedBufferAndCountsHits) {
+    presentFramesUntilFlattened();
+    const auto buffer = mLayers[0].outputLayerState.overrideInfo.buffer;
+
+    // Only the drawLayers call above is expected.
+    presentFrame();
+    presentFrame();
+
+    EXPECT_EQ(buffer, mLayers[0].outputLayerState.overrideInfo.buffer);
+    EXPECT_TRUE(mLayers[0].outputLayerState.overrideInfo.surfaceDamage.isEmpty());
+    EXPECT_THAT(dumpTimeStats(), HasSubstr("layerFlatteningHits = 2"));
+    EXPECT_THAT(dumpTimeStats(), HasSubstr("layerFlatteningMisses = 0"));
+}
+
+TEST_F(LayerFlattenerTest, dropsFlattenedLayersOnChange) {
+    presentFramesUntilFlattened();
+
+    mLayers[1].layerFEState.acquireFence = new Fence();
+    presentFrame();
+
+    for (const auto& layer : mLayers) {
+        EXPECT_EQ(nullptr, layer.outputLayerState.overrideInfo.buffer);
+        EXPECT_FALSE(layer.outputLayerState.overrideInfo.skip);
+    }
+    EXPECT_THAT(dumpTimeStats(), HasSubstr("layerFlatteningMisses = 1"));
+}
+
+TEST_F(LayerFlattenerTest, dropsFlattenedLayersRejectedByHwc) {
+    presentFramesUntilFlattened();
+
+    EXPECT_CALL(mLayers[0].outputLayer, requiresClientComposition()).WillRepeatedly(Return(true));
+    presentFrame();
+    EXPECT_THAT(dumpTimeStats(), HasSubstr("layerFlatteningMisses = 1"));
+
+    // The layers need to be stable again before being flattened again.
+    presentFrame();
+    EXPECT_EQ(nullptr, mLayers[0].outputLayerState.overrideInfo.buffer);
+}
+
+TEST_F(LayerFlattenerTest, doesNotFlattenClientComposedLayers) {
+    for (auto& layer : mLayers) {
+        layer.outputLayerState.forceClientComposition = true;
+    }
+    for (uint32_t i = 0; i <= kMinStableFrames; i++) {
+        presentFrame();
+    }
+    EXPECT_EQ(nullptr, mLayers[0].outputLayerState.overrideInfo.buffer);
+}
+
+} // namespace
+} // namespace android::compositionengine
@@ -971,6 +971,62 @@ TEST_F(OutputLayerWriteStateToHWCTest, perFrameStateDoesNotIncludeMetadataIfPres
     mOutputLayer.writeStateToHWC(false);
 }
 
+TEST_F(OutputLayerWriteStateToHWCTest, skippedLayerIncludesGeometryAndIsTransparent) {
+    mLayerFEState.compositionType = Hwc2::IComposerClient::Composition::DEVICE;
+    mOutputLayer.editState().overrideInfo.skip = true;
+
+    EXPECT_CALL(*mHwcLayer, setDisplayFrame(kDisplayFrame)).WillOnce(Return(kError));
+    EXPECT_CALL(*mHwcLayer, setSourceCrop(kSourceCrop)).WillOnce(Return(kError));
+    EXPECT_CALL(*mHwcLayer, setZOrder(kZOrder)).WillOnce(Return(kError));
+    EXPECT_CALL(*mHwcLayer, setTransform(kBufferTransform)).WillOnce(Return(kError));
+    EXPECT_CALL(*mHwcLayer, setBlendMode(kBlendMode)).WillOnce(Return(kError));
+    EXPECT_CALL(*mHwcLayer, setPlaneAlpha(0.0f)).WillOnce(Return(kError));
+    EXPECT_CALL(*mHwcLayer, setInfo(kType, kAppId)).WillOnce(Return(kError));
+    expectPerFrameCommonCalls();
+    expectSetHdrMetadataAndBufferCalls();
+    expectSetCompositionTypeCall(Hwc2::IComposerClient::Composition::DEVICE);
+
+    mOutputLayer.writeStateToHWC(false);
+}
+
+TEST_F(OutputLayerWriteStateToHWCTest, overrideBufferReplacesLayerState) {
+    const Rect kOverrideDisplayFrame{1101, 1102, 1103, 1104};
+    const Region kOverrideVisibleRegion{Rect{1105, 1106, 1107, 1108}};
+    const Region kOverrideSurfaceDamage{Rect{1109, 1110, 1111, 1112}};
+    constexpr ui::Dataspace kOverrideDataspace = static_cast<ui::Dataspace>(72);
+    const sp<GraphicBuffer> overrideBuffer = new GraphicBuffer();
+    const sp<Fence> overrideFence = new Fence();
+
+    mLayerFEState.compositionType = Hwc2::IComposerClient::Composition::SOLID_COLOR;
+    auto& overrideInfo = mOutputLayer.editState().overrideInfo;
+    overrideInfo.buffer = overrideBuffer;
+    overrideInfo.acquireFence = overrideFence;
+    overrideInfo.displayFrame = kOverrideDisplayFrame;
+    overrideInfo.dataspace = kOverrideDataspace;
+    overrideInfo.visibleRegion = kOverrideVisibleRegion;
+    overrideInfo.surfaceDamage = kOverrideSurfaceDamage;
+
+    EXPECT_CALL(*mHwcLayer, setDisplayFrame(kOverrideDisplayFrame)).WillOnce(Return(kError));
+    EXPECT_CALL(*mHwcLayer, setSourceCrop(kOverrideDisplayFrame.toFloatRect()))
+            .WillOnce(Return(kError));
+    EXPECT_CALL(*mHwcLayer, setZOrder(kZOrder)).WillOnce(Return(kError));
+    EXPECT_CALL(*mHwcLayer, setTransform(static_cast<Hwc2::Transform>(0)))
+            .WillOnce(Return(kError));
+    EXPECT_CALL(*mHwcLayer, setBlendMode(Hwc2::IComposerClient::BlendMode::PREMULTIPLIED))
+            .WillOnce(Return(kError));
+    EXPECT_CALL(*mHwcLayer, setPlaneAlpha(1.0f)).WillOnce(Return(kError));
+    EXPECT_CALL(*mHwcLayer, setVisibleRegion(RegionEq(kOverrideVisibleRegion)))
+            .WillOnce(Return(kError));
+    EXPECT_CALL(*mHwcLayer, setDataspace(kOverrideDataspace)).WillOnce(Return(kError));
+    EXPECT_CALL(*mHwcLayer, setColorTransform(mat4())).WillOnce(Return(hal::Error::NONE));
+    EXPECT_CALL(*mHwcLayer, setSurfaceDamage(RegionEq(kOverrideSurfaceDamage)))
+            .WillOnce(Return(kError));
+    EXPECT_CALL(*mHwcLayer, setBuffer(kExpectedHwcSlot, overrideBuffer, overrideFence));
+    expectSetCompositionTypeCall(Hwc2::IComposerClient::Composition::DEVICE);
+
+    mOutputLayer.writeStateToHWC(false);
+}
+
 /*
  * OutputLayer::writeCursorPositionToHWC()
  */
@@ -18,6 +18,7 @@
 
 #include <android-base/stringprintf.h>
 #include <compositionengine/LayerFECompositionState.h>
+#include <compositionengine/LayerFESnapshot.h>
 #include <compositionengine/impl/Output.h>
 #include <compositionengine/impl/OutputCompositionState.h>
 #include <compositionengine/impl/OutputLayerCompositionState.h>
@@ -45,6 +46,7 @@ using testing::DoAll;
 using testing::ElementsAre;
 using testing::ElementsAreArray;
 using testing::Eq;
+using testing::Field;
 using testing::InSequence;
 using testing::Invoke;
 using testing::IsEmpty;
@@ -1046,6 +1048,34 @@ TEST_F(OutputCollectVisibleLayersTest, processesCandidateLayersReversedAndSetsOu
     EXPECT_EQ(2u, mLayer3.outputLayerState.z);
 }
 
+TEST_F(OutputCollectVisibleLayersTest, skipsLayersRejectedBySnapshot) {
+    mOutput.mState.layerStackId = 1u;
+
+    LayerFECompositionState visibleState;
+    visibleState.layerStackId = 1u;
+    visibleState.geomLayerBounds = FloatRect{0, 0, 100, 200};
+    visibleState.shadowRadius = 0.0f;
+    LayerFECompositionState hiddenState = visibleState;
+    hiddenState.isVisible = false;
+    LayerFECompositionState otherStackState = visibleState;
+    otherStackState.layerStackId = 2u;
+
+    EXPECT_CALL(*mLayer1.layerFE, getCompositionState()).WillOnce(Return(&visibleState));
+    EXPECT_CALL(*mLayer2.layerFE, getCompositionState()).WillOnce(Return(&hiddenState));
+    EXPECT_CALL(*mLayer3.layerFE, getCompositionState()).WillOnce(Return(&otherStackState));
+    LayerFESnapshot snapshot;
+    snapshot.build(mRefreshArgs.layers);
+    mRefreshArgs.layerFESnapshot = &snapshot;
+
+    InSequence seq;
+
+    EXPECT_CALL(mOutput, ensureOutputLayerIfVisible(Eq(mLayer1.layerFE), Ref(mCoverageState)));
+    EXPECT_CALL(mOutput, setReleasedLayers(Ref(mRefreshArgs)));
+    EXPECT_CALL(mOutput, finalizePendingOutputLayers());
+
+    mOutput.collectVisibleLayers(mRefreshArgs, mCoverageState);
+}
+
 /*
  * Output::ensureOutputLayerIfVisible()
  */
@@ -1534,6 +1564,118 @@ TEST_F(OutputEnsureOutputLayerIfVisibleTest, takesNotSoEarlyOutifLayerWithShadow
     ensureOutputLayerIfVisible();
 }
 
+struct OutputEnsureOutputLayerIfVisibleCacheTest : public OutputEnsureOutputLayerIfVisibleTest {
+    OutputEnsureOutputLayerIfVisibleCacheTest() {
+        mLayer.layerFEState.contentDirty = false;
+
+        mCoverageState.reuseCachedVisibility = true;
+        mCoverageState.aboveCoveredLayers = Region(Rect(50, 0, 150, 200));
+        mCoverageState.aboveOpaqueLayers = Region(Rect(50, 0, 150, 200));
+    }
+
+    // Runs the computation a second time as if on the next frame, with the
+    // given coverage from the layers above.
+    void ensureOutputLayerIfVisibleAgain(const Region& aboveCoveredLayers,
+                                         const Region& aboveOpaqueLayers) {
+        ASSERT_TRUE(mLayer.outputLayerState.visibilityCache);
+
+        // Replace one of the computed values so we can tell if it is recomputed.
+        mLayer.outputLayerState.outputSpaceVisibleRegion = kSentinelRegion;
+
+        mNextCoverageState.reuseCachedVisibility = true;
+        mNextCoverageState.aboveCoveredLayers = aboveCoveredLayers;
+        mNextCoverageState.aboveOpaqueLayers = aboveOpaqueLayers;
+
+        sp<LayerFE> layerFE(mLayer.layerFE);
+        mOutput.ensureOutputLayerIfVisible(layerFE, mNextCoverageState);
+    }
+
+    const Region kSentinelRegion{Rect(1, 1, 2, 2)};
+
+    Output::CoverageState mNextCoverageState{mGeomSnapshots};
+};
+
+TEST_F(OutputEnsureOutputLayerIfVisibleCacheTest, doesNotCacheIfNotEnabled) {
+    mCoverageState.reuseCachedVisibility = false;
+    mLayer.outputLayerState.visibilityCache.emplace();
+
+    EXPECT_CALL(mOutput, ensureOutputLayer(Eq(0u), Eq(mLayer.layerFE)))
+            .WillOnce(Return(&mLayer.outputLayer));
+
+    ensureOutputLayerIfVisible();
+
+    EXPECT_FALSE(mLayer.outputLayerState.visibilityCache);
+}
+
+TEST_F(OutputEnsureOutputLayerIfVisibleCacheTest, reusesVisibilityIfInputsUnchanged) {
+    EXPECT_CALL(mOutput, ensureOutputLayer(Eq(0u), Eq(mLayer.layerFE)))
+            .Times(2)
+            .WillRepeatedly(Return(&mLayer.outputLayer));
+
+    ensureOutputLayerIfVisible();
+
+    // Coverage changes outside the footprint of the layer do not matter.
+    const Rect kOutsideFootprint(120, 250, 200, 300);
+    ensureOutputLayerIfVisibleAgain(Region(Rect(50, 0, 150, 200)).orSelf(kOutsideFootprint),
+                                    Region(Rect(50, 0, 150, 200)).orSelf(kOutsideFootprint));
+
+    const Region kExpectedAboveRegion = Region(Rect(0, 0, 150, 200)).orSelf(kOutsideFootprint);
+
+    EXPECT_THAT(mNextCoverageState.dirtyRegion, RegionEq(kEmptyRegion));
+    EXPECT_THAT(mNextCoverageState.aboveCoveredLayers, RegionEq(kExpectedAboveRegion));
+    EXPECT_THAT(mNextCoverageState.aboveOpaqueLayers, RegionEq(kExpectedAboveRegion));
+
+    EXPECT_THAT(mLayer.outputLayerState.visibleRegion, RegionEq(Region(Rect(0, 0, 50, 200))));
+    EXPECT_THAT(mLayer.outputLayerState.coveredRegion, RegionEq(Region(Rect(50, 0, 100, 200))));
+    EXPECT_THAT(mLayer.outputLayerState.outputSpaceVisibleRegion, RegionEq(kSentinelRegion));
+}
+
+TEST_F(OutputEnsureOutputLayerIfVisibleCacheTest, reusedVisibilityMarksContentDirty) {
+    EXPECT_CALL(mOutput, ensureOutputLayer(Eq(0u), Eq(mLayer.layerFE)))
+            .Times(2)
+            .WillRepeatedly(Return(&mLayer.outputLayer));
+
+    ensureOutputLayerIfVisible();
+
+    mLayer.layerFEState.contentDirty = true;
+    ensureOutputLayerIfVisibleAgain(Region(Rect(50, 0, 150, 200)),
+                                    Region(Rect(50, 0, 150, 200)));
+
+    EXPECT_THAT(mNextCoverageState.dirtyRegion, RegionEq(Region(Rect(0, 0, 50, 200))));
+    EXPECT_THAT(mLayer.outputLayerState.outputSpaceVisibleRegion, RegionEq(kSentinelRegion));
+}
+
+TEST_F(OutputEnsureOutputLayerIfVisibleCacheTest, recomputesVisibilityIfGeometryChanges) {
+    EXPECT_CALL(mOutput, ensureOutputLayer(Eq(0u), Eq(mLayer.layerFE)))
+            .Times(2)
+            .WillRepeatedly(Return(&mLayer.outputLayer));
+
+    ensureOutputLayerIfVisible();
+
+    mLayer.layerFEState.geomLayerBounds = FloatRect{0, 0, 100, 150};
+    ensureOutputLayerIfVisibleAgain(Region(Rect(50, 0, 150, 200)),
+                                    Region(Rect(50, 0, 150, 200)));
+
+    EXPECT_THAT(mLayer.outputLayerState.visibleRegion, RegionEq(Region(Rect(0, 0, 50, 150))));
+    EXPECT_THAT(mLayer.outputLayerState.outputSpaceVisibleRegion,
+                RegionEq(Region(Rect(0, 0, 50, 150))));
+}
+
+TEST_F(OutputEnsureOutputLayerIfVisibleCacheTest, recomputesVisibilityIfCoverageAboveChanges) {
+    EXPECT_CALL(mOutput, ensureOutputLayer(Eq(0u), Eq(mLayer.layerFE)))
+            .Times(2)
+            .WillRepeatedly(Return(&mLayer.outputLayer));
+
+    ensureOutputLayerIfVisible();
+
+    ensureOutputLayerIfVisibleAgain(Region(Rect(60, 0, 150, 200)),
+                                    Region(Rect(60, 0, 150, 200)));
+
+    EXPECT_THAT(mLayer.outputLayerState.visibleRegion, RegionEq(Region(Rect(0, 0, 60, 200))));
+    EXPECT_THAT(mLayer.outputLayerState.outputSpaceVisibleRegion,
+                RegionEq(Region(Rect(0, 0, 60, 200))));
+}
+
 /*
  * Output::present()
  */
@@ -1572,6 +1714,105 @@ TEST_F(OutputPresentTest, justInvokesChildFunctionsInSequence) {
     mOutput.present(args);
 }
 
+TEST_F(OutputPresentTest, skipsFramesAboveMaxFrameRate) {
+    StrictMock<mock::CompositionEngine> compositionEngine;
+    EXPECT_CALL(mOutput, getCompositionEngine()).WillRepeatedly(ReturnRef(compositionEngine));
+    mOutput.mState.isEnabled = true;
+    mOutput.mState.bounds = Rect(10, 20);
+    mOutput.setMaxFrameRate(30.0f);
+
+    const auto expectComposed = [&](const CompositionRefreshArgs& args) {
+        InSequence seq;
+        EXPECT_CALL(mOutput, updateColorProfile(Ref(args)));
+        EXPECT_CALL(mOutput, updateAndWriteCompositionState(Ref(args)));
+        EXPECT_CALL(mOutput, setColorTransform(Ref(args)));
+        EXPECT_CALL(mOutput, beginFrame());
+        EXPECT_CALL(mOutput, prepareFrame());
+        EXPECT_CALL(mOutput, devOptRepaintFlash(Ref(args)));
+        EXPECT_CALL(mOutput, finishFrame(Ref(args)));
+        EXPECT_CALL(mOutput, postFramebuffer());
+    };
+    const auto expectSkipped = [&](const CompositionRefreshArgs& args) {
+        InSequence seq;
+        EXPECT_CALL(mOutput, updateColorProfile(Ref(args)));
+        EXPECT_CALL(mOutput, setColorTransform(Ref(args)));
+    };
+
+    CompositionRefreshArgs args;
+    EXPECT_CALL(compositionEngine, getLastFrameRefreshTimestamp()).WillOnce(Return(100'000'000));
+    expectComposed(args);
+    mOutput.present(args);
+    EXPECT_FALSE(mOutput.mState.frameDeferred);
+
+    // A refresh on the next 120Hz vsync is skipped, and asks for another
+    // update if the output has changes.
+    args.updatingGeometryThisFrame = true;
+    EXPECT_CALL(compositionEngine, getLastFrameRefreshTimestamp()).WillOnce(Return(108'333'333));
+    expectSkipped(args);
+    mOutput.present(args);
+    EXPECT_TRUE(mOutput.mState.frameDeferred);
+    EXPECT_TRUE(mOutput.mState.geometryUpdatePending);
+
+    // A refresh slightly before the frame time is composed.
+    args.updatingGeometryThisFrame = false;
+    EXPECT_CALL(compositionEngine, getLastFrameRefreshTimestamp()).WillOnce(Return(132'900'000));
+    expectComposed(args);
+    mOutput.present(args);
+    EXPECT_FALSE(mOutput.mState.frameDeferred);
+
+    // Clearing the limit composes every refresh.
+    mOutput.setMaxFrameRate(0.0f);
+    expectComposed(args);
+    mOutput.present(args);
+}
+
+TEST_F(OutputPresentTest, skipsIdleRefreshes) {
+    NonInjectedLayer layer;
+    EXPECT_CALL(mOutput, getOutputLayerCount()).WillRepeatedly(Return(1u));
+    EXPECT_CALL(mOutput, getOutputLayerOrderedByZByIndex(0))
+            .WillRepeatedly(Return(&layer.outputLayer));
+    mOutput.mState.isEnabled = true;
+
+    const auto expectComposed = [&](const CompositionRefreshArgs& args) {
+        InSequence seq;
+        EXPECT_CALL(mOutput, updateColorProfile(Ref(args)));
+        EXPECT_CALL(mOutput, updateAndWriteCompositionState(Ref(args)));
+        EXPECT_CALL(mOutput, setColorTransform(Ref(args)));
+        EXPECT_CALL(mOutput, beginFrame());
+        EXPECT_CALL(mOutput, prepareFrame());
+        EXPECT_CALL(mOutput, devOptRepaintFlash(Ref(args)));
+        EXPECT_CALL(mOutput, finishFrame(Ref(args)));
+        EXPECT_CALL(mOutput, postFramebuffer());
+    };
+
+    CompositionRefreshArgs args;
+    args.skipIdleOutputs = true;
+    EXPECT_CALL(mOutput, updateColorProfile(Ref(args)));
+    mOutput.present(args);
+
+    // A queued frame on one of the layers of the output is composed.
+    args.layersWithQueuedFrames.push_back(layer.layerFE);
+    expectComposed(args);
+    mOutput.present(args);
+    args.layersWithQueuedFrames.clear();
+
+    // So are geometry changes and dirty regions.
+    args.updatingGeometryThisFrame = true;
+    expectComposed(args);
+    mOutput.present(args);
+    args.updatingGeometryThisFrame = false;
+
+    mOutput.mState.dirtyRegion = Region(Rect(10, 20));
+    expectComposed(args);
+    mOutput.present(args);
+    mOutput.mState.dirtyRegion.clear();
+
+    // The timing output is composed on every refresh.
+    args.timingOutput = &mOutput;
+    expectComposed(args);
+    mOutput.present(args);
+}
+
 /*
  * Output::updateColorProfile()
  */
@@ -3069,6 +3310,47 @@ TEST_F(OutputComposeSurfacesTest, clientCompositionIfRequestChanges) {
     EXPECT_FALSE(mOutput.mState.reusedClientComposition);
 }
 
+TEST_F(OutputComposeSurfacesTest, partialClientCompositionOnlyRedrawsBufferDamage) {
+    mOutput.cacheClientCompositionRequests(0);
+    mOutput.mState.dirtyRegion = Region(Rect(1005, 1006, 1006, 1007));
+    LayerFE::LayerSettings r1;
+    r1.geometry.boundaries = FloatRect{1, 2, 3, 4};
+
+    compositionengine::CompositionRefreshArgs refreshArgs;
+    refreshArgs.partialClientComposition = true;
+
+    const ui::Size surfaceSize{2000, 2000};
+    const Region frameDamage =
+            Region(Rect(1005, 1006, 1006, 1007)).orSelf(Rect{100, 101, 102, 103});
+    const Region bufferDamage(Rect(10, 11, 12, 13));
+
+    EXPECT_CALL(mOutput, getSkipColorTransform()).WillRepeatedly(Return(false));
+    EXPECT_CALL(*mDisplayColorProfile, hasWideColorGamut()).WillRepeatedly(Return(true));
+    EXPECT_CALL(mRenderEngine, supportsProtectedContent()).WillRepeatedly(Return(false));
+    EXPECT_CALL(mOutput, generateClientCompositionRequests(_, _, kDefaultOutputDataspace))
+            .WillRepeatedly(Return(std::vector<LayerFE::LayerSettings>{r1}));
+    EXPECT_CALL(mOutput, appendRegionFlashRequests(RegionEq(kDebugRegion), _))
+            .WillRepeatedly(Return());
+    EXPECT_CALL(mOutput, getOutputLayerCount()).WillRepeatedly(Return(0u));
+
+    EXPECT_CALL(*mRenderSurface, dequeueBuffer(_)).WillRepeatedly(Return(mOutputBuffer));
+    EXPECT_CALL(*mRenderSurface, getSize()).WillRepeatedly(ReturnRef(surfaceSize));
+    // The frame damage is added on every frame, and the whole surface is
+    // only damaged on the first one, which changes the display settings.
+    EXPECT_CALL(*mRenderSurface, addFrameDamage(RegionEq(frameDamage))).Times(2);
+    EXPECT_CALL(*mRenderSurface, addFrameDamage(RegionEq(Region(Rect(surfaceSize))))).Times(1);
+    EXPECT_CALL(*mRenderSurface, getBufferDamage()).WillRepeatedly(Return(bufferDamage));
+    EXPECT_CALL(mRenderEngine,
+                drawLayers(Field(&renderengine::DisplaySettings::damageRegion,
+                                 RegionEq(bufferDamage)),
+                           ElementsAre(Pointee(r1)), _, true, _, _))
+            .Times(2)
+            .WillRepeatedly(Return(NO_ERROR));
+
+    EXPECT_TRUE(mOutput.composeSurfaces(kDebugRegion, refreshArgs));
+    EXPECT_TRUE(mOutput.composeSurfaces(kDebugRegion, refreshArgs));
+}
+
 struct OutputComposeSurfacesTest_UsesExpectedDisplaySettings : public OutputComposeSurfacesTest {
     OutputComposeSurfacesTest_UsesExpectedDisplaySettings() {
         EXPECT_CALL(mRenderEngine, supportsProtectedContent()).WillRepeatedly(Return(false));
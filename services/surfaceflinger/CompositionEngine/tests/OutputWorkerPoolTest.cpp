@@ -0,0 +1,79 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <atomic>
+#include <thread>
+
+#include <compositionengine/impl/OutputWorkerPool.h>
+#include <gtest/gtest.h>
+
+namespace android::compositionengine {
+namespace {
+
+using impl::OutputWorkerPool;
+
+TEST(OutputWorkerPoolTest, handlesNoTasks) {
+    OutputWorkerPool pool(2);
+    std::vector<OutputWorkerPool::Task> tasks;
+    pool.runAll(tasks);
+
+    EXPECT_EQ(0u, pool.getThreadCountForTest());
+}
+
+TEST(OutputWorkerPoolTest, runsSingleTaskOnCallingThread) {
+    OutputWorkerPool pool(2);
+    std::thread::id taskThread;
+    std::vector<OutputWorkerPool::Task> tasks;
+    tasks.emplace_back([&]() { taskThread = std::this_thread::get_id(); });
+    pool.runAll(tasks);
+
+    EXPECT_EQ(std::this_thread::get_id(), taskThread);
+    EXPECT_EQ(0u, pool.getThreadCountForTest());
+}
+
+TEST(OutputWorkerPoolTest, runsAllTasksBeforeReturning) {
+    OutputWorkerPool pool(2);
+    std::atomic<int> count = 0;
+    std::vector<OutputWorkerPool::Task> tasks;
+    for (int i = 0; i < 5; i++) {
+        tasks.emplace_back([&]() { count++; });
+    }
+
+    pool.runAll(tasks);
+    EXPECT_EQ(5, count);
+    EXPECT_EQ(2u, pool.getThreadCountForTest());
+
+    // The threads are reused for subsequent frames.
+    pool.runAll(tasks);
+    EXPECT_EQ(10, count);
+    EXPECT_EQ(2u, pool.getThreadCountForTest());
+}
+
+TEST(OutputWorkerPoolTest, runsInlineWithoutWorkers) {
+    OutputWorkerPool pool(0);
+    int count = 0;
+    std::vector<OutputWorkerPool::Task> tasks;
+    for (int i = 0; i < 3; i++) {
+        tasks.emplace_back([&]() { count++; });
+    }
+
+    pool.runAll(tasks);
+    EXPECT_EQ(3, count);
+    EXPECT_EQ(0u, pool.getThreadCountForTest());
+}
+
+} // namespace
+} // namespace android::compositionengine
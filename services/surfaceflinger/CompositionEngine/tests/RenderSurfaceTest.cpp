@@ -28,6 +28,8 @@
 #include <gtest/gtest.h>
 #include <renderengine/mock/RenderEngine.h>
 
+#include "RegionMatcher.h"
+
 namespace android::compositionengine {
 namespace {
 
@@ -326,6 +328,81 @@ TEST_F(RenderSurfaceTest, queueBufferHandlesNativeWindowQueueBufferFailureOnVirt
     EXPECT_EQ(nullptr, mSurface.mutableGraphicBufferForTest().get());
 }
 
+/*
+ * RenderSurface::getBufferDamage()
+ */
+
+TEST_F(RenderSurfaceTest, getBufferDamageIsFullWithoutQueuedFrames) {
+    mSurface.mutableGraphicBufferForTest() = new GraphicBuffer();
+
+    EXPECT_CALL(*mNativeWindow, query(NATIVE_WINDOW_BUFFER_AGE, _))
+            .WillRepeatedly(DoAll(SetArgPointee<1>(1), Return(NO_ERROR)));
+
+    EXPECT_THAT(mSurface.getBufferDamage(),
+                RegionEq(Region(Rect(DEFAULT_DISPLAY_WIDTH, DEFAULT_DISPLAY_HEIGHT))));
+}
+
+TEST_F(RenderSurfaceTest, getBufferDamageAccumulatesDamageSinceBufferWasQueued) {
+    sp<GraphicBuffer> buffer = new GraphicBuffer();
+
+    impl::OutputCompositionState state;
+    state.usesClientComposition = true;
+
+    EXPECT_CALL(mDisplay, getState()).WillRepeatedly(ReturnRef(state));
+    EXPECT_CALL(*mNativeWindow, queueBuffer(buffer->getNativeBuffer(), -1))
+            .WillRepeatedly(Return(NO_ERROR));
+    EXPECT_CALL(*mDisplaySurface, advanceFrame()).WillRepeatedly(Return(NO_ERROR));
+
+    mSurface.mutableGraphicBufferForTest() = buffer;
+    mSurface.addFrameDamage(Region(Rect(0, 0, 10, 10)));
+    mSurface.queueBuffer(base::unique_fd());
+
+    mSurface.mutableGraphicBufferForTest() = buffer;
+    mSurface.addFrameDamage(Region(Rect(20, 20, 30, 30)));
+    mSurface.queueBuffer(base::unique_fd());
+
+    mSurface.mutableGraphicBufferForTest() = buffer;
+    mSurface.addFrameDamage(Region(Rect(40, 40, 50, 50)));
+
+    EXPECT_CALL(*mNativeWindow, query(NATIVE_WINDOW_BUFFER_AGE, _))
+            .WillOnce(DoAll(SetArgPointee<1>(1), Return(NO_ERROR)))
+            .WillOnce(DoAll(SetArgPointee<1>(2), Return(NO_ERROR)))
+            .WillOnce(DoAll(SetArgPointee<1>(3), Return(NO_ERROR)))
+            .WillOnce(DoAll(SetArgPointee<1>(0), Return(NO_ERROR)));
+
+    EXPECT_THAT(mSurface.getBufferDamage(), RegionEq(Region(Rect(40, 40, 50, 50))));
+    EXPECT_THAT(mSurface.getBufferDamage(),
+                RegionEq(Region(Rect(40, 40, 50, 50)).orSelf(Rect(20, 20, 30, 30))));
+    // Only two frames were queued, so the content of an older buffer is unknown.
+    EXPECT_THAT(mSurface.getBufferDamage(),
+                RegionEq(Region(Rect(DEFAULT_DISPLAY_WIDTH, DEFAULT_DISPLAY_HEIGHT))));
+    EXPECT_THAT(mSurface.getBufferDamage(),
+                RegionEq(Region(Rect(DEFAULT_DISPLAY_WIDTH, DEFAULT_DISPLAY_HEIGHT))));
+}
+
+TEST_F(RenderSurfaceTest, getBufferDamageIsFullForBufferQueuedWithoutBeingDrawn) {
+    sp<GraphicBuffer> buffer = new GraphicBuffer();
+
+    impl::OutputCompositionState state;
+    state.usesClientComposition = false;
+    state.flipClientTarget = true;
+
+    EXPECT_CALL(mDisplay, getState()).WillOnce(ReturnRef(state));
+    EXPECT_CALL(*mNativeWindow, queueBuffer(buffer->getNativeBuffer(), -1))
+            .WillOnce(Return(NO_ERROR));
+    EXPECT_CALL(*mDisplaySurface, advanceFrame()).Times(1);
+
+    mSurface.mutableGraphicBufferForTest() = buffer;
+    mSurface.queueBuffer(base::unique_fd());
+
+    mSurface.mutableGraphicBufferForTest() = buffer;
+    EXPECT_CALL(*mNativeWindow, query(NATIVE_WINDOW_BUFFER_AGE, _))
+            .WillOnce(DoAll(SetArgPointee<1>(1), Return(NO_ERROR)));
+
+    EXPECT_THAT(mSurface.getBufferDamage(),
+                RegionEq(Region(Rect(DEFAULT_DISPLAY_WIDTH, DEFAULT_DISPLAY_HEIGHT))));
+}
+
 /*
  * RenderSurface::onPresentDisplayCompleted()
  */
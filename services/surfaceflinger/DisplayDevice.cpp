@@ -123,7 +123,12 @@ uint32_t DisplayDevice::getPageFlipCount() const {
 // ----------------------------------------------------------------------------
 void DisplayDevice::setPowerMode(hal::PowerMode mode) {
     mPowerMode = mode;
-    getCompositionDisplay()->setCompositionEnabled(mPowerMode != hal::PowerMode::OFF);
+    getCompositionDisplay()->setCompositionEnabled(isPoweredOn() && !mPowerModeTransitionPending);
+}
+
+void DisplayDevice::setPowerModeTransitionPending(bool pending) {
+    mPowerModeTransitionPending = pending;
+    getCompositionDisplay()->setCompositionEnabled(isPoweredOn() && !mPowerModeTransitionPending);
 }
 
 hal::PowerMode DisplayDevice::getPowerMode() const {
@@ -154,6 +159,10 @@ void DisplayDevice::setDisplaySize(int width, int height) {
     mCompositionDisplay->setBounds(ui::Size(width, height));
 }
 
+void DisplayDevice::setMaxFrameRate(float frameRate) {
+    mCompositionDisplay->setMaxFrameRate(frameRate);
+}
+
 void DisplayDevice::setProjection(ui::Rotation orientation, Rect viewport, Rect frame) {
     mOrientation = orientation;
 
@@ -20,6 +20,7 @@
 #include <optional>
 #include <string>
 #include <unordered_map>
+#include <utility>
 
 #include <android/native_window.h>
 #include <binder/IBinder.h>
@@ -86,6 +87,7 @@ public:
 
     void setLayerStack(ui::LayerStack);
     void setDisplaySize(int width, int height);
+    void setMaxFrameRate(float frameRate);
     void setProjection(ui::Rotation orientation, Rect viewport, Rect frame);
 
     ui::Rotation getPhysicalOrientation() const { return mPhysicalOrientation; }
@@ -143,6 +145,18 @@ public:
     void setPowerMode(hardware::graphics::composer::hal::PowerMode mode);
     bool isPoweredOn() const;
 
+    // Whether the HWC is still switching the display to its power mode. The display isn't
+    // composed until it is done.
+    bool isPowerModeTransitionPending() const { return mPowerModeTransitionPending; }
+    void setPowerModeTransitionPending(bool pending);
+    // Keeps the last power mode requested while a transition was pending, to apply it after.
+    void queuePowerMode(hardware::graphics::composer::hal::PowerMode mode) {
+        mQueuedPowerMode = mode;
+    }
+    std::optional<hardware::graphics::composer::hal::PowerMode> takeQueuedPowerMode() {
+        return std::exchange(mQueuedPowerMode, std::nullopt);
+    }
+
     ui::Dataspace getCompositionDataSpace() const;
 
     /* ------------------------------------------------------------------------
@@ -178,6 +192,8 @@ private:
 
     hardware::graphics::composer::hal::PowerMode mPowerMode =
             hardware::graphics::composer::hal::PowerMode::OFF;
+    bool mPowerModeTransitionPending = false;
+    std::optional<hardware::graphics::composer::hal::PowerMode> mQueuedPowerMode;
     HwcConfigIndexType mActiveConfig;
 
     // TODO(b/74619554): Remove special cases for primary display.
@@ -206,6 +222,8 @@ struct DisplayDeviceState {
     ui::Rotation orientation = ui::ROTATION_0;
     uint32_t width = 0;
     uint32_t height = 0;
+    // The maximum rate at which a virtual display is composed, or 0 for no limit.
+    float maxFrameRate = 0.0f;
     std::string displayName;
     bool isSecure = false;
 
@@ -574,6 +574,26 @@ Error Composer::presentDisplay(Display display, int* outPresentFence)
     return Error::NONE;
 }
 
+Error Composer::presentDisplays(const std::vector<Display>& displays,
+                                std::vector<int>* outPresentFences)
+{
+    for (Display display : displays) {
+        mWriter.selectDisplay(display);
+        mWriter.presentDisplay();
+    }
+
+    // The fences of the displays which presented are taken even if another one failed, so that
+    // they are not leaked.
+    Error error = execute();
+
+    outPresentFences->resize(displays.size());
+    for (size_t i = 0; i < displays.size(); i++) {
+        mReader.takePresentFence(displays[i], &(*outPresentFences)[i]);
+    }
+
+    return error;
+}
+
 Error Composer::setActiveConfig(Display display, Config config)
 {
     auto ret = mClient->setActiveConfig(display, config);
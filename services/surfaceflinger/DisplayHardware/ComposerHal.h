@@ -137,6 +137,11 @@ public:
                                    std::vector<int>* outReleaseFences) = 0;
 
     virtual Error presentDisplay(Display display, int* outPresentFence) = 0;
+    // Presents the displays with a single command batch. The present fences are returned in the
+    // order of the displays, -1 for those which failed. The release fences of each display can
+    // then be read with getReleaseFences until the next command batch is executed.
+    virtual Error presentDisplays(const std::vector<Display>& displays,
+                                  std::vector<int>* outPresentFences) = 0;
 
     virtual Error setActiveConfig(Display display, Config config) = 0;
 
@@ -388,6 +393,8 @@ public:
                            std::vector<int>* outReleaseFences) override;
 
     Error presentDisplay(Display display, int* outPresentFence) override;
+    Error presentDisplays(const std::vector<Display>& displays,
+                          std::vector<int>* outPresentFences) override;
 
     Error setActiveConfig(Display display, Config config) override;
 
@@ -823,13 +823,27 @@ Error Layer::setSurfaceDamage(const Region& damage)
 
 Error Layer::setBlendMode(BlendMode mode)
 {
+    if (mBlendMode == mode) {
+        return Error::NONE;
+    }
     auto intError = mComposer.setLayerBlendMode(mDisplayId, mId, mode);
-    return static_cast<Error>(intError);
+    Error error = static_cast<Error>(intError);
+    if (error == Error::NONE) {
+        mBlendMode = mode;
+    }
+    return error;
 }
 
 Error Layer::setColor(Color color) {
+    if (mColor == color) {
+        return Error::NONE;
+    }
     auto intError = mComposer.setLayerColor(mDisplayId, mId, color);
-    return static_cast<Error>(intError);
+    Error error = static_cast<Error>(intError);
+    if (error == Error::NONE) {
+        mColor = color;
+    }
+    return error;
 }
 
 Error Layer::setCompositionType(Composition type)
@@ -912,16 +926,30 @@ Error Layer::setPerFrameMetadata(const int32_t supportedPerFrameMetadata,
 
 Error Layer::setDisplayFrame(const Rect& frame)
 {
+    if (mDisplayFrame == frame) {
+        return Error::NONE;
+    }
     Hwc2::IComposerClient::Rect hwcRect{frame.left, frame.top,
         frame.right, frame.bottom};
     auto intError = mComposer.setLayerDisplayFrame(mDisplayId, mId, hwcRect);
-    return static_cast<Error>(intError);
+    Error error = static_cast<Error>(intError);
+    if (error == Error::NONE) {
+        mDisplayFrame = frame;
+    }
+    return error;
 }
 
 Error Layer::setPlaneAlpha(float alpha)
 {
+    if (mPlaneAlpha == alpha) {
+        return Error::NONE;
+    }
     auto intError = mComposer.setLayerPlaneAlpha(mDisplayId, mId, alpha);
-    return static_cast<Error>(intError);
+    Error error = static_cast<Error>(intError);
+    if (error == Error::NONE) {
+        mPlaneAlpha = alpha;
+    }
+    return error;
 }
 
 Error Layer::setSidebandStream(const native_handle_t* stream)
@@ -937,17 +965,31 @@ Error Layer::setSidebandStream(const native_handle_t* stream)
 
 Error Layer::setSourceCrop(const FloatRect& crop)
 {
+    if (mSourceCrop == crop) {
+        return Error::NONE;
+    }
     Hwc2::IComposerClient::FRect hwcRect{
         crop.left, crop.top, crop.right, crop.bottom};
     auto intError = mComposer.setLayerSourceCrop(mDisplayId, mId, hwcRect);
-    return static_cast<Error>(intError);
+    Error error = static_cast<Error>(intError);
+    if (error == Error::NONE) {
+        mSourceCrop = crop;
+    }
+    return error;
 }
 
 Error Layer::setTransform(Transform transform)
 {
+    if (mTransform == transform) {
+        return Error::NONE;
+    }
     auto intTransform = static_cast<Hwc2::Transform>(transform);
     auto intError = mComposer.setLayerTransform(mDisplayId, mId, intTransform);
-    return static_cast<Error>(intError);
+    Error error = static_cast<Error>(intError);
+    if (error == Error::NONE) {
+        mTransform = transform;
+    }
+    return error;
 }
 
 Error Layer::setVisibleRegion(const Region& region)
@@ -973,14 +1015,29 @@ Error Layer::setVisibleRegion(const Region& region)
 
 Error Layer::setZOrder(uint32_t z)
 {
+    if (mZOrder == z) {
+        return Error::NONE;
+    }
     auto intError = mComposer.setLayerZOrder(mDisplayId, mId, z);
-    return static_cast<Error>(intError);
+    Error error = static_cast<Error>(intError);
+    if (error == Error::NONE) {
+        mZOrder = z;
+    }
+    return error;
 }
 
 Error Layer::setInfo(uint32_t type, uint32_t appId)
 {
-  auto intError = mComposer.setLayerInfo(mDisplayId, mId, type, appId);
-  return static_cast<Error>(intError);
+    const auto info = std::make_pair(type, appId);
+    if (mInfo == info) {
+        return Error::NONE;
+    }
+    auto intError = mComposer.setLayerInfo(mDisplayId, mId, type, appId);
+    Error error = static_cast<Error>(intError);
+    if (error == Error::NONE) {
+        mInfo = info;
+    }
+    return error;
 }
 
 // Composer HAL 2.3
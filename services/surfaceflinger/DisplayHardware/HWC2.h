@@ -28,9 +28,11 @@
 
 #include <functional>
 #include <future>
+#include <optional>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include "Hal.h"
@@ -449,6 +451,17 @@ private:
     android::HdrMetadata mHdrMetadata;
     android::mat4 mColorMatrix;
     uint32_t mBufferSlot;
+
+    // Geometry and per-frame state last accepted by the HWC. Unset until the
+    // first successful call, so the initial value is always sent.
+    std::optional<android::Rect> mDisplayFrame;
+    std::optional<android::FloatRect> mSourceCrop;
+    std::optional<uint32_t> mZOrder;
+    std::optional<hal::Transform> mTransform;
+    std::optional<hal::BlendMode> mBlendMode;
+    std::optional<float> mPlaneAlpha;
+    std::optional<hal::Color> mColor;
+    std::optional<std::pair<uint32_t, uint32_t>> mInfo;
 };
 
 } // namespace impl
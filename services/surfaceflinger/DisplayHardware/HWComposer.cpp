@@ -26,6 +26,7 @@
 
 #include "HWComposer.h"
 
+#include <android-base/stringprintf.h>
 #include <compositionengine/Output.h>
 #include <compositionengine/OutputLayer.h>
 #include <compositionengine/impl/OutputLayerCompositionState.h>
@@ -503,11 +504,13 @@ status_t HWComposer::getDeviceCompositionChanges(
     // First try to skip validate altogether when there is no client
     // composition.  When there is client composition, since we haven't
     // rendered to the client target yet, we should not attempt to skip
-    // validate.
+    // validate. Also go straight to validate while the HWC keeps overriding
+    // the composition types we request, as it would not present them as-is.
     displayData.validateWasSkipped = false;
-    if (!frameUsesClientComposition) {
+    if (!frameUsesClientComposition && displayData.tryPresentOrValidate) {
         sp<Fence> outPresentFence;
         uint32_t state = UINT32_MAX;
+        displayData.presentOrValidateCount++;
         error = hwcDisplay->presentOrValidate(&numTypes, &numRequests, &outPresentFence , &state);
         if (!hasChangesError(error)) {
             RETURN_IF_HWC_ERROR_FOR("presentOrValidate", error, displayId, UNKNOWN_ERROR);
@@ -518,6 +521,7 @@ status_t HWComposer::getDeviceCompositionChanges(
             displayData.releaseFences = std::move(releaseFences);
             displayData.lastPresentFence = outPresentFence;
             displayData.validateWasSkipped = true;
+            displayData.validateSkippedCount++;
             displayData.presentError = error;
             return NO_ERROR;
         }
@@ -526,6 +530,7 @@ status_t HWComposer::getDeviceCompositionChanges(
         error = hwcDisplay->validate(&numTypes, &numRequests);
     }
     ALOGV("SkipValidate failed, Falling back to SLOW validate/present");
+    displayData.validateCount++;
     if (!hasChangesError(error)) {
         RETURN_IF_HWC_ERROR_FOR("validate", error, displayId, BAD_INDEX);
     }
@@ -534,6 +539,7 @@ status_t HWComposer::getDeviceCompositionChanges(
     changedTypes.reserve(numTypes);
     error = hwcDisplay->getChangedCompositionTypes(&changedTypes);
     RETURN_IF_HWC_ERROR_FOR("getChangedCompositionTypes", error, displayId, BAD_INDEX);
+    displayData.tryPresentOrValidate = changedTypes.empty();
 
     auto displayRequests = static_cast<hal::DisplayRequest>(0);
     android::HWComposer::DeviceRequestedChanges::LayerRequests layerRequests;
@@ -577,6 +583,12 @@ status_t HWComposer::presentAndGetReleaseFences(DisplayId displayId) {
     auto& displayData = mDisplayData[displayId];
     auto& hwcDisplay = displayData.hwcDisplay;
 
+    if (displayData.presentedInBatch) {
+        displayData.presentedInBatch = false;
+        RETURN_IF_HWC_ERROR_FOR("present", displayData.presentError, displayId, UNKNOWN_ERROR);
+        return NO_ERROR;
+    }
+
     if (displayData.validateWasSkipped) {
         // explicitly flush all pending commands
         auto error = static_cast<hal::Error>(mComposer->executeCommands());
@@ -597,6 +609,48 @@ status_t HWComposer::presentAndGetReleaseFences(DisplayId displayId) {
     return NO_ERROR;
 }
 
+void HWComposer::presentDisplays(const std::vector<DisplayId>& displayIds) {
+    ATRACE_CALL();
+
+    // Displays which presented when they were validated are left to presentAndGetReleaseFences.
+    std::vector<DisplayId> batchedIds;
+    std::vector<hal::HWDisplayId> hwcDisplayIds;
+    for (DisplayId displayId : displayIds) {
+        const auto it = mDisplayData.find(displayId);
+        if (it == mDisplayData.end() || it->second.validateWasSkipped ||
+            !it->second.hwcDisplay->isConnected()) {
+            continue;
+        }
+        batchedIds.push_back(displayId);
+        hwcDisplayIds.push_back(it->second.hwcDisplay->getId());
+    }
+    if (batchedIds.size() < 2) {
+        return;
+    }
+
+    std::vector<int> presentFences;
+    const auto error =
+            static_cast<hal::Error>(mComposer->presentDisplays(hwcDisplayIds, &presentFences));
+
+    for (size_t i = 0; i < batchedIds.size(); i++) {
+        auto& displayData = mDisplayData[batchedIds[i]];
+        displayData.presentedInBatch = true;
+        // The error of a batch can't be attributed to one of its displays, so it is reported for
+        // those which did not return a present fence.
+        displayData.presentError =
+                presentFences[i] < 0 && error != hal::Error::NONE ? error : hal::Error::NONE;
+        if (displayData.presentError != hal::Error::NONE) {
+            continue;
+        }
+        displayData.lastPresentFence = new Fence(presentFences[i]);
+
+        // The release fences have to be read before the next command batch is executed.
+        std::unordered_map<HWC2::Layer*, sp<Fence>> releaseFences;
+        displayData.presentError = displayData.hwcDisplay->getReleaseFences(&releaseFences);
+        displayData.releaseFences = std::move(releaseFences);
+    }
+}
+
 status_t HWComposer::setPowerMode(DisplayId displayId, hal::PowerMode mode) {
     RETURN_IF_INVALID_DISPLAY(displayId, BAD_INDEX);
 
@@ -862,6 +916,17 @@ const std::unordered_map<std::string, bool>& HWComposer::getSupportedLayerGeneri
 }
 
 void HWComposer::dump(std::string& result) const {
+    for (const auto& [displayId, displayData] : mDisplayData) {
+        if (displayData.isVirtual) {
+            continue;
+        }
+        base::StringAppendF(&result,
+                            "Display %s: presentOrValidate=%" PRIu64 " validateSkipped=%" PRIu64
+                            " validate=%" PRIu64 " tryPresentOrValidate=%d\n",
+                            to_string(displayId).c_str(), displayData.presentOrValidateCount,
+                            displayData.validateSkippedCount, displayData.validateCount,
+                            displayData.tryPresentOrValidate);
+    }
     result.append(mComposer->dumpDebugInfo());
 }
 
@@ -118,6 +118,11 @@ public:
     // Present layers to the display and read releaseFences.
     virtual status_t presentAndGetReleaseFences(DisplayId displayId) = 0;
 
+    // Presents the displays, which have all been validated, with a single command batch, so that
+    // they cost one call into the HAL instead of one each. The release fences are still read by
+    // presentAndGetReleaseFences, which then does not present again.
+    virtual void presentDisplays(const std::vector<DisplayId>& displayIds) = 0;
+
     // set power mode
     virtual status_t setPowerMode(DisplayId displayId, hal::PowerMode mode) = 0;
 
@@ -265,6 +270,8 @@ public:
     // Present layers to the display and read releaseFences.
     status_t presentAndGetReleaseFences(DisplayId displayId) override;
 
+    void presentDisplays(const std::vector<DisplayId>& displayIds) override;
+
     // set power mode
     status_t setPowerMode(DisplayId displayId, hal::PowerMode mode) override;
 
@@ -391,8 +398,18 @@ private:
                 std::shared_ptr<const HWC2::Display::Config>> configMap;
 
         bool validateWasSkipped;
+        // Set by presentDisplays until presentAndGetReleaseFences is called.
+        bool presentedInBatch = false;
         hal::Error presentError;
 
+        // Cleared when validate changes the composition types we asked for, since the HWC
+        // would then validate again rather than present; set again once validate accepts
+        // them unchanged.
+        bool tryPresentOrValidate = true;
+        uint64_t presentOrValidateCount = 0;
+        uint64_t validateSkippedCount = 0;
+        uint64_t validateCount = 0;
+
         bool vsyncTraceToggle = false;
 
         std::mutex vsyncEnabledLock;
@@ -0,0 +1,90 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define ATRACE_TAG ATRACE_TAG_GRAPHICS
+
+#include "HwcControlThread.h"
+
+#include <pthread.h>
+#include <sys/resource.h>
+
+#include <system/thread_defs.h>
+#include <utils/Trace.h>
+
+namespace android {
+
+HwcControlThread::~HwcControlThread() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mExiting = true;
+        mTaskAvailable.notify_all();
+    }
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+}
+
+void HwcControlThread::start() {
+    mThread = std::thread(&HwcControlThread::threadMain, this);
+    pthread_setname_np(mThread.native_handle(), "HwcControl");
+
+    const pid_t tid = pthread_gettid_np(mThread.native_handle());
+    setpriority(PRIO_PROCESS, tid, ANDROID_PRIORITY_URGENT_DISPLAY);
+}
+
+bool HwcControlThread::isStarted() const {
+    return mThread.joinable();
+}
+
+void HwcControlThread::post(Task&& task) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mTasks.push_back(std::move(task));
+    mTaskAvailable.notify_one();
+}
+
+// std::unique_lock gives warnings with -Wthread-safety
+void HwcControlThread::waitForIdle() NO_THREAD_SAFETY_ANALYSIS {
+    ATRACE_CALL();
+    std::unique_lock<std::mutex> lock(mMutex);
+    mIdle.wait(lock, [this]() NO_THREAD_SAFETY_ANALYSIS {
+        return mTasks.empty() && !mRunningTask;
+    });
+}
+
+void HwcControlThread::threadMain() NO_THREAD_SAFETY_ANALYSIS {
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (true) {
+        mTaskAvailable.wait(lock, [this]() NO_THREAD_SAFETY_ANALYSIS {
+            return !mTasks.empty() || mExiting;
+        });
+        if (mTasks.empty()) {
+            return;
+        }
+
+        Task task = std::move(mTasks.front());
+        mTasks.pop_front();
+        mRunningTask = true;
+        lock.unlock();
+        task();
+        lock.lock();
+        mRunningTask = false;
+        if (mTasks.empty()) {
+            mIdle.notify_all();
+        }
+    }
+}
+
+} // namespace android
@@ -0,0 +1,62 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include <android-base/thread_annotations.h>
+
+namespace android {
+
+// Runs slow HWC calls, such as powering a panel on or off, in order on a thread of their own, so
+// that the main thread keeps composing the other displays meanwhile.
+class HwcControlThread {
+public:
+    using Task = std::function<void()>;
+
+    HwcControlThread() = default;
+    ~HwcControlThread();
+
+    HwcControlThread(const HwcControlThread&) = delete;
+    HwcControlThread& operator=(const HwcControlThread&) = delete;
+
+    // Starts the thread. Until then, callers are expected to run their tasks themselves.
+    void start();
+    bool isStarted() const;
+
+    void post(Task&& task);
+
+    // Returns once every task posted so far has run.
+    void waitForIdle();
+
+private:
+    void threadMain();
+
+    mutable std::mutex mMutex;
+    std::condition_variable mTaskAvailable;
+    std::condition_variable mIdle;
+    std::deque<Task> mTasks GUARDED_BY(mMutex);
+    bool mRunningTask GUARDED_BY(mMutex) = false;
+    bool mExiting GUARDED_BY(mMutex) = false;
+    std::thread mThread;
+};
+
+} // namespace android
@@ -19,6 +19,7 @@
 #undef LOG_TAG
 #define LOG_TAG "PowerAdvisor"
 
+#include <algorithm>
 #include <cinttypes>
 
 #include <android-base/properties.h>
@@ -59,6 +60,13 @@ int32_t getUpdateTimeout() {
     return timeout;
 }
 
+// The workload is hinted when the average work duration exceeds this fraction of the
+// target, or when a frame exceeds the target.
+constexpr float kWorkloadHintThreshold = 0.8f;
+// Number of frames covered by a workload hint. Hints are renewed one frame before they
+// end while the workload stays high.
+constexpr nsecs_t kWorkloadHintFrames = 4;
+
 } // namespace
 
 PowerAdvisor::PowerAdvisor()
@@ -127,6 +135,53 @@ void PowerAdvisor::notifyDisplayUpdateImminent() {
     }
 }
 
+void PowerAdvisor::setTargetWorkDuration(nsecs_t targetDuration) {
+    mTargetWorkDuration.store(targetDuration);
+}
+
+void PowerAdvisor::reportActualWorkDuration(nsecs_t actualDuration) {
+    // Only start sending this notification once the system has booted so we don't introduce an
+    // early-boot dependency on Power HAL
+    if (!mBootFinished.load()) {
+        return;
+    }
+
+    const nsecs_t targetDuration = mTargetWorkDuration.load();
+    if (targetDuration <= 0 || actualDuration <= 0) {
+        return;
+    }
+
+    mSmoothedWorkDuration = mSmoothedWorkDuration == 0
+            ? actualDuration
+            : (3 * mSmoothedWorkDuration + actualDuration) / 4;
+
+    const bool workloadHigh =
+            mSmoothedWorkDuration > targetDuration * kWorkloadHintThreshold ||
+            actualDuration > targetDuration;
+    const nsecs_t now = systemTime();
+    if (!workloadHigh || now < mWorkloadHintEnd) {
+        return;
+    }
+
+    const nsecs_t hintDuration = kWorkloadHintFrames * targetDuration;
+    {
+        std::lock_guard lock(mPowerHalMutex);
+        HalWrapper* const halWrapper = getPowerHal();
+        if (halWrapper == nullptr) {
+            return;
+        }
+
+        const int32_t durationMs = std::max(static_cast<int32_t>(ns2ms(hintDuration)), 1);
+        if (!halWrapper->notifyWorkloadIncrease(durationMs)) {
+            // The HAL has become unavailable; attempt to reconnect later
+            mReconnectPowerHal = true;
+            return;
+        }
+    }
+
+    mWorkloadHintEnd = now + hintDuration - targetDuration;
+}
+
 class HidlPowerHalWrapper : public PowerAdvisor::HalWrapper {
 public:
     HidlPowerHalWrapper(sp<V1_3::IPower> powerHal) : mPowerHal(std::move(powerHal)) {}
@@ -169,6 +224,12 @@ public:
         return true;
     }
 
+    bool notifyWorkloadIncrease(int32_t durationMs) override {
+        ALOGV("HIDL notifyWorkloadIncrease %" PRId32 "ms", durationMs);
+        auto ret = mPowerHal->powerHintAsync_1_3(PowerHint::INTERACTION, durationMs);
+        return ret.isOk();
+    }
+
 private:
     const sp<V1_3::IPower> mPowerHal = nullptr;
 };
@@ -186,6 +247,11 @@ public:
         if (!ret.isOk()) {
             mHasDisplayUpdateImminent = false;
         }
+
+        ret = mPowerHal->isBoostSupported(Boost::INTERACTION, &mHasInteraction);
+        if (!ret.isOk()) {
+            mHasInteraction = false;
+        }
     }
 
     ~AidlPowerHalWrapper() override = default;
@@ -223,10 +289,22 @@ public:
         return ret.isOk();
     }
 
+    bool notifyWorkloadIncrease(int32_t durationMs) override {
+        ALOGV("AIDL notifyWorkloadIncrease %" PRId32 "ms", durationMs);
+        if (!mHasInteraction) {
+            ALOGV("Skipped sending INTERACTION because HAL doesn't support it");
+            return true;
+        }
+
+        auto ret = mPowerHal->setBoost(Boost::INTERACTION, durationMs);
+        return ret.isOk();
+    }
+
 private:
     const sp<IPower> mPowerHal = nullptr;
     bool mHasExpensiveRendering = false;
     bool mHasDisplayUpdateImminent = false;
+    bool mHasInteraction = false;
 };
 
 PowerAdvisor::HalWrapper* PowerAdvisor::getPowerHal() {
@@ -20,6 +20,7 @@
 #include <unordered_set>
 
 #include <utils/Mutex.h>
+#include <utils/Timers.h>
 
 #include "../Scheduler/OneShotTimer.h"
 #include "DisplayIdentification.h"
@@ -34,6 +35,11 @@ public:
     virtual void onBootFinished() = 0;
     virtual void setExpensiveRenderingExpected(DisplayId displayId, bool expected) = 0;
     virtual void notifyDisplayUpdateImminent() = 0;
+    // Sets the duration within which the work of a frame is expected to complete.
+    virtual void setTargetWorkDuration(nsecs_t targetDuration) = 0;
+    // Reports the duration of the work of a frame, from its start to the end of its
+    // composition, so that the power HAL can be hinted before frames are missed.
+    virtual void reportActualWorkDuration(nsecs_t actualDuration) = 0;
 };
 
 namespace impl {
@@ -48,6 +54,7 @@ public:
 
         virtual bool setExpensiveRendering(bool enabled) = 0;
         virtual bool notifyDisplayUpdateImminent() = 0;
+        virtual bool notifyWorkloadIncrease(int32_t durationMs) = 0;
     };
 
     PowerAdvisor();
@@ -56,6 +63,8 @@ public:
     void onBootFinished() override;
     void setExpensiveRenderingExpected(DisplayId displayId, bool expected) override;
     void notifyDisplayUpdateImminent() override;
+    void setTargetWorkDuration(nsecs_t targetDuration) override;
+    void reportActualWorkDuration(nsecs_t actualDuration) override;
 
 private:
     HalWrapper* getPowerHal() REQUIRES(mPowerHalMutex);
@@ -70,6 +79,12 @@ private:
     const bool mUseUpdateImminentTimer;
     std::atomic_bool mSendUpdateImminent = true;
     scheduler::OneShotTimer mUpdateImminentTimer;
+
+    std::atomic<nsecs_t> mTargetWorkDuration = 0;
+    // Moving average of the reported work durations.
+    nsecs_t mSmoothedWorkDuration = 0;
+    // Time until which the last workload hint lasts.
+    nsecs_t mWorkloadHintEnd = 0;
 };
 
 } // namespace impl
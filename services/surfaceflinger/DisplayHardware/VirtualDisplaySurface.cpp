@@ -30,6 +30,7 @@
 #include <gui/BufferQueue.h>
 #include <gui/IProducerListener.h>
 #include <system/window.h>
+#include <ui/PixelFormat.h>
 
 // ---------------------------------------------------------------------------
 namespace android {
@@ -115,6 +116,12 @@ VirtualDisplaySurface::VirtualDisplaySurface(HWComposer& hwc,
     }
     mOutputFormat = mDefaultOutputFormat;
 
+    // The HWC copy only pays off when it converts to a format the GPU does not render to. A sink
+    // which asks for an RGB format gets the GPU output directly.
+    if (mForceHwcCopy && bytesPerPixel(mDefaultOutputFormat) != 0) {
+        mForceHwcCopy = false;
+    }
+
     ConsumerBase::mName = String8::format("VDS: %s", mDisplayName.c_str());
     mConsumer->setConsumerName(ConsumerBase::mName);
     mConsumer->setConsumerUsageBits(GRALLOC_USAGE_HW_COMPOSER);
@@ -125,6 +132,7 @@ VirtualDisplaySurface::VirtualDisplaySurface(HWComposer& hwc,
 }
 
 VirtualDisplaySurface::~VirtualDisplaySurface() {
+    releaseKeptOutputBuffer();
     mSource[SOURCE_SCRATCH]->disconnect(NATIVE_WINDOW_API_EGL);
 }
 
@@ -143,6 +151,11 @@ status_t VirtualDisplaySurface::beginFrame(bool mustRecompose) {
             "Unexpected beginFrame() in %s state", dbgStateStr());
     mDbgState = DBG_STATE_BEGUN;
 
+    if (mOutputProducerSlot >= 0) {
+        // Reuse the output buffer kept from the previous frame, which wasn't recomposed.
+        return mHwc.setOutputBuffer(*mDisplayId, Fence::NO_FENCE,
+                                    mProducerBuffers[mOutputProducerSlot]);
+    }
     return refreshOutputBuffer();
 }
 
@@ -265,6 +278,7 @@ void VirtualDisplaySurface::onFrameCommitted() {
         releaseBufferLocked(sslot, mProducerBuffers[mFbProducerSlot]);
     }
 
+    bool keepOutputBuffer = false;
     if (mOutputProducerSlot >= 0) {
         int sslot = mapProducer2SourceSlot(SOURCE_SINK, mOutputProducerSlot);
         QueueBufferOutput qbo;
@@ -284,19 +298,28 @@ void VirtualDisplaySurface::onFrameCommitted() {
         } else {
             // If the surface hadn't actually been updated, then we only went
             // through the motions of updating the display to keep our state
-            // machine happy. We cancel the buffer to avoid triggering another
-            // re-composition and causing an infinite loop.
-            mSource[SOURCE_SINK]->cancelBuffer(sslot, retireFence);
+            // machine happy. We don't queue the buffer to avoid triggering
+            // another re-composition and causing an infinite loop. Instead of
+            // cancelling it, we keep it for the next frame, which saves a
+            // dequeue and cancel from the sink on every skipped frame.
+            VDS_LOGV("onFrameCommitted: keep sink sslot=%d", sslot);
+            keepOutputBuffer = true;
         }
     }
 
+    const int keptOutputProducerSlot = mOutputProducerSlot;
     resetPerFrameState();
+    if (keepOutputBuffer) {
+        mOutputProducerSlot = keptOutputProducerSlot;
+        mOutputFence = retireFence;
+    }
 }
 
 void VirtualDisplaySurface::dumpAsString(String8& /* result */) const {
 }
 
 void VirtualDisplaySurface::resizeBuffers(const uint32_t w, const uint32_t h) {
+    releaseKeptOutputBuffer();
     mQueueBufferOutput.width = w;
     mQueueBufferOutput.height = h;
     mSinkBufferWidth = w;
@@ -641,6 +664,16 @@ void VirtualDisplaySurface::resetPerFrameState() {
     mFbProducerSlot = -1;
 }
 
+void VirtualDisplaySurface::releaseKeptOutputBuffer() {
+    if (mDbgState != DBG_STATE_IDLE || mOutputProducerSlot < 0) {
+        return;
+    }
+    mSource[SOURCE_SINK]->cancelBuffer(mapProducer2SourceSlot(SOURCE_SINK, mOutputProducerSlot),
+                                       mOutputFence);
+    mOutputProducerSlot = -1;
+    mOutputFence = Fence::NO_FENCE;
+}
+
 status_t VirtualDisplaySurface::refreshOutputBuffer() {
     LOG_FATAL_IF(!mDisplayId);
 
@@ -143,6 +143,8 @@ private:
     void updateQueueBufferOutput(QueueBufferOutput&& qbo);
     void resetPerFrameState();
     status_t refreshOutputBuffer();
+    // Cancels the output buffer kept from the last frame, if any, back to the sink.
+    void releaseKeptOutputBuffer();
 
     // Both the sink and scratch buffer pools have their own set of slots
     // ("source slots", or "sslot"). We have to merge these into the single
@@ -210,7 +212,9 @@ private:
     sp<Fence> mOutputFence;
 
     // Producer slot numbers for the buffers to use for HWC framebuffer target
-    // and output.
+    // and output. If a frame isn't recomposed, its output buffer is kept
+    // dequeued for the next frame, so mOutputProducerSlot and mOutputFence
+    // may also be valid between frames.
     int mFbProducerSlot;
     int mOutputProducerSlot;
 
@@ -0,0 +1,286 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#undef LOG_TAG
+#define LOG_TAG "FrameTimeline"
+#define ATRACE_TAG ATRACE_TAG_GRAPHICS
+
+#include "FrameTimeline.h"
+
+#include <android-base/stringprintf.h>
+#include <utils/Trace.h>
+
+#include <algorithm>
+#include <cinttypes>
+
+#include "TimeStats/TimeStats.h"
+
+namespace android::frametimeline {
+
+using base::StringAppendF;
+using base::StringPrintf;
+
+namespace {
+
+// Returns the signal time of a fence, or -1 if it has no fence. Returns
+// Fence::SIGNAL_TIME_PENDING if it has not signaled yet.
+nsecs_t getSignalTime(const std::shared_ptr<FenceTime>& fence) {
+    if (!fence || !fence->isValid()) return -1;
+    const nsecs_t signalTime = fence->getSignalTime();
+    return signalTime == Fence::SIGNAL_TIME_INVALID ? -1 : signalTime;
+}
+
+float relativeMs(nsecs_t time, nsecs_t reference) {
+    return time < 0 ? -1.0f : (time - reference) / 1e6f;
+}
+
+} // namespace
+
+std::string jankTypeBitmaskToString(int32_t jankType) {
+    if (jankType == JankType::None) return "None";
+
+    static const std::pair<int32_t, const char*> kNames[] = {
+            {JankType::AppDeadlineMissed, "App Deadline Missed"},
+            {JankType::SurfaceFlingerCpuDeadlineMissed, "SurfaceFlinger CPU Deadline Missed"},
+            {JankType::SurfaceFlingerGpuDeadlineMissed, "SurfaceFlinger GPU Deadline Missed"},
+            {JankType::DisplayHal, "Display HAL"},
+            {JankType::BufferStuffing, "Buffer Stuffing"},
+            {JankType::Unknown, "Unknown jank"},
+    };
+
+    std::string result;
+    for (const auto& [type, name] : kNames) {
+        if (!(jankType & type)) continue;
+        if (!result.empty()) result.append(", ");
+        result.append(name);
+    }
+    return result;
+}
+
+FrameTimeline::FrameTimeline(std::shared_ptr<TimeStats> timeStats,
+                             JankClassificationThresholds thresholds)
+      : mTimeStats(std::move(timeStats)), mThresholds(thresholds) {}
+
+void FrameTimeline::onBufferQueued(int32_t layerId, uid_t ownerUid, const std::string& layerName,
+                                   uint64_t frameNumber, nsecs_t postTime,
+                                   nsecs_t desiredPresentTime,
+                                   std::shared_ptr<FenceTime> acquireFence) {
+    std::lock_guard lock(mMutex);
+    auto& pending = mPendingSurfaceFrames[layerId];
+    if (pending.size() >= kMaxPendingSurfaceFrames) {
+        pending.pop_front();
+    }
+
+    SurfaceFrame surfaceFrame;
+    surfaceFrame.layerId = layerId;
+    surfaceFrame.ownerUid = ownerUid;
+    surfaceFrame.layerName = layerName;
+    surfaceFrame.frameNumber = frameNumber;
+    surfaceFrame.postTime = postTime;
+    surfaceFrame.desiredPresentTime = std::max<nsecs_t>(desiredPresentTime, 0);
+    if (acquireFence) {
+        surfaceFrame.acquireFence = std::move(acquireFence);
+    }
+    pending.push_back(std::move(surfaceFrame));
+}
+
+int64_t FrameTimeline::onSfWakeUp(nsecs_t expectedStartTime, nsecs_t expectedPresentTime,
+                                  nsecs_t actualStartTime) {
+    std::lock_guard lock(mMutex);
+    // Frames are classified long before they are evicted, unless their fence never signals.
+    while (mDisplayFrames.size() >= kMaxDisplayFrames) {
+        mDisplayFrames.pop_front();
+    }
+
+    DisplayFrame& displayFrame = mDisplayFrames.emplace_back();
+    displayFrame.vsyncId = mNextVsyncId++;
+    displayFrame.expectedStartTime = expectedStartTime;
+    displayFrame.expectedPresentTime = expectedPresentTime;
+    displayFrame.actualStartTime = actualStartTime;
+    mCurrentFrameOpen = true;
+
+    ATRACE_INT64("FrameTimelineVsyncId", displayFrame.vsyncId);
+    return displayFrame.vsyncId;
+}
+
+void FrameTimeline::onBufferLatched(int32_t layerId, uint64_t frameNumber) {
+    std::lock_guard lock(mMutex);
+    const auto it = mPendingSurfaceFrames.find(layerId);
+    if (it == mPendingSurfaceFrames.end()) return;
+
+    auto& pending = it->second;
+    while (!pending.empty() && pending.front().frameNumber < frameNumber) {
+        pending.pop_front();
+    }
+    if (pending.empty() || pending.front().frameNumber != frameNumber) return;
+
+    if (mCurrentFrameOpen) {
+        mDisplayFrames.back().surfaceFrames.push_back(std::move(pending.front()));
+    }
+    pending.pop_front();
+}
+
+void FrameTimeline::setSfPresent(nsecs_t cpuEndTime, std::shared_ptr<FenceTime> gpuFence,
+                                 std::shared_ptr<FenceTime> presentFence) {
+    std::lock_guard lock(mMutex);
+    if (mCurrentFrameOpen) {
+        DisplayFrame& displayFrame = mDisplayFrames.back();
+        displayFrame.presented = true;
+        displayFrame.cpuEndTime = cpuEndTime;
+        if (gpuFence) displayFrame.gpuFence = std::move(gpuFence);
+        if (presentFence) displayFrame.presentFence = std::move(presentFence);
+        mCurrentFrameOpen = false;
+    }
+
+    flushPendingPresentFencesLocked();
+}
+
+void FrameTimeline::onDestroy(int32_t layerId) {
+    std::lock_guard lock(mMutex);
+    mPendingSurfaceFrames.erase(layerId);
+}
+
+void FrameTimeline::flushPendingPresentFencesLocked() {
+    // Present fences signal in order, so stop at the first one still pending.
+    for (auto& displayFrame : mDisplayFrames) {
+        if (!displayFrame.presented || displayFrame.classified) continue;
+        if (getSignalTime(displayFrame.presentFence) == Fence::SIGNAL_TIME_PENDING) break;
+
+        classifyLocked(displayFrame);
+    }
+}
+
+void FrameTimeline::classifyLocked(DisplayFrame& displayFrame) {
+    displayFrame.classified = true;
+    displayFrame.actualPresentTime = getSignalTime(displayFrame.presentFence);
+    // Without a present fence there is nothing to classify against.
+    if (displayFrame.actualPresentTime < 0) return;
+
+    const nsecs_t gpuEndTime = getSignalTime(displayFrame.gpuFence);
+    displayFrame.gpuEndTime = gpuEndTime == Fence::SIGNAL_TIME_PENDING ? -1 : gpuEndTime;
+
+    const nsecs_t deadline = displayFrame.expectedPresentTime;
+    if (displayFrame.actualPresentTime > deadline + mThresholds.presentThreshold) {
+        int32_t jankType = JankType::None;
+        if (displayFrame.actualStartTime >
+                    displayFrame.expectedStartTime + mThresholds.startThreshold ||
+            displayFrame.cpuEndTime > deadline) {
+            jankType |= JankType::SurfaceFlingerCpuDeadlineMissed;
+        }
+        if (displayFrame.gpuEndTime > deadline) {
+            jankType |= JankType::SurfaceFlingerGpuDeadlineMissed;
+        }
+        displayFrame.jankType = jankType == JankType::None ? JankType::DisplayHal : jankType;
+    }
+
+    if (mTimeStats) {
+        mTimeStats->incrementJankyFrames(displayFrame.jankType);
+    }
+    if (displayFrame.jankType != JankType::None && ATRACE_ENABLED()) {
+        ATRACE_NAME(StringPrintf("Jank vsyncId=%" PRId64 " %s", displayFrame.vsyncId,
+                                 jankTypeBitmaskToString(displayFrame.jankType).c_str())
+                            .c_str());
+    }
+
+    for (auto& surfaceFrame : displayFrame.surfaceFrames) {
+        surfaceFrame.jankType = classifySurfaceFrameLocked(displayFrame, surfaceFrame);
+        if (mTimeStats) {
+            mTimeStats->incrementJankyFrames(surfaceFrame.layerName, surfaceFrame.jankType);
+        }
+        if (surfaceFrame.jankType != JankType::None && ATRACE_ENABLED()) {
+            ATRACE_NAME(StringPrintf("Jank %s frame=%" PRIu64 " expectedVsyncId=%" PRId64
+                                     " vsyncId=%" PRId64 " %s",
+                                     surfaceFrame.layerName.c_str(), surfaceFrame.frameNumber,
+                                     surfaceFrame.expectedVsyncId, displayFrame.vsyncId,
+                                     jankTypeBitmaskToString(surfaceFrame.jankType).c_str())
+                                .c_str());
+        }
+    }
+}
+
+int32_t FrameTimeline::classifySurfaceFrameLocked(const DisplayFrame& displayFrame,
+                                                  SurfaceFrame& surfaceFrame) const {
+    surfaceFrame.actualPresentTime = displayFrame.actualPresentTime;
+    surfaceFrame.readyTime =
+            std::max(surfaceFrame.postTime, getSignalTime(surfaceFrame.acquireFence));
+
+    // The buffer was expected in the first wakeup after it was queued that targeted a present
+    // time no earlier than the one the app asked for.
+    const auto expected =
+            std::find_if(mDisplayFrames.begin(), mDisplayFrames.end(), [&](const auto& frame) {
+                return frame.actualStartTime >= surfaceFrame.postTime &&
+                        frame.expectedPresentTime + mThresholds.presentThreshold >=
+                        surfaceFrame.desiredPresentTime;
+            });
+
+    // Whatever delayed the display frame delayed the buffer as well.
+    int32_t jankType = displayFrame.jankType;
+    if (expected == mDisplayFrames.end() || expected->vsyncId >= displayFrame.vsyncId) {
+        surfaceFrame.expectedVsyncId = displayFrame.vsyncId;
+        return jankType;
+    }
+
+    surfaceFrame.expectedVsyncId = expected->vsyncId;
+    if (surfaceFrame.readyTime > expected->actualStartTime) {
+        jankType |= JankType::AppDeadlineMissed;
+    } else if (std::any_of(expected->surfaceFrames.begin(), expected->surfaceFrames.end(),
+                           [&](const auto& frame) {
+                               return frame.layerId == surfaceFrame.layerId;
+                           })) {
+        jankType |= JankType::BufferStuffing;
+    } else {
+        jankType |= JankType::Unknown;
+    }
+    return jankType;
+}
+
+void FrameTimeline::dump(std::string& result) const {
+    std::lock_guard lock(mMutex);
+    StringAppendF(&result, "FrameTimeline: %zu display frames, %zu layers with pending buffers\n",
+                  mDisplayFrames.size(), mPendingSurfaceFrames.size());
+    StringAppendF(&result, "  times in ms relative to the expected start\n");
+    for (const auto& displayFrame : mDisplayFrames) {
+        if (!displayFrame.classified || displayFrame.actualPresentTime < 0) continue;
+
+        const nsecs_t start = displayFrame.expectedStartTime;
+        StringAppendF(&result,
+                      "  vsyncId=%" PRId64 " expectedPresent=%.3f actualStart=%.3f "
+                      "cpuEnd=%.3f gpuEnd=%.3f actualPresent=%.3f jank=%s\n",
+                      displayFrame.vsyncId, relativeMs(displayFrame.expectedPresentTime, start),
+                      relativeMs(displayFrame.actualStartTime, start),
+                      relativeMs(displayFrame.cpuEndTime, start),
+                      relativeMs(displayFrame.gpuEndTime, start),
+                      relativeMs(displayFrame.actualPresentTime, start),
+                      jankTypeBitmaskToString(displayFrame.jankType).c_str());
+        for (const auto& surfaceFrame : displayFrame.surfaceFrames) {
+            StringAppendF(&result,
+                          "    %s uid=%d frame=%" PRIu64 " post=%.3f ready=%.3f "
+                          "expectedVsyncId=%" PRId64 " jank=%s\n",
+                          surfaceFrame.layerName.c_str(), static_cast<int>(surfaceFrame.ownerUid),
+                          surfaceFrame.frameNumber, relativeMs(surfaceFrame.postTime, start),
+                          relativeMs(surfaceFrame.readyTime, start), surfaceFrame.expectedVsyncId,
+                          jankTypeBitmaskToString(surfaceFrame.jankType).c_str());
+        }
+    }
+}
+
+std::vector<FrameTimeline::DisplayFrame> FrameTimeline::getDisplayFrames() const {
+    std::lock_guard lock(mMutex);
+    return {mDisplayFrames.begin(), mDisplayFrames.end()};
+}
+
+} // namespace android::frametimeline
@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <android-base/thread_annotations.h>
+#include <timestatsproto/TimeStatsHelper.h>
+#include <ui/FenceTime.h>
+#include <utils/Timers.h>
+
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace android {
+
+class TimeStats;
+
+namespace frametimeline {
+
+using JankType = surfaceflinger::TimeStatsHelper::JankType;
+
+// Returns a readable form of a JankType bitmask, e.g. "App Deadline Missed, Display HAL".
+std::string jankTypeBitmaskToString(int32_t jankType);
+
+// Lateness below these thresholds is considered scheduling noise rather than jank.
+struct JankClassificationThresholds {
+    // How late a present fence may signal past the expected present time.
+    nsecs_t presentThreshold = std::chrono::nanoseconds(std::chrono::milliseconds(2)).count();
+    // How late SurfaceFlinger may wake up past its expected start time.
+    nsecs_t startThreshold = std::chrono::nanoseconds(std::chrono::milliseconds(2)).count();
+};
+
+// Tracks, for each SurfaceFlinger wakeup, when the display frame was expected to start and
+// present against when it actually did, along with the layer frames it presented. Once the
+// present fence signals, late frames are attributed to the stage that made them late, and the
+// result is reported to TimeStats and systrace.
+class FrameTimeline {
+public:
+    static constexpr int64_t kInvalidVsyncId = -1;
+
+    // A buffer queued by an app, from queue to present.
+    struct SurfaceFrame {
+        int32_t layerId = 0;
+        uid_t ownerUid = 0;
+        std::string layerName;
+        uint64_t frameNumber = 0;
+        nsecs_t postTime = 0;
+        // Zero when the buffer should be presented as soon as possible.
+        nsecs_t desiredPresentTime = 0;
+        std::shared_ptr<FenceTime> acquireFence = FenceTime::NO_FENCE;
+
+        // Filled in when the display frame presenting the buffer is classified.
+        int64_t expectedVsyncId = kInvalidVsyncId;
+        nsecs_t readyTime = -1;
+        nsecs_t actualPresentTime = -1;
+        int32_t jankType = JankType::None;
+    };
+
+    // A single SurfaceFlinger wakeup. Wakeups that composite nothing are kept as well, so that
+    // buffers can be matched against the frame they were expected to make.
+    struct DisplayFrame {
+        int64_t vsyncId = kInvalidVsyncId;
+        nsecs_t expectedStartTime = 0;
+        nsecs_t expectedPresentTime = 0;
+        nsecs_t actualStartTime = 0;
+
+        bool presented = false;
+        nsecs_t cpuEndTime = -1;
+        std::shared_ptr<FenceTime> gpuFence = FenceTime::NO_FENCE;
+        std::shared_ptr<FenceTime> presentFence = FenceTime::NO_FENCE;
+
+        // Filled in once the present fence has signaled.
+        bool classified = false;
+        nsecs_t gpuEndTime = -1;
+        nsecs_t actualPresentTime = -1;
+        int32_t jankType = JankType::None;
+        std::vector<SurfaceFrame> surfaceFrames;
+    };
+
+    explicit FrameTimeline(std::shared_ptr<TimeStats> timeStats,
+                           JankClassificationThresholds thresholds = {});
+    ~FrameTimeline() = default;
+
+    // Called when an app queues a buffer, from any thread.
+    void onBufferQueued(int32_t layerId, uid_t ownerUid, const std::string& layerName,
+                        uint64_t frameNumber, nsecs_t postTime, nsecs_t desiredPresentTime,
+                        std::shared_ptr<FenceTime> acquireFence);
+    // Starts a new display frame and returns its vsync id.
+    int64_t onSfWakeUp(nsecs_t expectedStartTime, nsecs_t expectedPresentTime,
+                       nsecs_t actualStartTime);
+    // Called for each buffer latched into the current display frame. Older buffers still
+    // pending for the layer were dropped and are forgotten.
+    void onBufferLatched(int32_t layerId, uint64_t frameNumber);
+    // Ends the current display frame, and classifies earlier frames whose fences have signaled.
+    void setSfPresent(nsecs_t cpuEndTime, std::shared_ptr<FenceTime> gpuFence,
+                      std::shared_ptr<FenceTime> presentFence);
+    void onDestroy(int32_t layerId);
+
+    void dump(std::string& result) const;
+
+    std::vector<DisplayFrame> getDisplayFrames() const;
+
+private:
+    static constexpr size_t kMaxDisplayFrames = 64;
+    static constexpr size_t kMaxPendingSurfaceFrames = 16;
+
+    void flushPendingPresentFencesLocked() REQUIRES(mMutex);
+    void classifyLocked(DisplayFrame& displayFrame) REQUIRES(mMutex);
+    int32_t classifySurfaceFrameLocked(const DisplayFrame& displayFrame,
+                                       SurfaceFrame& surfaceFrame) const REQUIRES(mMutex);
+
+    const std::shared_ptr<TimeStats> mTimeStats;
+    const JankClassificationThresholds mThresholds;
+
+    mutable std::mutex mMutex;
+    int64_t mNextVsyncId GUARDED_BY(mMutex) = 0;
+    bool mCurrentFrameOpen GUARDED_BY(mMutex) = false;
+    std::deque<DisplayFrame> mDisplayFrames GUARDED_BY(mMutex);
+    std::unordered_map<int32_t, std::deque<SurfaceFrame>> mPendingSurfaceFrames
+            GUARDED_BY(mMutex);
+};
+
+} // namespace frametimeline
+} // namespace android
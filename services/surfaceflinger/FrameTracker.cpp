@@ -23,9 +23,12 @@
 
 #include <inttypes.h>
 
+#include <algorithm>
+
 #include <android-base/stringprintf.h>
 #include <android/log.h>
 
+#include <ui/FenceWatcher.h>
 #include <ui/FrameStats.h>
 
 #include "FrameTracker.h"
@@ -35,11 +38,28 @@ namespace android {
 
 FrameTracker::FrameTracker() :
         mOffset(0),
+        mFrameNumber(0),
         mNumFences(0),
         mDisplayPeriod(0) {
     resetFrameCountersLocked();
 }
 
+FrameTracker::~FrameTracker() {
+    if (mWatcherLink) {
+        std::lock_guard lock(mWatcherLink->mutex);
+        mWatcherLink->tracker = nullptr;
+    }
+}
+
+void FrameTracker::setFenceWatcher(FenceWatcher* fenceWatcher) {
+    Mutex::Autolock lock(mMutex);
+    mFenceWatcher = fenceWatcher;
+    if (mFenceWatcher && !mWatcherLink) {
+        mWatcherLink = std::make_shared<WatcherLink>();
+        mWatcherLink->tracker = this;
+    }
+}
+
 void FrameTracker::setDesiredPresentTime(nsecs_t presentTime) {
     Mutex::Autolock lock(mMutex);
     mFrameRecords[mOffset].desiredPresentTime = presentTime;
@@ -55,6 +75,7 @@ void FrameTracker::setFrameReadyFence(
     Mutex::Autolock lock(mMutex);
     mFrameRecords[mOffset].frameReadyFence = std::move(readyFence);
     mNumFences++;
+    watchFenceLocked(mFrameRecords[mOffset].frameReadyFence);
 }
 
 void FrameTracker::setActualPresentTime(nsecs_t presentTime) {
@@ -67,6 +88,7 @@ void FrameTracker::setActualPresentFence(
     Mutex::Autolock lock(mMutex);
     mFrameRecords[mOffset].actualPresentFence = std::move(readyFence);
     mNumFences++;
+    watchFenceLocked(mFrameRecords[mOffset].actualPresentFence);
 }
 
 void FrameTracker::setDisplayRefreshPeriod(nsecs_t displayPeriod) {
@@ -77,11 +99,19 @@ void FrameTracker::setDisplayRefreshPeriod(nsecs_t displayPeriod) {
 void FrameTracker::advanceFrame() {
     Mutex::Autolock lock(mMutex);
 
+    // The fences of the frame we just finished may have signaled already, in
+    // which case the watcher did not process its record.
+    if (mFenceWatcher) {
+        processRecordFencesLocked(mOffset);
+    }
+
     // Update the statistic to include the frame we just finished.
     updateStatsLocked(mOffset);
 
     // Advance to the next frame.
     mOffset = (mOffset+1) % NUM_FRAME_RECORDS;
+    mFrameNumber++;
+    mFrameRecords[mOffset].frameNumber = mFrameNumber;
     mFrameRecords[mOffset].desiredPresentTime = INT64_MAX;
     mFrameRecords[mOffset].frameReadyTime = INT64_MAX;
     mFrameRecords[mOffset].actualPresentTime = INT64_MAX;
@@ -142,6 +172,35 @@ void FrameTracker::getStats(FrameStats* outStats) const {
     }
 }
 
+void FrameTracker::getStatsSince(uint64_t frameNumber, FrameStats* outStats,
+                                 uint64_t* outNextFrameNumber) const {
+    Mutex::Autolock lock(mMutex);
+    processFencesLocked();
+
+    outStats->refreshPeriodNano = mDisplayPeriod;
+
+    // The current frame is still being set, so stop before it.
+    const uint64_t oldestFrameNumber =
+            mFrameNumber >= NUM_FRAME_RECORDS - 1 ? mFrameNumber - (NUM_FRAME_RECORDS - 1) : 0;
+    uint64_t next = std::max(frameNumber, oldestFrameNumber);
+    for (; next < mFrameNumber; next++) {
+        const FrameRecord& record = mFrameRecords[next % NUM_FRAME_RECORDS];
+        if (record.frameReadyFence != nullptr || record.actualPresentFence != nullptr) {
+            break;
+        }
+
+        // Skip frame records cleared by clearStats.
+        if (record.desiredPresentTime == 0) {
+            continue;
+        }
+
+        outStats->desiredPresentTimesNano.push_back(record.desiredPresentTime);
+        outStats->actualPresentTimesNano.push_back(record.actualPresentTime);
+        outStats->frameReadyTimesNano.push_back(record.frameReadyTime);
+    }
+    *outNextFrameNumber = next;
+}
+
 void FrameTracker::logAndResetStats(const std::string_view& name) {
     Mutex::Autolock lock(mMutex);
     logStatsLocked(name);
@@ -149,37 +208,65 @@ void FrameTracker::logAndResetStats(const std::string_view& name) {
 }
 
 void FrameTracker::processFencesLocked() const {
+    for (int i = 1; i < NUM_FRAME_RECORDS && mNumFences > 0; i++) {
+        size_t idx = (mOffset+NUM_FRAME_RECORDS-i) % NUM_FRAME_RECORDS;
+        if (processRecordFencesLocked(idx)) {
+            updateStatsLocked(idx);
+        }
+    }
+}
+
+bool FrameTracker::processRecordFencesLocked(size_t idx) const {
     FrameRecord* records = const_cast<FrameRecord*>(mFrameRecords);
     int& numFences = const_cast<int&>(mNumFences);
-
-    for (int i = 1; i < NUM_FRAME_RECORDS && numFences > 0; i++) {
-        size_t idx = (mOffset+NUM_FRAME_RECORDS-i) % NUM_FRAME_RECORDS;
-        bool updated = false;
-
-        const std::shared_ptr<FenceTime>& rfence = records[idx].frameReadyFence;
-        if (rfence != nullptr) {
-            records[idx].frameReadyTime = rfence->getSignalTime();
-            if (records[idx].frameReadyTime < INT64_MAX) {
-                records[idx].frameReadyFence = nullptr;
-                numFences--;
-                updated = true;
-            }
+    bool updated = false;
+
+    const std::shared_ptr<FenceTime>& rfence = records[idx].frameReadyFence;
+    if (rfence != nullptr) {
+        records[idx].frameReadyTime = rfence->getSignalTime();
+        if (records[idx].frameReadyTime < INT64_MAX) {
+            records[idx].frameReadyFence = nullptr;
+            numFences--;
+            updated = true;
         }
+    }
 
-        const std::shared_ptr<FenceTime>& pfence =
-                records[idx].actualPresentFence;
-        if (pfence != nullptr) {
-            records[idx].actualPresentTime = pfence->getSignalTime();
-            if (records[idx].actualPresentTime < INT64_MAX) {
-                records[idx].actualPresentFence = nullptr;
-                numFences--;
-                updated = true;
-            }
+    const std::shared_ptr<FenceTime>& pfence =
+            records[idx].actualPresentFence;
+    if (pfence != nullptr) {
+        records[idx].actualPresentTime = pfence->getSignalTime();
+        if (records[idx].actualPresentTime < INT64_MAX) {
+            records[idx].actualPresentFence = nullptr;
+            numFences--;
+            updated = true;
         }
+    }
 
-        if (updated) {
-            updateStatsLocked(idx);
+    return updated;
+}
+
+void FrameTracker::watchFenceLocked(const std::shared_ptr<FenceTime>& fence) {
+    if (!mFenceWatcher) {
+        return;
+    }
+    mFenceWatcher->watch(fence, [link = mWatcherLink, frameNumber = mFrameNumber]() {
+        std::lock_guard lock(link->mutex);
+        if (link->tracker) {
+            link->tracker->onFenceSignaled(frameNumber);
         }
+    });
+}
+
+void FrameTracker::onFenceSignaled(uint64_t frameNumber) {
+    Mutex::Autolock lock(mMutex);
+    // The record is still being set if the frame is current, and has been
+    // reused if it is older than the records kept.
+    const size_t idx = frameNumber % NUM_FRAME_RECORDS;
+    if (frameNumber == mFrameNumber || mFrameRecords[idx].frameNumber != frameNumber) {
+        return;
+    }
+    if (processRecordFencesLocked(idx)) {
+        updateStatsLocked(idx);
     }
 }
 
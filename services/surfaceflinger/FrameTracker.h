@@ -22,10 +22,14 @@
 #include <utils/Timers.h>
 
 #include <cstddef>
+#include <memory>
+#include <mutex>
 #include <string_view>
 
 namespace android {
 
+class FenceWatcher;
+
 // FrameTracker tracks information about the most recently rendered frames. It
 // uses a circular buffer of frame records, and is *NOT* thread-safe -
 // mutexing must be done at a higher level if multi-threaded access is
@@ -34,6 +38,10 @@ namespace android {
 // Some of the time values tracked may be set either as a specific timestamp
 // or a fence.  When a non-nullptr fence is set for a given time value, the
 // signal time of that fence is used instead of the timestamp.
+//
+// If a FenceWatcher is set, the fences are handed to it and each frame record
+// is completed as soon as its fences signal, rather than when the stats are
+// next read.
 class FrameTracker {
 
 public:
@@ -44,6 +52,11 @@ public:
     enum { NUM_FRAME_BUCKETS = 7 };
 
     FrameTracker();
+    ~FrameTracker();
+
+    // setFenceWatcher sets the watcher that the fences set from now on are
+    // handed to. The watcher must outlive the FrameTracker.
+    void setFenceWatcher(FenceWatcher* fenceWatcher);
 
     // setDesiredPresentTime sets the time at which the current frame
     // should be presented to the user under ideal (i.e. zero latency)
@@ -82,6 +95,15 @@ public:
     // getStats gets the tracked frame stats.
     void getStats(FrameStats* outStats) const;
 
+    // getStatsSince gets the stats of the completed frames numbered from
+    // frameNumber on, in order, stopping at the first frame which still waits
+    // on a fence. outNextFrameNumber is set to the number of the frame to
+    // read next. Frames are numbered from 0 as they are advanced, and only the
+    // last NUM_FRAME_RECORDS - 1 frames are kept, so reading at least that
+    // often streams every frame; older frames are skipped.
+    void getStatsSince(uint64_t frameNumber, FrameStats* outStats,
+                       uint64_t* outNextFrameNumber) const;
+
     // logAndResetStats dumps the current statistics to the binary event log
     // and then resets the accumulated statistics to their initial values.
     void logAndResetStats(const std::string_view& name);
@@ -92,9 +114,11 @@ public:
 private:
     struct FrameRecord {
         FrameRecord() :
+            frameNumber(0),
             desiredPresentTime(0),
             frameReadyTime(0),
             actualPresentTime(0) {}
+        uint64_t frameNumber;
         nsecs_t desiredPresentTime;
         nsecs_t frameReadyTime;
         nsecs_t actualPresentTime;
@@ -111,6 +135,18 @@ private:
     // change.  This allows it to be called from the dump method.
     void processFencesLocked() const;
 
+    // processRecordFencesLocked replaces the signaled fences of a single frame
+    // record with their timestamps. Returns true if any fence was replaced.
+    bool processRecordFencesLocked(size_t idx) const;
+
+    // watchFenceLocked hands the fence of the current frame to the watcher,
+    // if any, so that the frame record is processed once it signals.
+    void watchFenceLocked(const std::shared_ptr<FenceTime>& fence);
+
+    // onFenceSignaled processes the record of the given frame, if it is still
+    // tracked.
+    void onFenceSignaled(uint64_t frameNumber);
+
     // updateStatsLocked updates the running statistics that are gathered
     // about the frame times.
     void updateStatsLocked(size_t newFrameIdx) const;
@@ -133,6 +169,10 @@ private:
     // mOffset is the offset into mFrameRecords of the current frame.
     size_t mOffset;
 
+    // mFrameNumber is the number of the current frame, i.e. the number of
+    // times advanceFrame was called.
+    uint64_t mFrameNumber;
+
     // mNumFences is the total number of fences set in the frame records.  It
     // is incremented each time a fence is added and decremented each time a
     // signaled fence is removed in processFences or if advanceFrame clobbers
@@ -155,6 +195,16 @@ private:
 
     // mMutex is used to protect access to all member variables.
     mutable Mutex mMutex;
+
+    // WatcherLink lets the callbacks of the fence watcher reach the
+    // FrameTracker as long as it exists. It is detached by the destructor.
+    struct WatcherLink {
+        std::mutex mutex;
+        FrameTracker* tracker;
+    };
+
+    FenceWatcher* mFenceWatcher = nullptr;
+    std::shared_ptr<WatcherLink> mWatcherLink;
 };
 
 } // namespace android
@@ -36,6 +36,7 @@
 #include <cutils/native_handle.h>
 #include <cutils/properties.h>
 #include <gui/BufferItem.h>
+#include <gui/FrameEventRing.h>
 #include <gui/LayerDebugInfo.h>
 #include <gui/Surface.h>
 #include <math.h>
@@ -61,6 +62,7 @@
 #include "DisplayDevice.h"
 #include "DisplayHardware/HWComposer.h"
 #include "EffectLayer.h"
+#include "FrameTimeline/FrameTimeline.h"
 #include "FrameTracer/FrameTracer.h"
 #include "LayerProtoHelper.h"
 #include "LayerRejecter.h"
@@ -75,6 +77,7 @@ namespace android {
 using base::StringAppendF;
 
 std::atomic<int32_t> Layer::sSequence{1};
+std::atomic<uint64_t> Layer::sDrawingStateGeneration{1};
 
 Layer::Layer(const LayerCreationArgs& args)
       : mFlinger(args.flinger),
@@ -133,6 +136,7 @@ Layer::Layer(const LayerCreationArgs& args)
     args.flinger->getCompositorTiming(&compositorTiming);
     mFrameEventHistory.initializeCompositorTiming(compositorTiming);
     mFrameTracker.setDisplayRefreshPeriod(compositorTiming.interval);
+    mFrameTracker.setFenceWatcher(args.flinger->mFenceWatcher.get());
 
     mCallingPid = args.callingPid;
     mCallingUid = args.callingUid;
@@ -145,6 +149,9 @@ void Layer::onFirstRef() {
 }
 
 Layer::~Layer() {
+    // Children which inherit properties from this layer no longer have a drawing parent.
+    invalidateInheritedState();
+
     sp<Client> c(mClientRef.promote());
     if (c != 0) {
         c->detachLayer(this);
@@ -1017,6 +1024,7 @@ uint32_t Layer::doTransaction(uint32_t flags) {
 
 void Layer::commitTransaction(const State& stateToCommit) {
     mDrawingState = stateToCommit;
+    invalidateInheritedState();
 }
 
 uint32_t Layer::getTransactionFlags(uint32_t flags) {
@@ -1478,20 +1486,7 @@ void Layer::deferTransactionUntil_legacy(const sp<IBinder>& barrierHandle, uint6
 // ----------------------------------------------------------------------------
 
 bool Layer::isHiddenByPolicy() const {
-    const State& s(mDrawingState);
-    const auto& parent = mDrawingParent.promote();
-    if (parent != nullptr && parent->isHiddenByPolicy()) {
-        return true;
-    }
-    if (usingRelativeZ(LayerVector::StateSet::Drawing)) {
-        auto zOrderRelativeOf = mDrawingState.zOrderRelativeOf.promote();
-        if (zOrderRelativeOf != nullptr) {
-            if (zOrderRelativeOf->isHiddenByPolicy()) {
-                return true;
-            }
-        }
-    }
-    return s.flags & layer_state_t::eLayerHidden;
+    return getInheritedState().hiddenByPolicy;
 }
 
 uint32_t Layer::getEffectiveUsage(uint32_t usage) const {
@@ -1670,6 +1665,11 @@ void Layer::getFrameStats(FrameStats* outStats) const {
     mFrameTracker.getStats(outStats);
 }
 
+void Layer::getFrameStatsSince(uint64_t frameNumber, FrameStats* outStats,
+                               uint64_t* outNextFrameNumber) const {
+    mFrameTracker.getStatsSince(frameNumber, outStats, outNextFrameNumber);
+}
+
 void Layer::dumpFrameEvents(std::string& result) {
     StringAppendF(&result, "- Layer %s (%s, %p)\n", getName().c_str(), getType(), this);
     Mutex::Autolock lock(mFrameEventHistoryMutex);
@@ -1688,6 +1688,7 @@ void Layer::onDisconnect() {
     const int32_t layerId = getSequence();
     mFlinger->mTimeStats->onDestroy(layerId);
     mFlinger->mFrameTracer->onDestroy(layerId);
+    mFlinger->mFrameTimeline->onDestroy(layerId);
 }
 
 void Layer::addAndGetFrameTimestamps(const NewFrameEventsEntry* newTimestamps,
@@ -1697,6 +1698,11 @@ void Layer::addAndGetFrameTimestamps(const NewFrameEventsEntry* newTimestamps,
                                           getName().c_str(), newTimestamps->postedTime);
         mFlinger->mTimeStats->setAcquireFence(getSequence(), newTimestamps->frameNumber,
                                               newTimestamps->acquireFence);
+        mFlinger->mFrameTimeline->onBufferQueued(getSequence(), getOwnerUid(), getName(),
+                                                 newTimestamps->frameNumber,
+                                                 newTimestamps->postedTime,
+                                                 newTimestamps->requestedPresentTime,
+                                                 newTimestamps->acquireFence);
     }
 
     Mutex::Autolock lock(mFrameEventHistoryMutex);
@@ -1716,6 +1722,18 @@ void Layer::addAndGetFrameTimestamps(const NewFrameEventsEntry* newTimestamps,
     }
 }
 
+void Layer::getFrameEventRing(sp<FrameEventRing>* outRing) {
+    Mutex::Autolock lock(mFrameEventHistoryMutex);
+    if (mFrameEventRing == nullptr) {
+        mFrameEventRing = FrameEventRing::create();
+        if (mFrameEventRing == nullptr) {
+            return;
+        }
+        mFrameEventHistory.setFrameEventRing(mFrameEventRing);
+    }
+    *outRing = mFrameEventRing;
+}
+
 size_t Layer::getChildrenCount() const {
     size_t count = 0;
     for (const sp<Layer>& child : mCurrentChildren) {
@@ -1779,6 +1797,7 @@ bool Layer::reparentChildren(const sp<IBinder>& newParentHandle) {
 void Layer::setChildrenDrawingParent(const sp<Layer>& newParent) {
     for (const sp<Layer>& child : mDrawingChildren) {
         child->mDrawingParent = newParent;
+        invalidateInheritedState();
         child->computeBounds(newParent->mBounds,
                              newParent->getTransformWithScale(newParent->getBufferScaleTransform()),
                              newParent->mEffectiveShadowRadius);
@@ -1884,19 +1903,11 @@ bool Layer::setColorTransform(const mat4& matrix) {
 }
 
 mat4 Layer::getColorTransform() const {
-    mat4 colorTransform = mat4(getDrawingState().colorTransform);
-    if (sp<Layer> parent = mDrawingParent.promote(); parent != nullptr) {
-        colorTransform = parent->getColorTransform() * colorTransform;
-    }
-    return colorTransform;
+    return getInheritedState().colorTransform;
 }
 
 bool Layer::hasColorTransform() const {
-    bool hasColorTransform = getDrawingState().hasColorTransform;
-    if (sp<Layer> parent = mDrawingParent.promote(); parent != nullptr) {
-        hasColorTransform = hasColorTransform || parent->hasColorTransform();
-    }
-    return hasColorTransform;
+    return getInheritedState().hasColorTransform;
 }
 
 bool Layer::isLegacyDataSpace() const {
@@ -2113,10 +2124,7 @@ ui::Transform Layer::getTransform() const {
 }
 
 half Layer::getAlpha() const {
-    const auto& p = mDrawingParent.promote();
-
-    half parentAlpha = (p != nullptr) ? p->getAlpha() : 1.0_hf;
-    return parentAlpha * getDrawingState().color.a;
+    return getInheritedState().alpha;
 }
 
 ui::Transform::RotationFlags Layer::getFixedTransformHint() const {
@@ -2139,6 +2147,10 @@ int32_t Layer::getBackgroundBlurRadius() const {
 }
 
 Layer::RoundedCornerState Layer::getRoundedCornerState() const {
+    return getInheritedState().roundedCornerState;
+}
+
+Layer::RoundedCornerState Layer::computeRoundedCornerState() const {
     const auto& p = mDrawingParent.promote();
     if (p != nullptr) {
         RoundedCornerState parentState = p->getRoundedCornerState();
@@ -2162,6 +2174,36 @@ Layer::RoundedCornerState Layer::getRoundedCornerState() const {
             : RoundedCornerState();
 }
 
+const Layer::InheritedState& Layer::getInheritedState() const {
+    const uint64_t generation = sDrawingStateGeneration;
+    if (mInheritedStateGeneration == generation) {
+        return mInheritedState;
+    }
+
+    const State& s(getDrawingState());
+    InheritedState state;
+    state.alpha = s.color.a;
+    state.colorTransform = mat4(s.colorTransform);
+    state.hasColorTransform = s.hasColorTransform;
+    state.hiddenByPolicy = s.flags & layer_state_t::eLayerHidden;
+    if (sp<Layer> parent = mDrawingParent.promote(); parent != nullptr) {
+        const InheritedState& parentState = parent->getInheritedState();
+        state.alpha = parentState.alpha * state.alpha;
+        state.colorTransform = parentState.colorTransform * state.colorTransform;
+        state.hasColorTransform = state.hasColorTransform || parentState.hasColorTransform;
+        state.hiddenByPolicy = state.hiddenByPolicy || parentState.hiddenByPolicy;
+    }
+    if (!state.hiddenByPolicy && usingRelativeZ(LayerVector::StateSet::Drawing)) {
+        sp<Layer> zOrderRelativeOf = s.zOrderRelativeOf.promote();
+        state.hiddenByPolicy = zOrderRelativeOf != nullptr && zOrderRelativeOf->isHiddenByPolicy();
+    }
+    mInheritedState = state;
+    // The rounded corner state is computed from the parent state, which is now cached.
+    mInheritedState.roundedCornerState = computeRoundedCornerState();
+    mInheritedStateGeneration = generation;
+    return mInheritedState;
+}
+
 renderengine::ShadowSettings Layer::getShadowSettings(const Rect& viewport) const {
     renderengine::ShadowSettings state = mFlinger->mDrawingState.globalShadowSettings;
 
@@ -2180,7 +2222,10 @@ void Layer::commitChildList() {
         child->commitChildList();
     }
     mDrawingChildren = mCurrentChildren;
-    mDrawingParent = mCurrentParent;
+    if (mDrawingParent != mCurrentParent) {
+        mDrawingParent = mCurrentParent;
+        invalidateInheritedState();
+    }
 }
 
 static wp<Layer> extractLayerFromBinder(const wp<IBinder>& weakBinderHandle) {
@@ -2501,6 +2546,7 @@ void Layer::setInitialValuesForClone(const sp<Layer>& clonedFrom) {
     // copy drawing state from cloned layer
     mDrawingState = clonedFrom->mDrawingState;
     mClonedFrom = clonedFrom;
+    invalidateInheritedState();
 }
 
 void Layer::updateMirrorInfo() {
@@ -2526,6 +2572,7 @@ void Layer::updateMirrorInfo() {
     mClonedChild->updateClonedDrawingState(clonedLayersMap);
     mClonedChild->updateClonedChildren(this, clonedLayersMap);
     mClonedChild->updateClonedRelatives(clonedLayersMap);
+    invalidateInheritedState();
 }
 
 void Layer::updateClonedDrawingState(std::map<sp<Layer>, sp<Layer>>& clonedLayersMap) {
@@ -2628,6 +2675,7 @@ void Layer::updateClonedRelatives(const std::map<sp<Layer>, sp<Layer>>& clonedLa
 void Layer::addChildToDrawing(const sp<Layer>& layer) {
     mDrawingChildren.add(layer);
     layer->mDrawingParent = this;
+    invalidateInheritedState();
 }
 
 void Layer::clearNotifiedFrameNumber() {
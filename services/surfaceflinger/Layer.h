@@ -35,6 +35,7 @@
 #include <utils/RefBase.h>
 #include <utils/Timers.h>
 
+#include <atomic>
 #include <chrono>
 #include <cstdint>
 #include <list>
@@ -430,6 +431,9 @@ public:
     virtual void useSurfaceDamage() {}
     virtual void useEmptyDamage() {}
 
+    // The screen space region that changed with the buffer latched this frame.
+    virtual Region getScreenSpaceSurfaceDamage() const { return Region(getScreenBounds()); }
+
     uint32_t getTransactionFlags() const { return mTransactionFlags; }
     uint32_t getTransactionFlags(uint32_t flags);
     uint32_t setTransactionFlags(uint32_t flags);
@@ -661,8 +665,22 @@ public:
 
     virtual bool isBufferLatched() const { return false; }
 
+    /*
+     * prepareLatch - called ahead of latchBuffer to do the part of its work which only reads the
+     * drawing state, such as polling acquire fences and querying buffer metadata. It may be
+     * called for several layers at once on worker threads, and must not touch state shared with
+     * other layers. Nothing is latched, latchBuffer may reuse the results.
+     */
+    virtual void prepareLatch() {}
+
     virtual void latchAndReleaseBuffer() {}
 
+    // Drops the buffer this layer is holding on to so its memory can be reclaimed. Used for
+    // layers that have been offscreen for longer than the offscreen buffer timeout; the layer
+    // shows no content until the client queues a new buffer.
+    // Should only be called on the main thread.
+    virtual void releaseOffscreenBuffers() {}
+
     /*
      * Remove relative z for the layer if its relative parent is not part of the
      * provided layer tree.
@@ -727,6 +745,8 @@ public:
     void clearFrameStats();
     void logFrameStats();
     void getFrameStats(FrameStats* outStats) const;
+    void getFrameStatsSince(uint64_t frameNumber, FrameStats* outStats,
+                            uint64_t* outNextFrameNumber) const;
 
     virtual std::vector<OccupancyTracker::Segment> getOccupancyHistory(bool /*forceFlush*/) {
         return {};
@@ -735,6 +755,9 @@ public:
     void onDisconnect();
     void addAndGetFrameTimestamps(const NewFrameEventsEntry* newEntry,
                                   FrameEventHistoryDelta* outDelta);
+    // Returns the shared memory ring mFrameEventHistory is published into, creating it on
+    // first use.
+    void getFrameEventRing(sp<FrameEventRing>* outRing);
 
     virtual bool getTransformToDisplayInverse() const { return false; }
 
@@ -759,7 +782,7 @@ public:
     // corner definition and converting it into current layer's coordinates.
     // As of now, only 1 corner radius per display list is supported. Subsequent ones will be
     // ignored.
-    virtual RoundedCornerState getRoundedCornerState() const;
+    RoundedCornerState getRoundedCornerState() const;
 
     renderengine::ShadowSettings getShadowSettings(const Rect& viewport) const;
 
@@ -837,6 +860,12 @@ public:
     virtual FrameRate getFrameRateForLayerTree() const;
     static std::string frameRateCompatibilityString(FrameRateCompatibility compatibility);
 
+    // The uid of the process that created this layer.
+    uid_t getOwnerUid() const { return mCallingUid; }
+
+    // The pid of the process that created this layer.
+    pid_t getOwnerPid() const { return mCallingPid; }
+
 protected:
     // constant
     sp<SurfaceFlinger> mFlinger;
@@ -1009,6 +1038,14 @@ protected:
 
     bool usingRelativeZ(LayerVector::StateSet stateSet) const;
 
+    // Computes the rounded corner state returned by getRoundedCornerState.
+    virtual RoundedCornerState computeRoundedCornerState() const;
+
+    // Must be called whenever the drawing state or the drawing parent of any layer changes, so
+    // that the inherited properties of all layers are resolved again.
+    static void invalidateInheritedState() { sDrawingStateGeneration++; }
+    static std::atomic<uint64_t> sDrawingStateGeneration;
+
     bool mPremultipliedAlpha{true};
     const std::string mName;
     const std::string mTransactionName{"TX - " + mName};
@@ -1033,6 +1070,7 @@ protected:
     // Accessed by both consumer and producer on main and binder threads.
     Mutex mFrameEventHistoryMutex;
     ConsumerFrameEventHistory mFrameEventHistory;
+    sp<FrameEventRing> mFrameEventRing;
     FenceTimeline mAcquireTimeline;
     FenceTimeline mReleaseTimeline;
 
@@ -1142,6 +1180,21 @@ private:
     // Returns true if the layer can draw shadows on its border.
     virtual bool canDrawShadows() const { return true; }
 
+    // Properties inherited down the layer hierarchy. They are queried many times per layer per
+    // frame, so they are resolved on first use and reused until the drawing state or the drawing
+    // hierarchy of any layer changes.
+    struct InheritedState {
+        half alpha;
+        RoundedCornerState roundedCornerState;
+        mat4 colorTransform;
+        bool hasColorTransform;
+        bool hiddenByPolicy;
+    };
+    const InheritedState& getInheritedState() const;
+    mutable InheritedState mInheritedState;
+    // Value of sDrawingStateGeneration when mInheritedState was resolved.
+    mutable uint64_t mInheritedStateGeneration = 0;
+
     // Find the root of the cloned hierarchy, this means the first non cloned parent.
     // This will return null if first non cloned parent is not found.
     sp<Layer> getClonedRoot();
@@ -0,0 +1,82 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <utility>
+
+namespace android {
+
+// A multi-producer inbox which producers can post to without taking a lock or
+// blocking. Items are only ever taken out all at once, in the order they were
+// posted, which keeps the implementation free of the ABA problem.
+template <typename T>
+class LockFreeInbox {
+public:
+    LockFreeInbox() = default;
+    ~LockFreeInbox() { drain([](T&&) {}); }
+
+    LockFreeInbox(const LockFreeInbox&) = delete;
+    LockFreeInbox& operator=(const LockFreeInbox&) = delete;
+
+    // Posts an item to the inbox. Safe to call from any thread.
+    template <typename... Args>
+    void post(Args&&... args) {
+        Node* node = new Node{T(std::forward<Args>(args)...), mHead.load(std::memory_order_relaxed)};
+        while (!mHead.compare_exchange_weak(node->next, node, std::memory_order_release,
+                                            std::memory_order_relaxed)) {
+        }
+    }
+
+    bool empty() const { return mHead.load(std::memory_order_acquire) == nullptr; }
+
+    // Takes every item currently in the inbox, and invokes the callback with
+    // each in turn, in the order they were posted. Returns the number of items.
+    template <typename F>
+    size_t drain(F&& callback) {
+        Node* node = mHead.exchange(nullptr, std::memory_order_acquire);
+
+        // The items are linked newest first, so reverse the list.
+        Node* oldest = nullptr;
+        while (node) {
+            Node* next = node->next;
+            node->next = oldest;
+            oldest = node;
+            node = next;
+        }
+
+        size_t count = 0;
+        while (oldest) {
+            Node* next = oldest->next;
+            callback(std::move(oldest->item));
+            delete oldest;
+            oldest = next;
+            count++;
+        }
+        return count;
+    }
+
+private:
+    struct Node {
+        T item;
+        Node* next;
+    };
+
+    std::atomic<Node*> mHead = nullptr;
+};
+
+} // namespace android
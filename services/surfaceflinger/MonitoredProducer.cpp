@@ -156,6 +156,15 @@ status_t MonitoredProducer::setAutoPrerotation(bool autoPrerotation) {
     return mProducer->setAutoPrerotation(autoPrerotation);
 }
 
+status_t MonitoredProducer::dequeueBuffers(const std::vector<DequeueBufferInput>& inputs,
+                                           std::vector<DequeueBufferOutput>* outputs) {
+    return mProducer->dequeueBuffers(inputs, outputs);
+}
+
+status_t MonitoredProducer::getFrameEventRing(sp<FrameEventRing>* outRing) {
+    return mProducer->getFrameEventRing(outRing);
+}
+
 IBinder* MonitoredProducer::onAsBinder() {
     return this;
 }
@@ -32,6 +32,8 @@
 #include <ui/DisplayStatInfo.h>
 #include <utils/Trace.h>
 
+#include <algorithm>
+#include <cmath>
 #include <string>
 
 #include "DisplayDevice.h"
@@ -62,6 +64,7 @@ constexpr auto maxRegionSamplingSkips = 10;
 constexpr auto defaultRegionSamplingOffset = -3ms;
 constexpr auto defaultRegionSamplingPeriod = 100ms;
 constexpr auto defaultRegionSamplingTimerTimeout = 100ms;
+constexpr int32_t defaultRegionSamplingMaxDimension = 128;
 // TODO: (b/127403193) duration to string conversion could probably be constexpr
 template <typename Rep, typename Per>
 inline std::string toNsString(std::chrono::duration<Rep, Per> t) {
@@ -168,6 +171,8 @@ RegionSamplingThread::RegionSamplingThread(SurfaceFlinger& flinger, Scheduler& s
       : mFlinger(flinger),
         mScheduler(scheduler),
         mTunables(tunables),
+        mMaxSampledDimension(property_get_int32("debug.sf.region_sampling_max_dimension",
+                                                defaultRegionSamplingMaxDimension)),
         mIdleTimer(std::chrono::duration_cast<std::chrono::milliseconds>(
                            mTunables.mSamplingTimerTimeout),
                    [] {}, [this] { checkForStaleLuma(); }),
@@ -307,6 +312,19 @@ float sampleArea(const uint32_t* data, int32_t width, int32_t height, int32_t st
     return accumulatedLuma / (255.0f * pixelCount);
 }
 
+Rect scaleSampleArea(const Rect& area, float xScale, float yScale, int32_t width,
+                     int32_t height) {
+    Rect scaled(static_cast<int32_t>(std::floor(area.left * xScale)),
+                static_cast<int32_t>(std::floor(area.top * yScale)),
+                static_cast<int32_t>(std::ceil(area.right * xScale)),
+                static_cast<int32_t>(std::ceil(area.bottom * yScale)));
+    scaled.left = std::clamp(scaled.left, 0, std::max(width - 1, 0));
+    scaled.top = std::clamp(scaled.top, 0, std::max(height - 1, 0));
+    scaled.right = std::clamp(scaled.right, scaled.left + 1, std::max(width, scaled.left + 1));
+    scaled.bottom = std::clamp(scaled.bottom, scaled.top + 1, std::max(height, scaled.top + 1));
+    return scaled;
+}
+
 std::vector<float> RegionSamplingThread::sampleBuffer(
         const sp<GraphicBuffer>& buffer, const Point& leftTop,
         const std::vector<RegionSamplingThread::Descriptor>& descriptors, uint32_t orientation) {
@@ -348,6 +366,19 @@ void RegionSamplingThread::captureSample() {
 
     const Rect sampledArea = sampleRegion.bounds();
 
+    // Render the sampled area into a small buffer. Luma is a mean over each descriptor's area,
+    // which a downscale preserves closely, while both the GPU render and the CPU walk below get
+    // cheaper with the pixel count.
+    float scale = 1.0f;
+    const int32_t maxDimension = std::max(sampledArea.getWidth(), sampledArea.getHeight());
+    if (mMaxSampledDimension > 0 && maxDimension > mMaxSampledDimension) {
+        scale = static_cast<float>(mMaxSampledDimension) / maxDimension;
+    }
+    const int32_t bufferWidth =
+            std::max(1, static_cast<int32_t>(std::lround(sampledArea.getWidth() * scale)));
+    const int32_t bufferHeight =
+            std::max(1, static_cast<int32_t>(std::lround(sampledArea.getHeight() * scale)));
+
     auto dx = 0;
     auto dy = 0;
     switch (orientation) {
@@ -368,8 +399,8 @@ void RegionSamplingThread::captureSample() {
     ui::Transform t(orientation);
     auto screencapRegion = t.transform(sampleRegion);
     screencapRegion = screencapRegion.translate(dx, dy);
-    DisplayRenderArea renderArea(device, screencapRegion.bounds(), sampledArea.getWidth(),
-                                 sampledArea.getHeight(), ui::Dataspace::V0_SRGB, orientation);
+    DisplayRenderArea renderArea(device, screencapRegion.bounds(), bufferWidth, bufferHeight,
+                                 ui::Dataspace::V0_SRGB, orientation);
 
     std::unordered_set<sp<IRegionSamplingListener>, SpHash<IRegionSamplingListener>> listeners;
 
@@ -415,13 +446,13 @@ void RegionSamplingThread::captureSample() {
     };
 
     sp<GraphicBuffer> buffer = nullptr;
-    if (mCachedBuffer && mCachedBuffer->getWidth() == sampledArea.getWidth() &&
-        mCachedBuffer->getHeight() == sampledArea.getHeight()) {
+    if (mCachedBuffer && mCachedBuffer->getWidth() == static_cast<uint32_t>(bufferWidth) &&
+        mCachedBuffer->getHeight() == static_cast<uint32_t>(bufferHeight)) {
         buffer = mCachedBuffer;
     } else {
         const uint32_t usage = GRALLOC_USAGE_SW_READ_OFTEN | GRALLOC_USAGE_HW_RENDER;
-        buffer = new GraphicBuffer(sampledArea.getWidth(), sampledArea.getHeight(),
-                                   PIXEL_FORMAT_RGBA_8888, 1, usage, "RegionSamplingThread");
+        buffer = new GraphicBuffer(bufferWidth, bufferHeight, PIXEL_FORMAT_RGBA_8888, 1, usage,
+                                   "RegionSamplingThread");
     }
 
     bool ignored;
@@ -436,8 +467,13 @@ void RegionSamplingThread::captureSample() {
     }
 
     ALOGV("Sampling %zu descriptors", activeDescriptors.size());
-    std::vector<float> lumas =
-            sampleBuffer(buffer, sampledArea.leftTop(), activeDescriptors, orientation);
+    const float xScale = static_cast<float>(bufferWidth) / sampledArea.getWidth();
+    const float yScale = static_cast<float>(bufferHeight) / sampledArea.getHeight();
+    for (auto& descriptor : activeDescriptors) {
+        descriptor.area = scaleSampleArea(descriptor.area - sampledArea.leftTop(), xScale, yScale,
+                                          bufferWidth, bufferHeight);
+    }
+    std::vector<float> lumas = sampleBuffer(buffer, Point(0, 0), activeDescriptors, orientation);
     if (lumas.size() != activeDescriptors.size()) {
         ALOGW("collected %zu median luma values for %zu descriptors", lumas.size(),
               activeDescriptors.size());
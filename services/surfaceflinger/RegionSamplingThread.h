@@ -40,6 +40,10 @@ struct SamplingOffsetCallback;
 float sampleArea(const uint32_t* data, int32_t width, int32_t height, int32_t stride,
                  uint32_t orientation, const Rect& area);
 
+// Maps an area of the full-resolution sampled region into a buffer scaled by xScale and yScale,
+// rounding outwards and clamping to the buffer size so that the area never becomes empty.
+Rect scaleSampleArea(const Rect& area, float xScale, float yScale, int32_t width, int32_t height);
+
 class RegionSamplingThread : public IBinder::DeathRecipient {
 public:
     struct TimingTunables {
@@ -107,6 +111,10 @@ private:
     SurfaceFlinger& mFlinger;
     Scheduler& mScheduler;
     const TimingTunables mTunables;
+    // debug.sf.region_sampling_max_dimension
+    // The sampled region is rendered into a buffer no larger than this on either side. Zero
+    // renders it at full resolution.
+    const int32_t mMaxSampledDimension;
     scheduler::OneShotTimer mIdleTimer;
 
     std::unique_ptr<SamplingOffsetCallback> const mPhaseCallback;
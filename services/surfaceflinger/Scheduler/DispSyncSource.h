@@ -35,6 +35,7 @@ public:
     void setVSyncEnabled(bool enable) override;
     void setCallback(VSyncSource::Callback* callback) override;
     void setPhaseOffset(nsecs_t phaseOffset) override;
+    nsecs_t getVSyncPeriod() const override;
 
     void dump(std::string&) const override;
 
@@ -24,6 +24,7 @@
 #include <sched.h>
 #include <sys/types.h>
 
+#include <atomic>
 #include <chrono>
 #include <cstdint>
 #include <optional>
@@ -32,6 +33,7 @@
 #include <android-base/stringprintf.h>
 
 #include <bfqio/bfqio.h>
+#include <binder/IPCThreadState.h>
 #include <cutils/compiler.h>
 #include <cutils/sched_policy.h>
 
@@ -68,8 +70,9 @@ std::string toString(VSyncRequest request) {
 }
 
 std::string toString(const EventThreadConnection& connection) {
-    return StringPrintf("Connection{%p, %s}", &connection,
-                        toString(connection.vsyncRequest).c_str());
+    return StringPrintf("Connection{%p, uid=%d, %s, frameRateDivisor=%u}", &connection,
+                        connection.mOwnerUid, toString(connection.vsyncRequest).c_str(),
+                        connection.frameRateDivisor);
 }
 
 std::string toString(const DisplayEventReceiver::Event& event) {
@@ -80,9 +83,11 @@ std::string toString(const DisplayEventReceiver::Event& event) {
                                 event.hotplug.connected ? "connected" : "disconnected");
         case DisplayEventReceiver::DISPLAY_EVENT_VSYNC:
             return StringPrintf("VSync{displayId=%" ANDROID_PHYSICAL_DISPLAY_ID_FORMAT
-                                ", count=%u, expectedVSyncTimestamp=%" PRId64 "}",
+                                ", count=%u, expectedVSyncTimestamp=%" PRId64
+                                ", vsyncId=%" PRId64 ", deadlineTimestamp=%" PRId64 "}",
                                 event.header.displayId, event.vsync.count,
-                                event.vsync.expectedVSyncTimestamp);
+                                event.vsync.expectedVSyncTimestamp, event.vsync.vsyncId,
+                                event.vsync.deadlineTimestamp);
         case DisplayEventReceiver::DISPLAY_EVENT_CONFIG_CHANGED:
             return StringPrintf("ConfigChanged{displayId=%" ANDROID_PHYSICAL_DISPLAY_ID_FORMAT
                                 ", configId=%u}",
@@ -100,12 +105,19 @@ DisplayEventReceiver::Event makeHotplug(PhysicalDisplayId displayId, nsecs_t tim
     return event;
 }
 
+// VSYNC ids are shared by all event threads, so that they identify a VSYNC regardless of the
+// connection it was received from.
+std::atomic<int64_t> sNextVsyncId = 0;
+
 DisplayEventReceiver::Event makeVSync(PhysicalDisplayId displayId, nsecs_t timestamp,
-                                      uint32_t count, nsecs_t expectedVSyncTimestamp) {
+                                      uint32_t count, nsecs_t expectedVSyncTimestamp,
+                                      nsecs_t deadlineTimestamp) {
     DisplayEventReceiver::Event event;
     event.header = {DisplayEventReceiver::DISPLAY_EVENT_VSYNC, displayId, timestamp};
     event.vsync.count = count;
     event.vsync.expectedVSyncTimestamp = expectedVSyncTimestamp;
+    event.vsync.vsyncId = sNextVsyncId++;
+    event.vsync.deadlineTimestamp = deadlineTimestamp;
     return event;
 }
 
@@ -120,11 +132,12 @@ DisplayEventReceiver::Event makeConfigChanged(PhysicalDisplayId displayId,
 
 } // namespace
 
-EventThreadConnection::EventThreadConnection(EventThread* eventThread,
+EventThreadConnection::EventThreadConnection(EventThread* eventThread, uid_t callingUid,
                                              ResyncCallback resyncCallback,
                                              ISurfaceComposer::ConfigChanged configChanged)
       : resyncCallback(std::move(resyncCallback)),
         mConfigChanged(configChanged),
+        mOwnerUid(callingUid),
         mEventThread(eventThread),
         mChannel(gui::BitTube(8 * 1024 /* default size is 4KB, double it */)) {}
 
@@ -212,8 +225,9 @@ void EventThread::setPhaseOffset(nsecs_t phaseOffset) {
 
 sp<EventThreadConnection> EventThread::createEventConnection(
         ResyncCallback resyncCallback, ISurfaceComposer::ConfigChanged configChanged) const {
-    return new EventThreadConnection(const_cast<EventThread*>(this), std::move(resyncCallback),
-                                     configChanged);
+    return new EventThreadConnection(const_cast<EventThread*>(this),
+                                     IPCThreadState::self()->getCallingUid(),
+                                     std::move(resyncCallback), configChanged);
 }
 
 status_t EventThread::registerDisplayEventConnection(const sp<EventThreadConnection>& connection) {
@@ -228,6 +242,11 @@ status_t EventThread::registerDisplayEventConnection(const sp<EventThreadConnect
         return ALREADY_EXISTS;
     }
 
+    if (const auto divisor = mFrameRateDivisors.find(connection->mOwnerUid);
+        divisor != mFrameRateDivisors.end()) {
+        connection->frameRateDivisor = std::max(divisor->second, 1u);
+    }
+
     mDisplayEventConnections.push_back(connection);
     mCondition.notify_all();
     return NO_ERROR;
@@ -268,6 +287,19 @@ void EventThread::requestNextVsync(const sp<EventThreadConnection>& connection)
     }
 }
 
+void EventThread::setFrameRateDivisors(FrameRateDivisors divisors) {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    mFrameRateDivisors = std::move(divisors);
+    for (const auto& ptr : mDisplayEventConnections) {
+        if (const auto connection = ptr.promote()) {
+            const auto divisor = mFrameRateDivisors.find(connection->mOwnerUid);
+            connection->frameRateDivisor =
+                    divisor != mFrameRateDivisors.end() ? std::max(divisor->second, 1u) : 1;
+        }
+    }
+}
+
 void EventThread::onScreenReleased() {
     std::lock_guard<std::mutex> lock(mMutex);
     if (!mVSyncState || mVSyncState->synthetic) {
@@ -292,8 +324,12 @@ void EventThread::onVSyncEvent(nsecs_t timestamp, nsecs_t expectedVSyncTimestamp
     std::lock_guard<std::mutex> lock(mMutex);
 
     LOG_FATAL_IF(!mVSyncState);
+    // The frame started on this VSYNC should be done before the next one. Without a period, the
+    // expected VSYNC is the best estimate.
+    const nsecs_t period = mVSyncSource->getVSyncPeriod();
+    const nsecs_t deadlineTimestamp = period > 0 ? timestamp + period : expectedVSyncTimestamp;
     mPendingEvents.push_back(makeVSync(mVSyncState->displayId, timestamp, ++mVSyncState->count,
-                                       expectedVSyncTimestamp));
+                                       expectedVSyncTimestamp, deadlineTimestamp));
     mCondition.notify_all();
 }
 
@@ -417,7 +453,8 @@ void EventThread::threadMain(std::unique_lock<std::mutex>& lock) {
                 const auto now = systemTime(SYSTEM_TIME_MONOTONIC);
                 const auto expectedVSyncTime = now + timeout.count();
                 mPendingEvents.push_back(makeVSync(mVSyncState->displayId, now,
-                                                   ++mVSyncState->count, expectedVSyncTime));
+                                                   ++mVSyncState->count, expectedVSyncTime,
+                                                   expectedVSyncTime));
             }
         }
     }
@@ -433,18 +470,29 @@ bool EventThread::shouldConsumeEvent(const DisplayEventReceiver::Event& event,
             return connection->mConfigChanged == ISurfaceComposer::eConfigChangedDispatch;
         }
 
-        case DisplayEventReceiver::DISPLAY_EVENT_VSYNC:
+        case DisplayEventReceiver::DISPLAY_EVENT_VSYNC: {
+            // Synthetic VSYNCs are already throttled, so deliver them regardless of the divisor.
+            const bool throttled = connection->frameRateDivisor > 1 &&
+                    !(mVSyncState && mVSyncState->synthetic) &&
+                    event.vsync.count % connection->frameRateDivisor != 0;
+
             switch (connection->vsyncRequest) {
                 case VSyncRequest::None:
                     return false;
                 case VSyncRequest::Single:
+                    // Keep the request pending until the next VSYNC in phase with the divisor.
+                    if (throttled) {
+                        return false;
+                    }
                     connection->vsyncRequest = VSyncRequest::None;
                     return true;
                 case VSyncRequest::Periodic:
-                    return true;
+                    return !throttled;
                 default:
-                    return event.vsync.count % vsyncPeriod(connection->vsyncRequest) == 0;
+                    return !throttled &&
+                            event.vsync.count % vsyncPeriod(connection->vsyncRequest) == 0;
             }
+        }
 
         default:
             return false;
@@ -29,6 +29,7 @@
 #include <mutex>
 #include <optional>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 
 #include "HwcStrongTypes.h"
@@ -45,6 +46,9 @@ class SurfaceFlinger;
 
 using ResyncCallback = std::function<void()>;
 
+// Maps an application uid to the number of display VSYNCs per VSYNC delivered to its connections.
+using FrameRateDivisors = std::unordered_map<uid_t, uint32_t>;
+
 enum class VSyncRequest {
     None = -1,
     Single = 0,
@@ -66,13 +70,15 @@ public:
     virtual void setVSyncEnabled(bool enable) = 0;
     virtual void setCallback(Callback* callback) = 0;
     virtual void setPhaseOffset(nsecs_t phaseOffset) = 0;
+    // Returns the time between VSYNC events, or 0 if unknown.
+    virtual nsecs_t getVSyncPeriod() const = 0;
 
     virtual void dump(std::string& result) const = 0;
 };
 
 class EventThreadConnection : public BnDisplayEventConnection {
 public:
-    EventThreadConnection(EventThread*, ResyncCallback,
+    EventThreadConnection(EventThread*, uid_t callingUid, ResyncCallback,
                           ISurfaceComposer::ConfigChanged configChanged);
     virtual ~EventThreadConnection();
 
@@ -89,6 +95,13 @@ public:
     const ISurfaceComposer::ConfigChanged mConfigChanged =
             ISurfaceComposer::ConfigChanged::eConfigChangedSuppress;
 
+    // The uid of the process that created this connection.
+    const uid_t mOwnerUid;
+
+    // Only every frameRateDivisor-th display VSYNC is delivered to this connection, aligned to
+    // the display's VSYNC count so that all throttled connections wake up together.
+    uint32_t frameRateDivisor = 1;
+
 private:
     virtual void onFirstRef();
     EventThread* const mEventThread;
@@ -126,6 +139,10 @@ public:
 
     // Retrieves the number of event connections tracked by this EventThread.
     virtual size_t getEventThreadConnectionCount() = 0;
+
+    // Throttles the VSYNC events delivered to the connections of the given uids. Uids that are
+    // not present receive every VSYNC.
+    virtual void setFrameRateDivisors(FrameRateDivisors divisors) = 0;
 };
 
 namespace impl {
@@ -161,6 +178,8 @@ public:
 
     size_t getEventThreadConnectionCount() override;
 
+    void setFrameRateDivisors(FrameRateDivisors divisors) override;
+
 private:
     friend EventThreadTest;
 
@@ -190,6 +209,7 @@ private:
 
     std::vector<wp<EventThreadConnection>> mDisplayEventConnections GUARDED_BY(mMutex);
     std::deque<DisplayEventReceiver::Event> mPendingEvents GUARDED_BY(mMutex);
+    FrameRateDivisors mFrameRateDivisors GUARDED_BY(mMutex);
 
     // VSYNC state of connected display.
     struct VSyncState {
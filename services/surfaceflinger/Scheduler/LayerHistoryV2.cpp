@@ -52,6 +52,10 @@ bool traceEnabled() {
     return property_get_bool("debug.sf.layer_history_trace", false);
 }
 
+bool contentDetectionEnabled() {
+    return property_get_bool("debug.sf.layer_history_content_detection", true);
+}
+
 bool useFrameRatePriority() {
     char value[PROPERTY_VALUE_MAX];
     property_get("debug.sf.use_frame_rate_priority", value, "1");
@@ -81,6 +85,7 @@ void trace(const wp<Layer>& weak, const LayerInfoV2& info, LayerHistory::LayerVo
 LayerHistoryV2::LayerHistoryV2(const scheduler::RefreshRateConfigs& refreshRateConfigs)
       : mTraceEnabled(traceEnabled()), mUseFrameRatePriority(useFrameRatePriority()) {
     LayerInfoV2::setTraceEnabled(mTraceEnabled);
+    LayerInfoV2::setContentDetectionEnabled(contentDetectionEnabled());
     LayerInfoV2::setRefreshRateConfigs(refreshRateConfigs);
 }
 
@@ -20,6 +20,8 @@
 #include "LayerInfoV2.h"
 
 #include <algorithm>
+#include <cmath>
+#include <numeric>
 #include <utility>
 
 #include <cutils/compiler.h>
@@ -33,6 +35,7 @@ namespace android::scheduler {
 
 const RefreshRateConfigs* LayerInfoV2::sRefreshRateConfigs = nullptr;
 bool LayerInfoV2::sTraceEnabled = false;
+bool LayerInfoV2::sContentDetectionEnabled = true;
 
 LayerInfoV2::LayerInfoV2(const std::string& name, nsecs_t highRefreshRatePeriod,
                          LayerHistory::LayerVoteType defaultVote)
@@ -178,11 +181,106 @@ std::optional<nsecs_t> LayerInfoV2::calculateAverageFrameTime() const {
     return static_cast<nsecs_t>(averageFrameTime);
 }
 
+std::optional<float> LayerInfoV2::calculateVideoFrameRateIfPossible() const {
+    if (!sContentDetectionEnabled || mFrameTimes.size() < CADENCE_WINDOW_SIZE) {
+        return std::nullopt;
+    }
+
+    const auto window = mFrameTimes.end() - CADENCE_WINDOW_SIZE;
+    bool missingPresentTime = false;
+    for (auto it = window; it != mFrameTimes.end(); ++it) {
+        if (!isFrameTimeValid(*it) || it->pendingConfigChange) {
+            return std::nullopt;
+        }
+        missingPresentTime |= it->presetTime == 0;
+    }
+
+    // Prefer the presentation timestamps, which video players derive from the content, over
+    // the queue times, which pick up the scheduling jitter of the producer.
+    std::array<nsecs_t, CADENCE_WINDOW_SIZE> timestamps;
+    std::transform(window, mFrameTimes.end(), timestamps.begin(), [&](const FrameTimeData& frame) {
+        return missingPresentTime ? frame.queueTime : frame.presetTime;
+    });
+
+    std::array<nsecs_t, CADENCE_WINDOW_SIZE - 1> deltas;
+    for (size_t i = 0; i < deltas.size(); i++) {
+        deltas[i] = timestamps[i + 1] - timestamps[i];
+    }
+    const auto median = deltas.begin() + deltas.size() / 2;
+    std::nth_element(deltas.begin(), median, deltas.end());
+    if (*median <= 0) {
+        return std::nullopt;
+    }
+
+    // Assign every frame to a cadence slot, allowing for the odd skipped frame, then fit the
+    // cadence to the slots.
+    const nsecs_t first = timestamps.front();
+    std::array<nsecs_t, CADENCE_WINDOW_SIZE> slots;
+    slots[0] = 0;
+    for (size_t i = 1; i < timestamps.size(); i++) {
+        const nsecs_t slotsAdvanced = (timestamps[i] - timestamps[i - 1] + *median / 2) / *median;
+        if (slotsAdvanced <= 0) {
+            return std::nullopt;
+        }
+        slots[i] = slots[i - 1] + slotsAdvanced;
+    }
+    std::for_each(timestamps.begin(), timestamps.end(), [first](nsecs_t& t) { t -= first; });
+    const auto skippedSlots = slots.back() - static_cast<nsecs_t>(slots.size() - 1);
+    if (skippedSlots > static_cast<nsecs_t>(slots.size() / 4)) {
+        return std::nullopt;
+    }
+
+    const double meanSlot = std::accumulate(slots.begin(), slots.end(), 0.0) / slots.size();
+    const double meanTimestamp =
+            std::accumulate(timestamps.begin(), timestamps.end(), 0.0) / timestamps.size();
+    double top = 0;
+    double bottom = 0;
+    for (size_t i = 0; i < timestamps.size(); i++) {
+        top += (slots[i] - meanSlot) * (timestamps[i] - meanTimestamp);
+        bottom += (slots[i] - meanSlot) * (slots[i] - meanSlot);
+    }
+    const double period = bottom > 0 ? top / bottom : 0;
+    if (period <= 0) {
+        return std::nullopt;
+    }
+    const double intercept = meanTimestamp - period * meanSlot;
+    for (size_t i = 0; i < timestamps.size(); i++) {
+        const double jitter = std::abs(timestamps[i] - (intercept + period * slots[i]));
+        if (jitter > period * CADENCE_MAX_JITTER) {
+            ALOGV("%s frames do not follow a cadence", mName.c_str());
+            return std::nullopt;
+        }
+    }
+
+    const auto frameRate = static_cast<float>(1e9 / period);
+    const auto videoFrameRate =
+            std::min_element(VIDEO_FRAME_RATES.begin(), VIDEO_FRAME_RATES.end(),
+                             [frameRate](float a, float b) {
+                                 return std::abs(a - frameRate) < std::abs(b - frameRate);
+                             });
+    if (std::abs(*videoFrameRate - frameRate) > *videoFrameRate * CADENCE_RATE_TOLERANCE) {
+        ALOGV("%s cadence of %.2fHz is not a video frame rate", mName.c_str(), frameRate);
+        return std::nullopt;
+    }
+
+    ALOGV("%s has a video cadence of %.2fHz", mName.c_str(), *videoFrameRate);
+    return *videoFrameRate;
+}
+
 std::optional<float> LayerInfoV2::calculateRefreshRateIfPossible(nsecs_t now) {
     static constexpr float MARGIN = 1.0f; // 1Hz
+    // A detected video cadence gives the first vote as soon as it is seen, and holds the vote
+    // against the heuristic for as long as the cadence lasts.
+    const auto videoFrameRate = calculateVideoFrameRateIfPossible();
+    if (videoFrameRate && mLastRefreshRate.reported == 0) {
+        mLastRefreshRate.calculated = *videoFrameRate;
+        mLastRefreshRate.reported = *videoFrameRate;
+    }
+    const bool holdingVideoFrameRate = videoFrameRate == mLastRefreshRate.reported;
+
     if (!hasEnoughDataForHeuristic()) {
         ALOGV("Not enough data");
-        return std::nullopt;
+        return videoFrameRate;
     }
 
     const auto averageFrameTime = calculateAverageFrameTime();
@@ -196,7 +294,7 @@ std::optional<float> LayerInfoV2::calculateRefreshRateIfPossible(nsecs_t now) {
             // To avoid oscillation, use the last calculated refresh rate if it is
             // close enough
             if (std::abs(mLastRefreshRate.calculated - refreshRate) > MARGIN &&
-                mLastRefreshRate.reported != knownRefreshRate) {
+                mLastRefreshRate.reported != knownRefreshRate && !holdingVideoFrameRate) {
                 mLastRefreshRate.calculated = refreshRate;
                 mLastRefreshRate.reported = knownRefreshRate;
             }
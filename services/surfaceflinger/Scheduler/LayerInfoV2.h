@@ -18,6 +18,7 @@
 
 #include <utils/Timers.h>
 
+#include <array>
 #include <chrono>
 #include <deque>
 
@@ -53,11 +54,22 @@ class LayerInfoV2 {
     static constexpr auto MAX_FREQUENT_LAYER_PERIOD_NS =
             std::chrono::nanoseconds(static_cast<nsecs_t>(1e9f / MIN_FPS_FOR_FREQUENT_LAYER)) + 1ms;
 
+    // Content detection looks for a steady video cadence over the most recent frames so that a
+    // layer can get a confident vote before the heuristic has a full history. A frame may land
+    // up to CADENCE_MAX_JITTER periods away from the cadence, and up to a quarter of the cadence
+    // slots may be skipped.
+    static constexpr size_t CADENCE_WINDOW_SIZE = 12;
+    static constexpr float CADENCE_MAX_JITTER = 0.25f;
+    static constexpr float CADENCE_RATE_TOLERANCE = 0.02f;
+    static constexpr std::array<float, 5> VIDEO_FRAME_RATES = {24.0f, 25.0f, 30.0f, 50.0f, 60.0f};
+
     friend class LayerHistoryTestV2;
 
 public:
     static void setTraceEnabled(bool enabled) { sTraceEnabled = enabled; }
 
+    static void setContentDetectionEnabled(bool enabled) { sContentDetectionEnabled = enabled; }
+
     static void setRefreshRateConfigs(const RefreshRateConfigs& refreshRateConfigs) {
         sRefreshRateConfigs = &refreshRateConfigs;
     }
@@ -186,6 +198,7 @@ private:
     bool hasEnoughDataForHeuristic() const;
     std::optional<float> calculateRefreshRateIfPossible(nsecs_t now);
     std::optional<nsecs_t> calculateAverageFrameTime() const;
+    std::optional<float> calculateVideoFrameRateIfPossible() const;
     bool isFrameTimeValid(const FrameTimeData&) const;
 
     const std::string mName;
@@ -215,6 +228,7 @@ private:
     // Shared for all LayerInfo instances
     static const RefreshRateConfigs* sRefreshRateConfigs;
     static bool sTraceEnabled;
+    static bool sContentDetectionEnabled;
 };
 
 } // namespace scheduler
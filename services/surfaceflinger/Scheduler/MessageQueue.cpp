@@ -18,6 +18,8 @@
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wconversion"
 
+#include <optional>
+
 #include <binder/IPCThreadState.h>
 
 #include <utils/Log.h>
@@ -42,19 +44,36 @@ void MessageQueue::Handler::dispatchRefresh() {
 void MessageQueue::Handler::dispatchInvalidate(nsecs_t expectedVSyncTimestamp) {
     if ((android_atomic_or(eventMaskInvalidate, &mEventMask) & eventMaskInvalidate) == 0) {
         mExpectedVSyncTime = expectedVSyncTimestamp;
-        mQueue.mLooper->sendMessage(this, Message(MessageQueue::INVALIDATE));
+        handleInvalidate();
+    }
+}
+
+void MessageQueue::Handler::handleInvalidate() {
+    android_atomic_and(~eventMaskInvalidate, &mEventMask);
+    mQueue.mFlinger->onMessageReceived(INVALIDATE, mExpectedVSyncTime);
+
+    // Composite in the same wakeup if the INVALIDATE requested a REFRESH. The REFRESH message
+    // may not have been sent yet if the request came from another thread, in which case it is
+    // ignored by handleMessage() since its bit was already cleared.
+    if (android_atomic_acquire_load(&mEventMask) & eventMaskRefresh) {
+        mQueue.mLooper->removeMessages(this, REFRESH);
+        handleRefresh();
+    }
+}
+
+void MessageQueue::Handler::handleRefresh() {
+    if (android_atomic_and(~eventMaskRefresh, &mEventMask) & eventMaskRefresh) {
+        mQueue.mFlinger->onMessageReceived(REFRESH, mExpectedVSyncTime);
     }
 }
 
 void MessageQueue::Handler::handleMessage(const Message& message) {
     switch (message.what) {
         case INVALIDATE:
-            android_atomic_and(~eventMaskInvalidate, &mEventMask);
-            mQueue.mFlinger->onMessageReceived(message.what, mExpectedVSyncTime);
+            handleInvalidate();
             break;
         case REFRESH:
-            android_atomic_and(~eventMaskRefresh, &mEventMask);
-            mQueue.mFlinger->onMessageReceived(message.what, mExpectedVSyncTime);
+            handleRefresh();
             break;
     }
 }
@@ -120,14 +139,19 @@ int MessageQueue::cb_eventReceiver(int fd, int events, void* data) {
 int MessageQueue::eventReceiver(int /*fd*/, int /*events*/) {
     ssize_t n;
     DisplayEventReceiver::Event buffer[8];
+    std::optional<nsecs_t> expectedVSyncTimestamp;
     while ((n = DisplayEventReceiver::getEvents(&mEventTube, buffer, 8)) > 0) {
         for (int i = 0; i < n; i++) {
             if (buffer[i].header.type == DisplayEventReceiver::DISPLAY_EVENT_VSYNC) {
-                mHandler->dispatchInvalidate(buffer[i].vsync.expectedVSyncTimestamp);
-                break;
+                expectedVSyncTimestamp = buffer[i].vsync.expectedVSyncTimestamp;
             }
         }
     }
+
+    // Only the latest VSYNC matters, and the frame runs once the events are drained.
+    if (expectedVSyncTimestamp) {
+        mHandler->dispatchInvalidate(*expectedVSyncTimestamp);
+    }
     return 1;
 }
 
@@ -75,16 +75,24 @@ public:
 namespace impl {
 
 class MessageQueue final : public android::MessageQueue {
+    // Frame work runs on the main thread as soon as VSYNC is received, rather than after the
+    // messages queued before it, and REFRESH runs right after the INVALIDATE which requested it
+    // instead of on the next iteration of the Looper.
     class Handler : public MessageHandler {
         enum { eventMaskInvalidate = 0x1, eventMaskRefresh = 0x2, eventMaskTransaction = 0x4 };
         MessageQueue& mQueue;
         int32_t mEventMask;
         std::atomic<nsecs_t> mExpectedVSyncTime;
 
+        void handleInvalidate();
+        void handleRefresh();
+
     public:
         explicit Handler(MessageQueue& queue) : mQueue(queue), mEventMask(0) {}
         virtual void handleMessage(const Message& message);
+        // May be called from any thread.
         void dispatchRefresh();
+        // Must be called from the main thread, runs INVALIDATE before returning.
         void dispatchInvalidate(nsecs_t expectedVSyncTimestamp);
     };
 
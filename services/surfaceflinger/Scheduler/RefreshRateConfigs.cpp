@@ -114,10 +114,83 @@ std::pair<nsecs_t, nsecs_t> RefreshRateConfigs::getDisplayFrames(nsecs_t layerPe
     return {displayFramesQuot, displayFramesRem};
 }
 
+float RefreshRateConfigs::calculateExactOrMultipleScore(nsecs_t layerPeriod,
+                                                        nsecs_t displayPeriod) const {
+    // Calculate how many display vsyncs we need to present a single frame for this layer
+    const auto [displayFramesQuot, displayFramesRem] = getDisplayFrames(layerPeriod, displayPeriod);
+    static constexpr size_t MAX_FRAMES_TO_FIT = 10; // Stop calculating when score < 0.1
+    if (displayFramesRem == 0) {
+        // Layer desired refresh rate matches the display rate.
+        return 1.0f;
+    }
+
+    if (displayFramesQuot == 0) {
+        // Layer desired refresh rate is higher the display rate.
+        return (static_cast<float>(layerPeriod) / static_cast<float>(displayPeriod)) *
+                (1.0f / (MAX_FRAMES_TO_FIT + 1));
+    }
+
+    // Layer desired refresh rate is lower the display rate. Check how well it fits the cadence
+    auto diff = std::abs(displayFramesRem - (displayPeriod - displayFramesRem));
+    int iter = 2;
+    while (diff > MARGIN_FOR_PERIOD_CALCULATION && iter < MAX_FRAMES_TO_FIT) {
+        diff = diff - (displayPeriod - diff);
+        iter++;
+    }
+
+    return 1.0f / iter;
+}
+
+float RefreshRateConfigs::getExactOrMultipleScore(const RefreshRate& refreshRate,
+                                                  float frameRate) const {
+    const auto knownFrameRate =
+            std::lower_bound(mKnownFrameRates.begin(), mKnownFrameRates.end(), frameRate);
+    if (knownFrameRate != mKnownFrameRates.end() && *knownFrameRate == frameRate) {
+        const auto& scores = mExactOrMultipleScores[refreshRate.configId.value()];
+        return scores[static_cast<size_t>(std::distance(mKnownFrameRates.begin(), knownFrameRate))];
+    }
+
+    return calculateExactOrMultipleScore(round<nsecs_t>(1e9f / frameRate),
+                                         refreshRate.hwcConfig->getVsyncPeriod());
+}
+
 const RefreshRate& RefreshRateConfigs::getBestRefreshRate(
         const std::vector<LayerRequirement>& layers, const GlobalSignals& globalSignals,
         GlobalSignals* outSignalsConsidered) const {
     ATRACE_CALL();
+
+    BestRefreshRateKey key{.signals = globalSignals};
+    key.layers.reserve(layers.size());
+    for (const auto& layer : layers) {
+        key.layers.push_back({layer.vote, layer.desiredRefreshRate, layer.weight, layer.focused});
+    }
+
+    std::lock_guard lock(mLock);
+
+    const auto cached = std::find_if(mBestRefreshRateCache.begin(), mBestRefreshRateCache.end(),
+                                     [&key](const auto& entry) { return entry.key == key; });
+    if (cached != mBestRefreshRateCache.end()) {
+        std::rotate(mBestRefreshRateCache.begin(), cached, std::next(cached));
+        const auto& entry = mBestRefreshRateCache.front();
+        if (outSignalsConsidered) *outSignalsConsidered = entry.signalsConsidered;
+        return *entry.refreshRate;
+    }
+
+    GlobalSignals signalsConsidered;
+    const RefreshRate& refreshRate =
+            getBestRefreshRateLocked(layers, globalSignals, &signalsConsidered);
+    if (outSignalsConsidered) *outSignalsConsidered = signalsConsidered;
+
+    if (mBestRefreshRateCache.size() == BEST_REFRESH_RATE_CACHE_SIZE) {
+        mBestRefreshRateCache.pop_back();
+    }
+    mBestRefreshRateCache.push_front({std::move(key), &refreshRate, signalsConsidered});
+    return refreshRate;
+}
+
+const RefreshRate& RefreshRateConfigs::getBestRefreshRateLocked(
+        const std::vector<LayerRequirement>& layers, const GlobalSignals& globalSignals,
+        GlobalSignals* outSignalsConsidered) const {
     ALOGV("getRefreshRateForContent %zu layers", layers.size());
 
     if (outSignalsConsidered) *outSignalsConsidered = {};
@@ -133,8 +206,6 @@ const RefreshRate& RefreshRateConfigs::getBestRefreshRate(
         }
     };
 
-    std::lock_guard lock(mLock);
-
     int noVoteLayers = 0;
     int minVoteLayers = 0;
     int maxVoteLayers = 0;
@@ -255,36 +326,8 @@ const RefreshRate& RefreshRateConfigs::getBestRefreshRate(
 
             if (layer.vote == LayerVoteType::ExplicitExactOrMultiple ||
                 layer.vote == LayerVoteType::Heuristic) {
-                const auto layerScore = [&] {
-                    // Calculate how many display vsyncs we need to present a single frame for this
-                    // layer
-                    const auto [displayFramesQuot, displayFramesRem] =
-                            getDisplayFrames(layerPeriod, displayPeriod);
-                    static constexpr size_t MAX_FRAMES_TO_FIT =
-                            10; // Stop calculating when score < 0.1
-                    if (displayFramesRem == 0) {
-                        // Layer desired refresh rate matches the display rate.
-                        return 1.0f;
-                    }
-
-                    if (displayFramesQuot == 0) {
-                        // Layer desired refresh rate is higher the display rate.
-                        return (static_cast<float>(layerPeriod) /
-                                static_cast<float>(displayPeriod)) *
-                                (1.0f / (MAX_FRAMES_TO_FIT + 1));
-                    }
-
-                    // Layer desired refresh rate is lower the display rate. Check how well it fits
-                    // the cadence
-                    auto diff = std::abs(displayFramesRem - (displayPeriod - displayFramesRem));
-                    int iter = 2;
-                    while (diff > MARGIN_FOR_PERIOD_CALCULATION && iter < MAX_FRAMES_TO_FIT) {
-                        diff = diff - (displayPeriod - diff);
-                        iter++;
-                    }
-
-                    return 1.0f / iter;
-                }();
+                const auto layerScore =
+                        getExactOrMultipleScore(*scores[i].first, layer.desiredRefreshRate);
                 ALOGV("%s (%s, weight %.2f) %.2fHz gives %s score of %.2f", layer.name.c_str(),
                       layerVoteTypeString(layer.vote).c_str(), weight, 1e9f / layerPeriod,
                       scores[i].first->name.c_str(), layerScore);
@@ -419,6 +462,17 @@ RefreshRateConfigs::RefreshRateConfigs(
     mDisplayManagerPolicy.defaultConfig = currentConfigId;
     mMinSupportedRefreshRate = sortedConfigs.front();
     mMaxSupportedRefreshRate = sortedConfigs.back();
+
+    mExactOrMultipleScores.resize(configs.size());
+    for (size_t i = 0; i < configs.size(); i++) {
+        auto& scores = mExactOrMultipleScores[i];
+        scores.reserve(mKnownFrameRates.size());
+        for (const float frameRate : mKnownFrameRates) {
+            scores.push_back(calculateExactOrMultipleScore(round<nsecs_t>(1e9f / frameRate),
+                                                           configs[i]->getVsyncPeriod()));
+        }
+    }
+
     constructAvailableRefreshRates();
 }
 
@@ -515,6 +569,8 @@ void RefreshRateConfigs::getSortedRefreshRateList(
 }
 
 void RefreshRateConfigs::constructAvailableRefreshRates() {
+    mBestRefreshRateCache.clear();
+
     // Filter configs based on current policy and sort based on vsync period
     const Policy* policy = getCurrentPolicyLocked();
     const auto& defaultConfig = mRefreshRates.at(policy->defaultConfig)->hwcConfig;
@@ -19,6 +19,7 @@
 #include <android-base/stringprintf.h>
 
 #include <algorithm>
+#include <deque>
 #include <numeric>
 #include <optional>
 #include <type_traits>
@@ -226,6 +227,10 @@ public:
         bool touch = false;
         // True if the system hasn't seen any buffers posted to layers recently.
         bool idle = false;
+
+        bool operator==(const GlobalSignals& other) const {
+            return touch == other.touch && idle == other.idle;
+        }
     };
 
     // Returns the refresh rate that fits best to the given layers.
@@ -308,6 +313,19 @@ private:
     template <typename Iter>
     const RefreshRate* getBestRefreshRate(Iter begin, Iter end) const;
 
+    const RefreshRate& getBestRefreshRateLocked(const std::vector<LayerRequirement>& layers,
+                                                const GlobalSignals& globalSignals,
+                                                GlobalSignals* outSignalsConsidered) const
+            REQUIRES(mLock);
+
+    // Returns how well a layer rendering at layerPeriod, or at a multiple of it, fits a display
+    // running at displayPeriod.
+    float calculateExactOrMultipleScore(nsecs_t layerPeriod, nsecs_t displayPeriod) const;
+
+    // Returns calculateExactOrMultipleScore() for a layer at frameRate on refreshRate, looking it
+    // up in mExactOrMultipleScores when frameRate is a known frame rate.
+    float getExactOrMultipleScore(const RefreshRate& refreshRate, float frameRate) const;
+
     // Returns number of display frames and remainder when dividing the layer refresh period by
     // display refresh period.
     std::pair<nsecs_t, nsecs_t> getDisplayFrames(nsecs_t layerPeriod, nsecs_t displayPeriod) const;
@@ -358,6 +376,45 @@ private:
     // A sorted list of known frame rates that a Heuristic layer will choose
     // from based on the closest value.
     const std::vector<float> mKnownFrameRates;
+
+    // calculateExactOrMultipleScore() of every known frame rate, in mKnownFrameRates order, on
+    // every config, indexed by config id. Heuristic layers always vote for a known frame rate.
+    // This must not change after this object is initialized.
+    std::vector<std::vector<float>> mExactOrMultipleScores;
+
+    // The inputs of getBestRefreshRate() that its result depends on. Layer names are left out.
+    struct BestRefreshRateKey {
+        struct Layer {
+            LayerVoteType vote;
+            float desiredRefreshRate;
+            float weight;
+            bool focused;
+
+            bool operator==(const Layer& other) const {
+                return vote == other.vote && desiredRefreshRate == other.desiredRefreshRate &&
+                        weight == other.weight && focused == other.focused;
+            }
+        };
+
+        std::vector<Layer> layers;
+        GlobalSignals signals;
+
+        bool operator==(const BestRefreshRateKey& other) const {
+            return signals == other.signals && layers == other.layers;
+        }
+    };
+
+    struct BestRefreshRateEntry {
+        BestRefreshRateKey key;
+        const RefreshRate* refreshRate;
+        GlobalSignals signalsConsidered;
+    };
+
+    // Recent getBestRefreshRate() results, most recent first. The layer requirements rarely
+    // change from one frame to the next, so this is usually hit. Cleared whenever the policy
+    // changes.
+    static constexpr size_t BEST_REFRESH_RATE_CACHE_SIZE = 8;
+    mutable std::deque<BestRefreshRateEntry> mBestRefreshRateCache GUARDED_BY(mLock);
 };
 
 } // namespace android::scheduler
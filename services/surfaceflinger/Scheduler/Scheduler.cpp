@@ -33,6 +33,7 @@
 
 #include <algorithm>
 #include <cinttypes>
+#include <cmath>
 #include <cstdint>
 #include <functional>
 #include <memory>
@@ -62,27 +63,43 @@
 
 namespace android {
 
-std::unique_ptr<DispSync> createDispSync(bool supportKernelTimer) {
+std::unique_ptr<DispSync> createDispSync(bool supportKernelTimer,
+                                         ISchedulerCallback& schedulerCallback) {
     // TODO (140302863) remove this and use the vsync_reactor system.
     if (property_get_bool("debug.sf.vsync_reactor", true)) {
         // TODO (144707443) tune Predictor tunables.
         static constexpr int defaultRate = 60;
         static constexpr auto initialPeriod =
                 std::chrono::duration<nsecs_t, std::ratio<1, defaultRate>>(1);
-        static constexpr size_t vsyncTimestampHistorySize = 20;
+        static constexpr size_t defaultVsyncTimestampHistorySize = 20;
         static constexpr size_t minimumSamplesForPrediction = 6;
         static constexpr uint32_t discardOutlierPercent = 20;
+        // Panels with noisy vsync timestamps may want a longer history to smooth the fit.
+        const int32_t historySizeProperty =
+                property_get_int32("debug.sf.vsp_history_size", defaultVsyncTimestampHistorySize);
+        const size_t vsyncTimestampHistorySize =
+                std::max(static_cast<size_t>(std::max(historySizeProperty, 0)),
+                         minimumSamplesForPrediction);
         auto tracker = std::make_unique<
                 scheduler::VSyncPredictor>(std::chrono::duration_cast<std::chrono::nanoseconds>(
                                                    initialPeriod)
                                                    .count(),
                                            vsyncTimestampHistorySize, minimumSamplesForPrediction,
-                                           discardOutlierPercent);
+                                           discardOutlierPercent,
+                                           [&schedulerCallback](nsecs_t idealPeriod,
+                                                                nsecs_t error) {
+                                               schedulerCallback
+                                                       .onVsyncPredictionError(idealPeriod, error);
+                                           });
 
         static constexpr auto vsyncMoveThreshold =
                 std::chrono::duration_cast<std::chrono::nanoseconds>(3ms);
-        static constexpr auto timerSlack =
-                std::chrono::duration_cast<std::chrono::nanoseconds>(500us);
+        static constexpr int32_t defaultTimerSlackUs = 500;
+        // Callbacks whose wakeups fall within the slack of each other share a single wakeup.
+        const int32_t timerSlackUs =
+                property_get_int32("debug.sf.vsync_timer_slack_us", defaultTimerSlackUs);
+        const auto timerSlack = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::microseconds(std::max(timerSlackUs, 0)));
         auto dispatch = std::make_unique<
                 scheduler::VSyncDispatchTimerQueue>(std::make_unique<scheduler::Timer>(), *tracker,
                                                     timerSlack.count(), vsyncMoveThreshold.count());
@@ -102,7 +119,7 @@ Scheduler::Scheduler(impl::EventControlThread::SetVSyncEnabledFunction function,
                      ISchedulerCallback& schedulerCallback, bool useContentDetectionV2,
                      bool useContentDetection)
       : mSupportKernelTimer(sysprop::support_kernel_idle_timer(false)),
-        mPrimaryDispSync(createDispSync(mSupportKernelTimer)),
+        mPrimaryDispSync(createDispSync(mSupportKernelTimer, schedulerCallback)),
         mEventControlThread(new impl::EventControlThread(std::move(function))),
         mSchedulerCallback(schedulerCallback),
         mRefreshRateConfigs(refreshRateConfig),
@@ -267,6 +284,25 @@ size_t Scheduler::getEventThreadConnectionCount(ConnectionHandle handle) {
     return mConnections[handle].thread->getEventThreadConnectionCount();
 }
 
+void Scheduler::setFrameRateDivisors(ConnectionHandle handle, FrameRateDivisors divisors) {
+    RETURN_IF_INVALID_HANDLE(handle);
+    mConnections[handle].thread->setFrameRateDivisors(std::move(divisors));
+}
+
+uint32_t Scheduler::getFrameRateDivisor(float displayRefreshRate, float frameRate) {
+    // Allow for NTSC rates such as 29.97, which are close to but not exactly a divisor.
+    constexpr float kMarginFps = 0.1f;
+    if (frameRate <= 0 || displayRefreshRate <= 0) {
+        return 1;
+    }
+
+    const auto divisor = std::round(displayRefreshRate / frameRate);
+    if (divisor < 2 || std::abs(displayRefreshRate / divisor - frameRate) > kMarginFps) {
+        return 1;
+    }
+    return static_cast<uint32_t>(divisor);
+}
+
 void Scheduler::dump(ConnectionHandle handle, std::string& result) const {
     RETURN_IF_INVALID_HANDLE(handle);
     mConnections.at(handle).thread->dump(result);
@@ -53,6 +53,9 @@ public:
                                    scheduler::RefreshRateConfigEvent) = 0;
     virtual void repaintEverythingForHWC() = 0;
     virtual void kernelTimerChanged(bool expired) = 0;
+    // Reports how far a hardware vsync landed from where the primary display's vsync model
+    // predicted it, while the model was tuned for idealPeriod.
+    virtual void onVsyncPredictionError(nsecs_t idealPeriod, nsecs_t error) = 0;
 };
 
 class IPhaseOffsetControl {
@@ -163,6 +166,13 @@ public:
 
     size_t getEventThreadConnectionCount(ConnectionHandle handle);
 
+    // Throttles the VSYNC events delivered to the connections of each uid on the given thread.
+    void setFrameRateDivisors(ConnectionHandle, FrameRateDivisors);
+
+    // Returns the number of display VSYNCs per frame of content at frameRate, or 1 if the display
+    // refresh rate is not a multiple of frameRate.
+    static uint32_t getFrameRateDivisor(float displayRefreshRate, float frameRate);
+
 private:
     friend class TestableScheduler;
 
@@ -17,6 +17,7 @@
 #define ATRACE_TAG ATRACE_TAG_GRAPHICS
 #include <android-base/stringprintf.h>
 #include <utils/Trace.h>
+#include <algorithm>
 #include <vector>
 
 #include "TimeKeeper.h"
@@ -140,6 +141,28 @@ void VSyncDispatchTimerQueueEntry::ensureNotRunning() {
     mCv.wait(lk, [this]() REQUIRES(mRunningMutex) { return !mRunning; });
 }
 
+void VSyncDispatchTimerQueueEntry::DispatchStats::insert(nsecs_t lateness) {
+    if (lateness < 0) {
+        coalesced++;
+    }
+    auto const clampedLateness = std::max(lateness, static_cast<nsecs_t>(0));
+    auto const bucket = std::lower_bound(kBucketBoundsUs.begin(), kBucketBoundsUs.end(),
+                                         clampedLateness / 1000);
+    buckets[std::distance(kBucketBoundsUs.begin(), bucket)]++;
+    dispatches++;
+    totalLateness += clampedLateness;
+    maxLateness = std::max(maxLateness, clampedLateness);
+}
+
+void VSyncDispatchTimerQueueEntry::recordDispatch(nsecs_t wakeupTime, nsecs_t now) {
+    mDispatchStats.insert(now - wakeupTime);
+}
+
+VSyncDispatchTimerQueueEntry::DispatchStats const& VSyncDispatchTimerQueueEntry::dispatchStats()
+        const {
+    return mDispatchStats;
+}
+
 void VSyncDispatchTimerQueueEntry::dump(std::string& result) const {
     std::lock_guard<std::mutex> lk(mRunningMutex);
     std::string armedInfo;
@@ -160,6 +183,20 @@ void VSyncDispatchTimerQueueEntry::dump(std::string& result) const {
     } else {
         StringAppendF(&result, "\t\t\tmLastDispatchTime unknown\n");
     }
+
+    auto const& stats = mDispatchStats;
+    StringAppendF(&result,
+                  "\t\t\tLateness: dispatches = %zu, coalesced = %zu, mean = %.1fus, "
+                  "max = %.1fus\n",
+                  stats.dispatches, stats.coalesced,
+                  stats.dispatches ? stats.totalLateness / 1e3f / stats.dispatches : 0.f,
+                  stats.maxLateness / 1e3f);
+    StringAppendF(&result, "\t\t\t\t");
+    for (size_t i = 0; i < stats.kBucketBoundsUs.size(); i++) {
+        StringAppendF(&result, "<=%" PRId64 "us=%zu ", stats.kBucketBoundsUs[i], stats.buckets[i]);
+    }
+    StringAppendF(&result, ">%" PRId64 "us=%zu\n", stats.kBucketBoundsUs.back(),
+                  stats.buckets.back());
 }
 
 VSyncDispatchTimerQueue::VSyncDispatchTimerQueue(std::unique_ptr<TimeKeeper> tk,
@@ -245,6 +282,7 @@ void VSyncDispatchTimerQueue::timerCallback() {
         std::lock_guard<decltype(mMutex)> lk(mMutex);
         auto const now = mTimeKeeper->now();
         mLastTimerCallback = now;
+        mTimerWakeups++;
         for (auto it = mCallbacks.begin(); it != mCallbacks.end(); it++) {
             auto& callback = it->second;
             auto const wakeupTime = callback->wakeupTime();
@@ -254,12 +292,14 @@ void VSyncDispatchTimerQueue::timerCallback() {
 
             auto const lagAllowance = std::max(now - mIntendedWakeupTime, static_cast<nsecs_t>(0));
             if (*wakeupTime < mIntendedWakeupTime + mTimerSlack + lagAllowance) {
+                callback->recordDispatch(*wakeupTime, now);
                 callback->executing();
                 invocations.emplace_back(
                         Invocation{callback, *callback->lastExecutedVsyncTarget(), *wakeupTime});
             }
         }
 
+        mDispatchedCallbacks += invocations.size();
         mIntendedWakeupTime = kInvalidTime;
         rearmTimer(mTimeKeeper->now());
     }
@@ -364,6 +404,9 @@ void VSyncDispatchTimerQueue::dump(std::string& result) const {
     StringAppendF(&result, "\tmLastTimerCallback: %.2fms ago mLastTimerSchedule: %.2fms ago\n",
                   (mTimeKeeper->now() - mLastTimerCallback) / 1e6f,
                   (mTimeKeeper->now() - mLastTimerSchedule) / 1e6f);
+    StringAppendF(&result, "\tmTimerWakeups: %zu mDispatchedCallbacks: %zu (%.2f per wakeup)\n",
+                  mTimerWakeups, mDispatchedCallbacks,
+                  mTimerWakeups ? static_cast<float>(mDispatchedCallbacks) / mTimerWakeups : 0.f);
     StringAppendF(&result, "\tCallbacks:\n");
     for (const auto& [token, entry] : mCallbacks) {
         entry->dump(result);
@@ -78,6 +78,26 @@ public:
     // Block calling thread while the callback is executing.
     void ensureNotRunning();
 
+    // Dispatch lateness, measured from the wakeup time this entry asked for to the time the timer
+    // actually fired. Entries that are coalesced into an earlier wakeup have negative lateness.
+    struct DispatchStats {
+        // Upper bounds of the lateness histogram buckets. The last bucket holds everything above
+        // the last bound.
+        static constexpr std::array<nsecs_t, 7> kBucketBoundsUs = {50,   100,  250, 500,
+                                                                   1000, 2000, 4000};
+        std::array<size_t, kBucketBoundsUs.size() + 1> buckets{};
+        size_t dispatches = 0;
+        // Dispatches that ran ahead of their wakeup time to share an earlier wakeup.
+        size_t coalesced = 0;
+        nsecs_t totalLateness = 0;
+        nsecs_t maxLateness = 0;
+
+        void insert(nsecs_t lateness);
+    };
+    // Records that the entry was dispatched at the given time. Not threadsafe.
+    void recordDispatch(nsecs_t wakeupTime, nsecs_t now);
+    DispatchStats const& dispatchStats() const;
+
     void dump(std::string& result) const;
 
 private:
@@ -101,6 +121,8 @@ private:
     };
     std::optional<WorkloadUpdateInfo> mWorkloadUpdateInfo;
 
+    DispatchStats mDispatchStats;
+
     mutable std::mutex mRunningMutex;
     std::condition_variable mCv;
     bool mRunning GUARDED_BY(mRunningMutex) = false;
@@ -116,7 +138,9 @@ public:
     // \param[in] tk                    A timekeeper.
     // \param[in] tracker               A tracker.
     // \param[in] timerSlack            The threshold at which different similarly timed callbacks
-    //                                  should be grouped into one wakeup.
+    //                                  should be grouped into one wakeup. Grouped callbacks fire
+    //                                  at the earliest of their wakeup times, so no callback is
+    //                                  delayed past its own deadline.
     // \param[in] minVsyncDistance      The minimum distance between two vsync estimates before the
     //                                  vsyncs are considered the same vsync event.
     explicit VSyncDispatchTimerQueue(std::unique_ptr<TimeKeeper> tk, VSyncTracker& tracker,
@@ -169,6 +193,8 @@ private:
     // For debugging purposes
     nsecs_t mLastTimerCallback GUARDED_BY(mMutex) = kInvalidTime;
     nsecs_t mLastTimerSchedule GUARDED_BY(mMutex) = kInvalidTime;
+    size_t mTimerWakeups GUARDED_BY(mMutex) = 0;
+    size_t mDispatchedCallbacks GUARDED_BY(mMutex) = 0;
 };
 
 } // namespace android::scheduler
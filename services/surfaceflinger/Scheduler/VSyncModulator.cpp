@@ -25,12 +25,39 @@
 #include <cutils/properties.h>
 #include <utils/Trace.h>
 
+#include <algorithm>
 #include <chrono>
 #include <cinttypes>
 #include <mutex>
 
 namespace android::scheduler {
 
+CompositionPredictor::CompositionPredictor() {
+    // Blurs are always composed with RenderEngine, so start out leaning towards it.
+    for (size_t i = 0; i < mCounters.size(); i++) {
+        const bool hasBlur = i & 0x2;
+        mCounters[i] = hasBlur ? kLikelyThreshold : kLikelyThreshold - 1;
+    }
+}
+
+size_t CompositionPredictor::index(const Features& features) {
+    return std::min(features.layerCount, kMaxTrackedLayerCount) * 4 + (features.hasBlur ? 0x2 : 0) +
+            (features.hasRoundedCorners ? 0x1 : 0);
+}
+
+void CompositionPredictor::onFrameComposed(const Features& features, bool usedRenderEngine) {
+    auto& counter = mCounters[index(features)];
+    if (usedRenderEngine) {
+        counter = std::min<uint8_t>(counter + 1, kMaxCounter);
+    } else if (counter > 0) {
+        counter--;
+    }
+}
+
+bool CompositionPredictor::isRenderEngineLikely(const Features& features) const {
+    return mCounters[index(features)] >= kLikelyThreshold;
+}
+
 VSyncModulator::VSyncModulator(IPhaseOffsetControl& phaseOffsetControl,
                                Scheduler::ConnectionHandle appConnectionHandle,
                                Scheduler::ConnectionHandle sfConnectionHandle,
@@ -42,6 +69,8 @@ VSyncModulator::VSyncModulator(IPhaseOffsetControl& phaseOffsetControl,
     char value[PROPERTY_VALUE_MAX];
     property_get("debug.sf.vsync_trace_detailed_info", value, "0");
     mTraceDetailedInfo = atoi(value);
+    property_get("debug.sf.vsync_predict_early_gl", value, "1");
+    mPredictRenderEngineUsage = atoi(value);
 }
 
 void VSyncModulator::setPhaseOffsets(const OffsetsConfig& config) {
@@ -109,9 +138,16 @@ void VSyncModulator::onRefreshRateChangeCompleted() {
     updateOffsets();
 }
 
-void VSyncModulator::onRefreshed(bool usedRenderEngine) {
+void VSyncModulator::onRefreshed(bool usedRenderEngine,
+                                 std::optional<CompositionPredictor::Features> features) {
     bool updateOffsetsNeeded = false;
 
+    if (features) {
+        std::lock_guard<std::mutex> lock(mPredictorMutex);
+        mCompositionPredictor.onFrameComposed(*features, usedRenderEngine);
+        mLastComposedFeatures = *features;
+    }
+
     // Apply a margin to account for potential data races
     // This might make us stay in early offsets for one
     // additional frame but it's better to be conservative here.
@@ -133,6 +169,29 @@ void VSyncModulator::onRefreshed(bool usedRenderEngine) {
     }
 }
 
+void VSyncModulator::onCompositionChangePending(
+        const CompositionPredictor::Features& addedFeatures) {
+    // Nothing to do if the early GL offsets are already in place.
+    if (!mPredictRenderEngineUsage || mRemainingRenderEngineUsageCount > 0) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mPredictorMutex);
+        auto features = mLastComposedFeatures;
+        features += addedFeatures;
+        if (!mCompositionPredictor.isRenderEngineLikely(features)) {
+            return;
+        }
+    }
+
+    if (mTraceDetailedInfo) {
+        ATRACE_NAME("RenderEnginePredicted");
+    }
+    mRemainingRenderEngineUsageCount = MIN_EARLY_GL_FRAME_COUNT_TRANSACTION;
+    updateOffsets();
+}
+
 VSyncModulator::Offsets VSyncModulator::getOffsets() const {
     std::lock_guard<std::mutex> lock(mMutex);
     return mOffsets;
@@ -16,13 +16,56 @@
 
 #pragma once
 
+#include <array>
 #include <chrono>
+#include <cstdint>
 #include <mutex>
+#include <optional>
 
 #include "Scheduler.h"
 
 namespace android::scheduler {
 
+/*
+ * Learns which kinds of frames end up being composed with RenderEngine, so that the early GL
+ * offsets can be applied before such a frame instead of after it. Each combination of features
+ * is tracked with a two-bit saturating counter. Hoisted to public for unit testing.
+ */
+class CompositionPredictor {
+public:
+    // Features of a frame that correlate with client composition.
+    struct Features {
+        size_t layerCount = 0;
+        bool hasBlur = false;
+        bool hasRoundedCorners = false;
+
+        Features& operator+=(const Features& other) {
+            layerCount += other.layerCount;
+            hasBlur |= other.hasBlur;
+            hasRoundedCorners |= other.hasRoundedCorners;
+            return *this;
+        }
+    };
+
+    CompositionPredictor();
+
+    // Records whether a frame with the given features was composed with RenderEngine.
+    void onFrameComposed(const Features&, bool usedRenderEngine);
+
+    // Returns whether a frame with the given features is likely to need RenderEngine.
+    bool isRenderEngineLikely(const Features&) const;
+
+private:
+    // Layer counts beyond this share a counter.
+    static constexpr size_t kMaxTrackedLayerCount = 15;
+    static constexpr uint8_t kMaxCounter = 3;
+    static constexpr uint8_t kLikelyThreshold = 2;
+
+    static size_t index(const Features&);
+
+    std::array<uint8_t, (kMaxTrackedLayerCount + 1) * 4> mCounters;
+};
+
 /*
  * Modulates the vsync-offsets depending on current SurfaceFlinger state.
  */
@@ -88,7 +131,14 @@ public:
     // Called when the display is presenting a new frame. usedRenderEngine
     // should be set to true if RenderEngine was involved with composing the new
     // frame.
-    void onRefreshed(bool usedRenderEngine);
+    // If features are given, they describe the composed frame and are used to learn when to
+    // predict RenderEngine usage.
+    void onRefreshed(bool usedRenderEngine,
+                     std::optional<CompositionPredictor::Features> features = std::nullopt);
+
+    // Called when a transaction adds the given features to the next frame. Moves into early GL
+    // offsets ahead of that frame if it is predicted to be composed with RenderEngine.
+    void onCompositionChangePending(const CompositionPredictor::Features& addedFeatures);
 
     // Returns the offsets that we are currently using
     Offsets getOffsets() const EXCLUDES(mMutex);
@@ -120,6 +170,11 @@ private:
     std::atomic<std::chrono::steady_clock::time_point> mTxnAppliedTime = {};
 
     bool mTraceDetailedInfo = false;
+    bool mPredictRenderEngineUsage = true;
+
+    mutable std::mutex mPredictorMutex;
+    CompositionPredictor mCompositionPredictor GUARDED_BY(mPredictorMutex);
+    CompositionPredictor::Features mLastComposedFeatures GUARDED_BY(mPredictorMutex);
 };
 
 } // namespace android::scheduler
@@ -35,15 +35,18 @@ namespace android::scheduler {
 using base::StringAppendF;
 
 static auto constexpr kMaxPercent = 100u;
+static constexpr size_t kRateMapSizeLimit = 30;
 
 VSyncPredictor::~VSyncPredictor() = default;
 
 VSyncPredictor::VSyncPredictor(nsecs_t idealPeriod, size_t historySize,
-                               size_t minimumSamplesForPrediction, uint32_t outlierTolerancePercent)
+                               size_t minimumSamplesForPrediction, uint32_t outlierTolerancePercent,
+                               PredictionErrorCallback predictionErrorCallback)
       : mTraceOn(property_get_bool("debug.sf.vsp_trace", true)),
         kHistorySize(historySize),
         kMinimumSamplesForPrediction(minimumSamplesForPrediction),
         kOutlierTolerancePercent(std::min(outlierTolerancePercent, kMaxPercent)),
+        mPredictionErrorCallback(std::move(predictionErrorCallback)),
         mIdealPeriod(idealPeriod) {
     resetModel();
 }
@@ -68,6 +71,41 @@ bool VSyncPredictor::validate(nsecs_t timestamp) const {
     return percent < kOutlierTolerancePercent || percent > (kMaxPercent - kOutlierTolerancePercent);
 }
 
+void VSyncPredictor::PredictionErrorStats::insert(nsecs_t error) {
+    auto const absError = std::abs(error);
+    auto const absErrorUs = absError / 1000;
+    auto const bucket = std::lower_bound(kBucketBoundsUs.begin(), kBucketBoundsUs.end(), absErrorUs);
+    buckets[std::distance(kBucketBoundsUs.begin(), bucket)]++;
+    samples++;
+    totalAbsError += absError;
+    maxAbsError = std::max(maxAbsError, absError);
+}
+
+VSyncPredictor::PredictionErrorStats& VSyncPredictor::currentErrorStats() {
+    if (CC_UNLIKELY(mErrorStats.size() == kRateMapSizeLimit &&
+                    mErrorStats.find(mIdealPeriod) == mErrorStats.end())) {
+        mErrorStats.erase(mErrorStats.begin());
+    }
+    return mErrorStats[mIdealPeriod];
+}
+
+void VSyncPredictor::recordPredictionError(nsecs_t timestamp) {
+    auto const [slope, intercept] = mRateMap.find(mIdealPeriod)->second;
+    auto const oldest = *std::min_element(mTimestamps.begin(), mTimestamps.end());
+
+    // Compare against the closest vsync the current model anticipates, before the timestamp
+    // is folded into the next fit.
+    auto const zeroPoint = oldest + intercept;
+    auto const ordinal = (timestamp - zeroPoint + slope / 2) / slope;
+    auto const error = timestamp - (zeroPoint + ordinal * slope);
+
+    currentErrorStats().insert(error);
+    traceInt64If("VSP-error", error);
+    if (mPredictionErrorCallback) {
+        mPredictionErrorCallback(mIdealPeriod, error);
+    }
+}
+
 nsecs_t VSyncPredictor::currentPeriod() const {
     std::lock_guard<std::mutex> lk(mMutex);
     return std::get<0>(mRateMap.find(mIdealPeriod)->second);
@@ -77,6 +115,10 @@ bool VSyncPredictor::addVsyncTimestamp(nsecs_t timestamp) {
     std::lock_guard<std::mutex> lk(mMutex);
 
     if (!validate(timestamp)) {
+        auto& errorStats = currentErrorStats();
+        errorStats.outliers++;
+        traceInt64If("VSP-outliers", errorStats.outliers);
+
         // VSR could elect to ignore the incongruent timestamp or resetModel(). If ts is ignored,
         // don't insert this ts into mTimestamps ringbuffer.
         if (!mTimestamps.empty()) {
@@ -88,6 +130,10 @@ bool VSyncPredictor::addVsyncTimestamp(nsecs_t timestamp) {
         return false;
     }
 
+    if (mTimestamps.size() >= kMinimumSamplesForPrediction) {
+        recordPredictionError(timestamp);
+    }
+
     if (mTimestamps.size() != kHistorySize) {
         mTimestamps.push_back(timestamp);
         mLastTimestampIndex = next(mLastTimestampIndex);
@@ -152,6 +198,7 @@ bool VSyncPredictor::addVsyncTimestamp(nsecs_t timestamp) {
 
     if (CC_UNLIKELY(bottom == 0)) {
         it->second = {mIdealPeriod, 0};
+        currentErrorStats().modelResets++;
         clearTimestamps();
         return false;
     }
@@ -162,6 +209,7 @@ bool VSyncPredictor::addVsyncTimestamp(nsecs_t timestamp) {
     auto const percent = std::abs(anticipatedPeriod - mIdealPeriod) * kMaxPercent / mIdealPeriod;
     if (percent >= kOutlierTolerancePercent) {
         it->second = {mIdealPeriod, 0};
+        currentErrorStats().modelResets++;
         clearTimestamps();
         return false;
     }
@@ -224,12 +272,21 @@ std::tuple<nsecs_t, nsecs_t> VSyncPredictor::getVSyncPredictionModel(
     return mRateMap.find(mIdealPeriod)->second;
 }
 
+std::optional<VSyncPredictor::PredictionErrorStats> VSyncPredictor::getPredictionErrorStats(
+        nsecs_t idealPeriod) const {
+    std::lock_guard<std::mutex> lk(mMutex);
+    auto const it = mErrorStats.find(idealPeriod);
+    if (it == mErrorStats.end()) {
+        return {};
+    }
+    return it->second;
+}
+
 void VSyncPredictor::setPeriod(nsecs_t period) {
     ATRACE_CALL();
 
     std::lock_guard<std::mutex> lk(mMutex);
-    static constexpr size_t kSizeLimit = 30;
-    if (CC_UNLIKELY(mRateMap.size() == kSizeLimit)) {
+    if (CC_UNLIKELY(mRateMap.size() == kRateMapSizeLimit)) {
         mRateMap.erase(mRateMap.begin());
     }
 
@@ -263,6 +320,9 @@ bool VSyncPredictor::needsMoreSamples() const {
 void VSyncPredictor::resetModel() {
     std::lock_guard<std::mutex> lk(mMutex);
     mRateMap[mIdealPeriod] = {mIdealPeriod, 0};
+    if (!mTimestamps.empty()) {
+        currentErrorStats().modelResets++;
+    }
     clearTimestamps();
 }
 
@@ -276,6 +336,22 @@ void VSyncPredictor::dump(std::string& result) const {
                       idealPeriod / 1e6f, std::get<0>(periodInterceptTuple) / 1e6f,
                       std::get<1>(periodInterceptTuple));
     }
+    StringAppendF(&result, "\tPrediction Error:\n");
+    for (const auto& [idealPeriod, stats] : mErrorStats) {
+        StringAppendF(&result,
+                      "\t\tFor ideal period %.2fms: samples = %zu, mean |error| = %.1fus, "
+                      "max |error| = %.1fus, outliers = %zu, model resets = %zu\n",
+                      idealPeriod / 1e6f, stats.samples,
+                      stats.samples ? stats.totalAbsError / 1e3f / stats.samples : 0.f,
+                      stats.maxAbsError / 1e3f, stats.outliers, stats.modelResets);
+        StringAppendF(&result, "\t\t\t");
+        for (size_t i = 0; i < stats.kBucketBoundsUs.size(); i++) {
+            StringAppendF(&result, "<=%" PRId64 "us=%zu ", stats.kBucketBoundsUs[i],
+                          stats.buckets[i]);
+        }
+        StringAppendF(&result, ">%" PRId64 "us=%zu\n", stats.kBucketBoundsUs.back(),
+                      stats.buckets.back());
+    }
 }
 
 } // namespace android::scheduler
@@ -17,7 +17,10 @@
 #pragma once
 
 #include <android-base/thread_annotations.h>
+#include <array>
+#include <functional>
 #include <mutex>
+#include <optional>
 #include <unordered_map>
 #include <vector>
 #include "SchedulerUtils.h"
@@ -27,15 +30,21 @@ namespace android::scheduler {
 
 class VSyncPredictor : public VSyncTracker {
 public:
+    // Invoked with the ideal period in effect and the signed difference between a vsync timestamp
+    // and the model's prediction for it. Called with the predictor lock held.
+    using PredictionErrorCallback = std::function<void(nsecs_t idealPeriod, nsecs_t error)>;
+
     /*
      * \param [in] idealPeriod  The initial ideal period to use.
      * \param [in] historySize  The internal amount of entries to store in the model.
      * \param [in] minimumSamplesForPrediction The minimum number of samples to collect before
      * predicting. \param [in] outlierTolerancePercent a number 0 to 100 that will be used to filter
      * samples that fall outlierTolerancePercent from an anticipated vsync event.
+     * \param [in] predictionErrorCallback  Optional sink for the per-sample prediction error.
      */
     VSyncPredictor(nsecs_t idealPeriod, size_t historySize, size_t minimumSamplesForPrediction,
-                   uint32_t outlierTolerancePercent);
+                   uint32_t outlierTolerancePercent,
+                   PredictionErrorCallback predictionErrorCallback = nullptr);
     ~VSyncPredictor();
 
     bool addVsyncTimestamp(nsecs_t timestamp) final;
@@ -59,12 +68,34 @@ public:
 
     std::tuple<nsecs_t /* slope */, nsecs_t /* intercept */> getVSyncPredictionModel() const;
 
+    // How well the model predicted the timestamps it was fed while a given ideal period was in
+    // effect.
+    struct PredictionErrorStats {
+        // Upper bounds of the absolute error histogram buckets. The last bucket holds everything
+        // above the last bound.
+        static constexpr std::array<nsecs_t, 7> kBucketBoundsUs = {50,   100,  250, 500,
+                                                                   1000, 2000, 4000};
+        std::array<size_t, kBucketBoundsUs.size() + 1> buckets{};
+        size_t samples = 0;
+        nsecs_t totalAbsError = 0;
+        nsecs_t maxAbsError = 0;
+        // Timestamps rejected for being too far away from an anticipated vsync.
+        size_t outliers = 0;
+        // Times the model was discarded, either explicitly or because a fit failed.
+        size_t modelResets = 0;
+
+        void insert(nsecs_t error);
+    };
+    std::optional<PredictionErrorStats> getPredictionErrorStats(nsecs_t idealPeriod) const;
+
     void dump(std::string& result) const final;
 
 private:
     VSyncPredictor(VSyncPredictor const&) = delete;
     VSyncPredictor& operator=(VSyncPredictor const&) = delete;
     void clearTimestamps() REQUIRES(mMutex);
+    void recordPredictionError(nsecs_t timestamp) REQUIRES(mMutex);
+    PredictionErrorStats& currentErrorStats() REQUIRES(mMutex);
 
     inline void traceInt64If(const char* name, int64_t value) const;
     bool const mTraceOn;
@@ -72,6 +103,7 @@ private:
     size_t const kHistorySize;
     size_t const kMinimumSamplesForPrediction;
     size_t const kOutlierTolerancePercent;
+    PredictionErrorCallback const mPredictionErrorCallback;
 
     std::mutex mutable mMutex;
     size_t next(int i) const REQUIRES(mMutex);
@@ -86,6 +118,8 @@ private:
 
     int mLastTimestampIndex GUARDED_BY(mMutex) = 0;
     std::vector<nsecs_t> mTimestamps GUARDED_BY(mMutex);
+
+    std::unordered_map<nsecs_t, PredictionErrorStats> mErrorStats GUARDED_BY(mMutex);
 };
 
 } // namespace android::scheduler
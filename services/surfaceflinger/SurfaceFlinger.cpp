@@ -86,6 +86,7 @@
 #include <cmath>
 #include <cstdint>
 #include <functional>
+#include <map>
 #include <mutex>
 #include <optional>
 #include <unordered_map>
@@ -104,6 +105,7 @@
 #include "DisplayHardware/VirtualDisplaySurface.h"
 #include "EffectLayer.h"
 #include "Effects/Daltonizer.h"
+#include "FrameTimeline/FrameTimeline.h"
 #include "FrameTracer/FrameTracer.h"
 #include "Layer.h"
 #include "LayerVector.h"
@@ -195,6 +197,19 @@ bool isWideColorMode(const ColorMode colorMode) {
 
 #pragma clang diagnostic pop
 
+// Approximate size of the memory backing a buffer. Formats without a fixed number of bytes per
+// pixel are YUV 4:2:0 in practice, which take 12 bits per pixel.
+size_t getBufferSize(const sp<GraphicBuffer>& buffer) {
+    if (buffer == nullptr) {
+        return 0;
+    }
+
+    const size_t pixels = static_cast<size_t>(buffer->getStride()) * buffer->getHeight() *
+            buffer->getLayerCount();
+    const uint32_t bpp = bytesPerPixel(buffer->getPixelFormat());
+    return bpp > 0 ? pixels * bpp : pixels * 3 / 2;
+}
+
 template <typename Mutex>
 struct SCOPED_CAPABILITY ConditionalLockGuard {
     ConditionalLockGuard(Mutex& mutex, bool lock) ACQUIRE(mutex) : mutex(mutex), lock(lock) {
@@ -323,6 +338,7 @@ SurfaceFlinger::SurfaceFlinger(Factory& factory, SkipInitializationTag)
         mInterceptor(mFactory.createSurfaceInterceptor(this)),
         mTimeStats(std::make_shared<impl::TimeStats>()),
         mFrameTracer(std::make_unique<FrameTracer>()),
+        mFrameTimeline(std::make_unique<frametimeline::FrameTimeline>(mTimeStats)),
         mEventQueue(mFactory.createMessageQueue()),
         mCompositionEngine(mFactory.createCompositionEngine()),
         mInternalDisplayDensity(getDensityFromProperty("ro.sf.lcd_density", true)),
@@ -438,9 +454,53 @@ SurfaceFlinger::SurfaceFlinger(Factory& factory) : SurfaceFlinger(factory, SkipI
     property_get("debug.sf.disable_client_composition_cache", value, "0");
     mDisableClientCompositionCache = atoi(value);
 
+    property_get("debug.sf.parallel_output_prepare", value, "0");
+    mParallelOutputPrepare = atoi(value);
+
+    property_get("debug.sf.batch_output_presents", value, "0");
+    mBatchOutputPresents = atoi(value);
+
+    property_get("debug.sf.incremental_visible_regions", value, "0");
+    mIncrementalVisibleRegions = atoi(value);
+
+    property_get("debug.sf.coalesce_transactions", value, "0");
+    mCoalesceTransactions = atoi(value);
+
+    property_get("debug.sf.incremental_input_windows", value, "0");
+    mIncrementalInputWindows = atoi(value);
+
+    property_get("debug.sf.partial_client_composition", value, "0");
+    mPartialClientComposition = atoi(value);
+
+    property_get("debug.sf.cache_client_composition_results", value, "0");
+    mCacheClientCompositionResults = atoi(value);
+
+    property_get("debug.sf.layer_flattening_threshold", value, "0");
+    mLayerFlatteningThreshold = static_cast<uint32_t>(atoi(value));
+
+    property_get("debug.sf.snapshot_layer_fe_state", value, "0");
+    mSnapshotLayerFEState = atoi(value);
+
+    property_get("debug.sf.skip_idle_outputs", value, "0");
+    mSkipIdleOutputs = atoi(value);
+
     property_get("ro.sf.force_light_brightness", value, "0");
     mForceLightBrightness = atoi(value);
 
+    mFrameRateDivisorsEnabled = property_get_bool("debug.sf.enable_frame_rate_divisors", true);
+
+    mTracing.setDeltaEncoding(property_get_bool("debug.sf.layer_trace_delta", false));
+
+    mInterceptor->setDeferredCapture(property_get_bool("debug.sf.interceptor_deferred", false),
+                                     property_get_bool("debug.sf.interceptor_compressed", false));
+
+    mOffscreenBufferTimeout = ms2ns(property_get_int32("debug.sf.offscreen_buffer_timeout_ms", 0));
+
+    if (property_get_bool("debug.sf.enable_fence_watcher", true)) {
+        mFenceWatcher = std::make_unique<FenceWatcher>();
+        mAnimFrameTracker.setFenceWatcher(mFenceWatcher.get());
+    }
+
     // We should be reading 'persist.sys.sf.color_saturation' here
     // but since /data may be encrypted, we need to wait until after vold
     // comes online to attempt to read the property. The property is
@@ -735,6 +795,8 @@ void SurfaceFlinger::init() {
         }
     }
 
+    mHwcControlThread.start();
+
     // initialize our drawing state
     mDrawingState = mCurrentState;
 
@@ -1980,6 +2042,12 @@ void SurfaceFlinger::onMessageInvalidate(nsecs_t expectedVSyncTime) {
     // potentially trigger a display handoff.
     updateVrFlinger();
 
+    // SurfaceFlinger is expected to wake up one work duration ahead of the present time.
+    const nsecs_t sfOffset = mVSyncModulator->getOffsets().sf;
+    const nsecs_t sfWorkDuration = sfOffset >= 0 ? stats.vsyncPeriod - sfOffset : -sfOffset;
+    mFrameTimeline->onSfWakeUp(expectedVSyncTime - sfWorkDuration, expectedVSyncTime, frameStart);
+    mPowerAdvisor.setTargetWorkDuration(sfWorkDuration);
+
     if (mTracingEnabledChanged) {
         mTracingEnabled = mTracing.isEnabled();
         mTracingEnabledChanged = false;
@@ -2008,6 +2076,7 @@ void SurfaceFlinger::onMessageInvalidate(nsecs_t expectedVSyncTime) {
     {
         Mutex::Autolock _l(mStateLock);
         mScheduler->chooseRefreshRateForContent();
+        updateFrameRateDivisors();
     }
 
     ON_MAIN_THREAD(performSetActiveConfig());
@@ -2067,9 +2136,15 @@ void SurfaceFlinger::onMessageRefresh() {
     for (const auto& [_, display] : displays) {
         refreshArgs.outputs.push_back(display->getCompositionDisplay());
     }
-    mDrawingState.traverseInZOrder([&refreshArgs](Layer* layer) {
+    scheduler::CompositionPredictor::Features compositionFeatures;
+    mDrawingState.traverseInZOrder([&](Layer* layer) {
         if (auto layerFE = layer->getCompositionEngineLayerFE())
             refreshArgs.layers.push_back(layerFE);
+        if (layer->isVisible()) {
+            compositionFeatures.layerCount++;
+            compositionFeatures.hasBlur |= layer->getDrawingState().backgroundBlurRadius > 0;
+            compositionFeatures.hasRoundedCorners |= layer->getRoundedCornerState().radius > 0.0f;
+        }
     });
     refreshArgs.layersWithQueuedFrames.reserve(mLayersWithQueuedFrames.size());
     for (sp<Layer> layer : mLayersWithQueuedFrames) {
@@ -2095,6 +2170,18 @@ void SurfaceFlinger::onMessageRefresh() {
     }
 
     refreshArgs.devOptForceClientComposition = mDebugDisableHWC || mDebugRegion;
+    refreshArgs.parallelizeOutputPrepare = mParallelOutputPrepare;
+    refreshArgs.batchOutputPresents = mBatchOutputPresents;
+    refreshArgs.incrementalVisibleRegions = mIncrementalVisibleRegions;
+    refreshArgs.partialClientComposition = mPartialClientComposition;
+    refreshArgs.cacheClientCompositionResults = mCacheClientCompositionResults;
+    refreshArgs.layerFlatteningThreshold = mLayerFlatteningThreshold;
+    refreshArgs.snapshotLayerFEState = mSnapshotLayerFEState;
+    refreshArgs.skipIdleOutputs = mSkipIdleOutputs;
+    // The present fence of the default display drives the frame timing.
+    if (const auto display = ON_MAIN_THREAD(getDefaultDisplayDeviceLocked())) {
+        refreshArgs.timingOutput = display->getCompositionDisplay().get();
+    }
 
     if (mDebugRegion != 0) {
         refreshArgs.devOptFlashDirtyRegionsDelay =
@@ -2108,7 +2195,12 @@ void SurfaceFlinger::onMessageRefresh() {
     const auto presentTime = systemTime();
 
     mCompositionEngine->present(refreshArgs);
-    mTimeStats->recordFrameDuration(mFrameStartTime, systemTime());
+    const nsecs_t frameEndTime = systemTime();
+    mTimeStats->recordFrameDuration(mFrameStartTime, frameEndTime);
+    // The frame includes the RenderEngine work of client composition.
+    if (mFrameStartTime > 0) {
+        mPowerAdvisor.reportActualWorkDuration(frameEndTime - mFrameStartTime);
+    }
     // Reset the frame start time now that we've recorded this frame.
     mFrameStartTime = 0;
 
@@ -2139,7 +2231,8 @@ void SurfaceFlinger::onMessageRefresh() {
     }
 
     // TODO: b/160583065 Enable skip validation when SF caches all client composition layers
-    mVSyncModulator->onRefreshed(mHadClientComposition || mReusedClientComposition);
+    mVSyncModulator->onRefreshed(mHadClientComposition || mReusedClientComposition,
+                                 compositionFeatures);
 
     mLayersWithQueuedFrames.clear();
     if (mVisibleRegionsDirty) {
@@ -2163,9 +2256,7 @@ bool SurfaceFlinger::handleMessageInvalidate() {
     }
 
     for (auto& layer : mLayersPendingRefresh) {
-        Region visibleReg;
-        visibleReg.set(layer->getScreenBounds());
-        invalidateLayerStack(layer, visibleReg);
+        invalidateLayerStack(layer, layer->getScreenSpaceSurfaceDamage());
     }
     mLayersPendingRefresh.clear();
     return refreshNeeded;
@@ -2259,6 +2350,11 @@ void SurfaceFlinger::postComposition()
     auto presentFenceTime = std::make_shared<FenceTime>(mPreviousPresentFences[0]);
     getBE().mDisplayTimeline.push(presentFenceTime);
 
+    if (mFenceWatcher) {
+        mFenceWatcher->watch(glCompositionDoneFenceTime);
+        mFenceWatcher->watch(presentFenceTime);
+    }
+
     DisplayStatInfo stats;
     mScheduler->getDisplayStatInfo(&stats);
 
@@ -2280,6 +2376,8 @@ void SurfaceFlinger::postComposition()
             recordBufferingStats(layer->getName(), layer->getOccupancyHistory(false));
         }
     });
+    // The composition was handed to the HWC right before dequeueReadyTime was sampled.
+    mFrameTimeline->setSfPresent(dequeueReadyTime, glCompositionDoneFenceTime, presentFenceTime);
 
     mTransactionCompletedThread.addPresentFence(mPreviousPresentFences[0]);
     mTransactionCompletedThread.sendCallbacks();
@@ -2447,6 +2545,11 @@ void SurfaceFlinger::handleTransaction(uint32_t transactionFlags)
 }
 
 void SurfaceFlinger::processDisplayHotplugEventsLocked() {
+    // Power mode transitions still in flight may use the displays being disconnected.
+    if (!mPendingHotplugEvents.empty()) {
+        mHwcControlThread.waitForIdle();
+    }
+
     for (const auto& event : mPendingHotplugEvents) {
         const std::optional<DisplayIdentificationInfo> info =
                 getHwComposer().onHotplug(event.hwcDisplayId, event.connection);
@@ -2588,6 +2691,7 @@ sp<DisplayDevice> SurfaceFlinger::setupNewDisplayDeviceInternal(
 
     display->setLayerStack(state.layerStack);
     display->setProjection(state.orientation, state.viewport, state.frame);
+    display->setMaxFrameRate(state.maxFrameRate);
     display->setDisplayName(state.displayName);
 
     return display;
@@ -2743,6 +2847,9 @@ void SurfaceFlinger::processDisplayChanged(const wp<IBinder>& displayToken,
             display->setProjection(currentState.orientation, currentState.viewport,
                                    currentState.frame);
         }
+        if (currentState.maxFrameRate != drawingState.maxFrameRate) {
+            display->setMaxFrameRate(currentState.maxFrameRate);
+        }
         if (currentState.width != drawingState.width ||
             currentState.height != drawingState.height) {
             display->setDisplaySize(currentState.width, currentState.height);
@@ -2963,9 +3070,51 @@ void SurfaceFlinger::updateInputWindowInfo() {
         }
     });
 
-    mInputFlinger->setInputWindows(inputHandles,
-                                   mInputWindowCommands.syncInputWindows ? mSetInputWindowsListener
-                                                                         : nullptr);
+    const sp<ISetInputWindowsListener> listener =
+            mInputWindowCommands.syncInputWindows ? mSetInputWindowsListener : nullptr;
+    if (mIncrementalInputWindows) {
+        updateInputWindowsIncrementally(std::move(inputHandles), listener);
+        return;
+    }
+    mInputFlinger->setInputWindows(inputHandles, listener);
+}
+
+void SurfaceFlinger::updateInputWindowsIncrementally(std::vector<InputWindowInfo>&& inputInfos,
+                                                     const sp<ISetInputWindowsListener>& listener) {
+    std::unordered_map<int32_t, size_t> indices;
+    indices.reserve(inputInfos.size());
+    std::vector<int32_t> windowIds;
+    windowIds.reserve(inputInfos.size());
+    std::vector<InputWindowInfo> changedWindows;
+    bool orderChanged = inputInfos.size() != mLastInputWindowInfos.size();
+    bool uniqueIds = true;
+
+    for (size_t i = 0; i < inputInfos.size(); i++) {
+        const auto& info = inputInfos[i];
+        uniqueIds &= indices.emplace(info.id, i).second;
+        windowIds.push_back(info.id);
+        if (!orderChanged && mLastInputWindowInfos[i].id != info.id) {
+            orderChanged = true;
+        }
+
+        const auto last = mLastInputWindowIndices.find(info.id);
+        if (last == mLastInputWindowIndices.end() ||
+            mLastInputWindowInfos[last->second] != info) {
+            changedWindows.push_back(info);
+        }
+    }
+
+    if (!mHasSentInputWindows || !uniqueIds) {
+        // The delta is keyed by window id, so without a baseline or with ambiguous ids the
+        // whole list has to be sent.
+        mInputFlinger->setInputWindows(inputInfos, listener);
+        mHasSentInputWindows = uniqueIds;
+    } else if (orderChanged || !changedWindows.empty() || listener) {
+        mInputFlinger->updateInputWindows(changedWindows, windowIds, listener);
+    }
+
+    mLastInputWindowInfos = std::move(inputInfos);
+    mLastInputWindowIndices = std::move(indices);
 }
 
 void SurfaceFlinger::commitInputWindowCommands() {
@@ -2994,6 +3143,50 @@ void SurfaceFlinger::changeRefreshRate(const RefreshRate& refreshRate,
     changeRefreshRateLocked(refreshRate, event);
 }
 
+void SurfaceFlinger::updateFrameRateDivisors() {
+    if (!mFrameRateDivisorsEnabled) {
+        return;
+    }
+
+    // A uid is only throttled if every visible layer it owns has an explicit frame rate, since
+    // a layer without a vote may need to be driven at the display refresh rate.
+    const float refreshRate = mRefreshRateConfigs->getCurrentRefreshRate().getFps();
+    FrameRateDivisors divisors;
+    std::unordered_set<uid_t> unthrottledUids;
+    mDrawingState.traverse([&](Layer* layer) {
+        if (!layer->isVisible()) {
+            return;
+        }
+
+        const auto frameRate = layer->getFrameRateForLayerTree();
+        if (frameRate.type == Layer::FrameRateCompatibility::NoVote) {
+            return;
+        }
+
+        const uid_t uid = layer->getOwnerUid();
+        const auto divisor = Scheduler::getFrameRateDivisor(refreshRate, frameRate.rate);
+        if (divisor <= 1) {
+            unthrottledUids.insert(uid);
+            return;
+        }
+
+        // The uid must keep up with the fastest of its layers.
+        const auto [it, inserted] = divisors.emplace(uid, divisor);
+        if (!inserted) {
+            it->second = std::min(it->second, divisor);
+        }
+    });
+
+    for (const uid_t uid : unthrottledUids) {
+        divisors.erase(uid);
+    }
+
+    if (divisors != mFrameRateDivisors) {
+        mFrameRateDivisors = divisors;
+        mScheduler->setFrameRateDivisors(mAppConnectionHandle, std::move(divisors));
+    }
+}
+
 void SurfaceFlinger::initScheduler(DisplayId primaryDisplayId) {
     if (mScheduler) {
         // In practice it's not allowed to hotplug in/out the primary display once it's been
@@ -3071,7 +3264,7 @@ void SurfaceFlinger::commitTransactionLocked() {
             // when traversing layers on screen. Add the layer to the offscreenLayers set to
             // ensure we can copy its current to drawing state.
             if (!l->getParent()) {
-                mOffscreenLayers.emplace(l.get());
+                mOffscreenLayers.emplace(l.get(), systemTime());
             }
         }
         mLayersPendingRemoval.clear();
@@ -3097,10 +3290,12 @@ void SurfaceFlinger::commitTransactionLocked() {
 
     commitOffscreenLayers();
     mDrawingState.traverse([&](Layer* layer) { layer->updateMirrorInfo(); });
+    // Mirroring rebuilds the cloned hierarchies in place.
+    mDrawingState.invalidateZOrder();
 }
 
 void SurfaceFlinger::commitOffscreenLayers() {
-    for (Layer* offscreenLayer : mOffscreenLayers) {
+    for (const auto& [offscreenLayer, offscreenTime] : mOffscreenLayers) {
         offscreenLayer->traverse(LayerVector::StateSet::Drawing, [](Layer* layer) {
             uint32_t trFlags = layer->getTransactionFlags(eTransactionNeeded);
             if (!trFlags) return;
@@ -3111,6 +3306,22 @@ void SurfaceFlinger::commitOffscreenLayers() {
     }
 }
 
+void SurfaceFlinger::releaseStaleOffscreenBuffers(nsecs_t now) {
+    if (mOffscreenBufferTimeout <= 0) {
+        return;
+    }
+
+    for (const auto& [offscreenLayer, offscreenTime] : mOffscreenLayers) {
+        if (now - offscreenTime < mOffscreenBufferTimeout) {
+            continue;
+        }
+
+        ATRACE_NAME("releaseStaleOffscreenBuffers");
+        offscreenLayer->traverse(LayerVector::StateSet::Drawing,
+                                 [](Layer* layer) { layer->releaseOffscreenBuffers(); });
+    }
+}
+
 void SurfaceFlinger::invalidateLayerStack(const sp<const Layer>& layer, const Region& dirty) {
     for (const auto& [token, displayDevice] : ON_MAIN_THREAD(mDisplays)) {
         auto display = displayDevice->getCompositionDisplay();
@@ -3120,6 +3331,34 @@ void SurfaceFlinger::invalidateLayerStack(const sp<const Layer>& layer, const Re
     }
 }
 
+void SurfaceFlinger::prepareLatches() {
+    ATRACE_CALL();
+
+    const size_t layerCount = mLayersWithQueuedFrames.size();
+    if (layerCount < kMinLayersForParallelLatch) {
+        for (const auto& layer : mLayersWithQueuedFrames) {
+            layer->prepareLatch();
+        }
+        return;
+    }
+
+    // Split the layers into one contiguous range per thread. The drawing state doesn't change
+    // until the latch, and each layer only touches its own state.
+    const size_t taskCount = std::min(layerCount, kMaxLatchWorkerThreads + 1);
+    std::vector<compositionengine::impl::OutputWorkerPool::Task> tasks;
+    tasks.reserve(taskCount);
+    for (size_t i = 0; i < taskCount; i++) {
+        const size_t begin = layerCount * i / taskCount;
+        const size_t end = layerCount * (i + 1) / taskCount;
+        tasks.emplace_back([this, begin, end]() {
+            for (size_t j = begin; j < end; j++) {
+                mLayersWithQueuedFrames[j]->prepareLatch();
+            }
+        });
+    }
+    mLatchWorkerPool.runAll(tasks);
+}
+
 bool SurfaceFlinger::handlePageFlip()
 {
     ATRACE_CALL();
@@ -3159,12 +3398,15 @@ bool SurfaceFlinger::handlePageFlip()
     // The client can continue submitting buffers for offscreen layers, but they will not
     // be shown on screen. Therefore, we need to latch and release buffers of offscreen
     // layers to ensure dequeueBuffer doesn't block indefinitely.
-    for (Layer* offscreenLayer : mOffscreenLayers) {
+    for (const auto& [offscreenLayer, offscreenTime] : mOffscreenLayers) {
         offscreenLayer->traverse(LayerVector::StateSet::Drawing,
                                          [&](Layer* l) { l->latchAndReleaseBuffer(); });
     }
+    releaseStaleOffscreenBuffers(latchTime);
 
     if (!mLayersWithQueuedFrames.empty()) {
+        prepareLatches();
+
         // mStateLock is needed for latchBuffer as LayerRejecter::reject()
         // writes to Layer current state. See also b/119481871
         Mutex::Autolock lock(mStateLock);
@@ -3305,10 +3547,11 @@ bool SurfaceFlinger::flushTransactionQueues() {
     // to prevent onHandleDestroyed from being called while the lock is held,
     // we must keep a copy of the transactions (specifically the composer
     // states) around outside the scope of the lock
-    std::vector<const TransactionState> transactions;
+    std::vector<TransactionState> transactions;
     bool flushedATransaction = false;
     {
         Mutex::Autolock _l(mStateLock);
+        drainTransactionInboxLocked();
 
         auto it = mTransactionQueues.begin();
         while (it != mTransactionQueues.end()) {
@@ -3322,12 +3565,24 @@ bool SurfaceFlinger::flushTransactionQueues() {
                     break;
                 }
                 transactions.push_back(transaction);
-                applyTransactionState(transaction.states, transaction.displays, transaction.flags,
-                                      mPendingInputWindowCommands, transaction.desiredPresentTime,
-                                      transaction.buffer, transaction.postTime,
-                                      transaction.privileged, transaction.hasListenerCallbacks,
-                                      transaction.listenerCallbacks, /*isMainThread*/ true);
                 transactionQueue.pop();
+
+                auto& merged = transactions.back();
+                while (mCoalesceTransactions && !transactionQueue.empty()) {
+                    const auto& next = transactionQueue.front();
+                    if (!merged.canCoalesceWith(next) ||
+                        !transactionIsReadyToBeApplied(next.desiredPresentTime, next.states)) {
+                        break;
+                    }
+                    merged.coalesce(next);
+                    transactionQueue.pop();
+                }
+
+                applyTransactionState(merged.states, merged.displays, merged.flags,
+                                      mPendingInputWindowCommands, merged.desiredPresentTime,
+                                      merged.buffer, merged.postTime, merged.privileged,
+                                      merged.hasListenerCallbacks, merged.listenerCallbacks,
+                                      /*isMainThread*/ true);
                 flushedATransaction = true;
             }
 
@@ -3342,8 +3597,62 @@ bool SurfaceFlinger::flushTransactionQueues() {
     return flushedATransaction;
 }
 
+namespace {
+
+// Layer state changes which either carry a buffer, whose latching and release
+// must be observed once per transaction, or change the hierarchy, which makes
+// the order in which different layers are updated significant.
+constexpr uint64_t kCoalescingBarrierChanges = layer_state_t::eBufferChanged |
+        layer_state_t::eAcquireFenceChanged | layer_state_t::eCachedBufferChanged |
+        layer_state_t::eSidebandStreamChanged | layer_state_t::eProducerDisconnect |
+        layer_state_t::eDeferTransaction_legacy | layer_state_t::eReparentChildren |
+        layer_state_t::eDetachChildren | layer_state_t::eRelativeLayerChanged |
+        layer_state_t::eReparent | layer_state_t::eDestroySurface |
+        layer_state_t::eHasListenerCallbacksChanged;
+
+bool isCoalescable(const Vector<ComposerState>& states, const Vector<DisplayState>& displays,
+                   const client_cache_t& uncacheBuffer, bool hasListenerCallbacks) {
+    if (!displays.empty() || uncacheBuffer.isValid() || hasListenerCallbacks) {
+        return false;
+    }
+    for (const ComposerState& state : states) {
+        if (state.state.what & kCoalescingBarrierChanges) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+bool SurfaceFlinger::TransactionState::canCoalesceWith(const TransactionState& other) const {
+    return privileged == other.privileged &&
+            isCoalescable(states, displays, buffer, hasListenerCallbacks) &&
+            isCoalescable(other.states, other.displays, other.buffer, other.hasListenerCallbacks);
+}
+
+void SurfaceFlinger::TransactionState::coalesce(const TransactionState& other) {
+    for (const ComposerState& otherState : other.states) {
+        auto it = std::find_if(states.begin(), states.end(), [&](const ComposerState& state) {
+            return state.state.surface == otherState.state.surface;
+        });
+        if (it != states.end()) {
+            it->state.merge(otherState.state);
+        } else {
+            states.add(otherState);
+        }
+    }
+    flags |= other.flags;
+}
+
 bool SurfaceFlinger::transactionFlushNeeded() {
-    return !mTransactionQueues.empty();
+    return !mTransactionQueues.empty() || !mTransactionInbox.empty();
+}
+
+void SurfaceFlinger::drainTransactionInboxLocked() {
+    mTransactionInbox.drain([this](std::pair<sp<IBinder>, TransactionState>&& pending) {
+        mTransactionQueues[pending.first].push(std::move(pending.second));
+    });
 }
 
 
@@ -3381,7 +3690,20 @@ void SurfaceFlinger::setTransactionState(
 
     bool privileged = callingThreadHasUnscopedSurfaceFlingerAccess();
 
+    // A transaction which cannot be applied yet only needs to be queued, which does not require
+    // mStateLock. Animation transactions still take the lock below, since they have to wait for
+    // the prior animation frame to be applied.
+    if (!(flags & eAnimation) && !transactionIsReadyToBeApplied(desiredPresentTime, states)) {
+        mTransactionInbox.post(applyToken,
+                               TransactionState(states, displays, flags, desiredPresentTime,
+                                                uncacheBuffer, postTime, privileged,
+                                                hasListenerCallbacks, listenerCallbacks));
+        setTransactionFlags(eTransactionFlushNeeded);
+        return;
+    }
+
     Mutex::Autolock _l(mStateLock);
+    drainTransactionInboxLocked();
 
     // If its TransactionQueue already has a pending TransactionState or if it is pending
     auto itr = mTransactionQueues.find(applyToken);
@@ -3396,6 +3718,7 @@ void SurfaceFlinger::setTransactionState(
                          "waiting for animation frame to apply");
                 break;
             }
+            drainTransactionInboxLocked();
             itr = mTransactionQueues.find(applyToken);
         }
     }
@@ -3453,7 +3776,22 @@ void SurfaceFlinger::applyTransactionState(
 
     std::unordered_set<ListenerCallbacks, ListenerCallbacksHash> listenerCallbacksWithSurfaces;
     uint32_t clientStateFlags = 0;
+    scheduler::CompositionPredictor::Features addedCompositionFeatures;
     for (const ComposerState& state : states) {
+        // Collect what this transaction adds to the next frame, so that VSyncModulator can move
+        // into early GL offsets if the frame is likely to need client composition.
+        const layer_state_t& s = state.state;
+        if ((s.what & layer_state_t::eFlagsChanged) && (s.mask & layer_state_t::eLayerHidden) &&
+            !(s.flags & layer_state_t::eLayerHidden)) {
+            addedCompositionFeatures.layerCount++;
+        }
+        if ((s.what & layer_state_t::eBackgroundBlurRadiusChanged) && s.backgroundBlurRadius > 0) {
+            addedCompositionFeatures.hasBlur = true;
+        }
+        if ((s.what & layer_state_t::eCornerRadiusChanged) && s.cornerRadius > 0.0f) {
+            addedCompositionFeatures.hasRoundedCorners = true;
+        }
+
         clientStateFlags |= setClientStateLocked(state, desiredPresentTime, postTime, privileged,
                                                  listenerCallbacksWithSurfaces);
         if ((flags & eAnimation) && state.state.surface) {
@@ -3515,6 +3853,11 @@ void SurfaceFlinger::applyTransactionState(
             mInterceptor->saveTransaction(states, mCurrentState.displays, displays, flags);
         }
 
+        if (addedCompositionFeatures.layerCount > 0 || addedCompositionFeatures.hasBlur ||
+            addedCompositionFeatures.hasRoundedCorners) {
+            mVSyncModulator->onCompositionChangePending(addedCompositionFeatures);
+        }
+
         // TODO(b/159125966): Remove eEarlyWakeup completly as no client should use this flag
         if (flags & eEarlyWakeup) {
             ALOGW("eEarlyWakeup is deprecated. Use eExplicitEarlyWakeup[Start|End]");
@@ -3617,6 +3960,17 @@ uint32_t SurfaceFlinger::setDisplayStateLocked(const DisplayState& s) {
             flags |= eDisplayTransactionNeeded;
         }
     }
+    if (what & DisplayState::eFrameRateChanged) {
+        // Physical displays are composed on every refresh, as their rate is
+        // set by their config.
+        if (!state.isVirtual()) {
+            ALOGW("Ignoring a maximum frame rate for physical display %s",
+                  state.displayName.c_str());
+        } else if (state.maxFrameRate != s.maxFrameRate) {
+            state.maxFrameRate = s.maxFrameRate;
+            flags |= eDisplayTransactionNeeded;
+        }
+    }
 
     return flags;
 }
@@ -3936,6 +4290,11 @@ uint32_t SurfaceFlinger::setClientStateLocked(
         buffer = s.buffer;
     }
     if (buffer) {
+        // Surface damage describes a single buffer, so a buffer sent without damage of its own
+        // is damaged everywhere.
+        if (!(what & layer_state_t::eSurfaceDamageRegionChanged)) {
+            layer->setSurfaceDamageRegion(Region::INVALID_REGION);
+        }
         if (layer->setBuffer(buffer, s.acquireFence, postTime, desiredPresentTime,
                              s.cachedBuffer)) {
             flags |= eTraversalNeeded;
@@ -4253,6 +4612,14 @@ void SurfaceFlinger::setPowerModeInternal(const sp<DisplayDevice>& display, hal:
     const auto displayId = display->getId();
     LOG_ALWAYS_FATAL_IF(!displayId);
 
+    // Transitions of a display are applied one at a time, so that each one starts from the
+    // mode the previous one left the HWC and the scheduler in.
+    if (display->isPowerModeTransitionPending()) {
+        ALOGD("Queueing power mode %d on display %s", mode, to_string(*displayId).c_str());
+        display->queuePowerMode(mode);
+        return;
+    }
+
     ALOGD("Setting power mode %d on display %s", mode, to_string(*displayId).c_str());
 
     const hal::PowerMode currentMode = display->getPowerMode();
@@ -4265,21 +4632,10 @@ void SurfaceFlinger::setPowerModeInternal(const sp<DisplayDevice>& display, hal:
     if (mInterceptor->isEnabled()) {
         mInterceptor->savePowerModeUpdate(display->getSequenceId(), static_cast<int32_t>(mode));
     }
-    const auto vsyncPeriod = mRefreshRateConfigs->getCurrentRefreshRate().getVsyncPeriod();
     if (currentMode == hal::PowerMode::OFF) {
         if (SurfaceFlinger::setSchedFifo(true) != NO_ERROR) {
             ALOGW("Couldn't set SCHED_FIFO on display on: %s\n", strerror(errno));
         }
-        getHwComposer().setPowerMode(*displayId, mode);
-        if (display->isPrimary() && mode != hal::PowerMode::DOZE_SUSPEND) {
-            getHwComposer().setVsyncEnabled(*displayId, mHWCVsyncPendingState);
-            mScheduler->onScreenAcquired(mAppConnectionHandle);
-            mScheduler->resyncToHardwareVsync(true, vsyncPeriod);
-        }
-
-        mVisibleRegionsDirty = true;
-        mHasPoweredOff = true;
-        repaintEverything();
     } else if (mode == hal::PowerMode::OFF) {
         // Turn off the display
         if (SurfaceFlinger::setSchedFifo(false) != NO_ERROR) {
@@ -4289,30 +4645,77 @@ void SurfaceFlinger::setPowerModeInternal(const sp<DisplayDevice>& display, hal:
             mScheduler->disableHardwareVsync(true);
             mScheduler->onScreenReleased(mAppConnectionHandle);
         }
+    } else if (mode == hal::PowerMode::DOZE_SUSPEND) {
+        // Leave display going to doze
+        if (display->isPrimary()) {
+            mScheduler->disableHardwareVsync(true);
+            mScheduler->onScreenReleased(mAppConnectionHandle);
+        }
+    } else if (mode != hal::PowerMode::DOZE && mode != hal::PowerMode::ON) {
+        ALOGE("Attempting to set unknown power mode: %d\n", mode);
+    }
 
-        // Make sure HWVsync is disabled before turning off the display
-        getHwComposer().setVsyncEnabled(*displayId, hal::Vsync::DISABLE);
+    const bool enableVsync = currentMode == hal::PowerMode::OFF && display->isPrimary() &&
+            mode != hal::PowerMode::DOZE_SUSPEND;
+    const hal::Vsync vsyncState = mHWCVsyncPendingState;
+    auto applyToHwc = [this, id = *displayId, mode, enableVsync, vsyncState]() {
+        ATRACE_NAME("setPowerMode");
+        if (mode == hal::PowerMode::OFF) {
+            // Make sure HWVsync is disabled before turning off the display
+            getHwComposer().setVsyncEnabled(id, hal::Vsync::DISABLE);
+        }
+        getHwComposer().setPowerMode(id, mode);
+        if (enableVsync) {
+            getHwComposer().setVsyncEnabled(id, vsyncState);
+        }
+    };
+
+    if (!mHwcControlThread.isStarted()) {
+        applyToHwc();
+        onPowerModeTransitionDone(display, currentMode, mode);
+        return;
+    }
+
+    // Powering a panel on or off takes the HWC tens of milliseconds, during which the other
+    // displays keep being composed. This one is not composed until the transition is done.
+    display->setPowerModeTransitionPending(true);
+    mHwcControlThread.post([this, display, currentMode, mode, applyToHwc]() {
+        applyToHwc();
+        static_cast<void>(schedule([this, display, currentMode, mode]() MAIN_THREAD {
+            display->setPowerModeTransitionPending(false);
+            onPowerModeTransitionDone(display, currentMode, mode);
+            if (display->isPoweredOn()) {
+                // Catch up with the frames composed while the display was paused.
+                repaintEverything();
+            }
+            if (const auto queuedMode = display->takeQueuedPowerMode()) {
+                setPowerModeInternal(display, *queuedMode);
+            }
+        }));
+    });
+}
 
-        getHwComposer().setPowerMode(*displayId, mode);
+void SurfaceFlinger::onPowerModeTransitionDone(const sp<DisplayDevice>& display,
+                                               hal::PowerMode previousMode, hal::PowerMode mode) {
+    const auto vsyncPeriod = mRefreshRateConfigs->getCurrentRefreshRate().getVsyncPeriod();
+    if (previousMode == hal::PowerMode::OFF) {
+        if (display->isPrimary() && mode != hal::PowerMode::DOZE_SUSPEND) {
+            mScheduler->onScreenAcquired(mAppConnectionHandle);
+            mScheduler->resyncToHardwareVsync(true, vsyncPeriod);
+        }
+
+        mVisibleRegionsDirty = true;
+        mHasPoweredOff = true;
+        repaintEverything();
+    } else if (mode == hal::PowerMode::OFF) {
         mVisibleRegionsDirty = true;
         // from this point on, SF will stop drawing on this display
     } else if (mode == hal::PowerMode::DOZE || mode == hal::PowerMode::ON) {
         // Update display while dozing
-        getHwComposer().setPowerMode(*displayId, mode);
-        if (display->isPrimary() && currentMode == hal::PowerMode::DOZE_SUSPEND) {
+        if (display->isPrimary() && previousMode == hal::PowerMode::DOZE_SUSPEND) {
             mScheduler->onScreenAcquired(mAppConnectionHandle);
             mScheduler->resyncToHardwareVsync(true, vsyncPeriod);
         }
-    } else if (mode == hal::PowerMode::DOZE_SUSPEND) {
-        // Leave display going to doze
-        if (display->isPrimary()) {
-            mScheduler->disableHardwareVsync(true);
-            mScheduler->onScreenReleased(mAppConnectionHandle);
-        }
-        getHwComposer().setPowerMode(*displayId, mode);
-    } else {
-        ALOGE("Attempting to set unknown power mode: %d\n", mode);
-        getHwComposer().setPowerMode(*displayId, mode);
     }
 
     if (display->isPrimary()) {
@@ -4321,7 +4724,8 @@ void SurfaceFlinger::setPowerModeInternal(const sp<DisplayDevice>& display, hal:
         mScheduler->setDisplayPowerState(mode == hal::PowerMode::ON);
     }
 
-    ALOGD("Finished setting power mode %d on display %s", mode, to_string(*displayId).c_str());
+    ALOGD("Finished setting power mode %d on display %s", mode,
+          to_string(*display->getId()).c_str());
 }
 
 void SurfaceFlinger::setPowerMode(const sp<IBinder>& displayToken, int mode) {
@@ -4336,6 +4740,9 @@ void SurfaceFlinger::setPowerMode(const sp<IBinder>& displayToken, int mode) {
             setPowerModeInternal(display, static_cast<hal::PowerMode>(mode));
         }
     }).wait();
+
+    // Return once the HWC has applied the mode, as before it was applied off the main thread.
+    mHwcControlThread.waitForIdle();
 }
 
 status_t SurfaceFlinger::doDump(int fd, const DumpArgs& args, bool asProto) {
@@ -4352,34 +4759,60 @@ status_t SurfaceFlinger::doDump(int fd, const DumpArgs& args, bool asProto) {
     } else {
         static const std::unordered_map<std::string, Dumper> dumpers = {
                 {"--display-id"s, dumper(&SurfaceFlinger::dumpDisplayIdentificationData)},
-                {"--dispsync"s,
-                 dumper([this](std::string& s) { mScheduler->getPrimaryDispSync().dump(s); })},
                 {"--edid"s, argsDumper(&SurfaceFlinger::dumpRawDisplayIdentificationData)},
                 {"--frame-events"s, dumper(&SurfaceFlinger::dumpFrameEventsLocked)},
                 {"--latency"s, argsDumper(&SurfaceFlinger::dumpStatsLocked)},
                 {"--latency-clear"s, argsDumper(&SurfaceFlinger::clearStatsLocked)},
                 {"--list"s, dumper(&SurfaceFlinger::listLayersLocked)},
-                {"--static-screen"s, dumper(&SurfaceFlinger::dumpStaticScreenStats)},
-                {"--timestats"s, protoDumper(&SurfaceFlinger::dumpTimeStats)},
                 {"--vsync"s, dumper(&SurfaceFlinger::dumpVSync)},
                 {"--wide-color"s, dumper(&SurfaceFlinger::dumpWideColorInfo)},
         };
 
+        // Sections which don't read the state guarded by mStateLock, so that they can be polled
+        // without contending with transactions and display changes on the main thread.
+        static const std::unordered_map<std::string, Dumper> unlockedDumpers = {
+                {"--counters"s, dumper(&SurfaceFlinger::dumpCounters)},
+                {"--counters-binary"s, dumper(&SurfaceFlinger::dumpCountersBinary)},
+                {"--dispsync"s,
+                 dumper([this](std::string& s) { mScheduler->getPrimaryDispSync().dump(s); })},
+                {"--frametimeline"s, dumper([this](std::string& s) { mFrameTimeline->dump(s); })},
+                // Offscreen layers are read on the main thread, which may be waiting for
+                // mStateLock.
+                {"--offscreen"s, dumper(&SurfaceFlinger::dumpOffscreenLayerMemory)},
+                {"--static-screen"s, dumper(&SurfaceFlinger::dumpStaticScreenStats)},
+                {"--timestats"s, protoDumper(&SurfaceFlinger::dumpTimeStats)},
+        };
+
         const auto flag = args.empty() ? ""s : std::string(String8(args[0]));
 
         bool dumpLayers = true;
-        {
-            TimedLock lock(mStateLock, s2ns(1), __FUNCTION__);
-            if (!lock.locked()) {
-                StringAppendF(&result, "Dumping without lock after timeout: %s (%d)\n",
-                              strerror(-lock.status), lock.status);
+        if (const auto it = unlockedDumpers.find(flag); it != unlockedDumpers.end()) {
+            (it->second)(args, asProto, result);
+            dumpLayers = false;
+        } else {
+            const auto it = dumpers.find(flag);
+            const bool dumpAll = it == dumpers.end() && !asProto;
+            if (dumpAll) {
+                dumpBuildConfiguration(args, result);
             }
 
-            if (const auto it = dumpers.find(flag); it != dumpers.end()) {
-                (it->second)(args, asProto, result);
-                dumpLayers = false;
-            } else if (!asProto) {
-                dumpAllLocked(args, result);
+            {
+                TimedLock lock(mStateLock, s2ns(1), __FUNCTION__);
+                if (!lock.locked()) {
+                    StringAppendF(&result, "Dumping without lock after timeout: %s (%d)\n",
+                                  strerror(-lock.status), lock.status);
+                }
+
+                if (it != dumpers.end()) {
+                    (it->second)(args, asProto, result);
+                    dumpLayers = false;
+                } else if (dumpAll) {
+                    dumpAllLocked(args, result);
+                }
+            }
+
+            if (dumpAll) {
+                dumpAllocatorAndTimeStats(result);
             }
         }
 
@@ -4680,7 +5113,7 @@ void SurfaceFlinger::dumpOffscreenLayersProto(LayersProto& layersProto, uint32_t
     rootProto->set_name("Offscreen Root");
     rootProto->set_parent(-1);
 
-    for (Layer* offscreenLayer : mOffscreenLayers) {
+    for (const auto& [offscreenLayer, offscreenTime] : mOffscreenLayers) {
         // Add layer as child of the fake root
         rootProto->add_children(offscreenLayer->sequence);
 
@@ -4699,7 +5132,7 @@ void SurfaceFlinger::dumpOffscreenLayers(std::string& result) {
     result.append("Offscreen Layers:\n");
     result.append(schedule([this] {
                       std::string result;
-                      for (Layer* offscreenLayer : mOffscreenLayers) {
+                      for (const auto& [offscreenLayer, offscreenTime] : mOffscreenLayers) {
                           offscreenLayer->traverse(LayerVector::StateSet::Drawing,
                                                    [&](Layer* layer) {
                                                        layer->dumpCallingUidPid(result);
@@ -4707,6 +5140,64 @@ void SurfaceFlinger::dumpOffscreenLayers(std::string& result) {
                       }
                       return result;
                   }).get());
+    result.append("\n");
+    dumpOffscreenLayerMemory(result);
+}
+
+void SurfaceFlinger::dumpOffscreenLayerMemory(std::string& result) {
+    struct BufferUsage {
+        size_t layerCount = 0;
+        size_t bufferCount = 0;
+        size_t bufferBytes = 0;
+
+        void add(size_t bytes) {
+            layerCount++;
+            bufferCount += bytes > 0 ? 1 : 0;
+            bufferBytes += bytes;
+        }
+    };
+
+    const auto toKiB = [](size_t bytes) { return static_cast<double>(bytes) / 1024.0; };
+
+    result.append(schedule([&] {
+                      std::string result;
+                      StringAppendF(&result,
+                                    "Offscreen layer buffers (release timeout: %" PRId64 " ms):\n",
+                                    ns2ms(mOffscreenBufferTimeout));
+
+                      const nsecs_t now = systemTime();
+                      std::map<std::pair<pid_t, uid_t>, BufferUsage> clients;
+                      BufferUsage total;
+                      for (const auto& [offscreenLayer, offscreenTime] : mOffscreenLayers) {
+                          BufferUsage tree;
+                          offscreenLayer->traverse(LayerVector::StateSet::Drawing,
+                                                   [&](Layer* layer) {
+                                                       const size_t bytes =
+                                                               getBufferSize(layer->getBuffer());
+                                                       clients[{layer->getOwnerPid(),
+                                                                layer->getOwnerUid()}]
+                                                               .add(bytes);
+                                                       tree.add(bytes);
+                                                       total.add(bytes);
+                                                   });
+                          StringAppendF(&result,
+                                        "  %s: offscreen for %.1f s, %zu layers, %.1f KiB\n",
+                                        offscreenLayer->getName().c_str(),
+                                        static_cast<double>(now - offscreenTime) / 1e9,
+                                        tree.layerCount, toKiB(tree.bufferBytes));
+                      }
+
+                      result.append("Per client:\n");
+                      for (const auto& [owner, usage] : clients) {
+                          StringAppendF(&result,
+                                        "  pid:%d uid:%d layers:%zu buffers:%zu %.1f KiB\n",
+                                        owner.first, owner.second, usage.layerCount,
+                                        usage.bufferCount, toKiB(usage.bufferBytes));
+                      }
+                      StringAppendF(&result, "Total: %zu layers, %zu buffers, %.1f KiB\n",
+                                    total.layerCount, total.bufferCount, toKiB(total.bufferBytes));
+                      return result;
+                  }).get());
 }
 
 void SurfaceFlinger::dumpAllLocked(const DumpArgs& args, std::string& result) const {
@@ -4718,18 +5209,6 @@ void SurfaceFlinger::dumpAllLocked(const DumpArgs& args, std::string& result) co
     const nsecs_t inTransaction(mDebugInTransaction);
     nsecs_t inTransactionDuration = (inTransaction) ? now-inTransaction : 0;
 
-    /*
-     * Dump library configuration.
-     */
-
-    colorizer.bold(result);
-    result.append("Build configuration:");
-    colorizer.reset(result);
-    appendSfConfigString(result);
-    appendUiConfigString(result);
-    appendGuiConfigString(result);
-    result.append("\n");
-
     result.append("\nDisplay identification data:\n");
     dumpDisplayIdentificationData(result);
 
@@ -4757,6 +5236,9 @@ void SurfaceFlinger::dumpAllLocked(const DumpArgs& args, std::string& result) co
 
     dumpBufferingStats(result);
 
+    ClientCache::getInstance().dump(result);
+    result.append("\n");
+
     /*
      * Dump the visible layer list
      */
@@ -4768,7 +5250,10 @@ void SurfaceFlinger::dumpAllLocked(const DumpArgs& args, std::string& result) co
 
     {
         StringAppendF(&result, "Composition layers\n");
-        mDrawingState.traverseInZOrder([&](Layer* layer) {
+        // Dumps run on a binder thread, so walk the tree directly rather than through the cached
+        // draw order, which the main thread owns.
+        const auto stateSet = LayerVector::StateSet::Drawing;
+        mDrawingState.layersSortedByZ.traverseInZOrder(stateSet, [&](Layer* layer) {
             auto* compositionState = layer->getCompositionState();
             if (!compositionState) return;
 
@@ -4865,7 +5350,26 @@ void SurfaceFlinger::dumpAllLocked(const DumpArgs& args, std::string& result) co
     bool hwcDisabled = mDebugDisableHWC || mDebugRegion;
     StringAppendF(&result, "  h/w composer %s\n", hwcDisabled ? "disabled" : "enabled");
     getHwComposer().dump(result);
+}
+
+void SurfaceFlinger::dumpBuildConfiguration(const DumpArgs& args, std::string& result) const {
+    const bool colorize = !args.empty() && args[0] == String16("--color");
+    Colorizer colorizer(colorize);
 
+    /*
+     * Dump library configuration.
+     */
+
+    colorizer.bold(result);
+    result.append("Build configuration:");
+    colorizer.reset(result);
+    appendSfConfigString(result);
+    appendUiConfigString(result);
+    appendGuiConfigString(result);
+    result.append("\n");
+}
+
+void SurfaceFlinger::dumpAllocatorAndTimeStats(std::string& result) const {
     /*
      * Dump gralloc state
      */
@@ -4885,6 +5389,50 @@ void SurfaceFlinger::dumpAllLocked(const DumpArgs& args, std::string& result) co
     result.append("\n");
 }
 
+std::vector<std::pair<const char*, int64_t>> SurfaceFlinger::getCounters() const {
+    const nsecs_t vsyncPeriod =
+            mRefreshRateConfigs ? mRefreshRateConfigs->getCurrentRefreshRate().getVsyncPeriod() : 0;
+
+    return {
+            {"layers", static_cast<int64_t>(mNumLayers.load())},
+            {"missed_frames", mFrameMissedCount.load()},
+            {"hwc_missed_frames", mHwcFrameMissedCount.load()},
+            {"gpu_missed_frames", mGpuFrameMissedCount.load()},
+            {"transaction_flags", mTransactionFlags.load()},
+            {"refresh_pending", mRefreshPending.load()},
+            {"expected_present_time", mExpectedPresentTime.load()},
+            {"last_swap_time", getBE().mLastSwapTime.load()},
+            {"vsync_period", vsyncPeriod},
+            {"graphic_buffer_bytes",
+             static_cast<int64_t>(GraphicBufferAllocator::get().getTotalSize())},
+            {"boot_finished", mBootFinished.load()},
+    };
+}
+
+void SurfaceFlinger::dumpCounters(std::string& result) const {
+    for (const auto& [name, value] : getCounters()) {
+        StringAppendF(&result, "%s=%" PRId64 "\n", name, value);
+    }
+}
+
+void SurfaceFlinger::dumpCountersBinary(std::string& result) const {
+    const auto append = [&result](const auto& value) {
+        result.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    };
+
+    const auto counters = getCounters();
+    append(kCountersMagic);
+    append(kCountersVersion);
+    append(static_cast<uint32_t>(counters.size()));
+
+    for (const auto& [name, value] : counters) {
+        const auto length = static_cast<uint16_t>(strlen(name));
+        append(length);
+        result.append(name, length);
+        append(value);
+    }
+}
+
 void SurfaceFlinger::updateColorMatrixLocked() {
     mat4 colorMatrix;
     if (mGlobalSaturationFactor != 1.0f) {
@@ -4992,6 +5540,7 @@ status_t SurfaceFlinger::CheckTransactCodeCredentials(uint32_t code) {
         }
         case CAPTURE_LAYERS:
         case CAPTURE_SCREEN:
+        case CAPTURE_SCREEN_INTO_BUFFER:
         case ADD_REGION_SAMPLING_LISTENER:
         case REMOVE_REGION_SAMPLING_LISTENER: {
             // codes that require permission check
@@ -5023,9 +5572,9 @@ status_t SurfaceFlinger::CheckTransactCodeCredentials(uint32_t code) {
         code == IBinder::SYSPROPS_TRANSACTION) {
         return OK;
     }
-    // Numbers from 1000 to 1036 are currently used for backdoors. The code
+    // Numbers from 1000 to 1037 are currently used for backdoors. The code
     // in onTransact verifies that the user is root, and has access to use SF.
-    if (code >= 1000 && code <= 1036) {
+    if (code >= 1000 && code <= 1037) {
         ALOGV("Accessing SurfaceFlinger through backdoor code: %u", code);
         return OK;
     }
@@ -5366,6 +5915,12 @@ status_t SurfaceFlinger::onTransact(uint32_t code, const Parcel& data, Parcel* r
                 }
                 return NO_ERROR;
             }
+            // Trim the client buffer cache to the given number of bytes, on memory pressure
+            case 1037: {
+                const int64_t targetBytes = std::max<int64_t>(0, data.readInt64());
+                ClientCache::getInstance().trim(static_cast<size_t>(targetBytes));
+                return NO_ERROR;
+            }
         }
     }
     return err;
@@ -5382,6 +5937,12 @@ void SurfaceFlinger::repaintEverythingForHWC() {
     mEventQueue->invalidate();
 }
 
+void SurfaceFlinger::onVsyncPredictionError(nsecs_t idealPeriod, nsecs_t error) {
+    if (idealPeriod <= 0) return;
+    const uint32_t fps = static_cast<uint32_t>((1e9f / idealPeriod) + 0.5f);
+    mTimeStats->recordVsyncPredictionError(fps, error);
+}
+
 void SurfaceFlinger::kernelTimerChanged(bool expired) {
     static bool updateOverlay =
             property_get_bool("debug.sf.kernel_idle_timer_update_overlay", true);
@@ -5460,42 +6021,96 @@ status_t SurfaceFlinger::captureScreen(const sp<IBinder>& displayToken,
 
     if (!displayToken) return BAD_VALUE;
 
+    sp<DisplayDevice> display;
+    ui::Transform::RotationFlags renderAreaRotation;
+    if (status_t result = getDisplayForCapture(displayToken, rotation, &reqWidth, &reqHeight,
+                                               &display, &renderAreaRotation);
+        result != NO_ERROR) {
+        return result;
+    }
+
+    DisplayRenderArea renderArea(display, sourceCrop, reqWidth, reqHeight, reqDataspace,
+                                 renderAreaRotation, captureSecureLayers);
+    auto traverseLayers = std::bind(&SurfaceFlinger::traverseLayersInDisplay, this, display,
+                                    std::placeholders::_1);
+    return captureScreenCommon(renderArea, traverseLayers, outBuffer, reqPixelFormat,
+                               useIdentityTransform, outCapturedSecureLayers);
+}
+
+status_t SurfaceFlinger::captureScreenIntoBuffer(const sp<IBinder>& displayToken,
+                                                 const sp<GraphicBuffer>& buffer,
+                                                 Dataspace reqDataspace, const Rect& sourceCrop,
+                                                 bool useIdentityTransform, ui::Rotation rotation,
+                                                 bool captureSecureLayers,
+                                                 bool& outCapturedSecureLayers,
+                                                 sp<Fence>* outFence) {
+    ATRACE_CALL();
+
+    if (!displayToken || !buffer || !outFence) return BAD_VALUE;
+    if ((buffer->getUsage() & GRALLOC_USAGE_HW_RENDER) == 0 || buffer->getWidth() == 0 ||
+        buffer->getHeight() == 0) {
+        ALOGE("%s: Buffer is not renderable", __FUNCTION__);
+        return BAD_VALUE;
+    }
+
+    uint32_t reqWidth = buffer->getWidth();
+    uint32_t reqHeight = buffer->getHeight();
+    sp<DisplayDevice> display;
+    ui::Transform::RotationFlags renderAreaRotation;
+    if (status_t result = getDisplayForCapture(displayToken, rotation, &reqWidth, &reqHeight,
+                                               &display, &renderAreaRotation);
+        result != NO_ERROR) {
+        return result;
+    }
+
+    DisplayRenderArea renderArea(display, sourceCrop, reqWidth, reqHeight, reqDataspace,
+                                 renderAreaRotation, captureSecureLayers);
+    auto traverseLayers = std::bind(&SurfaceFlinger::traverseLayersInDisplay, this, display,
+                                    std::placeholders::_1);
+    base::unique_fd fence;
+    const status_t result =
+            captureScreenCommonAsync(renderArea, traverseLayers, buffer, useIdentityTransform,
+                                     false /* regionSampling */, outCapturedSecureLayers, &fence);
+    if (result == NO_ERROR) {
+        *outFence = fence.get() >= 0 ? sp<Fence>(new Fence(std::move(fence))) : Fence::NO_FENCE;
+    }
+    return result;
+}
+
+status_t SurfaceFlinger::getDisplayForCapture(const sp<IBinder>& displayToken,
+                                              ui::Rotation rotation, uint32_t* reqWidth,
+                                              uint32_t* reqHeight, sp<DisplayDevice>* outDisplay,
+                                              ui::Transform::RotationFlags* outRotation) {
     auto renderAreaRotation = ui::Transform::toRotationFlags(rotation);
     if (renderAreaRotation == ui::Transform::ROT_INVALID) {
         ALOGE("%s: Invalid rotation: %s", __FUNCTION__, toCString(rotation));
         renderAreaRotation = ui::Transform::ROT_0;
     }
 
-    sp<DisplayDevice> display;
-    {
-        Mutex::Autolock lock(mStateLock);
+    Mutex::Autolock lock(mStateLock);
 
-        display = getDisplayDeviceLocked(displayToken);
-        if (!display) return NAME_NOT_FOUND;
+    const auto display = getDisplayDeviceLocked(displayToken);
+    if (!display) return NAME_NOT_FOUND;
 
-        if (display->isPrimary()) {
-            const auto physicalOrientation = display->getPhysicalOrientation();
-            renderAreaRotation = ui::Transform::toRotationFlags(rotation + physicalOrientation);
-            if (renderAreaRotation == ui::Transform::ROT_INVALID) {
-                ALOGE("%s: Invalid rotation: %s", __FUNCTION__, toCString(rotation));
-                renderAreaRotation = ui::Transform::ROT_0;
-            }
+    if (display->isPrimary()) {
+        const auto physicalOrientation = display->getPhysicalOrientation();
+        renderAreaRotation = ui::Transform::toRotationFlags(rotation + physicalOrientation);
+        if (renderAreaRotation == ui::Transform::ROT_INVALID) {
+            ALOGE("%s: Invalid rotation: %s", __FUNCTION__, toCString(rotation));
+            renderAreaRotation = ui::Transform::ROT_0;
         }
+    }
 
-        // set the requested width/height to the logical display viewport size
-        // by default
-        if (reqWidth == 0 || reqHeight == 0) {
-            reqWidth = uint32_t(display->getViewport().width());
-            reqHeight = uint32_t(display->getViewport().height());
-        }
+    // set the requested width/height to the logical display viewport size
+    // by default
+    if (*reqWidth == 0 || *reqHeight == 0) {
+        *reqWidth = uint32_t(display->getViewport().width());
+        *reqHeight = uint32_t(display->getViewport().height());
     }
 
-    DisplayRenderArea renderArea(display, sourceCrop, reqWidth, reqHeight, reqDataspace,
-                                 renderAreaRotation, captureSecureLayers);
-    auto traverseLayers = std::bind(&SurfaceFlinger::traverseLayersInDisplay, this, display,
-                                    std::placeholders::_1);
-    return captureScreenCommon(renderArea, traverseLayers, outBuffer, reqPixelFormat,
-                               useIdentityTransform, outCapturedSecureLayers);
+    *outDisplay = display;
+    *outRotation = renderAreaRotation;
+    return NO_ERROR;
 }
 
 static Dataspace pickDataspaceFromColorMode(const ColorMode colorMode) {
@@ -5832,6 +6447,22 @@ status_t SurfaceFlinger::captureScreenCommon(RenderArea& renderArea,
                                              const sp<GraphicBuffer>& buffer,
                                              bool useIdentityTransform, bool regionSampling,
                                              bool& outCapturedSecureLayers) {
+    base::unique_fd fence;
+    const status_t result = captureScreenCommonAsync(renderArea, traverseLayers, buffer,
+                                                     useIdentityTransform, regionSampling,
+                                                     outCapturedSecureLayers, &fence);
+    if (result == NO_ERROR && fence.get() >= 0) {
+        sync_wait(fence.get(), -1);
+    }
+    return result;
+}
+
+status_t SurfaceFlinger::captureScreenCommonAsync(RenderArea& renderArea,
+                                                  TraverseLayersFunction traverseLayers,
+                                                  const sp<GraphicBuffer>& buffer,
+                                                  bool useIdentityTransform, bool regionSampling,
+                                                  bool& outCapturedSecureLayers,
+                                                  base::unique_fd* outFence) {
     const int uid = IPCThreadState::self()->getCallingUid();
     const bool forSystem = uid == AID_GRAPHICS || uid == AID_SYSTEM;
 
@@ -5860,11 +6491,9 @@ status_t SurfaceFlinger::captureScreenCommon(RenderArea& renderArea,
                 }).get();
     } while (result == EAGAIN);
 
-    if (result == NO_ERROR) {
-        sync_wait(syncFd, -1);
-        close(syncFd);
-    }
-
+    // Only the CPU side of the render happens under mStateLock; the GPU work is waited on by
+    // whoever holds the fence.
+    outFence->reset(syncFd);
     return result;
 }
 
@@ -5949,8 +6578,8 @@ void SurfaceFlinger::renderScreenImplLocked(const RenderArea& renderArea,
                    std::pointer_traits<renderengine::LayerSettings*>::pointer_to);
 
     clientCompositionDisplay.clearRegion = clearRegion;
-    // Use an empty fence for the buffer fence, since we just created the buffer so
-    // there is no need for synchronization with the GPU.
+    // Use an empty fence for the buffer fence, since the buffer was either just created or
+    // handed to us idle by the caller, so there is no need for synchronization with the GPU.
     base::unique_fd bufferFence;
     base::unique_fd drawFence;
     getRenderEngine().useProtectedContext(false);
@@ -6007,32 +6636,55 @@ void SurfaceFlinger::State::traverse(const LayerVector::Visitor& visitor) const
 }
 
 void SurfaceFlinger::State::traverseInZOrder(const LayerVector::Visitor& visitor) const {
-    layersSortedByZ.traverseInZOrder(stateSet, visitor);
+    if (stateSet != LayerVector::StateSet::Drawing) {
+        layersSortedByZ.traverseInZOrder(stateSet, visitor);
+        return;
+    }
+    for (const auto& layer : getLayersInZOrder()) {
+        visitor(layer.get());
+    }
 }
 
 void SurfaceFlinger::State::traverseInReverseZOrder(const LayerVector::Visitor& visitor) const {
-    layersSortedByZ.traverseInReverseZOrder(stateSet, visitor);
+    if (stateSet != LayerVector::StateSet::Drawing) {
+        layersSortedByZ.traverseInReverseZOrder(stateSet, visitor);
+        return;
+    }
+    const auto& layers = getLayersInZOrder();
+    for (auto it = layers.rbegin(); it != layers.rend(); ++it) {
+        visitor(it->get());
+    }
+}
+
+void SurfaceFlinger::State::invalidateZOrder() const {
+    mLayersInZOrderValid = false;
+    mLayersInZOrder.clear();
+}
+
+const std::vector<sp<Layer>>& SurfaceFlinger::State::getLayersInZOrder() const {
+    if (!mLayersInZOrderValid) {
+        ATRACE_NAME("rebuildLayersInZOrder");
+        mLayersInZOrder.clear();
+        layersSortedByZ.traverseInZOrder(stateSet,
+                                         [&](Layer* layer) { mLayersInZOrder.emplace_back(layer); });
+        mLayersInZOrderValid = true;
+    }
+    return mLayersInZOrder;
 }
 
 void SurfaceFlinger::traverseLayersInDisplay(const sp<const DisplayDevice>& display,
                                              const LayerVector::Visitor& visitor) {
-    // We loop through the first level of layers without traversing,
-    // as we need to determine which layers belong to the requested display.
-    for (const auto& layer : mDrawingState.layersSortedByZ) {
+    // Relative layers may sit under a root on a different layer stack, so the stack is checked
+    // for every layer rather than once per root.
+    mDrawingState.traverseInZOrder([&](Layer* layer) {
         if (!layer->belongsToDisplay(display->getLayerStack(), false)) {
-            continue;
+            return;
         }
-        // relative layers are traversed in Layer::traverseInZOrder
-        layer->traverseInZOrder(LayerVector::StateSet::Drawing, [&](Layer* layer) {
-            if (!layer->belongsToDisplay(display->getLayerStack(), false)) {
-                return;
-            }
-            if (!layer->isVisible()) {
-                return;
-            }
-            visitor(layer);
-        });
-    }
+        if (!layer->isVisible()) {
+            return;
+        }
+        visitor(layer);
+    });
 }
 
 status_t SurfaceFlinger::setDesiredDisplayConfigSpecsInternal(
@@ -6269,7 +6921,7 @@ void SurfaceFlinger::onLayerDestroyed(Layer* layer) {
 // See b/141111965
 void SurfaceFlinger::removeFromOffscreenLayers(Layer* layer) {
     for (auto& child : layer->getCurrentChildren()) {
-        mOffscreenLayers.emplace(child.get());
+        mOffscreenLayers.emplace(child.get(), systemTime());
     }
     mOffscreenLayers.erase(layer);
 }
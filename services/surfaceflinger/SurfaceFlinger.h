@@ -24,6 +24,7 @@
 
 #include <android-base/thread_annotations.h>
 #include <compositionengine/OutputColorSetting.h>
+#include <compositionengine/impl/OutputWorkerPool.h>
 #include <cutils/atomic.h>
 #include <cutils/compiler.h>
 #include <gui/BufferQueue.h>
@@ -40,6 +41,7 @@
 #include <serviceutils/PriorityDumper.h>
 #include <system/graphics.h>
 #include <ui/FenceTime.h>
+#include <ui/FenceWatcher.h>
 #include <ui/PixelFormat.h>
 #include <ui/Size.h>
 #include <utils/Errors.h>
@@ -52,10 +54,12 @@
 #include "ClientCache.h"
 #include "DisplayDevice.h"
 #include "DisplayHardware/HWC2.h"
+#include "DisplayHardware/HwcControlThread.h"
 #include "DisplayHardware/PowerAdvisor.h"
 #include "Effects/Daltonizer.h"
 #include "FrameTracker.h"
 #include "LayerVector.h"
+#include "LockFreeInbox.h"
 #include "Scheduler/RefreshRateConfigs.h"
 #include "Scheduler/RefreshRateStats.h"
 #include "Scheduler/Scheduler.h"
@@ -113,6 +117,10 @@ namespace dvr {
 class VrFlinger;
 } // namespace dvr
 
+namespace frametimeline {
+class FrameTimeline;
+} // namespace frametimeline
+
 enum {
     eTransactionNeeded = 0x01,
     eTraversalNeeded = 0x02,
@@ -336,6 +344,48 @@ public:
     // debug.sf.disable_client_composition_cache
     bool mDisableClientCompositionCache = false;
 
+    // If set, the visibility of each display is computed concurrently. This can
+    // be set by debug.sf.parallel_output_prepare
+    bool mParallelOutputPrepare = false;
+
+    // If set, the displays are presented with a single HWC command batch once
+    // all of them are composed. This can be set by debug.sf.batch_output_presents
+    bool mBatchOutputPresents = false;
+
+    // If set, the visibility of layers is reused across frames when its inputs
+    // have not changed. This can be set by debug.sf.incremental_visible_regions
+    bool mIncrementalVisibleRegions = false;
+
+    // If set, consecutive ready transactions from the same apply token are merged
+    // into one before being applied. This can be set by debug.sf.coalesce_transactions
+    bool mCoalesceTransactions = false;
+
+    // If set, only the input windows which changed are sent to InputFlinger. This can be
+    // set by debug.sf.incremental_input_windows
+    bool mIncrementalInputWindows = false;
+
+    // If set, client composition only redraws the damaged part of the output
+    // buffer. This can be set by debug.sf.partial_client_composition
+    bool mPartialClientComposition = false;
+
+    // If set, the static bottom layers of client composition are drawn once and
+    // reused across frames. This can be set by debug.sf.cache_client_composition_results
+    bool mCacheClientCompositionResults = false;
+
+    // If non-zero, the number of frames layers must be presented unchanged before
+    // being flattened into a single HWC layer. This can be set by
+    // debug.sf.layer_flattening_threshold
+    uint32_t mLayerFlatteningThreshold = 0;
+
+    // If set, the state deciding which layers can be on each output is snapshotted
+    // once per frame so that outputs skip other layers cheaply. This can be set by
+    // debug.sf.snapshot_layer_fe_state
+    bool mSnapshotLayerFEState = false;
+
+    // If set, displays other than the default display are not composed on refreshes where
+    // nothing they show changed. This can be set by debug.sf.skip_idle_outputs
+    bool mSkipIdleOutputs = false;
+
 private:
     friend class BufferLayer;
     friend class BufferQueueLayer;
@@ -379,6 +429,7 @@ private:
                 colorMatrix = other.colorMatrix;
             }
             globalShadowSettings = other.globalShadowSettings;
+            invalidateZOrder();
 
             return *this;
         }
@@ -393,8 +444,22 @@ private:
         renderengine::ShadowSettings globalShadowSettings;
 
         void traverse(const LayerVector::Visitor& visitor) const;
+        // For the Drawing state set these walk a flattened z-ordered copy of the layer tree,
+        // which is rebuilt on first use after invalidateZOrder(). The Drawing state must only be
+        // traversed this way from the main thread, and visitors must not change the hierarchy.
         void traverseInZOrder(const LayerVector::Visitor& visitor) const;
         void traverseInReverseZOrder(const LayerVector::Visitor& visitor) const;
+        // Must be called whenever the hierarchy or z order of the Drawing state changes outside
+        // of assignment from the Current state.
+        void invalidateZOrder() const;
+
+    private:
+        const std::vector<sp<Layer>>& getLayersInZOrder() const;
+
+        // Strong references, since layers reached through a relative-z parent are otherwise
+        // only weakly held by the tree.
+        mutable std::vector<sp<Layer>> mLayersInZOrder;
+        mutable bool mLayersInZOrderValid = false;
     };
 
     /* ------------------------------------------------------------------------
@@ -435,6 +500,11 @@ private:
                            ui::Rotation rotation, bool captureSecureLayers) override;
     status_t captureScreen(uint64_t displayOrLayerStack, ui::Dataspace* outDataspace,
                            sp<GraphicBuffer>* outBuffer) override;
+    status_t captureScreenIntoBuffer(const sp<IBinder>& displayToken,
+                                     const sp<GraphicBuffer>& buffer, ui::Dataspace reqDataspace,
+                                     const Rect& sourceCrop, bool useIdentityTransform,
+                                     ui::Rotation rotation, bool captureSecureLayers,
+                                     bool& outCapturedSecureLayers, sp<Fence>* outFence) override;
     status_t captureLayers(
             const sp<IBinder>& parentHandle, sp<GraphicBuffer>* outBuffer,
             const ui::Dataspace reqDataspace, const ui::PixelFormat reqPixelFormat,
@@ -535,6 +605,8 @@ private:
     void repaintEverythingForHWC() override;
     // Called when kernel idle timer has expired. Used to update the refresh rate overlay.
     void kernelTimerChanged(bool expired) override;
+    // Forwards vsync model prediction errors to TimeStats.
+    void onVsyncPredictionError(nsecs_t idealPeriod, nsecs_t error) override;
     // Toggles the kernel idle timer on or off depending the policy decisions around refresh rates.
     void toggleKernelIdleTimer();
     // Keeps track of whether the kernel idle timer is currently enabled, so we don't have to
@@ -575,9 +647,15 @@ private:
     void performSetActiveConfig() REQUIRES(mStateLock);
     // Called when active config is no longer is progress
     void desiredActiveConfigChangeDone() REQUIRES(mStateLock);
+    // Throttles the app VSYNC of uids whose visible layers all vote for a divisor of the current
+    // refresh rate.
+    void updateFrameRateDivisors() REQUIRES(mStateLock);
     // called on the main thread in response to setPowerMode()
     void setPowerModeInternal(const sp<DisplayDevice>& display, hal::PowerMode mode)
             REQUIRES(mStateLock);
+    // Called on the main thread once the HWC has switched the display from previousMode to mode.
+    void onPowerModeTransitionDone(const sp<DisplayDevice>& display, hal::PowerMode previousMode,
+                                   hal::PowerMode mode) REQUIRES(mStateLock);
 
     // Sets the desired display configs.
     status_t setDesiredDisplayConfigSpecsInternal(
@@ -604,6 +682,9 @@ private:
 
     void updateInputFlinger();
     void updateInputWindowInfo();
+    // Sends only the windows which changed since the last call, along with the window order.
+    void updateInputWindowsIncrementally(std::vector<InputWindowInfo>&& inputInfos,
+                                         const sp<ISetInputWindowsListener>& listener);
     void commitInputWindowCommands() REQUIRES(mStateLock);
     void setInputWindowsFinished();
     void updateCursorAsync();
@@ -615,6 +696,10 @@ private:
      */
     bool handlePageFlip();
 
+    // Calls Layer::prepareLatch for the layers with queued frames, on worker threads when there
+    // are enough of them.
+    void prepareLatches();
+
     /* ------------------------------------------------------------------------
      * Transactions
      */
@@ -643,8 +728,13 @@ private:
     uint32_t setTransactionFlags(uint32_t flags, Scheduler::TransactionStart transactionStart);
     void commitTransaction() REQUIRES(mStateLock);
     void commitOffscreenLayers();
+    // Releases the buffers of layer trees that have been offscreen for longer than
+    // mOffscreenBufferTimeout.
+    void releaseStaleOffscreenBuffers(nsecs_t now);
     bool transactionIsReadyToBeApplied(int64_t desiredPresentTime,
                                        const Vector<ComposerState>& states);
+    // Moves the transactions posted to mTransactionInbox to their mTransactionQueues.
+    void drainTransactionInboxLocked() REQUIRES(mStateLock);
     uint32_t setDisplayStateLocked(const DisplayState& s) REQUIRES(mStateLock);
     uint32_t addInputWindowCommands(const InputWindowCommands& inputWindowCommands)
             REQUIRES(mStateLock);
@@ -728,6 +818,17 @@ private:
     status_t captureScreenCommon(RenderArea& renderArea, TraverseLayersFunction traverseLayers,
                                  const sp<GraphicBuffer>& buffer, bool useIdentityTransform,
                                  bool regionSampling, bool& outCapturedSecureLayers);
+    // Renders into buffer without waiting for the GPU. outFence signals when the render is done.
+    status_t captureScreenCommonAsync(RenderArea& renderArea, TraverseLayersFunction traverseLayers,
+                                      const sp<GraphicBuffer>& buffer, bool useIdentityTransform,
+                                      bool regionSampling, bool& outCapturedSecureLayers,
+                                      base::unique_fd* outFence);
+    // Resolves the display and render area rotation for a capture, defaulting reqWidth and
+    // reqHeight to the display viewport if either is zero.
+    status_t getDisplayForCapture(const sp<IBinder>& displayToken, ui::Rotation rotation,
+                                  uint32_t* reqWidth, uint32_t* reqHeight,
+                                  sp<DisplayDevice>* outDisplay,
+                                  ui::Transform::RotationFlags* outRotation) EXCLUDES(mStateLock);
     sp<DisplayDevice> getDisplayByIdOrLayerStack(uint64_t displayOrLayerStack) REQUIRES(mStateLock);
     sp<DisplayDevice> getDisplayByLayerStack(uint64_t layerStack) REQUIRES(mStateLock);
     status_t captureScreenImplLocked(const RenderArea& renderArea,
@@ -943,6 +1044,20 @@ private:
     }
 
     void dumpAllLocked(const DumpArgs& args, std::string& result) const REQUIRES(mStateLock);
+    // The parts of the full dump which don't need mStateLock, before and after dumpAllLocked.
+    void dumpBuildConfiguration(const DumpArgs& args, std::string& result) const;
+    void dumpAllocatorAndTimeStats(std::string& result) const;
+
+    // Counters which can be read without mStateLock, for monitoring tools which poll them.
+    std::vector<std::pair<const char*, int64_t>> getCounters() const;
+    // Dumps the counters as "name=value" lines.
+    void dumpCounters(std::string& result) const;
+    // Dumps the counters as kCountersMagic, kCountersVersion and the uint32_t number of
+    // counters, followed by the uint16_t length of the name, the name and the int64_t value
+    // of each counter, in host byte order.
+    void dumpCountersBinary(std::string& result) const;
+    static constexpr uint32_t kCountersMagic = 0x53464354; // "SFCT"
+    static constexpr uint32_t kCountersVersion = 1;
 
     void appendSfConfigString(std::string& result) const;
     void listLayersLocked(std::string& result) const;
@@ -970,6 +1085,8 @@ private:
     LayersProto dumpProtoFromMainThread(uint32_t traceFlags = SurfaceTracing::TRACE_ALL)
             EXCLUDES(mStateLock);
     void dumpOffscreenLayers(std::string& result) EXCLUDES(mStateLock);
+    // Dumps the buffer memory held by offscreen layers, per client.
+    void dumpOffscreenLayerMemory(std::string& result) EXCLUDES(mStateLock);
 
     bool isLayerTripleBufferingDisabled() const {
         return this->mLayerTripleBufferingDisabled;
@@ -1042,6 +1159,10 @@ private:
     bool mGeometryInvalid = false;
     bool mAnimCompositionPending = false;
     std::vector<sp<Layer>> mLayersWithQueuedFrames;
+    // Runs Layer::prepareLatch for the layers with queued frames in parallel.
+    static constexpr size_t kMaxLatchWorkerThreads = 3;
+    static constexpr size_t kMinLayersForParallelLatch = 4;
+    compositionengine::impl::OutputWorkerPool mLatchWorkerPool{kMaxLatchWorkerThreads};
     // Tracks layers that need to update a display's dirty region.
     std::vector<sp<Layer>> mLayersPendingRefresh;
     std::array<sp<Fence>, 2> mPreviousPresentFences = {Fence::NO_FENCE, Fence::NO_FENCE};
@@ -1094,6 +1215,10 @@ private:
 
     const std::shared_ptr<TimeStats> mTimeStats;
     const std::unique_ptr<FrameTracer> mFrameTracer;
+    const std::unique_ptr<frametimeline::FrameTimeline> mFrameTimeline;
+    // Publishes present and client composition fence signal times off the main thread, so the
+    // per-layer consumers of those FenceTimes stop polling them. Null if disabled.
+    std::unique_ptr<FenceWatcher> mFenceWatcher;
     bool mUseHwcVirtualDisplays = false;
     // If blurs should be enabled on this device.
     bool mSupportsBlur = false;
@@ -1145,6 +1270,12 @@ private:
                 hasListenerCallbacks(hasListenerCallbacks),
                 listenerCallbacks(listenerCallbacks) {}
 
+        // Returns whether other can be folded into this transaction, i.e. whether
+        // applying the merged state is indistinguishable from applying both in order.
+        bool canCoalesceWith(const TransactionState& other) const;
+        // Folds the layer states of a later transaction into this one.
+        void coalesce(const TransactionState& other);
+
         Vector<ComposerState> states;
         Vector<DisplayState> displays;
         uint32_t flags;
@@ -1156,6 +1287,10 @@ private:
         std::vector<ListenerCallbacks> listenerCallbacks;
     };
     std::unordered_map<sp<IBinder>, std::queue<TransactionState>, IListenerHash> mTransactionQueues;
+    // Transactions which were not ready to be applied when they arrived. Binder threads post them
+    // here without taking mStateLock; they are moved to mTransactionQueues, in arrival order, by
+    // whoever takes mStateLock next to look at the queues.
+    LockFreeInbox<std::pair<sp<IBinder>, TransactionState>> mTransactionInbox;
 
     /* ------------------------------------------------------------------------
      * Feature prototyping
@@ -1249,6 +1384,10 @@ private:
 
     bool mLumaSampling = true;
     bool mForceLightBrightness = false;
+
+    // Last per-uid VSYNC divisors sent to the app EventThread. Only accessed by the main thread.
+    bool mFrameRateDivisorsEnabled = true;
+    FrameRateDivisors mFrameRateDivisors;
     sp<RegionSamplingThread> mRegionSamplingThread;
     ui::DisplayPrimaries mInternalDisplayPrimaries;
 
@@ -1259,6 +1398,11 @@ private:
     InputWindowCommands mPendingInputWindowCommands GUARDED_BY(mStateLock);
     // Should only be accessed by the main thread.
     InputWindowCommands mInputWindowCommands;
+    // The windows last sent to mInputFlinger, and the index of each in it by window id. Only
+    // maintained when mIncrementalInputWindows is set, and only accessed on the main thread.
+    std::vector<InputWindowInfo> mLastInputWindowInfos;
+    std::unordered_map<int32_t, size_t> mLastInputWindowIndices;
+    bool mHasSentInputWindows = false;
 
     struct SetInputWindowsListener : BnSetInputWindowsListener {
         explicit SetInputWindowsListener(sp<SurfaceFlinger> flinger)
@@ -1274,6 +1418,9 @@ private:
     bool mPendingSyncInputWindows GUARDED_BY(mStateLock) = false;
     Hwc2::impl::PowerAdvisor mPowerAdvisor;
 
+    // Applies display power mode changes, once started by init().
+    HwcControlThread mHwcControlThread;
+
     // This should only be accessed on the main thread.
     nsecs_t mFrameStartTime = 0;
 
@@ -1283,11 +1430,16 @@ private:
     // Flag used to set override allowed display configs from backdoor
     bool mDebugDisplayConfigSetByBackdoor = false;
 
-    // A set of layers that have no parent so they are not drawn on screen.
+    // A set of layers that have no parent so they are not drawn on screen, mapped to the time
+    // they went offscreen.
     // Should only be accessed by the main thread.
     // The Layer pointer is removed from the set when the destructor is called so there shouldn't
     // be any issues with a raw pointer referencing an invalid object.
-    std::unordered_set<Layer*> mOffscreenLayers;
+    std::unordered_map<Layer*, nsecs_t> mOffscreenLayers;
+
+    // How long a layer may stay offscreen before its buffers are released, or 0 to keep them
+    // until the client drops the layer. Set from debug.sf.offscreen_buffer_timeout_ms.
+    nsecs_t mOffscreenBufferTimeout = 0;
 
     // Fields tracking the current jank event: when it started and how many
     // janky frames there are.
@@ -25,9 +25,15 @@
 #include "SurfaceFlinger.h"
 #include "SurfaceInterceptor.h"
 
+#include <fcntl.h>
+#include <pthread.h>
+#include <zlib.h>
+
+#include <chrono>
 #include <fstream>
 
 #include <android-base/file.h>
+#include <android-base/unique_fd.h>
 #include <log/log.h>
 #include <utils/Trace.h>
 
@@ -40,11 +46,46 @@ SurfaceInterceptor::~SurfaceInterceptor() = default;
 
 namespace impl {
 
+namespace {
+
+// How often the deferred capture thread drains the intercepted state. Producers never wake the
+// thread, so this bounds how much state is held in memory between writes.
+constexpr std::chrono::milliseconds kDeferredDrainInterval{50};
+
+// Tag of Trace.increment (field 1, length-delimited). Increments written one after another with
+// this framing parse as a single Trace, so the deferred capture can stream them to disk.
+constexpr uint8_t kTraceIncrementTag = (1 << 3) | 2;
+
+void appendVarint(std::string* output, uint64_t value) {
+    while (value >= 0x80) {
+        output->push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    output->push_back(static_cast<char>(value));
+}
+
+} // namespace
+
 SurfaceInterceptor::SurfaceInterceptor(SurfaceFlinger* flinger)
     :   mFlinger(flinger)
 {
 }
 
+SurfaceInterceptor::~SurfaceInterceptor() {
+    if (mWorker.joinable()) {
+        stopDeferredCapture();
+    }
+}
+
+void SurfaceInterceptor::setDeferredCapture(bool deferred, bool compressed) {
+    std::lock_guard<std::mutex> protoGuard(mTraceMutex);
+    if (mEnabled) {
+        return;
+    }
+    mDeferred = deferred;
+    mCompressed = compressed;
+}
+
 void SurfaceInterceptor::enable(const SortedVector<sp<Layer>>& layers,
         const DefaultKeyedVector< wp<IBinder>, DisplayDeviceState>& displays)
 {
@@ -56,6 +97,11 @@ void SurfaceInterceptor::enable(const SortedVector<sp<Layer>>& layers,
     std::lock_guard<std::mutex> protoGuard(mTraceMutex);
     saveExistingDisplaysLocked(displays);
     saveExistingSurfacesLocked(layers);
+    if (mDeferred) {
+        status_t err(startDeferredCaptureLocked());
+        ALOGE_IF(err != NO_ERROR, "Could not open %s for deferred capture (%s)",
+                 mOutputFileName.c_str(), strerror(-err));
+    }
 }
 
 void SurfaceInterceptor::disable() {
@@ -63,6 +109,10 @@ void SurfaceInterceptor::disable() {
         return;
     }
     ATRACE_CALL();
+    if (mDeferred) {
+        stopDeferredCapture();
+        return;
+    }
     std::lock_guard<std::mutex> protoGuard(mTraceMutex);
     mEnabled = false;
     status_t err(writeProtoFileLocked());
@@ -163,6 +213,114 @@ status_t SurfaceInterceptor::writeProtoFileLocked() {
     return NO_ERROR;
 }
 
+void SurfaceInterceptor::postDeferredIncrement(DeferredFill&& fill) {
+    mDeferredIncrements.post(DeferredIncrement{elapsedRealtimeNano(), std::move(fill)});
+}
+
+status_t SurfaceInterceptor::startDeferredCaptureLocked() {
+    // The thread is started even if the file cannot be opened, so that the intercepted state
+    // keeps being drained and discarded rather than piling up until the capture is disabled.
+    {
+        std::lock_guard<std::mutex> lock(mWorkerMutex);
+        mWorkerRunning = true;
+    }
+    mDroppedIncrements = 0;
+    mWorker = std::thread(&SurfaceInterceptor::deferredCaptureMain, this);
+    pthread_setname_np(mWorker.native_handle(), "SurfaceIntercept");
+
+    android::base::unique_fd fd(
+            open(mOutputFileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666));
+    if (fd < 0) {
+        return -errno;
+    }
+    // "T" writes the file uncompressed; zlib reads both forms back transparently.
+    mCaptureFile = gzdopen(fd.get(), mCompressed ? "wb" : "wbT");
+    if (mCaptureFile == nullptr) {
+        return NO_MEMORY;
+    }
+    fd.release();
+    gzbuffer(mCaptureFile, 128 * 1024);
+    return NO_ERROR;
+}
+
+void SurfaceInterceptor::stopDeferredCapture() {
+    mEnabled = false;
+    {
+        std::lock_guard<std::mutex> lock(mWorkerMutex);
+        mWorkerRunning = false;
+    }
+    mWorkerCondition.notify_one();
+    if (mWorker.joinable()) {
+        mWorker.join();
+    }
+
+    std::lock_guard<std::mutex> protoGuard(mTraceMutex);
+    // Pick up anything posted by callers that raced with disabling.
+    drainDeferredIncrementsLocked();
+    if (mCaptureFile != nullptr) {
+        ALOGE_IF(gzclose(mCaptureFile) != Z_OK, "Could not finish writing %s",
+                 mOutputFileName.c_str());
+        mCaptureFile = nullptr;
+    }
+    ALOGE_IF(mDroppedIncrements > 0, "Dropped %zu increments with missing fields",
+             mDroppedIncrements);
+}
+
+void SurfaceInterceptor::deferredCaptureMain() {
+    std::unique_lock<std::mutex> lock(mWorkerMutex);
+    bool running = true;
+    while (running) {
+        mWorkerCondition.wait_for(lock, kDeferredDrainInterval, [this] { return !mWorkerRunning; });
+        running = mWorkerRunning;
+        lock.unlock();
+        {
+            std::lock_guard<std::mutex> protoGuard(mTraceMutex);
+            drainDeferredIncrementsLocked();
+        }
+        lock.lock();
+    }
+}
+
+void SurfaceInterceptor::drainDeferredIncrementsLocked() {
+    ATRACE_CALL();
+    // The initial snapshot is built synchronously by enable().
+    for (const auto& increment : mTrace.increment()) {
+        writeIncrementLocked(increment);
+    }
+    mTrace.Clear();
+
+    mDeferredIncrements.drain([this](DeferredIncrement&& deferred) {
+        mScratchIncrement.Clear();
+        mScratchIncrement.set_time_stamp(deferred.timestamp);
+        deferred.fill(&mScratchIncrement);
+        writeIncrementLocked(mScratchIncrement);
+    });
+}
+
+void SurfaceInterceptor::writeIncrementLocked(const Increment& increment) {
+    if (mCaptureFile == nullptr) {
+        return;
+    }
+    if (!increment.IsInitialized()) {
+        mDroppedIncrements++;
+        return;
+    }
+
+    mSerializedIncrement.clear();
+    mSerializedIncrement.push_back(static_cast<char>(kTraceIncrementTag));
+    appendVarint(&mSerializedIncrement, increment.ByteSizeLong());
+    increment.AppendToString(&mSerializedIncrement);
+
+    const int size = static_cast<int>(mSerializedIncrement.size());
+    if (gzwrite(mCaptureFile, mSerializedIncrement.data(), size) != size) {
+        int err = Z_OK;
+        ALOGE("Could not write to %s (%s), stopping deferred capture", mOutputFileName.c_str(),
+              gzerror(mCaptureFile, &err));
+        gzclose(mCaptureFile);
+        mCaptureFile = nullptr;
+    }
+}
+
 const sp<const Layer> SurfaceInterceptor::getLayer(const wp<const IBinder>& weakHandle) const {
     const sp<const IBinder>& handle(weakHandle.promote());
     const auto layerHandle(static_cast<const Layer::Handle*>(handle.get()));
@@ -489,8 +647,8 @@ void SurfaceInterceptor::addDisplayChangesLocked(Transaction* transaction,
 
 void SurfaceInterceptor::addTransactionLocked(Increment* increment,
         const Vector<ComposerState>& stateUpdates,
-        const DefaultKeyedVector< wp<IBinder>, DisplayDeviceState>& displays,
-        const Vector<DisplayState>& changedDisplays, uint32_t transactionFlags)
+        const Vector<DisplayState>& changedDisplays,
+        const std::vector<int32_t>& displaySequenceIds, uint32_t transactionFlags)
 {
     Transaction* transaction(increment->mutable_transaction());
     transaction->set_synchronous(transactionFlags & BnSurfaceComposer::eSynchronous);
@@ -498,39 +656,57 @@ void SurfaceInterceptor::addTransactionLocked(Increment* increment,
     for (const auto& compState: stateUpdates) {
         addSurfaceChangesLocked(transaction, compState.state);
     }
+    for (size_t i = 0; i < changedDisplays.size(); i++) {
+        if (displaySequenceIds[i] >= 0) {
+            addDisplayChangesLocked(transaction, changedDisplays[i], displaySequenceIds[i]);
+        }
+    }
+}
+
+std::vector<int32_t> SurfaceInterceptor::getDisplaySequenceIds(
+        const DefaultKeyedVector< wp<IBinder>, DisplayDeviceState>& displays,
+        const Vector<DisplayState>& changedDisplays) const
+{
+    std::vector<int32_t> sequenceIds;
+    sequenceIds.reserve(changedDisplays.size());
     for (const auto& disp: changedDisplays) {
         ssize_t dpyIdx = displays.indexOfKey(disp.token);
-        if (dpyIdx >= 0) {
-            const DisplayDeviceState& dispState(displays.valueAt(dpyIdx));
-            addDisplayChangesLocked(transaction, disp, dispState.sequenceId);
-        }
+        sequenceIds.push_back(dpyIdx >= 0 ? displays.valueAt(dpyIdx).sequenceId : -1);
     }
+    return sequenceIds;
 }
 
 void SurfaceInterceptor::addSurfaceCreationLocked(Increment* increment,
         const sp<const Layer>& layer)
 {
-    SurfaceCreation* creation(increment->mutable_surface_creation());
-    creation->set_id(getLayerId(layer));
-    creation->set_name(layer->getName());
-    creation->set_w(layer->mCurrentState.active_legacy.w);
-    creation->set_h(layer->mCurrentState.active_legacy.h);
+    addSurfaceCreationLocked(increment, getLayerId(layer), layer->getName(),
+                             layer->mCurrentState.active_legacy.w,
+                             layer->mCurrentState.active_legacy.h);
 }
 
-void SurfaceInterceptor::addSurfaceDeletionLocked(Increment* increment,
-        const sp<const Layer>& layer)
+void SurfaceInterceptor::addSurfaceCreationLocked(Increment* increment, int32_t layerId,
+        const std::string& name, uint32_t w, uint32_t h)
 {
+    SurfaceCreation* creation(increment->mutable_surface_creation());
+    creation->set_id(layerId);
+    creation->set_name(name);
+    creation->set_w(w);
+    creation->set_h(h);
+}
+
+void SurfaceInterceptor::addSurfaceDeletionLocked(Increment* increment, int32_t layerId) {
     SurfaceDeletion* deletion(increment->mutable_surface_deletion());
-    deletion->set_id(getLayerId(layer));
+    deletion->set_id(layerId);
 }
 
 void SurfaceInterceptor::addBufferUpdateLocked(Increment* increment, int32_t layerId,
-        uint32_t width, uint32_t height, uint64_t frameNumber)
+        uint32_t width, uint32_t height, int32_t format, uint64_t frameNumber)
 {
     BufferUpdate* update(increment->mutable_buffer_update());
     update->set_id(layerId);
     update->set_w(width);
     update->set_h(height);
+    update->set_format(format);
     update->set_frame_number(frameNumber);
 }
 
@@ -621,9 +797,18 @@ void SurfaceInterceptor::saveTransaction(const Vector<ComposerState>& stateUpdat
         return;
     }
     ATRACE_CALL();
+    if (mDeferred) {
+        // Vector copies share their storage until written to, so this does not copy the states.
+        postDeferredIncrement([this, stateUpdates, changedDisplays, flags,
+                               sequenceIds = getDisplaySequenceIds(displays, changedDisplays)](
+                                      Increment* increment) {
+            addTransactionLocked(increment, stateUpdates, changedDisplays, sequenceIds, flags);
+        });
+        return;
+    }
     std::lock_guard<std::mutex> protoGuard(mTraceMutex);
-    addTransactionLocked(createTraceIncrementLocked(), stateUpdates, displays, changedDisplays,
-            flags);
+    addTransactionLocked(createTraceIncrementLocked(), stateUpdates, changedDisplays,
+            getDisplaySequenceIds(displays, changedDisplays), flags);
 }
 
 void SurfaceInterceptor::saveSurfaceCreation(const sp<const Layer>& layer) {
@@ -631,6 +816,14 @@ void SurfaceInterceptor::saveSurfaceCreation(const sp<const Layer>& layer) {
         return;
     }
     ATRACE_CALL();
+    if (mDeferred) {
+        postDeferredIncrement([this, layerId = getLayerId(layer), name = layer->getName(),
+                               w = layer->mCurrentState.active_legacy.w,
+                               h = layer->mCurrentState.active_legacy.h](Increment* increment) {
+            addSurfaceCreationLocked(increment, layerId, name, w, h);
+        });
+        return;
+    }
     std::lock_guard<std::mutex> protoGuard(mTraceMutex);
     addSurfaceCreationLocked(createTraceIncrementLocked(), layer);
 }
@@ -640,8 +833,14 @@ void SurfaceInterceptor::saveSurfaceDeletion(const sp<const Layer>& layer) {
         return;
     }
     ATRACE_CALL();
+    if (mDeferred) {
+        postDeferredIncrement([this, layerId = getLayerId(layer)](Increment* increment) {
+            addSurfaceDeletionLocked(increment, layerId);
+        });
+        return;
+    }
     std::lock_guard<std::mutex> protoGuard(mTraceMutex);
-    addSurfaceDeletionLocked(createTraceIncrementLocked(), layer);
+    addSurfaceDeletionLocked(createTraceIncrementLocked(), getLayerId(layer));
 }
 
 /**
@@ -652,20 +851,34 @@ void SurfaceInterceptor::saveSurfaceDeletion(const sp<const Layer>& layer) {
  * from this binder thread.
  */
 void SurfaceInterceptor::saveBufferUpdate(int32_t layerId, uint32_t width,
-        uint32_t height, uint64_t frameNumber)
+        uint32_t height, int32_t format, uint64_t frameNumber)
 {
     if (!mEnabled) {
         return;
     }
     ATRACE_CALL();
+    if (mDeferred) {
+        postDeferredIncrement([this, layerId, width, height, format,
+                               frameNumber](Increment* increment) {
+            addBufferUpdateLocked(increment, layerId, width, height, format, frameNumber);
+        });
+        return;
+    }
     std::lock_guard<std::mutex> protoGuard(mTraceMutex);
-    addBufferUpdateLocked(createTraceIncrementLocked(), layerId, width, height, frameNumber);
+    addBufferUpdateLocked(createTraceIncrementLocked(), layerId, width, height, format,
+                          frameNumber);
 }
 
 void SurfaceInterceptor::saveVSyncEvent(nsecs_t timestamp) {
     if (!mEnabled) {
         return;
     }
+    if (mDeferred) {
+        postDeferredIncrement([this, timestamp](Increment* increment) {
+            addVSyncUpdateLocked(increment, timestamp);
+        });
+        return;
+    }
     std::lock_guard<std::mutex> protoGuard(mTraceMutex);
     addVSyncUpdateLocked(createTraceIncrementLocked(), timestamp);
 }
@@ -675,6 +888,11 @@ void SurfaceInterceptor::saveDisplayCreation(const DisplayDeviceState& info) {
         return;
     }
     ATRACE_CALL();
+    if (mDeferred) {
+        postDeferredIncrement(
+                [this, info](Increment* increment) { addDisplayCreationLocked(increment, info); });
+        return;
+    }
     std::lock_guard<std::mutex> protoGuard(mTraceMutex);
     addDisplayCreationLocked(createTraceIncrementLocked(), info);
 }
@@ -684,6 +902,12 @@ void SurfaceInterceptor::saveDisplayDeletion(int32_t sequenceId) {
         return;
     }
     ATRACE_CALL();
+    if (mDeferred) {
+        postDeferredIncrement([this, sequenceId](Increment* increment) {
+            addDisplayDeletionLocked(increment, sequenceId);
+        });
+        return;
+    }
     std::lock_guard<std::mutex> protoGuard(mTraceMutex);
     addDisplayDeletionLocked(createTraceIncrementLocked(), sequenceId);
 }
@@ -693,6 +917,12 @@ void SurfaceInterceptor::savePowerModeUpdate(int32_t sequenceId, int32_t mode) {
         return;
     }
     ATRACE_CALL();
+    if (mDeferred) {
+        postDeferredIncrement([this, sequenceId, mode](Increment* increment) {
+            addPowerModeUpdateLocked(increment, sequenceId, mode);
+        });
+        return;
+    }
     std::lock_guard<std::mutex> protoGuard(mTraceMutex);
     addPowerModeUpdateLocked(createTraceIncrementLocked(), sequenceId, mode);
 }
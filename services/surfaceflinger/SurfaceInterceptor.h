@@ -19,7 +19,10 @@
 
 #include <frameworks/native/cmds/surfacereplayer/proto/src/trace.pb.h>
 
+#include <condition_variable>
+#include <functional>
 #include <mutex>
+#include <thread>
 
 #include <gui/LayerState.h>
 
@@ -29,6 +32,9 @@
 #include <utils/Vector.h>
 
 #include "DisplayDevice.h"
+#include "LockFreeInbox.h"
+
+typedef struct gzFile_s* gzFile;
 
 namespace android {
 
@@ -58,6 +64,11 @@ public:
     virtual void disable() = 0;
     virtual bool isEnabled() = 0;
 
+    // In deferred mode the callers only copy the intercepted state, and a background thread
+    // builds and writes the increments as the trace is recorded. If compressed is set the trace
+    // is gzip-compressed on disk. Takes effect the next time the interceptor is enabled.
+    virtual void setDeferredCapture(bool deferred, bool compressed) = 0;
+
     // Intercept display and surface transactions
     virtual void saveTransaction(
             const Vector<ComposerState>& stateUpdates,
@@ -68,7 +79,7 @@ public:
     virtual void saveSurfaceCreation(const sp<const Layer>& layer) = 0;
     virtual void saveSurfaceDeletion(const sp<const Layer>& layer) = 0;
     virtual void saveBufferUpdate(int32_t layerId, uint32_t width, uint32_t height,
-                                  uint64_t frameNumber) = 0;
+                                  int32_t format, uint64_t frameNumber) = 0;
 
     // Intercept display data
     virtual void saveDisplayCreation(const DisplayDeviceState& info) = 0;
@@ -86,7 +97,7 @@ namespace impl {
 class SurfaceInterceptor final : public android::SurfaceInterceptor {
 public:
     explicit SurfaceInterceptor(SurfaceFlinger* const flinger);
-    ~SurfaceInterceptor() override = default;
+    ~SurfaceInterceptor() override;
 
     // Both vectors are used to capture the current state of SF as the initial snapshot in the trace
     void enable(const SortedVector<sp<Layer>>& layers,
@@ -94,6 +105,8 @@ public:
     void disable() override;
     bool isEnabled() override;
 
+    void setDeferredCapture(bool deferred, bool compressed) override;
+
     // Intercept display and surface transactions
     void saveTransaction(const Vector<ComposerState>& stateUpdates,
                          const DefaultKeyedVector<wp<IBinder>, DisplayDeviceState>& displays,
@@ -102,7 +115,7 @@ public:
     // Intercept surface data
     void saveSurfaceCreation(const sp<const Layer>& layer) override;
     void saveSurfaceDeletion(const sp<const Layer>& layer) override;
-    void saveBufferUpdate(int32_t layerId, uint32_t width, uint32_t height,
+    void saveBufferUpdate(int32_t layerId, uint32_t width, uint32_t height, int32_t format,
                           uint64_t frameNumber) override;
 
     // Intercept display data
@@ -122,6 +135,19 @@ private:
     void addInitialDisplayStateLocked(Increment* increment, const DisplayDeviceState& display);
 
     status_t writeProtoFileLocked();
+
+    // Deferred capture
+    using DeferredFill = std::function<void(Increment*)>;
+    struct DeferredIncrement {
+        nsecs_t timestamp;
+        DeferredFill fill;
+    };
+    void postDeferredIncrement(DeferredFill&& fill);
+    status_t startDeferredCaptureLocked();
+    void stopDeferredCapture();
+    void deferredCaptureMain();
+    void drainDeferredIncrementsLocked();
+    void writeIncrementLocked(const Increment& increment);
     const sp<const Layer> getLayer(const wp<const IBinder>& weakHandle) const;
     int32_t getLayerId(const sp<const Layer>& layer) const;
     int32_t getLayerIdFromWeakRef(const wp<const Layer>& layer) const;
@@ -129,9 +155,11 @@ private:
 
     Increment* createTraceIncrementLocked();
     void addSurfaceCreationLocked(Increment* increment, const sp<const Layer>& layer);
-    void addSurfaceDeletionLocked(Increment* increment, const sp<const Layer>& layer);
+    void addSurfaceCreationLocked(Increment* increment, int32_t layerId, const std::string& name,
+                                  uint32_t w, uint32_t h);
+    void addSurfaceDeletionLocked(Increment* increment, int32_t layerId);
     void addBufferUpdateLocked(Increment* increment, int32_t layerId, uint32_t width,
-            uint32_t height, uint64_t frameNumber);
+            uint32_t height, int32_t format, uint64_t frameNumber);
     void addVSyncUpdateLocked(Increment* increment, nsecs_t timestamp);
     void addDisplayCreationLocked(Increment* increment, const DisplayDeviceState& info);
     void addDisplayDeletionLocked(Increment* increment, int32_t sequenceId);
@@ -160,8 +188,12 @@ private:
             int32_t overrideScalingMode);
     void addSurfaceChangesLocked(Transaction* transaction, const layer_state_t& state);
     void addTransactionLocked(Increment* increment, const Vector<ComposerState>& stateUpdates,
+            const Vector<DisplayState>& changedDisplays,
+            const std::vector<int32_t>& displaySequenceIds, uint32_t transactionFlags);
+    // Looks up the sequence id of each changed display, or -1 if it is not in displays
+    std::vector<int32_t> getDisplaySequenceIds(
             const DefaultKeyedVector< wp<IBinder>, DisplayDeviceState>& displays,
-            const Vector<DisplayState>& changedDisplays, uint32_t transactionFlags);
+            const Vector<DisplayState>& changedDisplays) const;
     void addReparentLocked(Transaction* transaction, int32_t layerId, int32_t parentId);
     void addReparentChildrenLocked(Transaction* transaction, int32_t layerId, int32_t parentId);
     void addDetachChildrenLocked(Transaction* transaction, int32_t layerId, bool detached);
@@ -188,6 +220,19 @@ private:
     std::mutex mTraceMutex {};
     Trace mTrace {};
     SurfaceFlinger* const mFlinger;
+
+    bool mDeferred {false};
+    bool mCompressed {false};
+    LockFreeInbox<DeferredIncrement> mDeferredIncrements;
+    gzFile mCaptureFile {nullptr};
+    Increment mScratchIncrement {};
+    std::string mSerializedIncrement;
+    size_t mDroppedIncrements {0};
+
+    std::mutex mWorkerMutex;
+    std::condition_variable mWorkerCondition;
+    bool mWorkerRunning {false};
+    std::thread mWorker;
 };
 
 } // namespace impl
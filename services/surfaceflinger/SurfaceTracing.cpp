@@ -30,12 +30,33 @@
 #include <utils/SystemClock.h>
 #include <utils/Trace.h>
 
+#include <algorithm>
+#include <cstring>
+
 namespace android {
 
+namespace {
+
+// LayersTraceFileProto.entry is field 2, and is length delimited
+constexpr char kEntryFieldTag = (2 << 3) | 2;
+
+void appendVarint(std::string* output, uint64_t value) {
+    while (value >= 0x80) {
+        output->push_back(static_cast<char>(value | 0x80));
+        value >>= 7;
+    }
+    output->push_back(static_cast<char>(value));
+}
+
+} // namespace
+
 SurfaceTracing::SurfaceTracing(SurfaceFlinger& flinger)
       : mFlinger(flinger), mSfLock(flinger.mTracingLock) {}
 
 void SurfaceTracing::mainLoop() {
+    mLastLayers.clear();
+    mEntriesSinceKeyframe = kKeyframeInterval;
+
     bool enabled = addFirstEntry();
     while (enabled) {
         LayersTraceProto entry = traceWhenNotified();
@@ -64,8 +85,28 @@ LayersTraceProto SurfaceTracing::traceWhenNotified() {
 }
 
 bool SurfaceTracing::addTraceToBuffer(LayersTraceProto& entry) {
+    bool deltaEncoding;
+    bool needsKeyframe;
+    {
+        std::scoped_lock lock(mTraceLock);
+        deltaEncoding = mDeltaEncoding;
+        needsKeyframe = !mBuffer.hasKeyframe();
+    }
+
+    // Encode the entry without holding either lock, reusing the serialization buffer.
+    bool keyframe = true;
+    if (deltaEncoding) {
+        keyframe = needsKeyframe || mEntriesSinceKeyframe >= kKeyframeInterval;
+        encodeDelta(entry, keyframe);
+        mEntriesSinceKeyframe = keyframe ? 0 : mEntriesSinceKeyframe + 1;
+    } else {
+        mLastLayers.clear();
+        mEntriesSinceKeyframe = kKeyframeInterval;
+    }
+    entry.SerializeToString(&mSerializedEntry);
+
     std::scoped_lock lock(mTraceLock);
-    mBuffer.emplace(std::move(entry));
+    mBuffer.emplace(mSerializedEntry, keyframe);
     if (mWriteToFile) {
         writeProtoFileLocked();
         mWriteToFile = false;
@@ -93,34 +134,105 @@ void SurfaceTracing::writeToFileAsync() {
     mCanStartTrace.notify_one();
 }
 
+void SurfaceTracing::encodeDelta(LayersTraceProto& entry, bool keyframe) {
+    ATRACE_CALL();
+
+    std::unordered_map<int32_t, std::string> layers;
+    layers.reserve(mLastLayers.size());
+    LayersProto changedLayers;
+
+    for (auto& layer : *entry.mutable_layers()->mutable_layers()) {
+        const int32_t id = layer.id();
+        std::string serialized = layer.SerializeAsString();
+        if (!keyframe) {
+            const auto last = mLastLayers.find(id);
+            if (last == mLastLayers.end() || last->second != serialized) {
+                changedLayers.add_layers()->Swap(&layer);
+            }
+        }
+        layers.insert_or_assign(id, std::move(serialized));
+    }
+
+    if (!keyframe) {
+        entry.set_delta(true);
+        for (const auto& [id, _] : mLastLayers) {
+            if (layers.count(id) == 0) {
+                entry.add_removed_layers(id);
+            }
+        }
+        entry.mutable_layers()->Swap(&changedLayers);
+    }
+    mLastLayers = std::move(layers);
+}
+
 void SurfaceTracing::LayersTraceBuffer::reset(size_t newSize) {
-    // use the swap trick to make sure memory is released
-    std::queue<LayersTraceProto>().swap(mStorage);
     mSizeInBytes = newSize;
+    std::vector<uint8_t>(newSize).swap(mStorage);
+    mEntries.clear();
+    mUsedInBytes = 0U;
+    mKeyframeCount = 0U;
+    mHead = 0U;
+}
+
+void SurfaceTracing::LayersTraceBuffer::release() {
+    // use the swap trick to make sure memory is released
+    std::vector<uint8_t>().swap(mStorage);
+    std::deque<Entry>().swap(mEntries);
     mUsedInBytes = 0U;
+    mKeyframeCount = 0U;
+    mHead = 0U;
+}
+
+void SurfaceTracing::LayersTraceBuffer::popFront() {
+    const Entry& entry = mEntries.front();
+    mUsedInBytes -= entry.size;
+    if (entry.keyframe) {
+        mKeyframeCount--;
+    }
+    mEntries.pop_front();
 }
 
-void SurfaceTracing::LayersTraceBuffer::emplace(LayersTraceProto&& proto) {
-    auto protoSize = proto.ByteSize();
-    while (mUsedInBytes + protoSize > mSizeInBytes) {
-        if (mStorage.empty()) {
-            return;
+bool SurfaceTracing::LayersTraceBuffer::emplace(const std::string& entry, bool keyframe) {
+    const size_t size = entry.size();
+    if (size > mStorage.size()) {
+        return false;
+    }
+
+    if (mHead + size > mStorage.size()) {
+        // The entries between the head and the end of the storage are the oldest, so they
+        // are dropped before wrapping around.
+        while (!mEntries.empty() && mEntries.front().offset >= mHead) {
+            popFront();
         }
-        mUsedInBytes -= mStorage.front().ByteSize();
-        mStorage.pop();
+        mHead = 0U;
     }
-    mUsedInBytes += protoSize;
-    mStorage.emplace();
-    mStorage.back().Swap(&proto);
+
+    // Drop the oldest entries until the new one does not overlap them.
+    while (!mEntries.empty() && mEntries.front().offset < mHead + size &&
+           mEntries.front().offset + mEntries.front().size > mHead) {
+        popFront();
+    }
+
+    memcpy(mStorage.data() + mHead, entry.data(), size);
+    mEntries.push_back({.offset = mHead, .size = size, .keyframe = keyframe});
+    mHead += size;
+    mUsedInBytes += size;
+    if (keyframe) {
+        mKeyframeCount++;
+    }
+    return true;
 }
 
-void SurfaceTracing::LayersTraceBuffer::flush(LayersTraceFileProto* fileProto) {
-    fileProto->mutable_entry()->Reserve(mStorage.size());
+void SurfaceTracing::LayersTraceBuffer::flush(std::string* output) const {
+    // Deltas before the oldest keyframe have nothing to be applied to.
+    auto it = std::find_if(mEntries.begin(), mEntries.end(),
+                           [](const Entry& entry) { return entry.keyframe; });
 
-    while (!mStorage.empty()) {
-        auto entry = fileProto->add_entry();
-        entry->Swap(&mStorage.front());
-        mStorage.pop();
+    output->reserve(output->size() + mUsedInBytes + mEntries.size() * 6);
+    for (; it != mEntries.end(); ++it) {
+        output->push_back(kEntryFieldTag);
+        appendVarint(output, it->size);
+        output->append(reinterpret_cast<const char*>(mStorage.data() + it->offset), it->size);
     }
 }
 
@@ -171,6 +283,11 @@ void SurfaceTracing::setBufferSize(size_t bufferSizeInByte) {
     mBuffer.setSize(bufferSizeInByte);
 }
 
+void SurfaceTracing::setDeltaEncoding(bool enabled) {
+    std::scoped_lock lock(mTraceLock);
+    mDeltaEncoding = enabled;
+}
+
 void SurfaceTracing::setTraceFlags(uint32_t flags) {
     std::scoped_lock lock(mSfLock);
     mTraceFlags = flags;
@@ -208,15 +325,20 @@ void SurfaceTracing::writeProtoFileLocked() {
     LayersTraceFileProto fileProto;
     std::string output;
 
+    // The entries are already serialized, so only the header goes through the proto, and the
+    // entries are appended to it as they are.
     fileProto.set_magic_number(uint64_t(LayersTraceFileProto_MagicNumber_MAGIC_NUMBER_H) << 32 |
                                LayersTraceFileProto_MagicNumber_MAGIC_NUMBER_L);
-    mBuffer.flush(&fileProto);
-    mBuffer.reset(mBufferSize);
-
     if (!fileProto.SerializeToString(&output)) {
         ALOGE("Could not save the proto file! Permission denied");
         mLastErr = PERMISSION_DENIED;
     }
+    mBuffer.flush(&output);
+    if (mEnabled) {
+        mBuffer.reset(mBufferSize);
+    } else {
+        mBuffer.release();
+    }
 
     // -rw-r--r--
     const mode_t mode = S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH;
@@ -231,7 +353,8 @@ void SurfaceTracing::writeProtoFileLocked() {
 
 void SurfaceTracing::dump(std::string& result) const {
     std::scoped_lock lock(mTraceLock);
-    base::StringAppendF(&result, "Tracing state: %s\n", mEnabled ? "enabled" : "disabled");
+    base::StringAppendF(&result, "Tracing state: %s%s\n", mEnabled ? "enabled" : "disabled",
+                        mDeltaEncoding ? " (delta encoded)" : "");
     base::StringAppendF(&result, "  number of entries: %zu (%.2fMB / %.2fMB)\n",
                         mBuffer.frameCount(), float(mBuffer.used()) / float(1_MB),
                         float(mBuffer.size()) / float(1_MB));
@@ -22,10 +22,14 @@
 #include <utils/StrongPointer.h>
 
 #include <condition_variable>
+#include <cstdint>
+#include <deque>
 #include <memory>
 #include <mutex>
-#include <queue>
+#include <string>
 #include <thread>
+#include <unordered_map>
+#include <vector>
 
 using namespace android::surfaceflinger;
 
@@ -50,6 +54,10 @@ public:
     void notifyLocked(const char* where) NO_THREAD_SAFETY_ANALYSIS /* REQUIRES(mSfLock) */;
 
     void setBufferSize(size_t bufferSizeInByte);
+    // If enabled, each entry only holds the layers which changed since the previous one, with a
+    // full entry every kKeyframeInterval entries so that the trace can be decoded after the
+    // oldest entries are dropped from the buffer.
+    void setDeltaEncoding(bool enabled);
     void writeToFileAsync();
     void dump(std::string& result) const;
 
@@ -69,22 +77,43 @@ public:
 private:
     static constexpr auto kDefaultBufferCapInByte = 5_MB;
     static constexpr auto kDefaultFileName = "/data/misc/wmtrace/layers_trace.pb";
+    static constexpr size_t kKeyframeInterval = 64;
 
-    class LayersTraceBuffer { // ring buffer
+    // Ring buffer of serialized entries, stored back to back in storage allocated up front.
+    class LayersTraceBuffer {
     public:
-        size_t size() const { return mSizeInBytes; }
+        size_t size() const { return mStorage.size(); }
         size_t used() const { return mUsedInBytes; }
-        size_t frameCount() const { return mStorage.size(); }
+        size_t frameCount() const { return mEntries.size(); }
+        bool hasKeyframe() const { return mKeyframeCount > 0; }
 
+        // The new size takes effect on the next reset()
         void setSize(size_t newSize) { mSizeInBytes = newSize; }
         void reset(size_t newSize);
-        void emplace(LayersTraceProto&& proto);
-        void flush(LayersTraceFileProto* fileProto);
+        // Frees the storage until the next reset()
+        void release();
+        // Returns false if the entry is larger than the whole buffer
+        bool emplace(const std::string& entry, bool keyframe);
+        // Appends the entries from the oldest keyframe onwards to output, encoded as the entry
+        // field of LayersTraceFileProto
+        void flush(std::string* output) const;
 
     private:
-        size_t mUsedInBytes = 0U;
+        struct Entry {
+            size_t offset;
+            size_t size;
+            bool keyframe;
+        };
+
+        void popFront();
+
         size_t mSizeInBytes = 0U;
-        std::queue<LayersTraceProto> mStorage;
+        size_t mUsedInBytes = 0U;
+        size_t mKeyframeCount = 0U;
+        // Where the next entry is written
+        size_t mHead = 0U;
+        std::vector<uint8_t> mStorage;
+        std::deque<Entry> mEntries;
     };
 
     void mainLoop();
@@ -94,6 +123,8 @@ private:
 
     // Returns true if trace is enabled.
     bool addTraceToBuffer(LayersTraceProto& entry);
+    // Strips the layers which are unchanged since the last entry, unless keyframe is set.
+    void encodeDelta(LayersTraceProto& entry, bool keyframe);
     void writeProtoFileLocked() REQUIRES(mTraceLock);
 
     SurfaceFlinger& mFlinger;
@@ -112,6 +143,12 @@ private:
     size_t mBufferSize GUARDED_BY(mTraceLock) = kDefaultBufferCapInByte;
     bool mEnabled GUARDED_BY(mTraceLock) = false;
     bool mWriteToFile GUARDED_BY(mTraceLock) = false;
+    bool mDeltaEncoding GUARDED_BY(mTraceLock) = false;
+
+    // Only accessed on the tracing thread.
+    std::unordered_map<int32_t, std::string> mLastLayers;
+    size_t mEntriesSinceKeyframe = 0U;
+    std::string mSerializedEntry;
 };
 
 } // namespace android
@@ -30,6 +30,8 @@
 #include <utils/Timers.h>
 #include <utils/Trace.h>
 
+#include <pthread.h>
+
 #include <algorithm>
 #include <chrono>
 
@@ -92,6 +94,7 @@ std::string histogramToProtoByteString(const std::unordered_map<int32_t, int32_t
 
 AStatsManager_PullAtomCallbackReturn TimeStats::populateGlobalAtom(AStatsEventList* data) {
     std::lock_guard<std::mutex> lock(mMutex);
+    flushLayerEventsLocked();
 
     if (mTimeStats.statsStart == 0) {
         return AStatsManager_PULL_SKIP;
@@ -123,6 +126,7 @@ AStatsManager_PullAtomCallbackReturn TimeStats::populateGlobalAtom(AStatsEventLi
 
 AStatsManager_PullAtomCallbackReturn TimeStats::populateLayerAtom(AStatsEventList* data) {
     std::lock_guard<std::mutex> lock(mMutex);
+    flushLayerEventsLocked();
 
     std::vector<TimeStatsHelper::TimeStatsLayer const*> dumpStats;
     for (const auto& ele : mTimeStats.stats) {
@@ -184,9 +188,19 @@ TimeStats::TimeStats(std::unique_ptr<StatsEventDelegate> statsDelegate,
     if (maxPulledHistogramBuckets) {
         mMaxPulledHistogramBuckets = *maxPulledHistogramBuckets;
     }
+
+    mFoldThread = std::thread(&TimeStats::foldThreadMain, this);
+    pthread_setname_np(mFoldThread.native_handle(), "TimeStatsFold");
 }
 
 TimeStats::~TimeStats() {
+    {
+        std::lock_guard<std::mutex> lock(mEventMutex);
+        mStopFolding = true;
+        mEventCondition.notify_one();
+    }
+    mFoldThread.join();
+
     std::lock_guard<std::mutex> lock(mMutex);
     mStatsDelegate->clearStatsPullAtomCallback(android::util::SURFACEFLINGER_STATS_GLOBAL_INFO);
     mStatsDelegate->clearStatsPullAtomCallback(android::util::SURFACEFLINGER_STATS_LAYER_INFO);
@@ -238,6 +252,7 @@ std::string TimeStats::miniDump() {
 
     std::string result = "TimeStats miniDump:\n";
     std::lock_guard<std::mutex> lock(mMutex);
+    flushLayerEventsLocked();
     android::base::StringAppendF(&result, "Number of layers currently being tracked is %zu\n",
                                  mTimeStatsTracker.size());
     android::base::StringAppendF(&result, "Number of layers in the stats pool is %zu\n",
@@ -299,6 +314,24 @@ void TimeStats::incrementCompositionStrategyChanges() {
     mTimeStats.compositionStrategyChanges++;
 }
 
+void TimeStats::incrementLayerFlatteningHits() {
+    if (!mEnabled.load()) return;
+
+    ATRACE_CALL();
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mTimeStats.layerFlatteningHits++;
+}
+
+void TimeStats::incrementLayerFlatteningMisses() {
+    if (!mEnabled.load()) return;
+
+    ATRACE_CALL();
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mTimeStats.layerFlatteningMisses++;
+}
+
 void TimeStats::recordDisplayEventConnectionCount(int32_t count) {
     if (!mEnabled.load()) return;
 
@@ -411,6 +444,11 @@ void TimeStats::flushAvailableRecordsToStatsLocked(int32_t layerId) {
             layerRecord.lateAcquireFrames = 0;
             layerRecord.badDesiredPresentFrames = 0;
 
+            for (const auto& [depth, count] : layerRecord.queueOccupancy.depths) {
+                timeStatsLayer.queueOccupancy.depths[depth] += count;
+            }
+            layerRecord.queueOccupancy.depths.clear();
+
             const int32_t postToAcquireMs = msBetween(timeRecords[0].frameTime.postTime,
                                                       timeRecords[0].frameTime.acquireTime);
             ALOGV("[%d]-[%" PRIu64 "]-post2acquire[%d]", layerId,
@@ -466,211 +504,287 @@ void TimeStats::setPostTime(int32_t layerId, uint64_t frameNumber, const std::st
                             nsecs_t postTime) {
     if (!mEnabled.load()) return;
 
-    ATRACE_CALL();
-    ALOGV("[%d]-[%" PRIu64 "]-[%s]-PostTime[%" PRId64 "]", layerId, frameNumber, layerName.c_str(),
-          postTime);
-
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (!mTimeStats.stats.count(layerName) && mTimeStats.stats.size() >= MAX_NUM_LAYER_STATS) {
-        return;
-    }
-    if (!mTimeStatsTracker.count(layerId) && mTimeStatsTracker.size() < MAX_NUM_LAYER_RECORDS &&
-        layerNameIsValid(layerName)) {
-        mTimeStatsTracker[layerId].layerName = layerName;
-    }
-    if (!mTimeStatsTracker.count(layerId)) return;
-    LayerRecord& layerRecord = mTimeStatsTracker[layerId];
-    if (layerRecord.timeRecords.size() == MAX_NUM_TIME_RECORDS) {
-        ALOGE("[%d]-[%s]-timeRecords is at its maximum size[%zu]. Ignore this when unittesting.",
-              layerId, layerRecord.layerName.c_str(), MAX_NUM_TIME_RECORDS);
-        mTimeStatsTracker.erase(layerId);
-        return;
-    }
-    // For most media content, the acquireFence is invalid because the buffer is
-    // ready at the queueBuffer stage. In this case, acquireTime should be given
-    // a default value as postTime.
-    TimeRecord timeRecord = {
-            .frameTime =
-                    {
-                            .frameNumber = frameNumber,
-                            .postTime = postTime,
-                            .latchTime = postTime,
-                            .acquireTime = postTime,
-                            .desiredTime = postTime,
-                    },
-    };
-    layerRecord.timeRecords.push_back(timeRecord);
-    if (layerRecord.waitData < 0 ||
-        layerRecord.waitData >= static_cast<int32_t>(layerRecord.timeRecords.size()))
-        layerRecord.waitData = layerRecord.timeRecords.size() - 1;
+    queueLayerEvent({.type = LayerEvent::Type::PostTime,
+                     .layerId = layerId,
+                     .frameNumber = frameNumber,
+                     .time = postTime,
+                     .layerName = layerName});
 }
 
 void TimeStats::setLatchTime(int32_t layerId, uint64_t frameNumber, nsecs_t latchTime) {
     if (!mEnabled.load()) return;
 
-    ATRACE_CALL();
-    ALOGV("[%d]-[%" PRIu64 "]-LatchTime[%" PRId64 "]", layerId, frameNumber, latchTime);
-
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (!mTimeStatsTracker.count(layerId)) return;
-    LayerRecord& layerRecord = mTimeStatsTracker[layerId];
-    if (layerRecord.waitData < 0 ||
-        layerRecord.waitData >= static_cast<int32_t>(layerRecord.timeRecords.size()))
-        return;
-    TimeRecord& timeRecord = layerRecord.timeRecords[layerRecord.waitData];
-    if (timeRecord.frameTime.frameNumber == frameNumber) {
-        timeRecord.frameTime.latchTime = latchTime;
-    }
+    queueLayerEvent({.type = LayerEvent::Type::LatchTime,
+                     .layerId = layerId,
+                     .frameNumber = frameNumber,
+                     .time = latchTime});
 }
 
 void TimeStats::incrementLatchSkipped(int32_t layerId, LatchSkipReason reason) {
     if (!mEnabled.load()) return;
 
-    ATRACE_CALL();
-    ALOGV("[%d]-LatchSkipped-Reason[%d]", layerId,
-          static_cast<std::underlying_type<LatchSkipReason>::type>(reason));
-
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (!mTimeStatsTracker.count(layerId)) return;
-    LayerRecord& layerRecord = mTimeStatsTracker[layerId];
-
-    switch (reason) {
-        case LatchSkipReason::LateAcquire:
-            layerRecord.lateAcquireFrames++;
-            break;
-    }
+    queueLayerEvent({.type = LayerEvent::Type::LatchSkipped,
+                     .layerId = layerId,
+                     .latchSkipReason = reason});
 }
 
 void TimeStats::incrementBadDesiredPresent(int32_t layerId) {
     if (!mEnabled.load()) return;
 
-    ATRACE_CALL();
-    ALOGV("[%d]-BadDesiredPresent", layerId);
+    queueLayerEvent({.type = LayerEvent::Type::BadDesiredPresent, .layerId = layerId});
+}
 
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (!mTimeStatsTracker.count(layerId)) return;
-    LayerRecord& layerRecord = mTimeStatsTracker[layerId];
-    layerRecord.badDesiredPresentFrames++;
+void TimeStats::recordQueueDepth(int32_t layerId, int32_t queuedFrames) {
+    if (!mEnabled.load()) return;
+
+    queueLayerEvent({.type = LayerEvent::Type::QueueDepth,
+                     .layerId = layerId,
+                     .queuedFrames = queuedFrames});
 }
 
 void TimeStats::setDesiredTime(int32_t layerId, uint64_t frameNumber, nsecs_t desiredTime) {
     if (!mEnabled.load()) return;
 
-    ATRACE_CALL();
-    ALOGV("[%d]-[%" PRIu64 "]-DesiredTime[%" PRId64 "]", layerId, frameNumber, desiredTime);
-
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (!mTimeStatsTracker.count(layerId)) return;
-    LayerRecord& layerRecord = mTimeStatsTracker[layerId];
-    if (layerRecord.waitData < 0 ||
-        layerRecord.waitData >= static_cast<int32_t>(layerRecord.timeRecords.size()))
-        return;
-    TimeRecord& timeRecord = layerRecord.timeRecords[layerRecord.waitData];
-    if (timeRecord.frameTime.frameNumber == frameNumber) {
-        timeRecord.frameTime.desiredTime = desiredTime;
-    }
+    queueLayerEvent({.type = LayerEvent::Type::DesiredTime,
+                     .layerId = layerId,
+                     .frameNumber = frameNumber,
+                     .time = desiredTime});
 }
 
 void TimeStats::setAcquireTime(int32_t layerId, uint64_t frameNumber, nsecs_t acquireTime) {
     if (!mEnabled.load()) return;
 
-    ATRACE_CALL();
-    ALOGV("[%d]-[%" PRIu64 "]-AcquireTime[%" PRId64 "]", layerId, frameNumber, acquireTime);
-
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (!mTimeStatsTracker.count(layerId)) return;
-    LayerRecord& layerRecord = mTimeStatsTracker[layerId];
-    if (layerRecord.waitData < 0 ||
-        layerRecord.waitData >= static_cast<int32_t>(layerRecord.timeRecords.size()))
-        return;
-    TimeRecord& timeRecord = layerRecord.timeRecords[layerRecord.waitData];
-    if (timeRecord.frameTime.frameNumber == frameNumber) {
-        timeRecord.frameTime.acquireTime = acquireTime;
-    }
+    queueLayerEvent({.type = LayerEvent::Type::AcquireTime,
+                     .layerId = layerId,
+                     .frameNumber = frameNumber,
+                     .time = acquireTime});
 }
 
 void TimeStats::setAcquireFence(int32_t layerId, uint64_t frameNumber,
                                 const std::shared_ptr<FenceTime>& acquireFence) {
     if (!mEnabled.load()) return;
 
-    ATRACE_CALL();
-    ALOGV("[%d]-[%" PRIu64 "]-AcquireFenceTime[%" PRId64 "]", layerId, frameNumber,
-          acquireFence->getSignalTime());
-
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (!mTimeStatsTracker.count(layerId)) return;
-    LayerRecord& layerRecord = mTimeStatsTracker[layerId];
-    if (layerRecord.waitData < 0 ||
-        layerRecord.waitData >= static_cast<int32_t>(layerRecord.timeRecords.size()))
-        return;
-    TimeRecord& timeRecord = layerRecord.timeRecords[layerRecord.waitData];
-    if (timeRecord.frameTime.frameNumber == frameNumber) {
-        timeRecord.acquireFence = acquireFence;
-    }
+    queueLayerEvent({.type = LayerEvent::Type::AcquireFence,
+                     .layerId = layerId,
+                     .frameNumber = frameNumber,
+                     .fence = acquireFence});
 }
 
 void TimeStats::setPresentTime(int32_t layerId, uint64_t frameNumber, nsecs_t presentTime) {
     if (!mEnabled.load()) return;
 
-    ATRACE_CALL();
-    ALOGV("[%d]-[%" PRIu64 "]-PresentTime[%" PRId64 "]", layerId, frameNumber, presentTime);
-
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (!mTimeStatsTracker.count(layerId)) return;
-    LayerRecord& layerRecord = mTimeStatsTracker[layerId];
-    if (layerRecord.waitData < 0 ||
-        layerRecord.waitData >= static_cast<int32_t>(layerRecord.timeRecords.size()))
-        return;
-    TimeRecord& timeRecord = layerRecord.timeRecords[layerRecord.waitData];
-    if (timeRecord.frameTime.frameNumber == frameNumber) {
-        timeRecord.frameTime.presentTime = presentTime;
-        timeRecord.ready = true;
-        layerRecord.waitData++;
-    }
-
-    flushAvailableRecordsToStatsLocked(layerId);
+    queueLayerEvent({.type = LayerEvent::Type::PresentTime,
+                     .layerId = layerId,
+                     .frameNumber = frameNumber,
+                     .time = presentTime});
 }
 
 void TimeStats::setPresentFence(int32_t layerId, uint64_t frameNumber,
                                 const std::shared_ptr<FenceTime>& presentFence) {
     if (!mEnabled.load()) return;
 
+    queueLayerEvent({.type = LayerEvent::Type::PresentFence,
+                     .layerId = layerId,
+                     .frameNumber = frameNumber,
+                     .fence = presentFence});
+}
+
+void TimeStats::onDestroy(int32_t layerId) {
+    // Queued regardless of mEnabled, so that it is ordered after any record still pending for
+    // the layer.
+    queueLayerEvent({.type = LayerEvent::Type::Destroy, .layerId = layerId});
+}
+
+void TimeStats::removeTimeRecord(int32_t layerId, uint64_t frameNumber) {
+    if (!mEnabled.load()) return;
+
+    queueLayerEvent({.type = LayerEvent::Type::RemoveTimeRecord,
+                     .layerId = layerId,
+                     .frameNumber = frameNumber});
+}
+
+void TimeStats::queueLayerEvent(LayerEvent&& event) {
+    std::lock_guard<std::mutex> lock(mEventMutex);
+    mPendingLayerEvents.push_back(std::move(event));
+    if (mPendingLayerEvents.size() >= MAX_NUM_PENDING_LAYER_EVENTS) {
+        mFoldRequested = true;
+        mEventCondition.notify_one();
+    }
+}
+
+void TimeStats::requestFold() {
+    std::lock_guard<std::mutex> lock(mEventMutex);
+    if (mPendingLayerEvents.empty()) return;
+    mFoldRequested = true;
+    mEventCondition.notify_one();
+}
+
+void TimeStats::foldThreadMain() {
+    std::unique_lock<std::mutex> eventLock(mEventMutex);
+    while (true) {
+        mEventCondition.wait(eventLock, [this] { return mFoldRequested || mStopFolding; });
+        if (mStopFolding) break;
+        mFoldRequested = false;
+
+        // mMutex is taken before mEventMutex everywhere else.
+        eventLock.unlock();
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            flushLayerEventsLocked();
+        }
+        eventLock.lock();
+    }
+}
+
+void TimeStats::flushLayerEventsLocked() {
+    {
+        std::lock_guard<std::mutex> lock(mEventMutex);
+        // mFoldingLayerEvents is empty, so this hands its capacity back to the producers.
+        std::swap(mPendingLayerEvents, mFoldingLayerEvents);
+    }
+    if (mFoldingLayerEvents.empty()) return;
+
     ATRACE_CALL();
-    ALOGV("[%d]-[%" PRIu64 "]-PresentFenceTime[%" PRId64 "]", layerId, frameNumber,
-          presentFence->getSignalTime());
+    for (const LayerEvent& event : mFoldingLayerEvents) {
+        applyLayerEventLocked(event);
+    }
+    mFoldingLayerEvents.clear();
+}
+
+void TimeStats::applyLayerEventLocked(const LayerEvent& event) {
+    const int32_t layerId = event.layerId;
+    const uint64_t frameNumber = event.frameNumber;
+
+    if (event.type == LayerEvent::Type::PostTime) {
+        setPostTimeLocked(layerId, frameNumber, event.layerName, event.time);
+        return;
+    }
+    if (event.type == LayerEvent::Type::Destroy) {
+        ALOGV("[%d]-onDestroy", layerId);
+        mTimeStatsTracker.erase(layerId);
+        return;
+    }
+
+    const auto it = mTimeStatsTracker.find(layerId);
+    if (it == mTimeStatsTracker.end()) return;
+    LayerRecord& layerRecord = it->second;
+
+    switch (event.type) {
+        case LayerEvent::Type::LatchSkipped:
+            ALOGV("[%d]-LatchSkipped-Reason[%d]", layerId,
+                  static_cast<std::underlying_type<LatchSkipReason>::type>(
+                          event.latchSkipReason));
+            switch (event.latchSkipReason) {
+                case LatchSkipReason::LateAcquire:
+                    layerRecord.lateAcquireFrames++;
+                    break;
+            }
+            return;
+        case LayerEvent::Type::BadDesiredPresent:
+            ALOGV("[%d]-BadDesiredPresent", layerId);
+            layerRecord.badDesiredPresentFrames++;
+            return;
+        case LayerEvent::Type::QueueDepth:
+            ALOGV("[%d]-QueueDepth[%d]", layerId, event.queuedFrames);
+            layerRecord.queueOccupancy.insert(event.queuedFrames);
+            return;
+        case LayerEvent::Type::RemoveTimeRecord:
+            removeTimeRecordLocked(layerId, frameNumber, layerRecord);
+            return;
+        default:
+            break;
+    }
 
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (!mTimeStatsTracker.count(layerId)) return;
-    LayerRecord& layerRecord = mTimeStatsTracker[layerId];
     if (layerRecord.waitData < 0 ||
         layerRecord.waitData >= static_cast<int32_t>(layerRecord.timeRecords.size()))
         return;
     TimeRecord& timeRecord = layerRecord.timeRecords[layerRecord.waitData];
-    if (timeRecord.frameTime.frameNumber == frameNumber) {
-        timeRecord.presentFence = presentFence;
-        timeRecord.ready = true;
-        layerRecord.waitData++;
-    }
+    if (timeRecord.frameTime.frameNumber != frameNumber) return;
 
-    flushAvailableRecordsToStatsLocked(layerId);
+    switch (event.type) {
+        case LayerEvent::Type::LatchTime:
+            ALOGV("[%d]-[%" PRIu64 "]-LatchTime[%" PRId64 "]", layerId, frameNumber, event.time);
+            timeRecord.frameTime.latchTime = event.time;
+            break;
+        case LayerEvent::Type::DesiredTime:
+            ALOGV("[%d]-[%" PRIu64 "]-DesiredTime[%" PRId64 "]", layerId, frameNumber,
+                  event.time);
+            timeRecord.frameTime.desiredTime = event.time;
+            break;
+        case LayerEvent::Type::AcquireTime:
+            ALOGV("[%d]-[%" PRIu64 "]-AcquireTime[%" PRId64 "]", layerId, frameNumber,
+                  event.time);
+            timeRecord.frameTime.acquireTime = event.time;
+            break;
+        case LayerEvent::Type::AcquireFence:
+            ALOGV("[%d]-[%" PRIu64 "]-AcquireFenceTime[%" PRId64 "]", layerId, frameNumber,
+                  event.fence->getSignalTime());
+            timeRecord.acquireFence = event.fence;
+            break;
+        case LayerEvent::Type::PresentTime:
+            ALOGV("[%d]-[%" PRIu64 "]-PresentTime[%" PRId64 "]", layerId, frameNumber,
+                  event.time);
+            timeRecord.frameTime.presentTime = event.time;
+            timeRecord.ready = true;
+            layerRecord.waitData++;
+            flushAvailableRecordsToStatsLocked(layerId);
+            break;
+        case LayerEvent::Type::PresentFence:
+            ALOGV("[%d]-[%" PRIu64 "]-PresentFenceTime[%" PRId64 "]", layerId, frameNumber,
+                  event.fence->getSignalTime());
+            timeRecord.presentFence = event.fence;
+            timeRecord.ready = true;
+            layerRecord.waitData++;
+            flushAvailableRecordsToStatsLocked(layerId);
+            break;
+        default:
+            break;
+    }
 }
 
-void TimeStats::onDestroy(int32_t layerId) {
-    ATRACE_CALL();
-    ALOGV("[%d]-onDestroy", layerId);
-    std::lock_guard<std::mutex> lock(mMutex);
-    mTimeStatsTracker.erase(layerId);
-}
+void TimeStats::setPostTimeLocked(int32_t layerId, uint64_t frameNumber,
+                                  const std::string& layerName, nsecs_t postTime) {
+    ALOGV("[%d]-[%" PRIu64 "]-[%s]-PostTime[%" PRId64 "]", layerId, frameNumber, layerName.c_str(),
+          postTime);
 
-void TimeStats::removeTimeRecord(int32_t layerId, uint64_t frameNumber) {
-    if (!mEnabled.load()) return;
+    if (!mTimeStats.stats.count(layerName) && mTimeStats.stats.size() >= MAX_NUM_LAYER_STATS) {
+        return;
+    }
+    if (!mTimeStatsTracker.count(layerId) && mTimeStatsTracker.size() < MAX_NUM_LAYER_RECORDS &&
+        layerNameIsValid(layerName)) {
+        mTimeStatsTracker[layerId].layerName = layerName;
+    }
+    if (!mTimeStatsTracker.count(layerId)) return;
+    LayerRecord& layerRecord = mTimeStatsTracker[layerId];
+    if (layerRecord.timeRecords.size() == MAX_NUM_TIME_RECORDS) {
+        ALOGE("[%d]-[%s]-timeRecords is at its maximum size[%zu]. Ignore this when unittesting.",
+              layerId, layerRecord.layerName.c_str(), MAX_NUM_TIME_RECORDS);
+        mTimeStatsTracker.erase(layerId);
+        return;
+    }
+    // For most media content, the acquireFence is invalid because the buffer is
+    // ready at the queueBuffer stage. In this case, acquireTime should be given
+    // a default value as postTime.
+    TimeRecord timeRecord = {
+            .frameTime =
+                    {
+                            .frameNumber = frameNumber,
+                            .postTime = postTime,
+                            .latchTime = postTime,
+                            .acquireTime = postTime,
+                            .desiredTime = postTime,
+                    },
+    };
+    layerRecord.timeRecords.push_back(timeRecord);
+    if (layerRecord.waitData < 0 ||
+        layerRecord.waitData >= static_cast<int32_t>(layerRecord.timeRecords.size()))
+        layerRecord.waitData = layerRecord.timeRecords.size() - 1;
+}
 
-    ATRACE_CALL();
+void TimeStats::removeTimeRecordLocked(int32_t layerId, uint64_t frameNumber,
+                                       LayerRecord& layerRecord) {
     ALOGV("[%d]-[%" PRIu64 "]-removeTimeRecord", layerId, frameNumber);
 
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (!mTimeStatsTracker.count(layerId)) return;
-    LayerRecord& layerRecord = mTimeStatsTracker[layerId];
     size_t removeAt = 0;
     for (const TimeRecord& record : layerRecord.timeRecords) {
         if (record.frameTime.frameNumber == frameNumber) break;
@@ -729,6 +843,33 @@ void TimeStats::recordRefreshRate(uint32_t fps, nsecs_t duration) {
     }
 }
 
+void TimeStats::recordVsyncPredictionError(uint32_t fps, nsecs_t error) {
+    if (!mEnabled.load()) return;
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mTimeStats.vsyncPredictionErrors[fps].insert(error);
+}
+
+void TimeStats::incrementJankyFrames(int32_t jankType) {
+    if (!mEnabled.load()) return;
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mTimeStats.jankPayload.insert(jankType);
+}
+
+void TimeStats::incrementJankyFrames(const std::string& layerName, int32_t jankType) {
+    if (!mEnabled.load()) return;
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (!mTimeStats.stats.count(layerName)) {
+        if (mTimeStats.stats.size() >= MAX_NUM_LAYER_STATS || !layerNameIsValid(layerName)) {
+            return;
+        }
+        mTimeStats.stats[layerName].layerName = layerName;
+    }
+    mTimeStats.stats[layerName].jankPayload.insert(jankType);
+}
+
 void TimeStats::flushAvailableGlobalRecordsToStatsLocked() {
     ATRACE_CALL();
 
@@ -788,6 +929,9 @@ void TimeStats::setPresentFenceGlobal(const std::shared_ptr<FenceTime>& presentF
     if (!mEnabled.load()) return;
 
     ATRACE_CALL();
+    // Once per frame, hand the layer records queued during it to the fold thread.
+    requestFold();
+
     std::lock_guard<std::mutex> lock(mMutex);
     if (presentFence == nullptr || !presentFence->isValid()) {
         mGlobalRecord.prevPresentTime = 0;
@@ -840,6 +984,7 @@ void TimeStats::disable() {
 
 void TimeStats::clearAll() {
     std::lock_guard<std::mutex> lock(mMutex);
+    flushLayerEventsLocked();
     clearGlobalLocked();
     clearLayersLocked();
 }
@@ -855,12 +1000,16 @@ void TimeStats::clearGlobalLocked() {
     mTimeStats.clientCompositionReusedFrames = 0;
     mTimeStats.refreshRateSwitches = 0;
     mTimeStats.compositionStrategyChanges = 0;
+    mTimeStats.layerFlatteningHits = 0;
+    mTimeStats.layerFlatteningMisses = 0;
     mTimeStats.displayEventConnectionsCount = 0;
     mTimeStats.displayOnTime = 0;
     mTimeStats.presentToPresent.hist.clear();
     mTimeStats.frameDuration.hist.clear();
     mTimeStats.renderEngineTiming.hist.clear();
     mTimeStats.refreshRateStats.clear();
+    mTimeStats.vsyncPredictionErrors.clear();
+    mTimeStats.jankPayload = {};
     mPowerTime.prevTime = systemTime();
     mGlobalRecord.prevPresentTime = 0;
     mGlobalRecord.presentFences.clear();
@@ -887,6 +1036,7 @@ void TimeStats::dump(bool asProto, std::optional<uint32_t> maxLayers, std::strin
         return;
     }
 
+    flushLayerEventsLocked();
     mTimeStats.statsEnd = static_cast<int64_t>(std::time(0));
 
     flushPowerTimeLocked();
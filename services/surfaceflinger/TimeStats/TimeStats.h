@@ -34,11 +34,15 @@
 #include <utils/String16.h>
 #include <utils/Vector.h>
 
+#include <condition_variable>
 #include <deque>
 #include <mutex>
 #include <optional>
+#include <string>
+#include <thread>
 #include <unordered_map>
 #include <variant>
+#include <vector>
 
 using namespace android::surfaceflinger;
 
@@ -66,6 +70,12 @@ public:
     // The intention is to reflect the number of changes between hwc and gpu
     // composition, where "gpu composition" may also include mixed composition.
     virtual void incrementCompositionStrategyChanges() = 0;
+    // Increments the number of frames which presented layers flattened into a
+    // single buffer on an earlier frame.
+    virtual void incrementLayerFlatteningHits() = 0;
+    // Increments the number of flattened buffers dropped, either because a
+    // flattened layer changed or because the HWC could not present the buffer.
+    virtual void incrementLayerFlatteningMisses() = 0;
     // Records the most up-to-date count of display event connections.
     // The stored count will be the maximum ever recoded.
     virtual void recordDisplayEventConnectionCount(int32_t count) = 0;
@@ -99,6 +109,9 @@ public:
     // Bad desired present times are "implausible" and cause SurfaceFlinger to
     // latch a buffer immediately to avoid stalling.
     virtual void incrementBadDesiredPresent(int32_t layerId) = 0;
+    // Records the number of buffers queued for this layer, including the one being latched, each
+    // time a buffer is latched.
+    virtual void recordQueueDepth(int32_t layerId, int32_t queuedFrames) = 0;
     virtual void setDesiredTime(int32_t layerId, uint64_t frameNumber, nsecs_t desiredTime) = 0;
     virtual void setAcquireTime(int32_t layerId, uint64_t frameNumber, nsecs_t acquireTime) = 0;
     virtual void setAcquireFence(int32_t layerId, uint64_t frameNumber,
@@ -117,6 +130,13 @@ public:
             hardware::graphics::composer::V2_4::IComposerClient::PowerMode powerMode) = 0;
     // Source of truth is RefrehRateStats.
     virtual void recordRefreshRate(uint32_t fps, nsecs_t duration) = 0;
+    // Records the error between a hardware vsync and the vsync model's prediction for it,
+    // attributed to the refresh rate the model was tuned for.
+    virtual void recordVsyncPredictionError(uint32_t fps, nsecs_t error) = 0;
+    // Records the classification of a display frame, or of a layer's frame, once its present
+    // fence has signaled. jankType is a bitmask of TimeStatsHelper::JankType.
+    virtual void incrementJankyFrames(int32_t jankType) = 0;
+    virtual void incrementJankyFrames(const std::string& layerName, int32_t jankType) = 0;
     virtual void setPresentFenceGlobal(const std::shared_ptr<FenceTime>& presentFence) = 0;
 };
 
@@ -150,6 +170,7 @@ class TimeStats : public android::TimeStats {
         uint32_t droppedFrames = 0;
         uint32_t lateAcquireFrames = 0;
         uint32_t badDesiredPresentFrames = 0;
+        TimeStatsHelper::QueueOccupancy queueOccupancy;
         TimeRecord prevTimeRecord;
         std::deque<TimeRecord> timeRecords;
     };
@@ -170,6 +191,35 @@ class TimeStats : public android::TimeStats {
         std::deque<RenderEngineDuration> renderEngineDurations;
     };
 
+    // A per-layer record, queued by the calling thread and applied to mTimeStatsTracker later
+    // on the fold thread, so that recording a frame costs one short critical section instead of
+    // hash map lookups under mMutex.
+    struct LayerEvent {
+        enum class Type {
+            PostTime,
+            LatchTime,
+            LatchSkipped,
+            BadDesiredPresent,
+            QueueDepth,
+            DesiredTime,
+            AcquireTime,
+            AcquireFence,
+            PresentTime,
+            PresentFence,
+            Destroy,
+            RemoveTimeRecord,
+        };
+
+        Type type;
+        int32_t layerId = 0;
+        uint64_t frameNumber = 0;
+        nsecs_t time = 0;
+        std::shared_ptr<FenceTime> fence;
+        std::string layerName;
+        LatchSkipReason latchSkipReason = LatchSkipReason::LateAcquire;
+        int32_t queuedFrames = 0;
+    };
+
 public:
     TimeStats();
 
@@ -234,6 +284,8 @@ public:
     void incrementClientCompositionReusedFrames() override;
     void incrementRefreshRateSwitches() override;
     void incrementCompositionStrategyChanges() override;
+    void incrementLayerFlatteningHits() override;
+    void incrementLayerFlatteningMisses() override;
     void recordDisplayEventConnectionCount(int32_t count) override;
 
     void recordFrameDuration(nsecs_t startTime, nsecs_t endTime) override;
@@ -246,6 +298,7 @@ public:
     void setLatchTime(int32_t layerId, uint64_t frameNumber, nsecs_t latchTime) override;
     void incrementLatchSkipped(int32_t layerId, LatchSkipReason reason) override;
     void incrementBadDesiredPresent(int32_t layerId) override;
+    void recordQueueDepth(int32_t layerId, int32_t queuedFrames) override;
     void setDesiredTime(int32_t layerId, uint64_t frameNumber, nsecs_t desiredTime) override;
     void setAcquireTime(int32_t layerId, uint64_t frameNumber, nsecs_t acquireTime) override;
     void setAcquireFence(int32_t layerId, uint64_t frameNumber,
@@ -262,6 +315,9 @@ public:
             hardware::graphics::composer::V2_4::IComposerClient::PowerMode powerMode) override;
     // Source of truth is RefrehRateStats.
     void recordRefreshRate(uint32_t fps, nsecs_t duration) override;
+    void recordVsyncPredictionError(uint32_t fps, nsecs_t error) override;
+    void incrementJankyFrames(int32_t jankType) override;
+    void incrementJankyFrames(const std::string& layerName, int32_t jankType) override;
     void setPresentFenceGlobal(const std::shared_ptr<FenceTime>& presentFence) override;
 
     static const size_t MAX_NUM_TIME_RECORDS = 64;
@@ -276,6 +332,17 @@ private:
     void flushAvailableRecordsToStatsLocked(int32_t layerId);
     void flushPowerTimeLocked();
     void flushAvailableGlobalRecordsToStatsLocked();
+    void queueLayerEvent(LayerEvent&& event);
+    // Wakes up the fold thread if there are queued layer events.
+    void requestFold();
+    void foldThreadMain();
+    // Applies all queued layer events. Called with mMutex held, by the fold thread and by
+    // readers so that they observe every record queued before them.
+    void flushLayerEventsLocked();
+    void applyLayerEventLocked(const LayerEvent& event);
+    void setPostTimeLocked(int32_t layerId, uint64_t frameNumber, const std::string& layerName,
+                           nsecs_t postTime);
+    void removeTimeRecordLocked(int32_t layerId, uint64_t frameNumber, LayerRecord& layerRecord);
 
     void enable();
     void disable();
@@ -291,12 +358,26 @@ private:
     std::unordered_map<int32_t, LayerRecord> mTimeStatsTracker;
     PowerTime mPowerTime;
     GlobalRecord mGlobalRecord;
+    // Layer events being applied by flushLayerEventsLocked(). Kept to reuse its capacity.
+    std::vector<LayerEvent> mFoldingLayerEvents;
+
+    // mEventMutex nests inside mMutex.
+    std::mutex mEventMutex;
+    std::condition_variable mEventCondition;
+    std::vector<LayerEvent> mPendingLayerEvents;
+    bool mFoldRequested = false;
+    bool mStopFolding = false;
 
     static const size_t MAX_NUM_LAYER_RECORDS = 200;
     static const size_t MAX_NUM_LAYER_STATS = 200;
+    // Folding is forced once this many layer events are pending, e.g. while the display is off.
+    static const size_t MAX_NUM_PENDING_LAYER_EVENTS = 4096;
     std::unique_ptr<StatsEventDelegate> mStatsDelegate = std::make_unique<StatsEventDelegate>();
     size_t mMaxPulledLayers = 8;
     size_t mMaxPulledHistogramBuckets = 6;
+
+    // Started last and stopped first, as it uses the members above.
+    std::thread mFoldThread;
 };
 
 } // namespace impl
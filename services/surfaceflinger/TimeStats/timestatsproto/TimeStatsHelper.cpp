@@ -18,7 +18,9 @@
 #include <android-base/stringprintf.h>
 #include <inttypes.h>
 
+#include <algorithm>
 #include <array>
+#include <cstdlib>
 
 #define HISTOGRAM_SIZE 85
 
@@ -77,6 +79,77 @@ std::string TimeStatsHelper::Histogram::toString() const {
     return result;
 }
 
+void TimeStatsHelper::VsyncPredictionError::insert(nsecs_t error) {
+    const int64_t absError = std::abs(error);
+    samples++;
+    totalAbsError += absError;
+    maxAbsError = std::max(maxAbsError, absError);
+    if (absError > ms2ns(1)) {
+        lateSamples++;
+    }
+}
+
+std::string TimeStatsHelper::VsyncPredictionError::toString() const {
+    const float averageAbsError = samples ? totalAbsError / 1e3f / samples : 0.0f;
+    return StringPrintf("samples=%d averageAbsError=%.1fus maxAbsError=%.1fus lateSamples=%d\n",
+                        samples, averageAbsError, maxAbsError / 1e3f, lateSamples);
+}
+
+void TimeStatsHelper::QueueOccupancy::insert(int32_t queuedFrames) {
+    if (queuedFrames <= 0) return;
+    depths[queuedFrames]++;
+}
+
+int32_t TimeStatsHelper::QueueOccupancy::drainedLatches() const {
+    const auto iter = depths.find(1);
+    return iter == depths.end() ? 0 : iter->second;
+}
+
+int32_t TimeStatsHelper::QueueOccupancy::stuffedLatches() const {
+    int32_t stuffed = 0;
+    for (const auto& [depth, count] : depths) {
+        if (depth > 1) stuffed += count;
+    }
+    return stuffed;
+}
+
+std::string TimeStatsHelper::QueueOccupancy::toString() const {
+    std::vector<std::pair<int32_t, int32_t>> sorted(depths.begin(), depths.end());
+    std::sort(sorted.begin(), sorted.end());
+    std::string result = StringPrintf("drainedLatches = %d stuffedLatches = %d\n",
+                                      drainedLatches(), stuffedLatches());
+    if (sorted.empty()) return result;
+    result.append("queueDepth histogram is as below:\n");
+    for (const auto& [depth, count] : sorted) {
+        StringAppendF(&result, "%d=%d ", depth, count);
+    }
+    result.back() = '\n';
+    return result;
+}
+
+void TimeStatsHelper::JankPayload::insert(int32_t jankType) {
+    totalFrames++;
+    if (jankType == JankType::None) return;
+
+    totalJankyFrames++;
+    if (jankType & JankType::AppDeadlineMissed) appDeadlineMissed++;
+    if (jankType & JankType::SurfaceFlingerCpuDeadlineMissed) sfCpuDeadlineMissed++;
+    if (jankType & JankType::SurfaceFlingerGpuDeadlineMissed) sfGpuDeadlineMissed++;
+    if (jankType & JankType::DisplayHal) displayHal++;
+    if (jankType & JankType::BufferStuffing) bufferStuffing++;
+    if (jankType & JankType::Unknown) unknown++;
+}
+
+std::string TimeStatsHelper::JankPayload::toString() const {
+    return StringPrintf("totalTimelineFrames = %d\n"
+                        "jankyFrames = %d\n"
+                        "appDeadlineMissed = %d sfCpuDeadlineMissed = %d "
+                        "sfGpuDeadlineMissed = %d displayHal = %d bufferStuffing = %d "
+                        "unknownJank = %d\n",
+                        totalFrames, totalJankyFrames, appDeadlineMissed, sfCpuDeadlineMissed,
+                        sfGpuDeadlineMissed, displayHal, bufferStuffing, unknown);
+}
+
 std::string TimeStatsHelper::TimeStatsLayer::toString() const {
     std::string result = "\n";
     StringAppendF(&result, "layerName = %s\n", layerName.c_str());
@@ -85,6 +158,8 @@ std::string TimeStatsHelper::TimeStatsLayer::toString() const {
     StringAppendF(&result, "droppedFrames = %d\n", droppedFrames);
     StringAppendF(&result, "lateAcquireFrames = %d\n", lateAcquireFrames);
     StringAppendF(&result, "badDesiredPresentFrames = %d\n", badDesiredPresentFrames);
+    result.append(jankPayload.toString());
+    result.append(queueOccupancy.toString());
     const auto iter = deltas.find("present2present");
     if (iter != deltas.end()) {
         const float averageTime = iter->second.averageTime();
@@ -109,12 +184,19 @@ std::string TimeStatsHelper::TimeStatsGlobal::toString(std::optional<uint32_t> m
     StringAppendF(&result, "clientCompositionReusedFrames = %d\n", clientCompositionReusedFrames);
     StringAppendF(&result, "refreshRateSwitches = %d\n", refreshRateSwitches);
     StringAppendF(&result, "compositionStrategyChanges = %d\n", compositionStrategyChanges);
+    StringAppendF(&result, "layerFlatteningHits = %d\n", layerFlatteningHits);
+    StringAppendF(&result, "layerFlatteningMisses = %d\n", layerFlatteningMisses);
     StringAppendF(&result, "displayOnTime = %" PRId64 " ms\n", displayOnTime);
     StringAppendF(&result, "displayConfigStats is as below:\n");
     for (const auto& [fps, duration] : refreshRateStats) {
         StringAppendF(&result, "%dfps=%ldms ", fps, ns2ms(duration));
     }
     result.back() = '\n';
+    StringAppendF(&result, "vsyncPredictionError is as below:\n");
+    for (const auto& [fps, error] : vsyncPredictionErrors) {
+        StringAppendF(&result, "%dfps: %s", fps, error.toString().c_str());
+    }
+    result.append(jankPayload.toString());
     StringAppendF(&result, "totalP2PTime = %" PRId64 " ms\n", presentToPresent.totalTime());
     StringAppendF(&result, "presentToPresent histogram is as below:\n");
     result.append(presentToPresent.toString());
@@ -142,6 +224,11 @@ SFTimeStatsLayerProto TimeStatsHelper::TimeStatsLayer::toProto() const {
     layerProto.set_package_name(packageName);
     layerProto.set_total_frames(totalFrames);
     layerProto.set_dropped_frames(droppedFrames);
+    for (const auto& [depth, count] : queueOccupancy.depths) {
+        SFTimeStatsQueueDepthBucketProto* depthProto = layerProto.add_queue_depths();
+        depthProto->set_queued_frames(depth);
+        depthProto->set_latch_count(count);
+    }
     for (const auto& ele : deltas) {
         SFTimeStatsDeltaProto* deltaProto = layerProto.add_deltas();
         deltaProto->set_delta_name(ele.first);
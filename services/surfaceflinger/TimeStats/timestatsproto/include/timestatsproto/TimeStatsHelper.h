@@ -40,6 +40,69 @@ public:
         std::string toString() const;
     };
 
+    class VsyncPredictionError {
+    public:
+        int32_t samples = 0;
+        int64_t totalAbsError = 0;
+        int64_t maxAbsError = 0;
+        // Samples off by more than a millisecond, which is enough to move a frame across the
+        // edge of its vsync.
+        int32_t lateSamples = 0;
+
+        void insert(nsecs_t error);
+        std::string toString() const;
+    };
+
+    // Occupancy of a layer's buffer queue, sampled each time SurfaceFlinger latches a buffer.
+    class QueueOccupancy {
+    public:
+        // Key is the number of buffers queued when a buffer was latched, including that buffer.
+        // Value is the number of latches which saw that many buffers.
+        std::unordered_map<int32_t, int32_t> depths;
+
+        void insert(int32_t queuedFrames);
+        // Latches which left the queue empty, so that the next refresh starves unless the app
+        // queues another buffer in time.
+        int32_t drainedLatches() const;
+        // Latches with buffers queued behind the latched one, each of which is delayed by at
+        // least one more refresh.
+        int32_t stuffedLatches() const;
+        std::string toString() const;
+    };
+
+    // Bitmask of the reasons a frame missed its expected present time, as classified by
+    // FrameTimeline.
+    enum JankType : int32_t {
+        None = 0x0,
+        // The app did not finish rendering the buffer before SurfaceFlinger wanted to latch it.
+        AppDeadlineMissed = 0x1,
+        // SurfaceFlinger woke up late or its CPU work ran past the deadline.
+        SurfaceFlingerCpuDeadlineMissed = 0x2,
+        // Client composition did not finish before the deadline.
+        SurfaceFlingerGpuDeadlineMissed = 0x4,
+        // SurfaceFlinger was on time, but the display presented late.
+        DisplayHal = 0x8,
+        // The buffer was ready, but queued behind another buffer of the same layer.
+        BufferStuffing = 0x10,
+        // The frame was late for a reason that could not be attributed.
+        Unknown = 0x20,
+    };
+
+    class JankPayload {
+    public:
+        int32_t totalFrames = 0;
+        int32_t totalJankyFrames = 0;
+        int32_t appDeadlineMissed = 0;
+        int32_t sfCpuDeadlineMissed = 0;
+        int32_t sfGpuDeadlineMissed = 0;
+        int32_t displayHal = 0;
+        int32_t bufferStuffing = 0;
+        int32_t unknown = 0;
+
+        void insert(int32_t jankType);
+        std::string toString() const;
+    };
+
     class TimeStatsLayer {
     public:
         std::string layerName;
@@ -48,6 +111,8 @@ public:
         int32_t droppedFrames = 0;
         int32_t lateAcquireFrames = 0;
         int32_t badDesiredPresentFrames = 0;
+        JankPayload jankPayload;
+        QueueOccupancy queueOccupancy;
         std::unordered_map<std::string, Histogram> deltas;
 
         std::string toString() const;
@@ -64,6 +129,8 @@ public:
         int32_t clientCompositionReusedFrames = 0;
         int32_t refreshRateSwitches = 0;
         int32_t compositionStrategyChanges = 0;
+        int32_t layerFlatteningHits = 0;
+        int32_t layerFlatteningMisses = 0;
         int32_t displayEventConnectionsCount = 0;
         int64_t displayOnTime = 0;
         Histogram presentToPresent;
@@ -71,6 +138,8 @@ public:
         Histogram renderEngineTiming;
         std::unordered_map<std::string, TimeStatsLayer> stats;
         std::unordered_map<uint32_t, nsecs_t> refreshRateStats;
+        std::unordered_map<uint32_t, VsyncPredictionError> vsyncPredictionErrors;
+        JankPayload jankPayload;
 
         std::string toString(std::optional<uint32_t> maxLayers) const;
         SFTimeStatsGlobalProto toProto(std::optional<uint32_t> maxLayers) const;
@@ -259,6 +259,7 @@ void TransactionCompletedThread::addPresentFence(const sp<Fence>& presentFence)
 void TransactionCompletedThread::sendCallbacks() {
     std::lock_guard lock(mMutex);
     if (mRunning) {
+        mCallbacksPending = true;
         mConditionVariable.notify_all();
     }
 }
@@ -267,7 +268,13 @@ void TransactionCompletedThread::threadMain() {
     std::lock_guard lock(mMutex);
 
     while (mKeepRunning) {
-        mConditionVariable.wait(mMutex);
+        // Frames which asked for their callbacks while the previous ones were being sent are
+        // handled by a single pass, so a listener which fell behind gets one callback for all of
+        // its completed transactions rather than one per frame, and no request is missed.
+        while (!mCallbacksPending && mKeepRunning) {
+            mConditionVariable.wait(mMutex);
+        }
+        mCallbacksPending = false;
         std::vector<ListenerStats> completedListenerStats;
 
         // For each listener
@@ -332,11 +339,10 @@ void TransactionCompletedThread::threadMain() {
                     completedTransactionsItr =
                             mCompletedTransactions.erase(completedTransactionsItr);
                 }
+                completedListenerStats.push_back(std::move(listenerStats));
             } else {
                 completedTransactionsItr++;
             }
-
-            completedListenerStats.push_back(std::move(listenerStats));
         }
 
         if (mPresentFence) {
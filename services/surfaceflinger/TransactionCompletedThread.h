@@ -128,6 +128,8 @@ private:
 
     bool mRunning GUARDED_BY(mMutex) = false;
     bool mKeepRunning GUARDED_BY(mMutex) = true;
+    // Set by sendCallbacks, cleared by the thread once it starts sending them.
+    bool mCallbacksPending GUARDED_BY(mMutex) = false;
 
     sp<Fence> mPresentFence GUARDED_BY(mMutex);
 };
@@ -0,0 +1,366 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <benchmark/benchmark.h>
+
+#include <gui/ISurfaceComposerClient.h>
+#include <gui/Surface.h>
+#include <gui/SurfaceComposerClient.h>
+#include <timestatsproto/TimeStatsProtoHeader.h>
+#include <ui/DisplayConfig.h>
+#include <ui/Fence.h>
+#include <ui/GraphicBuffer.h>
+#include <utils/String8.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace android {
+namespace {
+
+using namespace std::chrono_literals;
+using Transaction = SurfaceComposerClient::Transaction;
+using surfaceflinger::SFTimeStatsGlobalProto;
+using surfaceflinger::SFTimeStatsHistogramBucketProto;
+
+// Keep the benchmark layers above everything else on the display.
+constexpr int32_t kLayerZBase = INT32_MAX - 256;
+constexpr size_t kBuffersPerLayer = 3;
+constexpr int kPresentTimeoutMs = 1000;
+
+struct Scenario {
+    // Whether the layers are BufferStateLayers fed through transactions, rather than
+    // BufferQueueLayers fed through their Surface.
+    bool blast = false;
+
+    // Rounded corners and shadows make SurfaceFlinger compose the layer with RenderEngine. If
+    // everyOtherLayer is set they are only applied to odd layers, so that the frame mixes device
+    // and client composition.
+    float cornerRadius = 0.f;
+    float shadowRadius = 0.f;
+    bool everyOtherLayer = false;
+
+    // Disables HWC, so that every layer is client composited.
+    bool disableHwc = false;
+};
+
+// Mean of a TimeStats histogram, whose buckets are 1ms wide at the low end.
+double histogramMeanMs(const google::protobuf::RepeatedPtrField<SFTimeStatsHistogramBucketProto>&
+                               histogram) {
+    int64_t totalMs = 0;
+    int64_t frames = 0;
+    for (const auto& bucket : histogram) {
+        totalMs += static_cast<int64_t>(bucket.time_millis()) * bucket.frame_count();
+        frames += bucket.frame_count();
+    }
+    return frames == 0 ? 0.0 : static_cast<double>(totalMs) / static_cast<double>(frames);
+}
+
+bool dumpTimeStats(SFTimeStatsGlobalProto* outProto) {
+    FILE* pipe = popen("dumpsys SurfaceFlinger --timestats -dump --proto", "r");
+    if (pipe == nullptr) {
+        return false;
+    }
+    std::string output;
+    char buffer[4096];
+    size_t size;
+    while ((size = fread(buffer, 1, sizeof(buffer), pipe)) > 0) {
+        output.append(buffer, size);
+    }
+    pclose(pipe);
+    return outProto->ParseFromString(output);
+}
+
+class PresentCallback {
+public:
+    static void function(void* context, nsecs_t /*latchTime*/, const sp<Fence>& presentFence,
+                         const std::vector<SurfaceControlStats>& /*stats*/) {
+        auto* callback = static_cast<PresentCallback*>(context);
+        std::lock_guard lock(callback->mMutex);
+        callback->mPresentFence = presentFence;
+        callback->mCompleted = true;
+        callback->mCondition.notify_all();
+    }
+
+    // Returns the present time of the last transaction, or -1 if it was not presented.
+    nsecs_t waitForPresent() {
+        sp<Fence> presentFence;
+        {
+            std::unique_lock lock(mMutex);
+            if (!mCondition.wait_for(lock, std::chrono::milliseconds(kPresentTimeoutMs),
+                                     [this] { return mCompleted; })) {
+                return -1;
+            }
+            mCompleted = false;
+            presentFence = std::move(mPresentFence);
+        }
+        if (presentFence == nullptr ||
+            presentFence->wait(kPresentTimeoutMs) != NO_ERROR) {
+            return -1;
+        }
+        return presentFence->getSignalTime();
+    }
+
+private:
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    bool mCompleted = false;
+    sp<Fence> mPresentFence;
+};
+
+class CompositionScene {
+public:
+    CompositionScene(const Scenario& scenario, size_t layerCount) : mScenario(scenario) {
+        mClient = new SurfaceComposerClient;
+        if (mClient->initCheck() != NO_ERROR) {
+            return;
+        }
+        const auto display = SurfaceComposerClient::getInternalDisplayToken();
+        DisplayConfig config;
+        if (display == nullptr ||
+            SurfaceComposerClient::getActiveDisplayConfig(display, &config) != NO_ERROR) {
+            return;
+        }
+        mVsyncPeriod = static_cast<nsecs_t>(1e9f / config.refreshRate);
+
+        // Tile half-display sized layers so that they overlap, and keep them translucent so that
+        // none of them are occluded.
+        const int32_t width = config.resolution.getWidth() / 2;
+        const int32_t height = config.resolution.getHeight() / 2;
+        Transaction t;
+        for (size_t i = 0; i < layerCount; i++) {
+            const uint32_t flags = scenario.blast ? ISurfaceComposerClient::eFXSurfaceBufferState
+                                                  : ISurfaceComposerClient::eFXSurfaceBufferQueue;
+            auto layer = mClient->createSurface(String8::format("Benchmark%zu", i),
+                                                static_cast<uint32_t>(width),
+                                                static_cast<uint32_t>(height),
+                                                PIXEL_FORMAT_RGBA_8888, flags);
+            if (layer == nullptr) {
+                return;
+            }
+
+            const float x = static_cast<float>(static_cast<int32_t>(i % 3) * width / 2);
+            const float y = static_cast<float>(static_cast<int32_t>(i / 3 % 3) * height / 2);
+            t.setLayerStack(layer, 0)
+                    .setLayer(layer, kLayerZBase + static_cast<int32_t>(i))
+                    .setPosition(layer, x, y)
+                    .show(layer);
+            if (scenario.blast) {
+                t.setFrame(layer, Rect(width, height)).setCrop(layer, Rect(width, height));
+            } else {
+                t.setCrop_legacy(layer, Rect(width, height));
+            }
+            if (!scenario.everyOtherLayer || i % 2 == 1) {
+                t.setCornerRadius(layer, scenario.cornerRadius)
+                        .setShadowRadius(layer, scenario.shadowRadius);
+            }
+
+            if (scenario.blast) {
+                std::vector<sp<GraphicBuffer>> buffers;
+                for (size_t b = 0; b < kBuffersPerLayer; b++) {
+                    buffers.push_back(allocateBuffer(width, height, static_cast<uint8_t>(i * 16)));
+                }
+                mBuffers.push_back(std::move(buffers));
+            } else {
+                layer->getSurface()->enableFrameTimestamps(true);
+            }
+            mLayers.push_back(std::move(layer));
+        }
+        if (t.apply(true) != NO_ERROR) {
+            mLayers.clear();
+        }
+    }
+
+    ~CompositionScene() {
+        Transaction t;
+        for (const auto& layer : mLayers) {
+            t.reparent(layer, nullptr);
+        }
+        t.apply(true);
+    }
+
+    bool isValid() const { return !mLayers.empty(); }
+    nsecs_t getVsyncPeriod() const { return mVsyncPeriod; }
+
+    // Posts a new buffer to every layer and waits for the frame to be presented. Returns the
+    // latency from posting to present, or -1 if the frame was not presented.
+    nsecs_t postFrame() {
+        return mScenario.blast ? postBlastFrame() : postBufferQueueFrame();
+    }
+
+private:
+    static sp<GraphicBuffer> allocateBuffer(int32_t width, int32_t height, uint8_t value) {
+        sp<GraphicBuffer> buffer =
+                new GraphicBuffer(static_cast<uint32_t>(width), static_cast<uint32_t>(height),
+                                  PIXEL_FORMAT_RGBA_8888, 1,
+                                  GraphicBuffer::USAGE_HW_TEXTURE |
+                                          GraphicBuffer::USAGE_HW_COMPOSER |
+                                          GraphicBuffer::USAGE_SW_WRITE_OFTEN,
+                                  "CompositionBenchmark");
+        void* bits = nullptr;
+        if (buffer->initCheck() == NO_ERROR &&
+            buffer->lock(GraphicBuffer::USAGE_SW_WRITE_OFTEN, &bits) == NO_ERROR) {
+            memset(bits, value, buffer->getStride() * buffer->getHeight() * 4);
+            buffer->unlock();
+        }
+        return buffer;
+    }
+
+    nsecs_t postBlastFrame() {
+        Transaction t;
+        for (size_t i = 0; i < mLayers.size(); i++) {
+            t.setBuffer(mLayers[i], mBuffers[i][mFrame % kBuffersPerLayer]);
+        }
+        t.addTransactionCompletedCallback(PresentCallback::function, &mPresentCallback);
+        mFrame++;
+
+        const nsecs_t postTime = systemTime();
+        t.apply();
+        const nsecs_t presentTime = mPresentCallback.waitForPresent();
+        return presentTime < 0 ? -1 : presentTime - postTime;
+    }
+
+    nsecs_t postBufferQueueFrame() {
+        uint64_t frameNumber = 0;
+        nsecs_t postTime = 0;
+        for (const auto& layer : mLayers) {
+            sp<Surface> surface = layer->getSurface();
+            ANativeWindow_Buffer buffer;
+            if (surface->lock(&buffer, nullptr) != NO_ERROR) {
+                return -1;
+            }
+            frameNumber = surface->getNextFrameNumber();
+            postTime = systemTime();
+            surface->unlockAndPost();
+        }
+
+        // Every layer is latched in the same frame, so wait on the last one posted.
+        const sp<Surface> surface = mLayers.back()->getSurface();
+        const nsecs_t deadline = postTime + ms2ns(kPresentTimeoutMs);
+        while (systemTime() < deadline) {
+            nsecs_t presentTime = FrameEvents::TIMESTAMP_PENDING;
+            if (surface->getFrameTimestamps(frameNumber, nullptr, nullptr, nullptr, nullptr,
+                                            nullptr, nullptr, &presentTime, nullptr,
+                                            nullptr) != NO_ERROR ||
+                presentTime == NATIVE_WINDOW_TIMESTAMP_INVALID) {
+                return -1;
+            }
+            if (presentTime != FrameEvents::TIMESTAMP_PENDING) {
+                return presentTime - postTime;
+            }
+            std::this_thread::sleep_for(1ms);
+        }
+        return -1;
+    }
+
+    const Scenario mScenario;
+    sp<SurfaceComposerClient> mClient;
+    nsecs_t mVsyncPeriod = 0;
+    std::vector<sp<SurfaceControl>> mLayers;
+    std::vector<std::vector<sp<GraphicBuffer>>> mBuffers;
+    size_t mFrame = 0;
+    PresentCallback mPresentCallback;
+};
+
+// Composes range(0) layers each frame, and reports SurfaceFlinger's CPU time per frame
+// (onMessageRefresh), RenderEngine's GPU time for client composited frames, and the latency
+// from posting the buffers to present. The CPU and GPU times come from TimeStats, so they have a
+// resolution of 1ms.
+void BM_composition(benchmark::State& state, Scenario scenario) {
+    if (scenario.disableHwc) {
+        system("service call SurfaceFlinger 1008 i32 1 > /dev/null");
+    }
+
+    {
+        CompositionScene scene(scenario, static_cast<size_t>(state.range(0)));
+        if (!scene.isValid()) {
+            state.SkipWithError("Could not set up the layers");
+        } else {
+            // Let the layers settle before measuring.
+            for (int i = 0; i < 3; i++) {
+                scene.postFrame();
+            }
+            system("dumpsys SurfaceFlinger --timestats -enable -clear > /dev/null");
+
+            nsecs_t totalLatency = 0;
+            int64_t presentedFrames = 0;
+            int64_t missedFrames = 0;
+            for (auto _ : state) {
+                const nsecs_t latency = scene.postFrame();
+                if (latency < 0) {
+                    missedFrames++;
+                    continue;
+                }
+                totalLatency += latency;
+                presentedFrames++;
+                // A frame posted right after a vsync is latched on the next one and presented
+                // on the one after, so anything slower missed its vsync.
+                if (latency > 2 * scene.getVsyncPeriod()) {
+                    missedFrames++;
+                }
+            }
+
+            SFTimeStatsGlobalProto timeStats;
+            if (dumpTimeStats(&timeStats)) {
+                state.counters["sf_cpu_ms"] = histogramMeanMs(timeStats.frame_duration());
+                state.counters["re_gpu_ms"] = histogramMeanMs(timeStats.render_engine_timing());
+                state.counters["client_frames"] =
+                        static_cast<double>(timeStats.client_composition_frames());
+            }
+            system("dumpsys SurfaceFlinger --timestats -disable > /dev/null");
+
+            if (presentedFrames > 0) {
+                state.counters["present_latency_ms"] = static_cast<double>(totalLatency) / 1e6 /
+                        static_cast<double>(presentedFrames);
+            }
+            state.counters["missed_frames"] = static_cast<double>(missedFrames);
+        }
+    }
+
+    if (scenario.disableHwc) {
+        system("service call SurfaceFlinger 1008 i32 0 > /dev/null");
+    }
+}
+
+void layerCounts(benchmark::internal::Benchmark* b) {
+    b->Arg(1)->Arg(4)->Arg(16)->Unit(benchmark::kMillisecond)->UseRealTime();
+}
+
+BENCHMARK_CAPTURE(BM_composition, bufferqueue, Scenario{})->Apply(layerCounts);
+BENCHMARK_CAPTURE(BM_composition, blast, Scenario{.blast = true})->Apply(layerCounts);
+BENCHMARK_CAPTURE(BM_composition, rounded_corners, Scenario{.blast = true, .cornerRadius = 32.f})
+        ->Apply(layerCounts);
+BENCHMARK_CAPTURE(BM_composition, shadows, Scenario{.blast = true, .shadowRadius = 16.f})
+        ->Apply(layerCounts);
+BENCHMARK_CAPTURE(BM_composition, mixed,
+                  Scenario{.blast = true,
+                           .cornerRadius = 32.f,
+                           .shadowRadius = 16.f,
+                           .everyOtherLayer = true})
+        ->Apply(layerCounts);
+BENCHMARK_CAPTURE(BM_composition, client, Scenario{.blast = true, .disableHwc = true})
+        ->Apply(layerCounts);
+
+} // namespace
+} // namespace android
+
+BENCHMARK_MAIN();
@@ -31,6 +31,7 @@ using namespace std::placeholders;
 
 using testing::_;
 using testing::Invoke;
+using testing::Return;
 
 namespace android {
 
@@ -39,6 +40,9 @@ namespace {
 constexpr PhysicalDisplayId INTERNAL_DISPLAY_ID = 111;
 constexpr PhysicalDisplayId EXTERNAL_DISPLAY_ID = 222;
 constexpr PhysicalDisplayId DISPLAY_ID_64BIT = 0xabcd12349876fedcULL;
+constexpr uid_t CONNECTION_UID = 10001;
+constexpr uid_t OTHER_UID = 10002;
+constexpr nsecs_t VSYNC_PERIOD = 16'666'667;
 
 class MockVSyncSource : public VSyncSource {
 public:
@@ -47,6 +51,7 @@ public:
     MOCK_METHOD1(setVSyncEnabled, void(bool));
     MOCK_METHOD1(setCallback, void(VSyncSource::Callback*));
     MOCK_METHOD1(setPhaseOffset, void(nsecs_t));
+    MOCK_CONST_METHOD0(getVSyncPeriod, nsecs_t());
     MOCK_METHOD1(pauseVsyncCallback, void(bool));
     MOCK_CONST_METHOD1(dump, void(std::string&));
 };
@@ -57,9 +62,11 @@ class EventThreadTest : public testing::Test {
 protected:
     class MockEventThreadConnection : public EventThreadConnection {
     public:
-        MockEventThreadConnection(impl::EventThread* eventThread, ResyncCallback&& resyncCallback,
+        MockEventThreadConnection(impl::EventThread* eventThread, uid_t callingUid,
+                                  ResyncCallback&& resyncCallback,
                                   ISurfaceComposer::ConfigChanged configChanged)
-              : EventThreadConnection(eventThread, std::move(resyncCallback), configChanged) {}
+              : EventThreadConnection(eventThread, callingUid, std::move(resyncCallback),
+                                      configChanged) {}
         MOCK_METHOD1(postEvent, status_t(const DisplayEventReceiver::Event& event));
     };
 
@@ -71,7 +78,8 @@ protected:
 
     void createThread(std::unique_ptr<VSyncSource>);
     sp<MockEventThreadConnection> createConnection(ConnectionEventRecorder& recorder,
-                                                   ISurfaceComposer::ConfigChanged configChanged);
+                                                   ISurfaceComposer::ConfigChanged configChanged,
+                                                   uid_t ownerUid = CONNECTION_UID);
 
     void expectVSyncSetEnabledCallReceived(bool expectedState);
     void expectVSyncSetPhaseOffsetCallReceived(nsecs_t expectedPhaseOffset);
@@ -117,6 +125,8 @@ EventThreadTest::EventThreadTest() {
     EXPECT_CALL(*mVSyncSource, setPhaseOffset(_))
             .WillRepeatedly(Invoke(mVSyncSetPhaseOffsetCallRecorder.getInvocable()));
 
+    EXPECT_CALL(*mVSyncSource, getVSyncPeriod()).WillRepeatedly(Return(VSYNC_PERIOD));
+
     createThread(std::move(vsyncSource));
     mConnection = createConnection(mConnectionEventCallRecorder,
                                    ISurfaceComposer::eConfigChangedDispatch);
@@ -145,10 +155,11 @@ void EventThreadTest::createThread(std::unique_ptr<VSyncSource> source) {
 }
 
 sp<EventThreadTest::MockEventThreadConnection> EventThreadTest::createConnection(
-        ConnectionEventRecorder& recorder, ISurfaceComposer::ConfigChanged configChanged) {
+        ConnectionEventRecorder& recorder, ISurfaceComposer::ConfigChanged configChanged,
+        uid_t ownerUid) {
     sp<MockEventThreadConnection> connection =
-            new MockEventThreadConnection(mThread.get(), mResyncCallRecorder.getInvocable(),
-                                          configChanged);
+            new MockEventThreadConnection(mThread.get(), ownerUid,
+                                          mResyncCallRecorder.getInvocable(), configChanged);
     EXPECT_CALL(*connection, postEvent(_)).WillRepeatedly(Invoke(recorder.getInvocable()));
     return connection;
 }
@@ -329,6 +340,26 @@ TEST_F(EventThreadTest, setVsyncRateOnePostsAllEventsToThatConnection) {
     expectVsyncEventReceivedByConnection(789, 3u);
 }
 
+TEST_F(EventThreadTest, vsyncEventsHaveIncreasingIdsAndDeadlines) {
+    mThread->setVsyncRate(1, mConnection);
+    expectVSyncSetEnabledCallReceived(true);
+
+    mCallback->onVSyncEvent(123, 456);
+    auto args = mConnectionEventCallRecorder.waitForCall();
+    ASSERT_TRUE(args.has_value());
+    const auto first = std::get<0>(args.value());
+    EXPECT_NE(DisplayEventReceiver::INVALID_VSYNC_ID, first.vsync.vsyncId);
+    EXPECT_EQ(456, first.vsync.expectedVSyncTimestamp);
+    EXPECT_EQ(123 + VSYNC_PERIOD, first.vsync.deadlineTimestamp);
+
+    mCallback->onVSyncEvent(789, 1011);
+    args = mConnectionEventCallRecorder.waitForCall();
+    ASSERT_TRUE(args.has_value());
+    const auto second = std::get<0>(args.value());
+    EXPECT_EQ(first.vsync.vsyncId + 1, second.vsync.vsyncId);
+    EXPECT_EQ(789 + VSYNC_PERIOD, second.vsync.deadlineTimestamp);
+}
+
 TEST_F(EventThreadTest, setVsyncRateTwoPostsEveryOtherEventToThatConnection) {
     mThread->setVsyncRate(2, mConnection);
 
@@ -356,6 +387,69 @@ TEST_F(EventThreadTest, setVsyncRateTwoPostsEveryOtherEventToThatConnection) {
     expectVsyncEventReceivedByConnection(101112, 4u);
 }
 
+TEST_F(EventThreadTest, frameRateDivisorThrottlesOnlyConnectionsOfThatUid) {
+    ConnectionEventRecorder otherConnectionEventRecorder{0};
+    sp<MockEventThreadConnection> otherConnection =
+            createConnection(otherConnectionEventRecorder,
+                             ISurfaceComposer::eConfigChangedSuppress, OTHER_UID);
+
+    mThread->setFrameRateDivisors({{CONNECTION_UID, 2}});
+    mThread->setVsyncRate(1, mConnection);
+    mThread->setVsyncRate(1, otherConnection);
+
+    // EventThread should enable vsync callbacks.
+    expectVSyncSetEnabledCallReceived(true);
+
+    // The first event is only delivered to the unthrottled connection.
+    mCallback->onVSyncEvent(123, 456);
+    expectInterceptCallReceived(123);
+    EXPECT_FALSE(mConnectionEventCallRecorder.waitForUnexpectedCall().has_value());
+    expectVsyncEventReceivedByConnection("otherConnection", otherConnectionEventRecorder, 123,
+                                         1u);
+
+    // The second event is in phase with the divisor, so both connections receive it.
+    mCallback->onVSyncEvent(456, 123);
+    expectInterceptCallReceived(456);
+    expectVsyncEventReceivedByConnection(456, 2u);
+    expectVsyncEventReceivedByConnection("otherConnection", otherConnectionEventRecorder, 456,
+                                         2u);
+
+    // Clearing the divisors delivers every event again.
+    mThread->setFrameRateDivisors({});
+    mCallback->onVSyncEvent(789, 777);
+    expectInterceptCallReceived(789);
+    expectVsyncEventReceivedByConnection(789, 3u);
+    expectVsyncEventReceivedByConnection("otherConnection", otherConnectionEventRecorder, 789,
+                                         3u);
+}
+
+TEST_F(EventThreadTest, frameRateDivisorDefersRequestNextVsyncToAlignedEvent) {
+    mThread->setFrameRateDivisors({{CONNECTION_UID, 2}});
+    mThread->requestNextVsync(mConnection);
+
+    // EventThread should immediately request a resync.
+    EXPECT_TRUE(mResyncCallRecorder.waitForCall().has_value());
+
+    // EventThread should enable vsync callbacks.
+    expectVSyncSetEnabledCallReceived(true);
+
+    // The first event is out of phase, so the request stays pending.
+    mCallback->onVSyncEvent(123, 456);
+    expectInterceptCallReceived(123);
+    EXPECT_FALSE(mConnectionEventCallRecorder.waitForUnexpectedCall().has_value());
+
+    // The second event satisfies the request.
+    mCallback->onVSyncEvent(456, 123);
+    expectInterceptCallReceived(456);
+    expectVsyncEventReceivedByConnection(456, 2u);
+
+    // No further events are delivered, and vsync callbacks are disabled.
+    mCallback->onVSyncEvent(789, 777);
+    expectInterceptCallReceived(789);
+    EXPECT_FALSE(mConnectionEventCallRecorder.waitForUnexpectedCall().has_value());
+    expectVSyncSetEnabledCallReceived(false);
+}
+
 TEST_F(EventThreadTest, connectionsRemovedIfInstanceDestroyed) {
     mThread->setVsyncRate(1, mConnection);
 
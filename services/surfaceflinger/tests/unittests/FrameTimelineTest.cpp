@@ -0,0 +1,218 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#undef LOG_TAG
+#define LOG_TAG "LibSurfaceFlingerUnittests"
+
+#include "FrameTimeline/FrameTimeline.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "mock/MockTimeStats.h"
+
+using namespace std::chrono_literals;
+using namespace testing;
+
+namespace android::frametimeline {
+namespace {
+
+constexpr int32_t kLayerId = 1;
+constexpr uid_t kUid = 10001;
+const std::string kLayerName = "com.example.app#0";
+
+constexpr nsecs_t kPeriod = std::chrono::nanoseconds(16ms).count();
+constexpr nsecs_t kFirstStart = std::chrono::nanoseconds(1s).count();
+
+class FrameTimelineTest : public testing::Test {
+protected:
+    static nsecs_t expectedStart(int frame) { return kFirstStart + frame * kPeriod; }
+    static nsecs_t expectedPresent(int frame) { return expectedStart(frame) + kPeriod; }
+
+    int64_t wakeUp(int frame, nsecs_t lateness = 0) {
+        return mFrameTimeline.onSfWakeUp(expectedStart(frame), expectedPresent(frame),
+                                         expectedStart(frame) + lateness);
+    }
+
+    void present(int frame, nsecs_t presentLateness, nsecs_t cpuEnd = ms2ns(4),
+                 nsecs_t gpuEnd = -1) {
+        mFrameTimeline.setSfPresent(expectedStart(frame) + cpuEnd,
+                                    gpuEnd < 0 ? FenceTime::NO_FENCE
+                                               : std::make_shared<FenceTime>(
+                                                         expectedStart(frame) + gpuEnd),
+                                    std::make_shared<FenceTime>(expectedPresent(frame) +
+                                                                presentLateness));
+    }
+
+    void queueBuffer(uint64_t frameNumber, nsecs_t postTime, nsecs_t readyTime = -1) {
+        mFrameTimeline.onBufferQueued(kLayerId, kUid, kLayerName, frameNumber, postTime, 0,
+                                      readyTime < 0 ? FenceTime::NO_FENCE
+                                                    : std::make_shared<FenceTime>(readyTime));
+    }
+
+    FrameTimeline::DisplayFrame displayFrame(int64_t vsyncId) const {
+        for (const auto& frame : mFrameTimeline.getDisplayFrames()) {
+            if (frame.vsyncId == vsyncId) return frame;
+        }
+        ADD_FAILURE() << "No display frame with vsyncId " << vsyncId;
+        return {};
+    }
+
+    std::shared_ptr<NiceMock<mock::TimeStats>> mTimeStats =
+            std::make_shared<NiceMock<mock::TimeStats>>();
+    FrameTimeline mFrameTimeline{mTimeStats};
+};
+
+TEST_F(FrameTimelineTest, onTimeFramesAreNotJanky) {
+    EXPECT_CALL(*mTimeStats, incrementJankyFrames(JankType::None)).Times(1);
+    EXPECT_CALL(*mTimeStats, incrementJankyFrames(kLayerName, JankType::None)).Times(1);
+
+    queueBuffer(1, expectedStart(0) - ms2ns(2));
+    const int64_t vsyncId = wakeUp(0);
+    mFrameTimeline.onBufferLatched(kLayerId, 1);
+    present(0, 0);
+
+    const auto frame = displayFrame(vsyncId);
+    EXPECT_TRUE(frame.classified);
+    EXPECT_EQ(JankType::None, frame.jankType);
+    ASSERT_EQ(1u, frame.surfaceFrames.size());
+    EXPECT_EQ(vsyncId, frame.surfaceFrames[0].expectedVsyncId);
+    EXPECT_EQ(JankType::None, frame.surfaceFrames[0].jankType);
+}
+
+TEST_F(FrameTimelineTest, latePresentIsAttributedToStage) {
+    // Late CPU work.
+    const int64_t cpuFrame = wakeUp(0);
+    present(0, ms2ns(8), /*cpuEnd=*/kPeriod + ms2ns(1));
+    // Late wakeup.
+    const int64_t wakeupFrame = wakeUp(1, ms2ns(5));
+    present(1, ms2ns(8));
+    // Late client composition.
+    const int64_t gpuFrame = wakeUp(2);
+    present(2, ms2ns(8), ms2ns(4), /*gpuEnd=*/kPeriod + ms2ns(3));
+    // SurfaceFlinger on time, present late anyway.
+    const int64_t halFrame = wakeUp(3);
+    present(3, ms2ns(8), ms2ns(4), /*gpuEnd=*/ms2ns(8));
+    // Present within the threshold.
+    const int64_t onTimeFrame = wakeUp(4);
+    present(4, ms2ns(1));
+    wakeUp(5);
+    present(5, 0);
+
+    EXPECT_EQ(JankType::SurfaceFlingerCpuDeadlineMissed, displayFrame(cpuFrame).jankType);
+    EXPECT_EQ(JankType::SurfaceFlingerCpuDeadlineMissed, displayFrame(wakeupFrame).jankType);
+    EXPECT_EQ(JankType::SurfaceFlingerGpuDeadlineMissed, displayFrame(gpuFrame).jankType);
+    EXPECT_EQ(JankType::DisplayHal, displayFrame(halFrame).jankType);
+    EXPECT_EQ(JankType::None, displayFrame(onTimeFrame).jankType);
+}
+
+TEST_F(FrameTimelineTest, bufferReadyLateIsAppDeadlineMissed) {
+    EXPECT_CALL(*mTimeStats, incrementJankyFrames(kLayerName, JankType::AppDeadlineMissed))
+            .Times(1);
+
+    // Queued in time for frame 0, but rendering finished after SurfaceFlinger woke up.
+    queueBuffer(1, expectedStart(0) - ms2ns(4), expectedStart(0) + ms2ns(3));
+    const int64_t expectedVsyncId = wakeUp(0);
+    present(0, 0);
+    const int64_t vsyncId = wakeUp(1);
+    mFrameTimeline.onBufferLatched(kLayerId, 1);
+    present(1, 0);
+    wakeUp(2);
+    present(2, 0);
+
+    const auto frame = displayFrame(vsyncId);
+    EXPECT_EQ(JankType::None, frame.jankType);
+    ASSERT_EQ(1u, frame.surfaceFrames.size());
+    EXPECT_EQ(expectedVsyncId, frame.surfaceFrames[0].expectedVsyncId);
+    EXPECT_EQ(JankType::AppDeadlineMissed, frame.surfaceFrames[0].jankType);
+}
+
+TEST_F(FrameTimelineTest, bufferQueuedBehindAnotherIsBufferStuffing) {
+    queueBuffer(1, expectedStart(0) - ms2ns(6));
+    queueBuffer(2, expectedStart(0) - ms2ns(2));
+    wakeUp(0);
+    mFrameTimeline.onBufferLatched(kLayerId, 1);
+    present(0, 0);
+    const int64_t vsyncId = wakeUp(1);
+    mFrameTimeline.onBufferLatched(kLayerId, 2);
+    present(1, 0);
+    wakeUp(2);
+    present(2, 0);
+
+    const auto frame = displayFrame(vsyncId);
+    ASSERT_EQ(1u, frame.surfaceFrames.size());
+    EXPECT_EQ(JankType::BufferStuffing, frame.surfaceFrames[0].jankType);
+}
+
+TEST_F(FrameTimelineTest, surfaceFrameInheritsDisplayJank) {
+    queueBuffer(1, expectedStart(0) - ms2ns(2));
+    const int64_t vsyncId = wakeUp(0);
+    mFrameTimeline.onBufferLatched(kLayerId, 1);
+    present(0, ms2ns(8));
+    wakeUp(1);
+    present(1, 0);
+
+    const auto frame = displayFrame(vsyncId);
+    EXPECT_EQ(JankType::DisplayHal, frame.jankType);
+    ASSERT_EQ(1u, frame.surfaceFrames.size());
+    EXPECT_EQ(JankType::DisplayHal, frame.surfaceFrames[0].jankType);
+}
+
+TEST_F(FrameTimelineTest, droppedBuffersAreForgotten) {
+    queueBuffer(1, expectedStart(0) - ms2ns(6));
+    queueBuffer(2, expectedStart(0) - ms2ns(2));
+    const int64_t vsyncId = wakeUp(0);
+    mFrameTimeline.onBufferLatched(kLayerId, 2);
+    present(0, 0);
+    wakeUp(1);
+    mFrameTimeline.onBufferLatched(kLayerId, 1);
+    present(1, 0);
+
+    const auto frame = displayFrame(vsyncId);
+    ASSERT_EQ(1u, frame.surfaceFrames.size());
+    EXPECT_EQ(2u, frame.surfaceFrames[0].frameNumber);
+    EXPECT_TRUE(displayFrame(vsyncId + 1).surfaceFrames.empty());
+}
+
+TEST_F(FrameTimelineTest, waitsForPresentFence) {
+    FenceToFenceTimeMap fenceMap;
+    const sp<Fence> fence = new Fence();
+    const int64_t vsyncId = wakeUp(0);
+    mFrameTimeline.setSfPresent(expectedStart(0) + ms2ns(4), FenceTime::NO_FENCE,
+                                fenceMap.createFenceTimeForTest(fence));
+    wakeUp(1);
+    present(1, 0);
+    EXPECT_FALSE(displayFrame(vsyncId).classified);
+    // Later frames are not classified ahead of the pending one.
+    EXPECT_FALSE(displayFrame(vsyncId + 1).classified);
+
+    fenceMap.signalAllForTest(fence, expectedPresent(0) + ms2ns(8));
+    wakeUp(2);
+    present(2, 0);
+    EXPECT_TRUE(displayFrame(vsyncId).classified);
+    EXPECT_EQ(JankType::DisplayHal, displayFrame(vsyncId).jankType);
+    EXPECT_TRUE(displayFrame(vsyncId + 1).classified);
+}
+
+TEST(FrameTimelineJankTypeTest, bitmaskToString) {
+    EXPECT_EQ("None", jankTypeBitmaskToString(JankType::None));
+    EXPECT_EQ("App Deadline Missed, Display HAL",
+              jankTypeBitmaskToString(JankType::AppDeadlineMissed | JankType::DisplayHal));
+}
+
+} // namespace
+} // namespace android::frametimeline
@@ -171,5 +171,39 @@ TEST_F(HWComposerLayerGenericMetadataTest, forwardsSupportedMetadata) {
     EXPECT_EQ(hal::Error::UNSUPPORTED, result);
 }
 
+struct HWComposerLayerStateCacheTest : public HWComposerLayerTest {
+    HWComposerLayerStateCacheTest() : HWComposerLayerTest({}) {}
+};
+
+TEST_F(HWComposerLayerStateCacheTest, skipsUnchangedState) {
+    const Rect frame(0, 0, 100, 100);
+    EXPECT_CALL(*mHal, setLayerDisplayFrame(kDisplayId, kLayerId, _))
+            .WillOnce(Return(hardware::graphics::composer::V2_4::Error::NONE));
+    EXPECT_CALL(*mHal, setLayerZOrder(kDisplayId, kLayerId, 1u))
+            .WillOnce(Return(hardware::graphics::composer::V2_4::Error::NONE));
+    EXPECT_CALL(*mHal, setLayerPlaneAlpha(kDisplayId, kLayerId, 0.5f))
+            .WillOnce(Return(hardware::graphics::composer::V2_4::Error::NONE));
+
+    for (int i = 0; i < 3; i++) {
+        EXPECT_EQ(hal::Error::NONE, mLayer.setDisplayFrame(frame));
+        EXPECT_EQ(hal::Error::NONE, mLayer.setZOrder(1u));
+        EXPECT_EQ(hal::Error::NONE, mLayer.setPlaneAlpha(0.5f));
+    }
+
+    EXPECT_CALL(*mHal, setLayerZOrder(kDisplayId, kLayerId, 2u))
+            .WillOnce(Return(hardware::graphics::composer::V2_4::Error::NONE));
+    EXPECT_EQ(hal::Error::NONE, mLayer.setZOrder(2u));
+}
+
+TEST_F(HWComposerLayerStateCacheTest, resendsStateAfterError) {
+    EXPECT_CALL(*mHal, setLayerZOrder(kDisplayId, kLayerId, 1u))
+            .WillOnce(Return(hardware::graphics::composer::V2_4::Error::BAD_LAYER))
+            .WillOnce(Return(hardware::graphics::composer::V2_4::Error::NONE));
+
+    EXPECT_EQ(hal::Error::BAD_LAYER, mLayer.setZOrder(1u));
+    EXPECT_EQ(hal::Error::NONE, mLayer.setZOrder(1u));
+    EXPECT_EQ(hal::Error::NONE, mLayer.setZOrder(1u));
+}
+
 } // namespace
 } // namespace android
@@ -0,0 +1,69 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "LibSurfaceFlingerUnittests"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "DisplayHardware/HwcControlThread.h"
+
+namespace android {
+namespace {
+
+TEST(HwcControlThreadTest, isNotStartedUntilStartIsCalled) {
+    HwcControlThread thread;
+    EXPECT_FALSE(thread.isStarted());
+
+    thread.start();
+    EXPECT_TRUE(thread.isStarted());
+}
+
+TEST(HwcControlThreadTest, runsTasksInOrderOffTheCallingThread) {
+    HwcControlThread thread;
+    thread.start();
+
+    std::vector<int> order;
+    std::thread::id taskThreadId;
+    for (int i = 0; i < 3; i++) {
+        thread.post([&order, &taskThreadId, i]() {
+            order.push_back(i);
+            taskThreadId = std::this_thread::get_id();
+        });
+    }
+    thread.waitForIdle();
+
+    EXPECT_EQ((std::vector<int>{0, 1, 2}), order);
+    EXPECT_NE(std::this_thread::get_id(), taskThreadId);
+}
+
+TEST(HwcControlThreadTest, runsPendingTasksBeforeExiting) {
+    bool ran = false;
+    {
+        HwcControlThread thread;
+        thread.start();
+        thread.post([]() { std::this_thread::sleep_for(std::chrono::milliseconds(10)); });
+        thread.post([&ran]() { ran = true; });
+    }
+    EXPECT_TRUE(ran);
+}
+
+} // namespace
+} // namespace android
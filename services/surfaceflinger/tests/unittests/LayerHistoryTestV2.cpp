@@ -41,6 +41,7 @@ protected:
     static constexpr auto PRESENT_TIME_HISTORY_DURATION = LayerInfoV2::HISTORY_DURATION;
     static constexpr auto REFRESH_RATE_AVERAGE_HISTORY_DURATION =
             LayerInfoV2::RefreshRateHistory::HISTORY_DURATION;
+    static constexpr auto CADENCE_WINDOW_SIZE = LayerInfoV2::CADENCE_WINDOW_SIZE;
 
     static constexpr float LO_FPS = 30.f;
     static constexpr auto LO_FPS_PERIOD = static_cast<nsecs_t>(1e9f / LO_FPS);
@@ -671,6 +672,72 @@ TEST_F(LayerHistoryTestV2, heuristicLayerNotOscillating) {
     recordFramesAndExpect(layer, time, 27.10f, 30.0f, PRESENT_TIME_HISTORY_SIZE);
 }
 
+TEST_F(LayerHistoryTestV2, videoCadenceVotesBeforeHeuristicHasEnoughData) {
+    const auto layer = createLayer();
+    EXPECT_CALL(*layer, isVisible()).WillRepeatedly(Return(true));
+    EXPECT_CALL(*layer, getFrameRateForLayerTree()).WillRepeatedly(Return(Layer::FrameRate()));
+
+    // 23.976fps content with presentation timestamps, queued late by a varying amount.
+    constexpr nsecs_t kPeriod = 41'708'333;
+    constexpr nsecs_t kQueueJitter[] = {0, 6'000'000, 2'000'000, 9'000'000};
+    nsecs_t time = systemTime();
+    for (size_t i = 0; i < CADENCE_WINDOW_SIZE - 1; i++) {
+        history().record(layer.get(), time, time + kQueueJitter[i % std::size(kQueueJitter)],
+                         LayerHistory::LayerUpdateType::Buffer);
+        time += kPeriod;
+        ASSERT_EQ(1, history().summarize(time).size());
+        EXPECT_EQ(LayerHistory::LayerVoteType::Max, history().summarize(time)[0].vote);
+    }
+
+    for (size_t i = 0; i < CADENCE_WINDOW_SIZE; i++) {
+        history().record(layer.get(), time, time + kQueueJitter[i % std::size(kQueueJitter)],
+                         LayerHistory::LayerUpdateType::Buffer);
+        time += kPeriod;
+        const auto summary = history().summarize(time);
+        ASSERT_EQ(1, summary.size());
+        EXPECT_EQ(LayerHistory::LayerVoteType::Heuristic, summary[0].vote);
+        EXPECT_FLOAT_EQ(24.0f, summary[0].desiredRefreshRate);
+    }
+}
+
+TEST_F(LayerHistoryTestV2, videoCadenceFromQueueTimes) {
+    const auto layer = createLayer();
+    EXPECT_CALL(*layer, isVisible()).WillRepeatedly(Return(true));
+    EXPECT_CALL(*layer, getFrameRateForLayerTree()).WillRepeatedly(Return(Layer::FrameRate()));
+
+    // 25fps content without presentation timestamps, with a dropped frame.
+    constexpr nsecs_t kPeriod = 40'000'000;
+    constexpr nsecs_t kQueueJitter[] = {0, 3'000'000, -2'000'000, 4'000'000, -1'000'000};
+    nsecs_t time = systemTime();
+    impl::LayerHistoryV2::Summary summary;
+    for (size_t i = 0; i < CADENCE_WINDOW_SIZE; i++) {
+        history().record(layer.get(), 0, time + kQueueJitter[i % std::size(kQueueJitter)],
+                         LayerHistory::LayerUpdateType::Buffer);
+        time += (i == CADENCE_WINDOW_SIZE / 2) ? 2 * kPeriod : kPeriod;
+        summary = history().summarize(time);
+    }
+
+    ASSERT_EQ(1, summary.size());
+    EXPECT_EQ(LayerHistory::LayerVoteType::Heuristic, summary[0].vote);
+    EXPECT_FLOAT_EQ(25.0f, summary[0].desiredRefreshRate);
+}
+
+TEST_F(LayerHistoryTestV2, burstyUpdatesHaveNoVideoCadence) {
+    const auto layer = createLayer();
+    EXPECT_CALL(*layer, isVisible()).WillRepeatedly(Return(true));
+    EXPECT_CALL(*layer, getFrameRateForLayerTree()).WillRepeatedly(Return(Layer::FrameRate()));
+
+    // Bursts of three frames at 60fps, every 100ms.
+    constexpr nsecs_t kDeltas[] = {16'666'667, 16'666'667, 66'666'666};
+    nsecs_t time = systemTime();
+    for (size_t i = 0; i < 2 * CADENCE_WINDOW_SIZE; i++) {
+        history().record(layer.get(), time, time, LayerHistory::LayerUpdateType::Buffer);
+        time += kDeltas[i % std::size(kDeltas)];
+        ASSERT_EQ(1, history().summarize(time).size());
+        EXPECT_EQ(LayerHistory::LayerVoteType::Max, history().summarize(time)[0].vote);
+    }
+}
+
 class LayerHistoryTestV2Parameterized
       : public LayerHistoryTestV2,
         public testing::WithParamInterface<std::chrono::nanoseconds> {};
@@ -0,0 +1,99 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "LockFreeInbox.h"
+
+namespace android {
+namespace {
+
+TEST(LockFreeInboxTest, startsEmpty) {
+    LockFreeInbox<int> inbox;
+    EXPECT_TRUE(inbox.empty());
+    EXPECT_EQ(0u, inbox.drain([](int) { FAIL(); }));
+}
+
+TEST(LockFreeInboxTest, drainsInPostOrder) {
+    LockFreeInbox<int> inbox;
+    inbox.post(1);
+    inbox.post(2);
+    inbox.post(3);
+    EXPECT_FALSE(inbox.empty());
+
+    std::vector<int> items;
+    EXPECT_EQ(3u, inbox.drain([&](int item) { items.push_back(item); }));
+    EXPECT_EQ((std::vector<int>{1, 2, 3}), items);
+    EXPECT_TRUE(inbox.empty());
+}
+
+TEST(LockFreeInboxTest, supportsMoveOnlyItems) {
+    LockFreeInbox<std::unique_ptr<int>> inbox;
+    inbox.post(std::make_unique<int>(42));
+
+    int value = 0;
+    inbox.drain([&](std::unique_ptr<int>&& item) { value = *item; });
+    EXPECT_EQ(42, value);
+}
+
+TEST(LockFreeInboxTest, destroysUndrainedItems) {
+    auto item = std::make_shared<int>(1);
+    {
+        LockFreeInbox<std::shared_ptr<int>> inbox;
+        inbox.post(item);
+        EXPECT_EQ(2, item.use_count());
+    }
+    EXPECT_EQ(1, item.use_count());
+}
+
+TEST(LockFreeInboxTest, preservesPerProducerOrderAcrossThreads) {
+    constexpr int kProducers = 4;
+    constexpr int kItemsPerProducer = 10000;
+
+    LockFreeInbox<std::pair<int, int>> inbox;
+    std::vector<int> lastSeen(kProducers, -1);
+    int total = 0;
+    const auto consume = [&](std::pair<int, int> item) {
+        EXPECT_EQ(lastSeen[item.first] + 1, item.second);
+        lastSeen[item.first] = item.second;
+        total++;
+    };
+
+    std::vector<std::thread> producers;
+    for (int producer = 0; producer < kProducers; producer++) {
+        producers.emplace_back([&inbox, producer]() {
+            for (int i = 0; i < kItemsPerProducer; i++) {
+                inbox.post(producer, i);
+            }
+        });
+    }
+    while (total < kProducers * kItemsPerProducer) {
+        inbox.drain(consume);
+    }
+    for (auto& thread : producers) {
+        thread.join();
+    }
+
+    EXPECT_TRUE(inbox.empty());
+    EXPECT_EQ(kProducers * kItemsPerProducer, total);
+}
+
+} // namespace
+} // namespace android
@@ -51,6 +51,11 @@ protected:
         return refreshRateConfigs.mKnownFrameRates;
     }
 
+    size_t getBestRefreshRateCacheSize(const RefreshRateConfigs& refreshRateConfigs)
+            NO_THREAD_SAFETY_ANALYSIS {
+        return refreshRateConfigs.mBestRefreshRateCache.size();
+    }
+
     // Test config IDs
     static inline const HwcConfigIndexType HWC_CONFIG_ID_60 = HwcConfigIndexType(0);
     static inline const HwcConfigIndexType HWC_CONFIG_ID_90 = HwcConfigIndexType(1);
@@ -1443,6 +1448,41 @@ TEST_F(RefreshRateConfigsTest, getBestRefreshRate_KnownFrameRate) {
     }
 }
 
+TEST_F(RefreshRateConfigsTest, getBestRefreshRate_cachedUntilPolicyChanges) {
+    auto refreshRateConfigs =
+            std::make_unique<RefreshRateConfigs>(m60_90Device,
+                                                 /*currentConfigId=*/HWC_CONFIG_ID_60);
+
+    auto layers = std::vector<LayerRequirement>{LayerRequirement{.weight = 1.0f}};
+    auto& layer = layers[0];
+    layer.vote = LayerVoteType::Heuristic;
+    layer.desiredRefreshRate = 60.0f;
+    layer.name = "60Hz Heuristic";
+    EXPECT_EQ(mExpected60Config, refreshRateConfigs->getBestRefreshRate(layers, {}));
+    EXPECT_EQ(1, getBestRefreshRateCacheSize(*refreshRateConfigs));
+
+    // The layer name does not take part in the selection.
+    layer.name = "Renamed";
+    EXPECT_EQ(mExpected60Config, refreshRateConfigs->getBestRefreshRate(layers, {}));
+    EXPECT_EQ(1, getBestRefreshRateCacheSize(*refreshRateConfigs));
+
+    RefreshRateConfigs::GlobalSignals consideredSignals;
+    EXPECT_EQ(mExpected90Config,
+              refreshRateConfigs->getBestRefreshRate(layers, {.touch = true}, &consideredSignals));
+    EXPECT_TRUE(consideredSignals.touch);
+    EXPECT_EQ(2, getBestRefreshRateCacheSize(*refreshRateConfigs));
+
+    consideredSignals = {};
+    EXPECT_EQ(mExpected90Config,
+              refreshRateConfigs->getBestRefreshRate(layers, {.touch = true}, &consideredSignals));
+    EXPECT_TRUE(consideredSignals.touch);
+    EXPECT_EQ(2, getBestRefreshRateCacheSize(*refreshRateConfigs));
+
+    ASSERT_GE(refreshRateConfigs->setDisplayManagerPolicy({HWC_CONFIG_ID_60, {60, 60}}), 0);
+    EXPECT_EQ(0, getBestRefreshRateCacheSize(*refreshRateConfigs));
+    EXPECT_EQ(mExpected60Config, refreshRateConfigs->getBestRefreshRate(layers, {.touch = true}));
+}
+
 TEST_F(RefreshRateConfigsTest, testComparisonOperator) {
     EXPECT_TRUE(mExpected60Config < mExpected90Config);
     EXPECT_FALSE(mExpected60Config < mExpected60Config);
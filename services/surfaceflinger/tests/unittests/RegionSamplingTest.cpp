@@ -140,6 +140,17 @@ TEST_F(RegionSamplingTest, orientation_90) {
                 testing::Eq(1.0));
 }
 
+TEST_F(RegionSamplingTest, scale_sample_area) {
+    EXPECT_EQ(Rect(5, 10, 15, 20), scaleSampleArea(Rect(10, 20, 30, 40), 0.5f, 0.5f, 50, 50));
+
+    // Partially covered pixels are included.
+    EXPECT_EQ(Rect(0, 0, 2, 2), scaleSampleArea(Rect(1, 1, 3, 3), 0.5f, 0.5f, 50, 50));
+
+    // Areas never collapse to nothing, and never leave the buffer.
+    EXPECT_EQ(Rect(0, 0, 1, 1), scaleSampleArea(Rect(7, 7, 8, 8), 0.1f, 0.1f, 10, 10));
+    EXPECT_EQ(Rect(0, 0, 50, 50), scaleSampleArea(Rect(0, 0, 100, 100), 1.0f, 1.0f, 50, 50));
+}
+
 } // namespace android
 
 // TODO(b/129481165): remove the #pragma below and fix conversion issues
@@ -46,7 +46,7 @@ protected:
     class MockEventThreadConnection : public android::EventThreadConnection {
     public:
         explicit MockEventThreadConnection(EventThread* eventThread)
-              : EventThreadConnection(eventThread, ResyncCallback(),
+              : EventThreadConnection(eventThread, /*callingUid=*/0, ResyncCallback(),
                                       ISurfaceComposer::eConfigChangedSuppress) {}
         ~MockEventThreadConnection() = default;
 
@@ -171,6 +171,18 @@ TEST_F(SchedulerTest, validConnectionHandle) {
     EXPECT_EQ(kEventConnections, mScheduler->getEventThreadConnectionCount(mConnectionHandle));
 }
 
+TEST_F(SchedulerTest, getFrameRateDivisor) {
+    EXPECT_EQ(1u, Scheduler::getFrameRateDivisor(120.f, 0.f));
+    EXPECT_EQ(1u, Scheduler::getFrameRateDivisor(120.f, 120.f));
+    EXPECT_EQ(1u, Scheduler::getFrameRateDivisor(120.f, 90.f));
+    EXPECT_EQ(1u, Scheduler::getFrameRateDivisor(120.f, 48.f));
+    EXPECT_EQ(2u, Scheduler::getFrameRateDivisor(120.f, 60.f));
+    EXPECT_EQ(4u, Scheduler::getFrameRateDivisor(120.f, 30.f));
+    EXPECT_EQ(4u, Scheduler::getFrameRateDivisor(120.f, 29.97f));
+    EXPECT_EQ(5u, Scheduler::getFrameRateDivisor(120.f, 24.f));
+    EXPECT_EQ(1u, Scheduler::getFrameRateDivisor(90.f, 60.f));
+}
+
 } // namespace
 } // namespace android
 
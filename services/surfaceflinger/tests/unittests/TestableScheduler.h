@@ -93,6 +93,7 @@ private:
     void changeRefreshRate(const RefreshRate&, ConfigEvent) override {}
     void repaintEverythingForHWC() override {}
     void kernelTimerChanged(bool /*expired*/) override {}
+    void onVsyncPredictionError(nsecs_t /*idealPeriod*/, nsecs_t /*error*/) override {}
 };
 
 } // namespace android
@@ -249,7 +249,10 @@ public:
     }
 
     static auto& mutableLayerCurrentState(const sp<Layer>& layer) { return layer->mCurrentState; }
-    static auto& mutableLayerDrawingState(const sp<Layer>& layer) { return layer->mDrawingState; }
+    static auto& mutableLayerDrawingState(const sp<Layer>& layer) {
+        Layer::invalidateInheritedState();
+        return layer->mDrawingState;
+    }
 
     auto& mutableStateLock() { return mFlinger->mStateLock; }
 
@@ -349,7 +352,11 @@ public:
         return mFlinger->SurfaceFlinger::getDisplayNativePrimaries(displayToken, primaries);
     }
 
-    auto& getTransactionQueue() { return mFlinger->mTransactionQueues; }
+    auto& getTransactionQueue() {
+        Mutex::Autolock lock(mFlinger->mStateLock);
+        mFlinger->drainTransactionInboxLocked();
+        return mFlinger->mTransactionQueues;
+    }
 
     auto setTransactionState(const Vector<ComposerState>& states,
                              const Vector<DisplayState>& displays, uint32_t flags,
@@ -390,7 +397,11 @@ public:
     auto& mutableCurrentState() { return mFlinger->mCurrentState; }
     auto& mutableDisplayColorSetting() { return mFlinger->mDisplayColorSetting; }
     auto& mutableDisplays() { return mFlinger->mDisplays; }
-    auto& mutableDrawingState() { return mFlinger->mDrawingState; }
+    auto& mutableDrawingState() {
+        // Callers may edit the layer tree directly.
+        mFlinger->mDrawingState.invalidateZOrder();
+        return mFlinger->mDrawingState;
+    }
     auto& mutableEventQueue() { return mFlinger->mEventQueue; }
     auto& mutableGeometryInvalid() { return mFlinger->mGeometryInvalid; }
     auto& mutableInterceptor() { return mFlinger->mInterceptor; }
@@ -47,6 +47,7 @@ using testing::AnyNumber;
 using testing::Contains;
 using testing::HasSubstr;
 using testing::InSequence;
+using testing::Not;
 using testing::SizeIs;
 using testing::StrEq;
 using testing::UnorderedElementsAre;
@@ -349,6 +350,25 @@ TEST_F(TimeStatsTest, canIncreaseBadDesiredPresent) {
     EXPECT_THAT(result, HasSubstr(expectedResult));
 }
 
+TEST_F(TimeStatsTest, canRecordQueueDepth) {
+    EXPECT_TRUE(inputCommand(InputCommand::ENABLE, FMT_STRING).empty());
+
+    insertTimeRecord(NORMAL_SEQUENCE, LAYER_ID_0, 1, 1000000);
+    mTimeStats->recordQueueDepth(LAYER_ID_0, 1);
+    mTimeStats->recordQueueDepth(LAYER_ID_0, 1);
+    mTimeStats->recordQueueDepth(LAYER_ID_0, 3);
+    insertTimeRecord(NORMAL_SEQUENCE_2, LAYER_ID_0, 2, 2000000);
+
+    const std::string result(inputCommand(InputCommand::DUMP_ALL, FMT_STRING));
+    EXPECT_THAT(result, HasSubstr("drainedLatches = 2 stuffedLatches = 1\n"));
+    EXPECT_THAT(result, HasSubstr("queueDepth histogram is as below:\n1=2 3=1\n"));
+
+    SFTimeStatsGlobalProto globalProto;
+    ASSERT_TRUE(globalProto.ParseFromString(inputCommand(InputCommand::DUMP_ALL, FMT_PROTO)));
+    ASSERT_EQ(1, globalProto.stats_size());
+    EXPECT_EQ(2, globalProto.stats(0).queue_depths_size());
+}
+
 TEST_F(TimeStatsTest, canIncreaseClientCompositionReusedFrames) {
     // this stat is not in the proto so verify by checking the string dump
     constexpr size_t CLIENT_COMPOSITION_REUSED_FRAMES = 2;
@@ -364,6 +384,36 @@ TEST_F(TimeStatsTest, canIncreaseClientCompositionReusedFrames) {
     EXPECT_THAT(result, HasSubstr(expectedResult));
 }
 
+TEST_F(TimeStatsTest, canIncreaseLayerFlatteningHits) {
+    // this stat is not in the proto so verify by checking the string dump
+    constexpr size_t LAYER_FLATTENING_HITS = 2;
+
+    EXPECT_TRUE(inputCommand(InputCommand::ENABLE, FMT_STRING).empty());
+    for (size_t i = 0; i < LAYER_FLATTENING_HITS; i++) {
+        ASSERT_NO_FATAL_FAILURE(mTimeStats->incrementLayerFlatteningHits());
+    }
+
+    const std::string result(inputCommand(InputCommand::DUMP_ALL, FMT_STRING));
+    const std::string expectedResult =
+            "layerFlatteningHits = " + std::to_string(LAYER_FLATTENING_HITS);
+    EXPECT_THAT(result, HasSubstr(expectedResult));
+}
+
+TEST_F(TimeStatsTest, canIncreaseLayerFlatteningMisses) {
+    // this stat is not in the proto so verify by checking the string dump
+    constexpr size_t LAYER_FLATTENING_MISSES = 2;
+
+    EXPECT_TRUE(inputCommand(InputCommand::ENABLE, FMT_STRING).empty());
+    for (size_t i = 0; i < LAYER_FLATTENING_MISSES; i++) {
+        ASSERT_NO_FATAL_FAILURE(mTimeStats->incrementLayerFlatteningMisses());
+    }
+
+    const std::string result(inputCommand(InputCommand::DUMP_ALL, FMT_STRING));
+    const std::string expectedResult =
+            "layerFlatteningMisses = " + std::to_string(LAYER_FLATTENING_MISSES);
+    EXPECT_THAT(result, HasSubstr(expectedResult));
+}
+
 TEST_F(TimeStatsTest, canIncreaseRefreshRateSwitches) {
     // this stat is not in the proto so verify by checking the string dump
     constexpr size_t REFRESH_RATE_SWITCHES = 2;
@@ -379,6 +429,47 @@ TEST_F(TimeStatsTest, canIncreaseRefreshRateSwitches) {
     EXPECT_THAT(result, HasSubstr(expectedResult));
 }
 
+TEST_F(TimeStatsTest, canRecordVsyncPredictionError) {
+    // this stat is not in the proto so verify by checking the string dump
+    EXPECT_TRUE(inputCommand(InputCommand::ENABLE, FMT_STRING).empty());
+    ASSERT_NO_FATAL_FAILURE(mTimeStats->recordVsyncPredictionError(60, 200000));
+    ASSERT_NO_FATAL_FAILURE(mTimeStats->recordVsyncPredictionError(60, -2000000));
+    ASSERT_NO_FATAL_FAILURE(mTimeStats->recordVsyncPredictionError(90, 0));
+
+    const std::string result(inputCommand(InputCommand::DUMP_ALL, FMT_STRING));
+    EXPECT_THAT(result,
+                HasSubstr("60fps: samples=2 averageAbsError=1100.0us maxAbsError=2000.0us "
+                          "lateSamples=1"));
+    EXPECT_THAT(result,
+                HasSubstr("90fps: samples=1 averageAbsError=0.0us maxAbsError=0.0us "
+                          "lateSamples=0"));
+}
+
+TEST_F(TimeStatsTest, canIncrementJankyFrames) {
+    // this stat is not in the proto so verify by checking the string dump
+    using JankType = TimeStatsHelper::JankType;
+    EXPECT_TRUE(inputCommand(InputCommand::ENABLE, FMT_STRING).empty());
+    ASSERT_NO_FATAL_FAILURE(mTimeStats->incrementJankyFrames(JankType::None));
+    ASSERT_NO_FATAL_FAILURE(
+            mTimeStats->incrementJankyFrames(JankType::SurfaceFlingerCpuDeadlineMissed));
+    ASSERT_NO_FATAL_FAILURE(mTimeStats->incrementJankyFrames(genLayerName(LAYER_ID_0),
+                                                             JankType::AppDeadlineMissed |
+                                                                     JankType::DisplayHal));
+    ASSERT_NO_FATAL_FAILURE(
+            mTimeStats->incrementJankyFrames(genLayerName(LAYER_ID_INVALID), JankType::Unknown));
+
+    const std::string result(inputCommand(InputCommand::DUMP_ALL, FMT_STRING));
+    EXPECT_THAT(result,
+                HasSubstr("totalTimelineFrames = 2\njankyFrames = 1\nappDeadlineMissed = 0 "
+                          "sfCpuDeadlineMissed = 1 sfGpuDeadlineMissed = 0 displayHal = 0 "
+                          "bufferStuffing = 0 unknownJank = 0\n"));
+    EXPECT_THAT(result,
+                HasSubstr("totalTimelineFrames = 1\njankyFrames = 1\nappDeadlineMissed = 1 "
+                          "sfCpuDeadlineMissed = 0 sfGpuDeadlineMissed = 0 displayHal = 1 "
+                          "bufferStuffing = 0 unknownJank = 0\n"));
+    EXPECT_THAT(result, Not(HasSubstr("unknownJank = 1")));
+}
+
 TEST_F(TimeStatsTest, canIncreaseCompositionStrategyChanges) {
     // this stat is not in the proto so verify by checking the string dump
     constexpr size_t COMPOSITION_STRATEGY_CHANGES = 2;
@@ -778,6 +869,8 @@ TEST_F(TimeStatsTest, canClearDumpOnlyTimeStats) {
     ASSERT_NO_FATAL_FAILURE(mTimeStats->incrementClientCompositionReusedFrames());
     ASSERT_NO_FATAL_FAILURE(mTimeStats->incrementRefreshRateSwitches());
     ASSERT_NO_FATAL_FAILURE(mTimeStats->incrementCompositionStrategyChanges());
+    ASSERT_NO_FATAL_FAILURE(mTimeStats->incrementLayerFlatteningHits());
+    ASSERT_NO_FATAL_FAILURE(mTimeStats->incrementLayerFlatteningMisses());
     mTimeStats->setPowerMode(PowerMode::ON);
     mTimeStats
             ->recordFrameDuration(std::chrono::duration_cast<std::chrono::nanoseconds>(1ms).count(),
@@ -795,6 +888,8 @@ TEST_F(TimeStatsTest, canClearDumpOnlyTimeStats) {
     EXPECT_THAT(result, HasSubstr("clientCompositionReusedFrames = 0"));
     EXPECT_THAT(result, HasSubstr("refreshRateSwitches = 0"));
     EXPECT_THAT(result, HasSubstr("compositionStrategyChanges = 0"));
+    EXPECT_THAT(result, HasSubstr("layerFlatteningHits = 0"));
+    EXPECT_THAT(result, HasSubstr("layerFlatteningMisses = 0"));
     EXPECT_THAT(result, HasSubstr("averageFrameDuration = 0.000 ms"));
     EXPECT_THAT(result, HasSubstr("averageRenderEngineTiming = 0.000 ms"));
 }
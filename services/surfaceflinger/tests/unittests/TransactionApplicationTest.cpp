@@ -67,13 +67,15 @@ public:
         EXPECT_CALL(*eventThread, registerDisplayEventConnection(_));
         EXPECT_CALL(*eventThread, createEventConnection(_, _))
                 .WillOnce(Return(
-                        new EventThreadConnection(eventThread.get(), ResyncCallback(),
+                        new EventThreadConnection(eventThread.get(), /*callingUid=*/0,
+                                                  ResyncCallback(),
                                                   ISurfaceComposer::eConfigChangedSuppress)));
 
         EXPECT_CALL(*sfEventThread, registerDisplayEventConnection(_));
         EXPECT_CALL(*sfEventThread, createEventConnection(_, _))
                 .WillOnce(Return(
-                        new EventThreadConnection(sfEventThread.get(), ResyncCallback(),
+                        new EventThreadConnection(sfEventThread.get(), /*callingUid=*/0,
+                                                  ResyncCallback(),
                                                   ISurfaceComposer::eConfigChangedSuppress)));
 
         EXPECT_CALL(*mPrimaryDispSync, computeNextRefresh(0, _)).WillRepeatedly(Return(0));
@@ -319,6 +321,83 @@ TEST_F(TransactionApplicationTest, BlockWithPriorTransaction_SyncInputWindows) {
     BlockedByPriorTransaction(/*flags*/ 0, /*syncInputWindows*/ true);
 }
 
+SurfaceFlinger::TransactionState makeTransactionState(const Vector<ComposerState>& states,
+                                                      bool privileged = false) {
+    return SurfaceFlinger::TransactionState(states, Vector<DisplayState>(), /*flags*/ 0,
+                                            /*desiredPresentTime*/ -1, client_cache_t(),
+                                            /*postTime*/ 0, privileged,
+                                            /*hasListenerCallbacks*/ false, {});
+}
+
+ComposerState makeComposerState(const sp<IBinder>& surface, uint64_t what) {
+    ComposerState state;
+    state.state.surface = surface;
+    state.state.what = what;
+    return state;
+}
+
+TEST_F(TransactionApplicationTest, Coalesce_MergesStatesForSameLayer) {
+    sp<IBinder> surface = new BBinder();
+
+    ComposerState first = makeComposerState(surface, layer_state_t::ePositionChanged);
+    first.state.x = 1;
+    first.state.y = 2;
+    ComposerState second = makeComposerState(surface,
+                                             layer_state_t::ePositionChanged |
+                                                     layer_state_t::eAlphaChanged);
+    second.state.x = 3;
+    second.state.y = 4;
+    second.state.alpha = 0.5f;
+
+    auto transaction = makeTransactionState({first});
+    const auto next = makeTransactionState({second});
+    ASSERT_TRUE(transaction.canCoalesceWith(next));
+    transaction.coalesce(next);
+
+    ASSERT_EQ(1, transaction.states.size());
+    const layer_state_t& state = transaction.states[0].state;
+    EXPECT_EQ(layer_state_t::ePositionChanged | layer_state_t::eAlphaChanged, state.what);
+    EXPECT_EQ(3, state.x);
+    EXPECT_EQ(4, state.y);
+    EXPECT_EQ(0.5f, state.alpha);
+}
+
+TEST_F(TransactionApplicationTest, Coalesce_AppendsStatesForOtherLayers) {
+    sp<IBinder> surfaceA = new BBinder();
+    sp<IBinder> surfaceB = new BBinder();
+
+    auto transaction =
+            makeTransactionState({makeComposerState(surfaceA, layer_state_t::eAlphaChanged)});
+    transaction.coalesce(
+            makeTransactionState({makeComposerState(surfaceB, layer_state_t::eAlphaChanged),
+                                  makeComposerState(surfaceA, layer_state_t::eCropChanged)}));
+
+    ASSERT_EQ(2, transaction.states.size());
+    EXPECT_EQ(surfaceA, transaction.states[0].state.surface);
+    EXPECT_EQ(layer_state_t::eAlphaChanged | layer_state_t::eCropChanged,
+              transaction.states[0].state.what);
+    EXPECT_EQ(surfaceB, transaction.states[1].state.surface);
+}
+
+TEST_F(TransactionApplicationTest, Coalesce_StopsAtBarriers) {
+    sp<IBinder> surface = new BBinder();
+    const auto transaction =
+            makeTransactionState({makeComposerState(surface, layer_state_t::eAlphaChanged)});
+
+    EXPECT_FALSE(transaction.canCoalesceWith(
+            makeTransactionState({makeComposerState(surface, layer_state_t::eBufferChanged)})));
+    EXPECT_FALSE(transaction.canCoalesceWith(
+            makeTransactionState({makeComposerState(surface, layer_state_t::eReparent)})));
+    EXPECT_FALSE(transaction.canCoalesceWith(
+            makeTransactionState({makeComposerState(surface, layer_state_t::eAlphaChanged)},
+                                 /*privileged*/ true)));
+
+    auto withDisplay =
+            makeTransactionState({makeComposerState(surface, layer_state_t::eAlphaChanged)});
+    withDisplay.displays.add(DisplayState());
+    EXPECT_FALSE(transaction.canCoalesceWith(withDisplay));
+}
+
 TEST_F(TransactionApplicationTest, FromHandle) {
     sp<IBinder> badHandle;
     auto ret = mFlinger.fromHandle(badHandle);
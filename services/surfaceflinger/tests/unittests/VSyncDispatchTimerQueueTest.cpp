@@ -778,6 +778,28 @@ TEST_F(VSyncDispatchTimerQueueTest, laggedTimerGroupsCallbacksWithinLag) {
     EXPECT_THAT(cb2.mWakeupTime[0], Eq(610));
 }
 
+TEST_F(VSyncDispatchTimerQueueTest, coalescedCallbacksShareOneWakeupAndAreReported) {
+    EXPECT_CALL(mMockClock, alarmAt(_, 600)).Times(1);
+
+    CountingCallback cb0(mDispatch);
+    CountingCallback cb1(mDispatch);
+
+    EXPECT_EQ(mDispatch.schedule(cb0, 400, 1000), ScheduleResult::Scheduled);
+    EXPECT_EQ(mDispatch.schedule(cb1, 400 - mDispatchGroupThreshold + 2, 1000),
+              ScheduleResult::Scheduled);
+    advanceToNextCallback();
+
+    ASSERT_THAT(cb0.mCalls.size(), Eq(1));
+    ASSERT_THAT(cb1.mCalls.size(), Eq(1));
+    EXPECT_THAT(cb1.mWakeupTime[0], Eq(600 + mDispatchGroupThreshold - 2));
+
+    std::string dump;
+    mDispatch.dump(dump);
+    EXPECT_THAT(dump, HasSubstr("mTimerWakeups: 1 mDispatchedCallbacks: 2"));
+    EXPECT_THAT(dump, HasSubstr("dispatches = 1, coalesced = 1"));
+    EXPECT_THAT(dump, HasSubstr("dispatches = 1, coalesced = 0"));
+}
+
 class VSyncDispatchTimerQueueEntryTest : public testing::Test {
 protected:
     nsecs_t const mPeriod = 1000;
@@ -854,6 +876,24 @@ TEST_F(VSyncDispatchTimerQueueEntryTest, runCallback) {
     EXPECT_THAT(*lastCalledTarget, Eq(mPeriod));
 }
 
+TEST_F(VSyncDispatchTimerQueueEntryTest, recordsDispatchLateness) {
+    VSyncDispatchTimerQueueEntry entry(
+            "test", [](auto, auto) {}, mVsyncMoveThreshold);
+
+    entry.recordDispatch(900, 890);
+    entry.recordDispatch(900, 900 + 300'000);
+    entry.recordDispatch(900, 900 + 5'000'000);
+
+    auto const& stats = entry.dispatchStats();
+    EXPECT_THAT(stats.dispatches, Eq(3));
+    EXPECT_THAT(stats.coalesced, Eq(1));
+    EXPECT_THAT(stats.maxLateness, Eq(5'000'000));
+    EXPECT_THAT(stats.totalLateness, Eq(5'300'000));
+    EXPECT_THAT(stats.buckets[0], Eq(1));
+    EXPECT_THAT(stats.buckets[3], Eq(1));
+    EXPECT_THAT(stats.buckets.back(), Eq(1));
+}
+
 TEST_F(VSyncDispatchTimerQueueEntryTest, updateCallback) {
     EXPECT_CALL(mStubTracker, nextAnticipatedVSyncTimeFrom(_))
             .Times(2)
@@ -43,6 +43,8 @@ class VSyncModulatorTest : public testing::Test {
 protected:
     static constexpr auto MIN_EARLY_FRAME_COUNT_TRANSACTION =
             VSyncModulator::MIN_EARLY_FRAME_COUNT_TRANSACTION;
+    static constexpr auto MIN_EARLY_GL_FRAME_COUNT_TRANSACTION =
+            VSyncModulator::MIN_EARLY_GL_FRAME_COUNT_TRANSACTION;
     // Add a 1ms slack to avoid strange timer race conditions.
     static constexpr auto MARGIN_FOR_TX_APPLY = VSyncModulator::MARGIN_FOR_TX_APPLY + 1ms;
 
@@ -298,4 +300,53 @@ TEST_F(VSyncModulatorTest, EarlyStartAfterEarlyEndWithMoreTransactions) {
     EXPECT_EQ(SF_LATE, mMockScheduler.getOffset(mSfConnection));
 }
 
+TEST_F(VSyncModulatorTest, EarlyGlBeforePredictedRenderEngineFrame) {
+    using Features = CompositionPredictor::Features;
+    const Features simpleFrame{.layerCount = 3};
+    const Features roundedFrame{.layerCount = 4, .hasRoundedCorners = true};
+
+    // Frames with rounded corners have been composed with RenderEngine.
+    for (int i = 0; i < 2; i++) {
+        mVSyncModulator->onRefreshed(true, roundedFrame);
+        EXPECT_EQ(APP_EARLY_GL, mMockScheduler.getOffset(mAppConnection));
+        EXPECT_EQ(SF_EARLY_GL, mMockScheduler.getOffset(mSfConnection));
+    }
+
+    for (int i = 0; i < MIN_EARLY_GL_FRAME_COUNT_TRANSACTION; i++) {
+        mVSyncModulator->onRefreshed(false, simpleFrame);
+    }
+    EXPECT_EQ(APP_LATE, mMockScheduler.getOffset(mAppConnection));
+    EXPECT_EQ(SF_LATE, mMockScheduler.getOffset(mSfConnection));
+
+    // A transaction that only shows a layer is not expected to need RenderEngine...
+    mVSyncModulator->onCompositionChangePending({.layerCount = 2});
+    EXPECT_EQ(APP_LATE, mMockScheduler.getOffset(mAppConnection));
+    EXPECT_EQ(SF_LATE, mMockScheduler.getOffset(mSfConnection));
+
+    // ...but one that brings back the rounded corners moves into early GL offsets right away.
+    mVSyncModulator->onCompositionChangePending({.layerCount = 1, .hasRoundedCorners = true});
+    EXPECT_EQ(APP_EARLY_GL, mMockScheduler.getOffset(mAppConnection));
+    EXPECT_EQ(SF_EARLY_GL, mMockScheduler.getOffset(mSfConnection));
+}
+
+TEST(CompositionPredictorTest, learnsFromComposedFrames) {
+    using Features = CompositionPredictor::Features;
+    CompositionPredictor predictor;
+    const Features blurFrame{.layerCount = 2, .hasBlur = true};
+    const Features roundedFrame{.layerCount = 2, .hasRoundedCorners = true};
+
+    EXPECT_TRUE(predictor.isRenderEngineLikely(blurFrame));
+    EXPECT_FALSE(predictor.isRenderEngineLikely(roundedFrame));
+
+    predictor.onFrameComposed(roundedFrame, true);
+    EXPECT_TRUE(predictor.isRenderEngineLikely(roundedFrame));
+
+    predictor.onFrameComposed(blurFrame, false);
+    EXPECT_FALSE(predictor.isRenderEngineLikely(blurFrame));
+
+    // Large layer counts share a counter.
+    predictor.onFrameComposed({.layerCount = 40}, true);
+    EXPECT_TRUE(predictor.isRenderEngineLikely({.layerCount = 100}));
+}
+
 } // namespace android::scheduler
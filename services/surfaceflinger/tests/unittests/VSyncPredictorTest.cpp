@@ -450,6 +450,54 @@ TEST_F(VSyncPredictorTest, aPhoneThatHasBeenAroundAWhileCanStillComputePeriod) {
     EXPECT_THAT(intercept, Eq(0));
 }
 
+TEST_F(VSyncPredictorTest, recordsPredictionErrorOnceModelIsPredicting) {
+    std::vector<std::pair<nsecs_t, nsecs_t>> errors;
+    VSyncPredictor errorTracker{mPeriod, kHistorySize, kMinimumSamplesForPrediction,
+                                kOutlierTolerancePercent,
+                                [&](nsecs_t idealPeriod, nsecs_t error) {
+                                    errors.emplace_back(idealPeriod, error);
+                                }};
+
+    for (auto i = 0u; i < kMinimumSamplesForPrediction; i++) {
+        errorTracker.addVsyncTimestamp(mNow += mPeriod);
+    }
+    EXPECT_THAT(errors, IsEmpty());
+
+    errorTracker.addVsyncTimestamp(mNow += mPeriod);
+    static constexpr nsecs_t kLateness = 30;
+    errorTracker.addVsyncTimestamp((mNow += mPeriod) + kLateness);
+    EXPECT_THAT(errors, ElementsAre(std::make_pair(mPeriod, 0), std::make_pair(mPeriod, kLateness)));
+
+    auto const stats = errorTracker.getPredictionErrorStats(mPeriod);
+    ASSERT_TRUE(stats);
+    EXPECT_THAT(stats->samples, Eq(2));
+    EXPECT_THAT(stats->totalAbsError, Eq(kLateness));
+    EXPECT_THAT(stats->maxAbsError, Eq(kLateness));
+    EXPECT_THAT(stats->buckets[0], Eq(2));
+    EXPECT_THAT(stats->outliers, Eq(0));
+    EXPECT_THAT(stats->modelResets, Eq(0));
+}
+
+TEST_F(VSyncPredictorTest, countsOutliersAndModelResets) {
+    EXPECT_FALSE(tracker.getPredictionErrorStats(mPeriod));
+
+    for (auto i = 0u; i < kMinimumSamplesForPrediction; i++) {
+        tracker.addVsyncTimestamp(mNow += mPeriod);
+    }
+    EXPECT_FALSE(tracker.addVsyncTimestamp(mNow + mPeriod / 2));
+    tracker.resetModel();
+
+    auto const stats = tracker.getPredictionErrorStats(mPeriod);
+    ASSERT_TRUE(stats);
+    EXPECT_THAT(stats->samples, Eq(0));
+    EXPECT_THAT(stats->outliers, Eq(1));
+    EXPECT_THAT(stats->modelResets, Eq(1));
+
+    auto const changedPeriod = mPeriod * 2;
+    tracker.setPeriod(changedPeriod);
+    EXPECT_FALSE(tracker.getPredictionErrorStats(changedPeriod));
+}
+
 } // namespace android::scheduler
 
 // TODO(b/129481165): remove the #pragma below and fix conversion issues
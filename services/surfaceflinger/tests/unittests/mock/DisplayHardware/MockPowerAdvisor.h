@@ -32,6 +32,8 @@ public:
     MOCK_METHOD0(onBootFinished, void());
     MOCK_METHOD2(setExpensiveRenderingExpected, void(DisplayId displayId, bool expected));
     MOCK_METHOD0(notifyDisplayUpdateImminent, void());
+    MOCK_METHOD1(setTargetWorkDuration, void(nsecs_t targetDuration));
+    MOCK_METHOD1(reportActualWorkDuration, void(nsecs_t actualDuration));
 };
 
 } // namespace mock
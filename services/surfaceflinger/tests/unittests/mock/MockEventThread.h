@@ -43,6 +43,7 @@ public:
     MOCK_METHOD1(requestLatestConfig, void(const sp<android::EventThreadConnection> &));
     MOCK_METHOD1(pauseVsyncCallback, void(bool));
     MOCK_METHOD0(getEventThreadConnectionCount, size_t());
+    MOCK_METHOD1(setFrameRateDivisors, void(FrameRateDivisors));
 };
 
 } // namespace mock
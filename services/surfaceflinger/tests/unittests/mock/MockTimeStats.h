@@ -38,6 +38,8 @@ public:
     MOCK_METHOD0(incrementClientCompositionReusedFrames, void());
     MOCK_METHOD0(incrementRefreshRateSwitches, void());
     MOCK_METHOD0(incrementCompositionStrategyChanges, void());
+    MOCK_METHOD0(incrementLayerFlatteningHits, void());
+    MOCK_METHOD0(incrementLayerFlatteningMisses, void());
     MOCK_METHOD1(recordDisplayEventConnectionCount, void(int32_t));
     MOCK_METHOD2(recordFrameDuration, void(nsecs_t, nsecs_t));
     MOCK_METHOD2(recordRenderEngineDuration, void(nsecs_t, nsecs_t));
@@ -45,6 +47,7 @@ public:
     MOCK_METHOD4(setPostTime, void(int32_t, uint64_t, const std::string&, nsecs_t));
     MOCK_METHOD2(incrementLatchSkipped, void(int32_t layerId, LatchSkipReason reason));
     MOCK_METHOD1(incrementBadDesiredPresent, void(int32_t layerId));
+    MOCK_METHOD2(recordQueueDepth, void(int32_t, int32_t));
     MOCK_METHOD3(setLatchTime, void(int32_t, uint64_t, nsecs_t));
     MOCK_METHOD3(setDesiredTime, void(int32_t, uint64_t, nsecs_t));
     MOCK_METHOD3(setAcquireTime, void(int32_t, uint64_t, nsecs_t));
@@ -56,6 +59,9 @@ public:
     MOCK_METHOD1(setPowerMode,
                  void(hardware::graphics::composer::V2_4::IComposerClient::PowerMode));
     MOCK_METHOD2(recordRefreshRate, void(uint32_t, nsecs_t));
+    MOCK_METHOD2(recordVsyncPredictionError, void(uint32_t, nsecs_t));
+    MOCK_METHOD1(incrementJankyFrames, void(int32_t));
+    MOCK_METHOD2(incrementJankyFrames, void(const std::string&, int32_t));
     MOCK_METHOD1(setPresentFenceGlobal, void(const std::shared_ptr<FenceTime>&));
 };
 
@@ -0,0 +1,148 @@
+#include "cpu_load.h"
+
+#include <log/log.h>
+
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+
+#include <android-base/file.h>
+#include <android-base/strings.h>
+
+namespace {
+
+const char kProcStatPath[] = "/proc/stat";
+
+// Number of leading /proc/stat fields that add up to the total time of a CPU:
+// user, nice, system, idle, iowait, irq, softirq and steal. The guest fields
+// that follow are already accounted for in user and nice.
+constexpr size_t kCpuTimeFieldCount = 8;
+constexpr size_t kIdleField = 3;
+constexpr size_t kIowaitField = 4;
+
+}  // anonymous namespace
+
+namespace android {
+namespace dvr {
+
+constexpr std::chrono::milliseconds CpuLoad::kMinSampleInterval;
+
+void CpuLoad::Update() {
+  const auto now = std::chrono::steady_clock::now();
+  if (!last_times_.empty() && now - last_sample_time_ < kMinSampleInterval)
+    return;
+
+  std::vector<CpuTimes> times;
+  if (!ReadCpuTimes(&times))
+    return;
+
+  std::vector<float> load(times.size(), -1.0f);
+  for (size_t cpu = 0; cpu < times.size() && cpu < last_times_.size(); cpu++) {
+    const CpuTimes& current = times[cpu];
+    const CpuTimes& last = last_times_[cpu];
+
+    // Counters go back to zero when a CPU is hotplugged.
+    if (current.total <= last.total || current.busy < last.busy)
+      continue;
+
+    load[cpu] = static_cast<float>(current.busy - last.busy) /
+                static_cast<float>(current.total - last.total);
+  }
+
+  load_ = std::move(load);
+  last_times_ = std::move(times);
+  last_sample_time_ = now;
+}
+
+float CpuLoad::GetLoad(const std::string& cpu_list) const {
+  float sum = 0.0f;
+  size_t count = 0;
+
+  for (int cpu : ParseCpuList(cpu_list)) {
+    if (cpu < static_cast<int>(load_.size()) && load_[cpu] >= 0.0f) {
+      sum += load_[cpu];
+      count++;
+    }
+  }
+
+  return count ? sum / count : -1.0f;
+}
+
+void CpuLoad::DumpState(std::ostringstream& stream) const {
+  stream << "cpu_load:";
+  for (size_t cpu = 0; cpu < load_.size(); cpu++) {
+    stream << " " << cpu << "=";
+    if (load_[cpu] >= 0.0f)
+      stream << std::fixed << std::setprecision(2) << load_[cpu];
+    else
+      stream << "?";
+  }
+  stream << std::endl;
+}
+
+std::vector<int> CpuLoad::ParseCpuList(const std::string& cpu_list) {
+  std::vector<int> cpus;
+
+  for (const auto& range : base::Split(base::Trim(cpu_list), ",")) {
+    if (range.empty())
+      continue;
+
+    char* end;
+    const long first = std::strtol(range.c_str(), &end, 10);
+    long last = first;
+    if (*end == '-')
+      last = std::strtol(end + 1, &end, 10);
+
+    if (*end != '\0' || first < 0 || last < first) {
+      ALOGW("CpuLoad::ParseCpuList: Invalid cpu list \"%s\".",
+            cpu_list.c_str());
+      return {};
+    }
+
+    for (long cpu = first; cpu <= last; cpu++)
+      cpus.push_back(static_cast<int>(cpu));
+  }
+
+  return cpus;
+}
+
+bool CpuLoad::ReadCpuTimes(std::vector<CpuTimes>* times) {
+  std::string contents;
+  if (!base::ReadFileToString(kProcStatPath, &contents)) {
+    ALOGE("CpuLoad::ReadCpuTimes: Failed to read %s: %s", kProcStatPath,
+          strerror(errno));
+    return false;
+  }
+
+  times->clear();
+  for (const auto& line : base::Split(contents, "\n")) {
+    // Only the per-CPU lines ("cpuN ..."), not the aggregate "cpu" line.
+    if (!base::StartsWith(line, "cpu") || line.size() < 4 ||
+        !isdigit(line[3]))
+      continue;
+
+    const auto fields = base::Split(line, " ");
+    if (fields.size() < kCpuTimeFieldCount + 1)
+      continue;
+
+    const size_t cpu = std::strtoul(fields[0].c_str() + 3, nullptr, 10);
+    CpuTimes cpu_times;
+    for (size_t i = 0; i < kCpuTimeFieldCount; i++) {
+      const uint64_t value = std::strtoull(fields[i + 1].c_str(), nullptr, 10);
+      cpu_times.total += value;
+      if (i != kIdleField && i != kIowaitField)
+        cpu_times.busy += value;
+    }
+
+    if (cpu >= times->size())
+      times->resize(cpu + 1);
+    (*times)[cpu] = cpu_times;
+  }
+
+  return !times->empty();
+}
+
+}  // namespace dvr
+}  // namespace android
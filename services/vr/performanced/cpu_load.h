@@ -0,0 +1,56 @@
+#ifndef ANDROID_DVR_PERFORMANCED_CPU_LOAD_H_
+#define ANDROID_DVR_PERFORMANCED_CPU_LOAD_H_
+
+#include <chrono>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace android {
+namespace dvr {
+
+// CpuLoad tracks per-CPU utilization using the counters in /proc/stat. The load
+// of each CPU is the fraction of time it was busy between the two most recent
+// samples.
+class CpuLoad {
+ public:
+  CpuLoad() {}
+
+  // Samples /proc/stat and recomputes the per-CPU load, unless the previous
+  // sample is more recent than kMinSampleInterval.
+  void Update();
+
+  // Returns the average load, in the range [0, 1], of the CPUs in |cpu_list|,
+  // which uses the cpuset list format (e.g. "0-3,6"). Returns a negative value
+  // when the load of none of these CPUs is known yet.
+  float GetLoad(const std::string& cpu_list) const;
+
+  void DumpState(std::ostringstream& stream) const;
+
+  // Parses a list in the cpuset list format into CPU numbers.
+  static std::vector<int> ParseCpuList(const std::string& cpu_list);
+
+  // Shorter sampling intervals give too noisy a picture of the load.
+  static constexpr std::chrono::milliseconds kMinSampleInterval{100};
+
+ private:
+  struct CpuTimes {
+    uint64_t busy = 0;
+    uint64_t total = 0;
+  };
+
+  static bool ReadCpuTimes(std::vector<CpuTimes>* times);
+
+  std::vector<CpuTimes> last_times_;
+  std::chrono::steady_clock::time_point last_sample_time_;
+  std::vector<float> load_;
+
+  CpuLoad(const CpuLoad&) = delete;
+  void operator=(const CpuLoad&) = delete;
+};
+
+}  // namespace dvr
+}  // namespace android
+
+#endif  // ANDROID_DVR_PERFORMANCED_CPU_LOAD_H_
@@ -40,6 +40,9 @@ const bool kAllowAppsToRequestVrAppRenderPolicy = false;
 constexpr unsigned long kTimerSlackForegroundNs = 50000;
 constexpr unsigned long kTimerSlackBackgroundNs = 40000000;
 
+// Average load above which the CPUs of a cpuset are considered saturated.
+constexpr float kCpuSetSaturatedLoad = 0.85f;
+
 // Expands the given parameter pack expression using an initializer list to
 // guarantee ordering and a comma expression to guarantee even void expressions
 // are valid elements of the initializer list.
@@ -111,6 +114,7 @@ PerformanceService::PerformanceService()
     : BASE("PerformanceService",
            Endpoint::Create(PerformanceRPC::kClientPath)) {
   cpuset_.Load(kCpuSetBasePath);
+  cpu_load_.Update();
 
   Task task(getpid());
   ALOGI("Running in cpuset=%s uid=%d gid=%d", task.GetCpuSetPath().c_str(),
@@ -235,6 +239,8 @@ std::string PerformanceService::DumpState(size_t /*max_length*/) {
   std::ostringstream stream;
   stream << "vr_app_render_thread: " << vr_app_render_thread_ << std::endl;
   cpuset_.DumpState(stream);
+  cpu_load_.Update();
+  cpu_load_.DumpState(stream);
   return stream.str();
 }
 
@@ -288,16 +294,22 @@ Status<void> PerformanceService::OnSetSchedulerPolicy(
     } else {
       target_cpuset = config.cpuset;
     }
-    ALOGI("PerformanceService::OnSetSchedulerPolicy: Using cpuset=%s",
-          target_cpuset.c_str());
 
     auto target_set = cpuset_.Lookup(target_cpuset);
     if (target_set) {
+      // Only policies that pin tasks to a specific cpuset adapt it to load;
+      // otherwise the cpuset is left as Android manages it.
+      if (!config.cpuset.empty())
+        target_set = SelectCpuSet(target_set);
+
+      ALOGI("PerformanceService::OnSetSchedulerPolicy: Using cpuset=%s",
+            target_set->path().c_str());
+
       auto attach_status = target_set->AttachTask(task_id);
       ALOGW_IF(!attach_status,
                "PerformanceService::OnSetSchedulerPolicy: Failed to attach "
                "task=%d to cpuset=%s: %s",
-               task_id, target_cpuset.c_str(),
+               task_id, target_set->path().c_str(),
                attach_status.GetErrorMessage().c_str());
     } else {
       ALOGW(
@@ -424,6 +436,29 @@ Status<void> PerformanceService::HandleMessage(Message& message) {
   }
 }
 
+CpuSet* PerformanceService::SelectCpuSet(CpuSet* preferred) {
+  cpu_load_.Update();
+
+  // A negative load means it is not known yet; keep the requested cpuset.
+  const float preferred_load = cpu_load_.GetLoad(preferred->GetCpuList());
+  if (preferred_load < kCpuSetSaturatedLoad)
+    return preferred;
+
+  for (CpuSet* set = preferred->parent(); set && !set->IsRoot();
+       set = set->parent()) {
+    const float load = cpu_load_.GetLoad(set->GetCpuList());
+    if (load >= 0.0f && load < kCpuSetSaturatedLoad) {
+      ALOGI(
+          "PerformanceService::SelectCpuSet: cpuset=%s is saturated "
+          "(load=%.2f), using cpuset=%s (load=%.2f) instead.",
+          preferred->path().c_str(), preferred_load, set->path().c_str(), load);
+      return set;
+    }
+  }
+
+  return preferred;
+}
+
 void PerformanceService::SetVrAppRenderThread(pid_t new_vr_app_render_thread) {
   ALOGI("SetVrAppRenderThread old=%d new=%d",
       vr_app_render_thread_, new_vr_app_render_thread);
@@ -7,6 +7,7 @@
 
 #include <pdx/service.h>
 
+#include "cpu_load.h"
 #include "cpu_set.h"
 #include "task.h"
 
@@ -47,7 +48,14 @@ class PerformanceService : public pdx::ServiceBase<PerformanceService> {
   // values.
   void SetVrAppRenderThread(pid_t new_vr_app_render_thread);
 
+  // Returns the cpuset to place a latency-critical task in given the cpuset
+  // requested by its policy. When the CPUs of |preferred| are saturated, the
+  // nearest ancestor cpuset (below the root) that still has headroom is used
+  // instead, so the task can spread onto the additional CPUs of that cpuset.
+  CpuSet* SelectCpuSet(CpuSet* preferred);
+
   CpuSetManager cpuset_;
+  CpuLoad cpu_load_;
 
   int sched_fifo_min_priority_;
   int sched_fifo_max_priority_;
@@ -24,6 +24,7 @@
 // to catch mismatches between vulkan.h and this file
 #undef VK_NO_PROTOTYPES
 #include "api.h"
+#include "proc_hash.h"
 
 namespace vulkan {
 namespace api {
@@ -597,13 +598,27 @@ VKAPI_ATTR PFN_vkVoidFunction GetDeviceProcAddr(VkDevice device, const char* pNa
         "vkGetPhysicalDeviceSurfaceSupportKHR",
         "vkSubmitDebugUtilsMessageEXT",
     };
+    static const uint16_t known_non_device_name_seeds[] = {
+        5, 2, 6, 1, 1, 5, 2, 4, 4, 1, 4, 1, 1, 2, 1, 7,
+    };
+    static const int16_t known_non_device_name_slots[] = {
+        9, -1, -1, 37, 32, -1, -1, 50, 20, 51, -1, -1, -1, -1, 22, 49,
+        36, -1, -1, -1, 39, -1, -1, -1, -1, -1, 15, 35, 1, -1, 21, -1,
+        33, 52, 45, 59, 0, -1, -1, 4, 23, -1, 24, 54, 29, 38, 34, -1,
+        -1, -1, -1, 19, 8, -1, 11, 40, 60, 2, -1, 28, 30, -1, 48, -1,
+        53, -1, -1, -1, 25, 3, -1, 57, 13, -1, -1, 5, -1, 43, 47, 12,
+        -1, -1, -1, 58, -1, -1, 18, 44, -1, -1, -1, 46, 61, -1, 31, 14,
+        -1, -1, 6, 10, -1, -1, 42, -1, 26, -1, 55, -1, -1, -1, -1, 27,
+        41, 17, 56, -1, -1, -1, 16, -1, 7, -1, -1, -1, -1, -1, -1, -1,
+    };
     // clang-format on
-    constexpr size_t count =
-        sizeof(known_non_device_names) / sizeof(known_non_device_names[0]);
-    if (!pName ||
-        std::binary_search(
-            known_non_device_names, known_non_device_names + count, pName,
-            [](const char* a, const char* b) { return (strcmp(a, b) < 0); })) {
+    int index = -1;
+    if (pName) {
+        index = FindProcName(pName, known_non_device_name_seeds,
+                             known_non_device_name_slots);
+    }
+    if (!pName || (index >= 0 &&
+                   strcmp(known_non_device_names[index], pName) == 0)) {
         vulkan::driver::Logger(device).Err(
             device, "invalid vkGetDeviceProcAddr(%p, \"%s\") call", device,
             (pName) ? pName : "(null)");
@@ -791,12 +806,49 @@ VKAPI_ATTR PFN_vkVoidFunction GetInstanceProcAddr(VkInstance instance, const cha
         { "vkUpdateDescriptorSets", reinterpret_cast<PFN_vkVoidFunction>(UpdateDescriptorSets) },
         { "vkWaitForFences", reinterpret_cast<PFN_vkVoidFunction>(WaitForFences) },
     };
+    static const uint16_t hook_seeds[] = {
+        2, 1, 2, 1, 1, 3, 1, 3, 2, 2, 1, 2, 1, 2, 2, 2,
+        9, 1, 2, 1, 2, 1, 2, 1, 3, 1, 1, 1, 4, 4, 8, 4,
+        1, 1, 2, 1, 1, 4, 1,
+    };
+    static const int16_t hook_slots[] = {
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 40, -1, 117, -1, 118, -1,
+        -1, -1, -1, -1, 7, 103, 92, -1, -1, -1, -1, -1, -1, 135, -1, -1,
+        -1, 130, 48, -1, 36, 91, -1, -1, -1, -1, -1, -1, 131, -1, -1, -1,
+        -1, -1, 151, -1, 60, 58, 12, -1, 128, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, 67, -1, 22, 87, -1, -1, 65, 107, -1, -1, -1, -1, 97, -1,
+        -1, -1, -1, -1, 17, -1, -1, -1, 115, -1, -1, 134, -1, -1, 119, -1,
+        3, -1, -1, -1, -1, -1, 74, -1, 99, -1, -1, -1, 18, -1, -1, 59,
+        -1, 4, -1, -1, -1, -1, -1, -1, 84, 152, -1, -1, 68, 121, 19, 26,
+        88, -1, -1, 28, -1, -1, -1, 90, -1, -1, -1, -1, -1, 141, -1, 2,
+        -1, 82, -1, -1, 43, -1, 56, -1, 57, -1, -1, -1, -1, 101, 53, -1,
+        -1, -1, 45, -1, -1, -1, -1, -1, -1, 110, -1, -1, 95, -1, 113, -1,
+        -1, -1, -1, -1, 136, -1, -1, -1, -1, 71, 122, -1, -1, 145, -1, -1,
+        -1, -1, -1, -1, 69, -1, -1, -1, 106, -1, 120, 30, -1, -1, -1, -1,
+        -1, -1, -1, 20, -1, -1, -1, -1, 133, -1, 64, -1, 24, -1, 116, -1,
+        -1, -1, -1, 102, 42, 98, -1, -1, -1, -1, -1, -1, -1, -1, -1, 79,
+        -1, 132, 37, -1, 9, -1, -1, -1, 44, -1, -1, -1, 75, -1, 50, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, 41, -1, 85, -1, -1, 154, 66, -1,
+        63, 31, -1, -1, -1, -1, 34, -1, -1, 47, -1, -1, 83, -1, -1, -1,
+        11, -1, -1, -1, -1, -1, -1, 155, -1, -1, -1, -1, 137, -1, 153, -1,
+        29, -1, -1, -1, -1, -1, 78, 150, 144, -1, -1, -1, 147, -1, -1, -1,
+        -1, -1, 54, -1, -1, 62, 125, -1, 6, 89, 111, -1, -1, -1, -1, -1,
+        -1, -1, 10, 73, -1, -1, -1, -1, -1, 123, 35, -1, -1, 80, -1, 14,
+        1, 93, -1, 105, 104, -1, -1, -1, -1, -1, -1, 148, -1, -1, 77, 100,
+        -1, 124, -1, 21, 5, 81, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        51, -1, -1, -1, 126, -1, -1, -1, -1, 46, -1, -1, 70, 146, -1, -1,
+        -1, -1, -1, -1, -1, 127, -1, -1, -1, -1, 96, -1, -1, -1, -1, -1,
+        139, -1, -1, 0, -1, -1, -1, -1, -1, -1, 38, 16, 109, -1, -1, -1,
+        94, -1, -1, -1, -1, -1, -1, -1, -1, 27, 23, -1, 143, 55, -1, -1,
+        138, -1, 140, -1, -1, -1, -1, -1, -1, 129, -1, -1, -1, 86, -1, -1,
+        -1, -1, -1, 13, -1, -1, -1, 8, 32, 49, -1, 108, -1, -1, 112, -1,
+        -1, -1, 52, 76, 15, -1, -1, -1, -1, 149, -1, -1, -1, -1, 114, -1,
+        142, -1, -1, 72, -1, -1, -1, -1, 39, -1, 61, 25, -1, -1, -1, 33,
+    };
     // clang-format on
-    constexpr size_t count = sizeof(hooks) / sizeof(hooks[0]);
-    auto hook = std::lower_bound(
-        hooks, hooks + count, pName,
-        [](const Hook& h, const char* n) { return strcmp(h.name, n) < 0; });
-    if (hook < hooks + count && strcmp(hook->name, pName) == 0) {
+    const int index = FindProcName(pName, hook_seeds, hook_slots);
+    if (index >= 0 && strcmp(hooks[index].name, pName) == 0) {
+        const Hook* hook = &hooks[index];
         if (!hook->proc) {
             vulkan::driver::Logger(instance).Err(
                 instance, "invalid vkGetInstanceProcAddr(%p, \"%s\") call",
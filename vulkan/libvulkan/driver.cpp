@@ -241,10 +241,18 @@ bool Hal::Open() {
     int result;
     const hwvulkan_module_t* module = nullptr;
 
+    // Set up the updated driver namespace first, so that its cost is reported
+    // apart from loading the driver.
+    nsecs_t stageTime = systemTime();
+    android::GraphicsEnv::getInstance().getDriverNamespace();
+    const nsecs_t namespaceTime = systemTime() - stageTime;
+
+    stageTime = systemTime();
     result = LoadUpdatedDriver(&module);
     if (result == -ENOENT) {
         result = LoadBuiltinDriver(&module);
     }
+    const nsecs_t dlopenTime = systemTime() - stageTime;
     if (result != 0) {
         android::GraphicsEnv::getInstance().setDriverLoaded(
             android::GpuStatsInfo::Api::API_VK, false, systemTime() - openTime);
@@ -252,6 +260,7 @@ bool Hal::Open() {
     }
 
     hwvulkan_device_t* device;
+    stageTime = systemTime();
     ATRACE_BEGIN("hwvulkan module open");
     result =
         module->common.methods->open(&module->common, HWVULKAN_DEVICE_0,
@@ -271,9 +280,17 @@ bool Hal::Open() {
     hal_.dev_ = device;
 
     hal_.InitDebugReportIndex();
-
-    android::GraphicsEnv::getInstance().setDriverLoaded(
-        android::GpuStatsInfo::Api::API_VK, true, systemTime() - openTime);
+    const nsecs_t initTime = systemTime() - stageTime;
+
+    android::GraphicsEnv& graphicsEnv = android::GraphicsEnv::getInstance();
+    graphicsEnv.setDriverLoadingStageTime(android::GpuStatsInfo::Api::API_VK,
+                                          "namespace", namespaceTime);
+    graphicsEnv.setDriverLoadingStageTime(android::GpuStatsInfo::Api::API_VK,
+                                          "dlopen", dlopenTime);
+    graphicsEnv.setDriverLoadingStageTime(android::GpuStatsInfo::Api::API_VK,
+                                          "init", initTime);
+    graphicsEnv.setDriverLoaded(android::GpuStatsInfo::Api::API_VK, true,
+                                systemTime() - openTime);
 
     return true;
 }
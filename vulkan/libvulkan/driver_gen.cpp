@@ -22,6 +22,7 @@
 #include <algorithm>
 
 #include "driver.h"
+#include "proc_hash.h"
 
 namespace vulkan {
 namespace driver {
@@ -480,13 +481,25 @@ const ProcHook g_proc_hooks[] = {
 }  // namespace
 
 const ProcHook* GetProcHook(const char* name) {
-    const auto& begin = g_proc_hooks;
-    const auto& end =
-        g_proc_hooks + sizeof(g_proc_hooks) / sizeof(g_proc_hooks[0]);
-    const auto hook = std::lower_bound(
-        begin, end, name,
-        [](const ProcHook& e, const char* n) { return strcmp(e.name, n) < 0; });
-    return (hook < end && strcmp(hook->name, name) == 0) ? hook : nullptr;
+    // clang-format off
+    static const uint16_t proc_hook_seeds[] = {
+        1, 1, 1, 5, 4, 1, 1, 2, 1, 8, 2,
+    };
+    static const int16_t proc_hook_slots[] = {
+        -1, 15, -1, -1, 18, -1, -1, 30, 26, 27, -1, -1, 9, -1, -1, -1,
+        -1, -1, 43, 36, -1, 32, -1, 21, 1, -1, -1, -1, -1, -1, -1, -1,
+        -1, 28, -1, 22, 6, -1, -1, -1, 39, -1, -1, -1, 38, -1, 11, -1,
+        3, 29, -1, -1, 5, -1, -1, -1, 19, -1, -1, -1, 2, 14, 31, -1,
+        -1, -1, -1, 41, -1, 8, -1, -1, -1, -1, 13, -1, -1, -1, -1, 17,
+        -1, -1, -1, -1, 33, -1, -1, -1, -1, 24, -1, -1, 4, -1, 42, -1,
+        -1, -1, 12, 16, -1, -1, 37, -1, -1, -1, 34, -1, 25, -1, -1, 10,
+        40, 23, 20, -1, -1, -1, -1, -1, -1, 35, 7, -1, -1, 0, -1, -1,
+    };
+    // clang-format on
+    const int index = FindProcName(name, proc_hook_seeds, proc_hook_slots);
+    return (index >= 0 && strcmp(g_proc_hooks[index].name, name) == 0)
+               ? &g_proc_hooks[index]
+               : nullptr;
 }
 
 ProcHook::Extension GetProcHookExtension(const char* name) {
@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef LIBVULKAN_PROC_HASH_H
+#define LIBVULKAN_PROC_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace vulkan {
+
+// Seeded FNV-1a over a command name. This must match proc_name_hash() in
+// ../scripts/generator_common.py, which builds the tables at generation time.
+inline uint32_t HashProcName(const char* name, uint32_t seed) {
+    uint32_t hash = 2166136261u ^ seed;
+    for (const char* c = name; *c; c++) {
+        hash ^= static_cast<uint8_t>(*c);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Returns the index of the only table entry that may be named name in a
+// two-level perfect hash generated by perfect_hash() in generator_common.py,
+// or -1. The caller must still compare the entry's name with name.
+template <size_t NumSeeds, size_t NumSlots>
+inline int FindProcName(const char* name,
+                        const uint16_t (&seeds)[NumSeeds],
+                        const int16_t (&slots)[NumSlots]) {
+    const uint32_t seed = seeds[HashProcName(name, 0) % NumSeeds];
+    return slots[HashProcName(name, seed) % NumSlots];
+}
+
+}  // namespace vulkan
+
+#endif  // LIBVULKAN_PROC_HASH_H
@@ -16,6 +16,7 @@
 
 #define ATRACE_TAG ATRACE_TAG_GRAPHICS
 
+#include <android-base/properties.h>
 #include <android/hardware/graphics/common/1.0/types.h>
 #include <grallocusage/GrallocUsageConversion.h>
 #include <graphicsenv/GraphicsEnv.h>
@@ -28,6 +29,7 @@
 #include <utils/Trace.h>
 
 #include <algorithm>
+#include <deque>
 #include <unordered_set>
 #include <vector>
 
@@ -219,11 +221,15 @@ enum { MAX_TIMING_INFOS = 10 };
 // syncronous requests to Surface Flinger):
 enum { MIN_NUM_FRAMES_AGO = 5 };
 
+// Maximum refresh divisor for swapchain frame pacing:
+enum { MAX_PACING_DIVISOR = 8 };
+
 struct Swapchain {
     Swapchain(Surface& surface_,
               uint32_t num_images_,
               VkPresentModeKHR present_mode,
-              int pre_transform_)
+              int pre_transform_,
+              uint32_t pacing_divisor_)
         : surface(surface_),
           num_images(num_images_),
           mailbox_mode(present_mode == VK_PRESENT_MODE_MAILBOX_KHR),
@@ -232,7 +238,9 @@ struct Swapchain {
           acquire_next_image_timeout(-1),
           shared(present_mode == VK_PRESENT_MODE_SHARED_DEMAND_REFRESH_KHR ||
                  present_mode ==
-                     VK_PRESENT_MODE_SHARED_CONTINUOUS_REFRESH_KHR) {
+                     VK_PRESENT_MODE_SHARED_CONTINUOUS_REFRESH_KHR),
+          pacing_divisor(pacing_divisor_),
+          last_paced_present_time(0) {
         ANativeWindow* window = surface.window.get();
         native_window_get_refresh_cycle_duration(
             window,
@@ -257,6 +265,16 @@ struct Swapchain {
     nsecs_t acquire_next_image_timeout;
     bool shared;
 
+    // When pacing_divisor is greater than 1, FIFO presents that don't carry a
+    // desiredPresentTime are scheduled every pacing_divisor refresh cycles.
+    // The cadence is re-anchored to the actual present time of an older
+    // frame, so it follows the display's vsync phase without the app having
+    // to poll for timestamps.
+    uint32_t pacing_divisor;
+    int64_t last_paced_present_time;
+    // Native frame IDs of recent paced presents, oldest first.
+    std::deque<uint64_t> paced_frames;
+
     struct Image {
         Image() : image(VK_NULL_HANDLE), dequeue_fence(-1), dequeued(false) {}
         VkImage image;
@@ -342,6 +360,7 @@ void OrphanSwapchain(VkDevice device, Swapchain* swapchain) {
     }
     swapchain->surface.swapchain_handle = VK_NULL_HANDLE;
     swapchain->timing.clear();
+    swapchain->paced_frames.clear();
 }
 
 uint32_t get_num_ready_timings(Swapchain& swapchain) {
@@ -400,6 +419,51 @@ uint32_t get_num_ready_timings(Swapchain& swapchain) {
     return num_ready;
 }
 
+// Returns the desired present time for the next paced frame of swapchain.
+int64_t get_paced_present_time(Swapchain& swapchain) {
+    ANativeWindow* window = swapchain.surface.window.get();
+    const int64_t refresh = swapchain.refresh_duration;
+    const int64_t period = refresh * swapchain.pacing_divisor;
+    const int64_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+
+    int64_t target = swapchain.last_paced_present_time + period;
+
+    // Frames MIN_NUM_FRAMES_AGO in the past have usually been presented, so
+    // querying them doesn't cause a synchronous request to SurfaceFlinger.
+    if (swapchain.paced_frames.size() >= MIN_NUM_FRAMES_AGO) {
+        int64_t actual_present_time = 0;
+        int err = native_window_get_frame_timestamps(
+            window, swapchain.paced_frames.front(),
+            nullptr,  //&desired_present_time,
+            nullptr,  //&render_complete_time,
+            nullptr,  //&composition_latch_time,
+            nullptr,  //&first_composition_start_time,
+            nullptr,  //&last_composition_start_time,
+            nullptr,  //&composition_finish_time,
+            &actual_present_time,
+            nullptr,  //&dequeue_ready_time,
+            nullptr /*&reads_done_time*/);
+        if (err == android::OK && actual_present_time > 0) {
+            // Aim half a refresh cycle ahead of the vsync the frame should
+            // land on, so it is latched for that vsync and not the previous.
+            const int64_t anchored = actual_present_time +
+                int64_t(swapchain.paced_frames.size()) * period - refresh / 2;
+            if (anchored > now) {
+                target = anchored;
+            }
+        }
+        swapchain.paced_frames.pop_front();
+    }
+
+    // The app fell behind the cadence (or this is the first paced frame), so
+    // restart it from the next refresh.
+    if (target <= now) {
+        target = now + refresh / 2;
+    }
+    swapchain.last_paced_present_time = target;
+    return target;
+}
+
 void copy_ready_timings(Swapchain& swapchain,
                         uint32_t* count,
                         VkPastPresentationTimingGOOGLE* timings) {
@@ -1285,9 +1349,17 @@ VkResult CreateSwapchainKHR(VkDevice device,
                                          VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
     if (!mem)
         return VK_ERROR_OUT_OF_HOST_MEMORY;
+    // Frame pacing only applies to FIFO; MAILBOX already lets the queue drop
+    // frames and the shared modes bypass it.
+    uint32_t pacing_divisor = 1;
+    if (create_info->presentMode == VK_PRESENT_MODE_FIFO_KHR) {
+        pacing_divisor = android::base::GetUintProperty<uint32_t>(
+            "debug.vulkan.swapchain.pacing_divisor", 1, MAX_PACING_DIVISOR);
+    }
     Swapchain* swapchain = new (mem)
         Swapchain(surface, num_images, create_info->presentMode,
-                  TranslateVulkanToNativeTransform(create_info->preTransform));
+                  TranslateVulkanToNativeTransform(create_info->preTransform),
+                  std::max(1u, pacing_divisor));
     // -- Dequeue all buffers and create a VkImage for each --
     // Any failures during or after this must cancel the dequeued buffers.
 
@@ -1709,6 +1781,24 @@ VkResult QueuePresentKHR(VkQueue queue, const VkPresentInfoKHR* present_info) {
                             static_cast<int64_t>(time->desiredPresentTime));
                     }
                 }
+                if (swapchain.pacing_divisor > 1 &&
+                    !(time && time->desiredPresentTime) &&
+                    swapchain.refresh_duration > 0) {
+                    ATRACE_NAME("PaceFrame");
+                    if (!swapchain.frame_timestamps_enabled) {
+                        native_window_enable_frame_timestamps(window, true);
+                        swapchain.frame_timestamps_enabled = true;
+                    }
+                    const int64_t desired_present_time =
+                        get_paced_present_time(swapchain);
+                    uint64_t nativeFrameId = 0;
+                    if (native_window_get_next_frame_id(
+                            window, &nativeFrameId) == android::OK) {
+                        swapchain.paced_frames.push_back(nativeFrameId);
+                    }
+                    native_window_set_buffers_timestamp(window,
+                                                        desired_present_time);
+                }
 
                 err = window->queueBuffer(window, img.buffer.get(), fence);
                 // queueBuffer always closes fence, even on error
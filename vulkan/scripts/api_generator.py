@@ -170,26 +170,28 @@ def _intercept_instance_proc_addr(f):
         PFN_vkVoidFunction proc;
     } hooks[] = {\n""")
 
+  hook_names = []
   sorted_command_list = sorted(gencom.command_list)
   for cmd in sorted_command_list:
     if gencom.is_function_exported(cmd):
       if gencom.is_globally_dispatched(cmd):
         f.write(gencom.indent(2) + '{ \"' + cmd + '\", nullptr },\n')
+        hook_names.append(cmd)
       elif (_is_intercepted(cmd) or
             cmd == 'vkGetInstanceProcAddr' or
             gencom.is_device_dispatched(cmd)):
         f.write(gencom.indent(2) + '{ \"' + cmd +
                 '\", reinterpret_cast<PFN_vkVoidFunction>(' +
                 gencom.base_name(cmd) + ') },\n')
+        hook_names.append(cmd)
 
+  f.write(gencom.indent(1) + '};\n')
+  gencom.write_perfect_hash('hook', hook_names, f)
   f.write("""\
-    };
     // clang-format on
-    constexpr size_t count = sizeof(hooks) / sizeof(hooks[0]);
-    auto hook = std::lower_bound(
-        hooks, hooks + count, pName,
-        [](const Hook& h, const char* n) { return strcmp(h.name, n) < 0; });
-    if (hook < hooks + count && strcmp(hook->name, pName) == 0) {
+    const int index = FindProcName(pName, hook_seeds, hook_slots);
+    if (index >= 0 && strcmp(hooks[index].name, pName) == 0) {
+        const Hook* hook = &hooks[index];
         if (!hook->proc) {
             vulkan::driver::Logger(instance).Err(
                 instance, "invalid vkGetInstanceProcAddr(%p, \\\"%s\\\") call",
@@ -214,21 +216,25 @@ def _intercept_device_proc_addr(f):
 
     static const char* const known_non_device_names[] = {\n""")
 
+  non_device_names = []
   sorted_command_list = sorted(gencom.command_list)
   for cmd in sorted_command_list:
     if gencom.is_function_supported(cmd):
       if not gencom.is_device_dispatched(cmd):
         f.write(gencom.indent(2) + '\"' + cmd + '\",\n')
+        non_device_names.append(cmd)
 
+  f.write(gencom.indent(1) + '};\n')
+  gencom.write_perfect_hash('known_non_device_name', non_device_names, f)
   f.write("""\
-    };
     // clang-format on
-    constexpr size_t count =
-        sizeof(known_non_device_names) / sizeof(known_non_device_names[0]);
-    if (!pName ||
-        std::binary_search(
-            known_non_device_names, known_non_device_names + count, pName,
-            [](const char* a, const char* b) { return (strcmp(a, b) < 0); })) {
+    int index = -1;
+    if (pName) {
+        index = FindProcName(pName, known_non_device_name_seeds,
+                             known_non_device_name_slots);
+    }
+    if (!pName || (index >= 0 &&
+                   strcmp(known_non_device_names[index], pName) == 0)) {
         vulkan::driver::Logger(device).Err(
             device, "invalid vkGetDeviceProcAddr(%p, \\\"%s\\\") call", device,
             (pName) ? pName : "(null)");
@@ -282,6 +288,7 @@ def gen_cpp():
 // to catch mismatches between vulkan.h and this file
 #undef VK_NO_PROTOTYPES
 #include "api.h"
+#include "proc_hash.h"
 
 namespace vulkan {
 namespace api {
@@ -430,6 +430,7 @@ def gen_cpp():
 #include <algorithm>
 
 #include "driver.h"
+#include "proc_hash.h"
 
 namespace vulkan {
 namespace driver {
@@ -447,15 +448,19 @@ namespace {
 const ProcHook g_proc_hooks[] = {
     // clang-format off\n""")
 
+    proc_hook_names = []
     sorted_command_list = sorted(gencom.command_list)
     for cmd in sorted_command_list:
       if _is_intercepted(cmd):
         if gencom.is_globally_dispatched(cmd):
           _define_global_proc_hook(cmd, f)
+          proc_hook_names.append(cmd)
         elif gencom.is_instance_dispatched(cmd):
           _define_instance_proc_hook(cmd, f)
+          proc_hook_names.append(cmd)
         elif gencom.is_device_dispatched(cmd):
           _define_device_proc_hook(cmd, f)
+          proc_hook_names.append(cmd)
 
     f.write("""\
     // clang-format on
@@ -464,13 +469,16 @@ const ProcHook g_proc_hooks[] = {
 }  // namespace
 
 const ProcHook* GetProcHook(const char* name) {
-    const auto& begin = g_proc_hooks;
-    const auto& end =
-        g_proc_hooks + sizeof(g_proc_hooks) / sizeof(g_proc_hooks[0]);
-    const auto hook = std::lower_bound(
-        begin, end, name,
-        [](const ProcHook& e, const char* n) { return strcmp(e.name, n) < 0; });
-    return (hook < end && strcmp(hook->name, name) == 0) ? hook : nullptr;
+    // clang-format off\n""")
+
+    gencom.write_perfect_hash('proc_hook', proc_hook_names, f)
+
+    f.write("""\
+    // clang-format on
+    const int index = FindProcName(name, proc_hook_seeds, proc_hook_slots);
+    return (index >= 0 && strcmp(g_proc_hooks[index].name, name) == 0)
+               ? &g_proc_hooks[index]
+               : nullptr;
 }
 
 ProcHook::Extension GetProcHookExtension(const char* name) {
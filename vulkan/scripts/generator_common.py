@@ -145,6 +145,86 @@ def run_clang_format(args):
   subprocess.check_call(clang_call)
 
 
+def proc_name_hash(name, seed):
+  """Returns the seeded FNV-1a hash of a command name.
+
+  This must match HashProcName() in libvulkan/proc_hash.h.
+
+  Args:
+    name: Vulkan command name.
+    seed: 32-bit hash seed.
+  """
+  value = (2166136261 ^ seed) & 0xffffffff
+  for c in name.encode('ascii'):
+    value ^= c
+    value = (value * 16777619) & 0xffffffff
+  return value
+
+
+def perfect_hash(names):
+  """Builds a two-level perfect hash over a list of command names.
+
+  Each name is first hashed with seed 0 into a bucket. Every bucket gets a
+  second seed under which none of its names collide with names already
+  placed. Lookup is done by FindProcName() in libvulkan/proc_hash.h.
+
+  Args:
+    names: List of unique Vulkan command names.
+
+  Returns:
+    A tuple of the per-bucket seeds and the slots, where each slot is an index
+    into names or -1.
+  """
+  num_seeds = max(1, (len(names) + 3) // 4)
+  num_slots = 1
+  while num_slots < 2 * len(names):
+    num_slots *= 2
+
+  buckets = [[] for _ in range(num_seeds)]
+  for index, name in enumerate(names):
+    buckets[proc_name_hash(name, 0) % num_seeds].append(index)
+
+  seeds = [0] * num_seeds
+  slots = [-1] * num_slots
+  for bucket in sorted(range(num_seeds), key=lambda b: -len(buckets[b])):
+    if not buckets[bucket]:
+      continue
+    for seed in range(1, 1 << 16):
+      positions = [proc_name_hash(names[i], seed) % num_slots
+                   for i in buckets[bucket]]
+      if (len(set(positions)) == len(positions) and
+          all(slots[p] == -1 for p in positions)):
+        break
+    else:
+      raise ValueError('no perfect hash seed for bucket ' + str(bucket))
+    seeds[bucket] = seed
+    for index, position in zip(buckets[bucket], positions):
+      slots[position] = index
+
+  return seeds, slots
+
+
+def write_perfect_hash(prefix, names, f):
+  """Emits the seed and slot tables of a perfect hash over names.
+
+  Args:
+    prefix: Prefix for the emitted table names.
+    names: List of unique Vulkan command names, in table order.
+    f: Output file handle.
+  """
+  seeds, slots = perfect_hash(names)
+
+  def write_table(ctype, name, values):
+    f.write(indent(1) + 'static const ' + ctype + ' ' + name + '[] = {\n')
+    for i in range(0, len(values), 16):
+      f.write(indent(2) +
+              ' '.join(str(v) + ',' for v in values[i:i + 16]) + '\n')
+    f.write(indent(1) + '};\n')
+
+  write_table('uint16_t', prefix + '_seeds', seeds)
+  write_table('int16_t', prefix + '_slots', slots)
+
+
 def is_extension_internal(ext):
   """Returns true if an extension is internal to the loader and drivers.
 